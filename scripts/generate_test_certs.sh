@@ -27,14 +27,23 @@ openssl req -new -x509 -key "$CERT_DIR/server.key" \
     -out "$CERT_DIR/server.crt" -days $DAYS \
     -subj "/C=US/ST=State/L=City/O=XOE/CN=localhost"
 
+# Generate an ECDSA P-256 key and certificate (cheaper handshakes;
+# load alongside the RSA pair with -cert a.crt,b.crt -key a.key,b.key)
+echo "Generating ECDSA private key and certificate..."
+openssl ecparam -name prime256v1 -genkey -noout -out "$CERT_DIR/server-ecdsa.key"
+openssl req -new -x509 -key "$CERT_DIR/server-ecdsa.key" \
+    -out "$CERT_DIR/server-ecdsa.crt" -days $DAYS \
+    -subj "/C=US/ST=State/L=City/O=XOE/CN=localhost"
+
 # Set appropriate permissions
-chmod 600 "$CERT_DIR/server.key"
-chmod 644 "$CERT_DIR/server.crt"
+chmod 600 "$CERT_DIR/server.key" "$CERT_DIR/server-ecdsa.key"
+chmod 644 "$CERT_DIR/server.crt" "$CERT_DIR/server-ecdsa.crt"
 
 echo ""
 echo "Certificates generated successfully in $CERT_DIR/"
 echo "  server.key - Private key (keep this secure!)"
 echo "  server.crt - Self-signed certificate"
+echo "  server-ecdsa.key / server-ecdsa.crt - ECDSA P-256 pair"
 echo ""
 echo "Valid for $DAYS days."
 echo ""
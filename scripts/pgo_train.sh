@@ -0,0 +1,47 @@
+#!/bin/bash
+################################################################################
+# Profile-Guided Optimization Training Run
+#
+# Drives a profile-generating build (make pgo) through the server's hot
+# paths: a server on a free port is loaded by the built-in bench client
+# with small and large frames, then stopped cleanly so the profile counts
+# are written out.
+#
+# Usage: scripts/pgo_train.sh [binary] [seconds per load]
+################################################################################
+
+set -e
+
+BIN="${1:-./bin/xoe}"
+SECONDS_PER_LOAD="${2:-5}"
+PORT=$((49152 + RANDOM % 16383))
+
+if [ ! -x "$BIN" ]; then
+    echo "pgo_train: $BIN not found" >&2
+    exit 1
+fi
+
+"$BIN" -p $PORT > /dev/null 2>&1 &
+SERVER_PID=$!
+trap 'kill $SERVER_PID 2>/dev/null || true' EXIT
+
+# Wait for the listener
+for i in $(seq 1 50); do
+    if (exec 6<>/dev/tcp/127.0.0.1/$PORT) 2>/dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+echo "Training: small frames..."
+"$BIN" -c 127.0.0.1:$PORT --bench 8 --bench-depth 32 \
+    --bench-time "$SECONDS_PER_LOAD" > /dev/null
+echo "Training: large frames..."
+"$BIN" -c 127.0.0.1:$PORT --bench 4 --bench-depth 8 --bench-size 16384 \
+    --bench-time "$SECONDS_PER_LOAD" > /dev/null
+
+# The profile is written when the server exits normally
+kill -TERM $SERVER_PID
+wait $SERVER_PID || true
+trap - EXIT
+echo "Training done"
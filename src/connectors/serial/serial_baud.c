@@ -0,0 +1,74 @@
+/**
+ * @file serial_baud.c
+ * @brief Arbitrary line rates through termios2 / IOSSIOSPEED
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_baud.h"
+#include "lib/common/definitions.h"
+
+#if defined(__linux__)
+/* Not <termios.h>: its struct termios collides with the kernel's */
+#include <asm/termbits.h>
+#include <asm/ioctls.h>
+#include <sys/ioctl.h>
+#elif defined(__APPLE__)
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <IOKit/serial/ioss.h>
+#endif
+
+#if defined(__linux__)
+int serial_baud_set_custom(int fd, int baud_rate)
+{
+    struct termios2 tio;
+
+    if (fd < 0 || baud_rate <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+
+    /* Input follows output (no separate IBSHIFT rate) */
+    tio.c_cflag &= ~(tcflag_t)(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER;
+    tio.c_ispeed = (speed_t)baud_rate;
+    tio.c_ospeed = (speed_t)baud_rate;
+    if (ioctl(fd, TCSETS2, &tio) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Drivers round to what their divisor reaches; refuse a poor match */
+    if (ioctl(fd, TCGETS2, &tio) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    if ((tio.c_cflag & CBAUD) != BOTHER ||
+        tio.c_ospeed * 100 < (speed_t)baud_rate * 97 ||
+        tio.c_ospeed * 100 > (speed_t)baud_rate * 103) {
+        return E_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+#elif defined(__APPLE__)
+int serial_baud_set_custom(int fd, int baud_rate)
+{
+    speed_t speed = (speed_t)baud_rate;
+
+    if (fd < 0 || baud_rate <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (ioctl(fd, IOSSIOSPEED, &speed) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+#else
+int serial_baud_set_custom(int fd, int baud_rate)
+{
+    (void)fd;
+    (void)baud_rate;
+    return E_NOT_SUPPORTED;
+}
+#endif
@@ -0,0 +1,44 @@
+/**
+ * @file serial_baud.h
+ * @brief Line rates beyond the termios speed constants
+ *
+ * termios names a fixed set of rates (B9600 ... B4000000 on Linux, far
+ * fewer elsewhere). USB adapters (FTDI, CP210x) run at any rate their
+ * divisor reaches, and some protocols need one no constant names (DMX
+ * at 250000). Where the platform can program a rate directly the port
+ * is opened at a standard rate and then switched:
+ *
+ *   Linux   TCSETS2 with BOTHER and the rate in c_ispeed / c_ospeed
+ *   macOS   the IOSSIOSPEED ioctl
+ *
+ * This lives apart from serial_port.c because the kernel's termios2
+ * definitions cannot share a translation unit with <termios.h>.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERIAL_BAUD_H
+#define SERIAL_BAUD_H
+
+/* 1 where serial_baud_set_custom() can program any rate in range */
+#if defined(__linux__) || defined(__APPLE__)
+#define SERIAL_BAUD_CUSTOM 1
+#else
+#define SERIAL_BAUD_CUSTOM 0
+#endif
+
+/**
+ * @brief Program an arbitrary line rate on an open, configured TTY
+ *
+ * Call after the last tcsetattr(): on macOS a later tcsetattr() puts the
+ * port back to the rate termios holds.
+ *
+ * @param fd        TTY descriptor
+ * @param baud_rate Rate in bits per second
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT if the driver refuses the
+ *         rate, E_NOT_SUPPORTED without SERIAL_BAUD_CUSTOM
+ */
+int serial_baud_set_custom(int fd, int baud_rate);
+
+#endif /* SERIAL_BAUD_H */
@@ -2,19 +2,97 @@
  * @file serial_buffer.c
  * @brief Thread-safe circular buffer implementation
  *
- * Implements a circular buffer with mutex-protected operations and
- * condition variables for blocking on full/empty conditions. Handles
- * network→serial speed mismatch by buffering incoming data.
+ * Implements blocking read/write on top of a lock-free SPSC ring. While
+ * data flows, neither side takes the mutex. A side that must sleep sets
+ * its waiting flag, issues a full fence and re-checks the ring under the
+ * mutex; the other side publishes its index, fences, and only signals
+ * when it sees the flag. The paired fences guarantee at least one of the
+ * two sees the other's store, so no wakeup is lost.
+ *
+ * Handles network→serial speed mismatch by buffering incoming data.
  *
  * [LLM-ASSISTED]
  */
 
 #include "connectors/serial/serial_buffer.h"
 #include "lib/common/definitions.h"
+#include "lib/common/mem_budget.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+/* ============================================================================
+ * Slow Path Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Check whether a sleeping side may proceed
+ */
+static int serial_buffer_ready(serial_buffer_t* buffer, int want_space,
+                               uint32_t min_len)
+{
+    if (SERIAL_ATOMIC_LOAD(&buffer->closed)) {
+        return TRUE;
+    }
+    if (want_space) {
+        return serial_ring_free_space(&buffer->ring) >= min_len;
+    }
+    return serial_ring_available(&buffer->ring) > 0;
+}
+
+/**
+ * @brief Sleep until the ring has data (reader) or space (writer)
+ *
+ * @param buffer Buffer
+ * @param waiting This side's waiting flag
+ * @param cond Condition the other side signals
+ * @param want_space TRUE for the writer, FALSE for the reader
+ * @param min_len Free bytes the writer needs (ignored for the reader)
+ */
+static void serial_buffer_wait(serial_buffer_t* buffer, int* waiting,
+                               pthread_cond_t* cond, int want_space,
+                               uint32_t min_len)
+{
+    pthread_mutex_lock(&buffer->mutex);
+
+    /* Announce before re-checking; pairs with the fence in wake() */
+    SERIAL_ATOMIC_STORE(waiting, TRUE);
+    SERIAL_ATOMIC_FENCE();
+
+    while (!serial_buffer_ready(buffer, want_space, min_len)) {
+        pthread_cond_wait(cond, &buffer->mutex);
+    }
+
+    SERIAL_ATOMIC_STORE(waiting, FALSE);
+    pthread_mutex_unlock(&buffer->mutex);
+}
+
+/**
+ * @brief Wake the other side if it is asleep
+ *
+ * Called after publishing a new head or tail.
+ *
+ * @param buffer Buffer
+ * @param waiting The other side's waiting flag
+ * @param cond Condition the other side sleeps on
+ */
+static void serial_buffer_wake(serial_buffer_t* buffer, int* waiting,
+                               pthread_cond_t* cond)
+{
+    SERIAL_ATOMIC_FENCE();
+    if (!SERIAL_ATOMIC_LOAD(waiting)) {
+        return;
+    }
+
+    pthread_mutex_lock(&buffer->mutex);
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(&buffer->mutex);
+}
+
+/* ============================================================================
+ * Public API
+ * ============================================================================ */
+
 /**
  * @brief Initialize a circular buffer
  */
@@ -33,18 +111,17 @@ int serial_buffer_init(serial_buffer_t* buffer, uint32_t capacity)
 
     /* Initialize structure */
     memset(buffer, 0, sizeof(serial_buffer_t));
-    buffer->capacity = capacity;
 
-    /* Allocate buffer memory */
-    buffer->data = (unsigned char*)malloc(capacity);
-    if (buffer->data == NULL) {
-        return E_OUT_OF_MEMORY;
+    /* Allocate ring storage */
+    result = serial_ring_init(&buffer->ring, capacity);
+    if (result != 0) {
+        return result;
     }
 
     /* Initialize mutex */
     result = pthread_mutex_init(&buffer->mutex, NULL);
     if (result != 0) {
-        free(buffer->data);
+        serial_ring_destroy(&buffer->ring);
         return E_UNKNOWN_ERROR;
     }
 
@@ -52,7 +129,7 @@ int serial_buffer_init(serial_buffer_t* buffer, uint32_t capacity)
     result = pthread_cond_init(&buffer->not_empty, NULL);
     if (result != 0) {
         pthread_mutex_destroy(&buffer->mutex);
-        free(buffer->data);
+        serial_ring_destroy(&buffer->ring);
         return E_UNKNOWN_ERROR;
     }
 
@@ -60,10 +137,11 @@ int serial_buffer_init(serial_buffer_t* buffer, uint32_t capacity)
     if (result != 0) {
         pthread_cond_destroy(&buffer->not_empty);
         pthread_mutex_destroy(&buffer->mutex);
-        free(buffer->data);
+        serial_ring_destroy(&buffer->ring);
         return E_UNKNOWN_ERROR;
     }
 
+    mem_budget_charge(buffer->ring.size);
     return 0;
 }
 
@@ -77,22 +155,18 @@ void serial_buffer_destroy(serial_buffer_t* buffer)
     }
 
     /* Wake all waiting threads before destroying */
-    pthread_mutex_lock(&buffer->mutex);
-    buffer->closed = TRUE;
-    pthread_cond_broadcast(&buffer->not_empty);
-    pthread_cond_broadcast(&buffer->not_full);
-    pthread_mutex_unlock(&buffer->mutex);
+    serial_buffer_close(buffer);
 
     /* Destroy synchronization primitives */
     pthread_cond_destroy(&buffer->not_full);
     pthread_cond_destroy(&buffer->not_empty);
     pthread_mutex_destroy(&buffer->mutex);
 
-    /* Free buffer memory */
-    if (buffer->data != NULL) {
-        free(buffer->data);
-        buffer->data = NULL;
+    /* Free ring storage */
+    if (buffer->ring.data != NULL) {
+        mem_budget_uncharge(buffer->ring.size);
     }
+    serial_ring_destroy(&buffer->ring);
 }
 
 /**
@@ -104,7 +178,6 @@ int serial_buffer_write(serial_buffer_t* buffer, const void* data,
     const unsigned char* src;
     uint32_t bytes_written;
     uint32_t chunk_size;
-    uint32_t space_to_end;
 
     if (buffer == NULL || data == NULL || len == 0) {
         return E_INVALID_ARGUMENT;
@@ -113,59 +186,31 @@ int serial_buffer_write(serial_buffer_t* buffer, const void* data,
     src = (const unsigned char*)data;
     bytes_written = 0;
 
-    pthread_mutex_lock(&buffer->mutex);
-
     /* Check if buffer is closed */
-    if (buffer->closed) {
-        pthread_mutex_unlock(&buffer->mutex);
+    if (SERIAL_ATOMIC_LOAD(&buffer->closed)) {
         return 0;
     }
 
     /* Write data in chunks as space becomes available */
     while (bytes_written < len) {
-        /* Wait for space if buffer is full */
-        while (buffer->count == buffer->capacity && !buffer->closed) {
-            pthread_cond_wait(&buffer->not_full, &buffer->mutex);
+        chunk_size = serial_ring_write(&buffer->ring, src + bytes_written,
+                                       len - bytes_written);
+        if (chunk_size > 0) {
+            bytes_written += chunk_size;
+            serial_buffer_wake(buffer, &buffer->reader_waiting,
+                               &buffer->not_empty);
+            continue;
         }
 
-        /* Check if buffer was closed while waiting */
-        if (buffer->closed) {
-            pthread_mutex_unlock(&buffer->mutex);
-            return bytes_written;
+        /* Ring full: stop if closed, otherwise sleep until space frees */
+        if (SERIAL_ATOMIC_LOAD(&buffer->closed)) {
+            break;
         }
-
-        /* Calculate how much we can write */
-        chunk_size = len - bytes_written;
-        if (chunk_size > buffer->capacity - buffer->count) {
-            chunk_size = buffer->capacity - buffer->count;
-        }
-
-        /* Handle wraparound */
-        space_to_end = buffer->capacity - buffer->head;
-        if (chunk_size > space_to_end) {
-            /* Write first part to end of buffer */
-            memcpy(buffer->data + buffer->head, src + bytes_written,
-                   space_to_end);
-            /* Write second part to beginning of buffer */
-            memcpy(buffer->data, src + bytes_written + space_to_end,
-                   chunk_size - space_to_end);
-        } else {
-            /* Write entire chunk */
-            memcpy(buffer->data + buffer->head, src + bytes_written,
-                   chunk_size);
-        }
-
-        /* Update head position */
-        buffer->head = (buffer->head + chunk_size) % buffer->capacity;
-        buffer->count += chunk_size;
-        bytes_written += chunk_size;
-
-        /* Signal that data is available */
-        pthread_cond_signal(&buffer->not_empty);
+        serial_buffer_wait(buffer, &buffer->writer_waiting,
+                           &buffer->not_full, TRUE, 1);
     }
 
-    pthread_mutex_unlock(&buffer->mutex);
-    return bytes_written;
+    return (int)bytes_written;
 }
 
 /**
@@ -173,60 +218,32 @@ int serial_buffer_write(serial_buffer_t* buffer, const void* data,
  */
 int serial_buffer_read(serial_buffer_t* buffer, void* data, uint32_t max_len)
 {
-    unsigned char* dst;
     uint32_t bytes_read;
-    uint32_t chunk_size;
-    uint32_t data_to_end;
+    int closed;
 
     if (buffer == NULL || data == NULL || max_len == 0) {
         return E_INVALID_ARGUMENT;
     }
 
-    dst = (unsigned char*)data;
-    bytes_read = 0;
+    for (;;) {
+        /* Sample closed first: everything written before close is visible */
+        closed = SERIAL_ATOMIC_LOAD(&buffer->closed);
 
-    pthread_mutex_lock(&buffer->mutex);
-
-    /* Wait for data if buffer is empty */
-    while (buffer->count == 0 && !buffer->closed) {
-        pthread_cond_wait(&buffer->not_empty, &buffer->mutex);
-    }
-
-    /* Check if buffer is closed and empty */
-    if (buffer->closed && buffer->count == 0) {
-        pthread_mutex_unlock(&buffer->mutex);
-        return 0;
-    }
+        bytes_read = serial_ring_read(&buffer->ring, data, max_len);
+        if (bytes_read > 0) {
+            serial_buffer_wake(buffer, &buffer->writer_waiting,
+                               &buffer->not_full);
+            return (int)bytes_read;
+        }
 
-    /* Calculate how much we can read */
-    chunk_size = max_len;
-    if (chunk_size > buffer->count) {
-        chunk_size = buffer->count;
-    }
+        /* Closed and empty */
+        if (closed) {
+            return 0;
+        }
 
-    /* Handle wraparound */
-    data_to_end = buffer->capacity - buffer->tail;
-    if (chunk_size > data_to_end) {
-        /* Read first part from tail to end of buffer */
-        memcpy(dst, buffer->data + buffer->tail, data_to_end);
-        /* Read second part from beginning of buffer */
-        memcpy(dst + data_to_end, buffer->data,
-               chunk_size - data_to_end);
-    } else {
-        /* Read entire chunk */
-        memcpy(dst, buffer->data + buffer->tail, chunk_size);
+        serial_buffer_wait(buffer, &buffer->reader_waiting,
+                           &buffer->not_empty, FALSE, 0);
     }
-
-    /* Update tail position */
-    buffer->tail = (buffer->tail + chunk_size) % buffer->capacity;
-    buffer->count -= chunk_size;
-    bytes_read = chunk_size;
-
-    /* Signal that space is available */
-    pthread_cond_signal(&buffer->not_full);
-
-    pthread_mutex_unlock(&buffer->mutex);
-    return bytes_read;
 }
 
 /**
@@ -234,17 +251,11 @@ int serial_buffer_read(serial_buffer_t* buffer, void* data, uint32_t max_len)
  */
 uint32_t serial_buffer_available(serial_buffer_t* buffer)
 {
-    uint32_t count;
-
     if (buffer == NULL) {
         return 0;
     }
 
-    pthread_mutex_lock(&buffer->mutex);
-    count = buffer->count;
-    pthread_mutex_unlock(&buffer->mutex);
-
-    return count;
+    return serial_ring_available(&buffer->ring);
 }
 
 /**
@@ -252,17 +263,11 @@ uint32_t serial_buffer_available(serial_buffer_t* buffer)
  */
 uint32_t serial_buffer_free_space(serial_buffer_t* buffer)
 {
-    uint32_t free_space;
-
     if (buffer == NULL) {
         return 0;
     }
 
-    pthread_mutex_lock(&buffer->mutex);
-    free_space = buffer->capacity - buffer->count;
-    pthread_mutex_unlock(&buffer->mutex);
-
-    return free_space;
+    return serial_ring_free_space(&buffer->ring);
 }
 
 /**
@@ -274,9 +279,10 @@ void serial_buffer_close(serial_buffer_t* buffer)
         return;
     }
 
+    SERIAL_ATOMIC_STORE(&buffer->closed, TRUE);
+
+    /* Wake all waiting threads (rare, so no waiting-flag shortcut) */
     pthread_mutex_lock(&buffer->mutex);
-    buffer->closed = TRUE;
-    /* Wake all waiting threads */
     pthread_cond_broadcast(&buffer->not_empty);
     pthread_cond_broadcast(&buffer->not_full);
     pthread_mutex_unlock(&buffer->mutex);
@@ -287,15 +293,155 @@ void serial_buffer_close(serial_buffer_t* buffer)
  */
 int serial_buffer_is_closed(serial_buffer_t* buffer)
 {
+    if (buffer == NULL) {
+        return FALSE;
+    }
+
+    return SERIAL_ATOMIC_LOAD(&buffer->closed);
+}
+
+/* ============================================================================
+ * Span Access
+ * ============================================================================ */
+
+/**
+ * @brief Wait for queued data and expose it as contiguous spans
+ */
+int serial_buffer_peek(serial_buffer_t* buffer, uint32_t max_len,
+                       struct iovec spans[SERIAL_RING_MAX_SPANS],
+                       int* span_count)
+{
+    uint32_t bytes;
     int closed;
 
-    if (buffer == NULL) {
+    if (buffer == NULL || spans == NULL || span_count == NULL ||
+        max_len == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (;;) {
+        /* Sample closed first, as in serial_buffer_read() */
+        closed = SERIAL_ATOMIC_LOAD(&buffer->closed);
+
+        bytes = serial_ring_peek(&buffer->ring, max_len, spans, span_count);
+        if (bytes > 0) {
+            return (int)bytes;
+        }
+        if (closed) {
+            return 0;
+        }
+
+        serial_buffer_wait(buffer, &buffer->reader_waiting,
+                           &buffer->not_empty, FALSE, 0);
+    }
+}
+
+/**
+ * @brief Release bytes exposed by serial_buffer_peek()
+ */
+void serial_buffer_consume(serial_buffer_t* buffer, uint32_t len)
+{
+    if (buffer == NULL || len == 0) {
+        return;
+    }
+
+    serial_ring_consume(&buffer->ring, len);
+    serial_buffer_wake(buffer, &buffer->writer_waiting, &buffer->not_full);
+}
+
+/**
+ * @brief Wait for free space and expose it as contiguous spans
+ */
+int serial_buffer_reserve(serial_buffer_t* buffer, uint32_t min_len,
+                          struct iovec spans[SERIAL_RING_MAX_SPANS],
+                          int* span_count)
+{
+    if (buffer == NULL || spans == NULL || span_count == NULL ||
+        min_len == 0 || min_len > buffer->ring.capacity) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (;;) {
+        if (SERIAL_ATOMIC_LOAD(&buffer->closed)) {
+            *span_count = 0;
+            return 0;
+        }
+
+        if (serial_ring_free_space(&buffer->ring) >= min_len) {
+            return (int)serial_ring_reserve(&buffer->ring,
+                                            buffer->ring.capacity,
+                                            spans, span_count);
+        }
+
+        serial_buffer_wait(buffer, &buffer->writer_waiting,
+                           &buffer->not_full, TRUE, min_len);
+    }
+}
+
+/**
+ * @brief Publish bytes written into serial_buffer_reserve() spans
+ */
+void serial_buffer_commit(serial_buffer_t* buffer, uint32_t len)
+{
+    if (buffer == NULL || len == 0) {
+        return;
+    }
+
+    serial_ring_commit(&buffer->ring, len);
+    serial_buffer_wake(buffer, &buffer->reader_waiting, &buffer->not_empty);
+}
+
+/* ============================================================================
+ * Flow Control
+ * ============================================================================ */
+
+/**
+ * @brief Set the flow control watermarks
+ */
+int serial_buffer_set_watermarks(serial_buffer_t* buffer, uint32_t high,
+                                 uint32_t low)
+{
+    if (buffer == NULL || high > buffer->ring.capacity ||
+        (high != 0 && low >= high)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    buffer->high_watermark = high;
+    buffer->low_watermark = low;
+    SERIAL_ATOMIC_STORE(&buffer->throttled, FALSE);
+    return 0;
+}
+
+/**
+ * @brief Check whether a watermark has been crossed
+ */
+int serial_buffer_flow_pending(serial_buffer_t* buffer)
+{
+    uint32_t level;
+
+    if (buffer == NULL || buffer->high_watermark == 0) {
         return FALSE;
     }
 
-    pthread_mutex_lock(&buffer->mutex);
-    closed = buffer->closed;
-    pthread_mutex_unlock(&buffer->mutex);
+    level = serial_ring_available(&buffer->ring);
+    if (SERIAL_ATOMIC_LOAD(&buffer->throttled)) {
+        return level <= buffer->low_watermark;
+    }
+    return level >= buffer->high_watermark;
+}
+
+/**
+ * @brief Report and record a watermark crossing
+ */
+int serial_buffer_flow_update(serial_buffer_t* buffer)
+{
+    int throttled;
+
+    if (!serial_buffer_flow_pending(buffer)) {
+        return SERIAL_BUFFER_FLOW_NONE;
+    }
 
-    return closed;
+    throttled = SERIAL_ATOMIC_LOAD(&buffer->throttled);
+    SERIAL_ATOMIC_STORE(&buffer->throttled, !throttled);
+    return throttled ? SERIAL_BUFFER_FLOW_XON : SERIAL_BUFFER_FLOW_XOFF;
 }
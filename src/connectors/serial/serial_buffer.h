@@ -3,11 +3,14 @@
  * @brief Thread-safe circular buffer for serial data flow control
  *
  * Provides a circular buffer implementation for handling the network→serial
- * speed mismatch. Implements thread-safe read/write operations using mutexes
- * and condition variables for blocking on full/empty conditions.
+ * speed mismatch, for exactly one writer thread and one reader thread.
+ * Data moves through a lock-free SPSC ring (serial_ring.h); the mutex and
+ * condition variables are only touched when one side has to sleep because
+ * the buffer is empty or full.
  *
  * The buffer size is configured to provide approximately 16 seconds of
- * buffering at 9600 baud (16KB).
+ * buffering at 9600 baud (16KB). Its storage is charged to the memory
+ * budget (mem_budget.h).
  *
  * [LLM-ASSISTED]
  */
@@ -17,27 +20,45 @@
 
 #include <pthread.h>
 #include "lib/protocol/protocol.h"
+#include "connectors/serial/serial_ring.h"
 
-/* Default buffer size (16KB) */
+/* Default buffer size (16KB, 4KB in the small-footprint profile) */
+#ifndef SERIAL_BUFFER_DEFAULT_SIZE
+#if XOE_SMALL_FOOTPRINT
+#define SERIAL_BUFFER_DEFAULT_SIZE 4096
+#else
 #define SERIAL_BUFFER_DEFAULT_SIZE 16384
+#endif
+#endif
+
+/* Default flow control watermarks, in percent of capacity */
+#define SERIAL_BUFFER_HIGH_WATERMARK_PCT 75
+#define SERIAL_BUFFER_LOW_WATERMARK_PCT 25
+
+/* Events returned by serial_buffer_flow_update() */
+#define SERIAL_BUFFER_FLOW_NONE 0   /* No change */
+#define SERIAL_BUFFER_FLOW_XOFF 1   /* Fill reached the high watermark */
+#define SERIAL_BUFFER_FLOW_XON  2   /* Fill drained to the low watermark */
 
 /**
  * @brief Circular buffer structure for serial data
  *
- * Implements a thread-safe circular buffer with blocking read/write
- * operations. Uses condition variables to wake waiting threads when
- * data becomes available or space is freed.
+ * Wraps an SPSC ring with blocking read/write operations. A side that
+ * finds the ring empty (reader) or full (writer) raises its waiting flag
+ * and sleeps on a condition variable; the other side only takes the
+ * mutex to signal when it sees that flag set.
  */
 typedef struct {
-    unsigned char* data;      /* Buffer memory */
-    uint32_t capacity;        /* Total buffer capacity */
-    uint32_t head;            /* Write position */
-    uint32_t tail;            /* Read position */
-    uint32_t count;           /* Number of bytes currently in buffer */
-    pthread_mutex_t mutex;    /* Mutex for thread safety */
+    serial_ring_t ring;       /* Lock-free data path */
+    pthread_mutex_t mutex;    /* Slow path: sleeping and waking only */
     pthread_cond_t not_empty; /* Condition: buffer has data */
     pthread_cond_t not_full;  /* Condition: buffer has space */
     int closed;               /* Flag: buffer closed for writing */
+    int reader_waiting;       /* Reader asleep on not_empty */
+    int writer_waiting;       /* Writer asleep on not_full */
+    uint32_t high_watermark;  /* XOFF at or above this fill (0 = off) */
+    uint32_t low_watermark;   /* XON at or below this fill */
+    int throttled;            /* XOFF reported, XON not yet */
 } serial_buffer_t;
 
 /**
@@ -49,7 +70,8 @@ typedef struct {
  * @param buffer Pointer to buffer structure to initialize
  * @param capacity Buffer capacity in bytes (0 for default size)
  * @return 0 on success, negative error code on failure
- *         E_INVALID_ARGUMENT - NULL pointer
+ *         E_INVALID_ARGUMENT - NULL pointer or capacity above
+ *                              SERIAL_RING_MAX_CAPACITY
  *         E_OUT_OF_MEMORY - Memory allocation failed
  *         E_UNKNOWN_ERROR - Mutex/condition variable initialization failed
  */
@@ -71,6 +93,7 @@ void serial_buffer_destroy(serial_buffer_t* buffer);
  *
  * Writes data to the buffer. Blocks if the buffer is full until space
  * becomes available. Returns immediately if the buffer has been closed.
+ * Must only be called from the single writer thread.
  *
  * @param buffer Pointer to buffer
  * @param data Data to write
@@ -87,7 +110,8 @@ int serial_buffer_write(serial_buffer_t* buffer, const void* data,
  * @brief Read data from circular buffer
  *
  * Reads data from the buffer. Blocks if the buffer is empty until data
- * becomes available or the buffer is closed.
+ * becomes available or the buffer is closed. Must only be called from
+ * the single reader thread.
  *
  * @param buffer Pointer to buffer
  * @param data Output buffer for data
@@ -102,7 +126,7 @@ int serial_buffer_read(serial_buffer_t* buffer, void* data, uint32_t max_len);
 /**
  * @brief Get number of bytes available in buffer
  *
- * Thread-safe query of current buffer occupancy.
+ * Lock-free query of current buffer occupancy.
  *
  * @param buffer Pointer to buffer
  * @return Number of bytes available, or 0 on error
@@ -112,7 +136,7 @@ uint32_t serial_buffer_available(serial_buffer_t* buffer);
 /**
  * @brief Get free space in buffer
  *
- * Thread-safe query of available write space.
+ * Lock-free query of available write space.
  *
  * @param buffer Pointer to buffer
  * @return Number of bytes of free space, or 0 on error
@@ -141,4 +165,101 @@ void serial_buffer_close(serial_buffer_t* buffer);
  */
 int serial_buffer_is_closed(serial_buffer_t* buffer);
 
+/**
+ * @brief Wait for queued data and expose it in place
+ *
+ * Blocks like serial_buffer_read(), but instead of copying, fills spans
+ * with the one or two contiguous ring regions holding the data, ready for
+ * writev(). The data stays queued until serial_buffer_consume(). Must
+ * only be called from the single reader thread.
+ *
+ * @param buffer Pointer to buffer
+ * @param max_len Maximum number of bytes to expose
+ * @param spans Filled with up to SERIAL_RING_MAX_SPANS regions
+ * @param span_count Set to the number of spans filled
+ * @return Number of bytes exposed on success
+ *         0 if buffer is closed and empty
+ *         E_INVALID_ARGUMENT - NULL pointer or zero length
+ */
+int serial_buffer_peek(serial_buffer_t* buffer, uint32_t max_len,
+                       struct iovec spans[SERIAL_RING_MAX_SPANS],
+                       int* span_count);
+
+/**
+ * @brief Release bytes exposed by serial_buffer_peek()
+ *
+ * @param buffer Pointer to buffer
+ * @param len Number of bytes consumed (at most the peeked length)
+ */
+void serial_buffer_consume(serial_buffer_t* buffer, uint32_t len);
+
+/**
+ * @brief Wait for free space and expose it in place
+ *
+ * Blocks until at least min_len bytes are free (or the buffer is closed),
+ * then fills spans with the one or two contiguous free regions so data
+ * can be decoded straight into the ring. Nothing becomes visible to the
+ * reader until serial_buffer_commit(). Must only be called from the
+ * single writer thread.
+ *
+ * @param buffer Pointer to buffer
+ * @param min_len Free bytes required (1 to capacity)
+ * @param spans Filled with up to SERIAL_RING_MAX_SPANS regions
+ * @param span_count Set to the number of spans filled
+ * @return Number of free bytes exposed (at least min_len) on success
+ *         0 if buffer is closed
+ *         E_INVALID_ARGUMENT - NULL pointer or min_len out of range
+ */
+int serial_buffer_reserve(serial_buffer_t* buffer, uint32_t min_len,
+                          struct iovec spans[SERIAL_RING_MAX_SPANS],
+                          int* span_count);
+
+/**
+ * @brief Publish bytes written into serial_buffer_reserve() spans
+ *
+ * @param buffer Pointer to buffer
+ * @param len Number of bytes written (at most the reserved length)
+ */
+void serial_buffer_commit(serial_buffer_t* buffer, uint32_t len);
+
+/**
+ * @brief Set the flow control watermarks
+ *
+ * Once the fill level reaches high, serial_buffer_flow_update() reports
+ * SERIAL_BUFFER_FLOW_XOFF; after it drains to low it reports
+ * SERIAL_BUFFER_FLOW_XON. Set before the buffer is shared between threads.
+ *
+ * @param buffer Pointer to buffer
+ * @param high High watermark in bytes (0 disables flow control)
+ * @param low Low watermark in bytes (below high)
+ * @return 0 on success, E_INVALID_ARGUMENT if the watermarks are invalid
+ */
+int serial_buffer_set_watermarks(serial_buffer_t* buffer, uint32_t high,
+                                 uint32_t low);
+
+/**
+ * @brief Check whether a watermark has been crossed
+ *
+ * Lock-free: lets the caller skip serial_buffer_flow_update() (and its
+ * own serialization) in the common case.
+ *
+ * @param buffer Pointer to buffer
+ * @return TRUE if serial_buffer_flow_update() would report an event
+ */
+int serial_buffer_flow_pending(serial_buffer_t* buffer);
+
+/**
+ * @brief Report and record a watermark crossing
+ *
+ * Called by the writer after writing and by the reader after reading.
+ * Calls from the two threads must be serialized by the caller, which
+ * should emit the event under the same lock so XOFF and XON reach the
+ * peer in the order they were recorded.
+ *
+ * @param buffer Pointer to buffer
+ * @return SERIAL_BUFFER_FLOW_XOFF, SERIAL_BUFFER_FLOW_XON or
+ *         SERIAL_BUFFER_FLOW_NONE
+ */
+int serial_buffer_flow_update(serial_buffer_t* buffer);
+
 #endif /* SERIAL_BUFFER_H */
@@ -2,10 +2,16 @@
  * @file serial_client.c
  * @brief Multi-threaded serial client implementation
  *
- * Implements bidirectional serial-to-network bridging using three threads:
+ * Implements bidirectional serial-to-network bridging using four threads:
  * - Main thread handles initialization and shutdown coordination
  * - Serial→Network thread reads from serial port, encapsulates, sends
- * - Network→Serial thread receives from network, decapsulates, writes
+ * - Network→Serial thread receives from network, decapsulates, enqueues
+ * - TTY writer thread drains the buffer to the serial port, so a slow
+ *   line never stalls the network read
+ *
+ * In a resumable session the network→serial thread also owns the
+ * connection: when a receive fails it replaces network_fd and resumes,
+ * while senders wait on tx_resumed for the link to come back.
  *
  * [LLM-ASSISTED]
  */
@@ -15,6 +21,11 @@
 #include "connectors/serial/serial_protocol.h"
 #include "connectors/serial/serial_config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+#include "lib/net/shm_link.h"
 #include "lib/protocol/wire_format.h"
 
 #include <stdio.h>
@@ -23,43 +34,21 @@
 #include <unistd.h>
 #include <errno.h>
 #include <stdarg.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/socket.h>
 
-/* C89-compliant logging - use inline fprintf to avoid variadic macro issues */
-#define LOG_ERROR3(fmt, a1, a2, a3) do { \
-    fprintf(stderr, "[ERROR] %s:%d: " fmt "\n", __FILE__, __LINE__, a1, a2, a3); \
-} while (0)
-
-#define LOG_ERROR2(fmt, a1, a2) do { \
-    fprintf(stderr, "[ERROR] %s:%d: " fmt "\n", __FILE__, __LINE__, a1, a2); \
-} while (0)
-
-#define LOG_ERROR1(fmt, a1) do { \
-    fprintf(stderr, "[ERROR] %s:%d: " fmt "\n", __FILE__, __LINE__, a1); \
-} while (0)
-
-#define LOG_WARN2(fmt, a1, a2) do { \
-    fprintf(stderr, "[WARN] %s:%d: " fmt "\n", __FILE__, __LINE__, a1, a2); \
-} while (0)
-
-#define LOG_WARN1(fmt, a1) do { \
-    fprintf(stderr, "[WARN] %s:%d: " fmt "\n", __FILE__, __LINE__, a1); \
-} while (0)
-
-#define LOG_INFO1(fmt, a1) do { \
-    fprintf(stdout, "[INFO] " fmt "\n", a1); \
-} while (0)
-
-#define LOG_ERROR_SIMPLE(msg) do { \
-    fprintf(stderr, "[ERROR] %s:%d: %s\n", __FILE__, __LINE__, msg); \
-} while (0)
-
-#define LOG_INFO_SIMPLE(msg) do { \
-    fprintf(stdout, "[INFO] %s\n", msg); \
-} while (0)
+/* Poll interval while the peer has paused us with XOFF */
+#define SERIAL_TX_PAUSE_POLL_MS 100
 
 /* Internal thread entry points */
 static void* serial_to_net_thread_func(void* arg);
 static void* net_to_serial_thread_func(void* arg);
+static void* tty_writer_thread_func(void* arg);
+
+/* Resumable session handshake, shared with the reconnect path */
+static int serial_client_resume_link(serial_client_t* client, int fd,
+                                     uint32_t features);
 
 /**
  * @brief Initialize a serial client session
@@ -85,6 +74,7 @@ serial_client_t* serial_client_init(const serial_config_t* config,
     /* Copy configuration */
     memcpy(&client->config, config, sizeof(serial_config_t));
     client->network_fd = network_fd;
+    xoe_transport_init_fd(&client->transport, network_fd);
 
     /* Initialize mutexes */
     result = pthread_mutex_init(&client->shutdown_mutex, NULL);
@@ -119,6 +109,26 @@ serial_client_t* serial_client_init(const serial_config_t* config,
         free(client);
         return NULL;
     }
+    serial_buffer_set_watermarks(&client->rx_buffer,
+        client->rx_buffer.ring.capacity / 100 * SERIAL_BUFFER_HIGH_WATERMARK_PCT,
+        client->rx_buffer.ring.capacity / 100 * SERIAL_BUFFER_LOW_WATERMARK_PCT);
+
+    /* Initialize network send lock and XOFF wait */
+    result = pthread_mutex_init(&client->send_mutex, NULL);
+    if (result == 0) {
+        result = pthread_cond_init(&client->tx_resumed, NULL);
+        if (result != 0) {
+            pthread_mutex_destroy(&client->send_mutex);
+        }
+    }
+    if (result != 0) {
+        serial_buffer_destroy(&client->rx_buffer);
+        serial_port_close(client->serial_fd);
+        pthread_mutex_destroy(&client->seq_mutex);
+        pthread_mutex_destroy(&client->shutdown_mutex);
+        free(client);
+        return NULL;
+    }
 
     return client;
 }
@@ -135,15 +145,17 @@ int serial_client_start(serial_client_t* client)
     }
 
     /* Start serial → network thread */
-    result = pthread_create(&client->serial_to_net_thread, NULL,
-                            serial_to_net_thread_func, client);
+    result = thread_sched_create(&client->serial_to_net_thread,
+                                 THREAD_CLASS_SERIAL, serial_to_net_thread_func,
+                                 client);
     if (result != 0) {
         return E_UNKNOWN_ERROR;
     }
 
-    /* Start network → serial thread */
-    result = pthread_create(&client->net_to_serial_thread, NULL,
-                            net_to_serial_thread_func, client);
+    /* Start TTY writer thread */
+    result = thread_sched_create(&client->tty_writer_thread,
+                                 THREAD_CLASS_SERIAL, tty_writer_thread_func,
+                                 client);
     if (result != 0) {
         /* Cancel the first thread */
         serial_client_request_shutdown(client);
@@ -151,6 +163,19 @@ int serial_client_start(serial_client_t* client)
         return E_UNKNOWN_ERROR;
     }
 
+    /* Start network → serial thread */
+    result = thread_sched_create(&client->net_to_serial_thread,
+                                 THREAD_CLASS_SERIAL, net_to_serial_thread_func,
+                                 client);
+    if (result != 0) {
+        /* Cancel the threads already running */
+        serial_client_request_shutdown(client);
+        serial_buffer_close(&client->rx_buffer);
+        pthread_join(client->serial_to_net_thread, NULL);
+        pthread_join(client->tty_writer_thread, NULL);
+        return E_UNKNOWN_ERROR;
+    }
+
     client->threads_started = TRUE;
     return 0;
 }
@@ -167,19 +192,76 @@ int serial_client_stop(serial_client_t* client)
     /* Request shutdown */
     serial_client_request_shutdown(client);
 
-    /* Close buffer to unblock net→serial thread */
+    /* Wake the receiver (and a resume handshake) blocked on the socket */
+    pthread_mutex_lock(&client->send_mutex);
+    if (client->network_fd >= 0) {
+        shutdown(client->network_fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&client->send_mutex);
+
+    /* Close buffer to unblock net→serial and TTY writer threads */
     serial_buffer_close(&client->rx_buffer);
 
+    /* Release a serial→net thread paused by the peer */
+    pthread_mutex_lock(&client->send_mutex);
+    pthread_cond_broadcast(&client->tx_resumed);
+    pthread_mutex_unlock(&client->send_mutex);
+
     /* Wait for threads if they were started */
     if (client->threads_started) {
         pthread_join(client->serial_to_net_thread, NULL);
         pthread_join(client->net_to_serial_thread, NULL);
+        pthread_join(client->tty_writer_thread, NULL);
         client->threads_started = FALSE;
     }
 
     return 0;
 }
 
+/**
+ * @brief Compress frames as negotiated on the connection
+ */
+int serial_client_set_compression(serial_client_t* client, uint32_t features)
+{
+    if (client == NULL || client->threads_started) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    xoe_wire_compress_cleanup(&client->compress);
+    return xoe_wire_compress_init(&client->compress, features);
+}
+
+/**
+ * @brief Make the bridge survive dropped connections
+ */
+int serial_client_enable_resume(serial_client_t* client, uint32_t features,
+                                serial_client_reconnect_fn reconnect,
+                                void* arg)
+{
+    int result;
+
+    if (client == NULL || reconnect == NULL || client->threads_started ||
+        client->session != NULL ||
+        !(features & XOE_WIRE_FEATURE_SERIAL_RESUME)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    client->session = serial_session_create(serial_session_new_id());
+    if (client->session == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    client->reconnect = reconnect;
+    client->reconnect_arg = arg;
+
+    result = serial_client_resume_link(client, client->network_fd, features);
+    if (result != 0) {
+        serial_session_destroy(client->session);
+        client->session = NULL;
+        client->link_up = FALSE;
+    }
+    return result;
+}
+
 /**
  * @brief Free serial client resources
  */
@@ -196,8 +278,12 @@ void serial_client_cleanup(serial_client_t** client)
 
     /* Destroy buffer */
     serial_buffer_destroy(&(*client)->rx_buffer);
+    xoe_wire_compress_cleanup(&(*client)->compress);
+    serial_session_destroy((*client)->session);
 
     /* Destroy mutexes */
+    pthread_cond_destroy(&(*client)->tx_resumed);
+    pthread_mutex_destroy(&(*client)->send_mutex);
     pthread_mutex_destroy(&(*client)->seq_mutex);
     pthread_mutex_destroy(&(*client)->shutdown_mutex);
 
@@ -238,80 +324,595 @@ void serial_client_request_shutdown(serial_client_t* client)
     pthread_mutex_unlock(&client->shutdown_mutex);
 }
 
+/* ============================================================================
+ * Resumable Session Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Give up on the current connection (send_mutex held)
+ *
+ * Senders hold their frames from now on; shutting the socket down makes
+ * the receiver's next read fail, and it reconnects.
+ */
+static void serial_client_link_lost(serial_client_t* client)
+{
+    if (client->link_up) {
+        client->link_up = FALSE;
+        shutdown(client->network_fd, SHUT_RDWR);
+    }
+}
+
+/**
+ * @brief Send one session frame with the current ACK (send_mutex held)
+ *
+ * A failed send only marks the link lost: data frames stay stored and go
+ * out again after the resume.
+ *
+ * @return 0 on success or lost link, negative error code if the frame
+ *         could not be built
+ */
+static int serial_client_send_session(serial_client_t* client,
+                                      const void* data, uint32_t len,
+                                      uint16_t sequence, uint16_t flags)
+{
+    xoe_packet_t packet;
+    int result;
+
+    result = serial_protocol_encapsulate_ack(data, len, sequence,
+                                             serial_session_take_ack(client->session),
+                                             (uint16_t)(flags | SERIAL_FLAG_ACK),
+                                             &packet);
+    if (result != 0) {
+        return result;
+    }
+
+    if (xoe_wire_send_compressed(&client->compress, &client->transport, 0,
+                                 &packet) != 0) {
+        LOG_WARN("Network write failed, connection lost");
+        serial_client_link_lost(client);
+    }
+    serial_protocol_free_payload(&packet);
+    return 0;
+}
+
+/**
+ * @brief Send an XON/XOFF or pure ACK frame (send_mutex held)
+ *
+ * Control frames reuse the next data sequence without consuming it.
+ */
+static void serial_client_send_control(serial_client_t* client,
+                                       uint16_t flags)
+{
+    if (serial_client_send_session(client, NULL, 0, client->session->tx_next,
+                                   flags) != 0) {
+        LOG_WARN("Failed to build serial control frame");
+    }
+}
+
+/**
+ * @brief Open or resume the session on a connection
+ *
+ * Installs @p fd as network_fd (so serial_client_stop() can wake the
+ * handshake), restarts frame compression for it, sends RESUME and waits
+ * for the server's. Then, under send_mutex, retransmits what the server's
+ * ACK says it is missing and marks the link up. If the server no longer
+ * had the session the unacknowledged data is lost; both directions start
+ * over.
+ *
+ * @return 0 on success, negative error code (network_fd is left set)
+ */
+static int serial_client_resume_link(serial_client_t* client, int fd,
+                                     uint32_t features)
+{
+    const serial_session_frame_t* frame;
+    const unsigned char* data;
+    serial_session_t* session = client->session;
+    xoe_packet_t packet;
+    uint32_t data_len;
+    uint64_t id;
+    uint16_t flags;
+    uint16_t sequence = 0;
+    uint16_t ack = 0;
+    int status = 0;
+    int result;
+    int i;
+
+    pthread_mutex_lock(&client->send_mutex);
+    client->network_fd = fd;
+    xoe_transport_init_fd(&client->transport, fd);
+    xoe_wire_compress_cleanup(&client->compress);
+    result = xoe_wire_compress_init(&client->compress, features);
+    if (result == 0) {
+        flags = SERIAL_ATOMIC_LOAD(&client->rx_buffer.throttled)
+                ? SERIAL_FLAG_XOFF : SERIAL_FLAG_XON;
+        result = serial_session_resume_frame(session, SERIAL_SESSION_OPENED,
+                                             flags, &packet);
+    }
+    if (result == 0) {
+        result = xoe_wire_send_compressed(&client->compress,
+                                          &client->transport, 0, &packet);
+        serial_protocol_free_payload(&packet);
+    }
+    pthread_mutex_unlock(&client->send_mutex);
+    if (result != 0) {
+        return result;
+    }
+
+    /* The server answers before it sends anything else */
+    memset(&packet, 0, sizeof(packet));
+    result = xoe_wire_recv_transport(&client->transport, &packet, 0);
+    if (result == 0) {
+        result = xoe_wire_decompress_packet(&client->compress, &packet);
+    }
+    if (result == 0) {
+        result = serial_protocol_peek(&packet, &flags, &sequence, &ack,
+                                      &data, &data_len);
+    }
+    if (result == 0 && (!(flags & SERIAL_FLAG_RESUME) ||
+                        serial_session_resume_parse(data, data_len, &id,
+                                                    &status) != 0 ||
+                        id != session->id)) {
+        result = E_PROTOCOL_ERROR;
+    }
+    xoe_wire_free_payload(&packet);
+    if (result != 0) {
+        return result;
+    }
+
+    pthread_mutex_lock(&client->send_mutex);
+    if (status == SERIAL_SESSION_OPENED &&
+        (session->tx_next != 0 || session->rx_next != 0)) {
+        LOG_WARN("Server lost serial session %016llx: %d unacknowledged "
+                 "frames dropped", (unsigned long long)session->id,
+                 serial_session_unacked(session));
+        serial_session_reset(session);
+    } else if (serial_session_ack(session, ack) < 0) {
+        pthread_mutex_unlock(&client->send_mutex);
+        return E_PROTOCOL_ERROR;
+    }
+
+    /* New data waits for the frames the server is about to retransmit:
+     * until then our ACKs lag its window, which the RESUME just opened */
+    client->resync_until = sequence;
+    client->resyncing = (sequence != session->rx_next) ? TRUE : FALSE;
+
+    client->link_up = TRUE;
+    for (i = 0; client->link_up && i < serial_session_unacked(session); i++) {
+        frame = serial_session_frame(session, i);
+        serial_client_send_session(client, frame->data, frame->len,
+                                   frame->sequence, frame->flags);
+        session->retransmitted++;
+    }
+    client->tx_paused = (flags & SERIAL_FLAG_XOFF) ? TRUE : FALSE;
+    pthread_cond_broadcast(&client->tx_resumed);
+    result = client->link_up ? 0 : E_IO_ERROR;
+    pthread_mutex_unlock(&client->send_mutex);
+
+    return result;
+}
+
+/**
+ * @brief Sleep for a reconnect backoff, waking early on shutdown
+ */
+static void serial_client_backoff(serial_client_t* client, int delay_ms)
+{
+    struct timespec slice;
+    int slept;
+
+    for (slept = 0; slept < delay_ms && !serial_client_should_shutdown(client);
+         slept += SERIAL_TX_PAUSE_POLL_MS) {
+        slice.tv_sec = 0;
+        slice.tv_nsec = (long)SERIAL_TX_PAUSE_POLL_MS * 1000000L;
+        nanosleep(&slice, NULL);
+    }
+}
+
+/**
+ * @brief Replace a dropped connection and resume the session
+ *
+ * Runs on the network→serial thread. Retries immediately, then after
+ * SERIAL_RECONNECT_MIN_MS, doubling up to SERIAL_RECONNECT_MAX_MS, until
+ * it succeeds or shutdown is requested.
+ *
+ * @return 0 once resumed, E_INTERRUPTED on shutdown
+ */
+static int serial_client_reconnect(serial_client_t* client)
+{
+    int delay_ms = SERIAL_RECONNECT_MIN_MS;
+    uint32_t features;
+    int attempts = 0;
+    int fd;
+    int result;
+
+    pthread_mutex_lock(&client->send_mutex);
+    client->link_up = FALSE;
+    fd = client->network_fd;
+    client->network_fd = -1;
+    pthread_mutex_unlock(&client->send_mutex);
+    if (fd >= 0) {
+        shm_link_close(fd);
+    }
+
+    LOG_WARN("Network connection lost, reconnecting (%d frames unacknowledged)",
+             serial_session_unacked(client->session));
+
+    while (!serial_client_should_shutdown(client)) {
+        attempts++;
+        result = client->reconnect(client->reconnect_arg, &fd, &features);
+        if (result == 0) {
+            result = serial_client_resume_link(client, fd, features);
+            if (result == 0) {
+                LOG_INFO("Serial session resumed after %d attempt(s), "
+                         "%llu frames retransmitted", attempts,
+                         (unsigned long long)client->session->retransmitted);
+                return 0;
+            }
+
+            pthread_mutex_lock(&client->send_mutex);
+            client->link_up = FALSE;
+            client->network_fd = -1;
+            pthread_mutex_unlock(&client->send_mutex);
+            shm_link_close(fd);
+        }
+        LOG_DEBUG("Reconnect attempt %d failed: %d", attempts, result);
+
+        serial_client_backoff(client, delay_ms);
+        delay_ms *= 2;
+        if (delay_ms > SERIAL_RECONNECT_MAX_MS) {
+            delay_ms = SERIAL_RECONNECT_MAX_MS;
+        }
+    }
+
+    return E_INTERRUPTED;
+}
+
+/**
+ * @brief Reconnect after a receive failure if the session allows it
+ *
+ * @return TRUE if the link was resumed and the receiver should go on
+ */
+static int serial_client_recover(serial_client_t* client)
+{
+    if (client->session == NULL || serial_client_should_shutdown(client)) {
+        return FALSE;
+    }
+
+    return (serial_client_reconnect(client) == 0) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Account a received session frame
+ *
+ * Applies the peer's ACK (waking senders the window held), classifies a
+ * data frame, and answers with a pure ACK when the peer has sent a
+ * quarter window without hearing from us.
+ *
+ * @return SERIAL_SESSION_NEW to deliver the frame (control frames too),
+ *         SERIAL_SESSION_DUPLICATE to drop it, E_PROTOCOL_ERROR if the
+ *         peer broke the session
+ */
+static int serial_client_session_rx(serial_client_t* client, uint16_t flags,
+                                    uint16_t sequence, uint16_t ack,
+                                    uint32_t data_len)
+{
+    int result = SERIAL_SESSION_NEW;
+    int released;
+
+    if (!(flags & SERIAL_FLAG_ACK) || (flags & SERIAL_FLAG_RESUME)) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    pthread_mutex_lock(&client->send_mutex);
+
+    released = serial_session_ack(client->session, ack);
+    if (released < 0) {
+        result = released;
+    } else if (released > 0) {
+        pthread_cond_broadcast(&client->tx_resumed);
+    }
+
+    if (result == SERIAL_SESSION_NEW && data_len > 0) {
+        result = serial_session_accept(client->session, sequence);
+        if (result == SERIAL_SESSION_NEW &&
+            serial_session_ack_due(client->session) && client->link_up) {
+            serial_client_send_control(client, 0);
+        }
+        if (client->resyncing &&
+            client->session->rx_next == client->resync_until) {
+            client->resyncing = FALSE;
+            pthread_cond_broadcast(&client->tx_resumed);
+        }
+    }
+
+    pthread_mutex_unlock(&client->send_mutex);
+    return result;
+}
+
+/* ============================================================================
+ * Flow Control Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Send XON or XOFF when the rx buffer crosses a watermark
+ *
+ * Called by the network receiver after enqueueing and by the TTY writer
+ * after draining. send_mutex serializes the state change with its frame,
+ * so the peer sees XOFF and XON in the order they were decided.
+ */
+static void serial_client_update_flow(serial_client_t* client)
+{
+    xoe_packet_t packet;
+    unsigned char none = 0;
+    uint16_t flags;
+    uint16_t seq;
+    int event;
+    int result;
+
+    /* Lock-free check: nothing to do between the watermarks */
+    if (!serial_buffer_flow_pending(&client->rx_buffer)) {
+        return;
+    }
+
+    pthread_mutex_lock(&client->send_mutex);
+
+    event = serial_buffer_flow_update(&client->rx_buffer);
+    if (event != SERIAL_BUFFER_FLOW_NONE) {
+        flags = (event == SERIAL_BUFFER_FLOW_XOFF) ? SERIAL_FLAG_XOFF :
+                                                     SERIAL_FLAG_XON;
+
+        if (client->session != NULL) {
+            /* While the link is down the RESUME frame carries the state */
+            if (client->link_up) {
+                serial_client_send_control(client, flags);
+            }
+            pthread_mutex_unlock(&client->send_mutex);
+            return;
+        }
+
+        pthread_mutex_lock(&client->seq_mutex);
+        seq = client->tx_sequence;
+        client->tx_sequence++;
+        pthread_mutex_unlock(&client->seq_mutex);
+
+        /* Control-only frame: flags and no data */
+        result = serial_protocol_encapsulate(&none, 0, seq, flags, &packet);
+        if (result == 0) {
+            result = xoe_wire_send_compressed(&client->compress,
+                                              &client->transport, 0, &packet);
+            serial_protocol_free_payload(&packet);
+        }
+        if (result != 0) {
+            LOG_WARN("Failed to send %s: error code %d",
+                      (flags == SERIAL_FLAG_XOFF) ? "XOFF" : "XON", result);
+        }
+    }
+
+    pthread_mutex_unlock(&client->send_mutex);
+}
+
+/**
+ * @brief Apply XON/XOFF received from the peer
+ */
+static void serial_client_set_tx_paused(serial_client_t* client, int paused)
+{
+    pthread_mutex_lock(&client->send_mutex);
+    client->tx_paused = paused;
+    if (!paused) {
+        pthread_cond_broadcast(&client->tx_resumed);
+    }
+    pthread_mutex_unlock(&client->send_mutex);
+}
+
+/**
+ * @brief Check whether a data frame may be sent (send_mutex held)
+ */
+static int serial_client_tx_blocked(const serial_client_t* client)
+{
+    if (client->tx_paused) {
+        return TRUE;
+    }
+
+    return (client->session != NULL &&
+            (!client->link_up || client->resyncing ||
+             serial_session_window_full(client->session)))
+           ? TRUE : FALSE;
+}
+
+/**
+ * @brief Wait while the peer has paused us, or the session's link is down,
+ *        resynchronizing or its window full (send_mutex held)
+ */
+static void serial_client_wait_tx_resumed(serial_client_t* client)
+{
+    struct timeval now;
+    struct timespec deadline;
+
+    while (serial_client_tx_blocked(client) &&
+           !serial_client_should_shutdown(client)) {
+        gettimeofday(&now, NULL);
+        deadline.tv_sec = now.tv_sec;
+        deadline.tv_nsec = (now.tv_usec * 1000) +
+                           ((long)SERIAL_TX_PAUSE_POLL_MS * 1000000);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&client->tx_resumed, &client->send_mutex,
+                               &deadline);
+    }
+}
+
+/* ============================================================================
+ * I/O Threads
+ * ============================================================================ */
+
+/**
+ * @brief Store and send one frame of a resumable session
+ *
+ * @return 0 on success (also when the link dropped: the frame is kept),
+ *         negative error code on failure
+ */
+static int serial_client_send_session_frame(serial_client_t* client,
+                                            const unsigned char* data, int len)
+{
+    uint16_t seq;
+    int result;
+
+    pthread_mutex_lock(&client->send_mutex);
+    serial_client_wait_tx_resumed(client);
+    if (serial_client_tx_blocked(client)) {
+        pthread_mutex_unlock(&client->send_mutex);
+        return 0;   /* Shutting down */
+    }
+
+    result = serial_session_store(client->session, data, (uint32_t)len, 0,
+                                  &seq);
+    if (result == 0) {
+        result = serial_client_send_session(client, data, (uint32_t)len,
+                                            seq, 0);
+    }
+    pthread_mutex_unlock(&client->send_mutex);
+
+    if (result != 0) {
+        LOG_ERROR("Packet encapsulation failed: error code %d, bytes=%d",
+                   result, len);
+    }
+    return result;
+}
+
+/**
+ * @brief Encapsulate one frame of serial data and send it to the network
+ *
+ * Waits while the peer has sent XOFF.
+ *
+ * @return 0 on success, negative error code on failure
+ */
+static int serial_client_send_frame(serial_client_t* client,
+                                    const unsigned char* data, int len)
+{
+    xoe_packet_t packet;
+    uint16_t seq;
+    int result;
+
+    if (client->session != NULL) {
+        return serial_client_send_session_frame(client, data, len);
+    }
+
+    /* SER-004 fix: mutex-protected sequence */
+    pthread_mutex_lock(&client->seq_mutex);
+    seq = client->tx_sequence;
+    client->tx_sequence++;
+    pthread_mutex_unlock(&client->seq_mutex);
+
+    result = serial_protocol_encapsulate(data, len, seq, 0, &packet);
+    if (result != 0) {
+        LOG_ERROR("Packet encapsulation failed: error code %d, bytes=%d, seq=%u",
+                   result, len, seq);
+        return result;
+    }
+
+    /* Send to network socket using wire format (SER-003 fix) */
+    pthread_mutex_lock(&client->send_mutex);
+    serial_client_wait_tx_resumed(client);
+    result = xoe_wire_send_compressed(&client->compress, &client->transport,
+                                      0, &packet);
+    pthread_mutex_unlock(&client->send_mutex);
+
+    /* Free packet payload */
+    serial_protocol_free_payload(&packet);
+
+    if (result != 0) {
+        LOG_ERROR("Network write failed: error code %d", result);
+    }
+    return result;
+}
+
 /**
  * @brief Serial → Network thread function
  *
  * Continuously reads from the serial port, encapsulates data into
- * XOE packets, and sends to the network socket. Exits on error or
- * shutdown request.
+ * XOE packets, and sends to the network socket. Consecutive reads are
+ * coalesced into one burst of up to serial_config_read_chunk() bytes, for
+ * at most coalesce_us, and flushed as soon as the line goes idle; the
+ * burst goes out as frames of up to coalesce_bytes. In frame read mode a
+ * burst is one device frame, ended by the inter-frame gap alone. Holds frames while
+ * the peer has sent XOFF. Exits on error or shutdown request.
  */
 static void* serial_to_net_thread_func(void* arg)
 {
     serial_client_t* client;
-    unsigned char buffer[SERIAL_READ_CHUNK_SIZE];
+    unsigned char buffer[SERIAL_READ_CHUNK_MAX];
+    uint64_t read_ns;
     int bytes_read;
-    int bytes_sent;
-    xoe_packet_t packet;
+    int frame_limit;
+    int read_limit;
+    int idle_us;
+    int window_us;
+    int offset;
+    int frame_len;
     int result;
 
     client = (serial_client_t*)arg;
-    LOG_INFO_SIMPLE("Serial→Network thread started");
+    LOG_INFO("Serial→Network thread started");
 
-    while (!serial_client_should_shutdown(client)) {
-        /* Read from serial port with timeout */
-        bytes_read = serial_port_read(client->serial_fd, buffer,
-                                       SERIAL_READ_CHUNK_SIZE,
-                                       client->config.read_timeout_ms);
+    /* Coalescing limits (validated in serial_config_validate) */
+    frame_limit = client->config.coalesce_bytes;
+    if (frame_limit <= 0 || frame_limit > SERIAL_MAX_PAYLOAD_SIZE) {
+        frame_limit = SERIAL_MAX_PAYLOAD_SIZE;
+    }
+    read_limit = serial_config_read_chunk(&client->config);
+    if (read_limit < frame_limit || read_limit > (int)sizeof(buffer)) {
+        read_limit = frame_limit;
+    }
+    idle_us = serial_config_idle_gap_us(&client->config);
+    window_us = serial_config_burst_window_us(&client->config);
+
+    result = 0;
+    while (result == 0 && !serial_client_should_shutdown(client)) {
+        /* Read one burst (up to read_limit bytes / window_us) */
+        if (client->config.read_mode != SERIAL_READ_MODE_FIXED) {
+            bytes_read = serial_port_read_adaptive(client->serial_fd, buffer,
+                                                   read_limit,
+                                                   client->config.read_timeout_ms,
+                                                   window_us,
+                                                   idle_us);
+        } else {
+            bytes_read = serial_port_read_coalesced(client->serial_fd, buffer,
+                                                    read_limit,
+                                                    client->config.read_timeout_ms,
+                                                    window_us,
+                                                    idle_us);
+        }
 
         if (bytes_read < 0) {
             /* Error reading from serial port */
-            LOG_ERROR3("Serial read failed: error code %d (errno=%d: %s)",
+            LOG_ERROR("Serial read failed: error code %d (errno=%d: %s)",
                        bytes_read, errno, strerror(errno));
-            LOG_ERROR2("Device: %s, Baud: %d",
+            LOG_ERROR("Device: %s, Baud: %d",
                        client->config.device_path, client->config.baud_rate);
             serial_client_request_shutdown(client);
             break;
         }
 
-        if (bytes_read == 0) {
-            /* Timeout, try again */
-            continue;
-        }
-
-        /* Encapsulate into XOE packet (SER-004 fix: mutex-protected sequence) */
-        {
-            uint16_t seq;
-            pthread_mutex_lock(&client->seq_mutex);
-            seq = client->tx_sequence;
-            client->tx_sequence++;
-            pthread_mutex_unlock(&client->seq_mutex);
+        metrics_add(METRIC_SERIAL_RX_BYTES, (uint64_t)bytes_read);
+        read_ns = latency_now_ns();
 
-            result = serial_protocol_encapsulate(buffer, bytes_read, seq, 0, &packet);
+        /* Split the burst into frames (nothing to do on timeout) */
+        for (offset = 0; offset < bytes_read; offset += frame_len) {
+            frame_len = bytes_read - offset;
+            if (frame_len > frame_limit) {
+                frame_len = frame_limit;
+            }
+            result = serial_client_send_frame(client, buffer + offset, frame_len);
             if (result != 0) {
-                LOG_ERROR3("Packet encapsulation failed: error code %d, bytes=%d, seq=%u",
-                           result, bytes_read, seq);
                 serial_client_request_shutdown(client);
                 break;
             }
+            latency_record_since(LATENCY_SERIAL_TO_NET, read_ns);
         }
-
-        /* Send to network socket using wire format (SER-003 fix) */
-        result = xoe_wire_send(client->network_fd, &packet);
-
-        /* Free packet payload */
-        serial_protocol_free_payload(&packet);
-
-        if (result != 0) {
-            /* Network error */
-            LOG_ERROR1("Network write failed: error code %d", result);
-            serial_client_request_shutdown(client);
-            break;
-        }
-
-        (void)bytes_sent;  /* Suppress unused warning */
     }
 
-    LOG_INFO_SIMPLE("Serial→Network thread exiting");
+    LOG_INFO("Serial→Network thread exiting");
     return NULL;
 }
 
@@ -319,74 +920,150 @@ static void* serial_to_net_thread_func(void* arg)
  * @brief Network → Serial thread function
  *
  * Continuously receives data from the network socket, decapsulates
- * XOE packets, and writes to the serial port via the circular buffer.
- * The buffer handles speed mismatch between network and serial.
+ * XOE packets, and enqueues the data in the circular buffer for the TTY
+ * writer thread. The buffer handles speed mismatch between network and
+ * serial; crossing its watermarks sends XOFF/XON to the peer.
  */
 static void* net_to_serial_thread_func(void* arg)
 {
     serial_client_t* client;
-    unsigned char serial_buffer[SERIAL_MAX_PAYLOAD_SIZE];
-    int bytes_read;
-    int bytes_written;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count;
+    int reserved;
+    uint32_t frame_len;
     xoe_packet_t packet;
     uint32_t actual_len;
+    const unsigned char* data;
     uint16_t sequence;
     uint16_t flags;
+    uint16_t ack;
     int result;
 
     client = (serial_client_t*)arg;
     memset(&packet, 0, sizeof(packet));
-    LOG_INFO_SIMPLE("Network→Serial thread started");
+    LOG_INFO("Network→Serial thread started");
 
     while (!serial_client_should_shutdown(client)) {
         /* Receive from network using wire format (SER-003 fix) */
-        /* xoe_wire_recv handles TCP framing and validates checksum */
-        result = xoe_wire_recv(client->network_fd, &packet);
+        /* Reads whole frames and validates the checksum */
+        result = xoe_wire_recv_transport(&client->transport, &packet, 0);
 
         if (result == E_IO_ERROR) {
-            /* Connection closed or error */
-            LOG_INFO_SIMPLE("Network connection closed by peer");
+            /* Connection closed or error: resume on a new one if we can */
+            if (serial_client_recover(client)) {
+                continue;
+            }
+            LOG_INFO("Network connection closed by peer");
             serial_client_request_shutdown(client);
             break;
         }
 
         if (result == E_CHECKSUM_MISMATCH) {
             /* Corrupted packet, log and continue */
-            LOG_WARN1("Checksum mismatch on received packet, error=%d", result);
+            LOG_WARN("Checksum mismatch on received packet, error=%d", result);
             continue;
         }
 
         if (result != 0) {
             /* Other error */
-            LOG_ERROR1("Network receive failed: error code %d", result);
+            LOG_ERROR("Network receive failed: error code %d", result);
+            if (serial_client_recover(client)) {
+                continue;
+            }
+            serial_client_request_shutdown(client);
+            break;
+        }
+
+        /* A frame that cannot be decompressed desynchronizes the stream */
+        result = xoe_wire_decompress_packet(&client->compress, &packet);
+        if (result != 0) {
+            LOG_ERROR("Undecodable compressed frame: error code %d", result);
+            xoe_wire_free_payload(&packet);
+            if (serial_client_recover(client)) {
+                continue;
+            }
             serial_client_request_shutdown(client);
             break;
         }
 
-        /* Decapsulate serial data from XOE packet */
-        result = serial_protocol_decapsulate(&packet, serial_buffer,
-                                              sizeof(serial_buffer),
-                                              &actual_len, &sequence,
-                                              &flags);
+        /*
+         * xoe_wire_recv() has verified the frame CRC, which also covers the
+         * length field and so differs from the serial protocol checksum;
+         * stamp the latter so decapsulation does not reject every frame.
+         */
+        packet.checksum = serial_protocol_checksum(&packet);
+
+        result = serial_protocol_peek(&packet, &flags, &sequence, &ack,
+                                      &data, &frame_len);
+
+        /* Resumable session: apply the ACK, drop retransmitted duplicates */
+        if (result == 0 && client->session != NULL) {
+            result = serial_client_session_rx(client, flags, sequence, ack,
+                                              frame_len);
+            if (result == SERIAL_SESSION_DUPLICATE) {
+                xoe_wire_free_payload(&packet);
+                continue;
+            }
+            if (result < 0) {
+                LOG_ERROR("Serial session protocol error (seq=%u, ack=%u)",
+                          sequence, ack);
+                xoe_wire_free_payload(&packet);
+                serial_client_request_shutdown(client);
+                break;
+            }
+            result = 0;
+        }
+
+        /* Reserve room for the frame's data straight in the ring */
+        span_count = 0;
+        if (result == 0 && frame_len > SERIAL_MAX_PAYLOAD_SIZE) {
+            result = E_BUFFER_TOO_SMALL;
+        } else if (result == 0) {
+            if (frame_len > 0) {
+                reserved = serial_buffer_reserve(&client->rx_buffer, frame_len,
+                                                 spans, &span_count);
+                if (reserved <= 0) {
+                    /* Buffer closed or error */
+                    LOG_ERROR("Buffer reserve failed: returned %d", reserved);
+                    xoe_wire_free_payload(&packet);
+                    serial_client_request_shutdown(client);
+                    break;
+                }
+            }
+
+            /* Decapsulate serial data from XOE packet into the ring */
+            result = serial_protocol_decapsulate_iov(&packet, spans, span_count,
+                                                     &actual_len, &sequence,
+                                                     &flags);
+        }
 
         /* Free wire format payload (allocated by xoe_wire_recv) */
         xoe_wire_free_payload(&packet);
 
         if (result != 0) {
             /* Decapsulation error, skip packet */
-            LOG_WARN1("Packet decapsulation failed: error code %d", result);
+            LOG_WARN("Packet decapsulation failed: error code %d", result);
             continue;
         }
 
         /* Check for serial errors in flags */
+        if (flags & (SERIAL_FLAG_PARITY_ERROR | SERIAL_FLAG_FRAMING_ERROR |
+                     SERIAL_FLAG_OVERRUN_ERROR)) {
+            metrics_add(METRIC_SERIAL_LINE_ERRORS, 1);
+        }
         if (flags & SERIAL_FLAG_PARITY_ERROR) {
-            LOG_WARN1("Parity error detected in packet seq=%u", sequence);
+            LOG_WARN("Parity error detected in packet seq=%u", sequence);
         }
         if (flags & SERIAL_FLAG_FRAMING_ERROR) {
-            LOG_WARN1("Framing error detected in packet seq=%u", sequence);
+            LOG_WARN("Framing error detected in packet seq=%u", sequence);
         }
         if (flags & SERIAL_FLAG_OVERRUN_ERROR) {
-            LOG_WARN1("Overrun error detected in packet seq=%u", sequence);
+            LOG_WARN("Overrun error detected in packet seq=%u", sequence);
+        }
+
+        /* Peer flow control: pause or resume serial→network */
+        if (flags & (SERIAL_FLAG_XOFF | SERIAL_FLAG_XON)) {
+            serial_client_set_tx_paused(client, (flags & SERIAL_FLAG_XOFF) != 0);
         }
 
         /* Update rx sequence (SER-004 fix: mutex-protected) */
@@ -394,50 +1071,78 @@ static void* net_to_serial_thread_func(void* arg)
         client->rx_sequence = sequence;
         pthread_mutex_unlock(&client->seq_mutex);
 
-        /* Write to serial port via circular buffer */
-        bytes_written = serial_buffer_write(&client->rx_buffer,
-                                             serial_buffer, actual_len);
-
-        if (bytes_written <= 0) {
-            /* Buffer closed or error */
-            LOG_ERROR1("Buffer write failed: returned %d", bytes_written);
-            serial_client_request_shutdown(client);
-            break;
+        if (actual_len == 0) {
+            continue; /* Control-only frame */
         }
 
-        if ((uint32_t)bytes_written != actual_len) {
-            LOG_WARN2("Partial buffer write: wrote %d of %u bytes", bytes_written, actual_len);
-        }
+        /* Hand the decoded bytes to the TTY writer thread */
+        serial_buffer_commit(&client->rx_buffer, actual_len);
 
-        /* Read from buffer and write to serial port */
-        while (serial_buffer_available(&client->rx_buffer) > 0 &&
-               !serial_client_should_shutdown(client)) {
-            bytes_read = serial_buffer_read(&client->rx_buffer,
-                                             serial_buffer,
-                                             sizeof(serial_buffer));
+        /* XOFF the peer once the high watermark is reached */
+        serial_client_update_flow(client);
+    }
 
-            if (bytes_read <= 0) {
-                break; /* Buffer empty or closed */
-            }
+    /* No more data: let the TTY writer drain and exit */
+    serial_buffer_close(&client->rx_buffer);
 
-            bytes_written = serial_port_write(client->serial_fd,
-                                               serial_buffer,
-                                               bytes_read);
+    LOG_INFO("Network→Serial thread exiting");
+    return NULL;
+}
 
-            if (bytes_written < 0) {
-                /* Serial write error */
-                LOG_ERROR3("Serial write failed: error code %d (errno=%d: %s)", bytes_written, errno, strerror(errno));
-                LOG_ERROR1("Device: %s", client->config.device_path);
-                serial_client_request_shutdown(client);
-                break;
-            }
+/**
+ * @brief TTY writer thread function
+ *
+ * Owns the serial port write side: drains the circular buffer to the
+ * TTY at line speed, so a slow port only fills the buffer instead of
+ * stalling the network read. Exits once the buffer is closed and empty,
+ * on a serial write error, or on shutdown request.
+ */
+static void* tty_writer_thread_func(void* arg)
+{
+    serial_client_t* client;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count;
+    int bytes_read;
+    int bytes_written;
 
-            if (bytes_written != bytes_read) {
-                LOG_WARN2("Partial serial write: wrote %d of %d bytes", bytes_written, bytes_read);
-            }
+    client = (serial_client_t*)arg;
+    LOG_INFO("TTY writer thread started");
+
+    while (!serial_client_should_shutdown(client)) {
+        /* Blocks until data arrives or the buffer is closed */
+        bytes_read = serial_buffer_peek(&client->rx_buffer,
+                                        SERIAL_WRITE_CHUNK_SIZE,
+                                        spans, &span_count);
+        if (bytes_read <= 0) {
+            break; /* Closed and drained */
         }
+
+        /* Straight from the ring to the TTY */
+        bytes_written = serial_port_writev(client->serial_fd, spans,
+                                           span_count);
+
+        if (bytes_written < 0) {
+            /* Serial write error */
+            LOG_ERROR("Serial write failed: error code %d (errno=%d: %s)", bytes_written, errno, strerror(errno));
+            LOG_ERROR("Device: %s", client->config.device_path);
+            serial_client_request_shutdown(client);
+            break;
+        }
+
+        metrics_add(METRIC_SERIAL_TX_BYTES, (uint64_t)bytes_written);
+
+        if (bytes_written != bytes_read) {
+            LOG_WARN("Partial serial write: wrote %d of %d bytes", bytes_written, bytes_read);
+        }
+
+        /* Free the space, then XON the peer once at the low watermark */
+        serial_buffer_consume(&client->rx_buffer, (uint32_t)bytes_read);
+        serial_client_update_flow(client);
     }
 
-    LOG_INFO_SIMPLE("Network→Serial thread exiting");
+    /* Unblock a receiver waiting for buffer space */
+    serial_buffer_close(&client->rx_buffer);
+
+    LOG_INFO("TTY writer thread exiting");
     return NULL;
 }
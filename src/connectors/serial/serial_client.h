@@ -3,12 +3,23 @@
  * @brief Multi-threaded serial client for XOE integration
  *
  * Provides high-level interface for bidirectional serial-to-network bridging.
- * Manages three threads:
+ * Manages four threads:
  * - Main thread: coordination and shutdown
  * - Serial→Network thread: reads from serial, encapsulates, sends to network
- * - Network→Serial thread: receives from network, decapsulates, writes to serial
+ * - Network→Serial thread: receives from network, decapsulates, enqueues
+ * - TTY writer thread: drains the buffer to the serial port
  *
- * Uses circular buffer for flow control on the network→serial path.
+ * Uses circular buffer for flow control on the network→serial path. When
+ * the buffer reaches its high watermark the peer is sent SERIAL_FLAG_XOFF,
+ * and SERIAL_FLAG_XON once it drains to the low watermark; the same flags
+ * from the peer pause and resume the serial→network path.
+ *
+ * With serial_client_enable_resume() the bridge survives a dropped
+ * connection: frames carry cumulative ACKs, unacknowledged ones are kept
+ * (serial_session.h), and the network→serial thread reconnects with
+ * exponential backoff and resumes the session, retransmitting only what
+ * the server missed. The serial→network thread holds its frames while
+ * the link is down or the window is full.
  *
  * [LLM-ASSISTED]
  */
@@ -19,6 +30,23 @@
 #include <pthread.h>
 #include "serial_config.h"
 #include "serial_buffer.h"
+#include "serial_session.h"
+#include "lib/protocol/wire_compress.h"
+
+/**
+ * @brief Open a new connection to the server for a resumed session
+ *
+ * Called on the network→serial thread after the connection dropped.
+ * Connects and negotiates XOE_WIRE_FEATURE_SERIAL_RESUME (plus any other
+ * features the first connection used).
+ *
+ * @param arg Argument given to serial_client_enable_resume()
+ * @param fd_out Output: connected socket
+ * @param features_out Output: granted XOE_WIRE_FEATURE_* bits
+ * @return 0 on success, negative error code to retry after a backoff
+ */
+typedef int (*serial_client_reconnect_fn)(void* arg, int* fd_out,
+                                          uint32_t* features_out);
 
 /**
  * @brief Serial client session structure
@@ -30,16 +58,34 @@ typedef struct {
     /* Configuration */
     serial_config_t config;
     int network_fd;
+    xoe_transport_t transport;    /* Bound to network_fd */
     int serial_fd;
 
     /* Threading */
     pthread_t serial_to_net_thread;
     pthread_t net_to_serial_thread;
+    pthread_t tty_writer_thread;
     int threads_started;
 
     /* Flow control buffer (network → serial) */
     serial_buffer_t rx_buffer;
 
+    /* Network send side, shared by data and XON/XOFF frames */
+    pthread_mutex_t send_mutex;   /* Serializes frames on network_fd */
+    pthread_cond_t tx_resumed;    /* Signalled on XON, a window-opening
+                                   * ACK and when the link is back */
+    int tx_paused;                /* Peer sent XOFF (send_mutex) */
+    xoe_wire_compress_t compress; /* Negotiated frame compression (send
+                                   * side under send_mutex) */
+
+    /* Resumable session (send_mutex); NULL unless enabled */
+    serial_session_t* session;
+    serial_client_reconnect_fn reconnect;
+    void* reconnect_arg;
+    int link_up;                  /* network_fd is usable (send_mutex) */
+    uint16_t resync_until;        /* Peer's next sequence at the resume */
+    int resyncing;                /* Its retransmissions not all in yet */
+
     /* Synchronization */
     pthread_mutex_t shutdown_mutex;
     int shutdown_flag;
@@ -64,11 +110,45 @@ typedef struct {
 serial_client_t* serial_client_init(const serial_config_t* config,
                                      int network_fd);
 
+/**
+ * @brief Compress frames as negotiated on the connection
+ *
+ * Call before serial_client_start(), after xoe_wire_negotiate() granted
+ * a compression feature.
+ *
+ * @param client    Pointer to client session
+ * @param features  Granted XOE_WIRE_FEATURE_* bits
+ * @return 0 on success, or an error from xoe_wire_compress_init()
+ */
+int serial_client_set_compression(serial_client_t* client, uint32_t features);
+
+/**
+ * @brief Make the bridge survive dropped connections
+ *
+ * Call before serial_client_start(), after xoe_wire_negotiate() granted
+ * XOE_WIRE_FEATURE_SERIAL_RESUME; replaces serial_client_set_compression().
+ * Opens the session with the server (one round trip on network_fd). From
+ * then on the client owns the socket: it closes it and uses the one
+ * @p reconnect returns when the connection drops, so after
+ * serial_client_stop() the caller closes network_fd (if >= 0) instead of
+ * the socket it passed to serial_client_init().
+ *
+ * @param client    Pointer to client session
+ * @param features  Granted XOE_WIRE_FEATURE_* bits
+ * @param reconnect Opens the replacement connections
+ * @param arg       Passed to @p reconnect
+ * @return 0 on success, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY, or a network
+ *         or protocol error from the handshake
+ */
+int serial_client_enable_resume(serial_client_t* client, uint32_t features,
+                                serial_client_reconnect_fn reconnect,
+                                void* arg);
+
 /**
  * @brief Start serial client I/O threads
  *
- * Spawns the serial→network and network→serial threads to begin
- * bidirectional data transfer. Returns immediately; threads run
+ * Spawns the serial→network, network→serial and TTY writer threads to
+ * begin bidirectional data transfer. Returns immediately; threads run
  * concurrently until shutdown.
  *
  * @param client Pointer to client session
@@ -81,8 +161,9 @@ int serial_client_start(serial_client_t* client);
 /**
  * @brief Stop serial client and wait for threads
  *
- * Sets the shutdown flag, closes resources, and waits for both I/O
- * threads to terminate. Blocks until all threads have exited.
+ * Sets the shutdown flag, shuts the network socket down to wake the
+ * receiver, and waits for all I/O threads to terminate. Blocks until all
+ * threads have exited.
  *
  * @param client Pointer to client session
  * @return 0 on success, negative error code on failure
@@ -0,0 +1,198 @@
+/**
+ * @file serial_config.c
+ * @brief Multi-device serial configuration
+ *
+ * Collects the ports named on the command line so one client process can
+ * bridge all of them (see serial_multi_client.h and serial_mux.h).
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_config.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initialize multi-device configuration
+ */
+serial_multi_config_t* serial_multi_config_init(int max_devices)
+{
+    serial_multi_config_t* multi_config;
+
+    if (max_devices <= 0 || max_devices > SERIAL_MULTI_MAX_DEVICES) {
+        return NULL;
+    }
+
+    multi_config = (serial_multi_config_t*)malloc(sizeof(serial_multi_config_t));
+    if (multi_config == NULL) {
+        return NULL;
+    }
+
+    multi_config->devices = (serial_config_t*)calloc((size_t)max_devices,
+                                                     sizeof(serial_config_t));
+    if (multi_config->devices == NULL) {
+        free(multi_config);
+        return NULL;
+    }
+
+    multi_config->device_count = 0;
+    multi_config->max_devices = max_devices;
+
+    return multi_config;
+}
+
+/**
+ * @brief Parse a delivery mode name
+ *
+ * @return SERIAL_DELIVERY_RELIABLE or _LATEST, E_INVALID_ARGUMENT
+ */
+static int parse_delivery(const char* text, size_t len)
+{
+    if (len == strlen("reliable") && strncmp(text, "reliable", len) == 0) {
+        return SERIAL_DELIVERY_RELIABLE;
+    }
+    if (len == strlen("latest") && strncmp(text, "latest", len) == 0) {
+        return SERIAL_DELIVERY_LATEST;
+    }
+    return E_INVALID_ARGUMENT;
+}
+
+/**
+ * @brief Parse one "path[@baud][#mode]" entry into a port configuration
+ */
+static int parse_device_spec(const char* spec, size_t len,
+                             serial_config_t* device)
+{
+    const char* mode_text;
+    const char* baud_text;
+    size_t path_len;
+    char* end;
+    long baud = 0;
+    int delivery = SERIAL_DELIVERY_DEFAULT;
+
+    mode_text = memchr(spec, SERIAL_SPEC_MODE_SEPARATOR, len);
+    if (mode_text != NULL) {
+        delivery = parse_delivery(mode_text + 1,
+                                  (size_t)(spec + len - mode_text - 1));
+        if (delivery < 0) {
+            return delivery;
+        }
+        len = (size_t)(mode_text - spec);
+    }
+
+    baud_text = memchr(spec, SERIAL_SPEC_BAUD_SEPARATOR, len);
+    path_len = (baud_text != NULL) ? (size_t)(baud_text - spec) : len;
+    if (path_len == 0 || path_len >= SERIAL_DEVICE_PATH_MAX) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (baud_text != NULL) {
+        baud_text++;
+        if (baud_text == spec + len) {
+            return E_INVALID_ARGUMENT;
+        }
+        baud = strtol(baud_text, &end, 10);
+        if (end != spec + len || serial_validate_baud((int)baud) != 0) {
+            return E_INVALID_ARGUMENT;
+        }
+    }
+
+    memset(device, 0, sizeof(*device));
+    memcpy(device->device_path, spec, path_len);
+    device->device_path[path_len] = '\0';
+    device->baud_rate = (int)baud;     /* 0 = shared baud rate */
+    device->delivery = delivery;
+    return 0;
+}
+
+/**
+ * @brief Add the ports named by a device spec
+ */
+int serial_multi_config_add_spec(serial_multi_config_t* multi_config,
+                                 const char* spec)
+{
+    const char* start;
+    const char* end;
+    size_t len;
+    int count;
+    int result;
+
+    if (multi_config == NULL || spec == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    count = multi_config->device_count;
+    start = spec;
+    for (;;) {
+        end = strchr(start, ',');
+        len = (end != NULL) ? (size_t)(end - start) : strlen(start);
+
+        if (count >= multi_config->max_devices) {
+            return E_BUFFER_TOO_SMALL;
+        }
+        result = parse_device_spec(start, len, &multi_config->devices[count]);
+        if (result != 0) {
+            return result;
+        }
+        count++;
+
+        if (end == NULL) {
+            break;
+        }
+        start = end + 1;
+    }
+
+    /* Commit only a fully valid spec */
+    multi_config->device_count = count;
+    return 0;
+}
+
+/**
+ * @brief Complete every port with the shared settings
+ */
+int serial_multi_config_resolve(serial_multi_config_t* multi_config,
+                                const serial_config_t* base)
+{
+    serial_config_t* device;
+    char path[SERIAL_DEVICE_PATH_MAX];
+    int baud_rate;
+    int delivery;
+    int i;
+
+    if (multi_config == NULL || base == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i < multi_config->device_count; i++) {
+        device = &multi_config->devices[i];
+        baud_rate = device->baud_rate;
+        delivery = device->delivery;
+        memcpy(path, device->device_path, sizeof(path));
+
+        memcpy(device, base, sizeof(*device));
+        memcpy(device->device_path, path, sizeof(path));
+        if (baud_rate != 0) {
+            device->baud_rate = baud_rate;
+        }
+        if (delivery != SERIAL_DELIVERY_DEFAULT) {
+            device->delivery = delivery;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Free multi-device configuration
+ */
+void serial_multi_config_free(serial_multi_config_t* multi_config)
+{
+    if (multi_config == NULL) {
+        return;
+    }
+
+    free(multi_config->devices);
+    free(multi_config);
+}
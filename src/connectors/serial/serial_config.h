@@ -14,6 +14,25 @@
 /* Maximum path length for device names */
 #define SERIAL_DEVICE_PATH_MAX 256
 
+/* Ports a single client process may bridge */
+#define SERIAL_MULTI_MAX_DEVICES 64
+
+/* Separates a device path from its baud rate in a device spec */
+#define SERIAL_SPEC_BAUD_SEPARATOR '@'
+
+/* Separates a device spec entry from its delivery mode ("#latest") */
+#define SERIAL_SPEC_MODE_SEPARATOR '#'
+
+/*
+ * Delivery over datagram transports (--udp, see serial_dgram.h): every
+ * frame in order, or only the newest. DEFAULT defers to the shared
+ * setting and resolves to RELIABLE. Stream connections always deliver
+ * every frame.
+ */
+#define SERIAL_DELIVERY_DEFAULT 0
+#define SERIAL_DELIVERY_RELIABLE 1
+#define SERIAL_DELIVERY_LATEST 2
+
 /* Default serial port settings */
 #define SERIAL_DEFAULT_BAUD 9600
 #define SERIAL_DEFAULT_DATA_BITS 8
@@ -22,10 +41,48 @@
 #define SERIAL_DEFAULT_FLOW SERIAL_FLOW_NONE
 #define SERIAL_DEFAULT_TIMEOUT_MS 100
 
+/* Serial→network frame coalescing (0 microseconds disables the window) */
+#define SERIAL_COALESCE_MAX_BYTES 1020      /* == SERIAL_MAX_PAYLOAD_SIZE */
+#define SERIAL_COALESCE_MAX_US 1000000
+#define SERIAL_DEFAULT_COALESCE_BYTES SERIAL_COALESCE_MAX_BYTES
+#define SERIAL_DEFAULT_COALESCE_US 2000
+
+/* Line is considered idle after this many character times without data */
+#define SERIAL_COALESCE_IDLE_CHARS 4
+#define SERIAL_COALESCE_MIN_IDLE_US 100
+
 /* Serial buffer sizes */
 #define SERIAL_READ_CHUNK_SIZE 256
+#define SERIAL_READ_CHUNK_MAX 4096
 #define SERIAL_WRITE_CHUNK_SIZE 256
 
+/*
+ * Read modes. FIXED re-arms the termios VTIME timer on every read and
+ * uses the SERIAL_COALESCE_IDLE_CHARS gap. ADAPTIVE programs termios once
+ * (VMIN = VTIME = 0, plus the low-latency flag where the driver has one),
+ * times reads with select() and derives the idle gap and read size from
+ * the baud rate. FRAME reads like ADAPTIVE but for gap-delimited device
+ * protocols (Modbus RTU): a burst ends only at a 3.5-character silence,
+ * however long the frame takes, and goes out as exactly one packet.
+ */
+#define SERIAL_READ_MODE_FIXED 0
+#define SERIAL_READ_MODE_ADAPTIVE 1
+#define SERIAL_READ_MODE_FRAME 2
+#define SERIAL_DEFAULT_READ_MODE SERIAL_READ_MODE_ADAPTIVE
+
+/* Adaptive mode: idle after 1.5 character times, reads sized for 50 ms */
+#define SERIAL_ADAPTIVE_IDLE_HALF_CHARS 3
+#define SERIAL_ADAPTIVE_MIN_IDLE_US 50
+#define SERIAL_ADAPTIVE_CHUNK_MS 50
+
+/*
+ * Frame mode: frames end after 3.5 character times of silence, or after
+ * 1750 us above 19200 baud, where Modbus RTU fixes the gap instead
+ */
+#define SERIAL_FRAME_GAP_HALF_CHARS 7
+#define SERIAL_FRAME_FIXED_GAP_ABOVE 19200
+#define SERIAL_FRAME_FIXED_GAP_US 1750
+
 /* Parity options */
 #define SERIAL_PARITY_NONE 0
 #define SERIAL_PARITY_ODD 1
@@ -51,13 +108,25 @@
 #define SERIAL_BAUD_57600 57600
 #define SERIAL_BAUD_115200 115200
 #define SERIAL_BAUD_230400 230400
+#define SERIAL_BAUD_460800 460800
+#define SERIAL_BAUD_921600 921600
+
+/* Range of rates accepted where any rate can be programmed (serial_baud.h) */
+#define SERIAL_BAUD_MIN 50
+#define SERIAL_BAUD_MAX 12000000
+
+/* Above this rate the driver is asked to skip its receive batching */
+#define SERIAL_BAUD_LOW_LATENCY_ABOVE 230400
 
 /**
- * @brief Validate baud rate against whitelist (FSM-002, SER-002 fix)
+ * @brief Validate baud rate (FSM-002, SER-002 fix)
  * @param baud_rate Baud rate to validate
  * @return 0 if valid, -1 if invalid
  *
- * Only standard baud rates are accepted: 9600, 19200, 38400, 57600, 115200, 230400
+ * Accepts every rate with a termios constant on this platform (up to
+ * 4000000 on Linux) and, where SERIAL_BAUD_CUSTOM is set (Linux, macOS),
+ * any rate from SERIAL_BAUD_MIN to SERIAL_BAUD_MAX, e.g. 250000 for DMX.
+ * Whether the adapter reaches the rate is only known when it is opened.
  */
 int serial_validate_baud(int baud_rate);
 
@@ -74,6 +143,10 @@ typedef struct {
     int parity;                                 /* Parity (NONE, ODD, EVEN) */
     int flow_control;                           /* Flow control (NONE, XONXOFF, RTSCTS) */
     int read_timeout_ms;                        /* Read timeout in milliseconds */
+    int coalesce_bytes;                         /* Max bytes packed per frame */
+    int coalesce_us;                            /* Max coalescing window (0 = off) */
+    int read_mode;                              /* Read mode (FIXED, ADAPTIVE) */
+    int delivery;                               /* Datagram delivery (SERIAL_DELIVERY_*) */
 } serial_config_t;
 
 /**
@@ -90,6 +163,63 @@ int serial_config_init_defaults(serial_config_t* config);
  */
 int serial_config_validate(const serial_config_t* config);
 
+/**
+ * @brief Multi-device configuration structure
+ *
+ * Ports bridged by one client process, in command-line order. Entries
+ * are added from device specs while arguments are parsed and completed
+ * with the shared settings by serial_multi_config_resolve().
+ */
+typedef struct {
+    serial_config_t* devices;   /* Array of port configurations */
+    int device_count;           /* Number of ports */
+    int max_devices;            /* Allocated array size */
+} serial_multi_config_t;
+
+/**
+ * @brief Initialize multi-device configuration
+ *
+ * @param max_devices Maximum number of ports (1 .. SERIAL_MULTI_MAX_DEVICES)
+ * @return Pointer to allocated structure, or NULL on failure
+ */
+serial_multi_config_t* serial_multi_config_init(int max_devices);
+
+/**
+ * @brief Add the ports named by a device spec
+ *
+ * A spec is a device path with an optional baud rate and delivery mode,
+ * "path[@baud][#reliable|#latest]", or a comma-separated list of them. A
+ * port without a baud rate or mode takes the shared one when resolved.
+ *
+ * @param multi_config Pointer to multi-device configuration
+ * @param spec         Device spec, e.g. "/dev/ttyS0@115200#latest,/dev/ttyS1"
+ * @return 0 on success, E_INVALID_ARGUMENT for an empty or overlong path,
+ *         an unsupported baud rate or an unknown delivery mode,
+ *         E_BUFFER_TOO_SMALL when full
+ *         (nothing is added on failure)
+ */
+int serial_multi_config_add_spec(serial_multi_config_t* multi_config,
+                                 const char* spec);
+
+/**
+ * @brief Complete every port with the shared settings
+ *
+ * Each port keeps its device path and its own baud rate and delivery
+ * mode, if its spec named them; everything else is copied from @p base.
+ *
+ * @param multi_config Pointer to multi-device configuration
+ * @param base         Settings from the command line (-b and friends)
+ * @return 0 on success, E_INVALID_ARGUMENT
+ */
+int serial_multi_config_resolve(serial_multi_config_t* multi_config,
+                                const serial_config_t* base);
+
+/**
+ * @brief Free multi-device configuration
+ * @param multi_config Pointer to multi-device configuration (NULL is ignored)
+ */
+void serial_multi_config_free(serial_multi_config_t* multi_config);
+
 /**
  * @brief Convert baud rate integer to termios speed constant
  * @param baud_rate Baud rate as integer (e.g., 9600)
@@ -0,0 +1,620 @@
+/**
+ * @file serial_dgram.c
+ * @brief Serial channel over a datagram association
+ *
+ * The reliable mode reuses serial_session_t for what it shares with
+ * resumable stream sessions: the stored frames, the cumulative ACK and
+ * both sequences. Its rx_next only advances when a frame is consumed, so
+ * the ACK never covers data still waiting for the TTY. Bitmaps (sacked,
+ * rx_present) are relative to tx_acked and rx_next and shift with them.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_dgram.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Bit for a window offset
+ */
+static uint64_t window_bit(int offset)
+{
+    return (uint64_t)1 << offset;
+}
+
+/**
+ * @brief Slot of a sequence in the per-sequence arrays
+ */
+static int slot(uint16_t sequence)
+{
+    return sequence % SERIAL_DGRAM_WINDOW;
+}
+
+/* ============================================================================
+ * Transmit
+ * ============================================================================ */
+
+/**
+ * @brief Build and transmit one frame
+ *
+ * Reliable frames carry the cumulative ACK, which settles any delayed
+ * ACK owed.
+ */
+static int transmit(serial_dgram_t* channel, const void* data, uint32_t len,
+                    uint16_t sequence, uint16_t flags, uint64_t now_ms)
+{
+    xoe_packet_t packet;
+    uint16_t ack = 0;
+    int result;
+
+    if (channel->mode == SERIAL_DGRAM_RELIABLE) {
+        ack = serial_session_take_ack(channel->session);
+        channel->ack_at_ms = 0;
+        flags |= SERIAL_FLAG_ACK;
+    }
+
+    result = serial_protocol_encapsulate_ack(data, len, sequence, ack, flags,
+                                             &packet);
+    if (result != 0) {
+        return result;
+    }
+
+    result = channel->send(channel->send_arg, &packet);
+    serial_protocol_free_payload(&packet);
+
+    channel->last_tx_ms = now_ms;
+    return result;
+}
+
+/**
+ * @brief Send a pure ACK, with a SACK bitmap when frames are buffered
+ */
+static int send_ack(serial_dgram_t* channel, uint64_t now_ms)
+{
+    unsigned char bitmap[SERIAL_DGRAM_SACK_SIZE];
+    int i;
+
+    if (channel->mode == SERIAL_DGRAM_LATEST) {
+        /* Keepalive only: nothing is acknowledged */
+        return transmit(channel, NULL, 0, channel->tx_sequence,
+                        SERIAL_FLAG_ACK, now_ms);
+    }
+
+    /* Bit i: frame rx_next + i, received but not yet delivered */
+    if (channel->rx_present == 0) {
+        return transmit(channel, NULL, 0, channel->session->tx_next, 0, now_ms);
+    }
+
+    for (i = 0; i < SERIAL_DGRAM_SACK_SIZE; i++) {
+        bitmap[i] = (unsigned char)(channel->rx_present >> (56 - 8 * i));
+    }
+    return transmit(channel, bitmap, sizeof(bitmap), channel->session->tx_next,
+                    SERIAL_FLAG_SACK, now_ms);
+}
+
+/**
+ * @brief Send an unacknowledged frame again
+ *
+ * @param index Window offset from tx_acked
+ */
+static int retransmit(serial_dgram_t* channel, int index, uint64_t now_ms)
+{
+    const serial_session_frame_t* frame;
+
+    frame = serial_session_frame(channel->session, index);
+    if (frame == NULL) {
+        return 0;
+    }
+
+    channel->sent_ms[slot(frame->sequence)] = now_ms;
+    channel->resent[slot(frame->sequence)] = TRUE;
+    channel->retransmits++;
+    metrics_add(METRIC_DGRAM_RETRANSMITS, 1);
+
+    return transmit(channel, frame->data, frame->len, frame->sequence,
+                    frame->flags, now_ms);
+}
+
+/* ============================================================================
+ * Acknowledgements (reliable)
+ * ============================================================================ */
+
+/**
+ * @brief Retransmit timeout from the round-trip estimate
+ */
+static uint32_t rto_from_estimate(const serial_dgram_t* channel)
+{
+    uint32_t rto = channel->srtt_ms + 4 * channel->rttvar_ms;
+
+    if (rto < SERIAL_DGRAM_RTO_MIN_MS) {
+        rto = SERIAL_DGRAM_RTO_MIN_MS;
+    }
+    if (rto > SERIAL_DGRAM_RTO_MAX_MS) {
+        rto = SERIAL_DGRAM_RTO_MAX_MS;
+    }
+    return rto;
+}
+
+/**
+ * @brief Fold one round-trip sample into the estimate (RFC 6298)
+ */
+static void rtt_sample(serial_dgram_t* channel, uint32_t rtt_ms)
+{
+    uint32_t delta;
+
+    if (channel->srtt_ms == 0) {
+        channel->srtt_ms = (rtt_ms > 0) ? rtt_ms : 1;
+        channel->rttvar_ms = rtt_ms / 2;
+    } else {
+        delta = (channel->srtt_ms > rtt_ms) ? channel->srtt_ms - rtt_ms
+                                            : rtt_ms - channel->srtt_ms;
+        channel->rttvar_ms = (3 * channel->rttvar_ms + delta) / 4;
+        channel->srtt_ms = (7 * channel->srtt_ms + rtt_ms) / 8;
+        if (channel->srtt_ms == 0) {
+            channel->srtt_ms = 1;
+        }
+    }
+}
+
+/**
+ * @brief Account for frames released by a cumulative ACK
+ */
+static void frames_acked(serial_dgram_t* channel, int released, uint64_t now_ms)
+{
+    uint16_t newest = (uint16_t)(channel->session->tx_acked - 1);
+
+    /* Karn: a retransmitted frame's ACK says nothing about the RTT */
+    if (!channel->resent[slot(newest)]) {
+        rtt_sample(channel, (uint32_t)(now_ms - channel->sent_ms[slot(newest)]));
+    }
+    if (channel->srtt_ms > 0) {
+        channel->rto_ms = rto_from_estimate(channel);
+    }
+
+    channel->sacked = (released >= 64) ? 0 : channel->sacked >> released;
+}
+
+/**
+ * @brief Record a SACK and resend the gaps below its highest frame
+ *
+ * @param bitmap Bit i: frame tx_acked + i received
+ */
+static int apply_sack(serial_dgram_t* channel, uint64_t bitmap, uint64_t now_ms)
+{
+    int unacked = serial_session_unacked(channel->session);
+    uint32_t min_age;
+    uint16_t sequence;
+    int highest;
+    int result;
+    int i;
+
+    if (unacked == 0) {
+        return 0;
+    }
+
+    if (unacked < 64) {
+        bitmap &= window_bit(unacked) - 1;
+    }
+    channel->sacked |= bitmap;
+    if (channel->sacked == 0) {
+        return 0;
+    }
+
+    highest = 63 - __builtin_clzll(channel->sacked);
+
+    /* Once per round trip: the SACKs after a resend still show the gap */
+    min_age = (channel->srtt_ms > 0) ? channel->srtt_ms : SERIAL_DGRAM_RTO_MIN_MS;
+
+    for (i = 0; i < highest; i++) {
+        if (channel->sacked & window_bit(i)) {
+            continue;
+        }
+        sequence = (uint16_t)(channel->session->tx_acked + i);
+        if (now_ms - channel->sent_ms[slot(sequence)] < min_age) {
+            continue;
+        }
+        result = retransmit(channel, i, now_ms);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * Receive
+ * ============================================================================ */
+
+/**
+ * @brief Buffer a reliable data frame and acknowledge what needs it
+ */
+static int input_reliable_data(serial_dgram_t* channel, uint16_t sequence,
+                               uint16_t flags, const unsigned char* data,
+                               uint32_t len, uint64_t now_ms)
+{
+    serial_session_frame_t* frame;
+    uint16_t ahead = (uint16_t)(sequence - channel->session->rx_next);
+
+    if (ahead >= 0x8000U) {
+        /* Already delivered: the ACK for it was lost */
+        channel->session->duplicates++;
+        return send_ack(channel, now_ms);
+    }
+    if (ahead >= SERIAL_DGRAM_WINDOW) {
+        channel->dropped++;
+        metrics_add(METRIC_DGRAM_DROPPED, 1);
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (channel->rx_present & window_bit(ahead)) {
+        channel->session->duplicates++;
+    } else {
+        frame = &channel->rx_frames[slot(sequence)];
+        frame->sequence = sequence;
+        frame->flags = (uint16_t)(flags & ~(SERIAL_FLAG_ACK | SERIAL_FLAG_SACK));
+        frame->len = (uint16_t)len;
+        memcpy(frame->data, data, len);
+        channel->rx_present |= window_bit(ahead);
+    }
+
+    /* Past a gap: tell the sender what is missing now */
+    if ((channel->rx_present & (window_bit(ahead) - 1)) !=
+        window_bit(ahead) - 1) {
+        return send_ack(channel, now_ms);
+    }
+    return 0;
+}
+
+/**
+ * @brief Process a frame on a reliable channel
+ */
+static int input_reliable(serial_dgram_t* channel, uint16_t flags,
+                          uint16_t sequence, uint16_t ack,
+                          const unsigned char* data, uint32_t len,
+                          uint64_t now_ms)
+{
+    uint64_t bitmap = 0;
+    int released;
+    int i;
+
+    if (!(flags & SERIAL_FLAG_ACK) || (flags & SERIAL_FLAG_RESUME)) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    released = serial_session_ack(channel->session, ack);
+    if (released < 0) {
+        return E_PROTOCOL_ERROR;
+    }
+    if (released > 0) {
+        frames_acked(channel, released, now_ms);
+    }
+
+    if (flags & SERIAL_FLAG_SACK) {
+        if (len != SERIAL_DGRAM_SACK_SIZE) {
+            return E_PROTOCOL_ERROR;
+        }
+        /* An ACK overtaken by a newer one has a stale bitmap */
+        if (ack != channel->session->tx_acked) {
+            return 0;
+        }
+        for (i = 0; i < SERIAL_DGRAM_SACK_SIZE; i++) {
+            bitmap = (bitmap << 8) | data[i];
+        }
+        return apply_sack(channel, bitmap, now_ms);
+    }
+
+    /* Pure ACK, keepalive, or flow control (not used on datagrams) */
+    if (len == 0) {
+        return 0;
+    }
+
+    return input_reliable_data(channel, sequence, flags, data, len, now_ms);
+}
+
+/**
+ * @brief Process a frame on a latest-value-wins channel
+ */
+static void input_latest(serial_dgram_t* channel, uint16_t flags,
+                         uint16_t sequence, const unsigned char* data,
+                         uint32_t len)
+{
+    serial_session_frame_t* frame = &channel->rx_frames[0];
+    uint16_t ahead = (uint16_t)(sequence - channel->rx_newest);
+
+    if (len == 0) {
+        return;                     /* Keepalive */
+    }
+
+    if (channel->rx_started && (ahead == 0 || ahead >= 0x8000U)) {
+        channel->dropped++;         /* Older than what we have */
+        metrics_add(METRIC_DGRAM_DROPPED, 1);
+        return;
+    }
+    if (channel->rx_ready) {
+        channel->dropped++;         /* Superseded before the TTY took it */
+        metrics_add(METRIC_DGRAM_DROPPED, 1);
+    }
+
+    channel->rx_newest = sequence;
+    channel->rx_started = TRUE;
+    frame->sequence = sequence;
+    frame->flags = (uint16_t)(flags & ~SERIAL_FLAG_ACK);
+    frame->len = (uint16_t)len;
+    memcpy(frame->data, data, len);
+    channel->rx_ready = TRUE;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+/**
+ * @brief Create a channel
+ */
+serial_dgram_t* serial_dgram_create(int mode, serial_dgram_send_fn send,
+                                    void* send_arg, uint64_t now_ms)
+{
+    serial_dgram_t* channel;
+    int frames;
+
+    if (send == NULL ||
+        (mode != SERIAL_DGRAM_RELIABLE && mode != SERIAL_DGRAM_LATEST)) {
+        return NULL;
+    }
+
+    channel = (serial_dgram_t*)calloc(1, sizeof(serial_dgram_t));
+    if (channel == NULL) {
+        return NULL;
+    }
+
+    frames = (mode == SERIAL_DGRAM_RELIABLE) ? SERIAL_DGRAM_WINDOW : 1;
+    channel->rx_frames = (serial_session_frame_t*)calloc((size_t)frames,
+                                                         sizeof(serial_session_frame_t));
+    if (mode == SERIAL_DGRAM_RELIABLE) {
+        channel->session = serial_session_create(0);
+    }
+    if (channel->rx_frames == NULL ||
+        (mode == SERIAL_DGRAM_RELIABLE && channel->session == NULL)) {
+        serial_dgram_destroy(channel);
+        return NULL;
+    }
+
+    channel->mode = mode;
+    channel->send = send;
+    channel->send_arg = send_arg;
+    channel->rto_ms = SERIAL_DGRAM_RTO_INITIAL_MS;
+    channel->last_tx_ms = now_ms;
+    channel->last_rx_ms = now_ms;
+    return channel;
+}
+
+/**
+ * @brief Free a channel
+ */
+void serial_dgram_destroy(serial_dgram_t* channel)
+{
+    if (channel == NULL) {
+        return;
+    }
+
+    serial_session_destroy(channel->session);
+    free(channel->rx_frames);
+    free(channel);
+}
+
+/**
+ * @brief Check whether serial_dgram_send() would take a data frame now
+ */
+int serial_dgram_can_send(const serial_dgram_t* channel)
+{
+    if (channel->mode == SERIAL_DGRAM_LATEST) {
+        return TRUE;
+    }
+    return !serial_session_window_full(channel->session);
+}
+
+/**
+ * @brief Send a data frame
+ */
+int serial_dgram_send(serial_dgram_t* channel, const void* data, uint32_t len,
+                      uint16_t flags, uint64_t now_ms)
+{
+    uint16_t sequence;
+    int result;
+
+    if (channel == NULL || data == NULL || len == 0 ||
+        len > SERIAL_MAX_PAYLOAD_SIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (channel->mode == SERIAL_DGRAM_LATEST) {
+        return transmit(channel, data, len, channel->tx_sequence++, flags,
+                        now_ms);
+    }
+
+    result = serial_session_store(channel->session, data, len, flags,
+                                  &sequence);
+    if (result != 0) {
+        return result;
+    }
+    channel->sent_ms[slot(sequence)] = now_ms;
+    channel->resent[slot(sequence)] = FALSE;
+
+    return transmit(channel, data, len, sequence, flags, now_ms);
+}
+
+/**
+ * @brief Process a serial packet received on the association
+ */
+int serial_dgram_input(serial_dgram_t* channel, const xoe_packet_t* packet,
+                       uint64_t now_ms)
+{
+    const unsigned char* data;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t sequence;
+    uint16_t ack;
+
+    if (channel == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (serial_protocol_peek(packet, &flags, &sequence, &ack, &data,
+                             &len) != 0 ||
+        len > SERIAL_MAX_PAYLOAD_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+    channel->last_rx_ms = now_ms;
+
+    if (channel->mode == SERIAL_DGRAM_LATEST) {
+        input_latest(channel, flags, sequence, data, len);
+        return 0;
+    }
+    return input_reliable(channel, flags, sequence, ack, data, len, now_ms);
+}
+
+/**
+ * @brief Next frame ready for delivery, if any
+ */
+int serial_dgram_peek(serial_dgram_t* channel, const unsigned char** data,
+                      uint32_t* len, uint16_t* flags)
+{
+    const serial_session_frame_t* frame;
+
+    if (channel->mode == SERIAL_DGRAM_LATEST) {
+        if (!channel->rx_ready) {
+            return FALSE;
+        }
+        frame = &channel->rx_frames[0];
+    } else {
+        if (!(channel->rx_present & 1)) {
+            return FALSE;
+        }
+        frame = &channel->rx_frames[slot(channel->session->rx_next)];
+    }
+
+    *data = frame->data;
+    *len = frame->len;
+    *flags = frame->flags;
+    return TRUE;
+}
+
+/**
+ * @brief Mark the frame from serial_dgram_peek() delivered
+ */
+int serial_dgram_consume(serial_dgram_t* channel, uint64_t now_ms)
+{
+    serial_session_t* session = channel->session;
+
+    if (channel->mode == SERIAL_DGRAM_LATEST) {
+        channel->rx_ready = FALSE;
+        return 0;
+    }
+    if (!(channel->rx_present & 1)) {
+        return 0;
+    }
+
+    channel->rx_present >>= 1;
+    session->rx_next++;
+    session->rx_unacked++;
+
+    if (serial_session_ack_due(session)) {
+        return send_ack(channel, now_ms);
+    }
+    if (channel->ack_at_ms == 0) {
+        channel->ack_at_ms = now_ms + SERIAL_DGRAM_ACK_DELAY_MS;
+    }
+    return 0;
+}
+
+/**
+ * @brief Run due retransmissions, delayed ACKs and keepalives
+ */
+int serial_dgram_tick(serial_dgram_t* channel, uint64_t now_ms)
+{
+    uint16_t sequence;
+    int expired = FALSE;
+    int unacked;
+    int result;
+    int i;
+
+    if (now_ms - channel->last_rx_ms >= SERIAL_DGRAM_PEER_TIMEOUT_MS) {
+        return E_TIMEOUT;
+    }
+
+    if (channel->mode == SERIAL_DGRAM_RELIABLE) {
+        unacked = serial_session_unacked(channel->session);
+        for (i = 0; i < unacked; i++) {
+            if (channel->sacked & window_bit(i)) {
+                continue;
+            }
+            sequence = (uint16_t)(channel->session->tx_acked + i);
+            if (now_ms - channel->sent_ms[slot(sequence)] < channel->rto_ms) {
+                continue;
+            }
+            result = retransmit(channel, i, now_ms);
+            if (result != 0) {
+                return result;
+            }
+            expired = TRUE;
+        }
+
+        /* Back off until an ACK brings a fresh estimate */
+        if (expired) {
+            channel->rto_ms *= 2;
+            if (channel->rto_ms > SERIAL_DGRAM_RTO_MAX_MS) {
+                channel->rto_ms = SERIAL_DGRAM_RTO_MAX_MS;
+            }
+        }
+
+        if (channel->ack_at_ms != 0 && now_ms >= channel->ack_at_ms) {
+            return send_ack(channel, now_ms);
+        }
+    }
+
+    if (now_ms - channel->last_tx_ms >= SERIAL_DGRAM_KEEPALIVE_MS) {
+        return send_ack(channel, now_ms);
+    }
+    return 0;
+}
+
+/**
+ * @brief Time until serial_dgram_tick() has work
+ */
+long serial_dgram_next_ms(const serial_dgram_t* channel, uint64_t now_ms)
+{
+    uint64_t due = channel->last_rx_ms + SERIAL_DGRAM_PEER_TIMEOUT_MS;
+    uint64_t at;
+    uint16_t sequence;
+    int unacked;
+    int i;
+
+    at = channel->last_tx_ms + SERIAL_DGRAM_KEEPALIVE_MS;
+    if (at < due) {
+        due = at;
+    }
+
+    if (channel->mode == SERIAL_DGRAM_RELIABLE) {
+        if (channel->ack_at_ms != 0 && channel->ack_at_ms < due) {
+            due = channel->ack_at_ms;
+        }
+        unacked = serial_session_unacked(channel->session);
+        for (i = 0; i < unacked; i++) {
+            if (channel->sacked & window_bit(i)) {
+                continue;
+            }
+            sequence = (uint16_t)(channel->session->tx_acked + i);
+            at = channel->sent_ms[slot(sequence)] + channel->rto_ms;
+            if (at < due) {
+                due = at;
+            }
+        }
+    }
+
+    return (due > now_ms) ? (long)(due - now_ms) : 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file serial_dgram.h
+ * @brief Serial channel over a datagram association
+ *
+ * Carries one serial port's frames over UDP or DTLS (see
+ * lib/protocol/wire_dgram.h) in one of two delivery modes, chosen per
+ * channel when the association is negotiated:
+ *
+ * SERIAL_DGRAM_RELIABLE (default): every data frame is delivered once
+ * and in order. Frames carry SERIAL_FLAG_ACK and a cumulative ACK as on
+ * resumable stream sessions (serial_session.h), and the sender keeps up
+ * to SERIAL_DGRAM_WINDOW unacknowledged frames. A frame that arrives
+ * ahead of a gap is buffered, and the receiver answers at once with a
+ * SACK: a pure ACK (SERIAL_FLAG_ACK | SERIAL_FLAG_SACK) whose 8 data
+ * bytes are a big-endian bitmap, bit i set when frame ACK + i is
+ * buffered; any ACK sent while frames are buffered carries one. The
+ * sender then retransmits only the missing frames below the highest
+ * one reported, so one lost datagram costs one resend
+ * instead of stalling everything behind it until a TCP timeout. Frames
+ * nobody reported are resent after a retransmit timeout derived from
+ * measured round trips (RFC 6298 style, doubled on each expiry). The
+ * cumulative ACK only moves once a frame was handed to the TTY, so a
+ * slow TTY holds the sender back through the window; no XON/XOFF needed.
+ *
+ * SERIAL_DGRAM_LATEST (XOE_WIRE_FEATURE_SERIAL_LATEST): nothing is
+ * acknowledged or retransmitted. The receiver keeps only the newest
+ * frame by sequence: an older or repeated one is dropped, and a newer
+ * one replaces a frame the TTY has not taken yet. Suits control loops
+ * that want the current setpoint, never a late one.
+ *
+ * Both modes send a pure ACK as keepalive after SERIAL_DGRAM_KEEPALIVE_MS
+ * without traffic, and report the peer gone after
+ * SERIAL_DGRAM_PEER_TIMEOUT_MS of silence.
+ *
+ * A channel is driven by its owner's poll loop: input() for each serial
+ * frame received, peek() / consume() to hand data on, tick() when
+ * next_ms() says so. It is not thread-safe.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERIAL_DGRAM_H
+#define SERIAL_DGRAM_H
+
+#include "connectors/serial/serial_protocol.h"
+#include "connectors/serial/serial_session.h"
+
+/* Delivery modes */
+#define SERIAL_DGRAM_RELIABLE 0
+#define SERIAL_DGRAM_LATEST   1
+
+/* Unacknowledged frames a reliable sender may have outstanding */
+#define SERIAL_DGRAM_WINDOW SERIAL_SESSION_WINDOW
+
+/* SACK payload: 64-bit bitmap */
+#define SERIAL_DGRAM_SACK_SIZE 8
+
+/* Retransmit timeout: before the first RTT sample, and its bounds */
+#define SERIAL_DGRAM_RTO_INITIAL_MS 200
+#define SERIAL_DGRAM_RTO_MIN_MS 20
+#define SERIAL_DGRAM_RTO_MAX_MS 2000
+
+/* A delivered frame is acknowledged within this time if no reply
+ * carries the ACK first */
+#define SERIAL_DGRAM_ACK_DELAY_MS 10
+
+/* Keepalive interval, and silence after which the peer counts as gone */
+#define SERIAL_DGRAM_KEEPALIVE_MS 2000
+#define SERIAL_DGRAM_PEER_TIMEOUT_MS 10000
+
+/**
+ * @brief Transmit one serial packet on the association
+ *
+ * @return 0 (also for a datagram the network dropped), negative error
+ *         code if the association is unusable
+ */
+typedef int (*serial_dgram_send_fn)(void* arg, const xoe_packet_t* packet);
+
+/**
+ * @brief Channel state (allocate with serial_dgram_create())
+ */
+typedef struct {
+    int mode;                       /* SERIAL_DGRAM_RELIABLE or _LATEST */
+    serial_dgram_send_fn send;
+    void* send_arg;
+
+    /* Reliable: stored frames and both sequences */
+    serial_session_t* session;
+    uint64_t sent_ms[SERIAL_DGRAM_WINDOW]; /* Last transmission, by sequence */
+    uint8_t resent[SERIAL_DGRAM_WINDOW];   /* Retransmitted: no RTT sample */
+    uint64_t sacked;                /* Bit i: tx_acked + i reported received */
+    uint32_t srtt_ms;               /* Smoothed round trip, 0 = no sample yet */
+    uint32_t rttvar_ms;
+    uint32_t rto_ms;                /* Current retransmit timeout */
+    uint64_t rx_present;            /* Bit i: frame rx_next + i buffered */
+    uint64_t ack_at_ms;             /* Delayed ACK due, 0 if none owed */
+
+    /* Received frames not yet delivered: by sequence (reliable), or the
+     * newest one in rx_frames[0] (latest) */
+    serial_session_frame_t* rx_frames;
+
+    /* Latest */
+    uint16_t tx_sequence;           /* Next sequence to send */
+    uint16_t rx_newest;             /* Newest sequence received */
+    int rx_started;                 /* rx_newest is valid */
+    int rx_ready;                   /* rx_frames[0] waits for delivery */
+
+    uint64_t last_tx_ms;
+    uint64_t last_rx_ms;
+    uint64_t retransmits;           /* Frames sent again */
+    uint64_t dropped;               /* Frames dropped on receipt */
+} serial_dgram_t;
+
+/**
+ * @brief Create a channel
+ *
+ * @param mode      SERIAL_DGRAM_RELIABLE or SERIAL_DGRAM_LATEST
+ * @param send      Transmit function of the association
+ * @param send_arg  Its argument
+ * @param now_ms    Current monotonic time (milliseconds)
+ * @return Channel, or NULL for a bad argument or out of memory
+ */
+serial_dgram_t* serial_dgram_create(int mode, serial_dgram_send_fn send,
+                                    void* send_arg, uint64_t now_ms);
+
+/**
+ * @brief Free a channel (NULL is ignored)
+ */
+void serial_dgram_destroy(serial_dgram_t* channel);
+
+/**
+ * @brief Check whether serial_dgram_send() would take a data frame now
+ *
+ * @return FALSE while a reliable channel's window is full
+ */
+int serial_dgram_can_send(const serial_dgram_t* channel);
+
+/**
+ * @brief Send a data frame
+ *
+ * @param channel   Channel
+ * @param data      Serial data
+ * @param len       Data length (1 to SERIAL_MAX_PAYLOAD_SIZE)
+ * @param flags     Line status flags (SERIAL_FLAG_*_ERROR)
+ * @param now_ms    Current time
+ * @return 0 on success, E_WOULD_BLOCK if the window is full,
+ *         E_INVALID_ARGUMENT, or the transmit function's error
+ */
+int serial_dgram_send(serial_dgram_t* channel, const void* data, uint32_t len,
+                      uint16_t flags, uint64_t now_ms);
+
+/**
+ * @brief Process a serial packet received on the association
+ *
+ * Applies ACKs and SACKs (retransmitting reported gaps), and buffers
+ * data for serial_dgram_peek().
+ *
+ * @param channel   Channel
+ * @param packet    XOE_PROTOCOL_SERIAL packet
+ * @param now_ms    Current time
+ * @return 0 on success, E_PROTOCOL_ERROR for a malformed frame or one
+ *         that does not fit the channel (drop it), or the transmit
+ *         function's error
+ */
+int serial_dgram_input(serial_dgram_t* channel, const xoe_packet_t* packet,
+                       uint64_t now_ms);
+
+/**
+ * @brief Next frame ready for delivery, if any
+ *
+ * @param channel   Channel
+ * @param data      Output: frame data (valid until consumed or input())
+ * @param len       Output: data length
+ * @param flags     Output: the frame's line status flags
+ * @return TRUE if a frame is ready
+ */
+int serial_dgram_peek(serial_dgram_t* channel, const unsigned char** data,
+                      uint32_t* len, uint16_t* flags);
+
+/**
+ * @brief Mark the frame from serial_dgram_peek() delivered
+ *
+ * @param channel   Channel
+ * @param now_ms    Current time
+ * @return 0, or the transmit function's error (an ACK may be sent)
+ */
+int serial_dgram_consume(serial_dgram_t* channel, uint64_t now_ms);
+
+/**
+ * @brief Run due retransmissions, delayed ACKs and keepalives
+ *
+ * @param channel   Channel
+ * @param now_ms    Current time
+ * @return 0, E_TIMEOUT once the peer was silent for
+ *         SERIAL_DGRAM_PEER_TIMEOUT_MS, or the transmit function's error
+ */
+int serial_dgram_tick(serial_dgram_t* channel, uint64_t now_ms);
+
+/**
+ * @brief Time until serial_dgram_tick() has work
+ *
+ * @return Milliseconds (0 = due now)
+ */
+long serial_dgram_next_ms(const serial_dgram_t* channel, uint64_t now_ms);
+
+#endif /* SERIAL_DGRAM_H */
@@ -0,0 +1,570 @@
+/**
+ * @file serial_hub.c
+ * @brief Serial routing hub: topics, write lease and per-member outboxes
+ *
+ * One mutex guards every topic and outbox; routing a frame only copies
+ * packet descriptors and takes payload references under it. Members with
+ * queued frames sit on a single ready list, which each owner searches for
+ * its own members; owners are few (one per event loop worker), so the
+ * list stays short.
+ *
+ * The cluster hooks have a lock of their own, held shared while the
+ * relay runs, so a frame is relayed without holding up the hub and the
+ * hooks are never cleared under a call in progress.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_hub.h"
+#include "connectors/serial/serial_protocol.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/protocol/payload_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct serial_hub_topic {
+    struct serial_hub_topic* next;      /* Topic list */
+    char name[SERIAL_HUB_TOPIC_MAX + 1];
+    serial_hub_member_t* members;       /* Every member, any role */
+    serial_hub_member_t* publisher;     /* NULL until one joins */
+    serial_hub_member_t* writer;        /* Write lease holder, or NULL */
+    uint64_t writer_at_ms;              /* Its last frame */
+} serial_hub_topic_t;
+
+struct serial_hub_member {
+    serial_hub_topic_t* topic;
+    serial_hub_member_t* next;          /* Topic member list */
+    serial_hub_member_t* ready_next;    /* Ready list */
+    int ready;                          /* On the ready list */
+    int role;
+    void* owner;
+    serial_hub_wake_fn wake;
+    void* user;
+    uint64_t dropped;
+    int head;                           /* Oldest queued frame */
+    int count;                          /* Frames queued */
+    xoe_packet_t outbox[SERIAL_HUB_OUTBOX_MAX];
+};
+
+static serial_hub_topic_t* g_topics = NULL;
+static serial_hub_member_t* g_ready = NULL;
+static pthread_mutex_t g_hub_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Cluster hooks: written under both locks, so either one reads them */
+static serial_hub_changed_fn g_changed = NULL;
+static serial_hub_relay_fn g_relay = NULL;
+static void* g_relay_ctx = NULL;
+static pthread_rwlock_t g_relay_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+/**
+ * @brief Find a topic by name (hub locked)
+ */
+static serial_hub_topic_t* hub_find_topic(const char* name)
+{
+    serial_hub_topic_t* topic;
+
+    for (topic = g_topics; topic != NULL; topic = topic->next) {
+        if (strcmp(topic->name, name) == 0) {
+            return topic;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Note a topic created or freed to the cluster (hub locked)
+ */
+static void hub_topics_changed(void)
+{
+    if (g_changed != NULL) {
+        g_changed(g_relay_ctx);
+    }
+}
+
+/**
+ * @brief Whether a writer other than @p from holds the lease (hub locked)
+ */
+static int hub_lease_held(const serial_hub_topic_t* topic,
+                          const serial_hub_member_t* from, uint64_t now)
+{
+    return topic->writer != NULL && topic->writer != from &&
+           now - topic->writer_at_ms < SERIAL_HUB_WRITE_LEASE_MS;
+}
+
+/**
+ * @brief Queue a frame for a member and wake its owner (hub locked)
+ *
+ * @param to Recipient
+ * @param packet Frame; its descriptor is copied
+ * @param shared Payload to hand out a reference to (pooled)
+ * @return TRUE if queued, FALSE if the outbox was full
+ */
+static int hub_queue(serial_hub_member_t* to, const xoe_packet_t* packet,
+                     xoe_payload_t* shared)
+{
+    xoe_packet_t* slot;
+
+    if (to->count == SERIAL_HUB_OUTBOX_MAX) {
+        to->dropped++;
+        return FALSE;
+    }
+
+    slot = &to->outbox[(to->head + to->count) % SERIAL_HUB_OUTBOX_MAX];
+    *slot = *packet;
+    slot->payload = xoe_payload_ref(shared);
+    to->count++;
+
+    if (!to->ready) {
+        to->ready = TRUE;
+        to->ready_next = g_ready;
+        g_ready = to;
+        to->wake(to->owner);
+    }
+    return TRUE;
+}
+
+/**
+ * @brief Join a topic, creating it on first use
+ */
+int serial_hub_join(const char* topic, int role, void* owner,
+                    serial_hub_wake_fn wake, void* user,
+                    serial_hub_member_t** member)
+{
+    serial_hub_topic_t* entry;
+    serial_hub_member_t* joined;
+    size_t len;
+
+    if (topic == NULL || wake == NULL || member == NULL ||
+        role < SERIAL_HUB_PUBLISHER || role > SERIAL_HUB_WRITER) {
+        return E_INVALID_ARGUMENT;
+    }
+    len = strlen(topic);
+    if (len == 0 || len > SERIAL_HUB_TOPIC_MAX) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    joined = (serial_hub_member_t*)calloc(1, sizeof(serial_hub_member_t));
+    if (joined == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    joined->role = role;
+    joined->owner = owner;
+    joined->wake = wake;
+    joined->user = user;
+
+    pthread_mutex_lock(&g_hub_lock);
+
+    entry = hub_find_topic(topic);
+    if (entry == NULL) {
+        entry = (serial_hub_topic_t*)calloc(1, sizeof(serial_hub_topic_t));
+        if (entry == NULL) {
+            pthread_mutex_unlock(&g_hub_lock);
+            free(joined);
+            return E_OUT_OF_MEMORY;
+        }
+        memcpy(entry->name, topic, len + 1);
+        entry->next = g_topics;
+        g_topics = entry;
+        hub_topics_changed();
+    } else if (role == SERIAL_HUB_PUBLISHER && entry->publisher != NULL) {
+        pthread_mutex_unlock(&g_hub_lock);
+        free(joined);
+        return E_DEVICE_BUSY;
+    }
+
+    if (role == SERIAL_HUB_PUBLISHER) {
+        entry->publisher = joined;
+    }
+    joined->topic = entry;
+    joined->next = entry->members;
+    entry->members = joined;
+
+    pthread_mutex_unlock(&g_hub_lock);
+
+    *member = joined;
+    return 0;
+}
+
+/**
+ * @brief Leave the topic and free the membership
+ */
+void serial_hub_leave(serial_hub_member_t* member)
+{
+    serial_hub_topic_t* topic;
+    serial_hub_member_t** link;
+    serial_hub_topic_t** topic_link;
+    int i;
+
+    if (member == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_hub_lock);
+
+    topic = member->topic;
+    for (link = &topic->members; *link != NULL; link = &(*link)->next) {
+        if (*link == member) {
+            *link = member->next;
+            break;
+        }
+    }
+    if (topic->publisher == member) {
+        topic->publisher = NULL;
+    }
+    if (topic->writer == member) {
+        topic->writer = NULL;
+    }
+
+    if (member->ready) {
+        for (link = &g_ready; *link != NULL; link = &(*link)->ready_next) {
+            if (*link == member) {
+                *link = member->ready_next;
+                break;
+            }
+        }
+    }
+
+    if (topic->members == NULL) {
+        for (topic_link = &g_topics; *topic_link != NULL;
+             topic_link = &(*topic_link)->next) {
+            if (*topic_link == topic) {
+                *topic_link = topic->next;
+                break;
+            }
+        }
+        free(topic);
+        hub_topics_changed();
+    }
+
+    pthread_mutex_unlock(&g_hub_lock);
+
+    for (i = 0; i < member->count; i++) {
+        xoe_payload_release(
+            member->outbox[(member->head + i) % SERIAL_HUB_OUTBOX_MAX].payload);
+    }
+    free(member);
+}
+
+/**
+ * @brief Route a frame received from a member
+ */
+int serial_hub_route(serial_hub_member_t* from, const xoe_packet_t* packet)
+{
+    serial_hub_topic_t* topic;
+    serial_hub_member_t* to;
+    xoe_payload_t* shared;
+    char name[SERIAL_HUB_TOPIC_MAX + 1];
+    int relay = FALSE;
+    int relayed;
+    uint64_t now;
+    int queued = 0;
+
+    if (from == NULL || packet == NULL || packet->payload == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Held while queueing; a payload from outside the pool is copied
+     * here once, not per recipient */
+    shared = xoe_payload_ref(packet->payload);
+    if (shared == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_hub_lock);
+    topic = from->topic;
+
+    if (from->role == SERIAL_HUB_PUBLISHER) {
+        for (to = topic->members; to != NULL; to = to->next) {
+            if (to != from && hub_queue(to, packet, shared)) {
+                queued++;
+            }
+        }
+        relay = TRUE;
+    } else if (from->role == SERIAL_HUB_WRITER) {
+        now = latency_now_ms();
+        if (hub_lease_held(topic, from, now)) {
+            from->dropped++;
+        } else {
+            topic->writer = from;
+            topic->writer_at_ms = now;
+            if (topic->publisher == NULL) {
+                /* The publisher may be on another node */
+                relay = TRUE;
+            } else if (hub_queue(topic->publisher, packet, shared)) {
+                queued++;
+            }
+        }
+    } else {
+        from->dropped++;
+    }
+
+    if (relay) {
+        memcpy(name, topic->name, sizeof(name));
+    }
+    pthread_mutex_unlock(&g_hub_lock);
+
+    xoe_payload_release(shared);
+
+    if (relay) {
+        relayed = 0;
+        pthread_rwlock_rdlock(&g_relay_lock);
+        if (g_relay != NULL) {
+            relayed = g_relay(g_relay_ctx, name, from->role, packet);
+        }
+        pthread_rwlock_unlock(&g_relay_lock);
+
+        if (from->role == SERIAL_HUB_WRITER && relayed == 0) {
+            pthread_mutex_lock(&g_hub_lock);
+            from->dropped++;
+            pthread_mutex_unlock(&g_hub_lock);
+        }
+    }
+    return queued;
+}
+
+/**
+ * @brief Route a frame another node relayed
+ */
+int serial_hub_deliver(const char* topic, int role, const xoe_packet_t* packet)
+{
+    serial_hub_topic_t* entry;
+    serial_hub_member_t* to;
+    xoe_payload_t* shared;
+    int queued = 0;
+
+    if (topic == NULL || packet == NULL || packet->payload == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    shared = xoe_payload_ref(packet->payload);
+    if (shared == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&g_hub_lock);
+    entry = hub_find_topic(topic);
+
+    if (entry != NULL && role == SERIAL_HUB_PUBLISHER) {
+        for (to = entry->members; to != NULL; to = to->next) {
+            if (to != entry->publisher && hub_queue(to, packet, shared)) {
+                queued++;
+            }
+        }
+    } else if (entry != NULL && role == SERIAL_HUB_WRITER &&
+               entry->publisher != NULL &&
+               !hub_lease_held(entry, NULL, latency_now_ms())) {
+        if (hub_queue(entry->publisher, packet, shared)) {
+            queued++;
+        }
+    }
+
+    pthread_mutex_unlock(&g_hub_lock);
+
+    xoe_payload_release(shared);
+    return queued;
+}
+
+/**
+ * @brief Set the cluster hooks
+ */
+void serial_hub_set_relay(serial_hub_changed_fn changed,
+                          serial_hub_relay_fn relay, void* ctx)
+{
+    /* Exclusive: waits out every relay in progress */
+    pthread_rwlock_wrlock(&g_relay_lock);
+    pthread_mutex_lock(&g_hub_lock);
+    g_changed = changed;
+    g_relay = relay;
+    g_relay_ctx = ctx;
+    pthread_mutex_unlock(&g_hub_lock);
+    pthread_rwlock_unlock(&g_relay_lock);
+}
+
+/**
+ * @brief List the topics with members on this node
+ */
+int serial_hub_topic_names(char (*names)[SERIAL_HUB_TOPIC_MAX + 1], int max)
+{
+    serial_hub_topic_t* topic;
+    int count = 0;
+
+    if (names == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_hub_lock);
+    for (topic = g_topics; topic != NULL && count < max; topic = topic->next) {
+        memcpy(names[count++], topic->name, sizeof(topic->name));
+    }
+    pthread_mutex_unlock(&g_hub_lock);
+
+    return count;
+}
+
+/**
+ * @brief Next member of @p owner with queued frames
+ */
+serial_hub_member_t* serial_hub_next_ready(void* owner)
+{
+    serial_hub_member_t** link;
+    serial_hub_member_t* member = NULL;
+
+    pthread_mutex_lock(&g_hub_lock);
+    for (link = &g_ready; *link != NULL; link = &(*link)->ready_next) {
+        if ((*link)->owner == owner) {
+            member = *link;
+            *link = member->ready_next;
+            member->ready_next = NULL;
+            member->ready = FALSE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_hub_lock);
+
+    return member;
+}
+
+/**
+ * @brief Take the oldest frame queued for a member
+ */
+int serial_hub_take(serial_hub_member_t* member, xoe_packet_t* packet)
+{
+    int taken = 0;
+
+    if (member == NULL || packet == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_hub_lock);
+    if (member->count > 0) {
+        *packet = member->outbox[member->head];
+        member->head = (member->head + 1) % SERIAL_HUB_OUTBOX_MAX;
+        member->count--;
+        taken = 1;
+    }
+    pthread_mutex_unlock(&g_hub_lock);
+
+    return taken;
+}
+
+/**
+ * @brief The user pointer given to serial_hub_join()
+ */
+void* serial_hub_member_user(const serial_hub_member_t* member)
+{
+    return (member != NULL) ? member->user : NULL;
+}
+
+/**
+ * @brief Frames dropped for or from a member
+ */
+uint64_t serial_hub_member_dropped(const serial_hub_member_t* member)
+{
+    uint64_t dropped;
+
+    if (member == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_hub_lock);
+    dropped = member->dropped;
+    pthread_mutex_unlock(&g_hub_lock);
+
+    return dropped;
+}
+
+/**
+ * @brief Build a join frame: role (1) + topic name
+ */
+int serial_hub_join_frame(const char* topic, int role, xoe_packet_t* packet)
+{
+    unsigned char payload[1 + SERIAL_HUB_TOPIC_MAX];
+    size_t len;
+
+    if (topic == NULL || packet == NULL ||
+        role < SERIAL_HUB_PUBLISHER || role > SERIAL_HUB_WRITER) {
+        return E_INVALID_ARGUMENT;
+    }
+    len = strlen(topic);
+    if (len == 0 || len > SERIAL_HUB_TOPIC_MAX) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    payload[0] = (unsigned char)role;
+    memcpy(payload + 1, topic, len);
+    return serial_protocol_encapsulate(payload, (uint32_t)(1 + len), 0,
+                                       SERIAL_FLAG_HUB, packet);
+}
+
+/**
+ * @brief Parse a join frame's data
+ */
+int serial_hub_join_parse(const unsigned char* data, uint32_t len,
+                          char* topic, int* role)
+{
+    if (data == NULL || topic == NULL || role == NULL ||
+        len < 2 || len - 1 > SERIAL_HUB_TOPIC_MAX ||
+        data[0] < SERIAL_HUB_PUBLISHER || data[0] > SERIAL_HUB_WRITER ||
+        memchr(data + 1, '\0', len - 1) != NULL) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    memcpy(topic, data + 1, len - 1);
+    topic[len - 1] = '\0';
+    *role = data[0];
+    return 0;
+}
+
+/**
+ * @brief Build the answer to a join frame: status (1)
+ */
+int serial_hub_status_frame(int status, xoe_packet_t* packet)
+{
+    unsigned char payload = (unsigned char)status;
+
+    return serial_protocol_encapsulate(&payload, 1, 0, SERIAL_FLAG_HUB,
+                                       packet);
+}
+
+/**
+ * @brief Read the status from the server's answer
+ */
+int serial_hub_status_parse(const xoe_packet_t* packet)
+{
+    const unsigned char* data;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t sequence;
+    uint16_t ack;
+
+    if (serial_protocol_peek(packet, &flags, &sequence, &ack, &data,
+                             &len) != 0 ||
+        !(flags & SERIAL_FLAG_HUB) || len != 1 ||
+        data[0] > SERIAL_HUB_REFUSED) {
+        return E_PROTOCOL_ERROR;
+    }
+    return data[0];
+}
+
+/**
+ * @brief Parse a role name
+ */
+int serial_hub_parse_role(const char* name)
+{
+    if (name == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (strcmp(name, "pub") == 0) {
+        return SERIAL_HUB_PUBLISHER;
+    }
+    if (strcmp(name, "sub") == 0) {
+        return SERIAL_HUB_SUBSCRIBER;
+    }
+    if (strcmp(name, "write") == 0) {
+        return SERIAL_HUB_WRITER;
+    }
+    return E_INVALID_ARGUMENT;
+}
@@ -0,0 +1,259 @@
+/**
+ * @file serial_hub.h
+ * @brief Serial routing hub: one port published to many clients (server)
+ *
+ * Without the hub the server echoes every serial frame back to its
+ * sender. A client that opens with a SERIAL_FLAG_HUB control frame joins
+ * a named topic instead, as one of:
+ *
+ * - PUBLISHER: the bridge holding the port. Its frames go to every other
+ *   member of the topic. One per topic.
+ * - SUBSCRIBER: receives the publisher's frames; what it sends is dropped.
+ * - WRITER: receives like a subscriber, and its frames go to the
+ *   publisher while it holds the topic's write lease. The first writer to
+ *   send takes the lease and keeps it until it leaves or has sent nothing
+ *   for SERIAL_HUB_WRITE_LEASE_MS; frames from the other writers are
+ *   dropped meanwhile, so two consoles never interleave keystrokes.
+ *
+ * Frames are routed unchanged: the hub shares the received payload with
+ * every recipient through xoe_payload_ref() rather than copying it, so
+ * the payload must not be modified afterwards. Each recipient has an
+ * outbox of up to SERIAL_HUB_OUTBOX_MAX frames, because its connection
+ * may belong to another event loop worker; the hub only queues and calls
+ * the member's wake function, and the owning thread takes the frames
+ * with serial_hub_next_ready() and serial_hub_take() and sends them
+ * itself. A full outbox drops new frames for that member alone, so a
+ * slow subscriber never stalls the publisher.
+ *
+ * Hub frames carry no session ACKs, so members do not negotiate
+ * XOE_WIRE_FEATURE_SERIAL_RESUME. Every function is thread-safe.
+ *
+ * In a cluster (core/cluster.h) a topic spans the nodes that have
+ * members of it. The publisher's frames are also handed to the relay,
+ * and so are a writer's when no publisher is on this node; frames from
+ * other nodes come back through serial_hub_deliver(). The publisher and
+ * the write lease stay per node: every node may have one publisher of a
+ * topic, and a local writer holding the lease shuts remote writers out.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERIAL_HUB_H
+#define SERIAL_HUB_H
+
+#include "lib/common/types.h"
+#include "lib/protocol/protocol.h"
+
+/* Longest topic name, in bytes */
+#define SERIAL_HUB_TOPIC_MAX 64
+
+/* Frames queued for one member before new ones are dropped */
+#define SERIAL_HUB_OUTBOX_MAX 256
+
+/* A writer idle this long loses the write lease */
+#define SERIAL_HUB_WRITE_LEASE_MS 1000
+
+/* Roles (first byte of a join frame) */
+#define SERIAL_HUB_PUBLISHER  1
+#define SERIAL_HUB_SUBSCRIBER 2
+#define SERIAL_HUB_WRITER     3
+
+/* Join status (the server's answer) */
+#define SERIAL_HUB_JOINED  0    /* Member of the topic */
+#define SERIAL_HUB_TAKEN   1    /* The topic already has a publisher */
+#define SERIAL_HUB_REFUSED 2    /* Not allowed on this connection */
+
+/**
+ * @brief Wake the thread that owns a member's connection
+ *
+ * Called with the hub locked when a member's outbox stops being empty;
+ * must not call back into the hub.
+ *
+ * @param owner The owner given to serial_hub_join()
+ */
+typedef void (*serial_hub_wake_fn)(void* owner);
+
+/**
+ * @brief Note that a topic was created or went away
+ *
+ * Called with the hub locked; must not call back into the hub
+ * (serial_hub_topic_names() reads the set later).
+ */
+typedef void (*serial_hub_changed_fn)(void* ctx);
+
+/**
+ * @brief Pass a member's frame on to other nodes
+ *
+ * Called without the hub lock, from the thread that routed the frame.
+ *
+ * @param ctx Context given to serial_hub_set_relay()
+ * @param topic Topic the frame was sent on
+ * @param role Sender's role (SERIAL_HUB_PUBLISHER or SERIAL_HUB_WRITER)
+ * @param packet Frame (payload owned by the caller)
+ * @return Nodes it was sent to
+ */
+typedef int (*serial_hub_relay_fn)(void* ctx, const char* topic, int role,
+                                   const xoe_packet_t* packet);
+
+/* Opaque topic membership */
+typedef struct serial_hub_member serial_hub_member_t;
+
+/**
+ * @brief Join a topic, creating it on first use
+ *
+ * @param topic Topic name (1 to SERIAL_HUB_TOPIC_MAX bytes, NUL-terminated)
+ * @param role SERIAL_HUB_PUBLISHER, SERIAL_HUB_SUBSCRIBER or SERIAL_HUB_WRITER
+ * @param owner Thread that sends to this member (passed to @p wake)
+ * @param wake Wake function for @p owner
+ * @param user Caller's pointer, returned by serial_hub_member_user()
+ * @param member Output: membership
+ * @return 0 on success, E_INVALID_ARGUMENT for a bad name or role,
+ *         E_DEVICE_BUSY if the topic has a publisher already,
+ *         E_OUT_OF_MEMORY
+ */
+int serial_hub_join(const char* topic, int role, void* owner,
+                    serial_hub_wake_fn wake, void* user,
+                    serial_hub_member_t** member);
+
+/**
+ * @brief Leave the topic and free the membership
+ *
+ * Frames still queued for the member are released. The topic goes away
+ * with its last member. Called by the owner, which must not use
+ * @p member afterwards.
+ *
+ * @param member Membership (NULL is ignored)
+ */
+void serial_hub_leave(serial_hub_member_t* member);
+
+/**
+ * @brief Route a frame received from a member
+ *
+ * The publisher's frames are queued for every other member, an active
+ * writer's for the publisher; anything else is dropped. The payload is
+ * shared, not copied.
+ *
+ * @param from Sending member
+ * @param packet XOE_PROTOCOL_SERIAL frame (payload still owned by the caller)
+ * @return Members it was queued for (0 when dropped), E_INVALID_ARGUMENT,
+ *         E_OUT_OF_MEMORY
+ */
+int serial_hub_route(serial_hub_member_t* from, const xoe_packet_t* packet);
+
+/**
+ * @brief Route a frame another node relayed
+ *
+ * A publisher's frame is queued for every member but the local
+ * publisher; a writer's for the local publisher, unless a local writer
+ * holds the lease. Never relayed again.
+ *
+ * @param topic Topic name
+ * @param role Sender's role on its node
+ * @param packet XOE_PROTOCOL_SERIAL frame (payload still owned by the caller)
+ * @return Members it was queued for (0 when dropped or the topic has no
+ *         members here), E_INVALID_ARGUMENT, E_OUT_OF_MEMORY
+ */
+int serial_hub_deliver(const char* topic, int role, const xoe_packet_t* packet);
+
+/**
+ * @brief Set the cluster hooks
+ *
+ * Returns once no call to the previous relay is in progress, so its
+ * context can be freed after clearing the hooks.
+ *
+ * @param changed Topic set change note (NULL for none)
+ * @param relay Frame relay (NULL for none)
+ * @param ctx Passed to both
+ */
+void serial_hub_set_relay(serial_hub_changed_fn changed,
+                          serial_hub_relay_fn relay, void* ctx);
+
+/**
+ * @brief List the topics with members on this node
+ *
+ * @param names Output: NUL-terminated names
+ * @param max Capacity of @p names
+ * @return Number of names stored (at most @p max)
+ */
+int serial_hub_topic_names(char (*names)[SERIAL_HUB_TOPIC_MAX + 1], int max);
+
+/**
+ * @brief Next member of @p owner with queued frames
+ *
+ * Takes the member off the ready list; it is put back, and @p owner woken
+ * again, when more frames arrive.
+ *
+ * @param owner Owner given to serial_hub_join()
+ * @return Member, or NULL if none of @p owner's members has frames
+ */
+serial_hub_member_t* serial_hub_next_ready(void* owner);
+
+/**
+ * @brief Take the oldest frame queued for a member
+ *
+ * @param member Membership
+ * @param packet Output: frame holding one payload reference (release with
+ *               xoe_wire_free_payload() once sent)
+ * @return 1 if a frame was taken, 0 if the outbox is empty
+ */
+int serial_hub_take(serial_hub_member_t* member, xoe_packet_t* packet);
+
+/**
+ * @brief The user pointer given to serial_hub_join()
+ */
+void* serial_hub_member_user(const serial_hub_member_t* member);
+
+/**
+ * @brief Frames dropped for or from a member (full outbox, no lease,
+ *        subscriber writes)
+ */
+uint64_t serial_hub_member_dropped(const serial_hub_member_t* member);
+
+/**
+ * @brief Build a join frame (client)
+ *
+ * @param topic Topic name (1 to SERIAL_HUB_TOPIC_MAX bytes)
+ * @param role SERIAL_HUB_PUBLISHER, SERIAL_HUB_SUBSCRIBER or SERIAL_HUB_WRITER
+ * @param packet Output packet (free with serial_protocol_free_payload())
+ * @return 0 on success, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY
+ */
+int serial_hub_join_frame(const char* topic, int role, xoe_packet_t* packet);
+
+/**
+ * @brief Parse a join frame's data (server)
+ *
+ * @param data Frame data (after the serial header)
+ * @param len Data length
+ * @param topic Output: NUL-terminated name (SERIAL_HUB_TOPIC_MAX + 1 bytes)
+ * @param role Output: role
+ * @return 0 on success, E_PROTOCOL_ERROR if malformed
+ */
+int serial_hub_join_parse(const unsigned char* data, uint32_t len,
+                          char* topic, int* role);
+
+/**
+ * @brief Build the answer to a join frame (server)
+ *
+ * @param status SERIAL_HUB_JOINED, SERIAL_HUB_TAKEN or SERIAL_HUB_REFUSED
+ * @param packet Output packet (free with serial_protocol_free_payload())
+ * @return 0 on success, negative error code on failure
+ */
+int serial_hub_status_frame(int status, xoe_packet_t* packet);
+
+/**
+ * @brief Read the status from the server's answer (client)
+ *
+ * @param packet Received packet
+ * @return SERIAL_HUB_JOINED, SERIAL_HUB_TAKEN or SERIAL_HUB_REFUSED, or
+ *         E_PROTOCOL_ERROR if @p packet is not an answer
+ */
+int serial_hub_status_parse(const xoe_packet_t* packet);
+
+/**
+ * @brief Parse a role name ("pub", "sub" or "write")
+ *
+ * @return SERIAL_HUB_* role, or E_INVALID_ARGUMENT
+ */
+int serial_hub_parse_role(const char* name);
+
+#endif /* SERIAL_HUB_H */
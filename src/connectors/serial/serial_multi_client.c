@@ -0,0 +1,911 @@
+/**
+ * @file serial_multi_client.c
+ * @brief Many serial ports bridged by one poll loop
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_multi_client.h"
+#include "connectors/serial/serial_port.h"
+#include "connectors/serial/serial_buffer.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/net/shm_link.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_l2.h"
+#include "lib/security/tls_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+#if TLS_ENABLED
+#include <openssl/ssl.h>
+#include "lib/security/tls_session.h"
+#endif
+
+/* ============================================================================
+ * Port Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Close a port's descriptors and take it out of the loop
+ */
+static void port_close(serial_multi_client_t* client, serial_multi_port_t* port)
+{
+    if (port->active) {
+        port->active = FALSE;
+        client->active_count--;
+    }
+
+#if TLS_ENABLED
+    if (port->tls != NULL) {
+        tls_session_shutdown((SSL*)port->tls);
+        tls_session_destroy((SSL*)port->tls);
+    }
+#endif
+    port->tls = NULL;
+
+    serial_dgram_destroy(port->dgram);
+    port->dgram = NULL;
+
+    if (port->network_fd >= 0) {
+        shm_link_close(port->network_fd);
+        port->network_fd = -1;
+    }
+    if (port->serial_fd >= 0) {
+        serial_port_close(port->serial_fd);
+        port->serial_fd = -1;
+    }
+}
+
+/**
+ * @brief Log why a port stopped and close it
+ */
+static void port_fail(serial_multi_client_t* client, serial_multi_port_t* port,
+                      const char* what, int result)
+{
+    LOG_ERROR("%s on %s: error code %d; port closed",
+              what, port->config.device_path, result);
+    port_close(client, port);
+}
+
+/**
+ * @brief Encapsulate and send one serial frame on a port's connection
+ */
+static int port_send_frame(serial_multi_port_t* port, const unsigned char* data,
+                           uint32_t len, uint16_t flags)
+{
+    xoe_packet_t packet;
+    int result;
+
+    if (port->dgram != NULL) {
+        return serial_dgram_send(port->dgram, data, len, flags,
+                                 latency_now_ms());
+    }
+
+    result = serial_protocol_encapsulate(data, len, port->tx_sequence, flags,
+                                         &packet);
+    if (result != 0) {
+        return result;
+    }
+    port->tx_sequence++;
+
+    result = xoe_wire_send_compressed(&port->compress, &port->transport,
+                                      port->features, &packet);
+
+    serial_protocol_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Send the coalesced TTY bytes, if any
+ */
+static int port_flush_pending(serial_multi_port_t* port)
+{
+    int result;
+
+    if (port->pending_len == 0) {
+        return 0;
+    }
+    if (port->dgram != NULL && !serial_dgram_can_send(port->dgram)) {
+        return 0;   /* Window full: kept until ACKs make room */
+    }
+
+    result = port_send_frame(port, port->pending, (uint32_t)port->pending_len, 0);
+    if (result == 0) {
+        latency_record_since(LATENCY_SERIAL_TO_NET, port->last_ns);
+    }
+    port->pending_len = 0;
+    return result;
+}
+
+/**
+ * @brief Nanoseconds until the pending bytes are due (< 0: nothing pending)
+ */
+static int64_t port_flush_due_ns(const serial_multi_port_t* port, uint64_t now)
+{
+    uint64_t idle_due;
+    uint64_t window_due;
+    uint64_t due;
+
+    if (port->pending_len == 0 ||
+        (port->dgram != NULL && !serial_dgram_can_send(port->dgram))) {
+        return -1;
+    }
+
+    idle_due = port->last_ns + (uint64_t)port->idle_us * 1000;
+    window_due = port->first_ns + (uint64_t)port->window_us * 1000;
+    due = (idle_due < window_due) ? idle_due : window_due;
+
+    return (due > now) ? (int64_t)(due - now) : 0;
+}
+
+/**
+ * @brief Move received datagram frames into the TTY queue while they fit
+ *
+ * @return 0, or the channel's transmit error (consuming may send an ACK)
+ */
+static int port_deliver_dgram(serial_multi_port_t* port)
+{
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    const unsigned char* data;
+    uint32_t offset;
+    uint32_t len;
+    uint16_t flags;
+    int span_count;
+    int result;
+    int i;
+
+    while (serial_dgram_peek(port->dgram, &data, &len, &flags)) {
+        if (serial_ring_reserve(&port->tty_queue, len, spans,
+                                &span_count) < len) {
+            break;  /* Left in the channel until the TTY catches up */
+        }
+        for (i = 0, offset = 0; i < span_count && offset < len; i++) {
+            memcpy(spans[i].iov_base, data + offset, spans[i].iov_len);
+            offset += (uint32_t)spans[i].iov_len;
+        }
+        serial_ring_commit(&port->tty_queue, len);
+
+        if (flags & (SERIAL_FLAG_PARITY_ERROR | SERIAL_FLAG_FRAMING_ERROR |
+                     SERIAL_FLAG_OVERRUN_ERROR)) {
+            metrics_add(METRIC_SERIAL_LINE_ERRORS, 1);
+            LOG_WARN("Line error flags 0x%04x on %s",
+                     flags, port->config.device_path);
+        }
+
+        result = serial_dgram_consume(port->dgram, latency_now_ms());
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Send XOFF or XON when the TTY queue crosses a watermark
+ *
+ * A datagram channel refills the queue instead: its window does the
+ * flow control.
+ */
+static int port_update_flow(serial_multi_port_t* port)
+{
+    uint32_t queued = serial_ring_available(&port->tty_queue);
+    unsigned char none = 0;
+
+    if (port->dgram != NULL) {
+        return port_deliver_dgram(port);
+    }
+
+    if (!port->xoff_sent && queued >= port->high_watermark) {
+        port->xoff_sent = TRUE;
+        return port_send_frame(port, &none, 0, SERIAL_FLAG_XOFF);
+    }
+    if (port->xoff_sent && queued <= port->low_watermark) {
+        port->xoff_sent = FALSE;
+        return port_send_frame(port, &none, 0, SERIAL_FLAG_XON);
+    }
+    return 0;
+}
+
+/**
+ * @brief Read what the TTY has and send full or due frames
+ *
+ * @return 0, or a negative error code if the TTY or the connection failed
+ */
+static int port_read_tty(serial_multi_port_t* port)
+{
+    uint64_t now;
+    ssize_t n;
+    int total = 0;
+    int result;
+
+    while (total < SERIAL_READ_CHUNK_MAX) {
+        n = read(port->serial_fd, port->pending + port->pending_len,
+                 (size_t)(port->frame_limit - port->pending_len));
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            return E_IO_ERROR;
+        }
+        if (n == 0) {
+            break;  /* VMIN = VTIME = 0: nothing more queued */
+        }
+
+        now = latency_now_ns();
+        if (port->pending_len == 0) {
+            port->first_ns = now;
+        }
+        port->last_ns = now;
+        port->pending_len += (int)n;
+        total += (int)n;
+        metrics_add(METRIC_SERIAL_RX_BYTES, (uint64_t)n);
+
+        if (port->pending_len == port->frame_limit) {
+            result = port_flush_pending(port);
+            if (result != 0) {
+                return result;
+            }
+        }
+    }
+
+    /* No coalescing window: send what this wakeup produced */
+    if (port->window_us == 0) {
+        return port_flush_pending(port);
+    }
+    return 0;
+}
+
+/**
+ * @brief Write as much of the TTY queue as the TTY takes without blocking
+ */
+static int port_write_tty(serial_multi_port_t* port)
+{
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count;
+    uint32_t queued;
+    ssize_t n;
+
+    for (;;) {
+        queued = serial_ring_peek(&port->tty_queue, SERIAL_MULTI_TTY_QUEUE_SIZE,
+                                  spans, &span_count);
+        if (queued == 0) {
+            break;
+        }
+
+        n = writev(port->serial_fd, spans, span_count);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                break;
+            }
+            return E_IO_ERROR;
+        }
+
+        serial_ring_consume(&port->tty_queue, (uint32_t)n);
+        metrics_add(METRIC_SERIAL_TX_BYTES, (uint64_t)n);
+        if ((uint32_t)n < queued) {
+            break;  /* TTY full; POLLOUT resumes */
+        }
+    }
+
+    return port_update_flow(port);
+}
+
+/**
+ * @brief Queue one received frame's data for the TTY
+ */
+static void port_handle_frame(serial_multi_port_t* port, xoe_packet_t* packet)
+{
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count = 0;
+    uint32_t frame_len;
+    uint32_t actual_len;
+    uint16_t sequence;
+    uint16_t flags;
+    int result;
+
+    if (packet->protocol_id != XOE_PROTOCOL_SERIAL) {
+        LOG_WARN("Ignoring protocol %u frame on %s", packet->protocol_id,
+                 port->config.device_path);
+        return;
+    }
+
+    /* Wire CRC already verified; stamp the serial protocol checksum */
+    packet->checksum = serial_protocol_checksum(packet);
+
+    frame_len = (packet->payload != NULL &&
+                 packet->payload->len > SERIAL_HEADER_SIZE)
+                ? packet->payload->len - SERIAL_HEADER_SIZE : 0;
+    if (frame_len > 0 &&
+        serial_ring_reserve(&port->tty_queue, frame_len, spans,
+                            &span_count) < frame_len) {
+        /* The peer kept sending after XOFF */
+        LOG_WARN("TTY queue full on %s: dropped %u bytes",
+                 port->config.device_path, frame_len);
+        return;
+    }
+
+    result = serial_protocol_decapsulate_iov(packet, spans, span_count,
+                                             &actual_len, &sequence, &flags);
+    if (result != 0) {
+        LOG_WARN("Packet decapsulation failed on %s: error code %d",
+                 port->config.device_path, result);
+        return;
+    }
+
+    if (flags & (SERIAL_FLAG_PARITY_ERROR | SERIAL_FLAG_FRAMING_ERROR |
+                 SERIAL_FLAG_OVERRUN_ERROR)) {
+        metrics_add(METRIC_SERIAL_LINE_ERRORS, 1);
+        LOG_WARN("Line error flags 0x%04x on %s seq=%u",
+                 flags, port->config.device_path, sequence);
+    }
+    if (flags & (SERIAL_FLAG_XOFF | SERIAL_FLAG_XON)) {
+        port->peer_paused = (flags & SERIAL_FLAG_XOFF) != 0;
+    }
+
+    if (actual_len > 0) {
+        serial_ring_commit(&port->tty_queue, actual_len);
+    }
+}
+
+/**
+ * @brief Feed one received wire frame to a port's datagram channel
+ *
+ * @return 0 (undecodable frames are dropped), or a negative error code
+ *         once the association is unusable
+ */
+static int port_dgram_input(serial_multi_port_t* port, const uint8_t* datagram,
+                            uint32_t len)
+{
+    xoe_packet_t packet;
+    int result;
+
+    if (xoe_wire_dgram_decode(datagram, len, port->features, &packet) != 0) {
+        return 0;
+    }
+    /* Anything else is a late HELLO_ACK */
+    result = 0;
+    if (packet.protocol_id == XOE_PROTOCOL_SERIAL) {
+        result = serial_dgram_input(port->dgram, &packet, latency_now_ms());
+    }
+    xoe_wire_free_payload(&packet);
+    return (result == E_PROTOCOL_ERROR) ? 0 : result;
+}
+
+/**
+ * @brief Read every queued datagram and feed its frame to the channel
+ *
+ * @return 0, or a negative error code once the association is unusable
+ */
+static int port_read_dgram(serial_multi_port_t* port)
+{
+    uint8_t datagram[XOE_WIRE_DGRAM_MAX];
+    int result;
+
+    for (;;) {
+        result = xoe_wire_dgram_recv(port->network_fd, port->tls, datagram,
+                                     sizeof(datagram));
+        if (result == E_WOULD_BLOCK) {
+            break;
+        }
+        if (result == E_NETWORK_ERROR || result == E_PROTOCOL_ERROR) {
+            continue;   /* ICMP error or oversized: the peer timeout decides */
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_IO_ERROR : result;
+        }
+
+        result = port_dgram_input(port, datagram, (uint32_t)result);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    result = port_deliver_dgram(port);
+    if (result != 0) {
+        return result;
+    }
+    return port_write_tty(port);
+}
+
+/**
+ * @brief Read from the connection and queue every completed frame
+ *
+ * @return 0, or a negative error code once the connection is unusable
+ */
+static int port_read_network(serial_multi_port_t* port)
+{
+    xoe_packet_t packet;
+    int result;
+
+    if (port->dgram != NULL) {
+        return port_read_dgram(port);
+    }
+
+    do {
+        result = xoe_wire_decoder_recv_transport(&port->decoder,
+                                                 &port->transport);
+        if (result == E_WOULD_BLOCK) {
+            break;
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_IO_ERROR : result;
+        }
+
+        while ((result = xoe_wire_decoder_next(&port->decoder, &packet)) == 1) {
+            result = xoe_wire_decompress_packet(&port->compress, &packet);
+            if (result == 0) {
+                port_handle_frame(port, &packet);
+            }
+            xoe_wire_free_payload(&packet);
+            if (result != 0) {
+                return result;
+            }
+        }
+        if (result < 0) {
+            return result;
+        }
+    } while (xoe_transport_pending(&port->transport));
+
+    /* Hand the new data to the TTY right away */
+    return port_write_tty(port);
+}
+
+/**
+ * @brief Hand every frame waiting in the link's ring to its port
+ *
+ * Frames go to the port whose association they carry, if they come from
+ * its server; each port that received any then moves data to its TTY.
+ */
+static void read_link(serial_multi_client_t* client)
+{
+    serial_multi_port_t* port = NULL;
+    l2_ring_frame_t frame;
+    const uint8_t* datagram;
+    uint32_t association;
+    uint32_t len;
+    uint16_t flags;
+    int result;
+    int i;
+
+    while (l2_ring_recv(client->link, &frame)) {
+        if (xoe_wire_l2_parse(frame.data, frame.len, &association, &flags,
+                              &datagram, &len) != 0 ||
+            !(flags & XOE_WIRE_L2_FROM_SERVER)) {
+            continue;
+        }
+        for (i = 0; i < client->port_count; i++) {
+            port = &client->ports[i];
+            if (port->active && port->link != NULL &&
+                port->association == association &&
+                memcmp(port->peer_mac, frame.src, L2_RING_MAC_LEN) == 0) {
+                break;
+            }
+        }
+        if (i == client->port_count) {
+            continue;
+        }
+
+        result = port_dgram_input(port, datagram, len);
+        if (result != 0) {
+            port_fail(client, port, "Network connection closed", result);
+            continue;
+        }
+        port->link_rx = TRUE;
+    }
+
+    for (i = 0; i < client->port_count; i++) {
+        port = &client->ports[i];
+        if (!port->link_rx) {
+            continue;
+        }
+        port->link_rx = FALSE;
+        if (!port->active) {
+            continue;
+        }
+        result = port_deliver_dgram(port);
+        if (result == 0) {
+            result = port_write_tty(port);
+        }
+        if (result != 0) {
+            port_fail(client, port, "Serial write failed", result);
+        }
+    }
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+serial_multi_client_t* serial_multi_client_init(const serial_config_t* configs,
+                                                int count)
+{
+    serial_multi_client_t* client;
+    serial_multi_port_t* port;
+    int i;
+
+    if (configs == NULL || count < 1 || count > SERIAL_MULTI_MAX_DEVICES) {
+        return NULL;
+    }
+
+    client = (serial_multi_client_t*)calloc(1, sizeof(serial_multi_client_t));
+    if (client == NULL) {
+        return NULL;
+    }
+    client->ports = (serial_multi_port_t*)calloc((size_t)count,
+                                                 sizeof(serial_multi_port_t));
+    client->fds = (struct pollfd*)calloc((size_t)count * 2 + 1,
+                                         sizeof(struct pollfd));
+    if (client->ports == NULL || client->fds == NULL) {
+        free(client->ports);
+        free(client->fds);
+        free(client);
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        port = &client->ports[i];
+        memcpy(&port->config, &configs[i], sizeof(serial_config_t));
+        port->network_fd = -1;
+        port->serial_fd = -1;
+
+        port->frame_limit = port->config.coalesce_bytes;
+        if (port->frame_limit <= 0 ||
+            port->frame_limit > SERIAL_MAX_PAYLOAD_SIZE) {
+            port->frame_limit = SERIAL_MAX_PAYLOAD_SIZE;
+        }
+        port->idle_us = serial_config_idle_gap_us(&port->config);
+        port->window_us = serial_config_burst_window_us(&port->config);
+
+        if (serial_ring_init(&port->tty_queue,
+                             SERIAL_MULTI_TTY_QUEUE_SIZE) != 0) {
+            break;
+        }
+        port->high_watermark = SERIAL_MULTI_TTY_QUEUE_SIZE / 100 *
+                               SERIAL_BUFFER_HIGH_WATERMARK_PCT;
+        port->low_watermark = SERIAL_MULTI_TTY_QUEUE_SIZE / 100 *
+                              SERIAL_BUFFER_LOW_WATERMARK_PCT;
+
+        if (serial_port_open(&port->config, &port->serial_fd) != 0 ||
+            fd_set_nonblocking(port->serial_fd) != 0) {
+            LOG_ERROR("Cannot open serial port %s", port->config.device_path);
+            serial_ring_destroy(&port->tty_queue);
+            if (port->serial_fd >= 0) {
+                serial_port_close(port->serial_fd);
+            }
+            break;
+        }
+        client->port_count++;
+    }
+
+    if (client->port_count < count) {
+        serial_multi_client_cleanup(&client);
+        return NULL;
+    }
+    return client;
+}
+
+int serial_multi_client_attach(serial_multi_client_t* client, int index,
+                               int network_fd, void* tls, uint32_t features)
+{
+    serial_multi_port_t* port;
+    int result;
+
+    if (client == NULL || index < 0 || index >= client->port_count ||
+        network_fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    port = &client->ports[index];
+    if (port->network_fd >= 0) {
+        return E_INVALID_STATE;
+    }
+
+    result = (tls != NULL) ? xoe_transport_init_tls(&port->transport, tls)
+                           : xoe_transport_init_fd(&port->transport, network_fd);
+    if (result != 0) {
+        return result;
+    }
+    result = xoe_wire_compress_init(&port->compress, features);
+    if (result != 0) {
+        return result;
+    }
+    if (xoe_wire_decoder_init(&port->decoder, 0) != 0) {
+        xoe_wire_compress_cleanup(&port->compress);
+        return E_OUT_OF_MEMORY;
+    }
+    port->network_fd = network_fd;
+    port->tls = tls;
+    port->features = features;
+    port->active = TRUE;
+    client->active_count++;
+
+    if (fd_set_nonblocking(network_fd) != 0) {
+        port_close(client, port);
+        return E_NETWORK_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * @brief Transmit function of a port's datagram channel
+ */
+static int port_dgram_send(void* arg, const xoe_packet_t* packet)
+{
+    serial_multi_port_t* port = (serial_multi_port_t*)arg;
+
+    return xoe_wire_dgram_send(port->network_fd, port->tls, NULL, 0,
+                               port->features, packet);
+}
+
+int serial_multi_client_attach_dgram(serial_multi_client_t* client, int index,
+                                     int network_fd, void* tls,
+                                     uint32_t features)
+{
+    serial_multi_port_t* port;
+    int mode;
+
+    if (client == NULL || index < 0 || index >= client->port_count ||
+        network_fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    port = &client->ports[index];
+    if (port->network_fd >= 0) {
+        return E_INVALID_STATE;
+    }
+
+    mode = (features & XOE_WIRE_FEATURE_SERIAL_LATEST) ? SERIAL_DGRAM_LATEST
+                                                       : SERIAL_DGRAM_RELIABLE;
+    port->dgram = serial_dgram_create(mode, port_dgram_send, port,
+                                      latency_now_ms());
+    if (port->dgram == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    port->network_fd = network_fd;
+    port->tls = tls;
+    port->features = features;
+    port->active = TRUE;
+    client->active_count++;
+
+    if (fd_set_nonblocking(network_fd) != 0) {
+        port_close(client, port);
+        return E_NETWORK_ERROR;
+    }
+    return 0;
+}
+
+int serial_multi_client_set_link(serial_multi_client_t* client,
+                                 l2_ring_t* ring)
+{
+    if (client == NULL || ring == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (client->link != NULL) {
+        return E_INVALID_STATE;
+    }
+    client->link = ring;
+    return 0;
+}
+
+/**
+ * @brief Transmit function of a port's layer-2 channel
+ *
+ * Frames wait in the ring until the loop flushes it.
+ */
+static int port_l2_send(void* arg, const xoe_packet_t* packet)
+{
+    serial_multi_port_t* port = (serial_multi_port_t*)arg;
+
+    return xoe_wire_l2_send(port->link, port->peer_mac, port->association, 0,
+                            port->features, packet);
+}
+
+int serial_multi_client_attach_l2(serial_multi_client_t* client, int index,
+                                  const uint8_t* server_mac,
+                                  uint32_t association, uint32_t features)
+{
+    serial_multi_port_t* port;
+    int mode;
+
+    if (client == NULL || index < 0 || index >= client->port_count ||
+        server_mac == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    port = &client->ports[index];
+    if (client->link == NULL || port->network_fd >= 0 || port->link != NULL) {
+        return E_INVALID_STATE;
+    }
+
+    mode = (features & XOE_WIRE_FEATURE_SERIAL_LATEST) ? SERIAL_DGRAM_LATEST
+                                                       : SERIAL_DGRAM_RELIABLE;
+    memcpy(port->peer_mac, server_mac, L2_RING_MAC_LEN);
+    port->association = association;
+    port->features = features;
+    port->link = client->link;
+    port->dgram = serial_dgram_create(mode, port_l2_send, port,
+                                      latency_now_ms());
+    if (port->dgram == NULL) {
+        port->link = NULL;
+        return E_OUT_OF_MEMORY;
+    }
+    port->active = TRUE;
+    client->active_count++;
+    return 0;
+}
+
+int serial_multi_client_run(serial_multi_client_t* client)
+{
+    serial_multi_port_t* port;
+    struct pollfd* tty_fd;
+    struct pollfd* net_fd;
+    int64_t due_ns;
+    int64_t wait_ns;
+    uint64_t now;
+    int timeout_ms;
+    int result;
+    int ready;
+    int i;
+
+    if (client == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    while (!client->shutdown_flag && client->active_count > 0) {
+        /* One poll set for every TTY and socket */
+        now = latency_now_ns();
+        wait_ns = (int64_t)SERIAL_MULTI_POLL_MS * 1000000;
+        for (i = 0; i < client->port_count; i++) {
+            port = &client->ports[i];
+            tty_fd = &client->fds[2 * i];
+            net_fd = &client->fds[2 * i + 1];
+
+            if (!port->active) {
+                tty_fd->fd = -1;
+                net_fd->fd = -1;
+                continue;
+            }
+
+            tty_fd->fd = port->serial_fd;
+            tty_fd->events = 0;
+            if (!port->peer_paused &&
+                (port->dgram == NULL || serial_dgram_can_send(port->dgram))) {
+                tty_fd->events |= POLLIN;
+            }
+            if (serial_ring_available(&port->tty_queue) > 0) {
+                tty_fd->events |= POLLOUT;
+            }
+            net_fd->fd = port->network_fd;
+            net_fd->events = POLLIN;
+
+            due_ns = port_flush_due_ns(port, now);
+            if (due_ns >= 0 && due_ns < wait_ns) {
+                wait_ns = due_ns;
+            }
+            if (port->dgram != NULL) {
+                due_ns = (int64_t)serial_dgram_next_ms(port->dgram,
+                                                       now / 1000000) * 1000000;
+                if (due_ns < wait_ns) {
+                    wait_ns = due_ns;
+                }
+            }
+        }
+
+        client->fds[2 * client->port_count].fd =
+            (client->link != NULL) ? l2_ring_fd(client->link) : -1;
+        client->fds[2 * client->port_count].events = POLLIN;
+
+        /* Round up so a due flush is never polled for 0 ms repeatedly */
+        timeout_ms = (int)((wait_ns + 999999) / 1000000);
+        ready = poll(client->fds, (nfds_t)client->port_count * 2 + 1,
+                     timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            LOG_ERROR("poll failed: errno=%d: %s", errno, strerror(errno));
+            return E_IO_ERROR;
+        }
+
+        if (ready > 0 && client->fds[2 * client->port_count].revents != 0) {
+            read_link(client);
+        }
+
+        for (i = 0; i < client->port_count; i++) {
+            port = &client->ports[i];
+            if (!port->active) {
+                continue;
+            }
+            tty_fd = &client->fds[2 * i];
+            net_fd = &client->fds[2 * i + 1];
+            result = 0;
+
+            if (ready > 0 && (net_fd->revents & (POLLIN | POLLHUP | POLLERR))) {
+                result = port_read_network(port);
+                if (result != 0) {
+                    port_fail(client, port, "Network connection closed", result);
+                    continue;
+                }
+            }
+            if (ready > 0 && (tty_fd->revents & (POLLHUP | POLLERR | POLLNVAL))) {
+                port_fail(client, port, "Serial port hung up", E_IO_ERROR);
+                continue;
+            }
+            if (ready > 0 && (tty_fd->revents & POLLOUT)) {
+                result = port_write_tty(port);
+                if (result != 0) {
+                    port_fail(client, port, "Serial write failed", result);
+                    continue;
+                }
+            }
+            if (ready > 0 && (tty_fd->revents & POLLIN)) {
+                result = port_read_tty(port);
+                if (result != 0) {
+                    port_fail(client, port, "Serial read failed", result);
+                    continue;
+                }
+            }
+
+            if (port_flush_due_ns(port, latency_now_ns()) == 0) {
+                result = port_flush_pending(port);
+                if (result != 0) {
+                    port_fail(client, port, "Network write failed", result);
+                    continue;
+                }
+            }
+
+            if (port->dgram != NULL) {
+                result = serial_dgram_tick(port->dgram, latency_now_ms());
+                if (result != 0) {
+                    port_fail(client, port, (result == E_TIMEOUT)
+                              ? "Server stopped answering"
+                              : "Network write failed", result);
+                }
+            }
+        }
+
+        /* Everything the ports queued on the link leaves together */
+        if (client->link != NULL && l2_ring_flush(client->link) != 0) {
+            LOG_WARN("Layer-2 send failed: errno=%d: %s", errno,
+                     strerror(errno));
+        }
+    }
+
+    return client->shutdown_flag ? 0 : E_IO_ERROR;
+}
+
+void serial_multi_client_request_shutdown(serial_multi_client_t* client)
+{
+    if (client != NULL) {
+        client->shutdown_flag = 1;
+    }
+}
+
+void serial_multi_client_cleanup(serial_multi_client_t** client)
+{
+    serial_multi_port_t* port;
+    int i;
+
+    if (client == NULL || *client == NULL) {
+        return;
+    }
+
+    for (i = 0; i < (*client)->port_count; i++) {
+        port = &(*client)->ports[i];
+        port_close(*client, port);
+        if (port->decoder.buffer != NULL) {
+            xoe_wire_decoder_cleanup(&port->decoder);
+        }
+        xoe_wire_compress_cleanup(&port->compress);
+        serial_ring_destroy(&port->tty_queue);
+    }
+
+    l2_ring_close((*client)->link);
+    free((*client)->fds);
+    free((*client)->ports);
+    free(*client);
+    *client = NULL;
+}
@@ -0,0 +1,223 @@
+/**
+ * @file serial_multi_client.h
+ * @brief Many serial ports bridged by one poll loop
+ *
+ * Bridges every port of a serial_multi_config_t, each over its own
+ * network connection (plain or TLS), from a single thread: one poll set
+ * holds all TTYs and all sockets. Compared with one serial_client per
+ * port (three threads each) or one process per port, a box serving
+ * dozens of ports keeps a single TLS context, a single management
+ * server and one set of process-wide statistics.
+ *
+ * Per port the loop:
+ * - reads whatever the TTY has, coalesces it for up to coalesce_us (or
+ *   until the line has been idle for the port's idle gap, or a frame is
+ *   full) and sends it as one serial frame
+ * - decodes frames from the socket incrementally and queues their data
+ *   for the TTY, writing as much as the TTY accepts without blocking
+ * - sends XOFF when the TTY queue passes its high watermark and XON once
+ *   it drains to the low one, and stops reading the TTY while the peer
+ *   has sent XOFF (same flags as serial_client)
+ *
+ * Network sends use the xoe_wire send functions, which wait a bounded
+ * time (XOE_WIRE_SEND_TIMEOUT_MS) for a full socket, as the server event
+ * loop does. A port whose TTY or connection fails is closed on its own;
+ * the loop ends once no port is left or shutdown is requested. Each
+ * connection negotiates frame compression separately, so every port
+ * keeps its own stream history (see lib/protocol/wire_compress.h).
+ *
+ * A port can instead be attached to a UDP or DTLS association
+ * (serial_multi_client_attach_dgram()). Its frames then go through a
+ * serial_dgram_t channel: no XON/XOFF, since a reliable channel's window
+ * holds the peer back until the TTY took the data, and the TTY is not
+ * read while the own window is full. Received frames move from the
+ * channel to the TTY queue as room appears.
+ *
+ * Datagram ports may also run over a layer-2 link instead
+ * (serial_multi_client_set_link(), serial_multi_client_attach_l2()):
+ * every such port shares the session's one AF_PACKET ring, received
+ * frames are handed to ports by association, and the ring is flushed
+ * once per loop iteration, so a round of sends over all ports costs one
+ * system call.
+ *
+ * The TTY read mode setting does not apply: reads are driven by poll().
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERIAL_MULTI_CLIENT_H
+#define SERIAL_MULTI_CLIENT_H
+
+#include <signal.h>
+#include <poll.h>
+
+#include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_dgram.h"
+#include "connectors/serial/serial_protocol.h"
+#include "connectors/serial/serial_ring.h"
+#include "lib/net/l2_ring.h"
+#include "lib/protocol/wire_compress.h"
+#include "lib/protocol/wire_format.h"
+
+/* Bytes queued per port for its TTY */
+#define SERIAL_MULTI_TTY_QUEUE_SIZE 16384
+
+/* Longest poll() wait, so a shutdown request is noticed (ms) */
+#define SERIAL_MULTI_POLL_MS 250
+
+/*
+ * Connection pacing: by default the server admits a burst of 20
+ * connections per address, then one per 500 ms (CONN_RATE_LIMIT_MAX,
+ * --conn-rate on the server). Ports beyond the burst connect at that
+ * pace instead of being refused.
+ */
+#define SERIAL_MULTI_CONNECT_BURST 20
+#define SERIAL_MULTI_CONNECT_INTERVAL_MS 500
+
+/**
+ * @brief State of one bridged port
+ */
+typedef struct {
+    serial_config_t config;
+    int serial_fd;                /* Non-blocking TTY, -1 once closed */
+    int network_fd;               /* Non-blocking socket, -1 until attached */
+    void* tls;                    /* SSL*, NULL for plain TCP or UDP */
+    xoe_transport_t transport;    /* Stream I/O, bound at attach */
+    serial_dgram_t* dgram;        /* Datagram channel, NULL on a stream */
+    l2_ring_t* link;              /* Session ring the channel runs over,
+                                     NULL unless on layer 2 */
+    uint8_t peer_mac[L2_RING_MAC_LEN];
+    uint32_t association;
+    int link_rx;                  /* Link frames arrived this round */
+    uint32_t features;            /* Negotiated XOE_WIRE_FEATURE_* bits */
+    xoe_wire_compress_t compress; /* Frame compression, if negotiated */
+    int active;                   /* Attached and not failed */
+
+    /* Network → serial */
+    xoe_wire_decoder_t decoder;
+    serial_ring_t tty_queue;
+    uint32_t high_watermark;
+    uint32_t low_watermark;
+    int xoff_sent;                /* We asked the peer to pause */
+
+    /* Serial → network */
+    unsigned char pending[SERIAL_MAX_PAYLOAD_SIZE];
+    int pending_len;              /* Bytes waiting to be framed */
+    int frame_limit;              /* Flush at this many bytes */
+    int idle_us;                  /* Flush after this much line silence */
+    int window_us;                /* ...or this long after pending[0] */
+    uint64_t first_ns;            /* When pending[0] was read */
+    uint64_t last_ns;             /* When the last byte was read */
+    int peer_paused;              /* Peer sent XOFF */
+    uint16_t tx_sequence;
+} serial_multi_port_t;
+
+/**
+ * @brief Multi-port client session
+ */
+typedef struct {
+    serial_multi_port_t* ports;
+    int port_count;
+    int active_count;
+    struct pollfd* fds;           /* Two entries per port (TTY, socket),
+                                     then the link */
+    l2_ring_t* link;              /* Layer-2 ring, or NULL */
+    volatile sig_atomic_t shutdown_flag;
+} serial_multi_client_t;
+
+/**
+ * @brief Open all TTYs
+ *
+ * @param configs   One resolved configuration per port
+ * @param count     Number of ports (1 .. SERIAL_MULTI_MAX_DEVICES)
+ * @return Session, or NULL if an argument is invalid, a port cannot be
+ *         opened or memory runs out
+ */
+serial_multi_client_t* serial_multi_client_init(const serial_config_t* configs,
+                                                int count);
+
+/**
+ * @brief Hand a port its connected socket
+ *
+ * The session takes ownership of @p network_fd and @p tls, switches the
+ * socket to non-blocking mode and closes both in cleanup.
+ *
+ * @param index         Port index
+ * @param network_fd    Connected socket
+ * @param tls           Established SSL* for the socket, or NULL
+ * @param features      Features negotiated on the connection (0 if none)
+ * @return 0 on success, E_INVALID_ARGUMENT, E_INVALID_STATE if the port
+ *         already has one, E_OUT_OF_MEMORY, E_NETWORK_ERROR, or an error
+ *         from xoe_wire_compress_init()
+ */
+int serial_multi_client_attach(serial_multi_client_t* client, int index,
+                               int network_fd, void* tls, uint32_t features);
+
+/**
+ * @brief Hand a port its datagram association
+ *
+ * Like serial_multi_client_attach(), for a connected UDP socket on which
+ * xoe_wire_dgram_negotiate() succeeded. The channel delivers the latest
+ * frame only if @p features has XOE_WIRE_FEATURE_SERIAL_LATEST, every
+ * frame otherwise.
+ *
+ * @param index         Port index
+ * @param network_fd    Connected UDP socket
+ * @param tls           Established DTLS SSL* for the socket, or NULL
+ * @param features      Features the server granted
+ * @return 0 on success, E_INVALID_ARGUMENT, E_INVALID_STATE if the port
+ *         already has a connection, E_OUT_OF_MEMORY, E_NETWORK_ERROR
+ */
+int serial_multi_client_attach_dgram(serial_multi_client_t* client, int index,
+                                     int network_fd, void* tls,
+                                     uint32_t features);
+
+/**
+ * @brief Give the session a layer-2 ring for serial_multi_client_attach_l2()
+ *
+ * The session takes ownership of @p ring and closes it in cleanup.
+ *
+ * @param ring          Open ring (lib/net/l2_ring.h)
+ * @return 0 on success, E_INVALID_ARGUMENT, E_INVALID_STATE if the
+ *         session already has one
+ */
+int serial_multi_client_set_link(serial_multi_client_t* client,
+                                 l2_ring_t* ring);
+
+/**
+ * @brief Hand a port its layer-2 association
+ *
+ * Like serial_multi_client_attach_dgram(), for an association opened on
+ * the session's ring with xoe_wire_l2_negotiate().
+ *
+ * @param index         Port index
+ * @param server_mac    MAC of the server that answered
+ * @param association   Association ID
+ * @param features      Features the server granted
+ * @return 0 on success, E_INVALID_ARGUMENT, E_INVALID_STATE if the
+ *         session has no ring or the port already has a connection,
+ *         E_OUT_OF_MEMORY
+ */
+int serial_multi_client_attach_l2(serial_multi_client_t* client, int index,
+                                  const uint8_t* server_mac,
+                                  uint32_t association, uint32_t features);
+
+/**
+ * @brief Run the poll loop in the calling thread
+ *
+ * @return 0 once shutdown was requested, E_IO_ERROR if every port
+ *         failed, E_INVALID_ARGUMENT
+ */
+int serial_multi_client_run(serial_multi_client_t* client);
+
+/**
+ * @brief Ask the loop to return (safe from a signal handler)
+ */
+void serial_multi_client_request_shutdown(serial_multi_client_t* client);
+
+/**
+ * @brief Close every port and free the session; sets *client to NULL
+ */
+void serial_multi_client_cleanup(serial_multi_client_t** client);
+
+#endif /* SERIAL_MULTI_CLIENT_H */
@@ -0,0 +1,689 @@
+/**
+ * @file serial_mux.c
+ * @brief Serial concentrator implementation
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_mux.h"
+#include "connectors/serial/serial_port.h"
+#include "connectors/serial/serial_protocol.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+/* Internal thread entry points */
+static void* serial_mux_reader_func(void* arg);
+static void* serial_mux_writer_func(void* arg);
+static void* serial_mux_net_func(void* arg);
+
+/* ============================================================================
+ * Network Send Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Send a frame on the shared connection
+ *
+ * Consumes the frame's payload. A send failure shuts the concentrator
+ * down, since the connection is then unusable for every channel.
+ */
+static int serial_mux_send(serial_mux_t* mux, xoe_packet_t* packet)
+{
+    int result;
+
+    pthread_mutex_lock(&mux->send_mutex);
+    result = xoe_wire_send_compressed(&mux->compress, &mux->transport, 0,
+                                      packet);
+    pthread_mutex_unlock(&mux->send_mutex);
+    xoe_mux_free_payload(packet);
+
+    if (result != 0) {
+        LOG_ERROR("Network write failed: error code %d", result);
+        serial_mux_request_shutdown(mux);
+    }
+    return result;
+}
+
+/**
+ * @brief Send a channel control frame (OPEN, CREDIT, CLOSE)
+ */
+static int serial_mux_send_ctrl(serial_mux_t* mux, uint16_t channel,
+                                uint8_t type, uint32_t value)
+{
+    xoe_mux_header_t header;
+    xoe_packet_t packet;
+    int result;
+
+    memset(&header, 0, sizeof(header));
+    header.channel = channel;
+    header.type = type;
+    header.inner_protocol = XOE_PROTOCOL_SERIAL;
+    header.inner_version = XOE_PROTOCOL_SERIAL_VERSION;
+    header.value = value;
+
+    result = xoe_mux_encapsulate(&header, 0, &packet, NULL);
+    if (result != 0) {
+        return result;
+    }
+    return serial_mux_send(mux, &packet);
+}
+
+/**
+ * @brief Send one serial frame on a port's channel (credit already taken)
+ */
+static int serial_mux_send_data(serial_mux_port_t* port,
+                                const unsigned char* data, uint32_t len)
+{
+    xoe_mux_header_t header;
+    xoe_packet_t packet;
+    uint8_t* inner;
+    int result;
+
+    memset(&header, 0, sizeof(header));
+    header.channel = port->channel;
+    header.type = XOE_MUX_DATA;
+    header.inner_protocol = XOE_PROTOCOL_SERIAL;
+    header.inner_version = XOE_PROTOCOL_SERIAL_VERSION;
+
+    result = xoe_mux_encapsulate(&header, SERIAL_HEADER_SIZE + len, &packet,
+                                 &inner);
+    if (result != 0) {
+        return result;
+    }
+
+    /* Serial header (flags, sequence) then the data, in place */
+    xoe_wire_write_uint16(inner, 0);
+    xoe_wire_write_uint16(inner + 2, port->tx_sequence);
+    port->tx_sequence++;
+    memcpy(inner + SERIAL_HEADER_SIZE, data, len);
+
+    return serial_mux_send(port->mux, &packet);
+}
+
+/**
+ * @brief Return consumed bytes to the server once a CREDIT is due
+ */
+static void serial_mux_consumed(serial_mux_port_t* port, uint32_t len)
+{
+    uint32_t credit;
+
+    credit = xoe_mux_rx_consumed(&port->mux->channels, port->channel, len);
+    if (credit > 0) {
+        serial_mux_send_ctrl(port->mux, port->channel, XOE_MUX_CREDIT, credit);
+    }
+}
+
+/**
+ * @brief Take a failed port out of service
+ *
+ * Closes its channel (telling the server why) and its buffer, which ends
+ * both of its threads. The concentrator shuts down once no channel is
+ * left.
+ */
+static void serial_mux_close_port(serial_mux_port_t* port, int reason)
+{
+    serial_mux_t* mux = port->mux;
+    int i;
+
+    if (xoe_mux_channel_close(&mux->channels, port->channel) !=
+        XOE_MUX_CHANNEL_CLOSED && reason != 0) {
+        serial_mux_send_ctrl(mux, port->channel, XOE_MUX_CLOSE,
+                             (uint32_t)(-reason));
+    }
+    serial_buffer_close(&port->rx_buffer);
+
+    for (i = 0; i < mux->port_count; i++) {
+        if (xoe_mux_channel_state(&mux->channels, mux->ports[i].channel) !=
+            XOE_MUX_CHANNEL_CLOSED) {
+            return;
+        }
+    }
+    LOG_WARN("All serial channels closed");
+    serial_mux_request_shutdown(mux);
+}
+
+/* ============================================================================
+ * Lifecycle
+ * ============================================================================ */
+
+/**
+ * @brief Close the ports opened so far
+ */
+static void serial_mux_close_ports(serial_mux_t* mux, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        serial_buffer_destroy(&mux->ports[i].rx_buffer);
+        serial_port_close(mux->ports[i].serial_fd);
+    }
+}
+
+serial_mux_t* serial_mux_init(const serial_config_t* configs, int count,
+                              int network_fd)
+{
+    serial_mux_t* mux;
+    serial_mux_port_t* port;
+    int i;
+
+    if (configs == NULL || count < 1 || count > SERIAL_MUX_MAX_PORTS ||
+        network_fd < 0) {
+        return NULL;
+    }
+
+    mux = (serial_mux_t*)malloc(sizeof(serial_mux_t));
+    if (mux == NULL) {
+        return NULL;
+    }
+    memset(mux, 0, sizeof(serial_mux_t));
+    mux->network_fd = network_fd;
+    xoe_transport_init_fd(&mux->transport, network_fd);
+
+    if (xoe_mux_init(&mux->channels) != 0) {
+        free(mux);
+        return NULL;
+    }
+    if (pthread_mutex_init(&mux->send_mutex, NULL) != 0) {
+        xoe_mux_destroy(&mux->channels);
+        free(mux);
+        return NULL;
+    }
+    if (pthread_mutex_init(&mux->shutdown_mutex, NULL) != 0) {
+        pthread_mutex_destroy(&mux->send_mutex);
+        xoe_mux_destroy(&mux->channels);
+        free(mux);
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        port = &mux->ports[i];
+        port->mux = mux;
+        port->channel = (uint16_t)i;
+        memcpy(&port->config, &configs[i], sizeof(serial_config_t));
+
+        if (serial_port_open(&port->config, &port->serial_fd) != 0) {
+            LOG_ERROR("Cannot open serial port %s", port->config.device_path);
+            break;
+        }
+        if (serial_buffer_init(&port->rx_buffer, 0) != 0) {
+            serial_port_close(port->serial_fd);
+            break;
+        }
+    }
+    if (i < count) {
+        serial_mux_close_ports(mux, i);
+        pthread_mutex_destroy(&mux->shutdown_mutex);
+        pthread_mutex_destroy(&mux->send_mutex);
+        xoe_mux_destroy(&mux->channels);
+        free(mux);
+        return NULL;
+    }
+    mux->port_count = count;
+
+    return mux;
+}
+
+int serial_mux_start(serial_mux_t* mux)
+{
+    serial_mux_port_t* port;
+    uint32_t window;
+    int result;
+    int i;
+
+    if (mux == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Ask for every channel before any data can flow */
+    for (i = 0; i < mux->port_count; i++) {
+        port = &mux->ports[i];
+
+        /* Never grant more than the buffer holds: delivery must not block */
+        window = port->rx_buffer.ring.capacity;
+        if (window > XOE_MUX_DEFAULT_WINDOW) {
+            window = XOE_MUX_DEFAULT_WINDOW;
+        }
+        result = xoe_mux_channel_open(&mux->channels, port->channel,
+                                      XOE_PROTOCOL_SERIAL,
+                                      XOE_PROTOCOL_SERIAL_VERSION, window);
+        if (result == 0) {
+            result = serial_mux_send_ctrl(mux, port->channel, XOE_MUX_OPEN,
+                                          window);
+        }
+        if (result != 0) {
+            return E_NETWORK_ERROR;
+        }
+    }
+
+    if (thread_sched_create(&mux->net_thread, THREAD_CLASS_SERIAL,
+                            serial_mux_net_func, mux) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    mux->threads_started = 1;
+
+    for (i = 0; i < mux->port_count; i++) {
+        port = &mux->ports[i];
+        if (thread_sched_create(&port->writer_thread, THREAD_CLASS_SERIAL,
+                                serial_mux_writer_func, port) != 0) {
+            break;
+        }
+        if (thread_sched_create(&port->reader_thread, THREAD_CLASS_SERIAL,
+                                serial_mux_reader_func, port) != 0) {
+            serial_buffer_close(&port->rx_buffer);
+            pthread_join(port->writer_thread, NULL);
+            break;
+        }
+        mux->threads_started++;
+    }
+
+    if (i < mux->port_count) {
+        serial_mux_stop(mux);
+        return E_UNKNOWN_ERROR;
+    }
+    return 0;
+}
+
+int serial_mux_stop(serial_mux_t* mux)
+{
+    serial_mux_port_t* port;
+    int i;
+
+    if (mux == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Say goodbye on channels still open, while the connection works */
+    if (!serial_mux_should_shutdown(mux)) {
+        for (i = 0; i < mux->port_count; i++) {
+            port = &mux->ports[i];
+            if (xoe_mux_channel_close(&mux->channels, port->channel) !=
+                XOE_MUX_CHANNEL_CLOSED) {
+                serial_mux_send_ctrl(mux, port->channel, XOE_MUX_CLOSE, 0);
+            }
+        }
+    }
+
+    serial_mux_request_shutdown(mux);
+
+    /* Release readers waiting for credit, writers and the receiver */
+    xoe_mux_shutdown(&mux->channels);
+    for (i = 0; i < mux->port_count; i++) {
+        serial_buffer_close(&mux->ports[i].rx_buffer);
+    }
+    shutdown(mux->network_fd, SHUT_RDWR);
+
+    if (mux->threads_started > 0) {
+        pthread_join(mux->net_thread, NULL);
+        for (i = 0; i < mux->threads_started - 1; i++) {
+            pthread_join(mux->ports[i].reader_thread, NULL);
+            pthread_join(mux->ports[i].writer_thread, NULL);
+        }
+        mux->threads_started = 0;
+    }
+
+    return 0;
+}
+
+int serial_mux_set_compression(serial_mux_t* mux, uint32_t features)
+{
+    if (mux == NULL || mux->threads_started) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    xoe_wire_compress_cleanup(&mux->compress);
+    return xoe_wire_compress_init(&mux->compress, features);
+}
+
+void serial_mux_cleanup(serial_mux_t** mux)
+{
+    if (mux == NULL || *mux == NULL) {
+        return;
+    }
+
+    serial_mux_close_ports(*mux, (*mux)->port_count);
+    xoe_mux_destroy(&(*mux)->channels);
+    xoe_wire_compress_cleanup(&(*mux)->compress);
+    pthread_mutex_destroy(&(*mux)->send_mutex);
+    pthread_mutex_destroy(&(*mux)->shutdown_mutex);
+
+    free(*mux);
+    *mux = NULL;
+}
+
+int serial_mux_should_shutdown(serial_mux_t* mux)
+{
+    int should_shutdown;
+
+    if (mux == NULL) {
+        return TRUE;
+    }
+
+    pthread_mutex_lock(&mux->shutdown_mutex);
+    should_shutdown = mux->shutdown_flag;
+    pthread_mutex_unlock(&mux->shutdown_mutex);
+
+    return should_shutdown;
+}
+
+void serial_mux_request_shutdown(serial_mux_t* mux)
+{
+    if (mux == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&mux->shutdown_mutex);
+    mux->shutdown_flag = TRUE;
+    pthread_mutex_unlock(&mux->shutdown_mutex);
+}
+
+/* ============================================================================
+ * I/O Threads
+ * ============================================================================ */
+
+/**
+ * @brief Port reader: serial port → channel
+ *
+ * Reads and coalesces bursts as serial_client does, then sends them as
+ * frames sized to the credit available, waiting while the channel has
+ * none. Exits when its channel closes or on shutdown.
+ */
+static void* serial_mux_reader_func(void* arg)
+{
+    serial_mux_port_t* port = (serial_mux_port_t*)arg;
+    serial_mux_t* mux = port->mux;
+    unsigned char buffer[SERIAL_READ_CHUNK_MAX];
+    uint64_t read_ns;
+    int bytes_read;
+    int frame_limit;
+    int read_limit;
+    int idle_us;
+    int window_us;
+    int offset;
+    int frame_len;
+    int granted;
+
+    frame_limit = port->config.coalesce_bytes;
+    if (frame_limit <= 0 || frame_limit > SERIAL_MAX_PAYLOAD_SIZE) {
+        frame_limit = SERIAL_MAX_PAYLOAD_SIZE;
+    }
+    read_limit = serial_config_read_chunk(&port->config);
+    if (read_limit < frame_limit || read_limit > (int)sizeof(buffer)) {
+        read_limit = frame_limit;
+    }
+    idle_us = serial_config_idle_gap_us(&port->config);
+    window_us = serial_config_burst_window_us(&port->config);
+
+    while (!serial_mux_should_shutdown(mux) &&
+           xoe_mux_channel_state(&mux->channels, port->channel) !=
+           XOE_MUX_CHANNEL_CLOSED) {
+        if (port->config.read_mode != SERIAL_READ_MODE_FIXED) {
+            bytes_read = serial_port_read_adaptive(port->serial_fd, buffer,
+                                                   read_limit,
+                                                   port->config.read_timeout_ms,
+                                                   window_us,
+                                                   idle_us);
+        } else {
+            bytes_read = serial_port_read_coalesced(port->serial_fd, buffer,
+                                                    read_limit,
+                                                    port->config.read_timeout_ms,
+                                                    window_us,
+                                                    idle_us);
+        }
+        if (bytes_read < 0) {
+            LOG_ERROR("Serial read failed on %s: error code %d (errno=%d: %s)",
+                      port->config.device_path, bytes_read, errno,
+                      strerror(errno));
+            serial_mux_close_port(port, E_IO_ERROR);
+            break;
+        }
+
+        metrics_add(METRIC_SERIAL_RX_BYTES, (uint64_t)bytes_read);
+        read_ns = latency_now_ns();
+
+        offset = 0;
+        while (offset < bytes_read) {
+            frame_len = bytes_read - offset;
+            if (frame_len > frame_limit) {
+                frame_len = frame_limit;
+            }
+
+            granted = xoe_mux_tx_acquire(&mux->channels, port->channel,
+                                         SERIAL_HEADER_SIZE + 1,
+                                         SERIAL_HEADER_SIZE + (uint32_t)frame_len,
+                                         SERIAL_MUX_CREDIT_POLL_MS);
+            if (granted == E_TIMEOUT) {
+                continue;   /* Same frame again; state rechecked inside */
+            }
+            if (granted < 0) {
+                offset = -1; /* Channel closed or shutdown */
+                break;
+            }
+
+            frame_len = granted - SERIAL_HEADER_SIZE;
+            if (serial_mux_send_data(port, buffer + offset,
+                                     (uint32_t)frame_len) != 0) {
+                offset = -1;
+                break;
+            }
+            latency_record_since(LATENCY_SERIAL_TO_NET, read_ns);
+            offset += frame_len;
+        }
+        if (offset < 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Port writer: buffer → serial port, then credit the server
+ */
+static void* serial_mux_writer_func(void* arg)
+{
+    serial_mux_port_t* port = (serial_mux_port_t*)arg;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count;
+    int bytes_read;
+    int bytes_written;
+
+    while (!serial_mux_should_shutdown(port->mux)) {
+        bytes_read = serial_buffer_peek(&port->rx_buffer,
+                                        SERIAL_WRITE_CHUNK_SIZE,
+                                        spans, &span_count);
+        if (bytes_read <= 0) {
+            break; /* Closed and drained */
+        }
+
+        bytes_written = serial_port_writev(port->serial_fd, spans, span_count);
+        if (bytes_written < 0) {
+            LOG_ERROR("Serial write failed on %s: error code %d (errno=%d: %s)",
+                      port->config.device_path, bytes_written, errno,
+                      strerror(errno));
+            serial_mux_close_port(port, E_IO_ERROR);
+            break;
+        }
+
+        metrics_add(METRIC_SERIAL_TX_BYTES, (uint64_t)bytes_written);
+        if (bytes_written != bytes_read) {
+            LOG_WARN("Partial serial write on %s: wrote %d of %d bytes",
+                     port->config.device_path, bytes_written, bytes_read);
+        }
+
+        serial_buffer_consume(&port->rx_buffer, (uint32_t)bytes_read);
+        serial_mux_consumed(port, (uint32_t)bytes_read);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Hand a DATA frame's serial bytes to its port's writer
+ *
+ * The serial header is credited back at once; the data when the writer
+ * has put it on the line. The window never exceeds the buffer, so the
+ * reserve does not wait on a slow port.
+ *
+ * @return 0, or E_PROTOCOL_ERROR if the server broke the window
+ */
+static int serial_mux_deliver(serial_mux_port_t* port, xoe_packet_t* inner)
+{
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count = 0;
+    uint32_t len = inner->payload->len;
+    uint32_t frame_len;
+    uint32_t actual_len = 0;
+    uint16_t sequence;
+    uint16_t flags;
+    int result;
+
+    result = xoe_mux_rx_accept(&port->mux->channels, port->channel, len);
+    if (result == E_PROTOCOL_ERROR) {
+        LOG_ERROR("Server exceeded the window of channel %u", port->channel);
+        return result;
+    }
+    if (result != 0) {
+        return 0;   /* Channel already closed here */
+    }
+
+    frame_len = (len > SERIAL_HEADER_SIZE) ? len - SERIAL_HEADER_SIZE : 0;
+    if (frame_len > SERIAL_MAX_PAYLOAD_SIZE) {
+        result = E_BUFFER_TOO_SMALL;
+    } else {
+        if (frame_len > 0 &&
+            serial_buffer_reserve(&port->rx_buffer, frame_len, spans,
+                                  &span_count) <= 0) {
+            /* Port out of service: credit the frame and drop it */
+            serial_mux_consumed(port, len);
+            return 0;
+        }
+        inner->checksum = serial_protocol_checksum(inner);
+        result = serial_protocol_decapsulate_iov(inner, spans, span_count,
+                                                 &actual_len, &sequence,
+                                                 &flags);
+    }
+    if (result != 0) {
+        LOG_WARN("Channel %u frame decapsulation failed: error code %d",
+                 port->channel, result);
+        serial_mux_consumed(port, len);
+        return 0;
+    }
+
+    if (flags & (SERIAL_FLAG_PARITY_ERROR | SERIAL_FLAG_FRAMING_ERROR |
+                 SERIAL_FLAG_OVERRUN_ERROR)) {
+        metrics_add(METRIC_SERIAL_LINE_ERRORS, 1);
+        LOG_WARN("Line error flags 0x%04x on channel %u seq=%u",
+                 flags, port->channel, sequence);
+    }
+
+    if (actual_len > 0) {
+        serial_buffer_commit(&port->rx_buffer, actual_len);
+    }
+    serial_mux_consumed(port, len - actual_len);
+    return 0;
+}
+
+/**
+ * @brief Network receiver: demultiplex frames to the ports
+ */
+static void* serial_mux_net_func(void* arg)
+{
+    serial_mux_t* mux = (serial_mux_t*)arg;
+    xoe_mux_header_t header;
+    xoe_packet_t packet;
+    xoe_packet_t inner;
+    xoe_payload_t inner_payload;
+    serial_mux_port_t* port;
+    int result;
+
+    memset(&packet, 0, sizeof(packet));
+
+    while (!serial_mux_should_shutdown(mux)) {
+        result = xoe_wire_recv_transport(&mux->transport, &packet, 0);
+        if (result == E_CHECKSUM_MISMATCH) {
+            LOG_WARN("Checksum mismatch on received packet, error=%d", result);
+            continue;
+        }
+        if (result != 0) {
+            if (!serial_mux_should_shutdown(mux)) {
+                LOG_INFO("Network connection closed: error code %d", result);
+            }
+            break;
+        }
+
+        result = xoe_wire_decompress_packet(&mux->compress, &packet);
+        if (result != 0) {
+            LOG_ERROR("Undecodable compressed frame: error code %d", result);
+            xoe_wire_free_payload(&packet);
+            break;
+        }
+
+        if (packet.protocol_id != XOE_PROTOCOL_MUX ||
+            xoe_mux_decapsulate(&packet, &header, &inner,
+                                &inner_payload) != 0) {
+            LOG_WARN("Ignoring non-channel frame (protocol %u)",
+                     packet.protocol_id);
+            xoe_wire_free_payload(&packet);
+            continue;
+        }
+
+        port = (header.channel < mux->port_count) ?
+               &mux->ports[header.channel] : NULL;
+        result = 0;
+
+        switch (header.type) {
+            case XOE_MUX_OPEN_ACK:
+                if (xoe_mux_channel_opened(&mux->channels, header.channel,
+                                           header.value) != 0) {
+                    LOG_WARN("Unexpected OPEN_ACK on channel %u",
+                             header.channel);
+                }
+                break;
+            case XOE_MUX_CREDIT:
+                result = xoe_mux_tx_grant(&mux->channels, header.channel,
+                                          header.value);
+                break;
+            case XOE_MUX_CLOSE:
+                if (port != NULL) {
+                    LOG_WARN("Server closed channel %u (%s): reason %u",
+                             header.channel, port->config.device_path,
+                             header.value);
+                    serial_mux_close_port(port, 0);
+                }
+                break;
+            case XOE_MUX_OPEN:
+                /* Channels are opened by the concentrator only */
+                serial_mux_send_ctrl(mux, header.channel, XOE_MUX_CLOSE,
+                                     (uint32_t)(-E_NOT_SUPPORTED));
+                break;
+            case XOE_MUX_DATA:
+                if (port != NULL) {
+                    result = serial_mux_deliver(port, &inner);
+                }
+                break;
+            default:
+                break;
+        }
+
+        xoe_wire_free_payload(&packet);
+
+        if (result != 0) {
+            LOG_ERROR("Channel protocol violation: error code %d", result);
+            break;
+        }
+    }
+
+    /* The connection is gone for every channel */
+    serial_mux_request_shutdown(mux);
+    xoe_mux_shutdown(&mux->channels);
+    return NULL;
+}
@@ -0,0 +1,136 @@
+/**
+ * @file serial_mux.h
+ * @brief Serial concentrator: many serial ports over one connection
+ *
+ * Bridges up to SERIAL_MUX_MAX_PORTS serial ports over a single network
+ * connection using channel multiplexing (lib/protocol/mux.h). Port i is
+ * channel i; each channel carries ordinary serial protocol payloads, so
+ * sequence numbers and line error flags work as in serial_client.
+ *
+ * Threads:
+ * - One reader per port: reads the port, waits for channel credit, sends
+ * - One TTY writer per port: drains that port's buffer to the device
+ * - One network receiver: demultiplexes frames into the port buffers
+ *
+ * Flow control is per channel credit instead of XON/XOFF: each port's
+ * receive window is no larger than its buffer, so the network receiver
+ * never blocks on a slow port and the other ports keep flowing. Credit
+ * goes back to the server as the TTY writer drains the buffer.
+ *
+ * A failing port closes only its own channel; a failing connection
+ * shuts the whole concentrator down.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERIAL_MUX_H
+#define SERIAL_MUX_H
+
+#include <pthread.h>
+#include "serial_config.h"
+#include "serial_buffer.h"
+#include "lib/protocol/mux.h"
+#include "lib/protocol/wire_compress.h"
+
+/* Ports per concentrator (16-port serial servers) */
+#define SERIAL_MUX_MAX_PORTS 16
+
+/* Poll interval of readers waiting for credit (ms) */
+#define SERIAL_MUX_CREDIT_POLL_MS 100
+
+struct serial_mux;
+
+/**
+ * @brief One bridged port
+ */
+typedef struct {
+    struct serial_mux* mux;       /* Owning concentrator */
+    uint16_t channel;             /* Channel ID (port index) */
+    serial_config_t config;
+    int serial_fd;
+
+    serial_buffer_t rx_buffer;    /* Network → serial */
+    pthread_t reader_thread;
+    pthread_t writer_thread;
+    uint16_t tx_sequence;         /* Reader thread only */
+} serial_mux_port_t;
+
+/**
+ * @brief Concentrator session
+ */
+typedef struct serial_mux {
+    int network_fd;
+    xoe_transport_t transport;    /* Bound to network_fd */
+    int port_count;
+    serial_mux_port_t ports[SERIAL_MUX_MAX_PORTS];
+
+    xoe_mux_t channels;           /* Per-channel credit */
+    pthread_mutex_t send_mutex;   /* Serializes frames on network_fd */
+    xoe_wire_compress_t compress; /* Negotiated frame compression */
+
+    pthread_t net_thread;
+    int threads_started;
+
+    pthread_mutex_t shutdown_mutex;
+    int shutdown_flag;
+} serial_mux_t;
+
+/**
+ * @brief Open all ports and set up the channel table
+ *
+ * @param configs    One configuration per port
+ * @param count      Number of ports (1 .. SERIAL_MUX_MAX_PORTS)
+ * @param network_fd Connected network socket
+ * @return Session, or NULL if an argument is invalid, a port cannot be
+ *         opened or memory runs out
+ */
+serial_mux_t* serial_mux_init(const serial_config_t* configs, int count,
+                              int network_fd);
+
+/**
+ * @brief Compress frames as negotiated on the connection
+ *
+ * Call before serial_mux_start().
+ *
+ * @param features  XOE_WIRE_FEATURE_* bits granted by xoe_wire_negotiate()
+ * @return 0 on success, or an error from xoe_wire_compress_init()
+ */
+int serial_mux_set_compression(serial_mux_t* mux, uint32_t features);
+
+/**
+ * @brief Open every channel and start the I/O threads
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_NETWORK_ERROR if the OPEN
+ *         frames cannot be sent, E_UNKNOWN_ERROR if a thread cannot start
+ */
+int serial_mux_start(serial_mux_t* mux);
+
+/**
+ * @brief Close the channels and wait for all threads
+ *
+ * Shuts the network socket down to release the receiver; the caller
+ * still closes it.
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT
+ */
+int serial_mux_stop(serial_mux_t* mux);
+
+/**
+ * @brief Free the session (after serial_mux_stop()); sets *mux to NULL
+ */
+void serial_mux_cleanup(serial_mux_t** mux);
+
+/**
+ * @brief TRUE once shutdown has been requested (or @p mux is NULL)
+ */
+int serial_mux_should_shutdown(serial_mux_t* mux);
+
+/**
+ * @brief Request shutdown
+ *
+ * Sets the shutdown flag without waiting for the threads; call
+ * serial_mux_stop() for that.
+ */
+void serial_mux_request_shutdown(serial_mux_t* mux);
+
+#endif /* SERIAL_MUX_H */
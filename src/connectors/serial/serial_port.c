@@ -11,6 +11,7 @@
 
 #include "connectors/serial/serial_port.h"
 #include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_baud.h"
 #include "lib/common/definitions.h"
 
 #include <fcntl.h>
@@ -19,11 +20,24 @@
 #include <string.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
 
 /* Internal helper functions */
 static int configure_termios(int fd, const serial_config_t* config);
 static int baud_to_speed_const(int baud_rate, speed_t* speed);
 static int set_timeout(int fd, int timeout_ms);
+static int wait_readable_us(int fd, long timeout_us);
+static long elapsed_us(const struct timespec* start);
+static int read_burst_tail(int fd, unsigned char* data, int total, int len,
+                           int window_us, int idle_us);
+static void set_low_latency(int fd);
+static int set_custom_baud(int fd, int baud_rate);
 
 /**
  * @brief Initialize serial configuration with default values
@@ -41,6 +55,9 @@ int serial_config_init_defaults(serial_config_t* config)
     config->parity = SERIAL_DEFAULT_PARITY;
     config->flow_control = SERIAL_DEFAULT_FLOW;
     config->read_timeout_ms = SERIAL_DEFAULT_TIMEOUT_MS;
+    config->coalesce_bytes = SERIAL_DEFAULT_COALESCE_BYTES;
+    config->coalesce_us = SERIAL_DEFAULT_COALESCE_US;
+    config->read_mode = SERIAL_DEFAULT_READ_MODE;
 
     return 0;
 }
@@ -146,6 +163,22 @@ int serial_config_validate(const serial_config_t* config)
         return E_INVALID_ARGUMENT;
     }
 
+    /* Validate coalescing limits */
+    if (config->coalesce_bytes < 1 ||
+        config->coalesce_bytes > SERIAL_COALESCE_MAX_BYTES) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (config->coalesce_us < 0 || config->coalesce_us > SERIAL_COALESCE_MAX_US) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Validate read mode */
+    if (config->read_mode != SERIAL_READ_MODE_FIXED &&
+        config->read_mode != SERIAL_READ_MODE_ADAPTIVE &&
+        config->read_mode != SERIAL_READ_MODE_FRAME) {
+        return E_INVALID_ARGUMENT;
+    }
+
     return 0;
 }
 
@@ -186,13 +219,33 @@ int serial_port_open(const serial_config_t* config, int* fd)
         return result;
     }
 
-    /* Set timeout */
-    result = set_timeout(file_descriptor, config->read_timeout_ms);
+    /*
+     * Set timeout. Adaptive and frame modes make read() return at once and
+     * time reads with select() instead, so termios is never touched again.
+     */
+    if (config->read_mode != SERIAL_READ_MODE_FIXED) {
+        result = set_timeout(file_descriptor, 0);
+    } else {
+        result = set_timeout(file_descriptor, config->read_timeout_ms);
+    }
     if (result != 0) {
         close(file_descriptor);
         return result;
     }
 
+    /* Last: on macOS any later tcsetattr() drops a custom rate again */
+    result = set_custom_baud(file_descriptor, config->baud_rate);
+    if (result != 0) {
+        close(file_descriptor);
+        return result;
+    }
+
+    /* Adaptive reads time gaps; fast lines fill the tty buffer quickly */
+    if (config->read_mode != SERIAL_READ_MODE_FIXED ||
+        config->baud_rate > SERIAL_BAUD_LOW_LATENCY_ABOVE) {
+        set_low_latency(file_descriptor);
+    }
+
     *fd = file_descriptor;
     return 0;
 }
@@ -245,6 +298,217 @@ int serial_port_read(int fd, void* buffer, int len, int timeout_ms)
     return bytes_read;
 }
 
+/**
+ * @brief Read from serial port, coalescing bursts into one buffer
+ *
+ * The first read behaves exactly like serial_port_read(). Once data has
+ * arrived, further reads are appended for as long as the line keeps
+ * delivering bytes, the window has not elapsed and the buffer is not full.
+ * A gap of @p idle_us without new data ends the burst immediately, so an
+ * idle line adds at most one idle gap of latency.
+ */
+int serial_port_read_coalesced(int fd, void* buffer, int len, int timeout_ms,
+                               int window_us, int idle_us)
+{
+    int total;
+
+    total = serial_port_read(fd, buffer, len, timeout_ms);
+    return read_burst_tail(fd, (unsigned char*)buffer, total, len,
+                           window_us, idle_us);
+}
+
+/**
+ * @brief Read a burst of data from a port opened in adaptive mode
+ */
+int serial_port_read_adaptive(int fd, void* buffer, int len, int timeout_ms,
+                              int window_us, int idle_us)
+{
+    int total;
+    int ready;
+
+    if (fd < 0 || buffer == NULL || len <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    ready = wait_readable_us(fd, timeout_ms < 0 ? -1L : (long)timeout_ms * 1000L);
+    if (ready <= 0) {
+        return ready; /* Timeout or select error */
+    }
+
+    total = serial_port_read(fd, buffer, len, -1);
+    return read_burst_tail(fd, (unsigned char*)buffer, total, len,
+                           window_us, idle_us);
+}
+
+/**
+ * @brief Extend a burst whose first read returned total bytes
+ *
+ * @return Bytes collected, or the first read's result if it was <= 0
+ */
+static int read_burst_tail(int fd, unsigned char* data, int total, int len,
+                           int window_us, int idle_us)
+{
+    struct timespec start;
+    long remaining_us;
+    int bytes_read;
+
+    if (total <= 0 || window_us <= 0 || total >= len) {
+        return total;
+    }
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start) != 0) {
+        return total;
+    }
+
+    while (total < len) {
+        remaining_us = (long)window_us - elapsed_us(&start);
+        if (remaining_us <= 0) {
+            break;
+        }
+        if (idle_us > 0 && remaining_us > idle_us) {
+            remaining_us = idle_us;
+        }
+
+        /* Line idle (or select error): flush what we have */
+        if (wait_readable_us(fd, remaining_us) <= 0) {
+            break;
+        }
+
+        /* Data is pending, so the existing VTIME setting cannot stall us */
+        bytes_read = serial_port_read(fd, data + total, len - total, -1);
+        if (bytes_read <= 0) {
+            /* Errors resurface on the next read; deliver this burst first */
+            break;
+        }
+        total += bytes_read;
+    }
+
+    return total;
+}
+
+/**
+ * @brief Bits one character occupies on the line
+ */
+static long bits_per_char(const serial_config_t* config)
+{
+    /* Start bit + data bits + optional parity + stop bits */
+    return 1 + config->data_bits + config->stop_bits +
+           (config->parity != SERIAL_PARITY_NONE ? 1 : 0);
+}
+
+/**
+ * @brief Compute the time one character occupies on the line
+ */
+int serial_config_char_time_us(const serial_config_t* config)
+{
+    if (config == NULL || config->baud_rate <= 0) {
+        return 0;
+    }
+
+    return (int)((bits_per_char(config) * 1000000L + config->baud_rate - 1) /
+                 config->baud_rate);
+}
+
+/**
+ * @brief Compute the idle gap that ends a coalescing burst
+ */
+int serial_config_idle_gap_us(const serial_config_t* config)
+{
+    long gap_us;
+
+    if (config == NULL || config->baud_rate <= 0) {
+        return SERIAL_COALESCE_MIN_IDLE_US;
+    }
+
+    if (config->read_mode == SERIAL_READ_MODE_FRAME) {
+        /* Modbus RTU t3.5; the spec fixes it on fast lines */
+        if (config->baud_rate > SERIAL_FRAME_FIXED_GAP_ABOVE) {
+            return SERIAL_FRAME_FIXED_GAP_US;
+        }
+        gap_us = (SERIAL_FRAME_GAP_HALF_CHARS * bits_per_char(config) *
+                  1000000L + 2L * config->baud_rate - 1) /
+                 (2L * config->baud_rate);
+        return (int)gap_us;
+    }
+
+    if (config->read_mode == SERIAL_READ_MODE_ADAPTIVE) {
+        /*
+         * A continuous stream delivers its next byte within one character
+         * time; the extra half absorbs wakeup jitter.
+         */
+        gap_us = (SERIAL_ADAPTIVE_IDLE_HALF_CHARS * bits_per_char(config) *
+                  1000000L + 2L * config->baud_rate - 1) /
+                 (2L * config->baud_rate);
+        if (gap_us < SERIAL_ADAPTIVE_MIN_IDLE_US) {
+            gap_us = SERIAL_ADAPTIVE_MIN_IDLE_US;
+        }
+        return (int)gap_us;
+    }
+
+    gap_us = (SERIAL_COALESCE_IDLE_CHARS * bits_per_char(config) * 1000000L +
+              config->baud_rate - 1) / config->baud_rate;
+
+    if (gap_us < SERIAL_COALESCE_MIN_IDLE_US) {
+        gap_us = SERIAL_COALESCE_MIN_IDLE_US;
+    }
+    return (int)gap_us;
+}
+
+/**
+ * @brief Compute how many bytes to collect per serial read burst
+ */
+int serial_config_read_chunk(const serial_config_t* config)
+{
+    long chunk;
+    int frame;
+
+    if (config == NULL) {
+        return SERIAL_READ_CHUNK_SIZE;
+    }
+
+    frame = config->coalesce_bytes;
+    if (frame <= 0 || frame > SERIAL_COALESCE_MAX_BYTES) {
+        frame = SERIAL_COALESCE_MAX_BYTES;
+    }
+    if (config->read_mode != SERIAL_READ_MODE_ADAPTIVE || config->baud_rate <= 0) {
+        return frame;
+    }
+
+    chunk = (long)config->baud_rate * SERIAL_ADAPTIVE_CHUNK_MS /
+            (bits_per_char(config) * 1000L);
+    if (chunk < SERIAL_READ_CHUNK_SIZE) {
+        chunk = SERIAL_READ_CHUNK_SIZE;
+    }
+    if (chunk > SERIAL_READ_CHUNK_MAX) {
+        chunk = SERIAL_READ_CHUNK_MAX;
+    }
+    if (chunk < frame) {
+        chunk = frame;
+    }
+    return (int)chunk;
+}
+
+/**
+ * @brief Compute the longest a read burst may last
+ */
+int serial_config_burst_window_us(const serial_config_t* config)
+{
+    long window_us;
+
+    if (config == NULL) {
+        return SERIAL_DEFAULT_COALESCE_US;
+    }
+    if (config->read_mode != SERIAL_READ_MODE_FRAME) {
+        return config->coalesce_us;
+    }
+
+    /* A full-size frame at line rate, then the gap that ends it */
+    window_us = (long)serial_config_read_chunk(config) *
+                serial_config_char_time_us(config) +
+                serial_config_idle_gap_us(config);
+    return (int)window_us;
+}
+
 /**
  * @brief Write data to serial port
  */
@@ -273,6 +537,58 @@ int serial_port_write(int fd, const void* buffer, int len)
     return total_written;
 }
 
+/**
+ * @brief Write scattered data to serial port
+ */
+int serial_port_writev(int fd, const struct iovec* iov, int iovcnt)
+{
+    struct iovec local[SERIAL_PORT_WRITEV_MAX_IOV];
+    struct iovec* next;
+    ssize_t bytes_written;
+    int total_written = 0;
+    int remaining;
+
+    if (fd < 0 || iov == NULL || iovcnt <= 0 ||
+        iovcnt > SERIAL_PORT_WRITEV_MAX_IOV) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Advanced in place as data goes out */
+    memcpy(local, iov, (size_t)iovcnt * sizeof(struct iovec));
+    next = local;
+    remaining = iovcnt;
+
+    while (remaining > 0) {
+        /* Skip regions already written (or empty) */
+        if (next->iov_len == 0) {
+            next++;
+            remaining--;
+            continue;
+        }
+
+        bytes_written = writev(fd, next, remaining);
+        if (bytes_written < 0) {
+            if (errno == EINTR) {
+                continue; /* Interrupted, retry */
+            }
+            return E_NETWORK_ERROR;
+        }
+        total_written += (int)bytes_written;
+
+        while (remaining > 0 && (size_t)bytes_written >= next->iov_len) {
+            bytes_written -= (ssize_t)next->iov_len;
+            next++;
+            remaining--;
+        }
+        if (remaining > 0) {
+            next->iov_base = (char*)next->iov_base + bytes_written;
+            next->iov_len -= (size_t)bytes_written;
+        }
+    }
+
+    return total_written;
+}
+
 /**
  * @brief Get error status from serial port
  */
@@ -340,10 +656,15 @@ static int configure_termios(int fd, const serial_config_t* config)
         return E_UNKNOWN_ERROR;
     }
 
-    /* Convert baud rate */
+    /*
+     * Convert baud rate. A rate without a constant opens at 38400 and is
+     * programmed by serial_baud_set_custom() once termios is final.
+     */
     result = baud_to_speed_const(config->baud_rate, &speed);
-    if (result != 0) {
-        return result;
+    if (result == E_NOT_SUPPORTED && SERIAL_BAUD_CUSTOM) {
+        speed = B38400;
+    } else if (result != 0) {
+        return E_INVALID_ARGUMENT;
     }
 
     /* Set baud rate */
@@ -405,23 +726,22 @@ static int configure_termios(int fd, const serial_config_t* config)
 }
 
 /**
- * @brief Validate baud rate against whitelist (FSM-002, SER-002 fix)
+ * @brief Validate baud rate (FSM-002, SER-002 fix)
  *
- * Only standard baud rates are accepted to prevent misconfiguration.
+ * Rates with a termios constant, plus any rate in range where the
+ * platform can program one directly (serial_baud.h).
  */
 int serial_validate_baud(int baud_rate)
 {
-    switch (baud_rate) {
-        case 9600:
-        case 19200:
-        case 38400:
-        case 57600:
-        case 115200:
-        case 230400:
-            return 0;  /* Valid */
-        default:
-            return -1; /* Invalid */
+    speed_t speed;
+
+    if (baud_rate < SERIAL_BAUD_MIN || baud_rate > SERIAL_BAUD_MAX) {
+        return -1;
+    }
+    if (baud_to_speed_const(baud_rate, &speed) == 0 || SERIAL_BAUD_CUSTOM) {
+        return 0;
     }
+    return -1;
 }
 
 /**
@@ -433,7 +753,44 @@ static int baud_to_speed_const(int baud_rate, speed_t* speed)
         return E_INVALID_ARGUMENT;
     }
 
+    /* Rates past B38400 are not POSIX: use those this platform names */
     switch (baud_rate) {
+        case 50:
+            *speed = B50;
+            break;
+        case 75:
+            *speed = B75;
+            break;
+        case 110:
+            *speed = B110;
+            break;
+        case 134:
+            *speed = B134;
+            break;
+        case 150:
+            *speed = B150;
+            break;
+        case 200:
+            *speed = B200;
+            break;
+        case 300:
+            *speed = B300;
+            break;
+        case 600:
+            *speed = B600;
+            break;
+        case 1200:
+            *speed = B1200;
+            break;
+        case 1800:
+            *speed = B1800;
+            break;
+        case 2400:
+            *speed = B2400;
+            break;
+        case 4800:
+            *speed = B4800;
+            break;
         case 9600:
             *speed = B9600;
             break;
@@ -443,17 +800,83 @@ static int baud_to_speed_const(int baud_rate, speed_t* speed)
         case 38400:
             *speed = B38400;
             break;
+#ifdef B57600
         case 57600:
             *speed = B57600;
             break;
+#endif
+#ifdef B115200
         case 115200:
             *speed = B115200;
             break;
+#endif
+#ifdef B230400
         case 230400:
             *speed = B230400;
             break;
+#endif
+#ifdef B460800
+        case 460800:
+            *speed = B460800;
+            break;
+#endif
+#ifdef B500000
+        case 500000:
+            *speed = B500000;
+            break;
+#endif
+#ifdef B576000
+        case 576000:
+            *speed = B576000;
+            break;
+#endif
+#ifdef B921600
+        case 921600:
+            *speed = B921600;
+            break;
+#endif
+#ifdef B1000000
+        case 1000000:
+            *speed = B1000000;
+            break;
+#endif
+#ifdef B1152000
+        case 1152000:
+            *speed = B1152000;
+            break;
+#endif
+#ifdef B1500000
+        case 1500000:
+            *speed = B1500000;
+            break;
+#endif
+#ifdef B2000000
+        case 2000000:
+            *speed = B2000000;
+            break;
+#endif
+#ifdef B2500000
+        case 2500000:
+            *speed = B2500000;
+            break;
+#endif
+#ifdef B3000000
+        case 3000000:
+            *speed = B3000000;
+            break;
+#endif
+#ifdef B3500000
+        case 3500000:
+            *speed = B3500000;
+            break;
+#endif
+#ifdef B4000000
+        case 4000000:
+            *speed = B4000000;
+            break;
+#endif
         default:
-            return E_INVALID_ARGUMENT;
+            return E_NOT_SUPPORTED;
     }
 
     return 0;
@@ -482,3 +905,86 @@ static int set_timeout(int fd, int timeout_ms)
 
     return 0;
 }
+
+/**
+ * @brief Ask the driver to push received bytes up without batching
+ *
+ * Best effort: Linux drivers that honour ASYNC_LOW_LATENCY hand each
+ * character to the tty layer as it arrives instead of on a timer;
+ * other drivers, ptys and other platforms simply keep their default.
+ */
+static void set_low_latency(int fd)
+{
+#if defined(__linux__) && defined(TIOCSSERIAL) && defined(ASYNC_LOW_LATENCY)
+    struct serial_struct serial;
+
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0) {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        (void)ioctl(fd, TIOCSSERIAL, &serial);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+/**
+ * @brief Program a rate that has no termios constant
+ *
+ * Standard rates were set by configure_termios() and are left alone.
+ */
+static int set_custom_baud(int fd, int baud_rate)
+{
+    speed_t speed;
+
+    if (baud_to_speed_const(baud_rate, &speed) == 0) {
+        return 0;
+    }
+    return serial_baud_set_custom(fd, baud_rate);
+}
+
+/**
+ * @brief Wait up to timeout_us for the descriptor to become readable
+ *
+ * A negative timeout waits indefinitely.
+ *
+ * @return 1 if readable, 0 on timeout, negative on error
+ */
+static int wait_readable_us(int fd, long timeout_us)
+{
+    fd_set read_fds;
+    struct timeval tv;
+    int result;
+
+    if (fd >= FD_SETSIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    FD_ZERO(&read_fds);
+    FD_SET(fd, &read_fds);
+    tv.tv_sec = timeout_us / 1000000L;
+    tv.tv_usec = timeout_us % 1000000L;
+
+    do {
+        result = select(fd + 1, &read_fds, NULL, NULL,
+                        timeout_us < 0 ? NULL : &tv);
+    } while (result < 0 && errno == EINTR);
+
+    if (result < 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    return result > 0 ? 1 : 0;
+}
+
+/**
+ * @brief Microseconds elapsed on the monotonic clock since start
+ */
+static long elapsed_us(const struct timespec* start)
+{
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) != 0) {
+        return 0;
+    }
+    return (long)(now.tv_sec - start->tv_sec) * 1000000L +
+           (long)(now.tv_nsec - start->tv_nsec) / 1000L;
+}
@@ -14,6 +14,10 @@
 
 #include "serial_config.h"
 #include "lib/protocol/protocol.h"
+#include <sys/uio.h>
+
+/* Maximum iovec entries accepted by serial_port_writev() */
+#define SERIAL_PORT_WRITEV_MAX_IOV 4
 
 /**
  * @brief Open and configure a serial port
@@ -60,6 +64,110 @@ int serial_port_close(int fd);
  */
 int serial_port_read(int fd, void* buffer, int len, int timeout_ms);
 
+/**
+ * @brief Read a burst of data from serial port into one buffer
+ *
+ * Blocks like serial_port_read() for the first bytes, then keeps appending
+ * further reads until one of the following holds:
+ *   - the buffer is full (`len` bytes),
+ *   - `window_us` microseconds have passed since the first bytes arrived,
+ *   - no new byte arrived for `idle_us` microseconds (line idle).
+ *
+ * Used to pack many short reads into one frame without delaying traffic
+ * on a quiet line.
+ *
+ * @param fd File descriptor
+ * @param buffer Output buffer for received data
+ * @param len Maximum number of bytes to collect
+ * @param timeout_ms Timeout for the first read in milliseconds
+ * @param window_us Maximum coalescing window (0 = single read)
+ * @param idle_us Idle gap that ends the burst early (0 = window only)
+ * @return Number of bytes read on success (may be less than len)
+ *         0 on timeout
+ *         Negative error code on failure
+ */
+int serial_port_read_coalesced(int fd, void* buffer, int len, int timeout_ms,
+                               int window_us, int idle_us);
+
+/**
+ * @brief Read a burst of data from a port opened in adaptive mode
+ *
+ * Same burst rules as serial_port_read_coalesced(), but the wait for the
+ * first bytes is a select() on `timeout_ms` rather than a termios VTIME
+ * update, so no read touches the line settings. Requires the VMIN = 0,
+ * VTIME = 0 setup serial_port_open() applies in SERIAL_READ_MODE_ADAPTIVE
+ * (or any descriptor where read() after select() cannot block).
+ *
+ * @param fd File descriptor
+ * @param buffer Output buffer for received data
+ * @param len Maximum number of bytes to collect
+ * @param timeout_ms Timeout for the first bytes in milliseconds (negative
+ *                   waits indefinitely)
+ * @param window_us Maximum coalescing window (0 = single read)
+ * @param idle_us Idle gap that ends the burst early (0 = window only)
+ * @return Number of bytes read on success (may be less than len)
+ *         0 on timeout
+ *         Negative error code on failure
+ */
+int serial_port_read_adaptive(int fd, void* buffer, int len, int timeout_ms,
+                              int window_us, int idle_us);
+
+/**
+ * @brief Compute the time one character occupies on the line
+ *
+ * Start bit, data bits, optional parity bit and stop bits at the
+ * configured baud rate, rounded up.
+ *
+ * @param config Serial port configuration
+ * @return Character time in microseconds (0 if the baud rate is invalid)
+ */
+int serial_config_char_time_us(const serial_config_t* config);
+
+/**
+ * @brief Compute the coalescing idle gap for a line configuration
+ *
+ * In SERIAL_READ_MODE_FIXED: SERIAL_COALESCE_IDLE_CHARS character times,
+ * but never less than SERIAL_COALESCE_MIN_IDLE_US. In
+ * SERIAL_READ_MODE_ADAPTIVE: one and a half character times, but never
+ * less than SERIAL_ADAPTIVE_MIN_IDLE_US, so a short message is flushed
+ * little more than one character time after its last byte.
+ *
+ * In SERIAL_READ_MODE_FRAME: the inter-frame gap, 3.5 character times
+ * (SERIAL_FRAME_FIXED_GAP_US above SERIAL_FRAME_FIXED_GAP_ABOVE baud).
+ *
+ * @param config Serial port configuration
+ * @return Idle gap in microseconds
+ */
+int serial_config_idle_gap_us(const serial_config_t* config);
+
+/**
+ * @brief Compute the longest a read burst may last
+ *
+ * coalesce_us, except in SERIAL_READ_MODE_FRAME: the time a frame of
+ * serial_config_read_chunk() bytes takes on the line plus the idle gap,
+ * so only the gap ends a frame and a slow line never splits one.
+ *
+ * @param config Serial port configuration
+ * @return Window in microseconds (0 = one read per burst)
+ */
+int serial_config_burst_window_us(const serial_config_t* config);
+
+/**
+ * @brief Compute how many bytes to collect per serial read burst
+ *
+ * In SERIAL_READ_MODE_FIXED this is coalesce_bytes (one frame). In
+ * SERIAL_READ_MODE_ADAPTIVE it is what the line delivers in
+ * SERIAL_ADAPTIVE_CHUNK_MS, clamped to SERIAL_READ_CHUNK_SIZE ..
+ * SERIAL_READ_CHUNK_MAX and never less than one frame, so a sustained
+ * stream is drained with few large reads and split into frames after.
+ * In SERIAL_READ_MODE_FRAME it is one frame again, so each device frame
+ * (up to coalesce_bytes) becomes one packet.
+ *
+ * @param config Serial port configuration
+ * @return Read size in bytes
+ */
+int serial_config_read_chunk(const serial_config_t* config);
+
 /**
  * @brief Write data to serial port
  *
@@ -74,6 +182,22 @@ int serial_port_read(int fd, void* buffer, int len, int timeout_ms);
  */
 int serial_port_write(int fd, const void* buffer, int len);
 
+/**
+ * @brief Write scattered data to serial port
+ *
+ * Gathers the regions into as few writev() calls as possible, e.g. the
+ * spans of a serial_buffer_peek(), so they go to the TTY without being
+ * copied into a contiguous buffer first. Blocks until all data is
+ * written or an error occurs.
+ *
+ * @param fd File descriptor
+ * @param iov Regions to write
+ * @param iovcnt Number of regions (1..SERIAL_PORT_WRITEV_MAX_IOV)
+ * @return Number of bytes written on success
+ *         Negative error code on failure
+ */
+int serial_port_writev(int fd, const struct iovec* iov, int iovcnt);
+
 /**
  * @brief Get error status from serial port
  *
@@ -10,10 +10,11 @@
 
 #include "connectors/serial/serial_protocol.h"
 #include "lib/common/definitions.h"
+#include "lib/protocol/crc32.h"
+#include "lib/protocol/payload_pool.h"
 
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
 #include <arpa/inet.h>  /* htons, ntohs for endianness conversion */
 
 /**
@@ -22,14 +23,35 @@
 int serial_protocol_encapsulate(const void* data, uint32_t len,
                                  uint16_t sequence, uint16_t flags,
                                  xoe_packet_t* packet)
+{
+    /* Validate parameters */
+    if (data == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    return serial_protocol_encapsulate_ack(data, len, sequence, 0,
+                                           (uint16_t)(flags & ~SERIAL_FLAG_ACK),
+                                           packet);
+}
+
+/**
+ * @brief Encapsulate serial data with a cumulative ACK
+ *
+ * Also the common path of serial_protocol_encapsulate(), which clears
+ * SERIAL_FLAG_ACK and so gets the plain 4-byte header.
+ */
+int serial_protocol_encapsulate_ack(const void* data, uint32_t len,
+                                     uint16_t sequence, uint16_t ack,
+                                     uint16_t flags, xoe_packet_t* packet)
 {
     xoe_payload_t* payload;
     serial_header_t* header;
     unsigned char* payload_data;
+    uint32_t header_size;
     uint32_t total_payload_size;
 
     /* Validate parameters */
-    if (data == NULL || packet == NULL) {
+    if (packet == NULL || (data == NULL && len > 0)) {
         return E_INVALID_ARGUMENT;
     }
 
@@ -38,36 +60,31 @@ int serial_protocol_encapsulate(const void* data, uint32_t len,
     }
 
     /* Calculate total payload size (header + data) */
-    total_payload_size = SERIAL_HEADER_SIZE + len;
+    header_size = (flags & SERIAL_FLAG_ACK) ? SERIAL_ACK_HEADER_SIZE
+                                            : SERIAL_HEADER_SIZE;
+    total_payload_size = header_size + len;
 
-    /* Allocate payload structure */
-    payload = (xoe_payload_t*)malloc(sizeof(xoe_payload_t));
+    /* Allocate payload (descriptor and data in one pooled block) */
+    payload = xoe_payload_alloc(total_payload_size);
     if (payload == NULL) {
         return E_OUT_OF_MEMORY;
     }
-
-    /* Allocate payload data buffer */
-    payload_data = (unsigned char*)malloc(total_payload_size);
-    if (payload_data == NULL) {
-        free(payload);
-        return E_OUT_OF_MEMORY;
-    }
+    payload_data = (unsigned char*)payload->data;
 
     /* Build serial header (LIB-003 fix: network byte order) */
     header = (serial_header_t*)payload_data;
     header->flags = htons(flags);
     header->sequence = htons(sequence);
+    if (flags & SERIAL_FLAG_ACK) {
+        ack = htons(ack);
+        memcpy(payload_data + SERIAL_HEADER_SIZE, &ack, sizeof(ack));
+    }
 
     /* Copy serial data after header */
     if (len > 0) {
-        memcpy(payload_data + SERIAL_HEADER_SIZE, data, len);
+        memcpy(payload_data + header_size, data, len);
     }
 
-    /* Set payload fields */
-    payload->data = payload_data;
-    payload->len = total_payload_size;
-    payload->owns_data = TRUE;  /* We malloc'd this data */
-
     /* Set packet fields */
     packet->protocol_id = XOE_PROTOCOL_SERIAL;
     packet->protocol_version = XOE_PROTOCOL_SERIAL_VERSION;
@@ -77,6 +94,52 @@ int serial_protocol_encapsulate(const void* data, uint32_t len,
     return 0;
 }
 
+/**
+ * @brief Read a serial packet's header without copying its data
+ */
+int serial_protocol_peek(const xoe_packet_t* packet, uint16_t* flags,
+                         uint16_t* sequence, uint16_t* ack,
+                         const unsigned char** data, uint32_t* data_len)
+{
+    const serial_header_t* header;
+    const unsigned char* payload_data;
+    uint32_t header_size = SERIAL_HEADER_SIZE;
+    uint16_t wire_ack = 0;
+
+    if (packet == NULL || flags == NULL || sequence == NULL || ack == NULL ||
+        data == NULL || data_len == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (packet->payload == NULL || packet->payload->data == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (packet->protocol_id != XOE_PROTOCOL_SERIAL ||
+        packet->payload->len < SERIAL_HEADER_SIZE) {
+        return E_INVALID_STATE;
+    }
+
+    payload_data = (const unsigned char*)packet->payload->data;
+    header = (const serial_header_t*)payload_data;
+    *flags = ntohs(header->flags);
+    *sequence = ntohs(header->sequence);
+
+    if (*flags & SERIAL_FLAG_ACK) {
+        header_size = SERIAL_ACK_HEADER_SIZE;
+        if (packet->payload->len < header_size) {
+            return E_INVALID_STATE;
+        }
+        memcpy(&wire_ack, payload_data + SERIAL_HEADER_SIZE, sizeof(wire_ack));
+    }
+
+    *ack = ntohs(wire_ack);
+    *data = payload_data + header_size;
+    *data_len = packet->payload->len - header_size;
+
+    return 0;
+}
+
 /**
  * @brief Decapsulate XOE packet to serial data
  */
@@ -84,15 +147,40 @@ int serial_protocol_decapsulate(const xoe_packet_t* packet,
                                  void* data, uint32_t max_len,
                                  uint32_t* actual_len,
                                  uint16_t* sequence, uint16_t* flags)
+{
+    struct iovec iov;
+
+    if (data == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    iov.iov_base = data;
+    iov.iov_len = max_len;
+    return serial_protocol_decapsulate_iov(packet, &iov, 1, actual_len,
+                                           sequence, flags);
+}
+
+/**
+ * @brief Decapsulate XOE packet into scattered output regions
+ */
+int serial_protocol_decapsulate_iov(const xoe_packet_t* packet,
+                                     const struct iovec* iov, int iovcnt,
+                                     uint32_t* actual_len,
+                                     uint16_t* sequence, uint16_t* flags)
 {
     const serial_header_t* header;
     const unsigned char* payload_data;
+    uint32_t header_size;
     uint32_t data_len;
+    uint32_t space;
+    uint32_t offset;
+    uint32_t chunk;
     int result;
+    int i;
 
     /* Validate parameters */
-    if (packet == NULL || data == NULL || actual_len == NULL ||
-        sequence == NULL || flags == NULL) {
+    if (packet == NULL || actual_len == NULL || sequence == NULL ||
+        flags == NULL || iovcnt < 0 || (iovcnt > 0 && iov == NULL)) {
         return E_INVALID_ARGUMENT;
     }
 
@@ -120,11 +208,24 @@ int serial_protocol_decapsulate(const xoe_packet_t* packet,
     payload_data = (const unsigned char*)packet->payload->data;
     header = (const serial_header_t*)payload_data;
 
+    /* Skip the cumulative ACK of a resumable session */
+    header_size = SERIAL_HEADER_SIZE;
+    if (ntohs(header->flags) & SERIAL_FLAG_ACK) {
+        header_size = SERIAL_ACK_HEADER_SIZE;
+        if (packet->payload->len < header_size) {
+            return E_INVALID_STATE;
+        }
+    }
+
     /* Calculate actual data length */
-    data_len = packet->payload->len - SERIAL_HEADER_SIZE;
+    data_len = packet->payload->len - header_size;
 
-    /* Check if output buffer is large enough */
-    if (data_len > max_len) {
+    /* Check if the output regions are large enough */
+    space = 0;
+    for (i = 0; i < iovcnt; i++) {
+        space += (uint32_t)iov[i].iov_len;
+    }
+    if (data_len > space) {
         return E_BUFFER_TOO_SMALL;
     }
 
@@ -133,9 +234,16 @@ int serial_protocol_decapsulate(const xoe_packet_t* packet,
     *flags = ntohs(header->flags);
     *actual_len = data_len;
 
-    /* Copy data to output buffer */
-    if (data_len > 0) {
-        memcpy(data, payload_data + SERIAL_HEADER_SIZE, data_len);
+    /* Copy data across the output regions */
+    payload_data += header_size;
+    offset = 0;
+    for (i = 0; i < iovcnt && offset < data_len; i++) {
+        chunk = data_len - offset;
+        if (chunk > (uint32_t)iov[i].iov_len) {
+            chunk = (uint32_t)iov[i].iov_len;
+        }
+        memcpy(iov[i].iov_base, payload_data + offset, chunk);
+        offset += chunk;
     }
 
     return 0;
@@ -146,25 +254,18 @@ int serial_protocol_decapsulate(const xoe_packet_t* packet,
  */
 uint32_t serial_protocol_checksum(const xoe_packet_t* packet)
 {
-    uint32_t checksum = 0;
-
-    uint8_t header_bytes[4];
+    uint32_t checksum;
 
     if (packet == NULL || packet->payload == NULL ||
         packet->payload->data == NULL) {
         return 0;
     }
 
-    /* Build header bytes for CRC calculation (SER-001 fix) */
-    header_bytes[0] = (uint8_t)(packet->protocol_id >> 8);
-    header_bytes[1] = (uint8_t)(packet->protocol_id);
-    header_bytes[2] = (uint8_t)(packet->protocol_version >> 8);
-    header_bytes[3] = (uint8_t)(packet->protocol_version);
-
-    /* CRC32 over header fields + payload */
-    checksum = (uint32_t)crc32(0L, header_bytes, 4);
-    checksum = (uint32_t)crc32(checksum, (const Bytef*)packet->payload->data,
-                               packet->payload->len);
+    /* CRC32 over header fields (network byte order, SER-001 fix) + payload */
+    checksum = xoe_crc32_be16(0, packet->protocol_id);
+    checksum = xoe_crc32_be16(checksum, packet->protocol_version);
+    checksum = xoe_crc32_update(checksum, packet->payload->data,
+                                packet->payload->len);
 
     return checksum;
 }
@@ -196,6 +297,7 @@ int serial_protocol_validate_checksum(const xoe_packet_t* packet)
  * If owns_data is TRUE, the data buffer was malloc'd and will be freed.
  * If owns_data is FALSE, the data buffer is managed externally (e.g., stack
  * variable) and must not be freed.
+ * If owns_data is XOE_PAYLOAD_POOLED, the block returns to the payload pool.
  */
 void serial_protocol_free_payload(xoe_packet_t* packet)
 {
@@ -204,12 +306,8 @@ void serial_protocol_free_payload(xoe_packet_t* packet)
     }
 
     if (packet->payload != NULL) {
-        /* Only free data buffer if this payload owns it */
-        if (packet->payload->owns_data && packet->payload->data != NULL) {
-            free(packet->payload->data);
-            packet->payload->data = NULL;
-        }
-        free(packet->payload);
+        /* Honors owns_data: pooled, malloc'd or borrowed data */
+        xoe_payload_release(packet->payload);
         packet->payload = NULL;
     }
 }
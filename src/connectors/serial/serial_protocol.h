@@ -13,6 +13,7 @@
 #define SERIAL_PROTOCOL_H
 
 #include "lib/protocol/protocol.h"
+#include <sys/uio.h>
 
 /* Protocol ID for serial protocol */
 #define XOE_PROTOCOL_SERIAL 0x0001
@@ -24,18 +25,33 @@
 /* Serial protocol header size (flags + sequence) */
 #define SERIAL_HEADER_SIZE 4
 
+/* Header size with SERIAL_FLAG_ACK (flags + sequence + ack) */
+#define SERIAL_ACK_HEADER_SIZE 6
+
 /* Serial protocol flags */
 #define SERIAL_FLAG_PARITY_ERROR  0x0001
 #define SERIAL_FLAG_FRAMING_ERROR 0x0002
 #define SERIAL_FLAG_OVERRUN_ERROR 0x0004
 #define SERIAL_FLAG_XON           0x0010
 #define SERIAL_FLAG_XOFF          0x0020
+/* Resumable sessions (serial_session.h), only after negotiating
+ * XOE_WIRE_FEATURE_SERIAL_RESUME: the header is followed by a 16-bit
+ * cumulative ACK, and RESUME marks a session open/resume control frame */
+#define SERIAL_FLAG_ACK           0x0040
+#define SERIAL_FLAG_RESUME        0x0080
+/* Reliable datagram channels (serial_dgram.h): a pure ACK whose data is
+ * a bitmap of the frames received beyond the cumulative ACK */
+#define SERIAL_FLAG_SACK          0x0100
+/* Routing hub (serial_hub.h): a control frame joining a topic, and the
+ * server's answer */
+#define SERIAL_FLAG_HUB           0x0200
 
 /**
  * @brief Serial protocol packet header
  *
  * This header is prepended to the actual serial data within the
- * xoe_payload_t structure.
+ * xoe_payload_t structure. With SERIAL_FLAG_ACK it is followed by the
+ * 16-bit cumulative ACK (network byte order) before the data.
  */
 typedef struct {
     uint16_t flags;     /* Status and error flags */
@@ -63,6 +79,43 @@ int serial_protocol_encapsulate(const void* data, uint32_t len,
                                  uint16_t sequence, uint16_t flags,
                                  xoe_packet_t* packet);
 
+/**
+ * @brief Encapsulate serial data with a cumulative ACK
+ *
+ * Like serial_protocol_encapsulate(), with SERIAL_FLAG_ACK set and @p ack
+ * (the next sequence expected from the peer) in the header.
+ *
+ * @param data Serial data (may be NULL when @p len is 0)
+ * @param len Length of serial data (max SERIAL_MAX_PAYLOAD_SIZE bytes)
+ * @param sequence Sequence number for this packet
+ * @param ack Cumulative ACK
+ * @param flags Status flags
+ * @param packet Output parameter for encapsulated packet
+ * @return 0 on success, negative error code as serial_protocol_encapsulate()
+ */
+int serial_protocol_encapsulate_ack(const void* data, uint32_t len,
+                                     uint16_t sequence, uint16_t ack,
+                                     uint16_t flags, xoe_packet_t* packet);
+
+/**
+ * @brief Read a serial packet's header without copying its data
+ *
+ * Does not validate the checksum (xoe_wire_recv() already checked the
+ * frame CRC).
+ *
+ * @param packet Received packet
+ * @param flags Output: status flags
+ * @param sequence Output: sequence number
+ * @param ack Output: cumulative ACK, 0 without SERIAL_FLAG_ACK
+ * @param data Output: start of the serial data
+ * @param data_len Output: serial data length
+ * @return 0 on success, E_INVALID_ARGUMENT for NULL pointers,
+ *         E_INVALID_STATE for a foreign or truncated packet
+ */
+int serial_protocol_peek(const xoe_packet_t* packet, uint16_t* flags,
+                         uint16_t* sequence, uint16_t* ack,
+                         const unsigned char** data, uint32_t* data_len);
+
 /**
  * @brief Decapsulate XOE packet to serial data
  *
@@ -85,6 +138,29 @@ int serial_protocol_decapsulate(const xoe_packet_t* packet,
                                  uint32_t* actual_len,
                                  uint16_t* sequence, uint16_t* flags);
 
+/**
+ * @brief Decapsulate XOE packet into scattered output regions
+ *
+ * Same validation as serial_protocol_decapsulate(), but the data is
+ * copied across the given regions in order, e.g. the free spans of a
+ * serial_buffer_reserve() call, so it lands in its destination directly.
+ *
+ * @param packet Input packet to decapsulate
+ * @param iov Output regions
+ * @param iovcnt Number of output regions (may be 0 for control frames)
+ * @param actual_len Output parameter for actual data length
+ * @param sequence Output parameter for packet sequence number
+ * @param flags Output parameter for status flags
+ * @return 0 on success, negative error code on failure
+ *         E_INVALID_ARGUMENT - NULL pointer or invalid parameters
+ *         E_BUFFER_TOO_SMALL - Regions too small for the data
+ *         E_INVALID_STATE - Protocol mismatch or checksum failure
+ */
+int serial_protocol_decapsulate_iov(const xoe_packet_t* packet,
+                                     const struct iovec* iov, int iovcnt,
+                                     uint32_t* actual_len,
+                                     uint16_t* sequence, uint16_t* flags);
+
 /**
  * @brief Calculate checksum for serial packet
  *
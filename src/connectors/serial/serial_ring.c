@@ -0,0 +1,214 @@
+/**
+ * @file serial_ring.c
+ * @brief Lock-free single-producer/single-consumer byte ring
+ *
+ * The producer fills the free region (reserve), then publishes the new
+ * head with a release store (commit); the consumer's acquire load of head
+ * therefore sees the written bytes. Reads mirror this through tail
+ * (peek, consume). The copying read and write are built on the spans.
+ *
+ * [LLM-ASSISTED]
+ */
+
+#include "connectors/serial/serial_ring.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initialize a ring
+ */
+int serial_ring_init(serial_ring_t* ring, uint32_t capacity)
+{
+    uint32_t size;
+
+    if (ring == NULL || capacity == 0 || capacity > SERIAL_RING_MAX_CAPACITY) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Round storage up to a power of two for mask indexing */
+    size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    memset(ring, 0, sizeof(serial_ring_t));
+    ring->data = (unsigned char*)malloc(size);
+    if (ring->data == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    ring->size = size;
+    ring->mask = size - 1;
+    ring->capacity = capacity;
+
+    return 0;
+}
+
+/**
+ * @brief Free the ring's storage
+ */
+void serial_ring_destroy(serial_ring_t* ring)
+{
+    if (ring == NULL) {
+        return;
+    }
+
+    free(ring->data);
+    ring->data = NULL;
+}
+
+/**
+ * @brief Describe len bytes starting at a ring position
+ */
+static int serial_ring_spans(const serial_ring_t* ring, uint32_t position,
+                             uint32_t len,
+                             struct iovec spans[SERIAL_RING_MAX_SPANS])
+{
+    uint32_t offset;
+    uint32_t first;
+
+    if (len == 0) {
+        return 0;
+    }
+
+    offset = position & ring->mask;
+    first = ring->size - offset;
+    if (first >= len) {
+        spans[0].iov_base = ring->data + offset;
+        spans[0].iov_len = len;
+        return 1;
+    }
+
+    /* Region wraps: tail of storage, then its start */
+    spans[0].iov_base = ring->data + offset;
+    spans[0].iov_len = first;
+    spans[1].iov_base = ring->data;
+    spans[1].iov_len = len - first;
+    return 2;
+}
+
+/**
+ * @brief Copy as much data as fits into the ring (producer only)
+ */
+uint32_t serial_ring_write(serial_ring_t* ring, const void* data, uint32_t len)
+{
+    const unsigned char* src = (const unsigned char*)data;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count;
+    int i;
+
+    len = serial_ring_reserve(ring, len, spans, &span_count);
+    for (i = 0; i < span_count; i++) {
+        memcpy(spans[i].iov_base, src, spans[i].iov_len);
+        src += spans[i].iov_len;
+    }
+    serial_ring_commit(ring, len);
+    return len;
+}
+
+/**
+ * @brief Copy out up to max_len queued bytes (consumer only)
+ */
+uint32_t serial_ring_read(serial_ring_t* ring, void* data, uint32_t max_len)
+{
+    unsigned char* dst = (unsigned char*)data;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    int span_count;
+    int i;
+
+    max_len = serial_ring_peek(ring, max_len, spans, &span_count);
+    for (i = 0; i < span_count; i++) {
+        memcpy(dst, spans[i].iov_base, spans[i].iov_len);
+        dst += spans[i].iov_len;
+    }
+    serial_ring_consume(ring, max_len);
+    return max_len;
+}
+
+/* ============================================================================
+ * Span Access
+ * ============================================================================ */
+
+/**
+ * @brief Expose queued bytes as contiguous spans (consumer only)
+ */
+uint32_t serial_ring_peek(const serial_ring_t* ring, uint32_t max_len,
+                          struct iovec spans[SERIAL_RING_MAX_SPANS],
+                          int* span_count)
+{
+    uint32_t queued;
+
+    /* tail is ours; head is published by the producer */
+    queued = SERIAL_ATOMIC_LOAD(&ring->head) - ring->tail;
+    if (max_len > queued) {
+        max_len = queued;
+    }
+
+    *span_count = serial_ring_spans(ring, ring->tail, max_len, spans);
+    return max_len;
+}
+
+/**
+ * @brief Release bytes exposed by serial_ring_peek() (consumer only)
+ */
+void serial_ring_consume(serial_ring_t* ring, uint32_t len)
+{
+    if (len > 0) {
+        SERIAL_ATOMIC_STORE(&ring->tail, ring->tail + len);
+    }
+}
+
+/**
+ * @brief Expose free space as contiguous spans (producer only)
+ */
+uint32_t serial_ring_reserve(const serial_ring_t* ring, uint32_t max_len,
+                             struct iovec spans[SERIAL_RING_MAX_SPANS],
+                             int* span_count)
+{
+    uint32_t space;
+
+    /* head is ours; tail is published by the consumer */
+    space = ring->capacity - (ring->head - SERIAL_ATOMIC_LOAD(&ring->tail));
+    if (max_len > space) {
+        max_len = space;
+    }
+
+    *span_count = serial_ring_spans(ring, ring->head, max_len, spans);
+    return max_len;
+}
+
+/**
+ * @brief Publish bytes written into serial_ring_reserve() spans (producer only)
+ */
+void serial_ring_commit(serial_ring_t* ring, uint32_t len)
+{
+    if (len > 0) {
+        SERIAL_ATOMIC_STORE(&ring->head, ring->head + len);
+    }
+}
+
+/**
+ * @brief Get number of queued bytes
+ */
+uint32_t serial_ring_available(const serial_ring_t* ring)
+{
+    uint32_t tail;
+    uint32_t queued;
+
+    /*
+     * Load tail first so the difference cannot underflow; a third thread
+     * racing both endpoints may overshoot, so clamp to the capacity.
+     */
+    tail = SERIAL_ATOMIC_LOAD(&ring->tail);
+    queued = SERIAL_ATOMIC_LOAD(&ring->head) - tail;
+    return (queued > ring->capacity) ? ring->capacity : queued;
+}
+
+/**
+ * @brief Get free space
+ */
+uint32_t serial_ring_free_space(const serial_ring_t* ring)
+{
+    return ring->capacity - serial_ring_available(ring);
+}
@@ -0,0 +1,172 @@
+/**
+ * @file serial_ring.h
+ * @brief Lock-free single-producer/single-consumer byte ring
+ *
+ * A bounded byte queue with exactly one writer thread and one reader
+ * thread. The writer only advances head and the reader only advances
+ * tail, so neither side takes a lock: each publishes its index with a
+ * release store and observes the other's with an acquire load.
+ *
+ * Indices are free-running 32-bit counters; the storage is rounded up
+ * to a power of two so a position maps to a slot with a mask. The
+ * usable capacity stays exactly what the caller asked for.
+ *
+ * Besides copying reads and writes, the ring exposes its free and filled
+ * regions as one or two contiguous spans (two when the region wraps past
+ * the end of storage), so callers can writev() straight from it or
+ * decode straight into it and then commit.
+ *
+ * Operations never block. serial_buffer_t layers blocking reads and
+ * writes on top.
+ *
+ * [LLM-ASSISTED]
+ */
+
+#ifndef SERIAL_RING_H
+#define SERIAL_RING_H
+
+#include "lib/protocol/protocol.h"
+#include <sys/uio.h>
+
+/* Assumed cache line size, used to keep head and tail apart */
+#define SERIAL_RING_CACHE_LINE 64
+
+/* Largest supported capacity (storage must fit a 32-bit power of two) */
+#define SERIAL_RING_MAX_CAPACITY 0x80000000UL
+
+/* Spans needed to describe any ring region (split at the wrap point) */
+#define SERIAL_RING_MAX_SPANS 2
+
+/*
+ * Atomic accessors for fields shared between the two threads.
+ *
+ * The tree is C99 without <stdatomic.h>; these use the GCC/Clang
+ * __atomic builtins that both supported compilers provide.
+ */
+#define SERIAL_ATOMIC_LOAD(ptr)       __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define SERIAL_ATOMIC_STORE(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define SERIAL_ATOMIC_FENCE()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+/**
+ * @brief SPSC ring state
+ *
+ * head is written only by the producer and tail only by the consumer;
+ * each sits on its own cache line so the two threads do not contend.
+ */
+typedef struct {
+    unsigned char* data;      /* Storage (size bytes) */
+    uint32_t size;            /* Storage size, a power of two */
+    uint32_t mask;            /* size - 1 */
+    uint32_t capacity;        /* Usable bytes, <= size */
+    char pad0[SERIAL_RING_CACHE_LINE];
+
+    uint32_t head;            /* Bytes ever written (producer) */
+    char pad1[SERIAL_RING_CACHE_LINE - sizeof(uint32_t)];
+
+    uint32_t tail;            /* Bytes ever read (consumer) */
+    char pad2[SERIAL_RING_CACHE_LINE - sizeof(uint32_t)];
+} serial_ring_t;
+
+/**
+ * @brief Initialize a ring
+ *
+ * @param ring Ring to initialize
+ * @param capacity Usable capacity in bytes (1 to SERIAL_RING_MAX_CAPACITY)
+ * @return 0 on success, negative error code on failure
+ *         E_INVALID_ARGUMENT - NULL pointer or capacity out of range
+ *         E_OUT_OF_MEMORY - Memory allocation failed
+ */
+int serial_ring_init(serial_ring_t* ring, uint32_t capacity);
+
+/**
+ * @brief Free the ring's storage
+ *
+ * @param ring Ring (may be NULL)
+ */
+void serial_ring_destroy(serial_ring_t* ring);
+
+/**
+ * @brief Copy as much data as fits into the ring (producer only)
+ *
+ * @param ring Ring
+ * @param data Data to write
+ * @param len Number of bytes offered
+ * @return Number of bytes written (0 if the ring is full)
+ */
+uint32_t serial_ring_write(serial_ring_t* ring, const void* data, uint32_t len);
+
+/**
+ * @brief Copy out up to max_len queued bytes (consumer only)
+ *
+ * @param ring Ring
+ * @param data Output buffer
+ * @param max_len Maximum number of bytes to read
+ * @return Number of bytes read (0 if the ring is empty)
+ */
+uint32_t serial_ring_read(serial_ring_t* ring, void* data, uint32_t max_len);
+
+/**
+ * @brief Get number of queued bytes
+ *
+ * Exact when called by either endpoint; a snapshot from other threads.
+ *
+ * @param ring Ring
+ * @return Number of bytes available to read
+ */
+uint32_t serial_ring_available(const serial_ring_t* ring);
+
+/**
+ * @brief Get free space
+ *
+ * @param ring Ring
+ * @return Number of bytes that can be written
+ */
+uint32_t serial_ring_free_space(const serial_ring_t* ring);
+
+/**
+ * @brief Expose queued bytes as contiguous spans (consumer only)
+ *
+ * The data stays queued until serial_ring_consume().
+ *
+ * @param ring Ring
+ * @param max_len Maximum number of bytes to expose
+ * @param spans Filled with up to SERIAL_RING_MAX_SPANS regions
+ * @param span_count Set to the number of spans filled (0 if empty)
+ * @return Number of bytes exposed
+ */
+uint32_t serial_ring_peek(const serial_ring_t* ring, uint32_t max_len,
+                          struct iovec spans[SERIAL_RING_MAX_SPANS],
+                          int* span_count);
+
+/**
+ * @brief Release bytes exposed by serial_ring_peek() (consumer only)
+ *
+ * @param ring Ring
+ * @param len Number of bytes consumed (at most the peeked length)
+ */
+void serial_ring_consume(serial_ring_t* ring, uint32_t len);
+
+/**
+ * @brief Expose free space as contiguous spans (producer only)
+ *
+ * Bytes written into the spans become visible at serial_ring_commit().
+ *
+ * @param ring Ring
+ * @param max_len Maximum number of bytes to expose
+ * @param spans Filled with up to SERIAL_RING_MAX_SPANS regions
+ * @param span_count Set to the number of spans filled (0 if full)
+ * @return Number of bytes exposed
+ */
+uint32_t serial_ring_reserve(const serial_ring_t* ring, uint32_t max_len,
+                             struct iovec spans[SERIAL_RING_MAX_SPANS],
+                             int* span_count);
+
+/**
+ * @brief Publish bytes written into serial_ring_reserve() spans (producer only)
+ *
+ * @param ring Ring
+ * @param len Number of bytes written (at most the reserved length)
+ */
+void serial_ring_commit(serial_ring_t* ring, uint32_t len);
+
+#endif /* SERIAL_RING_H */
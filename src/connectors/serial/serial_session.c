@@ -0,0 +1,353 @@
+/**
+ * @file serial_session.c
+ * @brief Resumable serial session: retransmit window and cumulative ACKs
+ *
+ * Sequences are 16-bit and compared with serial-number arithmetic: the
+ * difference of two sequences, taken modulo 2^16, is "ahead" below 2^15
+ * and "behind" above. The window is far smaller than 2^15, so a valid
+ * ACK or sequence is never ambiguous. Stored frames are indexed by
+ * sequence modulo SERIAL_SESSION_WINDOW.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_session.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Parked sessions of disconnected clients (server) */
+static serial_session_t* g_parked[SERIAL_SESSION_PARK_MAX];
+static pthread_mutex_t g_parked_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Allocate a session with both directions starting at sequence 0
+ */
+serial_session_t* serial_session_create(uint64_t id)
+{
+    serial_session_t* session;
+
+    session = (serial_session_t*)malloc(sizeof(serial_session_t));
+    if (session == NULL) {
+        return NULL;
+    }
+
+    memset(session, 0, sizeof(serial_session_t));
+    session->id = id;
+    return session;
+}
+
+/**
+ * @brief Free a session
+ */
+void serial_session_destroy(serial_session_t* session)
+{
+    free(session);
+}
+
+/**
+ * @brief Forget both directions and restart at sequence 0, keeping the ID
+ */
+void serial_session_reset(serial_session_t* session)
+{
+    if (session == NULL) {
+        return;
+    }
+
+    session->tx_next = 0;
+    session->tx_acked = 0;
+    session->rx_next = 0;
+    session->rx_unacked = 0;
+}
+
+/**
+ * @brief Generate a random session ID
+ */
+uint64_t serial_session_new_id(void)
+{
+    struct timespec ts;
+    uint64_t id = 0;
+    FILE* random;
+
+    random = fopen("/dev/urandom", "rb");
+    if (random != NULL) {
+        if (fread(&id, sizeof(id), 1, random) != 1) {
+            id = 0;
+        }
+        fclose(random);
+    }
+
+    if (id == 0) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+        id = ((uint64_t)ts.tv_sec << 32) ^ (uint64_t)ts.tv_nsec ^
+             (uint64_t)(uintptr_t)&ts;
+    }
+
+    return (id != 0) ? id : 1;
+}
+
+/**
+ * @brief Number of data frames sent and not yet acknowledged
+ */
+int serial_session_unacked(const serial_session_t* session)
+{
+    return (uint16_t)(session->tx_next - session->tx_acked);
+}
+
+/**
+ * @brief Check whether the window has room for another data frame
+ */
+int serial_session_window_full(const serial_session_t* session)
+{
+    return (serial_session_unacked(session) >= SERIAL_SESSION_WINDOW)
+           ? TRUE : FALSE;
+}
+
+/**
+ * @brief Keep a copy of an outgoing data frame and assign its sequence
+ */
+int serial_session_store(serial_session_t* session, const void* data,
+                         uint32_t len, uint16_t flags, uint16_t* sequence)
+{
+    serial_session_frame_t* frame;
+
+    if (session == NULL || data == NULL || sequence == NULL ||
+        len == 0 || len > SERIAL_MAX_PAYLOAD_SIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (serial_session_window_full(session)) {
+        return E_WOULD_BLOCK;
+    }
+
+    frame = &session->frames[session->tx_next % SERIAL_SESSION_WINDOW];
+    frame->sequence = session->tx_next;
+    frame->flags = flags;
+    frame->len = (uint16_t)len;
+    memcpy(frame->data, data, len);
+
+    *sequence = session->tx_next;
+    session->tx_next++;
+    return 0;
+}
+
+/**
+ * @brief Apply a cumulative ACK from the peer
+ */
+int serial_session_ack(serial_session_t* session, uint16_t ack)
+{
+    uint16_t ahead = (uint16_t)(ack - session->tx_acked);
+
+    if (ahead <= serial_session_unacked(session)) {
+        session->tx_acked = ack;
+        return ahead;
+    }
+
+    /* Behind tx_acked: an ACK overtaken by a newer one */
+    if (ahead >= 0x8000U) {
+        return 0;
+    }
+
+    return E_PROTOCOL_ERROR;
+}
+
+/**
+ * @brief Classify an incoming data frame by its sequence
+ */
+int serial_session_accept(serial_session_t* session, uint16_t sequence)
+{
+    uint16_t ahead = (uint16_t)(sequence - session->rx_next);
+
+    if (ahead == 0) {
+        session->rx_next++;
+        session->rx_unacked++;
+        return SERIAL_SESSION_NEW;
+    }
+
+    if (ahead >= 0x8000U) {
+        session->duplicates++;
+        return SERIAL_SESSION_DUPLICATE;
+    }
+
+    return E_PROTOCOL_ERROR;
+}
+
+/**
+ * @brief ACK to put in an outgoing frame; resets the pure ACK countdown
+ */
+uint16_t serial_session_take_ack(serial_session_t* session)
+{
+    session->rx_unacked = 0;
+    return session->rx_next;
+}
+
+/**
+ * @brief Check whether enough frames arrived to send a pure ACK
+ */
+int serial_session_ack_due(const serial_session_t* session)
+{
+    return (session->rx_unacked >= SERIAL_SESSION_ACK_EVERY) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Stored frame to retransmit
+ */
+const serial_session_frame_t* serial_session_frame(const serial_session_t* session,
+                                                   int index)
+{
+    uint16_t sequence;
+
+    if (index < 0 || index >= serial_session_unacked(session)) {
+        return NULL;
+    }
+
+    sequence = (uint16_t)(session->tx_acked + index);
+    return &session->frames[sequence % SERIAL_SESSION_WINDOW];
+}
+
+/**
+ * @brief Build a RESUME frame
+ */
+int serial_session_resume_frame(serial_session_t* session, int status,
+                                uint16_t flags, xoe_packet_t* packet)
+{
+    unsigned char payload[SERIAL_SESSION_RESUME_SIZE];
+    int i;
+
+    if (session == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i < 8; i++) {
+        payload[i] = (unsigned char)(session->id >> (56 - 8 * i));
+    }
+    payload[8] = (unsigned char)status;
+
+    return serial_protocol_encapsulate_ack(payload, sizeof(payload),
+                                           session->tx_next,
+                                           serial_session_take_ack(session),
+                                           (uint16_t)(flags | SERIAL_FLAG_ACK |
+                                                      SERIAL_FLAG_RESUME),
+                                           packet);
+}
+
+/**
+ * @brief Parse a RESUME payload
+ */
+int serial_session_resume_parse(const unsigned char* data, uint32_t len,
+                                uint64_t* id, int* status)
+{
+    uint64_t value = 0;
+    int i;
+
+    if (data == NULL || id == NULL || status == NULL ||
+        len != SERIAL_SESSION_RESUME_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    for (i = 0; i < 8; i++) {
+        value = (value << 8) | data[i];
+    }
+    if (value == 0 || data[8] > SERIAL_SESSION_RESUMED) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    *id = value;
+    *status = data[8];
+    return 0;
+}
+
+/**
+ * @brief Free parked sessions older than the linger time
+ *
+ * Caller holds g_parked_lock.
+ */
+static void park_expire(uint64_t now)
+{
+    int i;
+
+    for (i = 0; i < SERIAL_SESSION_PARK_MAX; i++) {
+        if (g_parked[i] != NULL &&
+            now - g_parked[i]->parked_at_ms >= SERIAL_SESSION_LINGER_MS) {
+            serial_session_destroy(g_parked[i]);
+            g_parked[i] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Keep a disconnected session for its client to resume
+ */
+void serial_session_park(serial_session_t* session)
+{
+    uint64_t now = latency_now_ms();
+    int slot = -1;
+    int i;
+
+    if (session == NULL) {
+        return;
+    }
+    session->parked_at_ms = now;
+
+    pthread_mutex_lock(&g_parked_lock);
+    park_expire(now);
+
+    for (i = 0; i < SERIAL_SESSION_PARK_MAX; i++) {
+        if (g_parked[i] == NULL) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 ||
+            g_parked[i]->parked_at_ms < g_parked[slot]->parked_at_ms) {
+            slot = i;
+        }
+    }
+
+    /* Table full: the session parked longest gives way */
+    serial_session_destroy(g_parked[slot]);
+    g_parked[slot] = session;
+    pthread_mutex_unlock(&g_parked_lock);
+}
+
+/**
+ * @brief Take a parked session back
+ */
+serial_session_t* serial_session_unpark(uint64_t id)
+{
+    serial_session_t* session = NULL;
+    int i;
+
+    pthread_mutex_lock(&g_parked_lock);
+    park_expire(latency_now_ms());
+
+    for (i = 0; i < SERIAL_SESSION_PARK_MAX; i++) {
+        if (g_parked[i] != NULL && g_parked[i]->id == id) {
+            session = g_parked[i];
+            g_parked[i] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_parked_lock);
+
+    return session;
+}
+
+/**
+ * @brief Free every parked session
+ */
+void serial_session_park_flush(void)
+{
+    int i;
+
+    pthread_mutex_lock(&g_parked_lock);
+    for (i = 0; i < SERIAL_SESSION_PARK_MAX; i++) {
+        serial_session_destroy(g_parked[i]);
+        g_parked[i] = NULL;
+    }
+    pthread_mutex_unlock(&g_parked_lock);
+}
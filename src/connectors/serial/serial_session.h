@@ -0,0 +1,234 @@
+/**
+ * @file serial_session.h
+ * @brief Resumable serial session: retransmit window and cumulative ACKs
+ *
+ * On a connection that negotiated XOE_WIRE_FEATURE_SERIAL_RESUME, every
+ * serial frame carries SERIAL_FLAG_ACK and a cumulative ACK in its header
+ * (the next sequence the sender expects, see serial_protocol.h), and each
+ * side keeps the data frames the peer has not acknowledged yet in a
+ * window of SERIAL_SESSION_WINDOW frames. Control-only frames (XON/XOFF,
+ * pure ACKs) carry no sequence of their own and are never retransmitted.
+ *
+ * The client opens the session with a SERIAL_FLAG_RESUME control frame
+ * carrying a random 64-bit session ID. When the connection drops, the
+ * server parks the session for SERIAL_SESSION_LINGER_MS and the client
+ * reconnects with exponential backoff and sends the same ID again. Each
+ * side's RESUME header acknowledges what it received, so after one round
+ * trip both retransmit exactly the frames the other is missing, and the
+ * receiver drops the duplicates of frames it already had. Nothing written
+ * to the TTY is lost or repeated.
+ *
+ * A session is not thread-safe; its owner serializes every call (the
+ * serial client's send_mutex, the server's event loop worker).
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERIAL_SESSION_H
+#define SERIAL_SESSION_H
+
+#include "connectors/serial/serial_protocol.h"
+
+/* Unacknowledged data frames a side may have outstanding */
+#define SERIAL_SESSION_WINDOW 64
+
+/* A receiver sends a pure ACK after this many frames without replying */
+#define SERIAL_SESSION_ACK_EVERY (SERIAL_SESSION_WINDOW / 4)
+
+/* How long the server keeps a disconnected session for its client */
+#define SERIAL_SESSION_LINGER_MS 60000
+
+/* Parked sessions the server keeps at most (oldest dropped first) */
+#define SERIAL_SESSION_PARK_MAX 64
+
+/* Client reconnect backoff: first retry, and cap of the doubling */
+#define SERIAL_RECONNECT_MIN_MS 100
+#define SERIAL_RECONNECT_MAX_MS 5000
+
+/* RESUME payload: session ID (8, big-endian) + status (1) */
+#define SERIAL_SESSION_RESUME_SIZE 9
+
+/* RESUME status, set by the server in its reply */
+#define SERIAL_SESSION_OPENED  0    /* New session (any old one is gone) */
+#define SERIAL_SESSION_RESUMED 1    /* Parked session picked up */
+
+/* serial_session_accept() results */
+#define SERIAL_SESSION_DUPLICATE 0  /* Already received: drop it */
+#define SERIAL_SESSION_NEW       1  /* Next in order: deliver it */
+
+/**
+ * @brief Unacknowledged data frame
+ */
+typedef struct {
+    uint16_t sequence;
+    uint16_t flags;
+    uint16_t len;
+    unsigned char data[SERIAL_MAX_PAYLOAD_SIZE];
+} serial_session_frame_t;
+
+/**
+ * @brief Session state (about 66 KB; allocate with serial_session_create())
+ */
+typedef struct serial_session {
+    uint64_t id;
+    uint16_t tx_next;           /* Sequence of the next data frame */
+    uint16_t tx_acked;          /* Oldest unacknowledged sequence */
+    uint16_t rx_next;           /* Next sequence expected from the peer */
+    int rx_unacked;             /* Frames received since an ACK was sent */
+    uint64_t parked_at_ms;      /* When the server parked it */
+    uint64_t retransmitted;     /* Frames sent again after a resume */
+    uint64_t duplicates;        /* Retransmitted frames already received */
+    serial_session_frame_t frames[SERIAL_SESSION_WINDOW]; /* By sequence */
+} serial_session_t;
+
+/**
+ * @brief Allocate a session with both directions starting at sequence 0
+ *
+ * @param id Session ID (serial_session_new_id() on the client)
+ * @return New session, or NULL if out of memory
+ */
+serial_session_t* serial_session_create(uint64_t id);
+
+/**
+ * @brief Free a session (NULL is ignored)
+ */
+void serial_session_destroy(serial_session_t* session);
+
+/**
+ * @brief Forget both directions and restart at sequence 0, keeping the ID
+ *
+ * @param session Session
+ */
+void serial_session_reset(serial_session_t* session);
+
+/**
+ * @brief Generate a random session ID
+ *
+ * @return Non-zero ID from /dev/urandom, or from time and address if
+ *         that is unavailable
+ */
+uint64_t serial_session_new_id(void);
+
+/**
+ * @brief Number of data frames sent and not yet acknowledged
+ */
+int serial_session_unacked(const serial_session_t* session);
+
+/**
+ * @brief Check whether the window has room for another data frame
+ *
+ * @return TRUE if serial_session_store() would fail with E_WOULD_BLOCK
+ */
+int serial_session_window_full(const serial_session_t* session);
+
+/**
+ * @brief Keep a copy of an outgoing data frame and assign its sequence
+ *
+ * @param session Session
+ * @param data Frame data
+ * @param len Data length (1 to SERIAL_MAX_PAYLOAD_SIZE)
+ * @param flags Frame flags to resend with it
+ * @param sequence Output: the frame's sequence
+ * @return 0 on success, E_WOULD_BLOCK if the window is full,
+ *         E_INVALID_ARGUMENT for a bad length
+ */
+int serial_session_store(serial_session_t* session, const void* data,
+                         uint32_t len, uint16_t flags, uint16_t* sequence);
+
+/**
+ * @brief Apply a cumulative ACK from the peer
+ *
+ * Releases every stored frame before @p ack.
+ *
+ * @param session Session
+ * @param ack Next sequence the peer expects
+ * @return Frames released (0 for an old ACK), or E_PROTOCOL_ERROR if
+ *         @p ack acknowledges frames never sent
+ */
+int serial_session_ack(serial_session_t* session, uint16_t ack);
+
+/**
+ * @brief Classify an incoming data frame by its sequence
+ *
+ * @param session Session
+ * @param sequence The frame's sequence
+ * @return SERIAL_SESSION_NEW (counted as received), SERIAL_SESSION_DUPLICATE,
+ *         or E_PROTOCOL_ERROR if frames were skipped
+ */
+int serial_session_accept(serial_session_t* session, uint16_t sequence);
+
+/**
+ * @brief ACK to put in an outgoing frame; resets the pure ACK countdown
+ */
+uint16_t serial_session_take_ack(serial_session_t* session);
+
+/**
+ * @brief Check whether enough frames arrived to send a pure ACK
+ */
+int serial_session_ack_due(const serial_session_t* session);
+
+/**
+ * @brief Stored frame to retransmit
+ *
+ * @param session Session
+ * @param index 0 to serial_session_unacked() - 1, oldest first
+ * @return Frame, or NULL if @p index is out of range
+ */
+const serial_session_frame_t* serial_session_frame(const serial_session_t* session,
+                                                   int index);
+
+/**
+ * @brief Build a RESUME frame
+ *
+ * Sent by the client to open or resume a session, and by the server in
+ * reply. The header acknowledges what this side received.
+ *
+ * @param session Session
+ * @param status SERIAL_SESSION_OPENED or SERIAL_SESSION_RESUMED (the
+ *               client sends SERIAL_SESSION_OPENED)
+ * @param flags Extra flags, e.g. SERIAL_FLAG_XOFF while throttled
+ * @param packet Output packet (free with serial_protocol_free_payload())
+ * @return 0 on success, negative error code on failure
+ */
+int serial_session_resume_frame(serial_session_t* session, int status,
+                                uint16_t flags, xoe_packet_t* packet);
+
+/**
+ * @brief Parse a RESUME payload
+ *
+ * @param data Frame data (after the serial header)
+ * @param len Data length
+ * @param id Output: session ID
+ * @param status Output: SERIAL_SESSION_OPENED or SERIAL_SESSION_RESUMED
+ * @return 0 on success, E_PROTOCOL_ERROR if malformed
+ */
+int serial_session_resume_parse(const unsigned char* data, uint32_t len,
+                                uint64_t* id, int* status);
+
+/**
+ * @brief Keep a disconnected session for its client to resume (server)
+ *
+ * Sessions parked longer than SERIAL_SESSION_LINGER_MS are freed; when
+ * the table is full the oldest is. Thread-safe.
+ *
+ * @param session Session, owned by the table from now on
+ */
+void serial_session_park(serial_session_t* session);
+
+/**
+ * @brief Take a parked session back (server)
+ *
+ * Thread-safe.
+ *
+ * @param id Session ID from the client's RESUME frame
+ * @return The session (owned by the caller again), or NULL if unknown
+ *         or expired
+ */
+serial_session_t* serial_session_unpark(uint64_t id);
+
+/**
+ * @brief Free every parked session (server shutdown)
+ */
+void serial_session_park_flush(void);
+
+#endif /* SERIAL_SESSION_H */
@@ -0,0 +1,312 @@
+/*
+ * usb_batch.c - Batched URB Sends from the USB Client
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#include "usb_batch.h"
+#include "lib/common/definitions.h"
+#include "lib/common/stage_prof.h"
+#include "lib/protocol/wire_format.h"
+#include <string.h>
+
+/**
+ * @brief Write serialized URB bytes as one frame
+ */
+static int usb_batch_write(int fd, uint8_t* urb, uint32_t urb_len)
+{
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+
+    payload.data = urb;
+    payload.len = urb_len;
+    payload.owns_data = FALSE;
+
+    packet.protocol_id = XOE_PROTOCOL_USB;
+    packet.protocol_version = XOE_PROTOCOL_USB_VERSION;
+    packet.payload = &payload;
+    packet.checksum = 0;
+
+    return xoe_wire_send(fd, &packet);
+}
+
+/**
+ * @brief Write the pending batch, and any that fill up meanwhile
+ *
+ * Called with the lock held by the thread that set sending. A batch of
+ * one URB is written as that URB alone.
+ */
+static int usb_batch_flush_locked(usb_batch_t* batch, int fd)
+{
+    usb_urb_header_t header;
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    uint8_t* frame;
+    uint32_t used;
+    int count;
+    int result;
+
+    while (batch->count > 0 && !batch->failed) {
+        /* Take the batch; senders fill the other frame meanwhile */
+        frame = batch->frames[batch->fill];
+        used = batch->used;
+        count = batch->count;
+        batch->fill ^= 1;
+        batch->used = 0;
+        batch->count = 0;
+        pthread_cond_broadcast(&batch->idle);
+        pthread_mutex_unlock(&batch->lock);
+
+        if (count == 1) {
+            result = usb_batch_write(fd,
+                                     frame + USB_URB_HEADER_WIRE_SIZE +
+                                     USB_BATCH_ENTRY_HEADER_SIZE,
+                                     used - USB_BATCH_ENTRY_HEADER_SIZE);
+        } else {
+            memset(&header, 0, sizeof(header));
+            header.command = USB_CMD_BATCH;
+            header.number_of_packets = (uint16_t)count;
+            result = usb_protocol_encapsulate_in_place(&header, frame, used,
+                                                       &payload, &packet);
+            if (result == 0) {
+                result = xoe_wire_send(fd, &packet);
+            }
+        }
+
+        pthread_mutex_lock(&batch->lock);
+        if (result != 0) {
+            batch->failed = TRUE;
+            break;
+        }
+        batch->frames_sent++;
+        if (count > 1) {
+            batch->batches_sent++;
+            batch->batched_urbs += (unsigned long)count;
+            if (count > batch->largest_batch) {
+                batch->largest_batch = count;
+            }
+        }
+    }
+
+    return batch->failed ? E_NETWORK_ERROR : 0;
+}
+
+/**
+ * @brief Queue a small URB, writing it if the link is idle
+ */
+static int usb_batch_add(usb_batch_t* batch,
+                         int fd,
+                         const usb_urb_header_t* urb_header,
+                         const void* data,
+                         uint32_t data_len)
+{
+    STAGE_PROF_VAR(start);
+    int result;
+
+    STAGE_PROF_START(start);
+    pthread_mutex_lock(&batch->lock);
+
+    /* A full batch is always being flushed (count > 0 implies sending) */
+    while (!batch->failed &&
+           USB_BATCH_ENTRY_SIZE(data_len) > USB_BATCH_CAPACITY - batch->used) {
+        pthread_cond_wait(&batch->idle, &batch->lock);
+    }
+    STAGE_PROF_STOP(STAGE_SEND_LOCK_WAIT, start);
+    if (batch->failed) {
+        pthread_mutex_unlock(&batch->lock);
+        return E_NETWORK_ERROR;
+    }
+
+    result = usb_protocol_batch_append(
+        batch->frames[batch->fill] + USB_URB_HEADER_WIRE_SIZE,
+        USB_BATCH_CAPACITY, &batch->used, urb_header, data, data_len);
+    if (result != 0) {
+        pthread_mutex_unlock(&batch->lock);
+        return result;
+    }
+    batch->count++;
+
+    /* Link busy: the writing thread takes this batch when it is done */
+    if (batch->sending) {
+        pthread_mutex_unlock(&batch->lock);
+        return 0;
+    }
+
+    batch->sending = TRUE;
+    result = usb_batch_flush_locked(batch, fd);
+    batch->sending = FALSE;
+    pthread_cond_broadcast(&batch->idle);
+    pthread_mutex_unlock(&batch->lock);
+
+    return result;
+}
+
+/**
+ * @brief Write a framed URB on its own, after the URBs batched before it
+ */
+static int usb_batch_send_alone(usb_batch_t* batch,
+                                int fd,
+                                const xoe_packet_t* packet)
+{
+    STAGE_PROF_VAR(start);
+    int result;
+
+    STAGE_PROF_START(start);
+    pthread_mutex_lock(&batch->lock);
+    while (batch->sending && !batch->failed) {
+        pthread_cond_wait(&batch->idle, &batch->lock);
+    }
+    STAGE_PROF_STOP(STAGE_SEND_LOCK_WAIT, start);
+    if (batch->failed) {
+        pthread_mutex_unlock(&batch->lock);
+        return E_NETWORK_ERROR;
+    }
+    batch->sending = TRUE;
+
+    result = usb_batch_flush_locked(batch, fd);
+    if (result == 0) {
+        pthread_mutex_unlock(&batch->lock);
+        result = xoe_wire_send(fd, packet);
+        pthread_mutex_lock(&batch->lock);
+        if (result != 0) {
+            batch->failed = TRUE;
+        } else {
+            batch->frames_sent++;
+        }
+
+        /* URBs batched while this one was written */
+        result = usb_batch_flush_locked(batch, fd);
+    }
+
+    batch->sending = FALSE;
+    pthread_cond_broadcast(&batch->idle);
+    pthread_mutex_unlock(&batch->lock);
+
+    return result;
+}
+
+/**
+ * @brief Initialize a batcher (batching disabled)
+ */
+int usb_batch_init(usb_batch_t* batch)
+{
+    if (batch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(batch, 0, sizeof(*batch));
+
+    if (pthread_mutex_init(&batch->lock, NULL) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    if (pthread_cond_init(&batch->idle, NULL) != 0) {
+        pthread_mutex_destroy(&batch->lock);
+        return E_UNKNOWN_ERROR;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Release a batcher
+ */
+void usb_batch_cleanup(usb_batch_t* batch)
+{
+    if (batch == NULL) {
+        return;
+    }
+
+    pthread_cond_destroy(&batch->idle);
+    pthread_mutex_destroy(&batch->lock);
+}
+
+/**
+ * @brief Allow USB_CMD_BATCH frames
+ */
+void usb_batch_set_enabled(usb_batch_t* batch, int enabled)
+{
+    if (batch == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    batch->enabled = enabled;
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * @brief Send a URB
+ */
+int usb_batch_send(usb_batch_t* batch,
+                   int fd,
+                   const usb_urb_header_t* urb_header,
+                   const void* data,
+                   uint32_t data_len)
+{
+    xoe_packet_t packet;
+    int enabled;
+    int result;
+
+    if (batch == NULL || urb_header == NULL ||
+        (data == NULL && data_len > 0)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    enabled = batch->enabled;
+    pthread_mutex_unlock(&batch->lock);
+
+    if (enabled && data_len <= USB_BATCH_MAX_URB_DATA) {
+        return usb_batch_add(batch, fd, urb_header, data, data_len);
+    }
+
+    result = usb_protocol_encapsulate(urb_header, data, data_len, &packet);
+    if (result != 0) {
+        return result;
+    }
+
+    result = usb_batch_send_alone(batch, fd, &packet);
+    usb_protocol_free_payload(&packet);
+
+    return result;
+}
+
+/**
+ * @brief Send a URB whose data has USB_URB_HEADER_WIRE_SIZE bytes in front
+ */
+int usb_batch_send_in_place(usb_batch_t* batch,
+                            int fd,
+                            const usb_urb_header_t* urb_header,
+                            unsigned char* data,
+                            uint32_t data_len)
+{
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    int enabled;
+    int result;
+
+    if (batch == NULL || urb_header == NULL || data == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&batch->lock);
+    enabled = batch->enabled;
+    pthread_mutex_unlock(&batch->lock);
+
+    /* Copying a small URB into the batch costs less than its own frame */
+    if (enabled && data_len <= USB_BATCH_MAX_URB_DATA) {
+        return usb_batch_add(batch, fd, urb_header, data, data_len);
+    }
+
+    result = usb_protocol_encapsulate_in_place(urb_header,
+                                               data - USB_URB_HEADER_WIRE_SIZE,
+                                               data_len, &payload, &packet);
+    if (result != 0) {
+        return result;
+    }
+
+    return usb_batch_send_alone(batch, fd, &packet);
+}
@@ -0,0 +1,131 @@
+/*
+ * usb_batch.h - Batched URB Sends from the USB Client
+ *
+ * Every URB the client sends to the server goes through one batcher per
+ * connection, which also keeps frames from different threads (USB event
+ * thread, network thread, registrations) from interleaving on the socket.
+ *
+ * Small URBs (interrupt reports, short bulk and control completions,
+ * unlink replies) are packed into USB_CMD_BATCH frames once the server
+ * has advertised support. Batching is group commit: a URB sent while the
+ * link is idle leaves at once in a frame of its own; URBs sent while
+ * another thread is writing collect in the next batch, which that
+ * thread writes as soon as its own write returns. The deeper the backlog
+ * behind a slow link, the more URBs share a frame; an idle link adds no
+ * delay.
+ *
+ * URBs too large to batch are sent on their own, after any URBs batched
+ * before them, so each endpoint's URBs keep their order.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#ifndef USB_BATCH_H
+#define USB_BATCH_H
+
+#include "usb_protocol.h"
+#include <pthread.h>
+
+/* Largest URB data packed into a batch; larger URBs fill frames alone */
+#define USB_BATCH_MAX_URB_DATA  512
+
+/* Batch data per frame (the whole frame fits USB_MAX_PAYLOAD_SIZE) */
+#define USB_BATCH_CAPACITY      USB_MAX_DATA_SIZE
+
+/**
+ * @brief Send path of one client connection
+ */
+typedef struct {
+    /* Two frames: one filled by senders while the other is written */
+    uint8_t frames[2][USB_URB_HEADER_WIRE_SIZE + USB_BATCH_CAPACITY];
+    int fill;                           /* Frame being filled */
+    uint32_t used;                      /* Batch data in the fill frame */
+    int count;                          /* URBs in the fill frame */
+
+    int enabled;                        /* Peer accepts USB_CMD_BATCH */
+    int sending;                        /* A thread is writing to the
+                                           socket (and flushes the batch) */
+    int failed;                         /* A write failed; link is dead */
+
+    pthread_mutex_t lock;               /* Protects the fields above */
+    pthread_cond_t idle;                /* Write finished or batch taken */
+
+    /* Statistics (guarded by lock) */
+    unsigned long frames_sent;          /* Frames written */
+    unsigned long batches_sent;         /* Of which USB_CMD_BATCH frames */
+    unsigned long batched_urbs;         /* URBs that travelled in batches */
+    int largest_batch;                  /* Most URBs in one batch */
+} usb_batch_t;
+
+/**
+ * @brief Initialize a batcher (batching disabled)
+ *
+ * @param batch Batcher to initialize
+ * @return 0 on success, negative error code on failure
+ */
+int usb_batch_init(usb_batch_t* batch);
+
+/**
+ * @brief Release a batcher
+ *
+ * No thread may still send through it.
+ *
+ * @param batch Batcher (may be NULL)
+ */
+void usb_batch_cleanup(usb_batch_t* batch);
+
+/**
+ * @brief Allow USB_CMD_BATCH frames
+ *
+ * Called once the server advertised USB_FLAG_BATCH; until then every
+ * URB leaves in its own frame.
+ *
+ * @param batch Batcher
+ * @param enabled TRUE to batch small URBs
+ */
+void usb_batch_set_enabled(usb_batch_t* batch, int enabled);
+
+/**
+ * @brief Send a URB
+ *
+ * A small URB sent while another thread is writing is queued in the
+ * next batch and this returns at once; that thread writes it.
+ *
+ * @param batch Batcher
+ * @param fd Socket to the server
+ * @param urb_header URB header
+ * @param data URB data (may be NULL if @p data_len is 0)
+ * @param data_len Bytes of URB data
+ * @return 0 on success (sent, or queued behind a write in progress),
+ *         E_NETWORK_ERROR if this or an earlier write failed,
+ *         other negative error code on bad arguments
+ */
+int usb_batch_send(usb_batch_t* batch,
+                   int fd,
+                   const usb_urb_header_t* urb_header,
+                   const void* data,
+                   uint32_t data_len);
+
+/**
+ * @brief Send a URB whose data has USB_URB_HEADER_WIRE_SIZE bytes in front
+ *
+ * As usb_batch_send(); a URB too large to batch goes out from @p data
+ * in place (see usb_protocol_encapsulate_in_place()).
+ *
+ * @param batch Batcher
+ * @param fd Socket to the server
+ * @param urb_header URB header
+ * @param data URB data, with writable room for the header before it
+ * @param data_len Bytes of URB data
+ * @return As usb_batch_send()
+ */
+int usb_batch_send_in_place(usb_batch_t* batch,
+                            int fd,
+                            const usb_urb_header_t* urb_header,
+                            unsigned char* data,
+                            uint32_t data_len);
+
+#endif /* USB_BATCH_H */
@@ -13,6 +13,10 @@
 #include "usb_client.h"
 #include "usb_protocol.h"
 #include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
 #include "lib/net/net_resolve.h"
 #include "lib/protocol/wire_format.h"
 #include "lib/security/usb_auth.h"
@@ -21,6 +25,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <limits.h>
 
 /* SIZE_MAX may not be defined in C89, provide fallback */
@@ -35,21 +40,1410 @@
 #include <errno.h>
 #include <sys/time.h>
 
+/* Registration exchanges (defined with the registration API below) */
+static int usb_client_register_urb(usb_client_t* client,
+                                   const usb_urb_header_t* reg_urb,
+                                   const void* reg_data,
+                                   uint32_t reg_len,
+                                   uint32_t* granted_size,
+                                   unsigned int timeout_ms);
+static int usb_client_register_slots(usb_client_t* client);
+
+
+/* ========================================================================
+ * Internal Helper Functions
+ * ======================================================================== */
+
+/**
+ * @brief Get current time in milliseconds
+ *
+ * @return Monotonic time in milliseconds (request deadlines)
+ */
+static uint64_t get_time_ms(void)
+{
+    return metrics_now_us() / 1000;
+}
+
+/**
+ * @brief Request deadline timer callback
+ *
+ * Runs from usb_client_cleanup_timeouts() with pending_lock held.
+ */
+static void usb_client_request_expired(timer_wheel_timer_t* timer, void* arg)
+{
+    usb_client_t* client = (usb_client_t*)arg;
+    usb_pending_request_t* request = (usb_pending_request_t*)(void*)
+        ((char*)timer - offsetof(usb_pending_request_t, timer));
+
+    if (!request->in_use || request->completed) {
+        return;
+    }
+
+    /* Mark as timed out and signal waiting thread */
+    request->completed = TRUE;
+    request->status = E_TIMEOUT;
+    pthread_cond_signal(&request->cond);
+
+    client->timeouts++;
+    metrics_add(METRIC_USB_URB_TIMEOUTS, 1);
+}
+
+/**
+ * @brief Arm a request's deadline timeout_ms from now
+ *
+ * Caller must hold pending_lock, and call usb_client_kick_timers() with
+ * the result once it released it.
+ *
+ * @return TRUE if usb_client_wait() sleeps past the new deadline
+ */
+static int usb_client_arm_request(usb_client_t* client,
+                                  usb_pending_request_t* request)
+{
+    uint64_t deadline = get_time_ms() + request->timeout_ms;
+
+    timer_wheel_add(&client->timers, &request->timer, deadline);
+
+    return (deadline < client->timers_wakeup_ms) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Wake usb_client_wait() to sleep until an earlier deadline
+ */
+static void usb_client_kick_timers(usb_client_t* client, int kick)
+{
+    if (!kick) {
+        return;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    client->timers_changed = TRUE;
+    pthread_cond_broadcast(&client->shutdown_cond);
+    pthread_mutex_unlock(&client->lock);
+}
+
+/**
+ * @brief Create the pending request table
+ *
+ * All slots and their condition variables are set up once here, so
+ * request/response matching never allocates on the transfer path.
+ *
+ * @param client Client context
+ * @return 0 on success, negative error code on failure
+ */
+static int usb_client_init_pending_table(usb_client_t* client)
+{
+    int i;
+
+    client->pending_table = (usb_pending_request_t*)calloc(
+        USB_PENDING_TABLE_SIZE, sizeof(usb_pending_request_t));
+    if (client->pending_table == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < USB_PENDING_TABLE_SIZE; i++) {
+        if (pthread_cond_init(&client->pending_table[i].cond, NULL) != 0) {
+            while (--i >= 0) {
+                pthread_cond_destroy(&client->pending_table[i].cond);
+            }
+            free(client->pending_table);
+            client->pending_table = NULL;
+            return E_OUT_OF_MEMORY;
+        }
+        timer_wheel_timer_init(&client->pending_table[i].timer,
+                               usb_client_request_expired, client);
+    }
+
+    timer_wheel_init(&client->timers, get_time_ms(), 1);
+    client->timers_wakeup_ms = 0;
+    client->timers_changed = FALSE;
+    client->pending_max_probe = 0;
+    return 0;
+}
+
+/**
+ * @brief Destroy the pending request table
+ *
+ * @param client Client context
+ */
+static void usb_client_destroy_pending_table(usb_client_t* client)
+{
+    int i;
+
+    if (client->pending_table == NULL) {
+        return;
+    }
+
+    for (i = 0; i < USB_PENDING_TABLE_SIZE; i++) {
+        pthread_cond_destroy(&client->pending_table[i].cond);
+    }
+    free(client->pending_table);
+    client->pending_table = NULL;
+}
+
+/**
+ * @brief Find the live request for a sequence number
+ *
+ * Probes from the home slot no further than the longest probe sequence
+ * currently in use, so a lookup is normally a single slot.
+ * Caller must hold pending_lock.
+ *
+ * @param client Client context
+ * @param seqnum Sequence number
+ * @return Matching request, or NULL if none
+ */
+static usb_pending_request_t* usb_client_find_pending(usb_client_t* client,
+                                                      uint32_t seqnum)
+{
+    usb_pending_request_t* slot;
+    int probe;
+
+    for (probe = 0; probe <= client->pending_max_probe; probe++) {
+        slot = &client->pending_table[(seqnum + (uint32_t)probe) &
+                                      USB_PENDING_TABLE_MASK];
+        if (slot->in_use && slot->seqnum == seqnum) {
+            return slot;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Complete a pending request with a received reply
+ *
+ * As usb_client_complete_pending_request(), also keeping the reply's
+ * command, transfer_length and flags for the waiter (registration
+ * replies).
+ */
+static int usb_client_complete_request(usb_client_t* client,
+                                       const usb_urb_header_t* reply,
+                                       const void* data,
+                                       uint32_t data_len)
+{
+    usb_pending_request_t* request;
+    uint32_t seqnum = reply->seqnum;
+    int32_t status = reply->status;
+
+    /* Validate parameters */
+    if (client == NULL || client->pending_table == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Slot cannot be released while we hold pending_lock (USB-004) */
+    pthread_mutex_lock(&client->pending_lock);
+
+    request = usb_client_find_pending(client, seqnum);
+    if (request == NULL || request->completed || request->unlinking) {
+        /* Unknown seqnum, or the waiter already gave up (timeout) */
+        pthread_mutex_unlock(&client->pending_lock);
+        return E_NOT_FOUND;
+    }
+
+    if (data != NULL && data_len > 0 && request->response_data != NULL) {
+        uint32_t copy_len = (data_len < request->response_size) ?
+                           data_len : request->response_size;
+        memcpy(request->response_data, data, copy_len);
+        request->response_received = copy_len;
+    }
+    request->status = status;
+    request->response_command = reply->command;
+    request->response_transfer_length = reply->transfer_length;
+    request->response_flags = reply->flags;
+    request->completed = TRUE;
+    timer_wheel_cancel(&client->timers, &request->timer);
+
+    /* Signal condition variable */
+    pthread_cond_signal(&request->cond);
+    pthread_mutex_unlock(&client->pending_lock);
+
+    return 0;
+}
+
+/**
+ * @brief Send a URB whose data has USB_ENGINE_HEADROOM bytes in front
+ *
+ * The URB header is written into the headroom and the frame goes out
+ * from there; only the wire header is built separately. Small URBs are
+ * copied into the next batch instead (see usb_batch.h).
+ */
+static int usb_client_send_urb_in_place(usb_client_t* client,
+                                        const usb_urb_header_t* urb_header,
+                                        unsigned char* data,
+                                        uint32_t data_len)
+{
+    int result;
+
+    result = usb_batch_send_in_place(&client->batch, client->socket_fd,
+                                     urb_header, data, data_len);
+    if (result != 0) {
+        fprintf(stderr, "Failed to send URB to server: error %d\n", result);
+        return result;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    client->packets_sent++;
+    pthread_mutex_unlock(&client->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Engine callback: bulk, interrupt or isochronous IN transfer
+ *        completed
+ *
+ * Runs on the USB event thread and forwards the data to the server while
+ * the endpoint's other queued transfers keep the device busy. Every
+ * interrupt report leaves as its own URB, as soon as it completes; an
+ * isochronous transfer leaves as one URB carrying its packet descriptors.
+ */
+static void usb_client_in_complete(usb_engine_endpoint_t* ep,
+                                   int status,
+                                   unsigned char* data,
+                                   int length,
+                                   void* user_data)
+{
+    usb_transfer_thread_ctx_t* ctx = (usb_transfer_thread_ctx_t*)user_data;
+    usb_client_t* client = ctx->client;
+    usb_device_t* device = ctx->device;
+    usb_urb_header_t urb_header;
+    int result;
+
+    if (status != 0) {
+        LOG_ERROR("USB read error on device %d: %d",
+                ctx->device_index + 1, status);
+
+        pthread_mutex_lock(&client->lock);
+        client->transfer_errors++;
+        pthread_mutex_unlock(&client->lock);
+        return;
+    }
+
+    /* Data received, prepare URB header */
+    memset(&urb_header, 0, sizeof(usb_urb_header_t));
+    urb_header.command = USB_CMD_SUBMIT;
+    urb_header.device_id = ((uint32_t)device->config.vendor_id << 16) |
+                           device->config.product_id;
+    urb_header.endpoint = ep->endpoint;
+    if (ep->iso_packets > 0) {
+        urb_header.transfer_type = USB_TRANSFER_ISOCHRONOUS;
+        urb_header.number_of_packets = (uint16_t)ep->iso_packets;
+    } else {
+        urb_header.transfer_type = ep->interrupt ? USB_TRANSFER_INTERRUPT :
+                                                   USB_TRANSFER_BULK;
+    }
+    urb_header.transfer_length = (uint32_t)length;
+    urb_header.actual_length = (uint32_t)length;
+    urb_header.status = 0;  /* Success */
+
+    /* Framed in the engine's headroom: the data is sent from the
+     * buffer the device filled, without a copy */
+    result = usb_client_send_urb_in_place(client, &urb_header, data,
+                                          (uint32_t)length);
+    if (result != 0) {
+        LOG_ERROR("Failed to send URB for device %d: %d",
+                ctx->device_index + 1, result);
+
+        /* Network error: shut the client down */
+        pthread_mutex_lock(&client->lock);
+        client->shutdown_requested = TRUE;
+        pthread_cond_broadcast(&client->shutdown_cond);
+        pthread_mutex_unlock(&client->lock);
+        return;
+    }
+
+    LOG_DEBUG("Device %d: Sent %d bytes to server",
+              ctx->device_index + 1, length);
+}
+
+/**
+ * @brief Submit a device's queued OUT URBs while its endpoint has room
+ *
+ * A URB that finds every transfer in flight stays queued for the next
+ * completion.
+ *
+ * @param ctx Device context
+ * @param queue Bulk OUT queue or isochronous jitter buffer
+ * @param ep Engine endpoint the queue feeds
+ */
+static void usb_client_write_queued(usb_transfer_thread_ctx_t* ctx,
+                                usb_out_queue_t* queue,
+                                usb_engine_endpoint_t* ep)
+{
+    usb_iso_packet_t packets[USB_ISO_MAX_PACKETS];
+    usb_client_t* client = ctx->client;
+    const unsigned char* data;
+    uint32_t length;
+    uint32_t offset;
+    uint32_t seqnum;
+    int count;
+    int result;
+
+    while (1) {
+        result = usb_out_queue_try_front_urb(queue, &data, &length,
+                                             &count, &seqnum);
+        if (result != 0) {
+            return;  /* Nothing ready, or the other thread has it */
+        }
+
+        if (ep->iso_packets > 0) {
+            /* Checked by the network thread before queueing */
+            result = usb_protocol_iso_read_descriptors(data, length, count,
+                                                       packets, &offset);
+            if (result == 0) {
+                result = usb_engine_write_iso(ep, seqnum, packets, count,
+                                              data + offset,
+                                              USB_ENGINE_NO_WAIT);
+            }
+        } else {
+            result = usb_engine_write(ep, seqnum, data, (int)length,
+                                      USB_ENGINE_NO_WAIT);
+        }
+
+        if (result == E_WOULD_BLOCK) {
+            /* All transfers in flight: the next completion writes this
+             * URB, unless one finished while we held it */
+            if (!usb_out_queue_put_back(queue)) {
+                return;
+            }
+            continue;
+        }
+
+        usb_out_queue_consume(queue);
+
+        if (result == E_INVALID_STATE) {
+            /* Engine stopping or device gone: refuse further OUT data */
+            usb_out_queue_close(queue);
+            return;
+        }
+
+        if (result != 0) {
+            LOG_ERROR("USB OUT write error on device %d: %d",
+                    ctx->device_index + 1, result);
+
+            pthread_mutex_lock(&client->lock);
+            client->transfer_errors++;
+            pthread_mutex_unlock(&client->lock);
+        }
+    }
+}
+
+/**
+ * @brief Send a USB_CMD_CREDIT for an OUT endpoint of a device
+ */
+static void usb_client_send_credit(usb_transfer_thread_ctx_t* ctx,
+                                   uint8_t endpoint,
+                                   uint32_t urbs,
+                                   uint16_t flags)
+{
+    const usb_config_t* config = &ctx->device->config;
+    usb_urb_header_t urb;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_CREDIT;
+    urb.flags = flags;
+    urb.device_id = ((uint32_t)config->vendor_id << 16) | config->product_id;
+    urb.endpoint = endpoint;
+    urb.transfer_length = urbs;
+
+    if (usb_client_send_urb(ctx->client, &urb, NULL, 0) != 0) {
+        LOG_WARN("Failed to send credit for device %d endpoint 0x%02x",
+                 ctx->device_index + 1, endpoint);
+    }
+}
+
+/**
+ * @brief Whether the server takes OUT credit
+ */
+static int usb_client_credit_enabled(usb_client_t* client)
+{
+    int enabled;
+
+    pthread_mutex_lock(&client->lock);
+    enabled = client->credit_enabled;
+    pthread_mutex_unlock(&client->lock);
+    return enabled;
+}
+
+/**
+ * @brief Advertise the window of each OUT queue of a device
+ *
+ * Sent once the queues exist; from then on the server pushes no more
+ * URBs to an endpoint than its queue holds.
+ */
+static void usb_client_advertise_windows(usb_transfer_thread_ctx_t* ctx)
+{
+    const usb_config_t* config = &ctx->device->config;
+
+    if (!usb_client_credit_enabled(ctx->client)) {
+        return;
+    }
+    if (ctx->out_queue.buffers != NULL) {
+        usb_client_send_credit(ctx, config->bulk_out_endpoint,
+                               (uint32_t)ctx->out_queue.depth,
+                               USB_FLAG_WINDOW);
+    }
+    if (ctx->iso_queue.buffers != NULL) {
+        usb_client_send_credit(ctx, config->iso_out_endpoint,
+                               (uint32_t)ctx->iso_queue.depth,
+                               USB_FLAG_WINDOW);
+    }
+}
+
+/**
+ * @brief Return the slots an OUT queue freed as credit, a batch at a time
+ */
+static void usb_client_return_credit(usb_transfer_thread_ctx_t* ctx,
+                                     usb_out_queue_t* queue)
+{
+    const usb_config_t* config = &ctx->device->config;
+    int batch;
+    int urbs;
+
+    if (!usb_client_credit_enabled(ctx->client)) {
+        return;
+    }
+
+    batch = queue->depth / USB_CREDIT_DIVISOR;
+    urbs = usb_out_queue_take_credit(queue, (batch > 0) ? batch : 1);
+    if (urbs > 0) {
+        usb_client_send_credit(ctx,
+                               (queue == &ctx->iso_queue) ?
+                               config->iso_out_endpoint :
+                               config->bulk_out_endpoint,
+                               (uint32_t)urbs, 0);
+    }
+}
+
+/**
+ * @brief Feed an OUT queue to its endpoint and return the slots freed
+ *
+ * Runs on the network thread after it queues a URB and on the USB event
+ * thread each time a write of the endpoint finishes, so nothing waits on
+ * the queue or for a free transfer.
+ */
+static void usb_client_pump_out(usb_transfer_thread_ctx_t* ctx,
+                                usb_out_queue_t* queue,
+                                usb_engine_endpoint_t* ep)
+{
+    usb_client_write_queued(ctx, queue, ep);
+    usb_client_return_credit(ctx, queue);
+}
+
+/**
+ * @brief Engine callback: bulk, interrupt or isochronous OUT transfer
+ *        completed
+ */
+static void usb_client_out_complete(usb_engine_endpoint_t* ep,
+                                    int status,
+                                    unsigned char* data,
+                                    int length,
+                                    void* user_data)
+{
+    usb_transfer_thread_ctx_t* ctx = (usb_transfer_thread_ctx_t*)user_data;
+    usb_client_t* client = ctx->client;
+
+    (void)data;
+
+    /* E_INTERRUPTED: unlinked by the peer, or stopping */
+    if (status != 0 && status != E_INTERRUPTED) {
+        LOG_ERROR("USB OUT write error on device %d: %d",
+                ctx->device_index + 1, status);
+
+        pthread_mutex_lock(&client->lock);
+        client->transfer_errors++;
+        pthread_mutex_unlock(&client->lock);
+    } else if (status == 0) {
+        LOG_DEBUG("Device %d: Wrote %d bytes to USB OUT endpoint",
+                  ctx->device_index + 1, length);
+    }
+
+    /* The write's transfer is free again: refill it from the queue */
+    if (ep == ctx->out_ep) {
+        usb_client_pump_out(ctx, &ctx->out_queue, ep);
+    } else if (ep == ctx->iso_out_ep) {
+        usb_client_pump_out(ctx, &ctx->iso_queue, ep);
+    }
+}
+
+/**
+ * @brief Register a device's interrupt endpoints with the engine
+ */
+static int usb_client_add_interrupt_endpoints(usb_client_t* client,
+                                              usb_transfer_thread_ctx_t* ctx)
+{
+    usb_device_t* device = ctx->device;
+    int packet_size;
+    int result;
+
+    if (device->config.interrupt_in_endpoint != USB_NO_ENDPOINT) {
+        /* One report per transfer: a bigger buffer would hold a
+         * full-size report back until the next one arrives */
+        packet_size = usb_device_get_max_packet_size(
+            device, device->config.interrupt_in_endpoint);
+        if (packet_size <= 0) {
+            return E_INVALID_ARGUMENT;
+        }
+
+        result = usb_engine_add_interrupt_endpoint(
+            &client->engine, device, device->config.interrupt_in_endpoint,
+            device->config.transfer_depth, packet_size,
+            usb_client_in_complete, ctx, &ctx->int_in_ep);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    if (device->config.interrupt_out_endpoint != USB_NO_ENDPOINT) {
+        result = usb_engine_add_interrupt_endpoint(
+            &client->engine, device, device->config.interrupt_out_endpoint,
+            device->config.transfer_depth, USB_MAX_DATA_SIZE,
+            usb_client_out_complete, ctx, &ctx->int_out_ep);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register a device's isochronous endpoints with the engine
+ *
+ * Each transfer spans iso_packets service intervals. An IN transfer
+ * leaves as one URB, so descriptors and full packets must fit the URB
+ * size granted by the server.
+ */
+static int usb_client_add_iso_endpoints(usb_client_t* client,
+                                        usb_transfer_thread_ctx_t* ctx)
+{
+    usb_device_t* device = ctx->device;
+    int packets = device->config.iso_packets;
+    int packet_size;
+    int result;
+
+    if (device->config.iso_in_endpoint != USB_NO_ENDPOINT) {
+        packet_size = usb_device_get_max_iso_packet_size(
+            device, device->config.iso_in_endpoint);
+        if (packet_size <= 0) {
+            return E_INVALID_ARGUMENT;
+        }
+        if (USB_ISO_DESCRIPTORS_SIZE(packets) +
+            (uint32_t)packets * (uint32_t)packet_size > ctx->urb_size) {
+            fprintf(stderr, "Device %d: %d isochronous packets of %d bytes "
+                    "exceed the %u byte URB size\n", ctx->device_index + 1,
+                    packets, packet_size, ctx->urb_size);
+            return E_BUFFER_TOO_SMALL;
+        }
+
+        result = usb_engine_add_iso_endpoint(
+            &client->engine, device, device->config.iso_in_endpoint,
+            device->config.transfer_depth, packets, packet_size,
+            usb_client_in_complete, ctx, &ctx->iso_in_ep);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    if (device->config.iso_out_endpoint != USB_NO_ENDPOINT) {
+        packet_size = usb_device_get_max_iso_packet_size(
+            device, device->config.iso_out_endpoint);
+        if (packet_size <= 0) {
+            return E_INVALID_ARGUMENT;
+        }
+
+        result = usb_engine_add_iso_endpoint(
+            &client->engine, device, device->config.iso_out_endpoint,
+            device->config.transfer_depth, packets, packet_size,
+            usb_client_out_complete, ctx, &ctx->iso_out_ep);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register a device's endpoints with the engine
+ *
+ * Also attaches a hotplugged device to the running engine, whose IN
+ * transfers then start at once.
+ */
+static int usb_client_add_device_endpoints(usb_client_t* client,
+                                           usb_transfer_thread_ctx_t* ctx)
+{
+    usb_device_t* device = ctx->device;
+    int result;
+
+    if (device->config.bulk_in_endpoint != USB_NO_ENDPOINT) {
+        result = usb_engine_add_endpoint(&client->engine, device,
+                                         device->config.bulk_in_endpoint,
+                                         device->config.transfer_depth,
+                                         (int)ctx->urb_size,
+                                         usb_client_in_complete, ctx,
+                                         &ctx->in_ep);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    if (device->config.bulk_out_endpoint != USB_NO_ENDPOINT) {
+        result = usb_engine_add_endpoint(&client->engine, device,
+                                         device->config.bulk_out_endpoint,
+                                         device->config.transfer_depth,
+                                         (int)ctx->urb_size,
+                                         usb_client_out_complete, ctx,
+                                         &ctx->out_ep);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    result = usb_client_add_interrupt_endpoints(client, ctx);
+    if (result != 0) {
+        return result;
+    }
+
+    result = usb_client_add_iso_endpoints(client, ctx);
+    if (result != 0) {
+        return result;
+    }
+
+    printf("Device %d: %d transfers of %u bytes queued per endpoint\n",
+           ctx->device_index + 1, device->config.transfer_depth,
+           ctx->urb_size);
+    return 0;
+}
+
+/**
+ * @brief Register every attached device's endpoints and start the engine
+ */
+static int usb_client_start_engine(usb_client_t* client)
+{
+    int result;
+    int i;
+
+    result = usb_engine_init(&client->engine, client->usb_ctx);
+    if (result != 0) {
+        return result;
+    }
+    client->engine_initialized = TRUE;
+
+    for (i = 0; i < client->device_count; i++) {
+        if (!client->device_ctx[i].attached) {
+            continue;  /* Not plugged in: added on arrival */
+        }
+        result = usb_client_add_device_endpoints(client,
+                                                 &client->device_ctx[i]);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return usb_engine_start(&client->engine);
+}
+
+/**
+ * @brief URBs of stream the isochronous jitter buffer holds back
+ *
+ * iso_jitter_ms worth of URBs of iso_packets service intervals each,
+ * rounded up (0 ms = no prefill).
+ */
+static int usb_client_iso_prefill(const usb_config_t* config)
+{
+    long urb_us = (long)config->iso_packets * config->iso_interval_us;
+
+    return (int)(((long)config->iso_jitter_ms * 1000 + urb_us - 1) / urb_us);
+}
+
+/**
+ * @brief Create a device's bulk OUT queue and isochronous jitter buffer
+ *        (for the endpoints it has)
+ */
+static int usb_client_init_device_queues(usb_transfer_thread_ctx_t* ctx)
+{
+    const usb_config_t* config = &ctx->device->config;
+    int prefill;
+    int result;
+
+    if (config->bulk_out_endpoint != USB_NO_ENDPOINT &&
+        ctx->out_queue.buffers == NULL) {
+        result = usb_out_queue_init(&ctx->out_queue,
+                                    config->transfer_depth,
+                                    ctx->urb_size);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    /* Room for the prefill plus as much again of late arrivals */
+    if (config->iso_out_endpoint != USB_NO_ENDPOINT &&
+        ctx->iso_queue.buffers == NULL) {
+        prefill = usb_client_iso_prefill(config);
+        result = usb_out_queue_init(&ctx->iso_queue,
+                                    (prefill * 2 > config->transfer_depth) ?
+                                    prefill * 2 : config->transfer_depth,
+                                    ctx->urb_size);
+        if (result != 0) {
+            return result;
+        }
+        usb_out_queue_set_prefill(&ctx->iso_queue, prefill);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Create the OUT queues of every attached device
+ *
+ * Done before the network thread starts, so an OUT URB the server pushes
+ * right after registration already has somewhere to go.
+ */
+static int usb_client_init_out_queues(usb_client_t* client)
+{
+    int result;
+    int i;
+
+    for (i = 0; i < client->device_count; i++) {
+        if (!client->device_ctx[i].attached) {
+            continue;
+        }
+        result = usb_client_init_device_queues(&client->device_ctx[i]);
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Close every OUT queue, waking the threads that wait on them
+ */
+static void usb_client_close_out_queues(usb_client_t* client)
+{
+    int i;
+
+    for (i = 0; i < client->device_count; i++) {
+        usb_out_queue_close(&client->device_ctx[i].out_queue);
+        usb_out_queue_close(&client->device_ctx[i].iso_queue);
+    }
+}
+
+/**
+ * @brief Find the device a pushed OUT URB is addressed to
+ *
+ * @param client Client context
+ * @param urb Received URB
+ * @param transfer_type Set to the type of the target endpoint
+ *                      (USB_TRANSFER_BULK, _INTERRUPT or _ISOCHRONOUS)
+ * @return Context of the target device, or NULL if the URB is not for
+ *         an OUT endpoint of one of our attached devices
+ *
+ * Caller must hold devices_lock (read) while it uses the context.
+ */
+static usb_transfer_thread_ctx_t* usb_client_out_target(
+    usb_client_t* client,
+    const usb_urb_header_t* urb,
+    int* transfer_type)
+{
+    usb_transfer_thread_ctx_t* ctx;
+    usb_device_t* device;
+    uint32_t device_id;
+    int i;
+
+    if ((urb->endpoint & 0x80) != 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < client->device_count; i++) {
+        device = &client->devices[i];
+        ctx = &client->device_ctx[i];
+        device_id = ((uint32_t)device->config.vendor_id << 16) |
+                    device->config.product_id;
+        if (device_id != urb->device_id || !ctx->attached) {
+            continue;
+        }
+        if (device->config.interrupt_out_endpoint == urb->endpoint &&
+            ctx->int_out_ep != NULL) {
+            *transfer_type = USB_TRANSFER_INTERRUPT;
+            return ctx;
+        }
+        if (device->config.iso_out_endpoint == urb->endpoint &&
+            ctx->iso_queue.buffers != NULL) {
+            *transfer_type = USB_TRANSFER_ISOCHRONOUS;
+            return ctx;
+        }
+        if (device->config.bulk_out_endpoint == urb->endpoint &&
+            ctx->out_queue.buffers != NULL) {
+            *transfer_type = USB_TRANSFER_BULK;
+            return ctx;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Answer a USB_CMD_UNLINK from the peer
+ *
+ * Drops the URB from the device's OUT queue if it has not been submitted
+ * yet, otherwise cancels its transfer if it is still on the bus.
+ * IN data is streamed rather than requested, so there is nothing to
+ * cancel for an IN endpoint.
+ */
+static int usb_client_handle_unlink(usb_client_t* client,
+                                    const usb_urb_header_t* urb)
+{
+    usb_transfer_thread_ctx_t* target;
+    usb_urb_header_t reply;
+    int transfer_type;
+    int status = E_NOT_FOUND;
+
+    target = usb_client_out_target(client, urb, &transfer_type);
+    if (target != NULL && urb->seqnum != 0) {
+        if (transfer_type == USB_TRANSFER_ISOCHRONOUS) {
+            status = usb_out_queue_cancel(&target->iso_queue, urb->seqnum);
+            if (status != 0) {
+                status = usb_engine_cancel(target->iso_out_ep, urb->seqnum);
+            } else {
+                /* Frees the slot and returns its credit */
+                usb_client_pump_out(target, &target->iso_queue,
+                                    target->iso_out_ep);
+            }
+        } else if (transfer_type == USB_TRANSFER_INTERRUPT) {
+            status = usb_engine_cancel(target->int_out_ep, urb->seqnum);
+        } else {
+            status = usb_out_queue_cancel(&target->out_queue, urb->seqnum);
+            if (status != 0) {
+                status = usb_engine_cancel(target->out_ep, urb->seqnum);
+            } else {
+                usb_client_pump_out(target, &target->out_queue,
+                                    target->out_ep);
+            }
+        }
+    }
+
+    LOG_DEBUG("Unlink seqnum=%u device_id=0x%08x endpoint=0x%02x: %d",
+              urb->seqnum, urb->device_id, urb->endpoint, status);
+
+    memset(&reply, 0, sizeof(reply));
+    reply.command = USB_RET_UNLINK;
+    reply.seqnum = urb->seqnum;
+    reply.device_id = urb->device_id;
+    reply.endpoint = urb->endpoint;
+    reply.status = (status == 0) ? 0 : E_NOT_FOUND;
+
+    return usb_client_send_urb(client, &reply, NULL, 0);
+}
+
+/**
+ * @brief Complete a request waiting for its USB_RET_UNLINK
+ */
+static void usb_client_complete_unlink(usb_client_t* client,
+                                       const usb_urb_header_t* urb)
+{
+    usb_pending_request_t* request;
+
+    pthread_mutex_lock(&client->pending_lock);
+
+    request = usb_client_find_pending(client, urb->seqnum);
+    if (request != NULL && request->unlinking && !request->completed) {
+        request->status = urb->status;
+        request->completed = TRUE;
+        timer_wheel_cancel(&client->timers, &request->timer);
+        pthread_cond_signal(&request->cond);
+    } else {
+        LOG_WARN("Unlink reply with no matching request (seqnum=%u)",
+                 urb->seqnum);
+    }
+
+    pthread_mutex_unlock(&client->pending_lock);
+}
+
+/**
+ * @brief Cancel a timed-out request on the device side
+ *
+ * Re-arms the request's slot to wait for the USB_RET_UNLINK, so the
+ * seqnum stays reserved and a late USB_RET_SUBMIT is dropped until then.
+ */
+static void usb_client_unlink_request(usb_client_t* client,
+                                      usb_pending_request_t* request)
+{
+    usb_urb_header_t urb;
+    int kick;
+
+    pthread_mutex_lock(&client->pending_lock);
+    request->response_data = NULL;
+    request->response_received = 0;
+    request->status = 0;
+    request->completed = FALSE;
+    request->unlinking = TRUE;
+    request->timeout_ms = USB_UNLINK_TIMEOUT_MS;
+    kick = usb_client_arm_request(client, request);
+    pthread_mutex_unlock(&client->pending_lock);
+    usb_client_kick_timers(client, kick);
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_UNLINK;
+    urb.seqnum = request->seqnum;
+    urb.device_id = request->device_id;
+    urb.endpoint = request->endpoint;
+
+    if (usb_client_send_urb(client, &urb, NULL, 0) != 0 ||
+        usb_client_wait_pending_request(client, request) != 0) {
+        return;  /* No answer: the peer may be gone */
+    }
+
+    if (request->status == 0) {
+        pthread_mutex_lock(&client->lock);
+        client->unlinks++;
+        pthread_mutex_unlock(&client->lock);
+        metrics_add(METRIC_USB_URB_UNLINKS, 1);
+    }
+}
 
 /* ========================================================================
- * Internal Helper Functions
+ * Device Attach / Detach
  * ======================================================================== */
 
 /**
- * @brief Get current time in milliseconds
+ * @brief Open a device slot's device and read its descriptors
  *
- * @return Current time in milliseconds since epoch
+ * The descriptors are read once per open; the server answers descriptor
+ * reads from them. Touches only the slot, so slots open in parallel.
  */
-static unsigned long get_time_ms(void)
+static int usb_client_open_slot(usb_client_t* client,
+                                usb_transfer_thread_ctx_t* ctx,
+                                const usb_config_t* config)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (unsigned long)((tv.tv_sec * 1000) + (tv.tv_usec / 1000));
+    int result;
+
+    result = usb_device_open(ctx->device, client->usb_ctx, config);
+    if (result != 0) {
+        return result;
+    }
+
+    if (usb_device_read_descriptors(ctx->device, &ctx->descriptors) != 0) {
+        usb_desc_cache_init(&ctx->descriptors);
+    }
+    return 0;
+}
+
+/**
+ * @brief Build the USB_CMD_REGISTER header for a device
+ */
+static void usb_client_build_register(usb_client_t* client,
+                                      usb_urb_header_t* reg_urb,
+                                      uint32_t device_id,
+                                      uint8_t device_class,
+                                      uint32_t urb_size,
+                                      uint32_t iso_bandwidth)
+{
+    memset(reg_urb, 0, sizeof(*reg_urb));
+    reg_urb->command = USB_CMD_REGISTER;
+    reg_urb->seqnum = usb_client_alloc_seqnum(client);
+    reg_urb->device_id = device_id;
+    reg_urb->endpoint = device_class;  /* Convention: device class in endpoint field */
+    reg_urb->transfer_length = urb_size; /* Largest URB we can handle */
+    reg_urb->actual_length = iso_bandwidth; /* Isochronous bytes/s to reserve */
+}
+
+/**
+ * @brief Build the registration of a device slot's device
+ *
+ * @param reg_data Receives the descriptors to send (NULL if none)
+ * @param reg_len Receives their size
+ */
+static void usb_client_build_slot_register(usb_client_t* client,
+                                           const usb_transfer_thread_ctx_t* ctx,
+                                           usb_urb_header_t* reg_urb,
+                                           const void** reg_data,
+                                           uint32_t* reg_len)
+{
+    usb_device_t* device = ctx->device;
+    uint8_t device_class = 0;  /* 0: class given per interface */
+    const uint8_t* desc;
+    uint32_t desc_len;
+    uint32_t iso_bandwidth;
+    uint32_t device_id;
+
+    /* bDeviceClass from the cached device descriptor (USB 2.0 9.6.1) */
+    if (usb_desc_cache_find(&ctx->descriptors, USB_DESC_TYPE_DEVICE, 0, 0,
+                            &desc, &desc_len) == 0 &&
+        desc_len > USB_DEVICE_DESC_CLASS_OFFSET) {
+        device_class = desc[USB_DEVICE_DESC_CLASS_OFFSET];
+    }
+
+    /* Construct device_id from VID:PID */
+    device_id = ((uint32_t)device->config.vendor_id << 16) |
+                device->config.product_id;
+
+    printf("  Registering device %d: VID:PID %04x:%04x (device_id=0x%08x)\n",
+           ctx->device_index + 1, device->config.vendor_id,
+           device->config.product_id, device_id);
+
+    /* Streams reserve their full rate with the server up front */
+    iso_bandwidth = usb_config_iso_bandwidth(
+        &device->config,
+        (device->config.iso_in_endpoint != USB_NO_ENDPOINT) ?
+        usb_device_get_max_iso_packet_size(device,
+                                           device->config.iso_in_endpoint) : 0,
+        (device->config.iso_out_endpoint != USB_NO_ENDPOINT) ?
+        usb_device_get_max_iso_packet_size(device,
+                                           device->config.iso_out_endpoint) : 0);
+
+    usb_client_build_register(client, reg_urb, device_id, device_class,
+                              (uint32_t)device->config.urb_size,
+                              iso_bandwidth);
+
+    /* Descriptors travel as the data; the frame length gives their size */
+    *reg_data = NULL;
+    *reg_len = 0;
+    if (ctx->descriptors.size > 0) {
+        *reg_data = ctx->descriptors.data;
+        *reg_len = ctx->descriptors.size;
+    }
+}
+
+/**
+ * @brief Register a device slot's device with the server
+ *
+ * Stores the URB size the server granted in the slot.
+ */
+static int usb_client_register_slot(usb_client_t* client,
+                                    usb_transfer_thread_ctx_t* ctx)
+{
+    usb_urb_header_t reg_urb;
+    const void* reg_data;
+    uint32_t reg_len;
+
+    usb_client_build_slot_register(client, ctx, &reg_urb, &reg_data, &reg_len);
+
+    return usb_client_register_urb(client, &reg_urb, reg_data, reg_len,
+                                   &ctx->urb_size, USB_REGISTER_TIMEOUT_MS);
+}
+
+/**
+ * @brief Free a detached slot's endpoints and queues
+ *
+ * The engine endpoints must have been removed already.
+ */
+static void usb_client_release_slot(usb_transfer_thread_ctx_t* ctx)
+{
+    ctx->in_ep = NULL;
+    ctx->out_ep = NULL;
+    ctx->int_in_ep = NULL;
+    ctx->int_out_ep = NULL;
+    ctx->iso_in_ep = NULL;
+    ctx->iso_out_ep = NULL;
+    usb_out_queue_cleanup(&ctx->out_queue);
+    usb_out_queue_cleanup(&ctx->iso_queue);
+}
+
+/**
+ * @brief Bring a plugged-in device into service
+ *
+ * Opens the device, registers it and starts its pipelines. The network
+ * thread only routes OUT URBs to it once everything is in place; an OUT
+ * URB the server sends before then is dropped as unmatched.
+ */
+static int usb_client_attach_device(usb_client_t* client, int index)
+{
+    usb_transfer_thread_ctx_t* ctx = &client->device_ctx[index];
+    usb_device_t* device = &client->devices[index];
+    usb_config_t config = device->config;
+    uint32_t device_id;
+    int result;
+
+    /* Opening clears the slot, so open from a copy of its config */
+    result = usb_client_open_slot(client, ctx, &config);
+    if (result != 0) {
+        device->config = config;
+        return result;
+    }
+
+    result = usb_client_register_slot(client, ctx);
+    if (result != 0) {
+        usb_device_close(device);
+        return result;
+    }
+
+    result = usb_client_init_device_queues(ctx);
+    if (result == 0) {
+        result = usb_client_add_device_endpoints(client, ctx);
+    }
+    if (result != 0) {
+        usb_engine_remove_device(&client->engine, device);
+        usb_client_release_slot(ctx);
+        device_id = ((uint32_t)config.vendor_id << 16) | config.product_id;
+        usb_client_unregister_device(client, device_id);
+        usb_device_close(device);
+        return result;
+    }
+
+    pthread_rwlock_wrlock(&client->devices_lock);
+    ctx->attached = TRUE;
+    pthread_rwlock_unlock(&client->devices_lock);
+    usb_client_advertise_windows(ctx);
+
+    pthread_mutex_lock(&client->lock);
+    client->hotplug_attaches++;
+    pthread_mutex_unlock(&client->lock);
+
+    printf("Device %d (%04x:%04x) attached\n", index + 1,
+           config.vendor_id, config.product_id);
+    return 0;
+}
+
+/**
+ * @brief Take a removed device out of service
+ *
+ * Stops its transfers and queues, unregisters it and closes it.
+ * The slot stays configured for the device's next arrival.
+ */
+static void usb_client_detach_device(usb_client_t* client, int index)
+{
+    usb_transfer_thread_ctx_t* ctx = &client->device_ctx[index];
+    usb_device_t* device = &client->devices[index];
+    uint32_t device_id;
+    int result;
+
+    /* Wake the network thread if it waits for an engine slot or for
+     * room in a queue of the device */
+    usb_engine_halt_device(&client->engine, device);
+    usb_out_queue_close(&ctx->out_queue);
+    usb_out_queue_close(&ctx->iso_queue);
+
+    /* Once we hold it, the network thread is done with the slot and
+     * skips it from now on */
+    pthread_rwlock_wrlock(&client->devices_lock);
+    ctx->attached = FALSE;
+    pthread_rwlock_unlock(&client->devices_lock);
+
+    usb_engine_remove_device(&client->engine, device);
+    usb_client_release_slot(ctx);
+
+    device_id = ((uint32_t)device->config.vendor_id << 16) |
+                device->config.product_id;
+    result = usb_client_unregister_device(client, device_id);
+    if (result != 0) {
+        fprintf(stderr, "Warning: Failed to unregister device %d: error %d\n",
+                index + 1, result);
+    }
+
+    usb_device_close(device);
+
+    pthread_mutex_lock(&client->lock);
+    client->hotplug_detaches++;
+    pthread_mutex_unlock(&client->lock);
+
+    printf("Device %d (%04x:%04x) detached\n", index + 1,
+           device->config.vendor_id, device->config.product_id);
+}
+
+/* ========================================================================
+ * Hotplug
+ * ======================================================================== */
+
+/**
+ * @brief libusb hotplug callback
+ *
+ * Runs on the USB event thread, which must keep serving transfers: the
+ * event is only queued for the hotplug thread. Devices without a
+ * hotplug slot are ignored here.
+ */
+static int LIBUSB_CALL usb_client_hotplug_callback(libusb_context* usb_ctx,
+                                                   libusb_device* usb_device,
+                                                   libusb_hotplug_event event,
+                                                   void* user_data)
+{
+    usb_client_t* client = (usb_client_t*)user_data;
+    struct libusb_device_descriptor desc;
+    const usb_config_t* config;
+    usb_hotplug_event_t* queued;
+    int wanted = FALSE;
+    int i;
+
+    (void)usb_ctx;
+
+    if (libusb_get_device_descriptor(usb_device, &desc) != LIBUSB_SUCCESS) {
+        return 0;
+    }
+
+    /* Slot configs do not change once the client runs */
+    for (i = 0; i < client->device_count && !wanted; i++) {
+        config = &client->devices[i].config;
+        wanted = config->enable_hotplug &&
+                 config->vendor_id == desc.idVendor &&
+                 config->product_id == desc.idProduct;
+    }
+    if (!wanted) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&client->hotplug_lock);
+    if (client->hotplug_count < USB_HOTPLUG_QUEUE_SIZE) {
+        queued = &client->hotplug_events[(client->hotplug_head +
+                                          client->hotplug_count) %
+                                         USB_HOTPLUG_QUEUE_SIZE];
+        queued->vendor_id = desc.idVendor;
+        queued->product_id = desc.idProduct;
+        queued->arrived = (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED);
+        client->hotplug_count++;
+        pthread_cond_signal(&client->hotplug_cond);
+    } else {
+        LOG_WARN("Hotplug event queue full, dropped %04x:%04x",
+                 desc.idVendor, desc.idProduct);
+    }
+    pthread_mutex_unlock(&client->hotplug_lock);
+
+    return 0;  /* Stay registered */
+}
+
+/**
+ * @brief Hotplug thread: attach and detach devices as libusb reports them
+ *
+ * An arrival attaches the first detached slot for the device's VID:PID,
+ * a removal detaches the first attached one. Attaching waits for the
+ * server, which is why it is not done on the event thread.
+ */
+static void* usb_client_hotplug_thread(void* arg)
+{
+    usb_client_t* client = (usb_client_t*)arg;
+    usb_hotplug_event_t event;
+    const usb_config_t* config;
+    int result;
+    int i;
+
+    while (1) {
+        pthread_mutex_lock(&client->hotplug_lock);
+        while (!client->hotplug_stop && client->hotplug_count == 0) {
+            pthread_cond_wait(&client->hotplug_cond, &client->hotplug_lock);
+        }
+        if (client->hotplug_stop) {
+            pthread_mutex_unlock(&client->hotplug_lock);
+            break;
+        }
+        event = client->hotplug_events[client->hotplug_head];
+        client->hotplug_head = (client->hotplug_head + 1) %
+                               USB_HOTPLUG_QUEUE_SIZE;
+        client->hotplug_count--;
+        pthread_mutex_unlock(&client->hotplug_lock);
+
+        /* Only this thread changes attached once the client runs */
+        for (i = 0; i < client->device_count; i++) {
+            config = &client->devices[i].config;
+            if (!config->enable_hotplug ||
+                config->vendor_id != event.vendor_id ||
+                config->product_id != event.product_id ||
+                client->device_ctx[i].attached == event.arrived) {
+                continue;
+            }
+
+            if (event.arrived) {
+                printf("USB device %04x:%04x plugged in\n",
+                       event.vendor_id, event.product_id);
+                result = usb_client_attach_device(client, i);
+                if (result != 0) {
+                    fprintf(stderr, "Failed to attach device %d: error %d\n",
+                            i + 1, result);
+                }
+            } else {
+                printf("USB device %04x:%04x removed\n",
+                       event.vendor_id, event.product_id);
+                usb_client_detach_device(client, i);
+            }
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Start following hotplug events, if any device asked for it
+ *
+ * Registered with LIBUSB_HOTPLUG_ENUMERATE, so a device plugged in
+ * between usb_client_add_device() and now is reported as well.
+ */
+static int usb_client_start_hotplug(usb_client_t* client)
+{
+    libusb_hotplug_callback_handle handle;
+    int wanted = FALSE;
+    int result;
+    int i;
+
+    for (i = 0; i < client->device_count; i++) {
+        wanted = wanted || client->devices[i].config.enable_hotplug;
+    }
+    if (!wanted) {
+        return 0;
+    }
+
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        fprintf(stderr, "Warning: libusb has no hotplug support on this "
+                "platform; devices are only opened at start\n");
+        return E_USB_NOT_SUPPORTED;
+    }
+
+    client->hotplug_stop = FALSE;
+    result = thread_sched_create(&client->hotplug_thread, THREAD_CLASS_USB,
+                                 usb_client_hotplug_thread, client);
+    if (result != 0) {
+        fprintf(stderr, "Failed to create hotplug thread: %s\n",
+                strerror(result));
+        client->hotplug_thread = 0;
+        return E_IO_ERROR;
+    }
+
+    result = libusb_hotplug_register_callback(
+        client->usb_ctx,
+        LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+        LIBUSB_HOTPLUG_ENUMERATE,
+        LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+        LIBUSB_HOTPLUG_MATCH_ANY,
+        usb_client_hotplug_callback, client, &handle);
+    if (result != LIBUSB_SUCCESS) {
+        fprintf(stderr, "Failed to register hotplug callback: %s\n",
+                libusb_strerror(result));
+        pthread_mutex_lock(&client->hotplug_lock);
+        client->hotplug_stop = TRUE;
+        pthread_cond_signal(&client->hotplug_cond);
+        pthread_mutex_unlock(&client->hotplug_lock);
+        pthread_join(client->hotplug_thread, NULL);
+        client->hotplug_thread = 0;
+        return E_USB_NOT_SUPPORTED;
+    }
+
+    client->hotplug_handle = (int)handle;
+    client->hotplug_registered = TRUE;
+
+    printf("Hotplug thread spawned\n");
+    return 0;
+}
+
+/**
+ * @brief Stop following hotplug events
+ *
+ * Lets an attach or detach in progress finish first.
+ */
+static void usb_client_stop_hotplug(usb_client_t* client)
+{
+    if (client->hotplug_registered) {
+        libusb_hotplug_deregister_callback(
+            client->usb_ctx,
+            (libusb_hotplug_callback_handle)client->hotplug_handle);
+        client->hotplug_registered = FALSE;
+    }
+
+    if (client->hotplug_thread != 0) {
+        pthread_mutex_lock(&client->hotplug_lock);
+        client->hotplug_stop = TRUE;
+        pthread_cond_signal(&client->hotplug_cond);
+        pthread_mutex_unlock(&client->hotplug_lock);
+        pthread_join(client->hotplug_thread, NULL);
+        client->hotplug_thread = 0;
+    }
 }
 
 /* ========================================================================
@@ -96,6 +1490,7 @@ usb_client_t* usb_client_init(const char* server_ip,
         memcpy(client->server_ip, server_ip, ip_len + 1);  /* Safe: explicit size */
     }
     client->server_port = server_port;
+    sock_tune_preset(&client->sock_tune, SOCK_TUNE_LOW_LATENCY);
 
     /* Allocate device array */
     client->devices = (usb_device_t*)malloc(sizeof(usb_device_t) * max_devices);
@@ -106,25 +1501,26 @@ usb_client_t* usb_client_init(const char* server_ip,
     }
     memset(client->devices, 0, sizeof(usb_device_t) * max_devices);
 
-    /* Allocate transfer thread array */
-    client->transfer_threads = (pthread_t*)malloc(sizeof(pthread_t) * max_devices);
-    if (client->transfer_threads == NULL) {
+    /* Allocate per-device transfer contexts */
+    client->device_ctx = (usb_transfer_thread_ctx_t*)calloc(
+        (size_t)max_devices, sizeof(usb_transfer_thread_ctx_t));
+    if (client->device_ctx == NULL) {
         free(client->devices);
         free(client->server_ip);
         free(client);
         return NULL;
     }
-    memset(client->transfer_threads, 0, sizeof(pthread_t) * max_devices);
 
     client->device_count = 0;
     client->max_devices = max_devices;
+    client->max_urb_size = USB_MAX_DATA_SIZE;
     client->socket_fd = -1;
     client->running = FALSE;
     client->shutdown_requested = FALSE;
 
     /* Initialize thread synchronization (USB-009 fix: check return values) */
     if (pthread_mutex_init(&client->lock, NULL) != 0) {
-        free(client->transfer_threads);
+        free(client->device_ctx);
         free(client->devices);
         free(client->server_ip);
         free(client);
@@ -132,7 +1528,7 @@ usb_client_t* usb_client_init(const char* server_ip,
     }
     if (pthread_cond_init(&client->shutdown_cond, NULL) != 0) {
         pthread_mutex_destroy(&client->lock);
-        free(client->transfer_threads);
+        free(client->device_ctx);
         free(client->devices);
         free(client->server_ip);
         free(client);
@@ -146,15 +1542,80 @@ usb_client_t* usb_client_init(const char* server_ip,
 
     /* Phase 5: Initialize request/response tracking */
     client->next_seqnum = 1;
-    client->pending_head = NULL;
     client->pending_count = 0;
     client->timeouts = 0;
+    client->unlinks = 0;
 
     /* USB-009 fix: check pthread_mutex_init return value */
     if (pthread_mutex_init(&client->pending_lock, NULL) != 0) {
         pthread_cond_destroy(&client->shutdown_cond);
         pthread_mutex_destroy(&client->lock);
-        free(client->transfer_threads);
+        free(client->device_ctx);
+        free(client->devices);
+        free(client->server_ip);
+        free(client);
+        return NULL;
+    }
+
+    if (usb_client_init_pending_table(client) != 0) {
+        pthread_mutex_destroy(&client->pending_lock);
+        pthread_cond_destroy(&client->shutdown_cond);
+        pthread_mutex_destroy(&client->lock);
+        free(client->device_ctx);
+        free(client->devices);
+        free(client->server_ip);
+        free(client);
+        return NULL;
+    }
+
+    /* Hotplug: device slot guard and event queue */
+    if (pthread_rwlock_init(&client->devices_lock, NULL) != 0) {
+        usb_client_destroy_pending_table(client);
+        pthread_mutex_destroy(&client->pending_lock);
+        pthread_cond_destroy(&client->shutdown_cond);
+        pthread_mutex_destroy(&client->lock);
+        free(client->device_ctx);
+        free(client->devices);
+        free(client->server_ip);
+        free(client);
+        return NULL;
+    }
+    if (pthread_mutex_init(&client->hotplug_lock, NULL) != 0) {
+        pthread_rwlock_destroy(&client->devices_lock);
+        usb_client_destroy_pending_table(client);
+        pthread_mutex_destroy(&client->pending_lock);
+        pthread_cond_destroy(&client->shutdown_cond);
+        pthread_mutex_destroy(&client->lock);
+        free(client->device_ctx);
+        free(client->devices);
+        free(client->server_ip);
+        free(client);
+        return NULL;
+    }
+    if (pthread_cond_init(&client->hotplug_cond, NULL) != 0) {
+        pthread_mutex_destroy(&client->hotplug_lock);
+        pthread_rwlock_destroy(&client->devices_lock);
+        usb_client_destroy_pending_table(client);
+        pthread_mutex_destroy(&client->pending_lock);
+        pthread_cond_destroy(&client->shutdown_cond);
+        pthread_mutex_destroy(&client->lock);
+        free(client->device_ctx);
+        free(client->devices);
+        free(client->server_ip);
+        free(client);
+        return NULL;
+    }
+
+    /* Send path (batching turned on by the server's registration reply) */
+    if (usb_batch_init(&client->batch) != 0) {
+        pthread_cond_destroy(&client->hotplug_cond);
+        pthread_mutex_destroy(&client->hotplug_lock);
+        pthread_rwlock_destroy(&client->devices_lock);
+        usb_client_destroy_pending_table(client);
+        pthread_mutex_destroy(&client->pending_lock);
+        pthread_cond_destroy(&client->shutdown_cond);
+        pthread_mutex_destroy(&client->lock);
+        free(client->device_ctx);
         free(client->devices);
         free(client->server_ip);
         free(client);
@@ -165,49 +1626,159 @@ usb_client_t* usb_client_init(const char* server_ip,
 }
 
 /**
- * @brief Add USB device to client
+ * @brief Set the TCP options used for the server connection
+ */
+void usb_client_set_sock_tune(usb_client_t* client, const sock_tune_t* tune)
+{
+    if (client == NULL) {
+        return;
+    }
+
+    if (tune != NULL) {
+        client->sock_tune = *tune;
+    } else {
+        sock_tune_preset(&client->sock_tune, SOCK_TUNE_SYSTEM);
+    }
+}
+
+/* One device being opened by usb_client_add_devices() */
+typedef struct {
+    usb_client_t* client;
+    usb_transfer_thread_ctx_t* ctx;
+    const usb_config_t* config;
+    pthread_t thread;
+    int started;
+    int result;
+} usb_client_open_job_t;
+
+/**
+ * @brief Open one device (worker of usb_client_add_devices())
+ */
+static void* usb_client_open_thread(void* arg)
+{
+    usb_client_open_job_t* job = (usb_client_open_job_t*)arg;
+
+    job->result = usb_client_open_slot(job->client, job->ctx, job->config);
+    return NULL;
+}
+
+/**
+ * @brief Add USB devices to client, opening them in parallel
  */
-int usb_client_add_device(usb_client_t* client,
-                          const usb_config_t* config)
+int usb_client_add_devices(usb_client_t* client,
+                           const usb_config_t* configs,
+                           int count)
 {
-    int result;
+    usb_client_open_job_t* jobs;
+    usb_transfer_thread_ctx_t* ctx;
     usb_device_t* device;
+    int first;
+    int result = 0;
+    int i;
 
     /* Validate parameters */
-    if (client == NULL || config == NULL) {
+    if (client == NULL || configs == NULL || count <= 0) {
         return E_INVALID_ARGUMENT;
     }
 
     /* Check if device array is full */
-    if (client->device_count >= client->max_devices) {
+    if (count > client->max_devices - client->device_count) {
         return E_BUFFER_TOO_SMALL;
     }
 
-    /* Validate device configuration */
-    result = usb_config_validate(config);
-    if (result != 0) {
-        return result;
+    /* Validate device configurations */
+    for (i = 0; i < count; i++) {
+        result = usb_config_validate(&configs[i]);
+        if (result != 0) {
+            return result;
+        }
     }
 
-    /* Get device slot */
-    device = &client->devices[client->device_count];
+    /* All devices share one libusb context, served by one event thread */
+    if (client->usb_ctx == NULL) {
+        result = usb_device_init_library(&client->usb_ctx);
+        if (result != 0) {
+            fprintf(stderr, "Failed to initialize libusb: error %d\n", result);
+            return result;
+        }
+    }
 
-    /* Open USB device (using shared libusb context = NULL for now) */
-    result = usb_device_open(device, NULL, config);
-    if (result != 0) {
-        fprintf(stderr, "Failed to open USB device %04x:%04x: error %d\n",
-                config->vendor_id, config->product_id, result);
-        return result;
+    jobs = (usb_client_open_job_t*)calloc((size_t)count, sizeof(*jobs));
+    if (jobs == NULL) {
+        return E_OUT_OF_MEMORY;
     }
 
-    /* Device successfully added */
-    client->device_count++;
+    /* Opening claims interfaces and reads descriptors: tens of
+     * milliseconds of control transfers per device, so each device is
+     * opened on its own thread; one that cannot start opens inline */
+    first = client->device_count;
+    for (i = 0; i < count; i++) {
+        ctx = &client->device_ctx[first + i];
+        ctx->client = client;
+        ctx->device = &client->devices[first + i];
+        ctx->device_index = first + i;
+
+        jobs[i].client = client;
+        jobs[i].ctx = ctx;
+        jobs[i].config = &configs[i];
+        if (count > 1 &&
+            thread_sched_create(&jobs[i].thread, THREAD_CLASS_NONE,
+                                usb_client_open_thread, &jobs[i]) == 0) {
+            jobs[i].started = TRUE;
+        } else {
+            usb_client_open_thread(&jobs[i]);
+        }
+    }
+
+    result = 0;
+    for (i = 0; i < count; i++) {
+        if (jobs[i].started) {
+            pthread_join(jobs[i].thread, NULL);
+        }
+        device = &client->devices[first + i];
 
-    printf("Added USB device %04x:%04x (device %d/%d)\n",
-           config->vendor_id, config->product_id,
-           client->device_count, client->max_devices);
+        /* The slot counts even if its device failed: cleanup closes it */
+        client->device_count++;
 
-    return 0;
+        /* The network receive buffer must hold the largest URB any device
+         * may be granted, including one attached later */
+        if ((uint32_t)configs[i].urb_size > client->max_urb_size) {
+            client->max_urb_size = (uint32_t)configs[i].urb_size;
+        }
+
+        if (jobs[i].result == 0) {
+            printf("Added USB device %04x:%04x (device %d/%d)\n",
+                   configs[i].vendor_id, configs[i].product_id,
+                   client->device_count, client->max_devices);
+        } else if (configs[i].enable_hotplug) {
+            /* Keep the slot; the device is attached when plugged in */
+            memset(device, 0, sizeof(usb_device_t));
+            device->config = configs[i];
+            printf("USB device %04x:%04x not present, waiting for it to be "
+                   "plugged in (device %d/%d)\n",
+                   configs[i].vendor_id, configs[i].product_id,
+                   client->device_count, client->max_devices);
+        } else {
+            fprintf(stderr, "Failed to open USB device %04x:%04x: error %d\n",
+                    configs[i].vendor_id, configs[i].product_id,
+                    jobs[i].result);
+            if (result == 0) {
+                result = jobs[i].result;
+            }
+        }
+    }
+
+    free(jobs);
+    return result;
+}
+
+/**
+ * @brief Add USB device to client
+ */
+int usb_client_add_device(usb_client_t* client,
+                          const usb_config_t* config)
+{
+    return usb_client_add_devices(client, config, 1);
 }
 
 /**
@@ -220,8 +1791,9 @@ static int usb_client_connect(usb_client_t* client)
     int result;
 
     /* Resolve hostname/IP and connect to server */
-    result = net_resolve_connect(client->server_ip, client->server_port,
-                                  &client->socket_fd, &resolve_result);
+    result = net_resolve_connect_tuned(client->server_ip, client->server_port,
+                                       &client->sock_tune,
+                                       &client->socket_fd, &resolve_result);
     if (result != 0) {
         net_resolve_format_error(&resolve_result, error_buf, sizeof(error_buf));
         fprintf(stderr, "Failed to connect to %s:%d: %s\n",
@@ -258,35 +1830,34 @@ int usb_client_start(usb_client_t* client)
         return result;
     }
 
-    /* Register all devices with server */
+    /* Register the devices that are plugged in with the server */
+    printf("\nRegistering USB devices with server...\n");
+    result = usb_client_register_slots(client);
+    if (result != 0) {
+        fprintf(stderr, "Closing server connection\n");
+        close(client->socket_fd);
+        client->socket_fd = -1;
+        return result;
+    }
+    printf("All devices registered successfully\n\n");
+
+    /* The server pushes OUT data as it arrives; queue it per device */
+    result = usb_client_init_out_queues(client);
+    if (result != 0) {
+        fprintf(stderr, "Failed to allocate USB OUT queues: error %d\n", result);
+        close(client->socket_fd);
+        client->socket_fd = -1;
+        return result;
+    }
+
+    /* Bound what the server pushes to each queue */
     {
         int i;
-        printf("\nRegistering USB devices with server...\n");
         for (i = 0; i < client->device_count; i++) {
-            uint32_t device_id = 0;
-            uint8_t device_class = 0;  /* TODO: Extract from USB descriptor */
-
-            /* Construct device_id from VID:PID */
-            device_id = ((uint32_t)client->devices[i].config.vendor_id << 16) |
-                        client->devices[i].config.product_id;
-
-            printf("  Registering device %d: VID:PID %04x:%04x (device_id=0x%08x)\n",
-                   i + 1,
-                   client->devices[i].config.vendor_id,
-                   client->devices[i].config.product_id,
-                   device_id);
-
-            result = usb_client_register_device(client, device_id, device_class, 5000);
-            if (result != 0) {
-                fprintf(stderr, "Failed to register device %d: error %d\n",
-                        i + 1, result);
-                fprintf(stderr, "Closing server connection\n");
-                close(client->socket_fd);
-                client->socket_fd = -1;
-                return result;
+            if (client->device_ctx[i].attached) {
+                usb_client_advertise_windows(&client->device_ctx[i]);
             }
         }
-        printf("All devices registered successfully\n\n");
     }
 
     /* Mark as running */
@@ -303,13 +1874,36 @@ int usb_client_start(usb_client_t* client)
     printf("  Server: %s:%d\n", client->server_ip, client->server_port);
     printf("\n");
 
+    /* Queue transfers and start the USB event thread first: the network
+     * thread submits interrupt OUT URBs on the engine's endpoints */
+    result = usb_client_start_engine(client);
+    if (result != 0) {
+        fprintf(stderr, "Failed to start USB transfer engine: error %d\n", result);
+        pthread_mutex_lock(&client->lock);
+        client->running = FALSE;
+        client->shutdown_requested = TRUE;
+        pthread_mutex_unlock(&client->lock);
+        if (client->engine_initialized) {
+            usb_engine_stop(&client->engine);
+        }
+        close(client->socket_fd);
+        client->socket_fd = -1;
+        return result;
+    }
+
+    printf("USB event thread spawned\n");
+
     /* Spawn network receive thread */
-    result = pthread_create(&client->network_thread, NULL,
-                           usb_client_network_thread, client);
+    result = thread_sched_create(&client->network_thread, THREAD_CLASS_USB,
+                                 usb_client_network_thread, client);
     if (result != 0) {
         fprintf(stderr, "Failed to create network thread: %s\n",
                 strerror(result));
+        pthread_mutex_lock(&client->lock);
         client->running = FALSE;
+        client->shutdown_requested = TRUE;
+        pthread_mutex_unlock(&client->lock);
+        usb_engine_stop(&client->engine);
         close(client->socket_fd);
         client->socket_fd = -1;
         return E_IO_ERROR;
@@ -317,41 +1911,9 @@ int usb_client_start(usb_client_t* client)
 
     printf("Network receive thread spawned\n");
 
-    /* Spawn per-device transfer threads */
-    {
-        int i;
-        for (i = 0; i < client->device_count; i++) {
-            usb_transfer_thread_ctx_t* ctx;
-
-            /* Allocate thread context */
-            ctx = (usb_transfer_thread_ctx_t*)malloc(
-                sizeof(usb_transfer_thread_ctx_t));
-            if (ctx == NULL) {
-                fprintf(stderr, "Failed to allocate thread context for device %d\n",
-                        i + 1);
-                /* Continue with other devices */
-                continue;
-            }
-
-            ctx->client = client;
-            ctx->device = &client->devices[i];
-            ctx->device_index = i;
-
-            /* Spawn thread */
-            result = pthread_create(&client->transfer_threads[i], NULL,
-                                   usb_client_transfer_thread, ctx);
-            if (result != 0) {
-                fprintf(stderr, "Failed to create transfer thread for device %d: %s\n",
-                        i + 1, strerror(result));
-                free(ctx);
-                continue;
-            }
-
-            printf("Transfer thread spawned for device %d (VID:PID %04x:%04x)\n",
-                   i + 1, client->devices[i].config.vendor_id,
-                   client->devices[i].config.product_id);
-        }
-    }
+    /* Devices plugged in or out from now on; the client keeps running
+     * without it, with the devices it has */
+    usb_client_start_hotplug(client);
 
     printf("\nAll threads started. Press Ctrl+C to exit...\n\n");
 
@@ -367,32 +1929,44 @@ int usb_client_wait(usb_client_t* client)
         return E_INVALID_ARGUMENT;
     }
 
-    /* Phase 5: Wait for shutdown with periodic timeout cleanup */
+    /* Sleep until shutdown, waking only as request deadlines fall due */
     pthread_mutex_lock(&client->lock);
     while (!client->shutdown_requested) {
         struct timespec timeout;
         struct timeval now;
-        int wait_result;
-
-        /* Wait for 1 second or until shutdown */
-        gettimeofday(&now, NULL);
-        timeout.tv_sec = now.tv_sec + 1;
-        timeout.tv_nsec = now.tv_usec * 1000;
-
-        wait_result = pthread_cond_timedwait(&client->shutdown_cond,
-                                             &client->lock,
-                                             &timeout);
+        long wait_ms;
 
         /* Unlock to allow cleanup to acquire pending_lock */
         pthread_mutex_unlock(&client->lock);
 
-        /* Clean up timed-out requests */
-        usb_client_cleanup_timeouts(client);
+        pthread_mutex_lock(&client->pending_lock);
+        timer_wheel_advance(&client->timers, get_time_ms());
+        wait_ms = timer_wheel_next_ms(&client->timers, get_time_ms());
+        client->timers_wakeup_ms = (wait_ms < 0) ? UINT64_MAX :
+                                   get_time_ms() + (uint64_t)wait_ms;
+        pthread_mutex_unlock(&client->pending_lock);
 
-        /* Reacquire lock for next iteration */
+        /* A deadline armed since is caught by timers_changed */
         pthread_mutex_lock(&client->lock);
+        if (client->timers_changed || client->shutdown_requested) {
+            client->timers_changed = FALSE;
+            continue;
+        }
+
+        if (wait_ms < 0) {
+            pthread_cond_wait(&client->shutdown_cond, &client->lock);
+            continue;
+        }
 
-        (void)wait_result;  /* Suppress unused variable warning */
+        gettimeofday(&now, NULL);
+        timeout.tv_sec = now.tv_sec + wait_ms / 1000;
+        timeout.tv_nsec = now.tv_usec * 1000 + (wait_ms % 1000) * 1000000L;
+        if (timeout.tv_nsec >= 1000000000L) {
+            timeout.tv_sec++;
+            timeout.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&client->shutdown_cond, &client->lock,
+                               &timeout);
     }
     pthread_mutex_unlock(&client->lock);
 
@@ -412,6 +1986,9 @@ int usb_client_stop(usb_client_t* client)
 
     printf("\nStopping USB client...\n");
 
+    /* No attach or detach may run past this point */
+    usb_client_stop_hotplug(client);
+
     /* Signal shutdown */
     pthread_mutex_lock(&client->lock);
 
@@ -421,20 +1998,20 @@ int usb_client_stop(usb_client_t* client)
     pthread_cond_broadcast(&client->shutdown_cond);
     pthread_mutex_unlock(&client->lock);
 
-    /* Phase 4: Close USB devices to force blocked transfers to abort */
-    printf("Closing USB devices to unblock transfer threads...\n");
-    for (i = 0; i < client->device_count; i++) {
-        if (client->devices[i].handle != NULL) {
-            usb_device_close(&client->devices[i]);
-        }
+    /* Cancel queued transfers and stop the USB event thread; this also
+     * wakes the network thread if it waits for a free OUT slot */
+    if (client->engine_initialized) {
+        printf("Cancelling queued USB transfers...\n");
+        usb_engine_stop(&client->engine);
     }
 
-    /* Phase 4.5: Wait for transfer threads to exit */
-    printf("Waiting for transfer threads to exit...\n");
+    /* Wake the network thread if it waits for room in a full queue */
+    usb_client_close_out_queues(client);
+
+    /* No transfers left in flight: safe to close the devices */
     for (i = 0; i < client->device_count; i++) {
-        if (client->transfer_threads[i] != 0) {
-            pthread_join(client->transfer_threads[i], NULL);
-            client->transfer_threads[i] = 0;
+        if (client->devices[i].handle != NULL) {
+            usb_device_close(&client->devices[i]);
         }
     }
 
@@ -445,6 +2022,10 @@ int usb_client_stop(usb_client_t* client)
             uint32_t device_id;
             int result;
 
+            if (!client->device_ctx[i].attached) {
+                continue;
+            }
+
             device_id = ((uint32_t)client->devices[i].config.vendor_id << 16) |
                         client->devices[i].config.product_id;
 
@@ -456,8 +2037,10 @@ int usb_client_stop(usb_client_t* client)
         }
     }
 
-    /* Close network connection (this will cause network thread to exit) */
+    /* Close network connection; shutdown() wakes the network thread's
+     * blocking receive, which close() alone does not */
     if (client->socket_fd >= 0) {
+        shutdown(client->socket_fd, SHUT_RDWR);
         close(client->socket_fd);
         client->socket_fd = -1;
     }
@@ -486,41 +2069,50 @@ void usb_client_cleanup(usb_client_t* client)
 
     printf("Cleaning up USB client...\n");
 
+    /* Stopped here if the client shut itself down (network error) */
+    usb_client_stop_hotplug(client);
+
+    /* Release engine transfers before their device handles go away */
+    if (client->engine_initialized) {
+        usb_engine_stop(&client->engine);
+        usb_engine_cleanup(&client->engine);
+        client->engine_initialized = FALSE;
+    }
+
     /* Close all USB devices */
     if (client->devices != NULL) {
         for (i = 0; i < client->device_count; i++) {
             usb_device_close(&client->devices[i]);
+            usb_out_queue_cleanup(&client->device_ctx[i].out_queue);
+            usb_out_queue_cleanup(&client->device_ctx[i].iso_queue);
         }
         free(client->devices);
     }
 
-    /* Free thread array */
-    if (client->transfer_threads != NULL) {
-        free(client->transfer_threads);
+    /* Shared libusb context (after every device is closed) */
+    if (client->usb_ctx != NULL) {
+        usb_device_cleanup_library(client->usb_ctx);
+        client->usb_ctx = NULL;
     }
 
+    free(client->device_ctx);
+
     /* Free server IP */
     if (client->server_ip != NULL) {
         free(client->server_ip);
     }
 
-    /* Phase 5: Clean up any remaining pending requests */
-    {
-        usb_pending_request_t* req = client->pending_head;
-        usb_pending_request_t* next;
-        while (req != NULL) {
-            next = req->next;
-            pthread_mutex_destroy(&req->mutex);
-            pthread_cond_destroy(&req->cond);
-            free(req);
-            req = next;
-        }
-    }
+    /* Phase 5: Release the pending request table */
+    usb_client_destroy_pending_table(client);
 
     /* Destroy synchronization primitives */
     pthread_mutex_destroy(&client->lock);
     pthread_cond_destroy(&client->shutdown_cond);
     pthread_mutex_destroy(&client->pending_lock);
+    pthread_rwlock_destroy(&client->devices_lock);
+    pthread_mutex_destroy(&client->hotplug_lock);
+    pthread_cond_destroy(&client->hotplug_cond);
+    usb_batch_cleanup(&client->batch);
 
     /* Free client structure */
     free(client);
@@ -540,9 +2132,7 @@ int usb_client_send_urb(usb_client_t* client,
                         const void* data,
                         uint32_t data_len)
 {
-    xoe_packet_t packet;
     int result;
-    ssize_t sent;
 
     /* Validate parameters */
     if (client == NULL || urb_header == NULL) {
@@ -553,20 +2143,14 @@ int usb_client_send_urb(usb_client_t* client,
         return E_INVALID_ARGUMENT;
     }
 
-    /* Encapsulate URB into XOE packet */
-    result = usb_protocol_encapsulate(urb_header, data, data_len, &packet);
-    if (result != 0) {
-        return result;
-    }
-
-    /* Send packet to server using wire format (LIB-001/NET-006 fix) */
-    result = xoe_wire_send(client->socket_fd, &packet);
+    /* Send packet to server using wire format (LIB-001/NET-006 fix),
+     * batched with other small URBs while the link is busy */
+    result = usb_batch_send(&client->batch, client->socket_fd,
+                            urb_header, data, data_len);
     if (result != 0) {
         fprintf(stderr, "Failed to send URB to server: error %d\n", result);
-        usb_protocol_free_payload(&packet);  /* Free allocated payload */
-        return E_NETWORK_ERROR;
+        return (result == E_INVALID_ARGUMENT) ? result : E_NETWORK_ERROR;
     }
-    (void)sent;  /* Suppress unused warning */
 
     /* Update statistics */
     pthread_mutex_lock(&client->lock);
@@ -575,9 +2159,6 @@ int usb_client_send_urb(usb_client_t* client,
 
     pthread_mutex_unlock(&client->lock);
 
-    /* Free allocated payload after successful send */
-    usb_protocol_free_payload(&packet);
-
     return 0;
 }
 
@@ -728,115 +2309,387 @@ static int usb_client_handle_auth_challenge(usb_client_t* client,
 }
 
 /**
- * @brief Register device with server
+ * @brief Check a registration reply and take the granted URB size
+ *
+ * Also turns batching on if the server accepts USB_CMD_BATCH.
  */
-int usb_client_register_device(usb_client_t* client,
-                                uint32_t device_id,
-                                uint8_t device_class,
-                                unsigned int timeout_ms)
+static int usb_client_check_registration(usb_client_t* client,
+                                         const usb_urb_header_t* reg_urb,
+                                         const usb_urb_header_t* response_urb,
+                                         uint32_t urb_size,
+                                         uint32_t* granted_size)
+{
+    uint32_t granted;
+
+    /* Verify response is registration complete */
+    if (response_urb->command != USB_RET_REGISTER) {
+        fprintf(stderr, "Unexpected response command: 0x%04x\n",
+                response_urb->command);
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (response_urb->seqnum != reg_urb->seqnum) {
+        fprintf(stderr, "Sequence number mismatch: expected %u, got %u\n",
+                reg_urb->seqnum, response_urb->seqnum);
+        return E_PROTOCOL_ERROR;
+    }
+
+    /* Check registration result */
+    if (response_urb->status != 0) {
+        fprintf(stderr, "Server registration failed: status %d\n",
+                response_urb->status);
+        return response_urb->status;
+    }
+
+    /* Servers that unpack batches say so in every registration reply */
+    if ((response_urb->flags & USB_FLAG_BATCH) != 0) {
+        usb_batch_set_enabled(&client->batch, TRUE);
+    }
+
+    /* ...and those that take OUT credit likewise */
+    if ((response_urb->flags & USB_FLAG_CREDIT) != 0) {
+        pthread_mutex_lock(&client->lock);
+        client->credit_enabled = TRUE;
+        pthread_mutex_unlock(&client->lock);
+    }
+
+    /* Servers without large URB support leave transfer_length zero */
+    granted = usb_protocol_negotiate_urb_size(response_urb->transfer_length,
+                                              urb_size);
+    if (granted_size != NULL) {
+        *granted_size = granted;
+    }
+
+    printf("Device 0x%08x (class 0x%02x) registered with server successfully "
+           "(URB size %u)\n", reg_urb->device_id, reg_urb->endpoint, granted);
+    return 0;
+}
+
+/**
+ * @brief Exchange a registration through the network thread
+ *
+ * The replies (an authentication challenge, then USB_RET_REGISTER) all
+ * carry the registration's seqnum and reach us through one pending
+ * request, re-armed after the challenge is answered.
+ *
+ * @param response_urb Receives command, seqnum, status, flags and
+ *                     transfer_length of the final reply
+ */
+static int usb_client_register_pending(usb_client_t* client,
+                                       const usb_urb_header_t* reg_urb,
+                                       const void* reg_data,
+                                       uint32_t reg_len,
+                                       usb_urb_header_t* response_urb,
+                                       unsigned int timeout_ms)
+{
+    usb_pending_request_t* request;
+    uint8_t challenge[sizeof(usb_auth_payload_t)];
+    uint32_t challenge_len;
+    int result;
+    int kick;
+
+    request = usb_client_create_pending_request(
+        client, reg_urb->seqnum, reg_urb->device_id, reg_urb->endpoint,
+        challenge, sizeof(challenge),
+        (timeout_ms > 0) ? timeout_ms : USB_REGISTER_TIMEOUT_MS);
+    if (request == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    result = usb_client_send_urb(client, reg_urb, reg_data, reg_len);
+    if (result == 0) {
+        result = usb_client_wait_pending_request(client, request);
+    }
+
+    /* Handle auth challenge (once) */
+    if (result == 0 && request->response_command == USB_CMD_AUTH) {
+        challenge_len = request->response_received;
+
+        pthread_mutex_lock(&client->pending_lock);
+        request->response_received = 0;
+        request->status = 0;
+        request->completed = FALSE;
+        kick = usb_client_arm_request(client, request);
+        pthread_mutex_unlock(&client->pending_lock);
+        usb_client_kick_timers(client, kick);
+
+        result = usb_client_handle_auth_challenge(client, NULL, challenge,
+                                                  challenge_len,
+                                                  reg_urb->seqnum);
+        if (result != 0) {
+            fprintf(stderr, "Authentication failed: error %d\n", result);
+        } else {
+            result = usb_client_wait_pending_request(client, request);
+        }
+    }
+
+    /* Timed out by usb_client_cleanup_timeouts() */
+    if (result == 0 && request->response_command == 0) {
+        result = (request->status != 0) ? request->status : E_PROTOCOL_ERROR;
+    }
+
+    if (result == 0) {
+        memset(response_urb, 0, sizeof(*response_urb));
+        response_urb->command = request->response_command;
+        response_urb->seqnum = reg_urb->seqnum;
+        response_urb->status = request->status;
+        response_urb->transfer_length = request->response_transfer_length;
+        response_urb->flags = request->response_flags;
+    }
+
+    usb_client_free_pending_request(client, request);
+
+    return result;
+}
+
+/**
+ * @brief Set a receive timeout on the client socket (0 = blocking)
+ */
+static void usb_client_set_recv_timeout(usb_client_t* client,
+                                        unsigned int timeout_ms)
+{
+    struct timeval tv;
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    if (setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVTIMEO,
+                   &tv, sizeof(tv)) < 0 && timeout_ms > 0) {
+        fprintf(stderr, "Warning: failed to set socket timeout\n");
+    }
+}
+
+/**
+ * @brief Exchange one registration with the server
+ *
+ * @param reg_urb USB_CMD_REGISTER header (usb_client_build_register())
+ * @param reg_data Descriptors sent with it (NULL if none)
+ */
+static int usb_client_register_urb(usb_client_t* client,
+                                   const usb_urb_header_t* reg_urb,
+                                   const void* reg_data,
+                                   uint32_t reg_len,
+                                   uint32_t* granted_size,
+                                   unsigned int timeout_ms)
 {
-    usb_urb_header_t reg_urb, response_urb;
+    usb_urb_header_t response_urb;
     uint8_t response_data[USB_MAX_DATA_SIZE];
     uint32_t response_len = 0;
     int result = 0;
     int auth_attempted = FALSE;
 
-    /* Validate parameters */
-    if (client == NULL) {
-        return E_INVALID_ARGUMENT;
+    /* The network thread owns the socket once it runs (hotplug) */
+    if (client->network_thread != 0) {
+        result = usb_client_register_pending(client, reg_urb,
+                                             reg_data, reg_len,
+                                             &response_urb, timeout_ms);
+        if (result != 0) {
+            fprintf(stderr, "Failed to receive registration response: "
+                    "error %d\n", result);
+            return result;
+        }
+        return usb_client_check_registration(client, reg_urb, &response_urb,
+                                             reg_urb->transfer_length,
+                                             granted_size);
     }
 
-    /* Build registration URB */
-    memset(&reg_urb, 0, sizeof(reg_urb));
-    reg_urb.command = USB_CMD_REGISTER;
-    reg_urb.seqnum = usb_client_alloc_seqnum(client);
-    reg_urb.device_id = device_id;
-    reg_urb.endpoint = device_class;  /* Convention: device class in endpoint field */
-
     /* Send registration request */
-    result = usb_client_send_urb(client, &reg_urb, NULL, 0);
+    result = usb_client_send_urb(client, reg_urb, reg_data, reg_len);
     if (result != 0) {
         fprintf(stderr, "Failed to send registration request: error %d\n",
                 result);
         return result;
     }
 
-    /* Set socket receive timeout */
-    if (timeout_ms > 0) {
-        struct timeval tv;
-        tv.tv_sec = timeout_ms / 1000;
-        tv.tv_usec = (timeout_ms % 1000) * 1000;
-        if (setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVTIMEO,
-                       &tv, sizeof(tv)) < 0) {
-            fprintf(stderr, "Warning: failed to set socket timeout\n");
-        }
+    /* Set socket receive timeout */
+    if (timeout_ms > 0) {
+        usb_client_set_recv_timeout(client, timeout_ms);
+    }
+
+receive_response:
+    /* Wait for response */
+    response_len = sizeof(response_data);
+    result = usb_client_receive_urb(client, &response_urb, response_data,
+                                     &response_len);
+
+    if (result != 0) {
+        fprintf(stderr, "Failed to receive registration response: error %d\n",
+                result);
+        goto cleanup_timeout;
+    }
+
+    /* Handle auth challenge */
+    if (response_urb.command == USB_CMD_AUTH && !auth_attempted) {
+        auth_attempted = TRUE;
+
+        result = usb_client_handle_auth_challenge(client, &response_urb,
+                                                   response_data, response_len,
+                                                   reg_urb->seqnum);
+        if (result != 0) {
+            fprintf(stderr, "Authentication failed: error %d\n", result);
+            goto cleanup_timeout;
+        }
+
+        /* Wait for final registration response */
+        goto receive_response;
+    }
+
+    result = usb_client_check_registration(client, reg_urb, &response_urb,
+                                           reg_urb->transfer_length,
+                                           granted_size);
+
+cleanup_timeout:
+    /* Restore socket to blocking mode */
+    if (timeout_ms > 0) {
+        usb_client_set_recv_timeout(client, 0);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Register device with server
+ */
+int usb_client_register_device(usb_client_t* client,
+                                uint32_t device_id,
+                                uint8_t device_class,
+                                uint32_t urb_size,
+                                uint32_t iso_bandwidth,
+                                const usb_desc_cache_t* descriptors,
+                                uint32_t* granted_size,
+                                unsigned int timeout_ms)
+{
+    usb_urb_header_t reg_urb;
+    const void* reg_data = NULL;
+    uint32_t reg_len = 0;
+
+    /* Validate parameters */
+    if (client == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    usb_client_build_register(client, &reg_urb, device_id, device_class,
+                              urb_size, iso_bandwidth);
+
+    /* Descriptors travel as the data; the frame length gives their size */
+    if (descriptors != NULL && descriptors->size > 0) {
+        reg_data = descriptors->data;
+        reg_len = descriptors->size;
     }
 
-receive_response:
-    /* Wait for response */
-    response_len = sizeof(response_data);
-    result = usb_client_receive_urb(client, &response_urb, response_data,
-                                     &response_len);
+    return usb_client_register_urb(client, &reg_urb, reg_data, reg_len,
+                                   granted_size, timeout_ms);
+}
 
-    if (result != 0) {
-        fprintf(stderr, "Failed to receive registration response: error %d\n",
-                result);
-        goto cleanup_timeout;
+/**
+ * @brief Register every plugged-in device at startup, pipelined
+ *
+ * Sends all the USB_CMD_REGISTER requests before reading any reply, then
+ * answers challenges and checks results as they come back, matched to
+ * their device by seqnum. Startup thus costs about one (two with
+ * authentication) round trips whatever the number of devices, instead of
+ * that many per device.
+ *
+ * Runs before the network thread, which then owns the socket. Marks each
+ * registered slot attached; fails on the first refusal, as the devices
+ * are all expected to be served.
+ */
+static int usb_client_register_slots(usb_client_t* client)
+{
+    usb_urb_header_t* reg_urbs;
+    int* auth_attempted;
+    usb_urb_header_t response_urb;
+    uint8_t response_data[USB_MAX_DATA_SIZE];
+    uint32_t response_len;
+    const void* reg_data;
+    uint32_t reg_len;
+    int outstanding = 0;
+    int result = 0;
+    int i;
+
+    reg_urbs = (usb_urb_header_t*)calloc((size_t)client->device_count,
+                                         sizeof(usb_urb_header_t));
+    auth_attempted = (int*)calloc((size_t)client->device_count, sizeof(int));
+    if (reg_urbs == NULL || auth_attempted == NULL) {
+        free(reg_urbs);
+        free(auth_attempted);
+        return E_OUT_OF_MEMORY;
     }
 
-    /* Handle auth challenge */
-    if (response_urb.command == USB_CMD_AUTH && !auth_attempted) {
-        auth_attempted = TRUE;
+    /* Send every request first */
+    for (i = 0; i < client->device_count; i++) {
+        if (client->devices[i].handle == NULL) {
+            continue;  /* Hotplug device not present yet */
+        }
 
-        result = usb_client_handle_auth_challenge(client, &response_urb,
-                                                   response_data, response_len,
-                                                   reg_urb.seqnum);
+        usb_client_build_slot_register(client, &client->device_ctx[i],
+                                       &reg_urbs[i], &reg_data, &reg_len);
+        result = usb_client_send_urb(client, &reg_urbs[i], reg_data, reg_len);
         if (result != 0) {
-            fprintf(stderr, "Authentication failed: error %d\n", result);
-            goto cleanup_timeout;
+            fprintf(stderr, "Failed to send registration request for "
+                    "device %d: error %d\n", i + 1, result);
+            goto done;
         }
-
-        /* Wait for final registration response */
-        goto receive_response;
+        outstanding++;
     }
 
-    /* Verify response is registration complete */
-    if (response_urb.command != USB_RET_REGISTER) {
-        fprintf(stderr, "Unexpected response command: 0x%04x\n",
-                response_urb.command);
-        result = E_PROTOCOL_ERROR;
-        goto cleanup_timeout;
-    }
+    usb_client_set_recv_timeout(client, USB_REGISTER_TIMEOUT_MS);
 
-    if (response_urb.seqnum != reg_urb.seqnum) {
-        fprintf(stderr, "Sequence number mismatch: expected %u, got %u\n",
-                reg_urb.seqnum, response_urb.seqnum);
-        result = E_PROTOCOL_ERROR;
-        goto cleanup_timeout;
-    }
+    /* Then take the replies in whatever order they come */
+    while (outstanding > 0) {
+        response_len = sizeof(response_data);
+        result = usb_client_receive_urb(client, &response_urb, response_data,
+                                        &response_len);
+        if (result != 0) {
+            fprintf(stderr, "Failed to receive registration response: "
+                    "error %d\n", result);
+            break;
+        }
 
-    /* Check registration result */
-    if (response_urb.status != 0) {
-        fprintf(stderr, "Server registration failed: status %d\n",
-                response_urb.status);
-        result = response_urb.status;
-        goto cleanup_timeout;
-    }
+        for (i = 0; i < client->device_count; i++) {
+            if (reg_urbs[i].command == USB_CMD_REGISTER &&
+                !client->device_ctx[i].attached &&
+                reg_urbs[i].seqnum == response_urb.seqnum) {
+                break;
+            }
+        }
+        if (i == client->device_count) {
+            fprintf(stderr, "Unexpected response seqnum %u during "
+                    "registration\n", response_urb.seqnum);
+            result = E_PROTOCOL_ERROR;
+            break;
+        }
 
-    printf("Device 0x%08x (class 0x%02x) registered with server successfully\n",
-           device_id, device_class);
-    result = 0;
+        if (response_urb.command == USB_CMD_AUTH && !auth_attempted[i]) {
+            auth_attempted[i] = TRUE;
+            result = usb_client_handle_auth_challenge(client, &response_urb,
+                                                      response_data,
+                                                      response_len,
+                                                      reg_urbs[i].seqnum);
+            if (result != 0) {
+                fprintf(stderr, "Authentication failed: error %d\n", result);
+                break;
+            }
+            continue;
+        }
 
-cleanup_timeout:
-    /* Restore socket to blocking mode */
-    if (timeout_ms > 0) {
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-        setsockopt(client->socket_fd, SOL_SOCKET, SO_RCVTIMEO,
-                   &tv, sizeof(tv));
+        result = usb_client_check_registration(client, &reg_urbs[i],
+                                               &response_urb,
+                                               reg_urbs[i].transfer_length,
+                                               &client->device_ctx[i].urb_size);
+        if (result != 0) {
+            fprintf(stderr, "Failed to register device %d: error %d\n",
+                    i + 1, result);
+            break;
+        }
+        client->device_ctx[i].attached = TRUE;
+        outstanding--;
     }
 
+    usb_client_set_recv_timeout(client, 0);
+
+done:
+    free(reg_urbs);
+    free(auth_attempted);
     return result;
 }
 
@@ -847,6 +2700,7 @@ int usb_client_unregister_device(usb_client_t* client,
                                   uint32_t device_id)
 {
     usb_urb_header_t unreg_urb, response_urb;
+    usb_pending_request_t* request;
     uint32_t response_len;
     int result;
 
@@ -861,18 +2715,43 @@ int usb_client_unregister_device(usb_client_t* client,
     unreg_urb.seqnum = usb_client_alloc_seqnum(client);
     unreg_urb.device_id = device_id;
 
+    /* The network thread owns the socket once it runs: wait for the
+     * reply through a pending request */
+    request = NULL;
+    if (client->network_thread != 0) {
+        request = usb_client_create_pending_request(client, unreg_urb.seqnum,
+                                                    device_id, 0, NULL, 0,
+                                                    USB_REGISTER_TIMEOUT_MS);
+        if (request == NULL) {
+            return E_OUT_OF_MEMORY;
+        }
+    }
+
     /* Send unregistration request */
     result = usb_client_send_urb(client, &unreg_urb, NULL, 0);
     if (result != 0) {
         fprintf(stderr, "Failed to send unregistration request: error %d\n",
                 result);
+        usb_client_free_pending_request(client, request);
         return result;
     }
 
     /* Wait for unregistration response */
-    response_len = 0;
-    result = usb_client_receive_urb(client, &response_urb, NULL,
-                                     &response_len);
+    if (request != NULL) {
+        result = usb_client_wait_pending_request(client, request);
+        memset(&response_urb, 0, sizeof(response_urb));
+        response_urb.command = request->response_command;
+        response_urb.seqnum = unreg_urb.seqnum;
+        response_urb.status = request->status;
+        usb_client_free_pending_request(client, request);
+        if (result == 0 && response_urb.command == 0) {
+            result = E_TIMEOUT;  /* Timed out by the cleanup scan */
+        }
+    } else {
+        response_len = 0;
+        result = usb_client_receive_urb(client, &response_urb, NULL,
+                                         &response_len);
+    }
     if (result != 0) {
         fprintf(stderr, "Failed to receive unregistration response: error %d\n",
                 result);
@@ -919,6 +2798,7 @@ int usb_client_submit_urb_sync(usb_client_t* client,
                                 unsigned int timeout_ms)
 {
     usb_pending_request_t* request = NULL;
+    uint64_t start_ns;
     uint32_t seqnum;
     int result;
 
@@ -927,6 +2807,8 @@ int usb_client_submit_urb_sync(usb_client_t* client,
         return E_INVALID_ARGUMENT;
     }
 
+    start_ns = latency_now_ns();
+
     /* Allocate sequence number */
     seqnum = usb_client_alloc_seqnum(client);
     if (seqnum == 0) {
@@ -960,6 +2842,9 @@ int usb_client_submit_urb_sync(usb_client_t* client,
 
     /* Wait for response */
     result = usb_client_wait_pending_request(client, request);
+    if (result == 0) {
+        latency_record_since(LATENCY_USB_URB_COMPLETION, start_ns);
+    }
 
     /* Copy actual length from completed request */
     if (actual_len != NULL) {
@@ -971,6 +2856,11 @@ int usb_client_submit_urb_sync(usb_client_t* client,
         result = request->status;
     }
 
+    /* Stop the device side from still transferring it */
+    if (result == E_TIMEOUT) {
+        usb_client_unlink_request(client, request);
+    }
+
     /* Cleanup pending request */
     usb_client_free_pending_request(client, request);
 
@@ -991,25 +2881,29 @@ void* usb_client_network_thread(void* arg)
 {
     usb_client_t* client = (usb_client_t*)arg;
     usb_urb_header_t urb_header;
-    unsigned char data_buffer[USB_MAX_TRANSFER_SIZE];
+    usb_transfer_thread_ctx_t* target;
+    usb_iso_packet_t packets[USB_ISO_MAX_PACKETS];
+    unsigned char* data_buffer;
+    int transfer_type;
     uint32_t data_len;
+    uint32_t offset;
     int result;
     int running;
 
+    /* Sized for the largest URB any device negotiated */
+    data_buffer = (unsigned char*)malloc(client->max_urb_size);
+    if (data_buffer == NULL) {
+        fprintf(stderr, "Network receive thread: out of memory\n");
+        return NULL;
+    }
+
     printf("Network receive thread started\n");
 
+    /* Runs until the connection goes: usb_client_stop() unregisters the
+     * devices through this thread before it shuts the socket down */
     while (1) {
-        /* Check if shutdown requested */
-        pthread_mutex_lock(&client->lock);
-        running = client->running;
-        pthread_mutex_unlock(&client->lock);
-
-        if (!running) {
-            break;
-        }
-
         /* Receive URB from server */
-        data_len = sizeof(data_buffer);
+        data_len = client->max_urb_size;
         result = usb_client_receive_urb(client, &urb_header,
                                         data_buffer, &data_len);
 
@@ -1018,230 +2912,131 @@ void* usb_client_network_thread(void* arg)
         }
 
         if (result != 0) {
-            fprintf(stderr, "Network receive error: %d\n", result);
-            break;  /* Fatal error, exit thread */
-        }
-
-        /* Phase 5: Route response to pending request */
-        result = usb_client_complete_pending_request(
-            client,
-            urb_header.seqnum,
-            data_buffer,
-            urb_header.actual_length,
-            urb_header.status
-        );
+            pthread_mutex_lock(&client->lock);
+            running = client->running;
+            pthread_mutex_unlock(&client->lock);
 
-        if (result == E_NOT_FOUND) {
-            /* No pending request found - may be unsolicited data or timeout */
-            printf("Warning: Received URB with no matching request "
-                   "(seqnum=%u, device_id=0x%08x, endpoint=0x%02x)\n",
-                   urb_header.seqnum, urb_header.device_id, urb_header.endpoint);
-        } else if (result != 0) {
-            fprintf(stderr, "Error completing pending request: %d\n", result);
+            if (running) {
+                LOG_ERROR("Network receive error: %d", result);
+            }
+            break;  /* Fatal error or shutdown, exit thread */
         }
 
-        /* Update statistics */
-        pthread_mutex_lock(&client->lock);
-        client->packets_received++;
-        pthread_mutex_unlock(&client->lock);
-    }
-
-    printf("Network receive thread exiting\n");
-
-    return NULL;
-}
-
-/**
- * @brief Per-device USB transfer thread
- *
- * Handles USB transfers for a single device, reading from USB
- * and sending to network.
- */
-void* usb_client_transfer_thread(void* arg)
-{
-    usb_transfer_thread_ctx_t* ctx = (usb_transfer_thread_ctx_t*)arg;
-    usb_client_t* client;
-    usb_device_t* device;
-    usb_transfer_ctx_t* transfer_ctx = NULL;
-    unsigned char buffer[USB_MAX_TRANSFER_SIZE];
-    int result;
-    int running;
-    usb_urb_header_t urb_header;
-
-    if (ctx == NULL) {
-        return NULL;
-    }
-
-    client = ctx->client;
-    device = ctx->device;
-
-    printf("Transfer thread started for device %d (VID:PID %04x:%04x)\n",
-           ctx->device_index + 1,
-           device->config.vendor_id, device->config.product_id);
-
-    /* Allocate transfer context for async operations */
-    transfer_ctx = usb_transfer_alloc();
-    if (transfer_ctx == NULL) {
-        fprintf(stderr, "Failed to allocate transfer context for device %d\n",
-                ctx->device_index + 1);
-        free(ctx);
-        return NULL;
-    }
-
-    while (1) {
-        /* Check if shutdown requested */
-        pthread_mutex_lock(&client->lock);
-        running = client->running;
-        pthread_mutex_unlock(&client->lock);
+        /* OUT data pushed by the server goes to the device's queue and
+         * on to the bus as far as the device's transfers allow; the rest
+         * follows from the USB event thread as writes complete. With
+         * credit (USB_CMD_CREDIT) the server never pushes more than the
+         * queue holds; an older server is held back (TCP) while we wait
+         * for room here. Interrupt OUT skips the queue: one small report,
+         * submitted directly. Isochronous OUT is checked here so the
+         * jitter buffer only ever holds playable URBs */
+        if (urb_header.command == USB_CMD_UNLINK ||
+            urb_header.command == USB_RET_UNLINK) {
+            if (urb_header.command == USB_CMD_UNLINK) {
+                pthread_rwlock_rdlock(&client->devices_lock);
+                result = usb_client_handle_unlink(client, &urb_header);
+                pthread_rwlock_unlock(&client->devices_lock);
+                if (result != 0) {
+                    LOG_WARN("Failed to answer unlink seqnum=%u: error %d",
+                             urb_header.seqnum, result);
+                }
+            } else {
+                usb_client_complete_unlink(client, &urb_header);
+            }
 
-        if (!running) {
-            break;
+            pthread_mutex_lock(&client->lock);
+            client->packets_received++;
+            pthread_mutex_unlock(&client->lock);
+            continue;
         }
 
-        /* Phase 5.5: Bidirectional USB transfers
-         *
-         * IN endpoint (USB→Network): Read from device, send to server
-         * OUT endpoint (Network→USB): Send request to server, wait for data,
-         *                              write to device
-         */
-
-        if (device->config.bulk_in_endpoint != USB_NO_ENDPOINT) {
-            int transferred = 0;
-
-            /* Perform synchronous bulk read */
-            result = usb_transfer_bulk_read(
-                device,
-                device->config.bulk_in_endpoint,
-                buffer,
-                USB_MAX_TRANSFER_SIZE,
-                &transferred,
-                device->config.transfer_timeout_ms
-            );
-
-            /* Handle timeout (expected for IN polling) */
-            if (result == E_TIMEOUT) {
-                continue;  /* No data available, retry */
+        /* A device being detached waits for this before it goes */
+        pthread_rwlock_rdlock(&client->devices_lock);
+        target = (urb_header.command == USB_CMD_SUBMIT) ?
+                 usb_client_out_target(client, &urb_header, &transfer_type) :
+                 NULL;
+        if (target != NULL) {
+            if (urb_header.actual_length < data_len) {
+                data_len = urb_header.actual_length;
+            }
+            if (data_len == 0) {
+                result = 0;
+            } else if (transfer_type == USB_TRANSFER_ISOCHRONOUS) {
+                result = usb_protocol_iso_read_descriptors(
+                    data_buffer, data_len, urb_header.number_of_packets,
+                    packets, &offset);
+                if (result == 0) {
+                    result = usb_out_queue_push_urb(&target->iso_queue,
+                                                    urb_header.seqnum,
+                                                    data_buffer, data_len,
+                                                    urb_header.number_of_packets);
+                }
+                if (result == 0) {
+                    usb_client_pump_out(target, &target->iso_queue,
+                                        target->iso_out_ep);
+                }
+            } else if (transfer_type == USB_TRANSFER_INTERRUPT) {
+                result = usb_engine_write(target->int_out_ep, urb_header.seqnum,
+                                          data_buffer, (int)data_len,
+                                          (unsigned int)target->device->config.transfer_timeout_ms);
+            } else {
+                result = usb_out_queue_push_urb(&target->out_queue,
+                                                urb_header.seqnum,
+                                                data_buffer, data_len, 0);
+                if (result == 0) {
+                    usb_client_pump_out(target, &target->out_queue,
+                                        target->out_ep);
+                }
             }
+            pthread_rwlock_unlock(&client->devices_lock);
 
-            /* Handle other errors */
             if (result != 0) {
-                fprintf(stderr, "USB read error on device %d: %d\n",
-                        ctx->device_index + 1, result);
-
-                /* Update error statistics */
+                /* E_INVALID_STATE: stopping, or the device is gone */
+                if (result != E_INVALID_STATE) {
+                    LOG_WARN("Dropped OUT URB for device_id=0x%08x: error %d",
+                             urb_header.device_id, result);
+                }
                 pthread_mutex_lock(&client->lock);
                 client->transfer_errors++;
                 pthread_mutex_unlock(&client->lock);
-
-                continue;  /* Non-fatal error, retry */
-            }
-
-            /* Data received, prepare URB header */
-            memset(&urb_header, 0, sizeof(usb_urb_header_t));
-            urb_header.command = USB_CMD_SUBMIT;
-            urb_header.device_id = ((uint32_t)device->config.vendor_id << 16) |
-                                   device->config.product_id;
-            urb_header.endpoint = device->config.bulk_in_endpoint;
-            urb_header.transfer_type = USB_TRANSFER_BULK;
-            urb_header.transfer_length = (uint32_t)transferred;
-            urb_header.actual_length = (uint32_t)transferred;
-            urb_header.status = 0;  /* Success */
-
-            /* Send URB to server */
-            result = usb_client_send_urb(client, &urb_header,
-                                        buffer, (uint32_t)transferred);
-            if (result != 0) {
-                fprintf(stderr, "Failed to send URB for device %d: %d\n",
-                        ctx->device_index + 1, result);
-                break;  /* Network error, exit thread */
-            }
-
-            printf("Device %d: Sent %d bytes to server\n",
-                   ctx->device_index + 1, transferred);
-        }
-
-        /* Phase 5.5: Handle OUT endpoint (Network→USB) */
-        if (device->config.bulk_out_endpoint != USB_NO_ENDPOINT) {
-            unsigned char out_buffer[USB_MAX_TRANSFER_SIZE];
-            uint32_t actual_len = 0;
-
-            /* Prepare OUT request URB */
-            memset(&urb_header, 0, sizeof(usb_urb_header_t));
-            urb_header.command = USB_CMD_SUBMIT;
-            urb_header.device_id = ((uint32_t)device->config.vendor_id << 16) |
-                                   device->config.product_id;
-            urb_header.endpoint = device->config.bulk_out_endpoint;
-            urb_header.transfer_type = USB_TRANSFER_BULK;
-            urb_header.transfer_length = USB_MAX_TRANSFER_SIZE;
-
-            /* Submit bidirectional request to server */
-            result = usb_client_submit_urb_sync(
-                client,
-                &urb_header,
-                NULL,                       /* No data to send */
-                0,
-                out_buffer,                 /* Buffer for response */
-                USB_MAX_TRANSFER_SIZE,
-                &actual_len,
-                device->config.transfer_timeout_ms
-            );
-
-            /* Handle timeout (no OUT data available from server) */
-            if (result == E_TIMEOUT) {
-                continue;  /* Expected, retry */
-            }
-
-            /* Handle other errors */
-            if (result != 0) {
-                fprintf(stderr, "USB OUT request error on device %d: %d\n",
-                        ctx->device_index + 1, result);
-                continue;  /* Non-fatal, retry */
             }
 
-            /* Write received data to USB device */
-            if (actual_len > 0) {
-                int transferred = 0;
-
-                result = usb_transfer_bulk_write(
-                    device,
-                    device->config.bulk_out_endpoint,
-                    out_buffer,
-                    (int)actual_len,
-                    &transferred,
-                    device->config.transfer_timeout_ms
-                );
-
-                if (result != 0) {
-                    fprintf(stderr, "USB OUT write error on device %d: %d\n",
-                            ctx->device_index + 1, result);
+            pthread_mutex_lock(&client->lock);
+            client->packets_received++;
+            pthread_mutex_unlock(&client->lock);
+            continue;
+        }
 
-                    pthread_mutex_lock(&client->lock);
-                    client->transfer_errors++;
-                    pthread_mutex_unlock(&client->lock);
+        pthread_rwlock_unlock(&client->devices_lock);
 
-                    continue;
-                }
+        /* Phase 5: Route response to pending request. An authentication
+         * challenge leaves actual_length zero; its payload is the data */
+        result = usb_client_complete_request(
+            client,
+            &urb_header,
+            data_buffer,
+            (urb_header.command == USB_CMD_AUTH) ? data_len :
+                                                  urb_header.actual_length
+        );
 
-                printf("Device %d: Wrote %d bytes to USB OUT endpoint\n",
-                       ctx->device_index + 1, transferred);
-            }
+        if (result == E_NOT_FOUND) {
+            /* No pending request found - may be unsolicited data or timeout */
+            LOG_WARN("Received URB with no matching request "
+                     "(seqnum=%u, device_id=0x%08x, endpoint=0x%02x)",
+                     urb_header.seqnum, urb_header.device_id, urb_header.endpoint);
+        } else if (result != 0) {
+            LOG_ERROR("Error completing pending request: %d", result);
         }
 
-        /* If no endpoints configured, sleep briefly */
-        if (device->config.bulk_in_endpoint == USB_NO_ENDPOINT &&
-            device->config.bulk_out_endpoint == USB_NO_ENDPOINT) {
-            usleep(100000);  /* 100ms */
-        }
+        /* Update statistics */
+        pthread_mutex_lock(&client->lock);
+        client->packets_received++;
+        pthread_mutex_unlock(&client->lock);
     }
 
-    /* Cleanup - save device_index before freeing ctx (USB-003) */
-    {
-        int device_index = ctx->device_index;
-        usb_transfer_free(transfer_ctx);
-        free(ctx);
-        printf("Transfer thread exiting for device %d\n", device_index + 1);
-    }
+    printf("Network receive thread exiting\n");
 
+    free(data_buffer);
     return NULL;
 }
 
@@ -1254,19 +3049,33 @@ void* usb_client_transfer_thread(void* arg)
  */
 void usb_client_print_stats(const usb_client_t* client)
 {
+    unsigned long underruns = 0;
+    int i;
+
     if (client == NULL) {
         return;
     }
 
+    for (i = 0; i < client->device_count; i++) {
+        underruns += client->device_ctx[i].iso_queue.underruns;
+    }
+
     printf("\n========================================\n");
     printf(" USB Client Statistics\n");
     printf("========================================\n");
     printf("Devices:          %d / %d\n", client->device_count, client->max_devices);
     printf("Packets sent:     %lu\n", client->packets_sent);
+    printf("Frames sent:      %lu (%lu batches, %lu URBs, largest %d)\n",
+           client->batch.frames_sent, client->batch.batches_sent,
+           client->batch.batched_urbs, client->batch.largest_batch);
     printf("Packets received: %lu\n", client->packets_received);
     printf("Transfer errors:  %lu\n", client->transfer_errors);
+    printf("Iso underruns:    %lu\n", underruns);
     printf("Pending requests: %lu\n", client->pending_count);
-    printf("Timeouts:         %lu\n", client->timeouts);
+    printf("Timeouts:         %lu (%lu unlinked)\n", client->timeouts,
+           client->unlinks);
+    printf("Hotplug:          %lu attached, %lu detached\n",
+           client->hotplug_attaches, client->hotplug_detaches);
     printf("Running:          %s\n", client->running ? "Yes" : "No");
     printf("========================================\n\n");
 }
@@ -1312,7 +3121,7 @@ uint32_t usb_client_alloc_seqnum(usb_client_t* client)
 }
 
 /**
- * @brief Create and enqueue pending request
+ * @brief Claim a pending table slot for a request
  */
 usb_pending_request_t* usb_client_create_pending_request(
     usb_client_t* client,
@@ -1324,21 +3133,38 @@ usb_pending_request_t* usb_client_create_pending_request(
     unsigned int timeout_ms
 )
 {
-    usb_pending_request_t* request;
+    usb_pending_request_t* request = NULL;
+    int probe;
+    int kick;
 
     /* Validate parameters */
-    if (client == NULL) {
+    if (client == NULL || client->pending_table == NULL) {
         return NULL;
     }
 
-    /* Allocate request structure */
-    request = (usb_pending_request_t*)malloc(sizeof(usb_pending_request_t));
+    pthread_mutex_lock(&client->pending_lock);
+
+    /* Linear probe from the home slot for a free entry */
+    for (probe = 0; probe < USB_PENDING_TABLE_SIZE; probe++) {
+        usb_pending_request_t* slot =
+            &client->pending_table[(seqnum + (uint32_t)probe) &
+                                   USB_PENDING_TABLE_MASK];
+        if (!slot->in_use) {
+            request = slot;
+            break;
+        }
+    }
+
     if (request == NULL) {
-        return NULL;
+        pthread_mutex_unlock(&client->pending_lock);
+        return NULL;  /* Table full */
     }
 
-    /* Initialize request fields */
-    memset(request, 0, sizeof(usb_pending_request_t));
+    if (probe > client->pending_max_probe) {
+        client->pending_max_probe = probe;
+    }
+
+    /* Initialize request fields (cond is reused as-is) */
     request->seqnum = seqnum;
     request->device_id = device_id;
     request->endpoint = endpoint;
@@ -1346,30 +3172,17 @@ usb_pending_request_t* usb_client_create_pending_request(
     request->response_size = response_size;
     request->response_received = 0;
     request->status = 0;
+    request->response_command = 0;
+    request->response_transfer_length = 0;
     request->completed = FALSE;
-    request->timestamp_ms = get_time_ms();
+    request->in_use = TRUE;
+    request->unlinking = FALSE;
     request->timeout_ms = timeout_ms;
-    request->next = NULL;
-
-    /* Initialize synchronization (USB-006 fix: check return values) */
-    if (pthread_mutex_init(&request->mutex, NULL) != 0) {
-        free(request);
-        return NULL;
-    }
-    if (pthread_cond_init(&request->cond, NULL) != 0) {
-        pthread_mutex_destroy(&request->mutex);
-        free(request);
-        return NULL;
-    }
-
-    /* Add to pending queue */
-    pthread_mutex_lock(&client->pending_lock);
-
-    request->next = client->pending_head;
-    client->pending_head = request;
+    kick = usb_client_arm_request(client, request);
     client->pending_count++;
 
     pthread_mutex_unlock(&client->pending_lock);
+    usb_client_kick_timers(client, kick);
 
     return request;
 }
@@ -1406,10 +3219,10 @@ int usb_client_wait_pending_request(
             abs_timeout.tv_nsec -= 1000000000;
         }
 
-        pthread_mutex_lock(&request->mutex);
+        pthread_mutex_lock(&client->pending_lock);
         while (!request->completed && result == 0) {
             int wait_result = pthread_cond_timedwait(&request->cond,
-                                                     &request->mutex,
+                                                     &client->pending_lock,
                                                      &abs_timeout);
             if (wait_result == ETIMEDOUT) {
                 result = E_TIMEOUT;
@@ -1417,7 +3230,12 @@ int usb_client_wait_pending_request(
                 result = E_IO_ERROR;
             }
         }
-        pthread_mutex_unlock(&request->mutex);
+        if (result != 0) {
+            /* Drop a late response instead of writing into our buffer */
+            request->completed = TRUE;
+            timer_wheel_cancel(&client->timers, &request->timer);
+        }
+        pthread_mutex_unlock(&client->pending_lock);
     }
 
     return result;
@@ -1434,103 +3252,42 @@ int usb_client_complete_pending_request(
     int32_t status
 )
 {
-    usb_pending_request_t* request;
-    int found = FALSE;
-
-    /* Validate parameters */
-    if (client == NULL) {
-        return E_INVALID_ARGUMENT;
-    }
-
-    /* Find request in pending queue (USB-004 race fix) */
-    /* Hold pending_lock while acquiring request->mutex to prevent free */
-    pthread_mutex_lock(&client->pending_lock);
-
-    request = client->pending_head;
-    while (request != NULL) {
-        if (request->seqnum == seqnum) {
-            found = TRUE;
-            break;
-        }
-        request = request->next;
-    }
-
-    if (!found) {
-        pthread_mutex_unlock(&client->pending_lock);
-        return E_NOT_FOUND;
-    }
-
-    /* Lock request while still holding pending_lock (prevents race) */
-    pthread_mutex_lock(&request->mutex);
-    pthread_mutex_unlock(&client->pending_lock);
+    usb_urb_header_t reply;
 
-    /* Copy response data (now safe, we hold request->mutex) */
+    memset(&reply, 0, sizeof(reply));
+    reply.seqnum = seqnum;
+    reply.status = status;
 
-    if (data != NULL && data_len > 0 && request->response_data != NULL) {
-        uint32_t copy_len = (data_len < request->response_size) ?
-                           data_len : request->response_size;
-        memcpy(request->response_data, data, copy_len);
-        request->response_received = copy_len;
-    }
-    request->status = status;
-    request->completed = TRUE;
-
-    /* Signal condition variable */
-    pthread_cond_signal(&request->cond);
-    pthread_mutex_unlock(&request->mutex);
-
-    return 0;
+    return usb_client_complete_request(client, &reply, data, data_len);
 }
 
 /**
- * @brief Free pending request
+ * @brief Release a pending table slot
  */
 void usb_client_free_pending_request(
     usb_client_t* client,
     usb_pending_request_t* request
 )
 {
-    usb_pending_request_t* prev;
-    usb_pending_request_t* curr;
-
     if (client == NULL || request == NULL) {
         return;
     }
 
-    /* Remove from pending queue */
     pthread_mutex_lock(&client->pending_lock);
 
-    prev = NULL;
-    curr = client->pending_head;
-    while (curr != NULL) {
-        if (curr == request) {
-            if (prev == NULL) {
-                client->pending_head = curr->next;
-            } else {
-                prev->next = curr->next;
-            }
-            client->pending_count--;
-            break;
+    if (request->in_use) {
+        request->in_use = FALSE;
+        request->response_data = NULL;
+        timer_wheel_cancel(&client->timers, &request->timer);
+        client->pending_count--;
+
+        /* Probe bound only grows while requests overlap; reset when idle */
+        if (client->pending_count == 0) {
+            client->pending_max_probe = 0;
         }
-        prev = curr;
-        curr = curr->next;
     }
-    /* Suppress -Wunused-but-set-variable when request not found in list */
-    (void)prev;
 
-    /* Lock request mutex BEFORE releasing pending_lock to prevent race
-     * with usb_client_complete_pending_request. This ensures the completion
-     * handler cannot acquire request->mutex while we're destroying it. */
-    pthread_mutex_lock(&request->mutex);
     pthread_mutex_unlock(&client->pending_lock);
-
-    /* Request is now safe to destroy (completion handler can't access it) */
-    pthread_mutex_unlock(&request->mutex);
-    pthread_mutex_destroy(&request->mutex);
-    pthread_cond_destroy(&request->cond);
-
-    /* Free request structure */
-    free(request);
 }
 
 /**
@@ -1538,47 +3295,14 @@ void usb_client_free_pending_request(
  */
 int usb_client_cleanup_timeouts(usb_client_t* client)
 {
-    usb_pending_request_t* request;
-    usb_pending_request_t* next;
-    usb_pending_request_t* prev;
-    unsigned long current_time;
-    int timeout_count = 0;
+    int timeout_count;
 
-    if (client == NULL) {
+    if (client == NULL || client->pending_table == NULL) {
         return 0;
     }
 
-    current_time = get_time_ms();
-
-    /* Scan pending queue for timeouts */
     pthread_mutex_lock(&client->pending_lock);
-
-    prev = NULL;
-    request = client->pending_head;
-    while (request != NULL) {
-        next = request->next;
-
-        /* Check if request has timed out */
-        if (!request->completed &&
-            (current_time - request->timestamp_ms) >= request->timeout_ms) {
-
-            /* Mark as timed out and signal waiting thread */
-            pthread_mutex_lock(&request->mutex);
-            request->completed = TRUE;
-            request->status = E_TIMEOUT;
-            pthread_cond_signal(&request->cond);
-            pthread_mutex_unlock(&request->mutex);
-
-            timeout_count++;
-            client->timeouts++;
-        }
-
-        prev = request;
-        request = next;
-    }
-    /* Suppress -Wunused-but-set-variable (prev reserved for future removal logic) */
-    (void)prev;
-
+    timeout_count = timer_wheel_advance(&client->timers, get_time_ms());
     pthread_mutex_unlock(&client->pending_lock);
 
     return timeout_count;
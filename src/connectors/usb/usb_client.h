@@ -16,9 +16,28 @@
 #include "usb_config.h"
 #include "usb_device.h"
 #include "usb_transfer.h"
+#include "usb_engine.h"
+#include "usb_out_queue.h"
+#include "usb_desc_cache.h"
+#include "usb_batch.h"
 #include "lib/protocol/protocol.h"
+#include "lib/common/timer_wheel.h"
+#include "lib/net/sock_tune.h"
 #include <pthread.h>
 
+/* Time a timed-out request waits for its USB_RET_UNLINK */
+#define USB_UNLINK_TIMEOUT_MS   1000
+
+/* Time a device registration (or unregistration) waits for the server */
+#define USB_REGISTER_TIMEOUT_MS 5000
+
+/* Hotplug events waiting for the hotplug thread */
+#define USB_HOTPLUG_QUEUE_SIZE  16
+
+/* Pending request table size (power of two, indexed by seqnum) */
+#define USB_PENDING_TABLE_SIZE  64
+#define USB_PENDING_TABLE_MASK  (USB_PENDING_TABLE_SIZE - 1)
+
 /* Forward declaration for pending request structure */
 typedef struct usb_pending_request usb_pending_request_t;
 
@@ -28,6 +47,11 @@ typedef struct usb_pending_request usb_pending_request_t;
  * Tracks outgoing USB requests waiting for responses from the server.
  * Used for bidirectional transfer coordination.
  *
+ * Requests live in a fixed open-addressing table owned by the client
+ * (home slot = seqnum & USB_PENDING_TABLE_MASK, linear probing). Slot
+ * state is protected by the client's pending_lock; the condition
+ * variable is created once with the table and reused by every request.
+ *
  * Phase 5 Addition
  */
 struct usb_pending_request {
@@ -40,40 +64,114 @@ struct usb_pending_request {
     uint32_t response_size;             /* Size of response buffer */
     uint32_t response_received;         /* Bytes received */
     int32_t status;                     /* Transfer status */
+    uint16_t response_command;          /* Command of the reply (USB_RET_*,
+                                           or USB_CMD_AUTH for a challenge) */
+    uint32_t response_transfer_length;  /* transfer_length of the reply */
+    uint16_t response_flags;            /* flags of the reply */
 
-    /* Synchronization */
-    pthread_mutex_t mutex;              /* Response mutex */
+    /* Synchronization (guarded by client->pending_lock) */
     pthread_cond_t cond;                /* Response condition variable */
     int completed;                      /* Response received flag */
+    int in_use;                         /* Slot holds a live request */
+    int unlinking;                      /* Timed out, waiting for
+                                           USB_RET_UNLINK */
 
-    /* Timeout tracking */
-    unsigned long timestamp_ms;         /* Request timestamp */
+    /* Timeout tracking (timer on client->timers, guarded by
+     * client->pending_lock) */
+    timer_wheel_timer_t timer;          /* Deadline */
     unsigned int timeout_ms;            /* Timeout value */
-
-    /* List linkage */
-    usb_pending_request_t* next;        /* Next in queue */
 };
 
+/* Forward declaration for per-device context */
+typedef struct usb_client usb_client_t;
+
+/**
+ * @brief Device arrival or removal reported by libusb
+ *
+ * Queued by the hotplug callback (USB event thread), which must not
+ * block, and handled by the client's hotplug thread.
+ */
+typedef struct {
+    uint16_t vendor_id;                 /* Device VID */
+    uint16_t product_id;                /* Device PID */
+    int arrived;                        /* Plugged in (TRUE) or removed */
+} usb_hotplug_event_t;
+
+/**
+ * @brief Per-device transfer context
+ *
+ * Owned by the client (one per device slot). Shared by the device's
+ * engine endpoints, whose completions on the USB event thread drain its
+ * OUT queues, and the network thread that fills them. No thread is
+ * dedicated to a device.
+ *
+ * A slot of a device with enable_hotplug outlives the device: it is
+ * attached (endpoints and queues set up) while the device is
+ * plugged in and registered, and torn down again when it is removed.
+ */
+typedef struct {
+    usb_client_t* client;               /* Parent client context */
+    usb_device_t* device;               /* USB device for this thread */
+    int device_index;                   /* Device index in array */
+    usb_engine_endpoint_t* in_ep;       /* Queued bulk IN transfers */
+    usb_engine_endpoint_t* out_ep;      /* Queued bulk OUT transfers */
+    usb_engine_endpoint_t* int_in_ep;   /* Queued interrupt IN transfers */
+    usb_engine_endpoint_t* int_out_ep;  /* Interrupt OUT transfers */
+    usb_engine_endpoint_t* iso_in_ep;   /* Queued isochronous IN transfers */
+    usb_engine_endpoint_t* iso_out_ep;  /* Isochronous OUT transfers */
+    uint32_t urb_size;                  /* URB data size granted by server */
+    usb_desc_cache_t descriptors;       /* Read at open, sent at registration */
+    usb_out_queue_t out_queue;          /* OUT URBs pushed by the server */
+    usb_out_queue_t iso_queue;          /* Isochronous OUT jitter buffer */
+    int attached;                       /* Device open and registered
+                                           (guarded by devices_lock) */
+} usb_transfer_thread_ctx_t;
+
 /**
  * @brief USB client context structure
  *
  * Maintains state for USB client operation including network connection,
  * device management, and thread coordination.
  */
-typedef struct {
+struct usb_client {
     /* Network connection */
     int socket_fd;                      /* Network socket to server */
     char* server_ip;                    /* Server IP address */
     int server_port;                    /* Server port */
+    sock_tune_t sock_tune;              /* Options for the server socket */
+    usb_batch_t batch;                  /* Send path; batches small URBs */
+    int credit_enabled;                 /* Server honours USB_CMD_CREDIT:
+                                           OUT queues advertise windows
+                                           (guarded by lock) */
 
     /* USB devices */
     usb_device_t* devices;              /* Array of USB devices */
     int device_count;                   /* Number of active devices */
     int max_devices;                    /* Maximum devices supported */
+    uint32_t max_urb_size;              /* Largest granted URB (receive size) */
+
+    /* Pipelined transfers (one libusb context and event thread) */
+    struct libusb_context* usb_ctx;     /* Shared libusb context */
+    usb_engine_t engine;                /* Transfer engine */
+    int engine_initialized;             /* TRUE once engine is set up */
+    usb_transfer_thread_ctx_t* device_ctx; /* Per-device contexts */
+    pthread_rwlock_t devices_lock;      /* Held for reading by the network
+                                           thread while it uses a device
+                                           slot, for writing to detach one */
+
+    /* Hotplug (devices added with enable_hotplug) */
+    int hotplug_registered;             /* libusb callback registered */
+    int hotplug_handle;                 /* libusb_hotplug_callback_handle */
+    pthread_t hotplug_thread;           /* Attaches and detaches devices */
+    pthread_mutex_t hotplug_lock;       /* Protects the event queue */
+    pthread_cond_t hotplug_cond;        /* Event queued or stopping */
+    usb_hotplug_event_t hotplug_events[USB_HOTPLUG_QUEUE_SIZE];
+    int hotplug_head;                   /* Oldest queued event */
+    int hotplug_count;                  /* Events queued */
+    int hotplug_stop;                   /* Hotplug thread exit flag */
 
     /* Thread management */
     pthread_t network_thread;           /* Network receive thread */
-    pthread_t* transfer_threads;        /* Per-device transfer threads */
     pthread_mutex_t lock;               /* Thread synchronization */
     pthread_cond_t shutdown_cond;       /* Shutdown condition */
 
@@ -83,8 +181,15 @@ typedef struct {
 
     /* Phase 5: Request/response tracking */
     uint32_t next_seqnum;               /* Next sequence number */
-    usb_pending_request_t* pending_head; /* Pending requests queue head */
-    pthread_mutex_t pending_lock;       /* Pending queue lock */
+    usb_pending_request_t* pending_table; /* USB_PENDING_TABLE_SIZE slots */
+    int pending_max_probe;              /* Longest probe sequence in use */
+    pthread_mutex_t pending_lock;       /* Pending table lock */
+    timer_wheel_t timers;               /* Request deadlines (pending_lock) */
+    uint64_t timers_wakeup_ms;          /* When usb_client_wait() next
+                                           expires timers (pending_lock;
+                                           0 while not waiting) */
+    int timers_changed;                 /* An earlier deadline was armed
+                                           (guarded by lock) */
 
     /* Authentication */
     char auth_secret[USB_AUTH_SECRET_MAX]; /* Shared secret for server auth */
@@ -95,18 +200,11 @@ typedef struct {
     unsigned long transfer_errors;      /* Transfer error count */
     unsigned long pending_count;        /* Pending requests count */
     unsigned long timeouts;             /* Request timeout count */
-} usb_client_t;
-
-/**
- * @brief Thread context for per-device USB transfers
- *
- * Contains device-specific context passed to transfer threads.
- */
-typedef struct {
-    usb_client_t* client;               /* Parent client context */
-    usb_device_t* device;               /* USB device for this thread */
-    int device_index;                   /* Device index in array */
-} usb_transfer_thread_ctx_t;
+    unsigned long unlinks;              /* Timed-out requests the peer
+                                           cancelled */
+    unsigned long hotplug_attaches;     /* Devices attached on arrival */
+    unsigned long hotplug_detaches;     /* Devices detached on removal */
+};
 
 /* ========================================================================
  * Client Lifecycle Functions
@@ -130,12 +228,29 @@ usb_client_t* usb_client_init(const char* server_ip,
                                int server_port,
                                int max_devices);
 
+/**
+ * @brief Set the TCP options used for the server connection
+ *
+ * Defaults to the low-latency preset; URB requests and completions are
+ * small and wait on each other, so Nagle's algorithm only adds delay.
+ *
+ * @param client Client context
+ * @param tune Options to copy (NULL leaves the kernel defaults)
+ *
+ * Note: Takes effect on the next connect (usb_client_start()).
+ */
+void usb_client_set_sock_tune(usb_client_t* client, const sock_tune_t* tune);
+
 /**
  * @brief Add USB device to client
  *
  * Opens and initializes a USB device, adding it to the client's
  * device list for management.
  *
+ * With config->enable_hotplug the device need not be plugged in: its
+ * slot is kept and the device is attached when it arrives, detached
+ * when it is removed, as often as it comes and goes.
+ *
  * @param client Client context
  * @param config Device configuration
  * @return 0 on success, negative error code on failure
@@ -145,18 +260,54 @@ usb_client_t* usb_client_init(const char* server_ip,
 int usb_client_add_device(usb_client_t* client,
                           const usb_config_t* config);
 
+/**
+ * @brief Add several USB devices to client at once
+ *
+ * As usb_client_add_device() for each configuration, but the devices
+ * are opened (interface claimed, descriptors read) in parallel, so
+ * bringing up a gateway's devices takes about as long as the slowest
+ * one rather than the sum of all of them.
+ *
+ * Every slot is added even if a device fails to open; the first such
+ * error (other than a hotplug device being absent) is returned, and
+ * usb_client_cleanup() closes the ones that did open.
+ *
+ * @param client Client context
+ * @param configs Device configurations
+ * @param count Number of configurations
+ * @return 0 on success, negative error code on failure
+ *
+ * Note: Devices must be added before calling usb_client_start().
+ */
+int usb_client_add_devices(usb_client_t* client,
+                           const usb_config_t* configs,
+                           int count);
+
 /**
  * @brief Start USB client operation
  *
  * Connects to server and spawns worker threads for USB transfer
  * handling and network communication.
  *
+ * The plugged-in devices are registered in one pipelined exchange: every
+ * USB_CMD_REGISTER is sent before any reply is read, and authentication
+ * challenges are answered as they arrive, matched by seqnum.
+ *
  * @param client Client context
  * @return 0 on success, negative error code on failure
  *
  * Thread Architecture:
- * - Network receive thread: Handles incoming packets from server
- * - Per-device transfer threads: Handle USB I/O for each device
+ * - Network receive thread: Handles incoming packets from server and
+ *   queues OUT URBs the server pushes on their device's OUT queue,
+ *   submitting them while the endpoint has free transfers (interrupt
+ *   OUT URBs are submitted directly)
+ * - USB event thread: Runs the transfer engine for every device; keeps
+ *   transfer_depth bulk and interrupt transfers queued per endpoint,
+ *   forwards IN data (each interrupt report as its own URB) and refills
+ *   each OUT transfer that completes from the device's OUT queue
+ * - Hotplug thread (devices with enable_hotplug): Opens, registers and
+ *   starts the pipelines of a device when it is plugged in; stops,
+ *   unregisters and closes it when it is removed
  *
  * Note: This function returns immediately after starting threads.
  *       Use usb_client_wait() to block until shutdown.
@@ -254,10 +405,20 @@ int usb_client_set_auth_secret(usb_client_t* client, const char* secret);
  * Sends registration request to server and waits for confirmation.
  * Handles challenge-response authentication if required by server.
  * This must be called after connecting to server and before sending URBs.
+ * Once the network receive thread runs, the replies reach this call
+ * through the pending request table.
  *
  * @param client Client context
  * @param device_id Device identifier (VID:PID) to register
  * @param device_class USB device class code
+ * @param urb_size Largest URB data size the device can use
+ * @param iso_bandwidth Isochronous bytes per second to reserve (0 = none;
+ *                      see usb_config_iso_bandwidth())
+ * @param descriptors Device's descriptors for the server to answer
+ *                    descriptor reads from (NULL or empty = none)
+ * @param granted_size Receives the size granted by the server
+ *                     (USB_MAX_DATA_SIZE from servers without large URB
+ *                     support; may be NULL)
  * @param timeout_ms Timeout in milliseconds
  * @return 0 on success, negative error code on failure
  *
@@ -267,12 +428,17 @@ int usb_client_set_auth_secret(usb_client_t* client, const char* secret);
 int usb_client_register_device(usb_client_t* client,
                                 uint32_t device_id,
                                 uint8_t device_class,
+                                uint32_t urb_size,
+                                uint32_t iso_bandwidth,
+                                const usb_desc_cache_t* descriptors,
+                                uint32_t* granted_size,
                                 unsigned int timeout_ms);
 
 /**
  * @brief Unregister device from server
  *
- * Sends unregistration request to server and waits for confirmation.
+ * Sends unregistration request to server and waits for confirmation
+ * (up to USB_REGISTER_TIMEOUT_MS once the network receive thread runs).
  * This should be called before disconnecting from server.
  *
  * @param client Client context
@@ -288,6 +454,11 @@ int usb_client_unregister_device(usb_client_t* client,
  * Sends URB to server and waits for response using pending request API.
  * This is the high-level interface for bidirectional USB transfers.
  *
+ * On timeout the URB is unlinked (USB_CMD_UNLINK) so the device side
+ * does not go on to transfer it; the call then waits up to
+ * USB_UNLINK_TIMEOUT_MS more for the acknowledgement and still returns
+ * E_TIMEOUT.
+ *
  * @param client Client context
  * @param urb_header URB header to send
  * @param send_data Data to send with URB (may be NULL)
@@ -316,25 +487,19 @@ int usb_client_submit_urb_sync(usb_client_t* client,
 /**
  * @brief Network receive thread entry point
  *
- * Continuously receives packets from server and dispatches them
- * to appropriate device handlers.
+ * Continuously receives packets from server. SUBMITs for a device's
+ * bulk OUT endpoint go to that device's OUT queue (waiting while it is
+ * full), SUBMITs for its isochronous OUT endpoint to its jitter buffer,
+ * and on to the engine while it has free transfers; SUBMITs for its
+ * interrupt OUT endpoint straight to the engine.
+ * UNLINKs cancel such a URB and are answered with USB_RET_UNLINK;
+ * everything else completes a pending request.
  *
  * @param arg Client context (usb_client_t*)
  * @return Thread exit code
  */
 void* usb_client_network_thread(void* arg);
 
-/**
- * @brief Per-device transfer thread entry point
- *
- * Handles USB transfers for a single device, reading from USB
- * and sending to network.
- *
- * @param arg Transfer thread context (usb_transfer_thread_ctx_t*)
- * @return Thread exit code
- */
-void* usb_client_transfer_thread(void* arg);
-
 /* ========================================================================
  * Statistics and Status Functions
  * ======================================================================== */
@@ -373,8 +538,8 @@ uint32_t usb_client_alloc_seqnum(usb_client_t* client);
 /**
  * @brief Create and enqueue pending request
  *
- * Allocates a pending request structure and adds it to the pending queue
- * for response matching.
+ * Claims a slot in the pending table for response matching. No memory
+ * is allocated; the slot is released by usb_client_free_pending_request().
  *
  * @param client Client context
  * @param seqnum Sequence number for this request
@@ -383,7 +548,7 @@ uint32_t usb_client_alloc_seqnum(usb_client_t* client);
  * @param response_buffer Buffer to receive response data
  * @param response_size Size of response buffer
  * @param timeout_ms Timeout in milliseconds
- * @return Pointer to pending request, or NULL on failure
+ * @return Pointer to pending request, or NULL if the table is full
  */
 usb_pending_request_t* usb_client_create_pending_request(
     usb_client_t* client,
@@ -412,15 +577,17 @@ int usb_client_wait_pending_request(
 /**
  * @brief Complete pending request with response data
  *
- * Called by network receive thread when a response arrives.
- * Signals waiting threads and stores response data.
+ * Called by network receive thread when a response arrives. The request
+ * is found by seqnum in the pending table (normally its home slot);
+ * stores response data and signals the waiting thread.
  *
  * @param client Client context
  * @param seqnum Sequence number of completed request
  * @param data Response data
  * @param data_len Length of response data
  * @param status Transfer status
- * @return 0 on success, E_NOT_FOUND if request not found
+ * @return 0 on success, E_NOT_FOUND if no live request has this seqnum
+ *         (unsolicited, or already timed out or being unlinked)
  */
 int usb_client_complete_pending_request(
     usb_client_t* client,
@@ -433,7 +600,7 @@ int usb_client_complete_pending_request(
 /**
  * @brief Free pending request
  *
- * Removes request from pending queue and frees all resources.
+ * Returns the request's slot to the pending table.
  *
  * @param client Client context
  * @param request Pending request to free
@@ -446,8 +613,9 @@ void usb_client_free_pending_request(
 /**
  * @brief Clean up timed-out requests
  *
- * Scans pending queue and removes/signals any requests that have exceeded
- * their timeout value.
+ * Expires the request deadlines that passed on the client's timer wheel
+ * and signals their waiters. usb_client_wait() calls this as each
+ * deadline comes due.
  *
  * @param client Client context
  * @return Number of requests timed out
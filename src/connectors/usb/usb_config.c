@@ -38,10 +38,18 @@ void usb_config_init_defaults(usb_config_t* config)
     config->bulk_in_endpoint = USB_NO_ENDPOINT;
     config->bulk_out_endpoint = USB_NO_ENDPOINT;
     config->interrupt_in_endpoint = USB_NO_ENDPOINT;
+    config->interrupt_out_endpoint = USB_NO_ENDPOINT;
+    config->iso_in_endpoint = USB_NO_ENDPOINT;
+    config->iso_out_endpoint = USB_NO_ENDPOINT;
 
     /* Set transfer parameters */
     config->transfer_timeout_ms = USB_DEFAULT_TIMEOUT_MS;
     config->max_packet_size = USB_DEFAULT_MAX_PACKET;
+    config->transfer_depth = USB_DEFAULT_TRANSFER_DEPTH;
+    config->urb_size = USB_DEFAULT_URB_SIZE;
+    config->iso_packets = USB_DEFAULT_ISO_PACKETS;
+    config->iso_interval_us = USB_DEFAULT_ISO_INTERVAL_US;
+    config->iso_jitter_ms = USB_DEFAULT_ISO_JITTER_MS;
 
     /* Set flags */
     config->detach_kernel_driver = TRUE;  /* Auto-detach by default */
@@ -72,7 +80,10 @@ int usb_config_validate(const usb_config_t* config)
     /* At least one endpoint must be configured */
     if (config->bulk_in_endpoint == USB_NO_ENDPOINT &&
         config->bulk_out_endpoint == USB_NO_ENDPOINT &&
-        config->interrupt_in_endpoint == USB_NO_ENDPOINT) {
+        config->interrupt_in_endpoint == USB_NO_ENDPOINT &&
+        config->interrupt_out_endpoint == USB_NO_ENDPOINT &&
+        config->iso_in_endpoint == USB_NO_ENDPOINT &&
+        config->iso_out_endpoint == USB_NO_ENDPOINT) {
         return E_INVALID_ARGUMENT;
     }
 
@@ -92,6 +103,36 @@ int usb_config_validate(const usb_config_t* config)
         return E_INVALID_ARGUMENT;  /* IN endpoint must have bit 7 set */
     }
 
+    if (config->interrupt_out_endpoint != USB_NO_ENDPOINT &&
+        (config->interrupt_out_endpoint & 0x80) != 0) {
+        return E_INVALID_ARGUMENT;  /* OUT endpoint must NOT have bit 7 set */
+    }
+
+    if (config->iso_in_endpoint != USB_NO_ENDPOINT &&
+        (config->iso_in_endpoint & 0x80) == 0) {
+        return E_INVALID_ARGUMENT;  /* IN endpoint must have bit 7 set */
+    }
+
+    if (config->iso_out_endpoint != USB_NO_ENDPOINT &&
+        (config->iso_out_endpoint & 0x80) != 0) {
+        return E_INVALID_ARGUMENT;  /* OUT endpoint must NOT have bit 7 set */
+    }
+
+    /* Isochronous streaming parameters */
+    if (config->iso_packets <= 0 || config->iso_packets > USB_ISO_MAX_PACKETS) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (config->iso_interval_us < USB_MIN_ISO_INTERVAL_US ||
+        config->iso_interval_us % USB_MIN_ISO_INTERVAL_US != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (config->iso_jitter_ms < 0 ||
+        config->iso_jitter_ms > USB_MAX_ISO_JITTER_MS) {
+        return E_INVALID_ARGUMENT;
+    }
+
     /* Timeout must be positive */
     if (config->transfer_timeout_ms <= 0) {
         return E_INVALID_ARGUMENT;
@@ -102,9 +143,45 @@ int usb_config_validate(const usb_config_t* config)
         return E_INVALID_ARGUMENT;
     }
 
+    /* Transfer queue depth */
+    if (config->transfer_depth <= 0 ||
+        config->transfer_depth > USB_MAX_TRANSFER_DEPTH) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Requested URB size (server may grant less) */
+    if (config->urb_size < USB_MAX_DATA_SIZE ||
+        config->urb_size > USB_MAX_LARGE_DATA_SIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
     return 0;
 }
 
+/**
+ * @brief Isochronous bandwidth of a device
+ */
+uint32_t usb_config_iso_bandwidth(const usb_config_t* config,
+                                  int in_packet_size,
+                                  int out_packet_size)
+{
+    unsigned long long bytes = 0;
+
+    if (config == NULL || config->iso_interval_us <= 0) {
+        return 0;
+    }
+
+    if (config->iso_in_endpoint != USB_NO_ENDPOINT && in_packet_size > 0) {
+        bytes += (unsigned long long)in_packet_size;
+    }
+    if (config->iso_out_endpoint != USB_NO_ENDPOINT && out_packet_size > 0) {
+        bytes += (unsigned long long)out_packet_size;
+    }
+
+    bytes = bytes * 1000000ULL / (unsigned long long)config->iso_interval_us;
+    return (bytes > 0xFFFFFFFFULL) ? 0xFFFFFFFFU : (uint32_t)bytes;
+}
+
 /**
  * @brief Initialize multi-device configuration
  *
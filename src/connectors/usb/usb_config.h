@@ -12,6 +12,7 @@
 #define USB_CONFIG_H
 
 #include "lib/common/types.h"
+#include "usb_protocol.h"
 
 /* Maximum path/string lengths */
 #define USB_DEVICE_DESC_MAX     256
@@ -37,6 +38,14 @@
 #define USB_DEFAULT_MAX_PACKET      512
 #define USB_DEFAULT_INTERFACE       0
 #define USB_DEFAULT_CONFIGURATION   0
+#define USB_DEFAULT_TRANSFER_DEPTH  4   /* Queued transfers per endpoint */
+#define USB_MAX_TRANSFER_DEPTH      32
+#define USB_DEFAULT_URB_SIZE        USB_MAX_LARGE_DATA_SIZE /* Requested */
+#define USB_DEFAULT_ISO_PACKETS     8   /* Packets per isochronous URB */
+#define USB_DEFAULT_ISO_INTERVAL_US 1000 /* Full-speed frame */
+#define USB_MIN_ISO_INTERVAL_US     125 /* High-speed microframe */
+#define USB_DEFAULT_ISO_JITTER_MS   20  /* Isochronous OUT jitter buffer */
+#define USB_MAX_ISO_JITTER_MS       1000
 
 /**
  * @brief USB device configuration structure
@@ -58,14 +67,25 @@ typedef struct {
     uint8_t  bulk_in_endpoint;      /* Bulk IN endpoint (0x81, etc.) */
     uint8_t  bulk_out_endpoint;     /* Bulk OUT endpoint (0x01, etc.) */
     uint8_t  interrupt_in_endpoint; /* Interrupt IN (USB_NO_ENDPOINT if none) */
+    uint8_t  interrupt_out_endpoint; /* Interrupt OUT (USB_NO_ENDPOINT if none) */
+    uint8_t  iso_in_endpoint;       /* Isochronous IN (USB_NO_ENDPOINT if none) */
+    uint8_t  iso_out_endpoint;      /* Isochronous OUT (USB_NO_ENDPOINT if none) */
 
     /* Transfer parameters */
     int      transfer_timeout_ms;   /* Default timeout */
     int      max_packet_size;       /* Maximum packet size */
+    int      transfer_depth;        /* In-flight transfers per endpoint */
+    int      urb_size;              /* Largest URB requested from server */
+
+    /* Isochronous streams (audio/video class) */
+    int      iso_packets;           /* Packets (service intervals) per URB */
+    int      iso_interval_us;       /* Endpoint service interval */
+    int      iso_jitter_ms;         /* OUT data held back before playing */
 
     /* Flags */
     int      detach_kernel_driver;  /* Auto-detach kernel driver */
-    int      enable_hotplug;        /* Enable hotplug detection */
+    int      enable_hotplug;        /* Attach/detach as the device is
+                                       plugged in and removed */
 } usb_config_t;
 
 /**
@@ -104,9 +124,26 @@ void usb_config_init_defaults(usb_config_t* config);
  * - Interface number is >= 0
  * - At least one endpoint is configured
  * - Timeout and packet size are reasonable
+ * - Isochronous packet count, service interval (a multiple of
+ *   USB_MIN_ISO_INTERVAL_US) and jitter buffer are in range
  */
 int usb_config_validate(const usb_config_t* config);
 
+/**
+ * @brief Isochronous bandwidth of a device
+ *
+ * Bytes per second its isochronous endpoints move when every service
+ * interval carries a full packet: the amount reserved with the server.
+ *
+ * @param config Device configuration
+ * @param in_packet_size Bytes per interval of the IN endpoint (0 if none)
+ * @param out_packet_size Bytes per interval of the OUT endpoint (0 if none)
+ * @return Bytes per second (saturates at UINT32_MAX)
+ */
+uint32_t usb_config_iso_bandwidth(const usb_config_t* config,
+                                  int in_packet_size,
+                                  int out_packet_size);
+
 /**
  * @brief Initialize multi-device configuration
  *
@@ -0,0 +1,191 @@
+/*
+ * usb_desc_cache.c - Cached Standard USB Descriptors
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#include "usb_desc_cache.h"
+#include "lib/common/definitions.h"
+#include <string.h>
+
+/**
+ * @brief Index the record whose header starts at @p offset
+ *
+ * @return Bytes the record takes, or 0 if it does not fit the cache
+ */
+static uint32_t usb_desc_cache_index(usb_desc_cache_t* cache,
+                                     uint32_t offset,
+                                     uint32_t limit)
+{
+    const uint8_t* header = cache->data + offset;
+    usb_desc_record_t* record;
+    uint32_t length;
+
+    if (cache->count == USB_DESC_CACHE_MAX_RECORDS ||
+        limit - offset < USB_DESC_RECORD_HEADER_SIZE) {
+        return 0;
+    }
+
+    length = ((uint32_t)header[4] << 8) | header[5];
+    if (length == 0 ||
+        length > limit - offset - USB_DESC_RECORD_HEADER_SIZE) {
+        return 0;
+    }
+
+    record = &cache->records[cache->count++];
+    record->type = header[0];
+    record->index = header[1];
+    record->langid = (uint16_t)(((uint32_t)header[2] << 8) | header[3]);
+    record->offset = (uint16_t)(offset + USB_DESC_RECORD_HEADER_SIZE);
+    record->length = (uint16_t)length;
+
+    return USB_DESC_RECORD_HEADER_SIZE + length;
+}
+
+/**
+ * @brief Empty a cache
+ */
+void usb_desc_cache_init(usb_desc_cache_t* cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    cache->size = 0;
+    cache->count = 0;
+}
+
+/**
+ * @brief Add a descriptor
+ */
+int usb_desc_cache_add(usb_desc_cache_t* cache,
+                       uint8_t type,
+                       uint8_t index,
+                       uint16_t langid,
+                       const uint8_t* desc,
+                       uint32_t length)
+{
+    uint8_t* header;
+
+    if (cache == NULL || desc == NULL || length == 0 || length > 0xFFFF) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (cache->count == USB_DESC_CACHE_MAX_RECORDS ||
+        USB_DESC_RECORD_HEADER_SIZE + length > sizeof(cache->data) - cache->size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    header = cache->data + cache->size;
+    header[0] = type;
+    header[1] = index;
+    header[2] = (uint8_t)(langid >> 8);
+    header[3] = (uint8_t)langid;
+    header[4] = (uint8_t)(length >> 8);
+    header[5] = (uint8_t)length;
+    memcpy(header + USB_DESC_RECORD_HEADER_SIZE, desc, length);
+
+    cache->size += usb_desc_cache_index(cache, cache->size,
+                                        cache->size +
+                                        USB_DESC_RECORD_HEADER_SIZE + length);
+    return 0;
+}
+
+/**
+ * @brief Load a cache from its wire form
+ */
+int usb_desc_cache_parse(usb_desc_cache_t* cache,
+                         const uint8_t* data,
+                         uint32_t size)
+{
+    uint32_t used;
+
+    if (cache == NULL || (data == NULL && size > 0)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    usb_desc_cache_init(cache);
+    if (size > sizeof(cache->data)) {
+        return E_PROTOCOL_ERROR;
+    }
+    if (size > 0) {
+        memcpy(cache->data, data, size);
+    }
+
+    while (cache->size < size) {
+        used = usb_desc_cache_index(cache, cache->size, size);
+        if (used == 0) {
+            usb_desc_cache_init(cache);
+            return E_PROTOCOL_ERROR;
+        }
+        cache->size += used;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find a cached descriptor
+ */
+int usb_desc_cache_find(const usb_desc_cache_t* cache,
+                        uint8_t type,
+                        uint8_t index,
+                        uint16_t langid,
+                        const uint8_t** desc,
+                        uint32_t* length)
+{
+    const usb_desc_record_t* record;
+    int i;
+
+    if (cache == NULL || desc == NULL || length == NULL) {
+        return E_NOT_FOUND;
+    }
+
+    for (i = 0; i < cache->count; i++) {
+        record = &cache->records[i];
+        if (record->type == type && record->index == index &&
+            record->langid == langid) {
+            *desc = cache->data + record->offset;
+            *length = record->length;
+            return 0;
+        }
+    }
+
+    return E_NOT_FOUND;
+}
+
+/**
+ * @brief Answer a control request from the cache
+ */
+int usb_desc_cache_answer(const usb_desc_cache_t* cache,
+                          const uint8_t setup[8],
+                          const uint8_t** desc,
+                          uint32_t* length)
+{
+    uint16_t langid;
+    uint32_t requested;
+    int result;
+
+    if (setup == NULL || setup[0] != USB_REQ_TYPE_STANDARD_IN ||
+        setup[1] != USB_REQ_GET_DESCRIPTOR) {
+        return E_NOT_FOUND;
+    }
+
+    /* Setup fields are little-endian: wValue = type:index, wIndex = langid */
+    langid = (uint16_t)(setup[4] | ((uint16_t)setup[5] << 8));
+    requested = (uint32_t)setup[6] | ((uint32_t)setup[7] << 8);
+
+    result = usb_desc_cache_find(cache, setup[3], setup[2], langid,
+                                 desc, length);
+    if (result != 0) {
+        return result;
+    }
+
+    if (*length > requested) {
+        *length = requested;
+    }
+    return 0;
+}
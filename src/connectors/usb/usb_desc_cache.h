@@ -0,0 +1,139 @@
+/*
+ * usb_desc_cache.h - Cached Standard USB Descriptors
+ *
+ * A host reads a device's descriptors again and again: at attach, after
+ * each reset and whenever a driver probes it. Forwarded over a WAN,
+ * every read is a round trip to the client serving the device. The
+ * client instead reads the standard descriptors once when it opens the
+ * device and sends them with USB_CMD_REGISTER; the server keeps them
+ * with the registration and answers USB_CMD_ENUM and standard
+ * GET_DESCRIPTOR control URBs for the device itself.
+ *
+ * The cache holds its records in wire form (see usb_protocol.h), so
+ * sending it is a copy and receiving it one pass to check and index it.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#ifndef USB_DESC_CACHE_H
+#define USB_DESC_CACHE_H
+
+#include "usb_protocol.h"
+
+/* Sized to travel in an unnegotiated URB (USB_CMD_REGISTER, USB_RET_ENUM) */
+#define USB_DESC_CACHE_MAX_SIZE     USB_MAX_DATA_SIZE
+#define USB_DESC_CACHE_MAX_RECORDS  32
+
+/* Standard GET_DESCRIPTOR request (USB 2.0 section 9.4.3) */
+#define USB_REQ_TYPE_STANDARD_IN    0x80
+#define USB_REQ_GET_DESCRIPTOR      0x06
+
+/* Descriptor types kept in the cache */
+#define USB_DESC_TYPE_DEVICE        0x01
+#define USB_DESC_TYPE_CONFIG        0x02
+#define USB_DESC_TYPE_STRING        0x03
+#define USB_DESC_TYPE_BOS           0x0F
+
+/* bDeviceClass within a device descriptor */
+#define USB_DEVICE_DESC_CLASS_OFFSET 4
+
+/**
+ * @brief Index entry for one cached descriptor
+ */
+typedef struct {
+    uint8_t  type;                      /* bDescriptorType */
+    uint8_t  index;                     /* Descriptor index */
+    uint16_t langid;                    /* Language ID (strings, else 0) */
+    uint16_t offset;                    /* Descriptor bytes in data */
+    uint16_t length;                    /* Descriptor size */
+} usb_desc_record_t;
+
+/**
+ * @brief Descriptors of one device
+ */
+typedef struct {
+    uint8_t data[USB_DESC_CACHE_MAX_SIZE];  /* Records in wire form */
+    uint32_t size;                      /* Bytes used in data */
+    usb_desc_record_t records[USB_DESC_CACHE_MAX_RECORDS];
+    int count;                          /* Records held */
+} usb_desc_cache_t;
+
+/**
+ * @brief Empty a cache
+ *
+ * @param cache Cache to reset
+ */
+void usb_desc_cache_init(usb_desc_cache_t* cache);
+
+/**
+ * @brief Add a descriptor
+ *
+ * @param cache Cache
+ * @param type bDescriptorType it is requested by
+ * @param index Descriptor index
+ * @param langid Language ID for string descriptors, 0 otherwise
+ * @param desc Descriptor bytes
+ * @param length Number of bytes (1..65535)
+ * @return 0 on success, E_BUFFER_TOO_SMALL if the cache is full (the
+ *         cache is left unchanged), E_INVALID_ARGUMENT on bad arguments
+ */
+int usb_desc_cache_add(usb_desc_cache_t* cache,
+                       uint8_t type,
+                       uint8_t index,
+                       uint16_t langid,
+                       const uint8_t* desc,
+                       uint32_t length);
+
+/**
+ * @brief Load a cache from its wire form
+ *
+ * @param cache Cache to fill
+ * @param data Records as sent by the peer
+ * @param size Bytes of @p data
+ * @return 0 on success, E_PROTOCOL_ERROR if a record is cut off or the
+ *         records do not fit a cache (the cache is left empty),
+ *         E_INVALID_ARGUMENT on bad arguments
+ */
+int usb_desc_cache_parse(usb_desc_cache_t* cache,
+                         const uint8_t* data,
+                         uint32_t size);
+
+/**
+ * @brief Find a cached descriptor
+ *
+ * @param cache Cache
+ * @param type bDescriptorType
+ * @param index Descriptor index
+ * @param langid Language ID (0 for all but string descriptors)
+ * @param desc Receives a pointer into the cache
+ * @param length Receives the descriptor size
+ * @return 0 if cached, E_NOT_FOUND otherwise
+ */
+int usb_desc_cache_find(const usb_desc_cache_t* cache,
+                        uint8_t type,
+                        uint8_t index,
+                        uint16_t langid,
+                        const uint8_t** desc,
+                        uint32_t* length);
+
+/**
+ * @brief Answer a control request from the cache
+ *
+ * Only a standard device GET_DESCRIPTOR for a cached descriptor is
+ * answered; the reply is cut to wLength, as the device would.
+ *
+ * @param cache Cache
+ * @param setup Setup packet of the control URB (as on the bus)
+ * @param desc Receives a pointer to the reply data
+ * @param length Receives the reply size
+ * @return 0 if answered, E_NOT_FOUND if the request must go to the device
+ */
+int usb_desc_cache_answer(const usb_desc_cache_t* cache,
+                          const uint8_t setup[8],
+                          const uint8_t** desc,
+                          uint32_t* length);
+
+#endif /* USB_DESC_CACHE_H */
@@ -278,6 +278,15 @@ int usb_device_close(usb_device_t* dev)
         dev->handle = NULL;
     }
 
+    /* Release backend state */
+    if (dev->backend != NULL) {
+        if (dev->backend->close != NULL) {
+            dev->backend->close(dev);
+        }
+        dev->backend = NULL;
+        dev->backend_data = NULL;
+    }
+
     /* Clean up context if we own it */
     if (dev->owns_context && dev->ctx != NULL) {
         usb_device_cleanup_library(dev->ctx);
@@ -394,12 +403,163 @@ int usb_device_get_endpoints(usb_device_t* dev,
     return count;
 }
 
+/**
+ * @brief Get the maximum packet size of an endpoint
+ */
+int usb_device_get_max_packet_size(usb_device_t* dev, uint8_t endpoint)
+{
+    int size;
+
+    if (dev == NULL || dev->handle == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    size = libusb_get_max_packet_size(libusb_get_device(dev->handle), endpoint);
+    if (size <= 0) {
+        return dev->config.max_packet_size;
+    }
+    return size;
+}
+
+/**
+ * @brief Get the bytes an isochronous endpoint moves per service interval
+ */
+int usb_device_get_max_iso_packet_size(usb_device_t* dev, uint8_t endpoint)
+{
+    int size;
+
+    if (dev == NULL || dev->handle == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    size = libusb_get_max_iso_packet_size(libusb_get_device(dev->handle),
+                                          endpoint);
+    if (size <= 0) {
+        return dev->config.max_packet_size;
+    }
+    return size;
+}
+
+/**
+ * @brief Read a descriptor set whose total length follows its header
+ *
+ * Configuration and BOS descriptors carry wTotalLength at offset 2: read
+ * the header for it, then the whole set.
+ *
+ * @return Bytes read into @p buffer, or 0 if the set is unavailable or
+ *         larger than @p size
+ */
+static int read_descriptor_set(usb_device_t* dev,
+                               uint8_t type,
+                               uint8_t index,
+                               int header_size,
+                               unsigned char* buffer,
+                               int size)
+{
+    int length;
+    int total;
+
+    length = libusb_get_descriptor(dev->handle, type, index, buffer,
+                                   header_size);
+    if (length < header_size) {
+        return 0;
+    }
+
+    total = buffer[2] | (buffer[3] << 8);
+    if (total < header_size || total > size) {
+        return 0;
+    }
+
+    length = libusb_get_descriptor(dev->handle, type, index, buffer, total);
+    return (length == total) ? length : 0;
+}
+
+/**
+ * @brief Read the device's standard descriptors
+ */
+int usb_device_read_descriptors(usb_device_t* dev, usb_desc_cache_t* cache)
+{
+    unsigned char device_desc[LIBUSB_DT_DEVICE_SIZE];
+    unsigned char buffer[USB_DESC_CACHE_MAX_SIZE];
+    const uint8_t* cached;
+    uint32_t cached_length;
+    uint16_t langid;
+    uint16_t bcd_usb;
+    int length;
+    int i;
+
+    if (dev == NULL || dev->handle == NULL || cache == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    usb_desc_cache_init(cache);
+
+    length = libusb_get_descriptor(dev->handle, LIBUSB_DT_DEVICE, 0,
+                                   device_desc, sizeof(device_desc));
+    if (length < 0) {
+        return map_libusb_error(length);
+    }
+    if (length != LIBUSB_DT_DEVICE_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+    (void)usb_desc_cache_add(cache, LIBUSB_DT_DEVICE, 0, 0,
+                             device_desc, (uint32_t)length);
+
+    /* bNumConfigurations at offset 17 */
+    for (i = 0; i < device_desc[17]; i++) {
+        length = read_descriptor_set(dev, LIBUSB_DT_CONFIG, (uint8_t)i,
+                                     LIBUSB_DT_CONFIG_SIZE,
+                                     buffer, sizeof(buffer));
+        if (length > 0) {
+            (void)usb_desc_cache_add(cache, LIBUSB_DT_CONFIG, (uint8_t)i, 0,
+                                     buffer, (uint32_t)length);
+        }
+    }
+
+    /* Older devices stall a BOS request, so only ask those that have one */
+    bcd_usb = (uint16_t)(device_desc[2] | (device_desc[3] << 8));
+    if (bcd_usb >= 0x0201) {
+        length = read_descriptor_set(dev, LIBUSB_DT_BOS, 0, LIBUSB_DT_BOS_SIZE,
+                                     buffer, sizeof(buffer));
+        if (length > 0) {
+            (void)usb_desc_cache_add(cache, LIBUSB_DT_BOS, 0, 0,
+                                     buffer, (uint32_t)length);
+        }
+    }
+
+    /* String 0 lists the languages; devices without strings have none */
+    length = libusb_get_string_descriptor(dev->handle, 0, 0, buffer, 255);
+    if (length < 4) {
+        return 0;
+    }
+    (void)usb_desc_cache_add(cache, LIBUSB_DT_STRING, 0, 0,
+                             buffer, (uint32_t)length);
+    langid = (uint16_t)(buffer[2] | (buffer[3] << 8));
+
+    /* iManufacturer, iProduct, iSerialNumber at offsets 14..16 */
+    for (i = 14; i <= 16; i++) {
+        if (device_desc[i] == 0 ||
+            usb_desc_cache_find(cache, LIBUSB_DT_STRING, device_desc[i],
+                                langid, &cached, &cached_length) == 0) {
+            continue;  /* None, or shared with an earlier field */
+        }
+        length = libusb_get_string_descriptor(dev->handle, device_desc[i],
+                                              langid, buffer, 255);
+        if (length >= 2) {
+            (void)usb_desc_cache_add(cache, LIBUSB_DT_STRING, device_desc[i],
+                                     langid, buffer, (uint32_t)length);
+        }
+    }
+
+    return 0;
+}
+
 /**
  * @brief Check if device is connected
  */
 int usb_device_is_connected(const usb_device_t* dev)
 {
-    if (dev == NULL || dev->handle == NULL) {
+    if (dev == NULL || (dev->handle == NULL && dev->backend == NULL)) {
         return FALSE;
     }
 
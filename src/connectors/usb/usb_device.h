@@ -16,6 +16,36 @@
 
 #include "lib/usb_compat.h"
 #include "usb_config.h"
+#include "usb_desc_cache.h"
+
+typedef struct usb_device usb_device_t;
+
+/**
+ * @brief Non-libusb device backend
+ *
+ * A device opened through a backend (for example the virtual loopback
+ * device in usb_virtual.h) has no libusb handle; the synchronous
+ * transfer functions and usb_device_close() dispatch to these hooks
+ * instead. The asynchronous engine still requires a libusb handle.
+ */
+typedef struct {
+    const char* name;                   /* Backend name for diagnostics */
+
+    /**
+     * Bulk or interrupt transfer; the direction is taken from bit 7 of
+     * @p endpoint. Same contract as usb_transfer_bulk_read()/_write():
+     * 0 or a negative error code, with *transferred always set.
+     */
+    int (*transfer)(usb_device_t* dev,
+                    uint8_t endpoint,
+                    unsigned char* buffer,
+                    int length,
+                    int* transferred,
+                    unsigned int timeout);
+
+    /** Release backend state (called once by usb_device_close()) */
+    void (*close)(usb_device_t* dev);
+} usb_device_backend_t;
 
 /**
  * @brief USB device context structure
@@ -23,7 +53,7 @@
  * Maintains all state for a single USB device connection including
  * libusb handles, configuration, and connection status.
  */
-typedef struct {
+struct usb_device {
     /* libusb handles */
     struct libusb_context* ctx;         /* libusb context (may be shared) */
     struct libusb_device_handle* handle;/* Device handle */
@@ -35,7 +65,11 @@ typedef struct {
     int interface_claimed;              /* TRUE if interface claimed */
     int kernel_driver_detached;         /* TRUE if kernel driver was detached */
     int owns_context;                   /* TRUE if this device owns the context */
-} usb_device_t;
+
+    /* Alternative backend (NULL for libusb devices) */
+    const usb_device_backend_t* backend; /* Transfer hooks */
+    void* backend_data;                 /* Backend private state */
+};
 
 /**
  * @brief Initialize libusb library
@@ -122,6 +156,7 @@ int usb_device_open(usb_device_t* dev,
  * - Releasing claimed interface
  * - Re-attaching kernel driver if it was detached
  * - Closing device handle
+ * - Closing the backend, for backend devices
  * - Cleaning up context if owned
  *
  * @param dev Device context to cleanup
@@ -176,6 +211,47 @@ int usb_device_get_endpoints(usb_device_t* dev,
                               uint8_t* endpoints,
                               int max_endpoints);
 
+/**
+ * @brief Get the maximum packet size of an endpoint
+ *
+ * Reads wMaxPacketSize from the endpoint descriptor. Falls back to the
+ * configured max_packet_size when the descriptor cannot be read.
+ *
+ * @param dev Device context
+ * @param endpoint Endpoint address (with direction bit)
+ * @return Packet size in bytes, or negative error code
+ */
+int usb_device_get_max_packet_size(usb_device_t* dev, uint8_t endpoint);
+
+/**
+ * @brief Get the bytes an isochronous endpoint moves per service interval
+ *
+ * wMaxPacketSize times the transactions per microframe for high-bandwidth
+ * endpoints, as reported for the active alternate setting. Falls back to
+ * the configured max_packet_size when the descriptor cannot be read.
+ *
+ * @param dev Device context
+ * @param endpoint Endpoint address (with direction bit)
+ * @return Packet size in bytes, or negative error code
+ */
+int usb_device_get_max_iso_packet_size(usb_device_t* dev, uint8_t endpoint);
+
+/**
+ * @brief Read the device's standard descriptors
+ *
+ * Fills @p cache with the device descriptor, every configuration
+ * descriptor set, the BOS descriptor (USB 2.01 and later), the string
+ * language list and the device's manufacturer, product and serial
+ * number strings in the first language. Descriptors the device does not
+ * return, or that no longer fit the cache, are left out.
+ *
+ * @param dev Device context (libusb devices only)
+ * @param cache Cache to fill (emptied first)
+ * @return 0 on success, negative error code if not even the device
+ *         descriptor could be read
+ */
+int usb_device_read_descriptors(usb_device_t* dev, usb_desc_cache_t* cache);
+
 /**
  * @brief Check if device is connected
  *
@@ -0,0 +1,946 @@
+/*
+ * usb_engine.c - Pipelined USB Transfer Engine Implementation
+ *
+ * Each endpoint owns a fixed ring of libusb transfers. IN transfers are
+ * resubmitted from their completion callback; OUT transfers return to the
+ * free pool when they complete. One thread runs the libusb event loop for
+ * the shared context, so completions of every device are serialized there.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#include "usb_engine.h"
+#include "usb_transfer.h"
+#include "lib/common/definitions.h"
+#include "lib/common/stage_prof.h"
+#include "lib/common/thread_sched.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+
+/* ========================================================================
+ * Internal Helper Functions
+ * ======================================================================== */
+
+/**
+ * @brief Compute absolute deadline for pthread_cond_timedwait
+ */
+static void deadline_after_ms(struct timespec* ts, unsigned int timeout_ms)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    ts->tv_sec = now.tv_sec + (timeout_ms / 1000);
+    ts->tv_nsec = (now.tv_usec + (long)(timeout_ms % 1000) * 1000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * @brief Mark a slot idle (engine lock held)
+ */
+static void slot_release_locked(usb_engine_slot_t* slot)
+{
+    slot->in_flight = FALSE;
+    slot->ep->in_flight--;
+    pthread_cond_broadcast(&slot->ep->engine->cond);
+}
+
+/**
+ * @brief Convert a completed isochronous IN transfer to URB form
+ *
+ * Writes the packet descriptors followed by each packet's data, packed,
+ * to the endpoint's iso_body.
+ *
+ * @param ep Isochronous IN endpoint
+ * @param transfer Completed transfer
+ * @param has_data Set TRUE if any packet holds data or failed
+ * @return Bytes written to ep->iso_body
+ */
+static int iso_build_body(usb_engine_endpoint_t* ep,
+                          struct libusb_transfer* transfer,
+                          int* has_data)
+{
+    usb_iso_packet_t packets[USB_ISO_MAX_PACKETS];
+    uint32_t offset;
+    int i;
+
+    offset = USB_ISO_DESCRIPTORS_SIZE(transfer->num_iso_packets);
+    *has_data = FALSE;
+
+    for (i = 0; i < transfer->num_iso_packets; i++) {
+        const struct libusb_iso_packet_descriptor* desc =
+            &transfer->iso_packet_desc[i];
+
+        packets[i].length = desc->length;
+        packets[i].actual_length = desc->actual_length;
+        packets[i].status = usb_transfer_status_to_error(desc->status);
+        if (packets[i].status != 0) {
+            packets[i].actual_length = 0;
+            *has_data = TRUE;
+        } else if (desc->actual_length > 0) {
+            memcpy(ep->iso_body + offset,
+                   libusb_get_iso_packet_buffer_simple(transfer, (unsigned int)i),
+                   desc->actual_length);
+            offset += desc->actual_length;
+            *has_data = TRUE;
+        }
+    }
+
+    usb_protocol_iso_write_descriptors(ep->iso_body, packets,
+                                       transfer->num_iso_packets);
+    return (int)offset;
+}
+
+/**
+ * @brief Bytes sent by a completed isochronous OUT transfer
+ */
+static int iso_sent_length(const struct libusb_transfer* transfer)
+{
+    int length = 0;
+    int i;
+
+    for (i = 0; i < transfer->num_iso_packets; i++) {
+        length += (int)transfer->iso_packet_desc[i].actual_length;
+    }
+    return length;
+}
+
+/**
+ * @brief Handle a completed engine transfer (engine_transfer_callback())
+ */
+static void engine_transfer_done(struct libusb_transfer* transfer)
+{
+    usb_engine_slot_t* slot = (usb_engine_slot_t*)transfer->user_data;
+    usb_engine_endpoint_t* ep;
+    usb_engine_t* engine;
+    unsigned char* data;
+    STAGE_PROF_VAR(start);
+    int length;
+    int is_in;
+    int status;
+    int notify;
+    int result;
+
+    if (slot == NULL) {
+        return;
+    }
+
+    ep = slot->ep;
+    engine = ep->engine;
+    is_in = (ep->endpoint & 0x80) != 0;
+    status = usb_transfer_status_to_error(transfer->status);
+    data = (is_in && status == 0) ? slot->buffer : NULL;
+    length = transfer->actual_length;
+
+    if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE) {
+        pthread_mutex_lock(&engine->lock);
+        ep->halted = TRUE;
+        pthread_mutex_unlock(&engine->lock);
+    }
+
+    /* Decide whether the user hears about this completion */
+    if (ep->iso_packets > 0 && transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        /* Per-packet results; actual_length is not set for isochronous */
+        if (is_in) {
+            length = iso_build_body(ep, transfer, &notify);
+            data = ep->iso_body;
+        } else {
+            length = iso_sent_length(transfer);
+            notify = TRUE;
+        }
+    } else if (is_in) {
+        if (transfer->status == LIBUSB_TRANSFER_CANCELLED) {
+            notify = FALSE;
+        } else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT) {
+            /* Idle poll; forward any partial data that did arrive */
+            notify = (transfer->actual_length > 0);
+            status = 0;
+        } else {
+            notify = (status != 0 || transfer->actual_length > 0);
+        }
+    } else {
+        notify = TRUE;  /* Cancelled writes too: their slot is free again */
+    }
+
+    /* OUT: free the slot first, so the callback can queue the next write */
+    if (!is_in) {
+        pthread_mutex_lock(&engine->lock);
+        slot_release_locked(slot);
+        ep->completing++;
+        pthread_mutex_unlock(&engine->lock);
+
+        if (ep->on_complete != NULL) {
+            ep->on_complete(ep, status, data, length, ep->user_data);
+        }
+
+        pthread_mutex_lock(&engine->lock);
+        ep->completing--;
+        pthread_cond_broadcast(&engine->cond);
+        pthread_mutex_unlock(&engine->lock);
+        return;
+    }
+
+    if (notify && ep->on_complete != NULL) {
+        ep->on_complete(ep, status, data, length, ep->user_data);
+    }
+
+    pthread_mutex_lock(&engine->lock);
+
+    /* IN: keep the queue full unless shutting down or the device is gone */
+    if (is_in && !engine->stopping && !ep->halted &&
+        transfer->status != LIBUSB_TRANSFER_CANCELLED) {
+        STAGE_PROF_START(start);
+        result = libusb_submit_transfer(transfer);
+        STAGE_PROF_STOP(STAGE_USB_SUBMIT, start);
+        if (result == LIBUSB_SUCCESS) {
+            pthread_mutex_unlock(&engine->lock);
+            return;
+        }
+    }
+
+    slot_release_locked(slot);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * @brief libusb completion callback for every engine transfer
+ *
+ * Profiled as a whole, including the forward its handler makes.
+ */
+static void engine_transfer_callback(struct libusb_transfer* transfer)
+{
+    STAGE_PROF_VAR(start);
+
+    STAGE_PROF_START(start);
+    engine_transfer_done(transfer);
+    STAGE_PROF_STOP(STAGE_USB_COMPLETE, start);
+}
+
+/**
+ * @brief Event thread: run libusb completions for the shared context
+ */
+static void* engine_event_thread(void* arg)
+{
+    usb_engine_t* engine = (usb_engine_t*)arg;
+    struct timeval tv;
+
+    while (!engine->stop_events) {
+        tv.tv_sec = 0;
+        tv.tv_usec = USB_ENGINE_EVENT_TIMEOUT_MS * 1000;
+        libusb_handle_events_timeout_completed(engine->ctx, &tv,
+                                               &engine->stop_events);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Allocate an endpoint's buffer pool
+ *
+ * Prefers usbfs device memory: the kernel then transfers to and from the
+ * pool directly instead of through a bounce buffer of its own.
+ */
+static int endpoint_alloc_pool(usb_engine_endpoint_t* ep, size_t size)
+{
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    ep->pool = libusb_dev_mem_alloc(ep->device->handle, size);
+    if (ep->pool != NULL) {
+        ep->pool_dev_mem = TRUE;
+        ep->pool_size = size;
+        return 0;
+    }
+#endif
+
+    /* Not supported by the platform or kernel: plain memory */
+    ep->pool = (unsigned char*)malloc(size);
+    if (ep->pool == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    ep->pool_dev_mem = FALSE;
+    ep->pool_size = size;
+    return 0;
+}
+
+/**
+ * @brief Free an endpoint's transfers and buffers
+ */
+static void endpoint_free(usb_engine_endpoint_t* ep)
+{
+    int i;
+
+    if (ep->slots != NULL) {
+        for (i = 0; i < ep->depth; i++) {
+            if (ep->slots[i].in_flight) {
+                /* Still owned by libusb; leaking beats use-after-free */
+                return;
+            }
+        }
+        for (i = 0; i < ep->depth; i++) {
+            if (ep->slots[i].transfer != NULL) {
+                libusb_free_transfer(ep->slots[i].transfer);
+            }
+        }
+        free(ep->slots);
+    }
+#if defined(LIBUSB_API_VERSION) && LIBUSB_API_VERSION >= 0x01000105
+    if (ep->pool_dev_mem) {
+        libusb_dev_mem_free(ep->device->handle, ep->pool, ep->pool_size);
+        ep->pool = NULL;
+    }
+#endif
+    free(ep->pool);
+    if (ep->iso_body != NULL) {
+        free(ep->iso_body - USB_ENGINE_HEADROOM);
+    }
+    free(ep);
+}
+
+/**
+ * @brief Submit every transfer of an IN endpoint (engine lock held)
+ *
+ * OUT endpoints are left idle until written to.
+ */
+static int endpoint_prime_locked(usb_engine_endpoint_t* ep)
+{
+    int result;
+    int i;
+
+    if ((ep->endpoint & 0x80) == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < ep->depth; i++) {
+        result = libusb_submit_transfer(ep->slots[i].transfer);
+        if (result != LIBUSB_SUCCESS) {
+            return usb_transfer_map_error(result);
+        }
+        ep->slots[i].in_flight = TRUE;
+        ep->in_flight++;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stop resubmitting a device's transfers and cancel them
+ *        (engine lock held)
+ *
+ * @return Transfers of the device still in flight
+ */
+static int engine_halt_device_locked(usb_engine_t* engine,
+                                     const usb_device_t* device)
+{
+    usb_engine_endpoint_t* ep;
+    int pending = 0;
+    int i;
+
+    for (ep = engine->endpoints; ep != NULL; ep = ep->next) {
+        if (ep->device != device) {
+            continue;
+        }
+        ep->halted = TRUE;
+        for (i = 0; i < ep->depth; i++) {
+            if (ep->slots[i].in_flight) {
+                libusb_cancel_transfer(ep->slots[i].transfer);
+            }
+        }
+        pending += ep->in_flight + ep->completing;
+    }
+
+    /* Wake writers waiting for a slot of the device */
+    pthread_cond_broadcast(&engine->cond);
+    return pending;
+}
+
+/* ========================================================================
+ * Engine Lifecycle
+ * ======================================================================== */
+
+/**
+ * @brief Initialize a transfer engine
+ */
+int usb_engine_init(usb_engine_t* engine, struct libusb_context* ctx)
+{
+    if (engine == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(engine, 0, sizeof(usb_engine_t));
+    engine->ctx = ctx;
+
+    if (pthread_mutex_init(&engine->lock, NULL) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    if (pthread_cond_init(&engine->cond, NULL) != 0) {
+        pthread_mutex_destroy(&engine->lock);
+        return E_UNKNOWN_ERROR;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register a bulk, interrupt or isochronous endpoint with the engine
+ *
+ * @param iso_packets Packets per transfer for an isochronous endpoint
+ *                    (@p buffer_size split evenly), 0 otherwise
+ */
+static int engine_add_endpoint(usb_engine_t* engine,
+                               usb_device_t* device,
+                               uint8_t endpoint,
+                               int interrupt,
+                               int iso_packets,
+                               int depth,
+                               int buffer_size,
+                               usb_engine_complete_fn on_complete,
+                               void* user_data,
+                               usb_engine_endpoint_t** out_ep)
+{
+    usb_engine_endpoint_t* ep;
+    unsigned int timeout;
+    size_t stride;
+    int result;
+    int i;
+
+    if (engine == NULL || device == NULL || device->handle == NULL ||
+        depth <= 0 || buffer_size <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (engine->stopping) {
+        return E_INVALID_STATE;
+    }
+
+    ep = (usb_engine_endpoint_t*)malloc(sizeof(usb_engine_endpoint_t));
+    if (ep == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    memset(ep, 0, sizeof(usb_engine_endpoint_t));
+
+    ep->engine = engine;
+    ep->device = device;
+    ep->endpoint = endpoint;
+    ep->interrupt = interrupt;
+    ep->iso_packets = iso_packets;
+    ep->iso_packet_size = (iso_packets > 0) ? buffer_size / iso_packets : 0;
+    ep->depth = depth;
+    ep->buffer_size = buffer_size;
+    ep->on_complete = on_complete;
+    ep->user_data = user_data;
+
+    ep->slots = (usb_engine_slot_t*)calloc((size_t)depth, sizeof(usb_engine_slot_t));
+    if (ep->slots == NULL) {
+        free(ep);
+        return E_OUT_OF_MEMORY;
+    }
+
+    /* Headroom and buffer of each slot, one cache line aligned block */
+    stride = (USB_ENGINE_HEADROOM + (size_t)buffer_size +
+              USB_ENGINE_BUFFER_ALIGN - 1) &
+             ~(size_t)(USB_ENGINE_BUFFER_ALIGN - 1);
+    if (endpoint_alloc_pool(ep, stride * (size_t)depth) != 0) {
+        endpoint_free(ep);
+        return E_OUT_OF_MEMORY;
+    }
+
+    /* Isochronous IN completions are built here before being handed over */
+    if (iso_packets > 0 && (endpoint & 0x80) != 0) {
+        ep->iso_body = (unsigned char*)malloc(USB_ENGINE_HEADROOM +
+            USB_ISO_DESCRIPTORS_SIZE(iso_packets) + (size_t)buffer_size);
+        if (ep->iso_body == NULL) {
+            endpoint_free(ep);
+            return E_OUT_OF_MEMORY;
+        }
+        ep->iso_body += USB_ENGINE_HEADROOM;
+    }
+
+    /* Interrupt IN waits for the next report however long it takes:
+     * no timeout, so no idle resubmission between reports. Isochronous
+     * transfers complete once per service interval anyway */
+    timeout = ((interrupt && (endpoint & 0x80) != 0) || iso_packets > 0) ?
+              0 : (unsigned int)device->config.transfer_timeout_ms;
+
+    for (i = 0; i < depth; i++) {
+        usb_engine_slot_t* slot = &ep->slots[i];
+
+        slot->ep = ep;
+        slot->transfer = libusb_alloc_transfer(iso_packets);
+        slot->buffer = ep->pool + stride * (size_t)i + USB_ENGINE_HEADROOM;
+        if (slot->transfer == NULL) {
+            endpoint_free(ep);
+            return E_OUT_OF_MEMORY;
+        }
+
+        if (iso_packets > 0) {
+            libusb_fill_iso_transfer(slot->transfer, device->handle, endpoint,
+                                     slot->buffer, buffer_size, iso_packets,
+                                     engine_transfer_callback, slot, timeout);
+            libusb_set_iso_packet_lengths(slot->transfer,
+                                          (unsigned int)ep->iso_packet_size);
+        } else if (interrupt) {
+            libusb_fill_interrupt_transfer(slot->transfer, device->handle,
+                                           endpoint, slot->buffer, buffer_size,
+                                           engine_transfer_callback, slot,
+                                           timeout);
+        } else {
+            libusb_fill_bulk_transfer(slot->transfer, device->handle, endpoint,
+                                      slot->buffer, buffer_size,
+                                      engine_transfer_callback, slot, timeout);
+        }
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    ep->next = engine->endpoints;
+    engine->endpoints = ep;
+
+    /* Added to a running engine (hotplug): queue IN transfers now.
+     * On failure the endpoint stays halted until its device is removed */
+    if (engine->thread_started) {
+        result = endpoint_prime_locked(ep);
+        if (result != 0) {
+            ep->halted = TRUE;
+            pthread_mutex_unlock(&engine->lock);
+            return result;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    if (out_ep != NULL) {
+        *out_ep = ep;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register a bulk endpoint with the engine
+ */
+int usb_engine_add_endpoint(usb_engine_t* engine,
+                            usb_device_t* device,
+                            uint8_t endpoint,
+                            int depth,
+                            int buffer_size,
+                            usb_engine_complete_fn on_complete,
+                            void* user_data,
+                            usb_engine_endpoint_t** out_ep)
+{
+    return engine_add_endpoint(engine, device, endpoint, FALSE, 0, depth,
+                               buffer_size, on_complete, user_data, out_ep);
+}
+
+/**
+ * @brief Register an interrupt endpoint with the engine
+ */
+int usb_engine_add_interrupt_endpoint(usb_engine_t* engine,
+                                      usb_device_t* device,
+                                      uint8_t endpoint,
+                                      int depth,
+                                      int buffer_size,
+                                      usb_engine_complete_fn on_complete,
+                                      void* user_data,
+                                      usb_engine_endpoint_t** out_ep)
+{
+    return engine_add_endpoint(engine, device, endpoint, TRUE, 0, depth,
+                               buffer_size, on_complete, user_data, out_ep);
+}
+
+/**
+ * @brief Register an isochronous endpoint with the engine
+ */
+int usb_engine_add_iso_endpoint(usb_engine_t* engine,
+                                usb_device_t* device,
+                                uint8_t endpoint,
+                                int depth,
+                                int packets,
+                                int packet_size,
+                                usb_engine_complete_fn on_complete,
+                                void* user_data,
+                                usb_engine_endpoint_t** out_ep)
+{
+    if (packets <= 0 || packets > USB_ISO_MAX_PACKETS || packet_size <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    return engine_add_endpoint(engine, device, endpoint, FALSE, packets,
+                               depth, packets * packet_size, on_complete,
+                               user_data, out_ep);
+}
+
+/**
+ * @brief Queue all IN transfers and start the event thread
+ */
+int usb_engine_start(usb_engine_t* engine)
+{
+    usb_engine_endpoint_t* ep;
+    int result;
+
+    if (engine == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (engine->thread_started) {
+        return E_INVALID_STATE;
+    }
+
+    engine->stop_events = 0;
+    engine->stopping = FALSE;
+
+    /* Event thread first, so a failed prime can still drain via stop */
+    result = thread_sched_create(&engine->event_thread, THREAD_CLASS_USB,
+                                 engine_event_thread, engine);
+    if (result != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    engine->thread_started = TRUE;
+
+    /* Prime every IN queue */
+    pthread_mutex_lock(&engine->lock);
+    for (ep = engine->endpoints; ep != NULL; ep = ep->next) {
+        result = endpoint_prime_locked(ep);
+        if (result != 0) {
+            pthread_mutex_unlock(&engine->lock);
+            usb_engine_stop(engine);
+            return result;
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Wait for a free slot of an OUT endpoint
+ *
+ * Returns with the engine lock held and *slot set on success; the lock
+ * is released on failure.
+ */
+static int engine_claim_slot(usb_engine_endpoint_t* ep,
+                             unsigned int timeout_ms,
+                             usb_engine_slot_t** slot)
+{
+    usb_engine_t* engine = ep->engine;
+    struct timespec deadline;
+    int i;
+
+    if (timeout_ms > 0 && timeout_ms != USB_ENGINE_NO_WAIT) {
+        deadline_after_ms(&deadline, timeout_ms);
+    }
+
+    pthread_mutex_lock(&engine->lock);
+
+    /* Wait for a free slot */
+    while (!engine->stopping && !ep->halted && ep->in_flight >= ep->depth) {
+        if (timeout_ms == USB_ENGINE_NO_WAIT) {
+            pthread_mutex_unlock(&engine->lock);
+            return E_WOULD_BLOCK;
+        } else if (timeout_ms == 0) {
+            pthread_cond_wait(&engine->cond, &engine->lock);
+        } else if (pthread_cond_timedwait(&engine->cond, &engine->lock,
+                                          &deadline) == ETIMEDOUT) {
+            pthread_mutex_unlock(&engine->lock);
+            return E_TIMEOUT;
+        }
+    }
+
+    if (engine->stopping || ep->halted) {
+        pthread_mutex_unlock(&engine->lock);
+        return E_INVALID_STATE;
+    }
+
+    /* in_flight < depth guarantees a free slot */
+    for (i = 0; i < ep->depth; i++) {
+        if (!ep->slots[i].in_flight) {
+            *slot = &ep->slots[i];
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Submit a claimed slot and release the engine lock
+ */
+static int engine_submit_slot(usb_engine_slot_t* slot)
+{
+    usb_engine_t* engine = slot->ep->engine;
+    STAGE_PROF_VAR(start);
+    int result;
+
+    STAGE_PROF_START(start);
+    result = libusb_submit_transfer(slot->transfer);
+    STAGE_PROF_STOP(STAGE_USB_SUBMIT, start);
+    if (result != LIBUSB_SUCCESS) {
+        pthread_mutex_unlock(&engine->lock);
+        return usb_transfer_map_error(result);
+    }
+
+    slot->in_flight = TRUE;
+    slot->ep->in_flight++;
+
+    pthread_mutex_unlock(&engine->lock);
+    return 0;
+}
+
+/**
+ * @brief Queue an asynchronous write on an OUT endpoint
+ */
+int usb_engine_write(usb_engine_endpoint_t* ep,
+                     uint32_t tag,
+                     const unsigned char* data,
+                     int length,
+                     unsigned int timeout_ms)
+{
+    usb_engine_slot_t* slot = NULL;
+    int result;
+
+    if (ep == NULL || data == NULL || length <= 0 ||
+        (ep->endpoint & 0x80) != 0 || ep->iso_packets > 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (length > ep->buffer_size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    result = engine_claim_slot(ep, timeout_ms, &slot);
+    if (result != 0) {
+        return result;
+    }
+
+    memcpy(slot->buffer, data, (size_t)length);
+    slot->transfer->length = length;
+    slot->tag = tag;
+
+    return engine_submit_slot(slot);
+}
+
+/**
+ * @brief Queue an asynchronous write on an isochronous OUT endpoint
+ */
+int usb_engine_write_iso(usb_engine_endpoint_t* ep,
+                         uint32_t tag,
+                         const usb_iso_packet_t* packets,
+                         int count,
+                         const unsigned char* data,
+                         unsigned int timeout_ms)
+{
+    usb_engine_slot_t* slot = NULL;
+    int length = 0;
+    int result;
+    int i;
+
+    if (ep == NULL || packets == NULL || data == NULL || count <= 0 ||
+        (ep->endpoint & 0x80) != 0 || ep->iso_packets == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (count > ep->iso_packets) {
+        return E_BUFFER_TOO_SMALL;
+    }
+    for (i = 0; i < count; i++) {
+        if (packets[i].actual_length > (uint32_t)ep->iso_packet_size) {
+            return E_BUFFER_TOO_SMALL;
+        }
+        length += (int)packets[i].actual_length;
+    }
+
+    result = engine_claim_slot(ep, timeout_ms, &slot);
+    if (result != 0) {
+        return result;
+    }
+
+    /* libusb lays packets out back to back, as they arrive on the wire */
+    memcpy(slot->buffer, data, (size_t)length);
+    slot->transfer->num_iso_packets = count;
+    for (i = 0; i < count; i++) {
+        slot->transfer->iso_packet_desc[i].length = packets[i].actual_length;
+    }
+    slot->transfer->length = length;
+    slot->tag = tag;
+
+    return engine_submit_slot(slot);
+}
+
+/**
+ * @brief Cancel an OUT write still in flight
+ */
+int usb_engine_cancel(usb_engine_endpoint_t* ep, uint32_t tag)
+{
+    int result = E_NOT_FOUND;
+    int i;
+
+    if (ep == NULL || tag == 0 || (ep->endpoint & 0x80) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&ep->engine->lock);
+    for (i = 0; i < ep->depth; i++) {
+        if (ep->slots[i].in_flight && ep->slots[i].tag == tag) {
+            /* Fails only if the transfer is already completing */
+            if (libusb_cancel_transfer(ep->slots[i].transfer) ==
+                LIBUSB_SUCCESS) {
+                result = 0;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ep->engine->lock);
+
+    return result;
+}
+
+/**
+ * @brief Stop a device's transfers without waiting
+ */
+void usb_engine_halt_device(usb_engine_t* engine, const usb_device_t* device)
+{
+    if (engine == NULL || device == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    engine_halt_device_locked(engine, device);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+/**
+ * @brief Drain and release every endpoint of a device
+ */
+void usb_engine_remove_device(usb_engine_t* engine, const usb_device_t* device)
+{
+    usb_engine_endpoint_t* removed = NULL;
+    usb_engine_endpoint_t** link;
+    usb_engine_endpoint_t* ep;
+    struct timespec deadline;
+    int pending;
+
+    if (engine == NULL || device == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+
+    pending = engine_halt_device_locked(engine, device);
+
+    /* Let the event thread deliver the cancellations */
+    deadline_after_ms(&deadline, USB_ENGINE_DRAIN_TIMEOUT_MS);
+    while (pending > 0 && engine->thread_started) {
+        if (pthread_cond_timedwait(&engine->cond, &engine->lock,
+                                   &deadline) == ETIMEDOUT) {
+            break;
+        }
+        pending = 0;
+        for (ep = engine->endpoints; ep != NULL; ep = ep->next) {
+            if (ep->device == device) {
+                pending += ep->in_flight + ep->completing;
+            }
+        }
+    }
+
+    /* Unlink the device's endpoints; the others keep running */
+    link = &engine->endpoints;
+    while (*link != NULL) {
+        ep = *link;
+        if (ep->device == device) {
+            *link = ep->next;
+            ep->next = removed;
+            removed = ep;
+        } else {
+            link = &ep->next;
+        }
+    }
+
+    pthread_mutex_unlock(&engine->lock);
+
+    while (removed != NULL) {
+        ep = removed;
+        removed = ep->next;
+        endpoint_free(ep);
+    }
+}
+
+/**
+ * @brief Cancel all transfers and stop the event thread
+ */
+void usb_engine_stop(usb_engine_t* engine)
+{
+    usb_engine_endpoint_t* ep;
+    struct timespec deadline;
+    int pending;
+    int i;
+
+    if (engine == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&engine->lock);
+    engine->stopping = TRUE;
+    pthread_cond_broadcast(&engine->cond);
+
+    for (ep = engine->endpoints; ep != NULL; ep = ep->next) {
+        for (i = 0; i < ep->depth; i++) {
+            if (ep->slots[i].in_flight) {
+                /* May fail if already completing; the callback then sees
+                 * stopping and releases the slot itself */
+                libusb_cancel_transfer(ep->slots[i].transfer);
+            }
+        }
+    }
+
+    /* Let the event thread deliver the cancellations */
+    if (engine->thread_started) {
+        deadline_after_ms(&deadline, USB_ENGINE_DRAIN_TIMEOUT_MS);
+        while (1) {
+            pending = 0;
+            for (ep = engine->endpoints; ep != NULL; ep = ep->next) {
+                pending += ep->in_flight + ep->completing;
+            }
+            if (pending == 0) {
+                break;
+            }
+            if (pthread_cond_timedwait(&engine->cond, &engine->lock,
+                                       &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&engine->lock);
+
+    if (engine->thread_started) {
+        engine->stop_events = 1;
+        libusb_interrupt_event_handler(engine->ctx);
+        pthread_join(engine->event_thread, NULL);
+        engine->thread_started = FALSE;
+    }
+}
+
+/**
+ * @brief Release all engine resources
+ */
+void usb_engine_cleanup(usb_engine_t* engine)
+{
+    usb_engine_endpoint_t* ep;
+    usb_engine_endpoint_t* next;
+
+    if (engine == NULL) {
+        return;
+    }
+
+    for (ep = engine->endpoints; ep != NULL; ep = next) {
+        next = ep->next;
+        endpoint_free(ep);
+    }
+    engine->endpoints = NULL;
+
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->cond);
+}
@@ -0,0 +1,361 @@
+/*
+ * usb_engine.h - Pipelined USB Transfer Engine
+ *
+ * Keeps several libusb transfers queued per endpoint so the host
+ * controller always has a buffer to fill (IN) or drain (OUT) while the
+ * previous one is being forwarded. All completions are dispatched by a
+ * single libusb event thread serving the shared libusb context.
+ *
+ * Transfer buffers come from one pool per endpoint, allocated with
+ * libusb_dev_mem_alloc() where usbfs supports it so the kernel moves data
+ * straight to and from them (no bounce copy), falling back to malloc().
+ * Every buffer is preceded by USB_ENGINE_HEADROOM bytes, so an IN
+ * completion can be framed as a URB around the data where it landed.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#ifndef USB_ENGINE_H
+#define USB_ENGINE_H
+
+#include "lib/usb_compat.h"
+#include "usb_device.h"
+#include "usb_protocol.h"
+#include <pthread.h>
+
+/* Event loop wake-up interval (bounds shutdown latency on old libusb) */
+#define USB_ENGINE_EVENT_TIMEOUT_MS 100
+
+/* Time allowed for cancelled transfers to complete during stop */
+#define USB_ENGINE_DRAIN_TIMEOUT_MS 2000
+
+/* Writable bytes in front of IN data handed to the callback (URB header) */
+#define USB_ENGINE_HEADROOM         USB_URB_HEADER_WIRE_SIZE
+
+/* Alignment of each transfer buffer within the endpoint's pool */
+#define USB_ENGINE_BUFFER_ALIGN     64
+
+/* Write timeout: fail with E_WOULD_BLOCK instead of waiting for a slot */
+#define USB_ENGINE_NO_WAIT          ((unsigned int)-1)
+
+typedef struct usb_engine usb_engine_t;
+typedef struct usb_engine_endpoint usb_engine_endpoint_t;
+
+/**
+ * @brief Completion callback
+ *
+ * Runs on the engine's event thread. For IN endpoints it is called for
+ * every transfer that returned data (status 0) and for every failed
+ * transfer (negative status, data NULL); timeouts are resubmitted
+ * silently. For OUT endpoints it is called once per write with the
+ * transfer status (E_INTERRUPTED if cancelled) and the number of bytes
+ * written, after the write's slot was freed, so it may queue the next
+ * write with USB_ENGINE_NO_WAIT.
+ *
+ * Isochronous IN data is handed over in URB form: number_of_packets
+ * descriptors (see usb_protocol.h) followed by the packed packet data,
+ * with @p length covering both.
+ *
+ * IN @p data is preceded by USB_ENGINE_HEADROOM bytes the callback may
+ * overwrite, e.g. with usb_protocol_encapsulate_in_place(). Data and
+ * headroom stay valid until the callback returns.
+ *
+ * The callback may block (e.g. on a network send); the other queued
+ * transfers of the endpoint keep the device busy meanwhile.
+ *
+ * @param ep Endpoint the transfer belongs to
+ * @param status 0 on success, negative error code on failure
+ * @param data Received data (IN only, NULL otherwise)
+ * @param length Bytes received or written
+ * @param user_data Value given when the endpoint was added
+ */
+typedef void (*usb_engine_complete_fn)(usb_engine_endpoint_t* ep,
+                                       int status,
+                                       unsigned char* data,
+                                       int length,
+                                       void* user_data);
+
+/**
+ * @brief One queued libusb transfer and its buffer
+ */
+typedef struct {
+    struct libusb_transfer* transfer;   /* libusb transfer object */
+    unsigned char* buffer;              /* Transfer buffer (in the pool,
+                                           after USB_ENGINE_HEADROOM) */
+    usb_engine_endpoint_t* ep;          /* Owning endpoint */
+    uint32_t tag;                       /* Caller's tag of an OUT write */
+    int in_flight;                      /* Submitted or being completed */
+} usb_engine_slot_t;
+
+/**
+ * @brief Per-endpoint transfer queue
+ */
+struct usb_engine_endpoint {
+    usb_engine_t* engine;               /* Owning engine */
+    usb_device_t* device;               /* Device the endpoint belongs to */
+    uint8_t endpoint;                   /* Endpoint address (bit 7 = IN) */
+    int interrupt;                      /* Interrupt (TRUE) or bulk endpoint */
+    int iso_packets;                    /* Packets per isochronous transfer
+                                           (0 = bulk or interrupt) */
+    int iso_packet_size;                /* Bytes per isochronous packet */
+    unsigned char* iso_body;            /* Isochronous IN completion in URB
+                                           form, after USB_ENGINE_HEADROOM
+                                           (event thread only) */
+    int depth;                          /* Number of queued transfers */
+    int buffer_size;                    /* Bytes per transfer buffer */
+    usb_engine_slot_t* slots;           /* depth slots */
+    unsigned char* pool;                /* Buffers of all slots */
+    size_t pool_size;                   /* Bytes in the pool */
+    int pool_dev_mem;                   /* Pool from libusb_dev_mem_alloc() */
+    int in_flight;                      /* Slots currently in flight */
+    int completing;                     /* OUT callbacks still running */
+    int halted;                         /* Device gone, no resubmission */
+
+    usb_engine_complete_fn on_complete; /* Completion callback */
+    void* user_data;                    /* Callback context */
+
+    usb_engine_endpoint_t* next;        /* Engine endpoint list */
+};
+
+/**
+ * @brief Transfer engine state
+ */
+struct usb_engine {
+    struct libusb_context* ctx;         /* Shared libusb context */
+    usb_engine_endpoint_t* endpoints;   /* Registered endpoints */
+
+    pthread_t event_thread;             /* libusb event thread */
+    int thread_started;                 /* TRUE once event thread runs */
+    int stop_events;                    /* Event loop exit flag */
+    int stopping;                       /* No new submissions */
+
+    pthread_mutex_t lock;               /* Protects slots and flags */
+    pthread_cond_t cond;                /* Slot freed / in-flight drop */
+};
+
+/**
+ * @brief Initialize a transfer engine
+ *
+ * @param engine Engine to initialize
+ * @param ctx libusb context shared by every device the engine serves
+ * @return 0 on success, negative error code on failure
+ */
+int usb_engine_init(usb_engine_t* engine, struct libusb_context* ctx);
+
+/**
+ * @brief Register a bulk endpoint with the engine
+ *
+ * Allocates @p depth transfers and buffers. IN endpoints are submitted
+ * by usb_engine_start() and resubmitted on every completion; OUT
+ * endpoints are fed with usb_engine_write().
+ *
+ * @param engine Engine
+ * @param device Opened device
+ * @param endpoint Bulk endpoint address
+ * @param depth Number of transfers to keep queued (>= 1)
+ * @param buffer_size Bytes per transfer
+ * @param on_complete Completion callback (may be NULL for OUT)
+ * @param user_data Callback context
+ * @param out_ep Receives the endpoint handle (may be NULL)
+ * @return 0 on success, negative error code on failure
+ *
+ * Note: Endpoints added after usb_engine_start() (a hotplugged device)
+ *       have their IN transfers queued at once.
+ */
+int usb_engine_add_endpoint(usb_engine_t* engine,
+                            usb_device_t* device,
+                            uint8_t endpoint,
+                            int depth,
+                            int buffer_size,
+                            usb_engine_complete_fn on_complete,
+                            void* user_data,
+                            usb_engine_endpoint_t** out_ep);
+
+/**
+ * @brief Register an interrupt endpoint with the engine
+ *
+ * Same queueing as usb_engine_add_endpoint() with interrupt transfers.
+ * IN transfers have no timeout: each one stays queued until the device
+ * sends a report, and is resubmitted as soon as its completion has been
+ * handed to @p on_complete, so reports are forwarded one by one.
+ *
+ * @param engine Engine
+ * @param device Opened device
+ * @param endpoint Interrupt endpoint address
+ * @param depth Number of transfers to keep queued (>= 1)
+ * @param buffer_size Bytes per transfer. For IN use the endpoint's
+ *                    wMaxPacketSize: a larger buffer keeps a full-size
+ *                    report waiting for the next one.
+ * @param on_complete Completion callback (may be NULL for OUT)
+ * @param user_data Callback context
+ * @param out_ep Receives the endpoint handle (may be NULL)
+ * @return 0 on success, negative error code on failure
+ *
+ * Note: Endpoints added after usb_engine_start() (a hotplugged device)
+ *       have their IN transfers queued at once.
+ */
+int usb_engine_add_interrupt_endpoint(usb_engine_t* engine,
+                                      usb_device_t* device,
+                                      uint8_t endpoint,
+                                      int depth,
+                                      int buffer_size,
+                                      usb_engine_complete_fn on_complete,
+                                      void* user_data,
+                                      usb_engine_endpoint_t** out_ep);
+
+/**
+ * @brief Register an isochronous endpoint with the engine
+ *
+ * Each of the @p depth transfers carries @p packets packets of
+ * @p packet_size bytes, so the queue covers depth x packets service
+ * intervals of the endpoint. IN transfers have no timeout and are
+ * resubmitted as soon as their completion has been handed over; OUT
+ * endpoints are fed with usb_engine_write_iso().
+ *
+ * @param engine Engine
+ * @param device Opened device
+ * @param endpoint Isochronous endpoint address
+ * @param depth Number of transfers to keep queued (>= 1)
+ * @param packets Packets per transfer (1..USB_ISO_MAX_PACKETS)
+ * @param packet_size Bytes per packet: the endpoint's bytes per service
+ *                    interval (wMaxPacketSize x transactions)
+ * @param on_complete Completion callback (may be NULL for OUT)
+ * @param user_data Callback context
+ * @param out_ep Receives the endpoint handle (may be NULL)
+ * @return 0 on success, negative error code on failure
+ *
+ * Note: Endpoints added after usb_engine_start() (a hotplugged device)
+ *       have their IN transfers queued at once.
+ */
+int usb_engine_add_iso_endpoint(usb_engine_t* engine,
+                                usb_device_t* device,
+                                uint8_t endpoint,
+                                int depth,
+                                int packets,
+                                int packet_size,
+                                usb_engine_complete_fn on_complete,
+                                void* user_data,
+                                usb_engine_endpoint_t** out_ep);
+
+/**
+ * @brief Queue all IN transfers and start the event thread
+ *
+ * @param engine Engine
+ * @return 0 on success, negative error code on failure
+ */
+int usb_engine_start(usb_engine_t* engine);
+
+/**
+ * @brief Queue an asynchronous write on an OUT endpoint
+ *
+ * Copies @p data into a free slot and submits it. Blocks only while all
+ * slots of the endpoint are in flight.
+ *
+ * @param ep OUT endpoint
+ * @param tag Identifies the write to usb_engine_cancel() (the URB's
+ *            seqnum; 0 = not cancellable)
+ * @param data Data to write
+ * @param length Number of bytes (at most the endpoint buffer size)
+ * @param timeout_ms Maximum wait for a free slot (0 = no limit,
+ *                   USB_ENGINE_NO_WAIT = do not wait)
+ * @return 0 once queued, E_TIMEOUT if no slot freed in time,
+ *         E_WOULD_BLOCK if none was free with USB_ENGINE_NO_WAIT,
+ *         E_INVALID_STATE if the engine is stopping or the device is gone,
+ *         other negative error code on failure
+ */
+int usb_engine_write(usb_engine_endpoint_t* ep,
+                     uint32_t tag,
+                     const unsigned char* data,
+                     int length,
+                     unsigned int timeout_ms);
+
+/**
+ * @brief Queue an asynchronous write on an isochronous OUT endpoint
+ *
+ * Same slot handling as usb_engine_write(). Packet i sends
+ * packets[i].actual_length bytes, taken from @p data right after the
+ * bytes of packet i-1.
+ *
+ * @param ep Isochronous OUT endpoint
+ * @param tag As for usb_engine_write()
+ * @param packets Packet descriptors
+ * @param count Number of packets (at most the endpoint's packet count)
+ * @param data Packed packet data
+ * @param timeout_ms As for usb_engine_write()
+ * @return 0 once queued, E_BUFFER_TOO_SMALL if a packet exceeds the
+ *         endpoint's packet size, otherwise as usb_engine_write()
+ */
+int usb_engine_write_iso(usb_engine_endpoint_t* ep,
+                         uint32_t tag,
+                         const usb_iso_packet_t* packets,
+                         int count,
+                         const unsigned char* data,
+                         unsigned int timeout_ms);
+
+/**
+ * @brief Cancel an OUT write still in flight
+ *
+ * Asks libusb to cancel the write queued with @p tag. The cancellation
+ * completes on the event thread, which frees the slot and reports the
+ * write to the completion callback with E_INTERRUPTED. A write already
+ * being completed finishes normally.
+ *
+ * @param ep OUT endpoint
+ * @param tag Tag given to usb_engine_write() or usb_engine_write_iso()
+ * @return 0 if a cancellation was requested, E_NOT_FOUND if no write
+ *         with @p tag is in flight, E_INVALID_ARGUMENT on bad arguments
+ */
+int usb_engine_cancel(usb_engine_endpoint_t* ep, uint32_t tag);
+
+/**
+ * @brief Stop a device's transfers without waiting
+ *
+ * Marks every endpoint of @p device halted and cancels its transfers:
+ * IN transfers are no longer resubmitted and writers waiting for a slot
+ * return E_INVALID_STATE. The endpoints stay valid until
+ * usb_engine_remove_device().
+ *
+ * @param engine Engine
+ * @param device Device whose endpoints to halt
+ */
+void usb_engine_halt_device(usb_engine_t* engine, const usb_device_t* device);
+
+/**
+ * @brief Drain and release every endpoint of a device
+ *
+ * Halts the device's endpoints, waits up to USB_ENGINE_DRAIN_TIMEOUT_MS
+ * for their transfers (and OUT completion callbacks) to finish and frees
+ * them; the other devices' transfers keep running. Used to detach an
+ * unplugged device, before the device is closed. Nobody may use the
+ * endpoint handles any more, and it must not be called from a
+ * completion callback.
+ *
+ * @param engine Engine
+ * @param device Device whose endpoints to remove
+ */
+void usb_engine_remove_device(usb_engine_t* engine, const usb_device_t* device);
+
+/**
+ * @brief Cancel all transfers and stop the event thread
+ *
+ * Waits up to USB_ENGINE_DRAIN_TIMEOUT_MS for cancelled transfers to
+ * complete. Must be called before the devices are closed.
+ *
+ * @param engine Engine
+ */
+void usb_engine_stop(usb_engine_t* engine);
+
+/**
+ * @brief Release all engine resources
+ *
+ * Transfers still in flight after usb_engine_stop() are leaked rather
+ * than freed under libusb.
+ *
+ * @param engine Engine (may be NULL)
+ */
+void usb_engine_cleanup(usb_engine_t* engine);
+
+#endif /* USB_ENGINE_H */
@@ -0,0 +1,433 @@
+/*
+ * usb_out_queue.c - Per-Device Bulk OUT Queue for the USB Client
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#include "usb_out_queue.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Free the head slot (queue lock held, count > 0)
+ */
+static void usb_out_queue_pop_locked(usb_out_queue_t* queue)
+{
+    queue->head = (queue->head + 1) % queue->depth;
+    queue->count--;
+    queue->credit_pending++;
+    pthread_cond_signal(&queue->not_full);
+
+    /* Ran dry: build the prefill margin up again before resuming */
+    if (queue->count == 0 && queue->playing) {
+        queue->playing = FALSE;
+        if (queue->prefill > 0) {
+            queue->underruns++;
+        }
+    }
+}
+
+/**
+ * @brief Hand out the head slot (queue lock held, head holds a URB)
+ *
+ * Pushes only fill slots behind the head, so this one stays put until
+ * it is consumed.
+ */
+static void usb_out_queue_take_locked(usb_out_queue_t* queue,
+                                      const unsigned char** data,
+                                      uint32_t* length,
+                                      int* packets,
+                                      uint32_t* seqnum)
+{
+    *data = queue->buffers + (size_t)queue->head * queue->slot_size;
+    *length = queue->lengths[queue->head];
+    *packets = queue->packets[queue->head];
+    *seqnum = queue->seqnums[queue->head];
+    queue->taken = TRUE;
+}
+
+/**
+ * @brief Initialize a queue
+ */
+int usb_out_queue_init(usb_out_queue_t* queue, int depth, uint32_t slot_size)
+{
+    if (queue == NULL || depth <= 0 || slot_size == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(queue, 0, sizeof(*queue));
+
+    queue->buffers = (unsigned char*)malloc((size_t)depth * slot_size);
+    queue->lengths = (uint32_t*)calloc((size_t)depth, sizeof(uint32_t));
+    queue->packets = (int*)calloc((size_t)depth, sizeof(int));
+    queue->seqnums = (uint32_t*)calloc((size_t)depth, sizeof(uint32_t));
+    if (queue->buffers == NULL || queue->lengths == NULL ||
+        queue->packets == NULL || queue->seqnums == NULL) {
+        goto fail_buffers;
+    }
+
+    if (pthread_mutex_init(&queue->lock, NULL) != 0) {
+        goto fail_buffers;
+    }
+    if (pthread_cond_init(&queue->not_empty, NULL) != 0) {
+        goto fail_lock;
+    }
+    if (pthread_cond_init(&queue->not_full, NULL) != 0) {
+        goto fail_not_empty;
+    }
+
+    queue->depth = depth;
+    queue->slot_size = slot_size;
+    return 0;
+
+fail_not_empty:
+    pthread_cond_destroy(&queue->not_empty);
+fail_lock:
+    pthread_mutex_destroy(&queue->lock);
+fail_buffers:
+    free(queue->buffers);
+    free(queue->lengths);
+    free(queue->packets);
+    free(queue->seqnums);
+    queue->buffers = NULL;
+    queue->lengths = NULL;
+    queue->packets = NULL;
+    queue->seqnums = NULL;
+    return E_OUT_OF_MEMORY;
+}
+
+/**
+ * @brief Release a queue's slots
+ */
+void usb_out_queue_cleanup(usb_out_queue_t* queue)
+{
+    if (queue == NULL || queue->buffers == NULL) {
+        return;
+    }
+
+    pthread_cond_destroy(&queue->not_full);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->buffers);
+    free(queue->lengths);
+    free(queue->packets);
+    free(queue->seqnums);
+    queue->buffers = NULL;
+    queue->lengths = NULL;
+    queue->packets = NULL;
+    queue->seqnums = NULL;
+}
+
+/**
+ * @brief Append OUT data
+ */
+int usb_out_queue_push(usb_out_queue_t* queue,
+                       const unsigned char* data,
+                       uint32_t length)
+{
+    return usb_out_queue_push_urb(queue, 0, data, length, 0);
+}
+
+/**
+ * @brief Append an isochronous URB
+ */
+int usb_out_queue_push_iso(usb_out_queue_t* queue,
+                           const unsigned char* data,
+                           uint32_t length,
+                           int packets)
+{
+    return usb_out_queue_push_urb(queue, 0, data, length, packets);
+}
+
+/**
+ * @brief Append a URB that can be cancelled
+ */
+int usb_out_queue_push_urb(usb_out_queue_t* queue,
+                           uint32_t seqnum,
+                           const unsigned char* data,
+                           uint32_t length,
+                           int packets)
+{
+    int slot;
+
+    if (queue == NULL || queue->buffers == NULL || data == NULL ||
+        length == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (length > queue->slot_size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    if (!queue->closed && queue->count == queue->depth) {
+        queue->push_waits++;
+        while (!queue->closed && queue->count == queue->depth) {
+            pthread_cond_wait(&queue->not_full, &queue->lock);
+        }
+    }
+
+    if (queue->closed) {
+        pthread_mutex_unlock(&queue->lock);
+        return E_INVALID_STATE;
+    }
+
+    slot = (queue->head + queue->count) % queue->depth;
+    memcpy(queue->buffers + (size_t)slot * queue->slot_size, data, length);
+    queue->lengths[slot] = length;
+    queue->packets[slot] = packets;
+    queue->seqnums[slot] = seqnum;
+    queue->count++;
+    queue->urbs_queued++;
+
+    if (queue->count >= queue->prefill) {
+        queue->playing = TRUE;
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Drop a queued URB before it is written
+ */
+int usb_out_queue_cancel(usb_out_queue_t* queue, uint32_t seqnum)
+{
+    int result = E_NOT_FOUND;
+    int slot;
+    int i;
+
+    if (queue == NULL || queue->buffers == NULL || seqnum == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    /* A zero length marks the slot for front to skip, keeping FIFO order */
+    for (i = queue->taken ? 1 : 0; i < queue->count; i++) {
+        slot = (queue->head + i) % queue->depth;
+        if (queue->seqnums[slot] == seqnum && queue->lengths[slot] > 0) {
+            queue->lengths[slot] = 0;
+            queue->cancelled++;
+            result = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return result;
+}
+
+/**
+ * @brief Take the slots freed since the last call, to return as credit
+ */
+int usb_out_queue_take_credit(usb_out_queue_t* queue, int batch)
+{
+    int credit = 0;
+
+    if (queue == NULL || queue->buffers == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->credit_pending >= batch ||
+        (queue->credit_pending > 0 && queue->count == 0)) {
+        credit = queue->credit_pending;
+        queue->credit_pending = 0;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return credit;
+}
+
+/**
+ * @brief Set the jitter buffer prefill
+ */
+void usb_out_queue_set_prefill(usb_out_queue_t* queue, int urbs)
+{
+    if (queue == NULL || queue->buffers == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    queue->prefill = (urbs < 0) ? 0 : (urbs > queue->depth) ? queue->depth : urbs;
+    queue->playing = (queue->count > 0 && queue->count >= queue->prefill);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Wait for the oldest queued URB
+ */
+int usb_out_queue_front(usb_out_queue_t* queue,
+                        const unsigned char** data,
+                        uint32_t* length)
+{
+    int packets;
+
+    return usb_out_queue_front_iso(queue, data, length, &packets);
+}
+
+/**
+ * @brief Wait for the oldest queued isochronous URB
+ */
+int usb_out_queue_front_iso(usb_out_queue_t* queue,
+                            const unsigned char** data,
+                            uint32_t* length,
+                            int* packets)
+{
+    uint32_t seqnum;
+
+    return usb_out_queue_front_urb(queue, data, length, packets, &seqnum);
+}
+
+/**
+ * @brief Wait for the oldest queued URB with its seqnum
+ */
+int usb_out_queue_front_urb(usb_out_queue_t* queue,
+                            const unsigned char** data,
+                            uint32_t* length,
+                            int* packets,
+                            uint32_t* seqnum)
+{
+    if (queue == NULL || queue->buffers == NULL || data == NULL ||
+        length == NULL || packets == NULL || seqnum == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    while (1) {
+        while (!queue->closed && (queue->count == 0 || !queue->playing)) {
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        }
+        if (queue->closed || queue->lengths[queue->head] > 0) {
+            break;
+        }
+
+        /* Cancelled while queued: free the slot without writing it */
+        usb_out_queue_pop_locked(queue);
+    }
+
+    if (queue->closed) {
+        pthread_mutex_unlock(&queue->lock);
+        return E_INVALID_STATE;
+    }
+
+    usb_out_queue_take_locked(queue, data, length, packets, seqnum);
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Take the oldest queued URB if one is ready
+ */
+int usb_out_queue_try_front_urb(usb_out_queue_t* queue,
+                                const unsigned char** data,
+                                uint32_t* length,
+                                int* packets,
+                                uint32_t* seqnum)
+{
+    if (queue == NULL || queue->buffers == NULL || data == NULL ||
+        length == NULL || packets == NULL || seqnum == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    /* Cancelled while queued: free the slots without writing them */
+    while (!queue->closed && !queue->taken && queue->count > 0 &&
+           queue->playing && queue->lengths[queue->head] == 0) {
+        usb_out_queue_pop_locked(queue);
+    }
+
+    if (queue->closed) {
+        pthread_mutex_unlock(&queue->lock);
+        return E_INVALID_STATE;
+    }
+
+    /* The holder may put it back; tell it to try again then */
+    if (queue->taken) {
+        queue->missed = TRUE;
+        pthread_mutex_unlock(&queue->lock);
+        return E_WOULD_BLOCK;
+    }
+
+    if (queue->count == 0 || !queue->playing) {
+        pthread_mutex_unlock(&queue->lock);
+        return E_WOULD_BLOCK;
+    }
+
+    usb_out_queue_take_locked(queue, data, length, packets, seqnum);
+
+    pthread_mutex_unlock(&queue->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Leave the URB returned by front queued, to be returned again
+ */
+int usb_out_queue_put_back(usb_out_queue_t* queue)
+{
+    int missed;
+
+    if (queue == NULL || queue->buffers == NULL) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    queue->taken = FALSE;
+    missed = queue->missed;
+    queue->missed = FALSE;
+    pthread_mutex_unlock(&queue->lock);
+
+    return missed;
+}
+
+/**
+ * @brief Release the slot returned by usb_out_queue_front()
+ */
+void usb_out_queue_consume(usb_out_queue_t* queue)
+{
+    if (queue == NULL || queue->buffers == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    queue->taken = FALSE;
+    queue->missed = FALSE;
+    if (queue->count > 0) {
+        usb_out_queue_pop_locked(queue);
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Close the queue
+ */
+void usb_out_queue_close(usb_out_queue_t* queue)
+{
+    if (queue == NULL || queue->buffers == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    queue->closed = TRUE;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+
+    pthread_mutex_unlock(&queue->lock);
+}
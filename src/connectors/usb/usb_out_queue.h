@@ -0,0 +1,284 @@
+/*
+ * usb_out_queue.h - Per-Device Bulk OUT Queue for the USB Client
+ *
+ * The server pushes OUT URBs to the client as they arrive. The network
+ * receive thread copies each one into the target device's queue, and
+ * the queue is fed to the device's OUT endpoint whenever a transfer of
+ * the endpoint is free (see usb_out_queue_try_front_urb()), so a device
+ * that is slow to accept data never stalls the receive path of the
+ * others until its own queue is full.
+ *
+ * Slots are preallocated once (depth x URB size); nothing is allocated
+ * per URB.
+ *
+ * Each slot keeps the seqnum of its URB, so a URB the peer unlinks
+ * (USB_CMD_UNLINK) before the writer reaches it is dropped unwritten.
+ *
+ * Every slot freed (written or cancelled) is counted as credit the
+ * server may be given back (USB_CMD_CREDIT, see usb_protocol.h), so it
+ * never pushes more URBs than the queue holds.
+ *
+ * For isochronous streams the queue doubles as the jitter buffer: with a
+ * prefill set, the writer only starts once that many URBs are queued and,
+ * after running dry, waits for the same margin again instead of feeding
+ * the device one late URB at a time.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#ifndef USB_OUT_QUEUE_H
+#define USB_OUT_QUEUE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * @brief Bounded FIFO of OUT data for one device
+ */
+typedef struct {
+    unsigned char* buffers;             /* depth slots of slot_size bytes */
+    uint32_t* lengths;                  /* Bytes held by each slot */
+    int* packets;                       /* Isochronous packets per slot */
+    uint32_t* seqnums;                  /* URB seqnum per slot */
+    int depth;                          /* Number of slots */
+    uint32_t slot_size;                 /* Largest URB accepted */
+
+    int head;                           /* Oldest slot */
+    int count;                          /* Slots holding data */
+    int closed;                         /* No more pushes or pops */
+    int taken;                          /* Head returned by front, not yet
+                                           consumed */
+    int missed;                         /* try_front refused while taken */
+    int prefill;                        /* URBs queued before writing starts
+                                           (0 = write at once) */
+    int playing;                        /* Prefill reached, writer running */
+
+    pthread_mutex_t lock;               /* Protects the fields above */
+    pthread_cond_t not_empty;           /* Data pushed or closed */
+    pthread_cond_t not_full;            /* Slot consumed or closed */
+
+    /* Statistics (guarded by lock) */
+    unsigned long urbs_queued;          /* URBs accepted */
+    unsigned long push_waits;           /* Pushes that found the queue full */
+    unsigned long underruns;            /* Writer ran dry with a prefill set */
+    unsigned long cancelled;            /* URBs dropped by usb_out_queue_cancel() */
+
+    int credit_pending;                 /* Slots freed, not yet credited */
+} usb_out_queue_t;
+
+/**
+ * @brief Initialize a queue
+ *
+ * @param queue Queue to initialize
+ * @param depth Number of URBs held at once (>= 1)
+ * @param slot_size Largest URB in bytes (> 0)
+ * @return 0 on success, negative error code on failure
+ */
+int usb_out_queue_init(usb_out_queue_t* queue, int depth, uint32_t slot_size);
+
+/**
+ * @brief Release a queue's slots
+ *
+ * No thread may still use the queue.
+ *
+ * @param queue Queue (may be NULL or never initialized)
+ */
+void usb_out_queue_cleanup(usb_out_queue_t* queue);
+
+/**
+ * @brief Append OUT data
+ *
+ * Copies @p data into a free slot, waiting while the queue is full
+ * (backpressure towards the server).
+ *
+ * @param queue Queue
+ * @param data Data to write to the device
+ * @param length Number of bytes (1..slot_size)
+ * @return 0 once queued, E_INVALID_STATE if the queue is closed,
+ *         E_BUFFER_TOO_SMALL if @p length exceeds the slot size,
+ *         E_INVALID_ARGUMENT on bad arguments
+ */
+int usb_out_queue_push(usb_out_queue_t* queue,
+                       const unsigned char* data,
+                       uint32_t length);
+
+/**
+ * @brief Append an isochronous URB
+ *
+ * As usb_out_queue_push(), keeping the URB's packet count for the
+ * writer (see usb_out_queue_front_iso()).
+ *
+ * @param queue Queue
+ * @param data Packet descriptors followed by packet data
+ * @param length Number of bytes (1..slot_size)
+ * @param packets number_of_packets of the URB
+ * @return As usb_out_queue_push()
+ */
+int usb_out_queue_push_iso(usb_out_queue_t* queue,
+                           const unsigned char* data,
+                           uint32_t length,
+                           int packets);
+
+/**
+ * @brief Append a URB that can be cancelled
+ *
+ * As usb_out_queue_push_iso(), also keeping the URB's seqnum for
+ * usb_out_queue_cancel() and usb_out_queue_front_urb().
+ *
+ * @param queue Queue
+ * @param seqnum URB sequence number (0 = not cancellable)
+ * @param data Data to write to the device
+ * @param length Number of bytes (1..slot_size)
+ * @param packets number_of_packets of the URB (0 unless isochronous)
+ * @return As usb_out_queue_push()
+ */
+int usb_out_queue_push_urb(usb_out_queue_t* queue,
+                           uint32_t seqnum,
+                           const unsigned char* data,
+                           uint32_t length,
+                           int packets);
+
+/**
+ * @brief Drop a queued URB before it is written
+ *
+ * The URB the writer holds (returned by front, not yet consumed) is
+ * past cancelling here.
+ *
+ * @param queue Queue
+ * @param seqnum seqnum given to usb_out_queue_push_urb() (not 0)
+ * @return 0 if the URB was dropped, E_NOT_FOUND if it is not queued
+ *         (or already taken by the writer), E_INVALID_ARGUMENT on bad
+ *         arguments
+ */
+int usb_out_queue_cancel(usb_out_queue_t* queue, uint32_t seqnum);
+
+/**
+ * @brief Set the jitter buffer prefill
+ *
+ * From now on the writer waits until @p urbs URBs are queued before it
+ * starts, and again each time it empties the queue. Capped at the queue
+ * depth.
+ *
+ * @param queue Queue
+ * @param urbs URBs to hold back (0 = none, the default)
+ */
+void usb_out_queue_set_prefill(usb_out_queue_t* queue, int urbs);
+
+/**
+ * @brief Wait for the oldest queued URB
+ *
+ * The slot stays owned by the caller until usb_out_queue_consume(), so
+ * the data can be handed to libusb without another copy.
+ *
+ * @param queue Queue
+ * @param data Receives a pointer to the data
+ * @param length Receives its length
+ * @return 0 with data available, E_INVALID_STATE once closed
+ */
+int usb_out_queue_front(usb_out_queue_t* queue,
+                        const unsigned char** data,
+                        uint32_t* length);
+
+/**
+ * @brief Wait for the oldest queued isochronous URB
+ *
+ * As usb_out_queue_front(), also returning the packet count given to
+ * usb_out_queue_push_iso() (0 for usb_out_queue_push()).
+ *
+ * @param queue Queue
+ * @param data Receives a pointer to the data
+ * @param length Receives its length
+ * @param packets Receives the packet count
+ * @return 0 with data available, E_INVALID_STATE once closed
+ */
+int usb_out_queue_front_iso(usb_out_queue_t* queue,
+                            const unsigned char** data,
+                            uint32_t* length,
+                            int* packets);
+
+/**
+ * @brief Wait for the oldest queued URB with its seqnum
+ *
+ * As usb_out_queue_front_iso(), also returning the seqnum given to
+ * usb_out_queue_push_urb() (0 for the other pushes).
+ *
+ * @param queue Queue
+ * @param data Receives a pointer to the data
+ * @param length Receives its length
+ * @param packets Receives the packet count
+ * @param seqnum Receives the seqnum
+ * @return 0 with data available, E_INVALID_STATE once closed
+ */
+int usb_out_queue_front_urb(usb_out_queue_t* queue,
+                            const unsigned char** data,
+                            uint32_t* length,
+                            int* packets,
+                            uint32_t* seqnum);
+
+/**
+ * @brief Take the oldest queued URB if one is ready
+ *
+ * Non-blocking usb_out_queue_front_urb(), for a writer driven by
+ * completions rather than a thread of its own. A URB is ready once the
+ * prefill is reached and no earlier front is still held.
+ *
+ * @param queue Queue
+ * @param data Receives a pointer to the data
+ * @param length Receives its length
+ * @param packets Receives the packet count
+ * @param seqnum Receives the seqnum
+ * @return 0 with data available, E_WOULD_BLOCK if none is ready (or
+ *         another writer holds it), E_INVALID_STATE once closed
+ */
+int usb_out_queue_try_front_urb(usb_out_queue_t* queue,
+                                const unsigned char** data,
+                                uint32_t* length,
+                                int* packets,
+                                uint32_t* seqnum);
+
+/**
+ * @brief Leave the URB returned by front queued
+ *
+ * For a writer that found no room for it downstream: the next front
+ * returns the same URB (unless it was cancelled meanwhile).
+ *
+ * @param queue Queue
+ * @return TRUE if usb_out_queue_try_front_urb() was refused while the
+ *         URB was held (the room it lacked may have appeared since: try
+ *         again), FALSE otherwise
+ */
+int usb_out_queue_put_back(usb_out_queue_t* queue);
+
+/**
+ * @brief Release the slot returned by usb_out_queue_front()
+ *
+ * @param queue Queue
+ */
+void usb_out_queue_consume(usb_out_queue_t* queue);
+
+/**
+ * @brief Take the slots freed since the last call, to return as credit
+ *
+ * Returns nothing until at least @p batch slots are free again, unless
+ * the queue has emptied, so credit goes back in few messages without
+ * ever leaving the sender waiting for a slot that is already free.
+ *
+ * @param queue Queue
+ * @param batch Slots worth a message (>= 1)
+ * @return Slots to credit (0 = none yet)
+ */
+int usb_out_queue_take_credit(usb_out_queue_t* queue, int batch);
+
+/**
+ * @brief Close the queue
+ *
+ * Wakes every waiting push and front; queued data is discarded.
+ *
+ * @param queue Queue (may be NULL or never initialized)
+ */
+void usb_out_queue_close(usb_out_queue_t* queue);
+
+#endif /* USB_OUT_QUEUE_H */
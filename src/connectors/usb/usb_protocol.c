@@ -13,9 +13,11 @@
 
 #include "usb_protocol.h"
 #include "lib/common/definitions.h"
+#include "lib/common/stage_prof.h"
+#include "lib/protocol/crc32.h"
+#include "lib/protocol/payload_pool.h"
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
 
 /*
  * Byte order conversion helpers
@@ -74,7 +76,7 @@ static void serialize_urb_header(uint8_t* buffer, const usb_urb_header_t* header
     write_uint32_be(buffer + 8, header->device_id);
     buffer[12] = header->endpoint;
     buffer[13] = header->transfer_type;
-    write_uint16_be(buffer + 14, header->reserved);
+    write_uint16_be(buffer + 14, header->number_of_packets);
     write_uint32_be(buffer + 16, header->transfer_length);
     write_uint32_be(buffer + 20, header->actual_length);
     write_int32_be(buffer + 24, header->status);
@@ -98,7 +100,7 @@ static void deserialize_urb_header(usb_urb_header_t* header, const uint8_t* buff
     header->device_id = read_uint32_be(buffer + 8);
     header->endpoint = buffer[12];
     header->transfer_type = buffer[13];
-    header->reserved = read_uint16_be(buffer + 14);
+    header->number_of_packets = read_uint16_be(buffer + 14);
     header->transfer_length = read_uint32_be(buffer + 16);
     header->actual_length = read_uint32_be(buffer + 20);
     header->status = read_int32_be(buffer + 24);
@@ -110,8 +112,8 @@ static void deserialize_urb_header(usb_urb_header_t* header, const uint8_t* buff
 /**
  * @brief Calculate CRC32 checksum over URB header and data (USB-002 fix)
  *
- * Uses zlib's CRC32 for reliable error detection, replacing the
- * weak byte-sum algorithm. The header is serialized to network byte order
+ * Uses CRC32 (lib/protocol/crc32.h) for reliable error detection, replacing
+ * the weak byte-sum algorithm. The header is serialized to network byte order
  * before checksumming to ensure cross-platform consistency.
  *
  * @param urb_header Pointer to URB header structure
@@ -136,11 +138,11 @@ uint32_t usb_protocol_checksum(
     serialize_urb_header(header_buffer, urb_header);
 
     /* CRC32 over serialized header */
-    checksum = (uint32_t)crc32(0L, header_buffer, sizeof(header_buffer));
+    checksum = xoe_crc32_update(0, header_buffer, sizeof(header_buffer));
 
     /* CRC32 over data if present */
     if (data != NULL && data_len > 0) {
-        checksum = (uint32_t)crc32(checksum, (const Bytef*)data, data_len);
+        checksum = xoe_crc32_update(checksum, data, data_len);
     }
 
     return checksum;
@@ -171,22 +173,23 @@ int usb_protocol_encapsulate(
         return E_INVALID_ARGUMENT;
     }
 
-    /* Check data length */
-    if (data_len > USB_MAX_DATA_SIZE) {
+    /* Check data length (negotiated limits are enforced by callers) */
+    if (data_len > USB_MAX_LARGE_DATA_SIZE) {
         return E_INVALID_ARGUMENT;
     }
 
     /* Calculate total payload size using wire format constant */
     total_size = USB_URB_HEADER_WIRE_SIZE + data_len;
-    if (total_size > USB_MAX_PAYLOAD_SIZE) {
+    if (total_size > USB_MAX_LARGE_PAYLOAD_SIZE) {
         return E_INVALID_ARGUMENT;
     }
 
-    /* Allocate payload buffer */
-    payload_buffer = (uint8_t*)malloc(total_size);
-    if (payload_buffer == NULL) {
+    /* Allocate payload (descriptor and data in one pooled block) */
+    payload = xoe_payload_alloc(total_size);
+    if (payload == NULL) {
         return E_OUT_OF_MEMORY;
     }
+    payload_buffer = (uint8_t*)payload->data;
 
     /* Serialize URB header to network byte order */
     serialize_urb_header(payload_buffer, urb_header);
@@ -198,18 +201,6 @@ int usb_protocol_encapsulate(
                data_len);
     }
 
-    /* Allocate payload structure */
-    payload = (xoe_payload_t*)malloc(sizeof(xoe_payload_t));
-    if (payload == NULL) {
-        free(payload_buffer);
-        return E_OUT_OF_MEMORY;
-    }
-
-    /* Initialize payload structure */
-    payload->len = total_size;
-    payload->data = payload_buffer;
-    payload->owns_data = TRUE;
-
     /* Initialize packet structure */
     packet->protocol_id = XOE_PROTOCOL_USB;
     packet->protocol_version = XOE_PROTOCOL_USB_VERSION;
@@ -222,19 +213,44 @@ int usb_protocol_encapsulate(
 }
 
 /**
- * @brief Decapsulate XOE packet into USB URB
- *
- * This function extracts a USB URB header and transfer data from
- * a XOE packet. It validates the protocol ID, version, and checksum.
+ * @brief Frame a URB around data that has room for its header
  */
-int usb_protocol_decapsulate(
-    const xoe_packet_t* packet,
-    usb_urb_header_t* urb_header,
-    void* transfer_data,
-    uint32_t* data_len)
+int usb_protocol_encapsulate_in_place(
+    const usb_urb_header_t* urb_header,
+    uint8_t* frame,
+    uint32_t data_len,
+    xoe_payload_t* payload,
+    xoe_packet_t* packet)
+{
+    /* Validate inputs */
+    if (urb_header == NULL || frame == NULL || payload == NULL ||
+        packet == NULL || data_len > USB_MAX_LARGE_DATA_SIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    serialize_urb_header(frame, urb_header);
+
+    payload->data = frame;
+    payload->len = USB_URB_HEADER_WIRE_SIZE + data_len;
+    payload->owns_data = FALSE;
+
+    packet->protocol_id = XOE_PROTOCOL_USB;
+    packet->protocol_version = XOE_PROTOCOL_USB_VERSION;
+    packet->payload = payload;
+    packet->checksum = 0;
+
+    return 0;
+}
+
+/**
+ * @brief Parse and copy out a URB (usb_protocol_decapsulate() body)
+ */
+static int decapsulate_urb(const xoe_packet_t* packet,
+                           usb_urb_header_t* urb_header,
+                           void* transfer_data,
+                           uint32_t* data_len)
 {
     const uint8_t* payload_buffer;
-    uint32_t calculated_checksum;
     uint32_t payload_data_len;
 
     /* Validate inputs */
@@ -262,7 +278,7 @@ int usb_protocol_decapsulate(
         return E_PROTOCOL_ERROR;
     }
 
-    if (packet->payload->len > USB_MAX_PAYLOAD_SIZE) {
+    if (packet->payload->len > USB_MAX_LARGE_PAYLOAD_SIZE) {
         return E_PROTOCOL_ERROR;
     }
 
@@ -275,17 +291,6 @@ int usb_protocol_decapsulate(
     /* Calculate data length using wire format constant */
     payload_data_len = packet->payload->len - USB_URB_HEADER_WIRE_SIZE;
 
-    /* Verify checksum BEFORE copying data (use original packet data) */
-    calculated_checksum = usb_protocol_checksum(
-        urb_header,
-        payload_data_len > 0 ? (payload_buffer + USB_URB_HEADER_WIRE_SIZE) : NULL,
-        payload_data_len
-    );
-
-    if (calculated_checksum != packet->checksum) {
-        return E_CHECKSUM_MISMATCH;
-    }
-
     /* Copy transfer data if present and buffer provided */
     if (payload_data_len > 0 && transfer_data != NULL) {
         /* Check if output buffer is large enough */
@@ -304,6 +309,199 @@ int usb_protocol_decapsulate(
     return 0;
 }
 
+/**
+ * @brief Decapsulate XOE packet into USB URB
+ *
+ * This function extracts a USB URB header and transfer data from
+ * a XOE packet. It validates the protocol ID, version and size.
+ *
+ * Integrity is not re-checked here: packet->checksum of a received
+ * packet is the wire frame CRC, already verified by xoe_wire_recv() over
+ * these same payload bytes (or covered by TLS when negotiated off).
+ */
+int usb_protocol_decapsulate(
+    const xoe_packet_t* packet,
+    usb_urb_header_t* urb_header,
+    void* transfer_data,
+    uint32_t* data_len)
+{
+    STAGE_PROF_VAR(start);
+    int result;
+
+    STAGE_PROF_START(start);
+    result = decapsulate_urb(packet, urb_header, transfer_data, data_len);
+    STAGE_PROF_STOP(STAGE_DECAPSULATE, start);
+
+    return result;
+}
+
+/**
+ * @brief Resolve the URB data size for a registration
+ *
+ * Peers that predate negotiation leave the field zero and get the base
+ * size; anything else is clamped to [USB_MAX_DATA_SIZE, limit].
+ */
+uint32_t usb_protocol_negotiate_urb_size(uint32_t requested, uint32_t limit)
+{
+    if (limit > USB_MAX_LARGE_DATA_SIZE) {
+        limit = USB_MAX_LARGE_DATA_SIZE;
+    }
+    if (limit < USB_MAX_DATA_SIZE) {
+        limit = USB_MAX_DATA_SIZE;
+    }
+
+    if (requested <= USB_MAX_DATA_SIZE) {
+        return USB_MAX_DATA_SIZE;
+    }
+    return (requested < limit) ? requested : limit;
+}
+
+/**
+ * @brief Write isochronous packet descriptors
+ */
+int usb_protocol_iso_write_descriptors(uint8_t* buffer,
+                                       const usb_iso_packet_t* packets,
+                                       int count)
+{
+    int i;
+
+    if (buffer == NULL || packets == NULL ||
+        count <= 0 || count > USB_ISO_MAX_PACKETS) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i < count; i++) {
+        uint8_t* desc = buffer + USB_ISO_DESCRIPTORS_SIZE(i);
+
+        write_uint32_be(desc + 0, packets[i].length);
+        write_uint32_be(desc + 4, packets[i].actual_length);
+        write_int32_be(desc + 8, packets[i].status);
+    }
+
+    return (int)USB_ISO_DESCRIPTORS_SIZE(count);
+}
+
+/**
+ * @brief Parse and check the descriptors of an isochronous URB
+ *
+ * The sum of the actual lengths must match the data exactly: the
+ * receiver locates each packet by adding up the ones before it.
+ */
+int usb_protocol_iso_read_descriptors(const uint8_t* data,
+                                      uint32_t data_len,
+                                      int count,
+                                      usb_iso_packet_t* packets,
+                                      uint32_t* payload_offset)
+{
+    uint32_t header_len;
+    uint32_t total = 0;
+    int i;
+
+    if (data == NULL || packets == NULL || payload_offset == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (count <= 0 || count > USB_ISO_MAX_PACKETS) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    header_len = USB_ISO_DESCRIPTORS_SIZE(count);
+    if (data_len < header_len) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    for (i = 0; i < count; i++) {
+        const uint8_t* desc = data + USB_ISO_DESCRIPTORS_SIZE(i);
+
+        packets[i].length = read_uint32_be(desc + 0);
+        packets[i].actual_length = read_uint32_be(desc + 4);
+        packets[i].status = read_int32_be(desc + 8);
+
+        if (packets[i].actual_length > packets[i].length ||
+            packets[i].actual_length > data_len - header_len - total) {
+            return E_PROTOCOL_ERROR;
+        }
+        total += packets[i].actual_length;
+    }
+
+    if (total != data_len - header_len) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    *payload_offset = header_len;
+    return 0;
+}
+
+/**
+ * @brief Append a URB to the data of a USB_CMD_BATCH
+ */
+int usb_protocol_batch_append(uint8_t* buffer,
+                              uint32_t capacity,
+                              uint32_t* used,
+                              const usb_urb_header_t* urb_header,
+                              const void* data,
+                              uint32_t data_len)
+{
+    uint8_t* entry;
+
+    if (buffer == NULL || used == NULL || urb_header == NULL ||
+        (data == NULL && data_len > 0) || *used > capacity ||
+        data_len > USB_MAX_DATA_SIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (USB_BATCH_ENTRY_SIZE(data_len) > capacity - *used) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    entry = buffer + *used;
+    write_uint32_be(entry, USB_URB_HEADER_WIRE_SIZE + data_len);
+    serialize_urb_header(entry + USB_BATCH_ENTRY_HEADER_SIZE, urb_header);
+    if (data_len > 0) {
+        memcpy(entry + USB_BATCH_ENTRY_HEADER_SIZE + USB_URB_HEADER_WIRE_SIZE,
+               data, data_len);
+    }
+
+    *used += USB_BATCH_ENTRY_SIZE(data_len);
+    return 0;
+}
+
+/**
+ * @brief Step to the next URB in the data of a USB_CMD_BATCH
+ */
+int usb_protocol_batch_next(const uint8_t* data,
+                            uint32_t size,
+                            uint32_t* offset,
+                            const uint8_t** urb,
+                            uint32_t* urb_len)
+{
+    uint32_t length;
+
+    if (offset == NULL || urb == NULL || urb_len == NULL ||
+        (data == NULL && size > 0)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (*offset >= size) {
+        return E_NOT_FOUND;
+    }
+
+    if (size - *offset < USB_BATCH_ENTRY_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    length = read_uint32_be(data + *offset);
+    if (length < USB_URB_HEADER_WIRE_SIZE ||
+        length > size - *offset - USB_BATCH_ENTRY_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    *urb = data + *offset + USB_BATCH_ENTRY_HEADER_SIZE;
+    *urb_len = length;
+    *offset += USB_BATCH_ENTRY_HEADER_SIZE + length;
+    return 0;
+}
+
 /**
  * @brief Free resources allocated for USB packet
  *
@@ -317,14 +515,8 @@ void usb_protocol_free_payload(xoe_packet_t* packet)
     }
 
     if (packet->payload != NULL) {
-        /* Free data buffer if owned by payload */
-        if (packet->payload->owns_data && packet->payload->data != NULL) {
-            free(packet->payload->data);
-            packet->payload->data = NULL;
-        }
-
-        /* Free payload structure */
-        free(packet->payload);
+        /* Honors owns_data: pooled, malloc'd or borrowed data */
+        xoe_payload_release(packet->payload);
         packet->payload = NULL;
     }
 }
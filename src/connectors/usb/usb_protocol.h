@@ -31,9 +31,24 @@
 #define USB_RET_ENUM        0x0011  /* Enumeration response */
 #define USB_CMD_AUTH        0x0020  /* Authentication challenge */
 #define USB_RET_AUTH        0x0021  /* Authentication response */
+#define USB_CMD_BATCH       0x0030  /* Several URBs in one frame */
+#define USB_CMD_CREDIT      0x0040  /* OUT endpoint credit (no reply) */
 
-/* USB transfer types (subset of libusb - isochronous not supported) */
+/*
+ * URB cancellation
+ *
+ * USB_CMD_UNLINK cancels a URB that is still outstanding: it carries the
+ * seqnum, device_id and endpoint of that URB and no data. The server
+ * routes it like the URB itself. The peer serving the device drops the
+ * URB if it is still queued, or cancels its transfer if it is on the
+ * bus, and answers USB_RET_UNLINK with the same seqnum and status 0.
+ * Status E_NOT_FOUND means the URB was already completed (its
+ * USB_RET_SUBMIT, if any, was sent first) or never arrived.
+ */
+
+/* USB transfer types (libusb values) */
 #define USB_TRANSFER_CONTROL        0
+#define USB_TRANSFER_ISOCHRONOUS    1
 #define USB_TRANSFER_BULK           2
 #define USB_TRANSFER_INTERRUPT      3
 
@@ -44,8 +59,13 @@
 #define USB_FLAG_OVERFLOW       0x0008  /* Buffer overflow */
 #define USB_FLAG_BABBLE         0x0010  /* Babble detected */
 #define USB_FLAG_CRC_ERROR      0x0020  /* CRC/protocol error */
+#define USB_FLAG_BATCH          0x0100  /* USB_RET_REGISTER: the server
+                                           accepts USB_CMD_BATCH */
+#define USB_FLAG_CREDIT         0x0200  /* USB_RET_REGISTER: the server
+                                           honours USB_CMD_CREDIT */
+#define USB_FLAG_WINDOW         0x0400  /* USB_CMD_CREDIT: sets the window */
 
-/* Maximum payload sizes */
+/* Base payload sizes (supported by every peer, used until negotiated) */
 #define USB_MAX_PAYLOAD_SIZE    4096    /* URB header + data */
 #define USB_MAX_DATA_SIZE       4048    /* Max transfer data */
 #define USB_MAX_TRANSFER_SIZE   4048    /* Max bytes per transfer (alias) */
@@ -53,6 +73,120 @@
 /* Wire format constants */
 #define USB_URB_HEADER_WIRE_SIZE 36     /* Packed wire size (no padding) */
 
+/*
+ * Large URB sizes (negotiated at registration)
+ *
+ * USB_CMD_REGISTER carries the largest transfer the client can handle in
+ * transfer_length; USB_RET_REGISTER returns the size the server grants.
+ * A zero field (older peers) means USB_MAX_DATA_SIZE. Well below the
+ * wire format frame limit (XOE_WIRE_MAX_PAYLOAD).
+ *
+ * USB_CMD_REGISTER also carries, in actual_length, the isochronous
+ * bandwidth in bytes per second the device's streams need (0 = none).
+ * The server reserves it against its budget and fails the registration
+ * with E_USB_NO_BANDWIDTH when it does not fit.
+ */
+#define USB_MAX_LARGE_DATA_SIZE     (64 * 1024)
+#define USB_MAX_LARGE_PAYLOAD_SIZE  (USB_URB_HEADER_WIRE_SIZE + USB_MAX_LARGE_DATA_SIZE)
+
+/*
+ * Descriptor cache (see usb_desc_cache.h)
+ *
+ * The data of USB_CMD_REGISTER, if any, is the device's standard
+ * descriptors (at most USB_MAX_DATA_SIZE bytes). The server then answers
+ * standard GET_DESCRIPTOR control URBs for the device with USB_RET_SUBMIT
+ * itself; those it does not hold go to the device as before. A
+ * registration without data (older clients) caches nothing.
+ *
+ * USB_CMD_ENUM asks for the cached descriptors of device_id;
+ * USB_RET_ENUM returns them as its data with status 0, or no data with
+ * E_NOT_FOUND when no other connection registered them.
+ *
+ * The descriptors are a list of records, each a header followed by
+ * length bytes of descriptor (big-endian, 6 bytes):
+ *   type (u8)       bDescriptorType it is requested by
+ *   index (u8)      Descriptor index
+ *   langid (u16)    Language ID for string descriptors, 0 otherwise
+ *   length (u16)    Descriptor size
+ */
+#define USB_DESC_RECORD_HEADER_SIZE 6
+
+/*
+ * Batched URBs (client to server)
+ *
+ * USB_CMD_BATCH carries several small URBs, for any endpoints and
+ * devices of the sending connection, in one frame. Its data is a list
+ * of entries, each a big-endian u32 length followed by that many bytes
+ * of URB exactly as it would travel alone (wire header, then data). The
+ * batch header's number_of_packets holds the entry count; the other
+ * fields are zero. The server handles the entries in order, as if each
+ * had arrived in its own frame; a batch never holds another batch.
+ *
+ * A client only batches once a USB_RET_REGISTER carried USB_FLAG_BATCH.
+ * A batch frame stays within USB_MAX_PAYLOAD_SIZE, so it needs no
+ * negotiated URB size.
+ */
+#define USB_BATCH_ENTRY_HEADER_SIZE 4
+#define USB_BATCH_ENTRY_SIZE(data_len) \
+    (USB_BATCH_ENTRY_HEADER_SIZE + USB_URB_HEADER_WIRE_SIZE + (uint32_t)(data_len))
+
+/*
+ * OUT credit (client to server)
+ *
+ * OUT URBs pushed to a client wait in a bounded queue per endpoint until
+ * the device takes them. Without credit a slow device fills its queue
+ * and then holds up the connection's receive path, and with it every
+ * other device on the connection. With credit the client bounds the OUT
+ * URBs in flight per endpoint itself, in the style of a flow-control
+ * window:
+ *
+ *   USB_CMD_CREDIT  device_id, endpoint (an OUT endpoint), and in
+ *                   transfer_length a number of URBs. With
+ *                   USB_FLAG_WINDOW it is the endpoint's window (its
+ *                   queue depth) and replaces the server's count;
+ *                   without, it is URBs the client has taken off the
+ *                   queue since, returned as credit.
+ *
+ * The server forwards a USB_CMD_SUBMIT carrying data to an endpoint only
+ * while the endpoint has credit, one URB each. Further URBs wait in the
+ * connection's send queue without holding up other endpoints; a few per
+ * endpoint are held, after which the sender sees the queue full. A
+ * USB_CMD_UNLINK for a held URB drops it there, so the client answers
+ * E_NOT_FOUND as for a URB that never arrived. Endpoints never given a
+ * window are not limited, nor are URBs sent before the window arrived.
+ *
+ * A client only sends credit once a USB_RET_REGISTER carried
+ * USB_FLAG_CREDIT. Nothing is sent back.
+ */
+#define USB_CREDIT_DIVISOR 4    /* Credit returned per quarter window */
+
+/*
+ * Isochronous URBs
+ *
+ * An isochronous URB carries number_of_packets packet descriptors at the
+ * start of its data, followed by the packet data. Only the bytes each
+ * packet actually holds are sent: packet i's data follows packet i-1's,
+ * so the data is the sum of the actual_length fields. transfer_length and
+ * actual_length of the header cover descriptors and data.
+ *
+ * Descriptor wire layout (big-endian, 12 bytes):
+ *   length (u32)         Bytes requested for the packet
+ *   actual_length (u32)  Bytes the packet holds (<= length)
+ *   status (i32)         Packet status (0 or negative error code)
+ */
+#define USB_ISO_MAX_PACKETS         128
+#define USB_ISO_PACKET_WIRE_SIZE    12
+#define USB_ISO_DESCRIPTORS_SIZE(n) ((uint32_t)(n) * USB_ISO_PACKET_WIRE_SIZE)
+
+/**
+ * @brief Isochronous packet descriptor
+ */
+typedef struct {
+    uint32_t length;            /* Bytes requested */
+    uint32_t actual_length;     /* Bytes transferred */
+    int32_t  status;            /* 0 or negative error code */
+} usb_iso_packet_t;
+
 /**
  * @brief USB URB (USB Request Block) header structure
  *
@@ -71,7 +205,7 @@ typedef struct {
     uint32_t device_id;         /* Device identifier (VID:PID) */
     uint8_t  endpoint;          /* Target endpoint */
     uint8_t  transfer_type;     /* Control/Bulk/Interrupt */
-    uint16_t reserved;          /* Alignment padding */
+    uint16_t number_of_packets; /* Isochronous packets (0 otherwise) */
     uint32_t transfer_length;   /* Expected data length */
     uint32_t actual_length;     /* Actual transferred (response) */
     int32_t  status;            /* Transfer status (libusb codes) */
@@ -88,6 +222,8 @@ typedef struct {
  * @param urb_header Pointer to URB header to encapsulate (read-only)
  * @param transfer_data Pointer to transfer data buffer (read-only, may be NULL)
  * @param data_len Length of transfer data in bytes
+ *                 (at most USB_MAX_LARGE_DATA_SIZE; callers keep to the
+ *                 size negotiated with the receiving peer)
  * @param packet Pointer to output XOE packet structure (caller-allocated)
  * @return 0 on success, negative error code on failure
  *
@@ -99,9 +235,9 @@ typedef struct {
  * - packet: Caller-allocated structure, not freed by function
  *
  * Outputs (owned by caller after successful return):
- * - packet->payload: Allocated by this function (caller must free)
- * - packet->payload->data: Allocated by this function (caller must free)
- * - packet->payload->owns_data: Set to TRUE
+ * - packet->payload: Pooled block holding descriptor and data
+ *   (see lib/protocol/payload_pool.h)
+ * - packet->payload->owns_data: Set to XOE_PAYLOAD_POOLED
  *
  * The caller MUST call usb_protocol_free_payload(packet) after transmission
  * to free the allocated payload and data buffer. Failure to do so will
@@ -125,11 +261,40 @@ int usb_protocol_encapsulate(
     xoe_packet_t* packet
 );
 
+/**
+ * @brief Frame a URB around data that has room for its header
+ *
+ * Zero-copy counterpart of usb_protocol_encapsulate(): the URB header is
+ * serialized into the USB_URB_HEADER_WIRE_SIZE bytes in front of the
+ * data, and the packet's payload points at that block in place. The
+ * checksum is left to the send (xoe_wire_send() computes the frame CRC).
+ *
+ * @param urb_header URB header to serialize (read-only)
+ * @param frame Start of the block: USB_URB_HEADER_WIRE_SIZE writable
+ *              bytes directly followed by the data
+ * @param data_len Length of the data after the header
+ *                 (at most USB_MAX_LARGE_DATA_SIZE)
+ * @param payload Caller-provided payload descriptor (not owning the data)
+ * @param packet Output packet referring to @p payload
+ * @return 0 on success, E_INVALID_ARGUMENT on bad arguments
+ *
+ * Note: Nothing is allocated; do not call usb_protocol_free_payload().
+ *       @p frame and @p payload must outlive the send.
+ */
+int usb_protocol_encapsulate_in_place(
+    const usb_urb_header_t* urb_header,
+    uint8_t* frame,
+    uint32_t data_len,
+    xoe_payload_t* payload,
+    xoe_packet_t* packet
+);
+
 /**
  * @brief Decapsulate XOE packet into USB URB
  *
  * Unpacks a XOE packet into a USB URB header and transfer data.
- * Verifies checksum and validates packet structure.
+ * Validates packet structure; the frame checksum is verified by the
+ * wire layer on receive.
  *
  * @param packet Pointer to input XOE packet (read-only)
  * @param urb_header Pointer to output URB header structure (caller-allocated)
@@ -147,7 +312,8 @@ int usb_protocol_encapsulate(
  * Outputs (owned by caller):
  * - urb_header: Caller-allocated structure, filled by this function
  * - transfer_data: Caller-allocated buffer, filled by this function
- *   Must be at least USB_MAX_DATA_SIZE (4048) bytes
+ *   Must be at least the negotiated URB size (USB_MAX_DATA_SIZE
+ *   before negotiation); *data_len gives its size
  * - data_len: Set to actual bytes copied to transfer_data
  *
  * This function COPIES data from the packet into caller-provided buffers.
@@ -155,7 +321,7 @@ int usb_protocol_encapsulate(
  *
  * The caller is responsible for:
  * 1. Allocating urb_header structure (can be stack or heap)
- * 2. Allocating transfer_data buffer (at least USB_MAX_DATA_SIZE bytes)
+ * 2. Allocating transfer_data buffer (E_BUFFER_TOO_SMALL if too short)
  * 3. Freeing the input packet (if needed) after decapsulation
  *
  * Example:
@@ -174,6 +340,89 @@ int usb_protocol_decapsulate(
     uint32_t* data_len
 );
 
+/**
+ * @brief Resolve the URB data size for a registration
+ *
+ * Used on both ends of the registration handshake: the server grants
+ * the client's request capped at its own limit, and the client applies
+ * the same rule to the value returned in USB_RET_REGISTER.
+ *
+ * @param requested Size advertised by the peer (0 = not advertised)
+ * @param limit Largest size the local side supports
+ * @return Agreed URB data size, never below USB_MAX_DATA_SIZE
+ */
+uint32_t usb_protocol_negotiate_urb_size(uint32_t requested, uint32_t limit);
+
+/**
+ * @brief Write isochronous packet descriptors
+ *
+ * Serializes @p count descriptors to the start of an isochronous URB's
+ * data; the packed packet data goes right after them.
+ *
+ * @param buffer Output (at least USB_ISO_DESCRIPTORS_SIZE(count) bytes)
+ * @param packets Descriptors to write
+ * @param count Number of descriptors (1..USB_ISO_MAX_PACKETS)
+ * @return Bytes written, or negative error code
+ */
+int usb_protocol_iso_write_descriptors(uint8_t* buffer,
+                                       const usb_iso_packet_t* packets,
+                                       int count);
+
+/**
+ * @brief Parse and check the descriptors of an isochronous URB
+ *
+ * @param data URB data (descriptors followed by packet data)
+ * @param data_len Bytes of URB data
+ * @param count number_of_packets from the URB header
+ * @param packets Receives @p count descriptors
+ * @param payload_offset Receives the offset of the packet data in @p data
+ * @return 0 on success, E_PROTOCOL_ERROR if the count is out of range, a
+ *         packet holds more than it asked for, or the packet data does
+ *         not add up to the bytes that follow the descriptors
+ */
+int usb_protocol_iso_read_descriptors(const uint8_t* data,
+                                      uint32_t data_len,
+                                      int count,
+                                      usb_iso_packet_t* packets,
+                                      uint32_t* payload_offset);
+
+/**
+ * @brief Append a URB to the data of a USB_CMD_BATCH
+ *
+ * @param buffer Batch data
+ * @param capacity Size of @p buffer
+ * @param used Bytes of @p buffer in use; advanced past the new entry
+ * @param urb_header URB header
+ * @param data URB data (may be NULL if @p data_len is 0)
+ * @param data_len Bytes of URB data
+ * @return 0 on success, E_BUFFER_TOO_SMALL if the entry does not fit
+ *         (nothing is written), E_INVALID_ARGUMENT on bad arguments
+ */
+int usb_protocol_batch_append(uint8_t* buffer,
+                              uint32_t capacity,
+                              uint32_t* used,
+                              const usb_urb_header_t* urb_header,
+                              const void* data,
+                              uint32_t data_len);
+
+/**
+ * @brief Step to the next URB in the data of a USB_CMD_BATCH
+ *
+ * @param data Batch data
+ * @param size Bytes of batch data
+ * @param offset Position of the next entry (0 to start); advanced
+ * @param urb Receives a pointer to the entry's URB (header and data)
+ * @param urb_len Receives the size of the entry's URB
+ * @return 0 on success, E_NOT_FOUND after the last entry,
+ *         E_PROTOCOL_ERROR if the entry is cut off or shorter than a
+ *         URB header
+ */
+int usb_protocol_batch_next(const uint8_t* data,
+                            uint32_t size,
+                            uint32_t* offset,
+                            const uint8_t** urb,
+                            uint32_t* urb_len);
+
 /**
  * @brief Calculate checksum over URB header and data
  *
@@ -0,0 +1,1031 @@
+/*
+ * usb_send_queue.c - Per-Socket Outbound Queues for the USB Server
+ *
+ * Lock order: writer->lock, then queue->lock. Producers never hold a
+ * queue lock while taking the writer lock: a push marks the queue active
+ * under its own lock and links it into the writer list afterwards.
+ *
+ * Frame slots are preallocated in the queue and linked by index: free
+ * slots on a free list, queued ones on their flow, and the writer's
+ * current batch in inflight[]. Nothing is allocated per frame.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#include "usb_send_queue.h"
+#include "usb_protocol.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/metrics.h"
+#include "lib/common/stage_prof.h"
+#include "lib/common/thread_sched.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_capture.h"
+#include "lib/protocol/wire_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* The writer must never block, nor die on a vanished peer */
+#ifdef MSG_NOSIGNAL
+#define USB_SEND_FLAGS (MSG_DONTWAIT | MSG_NOSIGNAL)
+#else
+#define USB_SEND_FLAGS MSG_DONTWAIT
+#endif
+
+/* Writer sleep when a blocked socket could not be polled */
+#define USB_SEND_RETRY_MS 10
+
+/* ========================================================================
+ * Internal Helpers
+ * ======================================================================== */
+
+/**
+ * @brief Bytes a frame occupies on the stream
+ */
+static size_t usb_send_frame_len(const usb_send_frame_t* frame)
+{
+    return XOE_WIRE_HEADER_SIZE +
+           ((frame->payload != NULL) ? frame->payload->len : 0);
+}
+
+/**
+ * @brief Flow a key hashes onto
+ */
+static int usb_send_flow_index(uint32_t key)
+{
+    key ^= key >> 16;
+    key *= 0x45d9f3bU;
+    key ^= key >> 16;
+    return (int)(key % USB_SEND_FLOWS);
+}
+
+/**
+ * @brief Empty the scheduler: every slot free, every flow idle
+ */
+static void usb_send_queue_reset(usb_send_queue_t* queue)
+{
+    int cls;
+    int i;
+
+    for (i = 0; i < USB_SEND_QUEUE_DEPTH; i++) {
+        queue->frames[i].payload = NULL;
+        queue->frames[i].next = (i + 1 < USB_SEND_QUEUE_DEPTH) ? i + 1 : -1;
+    }
+    queue->free_head = 0;
+    queue->count = 0;
+
+    for (cls = 0; cls < USB_SEND_CLASSES; cls++) {
+        for (i = 0; i < USB_SEND_FLOWS; i++) {
+            queue->flows[cls][i].head = -1;
+            queue->flows[cls][i].tail = -1;
+            queue->flows[cls][i].deficit = 0;
+            queue->flows[cls][i].next_active = -1;
+            queue->flows[cls][i].active = FALSE;
+        }
+        queue->round_head[cls] = -1;
+        queue->round_tail[cls] = -1;
+    }
+
+    queue->inflight_count = 0;
+    queue->head_offset = 0;
+
+    for (i = 0; i < USB_SEND_CREDIT_STREAMS; i++) {
+        queue->credits[i].in_use = FALSE;
+    }
+}
+
+/**
+ * @brief Release every queued frame (queue->lock held)
+ */
+static void usb_send_queue_discard(usb_send_queue_t* queue)
+{
+    int i;
+
+    for (i = 0; i < USB_SEND_QUEUE_DEPTH; i++) {
+        xoe_payload_release(queue->frames[i].payload);
+        queue->frames[i].payload = NULL;
+    }
+    metrics_sub(METRIC_USB_SEND_QUEUED, (uint64_t)queue->count);
+    usb_send_queue_reset(queue);
+}
+
+/**
+ * @brief Take the next frame due off its flow (queue->lock held)
+ *
+ * Strict priority between classes; deficit round robin between the
+ * flows of a class. A flow at the head of its round sends while its
+ * deficit covers the next frame, then goes to the back of the round
+ * with one more quantum of credit.
+ *
+ * @return Frame index, or -1 if nothing is queued
+ */
+static int usb_send_queue_pick(usb_send_queue_t* queue)
+{
+    usb_send_flow_t* flow;
+    size_t len;
+    int index;
+    int cls;
+    int f;
+
+    for (cls = 0; cls < USB_SEND_CLASSES; cls++) {
+        while ((f = queue->round_head[cls]) >= 0) {
+            flow = &queue->flows[cls][f];
+            index = flow->head;
+            len = usb_send_frame_len(&queue->frames[index]);
+
+            if (flow->deficit >= (long)len) {
+                flow->deficit -= (long)len;
+                flow->head = queue->frames[index].next;
+                queue->frames[index].next = -1;
+                if (flow->head < 0) {
+                    /* Drained: leave the round, unused credit lapses */
+                    flow->tail = -1;
+                    flow->deficit = 0;
+                    flow->active = FALSE;
+                    queue->round_head[cls] = flow->next_active;
+                    if (queue->round_head[cls] < 0) {
+                        queue->round_tail[cls] = -1;
+                    }
+                    flow->next_active = -1;
+                }
+                return index;
+            }
+
+            /* Turn over: credit for the next turn, back of the round */
+            flow->deficit += USB_SEND_QUANTUM;
+            if (flow->next_active >= 0) {
+                queue->round_head[cls] = flow->next_active;
+                queue->flows[cls][queue->round_tail[cls]].next_active = f;
+                queue->round_tail[cls] = f;
+                flow->next_active = -1;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Top up the writer's batch from the scheduler (queue->lock held)
+ *
+ * Frames already in the batch keep their place, as bytes of them may be
+ * on the stream. Small frames are gathered up to USB_SEND_BATCH; beyond
+ * USB_SEND_GATHER_BYTES nothing more is committed, so a frame queued
+ * meanwhile can still go ahead of the rest.
+ */
+static void usb_send_queue_gather(usb_send_queue_t* queue)
+{
+    size_t bytes = 0;
+    int index;
+    int i;
+
+    for (i = 0; i < queue->inflight_count; i++) {
+        bytes += usb_send_frame_len(&queue->frames[queue->inflight[i]]);
+    }
+
+    while (queue->inflight_count < USB_SEND_BATCH &&
+           (queue->inflight_count == 0 || bytes < USB_SEND_GATHER_BYTES)) {
+        index = usb_send_queue_pick(queue);
+        if (index < 0) {
+            break;
+        }
+        queue->inflight[queue->inflight_count++] = index;
+        bytes += usb_send_frame_len(&queue->frames[index]);
+    }
+}
+
+/**
+ * @brief Free a queue with no references that is off the writer list
+ */
+static void usb_send_queue_destroy(usb_send_queue_t* queue)
+{
+    usb_send_queue_discard(queue);
+    pthread_cond_destroy(&queue->space);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
+
+/**
+ * @brief Wake the writer thread
+ */
+static void usb_send_writer_wake(usb_send_writer_t* writer)
+{
+    char byte = 0;
+    ssize_t written;
+
+    /* A full pipe already holds a pending wake-up */
+    written = write(writer->wake_fds[1], &byte, 1);
+    (void)written;
+}
+
+/**
+ * @brief Write as much of the queue as the socket accepts (queue->lock held)
+ *
+ * @return TRUE if frames remain and the socket is full, FALSE otherwise
+ */
+static int usb_send_queue_flush(usb_send_queue_t* queue)
+{
+    struct iovec iov[USB_SEND_BATCH * 2];
+    struct msghdr msg;
+    STAGE_PROF_VAR(start);
+    ssize_t sent;
+    int frames;
+    int iovcnt;
+    int i;
+
+    while (queue->count > 0 && !queue->closed && !queue->failed) {
+        /* Gather the batch, skipping what is written */
+        usb_send_queue_gather(queue);
+        frames = queue->inflight_count;
+        if (frames == 0) {
+            break;  /* The rest are held for credit */
+        }
+        iovcnt = 0;
+        for (i = 0; i < frames; i++) {
+            usb_send_frame_t* frame = &queue->frames[queue->inflight[i]];
+            size_t skip = (i == 0) ? queue->head_offset : 0;
+
+            if (skip < XOE_WIRE_HEADER_SIZE) {
+                iov[iovcnt].iov_base = frame->header + skip;
+                iov[iovcnt].iov_len = XOE_WIRE_HEADER_SIZE - skip;
+                iovcnt++;
+                skip = 0;
+            } else {
+                skip -= XOE_WIRE_HEADER_SIZE;
+            }
+            if (frame->payload != NULL && frame->payload->len > skip) {
+                iov[iovcnt].iov_base = (uint8_t*)frame->payload->data + skip;
+                iov[iovcnt].iov_len = frame->payload->len - skip;
+                iovcnt++;
+            }
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        STAGE_PROF_START(start);
+        sent = sendmsg(queue->fd, &msg, USB_SEND_FLAGS);
+        STAGE_PROF_STOP(STAGE_SEND_SYSCALL, start);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return TRUE;
+        }
+        if (sent <= 0) {
+            /* Peer gone: nothing more can be delivered on this stream */
+            queue->failed = TRUE;
+            queue->writer->queue_failures++;
+            usb_send_queue_discard(queue);
+            pthread_cond_broadcast(&queue->space);
+            return FALSE;
+        }
+
+        /* Retire fully written frames */
+        while (sent > 0) {
+            int index = queue->inflight[0];
+            usb_send_frame_t* frame = &queue->frames[index];
+            size_t frame_len = usb_send_frame_len(frame);
+            size_t remaining = frame_len - queue->head_offset;
+
+            if ((size_t)sent < remaining) {
+                queue->head_offset += (size_t)sent;
+                break;
+            }
+
+            sent -= (ssize_t)remaining;
+            xoe_wire_trace_record_header(queue->fd, XOE_WIRE_TRACE_TX,
+                                         frame->header, XOE_WIRE_TRACE_OK);
+            xoe_wire_capture_frame(queue->fd, XOE_WIRE_CAPTURE_TX,
+                                   frame->header,
+                                   (frame->payload != NULL)
+                                       ? frame->payload->data : NULL,
+                                   XOE_WIRE_TRACE_OK);
+            xoe_payload_release(frame->payload);
+            frame->payload = NULL;
+            frame->next = queue->free_head;
+            queue->free_head = index;
+            queue->inflight_count--;
+            memmove(queue->inflight, queue->inflight + 1,
+                    (size_t)queue->inflight_count * sizeof(queue->inflight[0]));
+            queue->head_offset = 0;
+            queue->count--;
+            queue->writer->frames_sent++;
+            metrics_sub(METRIC_USB_SEND_QUEUED, 1);
+            metrics_add(METRIC_NET_TX_FRAMES, 1);
+            metrics_add(METRIC_NET_TX_BYTES, frame_len);
+        }
+        pthread_cond_broadcast(&queue->space);
+    }
+
+    return FALSE;
+}
+
+/**
+ * @brief Make room for one more pollfd (writer->lock held)
+ */
+static int usb_send_writer_reserve_poll(usb_send_writer_t* writer, int needed)
+{
+    struct pollfd* pollfds;
+    int capacity;
+
+    if (needed <= writer->poll_capacity) {
+        return 0;
+    }
+
+    capacity = writer->poll_capacity * 2;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    pollfds = (struct pollfd*)realloc(writer->pollfds,
+                                      (size_t)capacity * sizeof(*pollfds));
+    if (pollfds == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    writer->pollfds = pollfds;
+    writer->poll_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Writer thread: flush active queues, then sleep until writable
+ */
+static void* usb_send_writer_thread(void* arg)
+{
+    usb_send_writer_t* writer = (usb_send_writer_t*)arg;
+    usb_send_queue_t** link;
+    usb_send_queue_t* queue;
+    char drain[64];
+    int timeout;
+    int count;
+
+    pthread_mutex_lock(&writer->lock);
+    while (!writer->stop) {
+        /* Slot 0 is the wake pipe */
+        count = 1;
+        timeout = -1;
+        link = &writer->active;
+        while ((queue = *link) != NULL) {
+            int blocked;
+            int destroy = FALSE;
+
+            pthread_mutex_lock(&queue->lock);
+            blocked = usb_send_queue_flush(queue);
+            if (!blocked) {
+                /* Drained (or dead): leave the list until the next push */
+                queue->active = FALSE;
+                *link = queue->next_active;
+                queue->next_active = NULL;
+                destroy = (queue->refs == 0);
+            } else {
+                if (usb_send_writer_reserve_poll(writer, count + 1) == 0) {
+                    writer->pollfds[count].fd = queue->fd;
+                    writer->pollfds[count].events = POLLOUT;
+                    writer->pollfds[count].revents = 0;
+                    count++;
+                } else {
+                    /* Not polled: retry after a short sleep */
+                    timeout = USB_SEND_RETRY_MS;
+                }
+                link = &queue->next_active;
+            }
+            pthread_mutex_unlock(&queue->lock);
+
+            if (destroy) {
+                usb_send_queue_destroy(queue);
+            }
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        writer->pollfds[0].fd = writer->wake_fds[0];
+        writer->pollfds[0].events = POLLIN;
+        writer->pollfds[0].revents = 0;
+
+        /* Pushes to new queues and shutdown arrive through the pipe */
+        if (poll(writer->pollfds, (nfds_t)count, timeout) > 0 &&
+            (writer->pollfds[0].revents & POLLIN)) {
+            while (read(writer->wake_fds[0], drain, sizeof(drain)) > 0) {
+                /* Drain pending wake-ups */
+            }
+        }
+
+        pthread_mutex_lock(&writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    return NULL;
+}
+
+/* ========================================================================
+ * Writer Lifecycle
+ * ======================================================================== */
+
+/**
+ * @brief Initialize a writer and start its thread
+ */
+int usb_send_writer_init(usb_send_writer_t* writer)
+{
+    int i;
+
+    if (writer == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(writer, 0, sizeof(*writer));
+    writer->wake_fds[0] = -1;
+    writer->wake_fds[1] = -1;
+
+    writer->poll_capacity = 16;
+    writer->pollfds = (struct pollfd*)calloc((size_t)writer->poll_capacity,
+                                             sizeof(struct pollfd));
+    if (writer->pollfds == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    if (pipe(writer->wake_fds) != 0) {
+        free(writer->pollfds);
+        writer->pollfds = NULL;
+        return E_IO_ERROR;
+    }
+    for (i = 0; i < 2; i++) {
+        (void)fd_set_nonblocking(writer->wake_fds[i]);
+    }
+
+    if (pthread_mutex_init(&writer->lock, NULL) != 0) {
+        close(writer->wake_fds[0]);
+        close(writer->wake_fds[1]);
+        free(writer->pollfds);
+        writer->pollfds = NULL;
+        return E_UNKNOWN_ERROR;
+    }
+
+    if (thread_sched_create(&writer->thread, THREAD_CLASS_USB,
+                            usb_send_writer_thread, writer) != 0) {
+        pthread_mutex_destroy(&writer->lock);
+        close(writer->wake_fds[0]);
+        close(writer->wake_fds[1]);
+        free(writer->pollfds);
+        writer->pollfds = NULL;
+        return E_UNKNOWN_ERROR;
+    }
+    writer->thread_started = TRUE;
+
+    return 0;
+}
+
+/**
+ * @brief Stop the writer thread and free every remaining queue
+ */
+void usb_send_writer_cleanup(usb_send_writer_t* writer)
+{
+    usb_send_queue_t* queue;
+
+    if (writer == NULL || !writer->thread_started) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->stop = TRUE;
+    pthread_mutex_unlock(&writer->lock);
+    usb_send_writer_wake(writer);
+    pthread_join(writer->thread, NULL);
+    writer->thread_started = FALSE;
+
+    /* Released queues still waiting for the writer to unlink them */
+    while ((queue = writer->active) != NULL) {
+        writer->active = queue->next_active;
+        usb_send_queue_destroy(queue);
+    }
+
+    pthread_mutex_destroy(&writer->lock);
+    close(writer->wake_fds[0]);
+    close(writer->wake_fds[1]);
+    free(writer->pollfds);
+    writer->pollfds = NULL;
+}
+
+/* ========================================================================
+ * Queue Functions
+ * ======================================================================== */
+
+/**
+ * @brief Create a queue for a client socket
+ */
+usb_send_queue_t* usb_send_queue_create(usb_send_writer_t* writer, int fd)
+{
+    usb_send_queue_t* queue;
+
+    if (writer == NULL || fd < 0) {
+        return NULL;
+    }
+
+    queue = (usb_send_queue_t*)calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&queue->lock, NULL) != 0) {
+        free(queue);
+        return NULL;
+    }
+    if (pthread_cond_init(&queue->space, NULL) != 0) {
+        pthread_mutex_destroy(&queue->lock);
+        free(queue);
+        return NULL;
+    }
+
+    usb_send_queue_reset(queue);
+    queue->writer = writer;
+    queue->fd = fd;
+    queue->refs = 1;
+
+    return queue;
+}
+
+/**
+ * @brief Take an additional reference
+ */
+void usb_send_queue_retain(usb_send_queue_t* queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->refs++;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Drop a reference
+ */
+void usb_send_queue_release(usb_send_queue_t* queue)
+{
+    usb_send_writer_t* writer;
+    int destroy = FALSE;
+    int wake = FALSE;
+
+    if (queue == NULL) {
+        return;
+    }
+    writer = queue->writer;
+
+    pthread_mutex_lock(&queue->lock);
+    if (--queue->refs == 0) {
+        queue->closed = TRUE;
+        usb_send_queue_discard(queue);
+        pthread_cond_broadcast(&queue->space);
+
+        /* An active queue is freed by the writer when it unlinks it */
+        destroy = !queue->active;
+        wake = queue->active;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    /* Once unlocked, an active queue may already be gone */
+    if (destroy) {
+        usb_send_queue_destroy(queue);
+    } else if (wake) {
+        usb_send_writer_wake(writer);
+    }
+}
+
+/**
+ * @brief Read the routing fields of a USB frame's URB header
+ *
+ * @return TRUE for an uncompressed USB frame holding a URB header
+ */
+static int usb_send_frame_urb(const xoe_packet_t* packet,
+                              uint16_t* command,
+                              uint32_t* device_id,
+                              uint8_t* endpoint,
+                              uint8_t* transfer_type,
+                              uint32_t* seqnum)
+{
+    const uint8_t* urb;
+
+    if (packet == NULL || packet->protocol_id != XOE_PROTOCOL_USB ||
+        packet->payload == NULL ||
+        packet->payload->len < USB_URB_HEADER_WIRE_SIZE ||
+        (packet->protocol_version & XOE_WIRE_VERSION_COMPRESSED) != 0) {
+        return FALSE;
+    }
+
+    /* command at 0, seqnum at 4, device_id at 8, endpoint and type at 12 */
+    urb = (const uint8_t*)packet->payload->data;
+    *command = (uint16_t)(((uint16_t)urb[0] << 8) | urb[1]);
+    *seqnum = ((uint32_t)urb[4] << 24) | ((uint32_t)urb[5] << 16) |
+              ((uint32_t)urb[6] << 8) | (uint32_t)urb[7];
+    *device_id = ((uint32_t)urb[8] << 24) | ((uint32_t)urb[9] << 16) |
+                 ((uint32_t)urb[10] << 8) | (uint32_t)urb[11];
+    *endpoint = urb[12];
+    *transfer_type = urb[13];
+    return TRUE;
+}
+
+/**
+ * @brief Find the credit state of an OUT endpoint (queue->lock held)
+ *
+ * @param create Take a free entry if the endpoint has none
+ * @return Entry, or NULL if the endpoint is not tracked (or, with
+ *         @p create, the table is full)
+ */
+static usb_send_credit_t* usb_send_queue_find_credit(usb_send_queue_t* queue,
+                                                     uint32_t device_id,
+                                                     uint8_t endpoint,
+                                                     int create)
+{
+    usb_send_credit_t* unused = NULL;
+    int i;
+
+    for (i = 0; i < USB_SEND_CREDIT_STREAMS; i++) {
+        usb_send_credit_t* stream = &queue->credits[i];
+
+        if (!stream->in_use) {
+            if (unused == NULL) {
+                unused = stream;
+            }
+        } else if (stream->device_id == device_id &&
+                   stream->endpoint == endpoint) {
+            return stream;
+        }
+    }
+
+    if (!create || unused == NULL) {
+        return NULL;
+    }
+    unused->in_use = TRUE;
+    unused->device_id = device_id;
+    unused->endpoint = endpoint;
+    unused->credit = 0;
+    unused->held_head = -1;
+    unused->held_tail = -1;
+    unused->held_count = 0;
+    return unused;
+}
+
+/**
+ * @brief Whether a push has to wait (queue->lock held)
+ *
+ * The queue is full for everyone when every slot is used, and for an
+ * endpoint out of credit once it has USB_SEND_HELD_MAX frames held.
+ */
+static int usb_send_queue_full(const usb_send_queue_t* queue,
+                               const usb_send_credit_t* stream)
+{
+    return queue->count == USB_SEND_QUEUE_DEPTH ||
+           (stream != NULL && stream->credit == 0 &&
+            stream->held_count >= USB_SEND_HELD_MAX);
+}
+
+/**
+ * @brief Append a frame to its flow (queue->lock held)
+ *
+ * An idle flow joins the back of its class's round.
+ */
+static void usb_send_queue_link(usb_send_queue_t* queue, int index)
+{
+    usb_send_frame_t* frame = &queue->frames[index];
+    usb_send_flow_t* flow = &queue->flows[frame->cls][frame->flow];
+    int cls = frame->cls;
+
+    frame->next = -1;
+    if (flow->head < 0) {
+        flow->head = index;
+    } else {
+        queue->frames[flow->tail].next = index;
+    }
+    flow->tail = index;
+
+    if (!flow->active) {
+        flow->active = TRUE;
+        flow->deficit = USB_SEND_QUANTUM;
+        if (queue->round_tail[cls] < 0) {
+            queue->round_head[cls] = frame->flow;
+        } else {
+            queue->flows[cls][queue->round_tail[cls]].next_active = frame->flow;
+        }
+        queue->round_tail[cls] = frame->flow;
+    }
+}
+
+/**
+ * @brief Move held frames to their flows while credit lasts
+ *        (queue->lock held)
+ *
+ * @return Frames released
+ */
+static int usb_send_queue_release_held(usb_send_queue_t* queue,
+                                       usb_send_credit_t* stream)
+{
+    int released = 0;
+    int index;
+
+    while (stream->credit > 0 && stream->held_head >= 0) {
+        index = stream->held_head;
+        stream->held_head = queue->frames[index].next;
+        if (stream->held_head < 0) {
+            stream->held_tail = -1;
+        }
+        stream->held_count--;
+        stream->credit--;
+        usb_send_queue_link(queue, index);
+        released++;
+    }
+    return released;
+}
+
+/**
+ * @brief Drop a held URB its sender has unlinked (queue->lock held)
+ */
+static void usb_send_queue_drop_held(usb_send_queue_t* queue,
+                                     usb_send_credit_t* stream,
+                                     uint32_t seqnum)
+{
+    uint16_t command;
+    uint32_t device_id;
+    uint32_t held_seqnum;
+    uint8_t endpoint;
+    uint8_t transfer_type;
+    xoe_packet_t view;
+    int* link = &stream->held_head;
+    int prev = -1;
+    int index;
+
+    while ((index = *link) >= 0) {
+        usb_send_frame_t* frame = &queue->frames[index];
+
+        memset(&view, 0, sizeof(view));
+        view.protocol_id = XOE_PROTOCOL_USB;
+        view.payload = frame->payload;
+        if (usb_send_frame_urb(&view, &command, &device_id, &endpoint,
+                               &transfer_type, &held_seqnum) &&
+            held_seqnum == seqnum) {
+            *link = frame->next;
+            if (stream->held_tail == index) {
+                stream->held_tail = prev;
+            }
+            stream->held_count--;
+            xoe_payload_release(frame->payload);
+            frame->payload = NULL;
+            frame->next = queue->free_head;
+            queue->free_head = index;
+            queue->count--;
+            metrics_sub(METRIC_USB_SEND_QUEUED, 1);
+            pthread_cond_broadcast(&queue->space);
+            return;
+        }
+        prev = index;
+        link = &frame->next;
+    }
+}
+
+/**
+ * @brief Put an active queue on the writer's list and wake the writer
+ */
+static void usb_send_queue_link_writer(usb_send_queue_t* queue)
+{
+    usb_send_writer_t* writer = queue->writer;
+
+    pthread_mutex_lock(&writer->lock);
+    queue->next_active = writer->active;
+    writer->active = queue;
+    pthread_mutex_unlock(&writer->lock);
+    usb_send_writer_wake(writer);
+}
+
+/**
+ * @brief Traffic class of a packet
+ */
+int usb_send_frame_class(const xoe_packet_t* packet, uint32_t* flow_key)
+{
+    uint16_t command;
+    uint32_t device_id;
+    uint32_t seqnum;
+    uint8_t endpoint;
+    uint8_t transfer_type;
+
+    if (flow_key != NULL) {
+        *flow_key = (packet != NULL) ? packet->protocol_id : 0;
+    }
+    if (packet == NULL || packet->protocol_id != XOE_PROTOCOL_USB) {
+        return USB_SEND_CLASS_SERIAL;
+    }
+    if (!usb_send_frame_urb(packet, &command, &device_id, &endpoint,
+                            &transfer_type, &seqnum)) {
+        return USB_SEND_CLASS_BULK;
+    }
+    if (flow_key != NULL) {
+        *flow_key = device_id;
+    }
+
+    if ((command == USB_CMD_SUBMIT || command == USB_RET_SUBMIT) &&
+        (transfer_type == USB_TRANSFER_CONTROL ||
+         transfer_type == USB_TRANSFER_INTERRUPT ||
+         transfer_type == USB_TRANSFER_ISOCHRONOUS)) {
+        return USB_SEND_CLASS_URGENT;
+    }
+    return USB_SEND_CLASS_BULK;
+}
+
+/**
+ * @brief Set or return credit of an OUT endpoint on the socket
+ */
+int usb_send_queue_credit(usb_send_queue_t* queue,
+                          uint32_t device_id,
+                          uint8_t endpoint,
+                          uint32_t urbs,
+                          int window)
+{
+    usb_send_credit_t* stream;
+    int link = FALSE;
+    int result = 0;
+
+    if (queue == NULL || (endpoint & 0x80) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+
+    stream = usb_send_queue_find_credit(queue, device_id, endpoint, window);
+    if (stream == NULL) {
+        /* Credit for an endpoint never given a window is meaningless */
+        result = window ? E_BUFFER_TOO_SMALL : E_NOT_FOUND;
+    } else {
+        if (window) {
+            stream->credit = urbs;
+        } else if (stream->credit > UINT32_MAX - urbs) {
+            stream->credit = UINT32_MAX;
+        } else {
+            stream->credit += urbs;
+        }
+
+        if (usb_send_queue_release_held(queue, stream) > 0) {
+            pthread_cond_broadcast(&queue->space);
+            if (!queue->active && !queue->closed && !queue->failed) {
+                queue->active = TRUE;
+                link = TRUE;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    if (link) {
+        usb_send_queue_link_writer(queue);
+    }
+    return result;
+}
+
+/**
+ * @brief Queue a packet for the socket
+ */
+int usb_send_queue_push(usb_send_queue_t* queue,
+                        xoe_packet_t* packet,
+                        int relay,
+                        unsigned int stall_ms)
+{
+    usb_send_writer_t* writer;
+    usb_send_credit_t* stream = NULL;
+    usb_send_frame_t* frame;
+    struct timespec deadline;
+    struct timeval now;
+    uint32_t flow_key;
+    uint32_t device_id = 0;
+    uint32_t seqnum = 0;
+    uint16_t command = 0;
+    uint8_t endpoint = 0;
+    uint8_t transfer_type;
+    int is_urb;
+    int index;
+    int cls;
+    int stalled = FALSE;
+    int link = FALSE;
+    int result = 0;
+    STAGE_PROF_VAR(start);
+
+    if (queue == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    writer = queue->writer;
+    cls = usb_send_frame_class(packet, &flow_key);
+    is_urb = usb_send_frame_urb(packet, &command, &device_id, &endpoint,
+                                &transfer_type, &seqnum);
+
+    /* Contended while the writer is flushing this socket */
+    STAGE_PROF_START(start);
+    pthread_mutex_lock(&queue->lock);
+    STAGE_PROF_STOP(STAGE_SEND_LOCK_WAIT, start);
+
+    /* OUT data counts against its endpoint's credit, if it has a window */
+    if (is_urb && command == USB_CMD_SUBMIT && (endpoint & 0x80) == 0 &&
+        packet->payload->len > USB_URB_HEADER_WIRE_SIZE) {
+        stream = usb_send_queue_find_credit(queue, device_id, endpoint, FALSE);
+    }
+
+    /* Backpressure: wait for the writer to free a slot, up to stall_ms */
+    if (usb_send_queue_full(queue, stream) && !queue->closed &&
+        !queue->failed && stall_ms > 0) {
+        stalled = TRUE;
+        metrics_add(METRIC_USB_SEND_STALLS, 1);
+
+        gettimeofday(&now, NULL);
+        deadline.tv_sec = now.tv_sec + (stall_ms / 1000);
+        deadline.tv_nsec = (now.tv_usec * 1000) +
+                           ((long)(stall_ms % 1000) * 1000000);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        while (usb_send_queue_full(queue, stream) && !queue->closed &&
+               !queue->failed) {
+            if (pthread_cond_timedwait(&queue->space, &queue->lock,
+                                       &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+    }
+
+    if (queue->closed) {
+        result = E_INVALID_STATE;
+    } else if (queue->failed) {
+        result = E_NETWORK_ERROR;
+    } else if (usb_send_queue_full(queue, stream)) {
+        result = E_WOULD_BLOCK;
+    } else {
+        /* An unlinked URB still held for credit never goes out */
+        if (is_urb && command == USB_CMD_UNLINK) {
+            usb_send_credit_t* held = usb_send_queue_find_credit(
+                queue, device_id, endpoint, FALSE);
+            if (held != NULL) {
+                usb_send_queue_drop_held(queue, held, seqnum);
+            }
+        }
+
+        index = queue->free_head;
+        frame = &queue->frames[index];
+        queue->free_head = frame->next;
+        xoe_wire_build_header(packet, frame->header, relay);
+        frame->payload = packet->payload;
+        frame->cls = cls;
+        frame->flow = usb_send_flow_index(flow_key);
+        packet->payload = NULL;
+        queue->count++;
+        metrics_add(METRIC_USB_SEND_QUEUED, 1);
+
+        if (stream != NULL && stream->credit == 0) {
+            /* Held until the endpoint is given credit */
+            frame->next = -1;
+            if (stream->held_tail < 0) {
+                stream->held_head = index;
+            } else {
+                queue->frames[stream->held_tail].next = index;
+            }
+            stream->held_tail = index;
+            stream->held_count++;
+        } else {
+            if (stream != NULL) {
+                stream->credit--;
+            }
+            usb_send_queue_link(queue, index);
+            if (!queue->active) {
+                queue->active = TRUE;
+                link = TRUE;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+
+    /* Not queued: the payload is ours to release */
+    if (packet->payload != NULL) {
+        xoe_payload_release(packet->payload);
+        packet->payload = NULL;
+    }
+
+    if (link || stalled || result == E_WOULD_BLOCK) {
+        pthread_mutex_lock(&writer->lock);
+        if (link) {
+            queue->next_active = writer->active;
+            writer->active = queue;
+        }
+        if (stalled) {
+            writer->frames_stalled++;
+        }
+        if (result == E_WOULD_BLOCK) {
+            writer->frames_dropped++;
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        if (link) {
+            usb_send_writer_wake(writer);
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,294 @@
+/*
+ * usb_send_queue.h - Per-Socket Outbound Queues for the USB Server
+ *
+ * Frames routed to a USB client are appended to a bounded queue owned by
+ * the client's socket and written out by a single writer thread using
+ * non-blocking sends. A client whose TCP window is full only fills its
+ * own queue; routers sending to other clients are not held up by it.
+ *
+ * When a queue is full the router waits for space up to a stall limit
+ * (backpressure), then drops the frame. Both outcomes are counted.
+ *
+ * Frames do not leave in arrival order. Each is put in a traffic class
+ * (usb_send_frame_class()) and the writer always sends from the most
+ * urgent class that has frames, so a HID interrupt report is not queued
+ * behind megabytes of bulk data. Within a class, frames are kept in
+ * per-device flows served by deficit round robin on bytes: a device
+ * streaming large bulk URBs gets its share of the socket, not all of it.
+ * Frames of one flow stay in order.
+ *
+ * The stream format cannot interleave two frames, so a frame the writer
+ * has started is always finished. To keep that wait short the writer
+ * commits only up to USB_SEND_GATHER_BYTES of frames per sendmsg(); an
+ * urgent frame waits at most for those and whatever the socket buffer
+ * already holds. Bulk URBs are capped at the negotiated URB size
+ * (USB_MAX_LARGE_DATA_SIZE), which bounds the worst case.
+ *
+ * OUT URBs are also subject to credit from the client that owns the
+ * device (usb_send_queue_credit(), USB_CMD_CREDIT). An endpoint out of
+ * credit has its URBs held apart from the scheduler, and a sender pushing
+ * to it waits once USB_SEND_HELD_MAX are held; every other endpoint on
+ * the socket keeps flowing. Endpoints never given a window are unlimited.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2025-12-05
+ */
+
+#ifndef USB_SEND_QUEUE_H
+#define USB_SEND_QUEUE_H
+
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_format.h"
+#include <pthread.h>
+#include <poll.h>
+
+/* Frames queued per client socket */
+#define USB_SEND_QUEUE_DEPTH 64
+
+/* Default wait for queue space before a frame is dropped */
+#define USB_SEND_STALL_MS 50
+
+/* Frames gathered into one sendmsg() by the writer */
+#define USB_SEND_BATCH (XOE_WIRE_SENDV_MAX_IOV / 2)
+
+/* Further frames are gathered only while the batch is below this size */
+#define USB_SEND_GATHER_BYTES (16 * 1024)
+
+/*
+ * Traffic classes, most urgent first. Every USB command other than a
+ * control, interrupt or isochronous URB (its completion included) goes
+ * with bulk, so an UNLINK never overtakes the URB it cancels.
+ */
+#define USB_SEND_CLASS_URGENT 0         /* Control, interrupt, isochronous */
+#define USB_SEND_CLASS_SERIAL 1         /* Serial and other protocols */
+#define USB_SEND_CLASS_BULK   2         /* Bulk URBs, other USB commands */
+#define USB_SEND_CLASSES      3
+
+/* Flows per class; devices hash onto them */
+#define USB_SEND_FLOWS 8
+
+/* Bytes a flow may send per round before the next flow's turn */
+#define USB_SEND_QUANTUM (16 * 1024)
+
+/* OUT endpoints per socket that can be given a credit window */
+#define USB_SEND_CREDIT_STREAMS 8
+
+/* URBs held per endpoint out of credit before its senders wait */
+#define USB_SEND_HELD_MAX 4
+
+typedef struct usb_send_writer usb_send_writer_t;
+typedef struct usb_send_queue usb_send_queue_t;
+
+/**
+ * @brief One queued frame: serialized header plus owned payload
+ */
+typedef struct {
+    uint8_t header[XOE_WIRE_HEADER_SIZE];
+    xoe_payload_t* payload;             /* Released once written */
+    int next;                           /* Next frame of the flow, or of
+                                           its held list or of the free
+                                           list (-1: none) */
+    int cls;                            /* Traffic class */
+    int flow;                           /* Flow within the class */
+} usb_send_frame_t;
+
+/**
+ * @brief Frames of one class from the devices hashed onto it
+ */
+typedef struct {
+    int head;                           /* Oldest frame (-1: empty) */
+    int tail;                           /* Newest frame */
+    long deficit;                       /* Bytes it may still send */
+    int next_active;                    /* Next flow of the round */
+    int active;                         /* In its class's round */
+} usb_send_flow_t;
+
+/**
+ * @brief Credit of one OUT endpoint on the socket
+ */
+typedef struct {
+    uint32_t device_id;
+    uint8_t endpoint;
+    int in_use;                         /* Given a window */
+    uint32_t credit;                    /* URBs it may still send */
+    int held_head;                      /* Oldest held URB (-1: none) */
+    int held_tail;
+    int held_count;
+} usb_send_credit_t;
+
+/**
+ * @brief Bounded outbound frame queue of one client socket
+ *
+ * Shared by every registry entry on the socket, so frames for different
+ * devices never interleave on the stream. Freed once it has no
+ * references and is off the writer's list.
+ */
+struct usb_send_queue {
+    usb_send_writer_t* writer;          /* Owning writer */
+    int fd;                             /* Client socket */
+
+    usb_send_frame_t frames[USB_SEND_QUEUE_DEPTH];
+    int free_head;                      /* Unused frames */
+    int count;                          /* Frames held (queued and in
+                                           flight) */
+
+    /* Scheduler: flows per class, each class a round of active flows */
+    usb_send_flow_t flows[USB_SEND_CLASSES][USB_SEND_FLOWS];
+    int round_head[USB_SEND_CLASSES];   /* Flow served next (-1: idle) */
+    int round_tail[USB_SEND_CLASSES];
+
+    /* Frames taken off their flows for the current sendmsg(), in order */
+    int inflight[USB_SEND_BATCH];
+    int inflight_count;
+    size_t head_offset;                 /* Bytes of inflight[0] written */
+
+    /* OUT endpoints with a credit window and the URBs they hold */
+    usb_send_credit_t credits[USB_SEND_CREDIT_STREAMS];
+
+    int refs;                           /* Entries and in-progress pushes */
+    int closed;                         /* No references left */
+    int failed;                         /* Socket write error */
+    int active;                         /* On (or joining) writer list */
+
+    pthread_mutex_t lock;               /* Protects all fields above */
+    pthread_cond_t space;               /* Frame written or closed */
+
+    usb_send_queue_t* next_active;      /* Writer list (writer lock) */
+};
+
+/**
+ * @brief Writer thread draining every active queue
+ */
+struct usb_send_writer {
+    usb_send_queue_t* active;           /* Queues with frames to write */
+    struct pollfd* pollfds;             /* Blocked sockets + wake pipe */
+    int poll_capacity;                  /* Size of pollfds */
+
+    pthread_t thread;                   /* Writer thread */
+    int thread_started;                 /* TRUE once the thread runs */
+    int stop;                           /* Thread exit flag */
+    int wake_fds[2];                    /* Self-pipe: new active queue */
+
+    pthread_mutex_t lock;               /* Protects list and counters */
+
+    /* Statistics */
+    unsigned long frames_sent;          /* Frames fully written */
+    unsigned long frames_stalled;       /* Pushes that waited for space */
+    unsigned long frames_dropped;       /* Pushes refused on a full queue */
+    unsigned long queue_failures;       /* Sockets that failed mid-stream */
+};
+
+/**
+ * @brief Initialize a writer and start its thread
+ *
+ * @param writer Writer to initialize
+ * @return 0 on success, negative error code on failure
+ */
+int usb_send_writer_init(usb_send_writer_t* writer);
+
+/**
+ * @brief Stop the writer thread and free every remaining queue
+ *
+ * Queues must have been released by their owners first.
+ *
+ * @param writer Writer (may be NULL or never initialized)
+ */
+void usb_send_writer_cleanup(usb_send_writer_t* writer);
+
+/**
+ * @brief Create a queue for a client socket
+ *
+ * @param writer Writer that will drain the queue
+ * @param fd Client socket
+ * @return Queue holding one reference, or NULL on failure
+ */
+usb_send_queue_t* usb_send_queue_create(usb_send_writer_t* writer, int fd);
+
+/**
+ * @brief Take an additional reference
+ *
+ * Held by every registry entry on the socket, and by a sender for the
+ * duration of a push (taken while the entry is known to be alive, e.g.
+ * under the registry lock).
+ *
+ * @param queue Queue
+ */
+void usb_send_queue_retain(usb_send_queue_t* queue);
+
+/**
+ * @brief Drop a reference
+ *
+ * Dropping the last reference discards frames not yet written; after
+ * it returns the writer no longer touches the socket.
+ *
+ * @param queue Queue (may be NULL)
+ */
+void usb_send_queue_release(usb_send_queue_t* queue);
+
+/**
+ * @brief Traffic class of a packet
+ *
+ * USB frames are classed by command and transfer type from their URB
+ * header; a compressed or truncated one is treated as bulk. Frames of
+ * other protocols are USB_SEND_CLASS_SERIAL.
+ *
+ * @param packet Packet to be sent
+ * @param flow_key Set to the key its flow is chosen by (the URB's
+ *                 device_id, else the protocol id); may be NULL
+ * @return USB_SEND_CLASS_*
+ */
+int usb_send_frame_class(const xoe_packet_t* packet, uint32_t* flow_key);
+
+/**
+ * @brief Set or return credit of an OUT endpoint on the socket
+ *
+ * A window starts tracking the endpoint: from then on each CMD_SUBMIT
+ * with OUT data for it takes one credit, and one pushed without credit
+ * is held until credit arrives. URBs held are released to the scheduler
+ * in order as soon as credit covers them.
+ *
+ * @param queue Queue
+ * @param device_id Device
+ * @param endpoint OUT endpoint address
+ * @param urbs URBs granted
+ * @param window TRUE to set the credit to @p urbs (starting to track the
+ *               endpoint), FALSE to add @p urbs to it
+ * @return 0 on success,
+ *         E_INVALID_ARGUMENT for an IN endpoint,
+ *         E_BUFFER_TOO_SMALL if no more endpoints can be tracked (it
+ *         stays unlimited),
+ *         E_NOT_FOUND for credit to an endpoint never given a window
+ */
+int usb_send_queue_credit(usb_send_queue_t* queue,
+                          uint32_t device_id,
+                          uint8_t endpoint,
+                          uint32_t urbs,
+                          int window);
+
+/**
+ * @brief Queue a packet for the socket
+ *
+ * The caller must hold a reference. Returns as soon as the frame is
+ * queued; the writer thread sends it when its class and flow are due.
+ *
+ * Takes ownership of packet->payload in every case (set to NULL).
+ *
+ * @param queue Queue
+ * @param packet Packet to send
+ * @param relay TRUE to reuse the received checksum (see
+ *              xoe_wire_build_header())
+ * @param stall_ms Maximum wait for space when full (0 = drop at once)
+ * @return 0 once queued (or held for credit),
+ *         E_WOULD_BLOCK if the queue, or the endpoint's held URBs, stayed
+ *         full (frame dropped),
+ *         E_INVALID_STATE if the queue is closed,
+ *         E_NETWORK_ERROR if the socket has failed
+ */
+int usb_send_queue_push(usb_send_queue_t* queue,
+                        xoe_packet_t* packet,
+                        int relay,
+                        unsigned int stall_ms);
+
+#endif /* USB_SEND_QUEUE_H */
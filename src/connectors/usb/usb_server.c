@@ -14,6 +14,10 @@
 #include "usb_protocol.h"
 #include "usb_config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/stage_prof.h"
 #include "lib/protocol/wire_format.h"
 #include "lib/security/usb_auth.h"
 #include <stdlib.h>
@@ -25,6 +29,345 @@
 #include <arpa/inet.h>
 #include <errno.h>
 
+/* ========================================================================
+ * Client Registry (internal)
+ *
+ * All helpers expect registry_lock held exclusive unless noted.
+ * ======================================================================== */
+
+/**
+ * @brief Hash a device_id or socket descriptor to a bucket
+ */
+static uint32_t usb_server_bucket(const usb_server_t* server, uint32_t key)
+{
+    /* Fibonacci hashing: VID:PID values share their low bits often */
+    return (uint32_t)((key * 2654435761UL) >> 16) & server->bucket_mask;
+}
+
+/**
+ * @brief Link an entry into the device_id index (registration done)
+ */
+static void usb_server_index_device(usb_server_t* server,
+                                    usb_client_entry_t* entry)
+{
+    uint32_t bucket = usb_server_bucket(server, entry->device_id);
+
+    entry->device_next = server->device_buckets[bucket];
+    server->device_buckets[bucket] = entry;
+}
+
+/**
+ * @brief Unlink an entry from the device_id index
+ */
+static void usb_server_unindex_device(usb_server_t* server,
+                                      usb_client_entry_t* entry)
+{
+    usb_client_entry_t** link;
+
+    link = &server->device_buckets[usb_server_bucket(server, entry->device_id)];
+    while (*link != NULL) {
+        if (*link == entry) {
+            *link = entry->device_next;
+            break;
+        }
+        link = &(*link)->device_next;
+    }
+    entry->device_next = NULL;
+}
+
+/**
+ * @brief Link an entry into the socket index (entry reserved)
+ */
+static void usb_server_index_socket(usb_server_t* server,
+                                    usb_client_entry_t* entry)
+{
+    uint32_t bucket = usb_server_bucket(server, (uint32_t)entry->socket_fd);
+
+    entry->socket_next = server->socket_buckets[bucket];
+    server->socket_buckets[bucket] = entry;
+}
+
+/**
+ * @brief Unlink an entry from the socket index
+ */
+static void usb_server_unindex_socket(usb_server_t* server,
+                                      usb_client_entry_t* entry)
+{
+    usb_client_entry_t** link;
+
+    link = &server->socket_buckets[usb_server_bucket(server,
+                                                     (uint32_t)entry->socket_fd)];
+    while (*link != NULL) {
+        if (*link == entry) {
+            *link = entry->socket_next;
+            break;
+        }
+        link = &(*link)->socket_next;
+    }
+    entry->socket_next = NULL;
+}
+
+/**
+ * @brief Double the bucket count and rebuild both indexes
+ *
+ * @return 0 on success, E_OUT_OF_MEMORY (indexes left unchanged)
+ */
+static int usb_server_grow_buckets(usb_server_t* server)
+{
+    usb_client_entry_t** device_buckets;
+    usb_client_entry_t** socket_buckets;
+    uint32_t count = (server->bucket_mask + 1) * 2;
+    int i;
+
+    device_buckets = (usb_client_entry_t**)calloc(count, sizeof(*device_buckets));
+    socket_buckets = (usb_client_entry_t**)calloc(count, sizeof(*socket_buckets));
+    if (device_buckets == NULL || socket_buckets == NULL) {
+        free(device_buckets);
+        free(socket_buckets);
+        return E_OUT_OF_MEMORY;
+    }
+
+    free(server->device_buckets);
+    free(server->socket_buckets);
+    server->device_buckets = device_buckets;
+    server->socket_buckets = socket_buckets;
+    server->bucket_mask = count - 1;
+
+    for (i = 0; i < server->entry_count; i++) {
+        usb_client_entry_t* entry = server->entries[i];
+
+        if (entry->in_use) {
+            usb_server_index_device(server, entry);
+        }
+        if (entry->reserved) {
+            usb_server_index_socket(server, entry);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Find the send queue of a socket
+ *
+ * @param server Server context (registry_lock held, shared or exclusive)
+ * @param socket_fd Client socket
+ * @return Queue shared by the socket's entries, or NULL if none
+ */
+static usb_send_queue_t* usb_server_socket_queue(const usb_server_t* server,
+                                                 int socket_fd)
+{
+    usb_client_entry_t* entry;
+
+    entry = server->socket_buckets[usb_server_bucket(server, (uint32_t)socket_fd)];
+    for (; entry != NULL; entry = entry->socket_next) {
+        if (entry->socket_fd == socket_fd) {
+            return entry->send_queue;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Take an entry from the free list, allocating one if needed
+ *
+ * The entry is reserved, linked into the socket index and holds a
+ * reference to the socket's send queue (created for the first entry).
+ *
+ * @return Entry, or NULL if the registry is full or out of memory
+ */
+static usb_client_entry_t* usb_server_reserve_entry(usb_server_t* server,
+                                                    int socket_fd,
+                                                    uint32_t device_id)
+{
+    usb_client_entry_t* entry = server->free_entries;
+    usb_send_queue_t* queue;
+
+    /* Entries on one socket share its queue, so frames never interleave */
+    queue = usb_server_socket_queue(server, socket_fd);
+    if (queue != NULL) {
+        usb_send_queue_retain(queue);
+    } else {
+        queue = usb_send_queue_create(&server->send_writer, socket_fd);
+        if (queue == NULL) {
+            return NULL;
+        }
+    }
+
+    if (entry != NULL) {
+        server->free_entries = entry->free_next;
+    } else {
+        if (server->entry_count >= USB_MAX_CLIENTS) {
+            usb_send_queue_release(queue);
+            return NULL;
+        }
+
+        /* Keep the load factor at or below one entry per bucket */
+        if ((uint32_t)server->entry_count > server->bucket_mask) {
+            if (usb_server_grow_buckets(server) != 0) {
+                usb_send_queue_release(queue);
+                return NULL;
+            }
+        }
+
+        if (server->entry_count == server->entry_capacity) {
+            int capacity = server->entry_capacity * 2;
+            usb_client_entry_t** entries = (usb_client_entry_t**)realloc(
+                server->entries, (size_t)capacity * sizeof(*entries));
+            if (entries == NULL) {
+                usb_send_queue_release(queue);
+                return NULL;
+            }
+            server->entries = entries;
+            server->entry_capacity = capacity;
+        }
+
+        entry = (usb_client_entry_t*)calloc(1, sizeof(*entry));
+        if (entry == NULL) {
+            usb_send_queue_release(queue);
+            return NULL;
+        }
+        server->entries[server->entry_count++] = entry;
+    }
+
+    entry->socket_fd = socket_fd;
+    entry->device_id = device_id;
+    entry->device_class = 0;
+    entry->max_transfer_size = USB_MAX_DATA_SIZE;
+    entry->iso_bandwidth = 0;
+    entry->descriptors = NULL;
+    entry->in_use = FALSE;
+    entry->reserved = TRUE;
+    entry->authenticated = FALSE;
+    entry->auth_pending = FALSE;
+    memset(entry->pending_challenge, 0, USB_AUTH_CHALLENGE_SIZE);
+    entry->pending_seqnum = 0;
+    memset(entry->client_ip, 0, sizeof(entry->client_ip));
+    entry->send_queue = queue;
+    entry->device_next = NULL;
+    entry->free_next = NULL;
+
+    usb_server_index_socket(server, entry);
+    return entry;
+}
+
+/**
+ * @brief Tell the cluster the routable device_ids changed
+ */
+static void usb_server_devices_changed(usb_server_t* server)
+{
+    pthread_rwlock_rdlock(&server->relay_lock);
+    if (server->relay.devices_changed != NULL) {
+        server->relay.devices_changed(server->relay.ctx);
+    }
+    pthread_rwlock_unlock(&server->relay_lock);
+}
+
+/**
+ * @brief Make a reserved entry routable
+ */
+static void usb_server_activate_entry(usb_server_t* server,
+                                      usb_client_entry_t* entry)
+{
+    entry->in_use = TRUE;
+    usb_server_index_device(server, entry);
+    server->active_clients++;
+    usb_server_devices_changed(server);
+}
+
+/**
+ * @brief Unlink an entry from both indexes and return it to the free list
+ */
+static void usb_server_release_entry(usb_server_t* server,
+                                     usb_client_entry_t* entry)
+{
+    if (entry->in_use) {
+        usb_server_unindex_device(server, entry);
+        server->active_clients--;
+        usb_server_devices_changed(server);
+    }
+    if (entry->reserved) {
+        usb_server_unindex_socket(server, entry);
+    }
+
+    /* The last entry on a socket closes its queue */
+    usb_send_queue_release(entry->send_queue);
+    entry->send_queue = NULL;
+
+    server->iso_reserved -= entry->iso_bandwidth;
+    entry->iso_bandwidth = 0;
+
+    free(entry->descriptors);
+    entry->descriptors = NULL;
+
+    memset(entry->pending_challenge, 0, USB_AUTH_CHALLENGE_SIZE);
+    entry->socket_fd = -1;
+    entry->device_id = 0;
+    entry->max_transfer_size = USB_MAX_DATA_SIZE;
+    entry->in_use = FALSE;
+    entry->reserved = FALSE;
+    entry->authenticated = FALSE;
+    entry->auth_pending = FALSE;
+    entry->pending_seqnum = 0;
+
+    entry->free_next = server->free_entries;
+    server->free_entries = entry;
+}
+
+/**
+ * @brief Find a reserved entry on a socket
+ *
+ * @param server Server context (registry_lock held, shared or exclusive)
+ * @param socket_fd Client socket
+ * @param want_registered TRUE for a registered entry, FALSE for one
+ *                        awaiting an auth response
+ * @return Entry, or NULL if none
+ */
+static usb_client_entry_t* usb_server_find_socket(const usb_server_t* server,
+                                                  int socket_fd,
+                                                  int want_registered)
+{
+    usb_client_entry_t* entry;
+
+    entry = server->socket_buckets[usb_server_bucket(server, (uint32_t)socket_fd)];
+    for (; entry != NULL; entry = entry->socket_next) {
+        if (entry->socket_fd != socket_fd) {
+            continue;
+        }
+        if (want_registered ? entry->in_use : entry->auth_pending) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Find the entry a socket's authentication response answers
+ *
+ * A client may have several registrations awaiting their challenge at
+ * once; the response carries the seqnum of the one it answers.
+ *
+ * @param server Server context (registry_lock held, shared or exclusive)
+ * @param socket_fd Client socket
+ * @param seqnum Seqnum of the registration
+ * @return Entry, or NULL if none
+ */
+static usb_client_entry_t* usb_server_find_challenge(const usb_server_t* server,
+                                                     int socket_fd,
+                                                     uint32_t seqnum)
+{
+    usb_client_entry_t* entry;
+
+    entry = server->socket_buckets[usb_server_bucket(server, (uint32_t)socket_fd)];
+    for (; entry != NULL; entry = entry->socket_next) {
+        if (entry->socket_fd == socket_fd && entry->auth_pending &&
+            entry->pending_seqnum == seqnum) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
 /* ========================================================================
  * Server Lifecycle Functions
  * ======================================================================== */
@@ -35,29 +378,53 @@
 usb_server_t* usb_server_init(void)
 {
     usb_server_t* server = NULL;
-    int i = 0;
 
     /* Allocate server structure */
-    server = (usb_server_t*)malloc(sizeof(usb_server_t));
+    server = (usb_server_t*)calloc(1, sizeof(usb_server_t));
     if (server == NULL) {
         return NULL;
     }
 
-    /* Initialize client registry */
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        server->clients[i].socket_fd = -1;
-        server->clients[i].device_id = 0;
-        server->clients[i].device_class = 0;
-        server->clients[i].in_use = FALSE;
-        server->clients[i].authenticated = FALSE;
-        server->clients[i].auth_pending = FALSE;
-        memset(server->clients[i].pending_challenge, 0, USB_AUTH_CHALLENGE_SIZE);
-        memset(server->clients[i].client_ip, 0, sizeof(server->clients[i].client_ip));
-        pthread_mutex_init(&server->clients[i].send_lock, NULL);
-    }
+    /* Initialize client registry (grows on demand) */
+    server->entry_capacity = USB_INITIAL_CLIENTS;
+    server->entries = (usb_client_entry_t**)calloc(
+        (size_t)server->entry_capacity, sizeof(usb_client_entry_t*));
+    server->device_buckets = (usb_client_entry_t**)calloc(
+        USB_INITIAL_CLIENTS, sizeof(usb_client_entry_t*));
+    server->socket_buckets = (usb_client_entry_t**)calloc(
+        USB_INITIAL_CLIENTS, sizeof(usb_client_entry_t*));
+    server->bucket_mask = USB_INITIAL_CLIENTS - 1;
 
     /* Initialize locks */
-    pthread_mutex_init(&server->registry_lock, NULL);
+    if (server->entries == NULL || server->device_buckets == NULL ||
+        server->socket_buckets == NULL ||
+        pthread_rwlock_init(&server->registry_lock, NULL) != 0) {
+        free(server->entries);
+        free(server->device_buckets);
+        free(server->socket_buckets);
+        free(server);
+        return NULL;
+    }
+    if (pthread_rwlock_init(&server->relay_lock, NULL) != 0) {
+        pthread_rwlock_destroy(&server->registry_lock);
+        free(server->entries);
+        free(server->device_buckets);
+        free(server->socket_buckets);
+        free(server);
+        return NULL;
+    }
+
+    /* Start the writer that drains client send queues */
+    if (usb_send_writer_init(&server->send_writer) != 0) {
+        pthread_rwlock_destroy(&server->relay_lock);
+        pthread_rwlock_destroy(&server->registry_lock);
+        free(server->entries);
+        free(server->device_buckets);
+        free(server->socket_buckets);
+        free(server);
+        return NULL;
+    }
+    server->send_stall_ms = USB_SEND_STALL_MS;
 
     /* Initialize security configuration (auth disabled by default) */
     memset(server->auth_secret, 0, sizeof(server->auth_secret));
@@ -65,11 +432,16 @@ usb_server_t* usb_server_init(void)
     server->allowed_class_count = 0;
     server->require_auth = FALSE;
 
+    /* No isochronous budget until configured */
+    server->iso_budget = 0;
+    server->iso_reserved = 0;
+
     /* Initialize statistics */
     server->packets_routed = 0;
     server->routing_errors = 0;
     server->active_clients = 0;
     server->auth_failures = 0;
+    server->bandwidth_rejects = 0;
 
     return server;
 }
@@ -85,11 +457,24 @@ void usb_server_cleanup(usb_server_t* server)
         return;
     }
 
-    /* Destroy all mutexes */
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        pthread_mutex_destroy(&server->clients[i].send_lock);
+    /* Close every send queue, then stop the writer */
+    for (i = 0; i < server->entry_count; i++) {
+        usb_send_queue_release(server->entries[i]->send_queue);
+        server->entries[i]->send_queue = NULL;
     }
-    pthread_mutex_destroy(&server->registry_lock);
+    usb_send_writer_cleanup(&server->send_writer);
+
+    /* Destroy all entries */
+    for (i = 0; i < server->entry_count; i++) {
+        free(server->entries[i]->descriptors);
+        free(server->entries[i]);
+    }
+    free(server->entries);
+    free(server->device_buckets);
+    free(server->socket_buckets);
+    usb_auth_key_free(server->auth_key);
+    pthread_rwlock_destroy(&server->relay_lock);
+    pthread_rwlock_destroy(&server->registry_lock);
 
     /* Free server structure */
     free(server);
@@ -106,38 +491,30 @@ int usb_server_register_client(usb_server_t* server,
                                 int socket_fd,
                                 uint32_t device_id)
 {
-    int i;
-    int result = E_OUT_OF_MEMORY;
+    usb_client_entry_t* entry;
 
     if (server == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
-    pthread_mutex_lock(&server->registry_lock);
-
-    /* Find available slot */
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        if (!server->clients[i].in_use) {
-            server->clients[i].socket_fd = socket_fd;
-            server->clients[i].device_id = device_id;
-            server->clients[i].in_use = TRUE;
-            server->active_clients++;
-
-            printf("USB Server: Registered client socket=%d device_id=0x%08x\n",
-                   socket_fd, device_id);
+    pthread_rwlock_wrlock(&server->registry_lock);
 
-            result = 0;
-            break;
-        }
+    entry = usb_server_reserve_entry(server, socket_fd, device_id);
+    if (entry != NULL) {
+        usb_server_activate_entry(server, entry);
     }
 
-    pthread_mutex_unlock(&server->registry_lock);
+    pthread_rwlock_unlock(&server->registry_lock);
 
-    if (result != 0) {
+    if (entry == NULL) {
         fprintf(stderr, "USB Server: Client registry full\n");
+        return E_OUT_OF_MEMORY;
     }
 
-    return result;
+    printf("USB Server: Registered client socket=%d device_id=0x%08x\n",
+           socket_fd, device_id);
+
+    return 0;
 }
 
 /**
@@ -146,42 +523,209 @@ int usb_server_register_client(usb_server_t* server,
 int usb_server_unregister_client(usb_server_t* server,
                                   int socket_fd)
 {
-    int i;
-    int result = E_NOT_FOUND;
+    usb_client_entry_t* entry;
 
     if (server == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
-    pthread_mutex_lock(&server->registry_lock);
+    pthread_rwlock_wrlock(&server->registry_lock);
 
-    /* Find and remove client */
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        if (server->clients[i].in_use &&
-            server->clients[i].socket_fd == socket_fd) {
+    /* Find and remove client (or drop a registration still in auth) */
+    entry = usb_server_find_socket(server, socket_fd, TRUE);
+    if (entry == NULL) {
+        entry = usb_server_find_socket(server, socket_fd, FALSE);
+    }
+    if (entry != NULL) {
+        printf("USB Server: Unregistered client socket=%d device_id=0x%08x\n",
+               socket_fd, entry->device_id);
+        usb_server_release_entry(server, entry);
+    }
 
-            printf("USB Server: Unregistered client socket=%d device_id=0x%08x\n",
-                   socket_fd, server->clients[i].device_id);
+    pthread_rwlock_unlock(&server->registry_lock);
 
-            server->clients[i].socket_fd = -1;
-            server->clients[i].device_id = 0;
-            server->clients[i].in_use = FALSE;
-            server->active_clients--;
+    return (entry != NULL) ? 0 : E_NOT_FOUND;
+}
 
-            result = 0;
-            break;
-        }
+/**
+ * @brief Check whether a connection has a USB registration
+ */
+int usb_server_has_client(usb_server_t* server, int socket_fd)
+{
+    int found;
+
+    if (server == NULL) {
+        return FALSE;
     }
 
-    pthread_mutex_unlock(&server->registry_lock);
+    pthread_rwlock_rdlock(&server->registry_lock);
+    found = usb_server_find_socket(server, socket_fd, TRUE) != NULL ||
+            usb_server_find_socket(server, socket_fd, FALSE) != NULL;
+    pthread_rwlock_unlock(&server->registry_lock);
 
-    return result;
+    return found;
 }
 
 /* ========================================================================
  * URB Routing Functions
  * ======================================================================== */
 
+/**
+ * @brief Find the registration a URB for a device_id goes to
+ *
+ * @param server Server context (registry_lock held, shared or exclusive)
+ * @param device_id Target device
+ * @param sender_fd Socket of the sender (never its own target)
+ * @return Entry, or NULL if none
+ */
+static usb_client_entry_t* usb_server_find_device(const usb_server_t* server,
+                                                  uint32_t device_id,
+                                                  int sender_fd)
+{
+    usb_client_entry_t* target;
+
+    target = server->device_buckets[usb_server_bucket(server, device_id)];
+    for (; target != NULL; target = target->device_next) {
+        if (target->device_id == device_id &&
+            target->socket_fd != sender_fd) {
+            break;
+        }
+    }
+    return target;
+}
+
+/**
+ * @brief Count a URB no client, local or on another node, could take
+ */
+static void usb_server_no_route(usb_server_t* server, uint32_t device_id)
+{
+    LOG_WARN("USB Server: No route for device_id=0x%08x", device_id);
+    server->routing_errors++;
+    metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+}
+
+/**
+ * @brief Look up the route for a URB and take a reference to its queue
+ *
+ * The registry lock is held only for the lookup; the returned queue
+ * reference keeps it valid if the target unregisters meanwhile.
+ *
+ * @return Target's send queue (release after pushing), or NULL with
+ *         *error set (E_NOT_FOUND, not yet counted, if no local client
+ *         has the device)
+ */
+static usb_send_queue_t* usb_server_target_queue(usb_server_t* server,
+                                                 uint32_t device_id,
+                                                 uint32_t data_len,
+                                                 int sender_fd,
+                                                 int* error)
+{
+    usb_client_entry_t* target;
+    usb_send_queue_t* queue;
+    uint32_t target_max;
+    STAGE_PROF_VAR(start);
+
+    STAGE_PROF_START(start);
+    pthread_rwlock_rdlock(&server->registry_lock);
+
+    target = usb_server_find_device(server, device_id, sender_fd);
+    STAGE_PROF_STOP(STAGE_ROUTE_LOOKUP, start);
+
+    /* Check if target found */
+    if (target == NULL) {
+        pthread_rwlock_unlock(&server->registry_lock);
+        *error = E_NOT_FOUND;
+        return NULL;
+    }
+
+    /* Target only accepts URBs up to the size it negotiated */
+    target_max = target->max_transfer_size;
+    if (data_len > target_max) {
+        pthread_rwlock_unlock(&server->registry_lock);
+        LOG_WARN("USB Server: URB of %u bytes exceeds %u negotiated by "
+                 "device_id=0x%08x", data_len, target_max, device_id);
+        server->routing_errors++;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+        *error = E_BUFFER_TOO_SMALL;
+        return NULL;
+    }
+
+    queue = target->send_queue;
+    usb_send_queue_retain(queue);
+    pthread_rwlock_unlock(&server->registry_lock);
+
+    return queue;
+}
+
+/**
+ * @brief Queue a routed packet on the target's socket
+ *
+ * Consumes the packet payload and the queue reference.
+ */
+static int usb_server_queue_routed(usb_server_t* server,
+                                   usb_send_queue_t* queue,
+                                   xoe_packet_t* packet,
+                                   int relay)
+{
+    int result;
+
+    result = usb_send_queue_push(queue, packet, relay, server->send_stall_ms);
+    usb_send_queue_release(queue);
+
+    if (result != 0) {
+        /* Drops are counted by the writer; report only real failures */
+        if (result != E_WOULD_BLOCK) {
+            LOG_WARN("USB Server: Failed to queue packet: error %d",
+                    result);
+        }
+        server->routing_errors++;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+        return result;
+    }
+
+    /* Update statistics */
+    server->packets_routed++;
+    metrics_add(METRIC_USB_URBS_ROUTED, 1);
+
+    return 0;
+}
+
+/**
+ * @brief Offer a URB no local client can take to the cluster
+ *
+ * Consumes the packet payload.
+ */
+static int usb_server_route_remote(usb_server_t* server,
+                                   uint32_t device_id,
+                                   xoe_packet_t* packet,
+                                   int relay)
+{
+    int result = E_NOT_FOUND;
+
+    pthread_rwlock_rdlock(&server->relay_lock);
+    if (server->relay.forward != NULL) {
+        result = server->relay.forward(server->relay.ctx, device_id, packet,
+                                       relay);
+    }
+    pthread_rwlock_unlock(&server->relay_lock);
+    xoe_wire_free_payload(packet);
+
+    if (result == E_NOT_FOUND) {
+        usb_server_no_route(server, device_id);
+        return result;
+    }
+    if (result != 0) {
+        server->routing_errors++;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+        return result;
+    }
+
+    server->packets_routed++;
+    server->urbs_relayed++;
+    metrics_add(METRIC_USB_URBS_ROUTED, 1);
+    return 0;
+}
+
 /**
  * @brief Route URB to target client
  */
@@ -192,83 +736,185 @@ int usb_server_route_urb(usb_server_t* server,
                          int sender_fd)
 {
     xoe_packet_t packet;
-    int target_fd = -1;
-    int target_index = -1;
-    int i;
+    usb_send_queue_t* queue;
+    uint64_t start_ns;
     int result;
-    ssize_t sent;
 
     /* Validate parameters */
     if (server == NULL || urb_header == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
+    start_ns = latency_now_ns();
+
     /* Encapsulate URB into XOE packet */
     result = usb_protocol_encapsulate(urb_header, data, data_len, &packet);
     if (result != 0) {
         server->routing_errors++;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
         return result;
     }
 
-    /* Find target client based on device_id (USB-008 race fix) */
-    /* Acquire send_lock while holding registry_lock to prevent slot reuse */
-    pthread_mutex_lock(&server->registry_lock);
+    queue = usb_server_target_queue(server, urb_header->device_id, data_len,
+                                    sender_fd, &result);
+    if (queue == NULL && result == E_NOT_FOUND) {
+        return usb_server_route_remote(server, urb_header->device_id,
+                                       &packet, FALSE);
+    }
+    if (queue == NULL) {
+        usb_protocol_free_payload(&packet);
+        return result;
+    }
+
+    /* Written by the send writer in wire format (LIB-001/NET-006 fix) */
+    result = usb_server_queue_routed(server, queue, &packet, FALSE);
+    if (result == 0) {
+        latency_record_since(LATENCY_USB_ROUTE, start_ns);
+    }
+    return result;
+}
 
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        if (server->clients[i].in_use &&
-            server->clients[i].device_id == urb_header->device_id &&
-            server->clients[i].socket_fd != sender_fd) {
+/**
+ * @brief Forward a received URB frame to its target client unchanged
+ */
+int usb_server_forward_urb(usb_server_t* server,
+                           const usb_urb_header_t* urb_header,
+                           xoe_packet_t* packet,
+                           int sender_fd)
+{
+    usb_send_queue_t* queue;
+    uint64_t start_ns;
+    uint32_t data_len;
+    int result;
 
-            target_fd = server->clients[i].socket_fd;
-            target_index = i;
-            break;
-        }
+    /* Validate parameters */
+    if (server == NULL || urb_header == NULL || packet == NULL ||
+        packet->payload == NULL ||
+        packet->payload->len < USB_URB_HEADER_WIRE_SIZE) {
+        return E_INVALID_ARGUMENT;
     }
 
-    /* Check if target found */
-    if (target_fd < 0) {
-        pthread_mutex_unlock(&server->registry_lock);
-        fprintf(stderr, "USB Server: No route for device_id=0x%08x\n",
-                urb_header->device_id);
-        server->routing_errors++;
-        usb_protocol_free_payload(&packet);
-        return E_NOT_FOUND;
+    start_ns = latency_now_ns();
+
+    data_len = packet->payload->len - USB_URB_HEADER_WIRE_SIZE;
+
+    queue = usb_server_target_queue(server, urb_header->device_id, data_len,
+                                    sender_fd, &result);
+    if (queue == NULL && result == E_NOT_FOUND) {
+        return usb_server_route_remote(server, urb_header->device_id,
+                                       packet, TRUE);
+    }
+    if (queue == NULL) {
+        xoe_wire_free_payload(packet);
+        return result;
+    }
+
+    /* Relay the frame bytes as received: no copy, no CRC */
+    result = usb_server_queue_routed(server, queue, packet, TRUE);
+    if (result == 0) {
+        latency_record_since(LATENCY_USB_ROUTE, start_ns);
+    }
+    return result;
+}
+
+/**
+ * @brief Route a URB frame received from another node of a cluster
+ */
+int usb_server_deliver(usb_server_t* server, xoe_packet_t* packet)
+{
+    usb_urb_header_t urb_header;
+    usb_send_queue_t* queue;
+    uint32_t data_len;
+    int result;
+
+    if (server == NULL || packet == NULL || packet->payload == NULL) {
+        return E_INVALID_ARGUMENT;
     }
 
-    /* Lock send_lock while holding registry_lock (prevents race) */
-    pthread_mutex_lock(&server->clients[target_index].send_lock);
-    pthread_mutex_unlock(&server->registry_lock);
+    /* Only what route/forward hand to the relay crosses a link */
+    if (usb_protocol_decapsulate(packet, &urb_header, NULL, &data_len) != 0 ||
+        (urb_header.command != USB_CMD_SUBMIT &&
+         urb_header.command != USB_RET_SUBMIT &&
+         urb_header.command != USB_CMD_UNLINK &&
+         urb_header.command != USB_RET_UNLINK)) {
+        xoe_wire_free_payload(packet);
+        server->routing_errors++;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+        return E_PROTOCOL_ERROR;
+    }
 
-    /* Send packet to target client using wire format (LIB-001/NET-006 fix) */
-    result = xoe_wire_send(target_fd, &packet);
+    queue = usb_server_target_queue(server, urb_header.device_id, data_len,
+                                    -1, &result);
+    if (queue == NULL) {
+        xoe_wire_free_payload(packet);
+        if (result == E_NOT_FOUND) {
+            usb_server_no_route(server, urb_header.device_id);
+        }
+        return result;
+    }
 
-    pthread_mutex_unlock(&server->clients[target_index].send_lock);
+    return usb_server_queue_routed(server, queue, packet, TRUE);
+}
 
-    (void)sent;  /* Suppress unused warning */
+/**
+ * @brief Send a reply to the client on a socket
+ *
+ * Replies share the socket's send queue when it has one, so they never
+ * interleave with URBs the writer is streaming to the same client. A
+ * socket with no registry entry has nothing queued: its reply goes to
+ * the connection's own route when the frame came with one, and is only
+ * written directly (waiting for room) without.
+ *
+ * @param server Server context
+ * @param sender_fd Client socket
+ * @param reply Sender's reply route, or NULL
+ * @param queue Socket's queue if the caller holds its entry (and the
+ *              entry cannot be released meanwhile), or NULL to look it
+ *              up (registry_lock must not be held)
+ * @param response Reply packet (payload consumed)
+ * @return 0 on success, negative error code on failure
+ */
+static int usb_server_send_reply(usb_server_t* server,
+                                 int sender_fd,
+                                 const usb_server_reply_t* reply,
+                                 usb_send_queue_t* queue,
+                                 xoe_packet_t* response)
+{
+    int result;
 
-    if (result != 0) {
-        fprintf(stderr, "USB Server: Failed to route packet: error %d\n",
-                result);
-        server->routing_errors++;
-        usb_protocol_free_payload(&packet);  /* Free allocated payload */
-        return E_NETWORK_ERROR;
+    if (queue != NULL) {
+        usb_send_queue_retain(queue);
+    } else {
+        pthread_rwlock_rdlock(&server->registry_lock);
+        queue = usb_server_socket_queue(server, sender_fd);
+        if (queue != NULL) {
+            usb_send_queue_retain(queue);
+        }
+        pthread_rwlock_unlock(&server->registry_lock);
     }
 
-    /* Update statistics */
-    server->packets_routed++;
-
-    /* Free allocated payload after successful send */
-    usb_protocol_free_payload(&packet);
+    if (queue == NULL) {
+        result = (reply != NULL) ? reply->send(reply->arg, response)
+                                 : xoe_wire_send(sender_fd, response);
+        usb_protocol_free_payload(response);
+        return result;
+    }
 
-    return 0;
+    result = usb_send_queue_push(queue, response, FALSE, server->send_stall_ms);
+    usb_send_queue_release(queue);
+    return result;
 }
 
 /**
  * @brief Send authentication challenge to client
+ *
+ * Called with registry_lock held exclusive; releases the entry on failure.
+ * The nonce is drawn by the caller before it takes the lock.
  */
 static int usb_server_send_auth_challenge(usb_server_t* server,
                                            int sender_fd,
-                                           int client_index,
+                                           usb_client_entry_t* entry,
+                                           const uint8_t* challenge,
                                            uint32_t seqnum)
 {
     xoe_packet_t response;
@@ -276,46 +922,42 @@ static int usb_server_send_auth_challenge(usb_server_t* server,
     usb_auth_payload_t auth_payload;
     int result = 0;
 
-    /* Generate challenge */
-    result = usb_auth_generate_challenge(server->clients[client_index].pending_challenge);
-    if (result != 0) {
-        fprintf(stderr, "USB Server: Failed to generate auth challenge\n");
-        return result;
-    }
+    memcpy(entry->pending_challenge, challenge, USB_AUTH_CHALLENGE_SIZE);
 
-    /* Mark auth as pending */
-    server->clients[client_index].auth_pending = TRUE;
+    /* Mark auth as pending; the response names the registration's seqnum */
+    entry->auth_pending = TRUE;
+    entry->pending_seqnum = seqnum;
 
     /* Build auth challenge response */
     memset(&response_urb, 0, sizeof(response_urb));
     response_urb.command = USB_CMD_AUTH;
     response_urb.seqnum = seqnum;
-    response_urb.device_id = server->clients[client_index].device_id;
+    response_urb.device_id = entry->device_id;
     response_urb.status = E_USB_AUTH_REQUIRED;
 
     /* Build auth payload with challenge */
     memset(&auth_payload, 0, sizeof(auth_payload));
-    memcpy(auth_payload.challenge, server->clients[client_index].pending_challenge,
+    memcpy(auth_payload.challenge, entry->pending_challenge,
            USB_AUTH_CHALLENGE_SIZE);
-    auth_payload.device_id = server->clients[client_index].device_id;
-    auth_payload.device_class = server->clients[client_index].device_class;
+    auth_payload.device_id = entry->device_id;
+    auth_payload.device_class = entry->device_class;
 
     /* Encapsulate with auth payload */
     result = usb_protocol_encapsulate(&response_urb, &auth_payload,
                                        sizeof(auth_payload), &response);
     if (result != 0) {
         fprintf(stderr, "USB Server: Failed to encapsulate auth challenge\n");
-        server->clients[client_index].auth_pending = FALSE;
+        usb_server_release_entry(server, entry);
         return result;
     }
 
     /* Send challenge */
-    result = xoe_wire_send(sender_fd, &response);
-    usb_protocol_free_payload(&response);
+    result = usb_server_send_reply(server, sender_fd, NULL, entry->send_queue,
+                                   &response);
 
     if (result != 0) {
         fprintf(stderr, "USB Server: Failed to send auth challenge: error %d\n", result);
-        server->clients[client_index].auth_pending = FALSE;
+        usb_server_release_entry(server, entry);
         return E_NETWORK_ERROR;
     }
 
@@ -328,35 +970,41 @@ static int usb_server_send_auth_challenge(usb_server_t* server,
  */
 static int usb_server_complete_registration(usb_server_t* server,
                                              int sender_fd,
-                                             int client_index,
+                                             usb_client_entry_t* entry,
                                              uint32_t seqnum)
 {
     xoe_packet_t response;
     usb_urb_header_t response_urb;
     int result = 0;
 
-    /* Mark as authenticated and registered */
-    server->clients[client_index].authenticated = TRUE;
-    server->clients[client_index].auth_pending = FALSE;
-    server->clients[client_index].in_use = TRUE;
-    server->active_clients++;
+    /* Mark as authenticated and registered (now routable) */
+    pthread_rwlock_wrlock(&server->registry_lock);
+    entry->authenticated = TRUE;
+    entry->auth_pending = FALSE;
+    usb_server_activate_entry(server, entry);
+    pthread_rwlock_unlock(&server->registry_lock);
 
     /* Log success */
-    usb_auth_log_event(server->clients[client_index].client_ip,
-                       server->clients[client_index].device_id,
-                       server->clients[client_index].device_class,
+    usb_auth_log_event(entry->client_ip,
+                       entry->device_id,
+                       entry->device_class,
                        1, NULL);
 
-    printf("USB Server: Registered client socket=%d device_id=0x%08x class=0x%02x\n",
-           sender_fd, server->clients[client_index].device_id,
-           server->clients[client_index].device_class);
+    printf("USB Server: Registered client socket=%d device_id=0x%08x class=0x%02x "
+           "urb=%u\n",
+           sender_fd, entry->device_id,
+           entry->device_class,
+           entry->max_transfer_size);
 
     /* Build success response */
     memset(&response_urb, 0, sizeof(response_urb));
     response_urb.command = USB_RET_REGISTER;
     response_urb.seqnum = seqnum;
-    response_urb.device_id = server->clients[client_index].device_id;
+    response_urb.device_id = entry->device_id;
     response_urb.status = 0;
+    response_urb.transfer_length = entry->max_transfer_size;
+    /* We unpack USB_CMD_BATCH and honour USB_CMD_CREDIT */
+    response_urb.flags = USB_FLAG_BATCH | USB_FLAG_CREDIT;
 
     /* Encapsulate response */
     result = usb_protocol_encapsulate(&response_urb, NULL, 0, &response);
@@ -366,8 +1014,8 @@ static int usb_server_complete_registration(usb_server_t* server,
     }
 
     /* Send response */
-    result = xoe_wire_send(sender_fd, &response);
-    usb_protocol_free_payload(&response);
+    result = usb_server_send_reply(server, sender_fd, NULL, entry->send_queue,
+                                   &response);
 
     if (result != 0) {
         fprintf(stderr, "USB Server: Failed to send registration response: error %d\n",
@@ -381,7 +1029,9 @@ static int usb_server_complete_registration(usb_server_t* server,
 /**
  * @brief Send registration failure response
  */
-static int usb_server_send_register_failure(int sender_fd,
+static int usb_server_send_register_failure(usb_server_t* server,
+                                             int sender_fd,
+                                             const usb_server_reply_t* reply,
                                              uint32_t seqnum,
                                              uint32_t device_id,
                                              int error_code)
@@ -401,10 +1051,7 @@ static int usb_server_send_register_failure(int sender_fd,
         return result;
     }
 
-    result = xoe_wire_send(sender_fd, &response);
-    usb_protocol_free_payload(&response);
-
-    return result;
+    return usb_server_send_reply(server, sender_fd, reply, NULL, &response);
 }
 
 /**
@@ -412,11 +1059,17 @@ static int usb_server_send_register_failure(int sender_fd,
  */
 static int usb_server_handle_register(usb_server_t* server,
                                        const usb_urb_header_t* urb_header,
-                                       int sender_fd)
+                                       const void* data,
+                                       uint32_t data_len,
+                                       int sender_fd,
+                                       const usb_server_reply_t* reply)
 {
-    int i = 0;
-    int slot = -1;
+    usb_client_entry_t* entry;
+    usb_desc_cache_t* descriptors = NULL;
+    uint8_t challenge[USB_AUTH_CHALLENGE_SIZE];
+    int challenge_ready = FALSE;
     uint8_t device_class = 0;
+    uint32_t iso_bandwidth;
     char client_ip[46];
 
     /* Extract device class from endpoint field (protocol convention) */
@@ -425,13 +1078,39 @@ static int usb_server_handle_register(usb_server_t* server,
     /* Get client IP for logging */
     usb_server_get_client_ip(sender_fd, client_ip, sizeof(client_ip));
 
-    pthread_mutex_lock(&server->registry_lock);
+    /* Cached descriptors are optional: bad ones only cost the cache */
+    if (data_len > 0) {
+        descriptors = (usb_desc_cache_t*)malloc(sizeof(*descriptors));
+        if (descriptors != NULL &&
+            usb_desc_cache_parse(descriptors, (const uint8_t*)data,
+                                 data_len) != 0) {
+            LOG_WARN("USB Server: Ignoring malformed descriptors from "
+                     "device_id=0x%08x", urb_header->device_id);
+            free(descriptors);
+            descriptors = NULL;
+        }
+    }
+
+    /* Draw the nonce before taking the registry exclusively */
+    if (server->require_auth) {
+        if (usb_auth_generate_challenge(challenge) != 0) {
+            fprintf(stderr, "USB Server: Failed to generate auth challenge\n");
+            free(descriptors);
+            return usb_server_send_register_failure(server, sender_fd, reply,
+                                                     urb_header->seqnum,
+                                                     urb_header->device_id,
+                                                     E_UNKNOWN_ERROR);
+        }
+        challenge_ready = TRUE;
+    }
+
+    pthread_rwlock_wrlock(&server->registry_lock);
 
     /* Check device class whitelist first */
     if (!usb_auth_check_class_whitelist(device_class,
                                          server->allowed_classes,
                                          server->allowed_class_count)) {
-        pthread_mutex_unlock(&server->registry_lock);
+        pthread_rwlock_unlock(&server->registry_lock);
 
         /* Log rejection */
         usb_auth_log_event(client_ip, urb_header->device_id, device_class,
@@ -440,49 +1119,82 @@ static int usb_server_handle_register(usb_server_t* server,
 
         fprintf(stderr, "USB Server: Device class 0x%02x blocked for socket=%d\n",
                 device_class, sender_fd);
+        free(descriptors);
 
-        return usb_server_send_register_failure(sender_fd, urb_header->seqnum,
+        return usb_server_send_register_failure(server, sender_fd, reply,
+                                                 urb_header->seqnum,
                                                  urb_header->device_id,
                                                  E_USB_CLASS_BLOCKED);
     }
 
-    /* Find available slot */
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        if (!server->clients[i].in_use && !server->clients[i].auth_pending) {
-            slot = i;
-            break;
-        }
+    /* Isochronous streams must fit the remaining budget */
+    iso_bandwidth = urb_header->actual_length;
+    if (iso_bandwidth > 0 && server->iso_budget > 0 &&
+        server->iso_reserved + iso_bandwidth > server->iso_budget) {
+        server->bandwidth_rejects++;
+        pthread_rwlock_unlock(&server->registry_lock);
+
+        usb_auth_log_event(client_ip, urb_header->device_id, device_class,
+                           0, "isochronous bandwidth exhausted");
+
+        fprintf(stderr, "USB Server: No bandwidth for device_id=0x%08x "
+                "(%u B/s requested, %llu of %u B/s reserved)\n",
+                urb_header->device_id, iso_bandwidth,
+                (unsigned long long)server->iso_reserved, server->iso_budget);
+        free(descriptors);
+
+        return usb_server_send_register_failure(server, sender_fd, reply,
+                                                 urb_header->seqnum,
+                                                 urb_header->device_id,
+                                                 E_USB_NO_BANDWIDTH);
     }
 
-    if (slot < 0) {
-        pthread_mutex_unlock(&server->registry_lock);
+    /* Reserve an entry (reused or newly allocated) */
+    entry = usb_server_reserve_entry(server, sender_fd, urb_header->device_id);
+    if (entry == NULL) {
+        pthread_rwlock_unlock(&server->registry_lock);
         fprintf(stderr, "USB Server: Client registry full\n");
-        return usb_server_send_register_failure(sender_fd, urb_header->seqnum,
+        free(descriptors);
+        return usb_server_send_register_failure(server, sender_fd, reply,
+                                                 urb_header->seqnum,
                                                  urb_header->device_id,
                                                  E_OUT_OF_MEMORY);
     }
 
-    /* Initialize slot */
-    server->clients[slot].socket_fd = sender_fd;
-    server->clients[slot].device_id = urb_header->device_id;
-    server->clients[slot].device_class = device_class;
-    server->clients[slot].authenticated = FALSE;
-    server->clients[slot].auth_pending = FALSE;
-    strncpy(server->clients[slot].client_ip, client_ip,
-            sizeof(server->clients[slot].client_ip) - 1);
+    /* Initialize entry */
+    entry->device_class = device_class;
+    entry->max_transfer_size = usb_protocol_negotiate_urb_size(
+        urb_header->transfer_length, USB_MAX_LARGE_DATA_SIZE);
+    entry->iso_bandwidth = iso_bandwidth;
+    server->iso_reserved += iso_bandwidth;
+    entry->descriptors = descriptors;
+    snprintf(entry->client_ip, sizeof(entry->client_ip), "%s", client_ip);
 
     /* Check if authentication is required */
     if (server->require_auth && server->auth_secret[0] != '\0') {
+        int result = 0;
+
+        /* Auth turned on since the nonce was skipped: draw it now */
+        if (!challenge_ready) {
+            result = usb_auth_generate_challenge(challenge);
+        }
+
         /* Send auth challenge */
-        int result = usb_server_send_auth_challenge(server, sender_fd, slot,
-                                                     urb_header->seqnum);
-        pthread_mutex_unlock(&server->registry_lock);
+        if (result == 0) {
+            result = usb_server_send_auth_challenge(server, sender_fd, entry,
+                                                    challenge,
+                                                    urb_header->seqnum);
+        } else {
+            fprintf(stderr, "USB Server: Failed to generate auth challenge\n");
+            usb_server_release_entry(server, entry);
+        }
+        pthread_rwlock_unlock(&server->registry_lock);
         return result;
     }
 
     /* No auth required, complete registration */
-    pthread_mutex_unlock(&server->registry_lock);
-    return usb_server_complete_registration(server, sender_fd, slot,
+    pthread_rwlock_unlock(&server->registry_lock);
+    return usb_server_complete_registration(server, sender_fd, entry,
                                              urb_header->seqnum);
 }
 
@@ -493,10 +1205,10 @@ static int usb_server_handle_auth_response(usb_server_t* server,
                                             const usb_urb_header_t* urb_header,
                                             const void* data,
                                             uint32_t data_len,
-                                            int sender_fd)
+                                            int sender_fd,
+                                            const usb_server_reply_t* reply)
 {
-    int i = 0;
-    int slot = -1;
+    usb_client_entry_t* entry;
     usb_auth_payload_t auth_payload;
     int verify_result = 0;
 
@@ -508,59 +1220,65 @@ static int usb_server_handle_auth_response(usb_server_t* server,
 
     memcpy(&auth_payload, data, sizeof(auth_payload));
 
-    pthread_mutex_lock(&server->registry_lock);
-
-    /* Find client slot with pending auth */
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        if (server->clients[i].socket_fd == sender_fd &&
-            server->clients[i].auth_pending) {
-            slot = i;
-            break;
-        }
-    }
+    /* Verify under the shared lock: routing carries on meanwhile, and
+     * neither the entry nor the key can change */
+    pthread_rwlock_rdlock(&server->registry_lock);
 
-    if (slot < 0) {
-        pthread_mutex_unlock(&server->registry_lock);
+    /* Find the registration the response answers */
+    entry = usb_server_find_challenge(server, sender_fd, urb_header->seqnum);
+    if (entry == NULL) {
+        pthread_rwlock_unlock(&server->registry_lock);
         fprintf(stderr, "USB Server: Auth response from unregistered client\n");
         return E_INVALID_STATE;
     }
 
-    /* Verify the response */
-    verify_result = usb_auth_verify_response(
-        server->auth_secret,
-        server->clients[slot].pending_challenge,
-        server->clients[slot].device_id,
-        server->clients[slot].device_class,
+    /* Verify the response (copy of the keyed HMAC, no rekey) */
+    verify_result = usb_auth_key_verify(
+        server->auth_key,
+        entry->pending_challenge,
+        entry->device_id,
+        entry->device_class,
         auth_payload.response
     );
 
+    pthread_rwlock_unlock(&server->registry_lock);
+    pthread_rwlock_wrlock(&server->registry_lock);
+
+    /* Gone while unlocked (the socket was unregistered) */
+    if (usb_server_find_challenge(server, sender_fd,
+                                  urb_header->seqnum) != entry) {
+        pthread_rwlock_unlock(&server->registry_lock);
+        fprintf(stderr, "USB Server: Auth response from unregistered client\n");
+        return E_INVALID_STATE;
+    }
+
     if (verify_result != 1) {
         /* Auth failed */
-        server->clients[slot].auth_pending = FALSE;
-        server->clients[slot].socket_fd = -1;
         server->auth_failures++;
 
-        usb_auth_log_event(server->clients[slot].client_ip,
-                           server->clients[slot].device_id,
-                           server->clients[slot].device_class,
+        usb_auth_log_event(entry->client_ip,
+                           entry->device_id,
+                           entry->device_class,
                            0, "invalid auth response");
 
-        pthread_mutex_unlock(&server->registry_lock);
+        usb_server_release_entry(server, entry);
+        pthread_rwlock_unlock(&server->registry_lock);
 
         fprintf(stderr, "USB Server: Auth verification failed for socket=%d\n",
                 sender_fd);
 
-        return usb_server_send_register_failure(sender_fd, urb_header->seqnum,
+        return usb_server_send_register_failure(server, sender_fd, reply,
+                                                 urb_header->seqnum,
                                                  urb_header->device_id,
                                                  E_USB_AUTH_FAILED);
     }
 
     /* Clear challenge from memory */
-    memset(server->clients[slot].pending_challenge, 0, USB_AUTH_CHALLENGE_SIZE);
+    memset(entry->pending_challenge, 0, USB_AUTH_CHALLENGE_SIZE);
 
     /* Complete registration */
-    pthread_mutex_unlock(&server->registry_lock);
-    return usb_server_complete_registration(server, sender_fd, slot,
+    pthread_rwlock_unlock(&server->registry_lock);
+    return usb_server_complete_registration(server, sender_fd, entry,
                                              urb_header->seqnum);
 }
 
@@ -569,12 +1287,12 @@ static int usb_server_handle_auth_response(usb_server_t* server,
  */
 static int usb_server_handle_unregister(usb_server_t* server,
                                          const usb_urb_header_t* urb_header,
-                                         int sender_fd)
+                                         int sender_fd,
+                                         const usb_server_reply_t* reply)
 {
     xoe_packet_t response;
     usb_urb_header_t response_urb;
     int result;
-    ssize_t sent;
 
     /* Unregister client */
     result = usb_server_unregister_client(server, sender_fd);
@@ -594,76 +1312,417 @@ static int usb_server_handle_unregister(usb_server_t* server,
     }
 
     /* Send response back to client using wire format (LIB-001/NET-006 fix) */
-    result = xoe_wire_send(sender_fd, &response);
+    result = usb_server_send_reply(server, sender_fd, reply, NULL, &response);
     if (result != 0) {
         fprintf(stderr, "USB Server: Failed to send unregistration response: error %d\n",
                 result);
-        usb_protocol_free_payload(&response);  /* Free allocated payload */
         return E_NETWORK_ERROR;
     }
-    (void)sent;  /* Suppress unused warning */
 
-    /* Free allocated payload after successful send */
-    usb_protocol_free_payload(&response);
+    return 0;
+}
+
+/**
+ * @brief Copy cached descriptor data of the device a request is for
+ *
+ * With @p setup, the reply to that GET_DESCRIPTOR request; without, the
+ * whole cache in wire form (USB_RET_ENUM).
+ *
+ * @param data Output (USB_DESC_CACHE_MAX_SIZE bytes)
+ * @param length Receives the bytes copied
+ * @return 0 on success, E_NOT_FOUND if the target sent no such data
+ */
+static int usb_server_copy_descriptors(usb_server_t* server,
+                                       uint32_t device_id,
+                                       const uint8_t* setup,
+                                       int sender_fd,
+                                       uint8_t* data,
+                                       uint32_t* length)
+{
+    usb_client_entry_t* target;
+    const uint8_t* desc = NULL;
+    int result = E_NOT_FOUND;
+
+    pthread_rwlock_rdlock(&server->registry_lock);
+
+    target = usb_server_find_device(server, device_id, sender_fd);
+    if (target != NULL && target->descriptors != NULL) {
+        if (setup != NULL) {
+            result = usb_desc_cache_answer(target->descriptors, setup,
+                                           &desc, length);
+        } else if (target->descriptors->size > 0) {
+            desc = target->descriptors->data;
+            *length = target->descriptors->size;
+            result = 0;
+        }
+        if (result == 0) {
+            memcpy(data, desc, *length);
+        }
+    }
+
+    pthread_rwlock_unlock(&server->registry_lock);
+
+    return result;
+}
+
+/**
+ * @brief Answer a GET_DESCRIPTOR control URB from the target's cache
+ *
+ * @return 0 if answered, E_NOT_FOUND if it must go to the device, or a
+ *         send error
+ */
+static int usb_server_answer_descriptor(usb_server_t* server,
+                                        const usb_urb_header_t* urb_header,
+                                        int sender_fd,
+                                        const usb_server_reply_t* reply)
+{
+    xoe_packet_t response;
+    usb_urb_header_t response_urb;
+    uint8_t data[USB_DESC_CACHE_MAX_SIZE];
+    uint32_t length = 0;
+    int result;
+
+    result = usb_server_copy_descriptors(server, urb_header->device_id,
+                                         urb_header->setup, sender_fd,
+                                         data, &length);
+    if (result != 0) {
+        return result;
+    }
+
+    /* Completed as the device would have completed it */
+    response_urb = *urb_header;
+    response_urb.command = USB_RET_SUBMIT;
+    response_urb.actual_length = length;
+    response_urb.status = 0;
+
+    result = usb_protocol_encapsulate(&response_urb, data, length, &response);
+    if (result != 0) {
+        return result;
+    }
+
+    result = usb_server_send_reply(server, sender_fd, reply, NULL, &response);
+    if (result != 0) {
+        LOG_WARN("USB Server: Failed to send cached descriptor: error %d",
+                 result);
+        return result;
+    }
 
+    server->descriptor_hits++;
+    metrics_add(METRIC_USB_DESCRIPTOR_HITS, 1);
     return 0;
 }
 
 /**
- * @brief Handle incoming URB from client
+ * @brief Handle OUT credit from the client that owns a device
+ *
+ * Credit gates the frames queued to the sender's own socket, so a client
+ * can only throttle the traffic it receives. There is no reply.
  */
-int usb_server_handle_urb(usb_server_t* server,
-                          const xoe_packet_t* packet,
-                          int sender_fd)
+static int usb_server_handle_credit(usb_server_t* server,
+                                    const usb_urb_header_t* urb_header,
+                                    int sender_fd)
+{
+    usb_send_queue_t* queue;
+    int result;
+
+    pthread_rwlock_rdlock(&server->registry_lock);
+    queue = usb_server_socket_queue(server, sender_fd);
+    if (queue != NULL) {
+        usb_send_queue_retain(queue);
+    }
+    pthread_rwlock_unlock(&server->registry_lock);
+
+    if (queue == NULL) {
+        return E_NOT_FOUND;
+    }
+
+    result = usb_send_queue_credit(queue, urb_header->device_id,
+                                   urb_header->endpoint,
+                                   urb_header->transfer_length,
+                                   (urb_header->flags & USB_FLAG_WINDOW) != 0);
+    usb_send_queue_release(queue);
+
+    if (result == E_BUFFER_TOO_SMALL) {
+        LOG_WARN("USB Server: No room to track credit of endpoint 0x%02x "
+                 "of device_id=0x%08x; it stays unlimited",
+                 urb_header->endpoint, urb_header->device_id);
+    }
+    return result;
+}
+
+/**
+ * @brief Handle a device enumeration request
+ */
+static int usb_server_handle_enum(usb_server_t* server,
+                                  const usb_urb_header_t* urb_header,
+                                  int sender_fd,
+                                  const usb_server_reply_t* reply)
+{
+    xoe_packet_t response;
+    usb_urb_header_t response_urb;
+    uint8_t data[USB_DESC_CACHE_MAX_SIZE];
+    uint32_t length = 0;
+    int status;
+    int result;
+
+    status = usb_server_copy_descriptors(server, urb_header->device_id, NULL,
+                                         sender_fd, data, &length);
+
+    memset(&response_urb, 0, sizeof(response_urb));
+    response_urb.command = USB_RET_ENUM;
+    response_urb.seqnum = urb_header->seqnum;
+    response_urb.device_id = urb_header->device_id;
+    response_urb.transfer_length = length;
+    response_urb.actual_length = length;
+    response_urb.status = status;
+
+    result = usb_protocol_encapsulate(&response_urb, data, length, &response);
+    if (result != 0) {
+        return result;
+    }
+
+    result = usb_server_send_reply(server, sender_fd, reply, NULL, &response);
+    if (result != 0) {
+        fprintf(stderr, "USB Server: Failed to send enumeration response: "
+                "error %d\n", result);
+        return E_NETWORK_ERROR;
+    }
+
+    if (status == 0) {
+        server->descriptor_hits++;
+        metrics_add(METRIC_USB_DESCRIPTOR_HITS, 1);
+    }
+    return 0;
+}
+
+/**
+ * @brief Handle one URB, copying its data out of the frame
+ *
+ * Everything but the zero-copy relay of usb_server_handle_urb() and the
+ * unpacking of batches; the frame's payload is left to the caller.
+ */
+static int usb_server_dispatch_urb(usb_server_t* server,
+                                   const xoe_packet_t* packet,
+                                   int sender_fd,
+                                   const usb_server_reply_t* reply)
 {
     usb_urb_header_t urb_header;
-    unsigned char data_buffer[USB_MAX_TRANSFER_SIZE];
+    unsigned char stack_buffer[USB_MAX_TRANSFER_SIZE];
+    unsigned char* data_buffer = stack_buffer;
     uint32_t data_len;
     int result;
 
-    /* Validate parameters */
-    if (server == NULL || packet == NULL) {
-        return E_INVALID_ARGUMENT;
+    /* Large URBs (negotiated) do not fit the stack buffer */
+    data_len = sizeof(stack_buffer);
+    if (packet->payload != NULL &&
+        packet->payload->len > USB_URB_HEADER_WIRE_SIZE + sizeof(stack_buffer) &&
+        packet->payload->len <= USB_MAX_LARGE_PAYLOAD_SIZE) {
+        data_len = (uint32_t)packet->payload->len - USB_URB_HEADER_WIRE_SIZE;
+        data_buffer = (unsigned char*)malloc(data_len);
+        if (data_buffer == NULL) {
+            server->routing_errors++;
+            metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+            return E_OUT_OF_MEMORY;
+        }
     }
 
     /* Decapsulate XOE packet */
-    data_len = sizeof(data_buffer);
     result = usb_protocol_decapsulate(packet, &urb_header,
                                       data_buffer, &data_len);
     if (result != 0) {
-        fprintf(stderr, "USB Server: Failed to decapsulate URB: error %d\n",
+        LOG_WARN("USB Server: Failed to decapsulate URB: error %d",
                 result);
         server->routing_errors++;
-        return result;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+        goto done;
     }
 
     /* Handle command based on type */
     switch (urb_header.command) {
         case USB_CMD_REGISTER:
-            return usb_server_handle_register(server, &urb_header, sender_fd);
+            result = usb_server_handle_register(server, &urb_header,
+                                                data_buffer, data_len,
+                                                sender_fd, reply);
+            break;
 
         case USB_RET_AUTH:
-            return usb_server_handle_auth_response(server, &urb_header,
-                                                    data_buffer, data_len,
-                                                    sender_fd);
+            result = usb_server_handle_auth_response(server, &urb_header,
+                                                     data_buffer, data_len,
+                                                     sender_fd, reply);
+            break;
 
         case USB_CMD_UNREGISTER:
-            return usb_server_handle_unregister(server, &urb_header, sender_fd);
+            result = usb_server_handle_unregister(server, &urb_header, sender_fd, reply);
+            break;
+
+        case USB_CMD_ENUM:
+            result = usb_server_handle_enum(server, &urb_header, sender_fd, reply);
+            break;
+
+        case USB_CMD_CREDIT:
+            result = usb_server_handle_credit(server, &urb_header, sender_fd);
+            break;
 
         case USB_CMD_SUBMIT:
         case USB_RET_SUBMIT:
+            /* Descriptor reads the target's cache holds never leave the server */
+            if (urb_header.command == USB_CMD_SUBMIT &&
+                urb_header.transfer_type == USB_TRANSFER_CONTROL) {
+                result = usb_server_answer_descriptor(server, &urb_header,
+                                                      sender_fd, reply);
+                if (result != E_NOT_FOUND) {
+                    break;
+                }
+            }
+
+            /* actual_length describes the data carried in this frame */
+            if (urb_header.actual_length > data_len) {
+                LOG_WARN("USB Server: URB actual_length %u exceeds "
+                         "payload of %u bytes",
+                        urb_header.actual_length, data_len);
+                server->routing_errors++;
+                metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+                result = E_PROTOCOL_ERROR;
+                break;
+            }
+
             /* Route URB to target client */
             result = usb_server_route_urb(server, &urb_header,
                                           data_buffer, urb_header.actual_length,
                                           sender_fd);
-            return result;
+            break;
+
+        case USB_CMD_UNLINK:
+        case USB_RET_UNLINK:
+            /* Header only; the device side answers the cancellation */
+            result = usb_server_route_urb(server, &urb_header, NULL, 0,
+                                          sender_fd);
+            break;
 
         default:
-            fprintf(stderr, "USB Server: Unknown command type: 0x%04x\n",
+            LOG_WARN("USB Server: Unknown command type: 0x%04x",
                     urb_header.command);
             server->routing_errors++;
-            return E_INVALID_ARGUMENT;
+            metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+            result = E_INVALID_ARGUMENT;
+            break;
+    }
+
+done:
+    if (data_buffer != stack_buffer) {
+        free(data_buffer);
+    }
+    return result;
+}
+
+/**
+ * @brief Handle the URBs of a USB_CMD_BATCH in order
+ *
+ * The batch is checked whole before any of its URBs is handled, so a
+ * malformed one is dropped entirely. A URB that fails does not stop the
+ * ones after it; the last failure is returned.
+ */
+static int usb_server_handle_batch(usb_server_t* server,
+                                   const xoe_packet_t* packet,
+                                   const usb_urb_header_t* batch_header,
+                                   int sender_fd,
+                                   const usb_server_reply_t* reply)
+{
+    const uint8_t* data;
+    const uint8_t* urb;
+    xoe_payload_t entry_payload;
+    xoe_packet_t entry;
+    uint32_t size;
+    uint32_t offset = 0;
+    uint32_t urb_len;
+    int count = 0;
+    int result;
+    int failure = 0;
+
+    data = (const uint8_t*)packet->payload->data + USB_URB_HEADER_WIRE_SIZE;
+    size = (uint32_t)packet->payload->len - USB_URB_HEADER_WIRE_SIZE;
+
+    while ((result = usb_protocol_batch_next(data, size, &offset,
+                                             &urb, &urb_len)) == 0) {
+        count++;
+    }
+    if (result != E_NOT_FOUND || count != batch_header->number_of_packets) {
+        LOG_WARN("USB Server: Malformed batch from socket %d (%d of %u URBs)",
+                sender_fd, count, batch_header->number_of_packets);
+        server->routing_errors++;
+        metrics_add(METRIC_USB_ROUTING_ERRORS, 1);
+        return E_PROTOCOL_ERROR;
+    }
+
+    server->batches_received++;
+    server->batched_urbs += (unsigned long)count;
+    metrics_add(METRIC_USB_BATCHED_URBS, (uint64_t)count);
+
+    /* Each entry is a complete URB frame payload; view it in place */
+    entry.protocol_id = packet->protocol_id;
+    entry.protocol_version = packet->protocol_version;
+    entry.payload = &entry_payload;
+    entry.checksum = 0;
+    entry_payload.owns_data = FALSE;
+
+    offset = 0;
+    while (usb_protocol_batch_next(data, size, &offset, &urb, &urb_len) == 0) {
+        entry_payload.data = (void*)urb;
+        entry_payload.len = urb_len;
+
+        result = usb_server_dispatch_urb(server, &entry, sender_fd, reply);
+        if (result != 0) {
+            failure = result;
+        }
+    }
+
+    return failure;
+}
+
+/**
+ * @brief Handle incoming URB from client
+ */
+int usb_server_handle_urb(usb_server_t* server,
+                          xoe_packet_t* packet,
+                          int sender_fd)
+{
+    return usb_server_handle_urb_from(server, packet, sender_fd, NULL);
+}
+
+/**
+ * @brief Handle incoming URB from client, replies without a queue routed
+ */
+int usb_server_handle_urb_from(usb_server_t* server,
+                               xoe_packet_t* packet,
+                               int sender_fd,
+                               const usb_server_reply_t* reply)
+{
+    usb_urb_header_t urb_header;
+    uint32_t data_len;
+
+    /* Validate parameters */
+    if (server == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (usb_protocol_decapsulate(packet, &urb_header, NULL, &data_len) == 0) {
+        if (urb_header.command == USB_CMD_BATCH) {
+            return usb_server_handle_batch(server, packet, &urb_header,
+                                           sender_fd, reply);
+        }
+
+        /* Fast path: a data URB that fills its frame is relayed unchanged
+         * (control requests may be answered from the descriptor cache) */
+        if ((urb_header.command == USB_RET_SUBMIT ||
+             (urb_header.command == USB_CMD_SUBMIT &&
+              urb_header.transfer_type != USB_TRANSFER_CONTROL)) &&
+            urb_header.actual_length == data_len) {
+            return usb_server_forward_urb(server, &urb_header, packet,
+                                          sender_fd);
+        }
     }
+
+    return usb_server_dispatch_urb(server, packet, sender_fd, reply);
 }
 
 /* ========================================================================
@@ -688,26 +1747,104 @@ void usb_server_print_stats(const usb_server_t* server)
     printf("Packets routed:   %lu\n", server->packets_routed);
     printf("Routing errors:   %lu\n", server->routing_errors);
     printf("Auth failures:    %lu\n", server->auth_failures);
+    printf("Descriptor hits:  %lu\n", server->descriptor_hits);
+    printf("Batches:          %lu (%lu URBs)\n", server->batches_received,
+           server->batched_urbs);
+    printf("Relayed to nodes: %lu\n", server->urbs_relayed);
+    printf("Frames sent:      %lu\n", server->send_writer.frames_sent);
+    printf("Send stalls:      %lu (up to %u ms)\n",
+           server->send_writer.frames_stalled, server->send_stall_ms);
+    printf("Send drops:       %lu\n", server->send_writer.frames_dropped);
+    printf("Send failures:    %lu\n", server->send_writer.queue_failures);
     printf("Auth required:    %s\n", server->require_auth ? "yes" : "no");
     printf("Class whitelist:  %d entries\n", server->allowed_class_count);
+    if (server->iso_budget > 0) {
+        printf("Iso bandwidth:    %llu of %u B/s reserved (%lu refused)\n",
+               (unsigned long long)server->iso_reserved, server->iso_budget,
+               server->bandwidth_rejects);
+    } else {
+        printf("Iso bandwidth:    %llu B/s reserved (no budget)\n",
+               (unsigned long long)server->iso_reserved);
+    }
     printf("\n");
     printf("Registered Devices:\n");
 
-    pthread_mutex_lock((pthread_mutex_t*)&server->registry_lock);
+    pthread_rwlock_rdlock((pthread_rwlock_t*)&server->registry_lock);
 
-    for (i = 0; i < USB_MAX_CLIENTS; i++) {
-        if (server->clients[i].in_use) {
+    for (i = 0; i < server->entry_count; i++) {
+        if (server->entries[i]->in_use) {
             printf("  [%d] socket=%d device_id=0x%08x\n",
-                   i, server->clients[i].socket_fd,
-                   server->clients[i].device_id);
+                   i, server->entries[i]->socket_fd,
+                   server->entries[i]->device_id);
         }
     }
 
-    pthread_mutex_unlock((pthread_mutex_t*)&server->registry_lock);
+    pthread_rwlock_unlock((pthread_rwlock_t*)&server->registry_lock);
 
     printf("========================================\n\n");
 }
 
+/* ========================================================================
+ * Cluster Functions
+ * ======================================================================== */
+
+/**
+ * @brief Set the cluster hooks
+ */
+void usb_server_set_relay(usb_server_t* server,
+                          const usb_server_relay_t* relay)
+{
+    if (server == NULL) {
+        return;
+    }
+
+    /* Exclusive: waits out every call to the previous hooks */
+    pthread_rwlock_wrlock(&server->relay_lock);
+    if (relay != NULL) {
+        server->relay = *relay;
+    } else {
+        memset(&server->relay, 0, sizeof(server->relay));
+    }
+    pthread_rwlock_unlock(&server->relay_lock);
+}
+
+/**
+ * @brief List the device_ids local clients have registered
+ */
+int usb_server_device_ids(usb_server_t* server, uint32_t* ids, int max)
+{
+    usb_client_entry_t* entry;
+    uint32_t bucket;
+    int count = 0;
+    int seen;
+    int i;
+
+    if (server == NULL || ids == NULL || max < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_rwlock_rdlock(&server->registry_lock);
+    for (bucket = 0; bucket <= server->bucket_mask && count < max; bucket++) {
+        for (entry = server->device_buckets[bucket];
+             entry != NULL && count < max; entry = entry->device_next) {
+            /* Equal ids share a bucket: only look back within it */
+            seen = FALSE;
+            for (i = count - 1; i >= 0 && !seen; i--) {
+                if (usb_server_bucket(server, ids[i]) != bucket) {
+                    break;
+                }
+                seen = (ids[i] == entry->device_id);
+            }
+            if (!seen) {
+                ids[count++] = entry->device_id;
+            }
+        }
+    }
+    pthread_rwlock_unlock(&server->registry_lock);
+
+    return count;
+}
+
 /* ========================================================================
  * Authentication Configuration Functions
  * ======================================================================== */
@@ -717,12 +1854,29 @@ void usb_server_print_stats(const usb_server_t* server)
  */
 int usb_server_set_auth_secret(usb_server_t* server, const char* secret)
 {
+    char truncated[USB_AUTH_SECRET_MAX];
+    usb_auth_key_t* key = NULL;
+    usb_auth_key_t* old_key;
+
     if (server == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
-    pthread_mutex_lock(&server->registry_lock);
+    /* Key the HMAC once here instead of on every verification */
+    if (secret != NULL && secret[0] != '\0') {
+        strncpy(truncated, secret, USB_AUTH_SECRET_MAX - 1);
+        truncated[USB_AUTH_SECRET_MAX - 1] = '\0';
+        key = usb_auth_key_create(truncated);
+        memset(truncated, 0, sizeof(truncated));
+        if (key == NULL) {
+            return E_UNKNOWN_ERROR;
+        }
+    }
+
+    pthread_rwlock_wrlock(&server->registry_lock);
 
+    old_key = server->auth_key;
+    server->auth_key = key;
     if (secret == NULL || secret[0] == '\0') {
         /* Disable authentication */
         memset(server->auth_secret, 0, sizeof(server->auth_secret));
@@ -734,7 +1888,10 @@ int usb_server_set_auth_secret(usb_server_t* server, const char* secret)
         server->require_auth = TRUE;
     }
 
-    pthread_mutex_unlock(&server->registry_lock);
+    pthread_rwlock_unlock(&server->registry_lock);
+
+    /* Verifications hold the registry lock shared: none still uses it */
+    usb_auth_key_free(old_key);
 
     printf("USB Server: Authentication %s\n",
            server->require_auth ? "enabled" : "disabled");
@@ -759,7 +1916,7 @@ int usb_server_set_class_whitelist(usb_server_t* server,
         return E_INVALID_ARGUMENT;
     }
 
-    pthread_mutex_lock(&server->registry_lock);
+    pthread_rwlock_wrlock(&server->registry_lock);
 
     if (classes == NULL || count == 0) {
         /* Clear whitelist (default policy applies: block HID only) */
@@ -773,13 +1930,27 @@ int usb_server_set_class_whitelist(usb_server_t* server,
         server->allowed_class_count = count;
     }
 
-    pthread_mutex_unlock(&server->registry_lock);
+    pthread_rwlock_unlock(&server->registry_lock);
 
     printf("USB Server: Device class whitelist set (%d entries)\n", count);
 
     return 0;
 }
 
+/**
+ * @brief Set the isochronous bandwidth budget
+ */
+void usb_server_set_iso_budget(usb_server_t* server, uint32_t bytes_per_sec)
+{
+    if (server == NULL) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&server->registry_lock);
+    server->iso_budget = bytes_per_sec;
+    pthread_rwlock_unlock(&server->registry_lock);
+}
+
 /**
  * @brief Enable or disable authentication requirement
  */
@@ -789,14 +1960,32 @@ void usb_server_set_require_auth(usb_server_t* server, int require)
         return;
     }
 
-    pthread_mutex_lock(&server->registry_lock);
+    pthread_rwlock_wrlock(&server->registry_lock);
     server->require_auth = require ? TRUE : FALSE;
-    pthread_mutex_unlock(&server->registry_lock);
+    pthread_rwlock_unlock(&server->registry_lock);
 
     printf("USB Server: Authentication requirement %s\n",
            require ? "enabled" : "disabled");
 }
 
+/* ========================================================================
+ * Send Queue Configuration Functions
+ * ======================================================================== */
+
+/**
+ * @brief Set the send queue stall policy
+ */
+void usb_server_set_send_stall(usb_server_t* server, unsigned int stall_ms)
+{
+    if (server == NULL) {
+        return;
+    }
+
+    pthread_rwlock_wrlock(&server->registry_lock);
+    server->send_stall_ms = stall_ms;
+    pthread_rwlock_unlock(&server->registry_lock);
+}
+
 /**
  * @brief Get client IP address from socket
  */
@@ -15,54 +15,142 @@
 
 #include "usb_protocol.h"
 #include "usb_config.h"
+#include "usb_send_queue.h"
+#include "usb_desc_cache.h"
+#include "lib/security/usb_auth.h"
 #include <pthread.h>
 
-/* Maximum number of USB clients that can connect */
-#define USB_MAX_CLIENTS 16
+/* Client registry sizing (grows on demand up to the maximum) */
+#define USB_INITIAL_CLIENTS 16      /* Initial hash bucket count */
+#define USB_MAX_CLIENTS     4096    /* Registered device limit */
 
 /* Authentication challenge size (must match usb_auth.h) */
 #define USB_AUTH_CHALLENGE_SIZE 32
 
+typedef struct usb_client_entry usb_client_entry_t;
+
+/**
+ * @brief Hooks to a cluster of servers (core/cluster.h)
+ *
+ * A URB for a device_id no local client can take is offered to
+ * forward(), which sends it to another node registering the device. URBs
+ * other nodes send here come back through usb_server_deliver(), which
+ * never offers them again, so a frame crosses at most one link.
+ *
+ * devices_changed() runs with the registry locked exclusive whenever a
+ * device_id becomes routable or stops being so; it must only note the
+ * change (usb_server_device_ids() reads the set later).
+ */
+typedef struct {
+    void (*devices_changed)(void* ctx);
+    /* Takes packet->payload in every case; E_NOT_FOUND if no node has it */
+    int (*forward)(void* ctx, uint32_t device_id, xoe_packet_t* packet,
+                   int relay);
+    void* ctx;
+} usb_server_relay_t;
+
+/**
+ * @brief Route for replies to a sender the server has no send queue for
+ *
+ * send() gets the reply with its payload still owned by the server (it
+ * must take its own reference to keep it) and must not wait for the
+ * client to read.
+ */
+typedef struct {
+    int (*send)(void* arg, const xoe_packet_t* packet);
+    void* arg;
+} usb_server_reply_t;
+
 /**
  * @brief USB client registration entry
  *
  * Tracks connected USB clients and their advertised USB devices.
  * Used for routing URBs to the appropriate client.
+ *
+ * Entries are allocated individually and never freed before server
+ * cleanup. Released entries are reused through the free list.
+ *
+ * Every entry on a socket shares that socket's send queue; routers take
+ * a queue reference under the registry lock and push after dropping it.
+ *
+ * Descriptors sent with the registration are kept until it is released,
+ * so descriptor reads for the device are answered without a round trip.
  */
-typedef struct {
+struct usb_client_entry {
     int socket_fd;                      /* Client socket */
     uint32_t device_id;                 /* USB device ID (VID:PID) */
     uint8_t device_class;               /* USB device class */
-    int in_use;                         /* Slot in use flag */
+    uint32_t max_transfer_size;         /* Negotiated URB data limit */
+    uint32_t iso_bandwidth;             /* Isochronous bytes/s reserved */
+    usb_desc_cache_t* descriptors;      /* Sent at registration (NULL = none) */
+    int in_use;                         /* Registered (routable) flag */
+    int reserved;                       /* Taken from the free list */
     int authenticated;                  /* Authentication status */
     int auth_pending;                   /* Auth challenge sent, awaiting response */
     uint8_t pending_challenge[USB_AUTH_CHALLENGE_SIZE]; /* Challenge for auth */
+    uint32_t pending_seqnum;            /* Registration the challenge answers */
     char client_ip[46];                 /* Client IP (IPv6-ready) */
-    pthread_mutex_t send_lock;          /* Mutex for send operations */
-} usb_client_entry_t;
+    usb_send_queue_t* send_queue;       /* Outbound queue of the socket */
+
+    /* Registry linkage (guarded by registry_lock) */
+    usb_client_entry_t* device_next;    /* device_id hash chain (in_use) */
+    usb_client_entry_t* socket_next;    /* Socket hash chain (reserved) */
+    usb_client_entry_t* free_next;      /* Free list */
+};
 
 /**
  * @brief USB server context structure
  *
  * Maintains state for USB server operation including client registry
  * and routing logic.
+ *
+ * The registry is indexed by device_id (routing) and by socket
+ * (unregister, auth). It is read-mostly: routing takes registry_lock
+ * shared, so routing threads do not serialize on each other; only
+ * registration changes take it exclusive.
  */
 typedef struct usb_server_t {
     /* Client registry */
-    usb_client_entry_t clients[USB_MAX_CLIENTS];
-    pthread_mutex_t registry_lock;      /* Registry modification lock */
+    usb_client_entry_t** entries;       /* Every allocated entry */
+    int entry_count;                    /* Allocated entries */
+    int entry_capacity;                 /* Size of entries array */
+    usb_client_entry_t* free_entries;   /* Released entries */
+
+    usb_client_entry_t** device_buckets; /* device_id -> entries */
+    usb_client_entry_t** socket_buckets; /* socket_fd -> entries */
+    uint32_t bucket_mask;               /* Bucket count - 1 (power of two) */
+
+    pthread_rwlock_t registry_lock;     /* Shared: routing, exclusive: changes */
 
     /* Security configuration */
     char auth_secret[USB_AUTH_SECRET_MAX];  /* Shared secret for auth */
+    usb_auth_key_t* auth_key;               /* HMAC keyed with auth_secret */
     uint8_t allowed_classes[16];            /* Device class whitelist */
     int allowed_class_count;                /* Whitelist size */
     int require_auth;                       /* Authentication required flag */
 
+    /* Isochronous admission (guarded by registry_lock) */
+    uint32_t iso_budget;                /* Bytes/s for all streams (0 = no limit) */
+    uint64_t iso_reserved;              /* Bytes/s held by registrations */
+
+    /* Outbound path */
+    usb_send_writer_t send_writer;      /* Drains every client queue */
+    unsigned int send_stall_ms;         /* Wait for queue space, then drop */
+
+    /* Cluster hooks (held shared while one is called) */
+    usb_server_relay_t relay;
+    pthread_rwlock_t relay_lock;
+
     /* Statistics */
     unsigned long packets_routed;       /* Total packets routed */
     unsigned long routing_errors;       /* Routing error count */
     unsigned long active_clients;       /* Number of active clients */
     unsigned long auth_failures;        /* Authentication failures */
+    unsigned long bandwidth_rejects;    /* Registrations over the iso budget */
+    unsigned long descriptor_hits;      /* Descriptor reads answered from cache */
+    unsigned long batches_received;     /* USB_CMD_BATCH frames unpacked */
+    unsigned long batched_urbs;         /* URBs that arrived in them */
+    unsigned long urbs_relayed;         /* URBs sent to other nodes */
 } usb_server_t;
 
 /* ========================================================================
@@ -117,6 +205,17 @@ int usb_server_register_client(usb_server_t* server,
 int usb_server_unregister_client(usb_server_t* server,
                                   int socket_fd);
 
+/**
+ * @brief Check whether a connection has a USB registration
+ *
+ * Counts registrations still awaiting their auth response too.
+ *
+ * @param server Server context
+ * @param socket_fd Client socket file descriptor
+ * @return TRUE if registered, FALSE otherwise (or if server is NULL)
+ */
+int usb_server_has_client(usb_server_t* server, int socket_fd);
+
 /* ========================================================================
  * URB Routing Functions
  * ======================================================================== */
@@ -127,12 +226,21 @@ int usb_server_unregister_client(usb_server_t* server,
  * Routes a USB Request Block to the appropriate client based on device_id.
  * This is the core routing function of the USB server.
  *
+ * URBs larger than the size negotiated with the target client are
+ * rejected with E_BUFFER_TOO_SMALL rather than forwarded.
+ *
+ * The URB is queued on the target's socket and written by the server's
+ * send writer, so a slow target never blocks the caller for longer than
+ * the configured stall time.
+ *
  * @param server Server context
  * @param urb_header URB header
  * @param data Transfer data (may be NULL)
  * @param data_len Length of transfer data
  * @param sender_fd Socket FD of sending client (to avoid loopback)
  * @return 0 on success, negative error code on failure
+ *         (E_WOULD_BLOCK if the target's queue stayed full and the URB
+ *         was dropped)
  */
 int usb_server_route_urb(usb_server_t* server,
                          const usb_urb_header_t* urb_header,
@@ -140,21 +248,111 @@ int usb_server_route_urb(usb_server_t* server,
                          uint32_t data_len,
                          int sender_fd);
 
+/**
+ * @brief Forward a received URB frame to its target client unchanged
+ *
+ * Zero-copy counterpart of usb_server_route_urb() for relaying: the
+ * received payload is sent as-is with its verified checksum, so routing
+ * costs no allocation, copy or CRC. Used by usb_server_handle_urb() for
+ * SUBMIT/RET_SUBMIT frames whose actual_length covers the whole payload.
+ *
+ * The payload is handed to the target's send queue: on return
+ * packet->payload is NULL whatever the result.
+ *
+ * @param server Server context
+ * @param urb_header URB header decoded from @p packet
+ * @param packet Packet as received (payload must be unmodified)
+ * @param sender_fd Socket FD of sending client (to avoid loopback)
+ * @return 0 on success, negative error code on failure
+ *         (same routing errors as usb_server_route_urb())
+ */
+int usb_server_forward_urb(usb_server_t* server,
+                           const usb_urb_header_t* urb_header,
+                           xoe_packet_t* packet,
+                           int sender_fd);
+
 /**
  * @brief Handle incoming URB from client
  *
- * Processes a URB received from a client. Decapsulates the packet,
- * performs routing logic, and forwards to the appropriate destination.
+ * Processes a URB received from a client. Standard GET_DESCRIPTOR
+ * control URBs and USB_CMD_ENUM are answered from the target's cached
+ * descriptors when it sent them. Data URBs that fill their frame are
+ * relayed with usb_server_forward_urb(); everything else is
+ * decapsulated and handled or re-encapsulated for the destination. The
+ * URBs of a USB_CMD_BATCH are handled one by one, in order.
  *
  * @param server Server context
- * @param packet Received XOE packet
+ * @param packet Received XOE packet (a relayed payload is taken over and
+ *               packet->payload set to NULL)
  * @param sender_fd Socket FD of sending client
  * @return 0 on success, negative error code on failure
  */
 int usb_server_handle_urb(usb_server_t* server,
-                          const xoe_packet_t* packet,
+                          xoe_packet_t* packet,
                           int sender_fd);
 
+/**
+ * @brief Handle a URB, replying through the sender's connection
+ *
+ * Like usb_server_handle_urb(), but a reply to a socket with no registry
+ * entry (and so no send queue) is handed to @p reply instead of being
+ * written to the socket, which would wait while the client is not
+ * reading. Event loop connections pass a route that queues it for the
+ * worker owning the connection.
+ *
+ * @param server Server context
+ * @param packet Received XOE packet, as for usb_server_handle_urb()
+ * @param sender_fd Socket FD of sending client
+ * @param reply Reply route, or NULL to write replies directly
+ * @return 0 on success, negative error code on failure
+ */
+int usb_server_handle_urb_from(usb_server_t* server,
+                               xoe_packet_t* packet,
+                               int sender_fd,
+                               const usb_server_reply_t* reply);
+
+/**
+ * @brief Route a URB frame received from another node of a cluster
+ *
+ * Like usb_server_forward_urb() from a sender that is not a client of
+ * this server: the frame goes to a local registration of its device_id,
+ * unchanged, and is never offered to the relay again.
+ *
+ * @param server Server context
+ * @param packet XOE_PROTOCOL_USB frame as received (payload taken over,
+ *               packet->payload set to NULL)
+ * @return 0 on success, E_PROTOCOL_ERROR for a frame that is not a
+ *         routable URB, else the routing errors of usb_server_route_urb()
+ */
+int usb_server_deliver(usb_server_t* server, xoe_packet_t* packet);
+
+/* ========================================================================
+ * Cluster Functions
+ * ======================================================================== */
+
+/**
+ * @brief Set the cluster hooks
+ *
+ * Returns once no call to the previous hooks is in progress, so a
+ * cluster can be freed after clearing them.
+ *
+ * @param server Server context
+ * @param relay Hooks, or NULL to route among local clients only
+ */
+void usb_server_set_relay(usb_server_t* server,
+                          const usb_server_relay_t* relay);
+
+/**
+ * @brief List the device_ids local clients have registered
+ *
+ * @param server Server context
+ * @param ids Output: distinct device_ids, in no particular order
+ * @param max Capacity of @p ids
+ * @return Number of device_ids stored (at most @p max), or
+ *         E_INVALID_ARGUMENT
+ */
+int usb_server_device_ids(usb_server_t* server, uint32_t* ids, int max);
+
 /* ========================================================================
  * Statistics and Status Functions
  * ======================================================================== */
@@ -208,6 +406,35 @@ int usb_server_set_class_whitelist(usb_server_t* server,
  */
 void usb_server_set_require_auth(usb_server_t* server, int require);
 
+/**
+ * @brief Set the isochronous bandwidth budget
+ *
+ * Registrations reserve the isochronous bandwidth they advertise (see
+ * usb_protocol.h) until they unregister; one that would take the total
+ * past @p bytes_per_sec is refused with E_USB_NO_BANDWIDTH. Lowering
+ * the budget never evicts existing registrations.
+ *
+ * @param server Server context
+ * @param bytes_per_sec Budget for all devices (0 = unlimited, the default)
+ */
+void usb_server_set_iso_budget(usb_server_t* server, uint32_t bytes_per_sec);
+
+/* ========================================================================
+ * Send Queue Configuration Functions
+ * ======================================================================== */
+
+/**
+ * @brief Set the send queue stall policy
+ *
+ * When a client's send queue is full, routers wait up to @p stall_ms
+ * for the client to drain it before dropping the URB. 0 drops at once
+ * (pure drop policy). Both events are counted in the statistics.
+ *
+ * @param server Server context
+ * @param stall_ms Maximum wait in milliseconds (default USB_SEND_STALL_MS)
+ */
+void usb_server_set_send_stall(usb_server_t* server, unsigned int stall_ms);
+
 /**
  * @brief Get client IP address from socket
  *
@@ -65,6 +65,61 @@ static int map_libusb_error(int libusb_error)
     }
 }
 
+/**
+ * @brief Map libusb error code to XOE error code
+ */
+int usb_transfer_map_error(int libusb_error)
+{
+    return map_libusb_error(libusb_error);
+}
+
+/**
+ * @brief Map libusb transfer completion status to XOE error code
+ */
+int usb_transfer_status_to_error(int status)
+{
+    switch (status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+            return 0;
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            return E_TIMEOUT;
+        case LIBUSB_TRANSFER_CANCELLED:
+            return E_INTERRUPTED;
+        case LIBUSB_TRANSFER_STALL:
+            return E_USB_PIPE_ERROR;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            return E_USB_NOT_FOUND;
+        case LIBUSB_TRANSFER_OVERFLOW:
+            return E_BUFFER_TOO_SMALL;
+        default:
+            return E_USB_TRANSFER_ERROR;
+    }
+}
+
+/**
+ * @brief Run a synchronous transfer through a device backend
+ */
+static int usb_transfer_backend(usb_device_t* dev,
+                                uint8_t endpoint,
+                                unsigned char* buffer,
+                                int length,
+                                int* transferred,
+                                unsigned int timeout)
+{
+    int bytes_transferred = 0;
+    int result;
+
+    result = dev->backend->transfer(dev, endpoint, buffer, length,
+                                    &bytes_transferred, timeout);
+
+    /* Store transferred bytes if requested */
+    if (transferred != NULL) {
+        *transferred = bytes_transferred;
+    }
+
+    return result;
+}
+
 /* ========================================================================
  * Synchronous Transfer Functions
  * ======================================================================== */
@@ -123,7 +178,8 @@ int usb_transfer_bulk_read(usb_device_t* dev,
     int bytes_transferred = 0;
 
     /* Validate input parameters */
-    if (dev == NULL || dev->handle == NULL || buffer == NULL) {
+    if (dev == NULL || (dev->handle == NULL && dev->backend == NULL) ||
+        buffer == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
@@ -132,6 +188,12 @@ int usb_transfer_bulk_read(usb_device_t* dev,
         return E_INVALID_ARGUMENT;
     }
 
+    /* Backend devices have no libusb handle */
+    if (dev->backend != NULL) {
+        return usb_transfer_backend(dev, endpoint, buffer, length,
+                                    transferred, timeout);
+    }
+
     /* Perform synchronous bulk transfer */
     result = libusb_bulk_transfer(
         dev->handle,
@@ -169,7 +231,8 @@ int usb_transfer_bulk_write(usb_device_t* dev,
     int bytes_transferred = 0;
 
     /* Validate input parameters */
-    if (dev == NULL || dev->handle == NULL || buffer == NULL) {
+    if (dev == NULL || (dev->handle == NULL && dev->backend == NULL) ||
+        buffer == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
@@ -178,6 +241,12 @@ int usb_transfer_bulk_write(usb_device_t* dev,
         return E_INVALID_ARGUMENT;
     }
 
+    /* Backend devices have no libusb handle */
+    if (dev->backend != NULL) {
+        return usb_transfer_backend(dev, endpoint, (unsigned char*)buffer, length,
+                                    transferred, timeout);
+    }
+
     /* Perform synchronous bulk transfer (cast away const for libusb API) */
     result = libusb_bulk_transfer(
         dev->handle,
@@ -215,7 +284,8 @@ int usb_transfer_interrupt_read(usb_device_t* dev,
     int bytes_transferred = 0;
 
     /* Validate input parameters */
-    if (dev == NULL || dev->handle == NULL || buffer == NULL) {
+    if (dev == NULL || (dev->handle == NULL && dev->backend == NULL) ||
+        buffer == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
@@ -224,6 +294,12 @@ int usb_transfer_interrupt_read(usb_device_t* dev,
         return E_INVALID_ARGUMENT;
     }
 
+    /* Backend devices have no libusb handle */
+    if (dev->backend != NULL) {
+        return usb_transfer_backend(dev, endpoint, buffer, length,
+                                    transferred, timeout);
+    }
+
     /* Perform synchronous interrupt transfer */
     result = libusb_interrupt_transfer(
         dev->handle,
@@ -54,6 +54,29 @@ typedef struct {
 #endif
 } usb_transfer_ctx_t;
 
+/* ========================================================================
+ * Error Mapping
+ * ======================================================================== */
+
+/**
+ * @brief Map libusb error code to XOE error code
+ *
+ * @param libusb_error libusb return value (LIBUSB_ERROR_*)
+ * @return 0 for LIBUSB_SUCCESS, otherwise negative XOE error code
+ */
+int usb_transfer_map_error(int libusb_error);
+
+/**
+ * @brief Map libusb transfer completion status to XOE error code
+ *
+ * Asynchronous transfers report enum libusb_transfer_status rather than
+ * LIBUSB_ERROR_* codes; use this for transfer->status.
+ *
+ * @param status Transfer status (LIBUSB_TRANSFER_*)
+ * @return 0 for LIBUSB_TRANSFER_COMPLETED, otherwise negative XOE error code
+ */
+int usb_transfer_status_to_error(int status);
+
 /* ========================================================================
  * Synchronous Transfer Functions
  * ======================================================================== */
@@ -0,0 +1,421 @@
+/*
+ * usb_virtual.c - Virtual USB Loopback Device Implementation
+ *
+ * Bulk OUT data is paced, then queued in a ring; bulk IN takes queued
+ * data, then is paced. Each endpoint keeps the time its last transfer
+ * finishes on the simulated bus, so back-to-back transfers on one
+ * endpoint add up to the configured rate.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2026-10-14
+ */
+
+#include "usb_virtual.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+
+/**
+ * @brief Virtual device state (usb_device_t.backend_data)
+ */
+typedef struct {
+    usb_virtual_config_t config;
+
+    pthread_mutex_t lock;               /* Guards everything below */
+    pthread_cond_t data_cond;           /* Data queued */
+    pthread_cond_t space_cond;          /* Space freed */
+
+    /* Loopback ring */
+    unsigned char* fifo;
+    uint32_t fifo_head;                 /* Next byte to read */
+    uint32_t fifo_count;                /* Queued bytes */
+
+    /* Simulated bus time at which each endpoint becomes idle */
+    uint64_t in_busy_until_ns;
+    uint64_t out_busy_until_ns;
+
+    usb_virtual_stats_t stats;
+} usb_virtual_state_t;
+
+/* ========================================================================
+ * Internal Helper Functions
+ * ======================================================================== */
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+static uint64_t usb_virtual_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Absolute condition variable deadline for a libusb-style timeout
+ */
+static void usb_virtual_deadline(unsigned int timeout_ms,
+                                 struct timespec* deadline)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    deadline->tv_sec = now.tv_sec + (time_t)(timeout_ms / 1000);
+    deadline->tv_nsec = (now.tv_usec * 1000L) +
+                        (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+/**
+ * @brief Wait on a condition, forever when timeout_ms is 0
+ *
+ * @return 0 when signalled, E_TIMEOUT once the deadline has passed
+ */
+static int usb_virtual_wait(pthread_cond_t* cond, pthread_mutex_t* lock,
+                            unsigned int timeout_ms,
+                            const struct timespec* deadline)
+{
+    if (timeout_ms == 0) {
+        pthread_cond_wait(cond, lock);
+        return 0;
+    }
+    if (pthread_cond_timedwait(cond, lock, deadline) == ETIMEDOUT) {
+        return E_TIMEOUT;
+    }
+    return 0;
+}
+
+/**
+ * @brief Book bus time for a transfer on one endpoint
+ *
+ * Caller holds the lock.
+ *
+ * @return Monotonic time at which the transfer completes
+ */
+static uint64_t usb_virtual_book(const usb_virtual_state_t* state,
+                                 uint64_t* busy_until_ns,
+                                 uint32_t rate,
+                                 uint32_t bytes)
+{
+    uint64_t start;
+    uint64_t cost;
+
+    start = usb_virtual_now_ns();
+    if (*busy_until_ns > start) {
+        start = *busy_until_ns;
+    }
+
+    cost = (uint64_t)state->config.latency_us * 1000ULL;
+    if (rate > 0) {
+        cost += (uint64_t)bytes * 1000000000ULL / rate;
+    }
+
+    *busy_until_ns = start + cost;
+    return *busy_until_ns;
+}
+
+/**
+ * @brief Sleep until a monotonic time
+ */
+static void usb_virtual_sleep_until(uint64_t until_ns)
+{
+    struct timespec delay;
+    uint64_t now;
+
+    for (now = usb_virtual_now_ns(); now < until_ns;
+         now = usb_virtual_now_ns()) {
+        delay.tv_sec = (time_t)((until_ns - now) / 1000000000ULL);
+        delay.tv_nsec = (long)((until_ns - now) % 1000000000ULL);
+        nanosleep(&delay, NULL);
+    }
+}
+
+/* ========================================================================
+ * Endpoint Operations
+ * ======================================================================== */
+
+/**
+ * @brief Bulk IN: return looped-back data
+ */
+static int usb_virtual_read(usb_virtual_state_t* state,
+                            unsigned char* buffer,
+                            uint32_t length,
+                            int* transferred,
+                            unsigned int timeout)
+{
+    struct timespec deadline;
+    uint32_t size = state->config.fifo_size;
+    uint32_t count;
+    uint32_t first;
+    uint64_t done_ns;
+
+    usb_virtual_deadline(timeout, &deadline);
+
+    pthread_mutex_lock(&state->lock);
+
+    while (state->fifo_count == 0) {
+        if (usb_virtual_wait(&state->data_cond, &state->lock, timeout,
+                             &deadline) != 0) {
+            state->stats.timeouts++;
+            pthread_mutex_unlock(&state->lock);
+            return E_TIMEOUT;
+        }
+    }
+
+    count = (state->fifo_count < length) ? state->fifo_count : length;
+    first = size - state->fifo_head;
+    if (first > count) {
+        first = count;
+    }
+    memcpy(buffer, state->fifo + state->fifo_head, first);
+    memcpy(buffer + first, state->fifo, count - first);
+    state->fifo_head = (state->fifo_head + count) % size;
+    state->fifo_count -= count;
+    pthread_cond_broadcast(&state->space_cond);
+
+    done_ns = usb_virtual_book(state, &state->in_busy_until_ns,
+                               state->config.in_rate, count);
+    state->stats.in_transfers++;
+    state->stats.in_bytes += count;
+
+    pthread_mutex_unlock(&state->lock);
+
+    usb_virtual_sleep_until(done_ns);
+    *transferred = (int)count;
+    return 0;
+}
+
+/**
+ * @brief Bulk OUT: queue data for the IN endpoint
+ */
+static int usb_virtual_write(usb_virtual_state_t* state,
+                             const unsigned char* buffer,
+                             uint32_t length,
+                             int* transferred,
+                             unsigned int timeout)
+{
+    struct timespec deadline;
+    uint32_t size = state->config.fifo_size;
+    uint32_t moved = 0;
+    uint32_t tail;
+    uint32_t chunk;
+    uint32_t first;
+    uint64_t done_ns;
+    int result = 0;
+
+    usb_virtual_deadline(timeout, &deadline);
+
+    /* The data crosses the bus before the device buffers it */
+    pthread_mutex_lock(&state->lock);
+    done_ns = usb_virtual_book(state, &state->out_busy_until_ns,
+                               state->config.out_rate, length);
+    pthread_mutex_unlock(&state->lock);
+    usb_virtual_sleep_until(done_ns);
+
+    pthread_mutex_lock(&state->lock);
+
+    while (moved < length) {
+        if (state->fifo_count == size) {
+            result = usb_virtual_wait(&state->space_cond, &state->lock,
+                                      timeout, &deadline);
+            if (result != 0) {
+                state->stats.timeouts++;
+                break;
+            }
+            continue;
+        }
+
+        chunk = size - state->fifo_count;
+        if (chunk > length - moved) {
+            chunk = length - moved;
+        }
+        tail = (state->fifo_head + state->fifo_count) % size;
+        first = size - tail;
+        if (first > chunk) {
+            first = chunk;
+        }
+        memcpy(state->fifo + tail, buffer + moved, first);
+        memcpy(state->fifo, buffer + moved + first, chunk - first);
+        state->fifo_count += chunk;
+        moved += chunk;
+        pthread_cond_broadcast(&state->data_cond);
+    }
+
+    if (result == 0) {
+        state->stats.out_transfers++;
+    }
+    state->stats.out_bytes += moved;
+
+    pthread_mutex_unlock(&state->lock);
+
+    *transferred = (int)moved;
+    return result;
+}
+
+/* ========================================================================
+ * Backend Hooks
+ * ======================================================================== */
+
+/**
+ * @brief Backend transfer hook
+ */
+static int usb_virtual_transfer(usb_device_t* dev,
+                                uint8_t endpoint,
+                                unsigned char* buffer,
+                                int length,
+                                int* transferred,
+                                unsigned int timeout)
+{
+    usb_virtual_state_t* state = (usb_virtual_state_t*)dev->backend_data;
+
+    *transferred = 0;
+    if (length < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (endpoint == state->config.in_endpoint) {
+        return usb_virtual_read(state, buffer, (uint32_t)length,
+                                transferred, timeout);
+    }
+    if (endpoint == state->config.out_endpoint) {
+        return usb_virtual_write(state, buffer, (uint32_t)length,
+                                 transferred, timeout);
+    }
+
+    /* No such endpoint on this device */
+    return E_USB_PIPE_ERROR;
+}
+
+/**
+ * @brief Backend close hook
+ */
+static void usb_virtual_close(usb_device_t* dev)
+{
+    usb_virtual_state_t* state = (usb_virtual_state_t*)dev->backend_data;
+
+    if (state == NULL) {
+        return;
+    }
+
+    pthread_cond_destroy(&state->space_cond);
+    pthread_cond_destroy(&state->data_cond);
+    pthread_mutex_destroy(&state->lock);
+    free(state->fifo);
+    free(state);
+}
+
+static const usb_device_backend_t usb_virtual_backend = {
+    "virtual",
+    usb_virtual_transfer,
+    usb_virtual_close
+};
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+/**
+ * @brief Fill a configuration with defaults
+ */
+void usb_virtual_config_init(usb_virtual_config_t* config)
+{
+    if (config == NULL) {
+        return;
+    }
+
+    memset(config, 0, sizeof(usb_virtual_config_t));
+    config->in_endpoint = USB_VIRTUAL_IN_ENDPOINT;
+    config->out_endpoint = USB_VIRTUAL_OUT_ENDPOINT;
+    config->fifo_size = USB_VIRTUAL_FIFO_SIZE;
+}
+
+/**
+ * @brief Open a virtual loopback device
+ */
+int usb_virtual_open(usb_device_t* dev, const usb_virtual_config_t* config)
+{
+    usb_virtual_state_t* state;
+
+    if (dev == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    state = (usb_virtual_state_t*)calloc(1, sizeof(usb_virtual_state_t));
+    if (state == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    if (config != NULL) {
+        state->config = *config;
+    } else {
+        usb_virtual_config_init(&state->config);
+    }
+
+    /* Loopback needs one IN and one OUT endpoint */
+    if ((state->config.in_endpoint & 0x80) == 0 ||
+        (state->config.out_endpoint & 0x80) != 0 ||
+        state->config.fifo_size == 0) {
+        free(state);
+        return E_INVALID_ARGUMENT;
+    }
+
+    state->fifo = (unsigned char*)malloc(state->config.fifo_size);
+    if (state->fifo == NULL) {
+        free(state);
+        return E_OUT_OF_MEMORY;
+    }
+
+    if (pthread_mutex_init(&state->lock, NULL) != 0) {
+        free(state->fifo);
+        free(state);
+        return E_OUT_OF_MEMORY;
+    }
+    if (pthread_cond_init(&state->data_cond, NULL) != 0) {
+        pthread_mutex_destroy(&state->lock);
+        free(state->fifo);
+        free(state);
+        return E_OUT_OF_MEMORY;
+    }
+    if (pthread_cond_init(&state->space_cond, NULL) != 0) {
+        pthread_cond_destroy(&state->data_cond);
+        pthread_mutex_destroy(&state->lock);
+        free(state->fifo);
+        free(state);
+        return E_OUT_OF_MEMORY;
+    }
+
+    memset(dev, 0, sizeof(usb_device_t));
+    dev->backend = &usb_virtual_backend;
+    dev->backend_data = state;
+
+    return 0;
+}
+
+/**
+ * @brief Read the device counters
+ */
+int usb_virtual_get_stats(usb_device_t* dev, usb_virtual_stats_t* stats)
+{
+    usb_virtual_state_t* state;
+
+    if (dev == NULL || stats == NULL || dev->backend != &usb_virtual_backend) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    state = (usb_virtual_state_t*)dev->backend_data;
+    pthread_mutex_lock(&state->lock);
+    *stats = state->stats;
+    pthread_mutex_unlock(&state->lock);
+
+    return 0;
+}
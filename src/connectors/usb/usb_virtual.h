@@ -0,0 +1,89 @@
+/*
+ * usb_virtual.h - Virtual USB Loopback Device
+ *
+ * Software device behind the usb_device_t backend hooks, for exercising
+ * the USB forwarding path without hardware. Data written to the bulk OUT
+ * endpoint loops back on the bulk IN endpoint; each endpoint is paced at
+ * a configurable byte rate plus a fixed per-transfer latency, so tests
+ * and benchmarks can model slow and fast devices.
+ *
+ * EXPERIMENTAL FEATURE - Subject to change
+ *
+ * Author: [LLM-ARCH]
+ * Date: 2026-10-14
+ */
+
+#ifndef USB_VIRTUAL_H
+#define USB_VIRTUAL_H
+
+#include "usb_device.h"
+
+/* Default loopback endpoints */
+#define USB_VIRTUAL_IN_ENDPOINT     0x81
+#define USB_VIRTUAL_OUT_ENDPOINT    0x01
+
+/* Default loopback buffer (OUT data awaiting an IN transfer) */
+#define USB_VIRTUAL_FIFO_SIZE       (64 * 1024)
+
+/**
+ * @brief Virtual device configuration
+ *
+ * A rate of 0 leaves that endpoint unpaced (only latency_us applies).
+ */
+typedef struct {
+    uint8_t in_endpoint;                /* Bulk IN address (bit 7 set) */
+    uint8_t out_endpoint;               /* Bulk OUT address (bit 7 clear) */
+    uint32_t in_rate;                   /* Bulk IN bytes per second */
+    uint32_t out_rate;                  /* Bulk OUT bytes per second */
+    unsigned int latency_us;            /* Fixed cost of every transfer */
+    uint32_t fifo_size;                 /* Loopback buffer capacity */
+} usb_virtual_config_t;
+
+/**
+ * @brief Virtual device counters
+ */
+typedef struct {
+    unsigned long in_transfers;         /* Completed bulk IN transfers */
+    unsigned long out_transfers;        /* Completed bulk OUT transfers */
+    unsigned long long in_bytes;        /* Bytes returned by bulk IN */
+    unsigned long long out_bytes;       /* Bytes accepted by bulk OUT */
+    unsigned long timeouts;             /* Transfers that timed out */
+} usb_virtual_stats_t;
+
+/**
+ * @brief Fill a configuration with defaults
+ *
+ * Default endpoints, USB_VIRTUAL_FIFO_SIZE, no pacing and no latency.
+ *
+ * @param config Configuration to initialize
+ */
+void usb_virtual_config_init(usb_virtual_config_t* config);
+
+/**
+ * @brief Open a virtual loopback device
+ *
+ * Initializes @p dev (no libusb context or handle) with the virtual
+ * backend. The device is released by usb_device_close().
+ *
+ * Transfers follow libusb's synchronous semantics: a timeout of 0 waits
+ * forever, an expired timeout returns E_TIMEOUT with the bytes moved so
+ * far, and bulk IN returns as soon as any looped-back data is available.
+ * Transfers on the same endpoint are serialized by its pacing, while IN
+ * and OUT run independently, as on a real bus.
+ *
+ * @param dev Device context to initialize
+ * @param config Device configuration (NULL for defaults)
+ * @return 0 on success, negative error code on failure
+ */
+int usb_virtual_open(usb_device_t* dev, const usb_virtual_config_t* config);
+
+/**
+ * @brief Read the device counters
+ *
+ * @param dev Device opened with usb_virtual_open()
+ * @param stats Receives the counters
+ * @return 0 on success, E_INVALID_ARGUMENT if @p dev is not virtual
+ */
+int usb_virtual_get_stats(usb_device_t* dev, usb_virtual_stats_t* stats);
+
+#endif /* USB_VIRTUAL_H */
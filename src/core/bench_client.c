@@ -0,0 +1,683 @@
+/**
+ * @file bench_client.c
+ * @brief Echo load generator for capacity testing the server
+ *
+ * [LLM-ARCH]
+ */
+
+#include "core/bench_client.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/thread_sched.h"
+#include "lib/net/net_resolve.h"
+#include "lib/net/shm_link.h"
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#if TLS_ENABLED
+#include <openssl/ssl.h>
+#include "lib/security/tls_session.h"
+#endif
+
+/* Longest poll() wait, so stop requests are noticed promptly */
+#define BENCH_POLL_MS 100
+
+/* Raw stream frame version (as sent by the standard client) */
+#define BENCH_RAW_VERSION 1
+
+/**
+ * @brief One connection
+ */
+typedef struct {
+    int fd;
+    void* tls;                  /* SSL* or NULL */
+    xoe_transport_t transport;  /* Over tls, else fd */
+    xoe_wire_decoder_t decoder;
+    int active;
+    int in_flight;              /* Frames sent and not yet echoed */
+} bench_conn_t;
+
+struct bench_run;
+
+/**
+ * @brief One worker thread and the connections it drives
+ */
+typedef struct {
+    struct bench_run* run;
+    pthread_t thread;
+    bench_conn_t* conns;
+    struct pollfd* fds;
+    int conn_count;
+    uint32_t rate;              /* This thread's share (0 = unlimited) */
+    uint8_t* frame;             /* Payload template */
+    bench_result_t totals;
+} bench_worker_t;
+
+/**
+ * @brief State shared by the workers and the controlling thread
+ */
+typedef struct bench_run {
+    const bench_config_t* config;
+    const char* host;
+    int port;
+    const sock_tune_t* tune;
+    void* tls_ctx;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int ready;                  /* Workers done connecting */
+    int active;                 /* Connections still open */
+    int go;                     /* Measured run has started */
+    uint64_t start_ns;
+    int finish;                 /* Stop the workers (atomic) */
+} bench_run_t;
+
+/* ============================================================================
+ * Connection Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Connect (and handshake) one connection, timing the setup
+ *
+ * @return 0 on success, negative error code on failure
+ */
+static int conn_open(bench_run_t* run, bench_conn_t* conn)
+{
+    uint64_t start = latency_now_ns();
+    int result;
+
+    conn->fd = -1;
+    conn->tls = NULL;
+
+    result = net_resolve_connect_tuned(run->host, run->port, run->tune,
+                                       &conn->fd, NULL);
+    if (result != 0) {
+        return result;
+    }
+
+#if TLS_ENABLED
+    if (run->tls_ctx != NULL) {
+        conn->tls = tls_session_create_client((SSL_CTX*)run->tls_ctx,
+                                              conn->fd);
+        if (conn->tls == NULL) {
+            shm_link_close(conn->fd);
+            conn->fd = -1;
+            return E_TLS_HANDSHAKE_FAILED;
+        }
+    }
+#endif
+
+    latency_record_since(LATENCY_BENCH_CONNECT, start);
+
+    if (fd_set_nonblocking(conn->fd) != 0) {
+        result = E_NETWORK_ERROR;
+    } else if (xoe_wire_decoder_init(&conn->decoder, 0) != 0) {
+        result = E_OUT_OF_MEMORY;
+    } else {
+        if (conn->tls != NULL) {
+            xoe_transport_init_tls(&conn->transport, conn->tls);
+        } else {
+            xoe_transport_init_fd(&conn->transport, conn->fd);
+        }
+        conn->active = TRUE;
+        return 0;
+    }
+
+#if TLS_ENABLED
+    if (conn->tls != NULL) {
+        tls_session_destroy((SSL*)conn->tls);
+        conn->tls = NULL;
+    }
+#endif
+    shm_link_close(conn->fd);
+    conn->fd = -1;
+    return result;
+}
+
+/**
+ * @brief Close a connection and release its decoder
+ */
+static void conn_close(bench_conn_t* conn)
+{
+#if TLS_ENABLED
+    if (conn->tls != NULL) {
+        tls_session_shutdown((SSL*)conn->tls);
+        tls_session_destroy((SSL*)conn->tls);
+        conn->tls = NULL;
+    }
+#endif
+    if (conn->fd >= 0) {
+        shm_link_close(conn->fd);
+        conn->fd = -1;
+    }
+    if (conn->active) {
+        conn->active = FALSE;
+        xoe_wire_decoder_cleanup(&conn->decoder);
+    }
+}
+
+/**
+ * @brief Take a connection out of the run after a failure
+ */
+static void conn_lost(bench_worker_t* worker, bench_conn_t* conn, int result)
+{
+    LOG_WARN("Bench connection lost: error code %d", result);
+    conn_close(conn);
+    worker->totals.lost++;
+
+    pthread_mutex_lock(&worker->run->lock);
+    worker->run->active--;
+    pthread_mutex_unlock(&worker->run->lock);
+}
+
+/**
+ * @brief Send one frame stamped with @p stamp_ns
+ */
+static int conn_send(bench_worker_t* worker, bench_conn_t* conn,
+                     uint64_t stamp_ns)
+{
+    uint32_t size = worker->run->config->frame_size;
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    int result;
+
+    memcpy(worker->frame, &stamp_ns, sizeof(stamp_ns));
+    payload.len = size;
+    payload.data = worker->frame;
+    payload.owns_data = FALSE;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_RAW;
+    packet.protocol_version = BENCH_RAW_VERSION;
+    packet.payload = &payload;
+
+    result = xoe_wire_send_transport(&conn->transport, &packet, 0);
+    if (result == 0) {
+        conn->in_flight++;
+        worker->totals.frames_sent++;
+        worker->totals.bytes_sent += size;
+    }
+    return result;
+}
+
+/**
+ * @brief Read the connection and time every completed echo
+ *
+ * @return 0, or a negative error code once the connection is unusable
+ */
+static int conn_read(bench_worker_t* worker, bench_conn_t* conn)
+{
+    xoe_packet_t packet;
+    uint64_t stamp_ns;
+    uint64_t now;
+    int result;
+
+    do {
+        result = xoe_wire_decoder_recv_transport(&conn->decoder,
+                                                 &conn->transport);
+        if (result == E_WOULD_BLOCK) {
+            break;
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_IO_ERROR : result;
+        }
+
+        now = latency_now_ns();
+        while ((result = xoe_wire_decoder_next(&conn->decoder, &packet)) == 1) {
+            if (packet.protocol_id == XOE_PROTOCOL_RAW &&
+                packet.payload != NULL &&
+                packet.payload->len >= sizeof(stamp_ns)) {
+                memcpy(&stamp_ns, packet.payload->data, sizeof(stamp_ns));
+                if (now > stamp_ns) {
+                    latency_record(LATENCY_BENCH_RTT, now - stamp_ns);
+                }
+                if (conn->in_flight > 0) {
+                    conn->in_flight--;
+                }
+                worker->totals.frames_received++;
+                worker->totals.bytes_received += packet.payload->len;
+            }
+            xoe_wire_free_payload(&packet);
+        }
+        if (result < 0) {
+            return result;
+        }
+    } while (xoe_transport_pending(&conn->transport));
+
+    return 0;
+}
+
+/* ============================================================================
+ * Worker Thread
+ * ============================================================================ */
+
+/**
+ * @brief Fill every connection up to the configured depth
+ */
+static void worker_send_unlimited(bench_worker_t* worker, uint64_t now)
+{
+    int depth = worker->run->config->depth;
+    bench_conn_t* conn;
+    int result;
+    int i;
+
+    for (i = 0; i < worker->conn_count; i++) {
+        conn = &worker->conns[i];
+        while (conn->active && conn->in_flight < depth) {
+            result = conn_send(worker, conn, now);
+            if (result != 0) {
+                conn_lost(worker, conn, result);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Send the frames scheduled up to @p now on connections with room
+ *
+ * Frames that find every connection at its depth stay due and are sent,
+ * with their scheduled stamp, as soon as an echo frees a slot.
+ */
+static void worker_send_paced(bench_worker_t* worker, uint64_t now,
+                              uint64_t* next_ns, int* cursor)
+{
+    uint64_t interval_ns = 1000000000ULL / worker->rate;
+    int depth = worker->run->config->depth;
+    bench_conn_t* conn = NULL;
+    int result;
+    int tried;
+
+    while (*next_ns <= now) {
+        for (tried = 0; tried < worker->conn_count; tried++) {
+            conn = &worker->conns[*cursor];
+            *cursor = (*cursor + 1) % worker->conn_count;
+            if (conn->active && conn->in_flight < depth) {
+                break;
+            }
+        }
+        if (tried == worker->conn_count) {
+            return;
+        }
+
+        result = conn_send(worker, conn, *next_ns);
+        if (result != 0) {
+            conn_lost(worker, conn, result);
+            continue;
+        }
+        *next_ns += interval_ns;
+    }
+}
+
+static void* worker_thread_func(void* arg)
+{
+    bench_worker_t* worker = (bench_worker_t*)arg;
+    bench_run_t* run = worker->run;
+    uint64_t next_ns = 0;
+    uint64_t now;
+    int cursor = 0;
+    int live;
+    int timeout_ms;
+    int ready;
+    int result;
+    int i;
+
+    /* Setup phase: connect sequentially, timing each connection */
+    for (i = 0; i < worker->conn_count &&
+                !__atomic_load_n(&run->finish, __ATOMIC_ACQUIRE); i++) {
+        result = conn_open(run, &worker->conns[i]);
+        if (result != 0) {
+            LOG_WARN("Bench connection %d failed: error code %d", i, result);
+            worker->totals.failed++;
+        } else {
+            worker->totals.connected++;
+        }
+    }
+
+    pthread_mutex_lock(&run->lock);
+    run->ready++;
+    run->active += worker->totals.connected;
+    pthread_cond_broadcast(&run->cond);
+    while (!run->go && !__atomic_load_n(&run->finish, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&run->cond, &run->lock);
+    }
+    next_ns = run->start_ns;
+    pthread_mutex_unlock(&run->lock);
+
+    /* Measured phase */
+    while (!__atomic_load_n(&run->finish, __ATOMIC_ACQUIRE)) {
+        now = latency_now_ns();
+        if (worker->rate == 0) {
+            worker_send_unlimited(worker, now);
+            timeout_ms = BENCH_POLL_MS;
+        } else {
+            worker_send_paced(worker, now, &next_ns, &cursor);
+            now = latency_now_ns();
+            /* Round down: within the last millisecond before a frame is
+             * due, busy-poll so it leaves on time (frames are stamped
+             * with their schedule, so lateness would count as RTT) */
+            timeout_ms = (next_ns > now)
+                         ? (int)((next_ns - now) / 1000000) : 0;
+            if (timeout_ms > BENCH_POLL_MS) {
+                timeout_ms = BENCH_POLL_MS;
+            }
+        }
+
+        live = 0;
+        for (i = 0; i < worker->conn_count; i++) {
+            worker->fds[i].fd = worker->conns[i].active
+                                ? worker->conns[i].fd : -1;
+            worker->fds[i].events = POLLIN;
+            live += worker->conns[i].active;
+        }
+        if (live == 0) {
+            break;
+        }
+
+        ready = poll(worker->fds, (nfds_t)worker->conn_count, timeout_ms);
+        if (ready < 0 && errno != EINTR) {
+            LOG_ERROR("poll failed: errno=%d: %s", errno, strerror(errno));
+            break;
+        }
+        for (i = 0; ready > 0 && i < worker->conn_count; i++) {
+            if (worker->conns[i].active &&
+                (worker->fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                result = conn_read(worker, &worker->conns[i]);
+                if (result != 0) {
+                    conn_lost(worker, &worker->conns[i], result);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Run Control
+ * ============================================================================ */
+
+/**
+ * @brief Number of worker threads for @p config
+ */
+static int worker_count(const bench_config_t* config)
+{
+    long cpus;
+    int threads = config->threads;
+
+    if (threads <= 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (cpus > 0) ? (int)cpus : 1;
+    }
+    if (threads > BENCH_MAX_THREADS) {
+        threads = BENCH_MAX_THREADS;
+    }
+    if (threads > config->connections) {
+        threads = config->connections;
+    }
+    /* Every paced worker needs a share of at least one frame per second */
+    if (config->rate > 0 && (uint32_t)threads > config->rate) {
+        threads = (int)config->rate;
+    }
+    return threads;
+}
+
+/**
+ * @brief Sleep for up to @p ms milliseconds
+ */
+static void sleep_ms(int ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+}
+
+void bench_config_init_defaults(bench_config_t* config)
+{
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->frame_size = BENCH_DEFAULT_FRAME_SIZE;
+    config->depth = BENCH_DEFAULT_DEPTH;
+    config->duration_ms = BENCH_DEFAULT_DURATION_MS;
+}
+
+int bench_config_validate(const bench_config_t* config)
+{
+    if (config == NULL ||
+        config->connections < 1 ||
+        config->connections > BENCH_MAX_CONNECTIONS ||
+        config->threads < 0 || config->threads > BENCH_MAX_THREADS ||
+        config->frame_size < BENCH_MIN_FRAME_SIZE ||
+        config->frame_size > BENCH_MAX_FRAME_SIZE ||
+        config->rate > BENCH_MAX_RATE ||
+        config->depth < 1 || config->depth > BENCH_MAX_DEPTH ||
+        config->duration_ms < 1 ||
+        config->duration_ms > BENCH_MAX_DURATION_MS) {
+        return E_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+int bench_client_run(const bench_config_t* config, const char* host, int port,
+                     const sock_tune_t* tune, void* tls_ctx,
+                     volatile sig_atomic_t* stop, bench_result_t* result)
+{
+    bench_run_t run;
+    bench_worker_t* workers;
+    bench_conn_t* conns;
+    struct pollfd* fds;
+    uint64_t deadline_ns;
+    int threads;
+    int started = 0;
+    int first = 0;
+    int share;
+    int active;
+    int i;
+
+    if (result == NULL || host == NULL ||
+        bench_config_validate(config) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    memset(result, 0, sizeof(*result));
+
+    threads = worker_count(config);
+    workers = (bench_worker_t*)calloc((size_t)threads, sizeof(bench_worker_t));
+    conns = (bench_conn_t*)calloc((size_t)config->connections,
+                                  sizeof(bench_conn_t));
+    fds = (struct pollfd*)calloc((size_t)config->connections,
+                                 sizeof(struct pollfd));
+    if (workers == NULL || conns == NULL || fds == NULL) {
+        free(workers);
+        free(conns);
+        free(fds);
+        return E_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < config->connections; i++) {
+        conns[i].fd = -1;
+    }
+
+    memset(&run, 0, sizeof(run));
+    run.config = config;
+    run.host = host;
+    run.port = port;
+    run.tune = tune;
+    run.tls_ctx = tls_ctx;
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.cond, NULL);
+
+    /* Split connections and rate as evenly as possible */
+    for (i = 0; i < threads; i++) {
+        bench_worker_t* worker = &workers[i];
+
+        share = config->connections / threads +
+                (i < config->connections % threads ? 1 : 0);
+        worker->run = &run;
+        worker->conns = &conns[first];
+        worker->fds = &fds[first];
+        worker->conn_count = share;
+        worker->rate = config->rate / (uint32_t)threads +
+                       ((uint32_t)i < config->rate % (uint32_t)threads ? 1 : 0);
+        first += share;
+
+        worker->frame = (uint8_t*)malloc(config->frame_size);
+        if (worker->frame == NULL) {
+            break;
+        }
+        memset(worker->frame, 0x5A, config->frame_size);
+
+        if (thread_sched_create(&worker->thread, THREAD_CLASS_NET,
+                                worker_thread_func, worker) != 0) {
+            free(worker->frame);
+            worker->frame = NULL;
+            break;
+        }
+        started++;
+    }
+
+    /* Wait until every worker has finished connecting (polled, so a stop
+     * request from a signal handler is noticed) */
+    if (started < threads) {
+        __atomic_store_n(&run.finish, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_lock(&run.lock);
+    while (run.ready < started &&
+           !__atomic_load_n(&run.finish, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&run.lock);
+        sleep_ms(BENCH_POLL_MS / 10);
+        if (stop != NULL && *stop) {
+            __atomic_store_n(&run.finish, 1, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_lock(&run.lock);
+    }
+    run.start_ns = latency_now_ns();
+    run.go = TRUE;
+    pthread_cond_broadcast(&run.cond);
+    pthread_mutex_unlock(&run.lock);
+
+    /* Measured run */
+    deadline_ns = run.start_ns + (uint64_t)config->duration_ms * 1000000ULL;
+    while (!__atomic_load_n(&run.finish, __ATOMIC_ACQUIRE) &&
+           !(stop != NULL && *stop) && latency_now_ns() < deadline_ns) {
+        pthread_mutex_lock(&run.lock);
+        active = run.active;
+        pthread_mutex_unlock(&run.lock);
+        if (active == 0) {
+            break;
+        }
+        sleep_ms(BENCH_POLL_MS / 10);
+    }
+    __atomic_store_n(&run.finish, 1, __ATOMIC_RELEASE);
+    result->elapsed_ns = latency_now_ns() - run.start_ns;
+
+    for (i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+        result->connected += workers[i].totals.connected;
+        result->failed += workers[i].totals.failed;
+        result->lost += workers[i].totals.lost;
+        result->frames_sent += workers[i].totals.frames_sent;
+        result->frames_received += workers[i].totals.frames_received;
+        result->bytes_sent += workers[i].totals.bytes_sent;
+        result->bytes_received += workers[i].totals.bytes_received;
+        free(workers[i].frame);
+    }
+    for (i = 0; i < config->connections; i++) {
+        conn_close(&conns[i]);
+    }
+
+    pthread_cond_destroy(&run.cond);
+    pthread_mutex_destroy(&run.lock);
+    free(fds);
+    free(conns);
+    free(workers);
+
+    if (started < threads) {
+        return E_OUT_OF_MEMORY;
+    }
+    return (result->connected > 0) ? 0 : E_NETWORK_ERROR;
+}
+
+/* ============================================================================
+ * Report
+ * ============================================================================ */
+
+/**
+ * @brief Print the percentiles of one latency histogram in milliseconds
+ */
+static void report_latency(FILE* out, const char* label, latency_id_t id)
+{
+    static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    static const char* const names[] = {"p50", "p90", "p99", "p99.9"};
+    latency_snapshot_t snapshot;
+    size_t i;
+
+    latency_snapshot(id, &snapshot);
+    if (snapshot.count == 0) {
+        fprintf(out, "%-9s no samples\n", label);
+        return;
+    }
+
+    fprintf(out, "%-9s", label);
+    for (i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        fprintf(out, " %s %.3f ms ", names[i],
+                (double)latency_percentile(&snapshot, quantiles[i]) / 1e6);
+    }
+    fprintf(out, " max %.3f ms\n", (double)snapshot.max_ns / 1e6);
+}
+
+void bench_client_report(FILE* out, const bench_config_t* config,
+                         const bench_result_t* result)
+{
+    thread_sched_t sched;
+    char threads[THREAD_SCHED_FORMAT_MAX];
+    double seconds;
+
+    if (out == NULL || config == NULL || result == NULL) {
+        return;
+    }
+    seconds = (double)result->elapsed_ns / 1e9;
+    if (seconds <= 0.0) {
+        seconds = 1e-9;
+    }
+
+    fprintf(out, "Bench: %d connections, %u-byte frames, depth %d, ",
+            config->connections, config->frame_size, config->depth);
+    if (config->rate > 0) {
+        fprintf(out, "target %u frames/s, ", config->rate);
+    } else {
+        fprintf(out, "unlimited rate, ");
+    }
+    fprintf(out, "%.2f s\n", seconds);
+
+    /* Scheduling the numbers were taken under (--sched net:...) */
+    thread_sched_get(&sched);
+    thread_sched_format(&sched, threads, sizeof(threads));
+    fprintf(out, "Threads:   %s%s\n", threads,
+            thread_sched_memory_locked() ? ", memory locked" : "");
+
+    fprintf(out, "Connections: %d up, %d failed, %d lost\n",
+            result->connected, result->failed, result->lost);
+    fprintf(out, "Sent:      %llu frames, %.0f frames/s, %.2f MB/s\n",
+            (unsigned long long)result->frames_sent,
+            (double)result->frames_sent / seconds,
+            (double)result->bytes_sent / seconds / 1e6);
+    fprintf(out, "Echoed:    %llu frames, %.0f frames/s, %.2f MB/s\n",
+            (unsigned long long)result->frames_received,
+            (double)result->frames_received / seconds,
+            (double)result->bytes_received / seconds / 1e6);
+    report_latency(out, "Setup:", LATENCY_BENCH_CONNECT);
+    report_latency(out, "RTT:", LATENCY_BENCH_RTT);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file bench_client.h
+ * @brief Echo load generator for capacity testing the server
+ *
+ * Opens a number of connections to an xoe server (plain or TLS), fires
+ * XOE_PROTOCOL_RAW frames at it and times the echoes. Connections are
+ * spread over worker threads, each running one poll loop. Every frame
+ * carries its send timestamp in the first 8 payload bytes, so the round
+ * trip is measured from the echo alone.
+ *
+ * Each connection keeps up to @c depth frames in flight. With a target
+ * rate, frames are scheduled at fixed intervals and stamped with their
+ * scheduled time rather than the time they actually left. A server that
+ * falls behind therefore shows up as RTT, instead of silently lowering
+ * the offered load (coordinated omission).
+ *
+ * Connection setup time (TCP connect plus TLS handshake) goes to the
+ * LATENCY_BENCH_CONNECT histogram and round trips to LATENCY_BENCH_RTT
+ * (see lib/common/latency.h), from which bench_client_report() prints
+ * percentiles.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef BENCH_CLIENT_H
+#define BENCH_CLIENT_H
+
+#include <stdio.h>
+#include <signal.h>
+
+#include "lib/common/types.h"
+#include "lib/net/sock_tune.h"
+
+/* Defaults for the --bench-* options */
+#define BENCH_DEFAULT_FRAME_SIZE 64
+#define BENCH_DEFAULT_DEPTH 1
+#define BENCH_DEFAULT_DURATION_MS 10000
+
+/* Limits (the frame carries an 8-byte timestamp) */
+#define BENCH_MIN_FRAME_SIZE 8
+#define BENCH_MAX_FRAME_SIZE (1024 * 1024)
+#define BENCH_MAX_CONNECTIONS 1024
+#define BENCH_MAX_DEPTH 1024
+#define BENCH_MAX_RATE 10000000
+#define BENCH_MAX_DURATION_MS (24 * 3600 * 1000)
+#define BENCH_MAX_THREADS 64
+
+/**
+ * @brief What to run
+ */
+typedef struct {
+    int connections;            /* Concurrent connections */
+    int threads;                /* Worker threads (0 = one per CPU, at
+                                   most one per connection) */
+    uint32_t frame_size;        /* Payload bytes per frame */
+    uint32_t rate;              /* Frames per second, all connections
+                                   together (0 = as fast as possible) */
+    int depth;                  /* Frames in flight per connection */
+    int duration_ms;            /* Measured run time */
+} bench_config_t;
+
+/**
+ * @brief Totals of a run
+ */
+typedef struct {
+    int connected;              /* Connections set up */
+    int failed;                 /* Connections that could not be set up */
+    int lost;                   /* Connections closed during the run */
+    uint64_t frames_sent;
+    uint64_t frames_received;
+    uint64_t bytes_sent;        /* Payload bytes */
+    uint64_t bytes_received;
+    uint64_t elapsed_ns;        /* Measured run time */
+} bench_result_t;
+
+/**
+ * @brief Fill @p config with the defaults (and 0 connections)
+ */
+void bench_config_init_defaults(bench_config_t* config);
+
+/**
+ * @brief Check every field against its limit
+ *
+ * @return 0 if valid, E_INVALID_ARGUMENT otherwise
+ */
+int bench_config_validate(const bench_config_t* config);
+
+/**
+ * @brief Connect, run for the configured time and collect the totals
+ *
+ * All connections are set up before the measured run starts. Returns
+ * early once @p stop becomes non-zero (e.g. from a SIGINT handler) or
+ * every connection is lost.
+ *
+ * @param config    What to run
+ * @param host      Server host name or address
+ * @param port      Server port
+ * @param tune      Socket options for every connection (may be NULL)
+ * @param tls_ctx   Client SSL_CTX* for TLS connections, NULL for plain TCP
+ * @param stop      Stop request flag (may be NULL)
+ * @param result    Receives the totals
+ *
+ * @return 0 if the run took place (individual connection failures are
+ *         counted in @p result), E_INVALID_ARGUMENT, E_NETWORK_ERROR if
+ *         no connection could be set up, E_OUT_OF_MEMORY
+ */
+int bench_client_run(const bench_config_t* config, const char* host, int port,
+                     const sock_tune_t* tune, void* tls_ctx,
+                     volatile sig_atomic_t* stop, bench_result_t* result);
+
+/**
+ * @brief Print throughput, setup/RTT percentiles and the thread scheduling
+ *        of a run
+ */
+void bench_client_report(FILE* out, const bench_config_t* config,
+                         const bench_result_t* result);
+
+#endif /* BENCH_CLIENT_H */
@@ -0,0 +1,1490 @@
+/**
+ * cluster.c
+ *
+ * Links between the nodes of a cluster, what each node announced over
+ * them, and the relays that use it (see cluster.h).
+ *
+ * One thread accepts links from the peers' addresses, reads every link
+ * and sends the snapshots a link is behind on; another resolves and
+ * dials the configured peers. Frames leave
+ * through one usb_send_queue_t per link, drained by the cluster's own
+ * writer. Senders take a reference to a link under the cluster lock and
+ * push after dropping it; the last reference closes the socket, so a
+ * queued frame is never written to a descriptor already reused.
+ *
+ * Routes (device_id to node) have a lock of their own, held shared by
+ * every forwarded URB. Lock order: registry or hub lock, then cluster
+ * lock, then route lock; the cluster never calls into the USB server or
+ * the hub with a lock of its own held.
+ *
+ * [LLM-ARCH]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "core/cluster.h"
+#include "connectors/serial/serial_hub.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/thread_sched.h"
+#include "lib/net/net_resolve.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/security/usb_auth.h"
+
+/* Route table buckets (power of two) */
+#define CLUSTER_ROUTE_BUCKETS 256
+
+/**
+ * cluster_link_t - A TCP link to another node
+ */
+typedef struct {
+    int fd;
+    int peer;                       /* Configured peer it dials, or -1 */
+    int hello_node;                 /* Named in the other end's HELLO */
+    int node_id;                    /* 0 until the other end's AUTH */
+    int refs;                       /* The table's and senders' */
+    int dead;                       /* Failed; the thread closes it */
+    uint64_t hello_deadline_ms;
+    uint8_t challenge[USB_AUTH_CHALLENGE_LEN]; /* Sent in our HELLO */
+    unsigned long device_version;   /* Snapshots it carried */
+    unsigned long topic_version;
+    usb_send_queue_t *queue;
+    xoe_wire_decoder_t decoder;     /* Used by the link thread only */
+} cluster_link_t;
+
+/**
+ * cluster_node_t - Another node with at least one link up
+ */
+typedef struct {
+    int node_id;
+    int links;
+    int topic_count;
+    char (*topics)[SERIAL_HUB_TOPIC_MAX + 1];
+} cluster_node_t;
+
+typedef struct cluster_route {
+    struct cluster_route *next;
+    uint32_t device_id;
+    int node_id;
+} cluster_route_t;
+
+struct cluster {
+    cluster_config_t config;
+    usb_auth_key_t *key;            /* Keyed with the shared secret */
+    usb_server_t *usb;
+    int fd;                         /* Link listener */
+    int port;
+    int wake[2];                    /* Pipe: snapshot due, stop */
+    int dial_wake[2];               /* Pipe: stop the dialer */
+    int stop;
+    pthread_t thread;
+    pthread_t dial_thread;
+    int dial_started;
+    usb_send_writer_t writer;
+
+    pthread_mutex_t lock;           /* Everything below but routes */
+    cluster_link_t *links[CLUSTER_MAX_LINKS];
+    int link_count;
+    cluster_node_t nodes[CLUSTER_MAX_LINKS];
+    int node_count;
+    int peer_linked[CLUSTER_MAX_PEERS];
+    int peer_self[CLUSTER_MAX_PEERS]; /* Dialed this node: never again */
+    struct in_addr peer_addrs[CLUSTER_MAX_PEERS]; /* Links accepted from */
+    int peer_resolved[CLUSTER_MAX_PEERS];
+    unsigned long device_version;   /* Bumped on every change */
+    unsigned long topic_version;
+
+    pthread_rwlock_t route_lock;
+    cluster_route_t *routes[CLUSTER_ROUTE_BUCKETS];
+};
+
+static void wake(int fd)
+{
+    char byte = 0;
+
+    /* A full pipe already holds a wakeup */
+    if (write(fd, &byte, 1) < 0 && errno != EAGAIN) {
+        perror("cluster: wake");
+    }
+}
+
+static void drain(int fd)
+{
+    char buffer[64];
+
+    while (read(fd, buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+/**
+ * open_pipe - Non-blocking pipe
+ */
+static int open_pipe(int fds[2])
+{
+    if (pipe(fds) != 0) {
+        fds[0] = -1;
+        fds[1] = -1;
+        return -1;
+    }
+    if (fd_set_nonblocking(fds[0]) != 0 || fd_set_nonblocking(fds[1]) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        fds[0] = -1;
+        fds[1] = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int cluster_parse_peer(const char *spec, char *host, size_t host_len,
+                       int *port)
+{
+    const char *colon;
+    char *end;
+    long value;
+    size_t len;
+
+    if (spec == NULL || host == NULL || port == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    colon = strrchr(spec, ':');
+    if (colon == NULL || colon == spec || colon[1] == '\0') {
+        return E_INVALID_ARGUMENT;
+    }
+    errno = 0;
+    value = strtol(colon + 1, &end, 10);
+    if (errno != 0 || *end != '\0' || value < 1 || value > 65535) {
+        return E_INVALID_ARGUMENT;
+    }
+    len = (size_t)(colon - spec);
+    if (len >= host_len) {
+        return E_INVALID_ARGUMENT;
+    }
+    memcpy(host, spec, len);
+    host[len] = '\0';
+    *port = (int)value;
+    return 0;
+}
+
+int cluster_load_secret(const char *path, cluster_config_t *config)
+{
+    char line[USB_AUTH_SECRET_MAX + 2];
+    FILE *file;
+    size_t len;
+
+    if (path == NULL || config == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    file = fopen(path, "r");
+    if (file == NULL) {
+        return E_FILE_NOT_FOUND;
+    }
+    if (fgets(line, sizeof(line), file) == NULL) {
+        line[0] = '\0';
+    }
+    fclose(file);
+
+    len = strcspn(line, "\r\n");
+    line[len] = '\0';
+    if (len == 0 || len >= USB_AUTH_SECRET_MAX) {
+        memset(line, 0, sizeof(line));
+        return E_INVALID_ARGUMENT;
+    }
+    memcpy(config->secret, line, len + 1);
+    memset(line, 0, sizeof(line));
+    return 0;
+}
+
+/* ============================================================================
+ * Frames
+ * ============================================================================ */
+
+/**
+ * message_alloc - Pooled payload of a cluster frame, header filled in
+ */
+static xoe_payload_t *message_alloc(const cluster_t *cluster, int type,
+                                    uint32_t body_len)
+{
+    xoe_payload_t *payload;
+    uint8_t *data;
+
+    payload = xoe_payload_alloc(CLUSTER_HEADER_SIZE + body_len);
+    if (payload == NULL) {
+        return NULL;
+    }
+    data = (uint8_t *)payload->data;
+    data[0] = (uint8_t)type;
+    data[1] = 0;
+    data[2] = (uint8_t)(cluster->config.node_id >> 8);
+    data[3] = (uint8_t)cluster->config.node_id;
+    return payload;
+}
+
+static void message_packet(xoe_payload_t *payload, xoe_packet_t *packet)
+{
+    memset(packet, 0, sizeof(*packet));
+    packet->protocol_id = XOE_PROTOCOL_CLUSTER;
+    packet->protocol_version = CLUSTER_VERSION;
+    packet->payload = payload;
+}
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/**
+ * devices_message - Snapshot of the device_ids registered here
+ *
+ * Returns: Payload, or NULL if out of memory
+ */
+static xoe_payload_t *devices_message(cluster_t *cluster)
+{
+    xoe_payload_t *payload;
+    uint32_t *ids;
+    int count = 0;
+    int i;
+
+    ids = (uint32_t *)malloc(CLUSTER_MAX_DEVICES * sizeof(uint32_t));
+    if (ids == NULL) {
+        return NULL;
+    }
+    if (cluster->usb != NULL) {
+        count = usb_server_device_ids(cluster->usb, ids, CLUSTER_MAX_DEVICES);
+        if (count < 0) {
+            count = 0;
+        }
+    }
+
+    payload = message_alloc(cluster, CLUSTER_MSG_DEVICES, (uint32_t)count * 4);
+    if (payload != NULL) {
+        for (i = 0; i < count; i++) {
+            put_u32((uint8_t *)payload->data + CLUSTER_HEADER_SIZE + i * 4,
+                    ids[i]);
+        }
+    }
+    free(ids);
+    return payload;
+}
+
+/**
+ * topics_message - Snapshot of the hub topics with members here
+ *
+ * Returns: Payload, or NULL if out of memory
+ */
+static xoe_payload_t *topics_message(cluster_t *cluster)
+{
+    char (*names)[SERIAL_HUB_TOPIC_MAX + 1];
+    xoe_payload_t *payload;
+    uint8_t *p;
+    uint32_t len = 0;
+    int count;
+    int i;
+
+    names = malloc(CLUSTER_MAX_TOPICS * sizeof(*names));
+    if (names == NULL) {
+        return NULL;
+    }
+    count = serial_hub_topic_names(names, CLUSTER_MAX_TOPICS);
+    for (i = 0; i < count; i++) {
+        len += 1 + (uint32_t)strlen(names[i]);
+    }
+
+    payload = message_alloc(cluster, CLUSTER_MSG_TOPICS, len);
+    if (payload != NULL) {
+        p = (uint8_t *)payload->data + CLUSTER_HEADER_SIZE;
+        for (i = 0; i < count; i++) {
+            *p = (uint8_t)strlen(names[i]);
+            memcpy(p + 1, names[i], *p);
+            p += 1 + *p;
+        }
+    }
+    free(names);
+    return payload;
+}
+
+/* ============================================================================
+ * Links
+ * ============================================================================ */
+
+/**
+ * link_free - Close a link no one references any more
+ */
+static void link_free(cluster_link_t *link)
+{
+    /* Once released, the writer no longer touches the socket */
+    usb_send_queue_release(link->queue);
+    close(link->fd);
+    free(link);
+}
+
+/**
+ * link_put - Drop a reference taken with link_get()
+ */
+static void link_put(cluster_t *cluster, cluster_link_t *link)
+{
+    int last;
+
+    pthread_mutex_lock(&cluster->lock);
+    last = (--link->refs == 0);
+    pthread_mutex_unlock(&cluster->lock);
+
+    if (last) {
+        link_free(link);
+    }
+}
+
+/**
+ * link_push - Queue a frame on a link, failing it on a socket error
+ *
+ * Takes packet->payload in every case.
+ */
+static int link_push(cluster_t *cluster, cluster_link_t *link,
+                     xoe_packet_t *packet, int relay, unsigned int stall_ms)
+{
+    int result;
+
+    result = usb_send_queue_push(link->queue, packet, relay, stall_ms);
+    if (result == E_NETWORK_ERROR || result == E_INVALID_STATE) {
+        pthread_mutex_lock(&cluster->lock);
+        link->dead = TRUE;
+        pthread_mutex_unlock(&cluster->lock);
+        wake(cluster->wake[1]);
+    }
+    return result;
+}
+
+/**
+ * node_find - Node entry of @node_id (cluster locked)
+ */
+static cluster_node_t *node_find(cluster_t *cluster, int node_id)
+{
+    int i;
+
+    for (i = 0; i < cluster->node_count; i++) {
+        if (cluster->nodes[i].node_id == node_id) {
+            return &cluster->nodes[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * link_get - Take a reference to a link up to @node_id
+ *
+ * Returns: Link (drop with link_put()), or NULL if none is up
+ */
+static cluster_link_t *link_get(cluster_t *cluster, int node_id)
+{
+    cluster_link_t *link = NULL;
+    int i;
+
+    pthread_mutex_lock(&cluster->lock);
+    for (i = 0; i < cluster->link_count; i++) {
+        if (cluster->links[i]->node_id == node_id &&
+            !cluster->links[i]->dead) {
+            link = cluster->links[i];
+            link->refs++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    return link;
+}
+
+/**
+ * link_open - Put a connected socket in the table and send our HELLO
+ * @peer: Configured peer it was dialed for, or -1 if accepted
+ *
+ * Returns: 0, or a negative error code (@fd is closed)
+ */
+static int link_open(cluster_t *cluster, int fd, int peer)
+{
+    cluster_link_t *link;
+    xoe_payload_t *hello;
+    xoe_packet_t packet;
+
+    link = (cluster_link_t *)calloc(1, sizeof(cluster_link_t));
+    if (link == NULL || fd_set_nonblocking(fd) != 0 ||
+        xoe_wire_decoder_init(&link->decoder, 0) != 0) {
+        free(link);
+        close(fd);
+        return E_OUT_OF_MEMORY;
+    }
+    link->fd = fd;
+    link->peer = peer;
+    link->refs = 1;
+    link->hello_deadline_ms = latency_now_ms() + CLUSTER_HELLO_MS;
+    link->queue = usb_send_queue_create(&cluster->writer, fd);
+    hello = message_alloc(cluster, CLUSTER_MSG_HELLO, USB_AUTH_CHALLENGE_LEN);
+    if (link->queue == NULL || hello == NULL ||
+        usb_auth_generate_challenge(link->challenge) != 0) {
+        xoe_payload_release(hello);
+        xoe_wire_decoder_cleanup(&link->decoder);
+        link_free(link);
+        return E_OUT_OF_MEMORY;
+    }
+    memcpy((uint8_t *)hello->data + CLUSTER_HEADER_SIZE, link->challenge,
+           USB_AUTH_CHALLENGE_LEN);
+    message_packet(hello, &packet);
+    (void)usb_send_queue_push(link->queue, &packet, FALSE, 0);
+
+    pthread_mutex_lock(&cluster->lock);
+    if (cluster->link_count == CLUSTER_MAX_LINKS || cluster->stop) {
+        pthread_mutex_unlock(&cluster->lock);
+        xoe_wire_decoder_cleanup(&link->decoder);
+        link_free(link);
+        return E_BUFFER_TOO_SMALL;
+    }
+    cluster->links[cluster->link_count++] = link;
+    if (peer >= 0) {
+        cluster->peer_linked[peer] = TRUE;
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    wake(cluster->wake[1]);
+    return 0;
+}
+
+/**
+ * routes_drop - Free the routes of a node (route lock held for writing)
+ */
+static void routes_drop(cluster_t *cluster, int node_id)
+{
+    cluster_route_t **link;
+    cluster_route_t *route;
+    int i;
+
+    for (i = 0; i < CLUSTER_ROUTE_BUCKETS; i++) {
+        link = &cluster->routes[i];
+        while (*link != NULL) {
+            route = *link;
+            if (route->node_id == node_id) {
+                *link = route->next;
+                free(route);
+            } else {
+                link = &route->next;
+            }
+        }
+    }
+}
+
+/**
+ * forget_node - Drop what a node announced (route lock not held)
+ */
+static void forget_node(cluster_t *cluster, int node_id)
+{
+    pthread_rwlock_wrlock(&cluster->route_lock);
+    routes_drop(cluster, node_id);
+    pthread_rwlock_unlock(&cluster->route_lock);
+}
+
+/**
+ * link_close - Take a link out of the table (link thread)
+ * @why: Reason logged, or NULL to close silently
+ */
+static void link_close(cluster_t *cluster, cluster_link_t *link,
+                       const char *why)
+{
+    cluster_node_t *node;
+    int forget = 0;
+    int last;
+    int i;
+
+    pthread_mutex_lock(&cluster->lock);
+    for (i = 0; i < cluster->link_count; i++) {
+        if (cluster->links[i] == link) {
+            cluster->links[i] = cluster->links[--cluster->link_count];
+            break;
+        }
+    }
+    if (link->peer >= 0) {
+        cluster->peer_linked[link->peer] = FALSE;
+    }
+    node = (link->node_id != 0) ? node_find(cluster, link->node_id) : NULL;
+    if (node != NULL && --node->links == 0) {
+        forget = node->node_id;
+        free(node->topics);
+        *node = cluster->nodes[--cluster->node_count];
+    }
+    last = (--link->refs == 0);
+    pthread_mutex_unlock(&cluster->lock);
+
+    if (why != NULL) {
+        if (link->node_id != 0) {
+            LOG_WARN("Cluster: link to node %d %s", link->node_id, why);
+        } else {
+            LOG_WARN("Cluster: link %s", why);
+        }
+    }
+    if (forget != 0) {
+        forget_node(cluster, forget);
+    }
+
+    /* Stop further pushes from writing to the socket */
+    shutdown(link->fd, SHUT_RDWR);
+    xoe_wire_decoder_cleanup(&link->decoder);
+    if (last) {
+        link_free(link);
+    }
+}
+
+/* ============================================================================
+ * Receiving
+ * ============================================================================ */
+
+/**
+ * handle_hello - The other end named its node: answer its challenge
+ *
+ * Returns: 0, or a negative error code to close the link
+ */
+static int handle_hello(cluster_t *cluster, cluster_link_t *link,
+                        int node_id, const uint8_t *body, uint32_t len)
+{
+    xoe_payload_t *auth;
+    xoe_packet_t packet;
+    uint8_t *answer;
+    int role;
+
+    if (link->hello_node != 0 || node_id == 0 ||
+        len != USB_AUTH_CHALLENGE_LEN) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    role = (link->peer >= 0) ? CLUSTER_ROLE_DIALER : CLUSTER_ROLE_ACCEPTOR;
+    auth = message_alloc(cluster, CLUSTER_MSG_AUTH, USB_AUTH_RESPONSE_LEN);
+    if (auth == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    answer = (uint8_t *)auth->data + CLUSTER_HEADER_SIZE;
+    if (usb_auth_key_compute(cluster->key, body,
+                             (uint32_t)cluster->config.node_id, (uint8_t)role,
+                             answer) != 0) {
+        xoe_payload_release(auth);
+        return E_OUT_OF_MEMORY;
+    }
+    link->hello_node = node_id;
+
+    /* A failed push marks the link dead */
+    message_packet(auth, &packet);
+    (void)link_push(cluster, link, &packet, FALSE, 0);
+    return 0;
+}
+
+/**
+ * handle_auth - Check the other end's answer to our challenge
+ *
+ * Returns: 0 once the link is up, or a negative error code to close it
+ */
+static int handle_auth(cluster_t *cluster, cluster_link_t *link,
+                       const uint8_t *body, uint32_t len)
+{
+    cluster_node_t *node;
+    int role;
+
+    if (link->hello_node == 0 || link->node_id != 0 ||
+        len != USB_AUTH_RESPONSE_LEN) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    /* The other end holds the opposite role */
+    role = (link->peer >= 0) ? CLUSTER_ROLE_ACCEPTOR : CLUSTER_ROLE_DIALER;
+    if (usb_auth_key_verify(cluster->key, link->challenge,
+                            (uint32_t)link->hello_node, (uint8_t)role,
+                            body) != 1) {
+        return E_PERMISSION_DENIED;
+    }
+
+    /* Only an answer keyed with the secret proves a link reached itself */
+    if (link->hello_node == cluster->config.node_id) {
+        pthread_mutex_lock(&cluster->lock);
+        if (link->peer >= 0) {
+            cluster->peer_self[link->peer] = TRUE;
+        }
+        pthread_mutex_unlock(&cluster->lock);
+        LOG_WARN("Cluster: a link reached this node (%s, or node id %d "
+                 "used twice)",
+                 (link->peer >= 0) ? cluster->config.peers[link->peer] :
+                                     "inbound", link->hello_node);
+        return E_PROTOCOL_ERROR;
+    }
+
+    pthread_mutex_lock(&cluster->lock);
+    node = node_find(cluster, link->hello_node);
+    if (node == NULL) {
+        node = &cluster->nodes[cluster->node_count++];
+        memset(node, 0, sizeof(*node));
+        node->node_id = link->hello_node;
+    }
+    node->links++;
+    link->node_id = link->hello_node;
+    pthread_mutex_unlock(&cluster->lock);
+
+    LOG_INFO("Cluster: link to node %d up", link->node_id);
+    return 0;
+}
+
+/**
+ * handle_devices - Replace the routes a node announced
+ *
+ * The new routes are all allocated before the old ones go, so a snapshot
+ * that does not fit in memory leaves the previous one in place.
+ */
+static int handle_devices(cluster_t *cluster, int node_id,
+                          const uint8_t *body, uint32_t len)
+{
+    cluster_route_t *added = NULL;
+    cluster_route_t *route;
+    uint32_t bucket;
+    uint32_t i;
+
+    if (len % 4 != 0 || len / 4 > CLUSTER_MAX_DEVICES) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    for (i = 0; i < len; i += 4) {
+        route = (cluster_route_t *)malloc(sizeof(cluster_route_t));
+        if (route == NULL) {
+            while (added != NULL) {
+                route = added;
+                added = route->next;
+                free(route);
+            }
+            LOG_WARN("Cluster: no memory for node %d's devices, keeping "
+                     "the previous ones", node_id);
+            return 0;
+        }
+        route->device_id = get_u32(body + i);
+        route->node_id = node_id;
+        route->next = added;
+        added = route;
+    }
+
+    pthread_rwlock_wrlock(&cluster->route_lock);
+    routes_drop(cluster, node_id);
+    while (added != NULL) {
+        route = added;
+        added = route->next;
+        bucket = route->device_id & (CLUSTER_ROUTE_BUCKETS - 1);
+        route->next = cluster->routes[bucket];
+        cluster->routes[bucket] = route;
+    }
+    pthread_rwlock_unlock(&cluster->route_lock);
+
+    return 0;
+}
+
+/**
+ * handle_topics - Replace the topics a node announced
+ */
+static int handle_topics(cluster_t *cluster, int node_id,
+                         const uint8_t *body, uint32_t len)
+{
+    char (*topics)[SERIAL_HUB_TOPIC_MAX + 1];
+    cluster_node_t *node;
+    uint32_t offset = 0;
+    int count = 0;
+
+    topics = malloc(CLUSTER_MAX_TOPICS * sizeof(*topics));
+    if (topics == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    while (offset < len && count < CLUSTER_MAX_TOPICS) {
+        if (body[offset] == 0 || body[offset] > SERIAL_HUB_TOPIC_MAX ||
+            offset + 1 + body[offset] > len) {
+            free(topics);
+            return E_PROTOCOL_ERROR;
+        }
+        memcpy(topics[count], body + offset + 1, body[offset]);
+        topics[count][body[offset]] = '\0';
+        count++;
+        offset += 1 + body[offset];
+    }
+
+    pthread_mutex_lock(&cluster->lock);
+    node = node_find(cluster, node_id);
+    if (node != NULL) {
+        free(node->topics);
+        node->topics = topics;
+        node->topic_count = count;
+        topics = NULL;
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    free(topics);
+    return 0;
+}
+
+/**
+ * handle_serial - Deliver a hub frame from another node
+ */
+static int handle_serial(const uint8_t *body, uint32_t len)
+{
+    char topic[SERIAL_HUB_TOPIC_MAX + 1];
+    xoe_payload_t view;
+    xoe_packet_t packet;
+    uint32_t name_len;
+
+    if (len < 2 || body[1] == 0 || body[1] > SERIAL_HUB_TOPIC_MAX ||
+        len < 2 + (uint32_t)body[1] + 2) {
+        return E_PROTOCOL_ERROR;
+    }
+    name_len = body[1];
+    memcpy(topic, body + 2, name_len);
+    topic[name_len] = '\0';
+
+    /* The hub copies a payload from outside the pool once */
+    view.data = (void *)(body + 2 + name_len + 2);
+    view.len = len - (2 + name_len + 2);
+    view.owns_data = FALSE;
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_SERIAL;
+    packet.protocol_version = (uint16_t)((body[2 + name_len] << 8) |
+                                         body[2 + name_len + 1]);
+    packet.payload = &view;
+
+    return (serial_hub_deliver(topic, body[0], &packet) < 0) ?
+           E_OUT_OF_MEMORY : 0;
+}
+
+/**
+ * handle_frame - One frame read from a link
+ *
+ * Returns: 0, or a negative error code to close the link
+ */
+static int handle_frame(cluster_t *cluster, cluster_link_t *link,
+                        xoe_packet_t *packet)
+{
+    const uint8_t *data;
+    uint32_t len;
+
+    if (packet->protocol_id == XOE_PROTOCOL_USB && link->node_id != 0) {
+        if (cluster->usb != NULL) {
+            (void)usb_server_deliver(cluster->usb, packet);
+        }
+        return 0;
+    }
+
+    if (packet->protocol_id != XOE_PROTOCOL_CLUSTER ||
+        packet->protocol_version != CLUSTER_VERSION ||
+        packet->payload == NULL ||
+        packet->payload->len < CLUSTER_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+    data = (const uint8_t *)packet->payload->data;
+    len = packet->payload->len - CLUSTER_HEADER_SIZE;
+
+    if (data[0] == CLUSTER_MSG_HELLO) {
+        return handle_hello(cluster, link, (data[2] << 8) | data[3],
+                            data + CLUSTER_HEADER_SIZE, len);
+    }
+    if (data[0] == CLUSTER_MSG_AUTH) {
+        return handle_auth(cluster, link, data + CLUSTER_HEADER_SIZE, len);
+    }
+    if (link->node_id == 0) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    switch (data[0]) {
+    case CLUSTER_MSG_DEVICES:
+        return handle_devices(cluster, link->node_id,
+                              data + CLUSTER_HEADER_SIZE, len);
+    case CLUSTER_MSG_TOPICS:
+        return handle_topics(cluster, link->node_id,
+                             data + CLUSTER_HEADER_SIZE, len);
+    case CLUSTER_MSG_SERIAL:
+        return handle_serial(data + CLUSTER_HEADER_SIZE, len);
+    default:
+        /* Newer frame types are skipped */
+        return 0;
+    }
+}
+
+/**
+ * link_read - Read what a link has and handle every frame in it
+ *
+ * Returns: 0, or a negative error code (0 from the socket: E_IO_ERROR)
+ */
+static int link_read(cluster_t *cluster, cluster_link_t *link)
+{
+    xoe_packet_t packet;
+    int result;
+
+    result = xoe_wire_decoder_recv(&link->decoder, link->fd);
+    if (result == E_WOULD_BLOCK) {
+        return 0;
+    }
+    if (result <= 0) {
+        return E_IO_ERROR;
+    }
+
+    while ((result = xoe_wire_decoder_next(&link->decoder, &packet)) == 1) {
+        result = handle_frame(cluster, link, &packet);
+        xoe_wire_free_payload(&packet);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return result;
+}
+
+/* ============================================================================
+ * Link thread
+ * ============================================================================ */
+
+/**
+ * peer_allowed - Whether @from is an address a configured peer resolved to
+ */
+static int peer_allowed(cluster_t *cluster, const struct sockaddr_in *from)
+{
+    int allowed = FALSE;
+    int i;
+
+    pthread_mutex_lock(&cluster->lock);
+    for (i = 0; i < cluster->config.peer_count; i++) {
+        if (cluster->peer_resolved[i] &&
+            cluster->peer_addrs[i].s_addr == from->sin_addr.s_addr) {
+            allowed = TRUE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    return allowed;
+}
+
+/**
+ * accept_links - Accept every pending connection from a peer's address
+ */
+static void accept_links(cluster_t *cluster)
+{
+    char ip[INET_ADDRSTRLEN];
+    struct sockaddr_in from;
+    socklen_t len = sizeof(from);
+    int fd;
+
+    while ((fd = accept(cluster->fd, (struct sockaddr *)&from, &len)) >= 0) {
+        if (len != sizeof(from) || !peer_allowed(cluster, &from)) {
+            if (inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip)) == NULL) {
+                strcpy(ip, "?");
+            }
+            LOG_WARN("Cluster: refused a link from %s, not a --cluster-peer",
+                     ip);
+            close(fd);
+        } else if (link_open(cluster, fd, -1) == E_BUFFER_TOO_SMALL) {
+            LOG_WARN("Cluster: %d links open, refusing another",
+                     CLUSTER_MAX_LINKS);
+        }
+        len = sizeof(from);
+    }
+}
+
+/**
+ * sync_links - Send every link the snapshots it is behind on
+ */
+static void sync_links(cluster_t *cluster)
+{
+    cluster_link_t *due[CLUSTER_MAX_LINKS];
+    xoe_payload_t *devices = NULL;
+    xoe_payload_t *topics = NULL;
+    xoe_packet_t packet;
+    unsigned long device_version;
+    unsigned long topic_version;
+    int count = 0;
+    int i;
+
+    pthread_mutex_lock(&cluster->lock);
+    device_version = cluster->device_version;
+    topic_version = cluster->topic_version;
+    for (i = 0; i < cluster->link_count; i++) {
+        if (cluster->links[i]->node_id != 0 && !cluster->links[i]->dead &&
+            (cluster->links[i]->device_version != device_version ||
+             cluster->links[i]->topic_version != topic_version)) {
+            due[count++] = cluster->links[i];
+        }
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    /* Only this thread closes links, so the pointers stay valid */
+    for (i = 0; i < count; i++) {
+        if (due[i]->device_version != device_version) {
+            if (devices == NULL) {
+                devices = devices_message(cluster);
+            }
+            if (devices != NULL) {
+                message_packet(xoe_payload_ref(devices), &packet);
+                if (link_push(cluster, due[i], &packet, FALSE, 0) == 0) {
+                    due[i]->device_version = device_version;
+                }
+            }
+        }
+        if (due[i]->topic_version != topic_version) {
+            if (topics == NULL) {
+                topics = topics_message(cluster);
+            }
+            if (topics != NULL) {
+                message_packet(xoe_payload_ref(topics), &packet);
+                if (link_push(cluster, due[i], &packet, FALSE, 0) == 0) {
+                    due[i]->topic_version = topic_version;
+                }
+            }
+        }
+    }
+
+    xoe_payload_release(devices);
+    xoe_payload_release(topics);
+}
+
+static void *cluster_thread(void *arg)
+{
+    cluster_t *cluster = (cluster_t *)arg;
+    struct pollfd fds[CLUSTER_MAX_LINKS + 2];
+    cluster_link_t *polled[CLUSTER_MAX_LINKS];
+    cluster_link_t *link;
+    uint64_t now;
+    int count;
+    int result;
+    int dead;
+    int i;
+
+    while (1) {
+        pthread_mutex_lock(&cluster->lock);
+        if (cluster->stop) {
+            pthread_mutex_unlock(&cluster->lock);
+            break;
+        }
+        count = cluster->link_count;
+        for (i = 0; i < count; i++) {
+            polled[i] = cluster->links[i];
+        }
+        pthread_mutex_unlock(&cluster->lock);
+
+        fds[0].fd = cluster->wake[0];
+        fds[0].events = POLLIN;
+        fds[1].fd = cluster->fd;
+        fds[1].events = POLLIN;
+        for (i = 0; i < count; i++) {
+            fds[i + 2].fd = polled[i]->fd;
+            fds[i + 2].events = POLLIN;
+            fds[i + 2].revents = 0;
+        }
+
+        if (poll(fds, (nfds_t)(count + 2), CLUSTER_TICK_MS) < 0 &&
+            errno != EINTR) {
+            perror("cluster: poll");
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            drain(cluster->wake[0]);
+        }
+        if (fds[1].revents & POLLIN) {
+            accept_links(cluster);
+        }
+
+        now = latency_now_ms();
+        for (i = 0; i < count; i++) {
+            link = polled[i];
+            result = 0;
+            if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+                result = link_read(cluster, link);
+            }
+            pthread_mutex_lock(&cluster->lock);
+            dead = link->dead;
+            pthread_mutex_unlock(&cluster->lock);
+            if (result != 0) {
+                link_close(cluster, link,
+                           (result == E_IO_ERROR) ? "closed" :
+                           (result == E_PERMISSION_DENIED) ?
+                           "failed authentication" :
+                           "dropped on a bad frame");
+            } else if (dead) {
+                link_close(cluster, link, "failed");
+            } else if (link->node_id == 0 && now >= link->hello_deadline_ms) {
+                link_close(cluster, link, "did not authenticate in time");
+            }
+        }
+
+        sync_links(cluster);
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Dialer
+ * ============================================================================ */
+
+/**
+ * peer_resolve - Look a peer up, for dialing it and accepting its links
+ *
+ * A failed lookup keeps the address found before.
+ *
+ * Returns: 0 with @address set, or E_DNS_ERROR
+ */
+static int peer_resolve(cluster_t *cluster, int peer,
+                        struct sockaddr_in *address)
+{
+    char host[CLUSTER_PEER_MAX];
+    int port;
+
+    if (cluster_parse_peer(cluster->config.peers[peer], host, sizeof(host),
+                           &port) != 0 ||
+        net_resolve_to_sockaddr(host, port, address, NULL) != 0) {
+        return E_DNS_ERROR;
+    }
+
+    pthread_mutex_lock(&cluster->lock);
+    cluster->peer_addrs[peer] = address->sin_addr;
+    cluster->peer_resolved[peer] = TRUE;
+    pthread_mutex_unlock(&cluster->lock);
+    return 0;
+}
+
+/**
+ * dial - Connect to a peer, giving up after CLUSTER_CONNECT_MS or a stop
+ *
+ * Returns: Connected socket, or a negative error code
+ */
+static int dial(cluster_t *cluster, const struct sockaddr_in *address)
+{
+    struct pollfd fds[2];
+    socklen_t len = sizeof(int);
+    int error = 0;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || fd_set_nonblocking(fd) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return E_NETWORK_ERROR;
+    }
+    if (connect(fd, (const struct sockaddr *)address, sizeof(*address)) != 0) {
+        if (errno != EINPROGRESS) {
+            close(fd);
+            return E_NETWORK_ERROR;
+        }
+        fds[0].fd = fd;
+        fds[0].events = POLLOUT;
+        fds[1].fd = cluster->dial_wake[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, CLUSTER_CONNECT_MS) <= 0 ||
+            !(fds[0].revents & (POLLOUT | POLLERR | POLLHUP)) ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 ||
+            error != 0) {
+            close(fd);
+            return E_NETWORK_ERROR;
+        }
+    }
+    return fd;
+}
+
+static void *dial_thread(void *arg)
+{
+    cluster_t *cluster = (cluster_t *)arg;
+    int reported[CLUSTER_MAX_PEERS];
+    struct sockaddr_in address;
+    struct pollfd pfd;
+    int resolved;
+    int skip;
+    int fd;
+    int i;
+
+    memset(reported, 0, sizeof(reported));
+
+    while (1) {
+        for (i = 0; i < cluster->config.peer_count; i++) {
+            /* Linked peers too: their addresses may move */
+            resolved = (peer_resolve(cluster, i, &address) == 0);
+
+            pthread_mutex_lock(&cluster->lock);
+            skip = cluster->stop || cluster->peer_linked[i] ||
+                   cluster->peer_self[i];
+            pthread_mutex_unlock(&cluster->lock);
+            if (skip) {
+                continue;
+            }
+
+            fd = resolved ? dial(cluster, &address) : E_DNS_ERROR;
+            if (fd < 0) {
+                /* Once per outage; the peer may simply not be up yet */
+                if (!reported[i]) {
+                    LOG_WARN("Cluster: cannot reach peer %s, retrying",
+                             cluster->config.peers[i]);
+                    reported[i] = TRUE;
+                }
+                continue;
+            }
+            reported[i] = FALSE;
+            (void)link_open(cluster, fd, i);
+        }
+
+        pfd.fd = cluster->dial_wake[0];
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, CLUSTER_RECONNECT_MS) > 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Relays
+ * ============================================================================ */
+
+static void devices_changed(void *ctx)
+{
+    cluster_t *cluster = (cluster_t *)ctx;
+
+    pthread_mutex_lock(&cluster->lock);
+    cluster->device_version++;
+    pthread_mutex_unlock(&cluster->lock);
+    wake(cluster->wake[1]);
+}
+
+static void topics_changed(void *ctx)
+{
+    cluster_t *cluster = (cluster_t *)ctx;
+
+    pthread_mutex_lock(&cluster->lock);
+    cluster->topic_version++;
+    pthread_mutex_unlock(&cluster->lock);
+    wake(cluster->wake[1]);
+}
+
+/**
+ * forward_urb - Send a URB to the node announcing its device_id
+ */
+static int forward_urb(void *ctx, uint32_t device_id, xoe_packet_t *packet,
+                       int relay)
+{
+    cluster_t *cluster = (cluster_t *)ctx;
+    cluster_link_t *link = NULL;
+    int node_id;
+    int result;
+
+    node_id = cluster_route(cluster, device_id);
+    if (node_id > 0) {
+        link = link_get(cluster, node_id);
+    }
+    if (link == NULL) {
+        xoe_wire_free_payload(packet);
+        return E_NOT_FOUND;
+    }
+
+    result = link_push(cluster, link, packet, relay, USB_SEND_STALL_MS);
+    link_put(cluster, link);
+    return result;
+}
+
+/**
+ * relay_serial - Send a hub frame to every node announcing its topic
+ */
+static int relay_serial(void *ctx, const char *topic, int role,
+                        const xoe_packet_t *packet)
+{
+    cluster_t *cluster = (cluster_t *)ctx;
+    cluster_link_t *targets[CLUSTER_MAX_LINKS];
+    xoe_payload_t *message;
+    xoe_packet_t frame;
+    cluster_node_t *node;
+    uint8_t *p;
+    uint32_t name_len = (uint32_t)strlen(topic);
+    int count = 0;
+    int sent = 0;
+    int i;
+    int j;
+
+    /* One link per node that has the topic */
+    pthread_mutex_lock(&cluster->lock);
+    for (i = 0; i < cluster->node_count; i++) {
+        node = &cluster->nodes[i];
+        for (j = 0; j < node->topic_count; j++) {
+            if (strcmp(node->topics[j], topic) == 0) {
+                break;
+            }
+        }
+        if (j == node->topic_count) {
+            continue;
+        }
+        for (j = 0; j < cluster->link_count; j++) {
+            if (cluster->links[j]->node_id == node->node_id &&
+                !cluster->links[j]->dead) {
+                targets[count] = cluster->links[j];
+                targets[count++]->refs++;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cluster->lock);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    message = message_alloc(cluster, CLUSTER_MSG_SERIAL,
+                            2 + name_len + 2 + packet->payload->len);
+    if (message != NULL) {
+        p = (uint8_t *)message->data + CLUSTER_HEADER_SIZE;
+        p[0] = (uint8_t)role;
+        p[1] = (uint8_t)name_len;
+        memcpy(p + 2, topic, name_len);
+        p[2 + name_len] = (uint8_t)(packet->protocol_version >> 8);
+        p[3 + name_len] = (uint8_t)packet->protocol_version;
+        memcpy(p + 4 + name_len, packet->payload->data, packet->payload->len);
+    }
+
+    for (i = 0; i < count; i++) {
+        if (message != NULL) {
+            message_packet(xoe_payload_ref(message), &frame);
+            if (link_push(cluster, targets[i], &frame, FALSE, 0) == 0) {
+                sent++;
+            }
+        }
+        link_put(cluster, targets[i]);
+    }
+
+    xoe_payload_release(message);
+    return sent;
+}
+
+/* ============================================================================
+ * Lifecycle
+ * ============================================================================ */
+
+int cluster_route(cluster_t *cluster, uint32_t device_id)
+{
+    cluster_route_t *route;
+    int node_id = E_NOT_FOUND;
+
+    if (cluster == NULL) {
+        return E_NOT_FOUND;
+    }
+
+    pthread_rwlock_rdlock(&cluster->route_lock);
+    route = cluster->routes[device_id & (CLUSTER_ROUTE_BUCKETS - 1)];
+    for (; route != NULL; route = route->next) {
+        if (route->device_id == device_id) {
+            node_id = route->node_id;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&cluster->route_lock);
+
+    return node_id;
+}
+
+int cluster_port(const cluster_t *cluster)
+{
+    return (cluster != NULL) ? cluster->port : 0;
+}
+
+/**
+ * open_listener - Link listener on @address
+ *
+ * Returns: Descriptor, or -1
+ */
+static int open_listener(const struct sockaddr_in *address, int *port)
+{
+    struct sockaddr_in bound;
+    socklen_t len = sizeof(bound);
+    int opt = 1;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0 ||
+        bind(fd, (const struct sockaddr *)address, sizeof(*address)) != 0 ||
+        listen(fd, CLUSTER_MAX_LINKS) != 0 ||
+        fd_set_nonblocking(fd) != 0 ||
+        getsockname(fd, (struct sockaddr *)&bound, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(bound.sin_port);
+    return fd;
+}
+
+cluster_t *cluster_start(const cluster_config_t *config,
+                         const struct sockaddr_in *address,
+                         usb_server_t *usb)
+{
+    char ip[INET_ADDRSTRLEN];
+    struct sockaddr_in peer_address;
+    usb_server_relay_t relay;
+    cluster_t *cluster;
+    int i;
+
+    if (config == NULL || address == NULL || config->node_id <= 0 ||
+        config->secret[0] == '\0') {
+        return NULL;
+    }
+
+    cluster = (cluster_t *)calloc(1, sizeof(cluster_t));
+    if (cluster == NULL) {
+        fprintf(stderr, "Out of memory for the cluster\n");
+        return NULL;
+    }
+    cluster->config = *config;
+    cluster->usb = usb;
+    cluster->device_version = 1;
+    cluster->topic_version = 1;
+    cluster->wake[0] = cluster->wake[1] = -1;
+    cluster->dial_wake[0] = cluster->dial_wake[1] = -1;
+
+    if (pthread_mutex_init(&cluster->lock, NULL) != 0) {
+        free(cluster);
+        return NULL;
+    }
+    if (pthread_rwlock_init(&cluster->route_lock, NULL) != 0) {
+        pthread_mutex_destroy(&cluster->lock);
+        free(cluster);
+        return NULL;
+    }
+
+    cluster->fd = open_listener(address, &cluster->port);
+    if (cluster->fd < 0) {
+        perror("Cluster listener");
+        goto fail;
+    }
+    if (open_pipe(cluster->wake) != 0 || open_pipe(cluster->dial_wake) != 0) {
+        perror("Cluster: pipe");
+        goto fail;
+    }
+
+    /* Links from the peers are accepted from the start */
+    for (i = 0; i < config->peer_count; i++) {
+        (void)peer_resolve(cluster, i, &peer_address);
+    }
+
+    /* The keyed HMAC state is all the links need of the secret */
+    cluster->key = usb_auth_key_create(cluster->config.secret);
+    memset(cluster->config.secret, 0, sizeof(cluster->config.secret));
+    if (cluster->key == NULL) {
+        fprintf(stderr, "Cluster: cannot key the link authentication\n");
+        goto fail;
+    }
+    if (usb_send_writer_init(&cluster->writer) != 0) {
+        fprintf(stderr, "Cluster: cannot start the link writer\n");
+        goto fail;
+    }
+    if (thread_sched_create(&cluster->thread, THREAD_CLASS_NONE,
+                            cluster_thread, cluster) != 0) {
+        perror("Cluster: pthread_create");
+        usb_send_writer_cleanup(&cluster->writer);
+        goto fail;
+    }
+
+    /* Hooked only once links can be served */
+    relay.devices_changed = devices_changed;
+    relay.forward = forward_urb;
+    relay.ctx = cluster;
+    usb_server_set_relay(usb, &relay);
+    serial_hub_set_relay(topics_changed, relay_serial, cluster);
+
+    if (config->peer_count > 0) {
+        if (thread_sched_create(&cluster->dial_thread, THREAD_CLASS_NONE,
+                                dial_thread, cluster) != 0) {
+            perror("Cluster: pthread_create");
+        } else {
+            cluster->dial_started = TRUE;
+        }
+    }
+
+    if (inet_ntop(AF_INET, &address->sin_addr, ip, sizeof(ip)) == NULL) {
+        strcpy(ip, "?");
+    }
+    printf("Cluster node %d, links on %s:%d, %d peer%s\n", config->node_id,
+           ip, cluster->port, config->peer_count,
+           (config->peer_count == 1) ? "" : "s");
+    return cluster;
+
+fail:
+    if (cluster->fd >= 0) {
+        close(cluster->fd);
+    }
+    if (cluster->wake[0] >= 0) {
+        close(cluster->wake[0]);
+        close(cluster->wake[1]);
+    }
+    if (cluster->dial_wake[0] >= 0) {
+        close(cluster->dial_wake[0]);
+        close(cluster->dial_wake[1]);
+    }
+    usb_auth_key_free(cluster->key);
+    pthread_rwlock_destroy(&cluster->route_lock);
+    pthread_mutex_destroy(&cluster->lock);
+    free(cluster);
+    return NULL;
+}
+
+void cluster_stop(cluster_t *cluster)
+{
+    int i;
+
+    if (cluster == NULL) {
+        return;
+    }
+
+    /* No relay runs once these return */
+    usb_server_set_relay(cluster->usb, NULL);
+    serial_hub_set_relay(NULL, NULL, NULL);
+
+    pthread_mutex_lock(&cluster->lock);
+    cluster->stop = TRUE;
+    pthread_mutex_unlock(&cluster->lock);
+    wake(cluster->dial_wake[1]);
+    wake(cluster->wake[1]);
+    if (cluster->dial_started) {
+        pthread_join(cluster->dial_thread, NULL);
+    }
+    pthread_join(cluster->thread, NULL);
+
+    while (cluster->link_count > 0) {
+        link_close(cluster, cluster->links[0], NULL);
+    }
+    usb_send_writer_cleanup(&cluster->writer);
+
+    for (i = 0; i < CLUSTER_ROUTE_BUCKETS; i++) {
+        while (cluster->routes[i] != NULL) {
+            cluster_route_t *route = cluster->routes[i];
+            cluster->routes[i] = route->next;
+            free(route);
+        }
+    }
+
+    close(cluster->fd);
+    close(cluster->wake[0]);
+    close(cluster->wake[1]);
+    close(cluster->dial_wake[0]);
+    close(cluster->dial_wake[1]);
+    usb_auth_key_free(cluster->key);
+    pthread_rwlock_destroy(&cluster->route_lock);
+    pthread_mutex_destroy(&cluster->lock);
+    free(cluster);
+}
@@ -0,0 +1,192 @@
+/**
+ * cluster.h
+ *
+ * Several servers acting as one (--cluster-node), so peers of the same
+ * device_id or serial topic may be connected to different nodes behind
+ * a load balancer.
+ *
+ * Nodes keep persistent TCP links to each other: every node listens on
+ * its cluster address and port (--cluster-bind, --cluster-port, apart
+ * from the public listener) and dials the peers it was given
+ * (--cluster-peer), redialing one every CLUSTER_RECONNECT_MS while it is
+ * down. A link carries traffic both ways, but a node accepts links only
+ * from the addresses its peers resolve to, so two nodes name each other.
+ *
+ * Both ends open with a HELLO naming their node and carrying a random
+ * challenge, and answer the other's challenge with an AUTH: the
+ * HMAC-SHA256 of the challenge, their node id and their role (dialer or
+ * acceptor), keyed with the cluster's shared secret (--cluster-secret,
+ * through usb_auth_key_t, as device_id and device_class). The role keeps an answer given on an accepted
+ * link from being replayed to dial another node. Nothing but HELLO and
+ * AUTH is accepted before the other end's AUTH checked out.
+ *
+ * Each node tells the others which device_ids its USB clients registered
+ * (usb_server_device_ids()) and which serial hub topics have members here
+ * (serial_hub_topic_names()). These are full snapshots, sent again on a
+ * link whenever the set changed since the last one it carried, so a
+ * snapshot lost to a full queue is simply sent later and a new link
+ * starts in sync. A link going down forgets what its node announced once
+ * no other link to that node is left.
+ *
+ * A URB no local client can take goes to a node announcing its
+ * device_id, as the same XOE_PROTOCOL_USB frame (usb_server_t relay). A
+ * hub publisher's frames, and a writer's when the publisher is
+ * elsewhere, go to every node announcing the topic (serial_hub relay).
+ * The receiving node delivers them to local clients only, so a frame
+ * crosses at most one link. All frames of a link share one
+ * usb_send_queue_t, whose traffic classes and per-device flows keep a
+ * bulk stream of one device from delaying the others.
+ *
+ * Links are authenticated but not encrypted: keep them on a private
+ * network. Descriptor caches, OUT credit and the hub's write lease stay
+ * per node.
+ *
+ * Frames are XOE_PROTOCOL_CLUSTER with a four-byte header, type, zero,
+ * then the sender's node id (big-endian):
+ *
+ *   HELLO    challenge (USB_AUTH_CHALLENGE_LEN bytes)
+ *   AUTH     answer to the other end's challenge (USB_AUTH_RESPONSE_LEN)
+ *   DEVICES  device_id (u32 BE) for each registered device (at most
+ *            CLUSTER_MAX_DEVICES)
+ *   TOPICS   length (u8) + name, for each topic
+ *   SERIAL   role (u8), length (u8) + topic name, the serial frame's
+ *            protocol version (u16 BE), then its payload
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef CORE_CLUSTER_H
+#define CORE_CLUSTER_H
+
+#include "lib/common/types.h"
+#include "connectors/usb/usb_server.h"
+
+#include <netinet/in.h>
+
+/* Peers one node dials */
+#define CLUSTER_MAX_PEERS 16
+
+/* Longest "host:port" of a peer, NUL included */
+#define CLUSTER_PEER_MAX 256
+
+/* Largest node id (0 means cluster mode is off) */
+#define CLUSTER_MAX_NODE_ID 65535
+
+/* Links open at once, inbound and outbound */
+#define CLUSTER_MAX_LINKS 64
+
+/* Topics a node announces */
+#define CLUSTER_MAX_TOPICS 1024
+
+/* Device_ids a node announces: every registration a server can hold */
+#define CLUSTER_MAX_DEVICES USB_MAX_CLIENTS
+
+/* Snapshots and dead links are looked at this often (ms) */
+#define CLUSTER_TICK_MS 200
+
+/* Wait before dialing a peer again (ms) */
+#define CLUSTER_RECONNECT_MS 2000
+
+/* Longest wait for a dialed peer to answer (ms) */
+#define CLUSTER_CONNECT_MS 3000
+
+/* A new link must send its HELLO and AUTH within this (ms) */
+#define CLUSTER_HELLO_MS 5000
+
+/* Version of XOE_PROTOCOL_CLUSTER frames */
+#define CLUSTER_VERSION 1
+
+/* Frame types (first payload byte) */
+#define CLUSTER_MSG_HELLO   1
+#define CLUSTER_MSG_DEVICES 2
+#define CLUSTER_MSG_TOPICS  3
+#define CLUSTER_MSG_SERIAL  4
+#define CLUSTER_MSG_AUTH    5
+
+/* Type, zero and node id before the body */
+#define CLUSTER_HEADER_SIZE 4
+
+/* Roles bound into an AUTH answer (its device_class byte) */
+#define CLUSTER_ROLE_DIALER   1
+#define CLUSTER_ROLE_ACCEPTOR 2
+
+/* Cluster settings of a server */
+typedef struct {
+    int node_id;                        /* This node (0 = cluster mode off) */
+    int port;                           /* Link port (0 = listen port + 1) */
+    char bind[CLUSTER_PEER_MAX];        /* Link address ("" = loopback) */
+    char secret[USB_AUTH_SECRET_MAX];   /* Shared secret of the links */
+    int peer_count;                     /* Entries in peers */
+    char peers[CLUSTER_MAX_PEERS][CLUSTER_PEER_MAX]; /* "host:port" */
+} cluster_config_t;
+
+typedef struct cluster cluster_t;
+
+/**
+ * cluster_parse_peer - Split a "host:port" peer
+ * @spec:     Peer as given to --cluster-peer
+ * @host:     Output: host name or address
+ * @host_len: Size of @host
+ * @port:     Output: port
+ *
+ * The port follows the last colon, so "[::1]"-less IPv6 literals do not
+ * parse; use a host name for those.
+ *
+ * Returns: 0, or E_INVALID_ARGUMENT
+ */
+int cluster_parse_peer(const char *spec, char *host, size_t host_len,
+                       int *port);
+
+/**
+ * cluster_load_secret - Read the shared secret of the links from a file
+ * @path:   File whose first line is the secret
+ * @config: Output: config->secret
+ *
+ * A trailing newline is dropped. Every node of a cluster reads the same
+ * secret.
+ *
+ * Returns: 0, E_FILE_NOT_FOUND, or E_INVALID_ARGUMENT if the secret is
+ *          empty or not shorter than USB_AUTH_SECRET_MAX
+ */
+int cluster_load_secret(const char *path, cluster_config_t *config);
+
+/**
+ * cluster_start - Listen for nodes, dial the peers and relay for @usb
+ * @config:  Cluster settings (node_id and secret set)
+ * @address: Address and port of the link listener (port 0 picks one)
+ * @usb:     USB server whose misses go to other nodes (NULL: serial only)
+ *
+ * Also hooks into the serial hub, which is process-wide: only one
+ * cluster relays its topics at a time.
+ *
+ * Returns: Running cluster, or NULL if the listener, the send writer or
+ *          the threads could not be set up (the reason is printed)
+ */
+cluster_t *cluster_start(const cluster_config_t *config,
+                         const struct sockaddr_in *address,
+                         usb_server_t *usb);
+
+/**
+ * cluster_stop - Unhook, close every link and stop the threads
+ * @cluster: Cluster from cluster_start() (NULL is ignored)
+ *
+ * Returns once no relay is in progress, so @usb may go next.
+ */
+void cluster_stop(cluster_t *cluster);
+
+/**
+ * cluster_port - Port the link listener is bound to
+ * @cluster: Cluster
+ */
+int cluster_port(const cluster_t *cluster);
+
+/**
+ * cluster_route - Node a device_id would be forwarded to
+ * @cluster:   Cluster
+ * @device_id: Device
+ *
+ * Returns: Node id, or E_NOT_FOUND if no other node announced it
+ */
+int cluster_route(cluster_t *cluster, uint32_t device_id);
+
+#endif /* CORE_CLUSTER_H */
@@ -2,6 +2,18 @@
 #define CORE_CONFIG_H
 
 #include "lib/common/types.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/thread_sched.h"
+#include "lib/net/l2_ring.h"
+#include "lib/net/shm_link.h"
+#include "lib/net/sock_tune.h"
+#include "lib/net/server_pool.h"
+#include "lib/protocol/wire_format.h"
+#include "core/bench_client.h"
+#include "core/replay_client.h"
+#include "core/cluster.h"
+#include "core/handoff.h"
+#include "connectors/serial/serial_hub.h"
 #include <signal.h>
 
 /**
@@ -13,6 +25,13 @@ void mgmt_restart_clear(void);
 int mgmt_restart_is_requested(void);
 int mgmt_restart_check_and_clear(void);
 
+/**
+ * The running mode registers a notifier so a restart request wakes it at
+ * once instead of waiting for its next poll. Called on the requesting
+ * thread, after the flag is set.
+ */
+void mgmt_restart_set_notify(void (*notify)(void));
+
 /* Global config manager for runtime configuration changes */
 struct mgmt_config_manager_t;  /* Forward declaration */
 extern struct mgmt_config_manager_t *g_config_manager;
@@ -21,14 +40,99 @@ extern struct mgmt_config_manager_t *g_config_manager;
 #define SERVER_PORT 12345
 /* Define the port number for the management interface */
 #define MGMT_PORT 6969
-/* Define the maximum number of pending connections in the listen queue. */
-#define MAX_PENDING_CONNECTIONS 5
+/* Define the maximum number of pending connections in the listen queue.
+ * Default for --backlog; the kernel caps it at its own limit (somaxconn) */
+#define MAX_PENDING_CONNECTIONS 128
+/* Define the largest --backlog accepted */
+#define MAX_LISTEN_BACKLOG 65535
+/* Define the maximum number of SO_REUSEPORT listeners (--listeners) and
+ * of CPUs in a --cpus list */
+#define MAX_SERVER_LISTENERS 64
 /* Define a buffer size for network communication */
 #define BUFFER_SIZE 1024
+/*
+ * The small-footprint profile (make small, XOE_SMALL_FOOTPRINT=1) targets
+ * routers with 32-64 MB of RAM: fewer connection slots, workers and
+ * management sessions, smaller per-connection buffers and thread stacks,
+ * and a memory budget that is on by default. Each limit below can still
+ * be overridden with -D.
+ */
+#ifndef XOE_SMALL_FOOTPRINT
+#define XOE_SMALL_FOOTPRINT 0
+#endif
+
 /* Define the maximum number of concurrent client connections */
-#define MAX_CLIENTS 32
-/* Define the maximum number of concurrent management sessions */
+#ifndef MAX_CLIENTS
+#if XOE_SMALL_FOOTPRINT
+#define MAX_CLIENTS 64
+#else
+#define MAX_CLIENTS 1024
+#endif
+#endif
+/* Define the default connections per source address accepted in a burst,
+ * and refilled per 10 seconds (--conn-rate; 0 disables the limit) */
+#define CONN_RATE_LIMIT_MAX 20
+/* Define the largest --conn-rate accepted (one connection per millisecond) */
+#define MAX_CONN_RATE 10000
+/* Define the number of event loop worker threads in server mode */
+#ifndef EVENT_LOOP_WORKERS
+#if XOE_SMALL_FOOTPRINT
+#define EVENT_LOOP_WORKERS 1
+#else
+#define EVENT_LOOP_WORKERS 4
+#endif
+#endif
+/* Define the number of TLS handshake threads in server mode (0 = workers
+ * run handshakes inline; a pool isolates open connections from reconnect
+ * bursts on multi-core hosts) */
+#define EVENT_LOOP_HANDSHAKE_THREADS 0
+/* Define the maximum number of concurrent management sessions (all served
+ * by one thread; about 19 KB each, pre-allocated) */
+#ifndef MAX_MGMT_SESSIONS
+#if XOE_SMALL_FOOTPRINT
 #define MAX_MGMT_SESSIONS 4
+#else
+#define MAX_MGMT_SESSIONS 64
+#endif
+#endif
+/* Define the default memory budget for frame buffers (--mem-budget, MiB)
+ * and per connection (--conn-mem, KiB); 0 = unlimited */
+#ifndef MEM_BUDGET_DEFAULT_MB
+#if XOE_SMALL_FOOTPRINT
+#define MEM_BUDGET_DEFAULT_MB 8
+#else
+#define MEM_BUDGET_DEFAULT_MB 0
+#endif
+#endif
+#ifndef CONN_MEM_DEFAULT_KB
+#if XOE_SMALL_FOOTPRINT
+#define CONN_MEM_DEFAULT_KB 1024
+#else
+#define CONN_MEM_DEFAULT_KB 0
+#endif
+#endif
+/* Define whether the management port also answers HTTP "GET /metrics"
+ * (Prometheus text format, read-only, no password) */
+#define MGMT_METRICS_HTTP 0
+/* Define how long a new management session waits for an HTTP request
+ * before the console greeting is sent (milliseconds) */
+#define MGMT_METRICS_SNIFF_MS 100
+/* Define whether a connection's recent frames (wire flight recorder) are
+ * written to stderr when it is dropped for a corrupt frame */
+#define WIRE_TRACE_DUMP_ON_ERROR 1
+
+/* Define whether the USB protocol is built in. Without it (make
+ * serial-only, XOE_USB_ENABLED=0) -u is refused, the server closes
+ * connections that send USB frames and never starts libusb, and its data
+ * path skips the USB checks */
+#ifndef XOE_USB_ENABLED
+#define XOE_USB_ENABLED 1
+#endif
+/* Define the most USB device classes in the whitelist (set usb_classes) */
+#define MAX_USB_CLASSES 16
+/* Define the largest USB isochronous bandwidth budget (KB/s; fits the
+ * server's bytes per second in 32 bits) */
+#define MAX_USB_ISO_BUDGET_KBPS 4194303
 
 /* TLS certificate and key path maximum length */
 #define TLS_CERT_PATH_MAX 256
@@ -39,7 +143,9 @@ typedef enum {
     MODE_SERVER,            /* Run as TCP/TLS server */
     MODE_CLIENT_STANDARD,   /* Run as standard client (stdin/stdout) */
     MODE_CLIENT_SERIAL,     /* Run as serial bridge client */
-    MODE_CLIENT_USB         /* Run as USB bridge client */
+    MODE_CLIENT_USB,        /* Run as USB bridge client */
+    MODE_CLIENT_BENCH,      /* Run as echo load generator */
+    MODE_CLIENT_REPLAY      /* Run as wire capture replayer */
 } xoe_mode_t;
 
 /* FSM states for application flow */
@@ -53,6 +159,8 @@ typedef enum {
     STATE_CLIENT_STD,       /* Execute standard client mode */
     STATE_CLIENT_SERIAL,    /* Execute serial bridge client mode */
     STATE_CLIENT_USB,       /* Execute USB bridge client mode */
+    STATE_CLIENT_BENCH,     /* Execute bench client mode */
+    STATE_CLIENT_REPLAY,    /* Execute replay client mode */
     STATE_MODE_STOP,        /* Gracefully stop current mode for restart */
     STATE_APPLY_CONFIG,     /* Apply pending configuration */
     STATE_CLEANUP,          /* Cleanup resources */
@@ -64,8 +172,28 @@ typedef struct {
     xoe_mode_t mode;                    /* Operating mode */
     char *listen_address;               /* Server listen address */
     int listen_port;                    /* Server listen port */
+    int listeners;                      /* Accept threads (>1: SO_REUSEPORT) */
+    int listen_backlog;                 /* listen() backlog per socket */
+    int cpu_count;                      /* Entries in cpus (0 = no pinning) */
+    int cpus[MAX_SERVER_LISTENERS];     /* CPUs for listener/worker i */
+    sock_tune_t sock_tune;              /* TCP options for data sockets */
+    thread_sched_t thread_sched;        /* --sched CPU sets and policies */
+    int thread_stack_kb;                /* New thread stacks (0 = default) */
+    int mem_budget_mb;                  /* Frame memory limit (0 = none) */
+    int conn_mem_kb;                    /* Per-connection limit (0 = none) */
+    int use_io_uring;                   /* Event loop polls via io_uring */
+    int use_udp;                        /* Serial over UDP / DTLS (--udp) */
+    char l2_interface[L2_RING_IFNAME_MAX]; /* Serial over Ethernet ("" = off) */
+    uint8_t l2_server_mac[L2_RING_MAC_LEN]; /* Client: server (broadcast = find) */
+    char shm_path[SHM_LINK_PATH_MAX];   /* Same-host link socket ("" = off) */
+    int conn_rate;                      /* Connections per address per 10 s */
+    char handoff_path[HANDOFF_PATH_MAX]; /* Upgrade socket ("" = none) */
+    char takeover_path[HANDOFF_PATH_MAX]; /* Server to take over ("" = none) */
+    cluster_config_t cluster;           /* --cluster-* (node_id 0 = off) */
     char *connect_server_ip;            /* Client connection IP */
     int connect_server_port;            /* Client connection port */
+    server_list_t servers;              /* Every server given to -c (the
+                                         * first is connect_server_*) */
     int encryption_mode;                /* TLS encryption mode (0=off, 1=on) */
     char cert_path[TLS_CERT_PATH_MAX];  /* TLS certificate path */
     char key_path[TLS_CERT_PATH_MAX];   /* TLS key path */
@@ -73,9 +201,23 @@ typedef struct {
     int tls_verify_mode;                /* TLS verification mode (0=none, 1=peer) */
     int use_serial;                     /* Serial mode flag */
     void *serial_config;                /* Opaque pointer to serial_config_t */
-    char *serial_device;                /* Serial device path */
+    char *serial_device;                /* Serial device path (first -s) */
+    void *serial_multi;                 /* Opaque pointer to serial_multi_config_t */
+    int serial_mux;                     /* Multiplex all ports on one connection */
+    char hub_topic[SERIAL_HUB_TOPIC_MAX + 1]; /* Routing hub topic ("" = echo) */
+    int hub_role;                       /* SERIAL_HUB_* role in hub_topic */
+    char raw_channel[XOE_WIRE_RAW_NAME_MAX + 1]; /* --raw channel ("" = echo) */
+    uint32_t wire_compress;             /* XOE_WIRE_FEATURE_COMPRESS_* to request */
     int use_usb;                        /* USB mode flag */
     void *usb_config;                   /* Opaque pointer to usb_multi_config_t */
+    uint8_t usb_classes[MAX_USB_CLASSES]; /* USB class whitelist (server) */
+    int usb_class_count;                /* Entries in usb_classes (0 = default) */
+    int usb_iso_budget_kbps;            /* Isochronous budget, KB/s (0 = none) */
+    int log_level;                      /* log_level_t in effect */
+    bench_config_t bench;               /* --bench load (0 connections = off) */
+    replay_config_t replay;             /* --replay trace (NULL path = off) */
+    char *capture_path;                 /* --capture trace file (NULL = off) */
+    int capture_max_mb;                 /* --capture-max size (0 = no limit) */
     char *program_name;                 /* Program name for usage output */
     int exit_code;                      /* Exit code for application */
     int server_fd;                      /* Server connection file descriptor */
@@ -90,15 +232,19 @@ xoe_state_t state_parse_args(xoe_config_t *config, int argc, char *argv[]);
 xoe_state_t state_validate_config(xoe_config_t *config);
 xoe_state_t state_start_mgmt(xoe_config_t *config);
 xoe_state_t state_mode_select(xoe_config_t *config);
+int state_mode_is_server(const xoe_config_t *config);
 xoe_state_t state_server_mode(xoe_config_t *config);
 xoe_state_t state_client_std(xoe_config_t *config);
 xoe_state_t state_client_serial(xoe_config_t *config);
 xoe_state_t state_client_usb(xoe_config_t *config);
+xoe_state_t state_client_bench(xoe_config_t *config);
+xoe_state_t state_client_replay(xoe_config_t *config);
 xoe_state_t state_mode_stop(xoe_config_t *config);
 xoe_state_t state_apply_config(xoe_config_t *config);
 xoe_state_t state_cleanup(xoe_config_t *config);
 
 /* Forward declarations for helper functions used by state handlers */
 void print_usage(const char *program_name);
+int choose_server(xoe_config_t *config, uint32_t key);
 
 #endif /* CORE_CONFIG_H */
@@ -0,0 +1,828 @@
+/**
+ * dgram_server.c
+ *
+ * UDP / DTLS and layer-2 listener for serial channels (see
+ * dgram_server.h).
+ *
+ * [LLM-ARCH]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "core/dgram_server.h"
+#include "connectors/serial/serial_dgram.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+#include "lib/net/l2_ring.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/wire_l2.h"
+
+#include "lib/security/tls_config.h"
+#if TLS_ENABLED
+#include <openssl/ssl.h>
+#include "lib/security/tls_context.h"
+#include "lib/security/tls_session.h"
+#endif
+
+/**
+ * dgram_peer_t - One datagram association
+ */
+typedef struct {
+    int in_use;
+    struct dgram_server *server;
+    struct sockaddr_in addr;        /* Client address (UDP) */
+    int on_link;                    /* Layer 2: mac and association instead */
+    uint8_t mac[L2_RING_MAC_LEN];
+    uint32_t association;
+    char name[32];                  /* "address:port" or "mac/association" */
+    int fd;                         /* Own connected socket (DTLS), or -1 */
+    void *ssl;                      /* DTLS session, NULL on plain UDP */
+    int handshaking;                /* DTLS handshake still running */
+    uint64_t setup_deadline_ms;     /* Handshake and HELLO due by then */
+    uint32_t features;              /* Granted XOE_WIRE_FEATURE_* bits */
+    serial_dgram_t *channel;        /* NULL until the HELLO */
+} dgram_peer_t;
+
+struct dgram_server {
+    int fd;                         /* Listening UDP socket, or -1 */
+    l2_ring_t *link;                /* Layer-2 ring, or NULL */
+    struct sockaddr_in address;     /* Its address, for per-peer sockets */
+    void *tls_ctx;                  /* DTLS server context, or NULL */
+    int wake[2];                    /* Pipe: stop request */
+    pthread_t thread;
+    dgram_peer_t peers[DGRAM_SERVER_MAX_PEERS];
+    struct pollfd fds[DGRAM_SERVER_MAX_PEERS + 3];
+    int slot_of_fd[DGRAM_SERVER_MAX_PEERS + 3]; /* Peer behind fds[i] */
+};
+
+/**
+ * open_socket - UDP socket bound to the server address
+ * @address: Address and port
+ *
+ * SO_REUSEADDR lets the per-peer DTLS sockets share the port; the kernel
+ * prefers a connected socket for datagrams from its peer.
+ *
+ * Returns: Descriptor, or -1
+ */
+static int open_socket(const struct sockaddr_in *address)
+{
+    int opt = 1;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0 ||
+        bind(fd, (const struct sockaddr *)address, sizeof(*address)) != 0 ||
+        fd_set_nonblocking(fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* ============================================================================
+ * Peers
+ * ============================================================================ */
+
+static dgram_peer_t *peer_find(dgram_server_t *server,
+                               const struct sockaddr_in *addr)
+{
+    dgram_peer_t *peer;
+    int i;
+
+    for (i = 0; i < DGRAM_SERVER_MAX_PEERS; i++) {
+        peer = &server->peers[i];
+        if (peer->in_use && peer->addr.sin_port == addr->sin_port &&
+            peer->addr.sin_addr.s_addr == addr->sin_addr.s_addr) {
+            return peer;
+        }
+    }
+    return NULL;
+}
+
+static dgram_peer_t *peer_find_link(dgram_server_t *server,
+                                    const uint8_t *mac, uint32_t association)
+{
+    dgram_peer_t *peer;
+    int i;
+
+    for (i = 0; i < DGRAM_SERVER_MAX_PEERS; i++) {
+        peer = &server->peers[i];
+        if (peer->in_use && peer->on_link &&
+            peer->association == association &&
+            memcmp(peer->mac, mac, L2_RING_MAC_LEN) == 0) {
+            return peer;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * peer_alloc - Take a free slot (the caller sets address and name)
+ *
+ * Returns: Peer, or NULL if the table is full
+ */
+static dgram_peer_t *peer_alloc(dgram_server_t *server)
+{
+    dgram_peer_t *peer;
+    int i;
+
+    for (i = 0; i < DGRAM_SERVER_MAX_PEERS; i++) {
+        peer = &server->peers[i];
+        if (!peer->in_use) {
+            memset(peer, 0, sizeof(*peer));
+            peer->in_use = TRUE;
+            peer->server = server;
+            peer->fd = -1;
+            peer->setup_deadline_ms = latency_now_ms() + DGRAM_SERVER_SETUP_MS;
+            metrics_add(METRIC_DGRAM_PEERS, 1);
+            return peer;
+        }
+    }
+
+    LOG_WARN("Datagram peer table full (%d), ignoring a new client",
+             DGRAM_SERVER_MAX_PEERS);
+    return NULL;
+}
+
+static dgram_peer_t *peer_new(dgram_server_t *server,
+                              const struct sockaddr_in *addr)
+{
+    dgram_peer_t *peer = peer_alloc(server);
+
+    if (peer != NULL) {
+        peer->addr = *addr;
+        inet_ntop(AF_INET, &addr->sin_addr, peer->name, sizeof(peer->name));
+        snprintf(peer->name + strlen(peer->name),
+                 sizeof(peer->name) - strlen(peer->name), ":%d",
+                 ntohs(addr->sin_port));
+    }
+    return peer;
+}
+
+static dgram_peer_t *peer_new_link(dgram_server_t *server, const uint8_t *mac,
+                                   uint32_t association)
+{
+    dgram_peer_t *peer = peer_alloc(server);
+
+    if (peer != NULL) {
+        peer->on_link = TRUE;
+        memcpy(peer->mac, mac, L2_RING_MAC_LEN);
+        peer->association = association;
+        l2_ring_format_mac(mac, peer->name);
+        snprintf(peer->name + strlen(peer->name),
+                 sizeof(peer->name) - strlen(peer->name), "/%08x",
+                 (unsigned)association);
+    }
+    return peer;
+}
+
+/**
+ * peer_expire - Forget an association
+ * @peer: Peer
+ * @why: Reason for the log
+ */
+static void peer_expire(dgram_peer_t *peer, const char *why)
+{
+    LOG_INFO("Datagram peer %s %s", peer->name, why);
+
+#if TLS_ENABLED
+    if (peer->ssl != NULL) {
+        tls_session_shutdown((SSL *)peer->ssl);
+        tls_session_destroy((SSL *)peer->ssl);
+    }
+#endif
+    if (peer->fd >= 0) {
+        close(peer->fd);
+    }
+    serial_dgram_destroy(peer->channel);
+
+    peer->in_use = FALSE;
+    peer->ssl = NULL;
+    peer->fd = -1;
+    peer->channel = NULL;
+    metrics_sub(METRIC_DGRAM_PEERS, 1);
+}
+
+/**
+ * peer_send - Transmit function of a peer's channel
+ */
+static int peer_send(void *arg, const xoe_packet_t *packet)
+{
+    dgram_peer_t *peer = (dgram_peer_t *)arg;
+
+    if (peer->on_link) {
+        return xoe_wire_l2_send(peer->server->link, peer->mac,
+                                peer->association, XOE_WIRE_L2_FROM_SERVER,
+                                peer->features, packet);
+    }
+    if (peer->fd >= 0) {
+        return xoe_wire_dgram_send(peer->fd, peer->ssl, NULL, 0,
+                                   peer->features, packet);
+    }
+    return xoe_wire_dgram_send(peer->server->fd, NULL,
+                               (const struct sockaddr *)&peer->addr,
+                               sizeof(peer->addr), peer->features, packet);
+}
+
+/**
+ * peer_hello - Answer a HELLO, opening the channel on the first one
+ * @peer: Peer
+ * @requested: Features the client asked for
+ *
+ * A repeated HELLO (our HELLO_ACK was lost) gets the same answer.
+ *
+ * Returns: 0, or negative error code if the peer must go
+ */
+static int peer_hello(dgram_peer_t *peer, uint32_t requested)
+{
+    uint8_t buffer[XOE_WIRE_HELLO_SIZE];
+    xoe_payload_t payload;
+    xoe_packet_t reply;
+    uint32_t features = peer->features;
+    int mode;
+
+    if (peer->channel == NULL) {
+        features = xoe_wire_dgram_features_accept(requested, peer->ssl != NULL);
+        mode = (features & XOE_WIRE_FEATURE_SERIAL_LATEST)
+               ? SERIAL_DGRAM_LATEST : SERIAL_DGRAM_RELIABLE;
+        peer->channel = serial_dgram_create(mode, peer_send, peer,
+                                            latency_now_ms());
+        if (peer->channel == NULL) {
+            return E_OUT_OF_MEMORY;
+        }
+        LOG_INFO("Datagram peer %s opened (%s, features 0x%08x)",
+                 peer->name, (mode == SERIAL_DGRAM_LATEST) ? "latest" : "reliable",
+                 features);
+    }
+
+    /* The HELLO_ACK itself is checksummed: the client decodes it before
+     * it knows what was granted */
+    xoe_wire_hello_init(&reply, &payload, buffer, XOE_WIRE_CTRL_HELLO_ACK,
+                        features);
+    peer->features = 0;
+    peer_send(peer, &reply);
+    peer->features = features;
+    return 0;
+}
+
+/**
+ * peer_echo - Send back what the channel received, window permitting
+ *
+ * Frames the window cannot take stay in the channel unacknowledged,
+ * which holds the client back.
+ */
+static int peer_echo(dgram_peer_t *peer)
+{
+    const unsigned char *data;
+    uint32_t len;
+    uint16_t flags;
+    uint64_t now = latency_now_ms();
+    int result;
+
+    while (serial_dgram_can_send(peer->channel) &&
+           serial_dgram_peek(peer->channel, &data, &len, &flags)) {
+        result = serial_dgram_send(peer->channel, data, len, flags, now);
+        if (result == 0) {
+            result = serial_dgram_consume(peer->channel, now);
+        }
+        if (result != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+/**
+ * peer_input - Handle one datagram from a peer
+ * @peer: Peer
+ * @datagram: Datagram
+ * @len: Its length
+ *
+ * Returns: 0, or negative error code if the peer must go
+ */
+static int peer_input(dgram_peer_t *peer, const uint8_t *datagram,
+                      uint32_t len)
+{
+    xoe_packet_t packet;
+    uint32_t requested;
+    uint16_t type;
+    int result = 0;
+
+    /* Undecodable datagrams are dropped like lost ones */
+    if (xoe_wire_dgram_decode(datagram, len,
+                              (peer->channel != NULL) ? peer->features : 0,
+                              &packet) != 0) {
+        return 0;
+    }
+
+    if (packet.protocol_id == XOE_PROTOCOL_WIRE_CTRL) {
+        if (xoe_wire_hello_parse(&packet, &type, &requested) == 0 &&
+            type == XOE_WIRE_CTRL_HELLO) {
+            result = peer_hello(peer, requested);
+        }
+    } else if (packet.protocol_id == XOE_PROTOCOL_SERIAL &&
+               peer->channel != NULL) {
+        result = serial_dgram_input(peer->channel, &packet, latency_now_ms());
+        if (result == E_PROTOCOL_ERROR) {
+            result = 0;
+        }
+        if (result == 0) {
+            result = peer_echo(peer);
+        }
+    }
+
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * opens_association - Whether a datagram from an unknown sender may make
+ *                     it a peer: only a control frame (its HELLO) does
+ */
+static int opens_association(const uint8_t *datagram, uint32_t len)
+{
+    xoe_wire_header_t header;
+
+    if (len < XOE_WIRE_HEADER_SIZE) {
+        return FALSE;
+    }
+    xoe_wire_deserialize_header(&header, datagram);
+    return header.protocol_id == XOE_PROTOCOL_WIRE_CTRL;
+}
+
+/**
+ * peer_receive - Handle a datagram on a shared socket or ring
+ *
+ * The peer goes if the datagram breaks it, or if it was new and the
+ * datagram was not a HELLO after all.
+ */
+static void peer_receive(dgram_peer_t *peer, const uint8_t *datagram,
+                         uint32_t len)
+{
+    if (peer_input(peer, datagram, len) != 0) {
+        peer_expire(peer, "failed");
+    } else if (peer->channel == NULL) {
+        peer_expire(peer, "sent no HELLO");
+    }
+}
+
+/* ============================================================================
+ * Plain UDP
+ * ============================================================================ */
+
+/**
+ * read_plain - Read every datagram queued on the shared socket
+ */
+static void read_plain(dgram_server_t *server)
+{
+    uint8_t datagram[XOE_WIRE_DGRAM_MAX];
+    struct sockaddr_in from;
+    socklen_t from_len;
+    dgram_peer_t *peer;
+    ssize_t n;
+
+    for (;;) {
+        from_len = sizeof(from);
+        n = recvfrom(server->fd, datagram, sizeof(datagram), MSG_TRUNC,
+                     (struct sockaddr *)&from, &from_len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;  /* EAGAIN, or an ICMP error for some earlier send */
+        }
+        if (n == 0 || (size_t)n > sizeof(datagram) ||
+            from.sin_family != AF_INET) {
+            continue;
+        }
+
+        peer = peer_find(server, &from);
+        if (peer == NULL) {
+            if (!opens_association(datagram, (uint32_t)n)) {
+                continue;
+            }
+            peer = peer_new(server, &from);
+            if (peer == NULL) {
+                continue;
+            }
+        }
+        peer_receive(peer, datagram, (uint32_t)n);
+    }
+}
+
+/* ============================================================================
+ * Layer 2
+ * ============================================================================ */
+
+/**
+ * read_link - Handle every frame waiting in the receive ring
+ *
+ * Peers are told apart by MAC and association; frames carrying
+ * XOE_WIRE_L2_FROM_SERVER are our own (loopback) or another server's.
+ */
+static void read_link(dgram_server_t *server)
+{
+    l2_ring_frame_t frame;
+    const uint8_t *datagram;
+    uint32_t association;
+    uint32_t len;
+    uint16_t flags;
+    dgram_peer_t *peer;
+
+    while (l2_ring_recv(server->link, &frame)) {
+        if (xoe_wire_l2_parse(frame.data, frame.len, &association, &flags,
+                              &datagram, &len) != 0 ||
+            (flags & XOE_WIRE_L2_FROM_SERVER)) {
+            continue;
+        }
+
+        peer = peer_find_link(server, frame.src, association);
+        if (peer == NULL) {
+            if (!opens_association(datagram, len)) {
+                continue;
+            }
+            peer = peer_new_link(server, frame.src, association);
+            if (peer == NULL) {
+                continue;
+            }
+        }
+        peer_receive(peer, datagram, len);
+    }
+}
+
+/* ============================================================================
+ * DTLS
+ * ============================================================================ */
+
+#if TLS_ENABLED
+/**
+ * peer_handshake - Continue a peer's DTLS handshake
+ *
+ * Returns: 0 (done or in progress), negative error code if it failed
+ */
+static int peer_handshake(dgram_peer_t *peer)
+{
+    int result = tls_session_handshake_step((SSL *)peer->ssl);
+
+    if (result == 0) {
+        peer->handshaking = FALSE;
+        return 0;
+    }
+    return (result > 0) ? 0 : result;
+}
+
+/**
+ * accept_dtls - Take every client whose cookie checks out
+ *
+ * A client already known by address started over (it restarted with
+ * the same source port), so its old association goes.
+ */
+static void accept_dtls(dgram_server_t *server)
+{
+    struct sockaddr_in from;
+    dgram_peer_t *peer;
+    SSL *ssl;
+    int fd;
+
+    while ((ssl = tls_session_dtls_listen((SSL_CTX *)server->tls_ctx,
+                                          server->fd, &from)) != NULL) {
+        peer = peer_find(server, &from);
+        if (peer != NULL) {
+            peer_expire(peer, "restarted its handshake");
+        }
+
+        fd = open_socket(&server->address);
+        if (fd < 0 ||
+            connect(fd, (const struct sockaddr *)&from, sizeof(from)) != 0 ||
+            (peer = peer_new(server, &from)) == NULL) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            tls_session_destroy(ssl);
+            continue;
+        }
+
+        tls_session_dtls_attach(ssl, fd, &from);
+        peer->fd = fd;
+        peer->ssl = ssl;
+        peer->handshaking = TRUE;
+        if (peer_handshake(peer) != 0) {
+            peer_expire(peer, "failed its DTLS handshake");
+        }
+    }
+}
+
+/**
+ * read_dtls - Service a readable DTLS peer socket
+ *
+ * Returns: 0, or negative error code if the peer must go
+ */
+static int read_dtls(dgram_peer_t *peer)
+{
+    uint8_t datagram[XOE_WIRE_DGRAM_MAX];
+    int result;
+
+    if (peer->handshaking) {
+        result = peer_handshake(peer);
+        if (result != 0 || peer->handshaking) {
+            return result;
+        }
+    }
+
+    for (;;) {
+        result = xoe_wire_dgram_recv(peer->fd, peer->ssl, datagram,
+                                     sizeof(datagram));
+        if (result == E_WOULD_BLOCK) {
+            return 0;
+        }
+        if (result == E_NETWORK_ERROR || result == E_PROTOCOL_ERROR) {
+            continue;
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_NETWORK_ERROR : result;
+        }
+
+        result = peer_input(peer, datagram, (uint32_t)result);
+        if (result != 0) {
+            return result;
+        }
+    }
+}
+#endif
+
+/* ============================================================================
+ * Thread
+ * ============================================================================ */
+
+/**
+ * tick_peers - Run channel timers and expire silent or slow peers
+ *
+ * Returns: Milliseconds until a peer has timer work next
+ */
+static long tick_peers(dgram_server_t *server)
+{
+    dgram_peer_t *peer;
+    uint64_t now = latency_now_ms();
+    long wait_ms = DGRAM_SERVER_POLL_MS;
+    long next;
+    int result;
+    int i;
+
+    for (i = 0; i < DGRAM_SERVER_MAX_PEERS; i++) {
+        peer = &server->peers[i];
+        if (!peer->in_use) {
+            continue;
+        }
+
+        if (peer->channel == NULL) {
+            if (now >= peer->setup_deadline_ms) {
+                peer_expire(peer, "never completed its setup");
+                continue;
+            }
+            next = (long)(peer->setup_deadline_ms - now);
+#if TLS_ENABLED
+            if (peer->handshaking) {
+                long timer = tls_session_dtls_timer((SSL *)peer->ssl);
+
+                if (timer >= 0 && timer < next) {
+                    next = timer;
+                }
+            }
+#endif
+        } else {
+            result = serial_dgram_tick(peer->channel, now);
+            if (result != 0) {
+                peer_expire(peer, (result == E_TIMEOUT) ? "timed out"
+                                                        : "failed");
+                continue;
+            }
+            next = serial_dgram_next_ms(peer->channel, now);
+        }
+
+        if (next < wait_ms) {
+            wait_ms = next;
+        }
+    }
+
+    return wait_ms;
+}
+
+static void *dgram_server_thread(void *arg)
+{
+    dgram_server_t *server = (dgram_server_t *)arg;
+    dgram_peer_t *peer;
+    long wait_ms;
+    int count;
+    int ready;
+    int i;
+
+    for (;;) {
+        wait_ms = tick_peers(server);
+
+        server->fds[0].fd = server->wake[0];
+        server->fds[0].events = POLLIN;
+        server->fds[1].fd = server->fd;
+        server->fds[1].events = POLLIN;
+        server->fds[2].fd = (server->link != NULL) ? l2_ring_fd(server->link)
+                                                   : -1;
+        server->fds[2].events = POLLIN;
+        count = 3;
+        for (i = 0; i < DGRAM_SERVER_MAX_PEERS; i++) {
+            if (server->peers[i].in_use && server->peers[i].fd >= 0) {
+                server->fds[count].fd = server->peers[i].fd;
+                server->fds[count].events = POLLIN;
+                server->slot_of_fd[count] = i;
+                count++;
+            }
+        }
+
+        /* Whatever the last round queued on the ring leaves together */
+        if (server->link != NULL && l2_ring_flush(server->link) != 0) {
+            LOG_WARN("Layer-2 send failed: %s", strerror(errno));
+        }
+
+        ready = poll(server->fds, (nfds_t)count, (int)wait_ms);
+        if (ready < 0 && errno != EINTR) {
+            LOG_ERROR("Datagram server poll failed: %s", strerror(errno));
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        if (server->fds[0].revents != 0) {
+            break;
+        }
+
+        if (server->fds[1].revents != 0) {
+#if TLS_ENABLED
+            if (server->tls_ctx != NULL) {
+                accept_dtls(server);
+            } else
+#endif
+            {
+                read_plain(server);
+            }
+        }
+        if (server->fds[2].revents != 0) {
+            read_link(server);
+        }
+
+#if TLS_ENABLED
+        for (i = 3; i < count; i++) {
+            peer = &server->peers[server->slot_of_fd[i]];
+            if (server->fds[i].revents == 0 || !peer->in_use ||
+                peer->fd != server->fds[i].fd) {
+                continue;
+            }
+            if (read_dtls(peer) != 0) {
+                peer_expire(peer, "closed its association");
+            }
+        }
+#else
+        (void)peer;
+#endif
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+dgram_server_t *dgram_server_start(const xoe_config_t *config,
+                                   const struct sockaddr_in *address)
+{
+    dgram_server_t *server;
+    char mac[L2_RING_MAC_STRLEN];
+    int result;
+
+    server = (dgram_server_t *)calloc(1, sizeof(dgram_server_t));
+    if (server == NULL) {
+        fprintf(stderr, "Out of memory for the UDP listener\n");
+        return NULL;
+    }
+    server->address = *address;
+    server->fd = -1;
+    server->wake[0] = -1;
+    server->wake[1] = -1;
+
+#if TLS_ENABLED
+    if (config->use_udp && config->encryption_mode != ENCRYPT_NONE) {
+        server->tls_ctx = tls_context_init_dtls(config->cert_path,
+                                                config->key_path,
+                                                config->encryption_mode);
+        if (server->tls_ctx == NULL) {
+            fprintf(stderr, "Failed to initialize DTLS\n");
+            free(server);
+            return NULL;
+        }
+    }
+#endif
+
+    if (config->use_udp) {
+        server->fd = open_socket(address);
+        if (server->fd < 0) {
+            perror("UDP listener");
+            goto fail;
+        }
+    }
+    if (config->l2_interface[0] != '\0') {
+        result = l2_ring_open(config->l2_interface, XOE_WIRE_L2_ETHERTYPE,
+                              &server->link);
+        if (result != 0) {
+            fprintf(stderr, "Layer-2 listener on %s: %s\n",
+                    config->l2_interface,
+                    (result == E_PERMISSION_DENIED) ? "needs CAP_NET_RAW" :
+                    (result == E_NOT_FOUND) ? "no such interface" :
+                    (result == E_NOT_SUPPORTED) ? "AF_PACKET rings not "
+                                                  "supported" :
+                    "could not open the rings");
+            goto fail;
+        }
+    }
+
+    if (pipe(server->wake) != 0) {
+        perror("UDP listener: pipe");
+    } else if (thread_sched_create(&server->thread, THREAD_CLASS_NET,
+                                   dgram_server_thread, server) != 0) {
+        perror("UDP listener: pthread_create");
+    } else {
+        if (server->fd >= 0) {
+            printf("Serial bridges also on UDP port %d%s\n",
+                   ntohs(address->sin_port),
+                   (server->tls_ctx != NULL) ? " (DTLS)" : "");
+        }
+        if (server->link != NULL) {
+            printf("Serial bridges also on Ethernet %s (EtherType 0x%04x, "
+                   "MAC %s, unencrypted)\n", config->l2_interface,
+                   XOE_WIRE_L2_ETHERTYPE,
+                   l2_ring_format_mac(l2_ring_mac(server->link), mac));
+        }
+        return server;
+    }
+
+fail:
+    if (server->wake[0] >= 0) {
+        close(server->wake[0]);
+        close(server->wake[1]);
+    }
+    if (server->fd >= 0) {
+        close(server->fd);
+    }
+    l2_ring_close(server->link);
+#if TLS_ENABLED
+    tls_context_cleanup((SSL_CTX *)server->tls_ctx);
+#endif
+    free(server);
+    return NULL;
+}
+
+void dgram_server_stop(dgram_server_t *server)
+{
+    char byte = 0;
+    int i;
+
+    if (server == NULL) {
+        return;
+    }
+
+    if (write(server->wake[1], &byte, 1) != 1) {
+        perror("UDP listener: wake");
+    }
+    pthread_join(server->thread, NULL);
+
+    for (i = 0; i < DGRAM_SERVER_MAX_PEERS; i++) {
+        if (server->peers[i].in_use) {
+            peer_expire(&server->peers[i], "closed on shutdown");
+        }
+    }
+
+    close(server->wake[0]);
+    close(server->wake[1]);
+    if (server->fd >= 0) {
+        close(server->fd);
+    }
+    l2_ring_close(server->link);
+#if TLS_ENABLED
+    tls_context_cleanup((SSL_CTX *)server->tls_ctx);
+#endif
+    free(server);
+}
@@ -0,0 +1,71 @@
+/**
+ * dgram_server.h
+ *
+ * UDP / DTLS (--udp) and layer-2 (--l2) listener for serial channels,
+ * beside the TCP listeners of the same port.
+ *
+ * One thread serves every datagram association. With plain UDP all
+ * peers share the listening socket and are told apart by source
+ * address. With encryption each client first proves its address with a
+ * DTLS cookie (DTLSv1_listen), then gets a socket of its own, bound to
+ * the server port and connected to the client, so the kernel demuxes
+ * its records to the right DTLS session. Layer-2 peers share one
+ * AF_PACKET ring (lib/net/l2_ring.h) and are told apart by MAC and
+ * association (lib/protocol/wire_l2.h); what the thread sends to them
+ * leaves with one flush per loop iteration.
+ *
+ * An association starts with the client's HELLO (lib/protocol/wire_dgram.h)
+ * and carries one serial channel (connectors/serial/serial_dgram.h),
+ * which the server echoes as it echoes serial frames on TCP. Peers that
+ * stay silent for SERIAL_DGRAM_PEER_TIMEOUT_MS, or never finish their
+ * handshake and HELLO within DGRAM_SERVER_SETUP_MS, are forgotten.
+ *
+ * Associations live in this process only: they do not survive a
+ * restart or a takeover (core/handoff.h), and clients reconnect once
+ * their peer timeout expires.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef CORE_DGRAM_SERVER_H
+#define CORE_DGRAM_SERVER_H
+
+#include "core/config.h"
+
+#include <netinet/in.h>
+
+/* Associations served at once */
+#define DGRAM_SERVER_MAX_PEERS 256
+
+/* Milliseconds a new peer has for its DTLS handshake and HELLO */
+#define DGRAM_SERVER_SETUP_MS 10000
+
+/* Longest poll() wait, so tick work is never late by more (ms) */
+#define DGRAM_SERVER_POLL_MS 1000
+
+typedef struct dgram_server dgram_server_t;
+
+/**
+ * dgram_server_start - Open the UDP socket and / or ring and serve them
+ * @config: Server configuration (use_udp, l2_interface, encryption mode
+ *          and certificate paths)
+ * @address: Address and port to bind, as for the TCP listeners
+ *
+ * Encryption applies to UDP only: layer-2 links carry plain frames.
+ *
+ * Returns: Running server, or NULL if the socket, the ring, the DTLS
+ *          context or the thread could not be set up (the reason is
+ *          printed)
+ */
+dgram_server_t *dgram_server_start(const xoe_config_t *config,
+                                   const struct sockaddr_in *address);
+
+/**
+ * dgram_server_stop - Stop the thread and forget every association
+ * @server: Server from dgram_server_start() (NULL is ignored)
+ *
+ * DTLS peers are sent close_notify.
+ */
+void dgram_server_stop(dgram_server_t *server);
+
+#endif /* CORE_DGRAM_SERVER_H */
@@ -0,0 +1,1721 @@
+/**
+ * event_loop.c
+ *
+ * Event-driven connection engine for server mode.
+ *
+ * Each worker thread owns a kernel event queue and a doubly linked list
+ * of connections. The accept loop hands new connections to workers
+ * round-robin through a mutex-protected pending list plus a wakeup pipe,
+ * so connection lists and parser state are only ever touched by their
+ * owning worker.
+ *
+ * Sockets are level-triggered and non-blocking. Reads are drained in
+ * bounded batches for fairness; TLS handshakes are stepped as readiness
+ * events arrive instead of blocking a thread in SSL_accept().
+ *
+ * Handshake steps carry the asymmetric crypto (key exchange, signing), so
+ * with a handshake pool they run on its threads instead: the worker stops
+ * polling the socket, queues the connection, and takes it back once the
+ * step is done. A reconnect burst then queues on the pool while the
+ * workers keep serving open connections. The queue is bounded; when it is
+ * full the worker steps the handshake itself.
+ *
+ * Handshake deadlines sit on a per-worker timer wheel, so a worker with
+ * no deadline pending blocks in its poller until there is I/O instead of
+ * waking every second to scan its connections.
+ *
+ * Under the memory budget (lib/common/mem_budget.h) a connection that may
+ * not take more data is parked: its socket leaves the poller, so the
+ * kernel buffers fill and TCP flow control slows the peer down, and the
+ * worker checks its parked connections every timer tick until memory has
+ * been freed.
+ *
+ * Replies are never waited for: what a socket does not take is queued on
+ * its connection and sent when the socket polls writable. A connection
+ * with XOE_TRANSPORT_QUEUE_HIGH bytes queued is not read until half of
+ * them have left, so a peer that does not read its replies stops being
+ * served instead of stalling the worker or growing its queue.
+ */
+
+/* pthread_setaffinity_np() and cpu_set_t (worker CPU pinning) */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "core/event_loop.h"
+#include "core/config.h"
+#include "core/server.h"
+#include "core/raw_relay.h"
+#include "core/protocol_registry.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+#include "lib/common/timer_wheel.h"
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/wire_compress.h"
+#include "lib/protocol/wire_trace.h"
+#include "lib/protocol/wire_zerocopy.h"
+#include "lib/net/shm_link.h"
+#include "lib/net/event_poller.h"
+#include "connectors/usb/usb_server.h"
+
+#include "lib/security/tls_config.h"
+#if TLS_ENABLED
+#include <openssl/ssl.h>
+#include "lib/security/tls_session.h"
+#include "lib/security/tls_error.h"
+#endif
+
+/* Per-connection decoder staging buffer, initial size */
+#ifndef EVENT_LOOP_READ_CHUNK
+#if XOE_SMALL_FOOTPRINT
+#define EVENT_LOOP_READ_CHUNK 4096
+#else
+#define EVENT_LOOP_READ_CHUNK 16384
+#endif
+#endif
+
+/* Largest the staging buffer grows to while reads keep filling it */
+#ifndef EVENT_LOOP_READ_MAX
+#if XOE_SMALL_FOOTPRINT
+#define EVENT_LOOP_READ_MAX 16384
+#else
+#define EVENT_LOOP_READ_MAX 262144
+#endif
+#endif
+
+/* Reads per readiness event before yielding to other connections */
+#define EVENT_LOOP_READS_PER_EVENT 16
+
+/* Resolution of the worker timer wheels */
+#define EVENT_LOOP_TIMER_TICK_MS 10
+
+/* Handshake steps queued for the pool before workers step inline */
+#define EVENT_LOOP_HANDSHAKE_QUEUE 256
+
+/* conn_dispatch_frames(): the connection joined a raw channel */
+#define CONN_DISPATCH_RAW 1
+
+/* Connection lifecycle */
+typedef enum {
+    CONN_STATE_HANDSHAKE,   /* TLS handshake in progress */
+    CONN_STATE_HANDSHAKE_BUSY, /* Handshake step queued on / run by the pool */
+    CONN_STATE_OPEN         /* Exchanging wire frames */
+} conn_state_t;
+
+struct event_worker_t;
+
+/**
+ * event_conn_t - Per-connection state owned by a single worker
+ *
+ * Frame reassembly is done by the per-connection wire decoder: reads land
+ * in its staging buffer (or directly in a large payload) and completed
+ * packets are pulled out with xoe_wire_decoder_next().
+ */
+typedef struct event_conn_t {
+    client_info_t *client;          /* Pool slot (socket, address, TLS) */
+    conn_state_t state;             /* Lifecycle state */
+    int want_write;                 /* Write interest registered */
+    int throttled;                  /* Not read: output backed up */
+    int parked;                     /* Off the poller until memory frees */
+    uint64_t accepted_us;           /* For handshake time and deadline */
+    timer_wheel_timer_t handshake_timer; /* Handshake deadline */
+    xoe_wire_decoder_t decoder;     /* Incremental frame decoder */
+    xoe_transport_queue_t out;      /* What the socket did not take */
+
+    struct event_conn_t *prev;      /* Worker connection list */
+    struct event_conn_t *next;
+
+    /* Handshake offload (stays on the worker list while away) */
+    struct event_worker_t *owner;   /* Registering worker */
+    int handshake_result;           /* tls_session_handshake_step() */
+    struct event_conn_t *hs_next;   /* Pool queue / worker done list */
+} event_conn_t;
+
+/**
+ * handshake_pool_t - Threads that run TLS handshake steps for workers
+ */
+typedef struct {
+    pthread_t *threads;
+    int num_threads;
+    int threads_started;
+    pthread_mutex_t lock;           /* Protects the queue and stop */
+    pthread_cond_t cond;            /* Queue not empty, or stop */
+    int sync_initialized;
+    event_conn_t *head;             /* FIFO of queued steps */
+    event_conn_t *tail;
+    int queued;
+    int stop;
+} handshake_pool_t;
+
+typedef struct event_worker_t {
+    struct event_loop_t *loop;      /* Owning loop */
+    pthread_t thread;
+    int thread_started;
+    event_poller_t poller;          /* epoll, io_uring or kqueue */
+    int wake_pipe[2];               /* Acceptor -> worker wakeup */
+    pthread_mutex_t pending_lock;   /* Protects pending, handshaken, stop,
+                                       detach, exited */
+    int pending_lock_initialized;
+    event_conn_t *pending;          /* Handed off, not yet registered */
+    event_conn_t *handshaken;       /* Steps finished by the pool */
+    int stop;                       /* Shutdown requested */
+    int detach;                     /* Idle connections requested */
+    int exited;                     /* Thread no longer answers requests */
+    int detach_due;                 /* Worker-local copy of detach */
+    int kicked;                     /* server_flush_outbox() due (atomic) */
+    event_conn_t *conns;            /* Registered connections */
+    event_conn_t *closed;           /* Released during current batch */
+    int parked;                     /* Connections parked for memory */
+    handshake_pool_t *pool;         /* NULL: step handshakes inline */
+    timer_wheel_t timers;           /* Handshake deadlines */
+    xoe_transport_batch_t out_batch; /* Replies of the connection being
+                                        dispatched, sent together */
+} event_worker_t;
+
+struct event_loop_t {
+    event_worker_t *workers;
+    int num_workers;
+    unsigned int next_worker;       /* Round-robin cursor (atomic) */
+    handshake_pool_t pool;
+
+    /* event_loop_detach_idle() rendezvous */
+    pthread_mutex_t detach_lock;    /* Protects the fields below */
+    pthread_cond_t detach_cond;     /* A worker answered */
+    int detach_sync_initialized;
+    int detach_waiting;             /* Workers yet to answer */
+    int detach_remaining;           /* Connections the workers kept */
+    event_conn_t *detached;         /* Connections they gave up */
+};
+
+/* ========================================================================
+ * Helpers
+ * ======================================================================== */
+
+/**
+ * conn_free - Release a connection and its client slot
+ * @conn: Connection (already removed from poller and worker list)
+ */
+static void conn_free(event_conn_t *conn) {
+    /* Uncharges the slot's account, so before the slot can be reused */
+    xoe_wire_decoder_cleanup(&conn->decoder);
+    if (conn->client != NULL) {
+        server_release_client(conn->client);
+        conn->client = NULL;
+    }
+    xoe_transport_queue_free(&conn->out);
+    free(conn);
+    metrics_sub(METRIC_CONN_ACTIVE, 1);
+}
+
+/**
+ * conn_unlink - Remove a connection from its worker's list and poller
+ * @worker: Owning worker
+ * @conn: Registered connection
+ */
+static void conn_unlink(event_worker_t *worker, event_conn_t *conn) {
+    timer_wheel_cancel(&worker->timers, &conn->handshake_timer);
+
+    if (conn->parked) {
+        conn->parked = FALSE;
+        worker->parked--;
+    }
+
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        worker->conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+
+    event_poller_remove(&worker->poller, conn->client->client_socket);
+    conn->prev = NULL;
+    conn->next = NULL;
+}
+
+/**
+ * conn_close - Unregister a connection and schedule it for release
+ * @worker: Owning worker
+ * @conn: Connection to close
+ *
+ * The connection is parked on the worker's closed list and freed once the
+ * current event batch is done, since the batch may still reference it.
+ */
+static void conn_close(event_worker_t *worker, event_conn_t *conn) {
+    conn_unlink(worker, conn);
+    conn->next = worker->closed;
+    worker->closed = conn;
+}
+
+/**
+ * conn_is_closed - Check whether a connection was closed in this batch
+ */
+static int conn_is_closed(event_worker_t *worker, event_conn_t *conn) {
+    event_conn_t *it;
+
+    for (it = worker->closed; it != NULL; it = it->next) {
+        if (it == conn) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * conn_bind_output - Give the connection's transport its outbound queue
+ *
+ * Called again whenever the transport is rebound. shm links keep waiting
+ * for ring space: a ring has no writability to poll for.
+ */
+static void conn_bind_output(event_conn_t *conn) {
+    (void)xoe_transport_set_queue(&conn->client->transport, &conn->out);
+}
+
+/**
+ * conn_set_interest - Choose the readiness reported for a connection
+ * @worker: Owning worker
+ * @conn: Registered connection
+ * @want_write: Report writability
+ * @throttled: Stop reporting readability
+ */
+static void conn_set_interest(event_worker_t *worker, event_conn_t *conn,
+                              int want_write, int throttled) {
+    if (conn->want_write == want_write && conn->throttled == throttled) {
+        return;
+    }
+    if (event_poller_set_interest(&worker->poller,
+                                  conn->client->client_socket, conn,
+                                  !throttled, want_write) == 0) {
+        conn->want_write = want_write;
+        conn->throttled = throttled;
+    }
+}
+
+/**
+ * conn_update_output - Follow the connection's outbound queue
+ * @worker: Owning worker
+ * @conn: Open connection on the poller
+ *
+ * Write interest while bytes are queued; reading stops at
+ * XOE_TRANSPORT_QUEUE_HIGH and resumes below half of it.
+ */
+static void conn_update_output(event_worker_t *worker, event_conn_t *conn) {
+    size_t queued = xoe_transport_queued(&conn->client->transport);
+    int throttled = conn->throttled;
+
+    if (!throttled && queued >= XOE_TRANSPORT_QUEUE_HIGH) {
+        throttled = TRUE;
+        metrics_add(METRIC_CONN_OUT_THROTTLED, 1);
+    } else if (throttled && queued < XOE_TRANSPORT_QUEUE_HIGH / 2) {
+        throttled = FALSE;
+    }
+    conn_set_interest(worker, conn, queued > 0, throttled);
+}
+
+/* ========================================================================
+ * Connection I/O
+ * ======================================================================== */
+
+/**
+ * conn_dispatch_decoded - Dispatch every frame completed in the decoder
+ * @conn: Connection
+ *
+ * Returns: 0 to keep the connection, E_WOULD_BLOCK if the next frame
+ *          waits for memory, CONN_DISPATCH_RAW once it joined a raw
+ *          channel (no further frame is taken), another negative error
+ *          code to close it
+ */
+static int conn_dispatch_decoded(event_conn_t *conn) {
+    xoe_packet_t packet;
+    int result;
+
+    while ((result = xoe_wire_decoder_next(&conn->decoder, &packet)) == 1) {
+        result = xoe_wire_decompress_packet(conn->client->compress, &packet);
+        if (result != 0) {
+            LOG_WARN("Undecodable compressed frame from %s:%d",
+                    conn->client->client_ip,
+                    ntohs(conn->client->client_addr.sin_port));
+            xoe_wire_free_payload(&packet);
+            return result;
+        }
+        result = server_handle_packet(conn->client, &packet);
+        xoe_wire_free_payload(&packet);
+        if (result != 0) {
+            return result;
+        }
+        if (conn->client->raw_name[0] != '\0') {
+            return CONN_DISPATCH_RAW;
+        }
+        /* Negotiation may have changed checksum handling */
+        xoe_wire_decoder_set_features(&conn->decoder,
+                                      conn->client->wire_features);
+    }
+
+    if (result == E_CHECKSUM_MISMATCH) {
+        LOG_WARN("Checksum mismatch from %s:%d",
+                conn->client->client_ip,
+                ntohs(conn->client->client_addr.sin_port));
+    } else if (result == E_PROTOCOL_ERROR) {
+        LOG_WARN("Oversized frame from %s:%d",
+                conn->client->client_ip,
+                ntohs(conn->client->client_addr.sin_port));
+    } else if (result == E_OUT_OF_MEMORY) {
+        LOG_WARN("Frame from %s:%d does not fit the memory budget",
+                conn->client->client_ip,
+                ntohs(conn->client->client_addr.sin_port));
+    }
+#if WIRE_TRACE_DUMP_ON_ERROR
+    if (result == E_CHECKSUM_MISMATCH || result == E_PROTOCOL_ERROR) {
+        xoe_wire_trace_dump(conn->client->client_socket,
+                            result == E_CHECKSUM_MISMATCH ? "checksum mismatch"
+                                                          : "oversized frame",
+                            stderr);
+    }
+#endif
+
+    return result;
+}
+
+/**
+ * conn_dispatch_frames - Dispatch the decoded frames, replies batched
+ * @worker: Owning worker
+ * @conn: Connection
+ *
+ * Replies written inline while the frames of one read are dispatched
+ * are gathered in the worker's batch and leave in one write at the end
+ * (xoe_transport_cork()), rather than one write per frame.
+ *
+ * Returns: as conn_dispatch_decoded(); a failed final write closes
+ */
+static int conn_dispatch_frames(event_worker_t *worker, event_conn_t *conn) {
+    int result;
+    int flushed;
+
+    (void)xoe_transport_cork(&conn->client->transport, &worker->out_batch);
+    result = conn_dispatch_decoded(conn);
+    flushed = xoe_transport_uncork(&conn->client->transport);
+
+    if (flushed != 0 && (result == 0 || result == E_WOULD_BLOCK ||
+                         result == CONN_DISPATCH_RAW)) {
+        return flushed;
+    }
+    return result;
+}
+
+/**
+ * conn_recv - Non-blocking read into the connection's decoder
+ *
+ * Returns: bytes read (> 0), 0 on orderly close, E_WOULD_BLOCK when no
+ *          data is available, or another negative error code
+ */
+static int conn_recv(event_conn_t *conn) {
+    return xoe_wire_decoder_recv_transport(&conn->decoder,
+                                           &conn->client->transport);
+}
+
+/**
+ * conn_has_buffered - Check for bytes received but not yet read
+ *
+ * Level-triggered readiness only covers the socket, so data OpenSSL has
+ * already pulled off the wire, or left in a shared-memory link's ring,
+ * must be drained before yielding.
+ */
+static int conn_has_buffered(event_conn_t *conn) {
+    return xoe_transport_pending(&conn->client->transport);
+}
+
+/**
+ * conn_must_wait - Check whether the memory budget holds a connection back
+ *
+ * A frame already being received is let through to completion: its
+ * buffer is allocated, and holding it would only keep that memory longer.
+ */
+static int conn_must_wait(event_conn_t *conn) {
+    return conn->decoder.payload == NULL &&
+           (mem_budget_pressure() || mem_account_over(&conn->client->mem));
+}
+
+/**
+ * conn_park - Stop reading a connection until memory is freed
+ * @worker: Owning worker
+ * @conn: Open connection
+ */
+static void conn_park(event_worker_t *worker, event_conn_t *conn) {
+    event_poller_remove(&worker->poller, conn->client->client_socket);
+    conn->want_write = FALSE;
+    conn->throttled = FALSE;
+    conn->parked = TRUE;
+    worker->parked++;
+    metrics_add(METRIC_MEM_THROTTLED, 1);
+}
+
+/**
+ * conn_can_detach - Check whether a connection can leave the loop intact
+ * @conn: Registered connection
+ *
+ * Only the socket (and, with kernel TLS on both directions, the record
+ * keys inside it) can move; anything held in this process would be lost,
+ * as is a shared-memory link's mapping.
+ */
+static int conn_can_detach(event_conn_t *conn) {
+    client_info_t *client = conn->client;
+
+    if (conn->state != CONN_STATE_OPEN || conn->want_write || conn->parked ||
+        shm_link_find(client->client_socket) != NULL ||
+        client->mux != NULL || client->compress != NULL ||
+        client->serial_session != NULL || client->hub_member != NULL ||
+        protocol_registry_pending(client) ||
+        !xoe_wire_decoder_idle(&conn->decoder) ||
+        xoe_transport_queued(&client->transport) > 0 ||
+        xoe_wire_zerocopy_pending(client->client_socket) > 0) {
+        return FALSE;
+    }
+
+#if XOE_USB_ENABLED
+    if (usb_server_has_client(__atomic_load_n(&g_usb_server,
+                                              __ATOMIC_ACQUIRE),
+                              client->client_socket)) {
+        return FALSE;
+    }
+#endif
+
+#if TLS_ENABLED
+    if (client->tls_session != NULL &&
+        (tls_session_ktls_status(client->tls_session) !=
+             (TLS_KTLS_TX | TLS_KTLS_RX) ||
+         SSL_has_pending(client->tls_session))) {
+        return FALSE;
+    }
+#endif
+
+    return TRUE;
+}
+
+/**
+ * conn_start_raw - Hand a connection over to its raw channel
+ * @worker: Owning worker
+ * @conn: Connection whose RAW_JOIN was just dispatched
+ *
+ * The slot leaves the loop the way a connection passed in an upgrade
+ * does, so the same conditions apply; a client that sent anything behind
+ * its RAW_JOIN has a frame in the decoder and is closed instead. The
+ * decoder is released here, while its account is still ours to uncharge.
+ */
+static void conn_start_raw(event_worker_t *worker, event_conn_t *conn) {
+    client_info_t *client = conn->client;
+
+    if (!conn_can_detach(conn)) {
+        LOG_WARN("Raw channel %s refused for %s:%d: connection busy",
+                 client->raw_name, client->client_ip,
+                 ntohs(client->client_addr.sin_port));
+        conn_close(worker, conn);
+        return;
+    }
+
+    conn_unlink(worker, conn);
+    (void)xoe_transport_set_queue(&client->transport, NULL);
+    xoe_wire_decoder_cleanup(&conn->decoder);
+    conn->client = NULL;
+    conn->next = worker->closed;
+    worker->closed = conn;
+
+    if (raw_relay_join(client) != 0) {
+        server_release_client(client);
+    }
+}
+
+/**
+ * conn_on_readable - Drain available bytes through the frame parser
+ * @worker: Owning worker
+ * @conn: Connection
+ */
+static void conn_on_readable(event_worker_t *worker, event_conn_t *conn) {
+    int reads;
+    int n;
+
+    /* Zero-copy completions raise EPOLLERR, delivered here as readable */
+    (void)xoe_wire_zerocopy_reap(conn->client->client_socket);
+
+    for (reads = 0;
+         reads < EVENT_LOOP_READS_PER_EVENT || conn_has_buffered(conn);
+         reads++) {
+        if (conn_must_wait(conn)) {
+            conn_park(worker, conn);
+            return;
+        }
+
+        n = conn_recv(conn);
+
+        if (n == E_WOULD_BLOCK) {
+            return;
+        }
+
+        /* Orderly close and I/O errors both mean the peer is gone */
+        if (n <= 0) {
+            LOG_INFO("Client %s:%d disconnected", conn->client->client_ip,
+                     ntohs(conn->client->client_addr.sin_port));
+            conn_close(worker, conn);
+            return;
+        }
+
+        n = conn_dispatch_frames(worker, conn);
+        if (n == E_WOULD_BLOCK) {
+            conn_park(worker, conn);
+            return;
+        }
+        if (n == CONN_DISPATCH_RAW) {
+            conn_start_raw(worker, conn);
+            return;
+        }
+        if (n != 0) {
+            conn_close(worker, conn);
+            return;
+        }
+
+        conn_update_output(worker, conn);
+        if (conn->throttled) {
+            return;
+        }
+    }
+}
+
+/**
+ * conn_on_writable - Send queued bytes the socket takes now
+ * @worker: Owning worker
+ * @conn: Open connection on the poller
+ *
+ * Output held back for the queue (hub frames) follows it; a connection
+ * whose reading was paused is read again once the queue has drained.
+ */
+static void conn_on_writable(event_worker_t *worker, event_conn_t *conn) {
+    int throttled = conn->throttled;
+    int result;
+
+    (void)xoe_wire_zerocopy_reap(conn->client->client_socket);
+
+    result = xoe_transport_flush(&conn->client->transport);
+    if (result != 0 && result != E_WOULD_BLOCK) {
+        LOG_INFO("Client %s:%d disconnected", conn->client->client_ip,
+                 ntohs(conn->client->client_addr.sin_port));
+        conn_close(worker, conn);
+        return;
+    }
+
+    server_resume_output(conn->client);
+    conn_update_output(worker, conn);
+    if (throttled && !conn->throttled) {
+        conn_on_readable(worker, conn);
+    }
+}
+
+/**
+ * worker_update_output - Follow the queues server_flush_outbox() added to
+ * @worker: Worker (no event batch in progress)
+ */
+static void worker_update_output(event_worker_t *worker) {
+    event_conn_t *conn;
+
+    for (conn = worker->conns; conn != NULL; conn = conn->next) {
+        if (conn->state == CONN_STATE_OPEN && !conn->parked) {
+            conn_update_output(worker, conn);
+        }
+    }
+}
+
+/**
+ * worker_resume_parked - Take back parked connections memory allows again
+ * @worker: Worker (no event batch in progress)
+ *
+ * Frames held back in the decoder go first; the connection only returns
+ * to the poller once they are through. Queued output of the connections
+ * still parked is sent meanwhile, as it frees memory too.
+ */
+static void worker_resume_parked(event_worker_t *worker) {
+    event_conn_t *conn = worker->conns;
+    event_conn_t *next;
+    int result;
+
+    while (conn != NULL && worker->parked > 0) {
+        next = conn->next;
+        if (conn->parked &&
+            xoe_transport_queued(&conn->client->transport) > 0) {
+            result = xoe_transport_flush(&conn->client->transport);
+            if (result != 0 && result != E_WOULD_BLOCK) {
+                conn_close(worker, conn);
+                conn = next;
+                continue;
+            }
+        }
+        if (conn->parked && !conn_must_wait(conn)) {
+            conn->parked = FALSE;
+            worker->parked--;
+            result = conn_dispatch_frames(worker, conn);
+            if (result == E_WOULD_BLOCK) {
+                conn->parked = TRUE;
+                worker->parked++;
+            } else if (result == CONN_DISPATCH_RAW) {
+                conn_start_raw(worker, conn);
+            } else if (result != 0) {
+                conn_close(worker, conn);
+            } else if (event_poller_add(&worker->poller, conn->client->client_socket,
+                                  conn) != 0) {
+                perror("event loop: re-register connection");
+                conn_close(worker, conn);
+            } else {
+                conn_update_output(worker, conn);
+                /* Bytes may sit in OpenSSL or a shm ring without an event */
+                if (!conn->throttled) {
+                    conn_on_readable(worker, conn);
+                }
+            }
+        }
+        conn = next;
+    }
+}
+
+#if TLS_ENABLED
+/**
+ * conn_handshake_done - Apply the outcome of one handshake step
+ * @worker: Owning worker
+ * @conn: Connection in CONN_STATE_HANDSHAKE
+ * @result: tls_session_handshake_step() return value
+ *
+ * Returns: TRUE if the connection is open and may be read, FALSE otherwise
+ */
+static int conn_handshake_done(event_worker_t *worker, event_conn_t *conn,
+                               int result) {
+    if (result == TLS_HANDSHAKE_WANT_READ) {
+        conn_set_interest(worker, conn, FALSE, FALSE);
+        return FALSE;
+    }
+
+    if (result == TLS_HANDSHAKE_WANT_WRITE) {
+        conn_set_interest(worker, conn, TRUE, FALSE);
+        return FALSE;
+    }
+
+    if (result != 0) {
+        LOG_WARN("TLS handshake failed with %s:%d: %s",
+                conn->client->client_ip,
+                ntohs(conn->client->client_addr.sin_port),
+                tls_get_error_string());
+        metrics_add(METRIC_TLS_HANDSHAKE_FAILURES, 1);
+        conn_close(worker, conn);
+        return FALSE;
+    }
+
+    conn_set_interest(worker, conn, FALSE, FALSE);
+    conn->state = CONN_STATE_OPEN;
+    /* The handshake may have moved record encryption into the kernel */
+    xoe_transport_init_tls(&conn->client->transport, conn->client->tls_session);
+    conn_bind_output(conn);
+    timer_wheel_cancel(&worker->timers, &conn->handshake_timer);
+    metrics_add(METRIC_TLS_HANDSHAKES, 1);
+    metrics_add(METRIC_TLS_HANDSHAKE_US,
+                metrics_now_us() - conn->accepted_us);
+    LOG_INFO("TLS handshake successful with %s:%d%s",
+             conn->client->client_ip,
+             ntohs(conn->client->client_addr.sin_port),
+             tls_session_ktls_status(conn->client->tls_session) != 0 ?
+               " (kernel TLS)" : "");
+    return TRUE;
+}
+
+/**
+ * conn_offload_handshake - Queue the next handshake step on the pool
+ * @worker: Owning worker
+ * @conn: Connection in CONN_STATE_HANDSHAKE
+ *
+ * The socket leaves the poller until the step is handed back, so the
+ * worker neither sees its readiness nor touches its SSL meanwhile.
+ *
+ * Returns: TRUE if queued, FALSE if the worker must step it itself
+ */
+static int conn_offload_handshake(event_worker_t *worker, event_conn_t *conn) {
+    handshake_pool_t *pool = worker->pool;
+
+    if (pool == NULL) {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->stop || pool->queued >= EVENT_LOOP_HANDSHAKE_QUEUE) {
+        pthread_mutex_unlock(&pool->lock);
+        return FALSE;
+    }
+
+    event_poller_remove(&worker->poller, conn->client->client_socket);
+    conn->want_write = FALSE;
+    conn->state = CONN_STATE_HANDSHAKE_BUSY;
+    conn->hs_next = NULL;
+    if (pool->tail != NULL) {
+        pool->tail->hs_next = conn;
+    } else {
+        pool->head = conn;
+    }
+    pool->tail = conn;
+    pool->queued++;
+    metrics_add(METRIC_TLS_HANDSHAKE_QUEUED, 1);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    return TRUE;
+}
+
+/**
+ * conn_on_handshake - Advance a pending TLS handshake
+ * @worker: Owning worker
+ * @conn: Connection in CONN_STATE_HANDSHAKE
+ *
+ * Returns: TRUE if the connection is open and may be read, FALSE otherwise
+ */
+static int conn_on_handshake(event_worker_t *worker, event_conn_t *conn) {
+    if (conn_offload_handshake(worker, conn)) {
+        return FALSE;
+    }
+    return conn_handshake_done(worker, conn,
+                               tls_session_handshake_step(
+                                   conn->client->tls_session));
+}
+
+/**
+ * conn_handshake_timeout - Drop a connection stuck in the TLS handshake
+ * @worker: Owning worker
+ * @conn: Connection in CONN_STATE_HANDSHAKE
+ */
+static void conn_handshake_timeout(event_worker_t *worker, event_conn_t *conn) {
+    LOG_WARN("TLS handshake timed out with %s:%d",
+            conn->client->client_ip,
+            ntohs(conn->client->client_addr.sin_port));
+    metrics_add(METRIC_TLS_HANDSHAKE_FAILURES, 1);
+    conn_close(worker, conn);
+}
+
+/**
+ * conn_resume_handshake - Take back a connection whose step the pool ran
+ * @worker: Owning worker
+ * @conn: Connection in CONN_STATE_HANDSHAKE_BUSY
+ */
+static void conn_resume_handshake(event_worker_t *worker, event_conn_t *conn) {
+    conn->state = CONN_STATE_HANDSHAKE;
+
+    if (event_poller_add(&worker->poller, conn->client->client_socket,
+                   conn) != 0) {
+        perror("event loop: re-register connection");
+        conn_close(worker, conn);
+        return;
+    }
+
+    /* Application data may already sit decrypted inside OpenSSL */
+    if (conn_handshake_done(worker, conn, conn->handshake_result)) {
+        conn_on_readable(worker, conn);
+        return;
+    }
+
+    /* The deadline passed while the pool had it */
+    if (conn->state == CONN_STATE_HANDSHAKE &&
+        !conn_is_closed(worker, conn) &&
+        !timer_wheel_pending(&conn->handshake_timer)) {
+        conn_handshake_timeout(worker, conn);
+    }
+}
+
+/* ========================================================================
+ * Handshake Pool
+ * ======================================================================== */
+
+/**
+ * handshake_thread_func - Run queued handshake steps
+ * @arg: Pointer to handshake_pool_t
+ *
+ * Returns: NULL
+ */
+static void *handshake_thread_func(void *arg) {
+    handshake_pool_t *pool = (handshake_pool_t *)arg;
+    event_worker_t *worker;
+    event_conn_t *conn;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->head == NULL && !pool->stop) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        if (pool->stop) {
+            /* Queued connections stay on their workers, which close them */
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        conn = pool->head;
+        pool->head = conn->hs_next;
+        if (pool->head == NULL) {
+            pool->tail = NULL;
+        }
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+        metrics_sub(METRIC_TLS_HANDSHAKE_QUEUED, 1);
+
+        conn->handshake_result =
+            tls_session_handshake_step(conn->client->tls_session);
+
+        worker = conn->owner;
+        pthread_mutex_lock(&worker->pending_lock);
+        conn->hs_next = worker->handshaken;
+        worker->handshaken = conn;
+        pthread_mutex_unlock(&worker->pending_lock);
+
+        if (write(worker->wake_pipe[1], "h", 1) < 0 && errno != EAGAIN) {
+            perror("event loop: wake worker");
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * handshake_pool_start - Start the handshake threads
+ * @pool: Zeroed pool
+ * @num_threads: Thread count (0: no pool)
+ *
+ * Returns: 0 on success, -1 on failure (pool left for handshake_pool_stop)
+ */
+static int handshake_pool_start(handshake_pool_t *pool, int num_threads) {
+    int i;
+
+    if (num_threads == 0) {
+        return 0;
+    }
+
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_cond_init(&pool->cond, NULL) != 0) {
+        pthread_mutex_destroy(&pool->lock);
+        return -1;
+    }
+    pool->sync_initialized = TRUE;
+
+    pool->threads = (pthread_t *)calloc((size_t)num_threads,
+                                        sizeof(pthread_t));
+    if (pool->threads == NULL) {
+        return -1;
+    }
+    pool->num_threads = num_threads;
+
+    for (i = 0; i < num_threads; i++) {
+        if (thread_sched_create(&pool->threads[i], THREAD_CLASS_NET,
+                                handshake_thread_func, pool) != 0) {
+            perror("event loop: start handshake thread");
+            return -1;
+        }
+        pool->threads_started++;
+    }
+
+    return 0;
+}
+
+/**
+ * handshake_pool_stop - Stop the handshake threads and free the pool
+ * @pool: Pool (possibly never started)
+ *
+ * Steps already running finish and are handed back; queued ones are not
+ * run, so their connections can be closed by their workers.
+ */
+static void handshake_pool_stop(handshake_pool_t *pool) {
+    int i;
+
+    if (!pool->sync_initialized) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->threads_started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    /* Steps left in the queue will never run */
+    metrics_sub(METRIC_TLS_HANDSHAKE_QUEUED, (uint64_t)pool->queued);
+
+    free(pool->threads);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->lock);
+    memset(pool, 0, sizeof(handshake_pool_t));
+}
+#endif
+
+/* ========================================================================
+ * Worker Thread
+ * ======================================================================== */
+
+/**
+ * conn_handshake_expired - Handshake deadline timer callback
+ * @timer: The connection's handshake_timer
+ * @arg: Connection
+ *
+ * A step running on the pool is left to finish; the connection is
+ * dropped when it comes back (conn_resume_handshake()).
+ */
+static void conn_handshake_expired(timer_wheel_timer_t *timer, void *arg) {
+    event_conn_t *conn = (event_conn_t *)arg;
+
+    (void)timer;
+#if TLS_ENABLED
+    if (conn->state == CONN_STATE_HANDSHAKE) {
+        conn_handshake_timeout(conn->owner, conn);
+    }
+#else
+    (void)conn;
+#endif
+}
+
+/**
+ * worker_take_pending - Register connections handed off by the acceptor
+ * @worker: Worker
+ *
+ * Returns: TRUE if the worker has been asked to stop
+ */
+static int worker_take_pending(event_worker_t *worker) {
+    event_conn_t *list;
+    event_conn_t *handshaken;
+    event_conn_t *next;
+    char drain[64];
+    int stop;
+
+    /* Drain wakeup bytes (pipe is non-blocking) */
+    while (read(worker->wake_pipe[0], drain, sizeof(drain)) > 0) {
+        /* discard */
+    }
+
+    pthread_mutex_lock(&worker->pending_lock);
+    list = worker->pending;
+    worker->pending = NULL;
+    handshaken = worker->handshaken;
+    worker->handshaken = NULL;
+    stop = worker->stop;
+    if (worker->detach) {
+        /* Answered after the batch, when no event refers to a conn */
+        worker->detach = FALSE;
+        worker->detach_due = TRUE;
+    }
+    pthread_mutex_unlock(&worker->pending_lock);
+
+#if TLS_ENABLED
+    /* Already on the connection list, only out of the poller */
+    while (handshaken != NULL) {
+        next = handshaken->hs_next;
+        conn_resume_handshake(worker, handshaken);
+        handshaken = next;
+    }
+#else
+    (void)handshaken;
+#endif
+
+    while (list != NULL) {
+        next = list->next;
+
+        if (event_poller_add(&worker->poller, list->client->client_socket,
+                       list) != 0) {
+            perror("event loop: register connection");
+            conn_free(list);
+        } else {
+            list->prev = NULL;
+            list->next = worker->conns;
+            if (worker->conns != NULL) {
+                worker->conns->prev = list;
+            }
+            worker->conns = list;
+            list->owner = worker;
+            list->client->loop_owner = worker;
+
+            timer_wheel_timer_init(&list->handshake_timer,
+                                   conn_handshake_expired, list);
+            if (list->state == CONN_STATE_HANDSHAKE) {
+                timer_wheel_add(&worker->timers, &list->handshake_timer,
+                                list->accepted_us / 1000 +
+                                EVENT_LOOP_HANDSHAKE_TIMEOUT * 1000ULL);
+            }
+        }
+        list = next;
+    }
+
+    return stop;
+}
+
+/**
+ * worker_free_closed - Release connections closed during the last batch
+ */
+static void worker_free_closed(event_worker_t *worker) {
+    event_conn_t *conn;
+
+    while (worker->closed != NULL) {
+        conn = worker->closed;
+        worker->closed = conn->next;
+        conn_free(conn);
+    }
+}
+
+/**
+ * worker_detach_idle - Answer an event_loop_detach_idle() request
+ * @worker: Worker (no event batch in progress)
+ */
+static void worker_detach_idle(event_worker_t *worker) {
+    event_loop_t *loop = worker->loop;
+    event_conn_t *conn = worker->conns;
+    event_conn_t *detached = NULL;
+    event_conn_t *next;
+    int remaining = 0;
+
+    while (conn != NULL) {
+        next = conn->next;
+        if (conn_can_detach(conn)) {
+            conn_unlink(worker, conn);
+            (void)xoe_transport_set_queue(&conn->client->transport, NULL);
+            conn->next = detached;
+            detached = conn;
+        } else {
+            remaining++;
+        }
+        conn = next;
+    }
+
+    pthread_mutex_lock(&loop->detach_lock);
+    while (detached != NULL) {
+        next = detached->next;
+        detached->next = loop->detached;
+        loop->detached = detached;
+        detached = next;
+    }
+    loop->detach_remaining += remaining;
+    loop->detach_waiting--;
+    pthread_cond_broadcast(&loop->detach_cond);
+    pthread_mutex_unlock(&loop->detach_lock);
+}
+
+/**
+ * worker_thread_func - Event loop worker
+ * @arg: Pointer to event_worker_t
+ *
+ * Returns: NULL
+ */
+static void *worker_thread_func(void *arg) {
+    event_worker_t *worker = (event_worker_t *)arg;
+    event_poller_event_t events[EVENT_POLLER_MAX_EVENTS];
+    int stop = FALSE;
+    long timeout;
+    int n;
+    int i;
+
+    while (!stop) {
+        /* Sleep until I/O or the next handshake deadline */
+        timeout = timer_wheel_next_ms(&worker->timers, latency_now_ms());
+        if (worker->parked > 0 &&
+            (timeout < 0 || timeout > EVENT_LOOP_TIMER_TICK_MS)) {
+            timeout = EVENT_LOOP_TIMER_TICK_MS;
+        }
+        n = event_poller_wait(&worker->poller, events, EVENT_POLLER_MAX_EVENTS,
+                              (int)timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("event loop: wait");
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            event_conn_t *conn = (event_conn_t *)events[i].data;
+
+            if (conn == NULL) {
+                if (worker_take_pending(worker)) {
+                    stop = TRUE;
+                }
+                continue;
+            }
+
+            /* kqueue may report read and write separately for one conn;
+             * a handshake handed to the pool in this batch is not ours,
+             * and one parked in this batch waits for memory */
+            if (conn_is_closed(worker, conn) || conn->parked ||
+                conn->state == CONN_STATE_HANDSHAKE_BUSY) {
+                continue;
+            }
+
+#if TLS_ENABLED
+            if (conn->state == CONN_STATE_HANDSHAKE) {
+                if (!conn_on_handshake(worker, conn)) {
+                    continue;
+                }
+            }
+#endif
+
+            /* A paused connection's hangup is reported as readable */
+            if (events[i].writable || (conn->throttled && events[i].readable)) {
+                conn_on_writable(worker, conn);
+                if (conn_is_closed(worker, conn) || conn->throttled) {
+                    continue;
+                }
+            }
+
+            if (events[i].readable || conn_has_buffered(conn)) {
+                conn_on_readable(worker, conn);
+            }
+        }
+
+        if (worker->parked > 0) {
+            worker_resume_parked(worker);
+        }
+
+        worker_free_closed(worker);
+
+        if (worker->detach_due) {
+            worker->detach_due = FALSE;
+            worker_detach_idle(worker);
+        }
+
+        if (timer_wheel_advance(&worker->timers, latency_now_ms()) > 0) {
+            worker_free_closed(worker);
+        }
+
+        /* After the releases: a closed connection has left the hub */
+        if (__atomic_exchange_n(&worker->kicked, FALSE, __ATOMIC_ACQ_REL)) {
+            server_flush_outbox(worker);
+            worker_update_output(worker);
+        }
+    }
+
+    /* Answer a detach request that raced the stop, then take no more */
+    worker_take_pending(worker);
+    pthread_mutex_lock(&worker->pending_lock);
+    worker->exited = TRUE;
+    if (worker->detach) {
+        worker->detach = FALSE;
+        worker->detach_due = TRUE;
+    }
+    pthread_mutex_unlock(&worker->pending_lock);
+    if (worker->detach_due) {
+        worker->detach_due = FALSE;
+        worker_detach_idle(worker);
+    }
+
+    /* Release everything this worker still owns */
+    while (worker->conns != NULL) {
+        conn_close(worker, worker->conns);
+    }
+    worker_free_closed(worker);
+
+    return NULL;
+}
+
+/* ========================================================================
+ * Public API
+ * ======================================================================== */
+
+/**
+ * event_loop_init - Create the event loop and start its workers
+ * @num_workers: Number of worker threads (1..EVENT_LOOP_MAX_WORKERS)
+ * @handshake_threads: TLS handshake pool threads
+ *                     (0..EVENT_LOOP_MAX_HANDSHAKE_THREADS, 0 = inline)
+ * @use_io_uring: Poll with io_uring instead of epoll where available
+ *
+ * Returns: Event loop handle, or NULL on failure
+ */
+event_loop_t *event_loop_init(int num_workers, int handshake_threads,
+                              int use_io_uring) {
+    event_loop_t *loop;
+    int i;
+
+    if (num_workers <= 0 || num_workers > EVENT_LOOP_MAX_WORKERS ||
+        handshake_threads < 0 ||
+        handshake_threads > EVENT_LOOP_MAX_HANDSHAKE_THREADS) {
+        return NULL;
+    }
+
+    loop = (event_loop_t *)calloc(1, sizeof(event_loop_t));
+    if (loop == NULL) {
+        return NULL;
+    }
+
+    loop->workers = (event_worker_t *)calloc((size_t)num_workers,
+                                             sizeof(event_worker_t));
+    if (loop->workers == NULL) {
+        free(loop);
+        return NULL;
+    }
+    loop->num_workers = num_workers;
+
+    if (pthread_mutex_init(&loop->detach_lock, NULL) != 0) {
+        free(loop->workers);
+        free(loop);
+        return NULL;
+    }
+    if (pthread_cond_init(&loop->detach_cond, NULL) != 0) {
+        pthread_mutex_destroy(&loop->detach_lock);
+        free(loop->workers);
+        free(loop);
+        return NULL;
+    }
+    loop->detach_sync_initialized = TRUE;
+
+    /* Mark descriptors unset so a partial failure can be unwound */
+    for (i = 0; i < num_workers; i++) {
+        loop->workers[i].loop = loop;
+        loop->workers[i].poller.fd = -1;
+        loop->workers[i].wake_pipe[0] = -1;
+        loop->workers[i].wake_pipe[1] = -1;
+    }
+
+#if TLS_ENABLED
+    /* Before the workers, which may start handing steps over at once */
+    if (handshake_pool_start(&loop->pool, handshake_threads) != 0) {
+        goto fail;
+    }
+    for (i = 0; i < num_workers; i++) {
+        loop->workers[i].pool = (handshake_threads > 0) ? &loop->pool : NULL;
+    }
+#else
+    (void)handshake_threads;
+#endif
+
+    for (i = 0; i < num_workers; i++) {
+        event_worker_t *worker = &loop->workers[i];
+
+        if (pthread_mutex_init(&worker->pending_lock, NULL) != 0) {
+            goto fail;
+        }
+        worker->pending_lock_initialized = TRUE;
+        timer_wheel_init(&worker->timers, latency_now_ms(),
+                         EVENT_LOOP_TIMER_TICK_MS);
+
+        if (event_poller_create(&worker->poller, use_io_uring) != 0) {
+            perror("event loop: create poller");
+            goto fail;
+        }
+
+        if (pipe(worker->wake_pipe) != 0) {
+            perror("event loop: create wakeup pipe");
+            goto fail;
+        }
+        if (fd_set_nonblocking(worker->wake_pipe[0]) != 0 ||
+            fd_set_nonblocking(worker->wake_pipe[1]) != 0 ||
+            event_poller_add(&worker->poller, worker->wake_pipe[0], NULL) != 0) {
+            perror("event loop: register wakeup pipe");
+            goto fail;
+        }
+
+        if (thread_sched_create(&worker->thread, THREAD_CLASS_NET,
+                                worker_thread_func, worker) != 0) {
+            perror("event loop: pthread_create");
+            goto fail;
+        }
+        worker->thread_started = TRUE;
+    }
+
+    return loop;
+
+fail:
+    event_loop_cleanup(loop);
+    return NULL;
+}
+
+/**
+ * loop_enqueue - Queue a new connection for a worker and wake it
+ * @loop: Event loop handle
+ * @worker_index: Worker to own the connection, or -1 for round-robin
+ * @conn: Connection (the worker owns it from here)
+ */
+static void loop_enqueue(event_loop_t *loop, int worker_index,
+                         event_conn_t *conn) {
+    event_worker_t *worker;
+
+    /* Requested worker, else round-robin (several acceptors may race) */
+    if (worker_index < 0) {
+        worker_index = (int)(__atomic_fetch_add(&loop->next_worker, 1,
+                                                __ATOMIC_RELAXED) %
+                             (unsigned int)loop->num_workers);
+    }
+    worker = &loop->workers[worker_index];
+
+    pthread_mutex_lock(&worker->pending_lock);
+    conn->next = worker->pending;
+    worker->pending = conn;
+    pthread_mutex_unlock(&worker->pending_lock);
+
+    /* A full pipe already guarantees a pending wakeup */
+    if (write(worker->wake_pipe[1], "c", 1) < 0 && errno != EAGAIN) {
+        perror("event loop: wake worker");
+    }
+}
+
+/**
+ * conn_create - Allocate the loop state for a client socket
+ * @client: Pool slot with client_socket set
+ * @out: Receives the connection, in CONN_STATE_OPEN
+ *
+ * Returns: 0 on success, E_NETWORK_ERROR or E_OUT_OF_MEMORY
+ */
+static int conn_create(client_info_t *client, event_conn_t **out) {
+    event_conn_t *conn;
+
+    if (fd_set_nonblocking(client->client_socket) != 0) {
+        perror("event loop: set O_NONBLOCK");
+        return E_NETWORK_ERROR;
+    }
+
+    /* The descriptor's trace history belongs to its previous owner */
+    xoe_wire_trace_reset(client->client_socket);
+
+    conn = (event_conn_t *)calloc(1, sizeof(event_conn_t));
+    if (conn == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    if (xoe_wire_decoder_init(&conn->decoder, EVENT_LOOP_READ_CHUNK) != 0) {
+        free(conn);
+        return E_OUT_OF_MEMORY;
+    }
+    xoe_wire_decoder_set_max_buffer(&conn->decoder, EVENT_LOOP_READ_MAX);
+    xoe_wire_decoder_set_account(&conn->decoder, &client->mem);
+    conn->client = client;
+    conn->state = CONN_STATE_OPEN;
+    conn->accepted_us = metrics_now_us();
+    /* Plain TCP or a shared-memory link; TLS rebinds once set up */
+    xoe_transport_init_fd(&client->transport, client->client_socket);
+    conn_bind_output(conn);
+    *out = conn;
+    return 0;
+}
+
+/**
+ * event_loop_add_client - Hand an accepted connection to the event loop
+ * @loop: Event loop handle
+ * @client: Acquired pool slot with client_socket and client_addr set
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int event_loop_add_client(event_loop_t *loop, client_info_t *client) {
+    return event_loop_add_client_on(loop, -1, client);
+}
+
+/**
+ * event_loop_add_client_on - Hand an accepted connection to a given worker
+ * @loop: Event loop handle
+ * @worker_index: Worker to own the connection, or -1 for round-robin
+ * @client: Acquired pool slot with client_socket and client_addr set
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int event_loop_add_client_on(event_loop_t *loop, int worker_index,
+                             client_info_t *client) {
+    event_conn_t *conn;
+    int result;
+#if TLS_ENABLED
+    SSL_CTX *tls_ctx;
+#endif
+
+    if (loop == NULL || client == NULL || client->client_socket < 0 ||
+        worker_index >= loop->num_workers) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    inet_ntop(AF_INET, &client->client_addr.sin_addr, client->client_ip,
+              sizeof(client->client_ip));
+    client->wire_features = 0;
+    LOG_INFO("Connection accepted from %s:%d", client->client_ip,
+             ntohs(client->client_addr.sin_port));
+
+    result = conn_create(client, &conn);
+    if (result != 0) {
+        return result;
+    }
+
+#if TLS_ENABLED
+    /* Same-host links are unencrypted (lib/net/shm_link.h) */
+    client->tls_session = NULL;
+    tls_ctx = (shm_link_find(client->client_socket) == NULL)
+              ? server_tls_ctx_acquire() : NULL;
+    if (tls_ctx != NULL) {
+        /* The session keeps its own reference across certificate reloads */
+        client->tls_session = tls_session_create_deferred(tls_ctx,
+                                                          client->client_socket);
+        SSL_CTX_free(tls_ctx);
+        if (client->tls_session == NULL) {
+            LOG_WARN("TLS session setup failed with %s:%d: %s",
+                    client->client_ip, ntohs(client->client_addr.sin_port),
+                    tls_get_error_string());
+            xoe_wire_decoder_cleanup(&conn->decoder);
+            free(conn);
+            return E_TLS_HANDSHAKE_FAILED;
+        }
+        xoe_transport_init_tls(&client->transport, client->tls_session);
+        conn_bind_output(conn);
+        conn->state = CONN_STATE_HANDSHAKE;
+    }
+#endif
+
+    metrics_add(METRIC_CONN_ACCEPTED, 1);
+    metrics_add(METRIC_CONN_ACTIVE, 1);
+
+    loop_enqueue(loop, worker_index, conn);
+    return 0;
+}
+
+/**
+ * event_loop_adopt_client - Resume a connection opened elsewhere
+ * @loop: Event loop handle
+ * @client: Acquired pool slot with client_socket and client_addr set
+ * @wire_features: Features negotiated before the connection moved
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int event_loop_adopt_client(event_loop_t *loop, client_info_t *client,
+                            uint32_t wire_features) {
+    event_conn_t *conn;
+    int result;
+
+    if (loop == NULL || client == NULL || client->client_socket < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    inet_ntop(AF_INET, &client->client_addr.sin_addr, client->client_ip,
+              sizeof(client->client_ip));
+    client->wire_features = wire_features;
+
+    result = conn_create(client, &conn);
+    if (result != 0) {
+        return result;
+    }
+    xoe_wire_decoder_set_features(&conn->decoder, wire_features);
+    LOG_INFO("Connection adopted from %s:%d", client->client_ip,
+             ntohs(client->client_addr.sin_port));
+
+    metrics_add(METRIC_CONN_ACTIVE, 1);
+
+    loop_enqueue(loop, -1, conn);
+    return 0;
+}
+
+/**
+ * event_loop_detach_idle - Take idle connections out of the loop
+ * @loop: Event loop handle
+ * @fn: Called for each detached connection, on the calling thread
+ * @arg: Passed to @fn
+ *
+ * Returns: Connections the loop still owns, or E_INVALID_ARGUMENT
+ */
+int event_loop_detach_idle(event_loop_t *loop, event_loop_detach_fn fn,
+                           void *arg) {
+    event_conn_t *detached;
+    event_conn_t *conn;
+    int remaining;
+    int i;
+
+    if (loop == NULL || fn == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&loop->detach_lock);
+    loop->detach_waiting = 0;
+    loop->detach_remaining = 0;
+    loop->detached = NULL;
+    pthread_mutex_unlock(&loop->detach_lock);
+
+    for (i = 0; i < loop->num_workers; i++) {
+        event_worker_t *worker = &loop->workers[i];
+        int asked = FALSE;
+
+        if (!worker->thread_started) {
+            continue;
+        }
+        pthread_mutex_lock(&worker->pending_lock);
+        if (!worker->exited) {
+            worker->detach = TRUE;
+            asked = TRUE;
+            pthread_mutex_lock(&loop->detach_lock);
+            loop->detach_waiting++;
+            pthread_mutex_unlock(&loop->detach_lock);
+        }
+        pthread_mutex_unlock(&worker->pending_lock);
+
+        if (asked &&
+            write(worker->wake_pipe[1], "d", 1) < 0 && errno != EAGAIN) {
+            perror("event loop: wake worker");
+        }
+    }
+
+    pthread_mutex_lock(&loop->detach_lock);
+    while (loop->detach_waiting > 0) {
+        pthread_cond_wait(&loop->detach_cond, &loop->detach_lock);
+    }
+    detached = loop->detached;
+    loop->detached = NULL;
+    remaining = loop->detach_remaining;
+    pthread_mutex_unlock(&loop->detach_lock);
+
+    while (detached != NULL) {
+        conn = detached;
+        detached = conn->next;
+        fn(conn->client, arg);
+        conn->client = NULL;
+        conn_free(conn);
+    }
+
+    return remaining;
+}
+
+/**
+ * event_loop_kick - Make a worker flush its outboxes
+ * @owner: Worker (client->loop_owner)
+ *
+ * Only the first kick before a flush writes to the wakeup pipe, and none
+ * from the worker itself, which checks the flag after its batch anyway.
+ */
+void event_loop_kick(void *owner) {
+    event_worker_t *worker = (event_worker_t *)owner;
+
+    if (worker == NULL ||
+        __atomic_exchange_n(&worker->kicked, TRUE, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+    if (!pthread_equal(pthread_self(), worker->thread) &&
+        write(worker->wake_pipe[1], "k", 1) < 0 && errno != EAGAIN) {
+        perror("event loop: kick worker");
+    }
+}
+
+/**
+ * event_loop_worker_count - Number of worker threads
+ * @loop: Event loop handle
+ */
+int event_loop_worker_count(const event_loop_t *loop) {
+    return (loop != NULL) ? loop->num_workers : 0;
+}
+
+/**
+ * event_loop_pin_thread - Restrict a thread to one CPU
+ * @thread: Thread to pin
+ * @cpu: CPU number (0-based)
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT, E_NOT_SUPPORTED off Linux,
+ *          or E_UNKNOWN_ERROR if the kernel refuses (e.g. CPU offline)
+ */
+int event_loop_pin_thread(pthread_t thread, int cpu) {
+#if defined(__linux__)
+    cpu_set_t set;
+
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    return 0;
+#else
+    (void)thread;
+    (void)cpu;
+    return E_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * event_loop_pin_worker - Restrict a worker thread to one CPU
+ * @loop: Event loop handle
+ * @worker_index: Worker (0..event_loop_worker_count() - 1)
+ * @cpu: CPU number (0-based)
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int event_loop_pin_worker(event_loop_t *loop, int worker_index, int cpu) {
+    if (loop == NULL || worker_index < 0 || worker_index >= loop->num_workers ||
+        !loop->workers[worker_index].thread_started) {
+        return E_INVALID_ARGUMENT;
+    }
+    return event_loop_pin_thread(loop->workers[worker_index].thread, cpu);
+}
+
+/**
+ * event_loop_cleanup - Stop all workers and release every connection
+ * @loop: Event loop handle (may be NULL)
+ */
+void event_loop_cleanup(event_loop_t *loop) {
+    int i;
+
+    if (loop == NULL) {
+        return;
+    }
+
+#if TLS_ENABLED
+    /* First, so no pool thread touches a connection a worker frees */
+    handshake_pool_stop(&loop->pool);
+#endif
+
+    /* Ask every worker to stop */
+    for (i = 0; i < loop->num_workers; i++) {
+        event_worker_t *worker = &loop->workers[i];
+
+        if (!worker->thread_started) {
+            continue;
+        }
+        pthread_mutex_lock(&worker->pending_lock);
+        worker->stop = TRUE;
+        pthread_mutex_unlock(&worker->pending_lock);
+        if (write(worker->wake_pipe[1], "q", 1) < 0 && errno != EAGAIN) {
+            perror("event loop: wake worker");
+        }
+    }
+
+    for (i = 0; i < loop->num_workers; i++) {
+        event_worker_t *worker = &loop->workers[i];
+
+        if (worker->thread_started) {
+            pthread_join(worker->thread, NULL);
+        }
+
+        /* Connections handed off after the worker exited */
+        while (worker->pending != NULL) {
+            event_conn_t *conn = worker->pending;
+            worker->pending = conn->next;
+            conn_free(conn);
+        }
+
+        if (worker->wake_pipe[0] >= 0) {
+            close(worker->wake_pipe[0]);
+        }
+        if (worker->wake_pipe[1] >= 0) {
+            close(worker->wake_pipe[1]);
+        }
+        event_poller_destroy(&worker->poller);
+        if (worker->pending_lock_initialized) {
+            pthread_mutex_destroy(&worker->pending_lock);
+        }
+    }
+
+    if (loop->detach_sync_initialized) {
+        pthread_cond_destroy(&loop->detach_cond);
+        pthread_mutex_destroy(&loop->detach_lock);
+    }
+
+    free(loop->workers);
+    free(loop);
+}
@@ -0,0 +1,181 @@
+/**
+ * event_loop.h
+ *
+ * Event-driven connection engine for server mode.
+ *
+ * A small fixed set of worker threads each own one kernel event queue
+ * (epoll or io_uring on Linux, kqueue on BSD/macOS) and multiplex many
+ * non-blocking client connections. Each connection keeps its own
+ * incremental wire frame parser, so a slow or partial peer never blocks
+ * a thread and a single readiness event can yield several complete
+ * packets.
+ *
+ * Ownership: once a connection is handed to the loop, its socket, TLS
+ * session and client pool slot belong to exactly one worker until that
+ * worker releases them via server_release_client().
+ */
+
+#ifndef CORE_EVENT_LOOP_H
+#define CORE_EVENT_LOOP_H
+
+#include "core/server.h"
+
+#include <pthread.h>
+
+/* Opaque event loop handle */
+typedef struct event_loop_t event_loop_t;
+
+/* Maximum worker threads accepted by event_loop_init() */
+#define EVENT_LOOP_MAX_WORKERS 64
+
+/* Maximum TLS handshake pool threads accepted by event_loop_init() */
+#define EVENT_LOOP_MAX_HANDSHAKE_THREADS 64
+
+/* Seconds a TLS connection may spend in its handshake before it is dropped */
+#define EVENT_LOOP_HANDSHAKE_TIMEOUT 10
+
+/**
+ * event_loop_init - Create the event loop and start its workers
+ * @num_workers: Number of worker threads (1..EVENT_LOOP_MAX_WORKERS)
+ * @handshake_threads: TLS handshake pool threads
+ *                     (0..EVENT_LOOP_MAX_HANDSHAKE_THREADS)
+ * @use_io_uring: Poll with io_uring instead of epoll (Linux 5.11+; other
+ *                kernels and platforms keep their default with a warning)
+ *
+ * Returns: Event loop handle, or NULL on failure
+ *
+ * With a pool, each TLS handshake step (and its public key crypto) runs
+ * on a pool thread; connections reach the workers' data path only once
+ * the handshake has completed. With 0 threads workers step handshakes
+ * themselves.
+ */
+event_loop_t *event_loop_init(int num_workers, int handshake_threads,
+                              int use_io_uring);
+
+/**
+ * event_loop_add_client - Hand an accepted connection to the event loop
+ * @loop: Event loop handle
+ * @client: Acquired pool slot with client_socket and client_addr set
+ *
+ * Returns: 0 on success, negative error code on failure
+ *
+ * Switches the socket to non-blocking mode, prepares a deferred TLS
+ * session when g_tls_ctx is set, and assigns the connection to a worker.
+ * On success the loop owns @client. On failure ownership stays with the
+ * caller, which must close the socket and release the slot.
+ */
+int event_loop_add_client(event_loop_t *loop, client_info_t *client);
+
+/**
+ * event_loop_add_client_on - Hand an accepted connection to a given worker
+ * @loop: Event loop handle
+ * @worker_index: Worker to own the connection, or -1 for round-robin
+ * @client: Acquired pool slot with client_socket and client_addr set
+ *
+ * Returns: 0 on success, negative error code on failure
+ *
+ * Same as event_loop_add_client(), but lets each of several accept
+ * threads feed its own workers (SO_REUSEPORT listeners) so a connection
+ * stays on the CPU that accepted it. Safe to call from several threads.
+ */
+int event_loop_add_client_on(event_loop_t *loop, int worker_index,
+                             client_info_t *client);
+
+/**
+ * event_loop_adopt_client - Resume a connection opened elsewhere
+ * @loop: Event loop handle
+ * @client: Acquired pool slot with client_socket and client_addr set
+ * @wire_features: Features negotiated before the connection moved
+ *
+ * Returns: 0 on success, negative error code on failure
+ *
+ * For a connection taken over from another process (see core/handoff.h)
+ * or handed back after event_loop_detach_idle(): no handshake is run
+ * and no TLS session is created, since the peer is mid-stream. A
+ * client->tls_session already set is kept. Ownership as for
+ * event_loop_add_client().
+ */
+int event_loop_adopt_client(event_loop_t *loop, client_info_t *client,
+                            uint32_t wire_features);
+
+/**
+ * event_loop_detach_fn - Receives a connection leaving the loop
+ * @client: Pool slot, now owned by the callee
+ * @arg: Caller's argument
+ *
+ * The callee either passes the socket on and then releases its copy with
+ * close() (never shutdown(), which would end the connection for the new
+ * owner too) and release_client_slot(), or hands it back with
+ * event_loop_adopt_client().
+ */
+typedef void (*event_loop_detach_fn)(client_info_t *client, void *arg);
+
+/**
+ * event_loop_detach_idle - Take idle connections out of the loop
+ * @loop: Event loop handle
+ * @fn: Called for each detached connection, on the calling thread
+ * @arg: Passed to @fn
+ *
+ * Returns: Connections the loop still owns, or E_INVALID_ARGUMENT
+ *
+ * Every worker gives up its connections whose whole state is the socket:
+ * open, between frames, without compression, multiplexed channels or a
+ * USB registration, and either plain TCP or TLS with kernel TLS in both
+ * directions and nothing buffered in OpenSSL. Blocks until every worker
+ * has answered. Call from one thread at a time; callers retry later for
+ * connections that were mid-frame.
+ */
+int event_loop_detach_idle(event_loop_t *loop, event_loop_detach_fn fn,
+                           void *arg);
+
+/**
+ * event_loop_kick - Make a worker flush its outboxes
+ * @owner: Worker, as found in client->loop_owner
+ *
+ * The worker calls server_flush_outbox() once its current event batch is
+ * done, so frames queued from other threads for its connections (the
+ * serial routing hub's fan-out) are sent by the thread that owns them.
+ * Wakes coalesce until the flush. Thread-safe and non-blocking;
+ * serial_hub_wake_fn for hub members.
+ */
+void event_loop_kick(void *owner);
+
+/**
+ * event_loop_worker_count - Number of worker threads
+ * @loop: Event loop handle
+ *
+ * Returns: Worker count, 0 for NULL
+ */
+int event_loop_worker_count(const event_loop_t *loop);
+
+/**
+ * event_loop_pin_worker - Restrict a worker thread to one CPU
+ * @loop: Event loop handle
+ * @worker_index: Worker (0..event_loop_worker_count() - 1)
+ * @cpu: CPU number (0-based)
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT, E_NOT_SUPPORTED where the
+ *          platform has no thread affinity (only Linux does), or
+ *          E_UNKNOWN_ERROR if the kernel refuses the CPU
+ */
+int event_loop_pin_worker(event_loop_t *loop, int worker_index, int cpu);
+
+/**
+ * event_loop_pin_thread - Restrict any thread to one CPU
+ * @thread: Thread to pin
+ * @cpu: CPU number (0-based)
+ *
+ * Returns: As event_loop_pin_worker()
+ */
+int event_loop_pin_thread(pthread_t thread, int cpu);
+
+/**
+ * event_loop_cleanup - Stop all workers and release every connection
+ * @loop: Event loop handle (may be NULL)
+ *
+ * Blocks until all worker threads have exited. Every connection still
+ * open is released through server_release_client().
+ */
+void event_loop_cleanup(event_loop_t *loop);
+
+#endif /* CORE_EVENT_LOOP_H */
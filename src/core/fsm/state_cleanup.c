@@ -9,7 +9,10 @@
 #include "core/config.h"
 #include "core/mgmt/mgmt_server.h"
 #include "core/mgmt/mgmt_config.h"
+#include "connectors/serial/serial_config.h"
 #include "connectors/usb/usb_config.h"
+#include "lib/common/log.h"
+#include "lib/protocol/wire_capture.h"
 
 #if TLS_ENABLED
 #include "core/server.h"
@@ -25,6 +28,8 @@
  * Cleanup operations:
  * - Free dynamically allocated serial configuration
  * - Cleanup global TLS context (if TLS enabled)
+ * - Finish the --capture file
+ * - Flush and stop the log writer
  * - Release other dynamically allocated resources
  *
  * This is the final state before application exit. All resources
@@ -41,6 +46,10 @@ xoe_state_t state_cleanup(xoe_config_t *config) {
         free(config->serial_config);
         config->serial_config = NULL;
     }
+    if (config->serial_multi != NULL) {
+        serial_multi_config_free((serial_multi_config_t*)config->serial_multi);
+        config->serial_multi = NULL;
+    }
 
     /* Free dynamically allocated USB configuration */
     if (config->usb_config != NULL) {
@@ -62,12 +71,24 @@ xoe_state_t state_cleanup(xoe_config_t *config) {
 
 #if TLS_ENABLED
     /* Cleanup global TLS context if still allocated */
-    if (g_tls_ctx != NULL) {
-        tls_context_cleanup(g_tls_ctx);
-        g_tls_ctx = NULL;
-    }
+    server_tls_ctx_replace(NULL);
 #endif
 
+    /* Finish the wire capture (after every connection has closed) */
+    if (config->capture_path != NULL) {
+        xoe_wire_capture_stats_t stats;
+
+        xoe_wire_capture_close();
+        xoe_wire_capture_get_stats(&stats);
+        LOG_INFO("Wire capture: %llu frames, %llu dropped, %llu bytes",
+                 (unsigned long long)stats.frames,
+                 (unsigned long long)stats.dropped,
+                 (unsigned long long)stats.bytes);
+    }
+
+    /* Write out queued log messages and stop the log writer */
+    log_stop();
+
     /* Additional cleanup can be added here as needed:
      * - Close open sockets
      * - Release other dynamically allocated resources
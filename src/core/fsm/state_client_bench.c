@@ -0,0 +1,99 @@
+/**
+ * state_client_bench.c
+ *
+ * Implements bench client mode: an echo load generator for sizing and
+ * regression-testing servers (see core/bench_client.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "core/config.h"
+#include "core/bench_client.h"
+#include "lib/common/definitions.h"
+
+#if TLS_ENABLED
+#include "lib/security/tls_config.h"
+#include "lib/security/tls_context.h"
+#endif
+
+/* Set by SIGINT/SIGTERM; ends the measured run early */
+static volatile sig_atomic_t g_bench_stop = 0;
+
+/**
+ * signal_handler - Stop the bench run on SIGINT and SIGTERM
+ * @signum: Signal number received
+ */
+static void signal_handler(int signum) {
+    (void)signum;
+    g_bench_stop = 1;
+}
+
+/**
+ * state_client_bench - Execute bench client mode
+ * @config: Pointer to configuration structure
+ *
+ * Returns: STATE_CLEANUP when the run is over
+ *
+ * Opens config->bench.connections connections to the server (TLS with
+ * -e), drives echo traffic for the configured time, and prints
+ * throughput and connection setup and round-trip percentiles. Ctrl-C
+ * ends the run early and still prints the report.
+ */
+xoe_state_t state_client_bench(xoe_config_t *config) {
+    bench_result_t result;
+    struct sigaction sa;
+    void *tls_ctx = NULL;
+    int status;
+
+    /* Every connection goes to the one server picked from a -c list */
+    if (choose_server(config, 0) != 0) {
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+#if TLS_ENABLED
+    if (config->encryption_mode == ENCRYPT_TLS12 ||
+        config->encryption_mode == ENCRYPT_TLS13) {
+        tls_ctx = tls_context_init_client(config->encryption_mode);
+        if (tls_ctx == NULL) {
+            fprintf(stderr, "Failed to initialize TLS client context\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+#endif
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    g_bench_stop = 0;
+
+    printf("Bench: connecting %d connection(s) to %s:%d%s\n",
+           config->bench.connections, config->connect_server_ip,
+           config->connect_server_port, tls_ctx != NULL ? " (TLS)" : "");
+
+    status = bench_client_run(&config->bench, config->connect_server_ip,
+                              config->connect_server_port, &config->sock_tune,
+                              tls_ctx, &g_bench_stop, &result);
+    if (status == 0) {
+        bench_client_report(stdout, &config->bench, &result);
+    } else {
+        fprintf(stderr, "Bench failed: error code %d\n", status);
+    }
+
+#if TLS_ENABLED
+    if (tls_ctx != NULL) {
+        tls_context_cleanup(tls_ctx);
+    }
+#endif
+
+    config->exit_code = (status == 0 && result.failed == 0 && result.lost == 0)
+                        ? EXIT_SUCCESS : EXIT_FAILURE;
+    return STATE_CLEANUP;
+}
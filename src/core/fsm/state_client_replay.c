@@ -0,0 +1,100 @@
+/**
+ * state_client_replay.c
+ *
+ * Implements replay client mode: re-drives a --capture trace file against
+ * a server (see core/replay_client.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "core/config.h"
+#include "core/replay_client.h"
+#include "lib/common/definitions.h"
+
+#if TLS_ENABLED
+#include "lib/security/tls_config.h"
+#include "lib/security/tls_context.h"
+#endif
+
+/* Set by SIGINT/SIGTERM; ends the replay early */
+static volatile sig_atomic_t g_replay_stop = 0;
+
+/**
+ * signal_handler - Stop the replay on SIGINT and SIGTERM
+ * @signum: Signal number received
+ */
+static void signal_handler(int signum) {
+    (void)signum;
+    g_replay_stop = 1;
+}
+
+/**
+ * state_client_replay - Execute replay client mode
+ * @config: Pointer to configuration structure
+ *
+ * Returns: STATE_CLEANUP when the replay is over
+ *
+ * Sends the frames of config->replay.path to the server (TLS with -e),
+ * one connection per captured connection, at --replay-speed times the
+ * original pace, and prints what was sent, what came back and how well
+ * the schedule was kept. Ctrl-C ends the replay early and still prints
+ * the report.
+ */
+xoe_state_t state_client_replay(xoe_config_t *config) {
+    replay_result_t result;
+    struct sigaction sa;
+    void *tls_ctx = NULL;
+    int status;
+
+    /* Every connection goes to the one server picked from a -c list */
+    if (choose_server(config, 0) != 0) {
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+#if TLS_ENABLED
+    if (config->encryption_mode == ENCRYPT_TLS12 ||
+        config->encryption_mode == ENCRYPT_TLS13) {
+        tls_ctx = tls_context_init_client(config->encryption_mode);
+        if (tls_ctx == NULL) {
+            fprintf(stderr, "Failed to initialize TLS client context\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+#endif
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    g_replay_stop = 0;
+
+    printf("Replay: %s to %s:%d%s\n", config->replay.path,
+           config->connect_server_ip, config->connect_server_port,
+           tls_ctx != NULL ? " (TLS)" : "");
+
+    status = replay_client_run(&config->replay, config->connect_server_ip,
+                               config->connect_server_port, &config->sock_tune,
+                               tls_ctx, &g_replay_stop, &result);
+    if (status == 0) {
+        replay_client_report(stdout, &config->replay, &result);
+    } else {
+        fprintf(stderr, "Replay failed: error code %d\n", status);
+    }
+
+#if TLS_ENABLED
+    if (tls_ctx != NULL) {
+        tls_context_cleanup(tls_ctx);
+    }
+#endif
+
+    config->exit_code = (status == 0 && result.failed == 0 && result.lost == 0)
+                        ? EXIT_SUCCESS : EXIT_FAILURE;
+    return STATE_CLEANUP;
+}
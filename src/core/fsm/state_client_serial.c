@@ -9,6 +9,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -16,13 +18,33 @@
 
 #include "core/config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/log.h"
+#include "lib/net/l2_ring.h"
 #include "lib/net/net_resolve.h"
+#include "lib/net/server_pool.h"
+#include "lib/net/shm_link.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/wire_l2.h"
 #include "connectors/serial/serial_config.h"
 #include "connectors/serial/serial_client.h"
+#include "connectors/serial/serial_hub.h"
+#include "connectors/serial/serial_multi_client.h"
+#include "connectors/serial/serial_mux.h"
+#include "connectors/serial/serial_session.h"
+
+#if TLS_ENABLED
+#include "lib/security/tls_config.h"
+#include "lib/security/tls_context.h"
+#include "lib/security/tls_session.h"
+#endif
 
 /* Global state for signal handler (C89 compatible) */
 static volatile sig_atomic_t g_shutdown_requested = 0;
 static serial_client_t* g_serial_client_ptr = NULL;
+static serial_mux_t* g_serial_mux_ptr = NULL;
+static serial_multi_client_t* g_serial_multi_ptr = NULL;
 
 /**
  * signal_handler - Handle SIGINT and SIGTERM for graceful shutdown
@@ -41,6 +63,604 @@ static void signal_handler(int signum) {
     if (g_serial_client_ptr != NULL) {
         serial_client_request_shutdown(g_serial_client_ptr);
     }
+    if (g_serial_mux_ptr != NULL) {
+        serial_mux_request_shutdown(g_serial_mux_ptr);
+    }
+    if (g_serial_multi_ptr != NULL) {
+        serial_multi_client_request_shutdown(g_serial_multi_ptr);
+    }
+}
+
+/**
+ * install_signal_handlers - Route SIGINT/SIGTERM to signal_handler
+ */
+static void install_signal_handlers(void) {
+    struct sigaction sa;
+
+    /* NET-009 fix: use sigaction */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+/**
+ * negotiate_features - Request the configured frame compression and more
+ * @config:   Pointer to configuration structure
+ * @sock:     Connected socket, before any other traffic
+ * @tls:      SSL* on @sock, or NULL
+ * @extra:    Further XOE_WIRE_FEATURE_* bits to request
+ * @accepted: Output: features granted by the server
+ *
+ * Returns: 0 on success (also when nothing is requested or the server
+ *          declines), negative error code if the exchange failed
+ */
+static int negotiate_features(xoe_config_t *config, int sock, void *tls,
+                              uint32_t extra, uint32_t *accepted) {
+    uint32_t requested = config->wire_compress | extra;
+    xoe_transport_t transport;
+    int result;
+
+    *accepted = 0;
+    if (requested == 0) {
+        return 0;
+    }
+
+    result = (tls != NULL) ? xoe_transport_init_tls(&transport, tls)
+                           : xoe_transport_init_fd(&transport, sock);
+    if (result != 0) {
+        return result;
+    }
+    return xoe_wire_negotiate_transport(&transport, requested, accepted);
+}
+
+/* Where the single-port bridge connects */
+typedef struct {
+    xoe_config_t *config;
+    server_pool_t *pool;        /* -c list with standby, or NULL */
+    int server;                 /* Server of the connection in the pool */
+} serial_link_t;
+
+/**
+ * link_connect - Connect the single-port bridge to its server
+ * @link:     Where to connect
+ * @sock_out: Output: connected socket
+ * @result:   Output: error details of a single server (may be NULL)
+ *
+ * With a -c list the pool picks the server, taking a standby connection
+ * if it has one; a server other than the last one is a failover.
+ *
+ * Returns: 0 on success, negative error code
+ */
+static int link_connect(serial_link_t *link, int *sock_out,
+                        net_resolve_result_t *result) {
+    xoe_config_t *config = link->config;
+    int previous = link->server;
+    int status;
+
+    if (link->pool == NULL) {
+        return net_resolve_connect_tuned(config->connect_server_ip,
+                                         config->connect_server_port,
+                                         &config->sock_tune,
+                                         sock_out, result);
+    }
+
+    status = server_pool_connect(link->pool, sock_out, &link->server);
+    if (status != 0) {
+        return status;
+    }
+    config->connect_server_ip = config->servers.hosts[link->server];
+    config->connect_server_port = config->servers.ports[link->server];
+    if (previous >= 0 && previous != link->server) {
+        LOG_WARN("Failing over to %s:%d", config->connect_server_ip,
+                 config->connect_server_port);
+    }
+    return 0;
+}
+
+/**
+ * reconnect_serial - Open a replacement connection for a resumed session
+ * @arg:          Where to connect (serial_link_t)
+ * @fd_out:       Output: connected socket
+ * @features_out: Output: granted features
+ *
+ * Returns: 0 on success, negative error code to retry later
+ *
+ * serial_client_reconnect_fn for the single-port bridge. With a -c list
+ * the server of the lost connection is passed over until a health check
+ * reaches it again.
+ */
+static int reconnect_serial(void *arg, int *fd_out, uint32_t *features_out) {
+    serial_link_t *link = (serial_link_t *)arg;
+    xoe_config_t *config = link->config;
+    net_resolve_result_t resolve_result;
+    int sock;
+    int result;
+
+    result = link_connect(link, &sock, &resolve_result);
+    if (result != 0) {
+        return (link->pool == NULL) ? resolve_result.error_code : result;
+    }
+
+    if (negotiate_features(config, sock, NULL, XOE_WIRE_FEATURE_SERIAL_RESUME,
+                           features_out) != 0 ||
+        !(*features_out & XOE_WIRE_FEATURE_SERIAL_RESUME)) {
+        shm_link_close(sock);
+        return E_PROTOCOL_ERROR;
+    }
+
+    *fd_out = sock;
+    return 0;
+}
+
+/**
+ * join_hub - Join the --hub topic on the server's routing hub
+ * @config: Configuration (hub_topic, hub_role)
+ * @sock:   Connected socket, before any serial traffic
+ *
+ * Returns: SERIAL_HUB_JOINED, SERIAL_HUB_TAKEN or SERIAL_HUB_REFUSED, or
+ *          a negative error code if the exchange failed
+ */
+static int join_hub(const xoe_config_t *config, int sock) {
+    xoe_packet_t packet;
+    int result;
+
+    result = serial_hub_join_frame(config->hub_topic, config->hub_role,
+                                   &packet);
+    if (result != 0) {
+        return result;
+    }
+    result = xoe_wire_send(sock, &packet);
+    serial_protocol_free_payload(&packet);
+    if (result != 0) {
+        return result;
+    }
+
+    result = xoe_wire_recv(sock, &packet);
+    if (result != 0) {
+        return result;
+    }
+    result = serial_hub_status_parse(&packet);
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * report_compression - Print the outcome of negotiate_features()
+ */
+static void report_compression(const xoe_config_t *config, uint32_t accepted) {
+    if (accepted & XOE_WIRE_FEATURE_COMPRESS_LZ4) {
+        printf("Frame compression: lz4\n");
+    } else if (accepted & XOE_WIRE_FEATURE_COMPRESS_ZLIB) {
+        printf("Frame compression: zlib\n");
+    } else if (config->wire_compress != 0) {
+        printf("Server declined frame compression\n");
+    }
+}
+
+/**
+ * run_serial_mux - Bridge several serial ports over one connection
+ * @config: Pointer to configuration structure
+ * @sock:   Connected socket (closed before returning)
+ * @multi:  Resolved serial ports
+ *
+ * Returns: STATE_CLEANUP when the concentrator exits
+ *
+ * Used with --serial-mux: every port becomes a channel of one multiplexed
+ * connection (see connectors/serial/serial_mux.h) instead of needing a
+ * connection of its own.
+ */
+static xoe_state_t run_serial_mux(xoe_config_t *config, int sock,
+                                  const serial_multi_config_t *multi) {
+    serial_mux_t* serial_mux;
+    int count = multi->device_count;
+    int result;
+
+    uint32_t accepted;
+
+    if (negotiate_features(config, sock, NULL, 0, &accepted) != 0) {
+        fprintf(stderr, "Feature negotiation with the server failed\n");
+        shm_link_close(sock);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    serial_mux = serial_mux_init(multi->devices, count, sock);
+    if (serial_mux == NULL ||
+        serial_mux_set_compression(serial_mux, accepted) != 0) {
+        fprintf(stderr, "Failed to open %d serial ports\n", count);
+        serial_mux_cleanup(&serial_mux);
+        shm_link_close(sock);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+    report_compression(config, accepted);
+
+    printf("Serial concentrator: %d ports over one connection\n", count);
+
+    install_signal_handlers();
+    g_serial_mux_ptr = serial_mux;
+    g_shutdown_requested = 0;
+
+    result = serial_mux_start(serial_mux);
+    if (result != 0) {
+        fprintf(stderr, "Failed to start serial concentrator: %d\n", result);
+        g_serial_mux_ptr = NULL;
+        serial_mux_stop(serial_mux);
+        serial_mux_cleanup(&serial_mux);
+        shm_link_close(sock);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    printf("Serial bridge active (Ctrl+C to exit)\n");
+
+    while (!g_shutdown_requested && !serial_mux_should_shutdown(serial_mux)) {
+        sleep(1);
+    }
+
+    g_serial_mux_ptr = NULL;
+
+    printf("\nShutting down serial bridge...\n");
+    serial_mux_stop(serial_mux);
+    serial_mux_cleanup(&serial_mux);
+    printf("Serial ports closed\n");
+
+    shm_link_close(sock);
+    printf("Client disconnected.\n");
+
+    config->exit_code = EXIT_SUCCESS;
+    return STATE_CLEANUP;
+}
+
+/**
+ * connect_dgram - Open a port's UDP association and negotiate its mode
+ * @config:   Configuration (server address)
+ * @device:   The port; its delivery mode is requested
+ * @tls_ctx:  DTLS client context, or NULL for plain UDP
+ * @sock_out: Output: connected non-blocking UDP socket
+ * @tls_out:  Output: DTLS session on it, or NULL
+ * @accepted: Output: features granted by the server
+ *
+ * Returns: 0 on success, negative error code (the reason is printed)
+ */
+static int connect_dgram(xoe_config_t *config, const serial_config_t *device,
+                         void *tls_ctx, int *sock_out, void **tls_out,
+                         uint32_t *accepted) {
+    struct sockaddr_in address;
+    net_resolve_result_t resolve_result;
+    char error_buf[256];
+    uint32_t requested = 0;
+    void *tls = NULL;
+    int sock;
+    int result;
+
+    if (net_resolve_to_sockaddr(config->connect_server_ip,
+                                config->connect_server_port, &address,
+                                &resolve_result) != 0) {
+        net_resolve_format_error(&resolve_result, error_buf, sizeof(error_buf));
+        fprintf(stderr, "Failed to resolve %s: %s\n",
+                config->connect_server_ip, error_buf);
+        return resolve_result.error_code;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0 ||
+        connect(sock, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        fd_set_nonblocking(sock) != 0) {
+        perror("UDP socket");
+        if (sock >= 0) {
+            close(sock);
+        }
+        return E_NETWORK_ERROR;
+    }
+
+#if TLS_ENABLED
+    if (tls_ctx != NULL) {
+        tls = tls_session_create_dtls_client((SSL_CTX *)tls_ctx, sock,
+                                             XOE_WIRE_DGRAM_HELLO_TIMEOUT_MS);
+        if (tls == NULL) {
+            fprintf(stderr, "DTLS handshake failed for %s\n",
+                    device->device_path);
+            close(sock);
+            return E_TLS_HANDSHAKE_FAILED;
+        }
+        /* DTLS records carry their own integrity check */
+        requested |= XOE_WIRE_FEATURE_NO_CHECKSUM;
+    }
+#else
+    (void)tls_ctx;
+#endif
+
+    if (device->delivery == SERIAL_DELIVERY_LATEST) {
+        requested |= XOE_WIRE_FEATURE_SERIAL_LATEST;
+    }
+    result = xoe_wire_dgram_negotiate(sock, tls, requested, accepted,
+                                      XOE_WIRE_DGRAM_HELLO_TIMEOUT_MS);
+    if (result != 0) {
+        fprintf(stderr, "No UDP answer from %s:%d for %s: error code %d\n",
+                config->connect_server_ip, config->connect_server_port,
+                device->device_path, result);
+#if TLS_ENABLED
+        tls_session_destroy((SSL *)tls);
+#endif
+        close(sock);
+        return result;
+    }
+
+    *sock_out = sock;
+    *tls_out = tls;
+    return 0;
+}
+
+/**
+ * open_link - Open the layer-2 ring of --l2 and hand it to the session
+ * @config: Pointer to configuration structure
+ * @client: Multi-port session (takes the ring)
+ *
+ * Returns: 0 on success, negative error code (the reason is printed)
+ */
+static int open_link(const xoe_config_t *config,
+                     serial_multi_client_t *client) {
+    l2_ring_t *ring;
+    int result;
+
+    result = l2_ring_open(config->l2_interface, XOE_WIRE_L2_ETHERTYPE, &ring);
+    if (result != 0) {
+        fprintf(stderr, "Cannot open Ethernet interface %s: %s\n",
+                config->l2_interface,
+                (result == E_PERMISSION_DENIED) ? "needs CAP_NET_RAW" :
+                (result == E_NOT_FOUND) ? "no such interface" :
+                (result == E_NOT_SUPPORTED) ? "AF_PACKET rings not supported" :
+                "could not open the rings");
+        return result;
+    }
+    if (serial_multi_client_set_link(client, ring) != 0) {
+        l2_ring_close(ring);
+        return E_INVALID_STATE;
+    }
+    return 0;
+}
+
+/**
+ * connect_l2 - Open one port's association on the layer-2 link
+ * @config:      Pointer to configuration structure
+ * @device:      Port to bridge
+ * @client:      Multi-port session holding the ring
+ * @index:       Port index
+ * @association: Association ID for the port
+ * @server_mac:  Server MAC (broadcast until one answered; updated then)
+ * @accepted:    Receives the features the server granted
+ *
+ * Returns: 0 on success, negative error code (the reason is printed)
+ */
+static int connect_l2(const xoe_config_t *config,
+                      const serial_config_t *device,
+                      serial_multi_client_t *client, int index,
+                      uint32_t association, uint8_t *server_mac,
+                      uint32_t *accepted) {
+    uint32_t requested = 0;
+    int result;
+
+    if (device->delivery == SERIAL_DELIVERY_LATEST) {
+        requested |= XOE_WIRE_FEATURE_SERIAL_LATEST;
+    }
+    result = xoe_wire_l2_negotiate(client->link, server_mac, association,
+                                   requested, accepted,
+                                   XOE_WIRE_DGRAM_HELLO_TIMEOUT_MS);
+    if (result != 0) {
+        fprintf(stderr, "No server answered on %s for %s: error code %d\n",
+                config->l2_interface, device->device_path, result);
+        return result;
+    }
+
+    result = serial_multi_client_attach_l2(client, index, server_mac,
+                                           association, *accepted);
+    if (result != 0) {
+        fprintf(stderr, "Failed to attach %s\n", device->device_path);
+    }
+    return result;
+}
+
+/**
+ * run_serial_multi - Bridge every listed serial port from one poll loop
+ * @config: Pointer to configuration structure
+ * @multi:  Resolved serial ports
+ *
+ * Returns: STATE_CLEANUP when the loop exits
+ *
+ * Used when -s names more than one port, or TLS is requested. Each port
+ * gets its own connection (and TLS session, all from one client context);
+ * the TTYs and sockets are then served by serial_multi_client_run() in
+ * this thread (see connectors/serial/serial_multi_client.h). Ports past
+ * SERIAL_MULTI_CONNECT_BURST connect at the server's admission pace.
+ * With --udp each port gets a UDP association (DTLS with -e) instead,
+ * and with --l2 an association on the Ethernet link, all ports sharing
+ * one ring; the first server to answer is used for every port unless
+ * --l2 names its MAC.
+ */
+static xoe_state_t run_serial_multi(xoe_config_t *config,
+                                    const serial_multi_config_t *multi) {
+    serial_multi_client_t* client;
+    net_resolve_result_t resolve_result;
+    char error_buf[256];
+    void* tls = NULL;
+    uint32_t accepted = 0;
+    uint32_t association = 0;
+    char mac_text[L2_RING_MAC_STRLEN];
+    int sock;
+    int result;
+    int i;
+    struct timespec pace;
+#if TLS_ENABLED
+    SSL_CTX* tls_ctx = NULL;
+#endif
+
+    pace.tv_sec = SERIAL_MULTI_CONNECT_INTERVAL_MS / 1000;
+    pace.tv_nsec = (long)(SERIAL_MULTI_CONNECT_INTERVAL_MS % 1000) * 1000000L;
+
+    /* Every port goes to the one server picked from a -c list */
+    if (config->connect_server_ip != NULL && choose_server(config, 0) != 0) {
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    client = serial_multi_client_init(multi->devices, multi->device_count);
+    if (client == NULL) {
+        fprintf(stderr, "Failed to open %d serial ports\n",
+                multi->device_count);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    install_signal_handlers();
+    g_shutdown_requested = 0;
+
+    if (config->l2_interface[0] != '\0') {
+        if (open_link(config, client) != 0) {
+            serial_multi_client_cleanup(&client);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        /* Consecutive IDs from a random base: one per port */
+        association = (uint32_t)serial_session_new_id();
+    }
+
+#if TLS_ENABLED
+    if (config->encryption_mode == ENCRYPT_TLS12 ||
+        config->encryption_mode == ENCRYPT_TLS13) {
+        tls_ctx = config->use_udp
+                  ? tls_context_init_dtls_client(config->encryption_mode)
+                  : tls_context_init_client(config->encryption_mode);
+        if (tls_ctx == NULL) {
+            fprintf(stderr, "Failed to initialize TLS client context\n");
+            serial_multi_client_cleanup(&client);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+#endif
+
+    for (i = 0; i < multi->device_count && !g_shutdown_requested; i++) {
+        if (config->l2_interface[0] != '\0') {
+            if (connect_l2(config, &multi->devices[i], client, i,
+                           association + (uint32_t)i, config->l2_server_mac,
+                           &accepted) != 0) {
+                break;
+            }
+            printf("%s: %s delivery over Ethernet\n",
+                   multi->devices[i].device_path,
+                   (accepted & XOE_WIRE_FEATURE_SERIAL_LATEST) ? "latest"
+                                                               : "reliable");
+            continue;
+        }
+        if (config->use_udp) {
+#if TLS_ENABLED
+            result = connect_dgram(config, &multi->devices[i], tls_ctx,
+                                   &sock, &tls, &accepted);
+#else
+            result = connect_dgram(config, &multi->devices[i], NULL,
+                                   &sock, &tls, &accepted);
+#endif
+            if (result != 0 ||
+                serial_multi_client_attach_dgram(client, i, sock, tls,
+                                                 accepted) != 0) {
+                if (result == 0) {
+                    fprintf(stderr, "Failed to attach %s\n",
+                            multi->devices[i].device_path);
+                }
+                break;
+            }
+            printf("%s: %s delivery over UDP\n", multi->devices[i].device_path,
+                   (accepted & XOE_WIRE_FEATURE_SERIAL_LATEST) ? "latest"
+                                                               : "reliable");
+            continue;
+        }
+
+        if (i >= SERIAL_MULTI_CONNECT_BURST) {
+            nanosleep(&pace, NULL);
+        }
+        if (net_resolve_connect_tuned(config->connect_server_ip,
+                                      config->connect_server_port,
+                                      &config->sock_tune,
+                                      &sock, &resolve_result) != 0) {
+            net_resolve_format_error(&resolve_result, error_buf,
+                                     sizeof(error_buf));
+            fprintf(stderr, "Failed to connect %s to %s:%d: %s\n",
+                    multi->devices[i].device_path, config->connect_server_ip,
+                    config->connect_server_port, error_buf);
+            break;
+        }
+
+#if TLS_ENABLED
+        if (tls_ctx != NULL) {
+            tls = tls_session_create_client(tls_ctx, sock);
+            if (tls == NULL) {
+                fprintf(stderr, "TLS handshake failed for %s\n",
+                        multi->devices[i].device_path);
+                shm_link_close(sock);
+                break;
+            }
+        }
+#endif
+
+        if (negotiate_features(config, sock, tls, 0, &accepted) != 0) {
+            fprintf(stderr, "Feature negotiation failed for %s\n",
+                    multi->devices[i].device_path);
+            break;
+        }
+
+        if (serial_multi_client_attach(client, i, sock, tls, accepted) != 0) {
+            fprintf(stderr, "Failed to attach %s\n",
+                    multi->devices[i].device_path);
+            break;
+        }
+    }
+
+    if (i < multi->device_count) {
+        serial_multi_client_cleanup(&client);
+#if TLS_ENABLED
+        tls_context_cleanup(tls_ctx);
+#endif
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    if (config->l2_interface[0] != '\0') {
+        printf("Serial bridge: %d ports over Ethernet %s (server %s)\n",
+               multi->device_count, config->l2_interface,
+               l2_ring_format_mac(config->l2_server_mac, mac_text));
+    } else {
+        printf("Serial bridge: %d ports connected to %s:%d%s\n",
+               multi->device_count, config->connect_server_ip,
+               config->connect_server_port,
+               (tls != NULL) ? (config->use_udp ? " over DTLS" : " over TLS")
+                             : (config->use_udp ? " over UDP" : ""));
+        report_compression(config, accepted);
+    }
+
+    g_serial_multi_ptr = client;
+    if (g_shutdown_requested) {
+        serial_multi_client_request_shutdown(client);
+    }
+
+    printf("Serial bridge active (Ctrl+C to exit)\n");
+    result = serial_multi_client_run(client);
+
+    g_serial_multi_ptr = NULL;
+
+    printf("\nShutting down serial bridge...\n");
+    serial_multi_client_cleanup(&client);
+#if TLS_ENABLED
+    tls_context_cleanup(tls_ctx);
+#endif
+    printf("Serial ports closed\n");
+    printf("Client disconnected.\n");
+
+    config->exit_code = (result == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    return STATE_CLEANUP;
 }
 
 /**
@@ -59,61 +679,170 @@ static void signal_handler(int signum) {
  * 5. Stop threads and cleanup
  *
  * This mode bridges a local serial port to a remote network server,
- * allowing serial communication over TCP/IP.
+ * allowing serial communication over TCP/IP. Several ports, TLS, --udp or
+ * --l2 are bridged from one poll loop with a connection per port
+ * (run_serial_multi);
+ * --serial-mux bridges all ports over the one connection (run_serial_mux).
+ *
+ * With a -c list of servers, a resumable single-port bridge keeps warm
+ * standby connections to the others (server_pool.h) and resumes on one
+ * of them when its server dies; every other bridge connects once to the
+ * server choose_server() picks.
  */
 xoe_state_t state_client_serial(xoe_config_t *config) {
     int sock = -1;
     serial_client_t* serial_client;
     serial_config_t *serial_cfg = (serial_config_t*)config->serial_config;
+    serial_multi_config_t *multi = (serial_multi_config_t*)config->serial_multi;
+    uint32_t accepted;
     int result;
     net_resolve_result_t resolve_result;
     char error_buf[256];
+    serial_link_t link;
 
-    /* Resolve hostname/IP and connect to server */
-    if (net_resolve_connect(config->connect_server_ip,
-                            config->connect_server_port,
-                            &sock, &resolve_result) != 0) {
-        net_resolve_format_error(&resolve_result, error_buf, sizeof(error_buf));
-        fprintf(stderr, "Failed to connect to %s:%d: %s\n",
-                config->connect_server_ip, config->connect_server_port, error_buf);
+    if (serial_cfg == NULL || multi == NULL || multi->device_count == 0) {
+        fprintf(stderr, "Serial configuration not initialized\n");
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
 
-    printf("Connected to server %s:%d\n",
-           config->connect_server_ip, config->connect_server_port);
+    if (!config->serial_mux &&
+        (multi->device_count > 1 || config->encryption_mode != 0 ||
+         config->use_udp || config->l2_interface[0] != '\0')) {
+        return run_serial_multi(config, multi);
+    }
+
+    /* A resumable bridge keeps the whole -c list to fail over to; hub
+     * members and the concentrator connect once, to the server picked */
+    link.config = config;
+    link.pool = NULL;
+    link.server = -1;
+    if (config->servers.count > 1 && !config->serial_mux &&
+        config->hub_topic[0] == '\0') {
+        link.pool = server_pool_create(&config->servers, &config->sock_tune, 0);
+        if (link.pool == NULL) {
+            fprintf(stderr, "Failed to check the servers\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    } else if (choose_server(config,
+                             server_pool_key(config->hub_topic)) != 0) {
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
 
-    if (serial_cfg == NULL) {
-        fprintf(stderr, "Serial configuration not initialized\n");
-        close(sock);
+    /* Resolve hostname/IP and connect to server */
+    result = link_connect(&link, &sock, &resolve_result);
+    if (result != 0) {
+        if (link.pool != NULL) {
+            fprintf(stderr, "None of the %d servers answered\n",
+                    config->servers.count);
+            server_pool_destroy(link.pool);
+        } else {
+            net_resolve_format_error(&resolve_result, error_buf,
+                                     sizeof(error_buf));
+            fprintf(stderr, "Failed to connect to %s:%d: %s\n",
+                    config->connect_server_ip, config->connect_server_port,
+                    error_buf);
+        }
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
 
+    if (config->connect_server_port == 0) {
+        printf("Connected to server %s\n", config->connect_server_ip);
+    } else {
+        printf("Connected to server %s:%d\n",
+               config->connect_server_ip, config->connect_server_port);
+    }
+
+    if (config->serial_mux) {
+        return run_serial_mux(config, sock, multi);
+    }
+
     printf("Serial mode enabled: %s at %d baud\n",
            serial_cfg->device_path, serial_cfg->baud_rate);
 
+    /* Hub frames are relayed as they are, without session ACKs */
+    if (negotiate_features(config, sock, NULL,
+                           (config->hub_topic[0] != '\0')
+                               ? 0 : XOE_WIRE_FEATURE_SERIAL_RESUME,
+                           &accepted) != 0) {
+        fprintf(stderr, "Feature negotiation with the server failed\n");
+        shm_link_close(sock);
+        server_pool_destroy(link.pool);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    if (config->hub_topic[0] != '\0') {
+        result = join_hub(config, sock);
+        if (result != SERIAL_HUB_JOINED) {
+            fprintf(stderr, "Cannot join hub topic \"%s\": %s\n",
+                    config->hub_topic,
+                    (result == SERIAL_HUB_TAKEN) ? "it has a publisher already" :
+                    (result == SERIAL_HUB_REFUSED) ? "refused by the server" :
+                    "no answer from the server");
+            shm_link_close(sock);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        printf("Hub topic \"%s\" joined as %s\n", config->hub_topic,
+               (config->hub_role == SERIAL_HUB_PUBLISHER) ? "publisher" :
+               (config->hub_role == SERIAL_HUB_WRITER) ? "writer" :
+               "subscriber");
+    }
+
     /* Initialize serial client */
     serial_client = serial_client_init(serial_cfg, sock);
-    if (serial_client == NULL) {
+    if (serial_client == NULL ||
+        serial_client_set_compression(serial_client, accepted) != 0) {
         fprintf(stderr, "Failed to initialize serial client\n");
-        close(sock);
+        serial_client_cleanup(&serial_client);
+        shm_link_close(sock);
+        server_pool_destroy(link.pool);
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
+    report_compression(config, accepted);
 
-    printf("Serial port opened successfully\n");
+    /* Survive dropped connections when the server keeps sessions */
+    if (accepted & XOE_WIRE_FEATURE_SERIAL_RESUME) {
+        result = serial_client_enable_resume(serial_client, accepted,
+                                             reconnect_serial, &link);
+        if (result != 0) {
+            fprintf(stderr, "Failed to open serial session: %d\n", result);
+            serial_client_cleanup(&serial_client);
+            shm_link_close(sock);
+            server_pool_destroy(link.pool);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        printf("Serial session resumable across reconnects\n");
+    }
 
-    /* Install signal handlers for graceful shutdown (NET-009 fix: use sigaction) */
-    {
-        struct sigaction sa;
-        memset(&sa, 0, sizeof(sa));
-        sa.sa_handler = signal_handler;
-        sigemptyset(&sa.sa_mask);
-        sa.sa_flags = 0;
-        sigaction(SIGINT, &sa, NULL);
-        sigaction(SIGTERM, &sa, NULL);
+    /* Failing over means resuming elsewhere */
+    if (link.pool != NULL && !(accepted & XOE_WIRE_FEATURE_SERIAL_RESUME)) {
+        server_pool_destroy(link.pool);
+        link.pool = NULL;
+    } else if (link.pool != NULL) {
+        if (server_pool_standby(link.pool) != 0) {
+            fprintf(stderr, "Failed to start server health checks\n");
+            serial_client_cleanup(&serial_client);
+            shm_link_close(sock);
+            server_pool_destroy(link.pool);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        printf("Failover to %d other server(s), %s policy\n",
+               config->servers.count - 1,
+               server_policy_name(config->servers.policy));
     }
+
+    printf("Serial port opened successfully\n");
+
+    /* Install signal handlers for graceful shutdown */
+    install_signal_handlers();
     g_serial_client_ptr = serial_client;
     g_shutdown_requested = 0;
 
@@ -122,7 +851,8 @@ xoe_state_t state_client_serial(xoe_config_t *config) {
     if (result != 0) {
         fprintf(stderr, "Failed to start serial client threads: %d\n", result);
         serial_client_cleanup(&serial_client);
-        close(sock);
+        shm_link_close(sock);
+        server_pool_destroy(link.pool);
         config->exit_code = EXIT_FAILURE;
         g_serial_client_ptr = NULL;
         return STATE_CLEANUP;
@@ -138,13 +868,20 @@ xoe_state_t state_client_serial(xoe_config_t *config) {
     /* Clear global pointer before cleanup */
     g_serial_client_ptr = NULL;
 
-    /* Stop threads and cleanup */
+    /* Stop threads and cleanup; a resumed session may use a newer socket */
     printf("\nShutting down serial bridge...\n");
     serial_client_stop(serial_client);
+    sock = serial_client->network_fd;
     serial_client_cleanup(&serial_client);
     printf("Serial port closed\n");
 
-    close(sock);
+    if (sock >= 0) {
+        shm_link_close(sock);
+    }
+    if (link.pool != NULL) {
+        printf("Failovers: %lu\n", server_pool_failovers(link.pool));
+        server_pool_destroy(link.pool);
+    }
     printf("Client disconnected.\n");
 
     config->exit_code = EXIT_SUCCESS;
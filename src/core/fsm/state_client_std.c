@@ -1,28 +1,368 @@
 /**
  * state_client_std.c
  *
- * Implements standard client mode with interactive stdin/stdout communication.
+ * Implements standard client mode: a full-duplex stdin/stdout pipe.
+ *
+ * stdin is read as it becomes readable and each chunk (up to
+ * STD_CLIENT_FRAME_SIZE bytes) is sent as one XOE_PROTOCOL_RAW frame;
+ * the server echoes raw frames and their payloads are written to stdout
+ * unchanged. One poll() loop serves both directions, so many frames are
+ * in flight at once and binary data passes through untouched, e.g.
+ *
+ *   cat file | xoe -c host:port > copy
+ *
+ * The bytes sent but not yet echoed are bounded by STD_CLIENT_WINDOW:
+ * past it stdin is not read until echoes catch up, so neither side can
+ * fill both socket buffers and stall the other.
+ *
+ * With --raw <name> the client joins a raw channel instead (see
+ * core/raw_relay.h): once the server pairs it with the other client of
+ * that name, stdin goes to that client and its bytes come out on stdout,
+ * as plain bytes without frames.
+ *
+ * Status messages go to stderr so stdout carries only the echoed data.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
 #include "core/config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/log.h"
 #include "lib/net/net_resolve.h"
+#include "lib/net/shm_link.h"
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_format.h"
 
 #if TLS_ENABLED
+#include <openssl/ssl.h>
 #include "lib/security/tls_config.h"
 #include "lib/security/tls_context.h"
 #include "lib/security/tls_session.h"
-#include "lib/security/tls_io.h"
 #endif
 
+/* Largest stdin chunk sent as one frame (one TLS record) */
+#define STD_CLIENT_FRAME_SIZE 16384
+
+/* Most bytes sent and not yet echoed before stdin reads pause */
+#define STD_CLIENT_WINDOW (256 * 1024)
+
+/* After stdin EOF, give up on outstanding echoes after this much silence */
+#define STD_CLIENT_DRAIN_MS 2000
+
+/* Raw stream frame version */
+#define STD_CLIENT_RAW_VERSION 1
+
+/* A --raw peer that left must not kill the client with SIGPIPE */
+#ifdef MSG_NOSIGNAL
+#define STD_CLIENT_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define STD_CLIENT_SEND_FLAGS 0
+#endif
+
+/**
+ * std_client_t - State of one standard client pipe
+ */
+typedef struct {
+    int sock;
+    void *tls;                  /* SSL* or NULL */
+    xoe_transport_t transport;  /* Over tls, else sock */
+    xoe_wire_decoder_t decoder;
+    int interactive;            /* stdin is a terminal: honour "exit" */
+    int stdin_open;
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+} std_client_t;
+
+/**
+ * write_all - Write a whole buffer to a descriptor
+ *
+ * Returns: 0 on success, -1 on error
+ */
+static int write_all(int fd, const void *data, size_t len) {
+    const char *p = (const char *)data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * send_all - Send a whole buffer on a blocking socket
+ *
+ * Returns: 0 on success, -1 on error
+ */
+static int send_all(int sock, const void *data, size_t len) {
+    const char *p = (const char *)data;
+    ssize_t n;
+
+    while (len > 0) {
+        n = send(sock, p, len, STD_CLIENT_SEND_FLAGS);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/**
+ * std_client_send_stdin - Read one chunk of stdin and send it as a frame
+ *
+ * Returns: 0 on success (stdin_open cleared at EOF or "exit"),
+ *          negative error code if the connection failed
+ */
+static int std_client_send_stdin(std_client_t *client) {
+    xoe_packet_t packet;
+    ssize_t n;
+    int result;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_RAW;
+    packet.protocol_version = STD_CLIENT_RAW_VERSION;
+    packet.payload = xoe_payload_alloc(STD_CLIENT_FRAME_SIZE);
+    if (packet.payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    do {
+        n = read(STDIN_FILENO, packet.payload->data, STD_CLIENT_FRAME_SIZE);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0 ||
+        (client->interactive && n == 5 &&
+         memcmp(packet.payload->data, "exit\n", 5) == 0)) {
+        client->stdin_open = FALSE;
+        xoe_wire_free_payload(&packet);
+        return 0;
+    }
+    packet.payload->len = (uint32_t)n;
+
+    result = xoe_wire_send_transport(&client->transport, &packet, 0);
+    xoe_wire_free_payload(&packet);
+
+    if (result == 0) {
+        client->bytes_sent += (uint64_t)n;
+    }
+    return result;
+}
+
+/**
+ * std_client_read_network - Write every completed echo frame to stdout
+ *
+ * Returns: 0 on success, E_IO_ERROR once the server has closed the
+ *          connection, other negative error codes on failure
+ */
+static int std_client_read_network(std_client_t *client) {
+    xoe_packet_t packet;
+    int result;
+
+    do {
+        result = xoe_wire_decoder_recv_transport(&client->decoder,
+                                                 &client->transport);
+        if (result == E_WOULD_BLOCK) {
+            break;
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_IO_ERROR : result;
+        }
+
+        while ((result = xoe_wire_decoder_next(&client->decoder, &packet)) == 1) {
+            if (packet.protocol_id != XOE_PROTOCOL_RAW) {
+                LOG_WARN("Ignoring protocol %u frame from server",
+                         packet.protocol_id);
+            } else if (packet.payload != NULL && packet.payload->len > 0) {
+                if (write_all(STDOUT_FILENO, packet.payload->data,
+                              packet.payload->len) != 0) {
+                    xoe_wire_free_payload(&packet);
+                    return E_IO_ERROR;
+                }
+                client->bytes_received += packet.payload->len;
+            }
+            xoe_wire_free_payload(&packet);
+        }
+        if (result < 0) {
+            return result;
+        }
+    } while (xoe_transport_pending(&client->transport));
+
+    return 0;
+}
+
+/**
+ * std_client_run_raw - Pump stdin to a raw channel and its peer to stdout
+ *
+ * Returns: 0 once stdin and the peer's stream have both ended, negative
+ *          error code if the connection failed
+ *
+ * Each end of stream is passed on as a half close, so either side keeps
+ * sending after the other is done.
+ */
+static int std_client_run_raw(std_client_t *client) {
+    char buffer[STD_CLIENT_FRAME_SIZE];
+    struct pollfd fds[2];
+    int peer_open = TRUE;
+    ssize_t n;
+
+    while (client->stdin_open || peer_open) {
+        fds[0].fd = client->stdin_open ? STDIN_FILENO : -1;
+        fds[0].events = POLLIN;
+        fds[1].fd = peer_open ? client->sock : -1;
+        fds[1].events = POLLIN;
+
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return E_IO_ERROR;
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            do {
+                n = recv(client->sock, buffer, sizeof(buffer), 0);
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) {
+                return E_IO_ERROR;
+            }
+            if (n == 0) {
+                peer_open = FALSE;
+            } else {
+                if (write_all(STDOUT_FILENO, buffer, (size_t)n) != 0) {
+                    return E_IO_ERROR;
+                }
+                client->bytes_received += (uint64_t)n;
+            }
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            do {
+                n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            } while (n < 0 && errno == EINTR);
+            if (n <= 0) {
+                client->stdin_open = FALSE;
+                shutdown(client->sock, SHUT_WR);
+                continue;
+            }
+            if (send_all(client->sock, buffer, (size_t)n) != 0) {
+                return E_IO_ERROR;
+            }
+            client->bytes_sent += (uint64_t)n;
+        }
+    }
+    return 0;
+}
+
+/**
+ * std_client_raw - Join the --raw channel and relay stdin/stdout over it
+ * @config: Configuration (raw_channel set)
+ * @client: Connected plain TCP client, socket still blocking
+ */
+static void std_client_raw(xoe_config_t *config, std_client_t *client) {
+    int result;
+
+    fprintf(stderr, "Connected to server %s:%d, waiting for a peer on raw "
+            "channel %s\n", config->connect_server_ip,
+            config->connect_server_port, config->raw_channel);
+
+    result = xoe_wire_raw_join(client->sock, config->raw_channel);
+    if (result != 0) {
+        fprintf(stderr, "Raw channel %s not opened: %s\n",
+                config->raw_channel,
+                (result == E_PROTOCOL_ERROR) ? "refused by the server"
+                                             : "no peer joined in time");
+        config->exit_code = EXIT_FAILURE;
+        return;
+    }
+    fprintf(stderr, "Raw channel %s open\n", config->raw_channel);
+
+    client->stdin_open = TRUE;
+    result = std_client_run_raw(client);
+    if (result != 0) {
+        fprintf(stderr, "Raw channel %s failed: error code %d\n",
+                config->raw_channel, result);
+        config->exit_code = EXIT_FAILURE;
+    }
+}
+
+/**
+ * std_client_run - Pump stdin to the server and echoes to stdout
+ *
+ * Returns: 0 once stdin is exhausted and the echoes have drained,
+ *          negative error code if the connection failed
+ */
+static int std_client_run(std_client_t *client) {
+    struct pollfd fds[2];
+    int idle_ms = 0;
+    int timeout_ms;
+    int ready;
+    int result;
+
+    for (;;) {
+        if (!client->stdin_open &&
+            (client->bytes_received >= client->bytes_sent ||
+             idle_ms >= STD_CLIENT_DRAIN_MS)) {
+            return 0;
+        }
+
+        fds[0].fd = (client->stdin_open &&
+                     client->bytes_sent - client->bytes_received <
+                     STD_CLIENT_WINDOW) ? STDIN_FILENO : -1;
+        fds[0].events = POLLIN;
+        fds[1].fd = client->sock;
+        fds[1].events = POLLIN;
+
+        timeout_ms = client->stdin_open ? -1 : STD_CLIENT_DRAIN_MS - idle_ms;
+        ready = poll(fds, 2, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return E_IO_ERROR;
+        }
+        if (ready == 0) {
+            idle_ms += timeout_ms;
+            continue;
+        }
+
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            result = std_client_read_network(client);
+            if (result != 0) {
+                return result;
+            }
+            idle_ms = 0;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            result = std_client_send_stdin(client);
+            if (result != 0) {
+                return result;
+            }
+        }
+    }
+}
+
 /**
  * state_client_std - Execute standard client mode
  * @config: Pointer to configuration structure
@@ -31,30 +371,38 @@
  *
  * Standard client mode operation:
  * 1. Create socket and connect to server
- * 2. Interactive loop:
- *    - Read line from stdin
- *    - Send to server
- *    - Receive response
- *    - Display response
- * 3. Exit on "exit" command or EOF
- *
- * This is the interactive stdin/stdout client mode (not serial bridge).
+ * 2. Stream loop (std_client_run):
+ *    - Send stdin as raw frames as it arrives
+ *    - Write echoed frames to stdout as they arrive
+ * 3. Exit on EOF (after the echoes drain), on an "exit" line typed at a
+ *    terminal, or when the server disconnects
+ *
+ * With --raw, step 2 is std_client_raw() instead.
+ *
+ * This is the stdin/stdout client mode (not serial bridge).
  */
 xoe_state_t state_client_std(xoe_config_t *config) {
-    int sock = -1;
-    char buffer[BUFFER_SIZE] = {0};
-    int bytes_received = 0;
+    std_client_t client;
     net_resolve_result_t resolve_result;
     char error_buf[256];
+    int result;
 #if TLS_ENABLED
     SSL_CTX* tls_ctx = NULL;
     SSL* tls = NULL;
 #endif
 
-    /* Resolve hostname/IP and connect to server */
-    if (net_resolve_connect(config->connect_server_ip,
-                            config->connect_server_port,
-                            &sock, &resolve_result) != 0) {
+    memset(&client, 0, sizeof(client));
+    client.sock = -1;
+
+    /* Pick from a -c list, then resolve hostname/IP and connect */
+    if (choose_server(config, 0) != 0) {
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+    if (net_resolve_connect_tuned(config->connect_server_ip,
+                                  config->connect_server_port,
+                                  &config->sock_tune,
+                                  &client.sock, &resolve_result) != 0) {
         net_resolve_format_error(&resolve_result, error_buf, sizeof(error_buf));
         fprintf(stderr, "Failed to connect to %s:%d: %s\n",
                 config->connect_server_ip, config->connect_server_port, error_buf);
@@ -68,12 +416,12 @@ xoe_state_t state_client_std(xoe_config_t *config) {
         tls_ctx = tls_context_init_client(config->encryption_mode);
         if (tls_ctx == NULL) {
             fprintf(stderr, "Failed to initialize TLS client context\n");
-            close(sock);
+            close(client.sock);
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
         }
 
-        tls = tls_session_create_client(tls_ctx, sock);
+        tls = tls_session_create_client(tls_ctx, client.sock);
         if (tls == NULL) {
             struct linger linger_opt;
             fprintf(stderr, "TLS handshake failed\n");
@@ -81,75 +429,56 @@ xoe_state_t state_client_std(xoe_config_t *config) {
             /* Set SO_LINGER to 0 to avoid blocking on close() after failed handshake */
             linger_opt.l_onoff = 1;
             linger_opt.l_linger = 0;
-            setsockopt(sock, SOL_SOCKET, SO_LINGER, &linger_opt, sizeof(linger_opt));
-            close(sock);
+            setsockopt(client.sock, SOL_SOCKET, SO_LINGER, &linger_opt, sizeof(linger_opt));
+            close(client.sock);
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
         }
+        client.tls = tls;
     }
 #endif
 
-    printf("Connected to server %s:%d\n",
-           config->connect_server_ip, config->connect_server_port);
-    printf("Enter messages to send (type 'exit' to quit):\n");
-
-    /* Interactive stdin/stdout loop */
-    while (TRUE) {
-        printf("> ");
-        if (fgets(buffer, BUFFER_SIZE, stdin) == NULL) {
-            break; /* EOF or error */
+    /* Reads are driven by poll(); sends wait on a full socket themselves */
+    if (config->raw_channel[0] != '\0') {
+        std_client_raw(config, &client);
+    } else if (fd_set_nonblocking(client.sock) != 0 ||
+        xoe_wire_decoder_init(&client.decoder, 0) != 0) {
+        fprintf(stderr, "Failed to set up the connection\n");
+        config->exit_code = EXIT_FAILURE;
+    } else {
+        if (client.tls != NULL) {
+            xoe_transport_init_tls(&client.transport, client.tls);
+        } else {
+            xoe_transport_init_fd(&client.transport, client.sock);
         }
+        client.interactive = isatty(STDIN_FILENO);
+        client.stdin_open = TRUE;
 
-        /* Remove newline character if present */
-        buffer[strcspn(buffer, "\n")] = 0;
-
-        if (strcmp(buffer, "exit") == 0) {
-            break;
+        if (config->connect_server_port == 0) {
+            fprintf(stderr, "Connected to server %s\n",
+                    config->connect_server_ip);
+        } else {
+            fprintf(stderr, "Connected to server %s:%d\n",
+                    config->connect_server_ip, config->connect_server_port);
+        }
+        if (client.interactive) {
+            fprintf(stderr, "Enter messages to send (type 'exit' to quit):\n");
         }
 
-#if TLS_ENABLED
-        if (tls != NULL) {
-            /* Send via TLS */
-            if (tls_write(tls, buffer, strlen(buffer)) <= 0) {
-                fprintf(stderr, "TLS send failed\n");
-                config->exit_code = EXIT_FAILURE;
-                break;
-            }
-
-            /* Receive via TLS */
-            bytes_received = tls_read(tls, buffer, BUFFER_SIZE - 1);
-            if (bytes_received > 0) {
-                buffer[bytes_received] = '\0';
-                printf("Server response: %s\n", buffer);
-            } else if (bytes_received == 0) {
-                printf("Server disconnected.\n");
-                config->exit_code = EXIT_FAILURE;
-                break;
-            } else {
-                fprintf(stderr, "TLS recv failed\n");
-                config->exit_code = EXIT_FAILURE;
-                break;
-            }
-        } else
-#endif
-        {
-            /* Send message to server (plain TCP) */
-            send(sock, buffer, strlen(buffer), 0);
-
-            /* Receive response (plain TCP) */
-            bytes_received = recv(sock, buffer, BUFFER_SIZE - 1, 0);
-            if (bytes_received > 0) {
-                buffer[bytes_received] = '\0';
-                printf("Server response: %s\n", buffer);
-            } else if (bytes_received == 0) {
-                printf("Server disconnected.\n");
-                break;
-            } else {
-                perror("recv failed");
-                config->exit_code = EXIT_FAILURE;
-                break;
-            }
+        result = std_client_run(&client);
+        if (result == E_IO_ERROR) {
+            fprintf(stderr, "Server disconnected.\n");
+            config->exit_code = EXIT_FAILURE;
+        } else if (result != 0) {
+            fprintf(stderr, "Connection failed: error code %d\n", result);
+            config->exit_code = EXIT_FAILURE;
+        } else if (client.bytes_received < client.bytes_sent) {
+            fprintf(stderr, "Timed out waiting for %llu echoed bytes\n",
+                    (unsigned long long)(client.bytes_sent -
+                                         client.bytes_received));
+            config->exit_code = EXIT_FAILURE;
         }
+        xoe_wire_decoder_cleanup(&client.decoder);
     }
 
 #if TLS_ENABLED
@@ -163,8 +492,10 @@ xoe_state_t state_client_std(xoe_config_t *config) {
     }
 #endif
 
-    close(sock);
-    printf("Client disconnected.\n");
+    shm_link_close(client.sock);
+    fprintf(stderr, "Client disconnected (%llu bytes sent, %llu received).\n",
+            (unsigned long long)client.bytes_sent,
+            (unsigned long long)client.bytes_received);
 
     /* Only set SUCCESS if we haven't already set FAILURE */
     if (config->exit_code != EXIT_FAILURE) {
@@ -57,10 +57,10 @@ static void signal_handler(int signum)
  * - Phase 1-4: Basic infrastructure, device management, active transfers
  * - Phase 5: Request/response tracking API
  * - Phase 5.5: OUT endpoint support with bidirectional transfers
+ * - Phase 6: Hotplug attach/detach (--hotplug)
  *
  * Future Phases:
  * - Device manager for advanced multi-device scenarios
- * - Hotplug support (Phase 6)
  */
 xoe_state_t state_client_usb(xoe_config_t *config) {
     usb_multi_config_t *usb_multi = NULL;
@@ -128,6 +128,26 @@ xoe_state_t state_client_usb(xoe_config_t *config) {
         if (dev_cfg->interrupt_in_endpoint != USB_NO_ENDPOINT) {
             printf("  Interrupt IN endpoint: 0x%02x\n", dev_cfg->interrupt_in_endpoint);
         }
+        if (dev_cfg->interrupt_out_endpoint != USB_NO_ENDPOINT) {
+            printf("  Interrupt OUT endpoint: 0x%02x\n", dev_cfg->interrupt_out_endpoint);
+        }
+        if (dev_cfg->iso_in_endpoint != USB_NO_ENDPOINT) {
+            printf("  Isochronous IN endpoint: 0x%02x\n", dev_cfg->iso_in_endpoint);
+        }
+        if (dev_cfg->iso_out_endpoint != USB_NO_ENDPOINT) {
+            printf("  Isochronous OUT endpoint: 0x%02x (jitter buffer %d ms)\n",
+                   dev_cfg->iso_out_endpoint, dev_cfg->iso_jitter_ms);
+        }
+        if (dev_cfg->iso_in_endpoint != USB_NO_ENDPOINT ||
+            dev_cfg->iso_out_endpoint != USB_NO_ENDPOINT) {
+            printf("  Isochronous URB: %d packets every %d us\n",
+                   dev_cfg->iso_packets, dev_cfg->iso_interval_us);
+        }
+        if (dev_cfg->enable_hotplug) {
+            printf("  Hotplug: attached when plugged in, detached when removed\n");
+        }
+        printf("  Transfer queue depth: %d\n", dev_cfg->transfer_depth);
+        printf("  Requested URB size: %d bytes\n", dev_cfg->urb_size);
 
         /* Validate configuration */
         result = usb_config_validate(dev_cfg);
@@ -146,6 +166,14 @@ xoe_state_t state_client_usb(xoe_config_t *config) {
     printf("========================================\n");
     printf("\n");
 
+    /* Both ends of a device meet on the server its device_id hashes to */
+    if (choose_server(config,
+                      ((uint32_t)usb_multi->devices[0].vendor_id << 16) |
+                      usb_multi->devices[0].product_id) != 0) {
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
     /* Initialize USB client */
     printf("Initializing USB client...\n");
     client = usb_client_init(config->connect_server_ip,
@@ -156,18 +184,17 @@ xoe_state_t state_client_usb(xoe_config_t *config) {
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
+    usb_client_set_sock_tune(client, &config->sock_tune);
 
-    /* Add devices to client */
+    /* Add devices to client (opened in parallel) */
     printf("Adding USB devices...\n");
-    for (i = 0; i < usb_multi->device_count; i++) {
-        result = usb_client_add_device(client, &usb_multi->devices[i]);
-        if (result != 0) {
-            fprintf(stderr, "Error: Failed to add device %d (error %d)\n",
-                    i + 1, result);
-            usb_client_cleanup(client);
-            config->exit_code = EXIT_FAILURE;
-            return STATE_CLEANUP;
-        }
+    result = usb_client_add_devices(client, usb_multi->devices,
+                                    usb_multi->device_count);
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to add devices (error %d)\n", result);
+        usb_client_cleanup(client);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
     }
 
     /* Set up signal handler for graceful shutdown (NET-009 fix: use sigaction) */
@@ -208,7 +235,6 @@ xoe_state_t state_client_usb(xoe_config_t *config) {
     printf("\n");
     printf("NOTE: Advanced features will be added in future phases:\n");
     printf("      - Advanced multi-device routing and management\n");
-    printf("      - Hotplug device detection and handling (Phase 6)\n");
     printf("\n");
 
     config->exit_code = EXIT_SUCCESS;
@@ -13,6 +13,8 @@
 #include <unistd.h>
 #include "core/config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/log.h"
+#include "lib/protocol/wire_capture.h"
 #include "connectors/serial/serial_config.h"
 #include "connectors/usb/usb_config.h"
 
@@ -90,18 +92,40 @@ static char* generate_random_password(int length) {
  * - Default TLS certificate/key paths (if TLS enabled)
  */
 xoe_state_t state_init(xoe_config_t *config) {
+    /* Move log output off the calling threads (stays synchronous on failure) */
+    log_start();
+
     /* Set default operating mode */
     config->mode = MODE_SERVER;
 
     /* Initialize network configuration */
     config->listen_address = NULL;  /* Default to INADDR_ANY (0.0.0.0) */
     config->listen_port = SERVER_PORT;
+    config->listeners = 1;
+    config->listen_backlog = MAX_PENDING_CONNECTIONS;
+    config->cpu_count = 0;
+    sock_tune_preset(&config->sock_tune, SOCK_TUNE_LOW_LATENCY);
+    memset(&config->thread_sched, 0, sizeof(config->thread_sched));
+    config->thread_stack_kb = (int)(XOE_THREAD_STACK_SIZE / 1024);
+    config->mem_budget_mb = MEM_BUDGET_DEFAULT_MB;
+    config->conn_mem_kb = CONN_MEM_DEFAULT_KB;
+    config->use_io_uring = FALSE;
+    config->use_udp = FALSE;
+    config->l2_interface[0] = '\0';
+    memset(config->l2_server_mac, 0xff, sizeof(config->l2_server_mac));
+    config->shm_path[0] = '\0';
+    config->conn_rate = CONN_RATE_LIMIT_MAX;
+    config->handoff_path[0] = '\0';
+    config->takeover_path[0] = '\0';
+    memset(&config->cluster, 0, sizeof(config->cluster));
     config->connect_server_ip = NULL;
     config->connect_server_port = 0;
+    memset(&config->servers, 0, sizeof(config->servers));
 
     /* Initialize serial configuration */
     config->use_serial = FALSE;
     config->serial_device = NULL;
+    config->serial_multi = NULL;
     config->serial_config = malloc(sizeof(serial_config_t));
     if (config->serial_config == NULL) {
         fprintf(stderr, "Error: Failed to allocate serial configuration\n");
@@ -120,6 +144,36 @@ xoe_state_t state_init(xoe_config_t *config) {
         return STATE_CLEANUP;
     }
 
+    /* Default USB class policy (HID blocked) until a whitelist is set */
+    config->usb_class_count = 0;
+    config->usb_iso_budget_kbps = 0;
+
+    /* Level in effect until --log-level */
+    config->log_level = (int)log_get_level();
+
+    /* Initialize bench client settings (off until --bench) */
+    bench_config_init_defaults(&config->bench);
+
+    /* Wire capture and replay (off until --capture / --replay) */
+    replay_config_init_defaults(&config->replay);
+    config->capture_path = NULL;
+    config->capture_max_mb = XOE_WIRE_CAPTURE_DEFAULT_MB;
+
+    /* Initialize the list of serial ports (one entry per -s device) */
+    config->serial_mux = FALSE;
+    config->hub_topic[0] = '\0';
+    config->raw_channel[0] = '\0';
+    config->hub_role = SERIAL_HUB_PUBLISHER;
+    config->wire_compress = 0;
+    config->serial_multi = serial_multi_config_init(SERIAL_MULTI_MAX_DEVICES);
+    if (config->serial_multi == NULL) {
+        fprintf(stderr, "Error: Failed to allocate serial device list\n");
+        free(config->serial_config);
+        usb_multi_config_free((usb_multi_config_t*)config->usb_config);
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
     /* Initialize connection file descriptor */
     config->server_fd = -1;
 
@@ -134,6 +188,7 @@ xoe_state_t state_init(xoe_config_t *config) {
         fprintf(stderr, "Error: Failed to generate management password\n");
         free(config->serial_config);
         usb_multi_config_free((usb_multi_config_t*)config->usb_config);
+        serial_multi_config_free((serial_multi_config_t*)config->serial_multi);
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
@@ -6,8 +6,24 @@
  */
 
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "core/config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/thread_sched.h"
+#include "lib/protocol/wire_capture.h"
+
+/**
+ * state_mode_is_server - Whether the configuration runs server mode
+ * @config: Application configuration
+ *
+ * Returns: TRUE unless a server to connect to is given (or --l2 with -s)
+ */
+int state_mode_is_server(const xoe_config_t *config) {
+    return config->connect_server_ip == NULL &&
+           !(config->l2_interface[0] != '\0' && config->use_serial == TRUE);
+}
 
 /**
  * state_mode_select - Determine operating mode and select next state
@@ -15,6 +31,8 @@
  *
  * Returns: Appropriate state based on operating mode
  *   - STATE_CLEANUP if mode is MODE_HELP
+ *   - STATE_CLIENT_BENCH if client mode with --bench
+ *   - STATE_CLIENT_REPLAY if client mode with --replay
  *   - STATE_CLIENT_USB if client mode with USB enabled
  *   - STATE_CLIENT_SERIAL if client mode with serial enabled
  *   - STATE_CLIENT_STD if client mode without serial or USB
@@ -22,34 +40,88 @@
  *
  * Mode selection logic:
  * 1. If help mode was set during arg parsing, cleanup and exit
- * 2. If connect_server_ip is set, operate as client
- *    a. If USB enabled, use USB bridge mode
- *    b. If serial enabled, use serial bridge mode
- *    c. Otherwise, use standard client mode
+ * 2. If connect_server_ip is set (or --l2 with -s), operate as client
+ *    a. If --bench given, run the load generator
+ *    b. If --replay given, replay the trace file
+ *    c. If USB enabled, use USB bridge mode
+ *    d. If serial enabled, use serial bridge mode
+ *    e. Otherwise, use standard client mode
  * 3. Default to server mode
+ *
+ * The --sched thread settings, thread stack size and memory budget are
+ * installed first, so the threads the mode starts are placed and sized
+ * from their first instruction. A --capture file is opened once the mode
+ * is known (it records which side of the connections it was taken on)
+ * and stays open across restarts until state_cleanup().
  */
 xoe_state_t state_mode_select(xoe_config_t *config) {
+    xoe_state_t next;
+    int result;
+
     /* If help mode was requested, proceed to cleanup */
     if (config->mode == MODE_HELP) {
         return STATE_CLEANUP;
     }
 
+    switch (thread_sched_set(&config->thread_sched)) {
+    case 0:
+        break;
+    case E_PERMISSION_DENIED:
+        fprintf(stderr, "Warning: real-time scheduling needs CAP_SYS_NICE "
+                "and CAP_IPC_LOCK (or matching rlimits); memory not locked\n");
+        break;
+    case E_NOT_SUPPORTED:
+        fprintf(stderr, "Warning: thread scheduling is not supported on this "
+                "platform, --sched ignored\n");
+        break;
+    default:
+        fprintf(stderr, "Warning: could not apply --sched settings\n");
+        break;
+    }
+    thread_sched_set_stack_size((size_t)config->thread_stack_kb * 1024);
+    mem_budget_set_limit((size_t)config->mem_budget_mb * 1024 * 1024);
+    mem_budget_set_conn_limit((size_t)config->conn_mem_kb * 1024);
+
     /* Determine mode based on configuration */
-    if (config->connect_server_ip != NULL) {
-        /* Client mode - check for USB, serial, or standard */
-        if (config->use_usb == TRUE) {
+    if (!state_mode_is_server(config)) {
+        /* Client mode - check for bench, replay, USB, serial, or standard */
+        if (config->bench.connections > 0) {
+            config->mode = MODE_CLIENT_BENCH;
+            next = STATE_CLIENT_BENCH;
+        } else if (config->replay.path != NULL) {
+            config->mode = MODE_CLIENT_REPLAY;
+            next = STATE_CLIENT_REPLAY;
+        } else if (config->use_usb == TRUE) {
             config->mode = MODE_CLIENT_USB;
-            return STATE_CLIENT_USB;
+            next = STATE_CLIENT_USB;
         } else if (config->use_serial == TRUE) {
             config->mode = MODE_CLIENT_SERIAL;
-            return STATE_CLIENT_SERIAL;
+            next = STATE_CLIENT_SERIAL;
         } else {
             config->mode = MODE_CLIENT_STANDARD;
-            return STATE_CLIENT_STD;
+            next = STATE_CLIENT_STD;
+        }
+    } else {
+        /* Default to server mode */
+        config->mode = MODE_SERVER;
+        next = STATE_SERVER_MODE;
+    }
+
+    if (config->capture_path != NULL) {
+        result = xoe_wire_capture_open(config->capture_path,
+                                       config->mode == MODE_SERVER
+                                           ? XOE_WIRE_CAPTURE_ROLE_SERVER
+                                           : XOE_WIRE_CAPTURE_ROLE_CLIENT,
+                                       (uint64_t)config->capture_max_mb *
+                                           1024 * 1024);
+        /* E_INVALID_STATE: still open from before a restart */
+        if (result != 0 && result != E_INVALID_STATE) {
+            fprintf(stderr, "Cannot open capture file %s: error code %d\n",
+                    config->capture_path, result);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
         }
     }
 
-    /* Default to server mode */
-    config->mode = MODE_SERVER;
-    return STATE_SERVER_MODE;
+    return next;
 }
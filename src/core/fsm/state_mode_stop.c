@@ -15,11 +15,11 @@
  * management interface requests a mode restart via mgmt_restart_request().
  *
  * Server Mode Shutdown:
- * - Close server socket to stop accepting new connections
- * - Disconnect all active clients (close sockets)
- * - Wait up to 5 seconds for client threads to exit
- * - Force-clear any remaining client slots
- * - Clean up TLS context and USB server
+ * - Server mode has already stopped its listeners and event loop and
+ *   released the USB server and TLS context before returning here
+ * - Disconnect any remaining clients and wait (up to 5 seconds, woken as
+ *   each slot is released) for the pool to drain
+ * - Close any remaining server socket
  *
  * Client Mode Shutdown:
  * - For serial client: call serial_client_request_shutdown()
@@ -38,7 +38,9 @@ xoe_state_t state_mode_stop(xoe_config_t *config) {
            config->mode == MODE_SERVER ? "server" :
            config->mode == MODE_CLIENT_SERIAL ? "serial client" :
            config->mode == MODE_CLIENT_STANDARD ? "standard client" :
-           config->mode == MODE_CLIENT_USB ? "USB client" : "unknown");
+           config->mode == MODE_CLIENT_USB ? "USB client" :
+           config->mode == MODE_CLIENT_BENCH ? "bench client" :
+           config->mode == MODE_CLIENT_REPLAY ? "replay client" : "unknown");
 
     /* Mode-specific shutdown logic */
     switch (config->mode) {
@@ -46,15 +48,13 @@ xoe_state_t state_mode_stop(xoe_config_t *config) {
             printf("Disconnecting all clients...\n");
             disconnect_all_clients();
 
-            printf("Waiting up to 5 seconds for client threads to exit...\n");
             wait_for_clients(5);
 
 #if TLS_ENABLED
             /* Clean up TLS context if it exists */
             if (g_tls_ctx != NULL) {
                 printf("Cleaning up TLS context...\n");
-                tls_context_cleanup(g_tls_ctx);
-                g_tls_ctx = NULL;
+                server_tls_ctx_replace(NULL);
             }
 #endif
 
@@ -20,7 +20,12 @@
 
 #include "core/config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/log.h"
+#include "lib/protocol/wire_capture.h"
+#include "lib/protocol/wire_format.h"
 #include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_baud.h"
+#include "connectors/serial/serial_hub.h"
 #include "connectors/usb/usb_config.h"
 #include "connectors/usb/usb_device.h"
 
@@ -66,6 +71,55 @@ static int safe_strtol(const char *str, long *result, long min, long max) {
     return 0;
 }
 
+/**
+ * is_long_option - Check whether getopt's next argument is a long option
+ * @argv: Argument vector
+ * @argc: Argument count
+ *
+ * Returns: TRUE for "--name" and the single-dash TLS options (-cert,
+ *          -key, -ca), which Phase 2 parses
+ */
+static int is_long_option(char *argv[], int argc) {
+    const char *arg;
+
+    if (optind < 1 || optind >= argc) {
+        return FALSE;
+    }
+    arg = argv[optind];
+    return (strncmp(arg, "--", 2) == 0 && arg[2] != '\0') ||
+           strcmp(arg, "-cert") == 0 || strcmp(arg, "-key") == 0 ||
+           strcmp(arg, "-ca") == 0;
+}
+
+/**
+ * parse_long_value - Parse the numeric argument of a Phase 2 option
+ * @config: Pointer to configuration structure (usage output, exit code)
+ * @argc: Argument count
+ * @argv: Argument vector; argv[optind] is the option
+ * @min: Smallest accepted value
+ * @max: Largest accepted value
+ * @value: Output: parsed value
+ *
+ * Returns: 0 on success, -1 after reporting a missing or out-of-range
+ *          argument (exit_code is set)
+ */
+static int parse_long_value(xoe_config_t *config, int argc, char *argv[],
+                            long min, long max, long *value) {
+    if (optind + 1 >= argc) {
+        fprintf(stderr, "Option %s requires an argument\n", argv[optind]);
+        print_usage(config->program_name);
+        config->exit_code = EXIT_FAILURE;
+        return -1;
+    }
+    if (safe_strtol(argv[optind + 1], value, min, max) != 0) {
+        fprintf(stderr, "Invalid value for %s: %s (use %ld-%ld)\n",
+                argv[optind], argv[optind + 1], min, max);
+        config->exit_code = EXIT_FAILURE;
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * state_parse_args - Parse command-line arguments
  * @config: Pointer to configuration structure
@@ -77,20 +131,25 @@ static int safe_strtol(const char *str, long *result, long min, long max) {
  * Parses command-line options in two phases:
  * 1. Short options via getopt: -i, -p, -c, -e, -s, -b, -h
  * 2. Long options via manual parsing: --cert, --key, --parity, --databits,
- *    --stopbits, --flow
+ *    --stopbits, --flow, --coalesce-bytes, --coalesce-us, --read-mode,
+ *    --udp, --udp-mode, --l2, --shm, --hub (and the rest listed in
+ *    print_usage())
  *
  * Updates config structure with parsed values and validates input ranges.
  */
 xoe_state_t state_parse_args(xoe_config_t *config, int argc, char *argv[]) {
     int opt = 0;
-    char *colon = NULL;
+    const char *shm_path = NULL;
     serial_config_t *serial_cfg = (serial_config_t*)config->serial_config;
 
     /* Store program name for usage output */
     config->program_name = argv[0];
 
-    /* Phase 1: Parse short options with getopt (+ stops at first non-option) */
-    while ((opt = getopt(argc, argv, "+i:p:c:e:s:b:u:h")) != -1) {
+    /* Phase 1: Parse short options with getopt (+ stops at first non-option);
+     * stop before a long option, or getopt would take it apart as a
+     * cluster of short ones */
+    while (!is_long_option(argv, argc) &&
+           (opt = getopt(argc, argv, "+i:p:c:e:s:b:u:h")) != -1) {
         switch (opt) {
             case 'i':
                 config->listen_address = optarg;
@@ -110,25 +169,32 @@ xoe_state_t state_parse_args(xoe_config_t *config, int argc, char *argv[]) {
                 break;
 
             case 'c':
-                colon = strchr(optarg, ':');
-                if (colon == NULL) {
-                    fprintf(stderr, "Invalid server address format. Expected <ip>:<port>.\n");
-                    print_usage(config->program_name);
-                    config->exit_code = EXIT_FAILURE;
-                    return STATE_CLEANUP;
-                }
-                *colon = '\0';
-                config->connect_server_ip = optarg;
-                {
-                    long port;
-                    if (safe_strtol(colon + 1, &port, 1, 65535) != 0) {
-                        fprintf(stderr, "Invalid server port number: %s\n", colon + 1);
-                        print_usage(config->program_name);
+                /* A same-host link is a path, not <ip>:<port> */
+                shm_path = shm_link_address(optarg);
+                if (shm_path != NULL) {
+                    if (shm_path[0] == '\0' ||
+                        strlen(shm_path) >= SHM_LINK_PATH_MAX) {
+                        fprintf(stderr, "Invalid socket path in %s (1-%d characters)\n",
+                                optarg, SHM_LINK_PATH_MAX - 1);
                         config->exit_code = EXIT_FAILURE;
                         return STATE_CLEANUP;
                     }
-                    config->connect_server_port = (int)port;
+                    config->connect_server_ip = optarg;
+                    config->connect_server_port = 0;
+                    config->servers.count = 0;
+                    break;
+                }
+                /* <host>:<port>, or a comma-separated list of them */
+                if (server_list_parse(optarg, &config->servers) != 0) {
+                    fprintf(stderr, "Invalid server address: %s. Expected "
+                            "<ip>:<port>[,<ip>:<port>...] (at most %d)\n",
+                            optarg, SERVER_POOL_MAX);
+                    print_usage(config->program_name);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
                 }
+                config->connect_server_ip = config->servers.hosts[0];
+                config->connect_server_port = config->servers.ports[0];
                 break;
 
             case 'e':
@@ -153,25 +219,44 @@ xoe_state_t state_parse_args(xoe_config_t *config, int argc, char *argv[]) {
 #endif
                 break;
 
-            case 's':
-                config->serial_device = optarg;
+            case 's': {
+                int result = serial_multi_config_add_spec(
+                    (serial_multi_config_t*)config->serial_multi, optarg);
+                if (result != 0) {
+                    if (result == E_BUFFER_TOO_SMALL) {
+                        fprintf(stderr, "Too many serial devices (max %d)\n",
+                                SERIAL_MULTI_MAX_DEVICES);
+                    } else {
+                        fprintf(stderr, "Invalid serial device: %s "
+                                "(use path[@baud][#reliable|#latest], "
+                                "comma-separated)\n", optarg);
+                    }
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                if (config->serial_device == NULL) {
+                    config->serial_device = optarg;
+                }
                 config->use_serial = TRUE;
                 break;
+            }
 
             case 'b':
                 if (serial_cfg != NULL) {
                     long baud;
-                    if (safe_strtol(optarg, &baud, 1, 921600) != 0) {
+                    if (safe_strtol(optarg, &baud, 1, SERIAL_BAUD_MAX) != 0) {
                         fprintf(stderr, "Invalid baud rate: %s\n", optarg);
                         print_usage(config->program_name);
                         config->exit_code = EXIT_FAILURE;
                         return STATE_CLEANUP;
                     }
-                    /* FSM-002, SER-002 fix: validate against whitelist */
+                    /* FSM-002, SER-002 fix: validate the rate */
                     if (serial_validate_baud((int)baud) != 0) {
                         fprintf(stderr, "Unsupported baud rate: %ld\n", baud);
-                        fprintf(stderr, "Valid rates: 9600, 19200, 38400, ");
-                        fprintf(stderr, "57600, 115200, 230400\n");
+                        fprintf(stderr, "Valid rates: %d to %d%s\n",
+                                SERIAL_BAUD_MIN, SERIAL_BAUD_MAX,
+                                SERIAL_BAUD_CUSTOM ? ""
+                                                   : " with a termios constant");
                         config->exit_code = EXIT_FAILURE;
                         return STATE_CLEANUP;
                     }
@@ -180,6 +265,7 @@ xoe_state_t state_parse_args(xoe_config_t *config, int argc, char *argv[]) {
                 break;
 
             case 'u': {
+#if XOE_USB_ENABLED
                 /* Parse VID:PID format (hex values) */
                 usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
                 unsigned int vid = 0, pid = 0;
@@ -223,6 +309,11 @@ xoe_state_t state_parse_args(xoe_config_t *config, int argc, char *argv[]) {
                 usb_multi->device_count++;
 
                 config->use_usb = TRUE;
+#else
+                fprintf(stderr, "USB support not compiled in. Rebuild with XOE_USB_ENABLED=1\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+#endif
                 break;
             }
 
@@ -341,6 +432,66 @@ phase2:
                 serial_cfg->stop_bits = (int)bits;
             }
             optind += 2;
+        } else if (strcmp(argv[optind], "--coalesce-bytes") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --coalesce-bytes requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (serial_cfg != NULL) {
+                long bytes;
+                if (safe_strtol(argv[optind + 1], &bytes, 1,
+                                SERIAL_COALESCE_MAX_BYTES) != 0) {
+                    fprintf(stderr, "Invalid coalesce bytes: %s (use 1-%d)\n",
+                            argv[optind + 1], SERIAL_COALESCE_MAX_BYTES);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                serial_cfg->coalesce_bytes = (int)bytes;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--coalesce-us") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --coalesce-us requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (serial_cfg != NULL) {
+                long usec;
+                if (safe_strtol(argv[optind + 1], &usec, 0,
+                                SERIAL_COALESCE_MAX_US) != 0) {
+                    fprintf(stderr, "Invalid coalesce window: %s (use 0-%d)\n",
+                            argv[optind + 1], SERIAL_COALESCE_MAX_US);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                serial_cfg->coalesce_us = (int)usec;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--read-mode") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --read-mode requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (serial_cfg != NULL) {
+                if (strcmp(argv[optind + 1], "adaptive") == 0) {
+                    serial_cfg->read_mode = SERIAL_READ_MODE_ADAPTIVE;
+                } else if (strcmp(argv[optind + 1], "fixed") == 0) {
+                    serial_cfg->read_mode = SERIAL_READ_MODE_FIXED;
+                } else if (strcmp(argv[optind + 1], "frame") == 0) {
+                    serial_cfg->read_mode = SERIAL_READ_MODE_FRAME;
+                } else {
+                    fprintf(stderr, "Invalid read mode: %s (use adaptive, fixed or frame)\n",
+                            argv[optind + 1]);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
         } else if (strcmp(argv[optind], "--flow") == 0) {
             if (optind + 1 >= argc) {
                 fprintf(stderr, "Option --flow requires an argument\n");
@@ -469,6 +620,717 @@ phase2:
                 }
             }
             optind += 2;
+        } else if (strcmp(argv[optind], "--ep-int-out") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --ep-int-out requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* Apply to most recently added USB device */
+            {
+                usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+                unsigned int ep_addr = 0;
+                if (sscanf(argv[optind + 1], "%x", &ep_addr) != 1 || ep_addr > 0xFF) {
+                    fprintf(stderr, "Invalid endpoint address: %s (use hex, e.g., 02)\n",
+                            argv[optind + 1]);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                if (usb_multi != NULL && usb_multi->device_count > 0) {
+                    usb_multi->devices[usb_multi->device_count - 1].interrupt_out_endpoint =
+                        (uint8_t)ep_addr;
+                } else {
+                    fprintf(stderr, "Error: --ep-int-out must follow -u option\n");
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--ep-iso-in") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --ep-iso-in requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* Apply to most recently added USB device */
+            {
+                usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+                unsigned int ep_addr = 0;
+                if (sscanf(argv[optind + 1], "%x", &ep_addr) != 1 || ep_addr > 0xFF) {
+                    fprintf(stderr, "Invalid endpoint address: %s (use hex, e.g., 81)\n",
+                            argv[optind + 1]);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                if (usb_multi != NULL && usb_multi->device_count > 0) {
+                    usb_multi->devices[usb_multi->device_count - 1].iso_in_endpoint =
+                        (uint8_t)ep_addr;
+                } else {
+                    fprintf(stderr, "Error: --ep-iso-in must follow -u option\n");
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--ep-iso-out") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --ep-iso-out requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* Apply to most recently added USB device */
+            {
+                usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+                unsigned int ep_addr = 0;
+                if (sscanf(argv[optind + 1], "%x", &ep_addr) != 1 || ep_addr > 0xFF) {
+                    fprintf(stderr, "Invalid endpoint address: %s (use hex, e.g., 01)\n",
+                            argv[optind + 1]);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                if (usb_multi != NULL && usb_multi->device_count > 0) {
+                    usb_multi->devices[usb_multi->device_count - 1].iso_out_endpoint =
+                        (uint8_t)ep_addr;
+                } else {
+                    fprintf(stderr, "Error: --ep-iso-out must follow -u option\n");
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--iso-packets") == 0) {
+            /* Apply to most recently added USB device */
+            usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+            long value;
+            if (parse_long_value(config, argc, argv, 1, USB_ISO_MAX_PACKETS, &value) != 0) {
+                return STATE_CLEANUP;
+            }
+            if (usb_multi != NULL && usb_multi->device_count > 0) {
+                usb_multi->devices[usb_multi->device_count - 1].iso_packets = (int)value;
+            } else {
+                fprintf(stderr, "Error: --iso-packets must follow -u option\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--iso-interval") == 0) {
+            /* Apply to most recently added USB device */
+            usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+            long value;
+            if (parse_long_value(config, argc, argv, USB_MIN_ISO_INTERVAL_US, 1000000, &value) != 0) {
+                return STATE_CLEANUP;
+            }
+            if (usb_multi != NULL && usb_multi->device_count > 0) {
+                usb_multi->devices[usb_multi->device_count - 1].iso_interval_us = (int)value;
+            } else {
+                fprintf(stderr, "Error: --iso-interval must follow -u option\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--iso-jitter") == 0) {
+            /* Apply to most recently added USB device */
+            usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+            long value;
+            if (parse_long_value(config, argc, argv, 0, USB_MAX_ISO_JITTER_MS, &value) != 0) {
+                return STATE_CLEANUP;
+            }
+            if (usb_multi != NULL && usb_multi->device_count > 0) {
+                usb_multi->devices[usb_multi->device_count - 1].iso_jitter_ms = (int)value;
+            } else {
+                fprintf(stderr, "Error: --iso-jitter must follow -u option\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--hotplug") == 0) {
+            /* Apply to most recently added USB device */
+            usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+            if (usb_multi != NULL && usb_multi->device_count > 0) {
+                usb_multi->devices[usb_multi->device_count - 1].enable_hotplug = TRUE;
+            } else {
+                fprintf(stderr, "Error: --hotplug must follow -u option\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 1;
+        } else if (strcmp(argv[optind], "--queue-depth") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --queue-depth requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* Apply to most recently added USB device */
+            {
+                usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+                long depth;
+                if (safe_strtol(argv[optind + 1], &depth, 1, USB_MAX_TRANSFER_DEPTH) != 0) {
+                    fprintf(stderr, "Invalid queue depth: %s (use 1-%d)\n",
+                            argv[optind + 1], USB_MAX_TRANSFER_DEPTH);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                if (usb_multi != NULL && usb_multi->device_count > 0) {
+                    usb_multi->devices[usb_multi->device_count - 1].transfer_depth =
+                        (int)depth;
+                } else {
+                    fprintf(stderr, "Error: --queue-depth must follow -u option\n");
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--urb-size") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --urb-size requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* Apply to most recently added USB device */
+            {
+                usb_multi_config_t *usb_multi = (usb_multi_config_t*)config->usb_config;
+                long urb_size;
+                if (safe_strtol(argv[optind + 1], &urb_size,
+                                USB_MAX_DATA_SIZE, USB_MAX_LARGE_DATA_SIZE) != 0) {
+                    fprintf(stderr, "Invalid URB size: %s (use %d-%d)\n",
+                            argv[optind + 1], USB_MAX_DATA_SIZE,
+                            USB_MAX_LARGE_DATA_SIZE);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+                if (usb_multi != NULL && usb_multi->device_count > 0) {
+                    usb_multi->devices[usb_multi->device_count - 1].urb_size =
+                        (int)urb_size;
+                } else {
+                    fprintf(stderr, "Error: --urb-size must follow -u option\n");
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--listeners") == 0) {
+            long listeners;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --listeners requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (safe_strtol(argv[optind + 1], &listeners, 1,
+                            MAX_SERVER_LISTENERS) != 0) {
+                fprintf(stderr, "Invalid listener count: %s (use 1-%d)\n",
+                        argv[optind + 1], MAX_SERVER_LISTENERS);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            config->listeners = (int)listeners;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--backlog") == 0) {
+            long backlog;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --backlog requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (safe_strtol(argv[optind + 1], &backlog, 1,
+                            MAX_LISTEN_BACKLOG) != 0) {
+                fprintf(stderr, "Invalid backlog: %s (use 1-%d)\n",
+                        argv[optind + 1], MAX_LISTEN_BACKLOG);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            config->listen_backlog = (int)backlog;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--cpus") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --cpus requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (thread_sched_parse_cpus(argv[optind + 1], config->cpus,
+                                        MAX_SERVER_LISTENERS,
+                                        &config->cpu_count) != 0) {
+                fprintf(stderr, "Invalid CPU list: %s (use e.g. 0,1,2,3 "
+                        "or 0-3, at most %d CPUs)\n",
+                        argv[optind + 1], MAX_SERVER_LISTENERS);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--conn-rate") == 0) {
+            long rate;
+            if (parse_long_value(config, argc, argv, 0, MAX_CONN_RATE,
+                                 &rate) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->conn_rate = (int)rate;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--usb-iso-budget") == 0) {
+            long budget;
+            if (parse_long_value(config, argc, argv, 0, MAX_USB_ISO_BUDGET_KBPS,
+                                 &budget) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->usb_iso_budget_kbps = (int)budget;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--bench") == 0) {
+            long connections;
+            if (parse_long_value(config, argc, argv, 1, BENCH_MAX_CONNECTIONS,
+                                 &connections) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->bench.connections = (int)connections;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--bench-size") == 0) {
+            long size;
+            if (parse_long_value(config, argc, argv, BENCH_MIN_FRAME_SIZE,
+                                 BENCH_MAX_FRAME_SIZE, &size) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->bench.frame_size = (uint32_t)size;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--bench-rate") == 0) {
+            long rate;
+            if (parse_long_value(config, argc, argv, 0, BENCH_MAX_RATE,
+                                 &rate) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->bench.rate = (uint32_t)rate;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--bench-depth") == 0) {
+            long depth;
+            if (parse_long_value(config, argc, argv, 1, BENCH_MAX_DEPTH,
+                                 &depth) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->bench.depth = (int)depth;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--bench-time") == 0) {
+            long seconds;
+            if (parse_long_value(config, argc, argv, 1,
+                                 BENCH_MAX_DURATION_MS / 1000,
+                                 &seconds) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->bench.duration_ms = (int)seconds * 1000;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--bench-threads") == 0) {
+            long threads;
+            if (parse_long_value(config, argc, argv, 0, BENCH_MAX_THREADS,
+                                 &threads) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->bench.threads = (int)threads;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--capture") == 0 ||
+                   strcmp(argv[optind], "--replay") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option %s requires an argument\n", argv[optind]);
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (argv[optind + 1][0] == '\0') {
+                fprintf(stderr, "Invalid trace file for %s\n", argv[optind]);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (strcmp(argv[optind], "--capture") == 0) {
+                config->capture_path = argv[optind + 1];
+            } else {
+                config->replay.path = argv[optind + 1];
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--capture-max") == 0) {
+            long megabytes;
+            if (parse_long_value(config, argc, argv, 0,
+                                 XOE_WIRE_CAPTURE_MAX_MB, &megabytes) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->capture_max_mb = (int)megabytes;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--replay-speed") == 0) {
+            long speed;
+            if (parse_long_value(config, argc, argv, 0, REPLAY_MAX_SPEED,
+                                 &speed) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->replay.speed = (uint32_t)speed;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--cluster-node") == 0) {
+            long node_id;
+            if (parse_long_value(config, argc, argv, 1, CLUSTER_MAX_NODE_ID,
+                                 &node_id) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->cluster.node_id = (int)node_id;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--cluster-port") == 0) {
+            long cluster_port;
+            if (parse_long_value(config, argc, argv, 1, 65535,
+                                 &cluster_port) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->cluster.port = (int)cluster_port;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--cluster-peer") == 0) {
+            char peer_host[CLUSTER_PEER_MAX];
+            int peer_port;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --cluster-peer requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (cluster_parse_peer(argv[optind + 1], peer_host,
+                                   sizeof(peer_host), &peer_port) != 0) {
+                fprintf(stderr, "Invalid --cluster-peer: %s (use <host>:<port>)\n",
+                        argv[optind + 1]);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (config->cluster.peer_count == CLUSTER_MAX_PEERS) {
+                fprintf(stderr, "Too many --cluster-peer options (at most %d)\n",
+                        CLUSTER_MAX_PEERS);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            strcpy(config->cluster.peers[config->cluster.peer_count++],
+                   argv[optind + 1]);
+            optind += 2;
+        } else if (strcmp(argv[optind], "--cluster-bind") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --cluster-bind requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (strlen(argv[optind + 1]) >= sizeof(config->cluster.bind)) {
+                fprintf(stderr, "--cluster-bind address too long\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            strcpy(config->cluster.bind, argv[optind + 1]);
+            optind += 2;
+        } else if (strcmp(argv[optind], "--cluster-secret") == 0) {
+            int secret_result;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --cluster-secret requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            secret_result = cluster_load_secret(argv[optind + 1],
+                                                &config->cluster);
+            if (secret_result == E_FILE_NOT_FOUND) {
+                fprintf(stderr, "Cannot read --cluster-secret file %s\n",
+                        argv[optind + 1]);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (secret_result != 0) {
+                fprintf(stderr, "--cluster-secret %s: the first line must "
+                        "hold 1-%d characters\n", argv[optind + 1],
+                        USB_AUTH_SECRET_MAX - 1);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--io-uring") == 0) {
+            config->use_io_uring = TRUE;
+            optind++;
+        } else if (strcmp(argv[optind], "--handoff-socket") == 0 ||
+                   strcmp(argv[optind], "--takeover") == 0) {
+            char *path = (strcmp(argv[optind], "--takeover") == 0) ?
+                         config->takeover_path : config->handoff_path;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option %s requires an argument\n", argv[optind]);
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (argv[optind + 1][0] == '\0' ||
+                strlen(argv[optind + 1]) >= HANDOFF_PATH_MAX) {
+                fprintf(stderr, "Invalid socket path for %s (1-%d characters)\n",
+                        argv[optind], HANDOFF_PATH_MAX - 1);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            strcpy(path, argv[optind + 1]);
+            optind += 2;
+        } else if (strcmp(argv[optind], "--udp") == 0) {
+            config->use_udp = TRUE;
+            optind++;
+        } else if (strcmp(argv[optind], "--shm") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --shm requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (argv[optind + 1][0] == '\0' ||
+                strlen(argv[optind + 1]) >= SHM_LINK_PATH_MAX) {
+                fprintf(stderr, "Invalid socket path for --shm (1-%d characters)\n",
+                        SHM_LINK_PATH_MAX - 1);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            strcpy(config->shm_path, argv[optind + 1]);
+            optind += 2;
+        } else if (strcmp(argv[optind], "--l2") == 0) {
+            const char *spec;
+            const char *at;
+            size_t name_len;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --l2 requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            spec = argv[optind + 1];
+            at = strchr(spec, '@');
+            name_len = (at != NULL) ? (size_t)(at - spec) : strlen(spec);
+            if (name_len == 0 || name_len >= L2_RING_IFNAME_MAX ||
+                (at != NULL &&
+                 l2_ring_parse_mac(at + 1, config->l2_server_mac) != 0)) {
+                fprintf(stderr, "Invalid --l2 argument: %s "
+                        "(use <interface>[@<server-mac>])\n", spec);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            memcpy(config->l2_interface, spec, name_len);
+            config->l2_interface[name_len] = '\0';
+            optind += 2;
+        } else if (strcmp(argv[optind], "--udp-mode") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --udp-mode requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (serial_cfg != NULL) {
+                if (strcmp(argv[optind + 1], "reliable") == 0) {
+                    serial_cfg->delivery = SERIAL_DELIVERY_RELIABLE;
+                } else if (strcmp(argv[optind + 1], "latest") == 0) {
+                    serial_cfg->delivery = SERIAL_DELIVERY_LATEST;
+                } else {
+                    fprintf(stderr, "Invalid delivery mode: %s (use reliable or latest)\n",
+                            argv[optind + 1]);
+                    config->exit_code = EXIT_FAILURE;
+                    return STATE_CLEANUP;
+                }
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--serial-mux") == 0) {
+            config->serial_mux = TRUE;
+            optind++;
+        } else if (strcmp(argv[optind], "--hub") == 0) {
+            const char *spec;
+            const char *colon;
+            size_t topic_len;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --hub requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* <topic>[:pub|sub|write]; a topic may itself contain ':' */
+            spec = argv[optind + 1];
+            colon = strrchr(spec, ':');
+            topic_len = strlen(spec);
+            config->hub_role = SERIAL_HUB_PUBLISHER;
+            if (colon != NULL && serial_hub_parse_role(colon + 1) > 0) {
+                config->hub_role = serial_hub_parse_role(colon + 1);
+                topic_len = (size_t)(colon - spec);
+            }
+            if (topic_len == 0 || topic_len > SERIAL_HUB_TOPIC_MAX) {
+                fprintf(stderr, "Invalid --hub topic: %s (1-%d characters, "
+                        "then :pub, :sub or :write)\n", spec,
+                        SERIAL_HUB_TOPIC_MAX);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            memcpy(config->hub_topic, spec, topic_len);
+            config->hub_topic[topic_len] = '\0';
+            optind += 2;
+        } else if (strcmp(argv[optind], "--raw") == 0) {
+            xoe_packet_t join;
+            xoe_payload_t join_payload;
+            uint8_t join_buffer[XOE_WIRE_RAW_JOIN_HEADER +
+                                XOE_WIRE_RAW_NAME_MAX];
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --raw requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* Valid exactly when a RAW_JOIN can carry it */
+            if (xoe_wire_raw_join_init(&join, &join_payload, join_buffer,
+                                       argv[optind + 1]) != 0) {
+                fprintf(stderr, "Invalid --raw channel: %s (1-%d printable "
+                        "characters, no spaces)\n", argv[optind + 1],
+                        XOE_WIRE_RAW_NAME_MAX);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            strcpy(config->raw_channel, argv[optind + 1]);
+            optind += 2;
+        } else if (strcmp(argv[optind], "--compress") == 0) {
+            const char *algorithm;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --compress requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            algorithm = argv[optind + 1];
+            if (strcmp(algorithm, "none") == 0) {
+                config->wire_compress = 0;
+            } else if (strcmp(algorithm, "zlib") == 0) {
+                config->wire_compress = XOE_WIRE_FEATURE_COMPRESS_ZLIB;
+            } else if (strcmp(algorithm, "lz4") == 0 && LZ4_ENABLED) {
+                config->wire_compress = XOE_WIRE_FEATURE_COMPRESS_LZ4;
+            } else {
+                fprintf(stderr, "Invalid compression: %s (use none, zlib%s)\n",
+                        algorithm, LZ4_ENABLED ? ", lz4" : "");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--server-policy") == 0) {
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --server-policy requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (server_policy_parse(argv[optind + 1],
+                                    &config->servers.policy) != 0) {
+                fprintf(stderr, "Invalid server policy: %s (use primary, rtt "
+                        "or hash)\n", argv[optind + 1]);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            optind += 2;
+        } else if (strcmp(argv[optind], "--sock-profile") == 0) {
+            sock_tune_profile_t profile;
+            int busy_poll_us;
+            int zerocopy;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --sock-profile requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (sock_tune_parse_profile(argv[optind + 1], &profile) != 0) {
+                fprintf(stderr, "Invalid socket profile: %s\n",
+                        argv[optind + 1]);
+                fprintf(stderr, "Valid profiles: low-latency, bulk, system\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            /* --busy-poll and --zerocopy are independent of the preset */
+            busy_poll_us = config->sock_tune.busy_poll_us;
+            zerocopy = config->sock_tune.zerocopy;
+            sock_tune_preset(&config->sock_tune, profile);
+            config->sock_tune.busy_poll_us = busy_poll_us;
+            config->sock_tune.zerocopy = zerocopy;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--busy-poll") == 0) {
+            long usec;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --busy-poll requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (safe_strtol(argv[optind + 1], &usec, 0,
+                            SOCK_TUNE_MAX_BUSY_POLL_US) != 0) {
+                fprintf(stderr, "Invalid busy-poll time: %s (use 0-%d us)\n",
+                        argv[optind + 1], SOCK_TUNE_MAX_BUSY_POLL_US);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            config->sock_tune.busy_poll_us = (int)usec;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--zerocopy") == 0) {
+            config->sock_tune.zerocopy = TRUE;
+            optind += 1;
+        } else if (strcmp(argv[optind], "--sched") == 0) {
+            thread_class_t cls;
+            thread_sched_class_t entry;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --sched requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (thread_sched_parse(argv[optind + 1], &cls, &entry) != 0) {
+                fprintf(stderr, "Invalid thread scheduling: %s. Expected "
+                        "<class>:<cpus>[:fifo|rr[:<priority>]], class "
+                        "serial, usb or net, cpus a list or any, "
+                        "priority %d-%d\n", argv[optind + 1],
+                        THREAD_SCHED_MIN_PRIO, THREAD_SCHED_MAX_PRIO);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            config->thread_sched.classes[cls] = entry;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--thread-stack") == 0) {
+            long kb;
+            if (parse_long_value(config, argc, argv, 0,
+                                 THREAD_SCHED_MAX_STACK_KB, &kb) != 0) {
+                return STATE_CLEANUP;
+            }
+            if (kb != 0 && kb < THREAD_SCHED_MIN_STACK_KB) {
+                fprintf(stderr, "Invalid thread stack size: %ld KiB (use 0 "
+                        "for the system default or %d-%d)\n", kb,
+                        THREAD_SCHED_MIN_STACK_KB, THREAD_SCHED_MAX_STACK_KB);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            config->thread_stack_kb = (int)kb;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--mem-budget") == 0) {
+            long mb;
+            if (parse_long_value(config, argc, argv, 0, MEM_BUDGET_MAX_MB,
+                                 &mb) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->mem_budget_mb = (int)mb;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--conn-mem") == 0) {
+            long kb;
+            if (parse_long_value(config, argc, argv, 0, MEM_BUDGET_MAX_CONN_KB,
+                                 &kb) != 0) {
+                return STATE_CLEANUP;
+            }
+            config->conn_mem_kb = (int)kb;
+            optind += 2;
+        } else if (strcmp(argv[optind], "--log-level") == 0) {
+            log_level_t level;
+            if (optind + 1 >= argc) {
+                fprintf(stderr, "Option --log-level requires an argument\n");
+                print_usage(config->program_name);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            if (log_parse_level(argv[optind + 1], &level) != 0) {
+                fprintf(stderr, "Invalid log level: %s\n", argv[optind + 1]);
+                fprintf(stderr, "Valid levels: error, warn, info, debug\n");
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            log_set_level(level);
+            config->log_level = (int)level;
+            optind += 2;
         } else if (strcmp(argv[optind], "--list-usb") == 0) {
             /* List USB devices and exit */
             {
@@ -1,36 +1,126 @@
 /**
  * state_server_mode.c
  *
- * Implements the TCP/TLS server mode with multi-threaded client handling.
+ * Implements the TCP/TLS server mode. Accepted connections are handed to
+ * the event loop (core/event_loop.c), which services them on a small
+ * fixed set of worker threads.
+ *
+ * With --listeners N the server opens N sockets on the same port with
+ * SO_REUSEPORT, each accepted by its own thread. The kernel spreads
+ * incoming connections across the sockets (and their backlogs), and each
+ * listener hands its connections only to its own workers, so a reconnect
+ * storm is accepted on N cores instead of queueing behind one thread.
+ *
+ * With --handoff-socket a new binary started with --takeover takes the
+ * listening sockets and idle connections over (core/handoff.h): this
+ * process stops accepting, passes them on, serves what it cannot pass
+ * until it closes, and exits. If the new process dies before the
+ * listeners are through, or while connections are being passed, this
+ * one resumes accepting.
+ *
+ * With --udp a UDP (or DTLS) listener on the same port, and with --l2 a
+ * layer-2 one on an Ethernet interface, serve serial bridges beside the
+ * TCP ones (core/dgram_server.h). They stop while the listeners are
+ * handed over, and the new process opens its own.
+ *
+ * With --shm the first listener also accepts same-host links on a UNIX
+ * socket (lib/net/shm_link.h); they join the event loop like TCP
+ * connections. Like the datagram listeners the socket closes at a
+ * handover and the new process opens its own; open links are not passed
+ * on but served here until they close.
+ *
+ * With --cluster-node the server links to the other nodes of a cluster
+ * (core/cluster.h) and routes USB devices and hub topics across them.
+ * The links have a listener of their own, on --cluster-bind or loopback.
+ * The links close at a handover like the datagram listeners; the new
+ * process links up again and the nodes resync.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <pthread.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <sys/time.h>
 #include <netinet/in.h>
 #include <signal.h>
+#include <time.h>
 
 #include "core/config.h"
 #include "core/server.h"
+#include "core/event_loop.h"
+#include "core/cluster.h"
+#include "core/dgram_server.h"
+#include "core/handoff.h"
+#include "core/raw_relay.h"
+#include "core/mgmt/mgmt_config.h"
+#include "core/mgmt/mgmt_server.h"
 #include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/thread_sched.h"
 #include "lib/net/net_resolve.h"
+#include "lib/net/shm_link.h"
+#include "lib/net/sock_tune.h"
+#include "lib/protocol/wire_zerocopy.h"
 #include "connectors/usb/usb_server.h"
+#include "connectors/serial/serial_session.h"
 
 #if TLS_ENABLED
 #include "lib/security/tls_config.h"
 #include "lib/security/tls_context.h"
 #include "lib/security/tls_error.h"
+#include "lib/security/tls_session.h"
 #endif
 
 /* Global shutdown flag for signal handling */
 static volatile sig_atomic_t g_server_shutdown = 0;
 
+/* Set while listeners are handed to a new process: accept threads exit,
+ * but the server keeps running */
+static volatile sig_atomic_t g_accept_stop = 0;
+
+/* Written when either flag above is set, so accept threads block in
+ * select() without a timeout. Never closed: the signal handler may write
+ * to it at any time. */
+static int g_accept_wake[2] = {-1, -1};
+
+/* One listening socket and the thread accepting on it */
+typedef struct {
+    int fd;                     /* Listening socket (-1 = not open) */
+    int index;                  /* Listener number */
+    int stride;                 /* Listener count (1 = round-robin workers) */
+    int next;                   /* Cursor over this listener's workers */
+    event_loop_t *loop;         /* Where accepted connections go */
+    const sock_tune_t *tune;    /* Options for accepted sockets, unless the
+                                   config manager publishes newer ones */
+    int handoff_fd;             /* Upgrade socket to watch, or -1 */
+    int shm_fd;                 /* Same-host link socket to watch, or -1 */
+    int upgrade_sock;           /* Set when a new process asks to take over */
+    pthread_t thread;
+    int thread_started;
+} server_listener_t;
+
+/* Connections being passed to a new process */
+typedef struct {
+    int sock;                   /* Handoff connection */
+    event_loop_t *loop;         /* Where to put back what could not go */
+    int passed;                 /* Connections passed */
+    int broken;                 /* Handoff connection failed */
+} handoff_ctx_t;
+
+/* Connections arriving from the old process */
+typedef struct {
+    int sock;                   /* Handoff connection */
+    event_loop_t *loop;         /* Where adopted connections go */
+    pthread_t thread;
+    int thread_started;
+} takeover_t;
+
 /**
  * server_signal_handler - Signal handler for graceful shutdown
  * @signum: Signal number received
@@ -38,8 +128,687 @@ static volatile sig_atomic_t g_server_shutdown = 0;
  * Sets global shutdown flag when SIGINT or SIGTERM is received.
  */
 static void server_signal_handler(int signum) {
+    int saved_errno = errno;
+
     (void)signum; /* Unused parameter */
     g_server_shutdown = 1;
+    if (g_accept_wake[1] >= 0 && write(g_accept_wake[1], "s", 1) < 0) {
+        /* Pipe full: a wakeup is already pending */
+    }
+    errno = saved_errno;
+}
+
+/**
+ * accept_wake_open - Create the accept threads' wakeup pipe (once)
+ *
+ * Returns: 0 on success, -1 if accept threads must poll the flags
+ */
+static int accept_wake_open(void) {
+    int fds[2];
+    int i;
+
+    if (g_accept_wake[0] >= 0) {
+        return 0;
+    }
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    for (i = 0; i < 2; i++) {
+        if (fd_set_nonblocking(fds[i]) != 0) {
+            perror("fcntl");
+            close(fds[0]);
+            close(fds[1]);
+            return -1;
+        }
+    }
+    g_accept_wake[0] = fds[0];
+    g_accept_wake[1] = fds[1];
+    return 0;
+}
+
+/**
+ * accept_wake - Wake every accept thread to recheck the stop flags
+ *
+ * The byte stays in the pipe until accept_wake_reset(), so threads that
+ * reach select() later return at once too.
+ */
+static void accept_wake(void) {
+    if (g_accept_wake[1] >= 0 && write(g_accept_wake[1], "a", 1) < 0) {
+        /* Pipe full: a wakeup is already pending */
+    }
+}
+
+/**
+ * accept_wake_reset - Drain the wakeup pipe before accept threads restart
+ */
+static void accept_wake_reset(void) {
+    char drain[64];
+
+    if (g_accept_wake[0] < 0) {
+        return;
+    }
+    while (read(g_accept_wake[0], drain, sizeof(drain)) > 0) {
+        /* discard */
+    }
+}
+
+/**
+ * open_listener - Create, bind and listen on a server socket
+ * @address: Bind address
+ * @reuseport: Set SO_REUSEPORT so several sockets share the port
+ * @backlog: listen() backlog
+ * @tune: Socket options (buffer sizes must be set before listen())
+ *
+ * Returns: Listening socket, or -1 on failure (reason printed)
+ */
+static int open_listener(const struct sockaddr_in *address, int reuseport,
+                         int backlog, const sock_tune_t *tune) {
+    int fd;
+    int opt = 1;
+
+    /* Create socket file descriptor */
+    if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        perror("socket failed");
+        return -1;
+    }
+
+    /* Enable SO_REUSEADDR to allow rapid restart (avoids TIME_WAIT issues) */
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt SO_REUSEADDR failed");
+        close(fd);
+        return -1;
+    }
+
+#ifdef SO_REUSEPORT
+    if (reuseport &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt SO_REUSEPORT failed");
+        close(fd);
+        return -1;
+    }
+#else
+    (void)reuseport;
+#endif
+
+    /* Bind the socket to the specified IP and port */
+    if (bind(fd, (const struct sockaddr *)address, sizeof(*address)) < 0) {
+        perror("bind failed");
+        close(fd);
+        return -1;
+    }
+
+    if (sock_tune_apply(fd, tune) != 0) {
+        fprintf(stderr, "Warning: some %s socket options were refused\n",
+                sock_tune_profile_name(tune->profile));
+    }
+
+    /* Listen for incoming connections */
+    if (listen(fd, backlog) < 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * listener_next_worker - Pick the worker for a listener's next connection
+ * @listener: Listener
+ *
+ * Listener i owns workers i, i + N, i + 2N, ... (N listeners) and cycles
+ * through them; a single listener leaves the choice to the event loop.
+ *
+ * Returns: Worker index, or -1 for the event loop's round-robin
+ */
+static int listener_next_worker(server_listener_t *listener) {
+    int workers;
+    int worker;
+
+    if (listener->stride <= 1) {
+        return -1;
+    }
+
+    workers = event_loop_worker_count(listener->loop);
+    worker = listener->index + listener->next * listener->stride;
+    if (worker >= workers) {
+        listener->next = 0;
+        worker = listener->index;
+    }
+    listener->next++;
+    return worker;
+}
+
+/**
+ * accept_shm_link - Accept a same-host link from the --shm socket
+ * @listener: Listener watching it
+ *
+ * Links skip the rate limit (the socket's permissions govern who may
+ * connect) and socket options (there is no TCP underneath). They show as
+ * connections from 127.0.0.1 port 0.
+ */
+static void accept_shm_link(server_listener_t *listener) {
+    client_info_t *client_info;
+    int fd;
+    int result;
+
+    result = shm_link_accept(listener->shm_fd, &fd);
+    if (result != 0) {
+        fprintf(stderr, "Rejected shared-memory link (error %d)\n", result);
+        return;
+    }
+
+    client_info = acquire_client_slot();
+    if (client_info == NULL) {
+        fprintf(stderr, "Max clients (%d) reached, rejecting connection\n", MAX_CLIENTS);
+        shm_link_close(fd);
+        return;
+    }
+    memset(&client_info->client_addr, 0, sizeof(client_info->client_addr));
+    client_info->client_addr.sin_family = AF_INET;
+    client_info->client_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    client_info->client_socket = fd;
+
+    if (event_loop_add_client_on(listener->loop,
+                                 listener_next_worker(listener),
+                                 client_info) != 0) {
+        shm_link_close(fd);
+        release_client_slot(client_info);
+    }
+}
+
+/**
+ * accept_loop - Accept connections on one listener until shutdown
+ * @listener: Listener to serve
+ *
+ * Socket options for each accepted connection come from the active
+ * config snapshot, so buffer sizes changed with the management "reload"
+ * command apply to new connections without a restart.
+ *
+ * Also returns when a new process connects to the listener's upgrade
+ * socket (listener->upgrade_sock is set then).
+ */
+static void accept_loop(server_listener_t *listener) {
+    int new_socket = 0;
+    struct sockaddr_in address;
+    socklen_t addrlen;
+    client_info_t *client_info = NULL;
+    mgmt_config_reader_t live = MGMT_CONFIG_READER_INIT;
+    const xoe_config_t *active;
+    const sock_tune_t *tune;
+
+    while (!g_server_shutdown && !g_accept_stop &&
+           !mgmt_restart_is_requested()) {
+        fd_set readfds;
+        struct timeval timeout;
+        int select_result;
+        int max_fd = listener->fd;
+
+        /* Block until a connection or a wakeup; without the wakeup pipe,
+         * poll the flags every second */
+        FD_ZERO(&readfds);
+        FD_SET(listener->fd, &readfds);
+        if (listener->handoff_fd >= 0) {
+            FD_SET(listener->handoff_fd, &readfds);
+            if (listener->handoff_fd > max_fd) {
+                max_fd = listener->handoff_fd;
+            }
+        }
+        if (listener->shm_fd >= 0) {
+            FD_SET(listener->shm_fd, &readfds);
+            if (listener->shm_fd > max_fd) {
+                max_fd = listener->shm_fd;
+            }
+        }
+        if (g_accept_wake[0] >= 0) {
+            FD_SET(g_accept_wake[0], &readfds);
+            if (g_accept_wake[0] > max_fd) {
+                max_fd = g_accept_wake[0];
+            }
+        }
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+
+        select_result = select(max_fd + 1, &readfds, NULL, NULL,
+                               (g_accept_wake[0] >= 0) ? NULL : &timeout);
+
+        if (select_result < 0) {
+            if (g_server_shutdown) break;
+            perror("select");
+            continue;
+        }
+
+        if (select_result == 0) {
+            /* Timeout - check shutdown flag and continue */
+            continue;
+        }
+
+        if (listener->handoff_fd >= 0 &&
+            FD_ISSET(listener->handoff_fd, &readfds)) {
+            int sock = handoff_accept(listener->handoff_fd);
+            if (sock >= 0) {
+                listener->upgrade_sock = sock;
+                g_accept_stop = 1;
+                accept_wake();
+                break;
+            }
+            fprintf(stderr, "Ignoring connection on the handoff socket "
+                    "(error %d)\n", sock);
+        }
+
+        if (listener->shm_fd >= 0 && FD_ISSET(listener->shm_fd, &readfds)) {
+            accept_shm_link(listener);
+        }
+
+        if (!FD_ISSET(listener->fd, &readfds)) {
+            continue;
+        }
+
+        /* Socket is ready for accept() */
+        client_info = acquire_client_slot();
+        if (client_info == NULL) {
+            fprintf(stderr, "Max clients (%d) reached, rejecting connection\n", MAX_CLIENTS);
+            /* Still need to accept and close to prevent backlog */
+            addrlen = sizeof(address);
+            new_socket = accept(listener->fd, (struct sockaddr *)&address,
+                                &addrlen);
+            if (new_socket >= 0) {
+                close(new_socket);
+            }
+            continue;
+        }
+
+        addrlen = sizeof(client_info->client_addr);
+        new_socket = accept(listener->fd,
+                            (struct sockaddr *)&client_info->client_addr,
+                            &addrlen);
+        if (new_socket < 0) {
+            if (g_server_shutdown) {
+                release_client_slot(client_info);
+                break;
+            }
+            perror("accept");
+            release_client_slot(client_info);
+            continue;
+        }
+
+        /* Check connection rate limit (NET-012 fix) */
+        if (!check_connection_rate_limit(
+                (const struct sockaddr *)&client_info->client_addr)) {
+            fprintf(stderr, "Rate limit exceeded for %s, rejecting connection\n",
+                    inet_ntoa(client_info->client_addr.sin_addr));
+            close(new_socket);
+            release_client_slot(client_info);
+            continue;
+        }
+
+        /* Most options are inherited from the listener on Linux, not
+         * everywhere; failures were already reported for the listener */
+        active = mgmt_config_read(g_config_manager, &live);
+        tune = (active != NULL) ? &active->sock_tune : listener->tune;
+        (void)sock_tune_apply(new_socket, tune);
+        if (tune != NULL && tune->zerocopy) {
+            (void)xoe_wire_zerocopy_enable(new_socket);
+        }
+
+        client_info->client_socket = new_socket;
+
+        if (event_loop_add_client_on(listener->loop,
+                                     listener_next_worker(listener),
+                                     client_info) != 0) {
+            close(new_socket);
+            release_client_slot(client_info);
+        }
+    }
+
+    mgmt_config_reader_release(&live);
+}
+
+/**
+ * listener_thread_func - Thread body for listeners after the first
+ */
+static void *listener_thread_func(void *arg) {
+    accept_loop((server_listener_t *)arg);
+    return NULL;
+}
+
+/**
+ * pin_or_warn - Pin a thread, warning (once) if the platform refuses
+ */
+static void pin_or_warn(int result, const char *what, int index, int cpu) {
+    if (result == E_NOT_SUPPORTED) {
+        static int warned = 0;
+        if (!warned) {
+            fprintf(stderr, "Warning: CPU pinning is not supported on this "
+                    "platform, --cpus ignored\n");
+            warned = 1;
+        }
+    } else if (result != 0) {
+        fprintf(stderr, "Warning: could not pin %s %d to CPU %d\n",
+                what, index, cpu);
+    }
+}
+
+/**
+ * start_listener_threads - Start accept threads for listeners after the
+ *                          first and pin every listener if configured
+ * @listeners: Listeners (listener 0 runs on the calling thread)
+ * @num_listeners: Listener count
+ * @config: Configuration (CPU list)
+ */
+static void start_listener_threads(server_listener_t *listeners,
+                                   int num_listeners,
+                                   const xoe_config_t *config) {
+    int i;
+
+    for (i = 1; i < num_listeners; i++) {
+        if (thread_sched_create(&listeners[i].thread, THREAD_CLASS_NONE,
+                                listener_thread_func, &listeners[i]) != 0) {
+            perror("listener: pthread_create");
+            continue;   /* Its connections go to the other sockets */
+        }
+        listeners[i].thread_started = TRUE;
+    }
+    if (config->cpu_count > 0) {
+        for (i = 0; i < num_listeners; i++) {
+            int cpu = config->cpus[i % config->cpu_count];
+            if (i == 0) {
+                pin_or_warn(event_loop_pin_thread(pthread_self(), cpu),
+                            "listener", i, cpu);
+            } else if (listeners[i].thread_started) {
+                pin_or_warn(event_loop_pin_thread(listeners[i].thread, cpu),
+                            "listener", i, cpu);
+            }
+        }
+    }
+}
+
+/**
+ * join_listener_threads - Wait for accept threads after the first
+ *
+ * The wakeup pipe gets them out of select() once g_server_shutdown or
+ * g_accept_stop is set.
+ */
+static void join_listener_threads(server_listener_t *listeners,
+                                  int num_listeners) {
+    int i;
+
+    for (i = 1; i < num_listeners; i++) {
+        if (listeners[i].thread_started) {
+            pthread_join(listeners[i].thread, NULL);
+            listeners[i].thread_started = FALSE;
+        }
+    }
+}
+
+/**
+ * open_handoff_socket - Listen for upgrades if --handoff-socket is set
+ *
+ * Returns: Upgrade socket, or -1 (none configured, or warning printed)
+ */
+static int open_handoff_socket(const xoe_config_t *config) {
+    int fd;
+
+    if (config->handoff_path[0] == '\0') {
+        return -1;
+    }
+
+    fd = handoff_listen(config->handoff_path);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: cannot listen on handoff socket %s "
+                "(error %d), upgrades disabled\n", config->handoff_path, fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * open_shm_socket - Listen for same-host links if --shm is set
+ *
+ * Returns: Link socket, or -1 (none configured, or warning printed)
+ */
+static int open_shm_socket(const xoe_config_t *config) {
+    int fd;
+
+    if (config->shm_path[0] == '\0') {
+        return -1;
+    }
+
+    fd = shm_link_listen(config->shm_path);
+    if (fd < 0) {
+        fprintf(stderr, "Warning: cannot listen on shared-memory socket %s "
+                "(error %d), same-host links disabled\n", config->shm_path, fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * start_mgmt_late - Start the management interface once the listeners
+ *                   accept, or after a failed handoff released the port
+ *
+ * state_start_mgmt() leaves it to server mode, so that opening the
+ * console (and its TLS context) does not delay the first connection.
+ */
+static void start_mgmt_late(xoe_config_t *config) {
+    if (config->mgmt_port == 0 || config->mgmt_server != NULL) {
+        return;
+    }
+    config->mgmt_server = mgmt_server_start(config);
+    if (config->mgmt_server == NULL) {
+        fprintf(stderr, "Warning: Failed to start management interface\n");
+    }
+}
+
+/**
+ * pass_connection - Send one detached connection to the new process
+ * @client: Connection detached from the event loop
+ * @arg: handoff_ctx_t
+ *
+ * Once the new process has the descriptor, only this process's copy is
+ * closed; with kernel TLS the SSL object is freed without a close_notify,
+ * as the session lives on. If the send fails the connection goes back to
+ * this process's event loop.
+ */
+static void pass_connection(client_info_t *client, void *arg) {
+    handoff_ctx_t *ctx = (handoff_ctx_t *)arg;
+    handoff_conn_t conn;
+
+    conn.fd = client->client_socket;
+    conn.addr = client->client_addr;
+    conn.wire_features = client->wire_features;
+    conn.ktls = FALSE;
+#if TLS_ENABLED
+    conn.ktls = (client->tls_session != NULL);
+#endif
+
+    if (ctx->broken || handoff_send_conn(ctx->sock, &conn) != 0) {
+        ctx->broken = TRUE;
+        if (event_loop_adopt_client(ctx->loop, client,
+                                    client->wire_features) != 0) {
+            server_release_client(client);
+        }
+        return;
+    }
+
+#if TLS_ENABLED
+    tls_session_destroy(client->tls_session);
+    client->tls_session = NULL;
+#endif
+    xoe_wire_zerocopy_reset(client->client_socket);
+    close(client->client_socket);
+    release_client_slot(client);
+    ctx->passed++;
+}
+
+/**
+ * hand_over - Pass listeners and connections to a new process
+ * @config: Configuration (management interface)
+ * @listeners: Listeners, none of them accepting any more
+ * @num_listeners: Listener count
+ * @loop: Event loop holding the connections
+ * @sock: Handoff connection from handoff_accept() (closed here)
+ *
+ * Connections are passed as they go idle; the rest are served here until
+ * they close, HANDOFF_DRAIN_TIMEOUT passes or a signal arrives. The
+ * listening sockets stay open here until the end, so a failure leaves
+ * this process able to carry on.
+ *
+ * Returns: 0 once done (the server exits), -1 if the new process went
+ *          away and this one should resume accepting
+ */
+static int hand_over(xoe_config_t *config, server_listener_t *listeners,
+                     int num_listeners, event_loop_t *loop, int sock) {
+    int fds[MAX_SERVER_LISTENERS];
+    handoff_ctx_t ctx;
+    time_t deadline;
+    int remaining;
+    int reported = FALSE;
+    int i;
+
+    printf("Upgrade requested, handing over to the new process\n");
+
+    /* The new process binds the management port once it has the
+     * listeners */
+    if (config->mgmt_server != NULL) {
+        mgmt_server_stop((mgmt_server_t *)config->mgmt_server);
+        config->mgmt_server = NULL;
+    }
+
+    for (i = 0; i < num_listeners; i++) {
+        fds[i] = listeners[i].fd;
+    }
+    if (handoff_send_listeners(sock, fds, num_listeners) != 0) {
+        fprintf(stderr, "Handoff failed: the new process went away\n");
+        close(sock);
+        return -1;
+    }
+
+    ctx.sock = sock;
+    ctx.loop = loop;
+    ctx.passed = 0;
+    ctx.broken = FALSE;
+    deadline = time(NULL) + HANDOFF_DRAIN_TIMEOUT;
+
+    for (;;) {
+        remaining = event_loop_detach_idle(loop, pass_connection, &ctx);
+        if (ctx.broken) {
+            fprintf(stderr, "Handoff failed after %d connection(s): the new "
+                    "process went away\n", ctx.passed);
+            close(sock);
+            return -1;
+        }
+        if (remaining <= 0 || g_server_shutdown || time(NULL) >= deadline) {
+            break;
+        }
+        if (!reported) {
+            printf("Passed %d connection(s); serving %d more until they can "
+                   "be passed or close (at most %d s)\n",
+                   ctx.passed, remaining, HANDOFF_DRAIN_TIMEOUT);
+            reported = TRUE;
+        }
+        usleep(HANDOFF_DRAIN_POLL_MS * 1000);
+    }
+
+    (void)handoff_send_end(sock);
+    close(sock);
+    printf("Handoff complete: %d connection(s) passed, %d closed here\n",
+           ctx.passed, remaining > 0 ? remaining : 0);
+    return 0;
+}
+
+/**
+ * takeover_thread_func - Adopt connections passed by the old process
+ * @arg: takeover_t
+ *
+ * Runs until the old process reports the last one or goes away.
+ */
+static void *takeover_thread_func(void *arg) {
+    takeover_t *takeover = (takeover_t *)arg;
+    handoff_conn_t conn;
+    client_info_t *client;
+    int adopted = 0;
+    int result;
+
+    while ((result = handoff_recv_conn(takeover->sock, &conn)) == 1) {
+        client = acquire_client_slot();
+        if (client == NULL) {
+            fprintf(stderr, "Max clients (%d) reached, dropping taken-over "
+                    "connection\n", MAX_CLIENTS);
+            close(conn.fd);
+            continue;
+        }
+        client->client_socket = conn.fd;
+        client->client_addr = conn.addr;
+#if TLS_ENABLED
+        client->tls_session = NULL;     /* Kernel TLS, if any, is in the fd */
+#endif
+        if (event_loop_adopt_client(takeover->loop, client,
+                                    conn.wire_features) != 0) {
+            close(conn.fd);
+            release_client_slot(client);
+            continue;
+        }
+        adopted++;
+    }
+
+    if (result == 0) {
+        printf("Takeover complete: %d connection(s) adopted\n", adopted);
+    } else if (!g_server_shutdown) {
+        fprintf(stderr, "Takeover ended early (error %d): %d connection(s) "
+                "adopted\n", result, adopted);
+    }
+    return NULL;
+}
+
+/**
+ * take_over_listeners - Receive the listening sockets of a running server
+ * @config: Configuration (--takeover path, expected port)
+ * @listeners: Receives the descriptors
+ * @num_listeners: Receives the listener count
+ *
+ * Returns: Handoff connection for the connections that follow, or
+ *          negative error code (the caller opens its own listeners)
+ */
+static int take_over_listeners(const xoe_config_t *config,
+                               server_listener_t *listeners,
+                               int *num_listeners) {
+    int fds[MAX_SERVER_LISTENERS];
+    struct sockaddr_in bound;
+    socklen_t len = sizeof(bound);
+    int count;
+    int sock;
+    int result;
+    int i;
+
+    sock = handoff_connect(config->takeover_path);
+    if (sock < 0) {
+        return sock;
+    }
+
+    result = handoff_recv_listeners(sock, fds, MAX_SERVER_LISTENERS, &count);
+    if (result != 0) {
+        close(sock);
+        return result;
+    }
+
+    for (i = 0; i < count; i++) {
+        listeners[i].fd = fds[i];
+    }
+    *num_listeners = count;
+
+    if (count != config->listeners) {
+        fprintf(stderr, "Note: took over %d listener(s), --listeners %d "
+                "ignored\n", count, config->listeners);
+    }
+    if (getsockname(fds[0], (struct sockaddr *)&bound, &len) == 0 &&
+        ntohs(bound.sin_port) != config->listen_port) {
+        fprintf(stderr, "Note: taken-over listeners are on port %d, -p %d "
+                "ignored\n", ntohs(bound.sin_port), config->listen_port);
+    }
+    printf("Took over %d listener(s) from %s\n", count, config->takeover_path);
+    return sock;
 }
 
 /**
@@ -50,27 +819,40 @@ static void server_signal_handler(int signum) {
  *
  * Server mode operation:
  * 1. Initialize TLS context if encryption is enabled
- * 2. Create and bind server socket
+ * 2. Create and bind the server socket(s)
  * 3. Listen for incoming connections
- * 4. Accept connections and spawn handler threads
+ * 4. Accept connections (one thread per listener) and hand them to event
+ *    loop workers, optionally pinned to CPUs
  * 5. Manage client pool to limit concurrent connections
  *
- * The server runs in an infinite loop until interrupted.
+ * With --takeover, steps 2 and 3 are replaced by receiving the listening
+ * sockets of the running server, whose connections then follow.
+ *
+ * The server runs until interrupted, until the management interface
+ * requests a restart (which wakes the accept threads through the same
+ * pipe as a signal and returns STATE_MODE_STOP once everything is torn
+ * down), or until it has handed over to a new process.
  */
 xoe_state_t state_server_mode(xoe_config_t *config) {
-    int server_fd = 0;
-    int new_socket = 0;
     struct sockaddr_in address;
-    int addrlen = sizeof(address);
-    client_info_t *client_info = NULL;
-    pthread_t thread_id;
+    server_listener_t listeners[MAX_SERVER_LISTENERS];
+    int num_listeners;
+    int num_workers;
+    event_loop_t *event_loop = NULL;
+    dgram_server_t *dgram_server = NULL;
+    cluster_t *cluster = NULL;
+    struct sockaddr_in cluster_address;
+    takeover_t takeover;
+    int failed = FALSE;
+    int restart;
+    int i;
 
 #if TLS_ENABLED
     /* Initialize TLS context before accepting connections (if encryption enabled) */
     if (config->encryption_mode != ENCRYPT_NONE) {
-        g_tls_ctx = tls_context_init(config->cert_path, config->key_path,
-                                      config->encryption_mode);
-        if (g_tls_ctx == NULL) {
+        SSL_CTX *ctx = tls_context_init(config->cert_path, config->key_path,
+                                        config->encryption_mode);
+        if (ctx == NULL) {
             fprintf(stderr, "Failed to initialize TLS: %s\n", tls_get_error_string());
             fprintf(stderr, "Make sure certificates exist at:\n");
             fprintf(stderr, "  %s\n", config->cert_path);
@@ -79,6 +861,7 @@ xoe_state_t state_server_mode(xoe_config_t *config) {
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
         }
+        server_tls_ctx_replace(ctx);
         if (config->encryption_mode == ENCRYPT_TLS12) {
             printf("TLS 1.2 enabled\n");
         } else {
@@ -89,23 +872,17 @@ xoe_state_t state_server_mode(xoe_config_t *config) {
     }
 #endif
 
-    /* Create socket file descriptor */
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-        perror("socket failed");
-        config->exit_code = EXIT_FAILURE;
-        return STATE_CLEANUP;
+    /* Several listeners share the port through SO_REUSEPORT */
+    num_listeners = config->listeners;
+    if (num_listeners < 1 || num_listeners > MAX_SERVER_LISTENERS) {
+        num_listeners = 1;
     }
-
-    /* Enable SO_REUSEADDR to allow rapid restart (avoids TIME_WAIT issues) */
-    {
-        int opt = 1;
-        if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-            perror("setsockopt SO_REUSEADDR failed");
-            close(server_fd);
-            config->exit_code = EXIT_FAILURE;
-            return STATE_CLEANUP;
-        }
+#ifndef SO_REUSEPORT
+    if (num_listeners > 1) {
+        fprintf(stderr, "Warning: SO_REUSEPORT not available, using one listener\n");
+        num_listeners = 1;
     }
+#endif
 
     /* Set up address structure */
     memset(&address, 0, sizeof(address));
@@ -122,7 +899,6 @@ xoe_state_t state_server_mode(xoe_config_t *config) {
             net_resolve_format_error(&resolve_result, error_buf, sizeof(error_buf));
             fprintf(stderr, "Failed to resolve listen address '%s': %s\n",
                     config->listen_address, error_buf);
-            close(server_fd);
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
         }
@@ -131,35 +907,128 @@ xoe_state_t state_server_mode(xoe_config_t *config) {
         address.sin_addr.s_addr = INADDR_ANY;
     }
 
-    /* Bind the socket to the specified IP and port */
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
-        perror("bind failed");
-        close(server_fd);
+    /* Cluster links listen apart from the public listener: on loopback
+     * unless --cluster-bind names the nodes' network */
+    memset(&cluster_address, 0, sizeof(cluster_address));
+    cluster_address.sin_family = AF_INET;
+    cluster_address.sin_port = htons(config->cluster.port);
+    cluster_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (config->cluster.bind[0] != '\0') {
+        net_resolve_result_t resolve_result;
+        char error_buf[256];
+
+        if (net_resolve_to_sockaddr(config->cluster.bind, config->cluster.port,
+                                    &cluster_address, &resolve_result) != 0) {
+            net_resolve_format_error(&resolve_result, error_buf, sizeof(error_buf));
+            fprintf(stderr, "Failed to resolve cluster address '%s': %s\n",
+                    config->cluster.bind, error_buf);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+
+    /* Take the listening sockets over from a running server, if any */
+    for (i = 0; i < MAX_SERVER_LISTENERS; i++) {
+        listeners[i].fd = -1;
+    }
+    g_accept_stop = 0;
+    accept_wake_reset();
+    takeover.sock = -1;
+    takeover.thread_started = FALSE;
+    if (config->takeover_path[0] != '\0') {
+        takeover.sock = take_over_listeners(config, listeners, &num_listeners);
+        if (takeover.sock == E_NOT_FOUND) {
+            printf("No server to take over at %s, starting fresh\n",
+                   config->takeover_path);
+        } else if (takeover.sock < 0) {
+            fprintf(stderr, "Takeover from %s failed (error %d), starting "
+                    "fresh\n", config->takeover_path, takeover.sock);
+        }
+    }
+
+    /* Open every listening socket before serving any of them */
+    for (i = 0; i < num_listeners; i++) {
+        listeners[i].index = i;
+        listeners[i].stride = num_listeners;
+        listeners[i].next = 0;
+        listeners[i].loop = NULL;
+        listeners[i].tune = &config->sock_tune;
+        listeners[i].handoff_fd = -1;
+        listeners[i].shm_fd = -1;
+        listeners[i].upgrade_sock = -1;
+        listeners[i].thread_started = FALSE;
+    }
+    for (i = 0; i < num_listeners && !failed && takeover.sock < 0; i++) {
+        listeners[i].fd = open_listener(&address, num_listeners > 1,
+                                        config->listen_backlog,
+                                        &config->sock_tune);
+        failed = (listeners[i].fd < 0);
+    }
+    if (failed) {
+        for (i = 0; i < num_listeners; i++) {
+            if (listeners[i].fd >= 0) {
+                close(listeners[i].fd);
+            }
+        }
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
 
-    /* Listen for incoming connections */
-    if (listen(server_fd, MAX_PENDING_CONNECTIONS) < 0) {
-        perror("listen");
-        close(server_fd);
+    /* Initialize the client pool */
+    init_client_pool(config->conn_rate);
+
+    /* The USB server starts with the first USB frame (server_usb_get()) */
+    server_usb_prepare(config);
+
+    /* Protocol handlers and their pools (after USB server setup: the
+     * USB handler routes into it) */
+    if (server_protocols_init() != 0) {
+        fprintf(stderr, "Failed to start protocol handlers\n");
+        server_usb_cleanup();
+        for (i = 0; i < num_listeners; i++) {
+            close(listeners[i].fd);
+        }
+        if (takeover.sock >= 0) {
+            close(takeover.sock);
+        }
         config->exit_code = EXIT_FAILURE;
         return STATE_CLEANUP;
     }
 
-    /* Initialize the client pool */
-    init_client_pool();
+    /* Start event loop workers (after USB server: workers route into it);
+     * every listener needs at least one worker of its own */
+    num_workers = EVENT_LOOP_WORKERS;
+    if (num_workers < num_listeners) {
+        num_workers = num_listeners;
+    }
+    event_loop = event_loop_init(num_workers, EVENT_LOOP_HANDSHAKE_THREADS,
+                                 config->use_io_uring);
+    if (event_loop == NULL) {
+        fprintf(stderr, "Failed to start event loop\n");
+        server_protocols_cleanup();
+        server_usb_cleanup();
+        for (i = 0; i < num_listeners; i++) {
+            close(listeners[i].fd);
+        }
+        if (takeover.sock >= 0) {
+            close(takeover.sock);
+        }
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
 
-    /* Initialize USB server for USB protocol routing */
-    g_usb_server = usb_server_init();
-    if (g_usb_server == NULL) {
-        fprintf(stderr, "Warning: Failed to initialize USB server\n");
-        fprintf(stderr, "USB protocol routing will be disabled\n");
-    } else {
-        printf("USB server initialized\n");
+    /* Worker i shares CPU i of the list with listener i */
+    if (config->cpu_count > 0) {
+        for (i = 0; i < num_workers; i++) {
+            int cpu = config->cpus[i % config->cpu_count];
+            pin_or_warn(event_loop_pin_worker(event_loop, i, cpu),
+                        "worker", i, cpu);
+        }
     }
 
     /* Set up signal handlers for graceful shutdown (NET-009 fix: use sigaction) */
+    (void)accept_wake_open();
+    mgmt_restart_set_notify(accept_wake);
     {
         struct sigaction sa;
         memset(&sa, 0, sizeof(sa));
@@ -168,100 +1037,152 @@ xoe_state_t state_server_mode(xoe_config_t *config) {
         sa.sa_flags = 0;
         sigaction(SIGINT, &sa, NULL);
         sigaction(SIGTERM, &sa, NULL);
+
+        /* One process serves every client: a peer reset must not kill it */
+        sa.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &sa, NULL);
+    }
+
+    /* Connections from the old process arrive while this one accepts */
+    if (takeover.sock >= 0) {
+        takeover.loop = event_loop;
+        if (thread_sched_create(&takeover.thread, THREAD_CLASS_NONE,
+                                takeover_thread_func, &takeover) != 0) {
+            perror("takeover: pthread_create");
+        } else {
+            takeover.thread_started = TRUE;
+        }
+    }
+    listeners[0].handoff_fd = open_handoff_socket(config);
+    listeners[0].shm_fd = open_shm_socket(config);
+
+    /* A failed UDP / layer-2 listener leaves TCP service running */
+    if (config->use_udp || config->l2_interface[0] != '\0') {
+        dgram_server = dgram_server_start(config, &address);
+    }
+
+    /* Without its links the node still serves its own clients */
+    if (config->cluster.node_id != 0) {
+        cluster = cluster_start(&config->cluster, &cluster_address,
+                                server_usb_get());
     }
 
     printf("Server listening on %s:%d\n",
            (config->listen_address == NULL) ? "0.0.0.0" : config->listen_address,
            config->listen_port);
+    if (listeners[0].shm_fd >= 0) {
+        printf("Same-host clients also on %s (shared memory)\n",
+               config->shm_path);
+    }
+    if (num_listeners > 1) {
+        printf("%d SO_REUSEPORT listeners, %d workers, backlog %d each\n",
+               num_listeners, num_workers, config->listen_backlog);
+    }
     printf("Press Ctrl+C to shutdown gracefully\n");
 
-    /* Main accept loop */
-    while (!g_server_shutdown) {
-        fd_set readfds;
-        struct timeval timeout;
-        int select_result;
+    /* Listener 0 runs on this thread, the others on their own */
+    for (i = 0; i < num_listeners; i++) {
+        listeners[i].loop = event_loop;
+    }
+    start_listener_threads(listeners, num_listeners, config);
 
-        /* Use select() with timeout to allow signal checking */
-        FD_ZERO(&readfds);
-        FD_SET(server_fd, &readfds);
-        timeout.tv_sec = 1;  /* 1 second timeout */
-        timeout.tv_usec = 0;
+    /* The console comes up once clients are being accepted */
+    start_mgmt_late(config);
 
-        select_result = select(server_fd + 1, &readfds, NULL, NULL, &timeout);
+    /* Main accept loop; also returns when a new process takes over */
+    accept_loop(&listeners[0]);
+    while (listeners[0].upgrade_sock >= 0 && !g_server_shutdown &&
+           !mgmt_restart_is_requested()) {
+        int sock = listeners[0].upgrade_sock;
 
-        if (select_result < 0) {
-            if (g_server_shutdown) break;
-            perror("select");
-            continue;
-        }
+        listeners[0].upgrade_sock = -1;
+        join_listener_threads(listeners, num_listeners);
 
-        if (select_result == 0) {
-            /* Timeout - check shutdown flag and continue */
-            continue;
-        }
+        /* The new process listens on the same path for the next upgrade */
+        handoff_close_listener(listeners[0].handoff_fd, config->handoff_path);
+        listeners[0].handoff_fd = -1;
+        shm_link_close_listener(listeners[0].shm_fd, config->shm_path);
+        listeners[0].shm_fd = -1;
 
-        /* Socket is ready for accept() */
-        client_info = acquire_client_slot();
-        if (client_info == NULL) {
-            fprintf(stderr, "Max clients (%d) reached, rejecting connection\n", MAX_CLIENTS);
-            /* Still need to accept and close to prevent backlog */
-            new_socket = accept(server_fd, (struct sockaddr *)&address,
-                                (socklen_t *)&addrlen);
-            if (new_socket >= 0) {
-                close(new_socket);
-            }
-            continue;
-        }
+        /* Free the UDP port (and the ring) for the new process */
+        dgram_server_stop(dgram_server);
+        dgram_server = NULL;
+        cluster_stop(cluster);
+        cluster = NULL;
 
-        new_socket = accept(server_fd,
-                            (struct sockaddr *)&client_info->client_addr,
-                            (socklen_t *)&addrlen);
-        if (new_socket < 0) {
-            if (g_server_shutdown) {
-                release_client_slot(client_info);
-                break;
-            }
-            perror("accept");
-            release_client_slot(client_info);
-            continue;
+        if (hand_over(config, listeners, num_listeners, event_loop,
+                      sock) == 0) {
+            break;
         }
 
-        /* Check connection rate limit (NET-012 fix) */
-        if (!check_connection_rate_limit(client_info->client_addr.sin_addr.s_addr)) {
-            fprintf(stderr, "Rate limit exceeded for %s, rejecting connection\n",
-                    inet_ntoa(client_info->client_addr.sin_addr));
-            close(new_socket);
-            release_client_slot(client_info);
-            continue;
+        printf("Resuming service\n");
+        if (config->use_udp || config->l2_interface[0] != '\0') {
+            dgram_server = dgram_server_start(config, &address);
+        }
+        if (config->cluster.node_id != 0) {
+            cluster = cluster_start(&config->cluster, &cluster_address,
+                                    server_usb_get());
         }
+        start_mgmt_late(config);
+        listeners[0].handoff_fd = open_handoff_socket(config);
+        listeners[0].shm_fd = open_shm_socket(config);
+        g_accept_stop = 0;
+        accept_wake_reset();
+        start_listener_threads(listeners, num_listeners, config);
+        accept_loop(&listeners[0]);
+    }
+    if (listeners[0].upgrade_sock >= 0) {
+        close(listeners[0].upgrade_sock);  /* Signal raced the upgrade */
+    }
+    mgmt_restart_set_notify(NULL);
+    restart = !g_server_shutdown && mgmt_restart_is_requested();
 
-        client_info->client_socket = new_socket;
+    /* Graceful shutdown initiated */
+    printf(restart ? "\nServer stopping for restart...\n" :
+           "\nServer shutting down gracefully...\n");
 
-        if (pthread_create(&thread_id, NULL, handle_client, (void *)client_info) != 0) {
-            perror("pthread_create failed");
-            close(new_socket);
-            release_client_slot(client_info);
+    /* Other listeners were woken by the signal handler or the restart */
+    join_listener_threads(listeners, num_listeners);
+    handoff_close_listener(listeners[0].handoff_fd, config->handoff_path);
+    shm_link_close_listener(listeners[0].shm_fd, config->shm_path);
+
+    /* Unblock the takeover thread if the old process is still draining */
+    if (takeover.sock >= 0) {
+        shutdown(takeover.sock, SHUT_RDWR);
+        if (takeover.thread_started) {
+            pthread_join(takeover.thread, NULL);
         }
-        pthread_detach(thread_id); /* Detach thread to clean up resources automatically */
+        close(takeover.sock);
     }
 
-    /* Graceful shutdown initiated */
-    printf("\nServer shutting down gracefully...\n");
+    dgram_server_stop(dgram_server);
 
-    /* Cleanup USB server */
-    if (g_usb_server != NULL) {
-        usb_server_cleanup(g_usb_server);
-        g_usb_server = NULL;
+    /* Unhooked before the USB server and the hub's members go */
+    cluster_stop(cluster);
+
+    /* Stop workers and release all connections before the USB server goes */
+    event_loop_cleanup(event_loop);
+    event_loop = NULL;
+
+    /* No loop hands over connections any more */
+    raw_relay_stop_all();
+    server_protocols_cleanup();
+
+    /* Parked serial sessions outlive a restart, not a shutdown */
+    if (!restart) {
+        serial_session_park_flush();
     }
 
+    /* Cleanup USB server */
+    server_usb_cleanup();
+
 #if TLS_ENABLED
     /* Cleanup TLS context on shutdown */
-    if (g_tls_ctx != NULL) {
-        tls_context_cleanup(g_tls_ctx);
-        g_tls_ctx = NULL;
-    }
+    server_tls_ctx_replace(NULL);
 #endif
 
-    close(server_fd);
-    return STATE_CLEANUP;
+    for (i = 0; i < num_listeners; i++) {
+        close(listeners[i].fd);
+    }
+    return restart ? STATE_MODE_STOP : STATE_CLEANUP;
 }
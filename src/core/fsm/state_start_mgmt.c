@@ -11,7 +11,9 @@
  * once after configuration validation and before mode selection.
  *
  * The management server runs independently of the operational mode and
- * survives mode restarts.
+ * survives mode restarts. In server mode it is started by the mode itself
+ * once the listeners accept, so the console never delays the first
+ * client.
  *
  * Parameters:
  *   config - Application configuration
@@ -31,12 +33,19 @@ xoe_state_t state_start_mgmt(xoe_config_t *config) {
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
         }
-        printf("Configuration manager initialized\n");
+        fprintf(stderr, "Configuration manager initialized\n");
     }
 
     /* Check if management port is configured */
     if (config->mgmt_port == 0) {
-        printf("Management interface disabled (port not configured)\n");
+        fprintf(stderr, "Management interface disabled (port not configured)\n");
+        return STATE_MODE_SELECT;
+    }
+
+    /* Server mode starts the interface once its listeners accept (a
+     * server being taken over still holds the port until then) */
+    if (state_mode_is_server(config)) {
+        fprintf(stderr, "Management interface starts with the server\n");
         return STATE_MODE_SELECT;
     }
 
@@ -12,6 +12,7 @@
 #include "core/config.h"
 #include "lib/common/definitions.h"
 #include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_mux.h"
 
 /**
  * state_validate_config - Validate configuration settings
@@ -21,17 +22,39 @@
  *
  * Validates:
  * - Serial mode requires client mode (-s requires -c)
- * - Serial device path is set when serial mode is enabled
+ * - Serial device path is set when serial mode is enabled; every listed
+ *   port inherits the shared serial settings
+ * - --serial-mux is used with serial mode and at most SERIAL_MUX_MAX_PORTS
+ *   devices
+ * - A --udp client is a serial bridge without --serial-mux or --compress
+ * - An --l2 client is a serial bridge without -c, --udp, -e, --serial-mux
+ *   or --compress; only clients name a server MAC
+ * - --bench is used in client mode without -s or -u
+ * - --replay is used in client mode without -s, -u or --bench
+ * - --raw is a plain TCP stdin/stdout client (no -s, -u, -e, --bench,
+ *   --replay, --udp or --l2)
+ * - --handoff-socket and --takeover are only used in server mode
+ * - --cluster-port, --cluster-peer, --cluster-bind and --cluster-secret
+ *   need --cluster-node, which is for servers and needs --cluster-secret;
+ *   the link port defaults to the listen port + 1
+ * - A shm:/unix: server address is unencrypted, TCP only (no -u, --udp),
+ *   and --shm is for servers
+ * - --hub joins one serial port over plain TCP or shm (no -e, --udp,
+ *   --l2 or --serial-mux)
+ * - A -c list of servers shortens keepalive and TCP_USER_TIMEOUT (unless
+ *   --sock-profile system) so a dead server is noticed fast
  * - Port numbers are in valid range
  * - Configuration consistency
  */
 xoe_state_t state_validate_config(xoe_config_t *config) {
     serial_config_t *serial_cfg = (serial_config_t*)config->serial_config;
+    serial_multi_config_t *multi = (serial_multi_config_t*)config->serial_multi;
 
     /* Validate serial mode configuration */
     if (config->use_serial) {
-        if (config->connect_server_ip == NULL) {
-            fprintf(stderr, "Serial mode (-s) requires client mode (-c)\n");
+        if (config->connect_server_ip == NULL &&
+            config->l2_interface[0] == '\0') {
+            fprintf(stderr, "Serial mode (-s) requires client mode (-c or --l2)\n");
             print_usage(config->program_name);
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
@@ -42,11 +65,185 @@ xoe_state_t state_validate_config(xoe_config_t *config) {
             config->exit_code = EXIT_FAILURE;
             return STATE_CLEANUP;
         }
-        /* Set device path in serial config */
-        if (serial_cfg != NULL) {
-            strncpy(serial_cfg->device_path, config->serial_device,
+        /* Complete every port with the shared settings; the first port
+         * also stands for the single-port configuration */
+        if (serial_cfg != NULL && multi != NULL) {
+            serial_multi_config_resolve(multi, serial_cfg);
+            strncpy(serial_cfg->device_path, multi->devices[0].device_path,
                     SERIAL_DEVICE_PATH_MAX - 1);
             serial_cfg->device_path[SERIAL_DEVICE_PATH_MAX - 1] = '\0';
+            serial_cfg->baud_rate = multi->devices[0].baud_rate;
+        }
+        if (config->serial_mux && multi != NULL &&
+            multi->device_count > SERIAL_MUX_MAX_PORTS) {
+            fprintf(stderr, "--serial-mux supports at most %d serial devices\n",
+                    SERIAL_MUX_MAX_PORTS);
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    } else if (config->serial_mux) {
+        fprintf(stderr, "--serial-mux requires serial mode (-s)\n");
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    /* Datagrams carry serial ports one association each, uncompressed */
+    if (config->use_udp && config->connect_server_ip != NULL) {
+        if (!config->use_serial) {
+            fprintf(stderr, "--udp in client mode requires serial mode (-s)\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->serial_mux || config->wire_compress != 0) {
+            fprintf(stderr, "--udp cannot be combined with --serial-mux or --compress\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+
+    /* Layer 2 replaces the server address; frames are not encrypted */
+    if (config->l2_interface[0] != '\0' && config->use_serial) {
+        if (config->connect_server_ip != NULL || config->use_udp) {
+            fprintf(stderr, "--l2 replaces -c and --udp\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->serial_mux || config->wire_compress != 0 ||
+            config->encryption_mode != 0) {
+            fprintf(stderr, "--l2 cannot be combined with --serial-mux, --compress or -e\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    } else if (config->l2_interface[0] != '\0' &&
+               (config->connect_server_ip != NULL ||
+                config->l2_server_mac[0] != 0xff)) {
+        /* A server MAC is unicast, so never starts with 0xff */
+        fprintf(stderr, "--l2 is for servers, and serial clients (-s) without -c\n");
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    /* Same-host links: a stream, unencrypted, not for USB */
+    if (shm_link_address(config->connect_server_ip) != NULL) {
+        if (config->encryption_mode != 0 || config->use_udp ||
+            config->use_usb) {
+            fprintf(stderr, "A shm: server address cannot be combined with -e, --udp or -u\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+    if (config->shm_path[0] != '\0' && config->connect_server_ip != NULL) {
+        fprintf(stderr, "--shm requires server mode\n");
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    /* Hub members are single-port stream bridges without session resume */
+    if (config->hub_topic[0] != '\0') {
+        if (!config->use_serial || config->connect_server_ip == NULL ||
+            (multi != NULL && multi->device_count > 1)) {
+            fprintf(stderr, "--hub requires one serial device (-s) and -c\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->encryption_mode != 0 || config->use_udp ||
+            config->serial_mux) {
+            fprintf(stderr, "--hub cannot be combined with -e, --udp or --serial-mux\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+
+    /* The upgrade handoff is between server processes */
+    if ((config->handoff_path[0] != '\0' || config->takeover_path[0] != '\0') &&
+        config->connect_server_ip != NULL) {
+        fprintf(stderr, "--handoff-socket and --takeover require server mode\n");
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+
+    /* Cluster links are between servers */
+    if (config->cluster.node_id == 0 &&
+        (config->cluster.port != 0 || config->cluster.peer_count > 0 ||
+         config->cluster.bind[0] != '\0' ||
+         config->cluster.secret[0] != '\0')) {
+        fprintf(stderr, "--cluster-port, --cluster-peer, --cluster-bind and "
+                "--cluster-secret require --cluster-node\n");
+        config->exit_code = EXIT_FAILURE;
+        return STATE_CLEANUP;
+    }
+    if (config->cluster.node_id != 0) {
+        if (config->connect_server_ip != NULL || config->use_serial) {
+            fprintf(stderr, "--cluster-node requires server mode\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->cluster.secret[0] == '\0') {
+            fprintf(stderr, "--cluster-node requires --cluster-secret\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->cluster.port == 0) {
+            if (config->listen_port >= 65535) {
+                fprintf(stderr, "Set --cluster-port: listen port %d has no "
+                        "port after it\n", config->listen_port);
+                config->exit_code = EXIT_FAILURE;
+                return STATE_CLEANUP;
+            }
+            config->cluster.port = config->listen_port + 1;
+        }
+    }
+
+    /* With somewhere to fail over to, notice a dead server fast */
+    if (config->servers.count > 1 &&
+        config->sock_tune.profile != SOCK_TUNE_SYSTEM) {
+        server_pool_fast_loss(&config->sock_tune);
+    }
+
+    /* Validate bench client configuration */
+    if (config->bench.connections > 0) {
+        if (config->connect_server_ip == NULL) {
+            fprintf(stderr, "--bench requires client mode (-c)\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->use_serial || config->use_usb) {
+            fprintf(stderr, "--bench cannot be combined with -s or -u\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+
+    /* Validate replay client configuration */
+    if (config->replay.path != NULL) {
+        if (config->connect_server_ip == NULL) {
+            fprintf(stderr, "--replay requires client mode (-c)\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->use_serial || config->use_usb ||
+            config->bench.connections > 0) {
+            fprintf(stderr, "--replay cannot be combined with -s, -u or --bench\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+    }
+
+    /* Raw channels are spliced between plain TCP sockets */
+    if (config->raw_channel[0] != '\0') {
+        if (config->connect_server_ip == NULL) {
+            fprintf(stderr, "--raw requires client mode (-c)\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
+        }
+        if (config->use_serial || config->use_usb ||
+            config->encryption_mode != 0 || config->bench.connections > 0 ||
+            config->replay.path != NULL || config->use_udp ||
+            config->l2_interface[0] != '\0') {
+            fprintf(stderr, "--raw cannot be combined with -s, -u, -e, --bench, "
+                    "--replay, --udp or --l2\n");
+            config->exit_code = EXIT_FAILURE;
+            return STATE_CLEANUP;
         }
     }
 
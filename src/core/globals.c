@@ -16,6 +16,7 @@
 /* Global restart flag for management-triggered mode restarts */
 static volatile sig_atomic_t g_mgmt_restart_requested_internal = 0;
 static pthread_mutex_t g_restart_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void (*g_restart_notify)(void) = NULL;
 
 /* Global config manager for runtime configuration changes */
 struct mgmt_config_manager_t *g_config_manager = NULL;
@@ -24,8 +25,25 @@ struct mgmt_config_manager_t *g_config_manager = NULL;
  * Set the restart request flag (thread-safe)
  */
 void mgmt_restart_request(void) {
+    void (*notify)(void);
+
     pthread_mutex_lock(&g_restart_mutex);
     g_mgmt_restart_requested_internal = 1;
+    notify = g_restart_notify;
+    pthread_mutex_unlock(&g_restart_mutex);
+
+    if (notify != NULL) {
+        notify();
+    }
+}
+
+/**
+ * Set the function that wakes the running mode on a restart request
+ * (NULL to remove it)
+ */
+void mgmt_restart_set_notify(void (*notify)(void)) {
+    pthread_mutex_lock(&g_restart_mutex);
+    g_restart_notify = notify;
     pthread_mutex_unlock(&g_restart_mutex);
 }
 
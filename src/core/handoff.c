@@ -0,0 +1,590 @@
+/**
+ * handoff.c
+ *
+ * Upgrade socket and message encoding for the listener and connection
+ * handoff between an old and a new server process (see handoff.h).
+ *
+ * [LLM-ARCH]
+ */
+
+/* struct ucred (SO_PEERCRED) */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "core/handoff.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+
+/* "XOEH" */
+#define HANDOFF_MAGIC 0x584F4548u
+
+/* Bumped whenever handoff_msg_t changes; old and new binary must agree */
+#define HANDOFF_VERSION 1
+
+/* Message types */
+typedef enum {
+    HANDOFF_MSG_HELLO = 1,          /* New process: ready to take over */
+    HANDOFF_MSG_LISTENERS = 2,      /* Old process: listening sockets */
+    HANDOFF_MSG_CONN = 3,           /* Old process: one connection */
+    HANDOFF_MSG_END = 4             /* Old process: no more connections */
+} handoff_msg_type_t;
+
+/* handoff_msg_t.flags */
+#define HANDOFF_FLAG_KTLS 0x01
+
+/**
+ * handoff_msg_t - Fixed-size record exchanged on the upgrade socket
+ *
+ * Both ends run on the same host, so fields are in host byte order
+ * except the peer address, which stays as accept() returned it.
+ */
+typedef struct {
+    uint32_t magic;                 /* HANDOFF_MAGIC */
+    uint16_t version;               /* HANDOFF_VERSION */
+    uint16_t type;                  /* handoff_msg_type_t */
+    uint32_t fd_count;              /* Descriptors attached */
+    uint32_t wire_features;         /* CONN: XOE_WIRE_FEATURE_* bits */
+    uint32_t flags;                 /* CONN: HANDOFF_FLAG_* */
+    uint32_t addr;                  /* CONN: peer IPv4 address */
+    uint16_t port;                  /* CONN: peer port */
+    uint16_t reserved;
+} handoff_msg_t;
+
+#ifdef MSG_NOSIGNAL
+#define HANDOFF_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define HANDOFF_SEND_FLAGS 0
+#endif
+
+#ifdef MSG_CMSG_CLOEXEC
+#define HANDOFF_RECV_FLAGS MSG_CMSG_CLOEXEC
+#else
+#define HANDOFF_RECV_FLAGS 0
+#endif
+
+/**
+ * set_io_timeout - Bound blocking sends and receives on a descriptor
+ * @fd: Socket
+ * @seconds: Timeout (0 = block indefinitely)
+ */
+static void set_io_timeout(int fd, int seconds) {
+    struct timeval tv;
+
+    tv.tv_sec = seconds;
+    tv.tv_usec = 0;
+    (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/**
+ * fill_address - Build a UNIX socket address
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT if @path does not fit
+ */
+static int fill_address(struct sockaddr_un *addr, const char *path) {
+    if (path == NULL || path[0] == '\0' ||
+        strlen(path) >= sizeof(addr->sun_path) ||
+        strlen(path) >= HANDOFF_PATH_MAX) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+    return 0;
+}
+
+/**
+ * remove_stale_socket - Remove a socket file nobody listens on any more
+ * @addr: Address about to be bound
+ *
+ * Only a socket whose connect() is refused is left over from a process
+ * that did not exit cleanly. A live server, a file that is not a socket
+ * (or a symlink to one) and a socket we may not connect to are left in
+ * place, so the bind() that follows fails instead of taking them over.
+ */
+static void remove_stale_socket(const struct sockaddr_un *addr) {
+    struct stat st;
+    int refused;
+    int fd;
+
+    if (lstat(addr->sun_path, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return;
+    }
+
+    /* Non-blocking: a live server with a full backlog is not waited on */
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return;
+    }
+    (void)fd_set_nonblocking(fd);
+    refused = connect(fd, (const struct sockaddr *)addr,
+                      sizeof(*addr)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+
+    if (refused) {
+        (void)unlink(addr->sun_path);
+    }
+}
+
+/**
+ * peer_is_owner - Check the peer of a UNIX socket runs as our user
+ */
+static int peer_is_owner(int sock) {
+#if defined(__linux__)
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return FALSE;
+    }
+    return cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+
+    if (getpeereid(sock, &uid, &gid) != 0) {
+        return FALSE;
+    }
+    return uid == geteuid();
+#endif
+}
+
+/**
+ * msg_init - Start a record of the given type
+ */
+static void msg_init(handoff_msg_t *msg, handoff_msg_type_t type) {
+    memset(msg, 0, sizeof(*msg));
+    msg->magic = HANDOFF_MAGIC;
+    msg->version = HANDOFF_VERSION;
+    msg->type = (uint16_t)type;
+}
+
+/**
+ * send_msg - Send one record with its descriptors
+ * @sock: Handoff connection
+ * @msg: Record (fd_count set by the caller)
+ * @fds: Descriptors to attach (may be NULL when fd_count is 0)
+ *
+ * Returns: 0 on success, E_NETWORK_ERROR on failure
+ */
+static int send_msg(int sock, const handoff_msg_t *msg, const int *fds) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    } control;
+    const char *data = (const char *)msg;
+    size_t sent = 0;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    ssize_t n;
+
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = (void *)data;
+    iov.iov_len = sizeof(*msg);
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+
+    if (msg->fd_count > 0) {
+        memset(&control, 0, sizeof(control));
+        mh.msg_control = control.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * msg->fd_count);
+        cmsg = CMSG_FIRSTHDR(&mh);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * msg->fd_count);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * msg->fd_count);
+    }
+
+    /* Descriptors travel with the first chunk; the rest is plain data */
+    while (sent < sizeof(*msg)) {
+        n = sendmsg(sock, &mh, HANDOFF_SEND_FLAGS);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return E_NETWORK_ERROR;
+        }
+        sent += (size_t)n;
+        iov.iov_base = (void *)(data + sent);
+        iov.iov_len = sizeof(*msg) - sent;
+        mh.msg_control = NULL;
+        mh.msg_controllen = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * close_fds - Close received descriptors nobody will use
+ */
+static void close_fds(const int *fds, int count) {
+    int i;
+
+    for (i = 0; i < count; i++) {
+        close(fds[i]);
+    }
+}
+
+/**
+ * recv_msg - Receive one record and its descriptors
+ * @sock: Handoff connection
+ * @msg: Receives the record
+ * @fds: Receives the descriptors
+ * @max: Capacity of @fds
+ * @count: Receives the number of descriptors
+ *
+ * Returns: 0 on success, E_NETWORK_ERROR if the peer is gone or timed
+ *          out, E_PROTOCOL_ERROR for a malformed record (descriptors
+ *          are closed then)
+ */
+static int recv_msg(int sock, handoff_msg_t *msg, int *fds, int max,
+                    int *count) {
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_FDS)];
+    } control;
+    char *data = (char *)msg;
+    size_t got = 0;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    int truncated = FALSE;
+    int received;
+    ssize_t n;
+
+    *count = 0;
+
+    while (got < sizeof(*msg)) {
+        memset(&mh, 0, sizeof(mh));
+        iov.iov_base = data + got;
+        iov.iov_len = sizeof(*msg) - got;
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        mh.msg_control = control.buf;
+        mh.msg_controllen = sizeof(control.buf);
+
+        n = recvmsg(sock, &mh, HANDOFF_RECV_FLAGS);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close_fds(fds, *count);
+            *count = 0;
+            return E_NETWORK_ERROR;
+        }
+        got += (size_t)n;
+
+        if (mh.msg_flags & MSG_CTRUNC) {
+            truncated = TRUE;
+        }
+        for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+            int *incoming;
+            int i;
+
+            if (cmsg->cmsg_level != SOL_SOCKET ||
+                cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            incoming = (int *)CMSG_DATA(cmsg);
+            received = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (i = 0; i < received; i++) {
+                if (*count < max) {
+                    fds[(*count)++] = incoming[i];
+                } else {
+                    close(incoming[i]);
+                    truncated = TRUE;
+                }
+            }
+        }
+    }
+
+    if (msg->magic != HANDOFF_MAGIC || msg->version != HANDOFF_VERSION ||
+        truncated || (int)msg->fd_count != *count) {
+        close_fds(fds, *count);
+        *count = 0;
+        return E_PROTOCOL_ERROR;
+    }
+
+    return 0;
+}
+
+/**
+ * handoff_listen - Open the upgrade socket of a running server
+ * @path: Filesystem path
+ *
+ * Returns: Listening descriptor, or negative error code
+ */
+int handoff_listen(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (fill_address(&addr, path) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return E_NETWORK_ERROR;
+    }
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    remove_stale_socket(&addr);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int error = (errno == EACCES) ? E_PERMISSION_DENIED : E_NETWORK_ERROR;
+        close(fd);
+        return error;
+    }
+    /* Before listen(): until then a connect() is refused */
+    if (chmod(path, S_IRUSR | S_IWUSR) != 0 || listen(fd, 1) != 0) {
+        close(fd);
+        (void)unlink(path);
+        return E_NETWORK_ERROR;
+    }
+
+    return fd;
+}
+
+/**
+ * handoff_close_listener - Close the upgrade socket and remove its path
+ * @fd: Descriptor from handoff_listen() (ignored if negative)
+ * @path: Path it was opened on
+ */
+void handoff_close_listener(int fd, const char *path) {
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+    if (path != NULL) {
+        (void)unlink(path);
+    }
+}
+
+/**
+ * handoff_accept - Accept a new process on the upgrade socket
+ * @listen_fd: Descriptor from handoff_listen()
+ *
+ * Returns: Connected descriptor, or negative error code
+ */
+int handoff_accept(int listen_fd) {
+    handoff_msg_t msg;
+    int fds[HANDOFF_MAX_FDS];
+    int count;
+    int sock;
+    int result;
+
+    sock = accept(listen_fd, NULL, NULL);
+    if (sock < 0) {
+        return E_NETWORK_ERROR;
+    }
+    (void)fcntl(sock, F_SETFD, FD_CLOEXEC);
+
+    /* Whoever connects is given every client of this server */
+    if (!peer_is_owner(sock)) {
+        close(sock);
+        return E_PERMISSION_DENIED;
+    }
+    set_io_timeout(sock, HANDOFF_IO_TIMEOUT);
+
+    result = recv_msg(sock, &msg, fds, HANDOFF_MAX_FDS, &count);
+    if (result == 0 && (msg.type != HANDOFF_MSG_HELLO || count != 0)) {
+        close_fds(fds, count);
+        result = E_PROTOCOL_ERROR;
+    }
+    if (result != 0) {
+        close(sock);
+        return result;
+    }
+
+    return sock;
+}
+
+/**
+ * handoff_connect - Ask the server at @path to hand over
+ * @path: Its --handoff-socket path
+ *
+ * Returns: Connected descriptor, or negative error code
+ */
+int handoff_connect(const char *path) {
+    struct sockaddr_un addr;
+    handoff_msg_t msg;
+    int fd;
+
+    if (fill_address(&addr, path) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return E_NETWORK_ERROR;
+    }
+    (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int error = (errno == ENOENT || errno == ECONNREFUSED) ?
+                    E_NOT_FOUND : E_NETWORK_ERROR;
+        close(fd);
+        return error;
+    }
+
+    /* The old process stops accepting and its management interface
+     * before the listeners come back; that takes a few seconds at most */
+    set_io_timeout(fd, HANDOFF_IO_TIMEOUT);
+
+    msg_init(&msg, HANDOFF_MSG_HELLO);
+    if (send_msg(fd, &msg, NULL) != 0) {
+        close(fd);
+        return E_NETWORK_ERROR;
+    }
+
+    return fd;
+}
+
+/**
+ * handoff_send_listeners - Pass the listening sockets
+ * @sock: Handoff connection
+ * @fds: Listening descriptors
+ * @count: Number of descriptors (1..HANDOFF_MAX_FDS)
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_send_listeners(int sock, const int *fds, int count) {
+    handoff_msg_t msg;
+
+    if (sock < 0 || fds == NULL || count < 1 || count > HANDOFF_MAX_FDS) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    msg_init(&msg, HANDOFF_MSG_LISTENERS);
+    msg.fd_count = (uint32_t)count;
+    return send_msg(sock, &msg, fds);
+}
+
+/**
+ * handoff_recv_listeners - Receive the listening sockets
+ * @sock: Handoff connection
+ * @fds: Receives the descriptors
+ * @max: Capacity of @fds
+ * @count: Receives the number of descriptors
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_recv_listeners(int sock, int *fds, int max, int *count) {
+    handoff_msg_t msg;
+    int result;
+
+    if (sock < 0 || fds == NULL || count == NULL || max < 1) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    result = recv_msg(sock, &msg, fds, max, count);
+    if (result != 0) {
+        return result;
+    }
+    if (msg.type != HANDOFF_MSG_LISTENERS || *count == 0) {
+        close_fds(fds, *count);
+        *count = 0;
+        return E_PROTOCOL_ERROR;
+    }
+
+    /* Connections follow at the old process's pace, as they go idle */
+    set_io_timeout(sock, 0);
+    return 0;
+}
+
+/**
+ * handoff_send_conn - Pass one connection
+ * @sock: Handoff connection
+ * @conn: Connection
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_send_conn(int sock, const handoff_conn_t *conn) {
+    handoff_msg_t msg;
+
+    if (sock < 0 || conn == NULL || conn->fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    msg_init(&msg, HANDOFF_MSG_CONN);
+    msg.fd_count = 1;
+    msg.wire_features = conn->wire_features;
+    msg.flags = conn->ktls ? HANDOFF_FLAG_KTLS : 0;
+    msg.addr = (uint32_t)conn->addr.sin_addr.s_addr;
+    msg.port = conn->addr.sin_port;
+    return send_msg(sock, &msg, &conn->fd);
+}
+
+/**
+ * handoff_send_end - Tell the new process no more connections follow
+ * @sock: Handoff connection
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_send_end(int sock) {
+    handoff_msg_t msg;
+
+    if (sock < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    msg_init(&msg, HANDOFF_MSG_END);
+    return send_msg(sock, &msg, NULL);
+}
+
+/**
+ * handoff_recv_conn - Receive the next connection
+ * @sock: Handoff connection
+ * @conn: Receives the connection
+ *
+ * Returns: 1 if @conn was filled in, 0 after the last one, or negative
+ *          error code
+ */
+int handoff_recv_conn(int sock, handoff_conn_t *conn) {
+    handoff_msg_t msg;
+    int fd = -1;
+    int count;
+    int result;
+
+    if (sock < 0 || conn == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    result = recv_msg(sock, &msg, &fd, 1, &count);
+    if (result != 0) {
+        return result;
+    }
+
+    if (msg.type == HANDOFF_MSG_END && count == 0) {
+        return 0;
+    }
+    if (msg.type != HANDOFF_MSG_CONN || count != 1) {
+        close_fds(&fd, count);
+        return E_PROTOCOL_ERROR;
+    }
+
+    memset(conn, 0, sizeof(*conn));
+    conn->fd = fd;
+    conn->addr.sin_family = AF_INET;
+    conn->addr.sin_addr.s_addr = msg.addr;
+    conn->addr.sin_port = msg.port;
+    conn->wire_features = msg.wire_features;
+    conn->ktls = (msg.flags & HANDOFF_FLAG_KTLS) != 0;
+    return 1;
+}
@@ -0,0 +1,155 @@
+/**
+ * handoff.h
+ *
+ * Zero-downtime binary upgrade: a running server hands its listening
+ * sockets and open connections to a new process over a UNIX socket.
+ *
+ * The running server listens on --handoff-socket <path>. A new binary
+ * started with --takeover <path> connects there, and the old process
+ *   1. stops its management interface and its accept threads,
+ *   2. passes every listening socket (SCM_RIGHTS). The kernel queues new
+ *      connections on them throughout, so none is refused,
+ *   3. passes each open connection, with its negotiated wire features,
+ *      as soon as it sits idle between frames,
+ *   4. keeps serving the connections it cannot pass until they close or
+ *      HANDOFF_DRAIN_TIMEOUT expires, then exits.
+ *
+ * Plain TCP connections are passed as they are. A TLS session cannot
+ * leave OpenSSL, so TLS connections are only passed when kernel TLS
+ * carries both directions: the record keys live in the socket, and the
+ * new process reads and writes plaintext on it. Connections with
+ * compression or multiplexed channels, USB registrations, or a frame
+ * half received stay with the old process.
+ *
+ * Messages are fixed-size records over a stream socket; descriptors ride
+ * on the first byte of the record they belong to.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef CORE_HANDOFF_H
+#define CORE_HANDOFF_H
+
+#include "lib/common/types.h"
+
+#include <netinet/in.h>
+
+/* Longest --handoff-socket / --takeover path (sun_path is 104 bytes on
+ * BSD/macOS, 108 on Linux) */
+#define HANDOFF_PATH_MAX 104
+
+/* Most listening sockets passed in one message */
+#define HANDOFF_MAX_FDS 64
+
+/* Seconds the old process keeps serving connections it could not pass */
+#define HANDOFF_DRAIN_TIMEOUT 300
+
+/* Milliseconds between attempts to pass the remaining connections */
+#define HANDOFF_DRAIN_POLL_MS 100
+
+/* Seconds a peer on the handoff socket has to send each message */
+#define HANDOFF_IO_TIMEOUT 5
+
+/**
+ * handoff_conn_t - One connection passed to the new process
+ */
+typedef struct {
+    int fd;                         /* Connected socket */
+    struct sockaddr_in addr;        /* Peer address */
+    uint32_t wire_features;         /* Negotiated XOE_WIRE_FEATURE_* bits */
+    int ktls;                       /* TRUE: kernel TLS carries the records */
+} handoff_conn_t;
+
+/**
+ * handoff_listen - Open the upgrade socket of a running server
+ * @path: Filesystem path (a stale socket file there is replaced)
+ *
+ * A socket file is stale when connecting to it is refused; anything else
+ * at @path makes the call fail. The socket is made accessible to its
+ * owner only (mode 0600).
+ *
+ * Returns: Listening descriptor, or negative error code
+ */
+int handoff_listen(const char *path);
+
+/**
+ * handoff_close_listener - Close the upgrade socket and remove its path
+ * @fd: Descriptor from handoff_listen() (ignored if negative)
+ * @path: Path it was opened on
+ */
+void handoff_close_listener(int fd, const char *path);
+
+/**
+ * handoff_accept - Accept a new process on the upgrade socket
+ * @listen_fd: Descriptor from handoff_listen()
+ *
+ * Waits up to HANDOFF_IO_TIMEOUT for the peer's hello, so a stray
+ * connection never starts an upgrade. The peer must run as the same
+ * user as this process (SO_PEERCRED, getpeereid() on BSD/macOS).
+ *
+ * Returns: Connected descriptor, or negative error code
+ *          (E_PROTOCOL_ERROR for a peer that is not a compatible xoe,
+ *          E_PERMISSION_DENIED for one run by another user)
+ */
+int handoff_accept(int listen_fd);
+
+/**
+ * handoff_connect - Ask the server at @path to hand over
+ * @path: Its --handoff-socket path
+ *
+ * Returns: Connected descriptor, E_NOT_FOUND if no server listens there,
+ *          or another negative error code
+ */
+int handoff_connect(const char *path);
+
+/**
+ * handoff_send_listeners - Pass the listening sockets
+ * @sock: Handoff connection
+ * @fds: Listening descriptors (the caller still closes its copies)
+ * @count: Number of descriptors (1..HANDOFF_MAX_FDS)
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_send_listeners(int sock, const int *fds, int count);
+
+/**
+ * handoff_recv_listeners - Receive the listening sockets
+ * @sock: Handoff connection
+ * @fds: Receives the descriptors
+ * @max: Capacity of @fds
+ * @count: Receives the number of descriptors
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_recv_listeners(int sock, int *fds, int max, int *count);
+
+/**
+ * handoff_send_conn - Pass one connection
+ * @sock: Handoff connection
+ * @conn: Connection (the caller still closes its copy of conn->fd)
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_send_conn(int sock, const handoff_conn_t *conn);
+
+/**
+ * handoff_send_end - Tell the new process no more connections follow
+ * @sock: Handoff connection
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int handoff_send_end(int sock);
+
+/**
+ * handoff_recv_conn - Receive the next connection
+ * @sock: Handoff connection
+ * @conn: Receives the connection
+ *
+ * Blocks until the old process sends one.
+ *
+ * Returns: 1 if @conn was filled in, 0 after the last one, or negative
+ *          error code (the old process is gone or misbehaved)
+ */
+int handoff_recv_conn(int sock, handoff_conn_t *conn);
+
+#endif /* CORE_HANDOFF_H */
@@ -73,6 +73,14 @@ int main(int argc, char *argv[]) {
                 state = state_client_usb(&config);
                 break;
 
+            case STATE_CLIENT_BENCH:
+                state = state_client_bench(&config);
+                break;
+
+            case STATE_CLIENT_REPLAY:
+                state = state_client_replay(&config);
+                break;
+
             case STATE_MODE_STOP:
                 state = state_mode_stop(&config);
                 break;
@@ -2,6 +2,14 @@
 #include "mgmt_config.h"
 #include "core/config.h"
 #include "core/server.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/metrics.h"
+#include "lib/common/stage_prof.h"
+#include "lib/common/thread_sched.h"
+#include "lib/protocol/wire_trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -31,25 +39,36 @@ typedef struct {
 /* Forward declarations */
 static int cmd_help(mgmt_session_t *session, int argc, char **argv);
 static int cmd_show(mgmt_session_t *session, int argc, char **argv);
+static int cmd_stats(mgmt_session_t *session, int argc, char **argv);
+static int cmd_watch(mgmt_session_t *session, int argc, char **argv);
+static int cmd_trace(mgmt_session_t *session, int argc, char **argv);
+static int cmd_profile(mgmt_session_t *session, int argc, char **argv);
 static int cmd_set(mgmt_session_t *session, int argc, char **argv);
 static int cmd_get(mgmt_session_t *session, int argc, char **argv);
 static int cmd_pending(mgmt_session_t *session, int argc, char **argv);
 static int cmd_clear(mgmt_session_t *session, int argc, char **argv);
 static int cmd_validate(mgmt_session_t *session, int argc, char **argv);
 static int cmd_restart(mgmt_session_t *session, int argc, char **argv);
+static int cmd_reload(mgmt_session_t *session, int argc, char **argv);
 static int cmd_quit(mgmt_session_t *session, int argc, char **argv);
 static int cmd_shutdown(mgmt_session_t *session, int argc, char **argv);
+static int parse_int_value(const char *value, long min, long max, int *out);
 
 /* Command dispatch table */
 static const cmd_entry_t commands[] = {
     {"help",     cmd_help,     "Display available commands"},
     {"show",     cmd_show,     "Display status/config/clients"},
+    {"stats",    cmd_stats,    "Display counters and latencies [prometheus]"},
+    {"watch",    cmd_watch,    "Stream changed counters every N seconds [N]"},
+    {"trace",    cmd_trace,    "Display recent frames of a connection [fd]"},
+    {"profile",  cmd_profile,  "Hot-stage profiler [on|off|show]"},
     {"set",      cmd_set,      "Set configuration parameter"},
     {"get",      cmd_get,      "Get configuration parameter"},
     {"pending",  cmd_pending,  "Show pending changes"},
     {"clear",    cmd_clear,    "Clear pending changes"},
     {"validate", cmd_validate, "Validate pending config"},
     {"restart",  cmd_restart,  "Apply changes and restart"},
+    {"reload",   cmd_reload,   "Apply live changes, keep connections"},
     {"quit",     cmd_quit,     "Close session"},
     {"shutdown", cmd_shutdown, "Shutdown application"},
     {NULL, NULL, NULL}
@@ -103,60 +122,37 @@ static int parse_command(char *line, int *argc, char **argv, int max_args) {
     return count;
 }
 
+/* Helper: Open connections, from the lock-free gauge (the server's client
+ * pool count would take its mutex from the management thread) */
+static int active_connections(void) {
+    metrics_snapshot_t snapshot;
+
+    metrics_snapshot(&snapshot);
+    return (int)metrics_gauge(&snapshot, METRIC_CONN_ACTIVE);
+}
+
 /**
- * mgmt_command_loop - Main command processing loop
+ * mgmt_command_line - Run one console command
  */
-void mgmt_command_loop(mgmt_session_t *session) {
-    ssize_t bytes_read;
-    char *newline;
+int mgmt_command_line(mgmt_session_t *session, char *line) {
     int argc;
     char *argv[16];
     int i;
-    int found;
-    const char *prompt = "xoe> ";
-
-    while (1) {
-        send_str(session, prompt);
-
-        /* Read command (using TLS if enabled - FSM-006 fix) */
-        bytes_read = mgmt_read(session, session->read_buffer,
-                              MGMT_BUFFER_SIZE - 1);
-        if (bytes_read <= 0) {
-            break;
-        }
-
-        session->read_buffer[bytes_read] = '\0';
-
-        newline = strchr(session->read_buffer, '\n');
-        if (newline) *newline = '\0';
-        newline = strchr(session->read_buffer, '\r');
-        if (newline) *newline = '\0';
-
-        if (session->read_buffer[0] == '\0') {
-            continue;
-        }
 
-        parse_command(session->read_buffer, &argc, argv, 16);
-        if (argc == 0) {
-            continue;
-        }
-
-        found = 0;
-        for (i = 0; commands[i].name != NULL; i++) {
-            if (strcmp(argv[0], commands[i].name) == 0) {
-                if (commands[i].handler(session, argc, argv) != 0) {
-                    return;
-                }
-                found = 1;
-                break;
-            }
-        }
+    parse_command(line, &argc, argv, 16);
+    if (argc == 0) {
+        return 0;
+    }
 
-        if (!found) {
-            send_fmt(session, "Unknown command: %s (type 'help' for list)\n",
-                    argv[0]);
+    for (i = 0; commands[i].name != NULL; i++) {
+        if (strcmp(argv[0], commands[i].name) == 0) {
+            return commands[i].handler(session, argc, argv);
         }
     }
+
+    send_fmt(session, "Unknown command: %s (type 'help' for list)\n",
+            argv[0]);
+    return 0;
 }
 
 static int cmd_help(mgmt_session_t *session, int argc, char **argv) {
@@ -192,7 +188,7 @@ static int cmd_show(mgmt_session_t *session, int argc, char **argv) {
         send_str(session, "\n");
 
     } else if (strcmp(argv[1], "status") == 0) {
-        int clients = get_active_client_count();
+        int clients = active_connections();
         int has_pending = 0;
 
         if (g_config_manager != NULL) {
@@ -208,7 +204,7 @@ static int cmd_show(mgmt_session_t *session, int argc, char **argv) {
         send_str(session, "\n");
 
     } else if (strcmp(argv[1], "clients") == 0) {
-        int clients = get_active_client_count();
+        int clients = active_connections();
         send_str(session, "\n=== Connected Clients ===\n");
         send_fmt(session, "Active Connections: %d\n", clients);
         send_str(session, "\n");
@@ -220,13 +216,336 @@ static int cmd_show(mgmt_session_t *session, int argc, char **argv) {
     return 0;
 }
 
+/* Helper: Send every metric and latency histogram in Prometheus text format */
+static void send_prometheus(mgmt_session_t *session,
+                            const metrics_snapshot_t *snapshot) {
+    latency_snapshot_t latency;
+    int id;
+    int len;
+
+    for (id = 0; id < (int)METRIC_COUNT; id++) {
+        len = metrics_format_prometheus(snapshot, (metric_id_t)id,
+                                        session->write_buffer,
+                                        MGMT_BUFFER_SIZE);
+        if (len > 0) {
+            mgmt_write(session, session->write_buffer, (size_t)len);
+        }
+    }
+
+    for (id = 0; id < (int)LATENCY_COUNT; id++) {
+        latency_snapshot((latency_id_t)id, &latency);
+        len = latency_format_prometheus(&latency, (latency_id_t)id,
+                                        session->write_buffer,
+                                        MGMT_BUFFER_SIZE);
+        if (len > 0) {
+            mgmt_write(session, session->write_buffer, (size_t)len);
+        }
+    }
+}
+
+/* Helper: Send the latency histograms as a table of microseconds */
+static void send_latency_table(mgmt_session_t *session) {
+    latency_snapshot_t latency;
+    int id;
+
+    send_str(session, "\n=== Latency (us) ===\n");
+    send_fmt(session, "  %-20s %10s %10s %10s %10s %10s\n",
+             "stage", "count", "p50", "p99", "p999", "max");
+    for (id = 0; id < (int)LATENCY_COUNT; id++) {
+        latency_snapshot((latency_id_t)id, &latency);
+        send_fmt(session, "  %-20s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+                 latency_describe((latency_id_t)id)->name,
+                 (unsigned long long)latency.count,
+                 (double)latency_percentile(&latency, 0.5) / 1000.0,
+                 (double)latency_percentile(&latency, 0.99) / 1000.0,
+                 (double)latency_percentile(&latency, 0.999) / 1000.0,
+                 (double)latency.max_ns / 1000.0);
+    }
+}
+
+static int cmd_stats(mgmt_session_t *session, int argc, char **argv) {
+    metrics_snapshot_t snapshot;
+    const metric_desc_t *desc;
+    uint64_t handshakes;
+    int id;
+
+    metrics_snapshot(&snapshot);
+
+    if (argc >= 2 && strcmp(argv[1], "prometheus") == 0) {
+        send_prometheus(session, &snapshot);
+        return 0;
+    }
+    if (argc >= 2) {
+        send_str(session, "Usage: stats [prometheus]\n");
+        return 0;
+    }
+
+    send_str(session, "\n=== Runtime Statistics ===\n");
+    for (id = 0; id < (int)METRIC_COUNT; id++) {
+        desc = metrics_describe((metric_id_t)id);
+        if (desc->type == METRIC_TYPE_GAUGE) {
+            send_fmt(session, "  %-28s %lld\n", desc->name,
+                    (long long)metrics_gauge(&snapshot, (metric_id_t)id));
+        } else {
+            send_fmt(session, "  %-28s %llu\n", desc->name,
+                    (unsigned long long)snapshot.values[id]);
+        }
+    }
+
+    handshakes = snapshot.values[METRIC_TLS_HANDSHAKES];
+    if (handshakes > 0) {
+        send_fmt(session, "  %-28s %llu\n", "tls_handshake_avg_us",
+                (unsigned long long)(snapshot.values[METRIC_TLS_HANDSHAKE_US] /
+                                     handshakes));
+    }
+    send_latency_table(session);
+    send_str(session, "\n");
+
+    return 0;
+}
+
+static int cmd_watch(mgmt_session_t *session, int argc, char **argv) {
+    int seconds = MGMT_WATCH_DEFAULT_SEC;
+
+    if (argc > 2 || (argc == 2 &&
+        parse_int_value(argv[1], 1, MGMT_WATCH_MAX_SEC, &seconds) != 0)) {
+        send_fmt(session, "Usage: watch [seconds] (1-%d, default %d)\n",
+                 MGMT_WATCH_MAX_SEC, MGMT_WATCH_DEFAULT_SEC);
+        return 0;
+    }
+
+    metrics_snapshot(&session->watch_prev);
+    session->watch_start_us = metrics_now_us();
+    session->watch_interval_ms = (unsigned int)seconds * 1000U;
+    session->state = MGMT_STATE_WATCH;
+    send_fmt(session, "Watching every %d s; press Enter to stop\n", seconds);
+
+    return 0;
+}
+
+/**
+ * mgmt_watch_tick - Send one `watch` line
+ */
+void mgmt_watch_tick(mgmt_session_t *session) {
+    metrics_snapshot_t snapshot;
+    const metric_desc_t *desc;
+    uint64_t elapsed_ms;
+    int changed = 0;
+    int id;
+
+    metrics_snapshot(&snapshot);
+    /* Rounded to a tenth: the session timers run on whole milliseconds,
+     * so the tick due at 1 s may come at 999.x ms */
+    elapsed_ms = (metrics_now_us() - session->watch_start_us + 50000) / 1000;
+    send_fmt(session, "[%llu.%llus]",
+             (unsigned long long)(elapsed_ms / 1000),
+             (unsigned long long)(elapsed_ms % 1000 / 100));
+
+    for (id = 0; id < (int)METRIC_COUNT; id++) {
+        if (snapshot.values[id] == session->watch_prev.values[id]) {
+            continue;
+        }
+        desc = metrics_describe((metric_id_t)id);
+        if (desc->type == METRIC_TYPE_GAUGE) {
+            send_fmt(session, " %s=%lld", desc->name,
+                     (long long)metrics_gauge(&snapshot, (metric_id_t)id));
+        } else {
+            send_fmt(session, " %s+%llu", desc->name,
+                     (unsigned long long)(snapshot.values[id] -
+                                          session->watch_prev.values[id]));
+        }
+        changed++;
+    }
+    send_str(session, changed > 0 ? "\n" : " no change\n");
+
+    session->watch_prev = snapshot;
+}
+
+/* Helper: List the sockets that have a wire trace */
+static void send_trace_list(mgmt_session_t *session) {
+    int fds[XOE_WIRE_TRACE_MAX_FDS];
+    int count;
+    int i;
+
+    count = xoe_wire_trace_active(fds, XOE_WIRE_TRACE_MAX_FDS);
+    if (count == 0) {
+        send_str(session, "No connections traced\n");
+        return;
+    }
+
+    send_str(session, "Traced sockets:");
+    for (i = 0; i < count; i++) {
+        send_fmt(session, "%s %d", (i > 0 && i % 16 == 0) ? "\n " : "",
+                 fds[i]);
+    }
+    send_str(session, "\nUse: trace <fd>\n");
+}
+
+static int cmd_trace(mgmt_session_t *session, int argc, char **argv) {
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+    char line[XOE_WIRE_TRACE_LINE_MAX];
+    uint64_t now;
+    char *end;
+    long fd;
+    int count;
+    int i;
+
+    if (argc < 2) {
+        send_trace_list(session);
+        return 0;
+    }
+
+    errno = 0;
+    fd = strtol(argv[1], &end, 10);
+    if (errno != 0 || *end != '\0' || fd < 0 ||
+        fd >= XOE_WIRE_TRACE_MAX_FDS) {
+        send_str(session, "Usage: trace [fd]\n");
+        return 0;
+    }
+
+    count = xoe_wire_trace_snapshot((int)fd, entries, XOE_WIRE_TRACE_DEPTH);
+    if (count == 0) {
+        send_fmt(session, "No frames traced on fd %ld\n", fd);
+        return 0;
+    }
+
+    now = xoe_wire_trace_now_ns();
+    send_fmt(session, "\n=== Wire Trace fd %ld (last %d frames) ===\n",
+             fd, count);
+    for (i = 0; i < count; i++) {
+        if (xoe_wire_trace_format(&entries[i], now, line, sizeof(line)) > 0) {
+            send_fmt(session, "  %s\n", line);
+        }
+    }
+    send_str(session, "\n");
+
+    return 0;
+}
+
+/* Helper: Send the stage profiler totals */
+static void send_profile_table(mgmt_session_t *session) {
+    stage_prof_snapshot_t snapshot;
+    const stage_totals_t *stage;
+    int id;
+
+    stage_prof_snapshot(&snapshot);
+    send_fmt(session, "\n=== Stage Profile (%s, %s, %.1f s) ===\n",
+             snapshot.running ? "running" : "stopped", stage_prof_clock(),
+             (double)snapshot.elapsed_ns / 1e9);
+    send_fmt(session, "  %-16s %12s %10s %10s %12s %8s\n",
+             "stage", "count", "avg_ns", "max_us", "total_ms", "threads");
+    for (id = 0; id < (int)STAGE_COUNT; id++) {
+        stage = &snapshot.stages[id];
+        send_fmt(session, "  %-16s %12llu %10llu %10.1f %12.1f %8d\n",
+                 stage_prof_describe((stage_id_t)id)->name,
+                 (unsigned long long)stage->count,
+                 (unsigned long long)(stage->count > 0 ?
+                                      stage->sum_ns / stage->count : 0),
+                 (double)stage->max_ns / 1000.0,
+                 (double)stage->sum_ns / 1e6,
+                 stage->threads);
+    }
+    send_str(session, "\n");
+}
+
+static int cmd_profile(mgmt_session_t *session, int argc, char **argv) {
+    int was_running;
+    int on;
+
+    if (argc < 2 || strcmp(argv[1], "show") == 0) {
+        send_profile_table(session);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "on") == 0 || strcmp(argv[1], "off") == 0) {
+        on = (strcmp(argv[1], "on") == 0);
+        was_running = stage_prof_running();
+        if (stage_prof_enable(on) != 0) {
+            send_str(session, "Profiler not built in (XOE_STAGE_PROFILE=0)\n");
+            return 0;
+        }
+        send_fmt(session, "Stage profiling %s%s\n", on ? "on" : "off",
+                 (on && !was_running) ? " (totals cleared)" : "");
+        return 0;
+    }
+
+    send_str(session, "Usage: profile [on|off|show]\n");
+    return 0;
+}
+
+/**
+ * mgmt_serve_metrics_http - Answer one HTTP request with the metrics
+ */
+void mgmt_serve_metrics_http(mgmt_session_t *session) {
+    metrics_snapshot_t snapshot;
+
+    if (strncmp(session->read_buffer, "GET /metrics ", 13) != 0 &&
+        strncmp(session->read_buffer, "GET /metrics\r", 13) != 0) {
+        send_str(session, "HTTP/1.0 404 Not Found\r\n"
+                          "Content-Type: text/plain\r\n"
+                          "Connection: close\r\n\r\n"
+                          "Only /metrics is served here\n");
+        return;
+    }
+
+    /* HTTP/1.0 without Content-Length: the body ends when we close */
+    send_str(session, "HTTP/1.0 200 OK\r\n"
+                      "Content-Type: text/plain; version=0.0.4\r\n"
+                      "Connection: close\r\n\r\n");
+    metrics_snapshot(&snapshot);
+    send_prometheus(session, &snapshot);
+}
+
+/* Parse a decimal integer in [min, max]; returns 0 on success */
+static int parse_int_value(const char *value, long min, long max, int *out) {
+    char *endptr;
+    long parsed;
+
+    errno = 0;
+    parsed = strtol(value, &endptr, 10);
+    if (errno == ERANGE || endptr == value || *endptr != '\0' ||
+        parsed < min || parsed > max) {
+        return -1;
+    }
+    *out = (int)parsed;
+    return 0;
+}
+
+/* Parse "default" or a comma-separated list of USB class codes */
+static int parse_usb_classes(const char *value, uint8_t *classes, int *count) {
+    const char *p = value;
+    char *endptr;
+    unsigned long code;
+
+    *count = 0;
+    if (strcmp(value, "default") == 0) {
+        return 0;
+    }
+    while (*p != '\0') {
+        errno = 0;
+        code = strtoul(p, &endptr, 0);
+        if (errno == ERANGE || endptr == p || code > 0xFF ||
+            *count >= MAX_USB_CLASSES ||
+            (*endptr != ',' && *endptr != '\0')) {
+            return -1;
+        }
+        classes[(*count)++] = (uint8_t)code;
+        p = (*endptr == ',') ? endptr + 1 : endptr;
+    }
+    return (*count > 0) ? 0 : -1;
+}
+
 static int cmd_set(mgmt_session_t *session, int argc, char **argv) {
     const char *param;
     const char *value;
+    int number;
 
     if (argc < 3) {
         send_str(session, "Usage: set <parameter> <value>\n");
-        send_str(session, "Parameters: mode, port, listen_addr\n");
+        send_str(session, "Restart: mode, port\n");
+        send_str(session, "Live (reload): cert, key, conn_rate, log_level, "
+                 "rcvbuf, sndbuf, usb_classes, sched, mem_budget, "
+                 "conn_mem\n");
         return 0;
     }
 
@@ -263,6 +582,90 @@ static int cmd_set(mgmt_session_t *session, int argc, char **argv) {
         mgmt_config_set_listen_port(g_config_manager, (int)port);
         send_fmt(session, "Pending: port = %ld\n", port);
 
+    } else if (strcmp(param, "cert") == 0 || strcmp(param, "key") == 0) {
+        int result = (param[0] == 'c')
+                     ? mgmt_config_set_tls_cert(g_config_manager, value)
+                     : mgmt_config_set_tls_key(g_config_manager, value);
+        if (result != 0) {
+            send_fmt(session, "Invalid path (at most %d characters)\n",
+                     TLS_CERT_PATH_MAX - 1);
+            return 0;
+        }
+        send_fmt(session, "Pending: %s = %s\n", param, value);
+
+    } else if (strcmp(param, "conn_rate") == 0) {
+        if (parse_int_value(value, 0, MAX_CONN_RATE, &number) != 0) {
+            send_fmt(session, "Invalid rate (0-%d, 0 = unlimited)\n",
+                     MAX_CONN_RATE);
+            return 0;
+        }
+        mgmt_config_set_conn_rate(g_config_manager, number);
+        send_fmt(session, "Pending: conn_rate = %d\n", number);
+
+    } else if (strcmp(param, "log_level") == 0) {
+        log_level_t level;
+        if (log_parse_level(value, &level) != 0) {
+            send_str(session, "Invalid level (error, warn, info, debug)\n");
+            return 0;
+        }
+        mgmt_config_set_log_level(g_config_manager, (int)level);
+        send_fmt(session, "Pending: log_level = %s\n", value);
+
+    } else if (strcmp(param, "rcvbuf") == 0 || strcmp(param, "sndbuf") == 0) {
+        if (parse_int_value(value, 0, SOCK_TUNE_MAX_BUFFER, &number) != 0) {
+            send_fmt(session, "Invalid size (0-%d bytes, 0 = system default)\n",
+                     SOCK_TUNE_MAX_BUFFER);
+            return 0;
+        }
+        if (param[0] == 'r') {
+            mgmt_config_set_rcvbuf(g_config_manager, number);
+        } else {
+            mgmt_config_set_sndbuf(g_config_manager, number);
+        }
+        send_fmt(session, "Pending: %s = %d\n", param, number);
+
+    } else if (strcmp(param, "usb_classes") == 0) {
+        uint8_t classes[MAX_USB_CLASSES];
+        int count;
+        if (parse_usb_classes(value, classes, &count) != 0) {
+            send_fmt(session, "Invalid class list (\"default\" or up to %d "
+                     "codes, e.g. 0x08,0x02)\n", MAX_USB_CLASSES);
+            return 0;
+        }
+        mgmt_config_set_usb_classes(g_config_manager, classes, count);
+        send_fmt(session, "Pending: usb_classes = %s\n", value);
+
+    } else if (strcmp(param, "sched") == 0) {
+        thread_class_t cls;
+        thread_sched_class_t entry;
+        if (thread_sched_parse(value, &cls, &entry) != 0) {
+            send_fmt(session, "Invalid scheduling (<class>:<cpus>[:fifo|rr"
+                     "[:<priority>]], class serial, usb or net, cpus a list "
+                     "or any, priority %d-%d)\n", THREAD_SCHED_MIN_PRIO,
+                     THREAD_SCHED_MAX_PRIO);
+            return 0;
+        }
+        mgmt_config_set_thread_sched(g_config_manager, cls, &entry);
+        send_fmt(session, "Pending: sched = %s\n", value);
+
+    } else if (strcmp(param, "mem_budget") == 0) {
+        if (parse_int_value(value, 0, MEM_BUDGET_MAX_MB, &number) != 0) {
+            send_fmt(session, "Invalid budget (0-%d MiB, 0 = unlimited)\n",
+                     MEM_BUDGET_MAX_MB);
+            return 0;
+        }
+        mgmt_config_set_mem_budget(g_config_manager, number);
+        send_fmt(session, "Pending: mem_budget = %d MiB\n", number);
+
+    } else if (strcmp(param, "conn_mem") == 0) {
+        if (parse_int_value(value, 0, MEM_BUDGET_MAX_CONN_KB, &number) != 0) {
+            send_fmt(session, "Invalid limit (0-%d KiB, 0 = unlimited)\n",
+                     MEM_BUDGET_MAX_CONN_KB);
+            return 0;
+        }
+        mgmt_config_set_conn_mem(g_config_manager, number);
+        send_fmt(session, "Pending: conn_mem = %d KiB\n", number);
+
     } else {
         send_fmt(session, "Unknown parameter: %s\n", param);
     }
@@ -294,6 +697,43 @@ static int cmd_get(mgmt_session_t *session, int argc, char **argv) {
         int port = mgmt_config_get_listen_port(g_config_manager);
         send_fmt(session, "port: %d\n", port);
 
+    } else if (strcmp(param, "sched") == 0) {
+        thread_sched_t sched;
+        char text[THREAD_SCHED_FORMAT_MAX];
+
+        thread_sched_get(&sched);
+        thread_sched_format(&sched, text, sizeof(text));
+        send_fmt(session, "sched: %s%s\n", text,
+                 thread_sched_memory_locked() ? " (memory locked)" : "");
+
+    } else if (strcmp(param, "mem_budget") == 0 ||
+               strcmp(param, "conn_mem") == 0) {
+        send_fmt(session, "mem_budget: %zu KiB used, %zu KiB peak, "
+                 "limit %zu KiB, per connection %zu KiB (0 = unlimited)\n",
+                 mem_budget_used() / 1024, mem_budget_peak() / 1024,
+                 mem_budget_limit() / 1024, mem_budget_conn_limit() / 1024);
+
+    } else if (strcmp(param, "cert") == 0 || strcmp(param, "key") == 0 ||
+               strcmp(param, "conn_rate") == 0 ||
+               strcmp(param, "rcvbuf") == 0 || strcmp(param, "sndbuf") == 0) {
+        mgmt_config_snapshot_t *snapshot;
+        const xoe_config_t *active;
+
+        snapshot = mgmt_config_snapshot_acquire(g_config_manager);
+        active = &snapshot->config;
+        if (strcmp(param, "cert") == 0) {
+            send_fmt(session, "cert: %s\n", active->cert_path);
+        } else if (strcmp(param, "key") == 0) {
+            send_fmt(session, "key: %s\n", active->key_path);
+        } else if (strcmp(param, "conn_rate") == 0) {
+            send_fmt(session, "conn_rate: %d\n", active->conn_rate);
+        } else if (strcmp(param, "rcvbuf") == 0) {
+            send_fmt(session, "rcvbuf: %d\n", active->sock_tune.rcvbuf);
+        } else {
+            send_fmt(session, "sndbuf: %d\n", active->sock_tune.sndbuf);
+        }
+        mgmt_config_snapshot_release(snapshot);
+
     } else {
         send_fmt(session, "Unknown parameter: %s\n", param);
     }
@@ -402,6 +842,59 @@ static int cmd_restart(mgmt_session_t *session, int argc, char **argv) {
     return 0;
 }
 
+static int cmd_reload(mgmt_session_t *session, int argc, char **argv) {
+    char error_buf[256];
+    mgmt_config_snapshot_t *snapshot;
+    int result;
+
+    (void)argc;
+    (void)argv;
+
+    if (g_config_manager == NULL) {
+        send_str(session, "Error: Config manager not initialized\n");
+        return 0;
+    }
+
+    if (!mgmt_config_has_pending(g_config_manager)) {
+        send_str(session, "No pending changes - nothing to apply\n");
+        return 0;
+    }
+
+    if (mgmt_config_pending_needs_restart(g_config_manager, error_buf,
+                                          sizeof(error_buf))) {
+        send_fmt(session, "Cannot reload - %s change needs 'restart'\n",
+                 error_buf);
+        return 0;
+    }
+
+    result = mgmt_config_validate_pending(g_config_manager, error_buf, sizeof(error_buf));
+    if (result != 0) {
+        send_fmt(session, "Cannot reload - validation failed: %s\n", error_buf);
+        return 0;
+    }
+
+    if (mgmt_config_apply_pending(g_config_manager) != 0) {
+        send_str(session, "Error: Failed to apply pending configuration\n");
+        return 0;
+    }
+
+    snapshot = mgmt_config_snapshot_acquire(g_config_manager);
+    result = server_apply_live_config(&snapshot->config);
+    mgmt_config_snapshot_release(snapshot);
+
+    if (result == E_TLS_HANDSHAKE_FAILED) {
+        send_str(session, "Applied, but the certificate could not be loaded; "
+                 "the previous one stays in use\n");
+    } else if (result != 0) {
+        send_fmt(session, "Applied with errors (code %d)\n", result);
+    } else {
+        send_fmt(session, "Applied live; %d open connection(s) kept\n",
+                 active_connections());
+    }
+
+    return 0;
+}
+
 static int cmd_quit(mgmt_session_t *session, int argc, char **argv) {
     (void)argc;
     (void)argv;
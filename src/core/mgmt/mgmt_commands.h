@@ -7,20 +7,50 @@
  * Management Command Handlers
  *
  * Implements all CLI commands for runtime configuration and control.
- * Uses session's pre-allocated buffers for all I/O.
+ * Runs on the management server's event loop thread, so no handler may
+ * block; output goes through the session's pre-allocated buffers.
  */
 
 /**
- * mgmt_command_loop - Main command processing loop
+ * mgmt_command_line - Run one console command
  *
- * Reads commands from session socket, parses, and dispatches to handlers.
- * Continues until 'quit' command or connection close.
+ * Parses the line and dispatches it to its handler, whose output is
+ * queued with mgmt_write(). `watch` moves the session to
+ * MGMT_STATE_WATCH; the server then calls mgmt_watch_tick() every
+ * watch_interval_ms until the next input line.
  *
  * Parameters:
- *   session - Management session (contains socket, buffers, auth status)
+ *   session - Authenticated management session
+ *   line    - Command line without its line ending (modified in place)
  *
- * Uses session's pre-allocated read_buffer and write_buffer for all I/O.
+ * Returns:
+ *   0 to keep the session open, nonzero to close it ('quit')
  */
-void mgmt_command_loop(mgmt_session_t *session);
+int mgmt_command_line(mgmt_session_t *session, char *line);
+
+/**
+ * mgmt_watch_tick - Send one `watch` line
+ *
+ * Reports each metric that changed since the previous tick: counters as
+ * the increase, gauges as their new value. Reads only the lock-free
+ * metrics shards.
+ *
+ * Parameters:
+ *   session - Session in MGMT_STATE_WATCH
+ */
+void mgmt_watch_tick(mgmt_session_t *session);
+
+/**
+ * mgmt_serve_metrics_http - Answer one HTTP request with the metrics
+ *
+ * "GET /metrics" gets every metric in the Prometheus text format,
+ * anything else a 404. The caller closes the session once the response
+ * is sent, which ends the HTTP/1.0 response body.
+ *
+ * Parameters:
+ *   session - Management session whose read_buffer holds the request
+ *             head, NUL-terminated
+ */
+void mgmt_serve_metrics_http(mgmt_session_t *session);
 
 #endif /* CORE_MGMT_COMMANDS_H */
@@ -1,15 +1,27 @@
 #include "mgmt_config.h"
 #include "lib/common/definitions.h"
+#include "lib/common/log.h"
+#include "connectors/serial/serial_config.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sched.h>
 
 /**
  * Configuration Manager Implementation
  *
  * Provides thread-safe dual-configuration management for runtime
  * reconfiguration of XOE application.
+ *
+ * Snapshot reclamation: a reader loads mgr->current and then takes a
+ * reference, so the publisher must not drop the manager's reference on
+ * the old snapshot while a reader may sit between those two steps.
+ * Readers count themselves in mgr->acquiring around the two steps; after
+ * swapping mgr->current the publisher waits for that count to reach zero
+ * before releasing the old snapshot. Any reader starting later sees the
+ * new pointer. The wait is a few instructions long and only happens on
+ * apply, never on the read path.
  */
 
 /* Helper function to copy string (handles NULL) */
@@ -39,61 +51,94 @@ static void free_string(char **str) {
 /**
  * Deep copy configuration structure
  *
- * Copies all fields from src to dst, including dynamic strings.
- * Does NOT copy opaque pointers (serial_config, usb_config).
+ * Copies all fields from src to dst, duplicating the dynamic strings the
+ * copy owns (listen_address, connect_server_ip, serial_device,
+ * program_name). Opaque pointers (serial_config, usb_config, ...) and
+ * mgmt_password are shared, not copied; their owners manage them.
  */
 static int copy_config(xoe_config_t *dst, const xoe_config_t *src) {
-    /* Copy simple fields */
-    dst->mode = src->mode;
-    dst->listen_port = src->listen_port;
-    dst->connect_server_port = src->connect_server_port;
-    dst->encryption_mode = src->encryption_mode;
-    dst->use_serial = src->use_serial;
-    dst->use_usb = src->use_usb;
-    dst->exit_code = src->exit_code;
-    dst->server_fd = src->server_fd;
-
-    /* Copy string fields with rollback on allocation failure */
-    free_string(&dst->listen_address);
-    dst->listen_address = copy_string(src->listen_address);
-    if (src->listen_address != NULL && dst->listen_address == NULL) {
-        return E_OUT_OF_MEMORY;
-    }
+    char *listen_address = NULL;
+    char *connect_server_ip = NULL;
+    char *serial_device = NULL;
+    char *program_name = NULL;
 
-    free_string(&dst->connect_server_ip);
-    dst->connect_server_ip = copy_string(src->connect_server_ip);
-    if (src->connect_server_ip != NULL && dst->connect_server_ip == NULL) {
-        free_string(&dst->listen_address);
-        return E_OUT_OF_MEMORY;
-    }
+    /* Duplicate strings first so a failure leaves dst without them */
+    listen_address = copy_string(src->listen_address);
+    connect_server_ip = copy_string(src->connect_server_ip);
+    serial_device = copy_string(src->serial_device);
+    program_name = copy_string(src->program_name);
 
+    free_string(&dst->listen_address);
+    free_string(&dst->connect_server_ip);
     free_string(&dst->serial_device);
-    dst->serial_device = copy_string(src->serial_device);
-    if (src->serial_device != NULL && dst->serial_device == NULL) {
-        free_string(&dst->listen_address);
-        free_string(&dst->connect_server_ip);
+    free_string(&dst->program_name);
+
+    if ((src->listen_address != NULL && listen_address == NULL) ||
+        (src->connect_server_ip != NULL && connect_server_ip == NULL) ||
+        (src->serial_device != NULL && serial_device == NULL) ||
+        (src->program_name != NULL && program_name == NULL)) {
+        free_string(&listen_address);
+        free_string(&connect_server_ip);
+        free_string(&serial_device);
+        free_string(&program_name);
         return E_OUT_OF_MEMORY;
     }
 
-    free_string(&dst->program_name);
-    dst->program_name = copy_string(src->program_name);
-    if (src->program_name != NULL && dst->program_name == NULL) {
-        free_string(&dst->listen_address);
-        free_string(&dst->connect_server_ip);
-        free_string(&dst->serial_device);
-        return E_OUT_OF_MEMORY;
+    /* Copy every other field (fixed-size arrays included) */
+    *dst = *src;
+    dst->listen_address = listen_address;
+    dst->connect_server_ip = connect_server_ip;
+    dst->serial_device = serial_device;
+    dst->program_name = program_name;
+
+    return 0;
+}
+
+/* Free the strings a deep copy owns */
+static void free_config_strings(xoe_config_t *config) {
+    free_string(&config->listen_address);
+    free_string(&config->connect_server_ip);
+    free_string(&config->serial_device);
+    free_string(&config->program_name);
+}
+
+/**
+ * Create an unpublished snapshot of a configuration (one reference)
+ */
+static mgmt_config_snapshot_t* snapshot_create(const xoe_config_t *src) {
+    mgmt_config_snapshot_t *snapshot;
+
+    snapshot = (mgmt_config_snapshot_t*)calloc(1, sizeof(*snapshot));
+    if (snapshot == NULL) {
+        return NULL;
+    }
+    if (copy_config(&snapshot->config, src) != 0) {
+        free(snapshot);
+        return NULL;
     }
+    snapshot->refs = 1;
+    return snapshot;
+}
 
-    /* Copy fixed-size arrays */
-    memcpy(dst->cert_path, src->cert_path, TLS_CERT_PATH_MAX);
-    memcpy(dst->key_path, src->key_path, TLS_CERT_PATH_MAX);
+/**
+ * Publish a snapshot as current, handing over its reference
+ *
+ * Caller holds mgr->mutex (one publisher at a time).
+ */
+static void snapshot_publish(mgmt_config_manager_t *mgr,
+                             mgmt_config_snapshot_t *snapshot) {
+    mgmt_config_snapshot_t *old;
 
-    /* Note: Opaque pointers (serial_config, usb_config) are NOT copied.
-     * These must be managed separately by their respective modules. */
-    dst->serial_config = src->serial_config;
-    dst->usb_config = src->usb_config;
+    old = mgr->current;
+    snapshot->generation = mgr->generation + 1;
+    __atomic_store_n(&mgr->current, snapshot, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&mgr->generation, snapshot->generation, __ATOMIC_RELEASE);
 
-    return 0;
+    /* Let readers that loaded the old pointer take their reference */
+    while (__atomic_load_n(&mgr->acquiring, __ATOMIC_SEQ_CST) != 0) {
+        sched_yield();
+    }
+    mgmt_config_snapshot_release(old);
 }
 
 /**
@@ -138,10 +183,20 @@ mgmt_config_manager_t* mgmt_config_init(const xoe_config_t *initial_config) {
     }
 
     mgr->has_pending = 0;
+    mgr->acquiring = 0;
+    mgr->generation = 1;
+    mgr->current = snapshot_create(initial_config);
+    if (mgr->current != NULL) {
+        mgr->current->generation = 1;
+    }
 
     /* Initialize mutex */
     mutex_result = pthread_mutex_init(&mgr->mutex, NULL);
-    if (mutex_result != 0) {
+    if (mutex_result != 0 || mgr->current == NULL) {
+        if (mutex_result == 0) {
+            pthread_mutex_destroy(&mgr->mutex);
+        }
+        mgmt_config_snapshot_release(mgr->current);
         free_string(&mgr->active.listen_address);
         free_string(&mgr->active.connect_server_ip);
         free_string(&mgr->active.serial_device);
@@ -168,6 +223,10 @@ void mgmt_config_destroy(mgmt_config_manager_t *mgr) {
     /* Destroy mutex */
     pthread_mutex_destroy(&mgr->mutex);
 
+    /* Drop the manager's reference; pinned snapshots outlive it */
+    mgmt_config_snapshot_release(mgr->current);
+    mgr->current = NULL;
+
     /* Free active config strings */
     free_string(&mgr->active.listen_address);
     free_string(&mgr->active.connect_server_ip);
@@ -205,18 +264,31 @@ int mgmt_config_has_pending(mgmt_config_manager_t *mgr) {
  * Apply pending configuration
  */
 int mgmt_config_apply_pending(mgmt_config_manager_t *mgr) {
+    mgmt_config_snapshot_t *snapshot;
+
     if (mgr == NULL) {
         return -1;
     }
 
     pthread_mutex_lock(&mgr->mutex);
 
+    /* Build the snapshot first so a failure leaves active untouched */
+    snapshot = snapshot_create(&mgr->pending);
+    if (snapshot == NULL) {
+        pthread_mutex_unlock(&mgr->mutex);
+        return -1;
+    }
+
     /* Copy pending to active */
     if (copy_config(&mgr->active, &mgr->pending) != 0) {
         pthread_mutex_unlock(&mgr->mutex);
+        mgmt_config_snapshot_release(snapshot);
         return -1;
     }
 
+    /* Readers switch over with their next load */
+    snapshot_publish(mgr, snapshot);
+
     /* Clear pending flag */
     mgr->has_pending = 0;
 
@@ -251,6 +323,52 @@ void mgmt_config_clear_pending(mgmt_config_manager_t *mgr) {
     pthread_mutex_unlock(&mgr->mutex);
 }
 
+/* Compare two optional strings */
+static int strings_differ(const char *a, const char *b) {
+    if (a == NULL || b == NULL) {
+        return a != b;
+    }
+    return strcmp(a, b) != 0;
+}
+
+/**
+ * Check whether pending changes need a mode restart
+ */
+int mgmt_config_pending_needs_restart(mgmt_config_manager_t *mgr,
+                                      char *what_buf, size_t what_buf_size) {
+    const char *what = NULL;
+
+    if (mgr == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    if (mgr->pending.mode != mgr->active.mode) {
+        what = "mode";
+    } else if (mgr->pending.listen_port != mgr->active.listen_port) {
+        what = "port";
+    } else if (strings_differ(mgr->pending.listen_address,
+                              mgr->active.listen_address)) {
+        what = "listen address";
+    } else if (mgr->pending.connect_server_port !=
+               mgr->active.connect_server_port ||
+               strings_differ(mgr->pending.connect_server_ip,
+                              mgr->active.connect_server_ip)) {
+        what = "connect address";
+    } else if (mgr->pending.encryption_mode != mgr->active.encryption_mode) {
+        what = "encryption";
+    } else if (strings_differ(mgr->pending.serial_device,
+                              mgr->active.serial_device)) {
+        what = "serial device";
+    }
+    pthread_mutex_unlock(&mgr->mutex);
+
+    if (what != NULL && what_buf != NULL && what_buf_size > 0) {
+        snprintf(what_buf, what_buf_size, "%s", what);
+    }
+    return what != NULL;
+}
+
 /**
  * Validate pending configuration
  */
@@ -400,18 +518,76 @@ int mgmt_config_validate_pending(mgmt_config_manager_t *mgr,
     return 0;
 }
 
+/* Configuration Snapshots (lock-free reads of active configuration) */
+
+mgmt_config_snapshot_t* mgmt_config_snapshot_acquire(mgmt_config_manager_t *mgr) {
+    mgmt_config_snapshot_t *snapshot;
+
+    if (mgr == NULL) {
+        return NULL;
+    }
+
+    __atomic_fetch_add(&mgr->acquiring, 1, __ATOMIC_SEQ_CST);
+    snapshot = __atomic_load_n(&mgr->current, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&snapshot->refs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_sub(&mgr->acquiring, 1, __ATOMIC_RELEASE);
+
+    return snapshot;
+}
+
+void mgmt_config_snapshot_release(mgmt_config_snapshot_t *snapshot) {
+    if (snapshot == NULL) {
+        return;
+    }
+
+    if (__atomic_sub_fetch(&snapshot->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free_config_strings(&snapshot->config);
+        free(snapshot);
+    }
+}
+
+const xoe_config_t* mgmt_config_read(mgmt_config_manager_t *mgr,
+                                     mgmt_config_reader_t *reader) {
+    if (mgr == NULL || reader == NULL) {
+        return NULL;
+    }
+
+    /* Fast path: nothing applied since this reader last pinned */
+    if (reader->snapshot != NULL &&
+        __atomic_load_n(&mgr->generation, __ATOMIC_ACQUIRE) ==
+        reader->generation) {
+        return &reader->snapshot->config;
+    }
+
+    mgmt_config_snapshot_release(reader->snapshot);
+    reader->snapshot = mgmt_config_snapshot_acquire(mgr);
+    reader->generation = reader->snapshot->generation;
+    return &reader->snapshot->config;
+}
+
+void mgmt_config_reader_release(mgmt_config_reader_t *reader) {
+    if (reader == NULL) {
+        return;
+    }
+
+    mgmt_config_snapshot_release(reader->snapshot);
+    reader->snapshot = NULL;
+    reader->generation = 0;
+}
+
 /* Configuration Getters (read active configuration) */
 
 xoe_mode_t mgmt_config_get_mode(mgmt_config_manager_t *mgr) {
+    mgmt_config_snapshot_t *snapshot;
     xoe_mode_t mode;
 
     if (mgr == NULL) {
         return MODE_HELP;
     }
 
-    pthread_mutex_lock(&mgr->mutex);
-    mode = mgr->active.mode;
-    pthread_mutex_unlock(&mgr->mutex);
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    mode = snapshot->config.mode;
+    mgmt_config_snapshot_release(snapshot);
 
     return mode;
 }
@@ -431,15 +607,16 @@ const char* mgmt_config_get_listen_address(mgmt_config_manager_t *mgr) {
 }
 
 int mgmt_config_get_listen_port(mgmt_config_manager_t *mgr) {
+    mgmt_config_snapshot_t *snapshot;
     int port;
 
     if (mgr == NULL) {
         return -1;
     }
 
-    pthread_mutex_lock(&mgr->mutex);
-    port = mgr->active.listen_port;
-    pthread_mutex_unlock(&mgr->mutex);
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    port = snapshot->config.listen_port;
+    mgmt_config_snapshot_release(snapshot);
 
     return port;
 }
@@ -459,29 +636,31 @@ const char* mgmt_config_get_connect_address(mgmt_config_manager_t *mgr) {
 }
 
 int mgmt_config_get_connect_port(mgmt_config_manager_t *mgr) {
+    mgmt_config_snapshot_t *snapshot;
     int port;
 
     if (mgr == NULL) {
         return -1;
     }
 
-    pthread_mutex_lock(&mgr->mutex);
-    port = mgr->active.connect_server_port;
-    pthread_mutex_unlock(&mgr->mutex);
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    port = snapshot->config.connect_server_port;
+    mgmt_config_snapshot_release(snapshot);
 
     return port;
 }
 
 int mgmt_config_get_encryption(mgmt_config_manager_t *mgr) {
+    mgmt_config_snapshot_t *snapshot;
     int mode;
 
     if (mgr == NULL) {
         return -1;
     }
 
-    pthread_mutex_lock(&mgr->mutex);
-    mode = mgr->active.encryption_mode;
-    pthread_mutex_unlock(&mgr->mutex);
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    mode = snapshot->config.encryption_mode;
+    mgmt_config_snapshot_release(snapshot);
 
     return mode;
 }
@@ -631,8 +810,7 @@ int mgmt_config_set_serial_baud(mgmt_config_manager_t *mgr, int baud) {
     }
 
     /* Validate baud rate */
-    if (baud != 9600 && baud != 19200 && baud != 38400 &&
-        baud != 57600 && baud != 115200 && baud != 230400) {
+    if (serial_validate_baud(baud) != 0) {
         return -1;
     }
 
@@ -647,3 +825,151 @@ int mgmt_config_set_serial_baud(mgmt_config_manager_t *mgr, int baud) {
     /* TODO: Access serial_config and set baud rate when available */
     return 0;
 }
+
+/* Live settings (applied by "reload" without a restart) */
+
+/* Copy a path into a fixed-size pending field */
+static int set_path(mgmt_config_manager_t *mgr, char *field, const char *path) {
+    size_t len;
+
+    if (mgr == NULL || path == NULL) {
+        return -1;
+    }
+
+    len = strlen(path);
+    if (len == 0 || len >= TLS_CERT_PATH_MAX) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    memcpy(field, path, len + 1);
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_tls_cert(mgmt_config_manager_t *mgr, const char *path) {
+    return set_path(mgr, mgr != NULL ? mgr->pending.cert_path : NULL, path);
+}
+
+int mgmt_config_set_tls_key(mgmt_config_manager_t *mgr, const char *path) {
+    return set_path(mgr, mgr != NULL ? mgr->pending.key_path : NULL, path);
+}
+
+int mgmt_config_set_conn_rate(mgmt_config_manager_t *mgr, int rate) {
+    if (mgr == NULL || rate < 0 || rate > MAX_CONN_RATE) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.conn_rate = rate;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_mem_budget(mgmt_config_manager_t *mgr, int mb) {
+    if (mgr == NULL || mb < 0 || mb > MEM_BUDGET_MAX_MB) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.mem_budget_mb = mb;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_conn_mem(mgmt_config_manager_t *mgr, int kb) {
+    if (mgr == NULL || kb < 0 || kb > MEM_BUDGET_MAX_CONN_KB) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.conn_mem_kb = kb;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_log_level(mgmt_config_manager_t *mgr, int level) {
+    if (mgr == NULL || level < LOG_LEVEL_ERROR || level > LOG_LEVEL_DEBUG) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.log_level = level;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_rcvbuf(mgmt_config_manager_t *mgr, int bytes) {
+    if (mgr == NULL || bytes < 0 || bytes > SOCK_TUNE_MAX_BUFFER) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.sock_tune.rcvbuf = bytes;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_sndbuf(mgmt_config_manager_t *mgr, int bytes) {
+    if (mgr == NULL || bytes < 0 || bytes > SOCK_TUNE_MAX_BUFFER) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.sock_tune.sndbuf = bytes;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_usb_classes(mgmt_config_manager_t *mgr,
+                                const uint8_t *classes, int count) {
+    if (mgr == NULL || count < 0 || count > MAX_USB_CLASSES ||
+        (count > 0 && classes == NULL)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    memset(mgr->pending.usb_classes, 0, sizeof(mgr->pending.usb_classes));
+    if (count > 0) {
+        memcpy(mgr->pending.usb_classes, classes, (size_t)count);
+    }
+    mgr->pending.usb_class_count = count;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
+
+int mgmt_config_set_thread_sched(mgmt_config_manager_t *mgr,
+                                 thread_class_t cls,
+                                 const thread_sched_class_t *entry) {
+    if (mgr == NULL || entry == NULL || (int)cls < 0 ||
+        cls >= THREAD_CLASS_COUNT ||
+        entry->cpu_count < 0 || entry->cpu_count > THREAD_SCHED_MAX_CPUS ||
+        (entry->policy != THREAD_POLICY_DEFAULT &&
+         (entry->priority < THREAD_SCHED_MIN_PRIO ||
+          entry->priority > THREAD_SCHED_MAX_PRIO))) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&mgr->mutex);
+    mgr->pending.thread_sched.classes[cls] = *entry;
+    mgr->has_pending = 1;
+    pthread_mutex_unlock(&mgr->mutex);
+
+    return 0;
+}
@@ -11,10 +11,47 @@
  * allowing queued configuration changes to be validated and applied
  * atomically during runtime mode restarts.
  *
- * Thread Safety: All functions use mutex protection for concurrent access
- * from operational and management threads.
+ * Thread Safety: Setters and pending-config functions use mutex protection
+ * for concurrent access from operational and management threads.
+ *
+ * Read-mostly snapshots: the active configuration is also published as an
+ * immutable, reference-counted snapshot, replaced (never modified) by
+ * mgmt_config_apply_pending(). Readers take no lock:
+ * - mgmt_config_snapshot_acquire()/release() pin one snapshot, e.g. for
+ *   the lifetime of a connection.
+ * - A mgmt_config_reader_t keeps a pinned snapshot per thread and
+ *   mgmt_config_read() costs one atomic load of the generation counter
+ *   until a new configuration is applied, so data-path threads can read
+ *   settings on every iteration and still follow runtime changes.
+ * The scalar getters below read the current snapshot the same way.
  */
 
+/**
+ * Immutable configuration snapshot
+ *
+ * A deep copy of the active configuration at the time it was applied.
+ * Never modified after publication; freed when the last reference (the
+ * manager's, or a reader's) is released.
+ */
+typedef struct mgmt_config_snapshot_t {
+    int refs;                  /* References held (atomic) */
+    uint64_t generation;       /* Publication number, 1 = initial config */
+    xoe_config_t config;       /* Read-only copy of the active config */
+} mgmt_config_snapshot_t;
+
+/**
+ * Per-thread snapshot cache for mgmt_config_read()
+ *
+ * Zero-initialize before first use (or use MGMT_CONFIG_READER_INIT);
+ * release with mgmt_config_reader_release().
+ */
+typedef struct {
+    mgmt_config_snapshot_t *snapshot;  /* Pinned snapshot, NULL before use */
+    uint64_t generation;               /* Its generation */
+} mgmt_config_reader_t;
+
+#define MGMT_CONFIG_READER_INIT { NULL, 0 }
+
 /**
  * Dual configuration structure
  *
@@ -30,6 +67,9 @@ typedef struct mgmt_config_manager_t {
     xoe_config_t pending;      /* Staged configuration for next restart */
     int has_pending;           /* Flag: 1 if pending differs from active */
     pthread_mutex_t mutex;     /* Protects both configurations */
+    mgmt_config_snapshot_t *current;  /* Published copy of active (atomic) */
+    uint64_t generation;       /* Generation of current (atomic) */
+    int acquiring;             /* Snapshot acquires in progress (atomic) */
 } mgmt_config_manager_t;
 
 /**
@@ -102,6 +142,28 @@ int mgmt_config_apply_pending(mgmt_config_manager_t *mgr);
  */
 void mgmt_config_clear_pending(mgmt_config_manager_t *mgr);
 
+/**
+ * Check whether pending changes need a mode restart
+ *
+ * Mode, addresses, ports, encryption mode and serial device need a new
+ * listener or connection (restart). Everything else that can be set -
+ * TLS certificate/key, connection rate, log level, socket buffer sizes,
+ * thread scheduling, memory budget, USB class whitelist - is applied live by
+ * server_apply_live_config().
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   what_buf - Receives the first restart-only setting changed (may be NULL)
+ *   what_buf_size - Size of what_buf
+ *
+ * Returns:
+ *   1 if a restart is needed, 0 if the pending changes can be applied live
+ *
+ * Thread Safety: Mutex-protected read
+ */
+int mgmt_config_pending_needs_restart(mgmt_config_manager_t *mgr,
+                                      char *what_buf, size_t what_buf_size);
+
 /**
  * Validate pending configuration
  *
@@ -124,6 +186,58 @@ void mgmt_config_clear_pending(mgmt_config_manager_t *mgr);
 int mgmt_config_validate_pending(mgmt_config_manager_t *mgr,
                                   char *error_buf, size_t error_buf_size);
 
+/* Configuration Snapshots (lock-free reads of active configuration) */
+
+/**
+ * Pin the current snapshot
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *
+ * Returns:
+ *   Current snapshot with one reference taken for the caller (release
+ *   with mgmt_config_snapshot_release()), or NULL if mgr is NULL
+ *
+ * Thread Safety: Lock-free; may run concurrently with apply_pending
+ */
+mgmt_config_snapshot_t* mgmt_config_snapshot_acquire(mgmt_config_manager_t *mgr);
+
+/**
+ * Drop a snapshot reference
+ *
+ * Frees the snapshot once its last reference is released. A pinned
+ * snapshot stays valid even after the manager has been destroyed.
+ *
+ * Parameters:
+ *   snapshot - Snapshot from mgmt_config_snapshot_acquire() (NULL safe)
+ */
+void mgmt_config_snapshot_release(mgmt_config_snapshot_t *snapshot);
+
+/**
+ * Read the active configuration through a per-thread cache
+ *
+ * Returns the reader's pinned snapshot while it is still current (one
+ * atomic load), re-pinning the current one after an apply.
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   reader - Calling thread's cache (not shared between threads)
+ *
+ * Returns:
+ *   Read-only active configuration, valid until the next call with this
+ *   reader or mgmt_config_reader_release(); NULL if mgr or reader is NULL
+ */
+const xoe_config_t* mgmt_config_read(mgmt_config_manager_t *mgr,
+                                     mgmt_config_reader_t *reader);
+
+/**
+ * Release a reader's pinned snapshot
+ *
+ * Parameters:
+ *   reader - Reader cache (NULL safe); reusable afterwards
+ */
+void mgmt_config_reader_release(mgmt_config_reader_t *reader);
+
 /* Configuration Getters (read active configuration) */
 
 /**
@@ -268,11 +382,106 @@ int mgmt_config_set_serial_device(mgmt_config_manager_t *mgr,
  *
  * Parameters:
  *   mgr - Configuration manager
- *   baud - Baud rate (9600, 19200, 38400, 57600, 115200, 230400)
+ *   baud - Baud rate (any rate serial_validate_baud() accepts)
  *
  * Returns:
  *   0 on success, -1 on invalid baud rate
  */
 int mgmt_config_set_serial_baud(mgmt_config_manager_t *mgr, int baud);
 
+/* Live settings (applied by "reload" without a restart) */
+
+/**
+ * Set pending TLS certificate or key path
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   path - PEM file path (copied, at most TLS_CERT_PATH_MAX - 1 chars)
+ *
+ * Returns:
+ *   0 on success, -1 on NULL or overlong path
+ */
+int mgmt_config_set_tls_cert(mgmt_config_manager_t *mgr, const char *path);
+int mgmt_config_set_tls_key(mgmt_config_manager_t *mgr, const char *path);
+
+/**
+ * Set pending connection rate limit
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   rate - Connections per address per 10 s (0 = unlimited, max MAX_CONN_RATE)
+ *
+ * Returns:
+ *   0 on success, -1 on invalid rate
+ */
+int mgmt_config_set_conn_rate(mgmt_config_manager_t *mgr, int rate);
+
+/**
+ * Set pending log level
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   level - log_level_t value
+ *
+ * Returns:
+ *   0 on success, -1 on invalid level
+ */
+int mgmt_config_set_log_level(mgmt_config_manager_t *mgr, int level);
+
+/**
+ * Set pending socket receive or send buffer size for new connections
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   bytes - Buffer size (0 = system default, max SOCK_TUNE_MAX_BUFFER)
+ *
+ * Returns:
+ *   0 on success, -1 on invalid size
+ */
+int mgmt_config_set_rcvbuf(mgmt_config_manager_t *mgr, int bytes);
+int mgmt_config_set_sndbuf(mgmt_config_manager_t *mgr, int bytes);
+
+/**
+ * Set pending USB device class whitelist
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   classes - USB class codes (may be NULL if count is 0)
+ *   count - Entries (0 = default policy, max MAX_USB_CLASSES)
+ *
+ * Returns:
+ *   0 on success, -1 on invalid count
+ */
+int mgmt_config_set_usb_classes(mgmt_config_manager_t *mgr,
+                                const uint8_t *classes, int count);
+
+/**
+ * Set pending CPU set and scheduling policy of one thread class
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   cls - Thread class
+ *   entry - Its settings (see thread_sched_parse())
+ *
+ * Returns:
+ *   0 on success, -1 on invalid class or settings
+ */
+int mgmt_config_set_thread_sched(mgmt_config_manager_t *mgr,
+                                 thread_class_t cls,
+                                 const thread_sched_class_t *entry);
+
+/**
+ * Set pending memory budget and per-connection limit
+ *
+ * Parameters:
+ *   mgr - Configuration manager
+ *   mb - Frame buffer memory in MiB (0 = unlimited, max MEM_BUDGET_MAX_MB)
+ *   kb - Per connection in KiB (0 = unlimited, max MEM_BUDGET_MAX_CONN_KB)
+ *
+ * Returns:
+ *   0 on success, -1 on an invalid size
+ */
+int mgmt_config_set_mem_budget(mgmt_config_manager_t *mgr, int mb);
+int mgmt_config_set_conn_mem(mgmt_config_manager_t *mgr, int kb);
+
 #endif /* CORE_MGMT_CONFIG_H */
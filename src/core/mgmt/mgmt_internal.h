@@ -7,6 +7,10 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 
+#include "lib/common/metrics.h"
+#include "lib/common/timer_wheel.h"
+#include "lib/net/rate_limit.h"
+
 #if TLS_ENABLED
 #include <openssl/ssl.h>
 #endif
@@ -16,34 +20,64 @@
  * Not exposed to external code.
  */
 
-#define MGMT_BUFFER_SIZE 1024    /* Per-session I/O buffer */
+#define MGMT_BUFFER_SIZE 1024    /* Per-session input line / format buffer */
 #define MGMT_PASSWORD_MAX 128    /* Max password length */
 
-/* Rate limiting constants (NET-004, FSM-009 fix) */
-#define MGMT_RATE_LIMIT_ENTRIES 16   /* Max tracked IPs */
+/* Output queued per session; a command's output past it is dropped with a
+ * note (`stats prometheus` is about 8 KB) */
+#ifndef MGMT_OUTPUT_SIZE
+#define MGMT_OUTPUT_SIZE 16384
+#endif
+
+/* Rate limiting constants (NET-004, FSM-009 fix): after
+ * MGMT_RATE_LIMIT_FAILURES failed logins an address is locked out, and
+ * regains one attempt every MGMT_RATE_LIMIT_LOCKOUT seconds */
 #define MGMT_RATE_LIMIT_LOCKOUT 30   /* Seconds to lock out after failures */
 #define MGMT_RATE_LIMIT_FAILURES 5   /* Failures before lockout */
 
-/* Rate limit entry for tracking auth failures per IP */
-typedef struct {
-    in_addr_t ip_addr;      /* IPv4 address (0 = unused) */
-    int failure_count;      /* Number of failed auth attempts */
-    time_t lockout_until;   /* Lockout expiry time (0 = not locked) */
-} mgmt_rate_limit_entry_t;
+/* Seconds a new session has to finish TLS and log in before it is closed
+ * (a slot held by an idle login would keep monitors out) */
+#define MGMT_LOGIN_TIMEOUT_SEC 30
+
+/* `watch` interval: default and limits (seconds) */
+#define MGMT_WATCH_DEFAULT_SEC 1
+#define MGMT_WATCH_MAX_SEC 3600
 
 /* Forward declaration */
 struct mgmt_server_t;
 
+/* Session state, advanced by the management server's event loop */
+typedef enum {
+    MGMT_STATE_HANDSHAKE,       /* TLS handshake in progress */
+    MGMT_STATE_SNIFF,           /* Waiting to see whether it speaks HTTP */
+    MGMT_STATE_HTTP,            /* Reading an HTTP request head */
+    MGMT_STATE_AUTH,            /* Waiting for the password */
+    MGMT_STATE_COMMAND,         /* At the prompt */
+    MGMT_STATE_WATCH,           /* Streaming `watch` deltas */
+    MGMT_STATE_CLOSING          /* Flushing the last output, then closing */
+} mgmt_state_t;
+
 /* Session structure - shared between server and commands */
 typedef struct mgmt_session_t {
-    int socket_fd;              /* Session socket */
+    int socket_fd;              /* Session socket (non-blocking) */
     int in_use;                 /* Pool slot in-use flag */
-    pthread_t thread_id;        /* Session thread ID */
+    mgmt_state_t state;         /* Where the session is */
     char password[MGMT_PASSWORD_MAX]; /* Password buffer */
     volatile sig_atomic_t authenticated; /* Authentication status */
-    char read_buffer[MGMT_BUFFER_SIZE];  /* Pre-allocated read buffer */
-    char write_buffer[MGMT_BUFFER_SIZE]; /* Pre-allocated write buffer */
-    in_addr_t client_ip;        /* Client IP for rate limiting */
+    int auth_attempts;          /* Wrong passwords so far */
+    char read_buffer[MGMT_BUFFER_SIZE];  /* Input not yet split into lines */
+    size_t read_len;
+    char write_buffer[MGMT_BUFFER_SIZE]; /* send_fmt() scratch */
+    char out_buffer[MGMT_OUTPUT_SIZE];   /* Output not yet sent */
+    size_t out_start;           /* First unsent byte */
+    size_t out_len;             /* Unsent bytes from out_start */
+    int out_dropped;            /* Output dropped since the last prompt */
+    int want_write;             /* Write interest registered */
+    timer_wheel_timer_t timer;  /* Login deadline, sniff or watch tick */
+    unsigned int watch_interval_ms; /* `watch` period */
+    uint64_t watch_start_us;    /* When `watch` began */
+    metrics_snapshot_t watch_prev; /* Values the last tick reported against */
+    rate_limit_key_t client_key; /* Client address for rate limiting */
     struct mgmt_server_t *server; /* Back-pointer to server for rate limiting */
 #if TLS_ENABLED
     SSL* tls;                   /* TLS session (FSM-006 fix) */
@@ -51,10 +85,14 @@ typedef struct mgmt_session_t {
 } mgmt_session_t;
 
 /**
- * TLS-aware I/O helpers (FSM-006 fix)
- * Uses TLS if enabled, falls back to plain socket I/O.
+ * mgmt_write - Queue output for a session (FSM-006: TLS when enabled)
+ *
+ * Never blocks: output is sent as the socket drains. What does not fit in
+ * the session's output buffer is dropped until the next prompt, which
+ * then says so.
+ *
+ * Returns: len if queued, -1 if dropped
  */
 ssize_t mgmt_write(mgmt_session_t *session, const void *buf, size_t len);
-ssize_t mgmt_read(mgmt_session_t *session, void *buf, size_t len);
 
 #endif /* CORE_MGMT_INTERNAL_H */
@@ -2,6 +2,13 @@
 #include "mgmt_internal.h"
 #include "mgmt_commands.h"
 #include "core/config.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+#include "lib/common/timer_wheel.h"
+#include "lib/net/event_poller.h"
 #include "lib/security/password_hash.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,15 +17,16 @@
 #include <pthread.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #if TLS_ENABLED
+#include <openssl/err.h>
 #include "lib/security/tls_config.h"
 #include "lib/security/tls_context.h"
 #include "lib/security/tls_session.h"
-#include "lib/security/tls_io.h"
 #endif
 
 /**
@@ -36,23 +44,50 @@
  *
  * Thread architecture:
  * - Main thread: Calls mgmt_server_start/stop
- * - Listener thread: Accepts connections, spawns session threads
- * - Session threads: Handle individual management sessions (detached)
+ * - Loop thread: One event loop (event_poller.h, as the connection
+ *   workers use) for the listener and every session. Sockets are
+ *   non-blocking; input is split into lines as it arrives and output is
+ *   queued per session and sent as the socket drains, so a slow or idle
+ *   client never holds the thread. A timer wheel runs login deadlines,
+ *   the HTTP sniff and `watch` ticks.
+ *
+ * The thread only reads lock-free statistics (metrics, latency, wire
+ * trace, stage profiler) and the config manager; it never waits on a
+ * data-path lock to report on the data path.
  */
 
+/* Timer wheel resolution (sniff and watch periods are multiples) */
+#define MGMT_TIMER_TICK_MS 10
+
+/* Output kept back for the truncation note and the prompt after it */
+#define MGMT_OUTPUT_RESERVE 128
+
+/* Session I/O result: nothing to read, or no room to write, right now */
+#define MGMT_IO_AGAIN (-2)
+
+/* Sends never block, nor die on a vanished peer */
+#ifdef MSG_NOSIGNAL
+#define MGMT_SEND_FLAGS (MSG_DONTWAIT | MSG_NOSIGNAL)
+#else
+#define MGMT_SEND_FLAGS MSG_DONTWAIT
+#endif
+
 /* Management server structure - FIXED SIZE, ISOLATED MEMORY */
 struct mgmt_server_t {
-    int listen_fd;              /* Listening socket */
+    int listen_fd;              /* Listening socket (non-blocking) */
     int port;                   /* Listen port */
     char password_hash[PASSWORD_HEX_LEN]; /* Hashed password (never plaintext) */
     int password_enabled;       /* Authentication required flag */
-    pthread_t listener_thread;  /* Listener thread ID */
-    volatile sig_atomic_t shutdown_flag; /* Shutdown signal */
+    pthread_t loop_thread;      /* Event loop thread ID */
+    int thread_started;
+    int wake_pipe[2];           /* mgmt_server_stop() -> loop thread */
+    event_poller_t poller;      /* Listener, wake pipe and sessions */
+    timer_wheel_t timers;       /* Session deadlines and watch ticks */
+    int active_sessions;        /* Sessions in use (atomic) */
     mgmt_session_t sessions[MAX_MGMT_SESSIONS]; /* Session pool (pre-allocated) */
-    pthread_mutex_t session_mutex; /* Protects session pool */
     /* Rate limiting (NET-004, FSM-009 fix) */
-    mgmt_rate_limit_entry_t rate_limits[MGMT_RATE_LIMIT_ENTRIES];
-    pthread_mutex_t rate_limit_mutex; /* Protects rate limit table */
+    rate_limiter_t auth_limiter; /* Failed logins per client address */
+    int limiter_initialized;
 #if TLS_ENABLED
     /* TLS support for management interface (FSM-006 fix) */
     SSL_CTX* tls_ctx;           /* TLS context for management connections */
@@ -61,14 +96,26 @@ struct mgmt_server_t {
 };
 
 /* Forward declarations */
-static void* listener_thread(void* arg);
-static void* session_handler(void* arg);
-static mgmt_session_t* acquire_session_slot(mgmt_server_t *server);
-static void release_session_slot(mgmt_session_t *session);
-static int authenticate_session(mgmt_session_t *session);
-static int check_rate_limit(mgmt_server_t *server, in_addr_t ip);
-static void record_auth_failure(mgmt_server_t *server, in_addr_t ip);
-static void clear_auth_failure(mgmt_server_t *server, in_addr_t ip);
+static void* loop_thread(void* arg);
+static void accept_pending(mgmt_server_t *server);
+static void session_open(mgmt_session_t *session, int client_fd,
+                         const rate_limit_key_t *client_key);
+static void session_close(mgmt_session_t *session);
+static void session_begin(mgmt_session_t *session);
+static void session_greet(mgmt_session_t *session);
+static void session_on_event(mgmt_session_t *session, int readable,
+                             int writable);
+static void session_on_readable(mgmt_session_t *session);
+static void session_process(mgmt_session_t *session);
+static void session_line(mgmt_session_t *session, char *line);
+static void session_prompt(mgmt_session_t *session);
+static void session_settle(mgmt_session_t *session);
+static void session_timer_expired(timer_wheel_timer_t *timer, void *arg);
+static int check_rate_limit(mgmt_server_t *server, const rate_limit_key_t *key);
+static void record_auth_failure(mgmt_server_t *server,
+                                const rate_limit_key_t *key);
+static void clear_auth_failure(mgmt_server_t *server,
+                               const rate_limit_key_t *key);
 
 /**
  * secure_zero - Securely clear sensitive memory (NET-015 fix)
@@ -82,29 +129,185 @@ static void secure_zero(void* ptr, size_t len) {
 }
 
 /**
- * mgmt_write - TLS-aware write helper (FSM-006 fix)
- * Uses TLS if enabled, falls back to plain socket write.
+ * session_recv - TLS-aware non-blocking read (FSM-006 fix)
+ *
+ * Returns bytes read, 0 at end of stream, MGMT_IO_AGAIN when nothing is
+ * ready, or -1 on error.
  */
-ssize_t mgmt_write(mgmt_session_t *session, const void *buf, size_t len) {
+static ssize_t session_recv(mgmt_session_t *session, void *buf, size_t len) {
+    ssize_t n;
+
 #if TLS_ENABLED
     if (session->tls != NULL) {
-        return tls_write(session->tls, buf, len);
+        int got;
+
+        ERR_clear_error();
+        got = SSL_read(session->tls, buf, (int)len);
+        if (got > 0) {
+            return got;
+        }
+        switch (SSL_get_error(session->tls, got)) {
+            case SSL_ERROR_WANT_READ:
+            case SSL_ERROR_WANT_WRITE:
+                return MGMT_IO_AGAIN;
+            case SSL_ERROR_ZERO_RETURN:
+                return 0;
+            default:
+                return -1;
+        }
     }
 #endif
-    return write(session->socket_fd, buf, len);
+
+    n = recv(session->socket_fd, buf, len, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                  errno == EINTR)) {
+        return MGMT_IO_AGAIN;
+    }
+    return n;
 }
 
 /**
- * mgmt_read - TLS-aware read helper (FSM-006 fix)
- * Uses TLS if enabled, falls back to plain socket read.
+ * session_send - TLS-aware non-blocking write (FSM-006 fix)
+ *
+ * Returns bytes written, MGMT_IO_AGAIN when the socket is full, or -1
+ * on error.
  */
-ssize_t mgmt_read(mgmt_session_t *session, void *buf, size_t len) {
+static ssize_t session_send(mgmt_session_t *session, const void *buf,
+                            size_t len) {
+    ssize_t n;
+
 #if TLS_ENABLED
     if (session->tls != NULL) {
-        return tls_read(session->tls, buf, len);
+        int sent;
+
+        ERR_clear_error();
+        sent = SSL_write(session->tls, buf, (int)len);
+        if (sent > 0) {
+            return sent;
+        }
+        switch (SSL_get_error(session->tls, sent)) {
+            case SSL_ERROR_WANT_READ:
+            case SSL_ERROR_WANT_WRITE:
+                return MGMT_IO_AGAIN;
+            default:
+                return -1;
+        }
+    }
+#endif
+
+    n = send(session->socket_fd, buf, len, MGMT_SEND_FLAGS);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+                  errno == EINTR)) {
+        return MGMT_IO_AGAIN;
+    }
+    return n;
+}
+
+/**
+ * session_flush - Send queued output until the socket is full
+ *
+ * A failed send discards the output and marks the session for closing.
+ */
+static void session_flush(mgmt_session_t *session) {
+    ssize_t n;
+
+    while (session->out_len > 0) {
+        n = session_send(session, session->out_buffer + session->out_start,
+                         session->out_len);
+        if (n == MGMT_IO_AGAIN) {
+            break;
+        }
+        if (n <= 0) {
+            session->out_len = 0;
+            session->state = MGMT_STATE_CLOSING;
+            break;
+        }
+        session->out_start += (size_t)n;
+        session->out_len -= (size_t)n;
+    }
+    if (session->out_len == 0) {
+        session->out_start = 0;
+    }
+}
+
+/**
+ * session_queue - Append output while it stays under @limit bytes
+ *
+ * Returns TRUE if queued, FALSE if it did not fit even after sending
+ * what the socket would take.
+ */
+static int session_queue(mgmt_session_t *session, const void *buf,
+                         size_t len, size_t limit) {
+    if (session->out_len + len > limit) {
+        session_flush(session);
+        if (session->out_len + len > limit) {
+            return FALSE;
+        }
+    }
+
+    /* SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER lets a retried write move */
+    if (session->out_start + session->out_len + len > limit) {
+        memmove(session->out_buffer,
+                session->out_buffer + session->out_start, session->out_len);
+        session->out_start = 0;
+    }
+    memcpy(session->out_buffer + session->out_start + session->out_len,
+           buf, len);
+    session->out_len += len;
+    return TRUE;
+}
+
+/**
+ * mgmt_write - Queue output for a session
+ *
+ * Once something was dropped, the rest of the command's output is too,
+ * so the client never sees a gap inside the text.
+ */
+ssize_t mgmt_write(mgmt_session_t *session, const void *buf, size_t len) {
+    if (session->out_dropped ||
+        !session_queue(session, buf, len,
+                       MGMT_OUTPUT_SIZE - MGMT_OUTPUT_RESERVE)) {
+        session->out_dropped = 1;
+        return -1;
+    }
+    return (ssize_t)len;
+}
+
+/**
+ * mgmt_server_free - Release a server, started or partly started
+ */
+static void mgmt_server_free(mgmt_server_t *server) {
+    int i;
+
+    for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
+        if (server->sessions[i].in_use) {
+            session_close(&server->sessions[i]);
+        }
+    }
+    event_poller_destroy(&server->poller);
+    if (server->wake_pipe[0] >= 0) {
+        close(server->wake_pipe[0]);
+    }
+    if (server->wake_pipe[1] >= 0) {
+        close(server->wake_pipe[1]);
+    }
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+
+#if TLS_ENABLED
+    /* Cleanup TLS context (FSM-006 fix) */
+    if (server->tls_ctx != NULL) {
+        tls_context_cleanup(server->tls_ctx);
+        server->tls_ctx = NULL;
     }
 #endif
-    return read(session->socket_fd, buf, len);
+
+    if (server->limiter_initialized) {
+        rate_limiter_destroy(&server->auth_limiter);
+    }
+    secure_zero(server->password_hash, sizeof(server->password_hash));
+    free(server); /* Only the server structure itself was malloc'd */
 }
 
 /**
@@ -120,8 +323,8 @@ mgmt_server_t* mgmt_server_start(xoe_config_t *config) {
         return NULL;
     }
 
-    /* Allocate server structure */
-    server = (mgmt_server_t*)malloc(sizeof(mgmt_server_t));
+    /* Allocate server structure (sessions included, zeroed) */
+    server = (mgmt_server_t*)calloc(1, sizeof(mgmt_server_t));
     if (server == NULL) {
         fprintf(stderr, "Failed to allocate management server\n");
         return NULL;
@@ -130,58 +333,42 @@ mgmt_server_t* mgmt_server_start(xoe_config_t *config) {
     /* Initialize fields */
     server->listen_fd = -1;
     server->port = config->mgmt_port;
-    server->password_hash[0] = '\0';
-    server->password_enabled = 0;
-    server->shutdown_flag = 0;
+    server->wake_pipe[0] = -1;
+    server->wake_pipe[1] = -1;
+    server->poller.fd = -1;
 
     /* Hash password if provided (never store plaintext) */
     if (config->mgmt_password != NULL && config->mgmt_password[0] != '\0') {
         if (password_hash(config->mgmt_password, server->password_hash) != 0) {
             fprintf(stderr, "Failed to hash management password\n");
-            free(server);
+            mgmt_server_free(server);
             return NULL;
         }
         server->password_enabled = 1;
     }
 
     /* Initialize session pool (pre-allocated, zero dynamic allocation) */
-    /* USB-009 fix: check pthread_mutex_init return value */
-    if (pthread_mutex_init(&server->session_mutex, NULL) != 0) {
-        fprintf(stderr, "Failed to initialize session mutex\n");
-        free(server);
-        return NULL;
-    }
     for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
-        server->sessions[i].in_use = 0;
         server->sessions[i].socket_fd = -1;
-        server->sessions[i].authenticated = 0;
-        server->sessions[i].client_ip = 0;
         server->sessions[i].server = server;  /* Back-pointer for rate limiting */
         /* Copy hashed password to each session's isolated buffer */
         strncpy(server->sessions[i].password, server->password_hash, MGMT_PASSWORD_MAX - 1);
         server->sessions[i].password[MGMT_PASSWORD_MAX - 1] = '\0';
-        /* Buffers are already allocated as part of the structure */
+        timer_wheel_timer_init(&server->sessions[i].timer,
+                               session_timer_expired, &server->sessions[i]);
     }
+    timer_wheel_init(&server->timers, latency_now_ms(), MGMT_TIMER_TICK_MS);
 
     /* Initialize rate limiting (NET-004, FSM-009 fix) */
-    /* USB-009 fix: check pthread_mutex_init return value */
-    if (pthread_mutex_init(&server->rate_limit_mutex, NULL) != 0) {
+    if (rate_limiter_init(&server->auth_limiter, MGMT_RATE_LIMIT_FAILURES,
+                          MGMT_RATE_LIMIT_LOCKOUT * 1000) != 0) {
         fprintf(stderr, "Failed to initialize rate limit mutex\n");
-        pthread_mutex_destroy(&server->session_mutex);
-        free(server);
+        mgmt_server_free(server);
         return NULL;
     }
-    for (i = 0; i < MGMT_RATE_LIMIT_ENTRIES; i++) {
-        server->rate_limits[i].ip_addr = 0;
-        server->rate_limits[i].failure_count = 0;
-        server->rate_limits[i].lockout_until = 0;
-    }
+    server->limiter_initialized = 1;
 
 #if TLS_ENABLED
-    /* Initialize TLS context for management connections (FSM-006 fix) */
-    server->tls_enabled = 0;
-    server->tls_ctx = NULL;
-
     /* Only enable TLS if encryption is configured and cert/key exist */
     if (config->encryption_mode == ENCRYPT_TLS12 ||
         config->encryption_mode == ENCRYPT_TLS13) {
@@ -203,9 +390,7 @@ mgmt_server_t* mgmt_server_start(xoe_config_t *config) {
     server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (server->listen_fd < 0) {
         fprintf(stderr, "Failed to create management socket: %s\n", strerror(errno));
-        pthread_mutex_destroy(&server->rate_limit_mutex);
-        pthread_mutex_destroy(&server->session_mutex);
-        free(server);
+        mgmt_server_free(server);
         return NULL;
     }
 
@@ -225,41 +410,47 @@ mgmt_server_t* mgmt_server_start(xoe_config_t *config) {
              sizeof(server_addr)) < 0) {
         fprintf(stderr, "Failed to bind management port %d: %s\n",
                 server->port, strerror(errno));
-        close(server->listen_fd);
-        pthread_mutex_destroy(&server->rate_limit_mutex);
-        pthread_mutex_destroy(&server->session_mutex);
-        free(server);
+        mgmt_server_free(server);
         return NULL;
     }
 
     /* Start listening */
-    if (listen(server->listen_fd, MAX_PENDING_CONNECTIONS) < 0) {
+    if (listen(server->listen_fd, MAX_PENDING_CONNECTIONS) < 0 ||
+        fd_set_nonblocking(server->listen_fd) != 0) {
         fprintf(stderr, "Failed to listen on management port: %s\n", strerror(errno));
-        close(server->listen_fd);
-        pthread_mutex_destroy(&server->rate_limit_mutex);
-        pthread_mutex_destroy(&server->session_mutex);
-        free(server);
+        mgmt_server_free(server);
         return NULL;
     }
 
-    /* Spawn listener thread */
-    if (pthread_create(&server->listener_thread, NULL, listener_thread, server) != 0) {
-        fprintf(stderr, "Failed to create management listener thread: %s\n",
+    /* Event loop: listener (data = server), wake pipe (data = NULL) */
+    if (event_poller_create(&server->poller, FALSE) != 0 ||
+        pipe(server->wake_pipe) != 0 ||
+        fd_set_nonblocking(server->wake_pipe[0]) != 0 ||
+        event_poller_add(&server->poller, server->wake_pipe[0], NULL) != 0 ||
+        event_poller_add(&server->poller, server->listen_fd, server) != 0) {
+        fprintf(stderr, "Failed to set up management event loop: %s\n",
                 strerror(errno));
-        close(server->listen_fd);
-        pthread_mutex_destroy(&server->rate_limit_mutex);
-        pthread_mutex_destroy(&server->session_mutex);
-        free(server);
+        mgmt_server_free(server);
         return NULL;
     }
 
-    printf("Management interface started on 127.0.0.1:%d\n", server->port);
+    /* Spawn event loop thread */
+    if (thread_sched_create(&server->loop_thread, THREAD_CLASS_NONE,
+                            loop_thread, server) != 0) {
+        fprintf(stderr, "Failed to create management thread: %s\n",
+                strerror(errno));
+        mgmt_server_free(server);
+        return NULL;
+    }
+    server->thread_started = 1;
+
+    fprintf(stderr, "Management interface started on 127.0.0.1:%d\n", server->port);
 #if TLS_ENABLED
-    printf("Encryption: %s\n", server->tls_enabled ? "TLS enabled" : "disabled");
+    fprintf(stderr, "Encryption: %s\n", server->tls_enabled ? "TLS enabled" : "disabled");
 #else
-    printf("Encryption: disabled (TLS not compiled)\n");
+    fprintf(stderr, "Encryption: disabled (TLS not compiled)\n");
 #endif
-    printf("Authentication: enabled\n");
+    fprintf(stderr, "Authentication: enabled\n");
 
     return server;
 }
@@ -268,200 +459,215 @@ mgmt_server_t* mgmt_server_start(xoe_config_t *config) {
  * mgmt_server_stop - Stop management server
  */
 void mgmt_server_stop(mgmt_server_t *server) {
-    int i;
+    char wake = 1;
 
     if (server == NULL) {
         return;
     }
 
-    printf("Shutting down management interface...\n");
+    fprintf(stderr, "Shutting down management interface...\n");
 
-    /* Signal shutdown */
-    server->shutdown_flag = 1;
-
-    /* Close listening socket (unblocks accept) */
-    if (server->listen_fd >= 0) {
-        close(server->listen_fd);
-        server->listen_fd = -1;
-    }
-
-    /* Wait for listener thread */
-    pthread_join(server->listener_thread, NULL);
-
-    /* Close all active sessions */
-    pthread_mutex_lock(&server->session_mutex);
-    for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
-        if (server->sessions[i].in_use && server->sessions[i].socket_fd >= 0) {
-#if TLS_ENABLED
-            if (server->sessions[i].tls != NULL) {
-                tls_session_shutdown(server->sessions[i].tls);
-                tls_session_destroy(server->sessions[i].tls);
-                server->sessions[i].tls = NULL;
-            }
-#endif
-            close(server->sessions[i].socket_fd);
-            server->sessions[i].socket_fd = -1;
+    /* The loop thread closes every session on its way out */
+    if (server->thread_started) {
+        while (write(server->wake_pipe[1], &wake, 1) < 0 && errno == EINTR) {
         }
+        pthread_join(server->loop_thread, NULL);
     }
-    pthread_mutex_unlock(&server->session_mutex);
-
-    /* Wait briefly for session threads to exit (they're detached, can't join) */
-    sleep(1);
-
-#if TLS_ENABLED
-    /* Cleanup TLS context (FSM-006 fix) */
-    if (server->tls_ctx != NULL) {
-        tls_context_cleanup(server->tls_ctx);
-        server->tls_ctx = NULL;
-    }
-#endif
 
-    /* Cleanup (no dynamic memory to free - all pre-allocated) */
-    pthread_mutex_destroy(&server->rate_limit_mutex);
-    pthread_mutex_destroy(&server->session_mutex);
-    free(server); /* Only the server structure itself was malloc'd */
+    mgmt_server_free(server);
 
-    printf("Management interface stopped\n");
+    fprintf(stderr, "Management interface stopped\n");
 }
 
 /**
  * mgmt_server_get_active_sessions - Get count of active sessions
  */
 int mgmt_server_get_active_sessions(mgmt_server_t *server) {
-    int count = 0;
-    int i;
-
     if (server == NULL) {
         return 0;
     }
 
-    pthread_mutex_lock(&server->session_mutex);
+    return __atomic_load_n(&server->active_sessions, __ATOMIC_RELAXED);
+}
+
+/**
+ * loop_thread - Management event loop
+ */
+static void* loop_thread(void* arg) {
+    mgmt_server_t *server = (mgmt_server_t*)arg;
+    event_poller_event_t events[EVENT_POLLER_MAX_EVENTS];
+    mgmt_session_t *session;
+    int stop = FALSE;
+    long timeout;
+    int n;
+    int i;
+
+    while (!stop) {
+        /* Sleep until I/O or the next session timer */
+        timeout = timer_wheel_next_ms(&server->timers, latency_now_ms());
+        n = event_poller_wait(&server->poller, events,
+                              EVENT_POLLER_MAX_EVENTS, (int)timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("management: wait");
+            break;
+        }
+
+        for (i = 0; i < n; i++) {
+            if (events[i].data == NULL) {
+                stop = TRUE;
+            } else if (events[i].data == server) {
+                accept_pending(server);
+            } else {
+                session = (mgmt_session_t*)events[i].data;
+                /* A session closed earlier in this batch */
+                if (session->in_use) {
+                    session_on_event(session, events[i].readable,
+                                     events[i].writable);
+                }
+            }
+        }
+
+        timer_wheel_advance(&server->timers, latency_now_ms());
+    }
+
     for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
         if (server->sessions[i].in_use) {
-            count++;
+            session_close(&server->sessions[i]);
         }
     }
-    pthread_mutex_unlock(&server->session_mutex);
 
-    return count;
+    return NULL;
 }
 
 /**
- * listener_thread - Main listener thread
+ * reject_client - Tell a client why it is turned away, then close it
  */
-static void* listener_thread(void* arg) {
-    mgmt_server_t *server = (mgmt_server_t*)arg;
+static void reject_client(int client_fd, const char *msg) {
+    ssize_t ignored;
+
+    ignored = send(client_fd, msg, strlen(msg), MGMT_SEND_FLAGS);
+    (void)ignored;
+    close(client_fd);
+}
+
+/**
+ * accept_pending - Accept every queued connection
+ */
+static void accept_pending(mgmt_server_t *server) {
     struct sockaddr_in client_addr;
     socklen_t client_len;
     int client_fd;
-    mgmt_session_t *session;
-    pthread_t session_thread;
-    in_addr_t client_ip;
+    rate_limit_key_t client_key;
+    int i;
 
-    while (!server->shutdown_flag) {
+    for (;;) {
         client_len = sizeof(client_addr);
         client_fd = accept(server->listen_fd, (struct sockaddr*)&client_addr,
                           &client_len);
-
         if (client_fd < 0) {
-            if (server->shutdown_flag) {
-                break; /* Normal shutdown */
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
             }
-            fprintf(stderr, "Management accept failed: %s\n", strerror(errno));
-            continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fprintf(stderr, "Management accept failed: %s\n",
+                        strerror(errno));
+            }
+            return;
         }
 
-        /* Extract client IP for rate limiting */
-        client_ip = client_addr.sin_addr.s_addr;
+        /* Extract client address for rate limiting */
+        rate_limit_key_from_sockaddr((struct sockaddr*)&client_addr,
+                                     &client_key);
 
         /* Check rate limit before accepting (NET-004, FSM-009 fix) */
-        if (!check_rate_limit(server, client_ip)) {
-            const char *msg = "Too many failed attempts. Try again later.\n";
-            write(client_fd, msg, strlen(msg));
-            close(client_fd);
-            continue;
-        }
-
-        /* Acquire session slot */
-        session = acquire_session_slot(server);
-        if (session == NULL) {
-            const char *msg = "Management server full (max sessions reached)\n";
-            write(client_fd, msg, strlen(msg));
-            close(client_fd);
+        if (!check_rate_limit(server, &client_key)) {
+            reject_client(client_fd,
+                          "Too many failed attempts. Try again later.\n");
             continue;
         }
 
-        session->socket_fd = client_fd;
-        session->client_ip = client_ip;
-#if TLS_ENABLED
-        session->tls = NULL;
-
-        /* Perform TLS handshake if TLS is enabled (FSM-006 fix) */
-        if (server->tls_enabled && server->tls_ctx != NULL) {
-            session->tls = tls_session_create(server->tls_ctx, client_fd);
-            if (session->tls == NULL) {
-                const char *msg = "TLS handshake failed\n";
-                write(client_fd, msg, strlen(msg));
-                close(client_fd);
-                release_session_slot(session);
-                continue;
+        for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
+            if (!server->sessions[i].in_use) {
+                break;
             }
         }
-#endif
-
-        /* Spawn session handler (detached) */
-        if (pthread_create(&session_thread, NULL, session_handler, session) != 0) {
-            fprintf(stderr, "Failed to create session thread: %s\n", strerror(errno));
-            release_session_slot(session);
-            close(client_fd);
+        if (i == MAX_MGMT_SESSIONS) {
+            reject_client(client_fd,
+                          "Management server full (max sessions reached)\n");
             continue;
         }
 
-        session->thread_id = session_thread;
-        pthread_detach(session_thread);
+        session_open(&server->sessions[i], client_fd, &client_key);
     }
-
-    pthread_exit(NULL);
 }
 
 /**
- * session_handler - Per-session thread handler
+ * session_open - Set up a free slot for a new connection
  *
- * Uses pre-allocated session buffers - NO dynamic allocation in this function.
- * All I/O uses fixed-size buffers from the session structure.
+ * Starts the login deadline, then the TLS handshake or the session
+ * proper.
  */
-static void* session_handler(void* arg) {
-    mgmt_session_t *session = (mgmt_session_t*)arg;
-    const char *welcome = "XOE Management Console v1.0\n";
+static void session_open(mgmt_session_t *session, int client_fd,
+                         const rate_limit_key_t *client_key) {
+    mgmt_server_t *server = session->server;
 
-    /* Send welcome (using TLS if enabled - FSM-006 fix) */
-    mgmt_write(session, welcome, strlen(welcome));
+    if (fd_set_nonblocking(client_fd) != 0 ||
+        event_poller_add(&server->poller, client_fd, session) != 0) {
+        fprintf(stderr, "Management session setup failed: %s\n",
+                strerror(errno));
+        close(client_fd);
+        return;
+    }
+
+    session->socket_fd = client_fd;
+    session->in_use = 1;
+    session->authenticated = 0;
+    session->auth_attempts = 0;
+    session->read_len = 0;
+    session->out_start = 0;
+    session->out_len = 0;
+    session->out_dropped = 0;
+    session->want_write = 0;
+    session->client_key = *client_key;
+    __atomic_add_fetch(&server->active_sessions, 1, __ATOMIC_RELAXED);
+
+    timer_wheel_add(&server->timers, &session->timer,
+                    latency_now_ms() + MGMT_LOGIN_TIMEOUT_SEC * 1000);
 
-    /* Authenticate (always required for security) */
-    if (!authenticate_session(session)) {
-        const char *msg = "Authentication failed\n";
-        mgmt_write(session, msg, strlen(msg));
-        /* Record auth failure for rate limiting (NET-004, FSM-009 fix) */
-        record_auth_failure(session->server, session->client_ip);
 #if TLS_ENABLED
-        if (session->tls != NULL) {
-            tls_session_shutdown(session->tls);
-            tls_session_destroy(session->tls);
-            session->tls = NULL;
+    session->tls = NULL;
+
+    /* Handshake stepped as the socket allows (FSM-006 fix) */
+    if (server->tls_enabled && server->tls_ctx != NULL) {
+        session->tls = tls_session_create_deferred(server->tls_ctx, client_fd);
+        if (session->tls == NULL) {
+            session_close(session);
+            return;
         }
-#endif
-        close(session->socket_fd);
-        release_session_slot(session);
-        pthread_exit(NULL);
+        /* Queued output is sent in pieces and moves when compacted */
+        SSL_set_mode(session->tls, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                                   SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        session->state = MGMT_STATE_HANDSHAKE;
+        session_on_event(session, TRUE, FALSE);
+        return;
     }
+#endif
 
-    /* Clear any previous failures on successful auth */
-    clear_auth_failure(session->server, session->client_ip);
+    session_begin(session);
+    session_settle(session);
+}
 
-    /* Main command loop (Phase 5) */
-    mgmt_command_loop(session);
+/**
+ * session_close - Shut down TLS, close the socket and free the slot
+ */
+static void session_close(mgmt_session_t *session) {
+    mgmt_server_t *server = session->server;
 
-    /* Cleanup */
+    timer_wheel_cancel(&server->timers, &session->timer);
+    event_poller_remove(&server->poller, session->socket_fd);
 #if TLS_ENABLED
     if (session->tls != NULL) {
         tls_session_shutdown(session->tls);
@@ -470,216 +676,387 @@ static void* session_handler(void* arg) {
     }
 #endif
     close(session->socket_fd);
-    release_session_slot(session);
-    pthread_exit(NULL);
+    session->socket_fd = -1;
+    session->authenticated = 0;
+    secure_zero(session->read_buffer, MGMT_BUFFER_SIZE);
+    session->read_len = 0;
+    session->out_len = 0;
+    session->in_use = 0;
+    __atomic_sub_fetch(&server->active_sessions, 1, __ATOMIC_RELAXED);
 }
 
 /**
- * authenticate_session - Perform password authentication
+ * session_begin - Start the session once any TLS handshake is done
  *
- * Uses session's pre-allocated read_buffer - no stack/heap allocation.
+ * Metrics scrapes share the port and skip the console entirely: console
+ * clients wait for the greeting, so a client that speaks first within
+ * MGMT_METRICS_SNIFF_MS is taken for an HTTP scraper.
  */
-static int authenticate_session(mgmt_session_t *session) {
-    const char *prompt = "Password: ";
-    ssize_t bytes_read;
-    char *newline;
-    int attempts = 0;
+static void session_begin(mgmt_session_t *session) {
+    if (MGMT_METRICS_HTTP) {
+        session->state = MGMT_STATE_SNIFF;
+        timer_wheel_add(&session->server->timers, &session->timer,
+                        latency_now_ms() + MGMT_METRICS_SNIFF_MS);
+        return;
+    }
+    session_greet(session);
+}
 
-    while (attempts < 3) {
-        /* Send prompt (using TLS if enabled - FSM-006 fix) */
-        mgmt_write(session, prompt, strlen(prompt));
+/**
+ * session_greet - Send the banner and ask for the password
+ */
+static void session_greet(mgmt_session_t *session) {
+    const char *welcome = "XOE Management Console v1.0\nPassword: ";
 
-        /* Read password into pre-allocated buffer (blocking, with bounds check) */
-        bytes_read = mgmt_read(session, session->read_buffer,
-                              MGMT_BUFFER_SIZE - 1);
-        if (bytes_read <= 0) {
-            return 0; /* Connection closed */
-        }
+    session->state = MGMT_STATE_AUTH;
+    timer_wheel_add(&session->server->timers, &session->timer,
+                    latency_now_ms() + MGMT_LOGIN_TIMEOUT_SEC * 1000);
+    mgmt_write(session, welcome, strlen(welcome));
+}
+
+#if TLS_ENABLED
+/**
+ * session_handshake - Advance the TLS handshake
+ */
+static void session_handshake(mgmt_session_t *session) {
+    int result;
+    int want_write;
 
-        session->read_buffer[bytes_read] = '\0';
+    result = tls_session_handshake_step(session->tls);
+    if (result < 0) {
+        session_close(session);
+        return;
+    }
 
-        /* Strip newline */
-        newline = strchr(session->read_buffer, '\n');
-        if (newline != NULL) {
-            *newline = '\0';
-        }
-        newline = strchr(session->read_buffer, '\r');
-        if (newline != NULL) {
-            *newline = '\0';
+    if (result == 0) {
+        session_begin(session);
+        /* The client's first bytes may already sit in the TLS buffer */
+        session_on_readable(session);
+        if (session->in_use) {
+            session_settle(session);
         }
+        return;
+    }
 
-        /* Verify password against stored hash (constant-time comparison) */
-        if (password_verify(session->read_buffer, session->password) == 1) {
-            /* Clear password from buffer immediately (NET-015 fix) */
-            secure_zero(session->read_buffer, MGMT_BUFFER_SIZE);
-            mgmt_write(session, "Authentication successful\n\n", 27);
-            session->authenticated = 1;
-            return 1;
-        }
+    want_write = (result == TLS_HANDSHAKE_WANT_WRITE);
+    if (want_write != session->want_write) {
+        event_poller_set_write(&session->server->poller, session->socket_fd,
+                               session, want_write);
+        session->want_write = want_write;
+    }
+}
+#endif
 
-        /* Clear password from buffer after failed attempt (NET-015 fix) */
-        secure_zero(session->read_buffer, MGMT_BUFFER_SIZE);
+/**
+ * session_on_event - Handle readiness of a session socket
+ */
+static void session_on_event(mgmt_session_t *session, int readable,
+                             int writable) {
+#if TLS_ENABLED
+    if (session->state == MGMT_STATE_HANDSHAKE) {
+        session_handshake(session);
+        return;
+    }
+#endif
 
-        attempts++;
-        if (attempts < 3) {
-            const char *retry = "Incorrect password, try again\n";
-            mgmt_write(session, retry, strlen(retry));
+    (void)writable;     /* session_settle() flushes either way */
+    if (readable) {
+        session_on_readable(session);
+        if (!session->in_use) {
+            return;
         }
     }
+    session_settle(session);
+}
 
-    return 0; /* Authentication failed after 3 attempts */
+/**
+ * session_on_readable - Take the input that arrived and act on it
+ *
+ * At end of stream the output already queued gets one last try.
+ */
+static void session_on_readable(mgmt_session_t *session) {
+    ssize_t n;
+
+    do {
+        n = session_recv(session, session->read_buffer + session->read_len,
+                         MGMT_BUFFER_SIZE - 1 - session->read_len);
+        if (n == MGMT_IO_AGAIN) {
+            return;
+        }
+        if (n <= 0) {
+            session_flush(session);
+            session_close(session);
+            return;
+        }
+        session->read_len += (size_t)n;
+        session_process(session);
+#if TLS_ENABLED
+    } while (session->tls != NULL && SSL_pending(session->tls) > 0);
+#else
+    } while (0);
+#endif
 }
 
 /**
- * acquire_session_slot - Acquire session from pool
+ * session_process - Consume buffered input according to the state
+ *
+ * Console input is taken a line at a time; a line that fills the buffer
+ * is taken as it is.
  */
-static mgmt_session_t* acquire_session_slot(mgmt_server_t *server) {
-    mgmt_session_t *slot = NULL;
-    int i;
+static void session_process(mgmt_session_t *session) {
+    char *newline;
+    size_t line_len;
+    size_t consumed;
+
+    for (;;) {
+        switch (session->state) {
+            case MGMT_STATE_SNIFF:
+                if (session->read_len < 4 &&
+                    memcmp(session->read_buffer, "GET ",
+                           session->read_len) == 0) {
+                    return;     /* Could still be HTTP */
+                }
+                if (memcmp(session->read_buffer, "GET ", 4) == 0) {
+                    session->state = MGMT_STATE_HTTP;
+                    timer_wheel_add(&session->server->timers, &session->timer,
+                                    latency_now_ms() +
+                                    MGMT_LOGIN_TIMEOUT_SEC * 1000);
+                } else {
+                    session_greet(session);
+                }
+                continue;
 
-    pthread_mutex_lock(&server->session_mutex);
-    for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
-        if (!server->sessions[i].in_use) {
-            server->sessions[i].in_use = 1;
-            server->sessions[i].authenticated = 0;
-            slot = &server->sessions[i];
-            break;
+            case MGMT_STATE_HTTP:
+                /* Take the request head (the scrape sends no body) */
+                session->read_buffer[session->read_len] = '\0';
+                if (strstr(session->read_buffer, "\r\n\r\n") == NULL &&
+                    strstr(session->read_buffer, "\n\n") == NULL &&
+                    session->read_len < MGMT_BUFFER_SIZE - 1) {
+                    return;
+                }
+                mgmt_serve_metrics_http(session);
+                session->state = MGMT_STATE_CLOSING;
+                session->read_len = 0;
+                return;
+
+            case MGMT_STATE_AUTH:
+            case MGMT_STATE_COMMAND:
+            case MGMT_STATE_WATCH:
+                break;
+
+            default:
+                /* Handshake or closing: input is not wanted */
+                session->read_len = 0;
+                return;
+        }
+
+        newline = memchr(session->read_buffer, '\n', session->read_len);
+        if (newline != NULL) {
+            line_len = (size_t)(newline - session->read_buffer);
+            consumed = line_len + 1;
+        } else if (session->read_len == MGMT_BUFFER_SIZE - 1) {
+            line_len = session->read_len;
+            consumed = line_len;
+        } else {
+            return;
         }
+
+        session->read_buffer[line_len] = '\0';
+        newline = strchr(session->read_buffer, '\r');
+        if (newline != NULL) {
+            *newline = '\0';
+        }
+        session_line(session, session->read_buffer);
+
+        /* Clear what was consumed: it may have been a password (NET-015) */
+        memmove(session->read_buffer, session->read_buffer + consumed,
+                session->read_len - consumed);
+        session->read_len -= consumed;
+        secure_zero(session->read_buffer + session->read_len, consumed);
     }
-    pthread_mutex_unlock(&server->session_mutex);
+}
 
-    return slot;
+/**
+ * session_line - Act on one input line
+ */
+static void session_line(mgmt_session_t *session, char *line) {
+    mgmt_server_t *server = session->server;
+
+    switch (session->state) {
+        case MGMT_STATE_AUTH:
+            /* Verify password against stored hash (constant-time comparison) */
+            if (password_verify(line, session->password) == 1) {
+                timer_wheel_cancel(&server->timers, &session->timer);
+                session->authenticated = 1;
+                /* Clear any previous failures on successful auth */
+                clear_auth_failure(server, &session->client_key);
+                mgmt_write(session, "Authentication successful\n\n", 27);
+                session->state = MGMT_STATE_COMMAND;
+                session_prompt(session);
+                return;
+            }
+
+            session->auth_attempts++;
+            if (session->auth_attempts < 3) {
+                const char *retry = "Incorrect password, try again\nPassword: ";
+                mgmt_write(session, retry, strlen(retry));
+                return;
+            }
+
+            mgmt_write(session, "Authentication failed\n", 22);
+            /* Record auth failure for rate limiting (NET-004, FSM-009 fix) */
+            record_auth_failure(server, &session->client_key);
+            session->state = MGMT_STATE_CLOSING;
+            return;
+
+        case MGMT_STATE_WATCH:
+            /* Any line ends the watch; a command on it still runs */
+            timer_wheel_cancel(&server->timers, &session->timer);
+            session->state = MGMT_STATE_COMMAND;
+            mgmt_write(session, "Watch stopped\n", 14);
+            /* fall through */
+
+        case MGMT_STATE_COMMAND:
+            if (mgmt_command_line(session, line) != 0) {
+                session->state = MGMT_STATE_CLOSING;
+                return;
+            }
+            if (session->state == MGMT_STATE_WATCH) {
+                timer_wheel_add(&server->timers, &session->timer,
+                                latency_now_ms() + session->watch_interval_ms);
+                return;
+            }
+            session_prompt(session);
+            return;
+
+        default:
+            return;
+    }
 }
 
 /**
- * release_session_slot - Release session back to pool
+ * session_prompt - Send the prompt, saying first if output was dropped
  */
-static void release_session_slot(mgmt_session_t *session) {
-    if (session != NULL) {
-        session->in_use = 0;
-        session->socket_fd = -1;
-        session->authenticated = 0;
+static void session_prompt(mgmt_session_t *session) {
+    const char *dropped = "[output truncated: raise MGMT_OUTPUT_SIZE]\n";
+    const char *prompt = "xoe> ";
+
+    if (session->out_dropped) {
+        session_queue(session, dropped, strlen(dropped), MGMT_OUTPUT_SIZE);
+        session->out_dropped = 0;
     }
+    session_queue(session, prompt, strlen(prompt), MGMT_OUTPUT_SIZE);
 }
 
 /**
- * check_rate_limit - Check if IP is allowed to attempt authentication
+ * session_settle - Send what the socket takes and track write interest
  *
- * Returns 1 if allowed, 0 if rate limited (locked out).
- * Automatically clears expired lockouts.
+ * A closing session is closed once its output is gone.
  */
-static int check_rate_limit(mgmt_server_t *server, in_addr_t ip) {
-    int i;
-    time_t now;
-    int allowed = 1;
+static void session_settle(mgmt_session_t *session) {
+    int want_write;
 
-    if (server == NULL) {
-        return 1;
+    session_flush(session);
+    if (session->state == MGMT_STATE_CLOSING && session->out_len == 0) {
+        session_close(session);
+        return;
     }
 
-    now = time(NULL);
+    want_write = (session->out_len > 0);
+    if (want_write != session->want_write) {
+        event_poller_set_write(&session->server->poller, session->socket_fd,
+                               session, want_write);
+        session->want_write = want_write;
+    }
+}
 
-    pthread_mutex_lock(&server->rate_limit_mutex);
+/**
+ * session_timer_expired - Sniff period over, watch tick, or deadline
+ */
+static void session_timer_expired(timer_wheel_timer_t *timer, void *arg) {
+    mgmt_session_t *session = (mgmt_session_t*)arg;
+    mgmt_server_t *server = session->server;
+
+    (void)timer;
+    switch (session->state) {
+        case MGMT_STATE_SNIFF:
+            /* Quiet so far: a console client */
+            session_greet(session);
+            session_process(session);
+            break;
 
-    for (i = 0; i < MGMT_RATE_LIMIT_ENTRIES; i++) {
-        if (server->rate_limits[i].ip_addr == ip) {
-            /* Check if lockout has expired */
-            if (server->rate_limits[i].lockout_until > 0) {
-                if (now < server->rate_limits[i].lockout_until) {
-                    /* Still locked out */
-                    allowed = 0;
-                } else {
-                    /* Lockout expired, clear entry */
-                    server->rate_limits[i].ip_addr = 0;
-                    server->rate_limits[i].failure_count = 0;
-                    server->rate_limits[i].lockout_until = 0;
-                }
+        case MGMT_STATE_WATCH:
+            /* A watcher that has not taken the last line skips this one;
+             * the next line covers both intervals */
+            if (session->out_len == 0) {
+                mgmt_watch_tick(session);
             }
+            timer_wheel_add(&server->timers, &session->timer,
+                            latency_now_ms() + session->watch_interval_ms);
+            break;
+
+        case MGMT_STATE_HANDSHAKE:
+            session_close(session);
+            return;
+
+        case MGMT_STATE_AUTH:
+            mgmt_write(session, "\nLogin timed out\n", 17);
+            session->state = MGMT_STATE_CLOSING;
+            break;
+
+        default:
+            /* HTTP request head never completed */
+            session->state = MGMT_STATE_CLOSING;
             break;
-        }
     }
+    session_settle(session);
+}
 
-    pthread_mutex_unlock(&server->rate_limit_mutex);
+/**
+ * check_rate_limit - Check if an address is allowed to attempt authentication
+ *
+ * Returns 1 if allowed, 0 if rate limited (locked out).
+ * A lockout ends when the address regains an attempt.
+ */
+static int check_rate_limit(mgmt_server_t *server, const rate_limit_key_t *key) {
+    if (server == NULL) {
+        return 1;
+    }
 
-    return allowed;
+    return !rate_limiter_blocked(&server->auth_limiter, key);
 }
 
 /**
  * record_auth_failure - Record failed authentication attempt
  *
- * Increments failure count for IP. If threshold reached, sets lockout.
- * Uses LRU-style replacement if table is full.
+ * Spends one of the address's MGMT_RATE_LIMIT_FAILURES attempts; with none
+ * left it is locked out. The limiter evicts the least recently seen
+ * address when full, so tracking never stops for an active attacker.
  */
-static void record_auth_failure(mgmt_server_t *server, in_addr_t ip) {
-    int i;
-    int found = -1;
-    int empty = -1;
-    time_t now;
-
+static void record_auth_failure(mgmt_server_t *server,
+                                const rate_limit_key_t *key) {
     if (server == NULL) {
         return;
     }
 
-    now = time(NULL);
-
-    pthread_mutex_lock(&server->rate_limit_mutex);
-
-    /* Find existing entry or empty slot */
-    for (i = 0; i < MGMT_RATE_LIMIT_ENTRIES; i++) {
-        if (server->rate_limits[i].ip_addr == ip) {
-            found = i;
-            break;
-        }
-        if (empty < 0 && server->rate_limits[i].ip_addr == 0) {
-            empty = i;
-        }
+    rate_limiter_allow(&server->auth_limiter, key);
+    if (rate_limiter_blocked(&server->auth_limiter, key)) {
+        fprintf(stderr, "Rate limit: IP locked out for %d seconds\n",
+                MGMT_RATE_LIMIT_LOCKOUT);
     }
-
-    if (found >= 0) {
-        /* Increment existing entry */
-        server->rate_limits[found].failure_count++;
-        if (server->rate_limits[found].failure_count >= MGMT_RATE_LIMIT_FAILURES) {
-            server->rate_limits[found].lockout_until = now + MGMT_RATE_LIMIT_LOCKOUT;
-            fprintf(stderr, "Rate limit: IP locked out for %d seconds\n",
-                    MGMT_RATE_LIMIT_LOCKOUT);
-        }
-    } else if (empty >= 0) {
-        /* Create new entry in empty slot */
-        server->rate_limits[empty].ip_addr = ip;
-        server->rate_limits[empty].failure_count = 1;
-        server->rate_limits[empty].lockout_until = 0;
-    } else {
-        /* Table full, overwrite first entry (simple replacement policy) */
-        server->rate_limits[0].ip_addr = ip;
-        server->rate_limits[0].failure_count = 1;
-        server->rate_limits[0].lockout_until = 0;
-    }
-
-    pthread_mutex_unlock(&server->rate_limit_mutex);
 }
 
 /**
  * clear_auth_failure - Clear auth failure record on successful login
  *
- * Removes the IP from rate limit tracking after successful authentication.
+ * Restores the address's full attempt budget after successful
+ * authentication.
  */
-static void clear_auth_failure(mgmt_server_t *server, in_addr_t ip) {
-    int i;
-
+static void clear_auth_failure(mgmt_server_t *server,
+                               const rate_limit_key_t *key) {
     if (server == NULL) {
         return;
     }
 
-    pthread_mutex_lock(&server->rate_limit_mutex);
-
-    for (i = 0; i < MGMT_RATE_LIMIT_ENTRIES; i++) {
-        if (server->rate_limits[i].ip_addr == ip) {
-            server->rate_limits[i].ip_addr = 0;
-            server->rate_limits[i].failure_count = 0;
-            server->rate_limits[i].lockout_until = 0;
-            break;
-        }
-    }
-
-    pthread_mutex_unlock(&server->rate_limit_mutex);
+    rate_limiter_forget(&server->auth_limiter, key);
 }
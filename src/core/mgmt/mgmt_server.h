@@ -11,7 +11,9 @@
  * and handles up to MAX_MGMT_SESSIONS concurrent sessions.
  *
  * Protocol: Line-oriented text commands (telnet-compatible)
- * Threading: Dedicated listener thread + per-session handler threads
+ * Threading: One event loop thread for the listener and every session
+ * (non-blocking sockets, output queued per session), so `watch` monitors
+ * cost a pre-allocated slot each rather than a thread
  */
 
 /* Opaque server structure (implementation in mgmt_server.c) */
@@ -21,7 +23,8 @@ typedef struct mgmt_server_t mgmt_server_t;
  * mgmt_server_start - Start management server
  *
  * Creates and initializes management server, binds to specified port,
- * and spawns listener thread. Returns immediately - server runs in background.
+ * and spawns the event loop thread. Returns immediately - server runs in
+ * background.
  *
  * Parameters:
  *   config - Application configuration (port, password)
@@ -42,14 +45,14 @@ mgmt_server_t* mgmt_server_start(xoe_config_t *config);
 /**
  * mgmt_server_stop - Stop management server
  *
- * Signals shutdown to listener thread and all session threads,
- * waits for graceful exit, and frees all resources.
+ * Wakes the event loop thread, which closes every session and exits,
+ * joins it, and frees all resources.
  *
  * Parameters:
  *   server - Management server instance (NULL safe)
  *
  * Thread Safety:
- *   Blocks until all threads exit. Safe to call from main thread.
+ *   Blocks until the loop thread exits. Safe to call from main thread.
  */
 void mgmt_server_stop(mgmt_server_t *server);
 
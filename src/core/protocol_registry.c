@@ -0,0 +1,453 @@
+/**
+ * protocol_registry.c
+ *
+ * Server-side protocol dispatch table and per-protocol worker pools.
+ *
+ * The table has two levels keyed by the high and low byte of the
+ * protocol id, so the sparse ids in use (0x0000-0x0003, 0xFF00) cost two
+ * 256-entry pages instead of a 64K array. Frames of pool handlers are
+ * tasks of one shared work pool (lib/common/work_pool.h), submitted on
+ * the connection's sequence (client->pool_seq), which keeps its frames in
+ * order while any idle pool thread may run them. Replies from pool
+ * threads wait on one global list until the owning worker flushes them. A
+ * queued frame's payload counts towards its connection's memory account
+ * until the handler has run.
+ *
+ * [LLM-ARCH]
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "lib/common/definitions.h"
+#include "lib/common/log.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/work_pool.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_format.h"
+#include "core/event_loop.h"
+#include "core/protocol_registry.h"
+
+/* One frame waiting for, or being handled on, a pool thread */
+typedef struct {
+    work_task_t task;           /* In the client's sequence */
+    const protocol_handler_t *handler;
+    client_info_t *client;
+    xoe_packet_t packet;        /* Holds one payload reference */
+    uint32_t charged;           /* Bytes charged to the client's account */
+} pool_job_t;
+
+/* A registered handler */
+typedef struct {
+    const protocol_handler_t *handler;
+    int pooled;                 /* Frames go to the pool (once started) */
+} registry_entry_t;
+
+/* A reply queued by a pool thread */
+typedef struct pending_reply {
+    client_info_t *client;
+    void *owner;                /* client->loop_owner when queued */
+    xoe_packet_t packet;        /* Holds one payload reference */
+    struct pending_reply *next;
+} pending_reply_t;
+
+static registry_entry_t g_entries[PROTOCOL_REGISTRY_MAX];
+static int g_entry_count = 0;
+static registry_entry_t g_default = {NULL, FALSE};
+static registry_entry_t **g_pages[256];    /* [id >> 8][id & 0xFF] */
+static int g_started = FALSE;
+
+static work_pool_t g_pool;                 /* Threads of every pool handler */
+static int g_pool_started = FALSE;
+
+static pthread_mutex_t g_reply_lock = PTHREAD_MUTEX_INITIALIZER;
+static pending_reply_t *g_reply_head = NULL;
+static pending_reply_t *g_reply_tail = NULL;
+
+/**
+ * lookup_entry - Table entry for a protocol id, else the default
+ */
+static registry_entry_t *lookup_entry(uint16_t protocol_id) {
+    registry_entry_t **page = g_pages[protocol_id >> 8];
+
+    if (page != NULL && page[protocol_id & 0xFF] != NULL) {
+        return page[protocol_id & 0xFF];
+    }
+    return (g_default.handler != NULL) ? &g_default : NULL;
+}
+
+/**
+ * handler_valid - Check a handler's fields
+ */
+static int handler_valid(const protocol_handler_t *handler) {
+    if (handler == NULL || handler->handle_packet == NULL) {
+        return FALSE;
+    }
+    if (handler->dispatch == XOE_DISPATCH_INLINE) {
+        return TRUE;
+    }
+    return (handler->dispatch == XOE_DISPATCH_POOL &&
+            handler->pool_threads >= 1 &&
+            handler->pool_threads <= PROTOCOL_POOL_THREADS_MAX);
+}
+
+/**
+ * protocol_registry_register - Add a handler to the table
+ */
+int protocol_registry_register(const protocol_handler_t *handler) {
+    registry_entry_t **page;
+    registry_entry_t *entry;
+
+    if (!handler_valid(handler)) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (g_started || g_entry_count >= PROTOCOL_REGISTRY_MAX) {
+        return E_INVALID_STATE;
+    }
+
+    page = g_pages[handler->protocol_id >> 8];
+    if (page == NULL) {
+        page = (registry_entry_t **)calloc(256, sizeof(*page));
+        if (page == NULL) {
+            return E_OUT_OF_MEMORY;
+        }
+        g_pages[handler->protocol_id >> 8] = page;
+    }
+    if (page[handler->protocol_id & 0xFF] != NULL) {
+        return E_DEVICE_BUSY;
+    }
+
+    entry = &g_entries[g_entry_count++];
+    entry->handler = handler;
+    entry->pooled = FALSE;
+    page[handler->protocol_id & 0xFF] = entry;
+    return 0;
+}
+
+/**
+ * protocol_registry_set_default - Handler for unregistered protocol ids
+ */
+int protocol_registry_set_default(const protocol_handler_t *handler) {
+    if (handler != NULL && !handler_valid(handler)) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (g_started) {
+        return E_INVALID_STATE;
+    }
+    g_default.handler = handler;
+    g_default.pooled = FALSE;
+    return 0;
+}
+
+/**
+ * protocol_registry_lookup - Handler for a protocol id
+ */
+const protocol_handler_t *protocol_registry_lookup(uint16_t protocol_id) {
+    registry_entry_t *entry = lookup_entry(protocol_id);
+
+    return (entry != NULL) ? entry->handler : NULL;
+}
+
+/**
+ * pool_job_free - Release a job's payload, memory charge and itself
+ */
+static void pool_job_free(pool_job_t *job) {
+    xoe_wire_free_payload(&job->packet);
+    mem_account_uncharge(&job->client->mem, job->charged);
+    free(job);
+}
+
+/**
+ * pool_job_run - Handle one queued frame (work_task_fn, on a pool thread)
+ */
+static void pool_job_run(work_task_t *task, void *arg) {
+    pool_job_t *job = (pool_job_t *)arg;
+    int result;
+
+    (void)task;
+    result = job->handler->handle_packet(job->client, &job->packet);
+    if (result != 0) {
+        /* The owning worker sees the hangup and releases it, which
+         * waits for this job to finish */
+        LOG_WARN("%s handler closing %s:%d: %d", job->handler->name,
+                 job->client->client_ip,
+                 ntohs(job->client->client_addr.sin_port), result);
+        shutdown(job->client->client_socket, SHUT_RDWR);
+    }
+    pool_job_free(job);
+}
+
+/**
+ * pool_job_drop - Forget a frame of a closing connection (work_task_fn)
+ */
+static void pool_job_drop(work_task_t *task, void *arg) {
+    (void)task;
+    pool_job_free((pool_job_t *)arg);
+}
+
+/**
+ * all_entries - Visit the registered entries and the default one
+ * @index: 0 .. g_entry_count (the last is the default)
+ *
+ * Returns: Entry, or NULL for an empty default
+ */
+static registry_entry_t *all_entries(int index) {
+    if (index < g_entry_count) {
+        return &g_entries[index];
+    }
+    return (g_default.handler != NULL) ? &g_default : NULL;
+}
+
+/**
+ * protocol_registry_start - Start the pool of XOE_DISPATCH_POOL handlers
+ *
+ * One work pool serves them all, with as many threads as they ask for
+ * together (up to PROTOCOL_POOL_THREADS_MAX).
+ */
+int protocol_registry_start(void) {
+    registry_entry_t *entry;
+    int threads = 0;
+    int result;
+    int i;
+
+    if (g_started) {
+        return E_INVALID_STATE;
+    }
+
+    for (i = 0; i <= g_entry_count; i++) {
+        entry = all_entries(i);
+        if (entry != NULL && entry->handler->dispatch == XOE_DISPATCH_POOL) {
+            threads += entry->handler->pool_threads;
+        }
+    }
+    if (threads > PROTOCOL_POOL_THREADS_MAX) {
+        threads = PROTOCOL_POOL_THREADS_MAX;
+    }
+
+    if (threads > 0) {
+        result = work_pool_start(&g_pool, threads,
+                                 threads * PROTOCOL_POOL_QUEUE_MAX);
+        if (result != 0) {
+            LOG_ERROR("Cannot start the protocol pool threads");
+            return result;
+        }
+        g_pool_started = TRUE;
+    }
+    for (i = 0; i <= g_entry_count; i++) {
+        entry = all_entries(i);
+        if (entry != NULL && entry->handler->dispatch == XOE_DISPATCH_POOL) {
+            entry->pooled = TRUE;
+        }
+    }
+
+    g_started = TRUE;
+    return 0;
+}
+
+/**
+ * protocol_registry_cleanup - Stop the pools and forget every handler
+ */
+void protocol_registry_cleanup(void) {
+    int i;
+
+    if (g_pool_started) {
+        work_pool_stop(&g_pool);
+        g_pool_started = FALSE;
+    }
+    for (i = 0; i < 256; i++) {
+        free(g_pages[i]);
+        g_pages[i] = NULL;
+    }
+    memset(g_entries, 0, sizeof(g_entries));
+    g_entry_count = 0;
+    g_default.handler = NULL;
+    g_default.pooled = FALSE;
+    g_started = FALSE;
+}
+
+/**
+ * protocol_registry_dispatch - Hand one frame to its protocol's handler
+ *
+ * A pool handler that has no pool yet (before protocol_registry_start())
+ * runs inline.
+ */
+int protocol_registry_dispatch(client_info_t *client, xoe_packet_t *packet) {
+    registry_entry_t *entry;
+    pool_job_t *job;
+
+    entry = lookup_entry(packet->protocol_id);
+    if (entry == NULL) {
+        LOG_WARN("No handler for protocol 0x%04x from %s:%d",
+                 packet->protocol_id, client->client_ip,
+                 ntohs(client->client_addr.sin_port));
+        return E_NOT_SUPPORTED;
+    }
+    if (!entry->pooled) {
+        return entry->handler->handle_packet(client, packet);
+    }
+
+    job = (pool_job_t *)malloc(sizeof(*job));
+    if (job == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    job->handler = entry->handler;
+    job->client = client;
+    job->packet = *packet;
+    if (packet->payload != NULL) {
+        job->packet.payload = xoe_payload_ref(packet->payload);
+        if (job->packet.payload == NULL) {
+            free(job);
+            return E_OUT_OF_MEMORY;
+        }
+    }
+    job->charged = (job->packet.payload != NULL) ? job->packet.payload->len
+                                                 : 0;
+    mem_account_charge(&client->mem, job->charged);
+
+    work_task_init(&job->task, pool_job_run, job);
+    work_pool_submit(&g_pool, &client->pool_seq, &job->task);
+    return 0;
+}
+
+/**
+ * protocol_registry_reply - Queue a reply for the worker owning @client
+ */
+int protocol_registry_reply(client_info_t *client, const xoe_packet_t *packet) {
+    pending_reply_t *reply;
+    void *owner;
+
+    if (client == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    reply = (pending_reply_t *)malloc(sizeof(*reply));
+    if (reply == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    reply->client = client;
+    reply->owner = client->loop_owner;
+    reply->packet = *packet;
+    reply->next = NULL;
+    if (packet->payload != NULL) {
+        reply->packet.payload = xoe_payload_ref(packet->payload);
+        if (reply->packet.payload == NULL) {
+            free(reply);
+            return E_OUT_OF_MEMORY;
+        }
+    }
+    owner = reply->owner;
+
+    pthread_mutex_lock(&g_reply_lock);
+    if (g_reply_tail != NULL) {
+        g_reply_tail->next = reply;
+    } else {
+        g_reply_head = reply;
+    }
+    g_reply_tail = reply;
+    pthread_mutex_unlock(&g_reply_lock);
+
+    event_loop_kick(owner);
+    return 0;
+}
+
+/**
+ * take_replies - Unlink the replies matching @owner or @client, in order
+ * @owner: Owner to match (ignored when @client is set)
+ * @client: Client to match, or NULL
+ *
+ * Returns: The unlinked replies
+ */
+static pending_reply_t *take_replies(void *owner, const client_info_t *client) {
+    pending_reply_t *taken = NULL;
+    pending_reply_t **taken_tail = &taken;
+    pending_reply_t **link;
+    pending_reply_t *reply;
+
+    pthread_mutex_lock(&g_reply_lock);
+    link = &g_reply_head;
+    g_reply_tail = NULL;
+    while ((reply = *link) != NULL) {
+        if ((client != NULL) ? (reply->client == client)
+                             : (reply->owner == owner)) {
+            *link = reply->next;
+            reply->next = NULL;
+            *taken_tail = reply;
+            taken_tail = &reply->next;
+        } else {
+            g_reply_tail = reply;
+            link = &reply->next;
+        }
+    }
+    pthread_mutex_unlock(&g_reply_lock);
+    return taken;
+}
+
+/**
+ * protocol_registry_flush - Send the replies queued for @owner's clients
+ */
+void protocol_registry_flush(void *owner, protocol_send_fn send) {
+    pending_reply_t *reply;
+    pending_reply_t *next;
+    client_info_t *failed = NULL;
+
+    for (reply = take_replies(owner, NULL); reply != NULL; reply = next) {
+        next = reply->next;
+        if (reply->client != failed &&
+            send(reply->client, &reply->packet) != 0) {
+            failed = reply->client;
+        }
+        xoe_wire_free_payload(&reply->packet);
+        free(reply);
+    }
+}
+
+/**
+ * protocol_registry_pending - Check for frames or replies in flight
+ */
+int protocol_registry_pending(client_info_t *client) {
+    pending_reply_t *reply;
+    int pending;
+
+    pending = g_pool_started && work_seq_busy(&g_pool, &client->pool_seq);
+
+    pthread_mutex_lock(&g_reply_lock);
+    for (reply = g_reply_head; reply != NULL && !pending; reply = reply->next) {
+        pending = (reply->client == client);
+    }
+    pthread_mutex_unlock(&g_reply_lock);
+
+    return pending;
+}
+
+/**
+ * protocol_registry_release - Detach a closing connection from every handler
+ */
+void protocol_registry_release(client_info_t *client) {
+    registry_entry_t *entry;
+    pending_reply_t *reply;
+    pending_reply_t *next;
+    int i;
+
+    if (g_pool_started) {
+        (void)work_seq_cancel(&g_pool, &client->pool_seq, pool_job_drop);
+        work_seq_wait(&g_pool, &client->pool_seq);
+    }
+
+    /* No pool thread can queue for it any more */
+    for (reply = take_replies(NULL, client); reply != NULL; reply = next) {
+        next = reply->next;
+        xoe_wire_free_payload(&reply->packet);
+        free(reply);
+    }
+
+    for (i = 0; i <= g_entry_count; i++) {
+        entry = all_entries(i);
+        if (entry != NULL && entry->handler->cleanup_session != NULL) {
+            entry->handler->cleanup_session(client);
+        }
+    }
+}
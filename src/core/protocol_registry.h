@@ -0,0 +1,161 @@
+/**
+ * protocol_registry.h
+ *
+ * Server-side protocol dispatch table.
+ *
+ * Every frame a connection receives is handed to the protocol_handler_t
+ * (lib/protocol/protocol.h) registered for its protocol_id, looked up by
+ * indexing the table with the id; ids without a handler go to the
+ * default handler (the echo). The receive path therefore costs the same
+ * for every protocol, and adding one is a registration, not another
+ * branch in server_handle_packet().
+ *
+ * An XOE_DISPATCH_INLINE handler runs on the event loop worker that
+ * received the frame. XOE_DISPATCH_POOL handlers share one work-stealing
+ * pool (lib/common/work_pool.h), started by protocol_registry_start()
+ * with the threads they ask for together: the worker queues the frame
+ * (sharing its payload through xoe_payload_ref()) and moves on to the
+ * next one. A connection's frames are one sequence, so they still run
+ * one at a time and in order, but on whichever pool thread is free: a
+ * busy connection no longer holds up the others that happened to share
+ * its thread, and idle threads steal what waits behind it. A full pool
+ * makes the worker wait for room, which throttles the connections
+ * feeding a saturated protocol instead of buffering without bound.
+ *
+ * Connections stay owned by their worker (core/event_loop.h): pool
+ * handlers queue replies with protocol_registry_reply() and the worker,
+ * woken through event_loop_kick(), sends them from server_flush_outbox().
+ * A pool handler that fails shuts the socket down, as
+ * disconnect_all_clients() does, and the worker closes the connection.
+ *
+ * Handlers are registered while the server is single-threaded, before
+ * protocol_registry_start(); the table is read without locks afterwards.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef CORE_PROTOCOL_REGISTRY_H
+#define CORE_PROTOCOL_REGISTRY_H
+
+#include "core/server.h"
+#include "lib/protocol/protocol.h"
+
+/* Handlers registered at once (default handler not counted) */
+#define PROTOCOL_REGISTRY_MAX 32
+
+/* Threads one pool handler may ask for, and the shared pool's limit */
+#define PROTOCOL_POOL_THREADS_MAX 16
+
+/* Frames waiting per pool thread before the receiving worker blocks */
+#define PROTOCOL_POOL_QUEUE_MAX 256
+
+/**
+ * protocol_send_fn - Send a queued reply on the owning worker
+ * @client: Destination connection
+ * @packet: Reply frame
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+typedef int (*protocol_send_fn)(client_info_t *client,
+                                const xoe_packet_t *packet);
+
+/**
+ * protocol_registry_register - Add a handler to the table
+ * @handler: Handler (must stay valid until protocol_registry_cleanup())
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT for a handler without
+ *          handle_packet() or with a bad dispatch or pool size,
+ *          E_DEVICE_BUSY if the protocol_id already has a handler,
+ *          E_INVALID_STATE once started or with PROTOCOL_REGISTRY_MAX
+ *          handlers, E_OUT_OF_MEMORY
+ */
+int protocol_registry_register(const protocol_handler_t *handler);
+
+/**
+ * protocol_registry_set_default - Handler for unregistered protocol ids
+ * @handler: Handler (its protocol_id is ignored), or NULL to close
+ *           connections sending unknown protocols
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT, E_INVALID_STATE once started
+ */
+int protocol_registry_set_default(const protocol_handler_t *handler);
+
+/**
+ * protocol_registry_lookup - Handler for a protocol id
+ * @protocol_id: XOE_PROTOCOL_* id
+ *
+ * Returns: Registered handler, else the default handler (may be NULL)
+ */
+const protocol_handler_t *protocol_registry_lookup(uint16_t protocol_id);
+
+/**
+ * protocol_registry_start - Start the pool of XOE_DISPATCH_POOL handlers
+ *
+ * Returns: 0 on success, negative error code if a thread could not be
+ *          started (those started so far are stopped again)
+ */
+int protocol_registry_start(void);
+
+/**
+ * protocol_registry_cleanup - Stop the pools and forget every handler
+ *
+ * Call once no connection is left (after event_loop_cleanup()); the
+ * registry can then be filled and started again.
+ */
+void protocol_registry_cleanup(void);
+
+/**
+ * protocol_registry_dispatch - Hand one frame to its protocol's handler
+ * @client: Connection the frame arrived on
+ * @packet: Frame (payload still owned by the caller)
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *          (an inline handler's result; E_NOT_SUPPORTED without a
+ *          handler; E_OUT_OF_MEMORY if a pool frame cannot be queued)
+ *
+ * Called by the worker owning @client. Pool frames are queued and the
+ * call returns at once, unless the thread's queue is full.
+ */
+int protocol_registry_dispatch(client_info_t *client, xoe_packet_t *packet);
+
+/**
+ * protocol_registry_reply - Queue a reply for the worker owning @client
+ * @client: Connection (the one the pool handler is serving)
+ * @packet: Reply; its payload is shared, not copied, so it must not be
+ *          modified afterwards (the caller still frees its own reference)
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY
+ *
+ * For XOE_DISPATCH_POOL handlers. Replies to one connection are sent in
+ * the order they were queued.
+ */
+int protocol_registry_reply(client_info_t *client, const xoe_packet_t *packet);
+
+/**
+ * protocol_registry_flush - Send the replies queued for @owner's clients
+ * @owner: Event loop worker calling (client->loop_owner)
+ * @send: Sends one reply; after a failure the rest for that client are
+ *        dropped
+ */
+void protocol_registry_flush(void *owner, protocol_send_fn send);
+
+/**
+ * protocol_registry_pending - Check for frames or replies in flight
+ * @client: Connection
+ *
+ * Returns: TRUE while a pool holds a frame of @client or a reply to it
+ *          waits, else FALSE
+ */
+int protocol_registry_pending(client_info_t *client);
+
+/**
+ * protocol_registry_release - Detach a closing connection from every handler
+ * @client: Connection, on its owning worker
+ *
+ * Drops its queued frames, waits for the one a pool thread may be
+ * running, drops its unsent replies and calls every handler's
+ * cleanup_session().
+ */
+void protocol_registry_release(client_info_t *client);
+
+#endif /* CORE_PROTOCOL_REGISTRY_H */
@@ -0,0 +1,484 @@
+/**
+ * raw_relay.c
+ *
+ * Raw passthrough channels (see raw_relay.h).
+ *
+ * Every channel, waiting or relaying, is a raw_pair_t on one list under
+ * relay_lock, owned by the thread started when its first client joined.
+ * A joiner only fills in the second end and writes to the pair's wake
+ * pipe; everything else (pairing, relaying, releasing both slots, freeing
+ * the pair) happens on that thread. Whether a pair is still open to a
+ * joiner (paired FALSE) is only changed under the lock, so a client that
+ * arrives as the first one gives up is never lost.
+ *
+ * Each direction is a pipe between the two sockets: splice() moves bytes
+ * from one socket into the pipe and from the pipe into the other socket,
+ * both without blocking. A direction only reads again once its pipe has
+ * been emptied into the other socket, so one slow reader holds back at
+ * most a pipe's worth of data from its peer.
+ *
+ * [LLM-ARCH]
+ */
+
+/* splice() and F_SETPIPE_SZ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "core/raw_relay.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+#include "lib/protocol/wire_format.h"
+
+#if defined(__linux__) && defined(SPLICE_F_NONBLOCK)
+#define RAW_RELAY_SUPPORTED 1
+#else
+#define RAW_RELAY_SUPPORTED 0
+#endif
+
+#if RAW_RELAY_SUPPORTED
+
+/**
+ * raw_pair_t - One channel
+ */
+typedef struct raw_pair {
+    char name[XOE_WIRE_RAW_NAME_MAX + 1];
+    client_info_t *ends[2];         /* [0] waited, [1] joined it */
+    int paired;                     /* No longer open to a joiner */
+    int wake[2];                    /* Pipe: peer joined, or stop */
+    struct raw_pair *next;
+} raw_pair_t;
+
+/**
+ * raw_dir_t - One direction of a relaying pair
+ */
+typedef struct {
+    int from;
+    int to;
+    int pipe[2];
+    size_t queued;                  /* Bytes in the pipe */
+    int eof;                        /* @from ended its stream */
+    int shut;                       /* @to was half closed after it */
+} raw_dir_t;
+
+static pthread_mutex_t relay_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t relay_idle = PTHREAD_COND_INITIALIZER;
+static raw_pair_t *relay_pairs = NULL;
+static int relay_count = 0;
+static int relay_stopping = FALSE;
+
+/**
+ * pair_wake - Make the pair's thread look at it again
+ */
+static void pair_wake(raw_pair_t *pair) {
+    char byte = 1;
+
+    if (write(pair->wake[1], &byte, 1) < 0) {
+        /* Pipe full: a wakeup is already pending */
+    }
+}
+
+/**
+ * pair_remove - Take a pair off the list (relay_lock held)
+ */
+static void pair_remove(raw_pair_t *pair) {
+    raw_pair_t **link = &relay_pairs;
+
+    while (*link != NULL && *link != pair) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = pair->next;
+    }
+}
+
+/* A client as host:port in log messages */
+#define CLIENT_FMT "%s:%d"
+#define CLIENT_ARGS(c) (c)->client_ip, ntohs((c)->client_addr.sin_port)
+
+/**
+ * pair_wait - Wait for the second client of a channel
+ * @pair: Pair with only ends[0] set
+ *
+ * Returns: TRUE once paired; FALSE on timeout, stop, or if the waiting
+ *          client closed or sent data early. Either way the pair is no
+ *          longer open to joiners on return.
+ */
+static int pair_wait(raw_pair_t *pair) {
+    struct pollfd fds[2];
+    struct timespec now;
+    time_t deadline;
+    long remaining_ms;
+    char drain[16];
+    int stopping;
+    int n;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    deadline = now.tv_sec + RAW_RELAY_WAIT_S;
+
+    for (;;) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        remaining_ms = (long)(deadline - now.tv_sec) * 1000;
+        if (remaining_ms < 0) {
+            remaining_ms = 0;
+        }
+
+        fds[0].fd = pair->ends[0]->client_socket;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = pair->wake[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        n = poll(fds, 2, (int)remaining_ms);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        while (read(pair->wake[0], drain, sizeof(drain)) > 0) {
+        }
+
+        pthread_mutex_lock(&relay_lock);
+        stopping = relay_stopping;
+        if (pair->paired && !stopping && fds[0].revents == 0) {
+            pthread_mutex_unlock(&relay_lock);
+            return TRUE;
+        }
+        if (n > 0 && fds[0].revents == 0 && !stopping) {
+            pthread_mutex_unlock(&relay_lock);
+            continue;                       /* Stray wakeup */
+        }
+        pair->paired = TRUE;
+        pthread_mutex_unlock(&relay_lock);
+
+        if (stopping) {
+            return FALSE;
+        }
+        if (n == 0) {
+            LOG_INFO("Raw channel %s: no peer joined within %d s",
+                     pair->name, RAW_RELAY_WAIT_S);
+        } else {
+            LOG_INFO("Raw channel %s: " CLIENT_FMT " left or sent data "
+                     "before its peer joined", pair->name,
+                     CLIENT_ARGS(pair->ends[0]));
+        }
+        return FALSE;
+    }
+}
+
+/**
+ * pair_ready - Send RAW_READY to one end
+ */
+static int pair_ready(client_info_t *client) {
+    xoe_packet_t packet;
+    xoe_payload_t payload;
+    uint8_t buffer[XOE_WIRE_HELLO_SIZE];
+
+    xoe_wire_hello_init(&packet, &payload, buffer, XOE_WIRE_CTRL_RAW_READY, 0);
+    return xoe_wire_send_transport(&client->transport, &packet, 0);
+}
+
+/**
+ * dir_open - Set up one direction
+ *
+ * Returns: 0, or E_OUT_OF_MEMORY if no pipe can be created
+ */
+static int dir_open(raw_dir_t *dir, int from, int to) {
+    memset(dir, 0, sizeof(*dir));
+    dir->from = from;
+    dir->to = to;
+
+    if (pipe(dir->pipe) != 0) {
+        return E_OUT_OF_MEMORY;
+    }
+#ifdef F_SETPIPE_SZ
+    /* Best effort: the default (often 64 KiB) still works */
+    (void)fcntl(dir->pipe[1], F_SETPIPE_SZ, RAW_RELAY_PIPE_SIZE);
+#endif
+    return 0;
+}
+
+/**
+ * dir_close - Close one direction's pipe
+ */
+static void dir_close(raw_dir_t *dir) {
+    close(dir->pipe[0]);
+    close(dir->pipe[1]);
+}
+
+/**
+ * dir_wants_read - Whether the direction waits for its source
+ */
+static int dir_wants_read(const raw_dir_t *dir) {
+    return !dir->eof && dir->queued == 0;
+}
+
+/**
+ * dir_pump - Move whatever can move now, without blocking
+ *
+ * Returns: 0, or E_IO_ERROR if either socket failed
+ */
+static int dir_pump(raw_dir_t *dir) {
+    ssize_t n;
+
+    if (dir_wants_read(dir)) {
+        n = splice(dir->from, NULL, dir->pipe[1], NULL, RAW_RELAY_PIPE_SIZE,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            dir->queued = (size_t)n;
+        } else if (n == 0) {
+            dir->eof = TRUE;
+        } else if (errno != EAGAIN && errno != EINTR) {
+            return E_IO_ERROR;
+        }
+    }
+
+    while (dir->queued > 0) {
+        n = splice(dir->pipe[0], NULL, dir->to, NULL, dir->queued,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            dir->queued -= (size_t)n;
+            metrics_add(METRIC_RAW_BYTES, (uint64_t)n);
+        } else if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            break;
+        } else {
+            return E_IO_ERROR;
+        }
+    }
+
+    if (dir->eof && dir->queued == 0 && !dir->shut) {
+        shutdown(dir->to, SHUT_WR);
+        dir->shut = TRUE;
+    }
+    return 0;
+}
+
+/**
+ * pair_relay - Relay between both ends until both directions ended
+ */
+static void pair_relay(raw_pair_t *pair) {
+    raw_dir_t dirs[2];
+    struct pollfd fds[3];
+    int socks[2];
+    int i;
+
+    socks[0] = pair->ends[0]->client_socket;
+    socks[1] = pair->ends[1]->client_socket;
+
+    if (dir_open(&dirs[0], socks[0], socks[1]) != 0) {
+        return;
+    }
+    if (dir_open(&dirs[1], socks[1], socks[0]) != 0) {
+        dir_close(&dirs[0]);
+        return;
+    }
+
+    for (i = 0; i < 2; i++) {
+        (void)fd_set_nonblocking(socks[i]);
+    }
+
+    while (!dirs[0].shut || !dirs[1].shut) {
+        if (dir_pump(&dirs[0]) != 0 || dir_pump(&dirs[1]) != 0) {
+            break;
+        }
+        if (dirs[0].shut && dirs[1].shut) {
+            break;
+        }
+
+        /* Socket i is the source of dirs[i] and the target of the other */
+        for (i = 0; i < 2; i++) {
+            fds[i].fd = socks[i];
+            fds[i].events = 0;
+            fds[i].revents = 0;
+            if (dir_wants_read(&dirs[i])) {
+                fds[i].events |= POLLIN;
+            }
+            if (dirs[1 - i].queued > 0) {
+                fds[i].events |= POLLOUT;
+            }
+        }
+        fds[2].fd = pair->wake[0];
+        fds[2].events = POLLIN;
+        fds[2].revents = 0;
+
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[2].revents != 0 ||
+            (fds[0].revents & (POLLERR | POLLNVAL)) != 0 ||
+            (fds[1].revents & (POLLERR | POLLNVAL)) != 0) {
+            break;
+        }
+
+        /* Hung up both ways after its end of stream: nothing can reach it */
+        if (((fds[0].revents & POLLHUP) != 0 && dirs[0].eof) ||
+            ((fds[1].revents & POLLHUP) != 0 && dirs[1].eof)) {
+            break;
+        }
+    }
+
+    dir_close(&dirs[0]);
+    dir_close(&dirs[1]);
+}
+
+/**
+ * pair_thread_func - Wait for, then relay, one channel
+ * @arg: raw_pair_t, owned by this thread
+ */
+static void *pair_thread_func(void *arg) {
+    raw_pair_t *pair = (raw_pair_t *)arg;
+
+    if (pair_wait(pair)) {
+        if (pair_ready(pair->ends[0]) == 0 && pair_ready(pair->ends[1]) == 0) {
+            LOG_INFO("Raw channel %s: " CLIENT_FMT " and " CLIENT_FMT
+                     " paired", pair->name, CLIENT_ARGS(pair->ends[0]),
+                     CLIENT_ARGS(pair->ends[1]));
+            metrics_add(METRIC_RAW_PAIRS, 1);
+            pair_relay(pair);
+            metrics_sub(METRIC_RAW_PAIRS, 1);
+        }
+    }
+
+    server_release_client(pair->ends[0]);
+    if (pair->ends[1] != NULL) {
+        server_release_client(pair->ends[1]);
+    }
+
+    pthread_mutex_lock(&relay_lock);
+    pair_remove(pair);
+    relay_count--;
+    pthread_cond_broadcast(&relay_idle);
+    pthread_mutex_unlock(&relay_lock);
+
+    close(pair->wake[0]);
+    close(pair->wake[1]);
+    free(pair);
+    return NULL;
+}
+
+/**
+ * pair_create - Open a channel with @client waiting on it (relay_lock held)
+ *
+ * Returns: 0, or E_OUT_OF_MEMORY
+ */
+static int pair_create(client_info_t *client) {
+    raw_pair_t *pair;
+    pthread_t thread;
+    int i;
+
+    if (relay_count >= RAW_RELAY_MAX_PAIRS) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    pair = (raw_pair_t *)calloc(1, sizeof(raw_pair_t));
+    if (pair == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    if (pipe(pair->wake) != 0) {
+        free(pair);
+        return E_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < 2; i++) {
+        (void)fd_set_nonblocking(pair->wake[i]);
+    }
+    memcpy(pair->name, client->raw_name, sizeof(pair->name));
+    pair->ends[0] = client;
+
+    if (thread_sched_create(&thread, THREAD_CLASS_NET, pair_thread_func,
+                            pair) != 0) {
+        close(pair->wake[0]);
+        close(pair->wake[1]);
+        free(pair);
+        return E_OUT_OF_MEMORY;
+    }
+    pthread_detach(thread);
+
+    pair->next = relay_pairs;
+    relay_pairs = pair;
+    relay_count++;
+    return 0;
+}
+
+/**
+ * raw_relay_join - Take over a connection that joined a raw channel
+ */
+int raw_relay_join(client_info_t *client) {
+    raw_pair_t *pair;
+    int result;
+
+    if (client == NULL || client->raw_name[0] == '\0') {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&relay_lock);
+    if (relay_stopping) {
+        pthread_mutex_unlock(&relay_lock);
+        return E_INVALID_STATE;
+    }
+
+    for (pair = relay_pairs; pair != NULL; pair = pair->next) {
+        if (!pair->paired && strcmp(pair->name, client->raw_name) == 0) {
+            pair->ends[1] = client;
+            pair->paired = TRUE;
+            pair_wake(pair);
+            pthread_mutex_unlock(&relay_lock);
+            return 0;
+        }
+    }
+
+    /* The new thread takes relay_lock before it looks at the pair */
+    result = pair_create(client);
+    pthread_mutex_unlock(&relay_lock);
+
+    if (result != 0) {
+        LOG_WARN("Raw channel %s: cannot open another channel",
+                 client->raw_name);
+    }
+    return result;
+}
+
+/**
+ * raw_relay_stop_all - End every channel and wait for the relay threads
+ */
+void raw_relay_stop_all(void) {
+    raw_pair_t *pair;
+
+    pthread_mutex_lock(&relay_lock);
+    relay_stopping = TRUE;
+    for (pair = relay_pairs; pair != NULL; pair = pair->next) {
+        pair_wake(pair);
+    }
+    while (relay_count > 0) {
+        pthread_cond_wait(&relay_idle, &relay_lock);
+    }
+    relay_stopping = FALSE;
+    pthread_mutex_unlock(&relay_lock);
+}
+
+#else /* !RAW_RELAY_SUPPORTED */
+
+int raw_relay_join(client_info_t *client) {
+    (void)client;
+    return E_NOT_SUPPORTED;
+}
+
+void raw_relay_stop_all(void) {
+}
+
+#endif /* RAW_RELAY_SUPPORTED */
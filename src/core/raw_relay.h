@@ -0,0 +1,65 @@
+/**
+ * raw_relay.h
+ *
+ * Raw passthrough channels: two plain TCP clients that joined the same
+ * channel name (XOE_WIRE_CTRL_RAW_JOIN, see lib/protocol/wire_format.h)
+ * are connected back to back, and the server moves their bytes with
+ * splice() through a pipe per direction. The payload never enters user
+ * space: no framing, no checksum, no copy into a buffer of ours.
+ *
+ * The event loop hands a connection over once its RAW_JOIN is
+ * dispatched; from then on the slot belongs to this module. The first
+ * connection of a name waits up to RAW_RELAY_WAIT_S for its peer, on a
+ * thread started for the pair; the second one completes the pair, both
+ * are sent RAW_READY and that thread relays until both directions have
+ * ended. An end of stream is passed on as a half close (shutdown
+ * SHUT_WR), so each side can still read the other's last bytes; a reset
+ * or error on either side ends both. A waiting client that closes, or
+ * sends anything before RAW_READY, is dropped.
+ *
+ * Channels are not passed to a new process in an upgrade (--takeover);
+ * they end with the process that relays them.
+ *
+ * Linux only (splice); elsewhere RAW_JOIN is refused.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef CORE_RAW_RELAY_H
+#define CORE_RAW_RELAY_H
+
+#include "core/server.h"
+
+/* Seconds the first client of a channel waits for its peer */
+#define RAW_RELAY_WAIT_S 30
+
+/* Capacity asked for each direction's pipe (the kernel may round it) */
+#define RAW_RELAY_PIPE_SIZE (256 * 1024)
+
+/* Channels waiting or relaying at once */
+#define RAW_RELAY_MAX_PAIRS 256
+
+/**
+ * raw_relay_join - Take over a connection that joined a raw channel
+ * @client: Client slot, client->raw_name set, no longer on an event loop
+ *
+ * Pairs @client with the connection waiting on the same name, or makes
+ * it the one waiting. On success the slot is released by the relay once
+ * the channel ends.
+ *
+ * Returns: 0, E_NOT_SUPPORTED without splice(), E_INVALID_STATE while
+ *          stopping, E_OUT_OF_MEMORY if RAW_RELAY_MAX_PAIRS channels
+ *          are open or a thread cannot be started; the caller then still
+ *          owns @client
+ */
+int raw_relay_join(client_info_t *client);
+
+/**
+ * raw_relay_stop_all - End every channel and wait for the relay threads
+ *
+ * Joins are refused while it runs; call it once the event loops that
+ * hand connections over have stopped.
+ */
+void raw_relay_stop_all(void);
+
+#endif /* CORE_RAW_RELAY_H */
@@ -0,0 +1,534 @@
+/**
+ * @file replay_client.c
+ * @brief Re-drives a wire capture against a server
+ *
+ * [LLM-ARCH]
+ */
+
+#include "core/replay_client.h"
+#include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "lib/common/log.h"
+#include "lib/net/net_resolve.h"
+#include "lib/net/shm_link.h"
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_capture.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+#if TLS_ENABLED
+#include <openssl/ssl.h>
+#include "lib/security/tls_session.h"
+#endif
+
+/* Longest poll() wait, so stop requests are noticed promptly */
+#define REPLAY_POLL_MS 100
+
+/* Connection lookup table (power of two, at most half full) */
+#define REPLAY_SLOTS (REPLAY_MAX_CONNECTIONS * 2)
+
+/**
+ * @brief One replayed connection
+ */
+typedef struct {
+    uint32_t conn_id;           /* Connection number in the trace */
+    int fd;
+    void* tls;                  /* SSL* or NULL */
+    xoe_transport_t transport;  /* Over tls, else fd */
+    xoe_wire_decoder_t decoder;
+    int active;                 /* Open (a failed or lost connection's
+                                   frames are skipped) */
+} replay_conn_t;
+
+/**
+ * @brief State of one replay
+ */
+typedef struct {
+    const replay_config_t* config;
+    const char* host;
+    int port;
+    const sock_tune_t* tune;
+    void* tls_ctx;
+    volatile sig_atomic_t* stop;
+
+    replay_conn_t* conns;
+    int conn_count;
+    int slots[REPLAY_SLOTS];    /* Index into conns plus one, 0 = free */
+    struct pollfd* fds;
+    replay_conn_t** polled;     /* Connection of each fds entry */
+    uint8_t* fill;              /* Full-length payload of a cut frame */
+    replay_result_t* result;
+} replay_run_t;
+
+/* ============================================================================
+ * Connection Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Connect (and handshake) one connection
+ *
+ * @return 0 on success, negative error code on failure
+ */
+static int conn_open(replay_run_t* run, replay_conn_t* conn)
+{
+    int result;
+
+    conn->fd = -1;
+    conn->tls = NULL;
+
+    result = net_resolve_connect_tuned(run->host, run->port, run->tune,
+                                       &conn->fd, NULL);
+    if (result != 0) {
+        return result;
+    }
+
+#if TLS_ENABLED
+    if (run->tls_ctx != NULL) {
+        conn->tls = tls_session_create_client((SSL_CTX*)run->tls_ctx,
+                                              conn->fd);
+        if (conn->tls == NULL) {
+            shm_link_close(conn->fd);
+            conn->fd = -1;
+            return E_TLS_HANDSHAKE_FAILED;
+        }
+    }
+#endif
+
+    if (fd_set_nonblocking(conn->fd) != 0) {
+        result = E_NETWORK_ERROR;
+    } else if (xoe_wire_decoder_init(&conn->decoder, 0) != 0) {
+        result = E_OUT_OF_MEMORY;
+    } else {
+        if (conn->tls != NULL) {
+            xoe_transport_init_tls(&conn->transport, conn->tls);
+        } else {
+            xoe_transport_init_fd(&conn->transport, conn->fd);
+        }
+        conn->active = TRUE;
+        return 0;
+    }
+
+#if TLS_ENABLED
+    if (conn->tls != NULL) {
+        tls_session_destroy((SSL*)conn->tls);
+        conn->tls = NULL;
+    }
+#endif
+    shm_link_close(conn->fd);
+    conn->fd = -1;
+    return result;
+}
+
+/**
+ * @brief Close a connection and release its decoder
+ */
+static void conn_close(replay_conn_t* conn)
+{
+#if TLS_ENABLED
+    if (conn->tls != NULL) {
+        tls_session_shutdown((SSL*)conn->tls);
+        tls_session_destroy((SSL*)conn->tls);
+        conn->tls = NULL;
+    }
+#endif
+    if (conn->fd >= 0) {
+        shm_link_close(conn->fd);
+        conn->fd = -1;
+    }
+    if (conn->active) {
+        conn->active = FALSE;
+        xoe_wire_decoder_cleanup(&conn->decoder);
+    }
+}
+
+/**
+ * @brief Take a connection out of the replay after a failure
+ */
+static void conn_lost(replay_run_t* run, replay_conn_t* conn, int result)
+{
+    LOG_WARN("Replay connection %u lost: error code %d",
+             (unsigned int)conn->conn_id, result);
+    conn_close(conn);
+    run->result->lost++;
+}
+
+/**
+ * @brief Find the connection for a trace connection number, opening it on
+ *        its first frame
+ *
+ * @return Open connection, or NULL if its frames are to be skipped
+ */
+static replay_conn_t* conn_for(replay_run_t* run, uint32_t conn_id)
+{
+    replay_conn_t* conn;
+    uint32_t slot = (conn_id * 2654435761u) & (REPLAY_SLOTS - 1);
+    int result;
+
+    while (run->slots[slot] != 0) {
+        conn = &run->conns[run->slots[slot] - 1];
+        if (conn->conn_id == conn_id) {
+            return conn->active ? conn : NULL;
+        }
+        slot = (slot + 1) & (REPLAY_SLOTS - 1);
+    }
+
+    if (run->conn_count == REPLAY_MAX_CONNECTIONS) {
+        return NULL;
+    }
+
+    conn = &run->conns[run->conn_count++];
+    run->slots[slot] = run->conn_count;
+    conn->conn_id = conn_id;
+
+    result = conn_open(run, conn);
+    if (result != 0) {
+        LOG_WARN("Replay connection %u failed: error code %d",
+                 (unsigned int)conn_id, result);
+        run->result->failed++;
+        return NULL;
+    }
+    run->result->connected++;
+    return conn;
+}
+
+/**
+ * @brief Read a connection and count what the server sent
+ *
+ * @return 0, or a negative error code once the connection is unusable
+ */
+static int conn_read(replay_run_t* run, replay_conn_t* conn)
+{
+    xoe_packet_t packet;
+    int result;
+
+    do {
+        result = xoe_wire_decoder_recv_transport(&conn->decoder,
+                                                 &conn->transport);
+        if (result == E_WOULD_BLOCK) {
+            break;
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_IO_ERROR : result;
+        }
+
+        while ((result = xoe_wire_decoder_next(&conn->decoder, &packet)) == 1) {
+            run->result->frames_received++;
+            if (packet.payload != NULL) {
+                run->result->bytes_received += packet.payload->len;
+            }
+            xoe_wire_free_payload(&packet);
+        }
+        if (result < 0) {
+            return result;
+        }
+    } while (xoe_transport_pending(&conn->transport));
+
+    return 0;
+}
+
+/**
+ * @brief Wait up to @p timeout_ms for replies and read them
+ */
+static void poll_replies(replay_run_t* run, int timeout_ms)
+{
+    int count = 0;
+    int ready;
+    int result;
+    int i;
+
+    for (i = 0; i < run->conn_count; i++) {
+        if (run->conns[i].active) {
+            run->fds[count].fd = run->conns[i].fd;
+            run->fds[count].events = POLLIN;
+            run->fds[count].revents = 0;
+            run->polled[count] = &run->conns[i];
+            count++;
+        }
+    }
+
+    ready = poll(run->fds, (nfds_t)count, timeout_ms);
+    if (ready < 0 && errno != EINTR) {
+        LOG_ERROR("poll failed: errno=%d: %s", errno, strerror(errno));
+        return;
+    }
+    for (i = 0; ready > 0 && i < count; i++) {
+        if (run->fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+            result = conn_read(run, run->polled[i]);
+            if (result != 0) {
+                conn_lost(run, run->polled[i], result);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Read replies until @p due_ns (or a stop request)
+ */
+static void wait_until(replay_run_t* run, uint64_t due_ns)
+{
+    uint64_t now;
+    int timeout_ms;
+
+    for (;;) {
+        now = latency_now_ns();
+        if (now >= due_ns || (run->stop != NULL && *run->stop)) {
+            return;
+        }
+        /* Round down: busy-poll the last millisecond so frames leave on
+         * time */
+        timeout_ms = (int)((due_ns - now) / 1000000);
+        if (timeout_ms > REPLAY_POLL_MS) {
+            timeout_ms = REPLAY_POLL_MS;
+        }
+        poll_replies(run, timeout_ms);
+    }
+}
+
+/**
+ * @brief Send one captured frame
+ */
+static int conn_send(replay_run_t* run, replay_conn_t* conn,
+                     const xoe_wire_capture_record_t* record,
+                     const uint8_t* captured)
+{
+    xoe_wire_header_t header;
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    int result;
+
+    xoe_wire_deserialize_header(&header, record->header);
+
+    payload.len = record->length;
+    payload.data = (uint8_t*)captured;
+    payload.owns_data = FALSE;
+    if (record->captured < record->length) {
+        memcpy(run->fill, captured, record->captured);
+        memset(run->fill + record->captured, 0,
+               record->length - record->captured);
+        payload.data = run->fill;
+        run->result->frames_cut++;
+    }
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = header.protocol_id;
+    packet.protocol_version = header.protocol_version;
+    packet.payload = (record->length > 0) ? &payload : NULL;
+
+    /* The checksum is recomputed: a cut frame's original no longer holds */
+    result = xoe_wire_send_transport(&conn->transport, &packet, 0);
+    if (result == 0) {
+        run->result->frames_sent++;
+        run->result->bytes_sent += record->length;
+    }
+    return result;
+}
+
+/* ============================================================================
+ * Run Control
+ * ============================================================================ */
+
+void replay_config_init_defaults(replay_config_t* config)
+{
+    if (config == NULL) {
+        return;
+    }
+    memset(config, 0, sizeof(*config));
+    config->speed = REPLAY_DEFAULT_SPEED;
+}
+
+int replay_client_run(const replay_config_t* config, const char* host,
+                      int port, const sock_tune_t* tune, void* tls_ctx,
+                      volatile sig_atomic_t* stop, replay_result_t* result)
+{
+    xoe_wire_capture_reader_t reader;
+    const xoe_wire_capture_record_t* record;
+    const uint8_t* captured;
+    replay_run_t* run;
+    replay_conn_t* conn;
+    uint64_t trace_first = 0;
+    uint64_t start_ns = 0;
+    uint64_t due_ns = 0;
+    uint64_t sent_ns = 0;
+    uint64_t now;
+    uint8_t direction;
+    int first = TRUE;
+    int status;
+    int sent;
+    int i;
+
+    if (config == NULL || config->path == NULL || host == NULL ||
+        result == NULL || config->speed > REPLAY_MAX_SPEED) {
+        return E_INVALID_ARGUMENT;
+    }
+    memset(result, 0, sizeof(*result));
+
+    status = xoe_wire_capture_reader_open(&reader, config->path);
+    if (status != 0) {
+        return status;
+    }
+
+    /* Replay what the captured process's peers sent */
+    direction = (reader.header->role == XOE_WIRE_CAPTURE_ROLE_SERVER)
+                ? XOE_WIRE_CAPTURE_RX : XOE_WIRE_CAPTURE_TX;
+
+    run = (replay_run_t*)calloc(1, sizeof(replay_run_t));
+    if (run != NULL) {
+        run->conns = (replay_conn_t*)calloc(REPLAY_MAX_CONNECTIONS,
+                                            sizeof(replay_conn_t));
+        run->fds = (struct pollfd*)calloc(REPLAY_MAX_CONNECTIONS,
+                                          sizeof(struct pollfd));
+        run->polled = (replay_conn_t**)calloc(REPLAY_MAX_CONNECTIONS,
+                                              sizeof(replay_conn_t*));
+        run->fill = (uint8_t*)malloc(XOE_WIRE_MAX_PAYLOAD);
+    }
+    if (run == NULL || run->conns == NULL || run->fds == NULL ||
+        run->polled == NULL || run->fill == NULL) {
+        if (run != NULL) {
+            free(run->conns);
+            free(run->fds);
+            free(run->polled);
+            free(run->fill);
+            free(run);
+        }
+        xoe_wire_capture_reader_close(&reader);
+        return E_OUT_OF_MEMORY;
+    }
+
+    run->config = config;
+    run->host = host;
+    run->port = port;
+    run->tune = tune;
+    run->tls_ctx = tls_ctx;
+    run->stop = stop;
+    run->result = result;
+
+    while (!(stop != NULL && *stop) &&
+           (status = xoe_wire_capture_reader_next(&reader, &record,
+                                                  &captured)) == 1) {
+        if (record->type != direction) {
+            continue;
+        }
+        if (record->length > XOE_WIRE_MAX_PAYLOAD) {
+            result->frames_skipped++;
+            continue;
+        }
+
+        if (first) {
+            trace_first = record->timestamp_ns;
+            start_ns = latency_now_ns();
+            first = FALSE;
+        }
+        result->trace_ns = record->timestamp_ns - trace_first;
+
+        if (config->speed > 0) {
+            due_ns = start_ns + result->trace_ns / config->speed;
+            wait_until(run, due_ns);
+            if (stop != NULL && *stop) {
+                break;
+            }
+        }
+
+        conn = conn_for(run, record->conn_id);
+        if (conn == NULL) {
+            result->frames_skipped++;
+            continue;
+        }
+
+        now = latency_now_ns();
+        if (config->speed > 0 && now > due_ns) {
+            if (now - due_ns > REPLAY_LATE_NS) {
+                result->frames_late++;
+            }
+            if (now - due_ns > result->max_lag_ns) {
+                result->max_lag_ns = now - due_ns;
+            }
+        }
+
+        sent = conn_send(run, conn, record, captured);
+        if (sent != 0) {
+            conn_lost(run, conn, sent);
+            result->frames_skipped++;
+            continue;
+        }
+        sent_ns = latency_now_ns();
+
+        /* Take what has come back so neither side's buffers fill up */
+        poll_replies(run, 0);
+    }
+    if (status < 0) {
+        LOG_WARN("Replay: damaged record in %s, stopped there", config->path);
+    }
+    if (!first) {
+        result->elapsed_ns = sent_ns - start_ns;
+    }
+
+    /* Last replies */
+    if (!first) {
+        wait_until(run, latency_now_ns() + REPLAY_DRAIN_MS * 1000000ULL);
+    }
+
+    for (i = 0; i < run->conn_count; i++) {
+        conn_close(&run->conns[i]);
+    }
+    xoe_wire_capture_reader_close(&reader);
+    free(run->conns);
+    free(run->fds);
+    free(run->polled);
+    free(run->fill);
+    free(run);
+
+    return (result->connected > 0 || result->failed == 0)
+           ? 0 : E_NETWORK_ERROR;
+}
+
+/* ============================================================================
+ * Report
+ * ============================================================================ */
+
+void replay_client_report(FILE* out, const replay_config_t* config,
+                          const replay_result_t* result)
+{
+    double seconds;
+
+    if (out == NULL || config == NULL || result == NULL) {
+        return;
+    }
+    seconds = (double)result->elapsed_ns / 1e9;
+    if (seconds <= 0.0) {
+        seconds = 1e-9;
+    }
+
+    fprintf(out, "Replay: %s, %.2f s of traffic, ", config->path,
+            (double)result->trace_ns / 1e9);
+    if (config->speed > 0) {
+        fprintf(out, "%ux speed, ", config->speed);
+    } else {
+        fprintf(out, "as fast as possible, ");
+    }
+    fprintf(out, "%.2f s\n", (double)result->elapsed_ns / 1e9);
+
+    fprintf(out, "Connections: %d up, %d failed, %d lost\n",
+            result->connected, result->failed, result->lost);
+    fprintf(out, "Sent:      %llu frames, %.0f frames/s, %.2f MB/s "
+            "(%llu skipped, %llu zero-filled)\n",
+            (unsigned long long)result->frames_sent,
+            (double)result->frames_sent / seconds,
+            (double)result->bytes_sent / seconds / 1e6,
+            (unsigned long long)result->frames_skipped,
+            (unsigned long long)result->frames_cut);
+    fprintf(out, "Received:  %llu frames, %.2f MB\n",
+            (unsigned long long)result->frames_received,
+            (double)result->bytes_received / 1e6);
+    if (config->speed > 0) {
+        fprintf(out, "Pacing:    %llu frames more than %.1f ms late, "
+                "worst %.3f ms\n",
+                (unsigned long long)result->frames_late,
+                (double)REPLAY_LATE_NS / 1e6,
+                (double)result->max_lag_ns / 1e6);
+    }
+}
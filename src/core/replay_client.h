@@ -0,0 +1,107 @@
+/**
+ * @file replay_client.h
+ * @brief Re-drives a wire capture against a server
+ *
+ * Reads a trace file written with --capture (lib/protocol/wire_capture.h)
+ * and sends the frames the captured peers sent, on one connection per
+ * captured connection, at their original spacing or a multiple of it.
+ * A capture taken by a server replays the frames it received; one taken
+ * by a client replays the frames it sent. Frames cut at the capture's
+ * snap length go out at their full length, zero-filled past the captured
+ * part, so the offered load matches the original.
+ *
+ * Replay is deterministic: one thread sends every frame in capture order
+ * on a fixed schedule (connections are opened just before their first
+ * frame is due), so two runs of the same trace offer the same load in
+ * the same order. Whatever the server sends back is read and counted
+ * between frames. A frame sent more than REPLAY_LATE_NS after its
+ * scheduled time counts as late: the replay itself, or a server that
+ * does not read fast enough, could not keep the original pace.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef REPLAY_CLIENT_H
+#define REPLAY_CLIENT_H
+
+#include <stdio.h>
+#include <signal.h>
+
+#include "lib/common/types.h"
+#include "lib/net/sock_tune.h"
+
+/* Defaults and limits of the --replay-* options */
+#define REPLAY_DEFAULT_SPEED 1
+#define REPLAY_MAX_SPEED 1000
+#define REPLAY_MAX_CONNECTIONS 1024
+
+/* Lateness past which a frame counts as sent off schedule */
+#define REPLAY_LATE_NS 1000000ULL
+
+/* Time allowed for the last replies after the last frame */
+#define REPLAY_DRAIN_MS 500
+
+/**
+ * @brief What to replay
+ */
+typedef struct {
+    const char* path;           /* Trace file (NULL = replay off) */
+    uint32_t speed;             /* 1 = original timing, n = n times as
+                                   fast, 0 = as fast as possible */
+} replay_config_t;
+
+/**
+ * @brief Totals of a replay
+ */
+typedef struct {
+    int connected;              /* Connections set up */
+    int failed;                 /* Connections that could not be set up */
+    int lost;                   /* Connections closed during the replay */
+    uint64_t frames_sent;
+    uint64_t frames_skipped;    /* Frames of failed, lost or surplus
+                                   connections */
+    uint64_t frames_cut;        /* Frames zero-filled past the snap length */
+    uint64_t frames_late;       /* Sent more than REPLAY_LATE_NS late */
+    uint64_t frames_received;
+    uint64_t bytes_sent;        /* Payload bytes */
+    uint64_t bytes_received;
+    uint64_t max_lag_ns;        /* Worst lateness of a frame */
+    uint64_t trace_ns;          /* First to last replayed frame in the trace */
+    uint64_t elapsed_ns;        /* First to last frame sent */
+} replay_result_t;
+
+/**
+ * @brief Fill @p config with the defaults (and no trace file)
+ */
+void replay_config_init_defaults(replay_config_t* config);
+
+/**
+ * @brief Replay a trace file against a server
+ *
+ * Returns early once @p stop becomes non-zero (e.g. from a SIGINT
+ * handler).
+ *
+ * @param config    What to replay
+ * @param host      Server host name or address
+ * @param port      Server port
+ * @param tune      Socket options for every connection (may be NULL)
+ * @param tls_ctx   Client SSL_CTX* for TLS connections, NULL for plain TCP
+ * @param stop      Stop request flag (may be NULL)
+ * @param result    Receives the totals
+ *
+ * @return 0 if the replay took place (connection failures are counted in
+ *         @p result), E_INVALID_ARGUMENT, E_FILE_NOT_FOUND, E_IO_ERROR or
+ *         E_PROTOCOL_ERROR for an unreadable trace, E_NETWORK_ERROR if no
+ *         connection could be set up, E_OUT_OF_MEMORY
+ */
+int replay_client_run(const replay_config_t* config, const char* host,
+                      int port, const sock_tune_t* tune, void* tls_ctx,
+                      volatile sig_atomic_t* stop, replay_result_t* result);
+
+/**
+ * @brief Print the totals and pacing of a replay
+ */
+void replay_client_report(FILE* out, const replay_config_t* config,
+                          const replay_result_t* result);
+
+#endif /* REPLAY_CLIENT_H */
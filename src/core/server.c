@@ -2,7 +2,7 @@
  * server.c
  *
  * Server implementation for XOE including client pool management and
- * per-client thread handling.
+ * per-packet handling for connections serviced by the event loop.
  */
 
 #include <stdio.h>
@@ -17,7 +17,12 @@
 #include <netinet/in.h>
 
 #include "lib/common/definitions.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/net/rate_limit.h"
 #include "core/config.h"
+#include "core/event_loop.h"
+#include "core/protocol_registry.h"
 #include "core/server.h"
 
 /* TLS includes - include config first to get TLS_ENABLED */
@@ -29,37 +34,56 @@
 #include "lib/security/tls_error.h"
 #endif
 
+/* Serial connector defaults (usage text) */
+#include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_hub.h"
+#include "connectors/serial/serial_mux.h"
+#include "connectors/serial/serial_session.h"
+
 /* USB server includes */
 #include "connectors/usb/usb_server.h"
 #include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_capture.h"
 #include "lib/protocol/wire_format.h"
+#include "lib/protocol/wire_zerocopy.h"
+#include "lib/protocol/mux.h"
+#include "lib/protocol/wire_compress.h"
 
 /* Global fixed-size client pool */
 static client_info_t client_pool[MAX_CLIENTS];
 static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_released = PTHREAD_COND_INITIALIZER; /* A slot
+                                                    was released */
 
 /* Connection rate limiting (NET-012 fix) */
-#define CONN_RATE_LIMIT_ENTRIES 32   /* Max tracked IPs */
 #define CONN_RATE_LIMIT_WINDOW  10   /* Time window in seconds */
-#define CONN_RATE_LIMIT_MAX     20   /* Max connections per window */
-
-typedef struct {
-    in_addr_t ip_addr;       /* IPv4 address (0 = unused) */
-    int conn_count;          /* Connection count in current window */
-    time_t window_start;     /* Start of current time window */
-} conn_rate_limit_entry_t;
 
-static conn_rate_limit_entry_t conn_rate_limits[CONN_RATE_LIMIT_ENTRIES];
+static rate_limiter_t conn_rate_storage;
+static int conn_rate_ready = 0;                     /* Storage initialized */
+static rate_limiter_t *conn_rate_limiter = NULL;    /* NULL = no limit (atomic) */
 static pthread_mutex_t conn_rate_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-/* Global TLS context (read-only after initialization, thread-safe) */
+/* Global TLS context; swapped under tls_ctx_mutex, sessions hold their own
+ * reference (see server_tls_ctx_acquire) */
 #if TLS_ENABLED
 SSL_CTX* g_tls_ctx = NULL;
+static pthread_mutex_t tls_ctx_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
-/* Global USB server (NULL if not initialized) */
+/* Global USB server (NULL until first used, see server_usb_get()) */
 usb_server_t* g_usb_server = NULL;
 
+/* Settings the USB server starts with; usb_server_mutex also serializes
+ * its creation */
+static pthread_mutex_t usb_server_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t usb_server_classes[MAX_USB_CLASSES];
+static int usb_server_class_count = 0;
+static uint32_t usb_server_iso_budget = 0;
+static int usb_server_failed = 0;           /* Creation failed, not retried */
+
+/* Threads handling USB frames (URB decoding, authentication) */
+#define SERVER_USB_POOL_THREADS 2
+
 /**
  * acquire_client_slot - Acquire a client slot from the pool
  *
@@ -73,6 +97,8 @@ client_info_t* acquire_client_slot(void) {
     for (i = 0; i < MAX_CLIENTS; i++) {
         if (!client_pool[i].in_use) {
             client_pool[i].in_use = 1;
+            memset(&client_pool[i].mem, 0, sizeof(client_pool[i].mem));
+            client_pool[i].raw_name[0] = '\0';
             slot = &client_pool[i];
             break;
         }
@@ -91,238 +117,1102 @@ void release_client_slot(client_info_t *slot) {
         pthread_mutex_lock(&pool_mutex);
         slot->in_use = 0;
         slot->client_socket = -1;
+        pthread_cond_broadcast(&pool_released);
         pthread_mutex_unlock(&pool_mutex);
     }
 }
 
 /**
  * init_client_pool - Initialize the global client pool
+ * @conn_rate: Connections per source address per CONN_RATE_LIMIT_WINDOW
+ *             (0 = no limit)
  */
-void init_client_pool(void) {
+void init_client_pool(int conn_rate) {
     int i;
     for (i = 0; i < MAX_CLIENTS; i++) {
         client_pool[i].in_use = 0;
         client_pool[i].client_socket = -1;
+        client_pool[i].client_ip[0] = '\0';
+        client_pool[i].wire_features = 0;
+        client_pool[i].mux = NULL;
+        client_pool[i].compress = NULL;
+        client_pool[i].serial_session = NULL;
+        client_pool[i].hub_member = NULL;
+        client_pool[i].loop_owner = NULL;
 #if TLS_ENABLED
         client_pool[i].tls_session = NULL;
 #endif
     }
 
-    /* Initialize connection rate limit table (NET-012 fix) */
-    for (i = 0; i < CONN_RATE_LIMIT_ENTRIES; i++) {
-        conn_rate_limits[i].ip_addr = 0;
-        conn_rate_limits[i].conn_count = 0;
-        conn_rate_limits[i].window_start = 0;
+    /* Initialize connection rate limiter (NET-012 fix) */
+    if (server_set_conn_rate(conn_rate) != 0) {
+        LOG_ERROR("Connection rate limiter unavailable");
     }
 }
 
 /**
- * check_connection_rate_limit - Check if IP is rate-limited (NET-012 fix)
- * @ip: Client IP address in network byte order
+ * server_set_conn_rate - Change the per-address connection rate limit
+ * @conn_rate: Connections per source address per CONN_RATE_LIMIT_WINDOW
+ *             (0 = no limit)
  *
- * Returns: 1 if connection allowed, 0 if rate-limited
+ * Returns: 0 on success, negative error code from the limiter
  *
- * Uses sliding window algorithm: allows CONN_RATE_LIMIT_MAX connections
- * per CONN_RATE_LIMIT_WINDOW seconds per IP address.
+ * The limiter storage is set up on first use and then only retuned, so
+ * accept threads may hold a pointer to it at any time.
  */
-int check_connection_rate_limit(in_addr_t ip) {
-    int i;
-    int found = -1;
-    int empty = -1;
-    time_t now;
-    int allowed = 1;
-
-    now = time(NULL);
+int server_set_conn_rate(int conn_rate) {
+    uint32_t refill_ms;
+    int result = 0;
 
     pthread_mutex_lock(&conn_rate_mutex);
+    if (conn_rate <= 0) {
+        __atomic_store_n(&conn_rate_limiter, NULL, __ATOMIC_RELEASE);
+    } else {
+        refill_ms = (uint32_t)(CONN_RATE_LIMIT_WINDOW * 1000 / conn_rate);
+        if (!conn_rate_ready) {
+            result = rate_limiter_init(&conn_rate_storage, (uint32_t)conn_rate,
+                                       refill_ms);
+            conn_rate_ready = (result == 0);
+        } else {
+            result = rate_limiter_set_rate(&conn_rate_storage,
+                                           (uint32_t)conn_rate, refill_ms);
+        }
+        if (result == 0) {
+            __atomic_store_n(&conn_rate_limiter, &conn_rate_storage,
+                             __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&conn_rate_mutex);
 
-    /* Find existing entry or empty slot */
-    for (i = 0; i < CONN_RATE_LIMIT_ENTRIES; i++) {
-        if (conn_rate_limits[i].ip_addr == ip) {
-            found = i;
-            break;
+    return result;
+}
+
+#if TLS_ENABLED
+/**
+ * server_tls_ctx_acquire - Take a reference to the current server context
+ */
+SSL_CTX* server_tls_ctx_acquire(void) {
+    SSL_CTX *ctx;
+
+    pthread_mutex_lock(&tls_ctx_mutex);
+    ctx = g_tls_ctx;
+    if (ctx != NULL) {
+        SSL_CTX_up_ref(ctx);
+    }
+    pthread_mutex_unlock(&tls_ctx_mutex);
+
+    return ctx;
+}
+
+/**
+ * server_tls_ctx_replace - Install a new server context
+ */
+void server_tls_ctx_replace(SSL_CTX *ctx) {
+    SSL_CTX *old;
+
+    pthread_mutex_lock(&tls_ctx_mutex);
+    old = g_tls_ctx;
+    g_tls_ctx = ctx;
+    pthread_mutex_unlock(&tls_ctx_mutex);
+
+    /* Open sessions keep the old context alive until they close */
+    tls_context_cleanup(old);
+}
+#endif
+
+/**
+ * server_apply_live_config - Apply settings that need no restart
+ * @config: Newly active configuration
+ *
+ * Returns: 0 on success, first negative error code otherwise (the other
+ *          settings are still applied)
+ */
+int server_apply_live_config(const xoe_config_t *config) {
+#if TLS_ENABLED
+    SSL_CTX *ctx;
+#endif
+    int result = 0;
+    int status;
+
+    if (config == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    log_set_level((log_level_t)config->log_level);
+
+    status = server_set_conn_rate(config->conn_rate);
+    if (status != 0) {
+        LOG_ERROR("Could not change the connection rate limit");
+        result = status;
+    }
+
+    /* Takes effect for the next frame each connection reads */
+    mem_budget_set_limit((size_t)config->mem_budget_mb * 1024 * 1024);
+    mem_budget_set_conn_limit((size_t)config->conn_mem_kb * 1024);
+
+    /* Running threads move to their class's new CPU set and policy */
+    status = thread_sched_set(&config->thread_sched);
+    if (status != 0) {
+        LOG_ERROR("Could not apply all thread scheduling settings (code %d)",
+                  status);
+        if (result == 0) {
+            result = status;
         }
-        if (empty < 0 && conn_rate_limits[i].ip_addr == 0) {
-            empty = i;
+    }
+
+    /* Kept for a USB server not started yet */
+    pthread_mutex_lock(&usb_server_mutex);
+    memcpy(usb_server_classes, config->usb_classes,
+           sizeof(usb_server_classes));
+    usb_server_class_count = config->usb_class_count;
+    if (g_usb_server != NULL) {
+        status = usb_server_set_class_whitelist(g_usb_server,
+                                                config->usb_classes,
+                                                config->usb_class_count);
+        if (status != 0 && result == 0) {
+            result = status;
         }
     }
+    pthread_mutex_unlock(&usb_server_mutex);
 
-    if (found >= 0) {
-        /* Check if window has expired */
-        if (now - conn_rate_limits[found].window_start >= CONN_RATE_LIMIT_WINDOW) {
-            /* Reset window */
-            conn_rate_limits[found].window_start = now;
-            conn_rate_limits[found].conn_count = 1;
-        } else {
-            /* Check limit within window */
-            if (conn_rate_limits[found].conn_count >= CONN_RATE_LIMIT_MAX) {
-                allowed = 0;
-            } else {
-                conn_rate_limits[found].conn_count++;
+#if TLS_ENABLED
+    /* Only a running TLS server reloads; switching TLS on needs a restart */
+    ctx = server_tls_ctx_acquire();
+    if (ctx != NULL) {
+        SSL_CTX_free(ctx);
+        ctx = tls_context_init(config->cert_path, config->key_path,
+                               config->encryption_mode);
+        if (ctx == NULL) {
+            LOG_ERROR("TLS reload failed, keeping the current certificate: %s",
+                      tls_get_error_string());
+            if (result == 0) {
+                result = E_TLS_HANDSHAKE_FAILED;
             }
+        } else {
+            server_tls_ctx_replace(ctx);
+            LOG_INFO("TLS certificate reloaded from %s", config->cert_path);
         }
-    } else if (empty >= 0) {
-        /* Create new entry */
-        conn_rate_limits[empty].ip_addr = ip;
-        conn_rate_limits[empty].window_start = now;
-        conn_rate_limits[empty].conn_count = 1;
     }
-    /* If table is full, allow connection (fail-open for availability) */
+#endif
 
-    pthread_mutex_unlock(&conn_rate_mutex);
+    return result;
+}
+
+/**
+ * check_connection_rate_limit - Check if a peer is rate-limited (NET-012 fix)
+ * @addr: Peer address (AF_INET or AF_INET6)
+ *
+ * Returns: 1 if connection allowed, 0 if rate-limited
+ *
+ * Token bucket per source address: bursts of --conn-rate connections
+ * (CONN_RATE_LIMIT_MAX by default), refilled at the same number per
+ * CONN_RATE_LIMIT_WINDOW seconds. Lookups take
+ * one shard lock of the limiter, not a global one.
+ */
+int check_connection_rate_limit(const struct sockaddr *addr) {
+    rate_limit_key_t key;
 
-    return allowed;
+    if (rate_limit_key_from_sockaddr(addr, &key) != 0) {
+        return 1;
+    }
+    if (!rate_limiter_allow(__atomic_load_n(&conn_rate_limiter,
+                                            __ATOMIC_ACQUIRE), &key)) {
+        metrics_add(METRIC_CONN_RATE_LIMITED, 1);
+        return 0;
+    }
+    return 1;
 }
 
 /**
- * handle_client - Thread function to handle a single client connection
- * @arg: Pointer to client_info_t structure (void* for pthread compatibility)
+ * server_handle_raw_join - Accept a request to join a raw channel
+ * @client: Client the RAW_JOIN arrived on
+ * @name: Channel name
  *
- * Returns: NULL (pthread thread function requirement)
+ * Returns: 0 to keep the connection open, negative error code to close it
  *
- * Handles bidirectional communication with a client, including optional
- * TLS encryption. This function runs in a detached thread for each
- * connected client.
+ * Only records the name: the event loop hands the connection to
+ * core/raw_relay.h once this frame is dispatched. Raw bytes can only be
+ * spliced between plain TCP sockets, so any other transport is refused.
  */
-void *handle_client(void *arg) {
-    client_info_t *client_info = (client_info_t *)arg;
-    int client_socket = client_info->client_socket;
-    struct sockaddr_in client_addr = client_info->client_addr;
-    char client_ip[INET_ADDRSTRLEN];
-    int bytes_received;
+static int server_handle_raw_join(client_info_t *client, const char *name) {
+    if (!xoe_transport_is_tcp(&client->transport)) {
+        LOG_WARN("Raw channel refused for %s:%d: not plain TCP",
+                 client->client_ip, ntohs(client->client_addr.sin_port));
+        return E_NOT_SUPPORTED;
+    }
+
+    memcpy(client->raw_name, name, sizeof(client->raw_name));
+    return 0;
+}
+
+/**
+ * server_handle_wire_ctrl - Answer a wire feature negotiation HELLO
+ * @client: Client the packet arrived on
+ * @packet: XOE_PROTOCOL_WIRE_CTRL packet
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Grants the requested features the transport allows (checksum-off only
+ * over TLS, one compression back-end) and replies with a HELLO_ACK. The
+ * ACK itself is still sent with a checksum and uncompressed; the new
+ * features apply from the next frame on. Negotiating again restarts both
+ * compression streams.
+ *
+ * A RAW_JOIN goes to server_handle_raw_join() instead.
+ */
+static int server_handle_wire_ctrl(client_info_t *client, xoe_packet_t *packet) {
+    xoe_packet_t reply;
+    xoe_payload_t reply_payload;
+    uint8_t reply_buffer[XOE_WIRE_HELLO_SIZE];
+    xoe_wire_compress_t *compress = NULL;
+    uint16_t type;
+    uint32_t requested;
+    uint32_t accepted;
+    int authenticated = FALSE;
+    int result;
+    char raw_name[XOE_WIRE_RAW_NAME_MAX + 1];
+
+    if (xoe_wire_raw_join_parse(packet, raw_name) == 0) {
+        return server_handle_raw_join(client, raw_name);
+    }
+
+    if (xoe_wire_hello_parse(packet, &type, &requested) != 0 ||
+        type != XOE_WIRE_CTRL_HELLO) {
+        LOG_WARN("Malformed wire control packet from %s:%d",
+                client->client_ip, ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
 
 #if TLS_ENABLED
-    SSL* tls = NULL;
+    authenticated = (client->tls_session != NULL);
 #endif
+    accepted = xoe_wire_features_accept(requested, authenticated);
 
-    /* Convert client IP to string (thread-safe) */
-    inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-    printf("Connection accepted from %s:%d\n", client_ip, ntohs(client_addr.sin_port));
+    if (accepted & XOE_WIRE_FEATURES_COMPRESS) {
+        compress = (xoe_wire_compress_t *)malloc(sizeof(xoe_wire_compress_t));
+        if (compress == NULL ||
+            xoe_wire_compress_init(compress, accepted) != 0) {
+            LOG_WARN("Compression unavailable for %s:%d",
+                     client->client_ip, ntohs(client->client_addr.sin_port));
+            free(compress);
+            compress = NULL;
+            accepted &= ~(uint32_t)XOE_WIRE_FEATURES_COMPRESS;
+        }
+    }
 
-#if TLS_ENABLED
-    /* Perform TLS handshake (if encryption enabled) */
-    if (g_tls_ctx != NULL) {
-        tls = tls_session_create(g_tls_ctx, client_socket);
-        if (tls == NULL) {
-            fprintf(stderr, "TLS handshake failed with %s:%d: %s\n",
-                    client_ip, ntohs(client_addr.sin_port),
-                    tls_get_error_string());
-            goto cleanup;
+    xoe_wire_hello_init(&reply, &reply_payload, reply_buffer,
+                        XOE_WIRE_CTRL_HELLO_ACK, accepted);
+
+    result = xoe_wire_send_transport(&client->transport, &reply,
+                                     client->wire_features);
+
+    if (result != 0) {
+        if (compress != NULL) {
+            xoe_wire_compress_cleanup(compress);
+            free(compress);
         }
-        client_info->tls_session = tls;
-        printf("TLS handshake successful with %s:%d\n",
-               client_ip, ntohs(client_addr.sin_port));
+        return E_IO_ERROR;
     }
-#endif
 
-    /* Protocol handling loop - detect and route based on protocol */
-    /* Uses wire format for secure packet serialization (LIB-001/NET-006 fix) */
-    while (1) {
-        xoe_packet_t packet;
-        int recv_result;
+    if (client->compress != NULL) {
+        xoe_wire_compress_cleanup(client->compress);
+        free(client->compress);
+    }
+    client->compress = compress;
+    client->wire_features = accepted;
+    return 0;
+}
 
-#if TLS_ENABLED
-        if (tls != NULL) {
-            recv_result = xoe_wire_recv_tls(tls, &packet);
-        } else {
-            recv_result = xoe_wire_recv(client_socket, &packet);
+/**
+ * server_send_packet - Send one frame over a client's transport
+ * @client: Destination client
+ * @packet: Frame to send
+ *
+ * Returns: 0 on success, E_IO_ERROR on failure
+ */
+static int server_send_packet(client_info_t *client, const xoe_packet_t *packet) {
+    /* Compressed when negotiated and worth it (lib/protocol/wire_compress.h) */
+    if (xoe_wire_send_compressed(client->compress, &client->transport,
+                                 client->wire_features, packet) != 0) {
+        LOG_ERROR("Send to %s:%d failed", client->client_ip,
+                  ntohs(client->client_addr.sin_port));
+        return E_IO_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * server_send_mux - Send a channel frame to a client
+ * @client:  Destination client
+ * @header:  Channel header
+ * @data:    Payload after the header (NULL when @len is 0)
+ * @len:     Payload length
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+static int server_send_mux(client_info_t *client, const xoe_mux_header_t *header,
+                           const void *data, uint32_t len) {
+    xoe_packet_t reply;
+    uint8_t *inner;
+    int result;
+
+    result = xoe_mux_encapsulate(header, len, &reply, &inner);
+    if (result != 0) {
+        return result;
+    }
+    if (len > 0) {
+        memcpy(inner, data, len);
+    }
+    result = server_send_packet(client, &reply);
+    xoe_mux_free_payload(&reply);
+    return result;
+}
+
+/**
+ * server_handle_mux - Serve one channel multiplexing frame
+ * @client: Client the packet arrived on
+ * @packet: XOE_PROTOCOL_MUX packet
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Serial and raw channels are accepted and echoed per channel, like the
+ * single-stream protocols. An echo needs the client's credit; without it
+ * the frame is dropped (and counted) rather than queued, so a client that
+ * stops draining one port cannot make the server buffer without bound.
+ * USB channels are refused: the USB server replies on the socket itself,
+ * outside any channel. A window violation closes the connection.
+ */
+static int server_handle_mux(client_info_t *client, xoe_packet_t *packet) {
+    xoe_mux_header_t header;
+    xoe_mux_header_t reply;
+    xoe_packet_t inner;
+    xoe_payload_t inner_payload;
+    uint32_t credit;
+    int result;
+
+    if (xoe_mux_decapsulate(packet, &header, &inner, &inner_payload) != 0) {
+        LOG_WARN("Malformed channel frame from %s:%d",
+                 client->client_ip, ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (client->mux == NULL) {
+        client->mux = (xoe_mux_t*)malloc(sizeof(xoe_mux_t));
+        if (client->mux == NULL) {
+            return E_OUT_OF_MEMORY;
         }
-#else
-        recv_result = xoe_wire_recv(client_socket, &packet);
-#endif
+        if (xoe_mux_init(client->mux) != 0) {
+            free(client->mux);
+            client->mux = NULL;
+            return E_OUT_OF_MEMORY;
+        }
+    }
 
-        if (recv_result != 0) {
-            if (recv_result == E_IO_ERROR) {
-                bytes_received = 0;  /* Connection closed or error */
-            } else if (recv_result == E_CHECKSUM_MISMATCH) {
-                fprintf(stderr, "Checksum mismatch from %s:%d\n",
-                        client_ip, ntohs(client_addr.sin_port));
-                bytes_received = -1;
+    memset(&reply, 0, sizeof(reply));
+    reply.channel = header.channel;
+    reply.inner_protocol = header.inner_protocol;
+    reply.inner_version = header.inner_version;
+
+    switch (header.type) {
+        case XOE_MUX_OPEN:
+            if (header.inner_protocol != XOE_PROTOCOL_SERIAL &&
+                header.inner_protocol != XOE_PROTOCOL_RAW) {
+                result = E_NOT_SUPPORTED;
             } else {
-                bytes_received = -1;  /* Other error */
+                result = xoe_mux_channel_accept(client->mux, header.channel,
+                                                header.inner_protocol,
+                                                header.inner_version,
+                                                header.value,
+                                                XOE_MUX_DEFAULT_WINDOW);
             }
-            break;
-        }
-
-        /* Mark as successful receive for logging */
-        bytes_received = 1;
+            if (result == 0) {
+                reply.type = XOE_MUX_OPEN_ACK;
+                reply.value = XOE_MUX_DEFAULT_WINDOW;
+            } else {
+                LOG_WARN("Refusing channel %u (protocol %u) from %s:%d: %d",
+                         header.channel, header.inner_protocol,
+                         client->client_ip,
+                         ntohs(client->client_addr.sin_port), result);
+                reply.type = XOE_MUX_CLOSE;
+                reply.value = (uint32_t)(-result);
+            }
+            return server_send_mux(client, &reply, NULL, 0);
 
-        /* Check if this is a USB protocol packet */
-        if (packet.protocol_id == XOE_PROTOCOL_USB) {
+        case XOE_MUX_DATA:
+            result = xoe_mux_rx_accept(client->mux, header.channel,
+                                       inner_payload.len);
+            if (result == E_PROTOCOL_ERROR) {
+                LOG_WARN("Channel %u window exceeded by %s:%d",
+                         header.channel, client->client_ip,
+                         ntohs(client->client_addr.sin_port));
+                return result;
+            }
+            if (result != 0) {
+                return 0;   /* Data racing our CLOSE */
+            }
 
-            /* Route via USB server if available */
-            if (g_usb_server != NULL) {
-                int result = usb_server_handle_urb(g_usb_server, &packet,
-                                                   client_socket);
+            if (xoe_mux_tx_try(client->mux, header.channel,
+                               inner_payload.len) == 0) {
+                reply.type = XOE_MUX_DATA;
+                result = server_send_mux(client, &reply, inner_payload.data,
+                                         inner_payload.len);
                 if (result != 0) {
-                    fprintf(stderr, "USB routing error from %s:%d: %d\n",
-                            client_ip, ntohs(client_addr.sin_port), result);
+                    return result;
                 }
             } else {
-                fprintf(stderr, "USB packet received but USB server not initialized\n");
+                metrics_add(METRIC_MUX_DROPPED, 1);
             }
-        } else {
-            /* Echo mode for non-USB packets */
-            printf("Received from %s:%d (protocol %d, version %d)\n",
-                   client_ip, ntohs(client_addr.sin_port),
-                   packet.protocol_id, packet.protocol_version);
 
-#if TLS_ENABLED
-            if (tls != NULL) {
-                if (xoe_wire_send_tls(tls, &packet) != 0) {
-                    fprintf(stderr, "TLS write failed\n");
-                    break;
-                }
-            } else {
-                if (xoe_wire_send(client_socket, &packet) != 0) {
-                    perror("send failed");
-                    break;
-                }
+            credit = xoe_mux_rx_consumed(client->mux, header.channel,
+                                         inner_payload.len);
+            if (credit > 0) {
+                reply.type = XOE_MUX_CREDIT;
+                reply.value = credit;
+                return server_send_mux(client, &reply, NULL, 0);
             }
+            return 0;
+
+        case XOE_MUX_CREDIT:
+            if (xoe_mux_tx_grant(client->mux, header.channel,
+                                 header.value) != 0) {
+                return E_PROTOCOL_ERROR;
+            }
+            return 0;
+
+        case XOE_MUX_CLOSE:
+            xoe_mux_channel_close(client->mux, header.channel);
+            return 0;
+
+        default:
+            /* OPEN_ACK: the server opens no channels */
+            return 0;
+    }
+}
+
+/**
+ * server_send_serial - Send a serial frame of a resumable session
+ * @client:   Destination client
+ * @data:     Frame data (NULL when @len is 0)
+ * @len:      Data length
+ * @sequence: Frame sequence
+ * @flags:    Frame flags (SERIAL_FLAG_ACK is added)
+ *
+ * Returns: 0 on success, negative error code on failure
+ *
+ * Piggybacks the session's cumulative ACK on the frame.
+ */
+static int server_send_serial(client_info_t *client, const void *data,
+                              uint32_t len, uint16_t sequence, uint16_t flags) {
+    xoe_packet_t reply;
+    int result;
+
+    result = serial_protocol_encapsulate_ack(data, len, sequence,
+                                             serial_session_take_ack(client->serial_session),
+                                             (uint16_t)(flags | SERIAL_FLAG_ACK),
+                                             &reply);
+    if (result != 0) {
+        return result;
+    }
+
+    result = server_send_packet(client, &reply);
+    serial_protocol_free_payload(&reply);
+    return result;
+}
+
+/**
+ * server_handle_serial_resume - Open or resume a client's serial session
+ * @client: Client the RESUME frame arrived on
+ * @data:   RESUME payload
+ * @len:    Payload length
+ * @ack:    The client's cumulative ACK
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Takes the session back from the park table if the client had one, and
+ * replies with a RESUME frame saying whether it did. The reply's ACK
+ * tells the client which of its frames to send again; the server then
+ * retransmits the echoes the client's ACK says it missed.
+ */
+static int server_handle_serial_resume(client_info_t *client,
+                                       const unsigned char *data,
+                                       uint32_t len, uint16_t ack) {
+    serial_session_t *session;
+    const serial_session_frame_t *frame;
+    xoe_packet_t reply;
+    uint64_t id;
+    int status;
+    int result;
+    int i;
+
+    if (client->serial_session != NULL ||
+        serial_session_resume_parse(data, len, &id, &status) != 0) {
+        LOG_WARN("Unexpected serial RESUME from %s:%d", client->client_ip,
+                 ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
+
+    status = SERIAL_SESSION_OPENED;
+    session = serial_session_unpark(id);
+    if (session != NULL && serial_session_ack(session, ack) >= 0) {
+        status = SERIAL_SESSION_RESUMED;
+    } else {
+        serial_session_destroy(session);
+        session = serial_session_create(id);
+        if (session == NULL) {
+            return E_OUT_OF_MEMORY;
+        }
+    }
+    client->serial_session = session;
+
+    result = serial_session_resume_frame(session, status, 0, &reply);
+    if (result != 0) {
+        return result;
+    }
+    result = server_send_packet(client, &reply);
+    serial_protocol_free_payload(&reply);
+
+    for (i = 0; result == 0 && i < serial_session_unacked(session); i++) {
+        frame = serial_session_frame(session, i);
+        result = server_send_serial(client, frame->data, frame->len,
+                                    frame->sequence, frame->flags);
+        session->retransmitted++;
+    }
+
+    LOG_INFO("Serial session %016llx %s for %s:%d",
+             (unsigned long long)id,
+             (status == SERIAL_SESSION_RESUMED) ? "resumed" : "opened",
+             client->client_ip, ntohs(client->client_addr.sin_port));
+    return result;
+}
+
+/**
+ * server_handle_serial_session - Echo a serial frame of a resumable session
+ * @client: Client the packet arrived on
+ * @packet: XOE_PROTOCOL_SERIAL packet
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Applies the client's ACK, drops data frames it retransmitted that were
+ * already echoed, and echoes new ones through the session's window so a
+ * reconnecting client gets back echoes lost with the old connection.
+ * XON/XOFF frames are echoed as control frames, as in plain echo mode.
+ */
+static int server_handle_serial_session(client_info_t *client,
+                                        xoe_packet_t *packet) {
+    serial_session_t *session = client->serial_session;
+    const unsigned char *data;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t sequence;
+    uint16_t ack;
+    int result;
+
+    if (serial_protocol_peek(packet, &flags, &sequence, &ack, &data,
+                             &len) != 0 || !(flags & SERIAL_FLAG_ACK)) {
+        LOG_WARN("Malformed serial frame from %s:%d", client->client_ip,
+                 ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (flags & SERIAL_FLAG_RESUME) {
+        return server_handle_serial_resume(client, data, len, ack);
+    }
+
+    if (session == NULL || serial_session_ack(session, ack) < 0) {
+        LOG_WARN("Serial frame outside a session from %s:%d",
+                 client->client_ip, ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
+    flags &= (uint16_t)~SERIAL_FLAG_ACK;
+
+    /* Control frame: no sequence of its own */
+    if (len == 0) {
+        if (flags & (SERIAL_FLAG_XON | SERIAL_FLAG_XOFF)) {
+            return server_send_serial(client, NULL, 0, session->tx_next, flags);
+        }
+        return 0;
+    }
+
+    /* The client's window bounds ours (it ACKs every echo before sending
+     * past it); checked first so a refused frame stays unaccepted */
+    if (serial_session_window_full(session) &&
+        sequence == session->rx_next) {
+        LOG_WARN("Serial window overrun by %s:%d", client->client_ip,
+                 ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
+
+    result = serial_session_accept(session, sequence);
+    if (result == SERIAL_SESSION_DUPLICATE) {
+        return 0;
+    }
+    if (result < 0) {
+        LOG_WARN("Serial frames lost from %s:%d (got %u, expected %u)",
+                 client->client_ip, ntohs(client->client_addr.sin_port),
+                 sequence, session->rx_next);
+        return result;
+    }
+
+    serial_session_store(session, data, len, flags, &sequence);
+    return server_send_serial(client, data, len, sequence, flags);
+}
+
+/**
+ * server_handle_hub_join - Join a client to a serial routing hub topic
+ * @client: Client the join frame arrived on
+ * @data:   Join payload (role + topic name)
+ * @len:    Payload length
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Answers with the join status. Members relay frames as they are, so a
+ * connection that negotiated session resume (whose frames carry ACKs for
+ * the server) or is already a member is refused.
+ */
+static int server_handle_hub_join(client_info_t *client,
+                                  const unsigned char *data, uint32_t len) {
+    char topic[SERIAL_HUB_TOPIC_MAX + 1];
+    xoe_packet_t reply;
+    int status = SERIAL_HUB_JOINED;
+    int role;
+    int result;
+
+    if (serial_hub_join_parse(data, len, topic, &role) != 0) {
+        LOG_WARN("Malformed serial hub join from %s:%d", client->client_ip,
+                 ntohs(client->client_addr.sin_port));
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (client->hub_member != NULL ||
+        (client->wire_features & XOE_WIRE_FEATURE_SERIAL_RESUME)) {
+        status = SERIAL_HUB_REFUSED;
+    } else {
+        result = serial_hub_join(topic, role, client->loop_owner,
+                                 event_loop_kick, client,
+                                 &client->hub_member);
+        if (result == E_DEVICE_BUSY) {
+            status = SERIAL_HUB_TAKEN;
+        } else if (result != 0) {
+            return result;
+        }
+    }
+
+    LOG_INFO("Serial hub topic \"%s\": %s:%d %s as %s", topic,
+             client->client_ip, ntohs(client->client_addr.sin_port),
+             (status == SERIAL_HUB_JOINED) ? "joined" : "refused",
+             (role == SERIAL_HUB_PUBLISHER) ? "publisher" :
+             (role == SERIAL_HUB_WRITER) ? "writer" : "subscriber");
+
+    result = serial_hub_status_frame(status, &reply);
+    if (result != 0) {
+        return result;
+    }
+    result = server_send_packet(client, &reply);
+    serial_protocol_free_payload(&reply);
+    return result;
+}
+
+/**
+ * server_handle_serial - Dispatch a serial frame
+ * @client: Client the packet arrived on
+ * @packet: XOE_PROTOCOL_SERIAL packet
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Hub join frames are answered first. Resumable sessions are echoed
+ * through their window; a hub member's frames are queued for the rest of
+ * its topic (see connectors/serial/serial_hub.h) and sent by the workers
+ * owning the recipients; anything else is echoed.
+ */
+static int server_handle_serial(client_info_t *client, xoe_packet_t *packet) {
+    const unsigned char *data;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t sequence;
+    uint16_t ack;
+    int result;
+
+    if (serial_protocol_peek(packet, &flags, &sequence, &ack, &data,
+                             &len) == 0 && (flags & SERIAL_FLAG_HUB)) {
+        return server_handle_hub_join(client, data, len);
+    }
+
+    if (client->wire_features & XOE_WIRE_FEATURE_SERIAL_RESUME) {
+        return server_handle_serial_session(client, packet);
+    }
+
+    if (client->hub_member == NULL) {
+        return server_send_packet(client, packet);
+    }
+
+    result = serial_hub_route(client->hub_member, packet);
+    return (result < 0) ? result : 0;
+}
+
+/**
+ * server_cleanup_serial - Drop a closing connection's serial state
+ * @client: Client being released
+ *
+ * A hub member leaves its topic (frames still queued for it are
+ * released); a resumable session is parked for the client to resume on
+ * a new connection.
+ */
+static void server_cleanup_serial(client_info_t *client) {
+    if (client->hub_member != NULL) {
+        serial_hub_leave(client->hub_member);
+        client->hub_member = NULL;
+    }
+
+    if (client->serial_session != NULL) {
+        serial_session_park(client->serial_session);
+        client->serial_session = NULL;
+    }
+}
+
+/**
+ * server_cleanup_mux - Free a closing connection's channel table
+ * @client: Client being released
+ */
+static void server_cleanup_mux(client_info_t *client) {
+    if (client->mux != NULL) {
+        xoe_mux_destroy(client->mux);
+        free(client->mux);
+        client->mux = NULL;
+    }
+}
+
+#if XOE_USB_ENABLED
+/**
+ * server_usb_reply - Queue a USB reply for the worker owning a client
+ * @arg: Client the reply is for
+ * @packet: Reply (payload shared, not copied)
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+static int server_usb_reply(void *arg, const xoe_packet_t *packet) {
+    return protocol_registry_reply((client_info_t *)arg, packet);
+}
+
+/**
+ * server_handle_usb - Route a USB frame through the USB server
+ * @client: Client the packet arrived on
+ * @packet: XOE_PROTOCOL_USB packet
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Runs on the USB pool: URB decoding and device authentication stay off
+ * the event loop workers. The USB server writes its replies to the
+ * socket itself, through the socket's send queue, which is why
+ * shared-memory links are refused; a client it has no queue for yet is
+ * answered through the worker, like other pool protocols.
+ */
+static int server_handle_usb(client_info_t *client, xoe_packet_t *packet) {
+    usb_server_reply_t reply;
+    usb_server_t *usb;
+    int result;
+
+    /* USB replies come from other threads; a link's ring has one
+     * writer (lib/net/shm_link.h) */
+    if (shm_link_find(client->client_socket) != NULL) {
+        LOG_WARN("USB packet from %s on a shared-memory link, "
+                 "USB needs TCP", client->client_ip);
+        return E_NOT_SUPPORTED;
+    }
+
+    usb = server_usb_get();
+    if (usb == NULL) {
+        LOG_WARN("USB packet received but USB server not initialized");
+        return 0;
+    }
+
+    reply.send = server_usb_reply;
+    reply.arg = client;
+    result = usb_server_handle_urb_from(usb, packet, client->client_socket,
+                                        &reply);
+    if (result != 0) {
+        LOG_WARN("USB routing error from %s:%d: %d", client->client_ip,
+                 ntohs(client->client_addr.sin_port), result);
+    }
+    return 0;
+}
+
+/**
+ * server_cleanup_usb - Unregister a closing connection from the USB server
+ * @client: Client being released
+ */
+static void server_cleanup_usb(client_info_t *client) {
+    usb_server_t *usb = __atomic_load_n(&g_usb_server, __ATOMIC_ACQUIRE);
+
+    if (usb != NULL) {
+        usb_server_unregister_client(usb, client->client_socket);
+    }
+}
 #else
-            if (xoe_wire_send(client_socket, &packet) != 0) {
-                perror("send failed");
-                break;
+/**
+ * server_refuse_usb - Close a connection that sends USB frames
+ * @client: Client the packet arrived on
+ * @packet: XOE_PROTOCOL_USB packet
+ *
+ * Returns: E_NOT_SUPPORTED, so the connection is closed
+ *
+ * Registered instead of server_handle_usb() in builds without USB, so a
+ * USB client is told off rather than having its URBs echoed back.
+ */
+static int server_refuse_usb(client_info_t *client, xoe_packet_t *packet) {
+    (void)packet;
+    LOG_WARN("USB packet from %s, USB support not compiled in",
+             client->client_ip);
+    return E_NOT_SUPPORTED;
+}
+#endif
+
+/**
+ * server_usb_prepare - Set up the USB server to start on first use
+ * @config: Class whitelist and isochronous budget to start it with
+ */
+void server_usb_prepare(const xoe_config_t *config) {
+    pthread_mutex_lock(&usb_server_mutex);
+    memcpy(usb_server_classes, config->usb_classes,
+           sizeof(usb_server_classes));
+    usb_server_class_count = config->usb_class_count;
+    usb_server_iso_budget = (uint32_t)config->usb_iso_budget_kbps * 1024U;
+    usb_server_failed = 0;
+    pthread_mutex_unlock(&usb_server_mutex);
+}
+
+/**
+ * server_usb_get - The USB server, started on the first call
+ */
+usb_server_t *server_usb_get(void) {
+    usb_server_t *usb;
+
+#if !XOE_USB_ENABLED
+    /* Never started: libusb stays untouched */
+    return NULL;
+#endif
+
+    usb = __atomic_load_n(&g_usb_server, __ATOMIC_ACQUIRE);
+    if (usb != NULL) {
+        return usb;
+    }
+
+    pthread_mutex_lock(&usb_server_mutex);
+    usb = g_usb_server;
+    if (usb == NULL && !usb_server_failed) {
+        usb = usb_server_init();
+        if (usb == NULL) {
+            LOG_ERROR("Failed to initialize USB server, "
+                      "USB protocol routing disabled");
+            usb_server_failed = 1;
+        } else {
+            if (usb_server_class_count > 0) {
+                usb_server_set_class_whitelist(usb, usb_server_classes,
+                                               usb_server_class_count);
             }
+            if (usb_server_iso_budget > 0) {
+                usb_server_set_iso_budget(usb, usb_server_iso_budget);
+            }
+            __atomic_store_n(&g_usb_server, usb, __ATOMIC_RELEASE);
+            LOG_INFO("USB server initialized");
+        }
+    }
+    pthread_mutex_unlock(&usb_server_mutex);
+    return usb;
+}
+
+/**
+ * server_usb_cleanup - Stop the USB server if it was started
+ */
+void server_usb_cleanup(void) {
+    pthread_mutex_lock(&usb_server_mutex);
+    if (g_usb_server != NULL) {
+        usb_server_cleanup(g_usb_server);
+        __atomic_store_n(&g_usb_server, NULL, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&usb_server_mutex);
+}
+
+/**
+ * server_handle_echo - Echo a frame of a protocol without a handler
+ * @client: Client the packet arrived on
+ * @packet: Packet
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ */
+static int server_handle_echo(client_info_t *client, xoe_packet_t *packet) {
+    LOG_DEBUG("Received from %s:%d (protocol %d, version %d)",
+              client->client_ip, ntohs(client->client_addr.sin_port),
+              packet->protocol_id, packet->protocol_version);
+
+    return server_send_packet(client, packet);
+}
+
+/* The server's protocols (core/protocol_registry.h) */
+static const protocol_handler_t server_handlers[] = {
+    { "wire control", XOE_PROTOCOL_WIRE_CTRL, XOE_DISPATCH_INLINE, 0,
+      server_handle_wire_ctrl, NULL },
+    { "mux", XOE_PROTOCOL_MUX, XOE_DISPATCH_INLINE, 0,
+      server_handle_mux, server_cleanup_mux },
+    { "serial", XOE_PROTOCOL_SERIAL, XOE_DISPATCH_INLINE, 0,
+      server_handle_serial, server_cleanup_serial },
+#if XOE_USB_ENABLED
+    { "usb", XOE_PROTOCOL_USB, XOE_DISPATCH_POOL, SERVER_USB_POOL_THREADS,
+      server_handle_usb, server_cleanup_usb }
+#else
+    { "usb", XOE_PROTOCOL_USB, XOE_DISPATCH_INLINE, 0,
+      server_refuse_usb, NULL }
 #endif
+};
+
+static const protocol_handler_t server_echo_handler = {
+    "echo", XOE_PROTOCOL_RAW, XOE_DISPATCH_INLINE, 0,
+    server_handle_echo, NULL
+};
+
+/**
+ * server_protocols_init - Register the server's protocols and start pools
+ *
+ * Returns: 0 on success, negative error code on failure
+ */
+int server_protocols_init(void) {
+    size_t i;
+    int result;
+
+    for (i = 0; i < sizeof(server_handlers) / sizeof(server_handlers[0]); i++) {
+        result = protocol_registry_register(&server_handlers[i]);
+        if (result != 0) {
+            protocol_registry_cleanup();
+            return result;
         }
+    }
+
+    result = protocol_registry_set_default(&server_echo_handler);
+    if (result == 0) {
+        result = protocol_registry_start();
+    }
+    if (result != 0) {
+        protocol_registry_cleanup();
+    }
+    return result;
+}
 
-        /* Free payload allocated by xoe_wire_recv */
+/**
+ * server_protocols_cleanup - Stop the protocol pools
+ */
+void server_protocols_cleanup(void) {
+    protocol_registry_cleanup();
+}
+
+/**
+ * server_send_hub - Send a hub member's queued frames
+ * @client: Member's client
+ * @member: Its membership
+ *
+ * Stops while the client's outbound queue is full; the rest waits in
+ * the outbox for server_resume_output().
+ */
+static void server_send_hub(client_info_t *client,
+                            serial_hub_member_t *member) {
+    xoe_packet_t packet;
+    int failed = FALSE;
+
+    while (xoe_transport_queued(&client->transport) <
+               XOE_TRANSPORT_QUEUE_HIGH &&
+           serial_hub_take(member, &packet)) {
+        if (!failed && server_send_packet(client, &packet) != 0) {
+            LOG_WARN("Serial hub send to %s:%d failed",
+                     client->client_ip,
+                     ntohs(client->client_addr.sin_port));
+            failed = TRUE;
+        }
         xoe_wire_free_payload(&packet);
     }
+}
+
+/**
+ * server_flush_outbox - Send the frames queued for a worker's clients
+ * @owner: Event loop worker calling
+ *
+ * Routing hub frames first, then pool handler replies. A failed send
+ * drops the rest of that client's frames; the worker's read side
+ * notices the broken connection and releases it.
+ */
+void server_flush_outbox(void *owner) {
+    serial_hub_member_t *member;
 
-    if (bytes_received == 0) {
-        printf("Client %s:%d disconnected\n", client_ip, ntohs(client_addr.sin_port));
-    } else if (bytes_received == -1) {
-        fprintf(stderr, "Error receiving from %s:%d\n",
-                client_ip, ntohs(client_addr.sin_port));
+    while ((member = serial_hub_next_ready(owner)) != NULL) {
+        server_send_hub((client_info_t *)serial_hub_member_user(member),
+                        member);
     }
 
-cleanup:
-    /* Unregister client from USB server if initialized */
-    if (g_usb_server != NULL) {
-        usb_server_unregister_client(g_usb_server, client_socket);
+    protocol_registry_flush(owner, server_send_packet);
+}
+
+/**
+ * server_resume_output - Send what was held back for a client
+ * @client: Client whose outbound queue drained
+ */
+void server_resume_output(client_info_t *client) {
+    if (client->hub_member != NULL) {
+        server_send_hub(client, client->hub_member);
+    }
+}
+
+/**
+ * server_handle_packet - Process one complete packet from a client
+ * @client: Client the packet arrived on
+ * @packet: Validated packet (payload still owned by the caller)
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Runs on the event loop worker that owns the connection, so the TLS
+ * session (if any) is used by exactly one thread; pool protocols only
+ * queue the frame here.
+ */
+int server_handle_packet(client_info_t *client, xoe_packet_t *packet) {
+    return protocol_registry_dispatch(client, packet);
+}
+
+/**
+ * server_release_client - Tear down a client connection
+ * @client: Client slot to release
+ */
+void server_release_client(client_info_t *client) {
+    if (client == NULL) {
+        return;
+    }
+
+    /* Waits out pool frames, then each protocol's cleanup_session() */
+    protocol_registry_release(client);
+
+    if (client->compress != NULL) {
+        xoe_wire_compress_cleanup(client->compress);
+        free(client->compress);
+        client->compress = NULL;
     }
 
 #if TLS_ENABLED
-    if (tls != NULL) {
-        tls_session_shutdown(tls);
-        tls_session_destroy(tls);
+    if (client->tls_session != NULL) {
+        tls_session_shutdown(client->tls_session);
+        tls_session_destroy(client->tls_session);
+        client->tls_session = NULL;
         /* Only shutdown socket if TLS was successful */
-        shutdown(client_socket, SHUT_RDWR);
+        shutdown(client->client_socket, SHUT_RDWR);
     }
 #endif
 
-    close(client_socket);
-    release_client_slot(client_info);
-    pthread_exit(NULL);
+    /* Before the close: the descriptor number may be reused at once */
+    xoe_wire_zerocopy_reset(client->client_socket);
+    shm_link_close(client->client_socket);
+    release_client_slot(client);
 }
 
 /**
  * disconnect_all_clients - Close all active client connections
  *
- * Closes sockets for all clients currently in the pool. Threads will
- * exit when they detect the closed socket.
+ * Shuts down sockets for all clients currently in the pool. The socket
+ * and TLS session stay owned by their event loop worker, which releases
+ * them once it sees the hangup; closing them here would race the worker.
  */
 void disconnect_all_clients(void) {
     int i;
@@ -331,17 +1221,7 @@ void disconnect_all_clients(void) {
     pthread_mutex_lock(&pool_mutex);
     for (i = 0; i < MAX_CLIENTS; i++) {
         if (client_pool[i].in_use && client_pool[i].client_socket != -1) {
-#if TLS_ENABLED
-            /* Clean up TLS session if present */
-            if (client_pool[i].tls_session != NULL) {
-                tls_session_shutdown(client_pool[i].tls_session);
-                tls_session_destroy(client_pool[i].tls_session);
-                client_pool[i].tls_session = NULL;
-            }
-#endif
-            /* Close the socket (will cause thread to exit) */
-            close(client_pool[i].client_socket);
-            client_pool[i].client_socket = -1;
+            shutdown(client_pool[i].client_socket, SHUT_RDWR);
             disconnected++;
         }
     }
@@ -353,33 +1233,40 @@ void disconnect_all_clients(void) {
 }
 
 /**
- * wait_for_clients - Wait for all client threads to exit
+ * wait_for_clients - Wait for all client connections to be released
  * @timeout_sec: Maximum seconds to wait
  *
  * Returns: Number of clients still active after timeout
  */
 int wait_for_clients(int timeout_sec) {
-    int elapsed = 0;
+    struct timespec deadline;
+    int timed_out = FALSE;
     int active = 0;
     int i;
 
-    while (elapsed < timeout_sec) {
-        active = 0;
+    /* Woken by each release instead of polling the pool */
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_sec;
 
-        pthread_mutex_lock(&pool_mutex);
+    pthread_mutex_lock(&pool_mutex);
+    for (;;) {
+        active = 0;
         for (i = 0; i < MAX_CLIENTS; i++) {
             if (client_pool[i].in_use) {
                 active++;
             }
         }
-        pthread_mutex_unlock(&pool_mutex);
 
-        if (active == 0) {
-            return 0;  /* All clients exited */
+        if (active == 0 || timed_out) {
+            break;
         }
+        timed_out = pthread_cond_timedwait(&pool_released, &pool_mutex,
+                                           &deadline) == ETIMEDOUT;
+    }
+    pthread_mutex_unlock(&pool_mutex);
 
-        sleep(1);
-        elapsed++;
+    if (active == 0) {
+        return 0;  /* All clients released */
     }
 
     /* Timeout reached, force clear any remaining slots */
@@ -422,6 +1309,46 @@ int get_active_client_count(void) {
     return count;
 }
 
+/**
+ * choose_server - Point connect_server_* at the server the policy picks
+ * @config: Configuration (servers, sock_tune)
+ * @key:    Key of the hash policy (USB device_id, hub topic hash)
+ *
+ * Checks every server of a -c list once; with a single server nothing
+ * is checked or changed.
+ *
+ * Returns: 0, or a negative error code if no server answered (the
+ *          reason is printed)
+ */
+int choose_server(xoe_config_t *config, uint32_t key) {
+    server_pool_t *pool;
+    int index;
+
+    if (config->servers.count < 2) {
+        return 0;
+    }
+
+    pool = server_pool_create(&config->servers, &config->sock_tune, key);
+    if (pool == NULL) {
+        fprintf(stderr, "Failed to check the servers\n");
+        return E_OUT_OF_MEMORY;
+    }
+    index = server_pool_pick(pool);
+    server_pool_destroy(pool);
+    if (index < 0) {
+        fprintf(stderr, "None of the %d servers answered\n",
+                config->servers.count);
+        return index;
+    }
+
+    config->connect_server_ip = config->servers.hosts[index];
+    config->connect_server_port = config->servers.ports[index];
+    printf("Server %s:%d picked (%s policy, %d servers)\n",
+           config->connect_server_ip, config->connect_server_port,
+           server_policy_name(config->servers.policy), config->servers.count);
+    return 0;
+}
+
 /**
  * print_usage - Print usage information
  * @prog_name: Program name from argv[0]
@@ -435,22 +1362,124 @@ void print_usage(const char *prog_name) {
     printf("                    Examples: 127.0.0.1, eth0, 192.168.1.100\n\n");
     printf("  -p <port>         Port to listen on (default: %d)\n", SERVER_PORT);
     printf("                    Range: 1-65535\n\n");
+    printf("  --listeners <n>   Accept threads, one SO_REUSEPORT socket each (default: 1)\n");
+    printf("                    Each feeds its own event loop workers; the kernel\n");
+    printf("                    spreads new connections across them (Linux)\n\n");
+    printf("  --backlog <n>     Listen queue length per socket (default: %d)\n",
+           MAX_PENDING_CONNECTIONS);
+    printf("                    Capped by the kernel (net.core.somaxconn)\n\n");
+    printf("  --cpus <list>     Pin listener/worker i to the i-th CPU of the list\n");
+    printf("                    Example: --cpus 0-3 or --cpus 0,2,4,6 (Linux)\n\n");
+    printf("  --conn-rate <n>   New connections accepted per client address per\n");
+    printf("                    10 s, in bursts of n (default: %d, 0 = unlimited)\n\n",
+           CONN_RATE_LIMIT_MAX);
+    printf("  --usb-iso-budget <KB/s> Isochronous bandwidth USB devices may reserve\n");
+    printf("                    in total; streams over it are refused at\n");
+    printf("                    registration (default: 0 = unlimited)\n\n");
+    printf("  --io-uring        Event loop polls through io_uring instead of epoll\n");
+    printf("                    Batches interest changes with each wait (Linux 5.11+,\n");
+    printf("                    falls back to epoll when the kernel refuses)\n\n");
+    printf("  --handoff-socket <path> UNIX socket a new binary connects to for a\n");
+    printf("                    zero-downtime upgrade (see --takeover)\n\n");
+    printf("  --takeover <path> Take the listening sockets and idle connections\n");
+    printf("                    of the server at <path>; starts fresh if none\n\n");
+    printf("  --udp             Also serve serial bridges over UDP on the same port\n");
+    printf("                    (DTLS with -e; associations do not survive --takeover)\n\n");
+    printf("  --l2 <interface>  Also serve serial bridges in raw Ethernet frames\n");
+    printf("                    (EtherType 0x88b5, unencrypted, needs CAP_NET_RAW)\n\n");
+    printf("  --shm <path>      Also accept same-host clients through shared memory\n");
+    printf("                    on UNIX socket <path> (Linux, unencrypted, no USB)\n\n");
+    printf("  --cluster-node <id> Join a cluster as node <id> (1-%d): USB device_ids\n",
+           CLUSTER_MAX_NODE_ID);
+    printf("                    and hub topics are routed across the nodes\n\n");
+    printf("  --cluster-port <port> Port for links from other nodes\n");
+    printf("                    (default: listen port + 1)\n\n");
+    printf("  --cluster-bind <address> Address for links from other nodes\n");
+    printf("                    (default: 127.0.0.1, not the listen address)\n\n");
+    printf("  --cluster-peer <host>:<port> Node to link to and accept links\n");
+    printf("                    from; repeat for more (up to %d)\n\n",
+           CLUSTER_MAX_PEERS);
+    printf("  --cluster-secret <file> Shared secret authenticating the links\n");
+    printf("                    (first line of <file>; required, unencrypted)\n\n");
 #if TLS_ENABLED
     printf("  -e <mode>         Encryption mode (default: none)\n");
     printf("                    none  - Plain TCP (no encryption)\n");
     printf("                    tls12 - TLS 1.2 encryption\n");
     printf("                    tls13 - TLS 1.3 encryption (recommended)\n\n");
     printf("  -cert <path>      Path to server certificate (default: %s)\n", TLS_DEFAULT_CERT_FILE);
-    printf("                    Required for TLS modes\n\n");
+    printf("                    Required for TLS modes; a comma-separated list\n");
+    printf("                    (e.g. rsa.crt,ecdsa.crt) serves ECDSA to capable clients\n\n");
     printf("  -key <path>       Path to server private key (default: %s)\n", TLS_DEFAULT_KEY_FILE);
-    printf("                    Required for TLS modes\n\n");
+    printf("                    Required for TLS modes; one per certificate, same order\n\n");
 #endif
     printf("Client Mode Options:\n");
     printf("  -c <ip>:<port>    Connect to server as client\n");
-    printf("                    Example: -c 192.168.1.100:12345\n\n");
-    printf("Serial Connector Options (requires -c for client mode):\n");
-    printf("  -s <device>       Serial device path (e.g., /dev/ttyUSB0)\n");
-    printf("                    Enables serial-to-network bridging\n\n");
+    printf("                    Example: -c 192.168.1.100:12345\n");
+    printf("                    Streams stdin to the server, echoes to stdout\n\n");
+    printf("  -c shm:<path>     Connect to a server on this host through shared\n");
+    printf("                    memory (its --shm path; unix:<path> also works)\n\n");
+    printf("  -c <ip>:<port>,<ip>:<port>,... Up to %d servers: the client picks a\n",
+           SERVER_POOL_MAX);
+    printf("                    healthy one, and a serial bridge fails over to\n");
+    printf("                    another through a warm standby connection\n\n");
+    printf("  --server-policy <p> How the server is picked: primary (first in\n");
+    printf("                    the list, default), rtt (lowest round trip) or\n");
+    printf("                    hash (by USB device_id or --hub topic)\n\n");
+    printf("  --raw <name>      Join raw channel <name> instead of the echo: once\n");
+    printf("                    a second client joins it, stdin goes to that client\n");
+    printf("                    and its bytes to stdout, unframed (plain TCP only)\n\n");
+    printf("Bench Options (requires -c; -e for TLS):\n");
+    printf("  --bench <n>       Open n connections and generate echo load\n");
+    printf("                    Reports throughput, setup time and RTT percentiles\n\n");
+    printf("  --bench-size <bytes> Payload per frame (default: %d, min %d)\n\n",
+           BENCH_DEFAULT_FRAME_SIZE, BENCH_MIN_FRAME_SIZE);
+    printf("  --bench-rate <fps> Frames per second over all connections\n");
+    printf("                    (default: 0 = as fast as possible)\n\n");
+    printf("  --bench-depth <n> Frames in flight per connection (default: %d)\n\n",
+           BENCH_DEFAULT_DEPTH);
+    printf("  --bench-time <s>  Measured run time (default: %d)\n\n",
+           BENCH_DEFAULT_DURATION_MS / 1000);
+    printf("  --bench-threads <n> Worker threads (default: 0 = one per CPU)\n\n");
+    printf("Capture and Replay Options:\n");
+    printf("  --capture <file>  Record every frame sent and received, with its\n");
+    printf("                    time and connection, to a trace file (any mode)\n\n");
+    printf("  --capture-max <MiB> Stop recording at this size (default: %d,\n",
+           XOE_WIRE_CAPTURE_DEFAULT_MB);
+    printf("                    0 = no limit)\n\n");
+    printf("  --replay <file>   Send the frames of a trace to the -c server, a\n");
+    printf("                    connection per captured connection (-e for TLS)\n\n");
+    printf("  --replay-speed <n> n times the original pace (default: %d,\n",
+           REPLAY_DEFAULT_SPEED);
+    printf("                    0 = as fast as possible, at most %d)\n\n",
+           REPLAY_MAX_SPEED);
+    printf("Serial Connector Options (requires -c or --l2 for client mode):\n");
+    printf("  -s <device>[@baud][#mode] Serial device path (e.g., /dev/ttyUSB0@115200)\n");
+    printf("                    Enables serial-to-network bridging\n");
+    printf("                    Repeat -s or give a comma-separated list to bridge\n");
+    printf("                    up to %d ports from one process, a connection each\n",
+           SERIAL_MULTI_MAX_DEVICES);
+    printf("                    (baud defaults to -b, mode to --udp-mode)\n\n");
+    printf("  --udp             Bridge over UDP (DTLS with -e) instead of TCP, so a\n");
+    printf("                    lost packet does not stall the frames behind it\n\n");
+    printf("  --l2 <interface>[@server-mac] Bridge in raw Ethernet frames instead\n");
+    printf("                    of -c; the first server to answer is used unless\n");
+    printf("                    its MAC is given (unencrypted, needs CAP_NET_RAW)\n\n");
+    printf("  --udp-mode <mode> Delivery over --udp or --l2 (default: reliable)\n");
+    printf("                    reliable: every frame in order, lost ones resent\n");
+    printf("                    latest: newest frame only, nothing resent\n\n");
+    printf("  --serial-mux      Bridge all ports (up to %d) over one connection,\n",
+           SERIAL_MUX_MAX_PORTS);
+    printf("                    one channel per port\n\n");
+    printf("  --hub <topic>[:role] Join a routing hub topic on the server instead of\n");
+    printf("                    the echo: pub (default) sends the port to every\n");
+    printf("                    member, sub receives it, write receives it and\n");
+    printf("                    writes to the port while holding the write lease\n\n");
+#if LZ4_ENABLED
+    printf("  --compress <alg>  Compress frames to the server: none, zlib, lz4\n");
+#else
+    printf("  --compress <alg>  Compress frames to the server: none, zlib\n");
+#endif
+    printf("                    (default: none; both directions, if the server agrees)\n\n");
     printf("  -b <baud>         Baud rate (default: 9600)\n");
     printf("                    Common rates: 9600, 19200, 38400, 57600, 115200\n\n");
     printf("  --parity <mode>   Parity (default: none)\n");
@@ -461,8 +1490,43 @@ void print_usage(const char *prog_name) {
     printf("                    Options: 1, 2\n\n");
     printf("  --flow <mode>     Flow control (default: none)\n");
     printf("                    Options: none, xonxoff, rtscts\n\n");
+    printf("  --coalesce-bytes <n>\n");
+    printf("                    Max serial bytes packed per frame (default: %d)\n\n",
+           SERIAL_DEFAULT_COALESCE_BYTES);
+    printf("  --coalesce-us <n> Max coalescing window in microseconds (default: %d)\n",
+           SERIAL_DEFAULT_COALESCE_US);
+    printf("                    Frames flush early when the line goes idle; 0 disables\n\n");
+    printf("  --read-mode <mode> Serial read timing (default: adaptive)\n");
+    printf("                    adaptive: idle gap and read size follow the baud rate\n");
+    printf("                    fixed: termios VTIME timer, four-character idle gap\n");
+    printf("                    frame: one packet per device frame, split on the\n");
+    printf("                    3.5-character gap (Modbus RTU)\n\n");
     printf("General Options:\n");
-    printf("  -h                Show this help message\n\n");
+    printf("  --log-level <lvl> Most verbose messages shown (default: info)\n");
+    printf("                    Options: error, warn, info, debug (per-frame)\n\n");
+    printf("  --sock-profile <p> TCP tuning of data sockets (default: low-latency)\n");
+    printf("                    low-latency: TCP_NODELAY, keepalive, 60 s dead-peer timeout\n");
+    printf("                    bulk: Nagle on, 1 MiB socket buffers, keepalive\n");
+    printf("                    system: leave the kernel defaults\n\n");
+    printf("  --busy-poll <us>  SO_BUSY_POLL time on data sockets (default: 0, off)\n");
+    printf("                    Lower wakeup latency for a spinning CPU (Linux)\n\n");
+    printf("  --zerocopy        Send frame payloads of %d KiB and up to plain TCP\n",
+           XOE_WIRE_ZEROCOPY_MIN / 1024);
+    printf("                    clients with MSG_ZEROCOPY (server, Linux 4.14+)\n\n");
+    printf("  --sched <class>:<cpus>[:fifo|rr[:<prio>]]\n");
+    printf("                    CPU set and policy of a thread class (repeatable)\n");
+    printf("                    Classes: serial, usb, net (server workers, bench)\n");
+    printf("                    Example: --sched serial:2,3:fifo:80 (Linux; fifo/rr\n");
+    printf("                    need CAP_SYS_NICE and lock memory with mlockall)\n\n");
+    printf("  --thread-stack <KiB> Stack size of new threads (default: %d, 0 = system)\n",
+           (int)(XOE_THREAD_STACK_SIZE / 1024));
+    printf("  --mem-budget <MiB> Memory for frame buffers; connections pause when\n");
+    printf("                    it runs low (default: %d, 0 = unlimited)\n",
+           MEM_BUDGET_DEFAULT_MB);
+    printf("  --conn-mem <KiB>  Frame memory one connection may hold before it\n");
+    printf("                    pauses (default: %d, 0 = unlimited)\n\n",
+           CONN_MEM_DEFAULT_KB);
+    printf("  -h              Show this help message\n\n");
     printf("Examples:\n");
 #if TLS_ENABLED
     printf("  %s -e none                          # Plain TCP server\n", prog_name);
@@ -471,6 +1535,14 @@ void print_usage(const char *prog_name) {
     printf("  %s -p 12345                         # TCP server on port 12345\n", prog_name);
 #endif
     printf("  %s -c 127.0.0.1:12345               # Connect as client\n", prog_name);
+    printf("  %s -c 127.0.0.1:12345 --raw cam1 < feed\n", prog_name);
+    printf("                                      # Spliced to the other cam1 client\n");
     printf("  %s -c 192.168.1.100:12345 -s /dev/ttyUSB0 -b 115200\n", prog_name);
     printf("                                      # Serial bridge at 115200 baud\n");
+    printf("  %s -c 192.168.1.100:12345 -s /dev/ttyS0 -s /dev/ttyS1@9600\n", prog_name);
+    printf("                                      # Two ports, one event loop\n");
+    printf("  %s -c 192.168.1.100:12345 -s /dev/ttyS0#latest --udp\n", prog_name);
+    printf("                                      # Newest setpoints only, over UDP\n");
+    printf("  %s -s /dev/ttyS0 --l2 eth0            # Serial bridge over Ethernet\n", prog_name);
+    printf("  %s -c shm:/run/xoe.sock -s /dev/ttyS0 # Same-host bridge, no TCP\n", prog_name);
 }
@@ -2,7 +2,14 @@
 #define CORE_SERVER_H
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include "lib/security/tls_config.h"
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/net/transport.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/work_pool.h"
+#include "core/config.h"
 
 #if TLS_ENABLED
 #include <openssl/ssl.h>
@@ -12,12 +19,25 @@
  * client_info_t - Structure to hold client connection information
  *
  * Used by the server to manage multiple concurrent client connections
- * in a fixed-size pool.
+ * in a fixed-size pool. Connections are serviced by the event loop
+ * (see core/event_loop.h), not by a thread per client.
  */
-typedef struct {
+typedef struct client_info {
     int client_socket;              /* Client socket file descriptor */
+    xoe_transport_t transport;      /* Frame I/O, bound by the event loop */
     struct sockaddr_in client_addr; /* Client address information */
+    char client_ip[INET_ADDRSTRLEN];/* Printable client address */
     int in_use;                     /* Pool slot in-use flag */
+    uint32_t wire_features;         /* Negotiated XOE_WIRE_FEATURE_* bits */
+    struct xoe_mux *mux;            /* Channel table, on first MUX frame */
+    struct xoe_wire_compress *compress; /* Frame compression, if negotiated */
+    struct serial_session *serial_session; /* Resumable serial session */
+    struct serial_hub_member *hub_member; /* Routing hub topic, if joined */
+    void *loop_owner;               /* Event loop worker servicing the slot */
+    mem_account_t mem;              /* Frame buffers held for the connection */
+    work_seq_t pool_seq;            /* Its pool handler frames, in order */
+    char raw_name[XOE_WIRE_RAW_NAME_MAX + 1]; /* Raw channel joined, if
+                                       any (core/raw_relay.h) */
 #if TLS_ENABLED
     SSL* tls_session;               /* TLS session for encrypted connections */
 #endif
@@ -26,14 +46,65 @@ typedef struct {
 /* Forward declaration for USB server (incomplete type) */
 struct usb_server_t;
 
-/* Global TLS context (declared extern for use in state handlers) */
+/* Global TLS context (declared extern for use in state handlers).
+ * Swapped at runtime by server_tls_ctx_replace(); threads that create
+ * sessions take it with server_tls_ctx_acquire() */
 #if TLS_ENABLED
 extern SSL_CTX* g_tls_ctx;
+
+/**
+ * server_tls_ctx_acquire - Take a reference to the current server context
+ *
+ * Returns: Context with one reference for the caller (drop it with
+ *          SSL_CTX_free() once the session is created), or NULL without TLS
+ *
+ * Sessions created from it keep their own reference, so a certificate
+ * reload never disturbs connections that are already open.
+ */
+SSL_CTX* server_tls_ctx_acquire(void);
+
+/**
+ * server_tls_ctx_replace - Install a new server context
+ * @ctx: New context (ownership passes to the server), or NULL to clear
+ *
+ * Drops the server's reference to the previous context; it is freed once
+ * the last session using it has closed.
+ */
+void server_tls_ctx_replace(SSL_CTX *ctx);
 #endif
 
-/* Global USB server (declared extern for use in state handlers) */
+/* Global USB server (NULL until started, see server_usb_get()) */
 extern struct usb_server_t* g_usb_server;
 
+/**
+ * server_usb_prepare - Set up the USB server to start on first use
+ * @config: Class whitelist and isochronous budget to start it with
+ *
+ * The USB server (device registry and the thread writing its replies)
+ * is only created when the first USB frame arrives, so a server without
+ * USB clients never starts it and accepts its first connection sooner.
+ * Call before connections are accepted.
+ */
+void server_usb_prepare(const xoe_config_t *config);
+
+/**
+ * server_usb_get - The USB server, started on the first call
+ *
+ * Returns: The USB server, or NULL if it could not be created (logged
+ *          once; later calls return NULL until server_usb_prepare())
+ *
+ * Thread-safe. A cluster node calls it up front, as it routes for its
+ * peers before any local client speaks USB.
+ */
+struct usb_server_t *server_usb_get(void);
+
+/**
+ * server_usb_cleanup - Stop the USB server if it was started
+ *
+ * Call once every connection has been released.
+ */
+void server_usb_cleanup(void);
+
 /**
  * acquire_client_slot - Acquire a client slot from the pool
  *
@@ -57,40 +128,133 @@ void release_client_slot(client_info_t *slot);
  * init_client_pool - Initialize the global client pool
  *
  * Must be called before accepting any client connections. Initializes
- * all slots in the pool to an available state.
+ * all slots in the pool to an available state and sets up the
+ * per-address connection rate limiter (@conn_rate connections per 10 s,
+ * 0 = unlimited).
+ */
+void init_client_pool(int conn_rate);
+
+/**
+ * server_set_conn_rate - Change the per-address connection rate limit
+ * @conn_rate: Connections per source address per 10 s (0 = unlimited)
+ *
+ * Returns: 0 on success, negative error code if the limiter cannot be
+ *          set up (the previous limit stays in force)
+ *
+ * Safe to call while listeners are accepting; addresses already tracked
+ * keep their remaining tokens, capped at the new burst.
  */
-void init_client_pool(void);
+int server_set_conn_rate(int conn_rate);
 
 /**
- * handle_client - Thread function to handle a single client connection
- * @arg: Pointer to client_info_t structure (void* for pthread compatibility)
+ * server_apply_live_config - Apply settings that need no restart
+ * @config: Newly active configuration
  *
- * Returns: NULL (pthread thread function requirement)
+ * Returns: 0 on success, E_TLS_HANDSHAKE_FAILED if the certificate or key
+ *          could not be loaded (the previous ones stay in use), other
+ *          negative error codes if a setting could not be applied
+ *
+ * Called by the management "reload" command. Applies the log level, the
+ * connection rate limit, the memory budget, the thread CPU sets and
+ * policies (running threads included) and the USB class whitelist, and -
+ * if the server runs with TLS - reloads the certificate and key from
+ * their paths, so a rotated certificate is picked up by new handshakes.
+ * Socket buffer sizes reach new connections through the published config
+ * snapshot. Open connections are left untouched.
+ */
+int server_apply_live_config(const xoe_config_t *config);
+
+/**
+ * server_protocols_init - Register the server's protocols and start pools
+ *
+ * Returns: 0 on success, negative error code on failure
+ *
+ * Fills the protocol registry (core/protocol_registry.h): wire control,
+ * channel multiplexing and serial run inline on the event loop workers,
+ * USB on the shared protocol pool, and any other protocol is echoed.
+ * Call after server_usb_prepare() and before connections are accepted.
+ */
+int server_protocols_init(void);
+
+/**
+ * server_protocols_cleanup - Stop the protocol pools
+ *
+ * Call once every connection has been released (after
+ * event_loop_cleanup()).
+ */
+void server_protocols_cleanup(void);
+
+/**
+ * server_handle_packet - Process one complete packet from a client
+ * @client: Client the packet arrived on
+ * @packet: Validated packet (payload still owned by the caller)
+ *
+ * Returns: 0 to keep the connection open, negative error code to close it
+ *
+ * Hands the packet to the handler registered for its protocol id (see
+ * server_protocols_init()): USB protocol packets are routed through the
+ * USB server, wire control packets negotiate connection features
+ * (client->wire_features), channel multiplexing frames are answered per
+ * channel (client->mux), serial frames of routing hub members go to the
+ * other members of their topic (client->hub_member); all other protocols
+ * are echoed back to the sender. Called from event loop worker threads.
+ */
+int server_handle_packet(client_info_t *client, xoe_packet_t *packet);
+
+/**
+ * server_flush_outbox - Send the frames queued for a worker's clients
+ * @owner: Event loop worker calling (client->loop_owner of its clients)
+ *
+ * Sends every frame waiting for a hub member serviced by @owner and every
+ * reply a protocol pool queued for one of its clients, on the thread
+ * that owns the connection. Called by the worker after event_loop_kick()
+ * woke it.
+ *
+ * Hub frames are held in the member's outbox while the client has
+ * XOE_TRANSPORT_QUEUE_HIGH bytes or more queued, so a subscriber that
+ * does not read loses frames rather than growing its queue.
+ */
+void server_flush_outbox(void *owner);
+
+/**
+ * server_resume_output - Send what was held back for a client
+ * @client: Client whose outbound queue drained, on its owning worker
+ *
+ * Hub frames left in the member's outbox by server_flush_outbox().
+ */
+void server_resume_output(client_info_t *client);
+
+/**
+ * server_release_client - Tear down a client connection
+ * @client: Client slot to release
  *
- * Handles bidirectional communication with a client, including optional
- * TLS encryption. Runs in a detached thread, one per client connection.
+ * Waits for the protocol pools to finish with the client, lets every
+ * protocol free its state (USB server registration, channel table,
+ * routing hub topic, serial session), shuts down any TLS session,
+ * closes the socket and returns the slot to the pool. Must only be called
+ * by the thread that owns the connection.
  */
-void *handle_client(void *arg);
+void server_release_client(client_info_t *client);
 
 /**
  * disconnect_all_clients - Close all active client connections
  *
- * Closes sockets for all clients currently in the pool. Threads will
- * exit when they detect the closed socket. Does NOT wait for threads
- * to exit - use wait_for_clients() for that.
+ * Shuts down sockets for all clients currently in the pool. The owning
+ * event loop worker sees the hangup and releases the connection. Does
+ * NOT wait for teardown - use wait_for_clients() for that.
  *
  * Thread-safe: Uses pool mutex for protection.
  */
 void disconnect_all_clients(void);
 
 /**
- * wait_for_clients - Wait for all client threads to exit
+ * wait_for_clients - Wait for all client connections to be released
  * @timeout_sec: Maximum seconds to wait (0 = no wait, just check)
  *
  * Returns: Number of clients still active after timeout
  *
  * Polls the client pool for up to timeout_sec seconds, waiting for
- * all in_use flags to become 0 (indicating threads have exited).
+ * all in_use flags to become 0 (indicating connections were released).
  * Returns early if all clients disconnect before timeout.
  */
 int wait_for_clients(int timeout_sec);
@@ -105,14 +269,17 @@ int wait_for_clients(int timeout_sec);
 int get_active_client_count(void);
 
 /**
- * check_connection_rate_limit - Check if IP is rate-limited (NET-012 fix)
- * @ip: Client IP address in network byte order
+ * check_connection_rate_limit - Check if a peer is rate-limited (NET-012 fix)
+ * @addr: Peer address (AF_INET or AF_INET6)
  *
  * Returns: 1 if connection allowed, 0 if rate-limited
  *
- * Implements sliding window rate limiting: max 20 connections per 10 seconds
- * per source IP address. Prevents connection flood DoS attacks.
+ * Token bucket per source address: bursts of --conn-rate connections,
+ * refilled at the same number per 10 seconds (server_set_conn_rate()).
+ * Up to 1024 addresses are tracked; beyond that the
+ * least recently seen is forgotten, so a flood of new addresses cannot
+ * switch limiting off. Prevents connection flood DoS attacks.
  */
-int check_connection_rate_limit(in_addr_t ip);
+int check_connection_rate_limit(const struct sockaddr *addr);
 
 #endif /* CORE_SERVER_H */
@@ -35,6 +35,7 @@
 #define E_NOT_SUPPORTED        -23  /* Operation not supported */
 #define E_USB_TRANSFER_ERROR   -24  /* Generic USB transfer error */
 #define E_DNS_ERROR            -25  /* DNS resolution failed */
+#define E_WOULD_BLOCK          -26  /* Non-blocking operation would block */
 
 /* USB-specific Error Definitions (start at -100) */
 #define E_USB_NOT_FOUND        -100  /* USB device not found */
@@ -55,4 +56,7 @@
 #define E_USB_CLASS_BLOCKED    -113  /* Device class not allowed */
 #define E_USB_AUTH_TIMEOUT     -114  /* Authentication timeout */
 
+/* USB Stream Admission Error Definitions */
+#define E_USB_NO_BANDWIDTH     -115  /* Isochronous budget exhausted */
+
 #endif /* COMMON_DEFINITIONS_H */
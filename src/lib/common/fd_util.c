@@ -0,0 +1,20 @@
+/**
+ * @file fd_util.c
+ * @brief Descriptor flag helpers
+ *
+ * [LLM-ARCH]
+ */
+
+#include "fd_util.h"
+
+#include <fcntl.h>
+
+int fd_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0) {
+        return -1;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0 ? -1 : 0;
+}
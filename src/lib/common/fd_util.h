@@ -0,0 +1,19 @@
+/**
+ * @file fd_util.h
+ * @brief Descriptor flag helpers shared by sockets, pipes and ttys
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef FD_UTIL_H
+#define FD_UTIL_H
+
+/**
+ * @brief Put a descriptor into O_NONBLOCK mode, keeping its other flags
+ *
+ * @param fd  Open descriptor
+ * @return 0 on success, -1 with errno set on failure
+ */
+int fd_set_nonblocking(int fd);
+
+#endif /* FD_UTIL_H */
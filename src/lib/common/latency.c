@@ -0,0 +1,243 @@
+/**
+ * @file latency.c
+ * @brief Log-linear latency histograms
+ *
+ * Bucket index = shift * LATENCY_SUB_BUCKETS + (ns >> shift), where shift
+ * drops all but the top LATENCY_SUB_BUCKET_BITS + 1 significant bits.
+ * Values below 2 * LATENCY_SUB_BUCKETS are exact; above that each power
+ * of two spans LATENCY_SUB_BUCKETS equal-width buckets, and the indices
+ * of successive powers are contiguous.
+ *
+ * Histograms are shared by all threads and updated with relaxed atomics:
+ * the recorded stages run at most a few hundred thousand times a second,
+ * far below the rate where a shared line would matter, and per-thread
+ * copies of 4.7 KB histograms would cost more cache than they save.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "latency.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Largest sample kept in range */
+#define LATENCY_MAX_NS ((1ULL << LATENCY_MAX_BITS) - 1)
+
+typedef struct {
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_histogram_t;
+
+static latency_histogram_t histograms[LATENCY_COUNT];
+
+static const latency_desc_t descriptors[LATENCY_COUNT] = {
+    {"usb_urb_completion",
+     "USB client URB submit-to-completion latency"},
+    {"usb_route",
+     "USB server time from URB receipt to queued for its target"},
+    {"serial_to_net",
+     "Serial bridge time from port read to frame sent"},
+    {"bench_connect",
+     "Bench client TCP connect plus TLS handshake time"},
+    {"bench_rtt",
+     "Bench client frame round-trip time"}
+};
+
+/* ========================================================================
+ * Bucket Arithmetic
+ * ======================================================================== */
+
+/**
+ * @brief Bucket holding a sample
+ */
+static int bucket_index(uint64_t ns)
+{
+    int shift;
+
+    if (ns > LATENCY_MAX_NS) {
+        ns = LATENCY_MAX_NS;
+    }
+
+    /* Keep the top LATENCY_SUB_BUCKET_BITS + 1 significant bits */
+    shift = 0;
+    if (ns >= (uint64_t)(2 * LATENCY_SUB_BUCKETS)) {
+        shift = (63 - __builtin_clzll(ns)) - LATENCY_SUB_BUCKET_BITS;
+    }
+
+    return shift * LATENCY_SUB_BUCKETS + (int)(ns >> shift);
+}
+
+/**
+ * @brief Highest sample that lands in a bucket
+ */
+static uint64_t bucket_highest(int index)
+{
+    int shift;
+    uint64_t sub;
+
+    if (index < 2 * LATENCY_SUB_BUCKETS) {
+        return (uint64_t)index;
+    }
+
+    shift = index / LATENCY_SUB_BUCKETS - 1;
+    sub = (uint64_t)(index - shift * LATENCY_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+void latency_record(latency_id_t id, uint64_t ns)
+{
+    latency_histogram_t* hist;
+    uint64_t max;
+
+    if ((int)id < 0 || id >= LATENCY_COUNT) {
+        return;
+    }
+    hist = &histograms[id];
+
+    __atomic_fetch_add(&hist->buckets[bucket_index(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum_ns, ns, __ATOMIC_RELAXED);
+
+    /* New maxima are rare: only they pay for the compare-and-swap */
+    max = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+    while (ns > max &&
+           !__atomic_compare_exchange_n(&hist->max_ns, &max, ns, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* max reloaded by the failed exchange */
+    }
+}
+
+void latency_record_since(latency_id_t id, uint64_t start_ns)
+{
+    uint64_t now;
+
+    now = latency_now_ns();
+    latency_record(id, now > start_ns ? now - start_ns : 0);
+}
+
+uint64_t latency_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t latency_now_ms(void)
+{
+    return latency_now_ns() / 1000000ULL;
+}
+
+void latency_snapshot(latency_id_t id, latency_snapshot_t* snapshot)
+{
+    const latency_histogram_t* hist;
+    int i;
+
+    if (snapshot == NULL) {
+        return;
+    }
+    memset(snapshot, 0, sizeof(*snapshot));
+    if ((int)id < 0 || id >= LATENCY_COUNT) {
+        return;
+    }
+    hist = &histograms[id];
+
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        snapshot->buckets[i] = __atomic_load_n(&hist->buckets[i],
+                                               __ATOMIC_RELAXED);
+        snapshot->count += snapshot->buckets[i];
+    }
+    snapshot->sum_ns = __atomic_load_n(&hist->sum_ns, __ATOMIC_RELAXED);
+    snapshot->max_ns = __atomic_load_n(&hist->max_ns, __ATOMIC_RELAXED);
+}
+
+uint64_t latency_percentile(const latency_snapshot_t* snapshot,
+                            double quantile)
+{
+    uint64_t rank;
+    uint64_t seen;
+    uint64_t value;
+    int i;
+
+    if (snapshot == NULL || snapshot->count == 0) {
+        return 0;
+    }
+
+    if (quantile < 0.0) {
+        quantile = 0.0;
+    } else if (quantile > 1.0) {
+        quantile = 1.0;
+    }
+
+    /* 1-based rank of the sample at this quantile */
+    rank = (uint64_t)(quantile * (double)snapshot->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    } else if (rank > snapshot->count) {
+        rank = snapshot->count;
+    }
+
+    seen = 0;
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += snapshot->buckets[i];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    if (i == LATENCY_BUCKETS) {
+        i = LATENCY_BUCKETS - 1;
+    }
+
+    value = bucket_highest(i);
+    if (snapshot->max_ns != 0 && value > snapshot->max_ns) {
+        value = snapshot->max_ns;
+    }
+    return value;
+}
+
+const latency_desc_t* latency_describe(latency_id_t id)
+{
+    if ((int)id < 0 || id >= LATENCY_COUNT) {
+        return NULL;
+    }
+    return &descriptors[id];
+}
+
+int latency_format_prometheus(const latency_snapshot_t* snapshot,
+                              latency_id_t id, char* buffer, size_t size)
+{
+    const latency_desc_t* desc;
+    int len;
+
+    desc = latency_describe(id);
+    if (snapshot == NULL || desc == NULL || buffer == NULL || size == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    len = snprintf(buffer, size,
+                   "# HELP xoe_%s_seconds %s\n"
+                   "# TYPE xoe_%s_seconds summary\n"
+                   "xoe_%s_seconds{quantile=\"0.5\"} %.9f\n"
+                   "xoe_%s_seconds{quantile=\"0.99\"} %.9f\n"
+                   "xoe_%s_seconds{quantile=\"0.999\"} %.9f\n"
+                   "xoe_%s_seconds_sum %.9f\n"
+                   "xoe_%s_seconds_count %llu\n",
+                   desc->name, desc->help,
+                   desc->name,
+                   desc->name, (double)latency_percentile(snapshot, 0.5) / 1e9,
+                   desc->name, (double)latency_percentile(snapshot, 0.99) / 1e9,
+                   desc->name, (double)latency_percentile(snapshot, 0.999) / 1e9,
+                   desc->name, (double)snapshot->sum_ns / 1e9,
+                   desc->name, (unsigned long long)snapshot->count);
+    if (len < 0 || (size_t)len >= size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+    return len;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file latency.h
+ * @brief Process-wide latency histograms
+ *
+ * A fixed registry of log-linear (HDR-style) histograms for the stages
+ * whose tail latency matters: USB URB submit-to-completion on the client,
+ * URB routing on the server, serial read-to-network send, and the bench
+ * client's connection setup and frame round trip. Samples are
+ * nanoseconds; each power of two is split into LATENCY_SUB_BUCKETS linear
+ * buckets, so every reported value is within 1/LATENCY_SUB_BUCKETS of the
+ * recorded one, from 1 ns up to 2^LATENCY_MAX_BITS ns (about 18 minutes;
+ * longer samples land in the last bucket).
+ *
+ * Recording is two relaxed atomic adds and a load; snapshots and
+ * percentiles never block writers.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "lib/common/types.h"
+#include <stddef.h>
+
+/* Linear buckets per power of two (2^4 = 16: at most 6.25% error) */
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKETS     (1 << LATENCY_SUB_BUCKET_BITS)
+
+/* Largest sample kept exactly in range is 2^LATENCY_MAX_BITS - 1 ns */
+#define LATENCY_MAX_BITS        40
+
+/* Buckets per histogram */
+#define LATENCY_BUCKETS \
+    ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+/* Longest text produced by latency_format_prometheus() for one histogram */
+#define LATENCY_FORMAT_MAX 640
+
+/**
+ * @brief Registered histograms
+ *
+ * Append new histograms before LATENCY_COUNT and describe them in
+ * latency.c.
+ */
+typedef enum {
+    LATENCY_USB_URB_COMPLETION,     /* Client URB submit to response */
+    LATENCY_USB_ROUTE,              /* Server URB receipt to queued for target */
+    LATENCY_SERIAL_TO_NET,          /* Serial read to frame sent */
+    LATENCY_BENCH_CONNECT,          /* Bench client connect + handshake */
+    LATENCY_BENCH_RTT,              /* Bench client frame round trip */
+
+    LATENCY_COUNT
+} latency_id_t;
+
+/**
+ * @brief Static description of a histogram
+ */
+typedef struct {
+    const char* name;               /* snake_case, without prefix/unit */
+    const char* help;               /* One-line description */
+} latency_desc_t;
+
+/**
+ * @brief Point-in-time copy of one histogram
+ */
+typedef struct {
+    uint64_t count;                 /* Samples */
+    uint64_t sum_ns;                /* Sum of samples */
+    uint64_t max_ns;                /* Largest sample */
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_snapshot_t;
+
+/**
+ * @brief Record one sample
+ *
+ * @param id    Histogram (out-of-range ids are ignored)
+ * @param ns    Latency in nanoseconds
+ */
+void latency_record(latency_id_t id, uint64_t ns);
+
+/**
+ * @brief Record the time elapsed since @p start_ns
+ *
+ * @param id        Histogram (out-of-range ids are ignored)
+ * @param start_ns  Earlier latency_now_ns() reading
+ */
+void latency_record_since(latency_id_t id, uint64_t start_ns);
+
+/**
+ * @brief Monotonic clock in nanoseconds, for latency_record_since()
+ */
+uint64_t latency_now_ns(void);
+
+/**
+ * @brief Monotonic clock in milliseconds, for timeouts and deadlines
+ */
+uint64_t latency_now_ms(void);
+
+/**
+ * @brief Copy one histogram into @p snapshot
+ *
+ * Buckets read while writers run are each up to date to within the
+ * samples in flight; count is the sum of the copied buckets.
+ *
+ * @param id        Histogram
+ * @param snapshot  Receives the copy (zeroed for an out-of-range id)
+ */
+void latency_snapshot(latency_id_t id, latency_snapshot_t* snapshot);
+
+/**
+ * @brief Value at a quantile of a snapshot
+ *
+ * Reports the highest value equivalent to the bucket holding the sample
+ * of that rank, capped at the largest sample.
+ *
+ * @param snapshot  Histogram copy
+ * @param quantile  0.0 to 1.0 (e.g. 0.999 for p999)
+ *
+ * @return Latency in nanoseconds, or 0 for an empty histogram
+ */
+uint64_t latency_percentile(const latency_snapshot_t* snapshot,
+                            double quantile);
+
+/**
+ * @brief Describe a histogram
+ *
+ * @return Description, or NULL for an out-of-range id
+ */
+const latency_desc_t* latency_describe(latency_id_t id);
+
+/**
+ * @brief Format one histogram in the Prometheus text exposition format
+ *
+ * Writes a summary named "xoe_<name>_seconds" with the 0.5, 0.99 and
+ * 0.999 quantiles, _sum and _count.
+ *
+ * @param snapshot  Histogram copy
+ * @param id        Histogram it was taken from
+ * @param buffer    Output (NUL-terminated)
+ * @param size      Size of @p buffer (LATENCY_FORMAT_MAX always suffices)
+ *
+ * @return Length written, E_INVALID_ARGUMENT, or E_BUFFER_TOO_SMALL
+ */
+int latency_format_prometheus(const latency_snapshot_t* snapshot,
+                              latency_id_t id, char* buffer, size_t size);
+
+#endif /* LATENCY_H */
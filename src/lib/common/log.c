@@ -0,0 +1,383 @@
+/**
+ * @file log.c
+ * @brief Lock-free log ring drained by a writer thread
+ *
+ * The ring is a bounded multi-producer queue (Vyukov): each slot carries
+ * a sequence number that tells producers whether it is free for their
+ * ticket and the writer whether it holds a finished line. Producers claim
+ * a ticket with one compare-and-swap, format straight into the slot, and
+ * publish it with a release store; nothing waits on the writer.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "log.h"
+#include "lib/common/definitions.h"
+#include "lib/common/thread_sched.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+
+#define LOG_RING_MASK ((size_t)LOG_RING_SLOTS - 1)
+
+typedef struct {
+    size_t seq;                     /* Ticket this slot is free/full for */
+    log_level_t level;
+    int len;
+    char text[LOG_LINE_MAX];
+} log_slot_t;
+
+static log_slot_t ring[LOG_RING_SLOTS];
+static size_t enqueue_pos;
+static size_t dequeue_pos;          /* Writer thread only */
+
+static int running = FALSE;         /* Writer accepting from the ring */
+static int stopping = FALSE;
+static int atexit_registered = FALSE;
+static pthread_t writer_thread;
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int current_level = LOG_DEFAULT_LEVEL;
+static uint64_t dropped_total;
+static uint64_t dropped_reported;   /* Writer thread only */
+
+static const char* const level_names[] = {"error", "warn", "info", "debug"};
+static const char* const level_tags[] = {"ERROR", "WARN", "INFO", "DEBUG"};
+
+/* ========================================================================
+ * Helper Functions
+ * ======================================================================== */
+
+/**
+ * @brief Current monotonic second, for rate limiting
+ */
+static uint64_t now_seconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+/**
+ * @brief Apply the call site's per-second limit
+ *
+ * @return Messages suppressed before this one (>= 0), or -1 to drop it
+ */
+static long site_admit(log_site_t* site)
+{
+    uint64_t now;
+    uint64_t window;
+
+    now = now_seconds();
+    window = __atomic_load_n(&site->window, __ATOMIC_RELAXED);
+    if (window != now &&
+        __atomic_compare_exchange_n(&site->window, &window, now, FALSE,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&site->count, 0, __ATOMIC_RELAXED);
+    }
+
+    if (__atomic_fetch_add(&site->count, 1, __ATOMIC_RELAXED) >=
+        LOG_RATE_LIMIT) {
+        __atomic_fetch_add(&site->suppressed, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    return (long)__atomic_exchange_n(&site->suppressed, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Format one line (always newline-terminated, truncated to fit)
+ *
+ * @return Length of the line
+ */
+static int format_line(char* buffer, log_level_t level, const char* file,
+                       int line, long suppressed, const char* fmt,
+                       va_list args)
+{
+    int len;
+    int n;
+
+    /* Leave room for the newline */
+    if (level <= LOG_LEVEL_WARN) {
+        len = snprintf(buffer, LOG_LINE_MAX - 1, "[%s] %s:%d: ",
+                       level_tags[level], file, line);
+    } else {
+        len = snprintf(buffer, LOG_LINE_MAX - 1, "[%s] ", level_tags[level]);
+    }
+    if (len < 0 || len >= LOG_LINE_MAX - 1) {
+        len = LOG_LINE_MAX - 2;
+    }
+
+    n = vsnprintf(buffer + len, (size_t)(LOG_LINE_MAX - 1 - len), fmt, args);
+    if (n > 0) {
+        len += n;
+        if (len >= LOG_LINE_MAX - 1) {
+            len = LOG_LINE_MAX - 2;
+        }
+    }
+
+    if (suppressed > 0) {
+        n = snprintf(buffer + len, (size_t)(LOG_LINE_MAX - 1 - len),
+                     " (%ld similar suppressed)", suppressed);
+        if (n > 0) {
+            len += n;
+            if (len >= LOG_LINE_MAX - 1) {
+                len = LOG_LINE_MAX - 2;
+            }
+        }
+    }
+
+    buffer[len++] = '\n';
+    buffer[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Write a finished line to its stream
+ */
+static void emit_line(log_level_t level, const char* text, int len)
+{
+    fwrite(text, 1, (size_t)len, level <= LOG_LEVEL_WARN ? stderr : stdout);
+}
+
+/**
+ * @brief Claim a ring slot
+ *
+ * @return Slot owned by the caller until published, or NULL if full
+ */
+static log_slot_t* ring_claim(size_t* ticket)
+{
+    log_slot_t* slot;
+    size_t pos;
+    size_t seq;
+    intptr_t diff;
+
+    pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+    for (;;) {
+        slot = &ring[pos & LOG_RING_MASK];
+        seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, TRUE,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                *ticket = pos;
+                return slot;
+            }
+            /* pos reloaded by the failed exchange */
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Write every published line (writer thread)
+ *
+ * @return Lines written
+ */
+static int ring_drain(void)
+{
+    log_slot_t* slot;
+    uint64_t dropped;
+    char note[64];
+    int written = 0;
+    int len;
+
+    for (;;) {
+        slot = &ring[dequeue_pos & LOG_RING_MASK];
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != dequeue_pos + 1) {
+            break;
+        }
+        emit_line(slot->level, slot->text, slot->len);
+        __atomic_store_n(&slot->seq, dequeue_pos + LOG_RING_SLOTS,
+                         __ATOMIC_RELEASE);
+        dequeue_pos++;
+        written++;
+    }
+
+    dropped = __atomic_load_n(&dropped_total, __ATOMIC_RELAXED);
+    if (dropped != dropped_reported) {
+        len = snprintf(note, sizeof(note),
+                       "[WARN] log: %llu messages dropped (ring full)\n",
+                       (unsigned long long)(dropped - dropped_reported));
+        emit_line(LOG_LEVEL_WARN, note, len);
+        dropped_reported = dropped;
+        written++;
+    }
+
+    if (written > 0) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+    return written;
+}
+
+/**
+ * @brief Writer thread: drain until stopped, then drain once more
+ */
+static void* writer_thread_func(void* arg)
+{
+    struct timespec interval;
+
+    (void)arg;
+    interval.tv_sec = 0;
+    interval.tv_nsec = LOG_DRAIN_INTERVAL_MS * 1000000L;
+
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        if (ring_drain() == 0) {
+            nanosleep(&interval, NULL);
+        }
+    }
+
+    ring_drain();
+    return NULL;
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+int log_start(void)
+{
+    size_t i;
+
+    pthread_mutex_lock(&control_lock);
+    if (running) {
+        pthread_mutex_unlock(&control_lock);
+        return 0;
+    }
+
+    for (i = 0; i < LOG_RING_SLOTS; i++) {
+        ring[i].seq = i;
+    }
+    enqueue_pos = 0;
+    dequeue_pos = 0;
+    dropped_reported = __atomic_load_n(&dropped_total, __ATOMIC_RELAXED);
+    __atomic_store_n(&stopping, FALSE, __ATOMIC_RELAXED);
+
+    if (thread_sched_create(&writer_thread, THREAD_CLASS_NONE,
+                            writer_thread_func, NULL) != 0) {
+        pthread_mutex_unlock(&control_lock);
+        return E_UNKNOWN_ERROR;
+    }
+
+    /* Ring initialized before any producer can see running */
+    __atomic_store_n(&running, TRUE, __ATOMIC_RELEASE);
+
+    if (!atexit_registered) {
+        atexit(log_stop);
+        atexit_registered = TRUE;
+    }
+    pthread_mutex_unlock(&control_lock);
+    return 0;
+}
+
+void log_stop(void)
+{
+    pthread_mutex_lock(&control_lock);
+    if (!running) {
+        pthread_mutex_unlock(&control_lock);
+        return;
+    }
+
+    /* New messages go direct; queued ones are written before the join */
+    __atomic_store_n(&running, FALSE, __ATOMIC_RELEASE);
+    __atomic_store_n(&stopping, TRUE, __ATOMIC_RELEASE);
+    pthread_join(writer_thread, NULL);
+    pthread_mutex_unlock(&control_lock);
+}
+
+void log_set_level(log_level_t level)
+{
+    if ((int)level < LOG_LEVEL_ERROR || level > LOG_LEVEL_DEBUG) {
+        return;
+    }
+    __atomic_store_n(&current_level, (int)level, __ATOMIC_RELAXED);
+}
+
+log_level_t log_get_level(void)
+{
+    return (log_level_t)__atomic_load_n(&current_level, __ATOMIC_RELAXED);
+}
+
+int log_parse_level(const char* name, log_level_t* level)
+{
+    int i;
+
+    if (name == NULL || level == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i <= (int)LOG_LEVEL_DEBUG; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            *level = (log_level_t)i;
+            return 0;
+        }
+    }
+    return E_INVALID_ARGUMENT;
+}
+
+int log_enabled(log_level_t level)
+{
+    return (int)level <= __atomic_load_n(&current_level, __ATOMIC_RELAXED);
+}
+
+uint64_t log_dropped(void)
+{
+    return __atomic_load_n(&dropped_total, __ATOMIC_RELAXED);
+}
+
+void log_write(log_site_t* site, log_level_t level,
+               const char* file, int line, const char* fmt, ...)
+{
+    char direct[LOG_LINE_MAX];
+    log_slot_t* slot;
+    va_list args;
+    size_t ticket;
+    long suppressed;
+    int len;
+
+    if ((int)level < LOG_LEVEL_ERROR || level > LOG_LEVEL_DEBUG ||
+        fmt == NULL) {
+        return;
+    }
+
+    suppressed = 0;
+    if (site != NULL) {
+        suppressed = site_admit(site);
+        if (suppressed < 0) {
+            return;
+        }
+    }
+
+    va_start(args, fmt);
+    if (!__atomic_load_n(&running, __ATOMIC_ACQUIRE)) {
+        len = format_line(direct, level, file, line, suppressed, fmt, args);
+        va_end(args);
+        emit_line(level, direct, len);
+        return;
+    }
+
+    slot = ring_claim(&ticket);
+    if (slot == NULL) {
+        va_end(args);
+        __atomic_fetch_add(&dropped_total, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    slot->level = level;
+    slot->len = format_line(slot->text, level, file, line, suppressed,
+                            fmt, args);
+    va_end(args);
+    __atomic_store_n(&slot->seq, ticket + 1, __ATOMIC_RELEASE);
+}
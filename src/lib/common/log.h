@@ -0,0 +1,148 @@
+/**
+ * @file log.h
+ * @brief Asynchronous, rate-limited logging
+ *
+ * LOG_ERROR / LOG_WARN / LOG_INFO / LOG_DEBUG take a printf format and
+ * arguments. Messages below the current level cost one load and a
+ * compare. Enabled messages are formatted by the caller into a slot of a
+ * lock-free ring and written to stdout (info, debug) or stderr (warn,
+ * error) by a background thread, so a slow terminal never stalls a data
+ * path; when the ring is full the message is dropped and counted rather
+ * than waited for.
+ *
+ * Every call site allows LOG_RATE_LIMIT messages per second. Further
+ * messages from that site in the same second are suppressed, and the next
+ * one that gets through reports how many were.
+ *
+ * Before log_start() (and after log_stop()) messages are written
+ * synchronously, so tools and tests need no setup.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "lib/common/types.h"
+
+/* Ring capacity in messages (power of two) */
+#ifndef LOG_RING_SLOTS
+#if XOE_SMALL_FOOTPRINT
+#define LOG_RING_SLOTS 128
+#else
+#define LOG_RING_SLOTS 1024
+#endif
+#endif
+
+/* Longest formatted line, including the level and site prefix */
+#define LOG_LINE_MAX 256
+
+/* Messages per second allowed from one call site */
+#define LOG_RATE_LIMIT 20
+
+/* Writer thread poll interval while the ring is empty */
+#define LOG_DRAIN_INTERVAL_MS 5
+
+/**
+ * @brief Log levels, most severe first
+ */
+typedef enum {
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} log_level_t;
+
+/* Level in effect until log_set_level() */
+#ifndef LOG_DEFAULT_LEVEL
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO
+#endif
+
+/**
+ * @brief Rate limiting state of one call site (zero-initialized)
+ */
+typedef struct {
+    uint64_t window;                /* Second the count applies to */
+    uint32_t count;                 /* Messages in that second */
+    uint32_t suppressed;            /* Dropped since the last one written */
+} log_site_t;
+
+/**
+ * @brief Log at a level from this call site
+ *
+ * The first variadic argument is the format string.
+ */
+#define LOG_AT(level, ...) do { \
+    static log_site_t log_site_; \
+    if (log_enabled(level)) { \
+        log_write(&log_site_, (level), __FILE__, __LINE__, __VA_ARGS__); \
+    } \
+} while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+/**
+ * @brief Start the background writer
+ *
+ * Also registers log_stop() with atexit() so queued messages are written
+ * on exit. Calling it again while running does nothing.
+ *
+ * @return 0 on success, E_UNKNOWN_ERROR if the thread cannot be created
+ *         (logging stays synchronous)
+ */
+int log_start(void);
+
+/**
+ * @brief Write everything queued and stop the background writer
+ *
+ * Later messages are written synchronously.
+ */
+void log_stop(void);
+
+/**
+ * @brief Set the most verbose level that is written
+ */
+void log_set_level(log_level_t level);
+
+/**
+ * @brief Current level
+ */
+log_level_t log_get_level(void);
+
+/**
+ * @brief Parse "error", "warn", "info" or "debug"
+ *
+ * @param name   Level name
+ * @param level  Receives the level
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT for an unknown name
+ */
+int log_parse_level(const char* name, log_level_t* level);
+
+/**
+ * @brief Check whether a level is written
+ */
+int log_enabled(log_level_t level);
+
+/**
+ * @brief Messages dropped on a full ring since startup
+ */
+uint64_t log_dropped(void);
+
+/**
+ * @brief Format and queue one message (use the LOG_* macros)
+ *
+ * @param site   Call site's rate limiting state
+ * @param level  Message level
+ * @param file   Source file, shown for warnings and errors
+ * @param line   Source line
+ * @param fmt    printf format
+ */
+void log_write(log_site_t* site, log_level_t level,
+               const char* file, int line, const char* fmt, ...)
+    __attribute__((format(printf, 5, 6)));
+
+#endif /* LOG_H */
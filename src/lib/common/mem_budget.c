@@ -0,0 +1,122 @@
+/**
+ * @file mem_budget.c
+ * @brief Process-wide memory budget with per-connection accounts
+ *
+ * Relaxed atomics throughout: the budget steers flow control, it does not
+ * order other memory accesses, and a reading a few bytes stale only moves
+ * the point at which readers pause by as much. The used total is also
+ * published as the METRIC_MEM_USED gauge.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "mem_budget.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+
+static size_t budget_limit;
+static size_t budget_conn_limit;
+static size_t budget_used;
+static size_t budget_peak;
+
+void mem_budget_set_limit(size_t bytes)
+{
+    __atomic_store_n(&budget_limit, bytes, __ATOMIC_RELAXED);
+}
+
+size_t mem_budget_limit(void)
+{
+    return __atomic_load_n(&budget_limit, __ATOMIC_RELAXED);
+}
+
+void mem_budget_set_conn_limit(size_t bytes)
+{
+    __atomic_store_n(&budget_conn_limit, bytes, __ATOMIC_RELAXED);
+}
+
+size_t mem_budget_conn_limit(void)
+{
+    return __atomic_load_n(&budget_conn_limit, __ATOMIC_RELAXED);
+}
+
+size_t mem_budget_used(void)
+{
+    return __atomic_load_n(&budget_used, __ATOMIC_RELAXED);
+}
+
+size_t mem_budget_peak(void)
+{
+    return __atomic_load_n(&budget_peak, __ATOMIC_RELAXED);
+}
+
+void mem_budget_charge(size_t bytes)
+{
+    size_t used;
+    size_t peak;
+
+    if (bytes == 0) {
+        return;
+    }
+    used = __atomic_add_fetch(&budget_used, bytes, __ATOMIC_RELAXED);
+    metrics_add(METRIC_MEM_USED, bytes);
+
+    peak = __atomic_load_n(&budget_peak, __ATOMIC_RELAXED);
+    while (used > peak &&
+           !__atomic_compare_exchange_n(&budget_peak, &peak, used, TRUE,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        /* peak reloaded by the failed exchange */
+    }
+}
+
+void mem_budget_uncharge(size_t bytes)
+{
+    if (bytes == 0) {
+        return;
+    }
+    __atomic_sub_fetch(&budget_used, bytes, __ATOMIC_RELAXED);
+    metrics_sub(METRIC_MEM_USED, bytes);
+}
+
+int mem_budget_fits(size_t bytes)
+{
+    size_t limit = mem_budget_limit();
+
+    return limit == 0 || mem_budget_used() + bytes <= limit;
+}
+
+int mem_budget_pressure(void)
+{
+    size_t limit = mem_budget_limit();
+
+    return limit != 0 &&
+           mem_budget_used() >= limit / 100 * MEM_BUDGET_HIGH_WATER_PCT;
+}
+
+void mem_account_charge(mem_account_t* account, size_t bytes)
+{
+    if (account != NULL) {
+        __atomic_add_fetch(&account->used, bytes, __ATOMIC_RELAXED);
+    }
+}
+
+void mem_account_uncharge(mem_account_t* account, size_t bytes)
+{
+    if (account != NULL) {
+        __atomic_sub_fetch(&account->used, bytes, __ATOMIC_RELAXED);
+    }
+}
+
+size_t mem_account_used(const mem_account_t* account)
+{
+    if (account == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&account->used, __ATOMIC_RELAXED);
+}
+
+int mem_account_over(const mem_account_t* account)
+{
+    size_t limit = mem_budget_conn_limit();
+
+    return limit != 0 && mem_account_used(account) >= limit;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file mem_budget.h
+ * @brief Process-wide memory budget with per-connection accounts
+ *
+ * The memory that grows with traffic is charged here: payload blocks in
+ * use (frames received, queued or being sent; blocks idle in the per-thread
+ * caches are not counted), wire decoder staging buffers and serial ring
+ * buffers. One atomic counter holds the total, charged by whoever
+ * allocates. A connection's own share (its staging buffer, the frame it
+ * is receiving and the frames queued for pool handlers) is tracked on top
+ * in its mem_account_t, which does not add to the total again.
+ *
+ * The budget is enforced in two steps. From MEM_BUDGET_HIGH_WATER_PCT of
+ * the limit, mem_budget_pressure() asks readers to stop taking new data
+ * (the server parks connections, so TCP flow control pushes back on the
+ * peers), and a connection whose account is over its own limit is parked
+ * the same way. A decoder with an account holds back a frame whose
+ * payload would take the total past the limit (mem_budget_fits()) until
+ * it fits, and refuses one larger than the whole limit.
+ *
+ * With no limit set (the default) charging still counts, so the usage is
+ * visible, but nothing is throttled or refused.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef MEM_BUDGET_H
+#define MEM_BUDGET_H
+
+#include <stddef.h>
+
+/* Share of the limit at which readers are throttled */
+#define MEM_BUDGET_HIGH_WATER_PCT 75
+
+/* Largest --mem-budget accepted (MiB) */
+#define MEM_BUDGET_MAX_MB (64 * 1024)
+
+/* Largest --conn-mem accepted (KiB) */
+#define MEM_BUDGET_MAX_CONN_KB (1024 * 1024)
+
+/**
+ * @brief Bytes held on behalf of one connection
+ *
+ * Zero-initialize. Only bytes already charged to the total are tracked.
+ */
+typedef struct {
+    size_t used;                    /* Atomic */
+} mem_account_t;
+
+/**
+ * @brief Set the limit in bytes (0 = unlimited)
+ */
+void mem_budget_set_limit(size_t bytes);
+
+/**
+ * @brief Current limit in bytes (0 = unlimited)
+ */
+size_t mem_budget_limit(void);
+
+/**
+ * @brief Set the per-connection limit in bytes (0 = unlimited)
+ */
+void mem_budget_set_conn_limit(size_t bytes);
+
+/**
+ * @brief Current per-connection limit in bytes (0 = unlimited)
+ */
+size_t mem_budget_conn_limit(void);
+
+/**
+ * @brief Bytes charged now
+ */
+size_t mem_budget_used(void);
+
+/**
+ * @brief Highest total charged since start
+ */
+size_t mem_budget_peak(void);
+
+/**
+ * @brief Add @p bytes to the total
+ *
+ * Never fails: what is charged here is already allocated.
+ */
+void mem_budget_charge(size_t bytes);
+
+/**
+ * @brief Take @p bytes back from the total
+ */
+void mem_budget_uncharge(size_t bytes);
+
+/**
+ * @brief Whether @p bytes more would stay within the limit
+ */
+int mem_budget_fits(size_t bytes);
+
+/**
+ * @brief Whether the total is at or past the high-water mark
+ */
+int mem_budget_pressure(void);
+
+/**
+ * @brief Track @p bytes more as held by @p account (NULL is a no-op)
+ */
+void mem_account_charge(mem_account_t* account, size_t bytes);
+
+/**
+ * @brief Track @p bytes fewer as held by @p account (NULL is a no-op)
+ */
+void mem_account_uncharge(mem_account_t* account, size_t bytes);
+
+/**
+ * @brief Bytes held by @p account (0 for NULL)
+ */
+size_t mem_account_used(const mem_account_t* account);
+
+/**
+ * @brief Whether @p account holds its per-connection limit or more
+ */
+int mem_account_over(const mem_account_t* account);
+
+#endif /* MEM_BUDGET_H */
@@ -0,0 +1,318 @@
+/**
+ * @file metrics.c
+ * @brief Sharded, lock-free runtime counters
+ *
+ * Every thread that updates a metric owns one shard (a row of uint64_t,
+ * padded to whole cache lines) found through pthread thread-specific
+ * data. Only the owner writes its shard, so an update is a relaxed load
+ * and store with no bus lock; readers use relaxed loads and sum the rows.
+ * Ownership moves with acquire/release on the shard's in_use flag, which
+ * also publishes the previous owner's last values to the next one.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "metrics.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Metric words per shard, rounded up to whole 64-byte lines */
+#define METRICS_SHARD_WORDS ((((int)METRIC_COUNT) + 7) / 8 * 8)
+
+typedef struct {
+    uint64_t values[METRICS_SHARD_WORDS];
+    int in_use;                     /* Claimed by a running thread */
+    char pad[64 - sizeof(int)];     /* Keep the next shard off this line */
+} metrics_shard_t;
+
+static metrics_shard_t shards[METRICS_MAX_SHARDS];
+
+/* Shared by threads that found no free shard (atomic updates) */
+static metrics_shard_t overflow_shard;
+
+/* Thread-specific data key: the calling thread's shard */
+static pthread_key_t shard_key;
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
+static int shard_key_valid = FALSE;
+
+static const metric_desc_t descriptors[METRIC_COUNT] = {
+    {"net_rx_frames", METRIC_TYPE_COUNTER,
+     "Wire frames received with a valid header and checksum"},
+    {"net_rx_bytes", METRIC_TYPE_COUNTER,
+     "Wire bytes (header and payload) of received frames"},
+    {"net_tx_frames", METRIC_TYPE_COUNTER,
+     "Wire frames sent"},
+    {"net_tx_bytes", METRIC_TYPE_COUNTER,
+     "Wire bytes (header and payload) of sent frames"},
+    {"net_checksum_failures", METRIC_TYPE_COUNTER,
+     "Received frames dropped on checksum mismatch"},
+    {"conn_accepted", METRIC_TYPE_COUNTER,
+     "Client connections accepted by the server"},
+    {"conn_active", METRIC_TYPE_GAUGE,
+     "Client connections currently open"},
+    {"conn_rate_limited", METRIC_TYPE_COUNTER,
+     "Client connections refused by the per-address rate limit"},
+    {"conn_out_throttled", METRIC_TYPE_COUNTER,
+     "Client reads paused because the client was not reading its replies"},
+    {"tls_handshakes", METRIC_TYPE_COUNTER,
+     "Server TLS handshakes completed"},
+    {"tls_handshake_failures", METRIC_TYPE_COUNTER,
+     "Server TLS handshakes failed"},
+    {"tls_handshake_microseconds", METRIC_TYPE_COUNTER,
+     "Accept-to-completion time summed over completed TLS handshakes"},
+    {"tls_handshake_queued", METRIC_TYPE_GAUGE,
+     "TLS handshake steps waiting for the handshake pool"},
+    {"usb_urbs_routed", METRIC_TYPE_COUNTER,
+     "URBs routed by the USB server"},
+    {"usb_routing_errors", METRIC_TYPE_COUNTER,
+     "URBs the USB server failed to route"},
+    {"usb_urb_timeouts", METRIC_TYPE_COUNTER,
+     "USB client URBs that expired without a response"},
+    {"usb_urb_unlinks", METRIC_TYPE_COUNTER,
+     "Timed-out USB client URBs cancelled before reaching the device"},
+    {"usb_send_queued", METRIC_TYPE_GAUGE,
+     "Frames waiting in USB send queues"},
+    {"usb_send_stalls", METRIC_TYPE_COUNTER,
+     "USB send queue pushes that waited for space"},
+    {"usb_descriptor_hits", METRIC_TYPE_COUNTER,
+     "USB descriptor reads the server answered from its cache"},
+    {"usb_batched_urbs", METRIC_TYPE_COUNTER,
+     "URBs the USB server received packed in batch frames"},
+    {"serial_rx_bytes", METRIC_TYPE_COUNTER,
+     "Bytes read from the serial port"},
+    {"serial_tx_bytes", METRIC_TYPE_COUNTER,
+     "Bytes written to the serial port"},
+    {"serial_line_errors", METRIC_TYPE_COUNTER,
+     "Serial frames flagged with parity, framing or overrun errors"},
+    {"mux_channels_open", METRIC_TYPE_GAUGE,
+     "Multiplexed channels open"},
+    {"mux_credit_stalls", METRIC_TYPE_COUNTER,
+     "Channel sends that waited for flow-control credit"},
+    {"mux_dropped", METRIC_TYPE_COUNTER,
+     "Channel frames dropped for lack of flow-control credit"},
+    {"compress_in_bytes", METRIC_TYPE_COUNTER,
+     "Payload bytes of frames sent compressed"},
+    {"compress_out_bytes", METRIC_TYPE_COUNTER,
+     "Compressed size of those payloads"},
+    {"compress_skipped", METRIC_TYPE_COUNTER,
+     "Frames sent uncompressed on a compressing connection"},
+    {"dgram_retransmits", METRIC_TYPE_COUNTER,
+     "Serial frames retransmitted on reliable datagram channels"},
+    {"dgram_dropped", METRIC_TYPE_COUNTER,
+     "Serial datagram frames dropped as stale, superseded or out of window"},
+    {"dgram_peers", METRIC_TYPE_GAUGE,
+     "Datagram associations the server holds"},
+    {"l2_rx_drops", METRIC_TYPE_COUNTER,
+     "Ethernet frames dropped by the kernel while the receive ring was full"},
+    {"l2_tx_drops", METRIC_TYPE_COUNTER,
+     "Ethernet frames not sent because the send ring was full"},
+    {"mem_used", METRIC_TYPE_GAUGE,
+     "Bytes of frame buffers charged to the memory budget"},
+    {"mem_throttled", METRIC_TYPE_COUNTER,
+     "Connections paused because the memory budget ran low"},
+    {"mem_refused", METRIC_TYPE_COUNTER,
+     "Frames refused because they would exceed the memory budget"},
+    {"capture_frames", METRIC_TYPE_COUNTER,
+     "Wire frames recorded to the capture file"},
+    {"capture_dropped", METRIC_TYPE_COUNTER,
+     "Wire frames not captured because the buffer or file was full"},
+    {"zerocopy_frames", METRIC_TYPE_COUNTER,
+     "Frames whose payload was sent with MSG_ZEROCOPY"},
+    {"zerocopy_copied", METRIC_TYPE_COUNTER,
+     "MSG_ZEROCOPY send calls the kernel completed by copying"},
+    {"raw_pairs", METRIC_TYPE_GAUGE,
+     "Raw passthrough connection pairs being relayed"},
+    {"raw_bytes", METRIC_TYPE_COUNTER,
+     "Bytes relayed between raw passthrough connections"},
+    {"pool_tasks", METRIC_TYPE_COUNTER,
+     "Tasks run by the shared work pool's threads"},
+    {"pool_steals", METRIC_TYPE_COUNTER,
+     "Work pool tasks taken from another thread's deque"}
+};
+
+/* ========================================================================
+ * Shard Ownership
+ * ======================================================================== */
+
+/**
+ * @brief Hand a shard back when its thread exits
+ *
+ * The values stay for the next owner, so totals never go backwards.
+ */
+static void shard_release(void* ptr)
+{
+    metrics_shard_t* shard = (metrics_shard_t*)ptr;
+
+    __atomic_store_n(&shard->in_use, FALSE, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Create the thread-specific data key (once per process)
+ */
+static void make_shard_key(void)
+{
+    shard_key_valid = (pthread_key_create(&shard_key, shard_release) == 0);
+}
+
+/**
+ * @brief Get the calling thread's shard, claiming a free one on first use
+ *
+ * @return Owned shard, or NULL when updates must go to overflow_shard
+ */
+static metrics_shard_t* get_shard(void)
+{
+    metrics_shard_t* shard;
+    int expected;
+    int i;
+
+    pthread_once(&shard_key_once, make_shard_key);
+    if (!shard_key_valid) {
+        return NULL;
+    }
+
+    shard = (metrics_shard_t*)pthread_getspecific(shard_key);
+    if (shard != NULL) {
+        return shard;
+    }
+
+    for (i = 0; i < METRICS_MAX_SHARDS; i++) {
+        expected = FALSE;
+        if (__atomic_compare_exchange_n(&shards[i].in_use, &expected, TRUE,
+                                        FALSE, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            if (pthread_setspecific(shard_key, &shards[i]) != 0) {
+                shard_release(&shards[i]);
+                return NULL;
+            }
+            return &shards[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+void metrics_add(metric_id_t id, uint64_t n)
+{
+    metrics_shard_t* shard;
+    uint64_t value;
+
+    if ((int)id < 0 || id >= METRIC_COUNT) {
+        return;
+    }
+
+    shard = get_shard();
+    if (shard == NULL) {
+        __atomic_fetch_add(&overflow_shard.values[id], n, __ATOMIC_RELAXED);
+        return;
+    }
+
+    /* Single writer: no read-modify-write atomic needed */
+    value = __atomic_load_n(&shard->values[id], __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->values[id], value + n, __ATOMIC_RELAXED);
+}
+
+void metrics_sub(metric_id_t id, uint64_t n)
+{
+    /* Unsigned wrap-around: the shard sum is still the exact level */
+    metrics_add(id, (uint64_t)0 - n);
+}
+
+void metrics_snapshot(metrics_snapshot_t* snapshot)
+{
+    int shard;
+    int i;
+
+    if (snapshot == NULL) {
+        return;
+    }
+
+    for (i = 0; i < (int)METRIC_COUNT; i++) {
+        snapshot->values[i] = __atomic_load_n(&overflow_shard.values[i],
+                                              __ATOMIC_RELAXED);
+    }
+    for (shard = 0; shard < METRICS_MAX_SHARDS; shard++) {
+        for (i = 0; i < (int)METRIC_COUNT; i++) {
+            snapshot->values[i] += __atomic_load_n(&shards[shard].values[i],
+                                                   __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int64_t metrics_gauge(const metrics_snapshot_t* snapshot, metric_id_t id)
+{
+    uint64_t value;
+
+    if (snapshot == NULL || (int)id < 0 || id >= METRIC_COUNT) {
+        return 0;
+    }
+
+    /* Two's-complement reinterpretation without implementation-defined casts */
+    value = snapshot->values[id];
+    if (value > (uint64_t)INT64_MAX) {
+        return -(int64_t)((uint64_t)0 - value);
+    }
+    return (int64_t)value;
+}
+
+const metric_desc_t* metrics_describe(metric_id_t id)
+{
+    if ((int)id < 0 || id >= METRIC_COUNT) {
+        return NULL;
+    }
+    return &descriptors[id];
+}
+
+int metrics_format_prometheus(const metrics_snapshot_t* snapshot,
+                              metric_id_t id, char* buffer, size_t size)
+{
+    const metric_desc_t* desc;
+    const char* type;
+    const char* suffix;
+    char sample[32];
+    int len;
+
+    desc = metrics_describe(id);
+    if (snapshot == NULL || desc == NULL || buffer == NULL || size == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (desc->type == METRIC_TYPE_GAUGE) {
+        type = "gauge";
+        suffix = "";
+        snprintf(sample, sizeof(sample), "%lld",
+                 (long long)metrics_gauge(snapshot, id));
+    } else {
+        type = "counter";
+        suffix = "_total";
+        snprintf(sample, sizeof(sample), "%llu",
+                 (unsigned long long)snapshot->values[id]);
+    }
+
+    len = snprintf(buffer, size,
+                   "# HELP xoe_%s%s %s\n"
+                   "# TYPE xoe_%s%s %s\n"
+                   "xoe_%s%s %s\n",
+                   desc->name, suffix, desc->help,
+                   desc->name, suffix, type,
+                   desc->name, suffix, sample);
+    if (len < 0 || (size_t)len >= size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+    return len;
+}
+
+uint64_t metrics_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file metrics.h
+ * @brief Process-wide runtime counters and gauges
+ *
+ * A fixed registry of counters (monotonic) and gauges (current level)
+ * updated from the data paths: wire frames and bytes, checksum failures,
+ * connections, TLS handshakes, USB routing and send queues, and the
+ * serial bridge. Each thread writes its own shard without locks or
+ * atomic read-modify-write; readers sum the shards, so a snapshot costs
+ * one pass over METRICS_MAX_SHARDS small arrays and never blocks writers.
+ *
+ * Shards are claimed on a thread's first update and handed back when it
+ * exits; the values stay in the shard for the next owner, so totals are
+ * exact and counters never go backwards. Threads beyond
+ * METRICS_MAX_SHARDS share one overflow shard updated atomically.
+ *
+ * Gauges are adjusted with metrics_add() / metrics_sub() from whichever
+ * thread sees the change; the sum over the shards is the level.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "lib/common/types.h"
+#include <stddef.h>
+
+/* Shards for concurrently running threads (more share the overflow shard) */
+#define METRICS_MAX_SHARDS 64
+
+/* Longest line produced by metrics_format_prometheus() for one metric */
+#define METRICS_FORMAT_MAX 320
+
+/**
+ * @brief Registered metrics
+ *
+ * Append new metrics before METRIC_COUNT and describe them in metrics.c.
+ */
+typedef enum {
+    /* Wire protocol (all transports) */
+    METRIC_NET_RX_FRAMES,           /* Frames received and validated */
+    METRIC_NET_RX_BYTES,            /* Wire bytes of received frames */
+    METRIC_NET_TX_FRAMES,           /* Frames sent */
+    METRIC_NET_TX_BYTES,            /* Wire bytes of sent frames */
+    METRIC_NET_CHECKSUM_FAILURES,   /* Frames dropped on CRC mismatch */
+
+    /* Server connections */
+    METRIC_CONN_ACCEPTED,           /* Connections handed to the event loop */
+    METRIC_CONN_ACTIVE,             /* Gauge: connections open now */
+    METRIC_CONN_RATE_LIMITED,       /* Accepts refused by the rate limiter */
+    METRIC_CONN_OUT_THROTTLED,      /* Reads paused: output backed up */
+
+    /* TLS handshakes (server side) */
+    METRIC_TLS_HANDSHAKES,          /* Completed handshakes */
+    METRIC_TLS_HANDSHAKE_FAILURES,  /* Failed handshakes */
+    METRIC_TLS_HANDSHAKE_US,        /* Accept-to-done time of completed ones */
+    METRIC_TLS_HANDSHAKE_QUEUED,    /* Gauge: steps waiting for the pool */
+
+    /* USB forwarding */
+    METRIC_USB_URBS_ROUTED,         /* URBs routed by the USB server */
+    METRIC_USB_ROUTING_ERRORS,      /* URBs the USB server could not route */
+    METRIC_USB_URB_TIMEOUTS,        /* Client URBs expired without response */
+    METRIC_USB_URB_UNLINKS,         /* Timed-out URBs the device side cancelled */
+    METRIC_USB_SEND_QUEUED,         /* Gauge: frames in USB send queues */
+    METRIC_USB_SEND_STALLS,         /* Pushes that waited on a full queue */
+    METRIC_USB_DESCRIPTOR_HITS,     /* Descriptor reads answered from cache */
+    METRIC_USB_BATCHED_URBS,        /* URBs received in USB_CMD_BATCH frames */
+
+    /* Serial bridge */
+    METRIC_SERIAL_RX_BYTES,         /* Bytes read from the serial port */
+    METRIC_SERIAL_TX_BYTES,         /* Bytes written to the serial port */
+    METRIC_SERIAL_LINE_ERRORS,      /* Frames flagged parity/framing/overrun */
+
+    /* Channel multiplexing */
+    METRIC_MUX_CHANNELS_OPEN,       /* Gauge: multiplexed channels open now */
+    METRIC_MUX_CREDIT_STALLS,       /* Sends that waited for peer credit */
+    METRIC_MUX_DROPPED,             /* Channel frames dropped without credit */
+
+    /* Frame compression */
+    METRIC_COMPRESS_IN_BYTES,       /* Payload bytes of compressed frames */
+    METRIC_COMPRESS_OUT_BYTES,      /* Their compressed size */
+    METRIC_COMPRESS_SKIPPED,        /* Frames a compressing sender left raw */
+
+    /* Serial over datagrams */
+    METRIC_DGRAM_RETRANSMITS,       /* Reliable frames sent again */
+    METRIC_DGRAM_DROPPED,           /* Stale or superseded frames dropped */
+    METRIC_DGRAM_PEERS,             /* Gauge: server datagram associations */
+
+    /* Layer-2 rings */
+    METRIC_L2_RX_DROPS,             /* Frames the kernel dropped: ring full */
+    METRIC_L2_TX_DROPS,             /* Frames not sent: send ring full */
+
+    /* Memory budget */
+    METRIC_MEM_USED,                /* Gauge: bytes charged to the budget */
+    METRIC_MEM_THROTTLED,           /* Reads paused to stay within budget */
+    METRIC_MEM_REFUSED,             /* Frames refused: over the budget */
+
+    /* Wire capture */
+    METRIC_CAPTURE_FRAMES,          /* Frames written to the capture file */
+    METRIC_CAPTURE_DROPPED,         /* Frames not captured: buffer or file full */
+
+    /* Zero-copy sends and raw passthrough */
+    METRIC_NET_ZEROCOPY_FRAMES,     /* Frames sent with MSG_ZEROCOPY */
+    METRIC_NET_ZEROCOPY_COPIED,     /* Of their send calls, ones the kernel
+                                       copied anyway */
+    METRIC_RAW_PAIRS,               /* Gauge: raw passthrough pairs relaying */
+    METRIC_RAW_BYTES,               /* Bytes relayed by raw passthrough */
+
+    /* Shared work pool (protocol pools) */
+    METRIC_POOL_TASKS,              /* Tasks run by pool threads */
+    METRIC_POOL_STEALS,             /* Tasks taken from another thread's deque */
+
+    METRIC_COUNT
+} metric_id_t;
+
+/**
+ * @brief Metric kinds
+ */
+typedef enum {
+    METRIC_TYPE_COUNTER,            /* Monotonic total */
+    METRIC_TYPE_GAUGE               /* Level that goes up and down */
+} metric_type_t;
+
+/**
+ * @brief Static description of a metric
+ */
+typedef struct {
+    const char* name;               /* snake_case, without prefix/suffix */
+    metric_type_t type;
+    const char* help;               /* One-line description */
+} metric_desc_t;
+
+/**
+ * @brief Point-in-time sum of every shard
+ *
+ * Gauges are stored two's-complement; read them with metrics_gauge().
+ */
+typedef struct {
+    uint64_t values[METRIC_COUNT];
+} metrics_snapshot_t;
+
+/**
+ * @brief Add to a counter or raise a gauge
+ *
+ * @param id    Metric (out-of-range ids are ignored)
+ * @param n     Amount
+ */
+void metrics_add(metric_id_t id, uint64_t n);
+
+/**
+ * @brief Lower a gauge
+ *
+ * @param id    Gauge metric (out-of-range ids are ignored)
+ * @param n     Amount
+ */
+void metrics_sub(metric_id_t id, uint64_t n);
+
+/**
+ * @brief Sum every shard into @p snapshot
+ *
+ * Values read while writers run are each up to date to within the
+ * updates in flight; no lock is taken.
+ *
+ * @param snapshot  Receives the totals
+ */
+void metrics_snapshot(metrics_snapshot_t* snapshot);
+
+/**
+ * @brief Signed level of a gauge in a snapshot
+ */
+int64_t metrics_gauge(const metrics_snapshot_t* snapshot, metric_id_t id);
+
+/**
+ * @brief Describe a metric
+ *
+ * @return Description, or NULL for an out-of-range id
+ */
+const metric_desc_t* metrics_describe(metric_id_t id);
+
+/**
+ * @brief Format one metric in the Prometheus text exposition format
+ *
+ * Writes the HELP and TYPE lines followed by the sample, named
+ * "xoe_<name>" with "_total" appended for counters.
+ *
+ * @param snapshot  Values to format
+ * @param id        Metric to format
+ * @param buffer    Output (NUL-terminated)
+ * @param size      Size of @p buffer (METRICS_FORMAT_MAX always suffices)
+ *
+ * @return Length written, E_INVALID_ARGUMENT, or E_BUFFER_TOO_SMALL
+ */
+int metrics_format_prometheus(const metrics_snapshot_t* snapshot,
+                              metric_id_t id, char* buffer, size_t size);
+
+/**
+ * @brief Monotonic clock in microseconds, for timing metrics
+ */
+uint64_t metrics_now_us(void);
+
+#endif /* METRICS_H */
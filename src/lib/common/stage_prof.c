@@ -0,0 +1,410 @@
+/**
+ * @file stage_prof.c
+ * @brief Per-thread stage counters and their reset and calibration
+ *
+ * Each slot carries the reset epoch it was last cleared for. A reset only
+ * bumps the global epoch; the owner clears its own cells on its next
+ * sample, and readers skip slots still tagged with an older epoch, so
+ * nothing but the owner ever writes a slot's cells. Ownership moves with
+ * acquire/release on in_use, as in metrics.c.
+ *
+ * TSC ticks are converted with a rate measured once, on the first
+ * `profile on`, against CLOCK_MONOTONIC over STAGE_PROF_CALIBRATE_NS.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "stage_prof.h"
+#include "lib/common/definitions.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+static const stage_desc_t descriptors[STAGE_COUNT] = {
+    {"recv_syscall",
+     "Transport read: recv, SSL_read or shared-memory ring"},
+    {"checksum",
+     "Frame CRC32 over header and payload, sent or received"},
+    {"decapsulate",
+     "URB header and data parsed out of a frame"},
+    {"route_lookup",
+     "USB server lookup of the client that owns a device"},
+    {"send_lock_wait",
+     "Wait to own a connection's sender (USB batch or send queue)"},
+    {"send_syscall",
+     "Transport write: sendmsg, SSL_write or shared-memory ring"},
+    {"usb_submit",
+     "libusb_submit_transfer() call"},
+    {"usb_complete",
+     "libusb transfer completion callback"}
+};
+
+const stage_desc_t* stage_prof_describe(stage_id_t id)
+{
+    if ((int)id < 0 || id >= STAGE_COUNT) {
+        return NULL;
+    }
+    return &descriptors[id];
+}
+
+#if XOE_STAGE_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STAGE_PROF_TSC 1
+#else
+#define STAGE_PROF_TSC 0
+#endif
+
+/* Interval the TSC rate is measured over */
+#define STAGE_PROF_CALIBRATE_NS 5000000ULL
+
+typedef struct {
+    uint64_t count;
+    uint64_t ticks;
+    uint64_t max;
+} stage_cell_t;
+
+typedef struct {
+    stage_cell_t cells[STAGE_COUNT];
+    int in_use;                     /* Claimed by a running thread */
+    int epoch;                      /* Reset the cells were cleared for */
+    char pad[64 - 2 * sizeof(int)]; /* Keep the next slot off this line */
+} stage_slot_t;
+
+int g_stage_prof_on = FALSE;
+
+static stage_slot_t slots[STAGE_PROF_MAX_SLOTS];
+
+/* Shared by threads that found no free slot (atomic updates) */
+static stage_slot_t overflow_slot;
+
+/* Bumped by every reset; slots tagged with an older one count as empty */
+static int current_epoch = 1;
+
+/* Thread-specific data key: the calling thread's slot */
+static pthread_key_t slot_key;
+static pthread_once_t slot_key_once = PTHREAD_ONCE_INIT;
+static int slot_key_valid = FALSE;
+
+/* Serializes enable and snapshot (never taken by writers) */
+static pthread_mutex_t control_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t started_ns;         /* Monotonic time of the last reset */
+static uint64_t stopped_ns;         /* Monotonic time profiling went off */
+static double ticks_per_ns;         /* 0 until calibrated */
+
+/* ========================================================================
+ * Clocks
+ * ======================================================================== */
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t stage_prof_now(void)
+{
+#if STAGE_PROF_TSC
+    uint32_t lo;
+    uint32_t hi;
+
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return (((uint64_t)hi << 32) | lo) | 1;
+#else
+    return monotonic_ns() | 1;
+#endif
+}
+
+const char* stage_prof_clock(void)
+{
+    return STAGE_PROF_TSC ? "tsc" : "monotonic";
+}
+
+/**
+ * @brief Measure profiler ticks per nanosecond (once; control_lock held)
+ */
+static void calibrate(void)
+{
+    uint64_t ns0;
+    uint64_t ns1;
+    uint64_t t0;
+    uint64_t t1;
+
+    if (ticks_per_ns > 0.0) {
+        return;
+    }
+    if (!STAGE_PROF_TSC) {
+        ticks_per_ns = 1.0;
+        return;
+    }
+
+    ns0 = monotonic_ns();
+    t0 = stage_prof_now();
+    do {
+        ns1 = monotonic_ns();
+    } while (ns1 - ns0 < STAGE_PROF_CALIBRATE_NS);
+    t1 = stage_prof_now();
+
+    ticks_per_ns = (double)(t1 - t0) / (double)(ns1 - ns0);
+    if (ticks_per_ns <= 0.0) {
+        ticks_per_ns = 1.0;
+    }
+}
+
+/* ========================================================================
+ * Slot Ownership
+ * ======================================================================== */
+
+/**
+ * @brief Hand a slot back when its thread exits (its cells stay)
+ */
+static void slot_release(void* ptr)
+{
+    stage_slot_t* slot = (stage_slot_t*)ptr;
+
+    __atomic_store_n(&slot->in_use, FALSE, __ATOMIC_RELEASE);
+}
+
+static void make_slot_key(void)
+{
+    slot_key_valid = (pthread_key_create(&slot_key, slot_release) == 0);
+}
+
+/**
+ * @brief Get the calling thread's slot, claiming a free one on first use
+ *
+ * @return Owned slot, or NULL when samples must go to overflow_slot
+ */
+static stage_slot_t* get_slot(void)
+{
+    stage_slot_t* slot;
+    int expected;
+    int i;
+
+    pthread_once(&slot_key_once, make_slot_key);
+    if (!slot_key_valid) {
+        return NULL;
+    }
+
+    slot = (stage_slot_t*)pthread_getspecific(slot_key);
+    if (slot != NULL) {
+        return slot;
+    }
+
+    for (i = 0; i < STAGE_PROF_MAX_SLOTS; i++) {
+        expected = FALSE;
+        if (__atomic_compare_exchange_n(&slots[i].in_use, &expected, TRUE,
+                                        FALSE, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED)) {
+            if (pthread_setspecific(slot_key, &slots[i]) != 0) {
+                slot_release(&slots[i]);
+                return NULL;
+            }
+            return &slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Clear an owned slot left over from an earlier reset
+ */
+static void slot_sync_epoch(stage_slot_t* slot)
+{
+    int epoch = __atomic_load_n(&current_epoch, __ATOMIC_RELAXED);
+    int i;
+
+    if (slot->epoch == epoch) {
+        return;
+    }
+    for (i = 0; i < (int)STAGE_COUNT; i++) {
+        __atomic_store_n(&slot->cells[i].count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->cells[i].ticks, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&slot->cells[i].max, 0, __ATOMIC_RELAXED);
+    }
+    /* Readers that see the new epoch see the cleared cells */
+    __atomic_store_n(&slot->epoch, epoch, __ATOMIC_RELEASE);
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+void stage_prof_record(stage_id_t id, uint64_t start)
+{
+    stage_slot_t* slot;
+    stage_cell_t* cell;
+    uint64_t now = stage_prof_now();
+    uint64_t ticks = (now > start) ? now - start : 0;
+    uint64_t max;
+
+    if ((int)id < 0 || id >= STAGE_COUNT) {
+        return;
+    }
+
+    slot = get_slot();
+    if (slot == NULL) {
+        cell = &overflow_slot.cells[id];
+        __atomic_fetch_add(&cell->count, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&cell->ticks, ticks, __ATOMIC_RELAXED);
+        max = __atomic_load_n(&cell->max, __ATOMIC_RELAXED);
+        while (ticks > max &&
+               !__atomic_compare_exchange_n(&cell->max, &max, ticks, TRUE,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+            /* max reloaded by the failed exchange */
+        }
+        return;
+    }
+
+    slot_sync_epoch(slot);
+    cell = &slot->cells[id];
+
+    /* Single writer: no read-modify-write atomic needed */
+    __atomic_store_n(&cell->count,
+                     __atomic_load_n(&cell->count, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&cell->ticks,
+                     __atomic_load_n(&cell->ticks, __ATOMIC_RELAXED) + ticks,
+                     __ATOMIC_RELAXED);
+    if (ticks > __atomic_load_n(&cell->max, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&cell->max, ticks, __ATOMIC_RELAXED);
+    }
+}
+
+int stage_prof_enable(int on)
+{
+    int i;
+
+    pthread_mutex_lock(&control_lock);
+    if (on) {
+        calibrate();
+        if (!__atomic_load_n(&g_stage_prof_on, __ATOMIC_RELAXED)) {
+            /* Owned slots clear themselves; the overflow slot is shared */
+            __atomic_add_fetch(&current_epoch, 1, __ATOMIC_RELEASE);
+            for (i = 0; i < (int)STAGE_COUNT; i++) {
+                __atomic_store_n(&overflow_slot.cells[i].count, 0,
+                                 __ATOMIC_RELAXED);
+                __atomic_store_n(&overflow_slot.cells[i].ticks, 0,
+                                 __ATOMIC_RELAXED);
+                __atomic_store_n(&overflow_slot.cells[i].max, 0,
+                                 __ATOMIC_RELAXED);
+            }
+            started_ns = monotonic_ns();
+        }
+    } else if (__atomic_load_n(&g_stage_prof_on, __ATOMIC_RELAXED)) {
+        stopped_ns = monotonic_ns();
+    }
+    __atomic_store_n(&g_stage_prof_on, on ? TRUE : FALSE, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&control_lock);
+
+    return 0;
+}
+
+int stage_prof_running(void)
+{
+    return __atomic_load_n(&g_stage_prof_on, __ATOMIC_RELAXED);
+}
+
+void stage_prof_snapshot(stage_prof_snapshot_t* snapshot)
+{
+    uint64_t ticks[STAGE_COUNT];
+    uint64_t max[STAGE_COUNT];
+    const stage_slot_t* slot;
+    uint64_t count;
+    uint64_t value;
+    int epoch;
+    int s;
+    int i;
+
+    if (snapshot == NULL) {
+        return;
+    }
+    memset(snapshot, 0, sizeof(*snapshot));
+    memset(ticks, 0, sizeof(ticks));
+    memset(max, 0, sizeof(max));
+
+    pthread_mutex_lock(&control_lock);
+    if (ticks_per_ns <= 0.0) {
+        /* Never switched on: nothing recorded */
+        pthread_mutex_unlock(&control_lock);
+        return;
+    }
+
+    epoch = __atomic_load_n(&current_epoch, __ATOMIC_RELAXED);
+    for (s = -1; s < STAGE_PROF_MAX_SLOTS; s++) {
+        slot = (s < 0) ? &overflow_slot : &slots[s];
+        if (s >= 0 &&
+            __atomic_load_n(&slot->epoch, __ATOMIC_ACQUIRE) != epoch) {
+            continue;
+        }
+        for (i = 0; i < (int)STAGE_COUNT; i++) {
+            count = __atomic_load_n(&slot->cells[i].count, __ATOMIC_RELAXED);
+            if (count == 0) {
+                continue;
+            }
+            snapshot->stages[i].count += count;
+            snapshot->stages[i].threads++;
+            ticks[i] += __atomic_load_n(&slot->cells[i].ticks,
+                                        __ATOMIC_RELAXED);
+            value = __atomic_load_n(&slot->cells[i].max, __ATOMIC_RELAXED);
+            if (value > max[i]) {
+                max[i] = value;
+            }
+        }
+    }
+
+    for (i = 0; i < (int)STAGE_COUNT; i++) {
+        snapshot->stages[i].sum_ns = (uint64_t)((double)ticks[i] /
+                                                ticks_per_ns);
+        snapshot->stages[i].max_ns = (uint64_t)((double)max[i] /
+                                                ticks_per_ns);
+    }
+
+    snapshot->running = __atomic_load_n(&g_stage_prof_on, __ATOMIC_RELAXED);
+    snapshot->elapsed_ns = (snapshot->running ? monotonic_ns() : stopped_ns) -
+                           started_ns;
+    pthread_mutex_unlock(&control_lock);
+}
+
+#else /* !XOE_STAGE_PROFILE */
+
+int stage_prof_enable(int on)
+{
+    (void)on;
+    return E_NOT_SUPPORTED;
+}
+
+int stage_prof_running(void)
+{
+    return FALSE;
+}
+
+uint64_t stage_prof_now(void)
+{
+    return 1;
+}
+
+void stage_prof_record(stage_id_t id, uint64_t start)
+{
+    (void)id;
+    (void)start;
+}
+
+void stage_prof_snapshot(stage_prof_snapshot_t* snapshot)
+{
+    if (snapshot != NULL) {
+        memset(snapshot, 0, sizeof(*snapshot));
+    }
+}
+
+const char* stage_prof_clock(void)
+{
+    return "none";
+}
+
+#endif /* XOE_STAGE_PROFILE */
@@ -0,0 +1,176 @@
+/**
+ * @file stage_prof.h
+ * @brief Cycle-level profiler for the hot stages of the data path
+ *
+ * Brackets the stages a frame or URB passes through on its way across the
+ * bridge: the receive syscall, checksum, URB decapsulation, route lookup,
+ * waiting for the send lock, the send syscall, and libusb submit and
+ * completion handling. For each it keeps the number of samples, their
+ * sum and the largest one, so the console can say where the time goes
+ * without an external profiler attached.
+ *
+ * Built in by default (XOE_STAGE_PROFILE, off in the small-footprint
+ * profile); with XOE_STAGE_PROFILE set to 0 the macros below compile to
+ * nothing. Built in, it starts switched off and costs one relaxed load
+ * per stage until `profile on` is given on the management console.
+ *
+ * Timestamps come from the TSC on x86 (rdtsc, assumed to tick at a
+ * constant rate as on every CPU with constant_tsc) and from
+ * CLOCK_MONOTONIC elsewhere; they are converted to nanoseconds only when
+ * a snapshot is taken.
+ *
+ * Samples are summed per thread, like metrics.h: each thread owns a
+ * cache-line padded slot, claimed on its first sample, that only it
+ * writes. Threads beyond STAGE_PROF_MAX_SLOTS share one slot updated
+ * atomically.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef STAGE_PROF_H
+#define STAGE_PROF_H
+
+#include "lib/common/types.h"
+
+#ifndef XOE_STAGE_PROFILE
+#if XOE_SMALL_FOOTPRINT
+#define XOE_STAGE_PROFILE 0
+#else
+#define XOE_STAGE_PROFILE 1
+#endif
+#endif
+
+/* Slots for concurrently running threads (more share the overflow slot) */
+#define STAGE_PROF_MAX_SLOTS 64
+
+/**
+ * @brief Profiled stages
+ *
+ * Append new stages before STAGE_COUNT and describe them in stage_prof.c.
+ */
+typedef enum {
+    STAGE_RECV_SYSCALL,             /* Transport read (recv, SSL_read, ring) */
+    STAGE_CHECKSUM,                 /* Frame CRC, sent or received */
+    STAGE_DECAPSULATE,              /* URB header and data out of a frame */
+    STAGE_ROUTE_LOOKUP,             /* USB server device-to-client lookup */
+    STAGE_SEND_LOCK_WAIT,           /* Waiting to own a connection's sender */
+    STAGE_SEND_SYSCALL,             /* Transport write (sendmsg, SSL_write) */
+    STAGE_USB_SUBMIT,               /* libusb_submit_transfer() */
+    STAGE_USB_COMPLETE,             /* libusb transfer completion callback */
+
+    STAGE_COUNT
+} stage_id_t;
+
+/**
+ * @brief Static description of a stage
+ */
+typedef struct {
+    const char* name;               /* snake_case */
+    const char* help;               /* One-line description */
+} stage_desc_t;
+
+/**
+ * @brief Totals of one stage over all threads
+ */
+typedef struct {
+    uint64_t count;                 /* Samples */
+    uint64_t sum_ns;                /* Sum of samples */
+    uint64_t max_ns;                /* Largest sample */
+    int threads;                    /* Threads that recorded a sample */
+} stage_totals_t;
+
+/**
+ * @brief Point-in-time copy of every stage
+ */
+typedef struct {
+    int running;                    /* Profiling switched on */
+    uint64_t elapsed_ns;            /* Time profiled since the last reset */
+    stage_totals_t stages[STAGE_COUNT];
+} stage_prof_snapshot_t;
+
+#if XOE_STAGE_PROFILE
+
+/* Nonzero while profiling is switched on (read by the macros only) */
+extern int g_stage_prof_on;
+
+/*
+ * Bracket a stage:
+ *
+ *     STAGE_PROF_VAR(t0);
+ *     ...
+ *     STAGE_PROF_START(t0);
+ *     result = sendmsg(...);
+ *     STAGE_PROF_STOP(STAGE_SEND_SYSCALL, t0);
+ *
+ * A start taken while profiling is off records nothing at the stop.
+ */
+#define STAGE_PROF_VAR(name) uint64_t name
+#define STAGE_PROF_START(name) \
+    ((name) = __atomic_load_n(&g_stage_prof_on, __ATOMIC_RELAXED) ? \
+              stage_prof_now() : 0)
+#define STAGE_PROF_STOP(id, name) \
+    do { \
+        if ((name) != 0) { \
+            stage_prof_record((id), (name)); \
+        } \
+    } while (0)
+
+#else
+
+#define STAGE_PROF_VAR(name)
+#define STAGE_PROF_START(name) ((void)0)
+#define STAGE_PROF_STOP(id, name) ((void)0)
+
+#endif /* XOE_STAGE_PROFILE */
+
+/**
+ * @brief Switch profiling on or off
+ *
+ * Switching on from off clears every total and restarts the elapsed
+ * time; switching off keeps them for stage_prof_snapshot(). The first
+ * switch on spends a few milliseconds measuring the TSC rate.
+ *
+ * @return 0, or E_NOT_SUPPORTED when built without XOE_STAGE_PROFILE
+ */
+int stage_prof_enable(int on);
+
+/**
+ * @brief Whether profiling is switched on
+ */
+int stage_prof_running(void);
+
+/**
+ * @brief Timestamp in profiler ticks (TSC cycles or nanoseconds)
+ *
+ * Never 0, so the macros can use 0 for "not started".
+ */
+uint64_t stage_prof_now(void);
+
+/**
+ * @brief Record the ticks elapsed since @p start on the calling thread
+ *
+ * @param id     Stage (out-of-range ids are ignored)
+ * @param start  Earlier stage_prof_now() reading
+ */
+void stage_prof_record(stage_id_t id, uint64_t start);
+
+/**
+ * @brief Sum every thread's samples into @p snapshot
+ *
+ * Never blocks writers; samples in flight may be missing.
+ */
+void stage_prof_snapshot(stage_prof_snapshot_t* snapshot);
+
+/**
+ * @brief Describe a stage
+ *
+ * @return Description, or NULL for an out-of-range id
+ */
+const stage_desc_t* stage_prof_describe(stage_id_t id);
+
+/**
+ * @brief Name of the clock behind the timestamps ("tsc" or "monotonic")
+ */
+const char* stage_prof_clock(void);
+
+#endif /* STAGE_PROF_H */
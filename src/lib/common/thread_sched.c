@@ -0,0 +1,540 @@
+/**
+ * @file thread_sched.c
+ * @brief CPU affinity and real-time scheduling per class of thread
+ *
+ * One mutex guards the settings and the registry of running threads.
+ * Settings are applied to another thread only while holding it, and a
+ * thread leaves the registry under the same mutex before it exits, so a
+ * registered pthread_t always names a live thread.
+ *
+ * [LLM-ARCH]
+ */
+
+/* pthread_setaffinity_np() and cpu_set_t */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "thread_sched.h"
+#include "lib/common/definitions.h"
+#include "lib/common/log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+typedef struct {
+    pthread_t thread;
+    thread_class_t cls;
+    int used;
+} registered_t;
+
+typedef struct {
+    thread_class_t cls;
+    void* (*func)(void*);
+    void* arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int ready;                      /* Settings applied, start_t released */
+} start_t;
+
+static const char* const class_names[THREAD_CLASS_COUNT] = {
+    "serial", "usb", "net"
+};
+
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+static thread_sched_t settings;                 /* Process settings */
+static registered_t registry[THREAD_SCHED_MAX_THREADS];
+static int memory_locked = FALSE;
+static int warned[THREAD_CLASS_COUNT];
+static size_t stack_size = XOE_THREAD_STACK_SIZE;
+
+#if defined(__linux__)
+static cpu_set_t process_cpus;                  /* CPUs at the first set */
+static int have_process_cpus = FALSE;
+#endif
+
+/**
+ * parse_number - Parse a whole decimal number within [min, max]
+ */
+static int parse_number(const char* text, long min, long max, long* value) {
+    char* end;
+
+    if (*text < '0' || *text > '9') {
+        return E_INVALID_ARGUMENT;
+    }
+    errno = 0;
+    *value = strtol(text, &end, 10);
+    if (errno != 0 || *end != '\0' || *value < min || *value > max) {
+        return E_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+int thread_sched_parse_cpus(const char* list, int* cpus, int max, int* count) {
+    char item[32];
+    const char* end;
+    char* dash;
+    long first;
+    long last;
+    long cpu;
+    size_t len;
+    int found = 0;
+
+    if (list == NULL || cpus == NULL || count == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    while (*list != '\0') {
+        end = strchr(list, ',');
+        len = (end != NULL) ? (size_t)(end - list) : strlen(list);
+        if (len == 0 || len >= sizeof(item)) {
+            return E_INVALID_ARGUMENT;
+        }
+        memcpy(item, list, len);
+        item[len] = '\0';
+
+        dash = strchr(item, '-');
+        if (dash != NULL) {
+            *dash = '\0';
+            if (parse_number(item, 0, THREAD_SCHED_MAX_CPU, &first) != 0 ||
+                parse_number(dash + 1, first, THREAD_SCHED_MAX_CPU,
+                             &last) != 0) {
+                return E_INVALID_ARGUMENT;
+            }
+        } else {
+            if (parse_number(item, 0, THREAD_SCHED_MAX_CPU, &first) != 0) {
+                return E_INVALID_ARGUMENT;
+            }
+            last = first;
+        }
+
+        for (cpu = first; cpu <= last; cpu++) {
+            if (found >= max) {
+                return E_INVALID_ARGUMENT;
+            }
+            cpus[found++] = (int)cpu;
+        }
+
+        list += len;
+        if (*list == ',') {
+            list++;
+            if (*list == '\0') {
+                return E_INVALID_ARGUMENT;
+            }
+        }
+    }
+
+    if (found == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    *count = found;
+    return 0;
+}
+
+int thread_sched_parse(const char* spec, thread_class_t* cls,
+                       thread_sched_class_t* entry) {
+    char text[THREAD_SCHED_FORMAT_MAX];
+    char* fields[4];
+    char* colon;
+    int nfields = 0;
+    int i;
+    long prio;
+
+    if (spec == NULL || cls == NULL || entry == NULL ||
+        strlen(spec) >= sizeof(text)) {
+        return E_INVALID_ARGUMENT;
+    }
+    strcpy(text, spec);
+
+    fields[nfields++] = text;
+    while ((colon = strchr(fields[nfields - 1], ':')) != NULL) {
+        if (nfields == 4) {
+            return E_INVALID_ARGUMENT;
+        }
+        *colon = '\0';
+        fields[nfields++] = colon + 1;
+    }
+    if (nfields < 2) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i < THREAD_CLASS_COUNT; i++) {
+        if (strcmp(fields[0], class_names[i]) == 0) {
+            break;
+        }
+    }
+    if (i == THREAD_CLASS_COUNT) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(entry, 0, sizeof(*entry));
+    if (strcmp(fields[1], "any") != 0 && fields[1][0] != '\0' &&
+        thread_sched_parse_cpus(fields[1], entry->cpus, THREAD_SCHED_MAX_CPUS,
+                                &entry->cpu_count) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (nfields >= 3) {
+        if (strcmp(fields[2], "fifo") == 0) {
+            entry->policy = THREAD_POLICY_FIFO;
+        } else if (strcmp(fields[2], "rr") == 0) {
+            entry->policy = THREAD_POLICY_RR;
+        } else if (strcmp(fields[2], "default") != 0) {
+            return E_INVALID_ARGUMENT;
+        }
+    }
+    if (entry->policy != THREAD_POLICY_DEFAULT) {
+        entry->priority = THREAD_SCHED_DEFAULT_PRIO;
+        if (nfields == 4) {
+            if (parse_number(fields[3], THREAD_SCHED_MIN_PRIO,
+                             THREAD_SCHED_MAX_PRIO, &prio) != 0) {
+                return E_INVALID_ARGUMENT;
+            }
+            entry->priority = (int)prio;
+        }
+    } else if (nfields == 4) {
+        return E_INVALID_ARGUMENT;      /* No priority without a policy */
+    }
+
+    *cls = (thread_class_t)i;
+    return 0;
+}
+
+const char* thread_sched_class_name(thread_class_t cls) {
+    if ((int)cls < 0 || cls >= THREAD_CLASS_COUNT) {
+        return "unknown";
+    }
+    return class_names[cls];
+}
+
+void thread_sched_format(const thread_sched_t* sched, char* buf, size_t size) {
+    size_t used = 0;
+    int i;
+    int j;
+
+    if (buf == NULL || size == 0) {
+        return;
+    }
+    buf[0] = '\0';
+    if (sched == NULL) {
+        snprintf(buf, size, "default");
+        return;
+    }
+
+    for (i = 0; i < THREAD_CLASS_COUNT && used < size; i++) {
+        const thread_sched_class_t* entry = &sched->classes[i];
+
+        if (entry->cpu_count == 0 && entry->policy == THREAD_POLICY_DEFAULT) {
+            continue;
+        }
+        used += (size_t)snprintf(buf + used, size - used, "%s%s",
+                                 (used > 0) ? ", " : "", class_names[i]);
+        for (j = 0; j < entry->cpu_count && used < size; j++) {
+            used += (size_t)snprintf(buf + used, size - used, "%s%d",
+                                     (j == 0) ? " cpus " : ",",
+                                     entry->cpus[j]);
+        }
+        if (entry->policy != THREAD_POLICY_DEFAULT && used < size) {
+            used += (size_t)snprintf(buf + used, size - used, " %s/%d",
+                                     (entry->policy == THREAD_POLICY_FIFO)
+                                     ? "fifo" : "rr", entry->priority);
+        }
+    }
+    if (buf[0] == '\0') {
+        snprintf(buf, size, "default");
+    }
+}
+
+/**
+ * apply_class - Apply class settings to one thread
+ * @thread:   Thread (live: caller holds sched_mutex or is the thread)
+ * @entry:    Settings
+ * @starting: The thread is new, so defaults are left as inherited
+ *
+ * Returns: 0, E_PERMISSION_DENIED, E_INVALID_ARGUMENT or E_NOT_SUPPORTED
+ */
+static int apply_class(pthread_t thread, const thread_sched_class_t* entry,
+                       int starting) {
+#if defined(__linux__)
+    struct sched_param param;
+    cpu_set_t set;
+    int policy;
+    int result = 0;
+    int status;
+    int i;
+
+    if (entry->cpu_count > 0) {
+        CPU_ZERO(&set);
+        for (i = 0; i < entry->cpu_count; i++) {
+            if (entry->cpus[i] < CPU_SETSIZE) {
+                CPU_SET(entry->cpus[i], &set);
+            }
+        }
+        if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+            result = E_INVALID_ARGUMENT;     /* No usable CPU in the set */
+        }
+    } else if (!starting && have_process_cpus) {
+        (void)pthread_setaffinity_np(thread, sizeof(process_cpus),
+                                     &process_cpus);
+    }
+
+    if (starting && entry->policy == THREAD_POLICY_DEFAULT) {
+        return result;
+    }
+    memset(&param, 0, sizeof(param));
+    switch (entry->policy) {
+    case THREAD_POLICY_FIFO:
+        policy = SCHED_FIFO;
+        param.sched_priority = entry->priority;
+        break;
+    case THREAD_POLICY_RR:
+        policy = SCHED_RR;
+        param.sched_priority = entry->priority;
+        break;
+    default:
+        policy = SCHED_OTHER;
+        break;
+    }
+    status = pthread_setschedparam(thread, policy, &param);
+    if (status != 0 && result == 0) {
+        result = (status == EPERM) ? E_PERMISSION_DENIED : E_INVALID_ARGUMENT;
+    }
+    return result;
+#else
+    (void)thread;
+    (void)starting;
+    if (entry->cpu_count == 0 && entry->policy == THREAD_POLICY_DEFAULT) {
+        return 0;
+    }
+    return E_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * warn_once - Log the first failure to apply a class's settings
+ */
+static void warn_once(thread_class_t cls, int result) {
+    if (result == 0 || warned[cls]) {
+        return;
+    }
+    warned[cls] = TRUE;
+    LOG_WARN("Could not apply %s thread scheduling: %s", class_names[cls],
+             (result == E_PERMISSION_DENIED)
+             ? "real-time policies need CAP_SYS_NICE"
+             : (result == E_NOT_SUPPORTED)
+             ? "not supported on this platform"
+             : "no usable CPU in the set");
+}
+
+static int uses_realtime(const thread_sched_t* sched) {
+    int i;
+
+    for (i = 0; i < THREAD_CLASS_COUNT; i++) {
+        if (sched->classes[i].policy != THREAD_POLICY_DEFAULT) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+int thread_sched_set(const thread_sched_t* sched) {
+    int changed[THREAD_CLASS_COUNT];
+    int result = 0;
+    int status;
+    int i;
+
+    if (sched == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&sched_mutex);
+#if defined(__linux__)
+    if (!have_process_cpus &&
+        sched_getaffinity(0, sizeof(process_cpus), &process_cpus) == 0) {
+        have_process_cpus = TRUE;
+    }
+#endif
+    for (i = 0; i < THREAD_CLASS_COUNT; i++) {
+        changed[i] = memcmp(&settings.classes[i], &sched->classes[i],
+                            sizeof(settings.classes[i])) != 0;
+        if (changed[i]) {
+            warned[i] = FALSE;
+        }
+    }
+    settings = *sched;
+
+    /* Lock memory before the first thread turns real-time */
+    if (uses_realtime(&settings) && !memory_locked) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            memory_locked = TRUE;
+        } else {
+            result = E_PERMISSION_DENIED;
+        }
+    } else if (!uses_realtime(&settings) && memory_locked) {
+        (void)munlockall();
+        memory_locked = FALSE;
+    }
+
+    for (i = 0; i < THREAD_SCHED_MAX_THREADS; i++) {
+        if (registry[i].used && changed[registry[i].cls]) {
+            status = apply_class(registry[i].thread,
+                                 &settings.classes[registry[i].cls], FALSE);
+            if (status != 0 && result == 0) {
+                result = status;
+            }
+        }
+    }
+    pthread_mutex_unlock(&sched_mutex);
+
+    return result;
+}
+
+void thread_sched_get(thread_sched_t* sched) {
+    if (sched == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&sched_mutex);
+    *sched = settings;
+    pthread_mutex_unlock(&sched_mutex);
+}
+
+/**
+ * enter_class - Register the calling thread in @cls and apply its settings
+ */
+static int enter_class(thread_class_t cls) {
+    int result;
+    int i;
+
+    pthread_mutex_lock(&sched_mutex);
+    for (i = 0; i < THREAD_SCHED_MAX_THREADS; i++) {
+        if (!registry[i].used) {
+            registry[i].thread = pthread_self();
+            registry[i].cls = cls;
+            registry[i].used = TRUE;
+            break;
+        }
+    }
+    result = apply_class(pthread_self(), &settings.classes[cls], TRUE);
+    warn_once(cls, result);
+    pthread_mutex_unlock(&sched_mutex);
+
+    return result;
+}
+
+/**
+ * leave_class - Unregister the calling thread (its settings stay)
+ */
+static void leave_class(void) {
+    pthread_t self = pthread_self();
+    int i;
+
+    pthread_mutex_lock(&sched_mutex);
+    for (i = 0; i < THREAD_SCHED_MAX_THREADS; i++) {
+        if (registry[i].used && pthread_equal(registry[i].thread, self)) {
+            registry[i].used = FALSE;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&sched_mutex);
+}
+
+/**
+ * start_thread - Trampoline of thread_sched_create()
+ */
+static void* start_thread(void* arg) {
+    start_t* start = (start_t*)arg;
+    void* (*func)(void*) = start->func;
+    void* func_arg = start->arg;
+    thread_class_t cls = start->cls;
+    void* result;
+
+    if (cls != THREAD_CLASS_NONE) {
+        (void)enter_class(cls);
+    }
+
+    /* The creator returns (and its start_t goes away) after this */
+    pthread_mutex_lock(&start->lock);
+    start->ready = TRUE;
+    pthread_cond_signal(&start->cond);
+    pthread_mutex_unlock(&start->lock);
+
+    result = func(func_arg);
+    if (cls != THREAD_CLASS_NONE) {
+        leave_class();
+    }
+    return result;
+}
+
+int thread_sched_create(pthread_t* thread, thread_class_t cls,
+                        void* (*func)(void*), void* arg) {
+    pthread_attr_t attr;
+    size_t stack;
+    start_t start;
+    int result;
+
+    if (thread == NULL || func == NULL ||
+        (int)cls < THREAD_CLASS_NONE || cls >= THREAD_CLASS_COUNT) {
+        return EINVAL;
+    }
+
+    result = pthread_attr_init(&attr);
+    if (result != 0) {
+        return result;
+    }
+    stack = thread_sched_stack_size();
+    if (stack > 0) {
+#ifdef PTHREAD_STACK_MIN
+        if (stack < (size_t)PTHREAD_STACK_MIN) {
+            stack = (size_t)PTHREAD_STACK_MIN;
+        }
+#endif
+        result = pthread_attr_setstacksize(&attr, stack);
+        if (result != 0) {
+            pthread_attr_destroy(&attr);
+            return result;
+        }
+    }
+
+    start.cls = cls;
+    start.func = func;
+    start.arg = arg;
+    start.ready = FALSE;
+    pthread_mutex_init(&start.lock, NULL);
+    pthread_cond_init(&start.cond, NULL);
+
+    result = pthread_create(thread, &attr, start_thread, &start);
+    pthread_attr_destroy(&attr);
+    if (result == 0) {
+        pthread_mutex_lock(&start.lock);
+        while (!start.ready) {
+            pthread_cond_wait(&start.cond, &start.lock);
+        }
+        pthread_mutex_unlock(&start.lock);
+    }
+
+    pthread_cond_destroy(&start.cond);
+    pthread_mutex_destroy(&start.lock);
+    return result;
+}
+
+void thread_sched_set_stack_size(size_t bytes) {
+    __atomic_store_n(&stack_size, bytes, __ATOMIC_RELAXED);
+}
+
+size_t thread_sched_stack_size(void) {
+    return __atomic_load_n(&stack_size, __ATOMIC_RELAXED);
+}
+
+int thread_sched_memory_locked(void) {
+    int locked;
+
+    pthread_mutex_lock(&sched_mutex);
+    locked = memory_locked;
+    pthread_mutex_unlock(&sched_mutex);
+    return locked;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file thread_sched.h
+ * @brief CPU affinity and real-time scheduling per class of thread
+ *
+ * Threads on the data path are grouped into classes, and each class can be
+ * restricted to a CPU set and run under SCHED_FIFO or SCHED_RR at a fixed
+ * priority, so other work on a shared machine cannot preempt them:
+ *   serial  serial bridge readers, writers and network threads
+ *   usb     USB client network, transfer event, send queue and hotplug threads
+ *   net     server event loop workers, TLS handshake, protocol pool and UDP
+ *           threads, and the bench client's workers
+ *
+ * thread_sched_create() starts a thread in a class: the thread applies the
+ * class settings to itself before running, and is registered until it
+ * returns, so thread_sched_set() can change the settings of running
+ * threads too (mgmt "set sched" + "reload"). While any class uses a
+ * real-time policy, all process memory is locked (mlockall) so page faults
+ * do not add latency; it is unlocked once no class does.
+ *
+ * Affinity and policies are Linux features; elsewhere settings are kept
+ * but applying them returns E_NOT_SUPPORTED. Real-time policies need
+ * CAP_SYS_NICE (or a matching RLIMIT_RTPRIO) and mlockall needs
+ * CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK; without them the thread
+ * keeps running with the default policy.
+ *
+ * Every thread the process starts goes through thread_sched_create(),
+ * those outside the classes with THREAD_CLASS_NONE, so all of them get
+ * the stack size from thread_sched_set_stack_size() (--thread-stack). The
+ * system default (commonly 8 MiB of address space each) is what a
+ * low-memory build wants to avoid; XOE_THREAD_STACK_SIZE sets the
+ * compile-time default.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef THREAD_SCHED_H
+#define THREAD_SCHED_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/* Most CPUs in one class's set (and in a --cpus list) */
+#define THREAD_SCHED_MAX_CPUS 64
+
+/* Highest CPU number accepted */
+#define THREAD_SCHED_MAX_CPU 4095
+
+/* Real-time priority range (SCHED_FIFO / SCHED_RR) and the default */
+#define THREAD_SCHED_MIN_PRIO 1
+#define THREAD_SCHED_MAX_PRIO 99
+#define THREAD_SCHED_DEFAULT_PRIO 50
+
+/* Running threads tracked for live changes; later ones still get the
+ * settings when they start */
+#define THREAD_SCHED_MAX_THREADS 256
+
+/* Longest text produced by thread_sched_format() */
+#define THREAD_SCHED_FORMAT_MAX 512
+
+/* Range of --thread-stack (KiB) */
+#define THREAD_SCHED_MIN_STACK_KB 64
+#define THREAD_SCHED_MAX_STACK_KB (64 * 1024)
+
+/* Stack size of new threads in bytes (0 = system default) */
+#ifndef XOE_THREAD_STACK_SIZE
+#if XOE_SMALL_FOOTPRINT
+#define XOE_THREAD_STACK_SIZE (256 * 1024)
+#else
+#define XOE_THREAD_STACK_SIZE 0
+#endif
+#endif
+
+/**
+ * @brief Thread classes
+ */
+typedef enum {
+    THREAD_CLASS_NONE = -1,         /* Stack size only, never rescheduled */
+    THREAD_CLASS_SERIAL = 0,
+    THREAD_CLASS_USB,
+    THREAD_CLASS_NET,
+
+    THREAD_CLASS_COUNT
+} thread_class_t;
+
+/**
+ * @brief Scheduling policies
+ */
+typedef enum {
+    THREAD_POLICY_DEFAULT = 0,      /* SCHED_OTHER */
+    THREAD_POLICY_FIFO,             /* SCHED_FIFO */
+    THREAD_POLICY_RR                /* SCHED_RR */
+} thread_policy_t;
+
+/**
+ * @brief Settings of one class
+ */
+typedef struct {
+    int cpu_count;                      /* Entries in cpus (0 = any CPU) */
+    int cpus[THREAD_SCHED_MAX_CPUS];
+    thread_policy_t policy;
+    int priority;                       /* Real-time policies only */
+} thread_sched_class_t;
+
+/**
+ * @brief Settings of every class (all zero = leave threads alone)
+ */
+typedef struct {
+    thread_sched_class_t classes[THREAD_CLASS_COUNT];
+} thread_sched_t;
+
+/**
+ * @brief Parse a CPU list such as "0,2,4-7"
+ *
+ * @param list  Comma-separated CPU numbers and ranges
+ * @param cpus  Receives the CPUs
+ * @param max   Capacity of @p cpus
+ * @param count Receives the number of CPUs
+ * @return 0, or E_INVALID_ARGUMENT on a syntax error or more than @p max CPUs
+ */
+int thread_sched_parse_cpus(const char* list, int* cpus, int max, int* count);
+
+/**
+ * @brief Parse "<class>:<cpus>[:<policy>[:<priority>]]"
+ *
+ * Class is serial, usb or net; cpus is a CPU list or "any"; policy is
+ * fifo, rr or default (priority defaults to THREAD_SCHED_DEFAULT_PRIO).
+ * Examples: "serial:2-3:fifo:80", "net:0,1", "usb:any:rr".
+ *
+ * @param spec  Text to parse
+ * @param cls   Receives the class
+ * @param entry Receives its settings
+ * @return 0 or E_INVALID_ARGUMENT
+ */
+int thread_sched_parse(const char* spec, thread_class_t* cls,
+                       thread_sched_class_t* entry);
+
+/**
+ * @brief Name of a class ("serial", "usb", "net")
+ */
+const char* thread_sched_class_name(thread_class_t cls);
+
+/**
+ * @brief Describe settings, e.g. "serial cpus 2,3 fifo/80, net cpus 0,1"
+ *
+ * Classes left alone are omitted; nothing configured gives "default".
+ */
+void thread_sched_format(const thread_sched_t* sched, char* buf, size_t size);
+
+/**
+ * @brief Make @p sched the process settings and apply changed classes to
+ *        their running threads
+ *
+ * A class whose CPU set is removed goes back to the CPUs the process
+ * started with. Locks or unlocks memory as real-time use starts or ends.
+ *
+ * @return 0, or the first error (E_PERMISSION_DENIED, E_NOT_SUPPORTED,
+ *         E_INVALID_ARGUMENT); the rest is still applied
+ */
+int thread_sched_set(const thread_sched_t* sched);
+
+/**
+ * @brief Copy the process settings into @p sched
+ */
+void thread_sched_get(thread_sched_t* sched);
+
+/**
+ * @brief pthread_create() for a thread of class @p cls
+ *
+ * The new thread applies the settings before @p func runs, and this call
+ * returns only after it has, so a later per-thread change (--cpus) wins.
+ * Failing to apply them is logged (once per class) but does not stop
+ * the thread. THREAD_CLASS_NONE threads only get the stack size.
+ *
+ * @return As pthread_create()
+ */
+int thread_sched_create(pthread_t* thread, thread_class_t cls,
+                        void* (*func)(void*), void* arg);
+
+/**
+ * @brief Set the stack size of threads created from now on
+ *
+ * @param bytes Stack size (0 = system default); raised to the system
+ *              minimum if below it
+ */
+void thread_sched_set_stack_size(size_t bytes);
+
+/**
+ * @brief Stack size of new threads in bytes (0 = system default)
+ */
+size_t thread_sched_stack_size(void);
+
+/**
+ * @brief Whether memory is locked for real-time use
+ */
+int thread_sched_memory_locked(void);
+
+#endif /* THREAD_SCHED_H */
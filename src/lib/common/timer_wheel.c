@@ -0,0 +1,348 @@
+/**
+ * @file timer_wheel.c
+ * @brief Hierarchical timer wheel
+ *
+ * Times are whole ticks since base_ms; a deadline rounds up to a tick and
+ * the clock rounds down, so a timer fires only once its deadline passed.
+ * A timer due in delta ticks lives on the lowest level L with
+ * delta < 64^(L+1), in slot (expires >> 6L) & 63. Slots are indexed by
+ * absolute tick, so a level-L slot comes round exactly when the clock
+ * reaches a multiple of 64^L whose index matches; at that boundary its
+ * timers are re-hashed onto finer levels (higher levels first, so a timer
+ * can fall through several levels at once) before level 0's slot for
+ * the tick expires.
+ *
+ * Advancing jumps straight to the next tick at which a slot is occupied,
+ * found from the occupancy words with one rotate and count-trailing-zeros
+ * per level, so an hour without deadlines costs no more than one that
+ * has them.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "timer_wheel.h"
+#include "lib/common/definitions.h"
+
+/* Ticks covered by all levels */
+#define TIMER_WHEEL_RANGE \
+    ((uint64_t)1 << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS))
+
+#define TIMER_WHEEL_MASK ((uint64_t)TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * @brief Shift from ticks to a level's slot numbers
+ */
+static int level_shift(int level)
+{
+    return level * TIMER_WHEEL_SLOT_BITS;
+}
+
+/**
+ * @brief Unlink a timer from its list, keeping the occupancy bits right
+ */
+static void timer_unlink(timer_wheel_t* wheel, timer_wheel_timer_t* timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+
+    if (timer->slot >= 0) {
+        int level = timer->slot / TIMER_WHEEL_SLOTS;
+        int index = timer->slot % TIMER_WHEEL_SLOTS;
+        timer_wheel_timer_t* head = &wheel->slots[level][index];
+
+        if (head->next == head) {
+            wheel->occupied[level] &= ~((uint64_t)1 << index);
+        }
+    }
+
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+/**
+ * @brief Append a timer to a list
+ */
+static void timer_link(timer_wheel_timer_t* head, timer_wheel_timer_t* timer)
+{
+    timer->next = head;
+    timer->prev = head->prev;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+/**
+ * @brief Hash a timer into the slot for its deadline (expires >= now)
+ */
+static void timer_place(timer_wheel_t* wheel, timer_wheel_timer_t* timer)
+{
+    uint64_t expires = timer->expires;
+    uint64_t delta;
+    int level;
+    int index;
+
+    /* Out of range: park in the last level until it comes closer */
+    if (expires - wheel->now >= TIMER_WHEEL_RANGE) {
+        expires = wheel->now + TIMER_WHEEL_RANGE - 1;
+    }
+    delta = expires - wheel->now;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < ((uint64_t)1 << level_shift(level + 1))) {
+            break;
+        }
+    }
+
+    index = (int)((expires >> level_shift(level)) & TIMER_WHEEL_MASK);
+    timer->slot = level * TIMER_WHEEL_SLOTS + index;
+    timer_link(&wheel->slots[level][index], timer);
+    wheel->occupied[level] |= (uint64_t)1 << index;
+}
+
+/**
+ * @brief Next tick after now at which a slot needs processing
+ *
+ * For level 0 that is a deadline; for higher levels the boundary at
+ * which the slot cascades.
+ *
+ * Returns: Tick, or UINT64_MAX if the wheel is empty
+ */
+static uint64_t timer_wheel_next_tick(const timer_wheel_t* wheel)
+{
+    uint64_t best = UINT64_MAX;
+    int level;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        uint64_t occupied = wheel->occupied[level];
+        uint64_t position = wheel->now >> level_shift(level);
+        uint64_t rotated;
+        uint64_t tick;
+        int index = (int)(position & TIMER_WHEEL_MASK);
+
+        if (occupied == 0) {
+            continue;
+        }
+
+        /* Bit 0 of rotated is the slot after the current one */
+        if (index == TIMER_WHEEL_SLOTS - 1) {
+            rotated = occupied;
+        } else {
+            rotated = (occupied >> (index + 1)) |
+                      (occupied << (TIMER_WHEEL_SLOTS - 1 - index));
+        }
+
+        tick = (position + (uint64_t)__builtin_ctzll(rotated) + 1)
+               << level_shift(level);
+        if (tick < best) {
+            best = tick;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * @brief Re-hash the timers of a higher level's current slot
+ */
+static void timer_cascade(timer_wheel_t* wheel, int level)
+{
+    int index = (int)((wheel->now >> level_shift(level)) & TIMER_WHEEL_MASK);
+    timer_wheel_timer_t* head = &wheel->slots[level][index];
+    timer_wheel_timer_t* timer;
+
+    wheel->occupied[level] &= ~((uint64_t)1 << index);
+
+    while (head->next != head) {
+        timer = head->next;
+        timer->prev->next = timer->next;
+        timer->next->prev = timer->prev;
+        timer_place(wheel, timer);
+    }
+}
+
+/**
+ * @brief Expire level 0's slot for the current tick
+ */
+static int timer_expire(timer_wheel_t* wheel)
+{
+    int index = (int)(wheel->now & TIMER_WHEEL_MASK);
+    timer_wheel_timer_t* head = &wheel->slots[0][index];
+    timer_wheel_timer_t expired;
+    timer_wheel_timer_t* timer;
+    int fired = 0;
+
+    if (head->next == head) {
+        return 0;
+    }
+
+    /* Move the slot to a local list: callbacks may arm and cancel */
+    expired.next = head->next;
+    expired.prev = head->prev;
+    expired.next->prev = &expired;
+    expired.prev->next = &expired;
+    head->next = head;
+    head->prev = head;
+    wheel->occupied[0] &= ~((uint64_t)1 << index);
+
+    timer = expired.next;
+    while (timer != &expired) {
+        timer->slot = -1;
+        timer = timer->next;
+    }
+
+    while (expired.next != &expired) {
+        timer = expired.next;
+        timer_unlink(wheel, timer);
+        wheel->count--;
+        fired++;
+        timer->fn(timer, timer->arg);
+    }
+
+    return fired;
+}
+
+/**
+ * @brief Tick containing a time, rounded down
+ */
+static uint64_t ticks_floor(const timer_wheel_t* wheel, uint64_t ms)
+{
+    if (ms <= wheel->base_ms) {
+        return 0;
+    }
+    return (ms - wheel->base_ms) / wheel->tick_ms;
+}
+
+/**
+ * @brief Initialize an empty wheel
+ */
+void timer_wheel_init(timer_wheel_t* wheel, uint64_t now_ms,
+                      unsigned int tick_ms)
+{
+    int level;
+    int index;
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (index = 0; index < TIMER_WHEEL_SLOTS; index++) {
+            wheel->slots[level][index].next = &wheel->slots[level][index];
+            wheel->slots[level][index].prev = &wheel->slots[level][index];
+        }
+        wheel->occupied[level] = 0;
+    }
+
+    wheel->base_ms = now_ms;
+    wheel->now = 0;
+    wheel->tick_ms = (tick_ms > 0) ? tick_ms : 1;
+    wheel->count = 0;
+}
+
+/**
+ * @brief Prepare a timer (not pending)
+ */
+void timer_wheel_timer_init(timer_wheel_timer_t* timer, timer_wheel_fn fn,
+                            void* arg)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->expires = 0;
+    timer->slot = -1;
+    timer->fn = fn;
+    timer->arg = arg;
+}
+
+/**
+ * @brief Arm a timer, re-arming it if already pending
+ */
+void timer_wheel_add(timer_wheel_t* wheel, timer_wheel_timer_t* timer,
+                     uint64_t expires_ms)
+{
+    uint64_t expires = 0;
+
+    timer_wheel_cancel(wheel, timer);
+
+    if (expires_ms > wheel->base_ms) {
+        expires = (expires_ms - wheel->base_ms + wheel->tick_ms - 1) /
+                  wheel->tick_ms;
+    }
+    if (expires <= wheel->now) {
+        expires = wheel->now + 1;
+    }
+
+    timer->expires = expires;
+    timer_place(wheel, timer);
+    wheel->count++;
+}
+
+/**
+ * @brief Disarm a timer (no-op if not pending)
+ */
+void timer_wheel_cancel(timer_wheel_t* wheel, timer_wheel_timer_t* timer)
+{
+    if (timer->next == NULL) {
+        return;
+    }
+
+    timer_unlink(wheel, timer);
+    timer->slot = -1;
+    wheel->count--;
+}
+
+/**
+ * @brief Check whether a timer is armed
+ */
+int timer_wheel_pending(const timer_wheel_timer_t* timer)
+{
+    return (timer->next != NULL) ? TRUE : FALSE;
+}
+
+/**
+ * @brief Run the callbacks of every timer due by now_ms
+ */
+int timer_wheel_advance(timer_wheel_t* wheel, uint64_t now_ms)
+{
+    uint64_t target = ticks_floor(wheel, now_ms);
+    int fired = 0;
+    int level;
+
+    while (wheel->now < target) {
+        uint64_t next = timer_wheel_next_tick(wheel);
+
+        if (next > target) {
+            wheel->now = target;
+            break;
+        }
+        wheel->now = next;
+
+        /* Coarsest first: a timer may drop through several levels */
+        for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+            uint64_t span = ((uint64_t)1 << level_shift(level)) - 1;
+
+            if ((wheel->now & span) == 0) {
+                timer_cascade(wheel, level);
+            }
+        }
+
+        fired += timer_expire(wheel);
+    }
+
+    return fired;
+}
+
+/**
+ * @brief Time until the wheel next needs advancing
+ */
+long timer_wheel_next_ms(const timer_wheel_t* wheel, uint64_t now_ms)
+{
+    uint64_t next;
+    uint64_t due_ms;
+
+    if (wheel->count == 0) {
+        return -1;
+    }
+
+    next = timer_wheel_next_tick(wheel);
+    due_ms = wheel->base_ms + next * wheel->tick_ms;
+    if (due_ms <= now_ms) {
+        return 0;
+    }
+
+    return (long)(due_ms - now_ms);
+}
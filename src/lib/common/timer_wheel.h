@@ -0,0 +1,144 @@
+/**
+ * @file timer_wheel.h
+ * @brief Hierarchical timer wheel
+ *
+ * Deadlines for the event loop's TLS handshakes and the USB client's
+ * pending URBs. Instead of scanning every connection or request on a
+ * fixed tick to find the few that expired, each deadline is an intrusive
+ * timer hashed into one of TIMER_WHEEL_LEVELS wheels of
+ * TIMER_WHEEL_SLOTS slots: level 0 holds timers due within 64 ticks,
+ * level 1 within 64^2, and so on. Arming and cancelling are O(1) list
+ * operations; advancing visits only occupied slots, cascading a higher
+ * level's slot one level down when the lower wheel wraps, and
+ * timer_wheel_next_ms() tells the owner how long it may sleep, so an
+ * idle loop blocks until the next deadline instead of waking every
+ * second.
+ *
+ * Timers never fire early and fire at most one tick late. Deadlines
+ * further out than the wheel reaches (2^24 ticks) wait in its last
+ * level and are re-hashed until they come in range.
+ *
+ * A wheel is not thread-safe: its owner serializes every call (the
+ * event loop worker's thread, the USB client's pending_lock).
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include "lib/common/types.h"
+#include <stddef.h>
+
+/* Levels, and slots per level (64: one bit each in an occupancy word) */
+#define TIMER_WHEEL_LEVELS     4
+#define TIMER_WHEEL_SLOT_BITS  6
+#define TIMER_WHEEL_SLOTS      (1 << TIMER_WHEEL_SLOT_BITS)
+
+struct timer_wheel_timer;
+
+/**
+ * @brief Expiry callback
+ *
+ * Runs inside timer_wheel_advance(), which the owner calls under its own
+ * serialization; the timer is no longer pending and may be re-armed or
+ * freed, and other timers may be armed or cancelled.
+ */
+typedef void (*timer_wheel_fn)(struct timer_wheel_timer* timer, void* arg);
+
+/**
+ * @brief Timer, embedded in the object it times
+ */
+typedef struct timer_wheel_timer {
+    struct timer_wheel_timer* next;     /* Slot list; NULL when idle */
+    struct timer_wheel_timer* prev;
+    uint64_t expires;                   /* Due tick */
+    int slot;                           /* level * TIMER_WHEEL_SLOTS + index,
+                                           or -1 while being expired */
+    timer_wheel_fn fn;
+    void* arg;
+} timer_wheel_timer_t;
+
+/**
+ * @brief Timer wheel (embedded by value; about 10 KB)
+ */
+typedef struct {
+    timer_wheel_timer_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t occupied[TIMER_WHEEL_LEVELS];  /* Non-empty slots */
+    uint64_t base_ms;                   /* Time of tick 0 */
+    uint64_t now;                       /* Ticks processed so far */
+    unsigned int tick_ms;               /* Resolution */
+    size_t count;                       /* Pending timers */
+} timer_wheel_t;
+
+/**
+ * @brief Initialize an empty wheel
+ *
+ * @param wheel Wheel to initialize
+ * @param now_ms Current time on the clock later calls use (milliseconds)
+ * @param tick_ms Resolution in milliseconds (0 is taken as 1)
+ */
+void timer_wheel_init(timer_wheel_t* wheel, uint64_t now_ms,
+                      unsigned int tick_ms);
+
+/**
+ * @brief Prepare a timer (not pending)
+ *
+ * @param timer Timer to initialize
+ * @param fn Called when the timer expires
+ * @param arg Passed to @p fn
+ */
+void timer_wheel_timer_init(timer_wheel_timer_t* timer, timer_wheel_fn fn,
+                            void* arg);
+
+/**
+ * @brief Arm a timer, re-arming it if already pending
+ *
+ * A deadline already past fires on the next advance by a tick.
+ *
+ * @param wheel Wheel
+ * @param timer Initialized timer
+ * @param expires_ms Deadline (same clock as timer_wheel_init())
+ */
+void timer_wheel_add(timer_wheel_t* wheel, timer_wheel_timer_t* timer,
+                     uint64_t expires_ms);
+
+/**
+ * @brief Disarm a timer (no-op if not pending)
+ *
+ * @param wheel Wheel the timer was armed on
+ * @param timer Timer
+ */
+void timer_wheel_cancel(timer_wheel_t* wheel, timer_wheel_timer_t* timer);
+
+/**
+ * @brief Check whether a timer is armed
+ *
+ * @param timer Initialized timer
+ * @return TRUE if armed and not yet expired
+ */
+int timer_wheel_pending(const timer_wheel_timer_t* timer);
+
+/**
+ * @brief Run the callbacks of every timer due by @p now_ms
+ *
+ * @param wheel Wheel
+ * @param now_ms Current time
+ * @return Number of timers that expired
+ */
+int timer_wheel_advance(timer_wheel_t* wheel, uint64_t now_ms);
+
+/**
+ * @brief Time until the wheel next needs advancing
+ *
+ * May be earlier than the next deadline when a far timer has to move to
+ * a finer level first.
+ *
+ * @param wheel Wheel
+ * @param now_ms Current time
+ * @return Milliseconds to sleep (0 if something is due), or -1 if no
+ *         timer is pending
+ */
+long timer_wheel_next_ms(const timer_wheel_t* wheel, uint64_t now_ms);
+
+#endif /* TIMER_WHEEL_H */
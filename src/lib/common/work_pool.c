@@ -0,0 +1,427 @@
+/**
+ * @file work_pool.c
+ * @brief Work-stealing thread pool with per-key ordering
+ *
+ * Deques are doubly linked lists of intrusive tasks under a mutex each,
+ * so they never fill up and a steal only contends with the one owner.
+ * The pool-wide counters are atomics; the pool mutex is only taken by a
+ * thread about to sleep, or a submitter about to wait for room, and by
+ * whoever has to wake them (Dekker style: each side publishes its own
+ * counter, then checks the other's, with a full fence in between).
+ *
+ * A sequence's queue is guarded by one of WORK_POOL_SEQ_LOCKS mutexes
+ * picked by its address, which keeps work_seq_t free of anything that
+ * needs initializing. Its drain item is the only thing of it ever in a
+ * deque, and only while scheduled is set, so its tasks cannot run
+ * concurrently.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "work_pool.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Marks a sequence's drain item (never called)
+ */
+static void seq_drain_marker(work_task_t* task, void* arg)
+{
+    (void)task;
+    (void)arg;
+}
+
+/**
+ * @brief Index of a sequence's lock and condition
+ */
+static int seq_index(const work_seq_t* seq)
+{
+    return (int)(((uintptr_t)seq / sizeof(void*)) % WORK_POOL_SEQ_LOCKS);
+}
+
+/**
+ * @brief Append to the newest end of a deque (lock held)
+ */
+static void deque_push(work_pool_thread_t* thread, work_task_t* task)
+{
+    task->next = NULL;
+    task->prev = thread->bottom;
+    if (thread->bottom != NULL) {
+        thread->bottom->next = task;
+    } else {
+        thread->top = task;
+    }
+    thread->bottom = task;
+}
+
+/**
+ * @brief Take from the oldest end of a deque (lock held)
+ */
+static work_task_t* deque_pop_top(work_pool_thread_t* thread)
+{
+    work_task_t* task = thread->top;
+
+    if (task != NULL) {
+        thread->top = task->next;
+        if (thread->top != NULL) {
+            thread->top->prev = NULL;
+        } else {
+            thread->bottom = NULL;
+        }
+    }
+    return task;
+}
+
+/**
+ * @brief Take from the newest end of a deque (lock held)
+ */
+static work_task_t* deque_pop_bottom(work_pool_thread_t* thread)
+{
+    work_task_t* task = thread->bottom;
+
+    if (task != NULL) {
+        thread->bottom = task->prev;
+        if (thread->bottom != NULL) {
+            thread->bottom->next = NULL;
+        } else {
+            thread->top = NULL;
+        }
+    }
+    return task;
+}
+
+/**
+ * @brief Queue an item on a thread's deque and wake a sleeper
+ */
+static void pool_push(work_pool_t* pool, int index, work_task_t* task)
+{
+    work_pool_thread_t* thread = &pool->threads[index];
+
+    pthread_mutex_lock(&thread->lock);
+    deque_push(thread, task);
+    pthread_mutex_unlock(&thread->lock);
+
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->work);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief Next item for a thread: its own oldest, else another's newest
+ */
+static work_task_t* pool_take(work_pool_thread_t* self)
+{
+    work_pool_t* pool = self->pool;
+    work_pool_thread_t* victim;
+    work_task_t* task;
+    int i;
+
+    pthread_mutex_lock(&self->lock);
+    task = deque_pop_top(self);
+    pthread_mutex_unlock(&self->lock);
+
+    for (i = 1; task == NULL && i < pool->count; i++) {
+        victim = &pool->threads[(self->index + i) % pool->count];
+        pthread_mutex_lock(&victim->lock);
+        task = deque_pop_bottom(victim);
+        pthread_mutex_unlock(&victim->lock);
+        if (task != NULL) {
+            metrics_add(METRIC_POOL_STEALS, 1);
+        }
+    }
+
+    if (task != NULL) {
+        __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+    }
+    return task;
+}
+
+/**
+ * @brief Account for a finished or cancelled task and let a submitter in
+ */
+static void task_finished(work_pool_t* pool)
+{
+    __atomic_sub_fetch(&pool->outstanding, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->blocked, __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->room);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief Run a sequence's queued tasks in order, up to a burst
+ *
+ * Still busy after the burst, the sequence goes to the newest end of
+ * this thread's deque, behind everything already waiting there.
+ */
+static void seq_drain(work_pool_thread_t* self, work_seq_t* seq)
+{
+    work_pool_t* pool = self->pool;
+    int index = seq_index(seq);
+    work_task_t* task;
+    int ran;
+
+    for (ran = 0; ran < WORK_POOL_SEQ_BURST; ran++) {
+        pthread_mutex_lock(&pool->seq_locks[index]);
+        task = seq->head;
+        if (task == NULL) {
+            seq->scheduled = FALSE;
+            if (seq->waiters > 0) {
+                pthread_cond_broadcast(&pool->seq_idle[index]);
+            }
+            pthread_mutex_unlock(&pool->seq_locks[index]);
+            return;
+        }
+        seq->head = task->next;
+        if (seq->head == NULL) {
+            seq->tail = NULL;
+        }
+        pthread_mutex_unlock(&pool->seq_locks[index]);
+
+        task->fn(task, task->arg);
+        metrics_add(METRIC_POOL_TASKS, 1);
+        task_finished(pool);
+    }
+
+    pool_push(pool, self->index, &seq->drain);
+}
+
+/**
+ * @brief Pool thread: run items until stopped and nothing is left
+ */
+static void* pool_thread_func(void* arg)
+{
+    work_pool_thread_t* self = (work_pool_thread_t*)arg;
+    work_pool_t* pool = self->pool;
+    work_task_t* task;
+    int done;
+
+    for (;;) {
+        task = pool_take(self);
+        if (task != NULL) {
+            if (task->fn == seq_drain_marker) {
+                seq_drain(self, (work_seq_t*)task->arg);
+            } else {
+                task->fn(task, task->arg);
+                metrics_add(METRIC_POOL_TASKS, 1);
+                task_finished(pool);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0 &&
+               !pool->stop) {
+            pthread_cond_wait(&pool->work, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+        done = pool->stop &&
+               __atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (done) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int work_pool_start(work_pool_t* pool, int threads, int max_tasks)
+{
+    int i;
+
+    if (pool == NULL || threads < 1 || threads > WORK_POOL_MAX_THREADS ||
+        max_tasks < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = (work_pool_thread_t*)calloc((size_t)threads,
+                                                sizeof(work_pool_thread_t));
+    if (pool->threads == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    pool->count = threads;
+    pool->max_tasks = max_tasks;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->room, NULL);
+    for (i = 0; i < WORK_POOL_SEQ_LOCKS; i++) {
+        pthread_mutex_init(&pool->seq_locks[i], NULL);
+        pthread_cond_init(&pool->seq_idle[i], NULL);
+    }
+    for (i = 0; i < threads; i++) {
+        pool->threads[i].pool = pool;
+        pool->threads[i].index = i;
+        pthread_mutex_init(&pool->threads[i].lock, NULL);
+    }
+
+    for (i = 0; i < threads; i++) {
+        if (thread_sched_create(&pool->threads[i].thread, THREAD_CLASS_NET,
+                                pool_thread_func, &pool->threads[i]) != 0) {
+            work_pool_stop(pool);
+            return E_UNKNOWN_ERROR;
+        }
+        pool->started++;
+    }
+    return 0;
+}
+
+void work_pool_stop(work_pool_t* pool)
+{
+    int i;
+
+    if (pool == NULL || pool->threads == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->work);
+    pthread_cond_broadcast(&pool->room);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->started; i++) {
+        pthread_join(pool->threads[i].thread, NULL);
+    }
+    for (i = 0; i < pool->count; i++) {
+        pthread_mutex_destroy(&pool->threads[i].lock);
+    }
+    for (i = 0; i < WORK_POOL_SEQ_LOCKS; i++) {
+        pthread_mutex_destroy(&pool->seq_locks[i]);
+        pthread_cond_destroy(&pool->seq_idle[i]);
+    }
+    pthread_cond_destroy(&pool->room);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    memset(pool, 0, sizeof(*pool));
+}
+
+void work_task_init(work_task_t* task, work_task_fn fn, void* arg)
+{
+    task->fn = fn;
+    task->arg = arg;
+    task->next = NULL;
+    task->prev = NULL;
+}
+
+/**
+ * @brief Wait while the pool holds its limit of unfinished tasks
+ */
+static void wait_for_room(work_pool_t* pool)
+{
+    if (pool->max_tasks == 0) {
+        return;
+    }
+
+    while (__atomic_load_n(&pool->outstanding, __ATOMIC_SEQ_CST) >=
+           pool->max_tasks) {
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->blocked, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&pool->outstanding, __ATOMIC_SEQ_CST) >=
+                pool->max_tasks && !pool->stop) {
+            pthread_cond_wait(&pool->room, &pool->lock);
+        }
+        __atomic_sub_fetch(&pool->blocked, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+void work_pool_submit(work_pool_t* pool, work_seq_t* seq, work_task_t* task)
+{
+    int thread;
+    int schedule;
+    int index;
+
+    wait_for_room(pool);
+    __atomic_add_fetch(&pool->outstanding, 1, __ATOMIC_SEQ_CST);
+    thread = (int)(__atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED) %
+                   (unsigned int)pool->count);
+
+    if (seq == NULL) {
+        pool_push(pool, thread, task);
+        return;
+    }
+
+    index = seq_index(seq);
+    pthread_mutex_lock(&pool->seq_locks[index]);
+    task->next = NULL;
+    if (seq->tail != NULL) {
+        seq->tail->next = task;
+    } else {
+        seq->head = task;
+    }
+    seq->tail = task;
+    schedule = !seq->scheduled;
+    if (schedule) {
+        seq->scheduled = TRUE;
+        work_task_init(&seq->drain, seq_drain_marker, seq);
+    }
+    pthread_mutex_unlock(&pool->seq_locks[index]);
+
+    if (schedule) {
+        pool_push(pool, thread, &seq->drain);
+    }
+}
+
+int work_seq_cancel(work_pool_t* pool, work_seq_t* seq, work_task_fn drop)
+{
+    int index = seq_index(seq);
+    work_task_t* task;
+    work_task_t* next;
+    int count = 0;
+
+    pthread_mutex_lock(&pool->seq_locks[index]);
+    task = seq->head;
+    seq->head = NULL;
+    seq->tail = NULL;
+    pthread_mutex_unlock(&pool->seq_locks[index]);
+
+    for (; task != NULL; task = next) {
+        next = task->next;
+        if (drop != NULL) {
+            drop(task, task->arg);
+        }
+        task_finished(pool);
+        count++;
+    }
+    return count;
+}
+
+void work_seq_wait(work_pool_t* pool, work_seq_t* seq)
+{
+    int index = seq_index(seq);
+
+    pthread_mutex_lock(&pool->seq_locks[index]);
+    seq->waiters++;
+    while (seq->head != NULL || seq->scheduled) {
+        pthread_cond_wait(&pool->seq_idle[index], &pool->seq_locks[index]);
+    }
+    seq->waiters--;
+    pthread_mutex_unlock(&pool->seq_locks[index]);
+}
+
+int work_seq_busy(work_pool_t* pool, work_seq_t* seq)
+{
+    int index = seq_index(seq);
+    int busy;
+
+    pthread_mutex_lock(&pool->seq_locks[index]);
+    busy = (seq->head != NULL || seq->scheduled);
+    pthread_mutex_unlock(&pool->seq_locks[index]);
+    return busy;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file work_pool.h
+ * @brief Work-stealing thread pool with per-key ordering
+ *
+ * CPU-heavy per-frame work that must not stall the thread which received
+ * the data (the server's XOE_DISPATCH_POOL protocols, see
+ * core/protocol_registry.h) runs here as tasks. Each pool thread owns a
+ * deque: it works through its own from the oldest end, and a thread that
+ * runs dry steals from the newest end of another's, so a burst queued
+ * behind one busy thread is picked up by the idle ones instead of
+ * waiting for it.
+ *
+ * Tasks submitted on a sequence (work_seq_t, one per connection) run one
+ * at a time and in submission order, on whichever thread is free; tasks
+ * of different sequences run in parallel. A sequence is scheduled as a
+ * single item that runs its queued tasks in turn and, after
+ * WORK_POOL_SEQ_BURST of them, goes to the back of its thread's deque,
+ * so one hot sequence keeps at most one thread busy and cannot hold the
+ * tasks queued behind it hostage.
+ *
+ * Submissions from outside the pool are spread over the deques round
+ * robin and wait for room once the pool holds its limit of unfinished
+ * tasks, which throttles the producers of a saturated pool instead of
+ * queueing without bound.
+ *
+ * Tasks and sequences are intrusive: the caller embeds them and keeps
+ * them valid until the task has run or been cancelled, and the sequence
+ * until it is idle. A zeroed work_seq_t is an idle sequence.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <pthread.h>
+
+/* Most threads in one pool */
+#define WORK_POOL_MAX_THREADS 64
+
+/* Tasks a sequence runs before it yields its thread */
+#define WORK_POOL_SEQ_BURST 32
+
+/* Locks the sequences are hashed onto (a prime, so sequences embedded at a
+ * fixed stride spread over all of them) */
+#define WORK_POOL_SEQ_LOCKS 31
+
+struct work_task;
+
+/**
+ * @brief Task body
+ *
+ * Runs on a pool thread. The task may be freed or resubmitted from here;
+ * the pool does not touch it afterwards.
+ */
+typedef void (*work_task_fn)(struct work_task* task, void* arg);
+
+/**
+ * @brief Task, embedded in the object it works on
+ */
+typedef struct work_task {
+    work_task_fn fn;
+    void* arg;
+    struct work_task* next;             /* Deque or sequence queue */
+    struct work_task* prev;             /* Deque only */
+} work_task_t;
+
+/**
+ * @brief Ordered stream of tasks (guarded by the pool's sequence locks)
+ */
+typedef struct {
+    work_task_t* head;                  /* Queued, oldest first */
+    work_task_t* tail;
+    int scheduled;                      /* Drain queued or running */
+    int waiters;                        /* Threads in work_seq_wait() */
+    work_task_t drain;                  /* Its item in the deques */
+} work_seq_t;
+
+struct work_pool;
+
+/**
+ * @brief One pool thread and its deque
+ */
+typedef struct {
+    struct work_pool* pool;
+    pthread_t thread;
+    int index;
+    pthread_mutex_t lock;               /* Protects top and bottom */
+    work_task_t* top;                   /* Oldest: the owner takes from here */
+    work_task_t* bottom;                /* Newest: thieves take from here */
+} work_pool_thread_t;
+
+/**
+ * @brief Pool (treat as opaque)
+ */
+typedef struct work_pool {
+    work_pool_thread_t* threads;
+    int count;                          /* Threads with a deque */
+    int started;                        /* Threads running */
+    int max_tasks;                      /* Unfinished tasks before submitters
+                                           wait (0 = no limit) */
+    unsigned int next;                  /* Round-robin cursor (atomic) */
+    int queued;                         /* Items in the deques (atomic) */
+    int outstanding;                    /* Submitted, not finished (atomic) */
+    int sleepers;                       /* Threads out of work (atomic) */
+    int blocked;                        /* Submitters out of room (atomic) */
+    int stop;
+    pthread_mutex_t lock;               /* Sleep, room and stop */
+    pthread_cond_t work;                /* Something queued, or stop */
+    pthread_cond_t room;                /* A task finished */
+    pthread_mutex_t seq_locks[WORK_POOL_SEQ_LOCKS];
+    pthread_cond_t seq_idle[WORK_POOL_SEQ_LOCKS]; /* A sequence went idle */
+} work_pool_t;
+
+/**
+ * @brief Start a pool
+ *
+ * @param pool      Pool to fill in
+ * @param threads   Threads, 1 .. WORK_POOL_MAX_THREADS (THREAD_CLASS_NET)
+ * @param max_tasks Unfinished tasks at which submitters wait (0 = no
+ *                  limit)
+ * @return 0, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY, or E_UNKNOWN_ERROR if a
+ *         thread could not be started (the pool is then stopped again)
+ */
+int work_pool_start(work_pool_t* pool, int threads, int max_tasks);
+
+/**
+ * @brief Run every queued task, then stop the threads
+ *
+ * Nothing may be submitted once this is called. A no-op on a zeroed pool.
+ *
+ * @param pool Pool
+ */
+void work_pool_stop(work_pool_t* pool);
+
+/**
+ * @brief Prepare a task
+ *
+ * @param task Task to initialize
+ * @param fn   Body
+ * @param arg  Passed to @p fn
+ */
+void work_task_init(work_task_t* task, work_task_fn fn, void* arg);
+
+/**
+ * @brief Queue a task
+ *
+ * Waits while the pool holds max_tasks unfinished tasks; call from
+ * outside the pool.
+ *
+ * @param pool Started pool
+ * @param seq  Sequence to run it in, or NULL to run it in any order
+ * @param task Initialized task, not queued elsewhere
+ */
+void work_pool_submit(work_pool_t* pool, work_seq_t* seq, work_task_t* task);
+
+/**
+ * @brief Take back a sequence's tasks that have not started
+ *
+ * A task already running is not interrupted; use work_seq_wait() for it.
+ *
+ * @param pool Pool
+ * @param seq  Sequence
+ * @param drop Called for each task taken back, oldest first, outside the
+ *             pool's locks (NULL: just forget them)
+ * @return Number of tasks taken back
+ */
+int work_seq_cancel(work_pool_t* pool, work_seq_t* seq, work_task_fn drop);
+
+/**
+ * @brief Wait until a sequence has no task queued or running
+ *
+ * Must not be called from one of the sequence's own tasks.
+ *
+ * @param pool Pool
+ * @param seq  Sequence
+ */
+void work_seq_wait(work_pool_t* pool, work_seq_t* seq);
+
+/**
+ * @brief Check for a task of a sequence queued or running
+ *
+ * @return TRUE if busy, FALSE if idle
+ */
+int work_seq_busy(work_pool_t* pool, work_seq_t* seq);
+
+#endif /* WORK_POOL_H */
@@ -0,0 +1,236 @@
+/**
+ * event_poller.c
+ *
+ * epoll (or uring_poller) and kqueue backends of event_poller.h.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "event_poller.h"
+#include "lib/common/definitions.h"
+#include "lib/common/log.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define EVENT_POLLER_USE_EPOLL 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || \
+      defined(__OpenBSD__) || defined(__NetBSD__)
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#define EVENT_POLLER_USE_KQUEUE 1
+#else
+#error "event_poller requires epoll (Linux) or kqueue (BSD/macOS)"
+#endif
+
+/**
+ * event_poller_destroy - Release a poller
+ */
+void event_poller_destroy(event_poller_t *poller) {
+    if (poller == NULL) {
+        return;
+    }
+    if (poller->fd >= 0) {
+        close(poller->fd);
+        poller->fd = -1;
+    }
+    uring_poller_destroy(poller->uring);
+    poller->uring = NULL;
+}
+
+#if EVENT_POLLER_USE_EPOLL
+
+/*
+ * With use_io_uring the poller wraps a uring_poller instead of an epoll
+ * descriptor: interest changes are queued and submitted with the next
+ * wait rather than costing an epoll_ctl() each. Kernels without io_uring
+ * keep epoll.
+ */
+int event_poller_create(event_poller_t *poller, int use_io_uring) {
+    static int warned = 0;
+
+    poller->fd = -1;
+    poller->uring = NULL;
+
+    if (use_io_uring) {
+        if (uring_poller_create(&poller->uring) == 0) {
+            return 0;
+        }
+        if (!__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED)) {
+            LOG_WARN("io_uring unavailable, event loop falls back to epoll");
+        }
+    }
+
+    poller->fd = epoll_create(EVENT_POLLER_MAX_EVENTS);
+    return (poller->fd < 0) ? -1 : 0;
+}
+
+int event_poller_add(event_poller_t *poller, int fd, void *data) {
+    struct epoll_event ev;
+
+    if (poller->uring != NULL) {
+        return uring_poller_add(poller->uring, fd, data);
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = data;
+    return epoll_ctl(poller->fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int event_poller_set_write(event_poller_t *poller, int fd, void *data,
+                           int enable) {
+    return event_poller_set_interest(poller, fd, data, TRUE, enable);
+}
+
+int event_poller_set_interest(event_poller_t *poller, int fd, void *data,
+                              int read, int write) {
+    struct epoll_event ev;
+
+    if (poller->uring != NULL) {
+        return uring_poller_set_interest(poller->uring, fd, data, read,
+                                         write);
+    }
+
+    /* EPOLLHUP and EPOLLERR are reported even with no event asked for */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+    ev.data.ptr = data;
+    return epoll_ctl(poller->fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void event_poller_remove(event_poller_t *poller, int fd) {
+    struct epoll_event ev;
+
+    if (poller->uring != NULL) {
+        uring_poller_remove(poller->uring, fd);
+        return;
+    }
+
+    /* Non-NULL event required by kernels before 2.6.9 */
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(poller->fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+int event_poller_wait(event_poller_t *poller, event_poller_event_t *out,
+                      int max, int timeout_ms) {
+    struct epoll_event events[EVENT_POLLER_MAX_EVENTS];
+    uring_poller_event_t ring_events[EVENT_POLLER_MAX_EVENTS];
+    int n;
+    int i;
+
+    if (max > EVENT_POLLER_MAX_EVENTS) {
+        max = EVENT_POLLER_MAX_EVENTS;
+    }
+
+    if (poller->uring != NULL) {
+        n = uring_poller_wait(poller->uring, ring_events, max, timeout_ms);
+        for (i = 0; i < n; i++) {
+            out[i].data = ring_events[i].data;
+            out[i].readable = ring_events[i].readable;
+            out[i].writable = ring_events[i].writable;
+        }
+        return n;
+    }
+
+    n = epoll_wait(poller->fd, events, max, timeout_ms);
+    for (i = 0; i < n; i++) {
+        out[i].data = events[i].data.ptr;
+        /* Hangup and error are reported as readable so recv() sees them */
+        out[i].readable = (events[i].events &
+                           (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0;
+        out[i].writable = (events[i].events & EPOLLOUT) != 0;
+    }
+    return n;
+}
+
+#elif EVENT_POLLER_USE_KQUEUE
+
+int event_poller_create(event_poller_t *poller, int use_io_uring) {
+    static int warned = 0;
+
+    poller->fd = -1;
+    poller->uring = NULL;
+
+    if (use_io_uring && !__atomic_exchange_n(&warned, 1, __ATOMIC_RELAXED)) {
+        LOG_WARN("io_uring is Linux only, event loop uses kqueue");
+    }
+
+    poller->fd = kqueue();
+    return (poller->fd < 0) ? -1 : 0;
+}
+
+int event_poller_add(event_poller_t *poller, int fd, void *data) {
+    struct kevent change;
+
+    EV_SET(&change, fd, EVFILT_READ, EV_ADD, 0, 0, data);
+    return kevent(poller->fd, &change, 1, NULL, 0, NULL);
+}
+
+int event_poller_set_write(event_poller_t *poller, int fd, void *data,
+                           int enable) {
+    return event_poller_set_interest(poller, fd, data, TRUE, enable);
+}
+
+int event_poller_set_interest(event_poller_t *poller, int fd, void *data,
+                              int read, int write) {
+    struct kevent change;
+
+    /* While reading is paused, a closed peer shows on the write filter */
+    EV_SET(&change, fd, EVFILT_READ, read ? EV_ENABLE : EV_DISABLE,
+           0, 0, data);
+    if (kevent(poller->fd, &change, 1, NULL, 0, NULL) != 0) {
+        return -1;
+    }
+
+    /* Deleting a write filter never added is not an error */
+    EV_SET(&change, fd, EVFILT_WRITE, write ? EV_ADD : EV_DELETE,
+           0, 0, data);
+    if (kevent(poller->fd, &change, 1, NULL, 0, NULL) != 0 &&
+        (write || errno != ENOENT)) {
+        return -1;
+    }
+    return 0;
+}
+
+void event_poller_remove(event_poller_t *poller, int fd) {
+    struct kevent change;
+
+    /* Issued separately: a missing write filter must not mask the read one */
+    EV_SET(&change, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    kevent(poller->fd, &change, 1, NULL, 0, NULL);
+    EV_SET(&change, fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+    kevent(poller->fd, &change, 1, NULL, 0, NULL);
+}
+
+int event_poller_wait(event_poller_t *poller, event_poller_event_t *out,
+                      int max, int timeout_ms) {
+    struct kevent events[EVENT_POLLER_MAX_EVENTS];
+    struct timespec ts;
+    int n;
+    int i;
+
+    if (max > EVENT_POLLER_MAX_EVENTS) {
+        max = EVENT_POLLER_MAX_EVENTS;
+    }
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+
+    /* Negative timeout: wait without limit */
+    n = kevent(poller->fd, NULL, 0, events, max,
+               (timeout_ms < 0) ? NULL : &ts);
+    for (i = 0; i < n; i++) {
+        out[i].data = (void *)events[i].udata;
+        out[i].readable = (events[i].filter == EVFILT_READ);
+        out[i].writable = (events[i].filter == EVFILT_WRITE);
+    }
+    return n;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * event_poller.h
+ *
+ * Readiness poller behind every event loop of XOE: the server's
+ * connection workers (core/event_loop.c) and the management server
+ * (core/mgmt/mgmt_server.c).
+ *
+ * Wraps epoll on Linux, or io_uring when asked for and the kernel
+ * supports it (see uring_poller.h), and kqueue on BSD/macOS. Descriptors
+ * are level-triggered and watched for reading; write interest is added
+ * and dropped as output backs up and drains, and reading can be paused
+ * while it is backed up too far. Hangup and error are reported as
+ * readable, paused or not, so the following read or write sees them.
+ *
+ * A poller is not thread-safe; it belongs to the one thread that waits
+ * on it.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef EVENT_POLLER_H
+#define EVENT_POLLER_H
+
+#include "lib/net/uring_poller.h"
+
+/* Most events one event_poller_wait() returns */
+#define EVENT_POLLER_MAX_EVENTS 64
+
+/**
+ * Poller (embedded by value)
+ */
+typedef struct {
+    int fd;                         /* epoll or kqueue descriptor, or -1 */
+    uring_poller_t *uring;          /* io_uring instead of epoll, or NULL */
+} event_poller_t;
+
+/**
+ * Readiness report
+ */
+typedef struct {
+    void *data;                     /* Pointer given to event_poller_add() */
+    int readable;                   /* Readable, hangup or error */
+    int writable;                   /* Writable (only with write interest) */
+} event_poller_event_t;
+
+/**
+ * event_poller_create - Set up a poller
+ * @poller:       Poller to initialize
+ * @use_io_uring: Poll with io_uring (Linux 5.11+); other kernels and
+ *                platforms keep their default, with one warning per process
+ *
+ * Returns: 0 on success, -1 with errno set
+ */
+int event_poller_create(event_poller_t *poller, int use_io_uring);
+
+/**
+ * event_poller_destroy - Release a poller
+ * @poller: Poller, created or zeroed with fd -1 (NULL is ignored)
+ */
+void event_poller_destroy(event_poller_t *poller);
+
+/**
+ * event_poller_add - Watch a descriptor for readability
+ * @poller: Poller
+ * @fd:     Descriptor
+ * @data:   Returned with its events
+ *
+ * Returns: 0 on success, nonzero on failure
+ */
+int event_poller_add(event_poller_t *poller, int fd, void *data);
+
+/**
+ * event_poller_set_write - Add or drop write interest
+ * @poller: Poller
+ * @fd:     Watched descriptor
+ * @data:   Returned with its events
+ * @enable: TRUE to also report writability
+ *
+ * Reading is resumed if it was paused.
+ *
+ * Returns: 0 on success, nonzero on failure
+ */
+int event_poller_set_write(event_poller_t *poller, int fd, void *data,
+                           int enable);
+
+/**
+ * event_poller_set_interest - Choose the readiness reported for a descriptor
+ * @poller: Poller
+ * @fd:     Watched descriptor
+ * @data:   Returned with its events
+ * @read:   Report readability (FALSE pauses reading)
+ * @write:  Report writability
+ *
+ * Returns: 0 on success, nonzero on failure
+ */
+int event_poller_set_interest(event_poller_t *poller, int fd, void *data,
+                              int read, int write);
+
+/**
+ * event_poller_remove - Stop watching a descriptor
+ * @poller: Poller
+ * @fd:     Descriptor (may be closed right after)
+ */
+void event_poller_remove(event_poller_t *poller, int fd);
+
+/**
+ * event_poller_wait - Wait for readiness
+ * @poller:     Poller
+ * @out:        Receives up to @max events (at most EVENT_POLLER_MAX_EVENTS)
+ * @max:        Capacity of @out
+ * @timeout_ms: Longest wait (0 = do not block, negative = no limit)
+ *
+ * kqueue may report read and write readiness of one descriptor as two
+ * events.
+ *
+ * Returns: Number of events (0 on timeout), or -1 with errno set (EINTR
+ *          when interrupted by a signal)
+ */
+int event_poller_wait(event_poller_t *poller, event_poller_event_t *out,
+                      int max, int timeout_ms);
+
+#endif /* EVENT_POLLER_H */
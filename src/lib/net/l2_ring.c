@@ -0,0 +1,555 @@
+/**
+ * l2_ring.c
+ *
+ * TPACKET_V3 receive and send rings in one mapping, receive blocks first.
+ * The socket is opened for no protocol and only bound to the interface
+ * and EtherType once both rings exist, so no frame of another interface
+ * ends up in the ring.
+ *
+ * Block and slot status words are shared with the kernel: they are read
+ * with acquire and written with release ordering, the frame contents in
+ * between with plain accesses.
+ *
+ * [LLM-ARCH]
+ */
+
+/* struct ifreq, IFNAMSIZ under -std=c99 */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "l2_ring.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#endif
+
+#if defined(__linux__) && defined(TPACKET3_HDRLEN)
+#define L2_RING_AVAILABLE 1
+#else
+#define L2_RING_AVAILABLE 0
+#endif
+
+/* Ethernet pads payloads shorter than this */
+#define L2_MIN_PAYLOAD 46
+
+#if L2_RING_AVAILABLE
+
+/* Frame data in a send slot: after the header, where TPACKET_V3 expects it */
+#define L2_TX_DATA_OFFSET (TPACKET3_HDRLEN - sizeof(struct sockaddr_ll))
+
+/* Payload a slot has room for */
+#define L2_SLOT_PAYLOAD (L2_RING_SLOT_SIZE - L2_TX_DATA_OFFSET - \
+                         L2_RING_HEADER_SIZE)
+
+struct l2_ring {
+    int fd;
+    uint16_t ethertype;             /* Network order */
+    uint8_t mac[L2_RING_MAC_LEN];
+    uint32_t mtu;                   /* Payload limit, capped to a slot */
+    uint8_t *map;
+    size_t map_size;
+
+    /* Receive */
+    uint8_t *rx;
+    unsigned rx_block;              /* Block being read or waited for */
+    int rx_held;                    /* rx_block is ours until released */
+    uint8_t *rx_frame;              /* Next frame in it */
+    uint32_t rx_left;               /* Frames left in it */
+
+    /* Send (tx == NULL: one sendto() per frame) */
+    uint8_t *tx;
+    unsigned tx_slots;
+    unsigned tx_next;               /* Slot the next frame goes to */
+    unsigned tx_queued;             /* Committed since the last flush */
+    uint8_t *tx_current;            /* Frame begun, NULL if none */
+    uint8_t fallback[L2_RING_HEADER_SIZE + L2_SLOT_PAYLOAD];
+};
+
+static uint32_t status_load(const volatile uint32_t *status) {
+    return __atomic_load_n(status, __ATOMIC_ACQUIRE);
+}
+
+static void status_store(volatile uint32_t *status, uint32_t value) {
+    __atomic_store_n(status, value, __ATOMIC_RELEASE);
+}
+
+/**
+ * errno_result - Map an errno from socket setup to an error code
+ */
+static int errno_result(int err) {
+    switch (err) {
+        case EPERM:
+        case EACCES:
+            return E_PERMISSION_DENIED;
+        case ENODEV:
+        case ENXIO:
+            return E_NOT_FOUND;
+        case EAFNOSUPPORT:
+        case EINVAL:
+        case ENOPROTOOPT:
+            return E_NOT_SUPPORTED;
+        case ENOMEM:
+            return E_OUT_OF_MEMORY;
+        default:
+            return E_NETWORK_ERROR;
+    }
+}
+
+/**
+ * interface_info - Look up index, MAC and MTU of an interface
+ *
+ * Returns: 0, or negative error code
+ */
+static int interface_info(l2_ring_t *ring, const char *ifname, int *ifindex) {
+    struct ifreq ifr;
+
+    if (strlen(ifname) >= sizeof(ifr.ifr_name)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(ring->fd, SIOCGIFINDEX, &ifr) != 0) {
+        return errno_result(errno);
+    }
+    *ifindex = ifr.ifr_ifindex;
+
+    if (ioctl(ring->fd, SIOCGIFHWADDR, &ifr) != 0) {
+        return errno_result(errno);
+    }
+    memcpy(ring->mac, ifr.ifr_hwaddr.sa_data, L2_RING_MAC_LEN);
+
+    if (ioctl(ring->fd, SIOCGIFMTU, &ifr) != 0) {
+        return errno_result(errno);
+    }
+    ring->mtu = (ifr.ifr_mtu > 0 && (uint32_t)ifr.ifr_mtu < L2_SLOT_PAYLOAD)
+                ? (uint32_t)ifr.ifr_mtu : L2_SLOT_PAYLOAD;
+    return 0;
+}
+
+/**
+ * setup_rings - Create and map the receive ring and, if possible, the
+ *               send ring
+ *
+ * Returns: 0, or negative error code
+ */
+static int setup_rings(l2_ring_t *ring) {
+    struct tpacket_req3 req;
+    int version = TPACKET_V3;
+    size_t rx_size = (size_t)L2_RING_BLOCK_SIZE * L2_RING_RX_BLOCKS;
+    size_t tx_size = (size_t)L2_RING_BLOCK_SIZE * L2_RING_TX_BLOCKS;
+
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &version,
+                   sizeof(version)) != 0) {
+        return errno_result(errno);
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = L2_RING_BLOCK_SIZE;
+    req.tp_block_nr = L2_RING_RX_BLOCKS;
+    req.tp_frame_size = L2_RING_SLOT_SIZE;
+    req.tp_frame_nr = (L2_RING_BLOCK_SIZE / L2_RING_SLOT_SIZE) *
+                      L2_RING_RX_BLOCKS;
+    req.tp_retire_blk_tov = L2_RING_RX_TIMEOUT_MS;
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_RX_RING, &req,
+                   sizeof(req)) != 0) {
+        return errno_result(errno);
+    }
+
+    /* TPACKET_V3 send rings need Linux 4.11; the retire fields must be 0 */
+    req.tp_block_nr = L2_RING_TX_BLOCKS;
+    req.tp_frame_nr = (L2_RING_BLOCK_SIZE / L2_RING_SLOT_SIZE) *
+                      L2_RING_TX_BLOCKS;
+    req.tp_retire_blk_tov = 0;
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_TX_RING, &req,
+                   sizeof(req)) != 0) {
+        tx_size = 0;
+    }
+
+    ring->map_size = rx_size + tx_size;
+    ring->map = (uint8_t *)mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, ring->fd, 0);
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        return E_OUT_OF_MEMORY;
+    }
+
+    ring->rx = ring->map;
+    if (tx_size > 0) {
+        ring->tx = ring->map + rx_size;
+        ring->tx_slots = req.tp_frame_nr;
+    }
+    return 0;
+}
+
+/**
+ * account_drops - Add the kernel's drop count since the last read
+ */
+static void account_drops(l2_ring_t *ring) {
+    struct tpacket_stats_v3 stats;
+    socklen_t len = sizeof(stats);
+
+    if (getsockopt(ring->fd, SOL_PACKET, PACKET_STATISTICS, &stats,
+                   &len) == 0 && stats.tp_drops > 0) {
+        metrics_add(METRIC_L2_RX_DROPS, stats.tp_drops);
+    }
+}
+
+/**
+ * tx_slot - Header of a send slot
+ */
+static struct tpacket3_hdr *tx_slot(const l2_ring_t *ring, unsigned index) {
+    return (struct tpacket3_hdr *)(ring->tx + (size_t)index * L2_RING_SLOT_SIZE);
+}
+
+/**
+ * tx_slot_free - Whether the kernel is done with a send slot
+ *
+ * TP_STATUS_WRONG_FORMAT (a frame the kernel refused) frees it too.
+ */
+static int tx_slot_free(const l2_ring_t *ring, unsigned index) {
+    uint32_t status = status_load(&tx_slot(ring, index)->tp_status);
+
+    return (status & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)) == 0;
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+int l2_ring_open(const char *ifname, uint16_t ethertype, l2_ring_t **ring_out) {
+    struct sockaddr_ll addr;
+    l2_ring_t *ring;
+    int ifindex = 0;
+    int one = 1;
+    int result;
+
+    if (ifname == NULL || ring_out == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    *ring_out = NULL;
+
+    ring = (l2_ring_t *)calloc(1, sizeof(l2_ring_t));
+    if (ring == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    ring->ethertype = htons(ethertype);
+
+    /* No protocol until bound: nothing is queued before the rings exist */
+    ring->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (ring->fd < 0) {
+        result = errno_result(errno);
+        free(ring);
+        return result;
+    }
+
+    result = interface_info(ring, ifname, &ifindex);
+    if (result == 0) {
+        result = setup_rings(ring);
+    }
+    if (result != 0) {
+        l2_ring_close(ring);
+        return result;
+    }
+
+    /* Optional: skip the qdisc, and never see our own frames */
+    setsockopt(ring->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+#ifdef PACKET_IGNORE_OUTGOING
+    setsockopt(ring->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));
+#endif
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = ring->ethertype;
+    addr.sll_ifindex = ifindex;
+    if (bind(ring->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        result = errno_result(errno);
+        l2_ring_close(ring);
+        return result;
+    }
+
+    *ring_out = ring;
+    return 0;
+}
+
+void l2_ring_close(l2_ring_t *ring) {
+    if (ring == NULL) {
+        return;
+    }
+    if (ring->map != NULL) {
+        munmap(ring->map, ring->map_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring);
+}
+
+int l2_ring_fd(const l2_ring_t *ring) {
+    return ring->fd;
+}
+
+const uint8_t *l2_ring_mac(const l2_ring_t *ring) {
+    return ring->mac;
+}
+
+uint32_t l2_ring_mtu(const l2_ring_t *ring) {
+    return ring->mtu;
+}
+
+int l2_ring_recv(l2_ring_t *ring, l2_ring_frame_t *frame) {
+    struct tpacket_block_desc *block;
+    struct tpacket3_hdr *hdr;
+    const struct sockaddr_ll *sll;
+    const uint8_t *eth;
+    uint32_t status;
+
+    for (;;) {
+        while (ring->rx_left > 0) {
+            hdr = (struct tpacket3_hdr *)ring->rx_frame;
+            ring->rx_frame += hdr->tp_next_offset;
+            ring->rx_left--;
+
+            sll = (const struct sockaddr_ll *)((uint8_t *)hdr +
+                  TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+            if (sll->sll_pkttype == PACKET_OUTGOING ||
+                hdr->tp_snaplen != hdr->tp_len ||
+                hdr->tp_snaplen < L2_RING_HEADER_SIZE) {
+                continue;
+            }
+
+            eth = (const uint8_t *)hdr + hdr->tp_mac;
+            frame->src = eth + L2_RING_MAC_LEN;
+            frame->data = eth + L2_RING_HEADER_SIZE;
+            frame->len = hdr->tp_snaplen - L2_RING_HEADER_SIZE;
+            return TRUE;
+        }
+
+        /* Done with the previous frame's block: give it back */
+        if (ring->rx_held) {
+            block = (struct tpacket_block_desc *)(ring->rx +
+                    (size_t)ring->rx_block * L2_RING_BLOCK_SIZE);
+            status_store(&block->hdr.bh1.block_status, TP_STATUS_KERNEL);
+            ring->rx_block = (ring->rx_block + 1) % L2_RING_RX_BLOCKS;
+            ring->rx_held = FALSE;
+        }
+
+        block = (struct tpacket_block_desc *)(ring->rx +
+                (size_t)ring->rx_block * L2_RING_BLOCK_SIZE);
+        status = status_load(&block->hdr.bh1.block_status);
+        if (!(status & TP_STATUS_USER)) {
+            return FALSE;
+        }
+        if (status & TP_STATUS_LOSING) {
+            account_drops(ring);
+        }
+
+        ring->rx_held = TRUE;
+        ring->rx_left = block->hdr.bh1.num_pkts;
+        ring->rx_frame = (uint8_t *)block + block->hdr.bh1.offset_to_first_pkt;
+    }
+}
+
+uint8_t *l2_ring_tx_begin(l2_ring_t *ring, const uint8_t *dst,
+                          uint32_t *capacity) {
+    uint8_t *eth;
+
+    if (ring->tx == NULL) {
+        eth = ring->fallback;
+    } else {
+        if (!tx_slot_free(ring, ring->tx_next)) {
+            l2_ring_flush(ring);
+            if (!tx_slot_free(ring, ring->tx_next)) {
+                metrics_add(METRIC_L2_TX_DROPS, 1);
+                return NULL;
+            }
+        }
+        eth = (uint8_t *)tx_slot(ring, ring->tx_next) + L2_TX_DATA_OFFSET;
+    }
+
+    memcpy(eth, dst, L2_RING_MAC_LEN);
+    memcpy(eth + L2_RING_MAC_LEN, ring->mac, L2_RING_MAC_LEN);
+    memcpy(eth + 2 * L2_RING_MAC_LEN, &ring->ethertype, 2);
+
+    ring->tx_current = eth;
+    *capacity = ring->mtu;
+    return eth + L2_RING_HEADER_SIZE;
+}
+
+int l2_ring_tx_commit(l2_ring_t *ring, uint32_t len) {
+    struct tpacket3_hdr *hdr;
+    uint8_t *eth = ring->tx_current;
+    ssize_t sent;
+
+    if (eth == NULL || len > ring->mtu) {
+        return E_INVALID_ARGUMENT;
+    }
+    ring->tx_current = NULL;
+
+    if (len < L2_MIN_PAYLOAD) {
+        memset(eth + L2_RING_HEADER_SIZE + len, 0, L2_MIN_PAYLOAD - len);
+        len = L2_MIN_PAYLOAD;
+    }
+
+    if (ring->tx == NULL) {
+        do {
+            sent = send(ring->fd, eth, L2_RING_HEADER_SIZE + len, MSG_DONTWAIT);
+        } while (sent < 0 && errno == EINTR);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+                metrics_add(METRIC_L2_TX_DROPS, 1);
+                return 0;
+            }
+            return E_NETWORK_ERROR;
+        }
+        return 0;
+    }
+
+    hdr = tx_slot(ring, ring->tx_next);
+    hdr->tp_len = L2_RING_HEADER_SIZE + len;
+    hdr->tp_snaplen = hdr->tp_len;
+    hdr->tp_next_offset = 0;
+    status_store(&hdr->tp_status, TP_STATUS_SEND_REQUEST);
+
+    ring->tx_next = (ring->tx_next + 1) % ring->tx_slots;
+    ring->tx_queued++;
+    return 0;
+}
+
+int l2_ring_flush(l2_ring_t *ring) {
+    ssize_t sent;
+
+    if (ring->tx == NULL || ring->tx_queued == 0) {
+        return 0;
+    }
+
+    do {
+        sent = sendto(ring->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+        errno != ENOBUFS) {
+        return E_NETWORK_ERROR;
+    }
+    /* Frames the device could not take yet stay queued in their slots */
+    ring->tx_queued = 0;
+    return 0;
+}
+
+#else /* !L2_RING_AVAILABLE */
+
+int l2_ring_open(const char *ifname, uint16_t ethertype, l2_ring_t **ring) {
+    (void)ifname;
+    (void)ethertype;
+    if (ring != NULL) {
+        *ring = NULL;
+    }
+    return E_NOT_SUPPORTED;
+}
+
+void l2_ring_close(l2_ring_t *ring) {
+    (void)ring;
+}
+
+int l2_ring_fd(const l2_ring_t *ring) {
+    (void)ring;
+    return -1;
+}
+
+const uint8_t *l2_ring_mac(const l2_ring_t *ring) {
+    (void)ring;
+    return NULL;
+}
+
+uint32_t l2_ring_mtu(const l2_ring_t *ring) {
+    (void)ring;
+    return 0;
+}
+
+int l2_ring_recv(l2_ring_t *ring, l2_ring_frame_t *frame) {
+    (void)ring;
+    (void)frame;
+    return FALSE;
+}
+
+uint8_t *l2_ring_tx_begin(l2_ring_t *ring, const uint8_t *dst,
+                          uint32_t *capacity) {
+    (void)ring;
+    (void)dst;
+    (void)capacity;
+    return NULL;
+}
+
+int l2_ring_tx_commit(l2_ring_t *ring, uint32_t len) {
+    (void)ring;
+    (void)len;
+    return E_NOT_SUPPORTED;
+}
+
+int l2_ring_flush(l2_ring_t *ring) {
+    (void)ring;
+    return 0;
+}
+
+#endif /* L2_RING_AVAILABLE */
+
+/* ========================================================================
+ * MAC Addresses
+ * ======================================================================== */
+
+int l2_ring_parse_mac(const char *text, uint8_t *mac) {
+    unsigned value;
+    int digit;
+    int i;
+    int j;
+
+    if (text == NULL || mac == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (i = 0; i < L2_RING_MAC_LEN; i++) {
+        value = 0;
+        for (j = 0; j < 2; j++) {
+            digit = *text++;
+            if (digit >= '0' && digit <= '9') {
+                value = value * 16 + (unsigned)(digit - '0');
+            } else if (digit >= 'a' && digit <= 'f') {
+                value = value * 16 + (unsigned)(digit - 'a' + 10);
+            } else if (digit >= 'A' && digit <= 'F') {
+                value = value * 16 + (unsigned)(digit - 'A' + 10);
+            } else {
+                return E_INVALID_ARGUMENT;
+            }
+        }
+        mac[i] = (uint8_t)value;
+
+        if (i < L2_RING_MAC_LEN - 1) {
+            if (*text != ':' && *text != '-') {
+                return E_INVALID_ARGUMENT;
+            }
+            text++;
+        }
+    }
+
+    return (*text == '\0') ? 0 : E_INVALID_ARGUMENT;
+}
+
+char *l2_ring_format_mac(const uint8_t *mac, char *buf) {
+    snprintf(buf, L2_RING_MAC_STRLEN, "%02x:%02x:%02x:%02x:%02x:%02x",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return buf;
+}
@@ -0,0 +1,171 @@
+/**
+ * l2_ring.h
+ *
+ * Raw Ethernet frames of one EtherType through AF_PACKET rings (Linux).
+ *
+ * A layer-2 link skips the IP and transport stacks entirely: frames go
+ * from a memory-mapped ring to the driver and back. Both directions use
+ * TPACKET_V3 rings shared with the kernel:
+ *
+ *   receive  The kernel packs frames into blocks of L2_RING_BLOCK_SIZE
+ *            and hands a block over when it is full or has been open for
+ *            L2_RING_RX_TIMEOUT_MS. Readers walk the block in place and
+ *            give it back once done, so a busy link costs one wakeup per
+ *            block rather than one system call per frame. On a quiet link
+ *            a frame waits at most the retire timeout (the kernel's timer
+ *            granularity is one millisecond).
+ *   send     Frames are written into ring slots (l2_ring_tx_begin() /
+ *            l2_ring_tx_commit()) and one l2_ring_flush() hands every
+ *            queued slot to the driver with a single sendto(). Kernels
+ *            without a TPACKET_V3 send ring (before 4.11) fall back to one
+ *            sendto() per frame.
+ *
+ * Send rings bypass the qdisc layer where the kernel allows it
+ * (PACKET_QDISC_BYPASS). Frames leaving the interface are not received
+ * back, but on the loopback device every frame sent, ours included,
+ * arrives again as received: protocols on top tell directions apart.
+ *
+ * Frames carry no length of their own beyond the Ethernet one, and
+ * Ethernet pads anything shorter than 60 bytes: protocols on top must
+ * carry their own length.
+ *
+ * Opening a ring needs CAP_NET_RAW. Elsewhere than Linux l2_ring_open()
+ * fails with E_NOT_SUPPORTED. A ring is not thread-safe.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef L2_RING_H
+#define L2_RING_H
+
+#include "lib/common/types.h"
+
+/* MAC address and Ethernet header length */
+#define L2_RING_MAC_LEN 6
+#define L2_RING_HEADER_SIZE 14
+
+/* Ring geometry: a slot holds one full-size frame plus ring headers */
+#define L2_RING_BLOCK_SIZE (64 * 1024)
+#define L2_RING_SLOT_SIZE 2048
+#define L2_RING_RX_BLOCKS 64            /* 4 MiB receive ring */
+#define L2_RING_TX_BLOCKS 8             /* 256 send slots */
+
+/* Longest a partly filled receive block stays with the kernel (ms) */
+#define L2_RING_RX_TIMEOUT_MS 1
+
+/* Interface name buffer (IFNAMSIZ) */
+#define L2_RING_IFNAME_MAX 16
+
+/* Buffer for l2_ring_format_mac(): "aa:bb:cc:dd:ee:ff" */
+#define L2_RING_MAC_STRLEN 18
+
+/* Opaque ring handle */
+typedef struct l2_ring l2_ring_t;
+
+/**
+ * Received frame, valid until the next l2_ring_recv()
+ */
+typedef struct {
+    const uint8_t *src;     /* Sender MAC */
+    const uint8_t *data;    /* Payload after the Ethernet header */
+    uint32_t len;           /* Payload length (may include padding) */
+} l2_ring_frame_t;
+
+/**
+ * l2_ring_open - Open rings for one EtherType on an interface
+ * @ifname:    Interface name (e.g. "eth0")
+ * @ethertype: EtherType to send and receive (host order)
+ * @ring:      Receives the ring
+ *
+ * Returns: 0 on success, E_NOT_FOUND for an unknown interface,
+ *          E_PERMISSION_DENIED without CAP_NET_RAW, E_NOT_SUPPORTED if
+ *          the kernel has no TPACKET_V3, E_OUT_OF_MEMORY, E_NETWORK_ERROR
+ */
+int l2_ring_open(const char *ifname, uint16_t ethertype, l2_ring_t **ring);
+
+/**
+ * l2_ring_close - Unmap the rings and close the socket
+ * @ring: Ring (NULL is ignored)
+ *
+ * Frames queued and not flushed are dropped.
+ */
+void l2_ring_close(l2_ring_t *ring);
+
+/**
+ * l2_ring_fd - Descriptor to poll for POLLIN (a receive block is ready)
+ */
+int l2_ring_fd(const l2_ring_t *ring);
+
+/**
+ * l2_ring_mac - MAC address of the interface
+ */
+const uint8_t *l2_ring_mac(const l2_ring_t *ring);
+
+/**
+ * l2_ring_mtu - Largest payload a frame on the interface carries
+ */
+uint32_t l2_ring_mtu(const l2_ring_t *ring);
+
+/**
+ * l2_ring_recv - Next received frame
+ * @ring:  Ring
+ * @frame: Receives the frame
+ *
+ * Returns the block of the previous frame to the kernel once it is
+ * exhausted. Kernel drops (ring full) are added to METRIC_L2_RX_DROPS.
+ *
+ * Returns: TRUE if @frame is set, FALSE if nothing is ready
+ */
+int l2_ring_recv(l2_ring_t *ring, l2_ring_frame_t *frame);
+
+/**
+ * l2_ring_tx_begin - Start a frame in the next free send slot
+ * @ring:     Ring
+ * @dst:      Destination MAC
+ * @capacity: Receives the payload space (the interface MTU at most)
+ *
+ * Flushes once if every slot is queued.
+ *
+ * Returns: Payload area to write, or NULL if the ring is still full
+ */
+uint8_t *l2_ring_tx_begin(l2_ring_t *ring, const uint8_t *dst,
+                          uint32_t *capacity);
+
+/**
+ * l2_ring_tx_commit - Queue the frame started with l2_ring_tx_begin()
+ * @ring: Ring
+ * @len:  Payload length written (padded to the Ethernet minimum)
+ *
+ * Returns: 0, or E_NETWORK_ERROR if the fallback sendto() failed for a
+ *          reason other than a full queue
+ */
+int l2_ring_tx_commit(l2_ring_t *ring, uint32_t len);
+
+/**
+ * l2_ring_flush - Hand every queued frame to the driver
+ * @ring: Ring
+ *
+ * Returns: 0 (also when the device queue is full: the frames are sent
+ *          on a later flush), or E_NETWORK_ERROR
+ */
+int l2_ring_flush(l2_ring_t *ring);
+
+/**
+ * l2_ring_parse_mac - Parse "aa:bb:cc:dd:ee:ff" (or '-' separated)
+ * @text: Text
+ * @mac:  Receives L2_RING_MAC_LEN bytes
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT
+ */
+int l2_ring_parse_mac(const char *text, uint8_t *mac);
+
+/**
+ * l2_ring_format_mac - Format a MAC address as "aa:bb:cc:dd:ee:ff"
+ * @mac: L2_RING_MAC_LEN bytes
+ * @buf: At least L2_RING_MAC_STRLEN bytes
+ *
+ * Returns: @buf
+ */
+char *l2_ring_format_mac(const uint8_t *mac, char *buf);
+
+#endif /* L2_RING_H */
@@ -2,18 +2,27 @@
  * net_resolve.c
  *
  * Implementation of hostname resolution utilities.
- * Uses POSIX getaddrinfo() for thread-safe resolution.
+ * Uses POSIX getaddrinfo() for thread-safe resolution, a small
+ * lock-protected cache of its results, and staggered parallel connects
+ * across the resolved addresses.
  *
  * [LLM-ARCH]
  */
 
 #include "net_resolve.h"
 #include "lib/common/definitions.h"
+#include "lib/common/fd_util.h"
+#include "lib/common/latency.h"
+#include "shm_link.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -103,62 +112,208 @@ int net_resolve_to_sockaddr(const char *host, int port,
     return 0;
 }
 
-int net_resolve_connect(const char *host, int port, int *sock_out,
-                        net_resolve_result_t *result) {
-    struct addrinfo hints;
-    struct addrinfo *res = NULL;
-    struct addrinfo *rp = NULL;
-    int gai_ret;
-    int sock = -1;
-    int last_errno = 0;
-    struct sockaddr_in numeric_addr;
+/* ============================================================================
+ * Resolver Cache
+ * ============================================================================ */
 
-    init_result(result);
+typedef struct {
+    char host[NET_RESOLVE_HOST_MAX];
+    net_resolve_addr_t addrs[NET_RESOLVE_MAX_ADDRS];  /* Port 0 */
+    int count;                  /* 0: slot unused */
+    uint64_t expires_ms;
+} resolve_cache_entry_t;
 
-    /* Validate parameters */
-    if (host == NULL || sock_out == NULL) {
-        set_result(result, E_INVALID_ARGUMENT, 0, 0);
-        return E_INVALID_ARGUMENT;
+static resolve_cache_entry_t g_resolve_cache[NET_RESOLVE_CACHE_SIZE];
+static pthread_mutex_t g_resolve_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * cache_find - Find a hostname's entry (caller holds the cache lock)
+ *
+ * Returns: Entry, or NULL if the hostname is not cached
+ */
+static resolve_cache_entry_t *cache_find(const char *host) {
+    int i;
+
+    for (i = 0; i < NET_RESOLVE_CACHE_SIZE; i++) {
+        if (g_resolve_cache[i].count > 0 &&
+            strcmp(g_resolve_cache[i].host, host) == 0) {
+            return &g_resolve_cache[i];
+        }
     }
+    return NULL;
+}
 
-    if (port <= 0 || port > 65535) {
-        set_result(result, E_INVALID_ARGUMENT, 0, 0);
-        return E_INVALID_ARGUMENT;
+/**
+ * cache_lookup - Copy a hostname's fresh cached addresses
+ * @host:  Hostname
+ * @addrs: Output: NET_RESOLVE_MAX_ADDRS addresses
+ *
+ * Returns: Number of addresses, 0 if not cached or expired
+ */
+static int cache_lookup(const char *host, net_resolve_addr_t *addrs) {
+    resolve_cache_entry_t *entry;
+    int count = 0;
+
+    pthread_mutex_lock(&g_resolve_cache_lock);
+    entry = cache_find(host);
+    if (entry != NULL) {
+        if (entry->expires_ms > latency_now_ms()) {
+            count = entry->count;
+            memcpy(addrs, entry->addrs, sizeof(addrs[0]) * (size_t)count);
+        } else {
+            entry->count = 0;
+        }
     }
+    pthread_mutex_unlock(&g_resolve_cache_lock);
 
-    *sock_out = -1;
+    return count;
+}
 
-    /* Fast path: try numeric address first */
-    memset(&numeric_addr, 0, sizeof(numeric_addr));
-    numeric_addr.sin_family = AF_INET;
-    numeric_addr.sin_port = htons((unsigned short)port);
+/**
+ * cache_store - Remember a hostname's addresses
+ *
+ * Replaces the hostname's entry, else a free or expired slot, else the
+ * entry closest to expiry.
+ */
+static void cache_store(const char *host, const net_resolve_addr_t *addrs,
+                        int count) {
+    resolve_cache_entry_t *entry;
+    uint64_t now = latency_now_ms();
+    int i;
 
-    if (inet_pton(AF_INET, host, &numeric_addr.sin_addr) == 1) {
-        /* It's a numeric IP, try direct connect */
-        sock = socket(AF_INET, SOCK_STREAM, 0);
-        if (sock < 0) {
-            set_result(result, E_NETWORK_ERROR, 0, errno);
-            return E_NETWORK_ERROR;
+    if (strlen(host) >= NET_RESOLVE_HOST_MAX) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_resolve_cache_lock);
+    entry = cache_find(host);
+    for (i = 0; entry == NULL && i < NET_RESOLVE_CACHE_SIZE; i++) {
+        if (g_resolve_cache[i].count == 0 ||
+            g_resolve_cache[i].expires_ms <= now) {
+            entry = &g_resolve_cache[i];
+        }
+    }
+    if (entry == NULL) {
+        entry = &g_resolve_cache[0];
+        for (i = 1; i < NET_RESOLVE_CACHE_SIZE; i++) {
+            if (g_resolve_cache[i].expires_ms < entry->expires_ms) {
+                entry = &g_resolve_cache[i];
+            }
         }
+    }
+
+    strcpy(entry->host, host);
+    memcpy(entry->addrs, addrs, sizeof(addrs[0]) * (size_t)count);
+    entry->count = count;
+    entry->expires_ms = now + NET_RESOLVE_CACHE_TTL_MS;
+    pthread_mutex_unlock(&g_resolve_cache_lock);
+}
 
-        if (connect(sock, (struct sockaddr *)&numeric_addr,
-                    sizeof(numeric_addr)) == 0) {
-            *sock_out = sock;
-            return 0;
+/**
+ * cache_update - Record the outcome of connecting to cached addresses
+ * @host:   Hostname
+ * @winner: Index of the address that answered, or -1 if none did
+ *
+ * The address that answered moves to the front; an entry none of whose
+ * addresses answered is dropped.
+ */
+static void cache_update(const char *host, int winner) {
+    resolve_cache_entry_t *entry;
+    net_resolve_addr_t first;
+
+    pthread_mutex_lock(&g_resolve_cache_lock);
+    entry = cache_find(host);
+    if (entry != NULL) {
+        if (winner < 0) {
+            entry->count = 0;
+        } else if (winner > 0 && winner < entry->count) {
+            first = entry->addrs[winner];
+            memmove(&entry->addrs[1], &entry->addrs[0],
+                    sizeof(first) * (size_t)winner);
+            entry->addrs[0] = first;
         }
+    }
+    pthread_mutex_unlock(&g_resolve_cache_lock);
+}
 
-        /* Connect failed */
-        last_errno = errno;
-        close(sock);
-        set_result(result, E_NETWORK_ERROR, 0, last_errno);
-        return E_NETWORK_ERROR;
+void net_resolve_cache_flush(void) {
+    int i;
+
+    pthread_mutex_lock(&g_resolve_cache_lock);
+    for (i = 0; i < NET_RESOLVE_CACHE_SIZE; i++) {
+        g_resolve_cache[i].count = 0;
     }
+    pthread_mutex_unlock(&g_resolve_cache_lock);
+}
+
+/* ============================================================================
+ * Resolution and Connection
+ * ============================================================================ */
+
+/**
+ * set_port - Set the port of an IPv4 or IPv6 address
+ */
+static void set_port(net_resolve_addr_t *addr, int port) {
+    if (addr->addr.ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)&addr->addr)->sin6_port =
+            htons((unsigned short)port);
+    } else {
+        ((struct sockaddr_in *)&addr->addr)->sin_port =
+            htons((unsigned short)port);
+    }
+}
+
+/**
+ * resolve_numeric - Parse a literal IPv4 or IPv6 address
+ *
+ * Returns: 1 if @host was a literal (stored in @addr), 0 otherwise
+ */
+static int resolve_numeric(const char *host, net_resolve_addr_t *addr) {
+    struct sockaddr_in *in4 = (struct sockaddr_in *)&addr->addr;
+    struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&addr->addr;
+
+    memset(addr, 0, sizeof(*addr));
+    if (inet_pton(AF_INET, host, &in4->sin_addr) == 1) {
+        in4->sin_family = AF_INET;
+        addr->len = sizeof(*in4);
+        return 1;
+    }
+    if (inet_pton(AF_INET6, host, &in6->sin6_addr) == 1) {
+        in6->sin6_family = AF_INET6;
+        addr->len = sizeof(*in6);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * resolve_host - Query the resolver for a hostname's addresses
+ * @host:   Hostname
+ * @addrs:  Output: NET_RESOLVE_MAX_ADDRS addresses (port 0)
+ * @result: Output: error details (may be NULL)
+ *
+ * Families alternate, starting with the one the resolver preferred
+ * (RFC 8305 section 4), so a broken family costs one stagger at most.
+ *
+ * Returns: Number of addresses, or E_DNS_ERROR
+ */
+static int resolve_host(const char *host, net_resolve_addr_t *addrs,
+                        net_resolve_result_t *result) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    struct addrinfo *rp;
+    net_resolve_addr_t by_family[2][NET_RESOLVE_MAX_ADDRS];
+    int found[2] = {0, 0};
+    int taken[2] = {0, 0};
+    int first = -1;
+    int family;
+    int count = 0;
+    int gai_ret;
 
-    /* Slow path: DNS resolution via getaddrinfo */
     memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_INET;       /* IPv4 only */
+    hints.ai_family = AF_UNSPEC;     /* IPv6 and IPv4 */
     hints.ai_socktype = SOCK_STREAM; /* TCP */
-    hints.ai_flags = 0;
+    hints.ai_flags = AI_ADDRCONFIG;
 
     gai_ret = getaddrinfo(host, NULL, &hints, &res);
     if (gai_ret != 0) {
@@ -166,41 +321,306 @@ int net_resolve_connect(const char *host, int port, int *sock_out,
         return E_DNS_ERROR;
     }
 
-    if (res == NULL) {
+    for (rp = res; rp != NULL; rp = rp->ai_next) {
+        if (rp->ai_family != AF_INET && rp->ai_family != AF_INET6) {
+            continue;
+        }
+        if (rp->ai_addrlen > sizeof(struct sockaddr_storage)) {
+            continue;
+        }
+        family = (rp->ai_family == AF_INET6) ? 1 : 0;
+        if (first < 0) {
+            first = family;
+        }
+        if (found[family] < NET_RESOLVE_MAX_ADDRS) {
+            net_resolve_addr_t *addr = &by_family[family][found[family]++];
+
+            memset(addr, 0, sizeof(*addr));
+            memcpy(&addr->addr, rp->ai_addr, rp->ai_addrlen);
+            addr->len = (socklen_t)rp->ai_addrlen;
+        }
+    }
+    freeaddrinfo(res);
+
+    if (first < 0) {
         set_result(result, E_DNS_ERROR, 0, 0);
         return E_DNS_ERROR;
     }
 
-    /* Try each address in order until one succeeds */
-    for (rp = res; rp != NULL; rp = rp->ai_next) {
-        struct sockaddr_in *addr_in = (struct sockaddr_in *)rp->ai_addr;
+    family = first;
+    while (count < NET_RESOLVE_MAX_ADDRS &&
+           (taken[0] < found[0] || taken[1] < found[1])) {
+        if (taken[family] < found[family]) {
+            addrs[count++] = by_family[family][taken[family]++];
+        }
+        family = 1 - family;
+    }
 
-        /* Set the port (getaddrinfo doesn't set it when service is NULL) */
-        addr_in->sin_port = htons((unsigned short)port);
+    return count;
+}
 
-        sock = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
-        if (sock < 0) {
-            last_errno = errno;
+/**
+ * attempt_start - Start a non-blocking connect to one address
+ * @connected: Output: TRUE if the connect completed at once
+ * @err:       Output: errno if the attempt failed
+ *
+ * Returns: Socket, or -1 if the attempt failed already
+ */
+static int attempt_start(const net_resolve_addr_t *addr,
+                         const sock_tune_t *tune, int *connected, int *err) {
+    int sock;
+
+    *connected = FALSE;
+    sock = socket(addr->addr.ss_family, SOCK_STREAM, 0);
+    if (sock < 0) {
+        *err = errno;
+        return -1;
+    }
+
+    /* Best effort: a refused option never fails the connect */
+    (void)sock_tune_apply(sock, tune);
+
+    if (fd_set_nonblocking(sock) != 0) {
+        *err = errno;
+        close(sock);
+        return -1;
+    }
+
+    if (connect(sock, (const struct sockaddr *)&addr->addr, addr->len) == 0) {
+        *connected = TRUE;
+        return sock;
+    }
+    if (errno == EINPROGRESS) {
+        return sock;
+    }
+
+    *err = errno;
+    close(sock);
+    return -1;
+}
+
+/**
+ * connect_addrs - net_resolve_connect_addrs() with a time limit
+ * @timeout_ms: Give up after this long (0 = no limit)
+ *
+ * Returns: As net_resolve_connect_addrs(), or E_TIMEOUT
+ */
+static int connect_addrs(const net_resolve_addr_t *addrs, int count,
+                         const sock_tune_t *tune, int timeout_ms,
+                         int *sock_out, int *winner_out,
+                         net_resolve_result_t *result) {
+    struct pollfd pfds[NET_RESOLVE_MAX_ADDRS];
+    int index[NET_RESOLVE_MAX_ADDRS];
+    int inflight = 0;
+    int next = 0;
+    int winner = -1;
+    int sock = -1;
+    int last_errno = 0;
+    int timed_out = FALSE;
+    uint64_t next_at = 0;
+    uint64_t deadline = 0;
+    int i;
+
+    init_result(result);
+
+    if (addrs == NULL || sock_out == NULL || count < 1) {
+        set_result(result, E_INVALID_ARGUMENT, 0, 0);
+        return E_INVALID_ARGUMENT;
+    }
+    if (count > NET_RESOLVE_MAX_ADDRS) {
+        count = NET_RESOLVE_MAX_ADDRS;
+    }
+    *sock_out = -1;
+    if (timeout_ms > 0) {
+        deadline = latency_now_ms() + (uint64_t)timeout_ms;
+    }
+
+    while (winner < 0) {
+        uint64_t now = latency_now_ms();
+        int timeout = -1;
+        int ready;
+
+        if (deadline != 0 && now >= deadline) {
+            timed_out = TRUE;
+            break;
+        }
+
+        /* Next attempt: nothing in flight, or the stagger elapsed */
+        if (next < count && (inflight == 0 || now >= next_at)) {
+            int connected;
+            int err = 0;
+            int fd = attempt_start(&addrs[next], tune, &connected, &err);
+
+            if (fd >= 0 && connected) {
+                sock = fd;
+                winner = next;
+                break;
+            }
+            if (fd >= 0) {
+                pfds[inflight].fd = fd;
+                pfds[inflight].events = POLLOUT;
+                pfds[inflight].revents = 0;
+                index[inflight] = next;
+                inflight++;
+            } else {
+                last_errno = err;
+            }
+            next++;
+            next_at = now + NET_RESOLVE_ATTEMPT_DELAY_MS;
             continue;
         }
 
-        if (connect(sock, rp->ai_addr, rp->ai_addrlen) == 0) {
-            /* Success */
-            *sock_out = sock;
-            freeaddrinfo(res);
-            return 0;
+        if (inflight == 0) {
+            break;  /* Every address failed */
         }
 
-        /* Connect failed, try next address */
-        last_errno = errno;
-        close(sock);
-        sock = -1;
+        if (next < count) {
+            timeout = (int)(next_at - now);
+        }
+        if (deadline != 0 && (timeout < 0 || now + (uint64_t)timeout > deadline)) {
+            timeout = (int)(deadline - now);
+        }
+        ready = poll(pfds, (nfds_t)inflight, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            last_errno = errno;
+            break;
+        }
+
+        for (i = inflight - 1; i >= 0 && winner < 0; i--) {
+            int so_error = 0;
+            socklen_t len = sizeof(so_error);
+
+            if (pfds[i].revents == 0) {
+                continue;
+            }
+            if (getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR,
+                           &so_error, &len) < 0) {
+                so_error = errno;
+            }
+            if (so_error == 0) {
+                sock = pfds[i].fd;
+                winner = index[i];
+            } else {
+                /* Failed: the next address need not wait for the stagger */
+                last_errno = so_error;
+                close(pfds[i].fd);
+                next_at = now;
+            }
+            inflight--;
+            pfds[i] = pfds[inflight];
+            index[i] = index[inflight];
+        }
     }
 
-    /* All addresses failed */
-    freeaddrinfo(res);
-    set_result(result, E_NETWORK_ERROR, 0, last_errno);
-    return E_NETWORK_ERROR;
+    /* Losing attempts still in flight */
+    for (i = 0; i < inflight; i++) {
+        close(pfds[i].fd);
+    }
+
+    if (winner < 0 && timed_out) {
+        set_result(result, E_TIMEOUT, 0, ETIMEDOUT);
+        return E_TIMEOUT;
+    }
+    if (winner < 0) {
+        set_result(result, E_NETWORK_ERROR, 0, last_errno);
+        return E_NETWORK_ERROR;
+    }
+
+    /* Callers expect a blocking socket */
+    i = fcntl(sock, F_GETFL, 0);
+    if (i >= 0) {
+        (void)fcntl(sock, F_SETFL, i & ~O_NONBLOCK);
+    }
+
+    *sock_out = sock;
+    if (winner_out != NULL) {
+        *winner_out = winner;
+    }
+    return 0;
+}
+
+int net_resolve_connect_addrs(const net_resolve_addr_t *addrs, int count,
+                              const sock_tune_t *tune, int *sock_out,
+                              int *winner_out, net_resolve_result_t *result) {
+    return connect_addrs(addrs, count, tune, 0, sock_out, winner_out, result);
+}
+
+int net_resolve_connect(const char *host, int port, int *sock_out,
+                        net_resolve_result_t *result) {
+    return net_resolve_connect_tuned(host, port, NULL, sock_out, result);
+}
+
+int net_resolve_connect_tuned(const char *host, int port,
+                              const sock_tune_t *tune, int *sock_out,
+                              net_resolve_result_t *result) {
+    return net_resolve_connect_timed(host, port, tune, 0, sock_out, result);
+}
+
+int net_resolve_connect_timed(const char *host, int port,
+                              const sock_tune_t *tune, int timeout_ms,
+                              int *sock_out, net_resolve_result_t *result) {
+    net_resolve_addr_t addrs[NET_RESOLVE_MAX_ADDRS];
+    const char *shm_path;
+    int count;
+    int cached = FALSE;
+    int winner = -1;
+    int ret;
+    int i;
+
+    init_result(result);
+
+    /* Validate parameters */
+    if (host == NULL || sock_out == NULL) {
+        set_result(result, E_INVALID_ARGUMENT, 0, 0);
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Same-host link: no port, nothing to resolve or tune */
+    shm_path = shm_link_address(host);
+    if (shm_path != NULL) {
+        ret = shm_link_connect(shm_path, sock_out);
+        set_result(result, ret, 0, (ret == E_NETWORK_ERROR) ? errno : 0);
+        return ret;
+    }
+
+    if (port <= 0 || port > 65535) {
+        set_result(result, E_INVALID_ARGUMENT, 0, 0);
+        return E_INVALID_ARGUMENT;
+    }
+
+    *sock_out = -1;
+
+    /* Fast path: a literal address needs neither resolver nor cache */
+    if (resolve_numeric(host, &addrs[0])) {
+        count = 1;
+    } else {
+        count = cache_lookup(host, addrs);
+        if (count > 0) {
+            cached = TRUE;
+        } else {
+            count = resolve_host(host, addrs, result);
+            if (count < 0) {
+                return count;
+            }
+            cache_store(host, addrs, count);
+            cached = TRUE;
+        }
+    }
+
+    /* Cached addresses carry no port */
+    for (i = 0; i < count; i++) {
+        set_port(&addrs[i], port);
+    }
+
+    ret = connect_addrs(addrs, count, tune, timeout_ms, sock_out, &winner,
+                        result);
+    if (cached) {
+        cache_update(host, (ret == 0) ? winner : -1);
+    }
+    return ret;
 }
 
 void net_resolve_format_error(const net_resolve_result_t *result,
@@ -241,5 +661,10 @@ void net_resolve_format_error(const net_resolve_result_t *result,
         return;
     }
 
+    if (result->error_code == E_TIMEOUT) {
+        snprintf(buf, buflen, "Connection timed out");
+        return;
+    }
+
     snprintf(buf, buflen, "Unknown error (%d)", result->error_code);
 }
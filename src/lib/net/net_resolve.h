@@ -4,6 +4,20 @@
  * Network address resolution utilities for XOE.
  * Provides thread-safe hostname-to-address resolution with failover support.
  *
+ * Client modes reconnect through net_resolve_connect_tuned(), so two
+ * things make a reconnect to a hostname fast and predictable:
+ *
+ * - Resolved addresses are cached per hostname for
+ *   NET_RESOLVE_CACHE_TTL_MS. getaddrinfo() does not report record TTLs,
+ *   so the cache uses this short fixed lifetime and drops an entry as
+ *   soon as none of its addresses accepts a connection, letting a server
+ *   that moved be found again on the next attempt.
+ * - IPv6 and IPv4 results are interleaved and connected in parallel,
+ *   staggered by NET_RESOLVE_ATTEMPT_DELAY_MS (RFC 8305 "Happy
+ *   Eyeballs"): a black-holed address delays the connect by the stagger,
+ *   not by a TCP timeout. The address that answered moves to the front
+ *   of the cached list, so the next reconnect tries it first.
+ *
  * [LLM-ARCH]
  */
 
@@ -11,8 +25,30 @@
 #define NET_RESOLVE_H
 
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <stddef.h>
 
+#include "lib/net/sock_tune.h"
+
+/* Addresses kept per hostname, and hostnames kept */
+#define NET_RESOLVE_MAX_ADDRS 8
+#define NET_RESOLVE_CACHE_SIZE 16
+/* Longest hostname cached (DNS names are at most 253 characters) */
+#define NET_RESOLVE_HOST_MAX 256
+/* How long a resolution is reused */
+#define NET_RESOLVE_CACHE_TTL_MS 30000
+/* Delay before the next address is tried while one is still connecting
+ * (RFC 8305 recommends 250 ms) */
+#define NET_RESOLVE_ATTEMPT_DELAY_MS 250
+
+/**
+ * One resolved address, port included
+ */
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t len;
+} net_resolve_addr_t;
+
 /**
  * Thread-safe result structure for resolution operations.
  * Contains both success data and error details.
@@ -31,11 +67,13 @@ typedef struct {
  * @sock_out: Output: connected socket fd on success, -1 on failure
  * @result:   Output: detailed error information (may be NULL)
  *
- * Resolves the given hostname or IP address and attempts to connect.
- * When DNS returns multiple A records, tries each address in order
- * until one succeeds or all fail.
+ * Resolves the given hostname or IP address (IPv4 or IPv6) and connects
+ * to whichever resolved address answers first, trying them as described
+ * in net_resolve_connect_addrs(). Hostname results come from the
+ * resolver cache while fresh.
  *
- * Thread-safe: all state is returned via parameters, no globals used.
+ * Thread-safe: the cache is shared under a lock; everything else is
+ * returned via parameters. The returned socket is blocking.
  *
  * Returns: 0 on success, negative error code on failure
  *          E_INVALID_ARGUMENT - NULL host or sock_out, invalid port
@@ -45,6 +83,78 @@ typedef struct {
 int net_resolve_connect(const char *host, int port, int *sock_out,
                         net_resolve_result_t *result);
 
+/**
+ * net_resolve_connect_tuned - net_resolve_connect() with socket options
+ * @host:     Hostname or dotted-decimal IP address
+ * @port:     Port number (host byte order, 1-65535)
+ * @tune:     Options set on each socket before connect() (NULL = none)
+ * @sock_out: Output: connected socket fd on success, -1 on failure
+ * @result:   Output: detailed error information (may be NULL)
+ *
+ * Options are applied before connect() so buffer sizes take part in the
+ * window scale negotiation. A refused option does not fail the connect.
+ *
+ * A @host of "shm:<path>" or "unix:<path>" opens a shared-memory link
+ * (shm_link.h) instead; @port and @tune are ignored. Descriptors from
+ * here must be closed with shm_link_close().
+ *
+ * Returns: As net_resolve_connect(), or E_NOT_SUPPORTED (link elsewhere
+ *          than Linux)
+ */
+int net_resolve_connect_tuned(const char *host, int port,
+                              const sock_tune_t *tune, int *sock_out,
+                              net_resolve_result_t *result);
+
+/**
+ * net_resolve_connect_timed - net_resolve_connect_tuned() with a time limit
+ * @host:       Hostname or dotted-decimal IP address
+ * @port:       Port number (host byte order, 1-65535)
+ * @tune:       Options set on each socket before connect() (NULL = none)
+ * @timeout_ms: Give up after this long (0 = no limit); resolving the
+ *              name is not counted
+ * @sock_out:   Output: connected socket fd on success, -1 on failure
+ * @result:     Output: detailed error information (may be NULL)
+ *
+ * A black-holed address otherwise holds the connect until the kernel's
+ * SYN retries run out, which takes minutes.
+ *
+ * Returns: As net_resolve_connect_tuned(), or E_TIMEOUT
+ */
+int net_resolve_connect_timed(const char *host, int port,
+                              const sock_tune_t *tune, int timeout_ms,
+                              int *sock_out, net_resolve_result_t *result);
+
+/**
+ * net_resolve_connect_addrs - Connect to the first of several addresses
+ * @addrs:      Addresses in preference order, ports set
+ * @count:      Number of addresses (at least 1)
+ * @tune:       Options set on each socket before connect() (NULL = none)
+ * @sock_out:   Output: connected (blocking) socket fd, -1 on failure
+ * @winner_out: Output: index of the address connected to (may be NULL)
+ * @result:     Output: detailed error information (may be NULL)
+ *
+ * Starts a non-blocking connect to the first address and, every
+ * NET_RESOLVE_ATTEMPT_DELAY_MS while no attempt has finished, to the
+ * next; a refused or unreachable address starts the next one at once.
+ * The first attempt to complete wins and the others are closed, so the
+ * call takes as long as the fastest reachable address plus the stagger
+ * of the addresses before it.
+ *
+ * Returns: 0 on success
+ *          E_INVALID_ARGUMENT - NULL addrs or sock_out, count < 1
+ *          E_NETWORK_ERROR - every address failed (sys_errno of the last)
+ */
+int net_resolve_connect_addrs(const net_resolve_addr_t *addrs, int count,
+                              const sock_tune_t *tune, int *sock_out,
+                              int *winner_out, net_resolve_result_t *result);
+
+/**
+ * net_resolve_cache_flush - Forget every cached resolution
+ *
+ * The next connect to each hostname queries the resolver again.
+ */
+void net_resolve_cache_flush(void);
+
 /**
  * net_resolve_to_sockaddr - Resolve hostname/IP to sockaddr_in
  * @host:   Hostname or dotted-decimal IP address
@@ -0,0 +1,402 @@
+/**
+ * rate_limit.c
+ *
+ * Sharded token bucket table. An address hashes to one shard (its lock)
+ * and one chain within it; entries are preallocated per shard and reused
+ * from the tail of the shard's LRU list once all have been handed out.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "rate_limit.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#define RATE_LIMIT_SHARD_MASK  (RATE_LIMIT_SHARDS - 1)
+#define RATE_LIMIT_BUCKET_MASK (RATE_LIMIT_SHARD_BUCKETS - 1)
+#define RATE_LIMIT_NONE        ((int16_t)-1)
+
+/* IPv4-mapped IPv6 prefix (::ffff:0:0/96) */
+static const uint8_t v4_mapped_prefix[12] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff
+};
+
+/**
+ * key_hash - Seeded FNV-1a over the address with a final avalanche
+ *
+ * The per-limiter seed keeps a remote peer from choosing addresses that
+ * all land in one chain.
+ */
+static uint32_t key_hash(const rate_limiter_t *limiter,
+                         const rate_limit_key_t *key) {
+    uint32_t hash = 2166136261u ^ limiter->seed;
+    int i;
+
+    for (i = 0; i < (int)sizeof(key->addr); i++) {
+        hash ^= key->addr[i];
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * shard_for - Shard owning a hash (high bits; the low bits pick the chain)
+ */
+static rate_limit_shard_t* shard_for(rate_limiter_t *limiter, uint32_t hash) {
+    return &limiter->shards[(hash >> 24) & RATE_LIMIT_SHARD_MASK];
+}
+
+/**
+ * lru_unlink - Remove an entry from its shard's LRU list (lock held)
+ */
+static void lru_unlink(rate_limit_shard_t *shard, int16_t index) {
+    rate_limit_entry_t *entry = &shard->entries[index];
+
+    if (entry->lru_prev != RATE_LIMIT_NONE) {
+        shard->entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        shard->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next != RATE_LIMIT_NONE) {
+        shard->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        shard->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = RATE_LIMIT_NONE;
+    entry->lru_next = RATE_LIMIT_NONE;
+}
+
+/**
+ * lru_push_head - Make an entry the most recently used (lock held)
+ */
+static void lru_push_head(rate_limit_shard_t *shard, int16_t index) {
+    rate_limit_entry_t *entry = &shard->entries[index];
+
+    entry->lru_prev = RATE_LIMIT_NONE;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head != RATE_LIMIT_NONE) {
+        shard->entries[shard->lru_head].lru_prev = index;
+    }
+    shard->lru_head = index;
+    if (shard->lru_tail == RATE_LIMIT_NONE) {
+        shard->lru_tail = index;
+    }
+}
+
+/**
+ * lru_push_tail - Make an entry the next to be evicted (lock held)
+ */
+static void lru_push_tail(rate_limit_shard_t *shard, int16_t index) {
+    rate_limit_entry_t *entry = &shard->entries[index];
+
+    entry->lru_next = RATE_LIMIT_NONE;
+    entry->lru_prev = shard->lru_tail;
+    if (shard->lru_tail != RATE_LIMIT_NONE) {
+        shard->entries[shard->lru_tail].lru_next = index;
+    }
+    shard->lru_tail = index;
+    if (shard->lru_head == RATE_LIMIT_NONE) {
+        shard->lru_head = index;
+    }
+}
+
+/**
+ * chain_unlink - Remove an entry from its hash chain (lock held)
+ */
+static void chain_unlink(rate_limit_shard_t *shard, uint32_t bucket,
+                         int16_t index) {
+    int16_t *link = &shard->buckets[bucket];
+
+    while (*link != RATE_LIMIT_NONE) {
+        if (*link == index) {
+            *link = shard->entries[index].chain_next;
+            return;
+        }
+        link = &shard->entries[*link].chain_next;
+    }
+}
+
+/**
+ * shard_find - Look up an address in a shard (lock held)
+ *
+ * Returns: Entry index, or RATE_LIMIT_NONE
+ */
+static int16_t shard_find(const rate_limit_shard_t *shard, uint32_t hash,
+                          const rate_limit_key_t *key) {
+    int16_t index = shard->buckets[hash & RATE_LIMIT_BUCKET_MASK];
+
+    while (index != RATE_LIMIT_NONE) {
+        if (memcmp(&shard->entries[index].key, key, sizeof(*key)) == 0) {
+            return index;
+        }
+        index = shard->entries[index].chain_next;
+    }
+    return RATE_LIMIT_NONE;
+}
+
+/**
+ * shard_insert - Track a new address with a full bucket (lock held)
+ *
+ * Evicts the least recently used address once the shard is full.
+ */
+static int16_t shard_insert(rate_limiter_t *limiter, rate_limit_shard_t *shard,
+                            uint32_t hash, const rate_limit_key_t *key,
+                            uint64_t now) {
+    rate_limit_entry_t *entry;
+    uint32_t bucket = hash & RATE_LIMIT_BUCKET_MASK;
+    int16_t index;
+
+    if (shard->used < RATE_LIMIT_SHARD_ENTRIES) {
+        index = (int16_t)shard->used++;
+    } else {
+        index = shard->lru_tail;
+        lru_unlink(shard, index);
+        chain_unlink(shard,
+                     key_hash(limiter, &shard->entries[index].key) &
+                         RATE_LIMIT_BUCKET_MASK,
+                     index);
+    }
+
+    entry = &shard->entries[index];
+    entry->key = *key;
+    entry->tokens = limiter->burst;
+    entry->updated_ms = now;
+    entry->chain_next = shard->buckets[bucket];
+    shard->buckets[bucket] = index;
+    lru_push_head(shard, index);
+    return index;
+}
+
+/**
+ * entry_refill - Credit the tokens earned since the last update
+ */
+static void entry_refill(const rate_limiter_t *limiter,
+                         rate_limit_entry_t *entry, uint64_t now) {
+    uint64_t gained;
+
+    if (now <= entry->updated_ms) {
+        return;
+    }
+
+    gained = (now - entry->updated_ms) / limiter->refill_ms;
+    if (gained == 0) {
+        return;
+    }
+
+    if (gained >= (uint64_t)(limiter->burst - entry->tokens)) {
+        entry->tokens = limiter->burst;
+        entry->updated_ms = now;
+    } else {
+        entry->tokens += (uint32_t)gained;
+        entry->updated_ms += gained * limiter->refill_ms;
+    }
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+int rate_limiter_init(rate_limiter_t *limiter, uint32_t burst,
+                      uint32_t refill_ms) {
+    rate_limit_shard_t *shard;
+    int i;
+    int j;
+
+    if (limiter == NULL || burst == 0 || refill_ms == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(limiter, 0, sizeof(*limiter));
+    limiter->burst = burst;
+    limiter->refill_ms = refill_ms;
+    limiter->seed = (uint32_t)latency_now_ms() ^ (uint32_t)(uintptr_t)limiter;
+
+    for (i = 0; i < RATE_LIMIT_SHARDS; i++) {
+        shard = &limiter->shards[i];
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            while (--i >= 0) {
+                pthread_mutex_destroy(&limiter->shards[i].lock);
+            }
+            return E_UNKNOWN_ERROR;
+        }
+        for (j = 0; j < RATE_LIMIT_SHARD_BUCKETS; j++) {
+            shard->buckets[j] = RATE_LIMIT_NONE;
+        }
+        shard->lru_head = RATE_LIMIT_NONE;
+        shard->lru_tail = RATE_LIMIT_NONE;
+    }
+
+    return 0;
+}
+
+int rate_limiter_set_rate(rate_limiter_t *limiter, uint32_t burst,
+                          uint32_t refill_ms) {
+    rate_limit_shard_t *shard;
+    int i;
+    int j;
+
+    if (limiter == NULL || burst == 0 || refill_ms == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /* Lookups read burst/refill_ms under their shard lock: hold them all */
+    for (i = 0; i < RATE_LIMIT_SHARDS; i++) {
+        pthread_mutex_lock(&limiter->shards[i].lock);
+    }
+
+    limiter->burst = burst;
+    limiter->refill_ms = refill_ms;
+    for (i = 0; i < RATE_LIMIT_SHARDS; i++) {
+        shard = &limiter->shards[i];
+        for (j = 0; j < shard->used; j++) {
+            if (shard->entries[j].tokens > burst) {
+                shard->entries[j].tokens = burst;
+            }
+        }
+    }
+
+    for (i = RATE_LIMIT_SHARDS - 1; i >= 0; i--) {
+        pthread_mutex_unlock(&limiter->shards[i].lock);
+    }
+    return 0;
+}
+
+void rate_limiter_destroy(rate_limiter_t *limiter) {
+    int i;
+
+    if (limiter == NULL) {
+        return;
+    }
+    for (i = 0; i < RATE_LIMIT_SHARDS; i++) {
+        pthread_mutex_destroy(&limiter->shards[i].lock);
+    }
+}
+
+int rate_limiter_allow(rate_limiter_t *limiter, const rate_limit_key_t *key) {
+    rate_limit_shard_t *shard;
+    rate_limit_entry_t *entry;
+    uint32_t hash;
+    uint64_t now;
+    int16_t index;
+    int allowed = FALSE;
+
+    if (limiter == NULL || key == NULL) {
+        return TRUE;
+    }
+
+    hash = key_hash(limiter, key);
+    shard = shard_for(limiter, hash);
+    now = latency_now_ms();
+
+    pthread_mutex_lock(&shard->lock);
+
+    index = shard_find(shard, hash, key);
+    if (index == RATE_LIMIT_NONE) {
+        index = shard_insert(limiter, shard, hash, key, now);
+    } else {
+        lru_unlink(shard, index);
+        lru_push_head(shard, index);
+    }
+
+    entry = &shard->entries[index];
+    entry_refill(limiter, entry, now);
+    if (entry->tokens > 0) {
+        if (entry->tokens == limiter->burst) {
+            entry->updated_ms = now;    /* Refill clock starts at first use */
+        }
+        entry->tokens--;
+        allowed = TRUE;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return allowed;
+}
+
+int rate_limiter_blocked(rate_limiter_t *limiter, const rate_limit_key_t *key) {
+    rate_limit_shard_t *shard;
+    rate_limit_entry_t *entry;
+    uint32_t hash;
+    int16_t index;
+    int blocked = FALSE;
+
+    if (limiter == NULL || key == NULL) {
+        return FALSE;
+    }
+
+    hash = key_hash(limiter, key);
+    shard = shard_for(limiter, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    index = shard_find(shard, hash, key);
+    if (index != RATE_LIMIT_NONE) {
+        entry = &shard->entries[index];
+        entry_refill(limiter, entry, latency_now_ms());
+        blocked = (entry->tokens == 0);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return blocked;
+}
+
+void rate_limiter_forget(rate_limiter_t *limiter, const rate_limit_key_t *key) {
+    rate_limit_shard_t *shard;
+    rate_limit_entry_t *entry;
+    uint32_t hash;
+    int16_t index;
+
+    if (limiter == NULL || key == NULL) {
+        return;
+    }
+
+    hash = key_hash(limiter, key);
+    shard = shard_for(limiter, hash);
+
+    pthread_mutex_lock(&shard->lock);
+
+    /* A full bucket is the same as untracked; make it the first reused */
+    index = shard_find(shard, hash, key);
+    if (index != RATE_LIMIT_NONE) {
+        entry = &shard->entries[index];
+        entry->tokens = limiter->burst;
+        lru_unlink(shard, index);
+        lru_push_tail(shard, index);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+int rate_limit_key_from_sockaddr(const struct sockaddr *addr,
+                                 rate_limit_key_t *key) {
+    const struct sockaddr_in *v4;
+    const struct sockaddr_in6 *v6;
+
+    if (addr == NULL || key == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (addr->sa_family == AF_INET) {
+        v4 = (const struct sockaddr_in *)addr;
+        memcpy(key->addr, v4_mapped_prefix, sizeof(v4_mapped_prefix));
+        memcpy(key->addr + 12, &v4->sin_addr.s_addr, 4);
+        return 0;
+    }
+    if (addr->sa_family == AF_INET6) {
+        v6 = (const struct sockaddr_in6 *)addr;
+        memcpy(key->addr, &v6->sin6_addr, sizeof(key->addr));
+        return 0;
+    }
+
+    return E_INVALID_ARGUMENT;
+}
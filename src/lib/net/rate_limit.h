@@ -0,0 +1,153 @@
+/**
+ * rate_limit.h
+ *
+ * Per-address token bucket rate limiter for XOE.
+ *
+ * Each source address (IPv4 or IPv6) owns a bucket of @burst tokens that
+ * refills at one token per @refill_ms. Buckets live in a fixed-size table
+ * split into RATE_LIMIT_SHARDS shards, each with its own lock and hash
+ * chains, so concurrent accept paths rarely contend and a lookup costs a
+ * hash and a short chain walk instead of a scan of every tracked address.
+ *
+ * When a shard is full the least recently seen address in it is evicted,
+ * so a flood of new sources never disables limiting for the addresses
+ * already being throttled: the table never fails open.
+ *
+ * The limiter is embedded by value (no allocation) and is used for both
+ * the server's connection rate limit and the management console's
+ * authentication lockout.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include "lib/common/types.h"
+
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* Lock shards (power of two) */
+#define RATE_LIMIT_SHARDS 16
+
+/* Addresses tracked per shard (RATE_LIMIT_SHARDS * this in total) */
+#define RATE_LIMIT_SHARD_ENTRIES 64
+
+/* Hash chains per shard (power of two) */
+#define RATE_LIMIT_SHARD_BUCKETS 128
+
+/**
+ * Source address key: IPv6, with IPv4 stored as ::ffff:a.b.c.d
+ */
+typedef struct {
+    uint8_t addr[16];
+} rate_limit_key_t;
+
+/**
+ * One tracked address (internal)
+ */
+typedef struct {
+    rate_limit_key_t key;
+    uint64_t updated_ms;        /* Last refill (monotonic ms) */
+    uint32_t tokens;            /* Whole tokens left */
+    int16_t chain_next;         /* Next entry in the hash chain, or -1 */
+    int16_t lru_prev;           /* Towards most recently used, or -1 */
+    int16_t lru_next;           /* Towards least recently used, or -1 */
+} rate_limit_entry_t;
+
+/**
+ * One lock shard (internal)
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    int16_t buckets[RATE_LIMIT_SHARD_BUCKETS];
+    rate_limit_entry_t entries[RATE_LIMIT_SHARD_ENTRIES];
+    int used;                   /* Entries handed out so far */
+    int16_t lru_head;           /* Most recently used, or -1 */
+    int16_t lru_tail;           /* Least recently used, or -1 */
+} rate_limit_shard_t;
+
+/**
+ * Rate limiter (embed by value; initialize with rate_limiter_init)
+ */
+typedef struct {
+    uint32_t burst;             /* Bucket size */
+    uint32_t refill_ms;         /* Time to regain one token */
+    uint32_t seed;              /* Hash seed (per limiter) */
+    rate_limit_shard_t shards[RATE_LIMIT_SHARDS];
+} rate_limiter_t;
+
+/**
+ * rate_limiter_init - Initialize a limiter
+ * @limiter:   Limiter to initialize
+ * @burst:     Events allowed back to back from one address (>= 1)
+ * @refill_ms: Milliseconds to regain one event (>= 1)
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT, or E_UNKNOWN_ERROR if a
+ *          shard lock cannot be created
+ */
+int rate_limiter_init(rate_limiter_t *limiter, uint32_t burst,
+                      uint32_t refill_ms);
+
+/**
+ * rate_limiter_set_rate - Change the burst and refill rate in place
+ * @limiter:   Initialized limiter
+ * @burst:     New bucket size (>= 1)
+ * @refill_ms: New time to regain one event (>= 1)
+ *
+ * Takes every shard lock in turn, so it may run while other threads
+ * check addresses. Tracked addresses keep their tokens, capped at the new
+ * burst.
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT
+ */
+int rate_limiter_set_rate(rate_limiter_t *limiter, uint32_t burst,
+                          uint32_t refill_ms);
+
+/**
+ * rate_limiter_destroy - Release the shard locks
+ * @limiter: Initialized limiter
+ */
+void rate_limiter_destroy(rate_limiter_t *limiter);
+
+/**
+ * rate_limiter_allow - Take one token for an address
+ * @limiter: Limiter
+ * @key:     Source address
+ *
+ * Returns: TRUE if the event is allowed, FALSE if the address is out of
+ *          tokens (nothing is taken then)
+ */
+int rate_limiter_allow(rate_limiter_t *limiter, const rate_limit_key_t *key);
+
+/**
+ * rate_limiter_blocked - Check whether an address is out of tokens
+ * @limiter: Limiter
+ * @key:     Source address
+ *
+ * Does not take a token.
+ *
+ * Returns: TRUE if the next rate_limiter_allow() would be refused
+ */
+int rate_limiter_blocked(rate_limiter_t *limiter, const rate_limit_key_t *key);
+
+/**
+ * rate_limiter_forget - Drop an address (back to a full bucket)
+ * @limiter: Limiter
+ * @key:     Source address
+ */
+void rate_limiter_forget(rate_limiter_t *limiter, const rate_limit_key_t *key);
+
+/**
+ * rate_limit_key_from_sockaddr - Build a key from a peer address
+ * @addr: AF_INET or AF_INET6 socket address
+ * @key:  Output key (port is ignored)
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT for NULL or another family
+ */
+int rate_limit_key_from_sockaddr(const struct sockaddr *addr,
+                                 rate_limit_key_t *key);
+
+#endif /* RATE_LIMIT_H */
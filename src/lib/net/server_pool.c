@@ -0,0 +1,554 @@
+/**
+ * server_pool.c
+ *
+ * Health, round trip and standby connection per server under one lock.
+ * Connects are never made under it: a check connects first and stores
+ * the result after, so server_pool_connect() never waits for a check.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "server_pool.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Weight of the previous round trip in the smoothed one (of 8) */
+#define SERVER_POOL_RTT_KEEP 7
+
+/**
+ * One server's state (pool->lock)
+ */
+typedef struct {
+    int healthy;            /* The last connect to it succeeded */
+    int rtt_us;             /* Smoothed connect time (0 = not measured) */
+    int standby;            /* Warm connection, or -1 */
+    uint32_t hash;          /* Of "host:port", for the hash policy */
+} server_state_t;
+
+struct server_pool {
+    server_list_t list;
+    sock_tune_t tune;
+    int have_tune;
+    uint32_t key;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        /* Ends the wait between checks early */
+    server_state_t servers[SERVER_POOL_MAX];
+    int current;                /* Server of the last connection, or -1 */
+    unsigned long failovers;
+    int stop;
+
+    pthread_t thread;
+    int thread_started;
+};
+
+/**
+ * mix - Final avalanche of a 32-bit hash
+ */
+static uint32_t mix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * fnv1a - FNV-1a over a string, continuing from @hash
+ */
+static uint32_t fnv1a(uint32_t hash, const char *text) {
+    while (*text != '\0') {
+        hash ^= (uint8_t)*text++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int server_list_parse(const char *spec, server_list_t *list) {
+    const char *entry;
+    const char *end;
+    const char *colon;
+    const char *at;
+    char port_text[8];
+    size_t host_len;
+    size_t port_len;
+    char *tail;
+    long port;
+    int count = 0;
+
+    if (spec == NULL || list == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (entry = spec; ; entry = end + 1) {
+        end = strchr(entry, ',');
+        if (end == NULL) {
+            end = entry + strlen(entry);
+        }
+        if (count == SERVER_POOL_MAX) {
+            return E_INVALID_ARGUMENT;
+        }
+
+        /* The port follows the last colon of the entry */
+        colon = NULL;
+        for (at = entry; at < end; at++) {
+            if (*at == ':') {
+                colon = at;
+            }
+        }
+        if (colon == NULL || colon == entry) {
+            return E_INVALID_ARGUMENT;
+        }
+        host_len = (size_t)(colon - entry);
+        port_len = (size_t)(end - colon - 1);
+        if (host_len >= NET_RESOLVE_HOST_MAX || port_len == 0 ||
+            port_len >= sizeof(port_text)) {
+            return E_INVALID_ARGUMENT;
+        }
+        memcpy(port_text, colon + 1, port_len);
+        port_text[port_len] = '\0';
+        errno = 0;
+        port = strtol(port_text, &tail, 10);
+        if (errno != 0 || *tail != '\0' || port < 1 || port > 65535) {
+            return E_INVALID_ARGUMENT;
+        }
+
+        memcpy(list->hosts[count], entry, host_len);
+        list->hosts[count][host_len] = '\0';
+        list->ports[count] = (int)port;
+        count++;
+
+        if (*end == '\0') {
+            break;
+        }
+    }
+
+    list->count = count;
+    return 0;
+}
+
+int server_policy_parse(const char *name, server_policy_t *policy) {
+    if (name == NULL || policy == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (strcmp(name, "primary") == 0) {
+        *policy = SERVER_POLICY_PRIMARY;
+    } else if (strcmp(name, "rtt") == 0) {
+        *policy = SERVER_POLICY_RTT;
+    } else if (strcmp(name, "hash") == 0) {
+        *policy = SERVER_POLICY_HASH;
+    } else {
+        return E_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+const char *server_policy_name(server_policy_t policy) {
+    switch (policy) {
+        case SERVER_POLICY_RTT:
+            return "rtt";
+        case SERVER_POLICY_HASH:
+            return "hash";
+        default:
+            return "primary";
+    }
+}
+
+uint32_t server_pool_key(const char *name) {
+    if (name == NULL || name[0] == '\0') {
+        return 0;
+    }
+    return mix(fnv1a(2166136261u, name));
+}
+
+void server_pool_fast_loss(sock_tune_t *tune) {
+    int idle_s = (SERVER_POOL_LOSS_MS + 999) / 1000;
+
+    if (tune == NULL) {
+        return;
+    }
+    tune->keepalive = 1;
+    tune->keepidle_s = idle_s;
+    tune->keepintvl_s = idle_s;
+    tune->keepcnt = 1;
+    tune->user_timeout_ms = SERVER_POOL_LOSS_MS;
+}
+
+/**
+ * standby_alive - Whether a standby connection is still open
+ *
+ * The server sends nothing before the client's HELLO, so anything to
+ * read on it is its close or an error.
+ */
+static int standby_alive(int fd) {
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return (poll(&pfd, 1, 0) == 0) ? TRUE : FALSE;
+}
+
+/**
+ * connect_server - Connect to one server, timing the connect
+ * @rtt_us: Output: time the connect took
+ */
+static int connect_server(server_pool_t *pool, int index, int *fd_out,
+                          int *rtt_us) {
+    uint64_t start = metrics_now_us();
+    int result;
+
+    result = net_resolve_connect_timed(pool->list.hosts[index],
+                                       pool->list.ports[index],
+                                       pool->have_tune ? &pool->tune : NULL,
+                                       SERVER_POOL_CONNECT_MS, fd_out, NULL);
+    *rtt_us = (int)(metrics_now_us() - start);
+    if (*rtt_us < 1) {
+        *rtt_us = 1;
+    }
+    return result;
+}
+
+/**
+ * note_rtt - Fold a connect time into a server's round trip (pool->lock)
+ */
+static void note_rtt(server_state_t *server, int rtt_us) {
+    if (server->rtt_us == 0) {
+        server->rtt_us = rtt_us;
+    } else {
+        server->rtt_us = (int)(((int64_t)server->rtt_us * SERVER_POOL_RTT_KEEP +
+                                rtt_us) / (SERVER_POOL_RTT_KEEP + 1));
+    }
+}
+
+/**
+ * check_server - Connect to a server and note the outcome
+ * @keep: Keep the connection as its standby if it has none
+ */
+static void check_server(server_pool_t *pool, int index, int keep) {
+    server_state_t *server = &pool->servers[index];
+    int rtt_us;
+    int fd = -1;
+    int result;
+
+    result = connect_server(pool, index, &fd, &rtt_us);
+
+    pthread_mutex_lock(&pool->lock);
+    if (result == 0) {
+        server->healthy = TRUE;
+        note_rtt(server, rtt_us);
+        if (keep && !pool->stop && server->standby < 0 &&
+            index != pool->current) {
+            server->standby = fd;
+            fd = -1;
+        }
+    } else {
+        server->healthy = FALSE;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * ranks_before - Whether server @a goes before @b under the policy
+ * (pool->lock)
+ */
+static int ranks_before(const server_pool_t *pool, int a, int b) {
+    const server_state_t *sa = &pool->servers[a];
+    const server_state_t *sb = &pool->servers[b];
+    uint32_t score_a;
+    uint32_t score_b;
+
+    if (sa->healthy != sb->healthy) {
+        return sa->healthy;
+    }
+
+    switch (pool->list.policy) {
+        case SERVER_POLICY_RTT:
+            /* Unmeasured last; ties keep list order */
+            if (sa->rtt_us != sb->rtt_us) {
+                if (sa->rtt_us == 0 || sb->rtt_us == 0) {
+                    return sb->rtt_us == 0;
+                }
+                return sa->rtt_us < sb->rtt_us;
+            }
+            break;
+
+        case SERVER_POLICY_HASH:
+            /* Rendezvous: highest score of key and server wins */
+            if (pool->key == 0) {
+                break;
+            }
+            score_a = mix(sa->hash ^ pool->key);
+            score_b = mix(sb->hash ^ pool->key);
+            if (score_a != score_b) {
+                return score_a > score_b;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return a < b;
+}
+
+/**
+ * rank_servers - Servers in the order they are tried (pool->lock)
+ * @order: Output: list->count indexes, healthy ones first
+ */
+static void rank_servers(const server_pool_t *pool, int *order) {
+    int count = pool->list.count;
+    int i;
+    int j;
+    int index;
+
+    for (i = 0; i < count; i++) {
+        index = i;
+        for (j = i; j > 0 && ranks_before(pool, index, order[j - 1]); j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = index;
+    }
+}
+
+server_pool_t *server_pool_create(const server_list_t *list,
+                                const sock_tune_t *tune, uint32_t key) {
+    server_pool_t *pool;
+    char name[NET_RESOLVE_HOST_MAX + 8];
+    int i;
+
+    if (list == NULL || list->count < 1 || list->count > SERVER_POOL_MAX) {
+        return NULL;
+    }
+
+    pool = (server_pool_t *)calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+        free(pool);
+        return NULL;
+    }
+    if (pthread_cond_init(&pool->wake, NULL) != 0) {
+        pthread_mutex_destroy(&pool->lock);
+        free(pool);
+        return NULL;
+    }
+
+    pool->list = *list;
+    if (tune != NULL) {
+        pool->tune = *tune;
+        pool->have_tune = TRUE;
+    }
+    pool->key = key;
+    pool->current = -1;
+    for (i = 0; i < list->count; i++) {
+        snprintf(name, sizeof(name), "%s:%d", list->hosts[i], list->ports[i]);
+        pool->servers[i].hash = fnv1a(2166136261u, name);
+        pool->servers[i].standby = -1;
+    }
+
+    for (i = 0; i < list->count; i++) {
+        check_server(pool, i, FALSE);
+    }
+    return pool;
+}
+
+/**
+ * standby_thread - Check servers and keep a standby to each healthy one
+ * @arg: server_pool_t
+ *
+ * The server in use is left alone: its connection's keepalive watches it.
+ */
+static void *standby_thread(void *arg) {
+    server_pool_t *pool = (server_pool_t *)arg;
+    struct timespec deadline;
+    server_state_t *server;
+    int dead_fd;
+    int check;
+    int i;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop) {
+        for (i = 0; i < pool->list.count && !pool->stop; i++) {
+            server = &pool->servers[i];
+            if (i == pool->current) {
+                continue;
+            }
+
+            check = TRUE;
+            dead_fd = -1;
+            if (server->standby >= 0) {
+                if (standby_alive(server->standby)) {
+                    check = FALSE;
+                } else {
+                    dead_fd = server->standby;
+                    server->standby = -1;
+                    server->healthy = FALSE;
+                }
+            }
+            if (!check) {
+                continue;
+            }
+
+            pthread_mutex_unlock(&pool->lock);
+            if (dead_fd >= 0) {
+                close(dead_fd);
+            }
+            check_server(pool, i, TRUE);
+            pthread_mutex_lock(&pool->lock);
+        }
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += (long)SERVER_POOL_CHECK_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        if (!pool->stop) {
+            pthread_cond_timedwait(&pool->wake, &pool->lock, &deadline);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+int server_pool_standby(server_pool_t *pool) {
+    if (pool == NULL || pool->thread_started) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (thread_sched_create(&pool->thread, THREAD_CLASS_NONE, standby_thread,
+                            pool) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    pool->thread_started = TRUE;
+    return 0;
+}
+
+int server_pool_pick(server_pool_t *pool) {
+    int order[SERVER_POOL_MAX];
+    int best;
+
+    if (pool == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    rank_servers(pool, order);
+    best = pool->servers[order[0]].healthy ? order[0] : E_NOT_FOUND;
+    pthread_mutex_unlock(&pool->lock);
+    return best;
+}
+
+int server_pool_connect(server_pool_t *pool, int *sock_out, int *index_out) {
+    int order[SERVER_POOL_MAX];
+    int replacing;
+    int result = E_NETWORK_ERROR;
+    int rtt_us;
+    int index;
+    int fd;
+    int i;
+
+    if (pool == NULL || sock_out == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    replacing = (pool->current >= 0) ? TRUE : FALSE;
+    if (replacing) {
+        pool->servers[pool->current].healthy = FALSE;
+        pool->current = -1;
+    }
+    rank_servers(pool, order);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 0; i < pool->list.count; i++) {
+        index = order[i];
+
+        pthread_mutex_lock(&pool->lock);
+        fd = pool->servers[index].standby;
+        pool->servers[index].standby = -1;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (fd >= 0 && !standby_alive(fd)) {
+            close(fd);
+            fd = -1;
+        }
+        if (fd >= 0) {
+            result = 0;
+        } else {
+            result = connect_server(pool, index, &fd, &rtt_us);
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        if (result != 0) {
+            pool->servers[index].healthy = FALSE;
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+        pool->servers[index].healthy = TRUE;
+        pool->current = index;
+        if (replacing) {
+            pool->failovers++;
+        }
+        pthread_mutex_unlock(&pool->lock);
+
+        *sock_out = fd;
+        if (index_out != NULL) {
+            *index_out = index;
+        }
+        return 0;
+    }
+
+    return result;
+}
+
+unsigned long server_pool_failovers(server_pool_t *pool) {
+    unsigned long failovers;
+
+    if (pool == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&pool->lock);
+    failovers = pool->failovers;
+    pthread_mutex_unlock(&pool->lock);
+    return failovers;
+}
+
+void server_pool_destroy(server_pool_t *pool) {
+    int i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = TRUE;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    if (pool->thread_started) {
+        pthread_join(pool->thread, NULL);
+    }
+
+    for (i = 0; i < pool->list.count; i++) {
+        if (pool->servers[i].standby >= 0) {
+            close(pool->servers[i].standby);
+        }
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
@@ -0,0 +1,168 @@
+/**
+ * server_pool.h
+ *
+ * Several servers a client may connect to (-c a:p,b:p,...), with the one
+ * to use chosen by a policy among those that answer:
+ *
+ *   primary  The first in list order
+ *   rtt      The lowest connect round trip
+ *   hash     Rendezvous hashing of a key (a USB device_id, a hub topic)
+ *            over the servers, so every client with that key lands on
+ *            the same one and only the keys of a dead server move
+ *            (key 0: list order)
+ *
+ * A server is healthy while a connect to it succeeds within
+ * SERVER_POOL_CONNECT_MS; the round trip is the time that connect took,
+ * smoothed over checks. server_pool_standby() keeps checking in a thread
+ * every SERVER_POOL_CHECK_MS and holds a warm standby connection to each
+ * healthy server not in use, so a failover takes an established socket
+ * instead of connecting. A standby the server closed is noticed at the
+ * next check.
+ *
+ * server_pool_fast_loss() sets keepalive and TCP_USER_TIMEOUT so a dead
+ * server is noticed SERVER_POOL_LOSS_MS after data to it went
+ * unacknowledged, or about twice that into an idle connection, instead
+ * of after the minutes TCP takes on its own.
+ *
+ * A failover does not fail back: the connection in use stays where it is
+ * while it works.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SERVER_POOL_H
+#define SERVER_POOL_H
+
+#include "lib/common/types.h"
+#include "lib/net/net_resolve.h"
+#include "lib/net/sock_tune.h"
+
+/* Servers in one list */
+#define SERVER_POOL_MAX 8
+
+/* Health checks and standby connections are refreshed this often (ms) */
+#define SERVER_POOL_CHECK_MS 500
+
+/* A server not connected to within this is down (ms) */
+#define SERVER_POOL_CONNECT_MS 1000
+
+/* Unacknowledged data or silent keepalives for this long drop a
+ * connection (ms) */
+#define SERVER_POOL_LOSS_MS 1000
+
+/**
+ * Selection policies
+ */
+typedef enum {
+    SERVER_POLICY_PRIMARY = 0,
+    SERVER_POLICY_RTT,
+    SERVER_POLICY_HASH
+} server_policy_t;
+
+/**
+ * Servers as given on the command line
+ */
+typedef struct {
+    int count;                                  /* Entries (0 = none) */
+    server_policy_t policy;                     /* --server-policy */
+    char hosts[SERVER_POOL_MAX][NET_RESOLVE_HOST_MAX];
+    int ports[SERVER_POOL_MAX];
+} server_list_t;
+
+typedef struct server_pool server_pool_t;
+
+/**
+ * server_list_parse - Parse "host:port[,host:port...]"
+ * @spec: List as given to -c
+ * @list: Output: servers (policy left as it was)
+ *
+ * The port follows the last colon of each entry.
+ *
+ * Returns: 0, or E_INVALID_ARGUMENT for an empty entry, a bad port, an
+ *          overlong host or more than SERVER_POOL_MAX servers
+ */
+int server_list_parse(const char *spec, server_list_t *list);
+
+/**
+ * server_policy_parse - Parse "primary", "rtt" or "hash"
+ * @name:   Policy name
+ * @policy: Output: policy
+ *
+ * Returns: 0, or E_INVALID_ARGUMENT for an unknown name
+ */
+int server_policy_parse(const char *name, server_policy_t *policy);
+
+/**
+ * server_policy_name - Name of a policy
+ */
+const char *server_policy_name(server_policy_t policy);
+
+/**
+ * server_pool_key - Hash a name (hub topic, device path) into a key
+ * @name: Name (NULL or "" gives 0)
+ */
+uint32_t server_pool_key(const char *name);
+
+/**
+ * server_pool_fast_loss - Detect dead peers within SERVER_POOL_LOSS_MS
+ * @tune: Options to adjust (the rest is kept)
+ */
+void server_pool_fast_loss(sock_tune_t *tune);
+
+/**
+ * server_pool_create - Check every server once
+ * @list: Servers and policy (copied)
+ * @tune: Options for every connection (copied; NULL = none)
+ * @key:  Key of the hash policy
+ *
+ * Checks run one after the other, so a list of black-holed servers
+ * takes SERVER_POOL_CONNECT_MS each.
+ *
+ * Returns: Pool, or NULL on a bad list or no memory
+ */
+server_pool_t *server_pool_create(const server_list_t *list,
+                                const sock_tune_t *tune, uint32_t key);
+
+/**
+ * server_pool_standby - Keep checking, with warm standby connections
+ * @pool: Pool
+ *
+ * Returns: 0, or E_UNKNOWN_ERROR if the thread could not start
+ */
+int server_pool_standby(server_pool_t *pool);
+
+/**
+ * server_pool_pick - Server the policy prefers now
+ * @pool: Pool
+ *
+ * Returns: Index into the list, or E_NOT_FOUND if none is healthy
+ */
+int server_pool_pick(server_pool_t *pool);
+
+/**
+ * server_pool_connect - Connect to the best server that answers
+ * @pool:       Pool
+ * @sock_out:  Output: connected, blocking socket
+ * @index_out: Output: its server (may be NULL)
+ *
+ * Healthy servers are tried in policy order, a standby connection when
+ * there is one, then the others. Called again, the server of the
+ * previous connection counts as down until a check reaches it: call it
+ * after that connection was lost or refused.
+ *
+ * Returns: 0, or the error of the last server tried
+ */
+int server_pool_connect(server_pool_t *pool, int *sock_out, int *index_out);
+
+/**
+ * server_pool_failovers - Connections replaced by server_pool_connect()
+ */
+unsigned long server_pool_failovers(server_pool_t *pool);
+
+/**
+ * server_pool_destroy - Stop checking and close the standby connections
+ * @pool: Pool (NULL is ignored)
+ */
+void server_pool_destroy(server_pool_t *pool);
+
+#endif /* SERVER_POOL_H */
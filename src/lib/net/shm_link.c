@@ -0,0 +1,925 @@
+/**
+ * shm_link.c
+ *
+ * One memfd per link: a header page with the ring control blocks, then
+ * the client-to-server ring, then the server-to-client ring. Indices
+ * are free-running 32-bit byte counts. Each side keeps the index it
+ * owns privately and only publishes it, so a peer scribbling over the
+ * shared copy cannot make this side read or write out of bounds; the
+ * peer's index is checked against the ring size on every load.
+ *
+ * Indices are published with release and read with acquire ordering.
+ * The waiting flags pair with the opposite index through full fences:
+ * the sleeper sets its flag and then re-reads the index, the other side
+ * publishes its index and then reads the flag, so one of the two always
+ * sees the other.
+ *
+ * [LLM-ARCH]
+ */
+
+/* memfd_create(), F_ADD_SEALS, accept4() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "shm_link.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/futex.h>
+#endif
+
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING) && defined(SYS_futex)
+#define SHM_LINK_AVAILABLE 1
+#else
+#define SHM_LINK_AVAILABLE 0
+#endif
+
+const char *shm_link_address(const char *address)
+{
+    if (address == NULL) {
+        return NULL;
+    }
+    if (strncmp(address, "shm:", 4) == 0) {
+        return address + 4;
+    }
+    if (strncmp(address, "unix:", 5) == 0) {
+        return address + 5;
+    }
+    return NULL;
+}
+
+#if SHM_LINK_AVAILABLE
+
+#define SHM_LINK_MAGIC 0x58534D4CU          /* "XSML" */
+#define SHM_LINK_VERSION 1
+#define SHM_LINK_CACHE_LINE 64
+#define SHM_LINK_MASK (SHM_LINK_RING_SIZE - 1)
+
+/* Rings start on the second page */
+#define SHM_LINK_DATA_OFFSET 4096
+#define SHM_LINK_MAP_SIZE (SHM_LINK_DATA_OFFSET + 2 * SHM_LINK_RING_SIZE)
+
+/* Ring 0 carries client to server, ring 1 server to client */
+#define SHM_RING_UP 0
+#define SHM_RING_DOWN 1
+
+/* Longest futex sleep between checks that the peer is still there (ms) */
+#define SHM_LINK_HANGUP_CHECK_MS 100
+
+/*
+ * Ring control block. The writer's and the reader's fields sit on their
+ * own cache lines.
+ */
+typedef struct {
+    uint32_t tail;              /* Bytes ever written (writer) */
+    uint32_t writer_waiting;    /* Writer sleeps on head for room */
+    char pad0[SHM_LINK_CACHE_LINE - 2 * sizeof(uint32_t)];
+    uint32_t head;              /* Bytes ever read (reader); futex word */
+    uint32_t reader_waiting;    /* Reader wants the doorbell */
+    uint32_t reader_closed;     /* Reader gone: the writer stops waiting */
+    char pad1[SHM_LINK_CACHE_LINE - 3 * sizeof(uint32_t)];
+} shm_ring_ctl_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    char pad[SHM_LINK_CACHE_LINE - 3 * sizeof(uint32_t)];
+    shm_ring_ctl_t ring[2];
+} shm_link_header_t;
+
+struct shm_link {
+    int fd;                     /* UNIX socket: doorbell and hangup */
+    uint8_t *map;
+    shm_ring_ctl_t *tx;
+    shm_ring_ctl_t *rx;
+    uint8_t *tx_data;
+    uint8_t *rx_data;
+    uint32_t tx_tail;           /* Private copy of tx->tail */
+    uint32_t tx_published;      /* Last value stored to tx->tail */
+    uint32_t rx_head;           /* Private copy of rx->head */
+    int peer_closed;            /* End of stream seen on the socket */
+};
+
+/* Links by descriptor; the count keeps lookups free while there are none */
+static shm_link_t *g_links[SHM_LINK_MAX_FD];
+static int g_link_count = 0;
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+static void futex_wait(uint32_t *word, uint32_t value, int timeout_ms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+    (void)syscall(SYS_futex, word, FUTEX_WAIT, value, &ts, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word)
+{
+    (void)syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static int fill_address(struct sockaddr_un *addr, const char *path)
+{
+    if (path == NULL || path[0] == '\0' ||
+        strlen(path) >= sizeof(addr->sun_path) ||
+        strlen(path) >= SHM_LINK_PATH_MAX) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+    return 0;
+}
+
+/**
+ * link_new - Wrap a mapping and register it under @fd
+ * @fd:     Link socket
+ * @map:    SHM_LINK_MAP_SIZE bytes
+ * @client: TRUE on the connecting side
+ *
+ * Returns: Link, or NULL (the caller unmaps and closes)
+ */
+static shm_link_t *link_new(int fd, uint8_t *map, int client)
+{
+    shm_link_header_t *header = (shm_link_header_t *)map;
+    shm_link_t *link;
+    int up = client ? SHM_RING_UP : SHM_RING_DOWN;
+    int down = client ? SHM_RING_DOWN : SHM_RING_UP;
+
+    if (fd >= SHM_LINK_MAX_FD) {
+        return NULL;
+    }
+
+    link = (shm_link_t *)calloc(1, sizeof(shm_link_t));
+    if (link == NULL) {
+        return NULL;
+    }
+    link->fd = fd;
+    link->map = map;
+    link->tx = &header->ring[up];
+    link->rx = &header->ring[down];
+    link->tx_data = map + SHM_LINK_DATA_OFFSET + up * SHM_LINK_RING_SIZE;
+    link->rx_data = map + SHM_LINK_DATA_OFFSET + down * SHM_LINK_RING_SIZE;
+    link->tx_tail = __atomic_load_n(&link->tx->tail, __ATOMIC_ACQUIRE);
+    link->tx_published = link->tx_tail;
+    link->rx_head = __atomic_load_n(&link->rx->head, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n(&g_links[fd], link, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&g_link_count, 1, __ATOMIC_RELEASE);
+    return link;
+}
+
+/* ============================================================================
+ * Setup
+ * ============================================================================ */
+
+/**
+ * remove_stale_socket - Remove a socket file nobody listens on any more
+ * @addr: Address about to be bound
+ *
+ * Only a socket whose connect() is refused was left behind by a process
+ * that did not exit cleanly; a live server, anything that is not a
+ * socket (symlinks included) and a socket we may not connect to stay,
+ * and the bind() that follows fails.
+ */
+static void remove_stale_socket(const struct sockaddr_un *addr)
+{
+    struct stat st;
+    int refused;
+    int fd;
+
+    if (lstat(addr->sun_path, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return;
+    }
+
+    /* Non-blocking: a live server with a full backlog is not waited on */
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return;
+    }
+    refused = connect(fd, (const struct sockaddr *)addr,
+                      sizeof(*addr)) != 0 && errno == ECONNREFUSED;
+    close(fd);
+
+    if (refused) {
+        (void)unlink(addr->sun_path);
+    }
+}
+
+int shm_link_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (fill_address(&addr, path) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return E_NETWORK_ERROR;
+    }
+
+    remove_stale_socket(&addr);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int error = (errno == EACCES) ? E_PERMISSION_DENIED : E_NETWORK_ERROR;
+        close(fd);
+        return error;
+    }
+    /* Before listen(): until then a connect() is refused */
+    if (chmod(path, S_IRUSR | S_IWUSR) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        (void)unlink(path);
+        return E_NETWORK_ERROR;
+    }
+    return fd;
+}
+
+void shm_link_close_listener(int fd, const char *path)
+{
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+    if (path != NULL) {
+        (void)unlink(path);
+    }
+}
+
+/**
+ * recv_memory - Receive the client's memfd (one byte carrying it)
+ *
+ * Returns: The memfd, or E_TIMEOUT, E_PROTOCOL_ERROR, E_NETWORK_ERROR
+ */
+static int recv_memory(int fd)
+{
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct pollfd pfd;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char byte;
+    int mem = -1;
+    ssize_t n;
+    int ret;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    do {
+        ret = poll(&pfd, 1, SHM_LINK_SETUP_MS);
+    } while (ret < 0 && errno == EINTR);
+    if (ret == 0) {
+        return E_TIMEOUT;
+    }
+    if (ret < 0) {
+        return E_NETWORK_ERROR;
+    }
+
+    memset(&mh, 0, sizeof(mh));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+
+    do {
+        n = recvmsg(fd, &mh, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return E_NETWORK_ERROR;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+            cmsg->cmsg_len == CMSG_LEN(sizeof(int)) && mem < 0) {
+            memcpy(&mem, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (n != 1 || (mh.msg_flags & MSG_CTRUNC) || mem < 0) {
+        if (mem >= 0) {
+            close(mem);
+        }
+        return E_PROTOCOL_ERROR;
+    }
+    return mem;
+}
+
+/**
+ * map_memory - Map a client's memfd once it proved safe to map
+ *
+ * A memfd that could shrink would fault this process on access.
+ */
+static uint8_t *map_memory(int mem)
+{
+    const shm_link_header_t *header;
+    struct stat st;
+    uint8_t *map;
+    int seals;
+
+    seals = fcntl(mem, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK) ||
+        fstat(mem, &st) != 0 || st.st_size != SHM_LINK_MAP_SIZE) {
+        return NULL;
+    }
+
+    map = (uint8_t *)mmap(NULL, SHM_LINK_MAP_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, mem, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    header = (const shm_link_header_t *)map;
+    if (header->magic != SHM_LINK_MAGIC ||
+        header->version != SHM_LINK_VERSION ||
+        header->ring_size != SHM_LINK_RING_SIZE) {
+        munmap(map, SHM_LINK_MAP_SIZE);
+        return NULL;
+    }
+    return map;
+}
+
+int shm_link_accept(int listen_fd, int *fd_out)
+{
+    uint8_t *map;
+    int mem;
+    int fd;
+
+    if (fd_out == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    *fd_out = -1;
+
+    do {
+        fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        return E_NETWORK_ERROR;
+    }
+
+    mem = recv_memory(fd);
+    if (mem < 0) {
+        close(fd);
+        return mem;
+    }
+    map = map_memory(mem);
+    close(mem);
+    if (map == NULL) {
+        close(fd);
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (link_new(fd, map, FALSE) == NULL) {
+        munmap(map, SHM_LINK_MAP_SIZE);
+        close(fd);
+        return E_OUT_OF_MEMORY;
+    }
+    *fd_out = fd;
+    return 0;
+}
+
+/**
+ * create_memory - Sealed memfd with an initialized header
+ *
+ * Both readers start out waiting, so the first write rings.
+ *
+ * Returns: The memfd (its mapping in *map_out), or -1
+ */
+static int create_memory(uint8_t **map_out)
+{
+    shm_link_header_t *header;
+    uint8_t *map;
+    int mem;
+
+    mem = memfd_create("xoe-shm-link", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mem < 0) {
+        return -1;
+    }
+    if (ftruncate(mem, SHM_LINK_MAP_SIZE) != 0 ||
+        fcntl(mem, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        close(mem);
+        return -1;
+    }
+
+    map = (uint8_t *)mmap(NULL, SHM_LINK_MAP_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, mem, 0);
+    if (map == MAP_FAILED) {
+        close(mem);
+        return -1;
+    }
+
+    header = (shm_link_header_t *)map;
+    header->magic = SHM_LINK_MAGIC;
+    header->version = SHM_LINK_VERSION;
+    header->ring_size = SHM_LINK_RING_SIZE;
+    header->ring[SHM_RING_UP].reader_waiting = 1;
+    header->ring[SHM_RING_DOWN].reader_waiting = 1;
+
+    *map_out = map;
+    return mem;
+}
+
+/**
+ * send_memory - Pass the memfd with one byte
+ */
+static int send_memory(int fd, int mem)
+{
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char byte = 0;
+    ssize_t n;
+
+    memset(&mh, 0, sizeof(mh));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &mem, sizeof(int));
+
+    do {
+        n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return (n == 1) ? 0 : E_NETWORK_ERROR;
+}
+
+int shm_link_connect(const char *path, int *fd_out)
+{
+    struct sockaddr_un addr;
+    uint8_t *map = NULL;
+    int mem;
+    int fd;
+
+    if (fd_out == NULL || fill_address(&addr, path) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    *fd_out = -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return E_NETWORK_ERROR;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return E_NETWORK_ERROR;
+    }
+
+    mem = create_memory(&map);
+    if (mem < 0) {
+        close(fd);
+        return E_OUT_OF_MEMORY;
+    }
+    if (send_memory(fd, mem) != 0) {
+        int saved = errno;
+        close(mem);
+        munmap(map, SHM_LINK_MAP_SIZE);
+        close(fd);
+        errno = saved;
+        return E_NETWORK_ERROR;
+    }
+    close(mem);
+
+    if (link_new(fd, map, TRUE) == NULL) {
+        munmap(map, SHM_LINK_MAP_SIZE);
+        close(fd);
+        return E_OUT_OF_MEMORY;
+    }
+    *fd_out = fd;
+    return 0;
+}
+
+shm_link_t *shm_link_find(int fd)
+{
+    if (__atomic_load_n(&g_link_count, __ATOMIC_RELAXED) == 0 ||
+        fd < 0 || fd >= SHM_LINK_MAX_FD) {
+        return NULL;
+    }
+    return __atomic_load_n(&g_links[fd], __ATOMIC_ACQUIRE);
+}
+
+void shm_link_close(int fd)
+{
+    shm_link_t *link;
+
+    if (fd < 0) {
+        return;
+    }
+
+    link = shm_link_find(fd);
+    if (link != NULL) {
+        __atomic_store_n(&g_links[fd], NULL, __ATOMIC_RELEASE);
+        __atomic_sub_fetch(&g_link_count, 1, __ATOMIC_RELEASE);
+
+        /* A writer waiting for room in our ring gives up at once */
+        __atomic_store_n(&link->rx->reader_closed, 1, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        futex_wake(&link->rx->head);
+
+        munmap(link->map, SHM_LINK_MAP_SIZE);
+        free(link);
+    }
+    close(fd);
+}
+
+/* ============================================================================
+ * Receive
+ * ============================================================================ */
+
+/**
+ * ring_read - Copy out what the receive ring holds, up to @len bytes
+ *
+ * Returns: Bytes read (0 if empty), E_IO_ERROR if the peer's index is
+ *          impossible
+ */
+static int ring_read(shm_link_t *link, uint8_t *buf, uint32_t len)
+{
+    uint32_t tail = __atomic_load_n(&link->rx->tail, __ATOMIC_ACQUIRE);
+    uint32_t avail = tail - link->rx_head;
+    uint32_t offset;
+    uint32_t first;
+
+    if (avail > SHM_LINK_RING_SIZE) {
+        return E_IO_ERROR;
+    }
+    if (avail == 0) {
+        return 0;
+    }
+    if (len > avail) {
+        len = avail;
+    }
+
+    offset = link->rx_head & SHM_LINK_MASK;
+    first = SHM_LINK_RING_SIZE - offset;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(buf, link->rx_data + offset, first);
+    memcpy(buf + first, link->rx_data, len - first);
+
+    link->rx_head += len;
+    __atomic_store_n(&link->rx->head, link->rx_head, __ATOMIC_RELEASE);
+
+    /* A writer waiting for room has some now */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&link->rx->writer_waiting, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&link->rx->writer_waiting, 0, __ATOMIC_ACQ_REL)) {
+        futex_wake(&link->rx->head);
+    }
+    return (int)len;
+}
+
+/**
+ * drain_doorbell - Consume doorbell bytes; notes end of stream
+ */
+static void drain_doorbell(shm_link_t *link)
+{
+    char bytes[64];
+    ssize_t n;
+
+    for (;;) {
+        n = recv(link->fd, bytes, sizeof(bytes), MSG_DONTWAIT);
+        if (n == (ssize_t)sizeof(bytes)) {
+            continue;
+        }
+        if (n > 0) {
+            return;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            link->peer_closed = TRUE;
+        }
+        return;
+    }
+}
+
+int shm_link_recv(shm_link_t *link, void *buf, uint32_t len)
+{
+    struct pollfd pfd;
+    int flags;
+    int n;
+
+    if (link == NULL || buf == NULL || len == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    for (;;) {
+        n = ring_read(link, (uint8_t *)buf, len);
+        if (n != 0) {
+            return n;
+        }
+
+        /* Empty: take the doorbell down, then ask for the next one.
+         * Data written before the flag was seen is found below. */
+        drain_doorbell(link);
+        __atomic_store_n(&link->rx->reader_waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        n = ring_read(link, (uint8_t *)buf, len);
+        if (n != 0) {
+            return n;
+        }
+        if (link->peer_closed) {
+            return 0;
+        }
+
+        flags = fcntl(link->fd, F_GETFL, 0);
+        if (flags < 0) {
+            return E_IO_ERROR;
+        }
+        if (flags & O_NONBLOCK) {
+            return E_WOULD_BLOCK;
+        }
+
+        pfd.fd = link->fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            return E_IO_ERROR;
+        }
+    }
+}
+
+int shm_link_pending(shm_link_t *link)
+{
+    if (link == NULL) {
+        return FALSE;
+    }
+    if (__atomic_load_n(&link->rx->tail, __ATOMIC_ACQUIRE) != link->rx_head) {
+        return TRUE;
+    }
+
+    /* Going back to poll(): the next write must ring */
+    __atomic_store_n(&link->rx->reader_waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&link->rx->tail, __ATOMIC_ACQUIRE) != link->rx_head;
+}
+
+/* ============================================================================
+ * Send
+ * ============================================================================ */
+
+/**
+ * publish - Make written bytes visible and ring a waiting reader
+ *
+ * Returns: 0, or E_IO_ERROR if the peer's socket is gone
+ */
+static int publish(shm_link_t *link)
+{
+    char byte = 0;
+    ssize_t n;
+
+    if (link->tx_tail == link->tx_published) {
+        return 0;
+    }
+    __atomic_store_n(&link->tx->tail, link->tx_tail, __ATOMIC_RELEASE);
+    link->tx_published = link->tx_tail;
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&link->tx->reader_waiting, __ATOMIC_RELAXED) ||
+        !__atomic_exchange_n(&link->tx->reader_waiting, 0, __ATOMIC_ACQ_REL)) {
+        return 0;
+    }
+
+    do {
+        n = send(link->fd, &byte, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+
+    /* A full socket already holds doorbells enough */
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        return E_IO_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * peer_hung_up - Whether the socket reports the peer gone
+ */
+static int peer_hung_up(shm_link_t *link)
+{
+    struct pollfd pfd;
+
+    if (link->peer_closed) {
+        return TRUE;
+    }
+    pfd.fd = link->fd;
+    pfd.events = 0;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0 &&
+           (pfd.revents & (POLLHUP | POLLERR | POLLNVAL));
+}
+
+/**
+ * wait_room - Sleep until the reader frees room in the send ring
+ *
+ * Returns: 0 once there is room, E_IO_ERROR if the reader is gone or
+ *          @deadline passed
+ */
+static int wait_room(shm_link_t *link, uint64_t deadline)
+{
+    uint32_t head;
+    uint64_t now;
+    int wait_ms;
+
+    for (;;) {
+        __atomic_store_n(&link->tx->writer_waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        head = __atomic_load_n(&link->tx->head, __ATOMIC_ACQUIRE);
+        if (link->tx_tail - head < SHM_LINK_RING_SIZE) {
+            return 0;
+        }
+        if (__atomic_load_n(&link->tx->reader_closed, __ATOMIC_ACQUIRE) ||
+            peer_hung_up(link)) {
+            return E_IO_ERROR;
+        }
+
+        now = latency_now_ms();
+        if (now >= deadline) {
+            return E_IO_ERROR;
+        }
+        wait_ms = (deadline - now < SHM_LINK_HANGUP_CHECK_MS)
+                  ? (int)(deadline - now) : SHM_LINK_HANGUP_CHECK_MS;
+        futex_wait(&link->tx->head, head, wait_ms);
+    }
+}
+
+int shm_link_sendv(shm_link_t *link, const struct iovec *iov, int iovcnt,
+                   int timeout_ms)
+{
+    const uint8_t *data;
+    uint64_t deadline = 0;
+    uint32_t room;
+    uint32_t chunk;
+    uint32_t offset;
+    uint32_t first;
+    size_t left;
+    int result;
+    int i;
+
+    if (link == NULL || (iov == NULL && iovcnt > 0)) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (__atomic_load_n(&link->tx->reader_closed, __ATOMIC_ACQUIRE)) {
+        return E_IO_ERROR;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        data = (const uint8_t *)iov[i].iov_base;
+        left = iov[i].iov_len;
+
+        while (left > 0) {
+            room = SHM_LINK_RING_SIZE -
+                   (link->tx_tail -
+                    __atomic_load_n(&link->tx->head, __ATOMIC_ACQUIRE));
+            if (room > SHM_LINK_RING_SIZE) {
+                return E_IO_ERROR;      /* Impossible reader index */
+            }
+            if (room == 0) {
+                /* Let the reader see what fits, then wait for it */
+                if (publish(link) != 0) {
+                    return E_IO_ERROR;
+                }
+                if (deadline == 0) {
+                    deadline = latency_now_ms() + (uint64_t)timeout_ms;
+                }
+                result = wait_room(link, deadline);
+                if (result != 0) {
+                    return result;
+                }
+                continue;
+            }
+
+            chunk = (left < room) ? (uint32_t)left : room;
+            offset = link->tx_tail & SHM_LINK_MASK;
+            first = SHM_LINK_RING_SIZE - offset;
+            if (first > chunk) {
+                first = chunk;
+            }
+            memcpy(link->tx_data + offset, data, first);
+            memcpy(link->tx_data, data + first, chunk - first);
+
+            link->tx_tail += chunk;
+            data += chunk;
+            left -= chunk;
+        }
+    }
+
+    return publish(link);
+}
+
+#else /* !SHM_LINK_AVAILABLE */
+
+int shm_link_listen(const char *path)
+{
+    (void)path;
+    return E_NOT_SUPPORTED;
+}
+
+void shm_link_close_listener(int fd, const char *path)
+{
+    (void)path;
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int shm_link_accept(int listen_fd, int *fd_out)
+{
+    (void)listen_fd;
+    if (fd_out != NULL) {
+        *fd_out = -1;
+    }
+    return E_NOT_SUPPORTED;
+}
+
+int shm_link_connect(const char *path, int *fd_out)
+{
+    (void)path;
+    if (fd_out != NULL) {
+        *fd_out = -1;
+    }
+    return E_NOT_SUPPORTED;
+}
+
+shm_link_t *shm_link_find(int fd)
+{
+    (void)fd;
+    return NULL;
+}
+
+int shm_link_recv(shm_link_t *link, void *buf, uint32_t len)
+{
+    (void)link;
+    (void)buf;
+    (void)len;
+    return E_NOT_SUPPORTED;
+}
+
+int shm_link_pending(shm_link_t *link)
+{
+    (void)link;
+    return FALSE;
+}
+
+int shm_link_sendv(shm_link_t *link, const struct iovec *iov, int iovcnt,
+                   int timeout_ms)
+{
+    (void)link;
+    (void)iov;
+    (void)iovcnt;
+    (void)timeout_ms;
+    return E_NOT_SUPPORTED;
+}
+
+void shm_link_close(int fd)
+{
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+#endif /* SHM_LINK_AVAILABLE */
@@ -0,0 +1,166 @@
+/**
+ * shm_link.h
+ *
+ * Same-host connections through shared memory (Linux).
+ *
+ * A client and server on one host need not pay for loopback TCP: no
+ * checksums, no segmentation, no copy through socket buffers. A link
+ * starts as a UNIX stream connection to the server's --shm path; the
+ * client then passes a sealed memfd holding one SPSC byte ring per
+ * direction, and from then on the wire stream of each direction goes
+ * through its ring. The UNIX socket stays as the link's descriptor:
+ *
+ *   doorbell  A reader about to sleep on an empty ring sets its waiting
+ *             flag; the writer clears it and sends one byte on the
+ *             socket. A busy reader is never woken, so a steady stream
+ *             costs no system calls at all.
+ *   hangup    The peer closing (or dying) reads as end of stream on the
+ *             socket, as it would on TCP.
+ *
+ * A writer finding its ring full sleeps on a futex on the reader's
+ * index, which the reader wakes once it consumed something.
+ *
+ * Links are looked up by descriptor (shm_link_find()), so binding the
+ * descriptor as a transport (xoe_transport_init_fd(), lib/net/transport.h)
+ * gives the link's rings to the wire layer wherever it is handed the
+ * descriptor. One difference from a socket remains: a partial read can
+ * leave bytes in the ring without the descriptor polling readable, so
+ * callers that read once per poll wakeup check xoe_transport_pending(),
+ * as for TLS records, and go back to poll() only once it returned FALSE.
+ *
+ * The server maps memory its client controls: ring indices read from
+ * it are checked, each side keeps its own index privately, and the
+ * memfd must be sealed against shrinking. Links are unencrypted; access
+ * is governed by the permissions of the socket path.
+ *
+ * Elsewhere than Linux every call fails with E_NOT_SUPPORTED.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SHM_LINK_H
+#define SHM_LINK_H
+
+#include "lib/common/types.h"
+
+#include <sys/uio.h>
+
+/* Ring bytes per direction (a power of two) */
+#define SHM_LINK_RING_SIZE (1024 * 1024)
+
+/* Milliseconds an accepted client has to pass its memory */
+#define SHM_LINK_SETUP_MS 1000
+
+/* Descriptors from 0 up to this may carry links */
+#define SHM_LINK_MAX_FD 65536
+
+/* Socket path buffer (fits sockaddr_un on every platform) */
+#define SHM_LINK_PATH_MAX 104
+
+/* Opaque link handle */
+typedef struct shm_link shm_link_t;
+
+/**
+ * shm_link_address - Whether a connect address names a same-host link
+ * @address: Address as given to -c ("shm:<path>" or "unix:<path>")
+ *
+ * Returns: The socket path, or NULL for a network address
+ */
+const char *shm_link_address(const char *address);
+
+/**
+ * shm_link_listen - Listen for links on a UNIX socket path
+ * @path: Socket path (a stale socket there is replaced)
+ *
+ * A socket is stale when connecting to it is refused; anything else at
+ * @path makes the call fail. Only the owner may connect (mode 0600).
+ *
+ * Returns: Listening descriptor, or E_INVALID_ARGUMENT,
+ *          E_PERMISSION_DENIED, E_NETWORK_ERROR, E_NOT_SUPPORTED
+ */
+int shm_link_listen(const char *path);
+
+/**
+ * shm_link_close_listener - Close a listener and remove its path
+ * @fd:   Descriptor from shm_link_listen() (ignored if negative)
+ * @path: Path it was opened on
+ */
+void shm_link_close_listener(int fd, const char *path);
+
+/**
+ * shm_link_accept - Accept a link and map the client's rings
+ * @listen_fd: Descriptor from shm_link_listen()
+ * @fd_out:    Receives the link's (blocking) descriptor
+ *
+ * Waits up to SHM_LINK_SETUP_MS for the client's memory.
+ *
+ * Returns: 0, E_TIMEOUT, E_PROTOCOL_ERROR for memory that is not a
+ *          valid sealed link, E_OUT_OF_MEMORY, E_NETWORK_ERROR
+ */
+int shm_link_accept(int listen_fd, int *fd_out);
+
+/**
+ * shm_link_connect - Connect to a server's link path
+ * @path:   Socket path
+ * @fd_out: Receives the link's (blocking) descriptor
+ *
+ * Returns: 0, E_INVALID_ARGUMENT, E_NETWORK_ERROR (errno set),
+ *          E_OUT_OF_MEMORY, E_NOT_SUPPORTED
+ */
+int shm_link_connect(const char *path, int *fd_out);
+
+/**
+ * shm_link_find - Link behind a descriptor
+ * @fd: Any descriptor
+ *
+ * One relaxed load while no link is open.
+ *
+ * Returns: Link, or NULL if @fd is a plain socket
+ */
+shm_link_t *shm_link_find(int fd);
+
+/**
+ * shm_link_recv - Read what the ring holds, up to @len bytes
+ * @link: Link
+ * @buf:  Destination
+ * @len:  Its size (> 0)
+ *
+ * Like recv(): an empty ring waits while the descriptor is blocking.
+ *
+ * Returns: Bytes read, 0 once the peer closed and the ring is empty,
+ *          E_WOULD_BLOCK (non-blocking, nothing there), E_IO_ERROR
+ */
+int shm_link_recv(shm_link_t *link, void *buf, uint32_t len);
+
+/**
+ * shm_link_pending - Whether the receive ring holds bytes
+ * @link: Link (NULL is a socket: FALSE)
+ *
+ * An empty ring asks the writer for a doorbell, so once this returns
+ * FALSE the descriptor polls readable when data arrives.
+ */
+int shm_link_pending(shm_link_t *link);
+
+/**
+ * shm_link_sendv - Copy a whole iovec array into the send ring
+ * @link:       Link
+ * @iov:        Data
+ * @iovcnt:     Entries
+ * @timeout_ms: Longest wait for room in a full ring
+ *
+ * Returns: 0, or E_IO_ERROR if the peer is gone or did not make room
+ *          in time
+ */
+int shm_link_sendv(shm_link_t *link, const struct iovec *iov, int iovcnt,
+                   int timeout_ms);
+
+/**
+ * shm_link_close - Close a descriptor, and its link if it has one
+ * @fd: Any descriptor (ignored if negative)
+ *
+ * Every descriptor that may carry a link must be closed this way, so
+ * the descriptor number does not keep a stale link when reused.
+ */
+void shm_link_close(int fd);
+
+#endif /* SHM_LINK_H */
@@ -0,0 +1,158 @@
+/**
+ * sock_tune.c
+ *
+ * Socket tuning presets and their application. Options the platform does
+ * not define are compiled out; options the kernel refuses (for example
+ * SO_BUSY_POLL without CAP_NET_ADMIN on older kernels) are skipped and
+ * reported through the return value without affecting the others.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "sock_tune.h"
+#include "lib/common/definitions.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/**
+ * set_int_opt - setsockopt() for an int option, TRUE on success
+ */
+static int set_int_opt(int fd, int level, int name, int value) {
+    return setsockopt(fd, level, name, &value, sizeof(value)) == 0;
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+void sock_tune_preset(sock_tune_t *tune, sock_tune_profile_t profile) {
+    if (tune == NULL) {
+        return;
+    }
+
+    memset(tune, 0, sizeof(*tune));
+    tune->profile = profile;
+
+    switch (profile) {
+        case SOCK_TUNE_LOW_LATENCY:
+            tune->nodelay = TRUE;
+            tune->keepalive = TRUE;
+            tune->keepidle_s = SOCK_TUNE_KEEPIDLE_S;
+            tune->keepintvl_s = SOCK_TUNE_KEEPINTVL_S;
+            tune->keepcnt = SOCK_TUNE_KEEPCNT;
+            tune->user_timeout_ms = (SOCK_TUNE_KEEPIDLE_S +
+                                     SOCK_TUNE_KEEPINTVL_S * SOCK_TUNE_KEEPCNT) *
+                                    1000;
+            break;
+        case SOCK_TUNE_BULK:
+            tune->sndbuf = SOCK_TUNE_BULK_BUFFER;
+            tune->rcvbuf = SOCK_TUNE_BULK_BUFFER;
+            tune->keepalive = TRUE;
+            tune->keepidle_s = SOCK_TUNE_KEEPIDLE_S;
+            tune->keepintvl_s = SOCK_TUNE_KEEPINTVL_S;
+            tune->keepcnt = SOCK_TUNE_KEEPCNT;
+            break;
+        case SOCK_TUNE_SYSTEM:
+        default:
+            break;
+    }
+}
+
+int sock_tune_parse_profile(const char *name, sock_tune_profile_t *profile) {
+    if (name == NULL || profile == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (strcmp(name, "low-latency") == 0) {
+        *profile = SOCK_TUNE_LOW_LATENCY;
+    } else if (strcmp(name, "bulk") == 0) {
+        *profile = SOCK_TUNE_BULK;
+    } else if (strcmp(name, "system") == 0) {
+        *profile = SOCK_TUNE_SYSTEM;
+    } else {
+        return E_INVALID_ARGUMENT;
+    }
+    return 0;
+}
+
+const char *sock_tune_profile_name(sock_tune_profile_t profile) {
+    switch (profile) {
+        case SOCK_TUNE_LOW_LATENCY:
+            return "low-latency";
+        case SOCK_TUNE_BULK:
+            return "bulk";
+        case SOCK_TUNE_SYSTEM:
+            return "system";
+        default:
+            return "unknown";
+    }
+}
+
+int sock_tune_apply(int fd, const sock_tune_t *tune) {
+    int ok = TRUE;
+
+    if (fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (tune == NULL) {
+        return 0;
+    }
+
+    if (tune->nodelay) {
+        ok &= set_int_opt(fd, IPPROTO_TCP, TCP_NODELAY, 1);
+    }
+    if (tune->sndbuf > 0) {
+        ok &= set_int_opt(fd, SOL_SOCKET, SO_SNDBUF, tune->sndbuf);
+    }
+    if (tune->rcvbuf > 0) {
+        ok &= set_int_opt(fd, SOL_SOCKET, SO_RCVBUF, tune->rcvbuf);
+    }
+
+    if (tune->keepalive) {
+        ok &= set_int_opt(fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+#if defined(TCP_KEEPIDLE)
+        if (tune->keepidle_s > 0) {
+            ok &= set_int_opt(fd, IPPROTO_TCP, TCP_KEEPIDLE, tune->keepidle_s);
+        }
+#elif defined(TCP_KEEPALIVE)
+        if (tune->keepidle_s > 0) {
+            ok &= set_int_opt(fd, IPPROTO_TCP, TCP_KEEPALIVE, tune->keepidle_s);
+        }
+#endif
+#if defined(TCP_KEEPINTVL)
+        if (tune->keepintvl_s > 0) {
+            ok &= set_int_opt(fd, IPPROTO_TCP, TCP_KEEPINTVL,
+                              tune->keepintvl_s);
+        }
+#endif
+#if defined(TCP_KEEPCNT)
+        if (tune->keepcnt > 0) {
+            ok &= set_int_opt(fd, IPPROTO_TCP, TCP_KEEPCNT, tune->keepcnt);
+        }
+#endif
+    }
+
+#if defined(TCP_USER_TIMEOUT)
+    if (tune->user_timeout_ms > 0) {
+        ok &= set_int_opt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT,
+                          tune->user_timeout_ms);
+    }
+#endif
+
+#if defined(SO_BUSY_POLL)
+    if (tune->busy_poll_us > 0) {
+        ok &= set_int_opt(fd, SOL_SOCKET, SO_BUSY_POLL, tune->busy_poll_us);
+    }
+#endif
+
+#if defined(SO_ZEROCOPY)
+    if (tune->zerocopy) {
+        ok &= set_int_opt(fd, SOL_SOCKET, SO_ZEROCOPY, 1);
+    }
+#endif
+
+    return ok ? 0 : E_NETWORK_ERROR;
+}
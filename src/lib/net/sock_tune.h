@@ -0,0 +1,112 @@
+/**
+ * sock_tune.h
+ *
+ * TCP socket tuning profiles for XOE.
+ *
+ * XOE traffic is mostly small frames (serial chunks, URB requests and
+ * completions) that wait on each other, which is the worst case for
+ * Nagle's algorithm combined with delayed ACKs. A sock_tune_t collects
+ * the options worth setting on every data socket and is applied
+ * wherever one is created: listening and accepted server sockets and
+ * the client connects in net_resolve_connect_tuned().
+ *
+ * Presets:
+ *   low-latency  TCP_NODELAY, keepalive with a short probe schedule and a
+ *                matching TCP_USER_TIMEOUT, so dead peers are noticed in
+ *                well under a minute; kernel buffer sizes (default)
+ *   bulk         Nagle left on, 1 MiB send/receive buffers, keepalive
+ *   system       Touch nothing (kernel defaults)
+ *
+ * SO_BUSY_POLL is off in every preset; it trades a CPU spinning in the
+ * receive path for lower wakeup latency and is meant for a few
+ * latency-critical control links (--busy-poll).
+ *
+ * SO_ZEROCOPY is off in every preset too (--zerocopy): it only pays for
+ * payloads of tens of kilobytes, and costs a completion per send.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef SOCK_TUNE_H
+#define SOCK_TUNE_H
+
+/* Send/receive buffer size of the bulk preset */
+#define SOCK_TUNE_BULK_BUFFER (1024 * 1024)
+
+/* Largest send/receive buffer size accepted (mgmt "set rcvbuf/sndbuf") */
+#define SOCK_TUNE_MAX_BUFFER (64 * 1024 * 1024)
+
+/* Keepalive schedule of the low-latency and bulk presets */
+#define SOCK_TUNE_KEEPIDLE_S   30   /* Idle time before the first probe */
+#define SOCK_TUNE_KEEPINTVL_S  10   /* Between probes */
+#define SOCK_TUNE_KEEPCNT      3    /* Unanswered probes before reset */
+
+/* Longest SO_BUSY_POLL accepted (microseconds) */
+#define SOCK_TUNE_MAX_BUSY_POLL_US 10000
+
+/**
+ * Tuning presets
+ */
+typedef enum {
+    SOCK_TUNE_LOW_LATENCY = 0,
+    SOCK_TUNE_BULK,
+    SOCK_TUNE_SYSTEM
+} sock_tune_profile_t;
+
+/**
+ * Socket options to apply (0 = leave the kernel default)
+ */
+typedef struct {
+    sock_tune_profile_t profile;    /* Preset these values came from */
+    int nodelay;                    /* TCP_NODELAY */
+    int sndbuf;                     /* SO_SNDBUF bytes */
+    int rcvbuf;                     /* SO_RCVBUF bytes */
+    int keepalive;                  /* SO_KEEPALIVE */
+    int keepidle_s;                 /* TCP_KEEPIDLE (TCP_KEEPALIVE on macOS) */
+    int keepintvl_s;                /* TCP_KEEPINTVL */
+    int keepcnt;                    /* TCP_KEEPCNT */
+    int user_timeout_ms;            /* TCP_USER_TIMEOUT (Linux) */
+    int busy_poll_us;               /* SO_BUSY_POLL (Linux) */
+    int zerocopy;                   /* SO_ZEROCOPY (Linux): large frames are
+                                       sent with MSG_ZEROCOPY where the
+                                       connection's owner tracks completions
+                                       (lib/protocol/wire_zerocopy.h) */
+} sock_tune_t;
+
+/**
+ * sock_tune_preset - Fill options from a preset
+ * @tune:    Options to fill
+ * @profile: Preset
+ */
+void sock_tune_preset(sock_tune_t *tune, sock_tune_profile_t profile);
+
+/**
+ * sock_tune_parse_profile - Parse "low-latency", "bulk" or "system"
+ * @name:    Preset name
+ * @profile: Receives the preset
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT for an unknown name
+ */
+int sock_tune_parse_profile(const char *name, sock_tune_profile_t *profile);
+
+/**
+ * sock_tune_profile_name - Name of a preset
+ */
+const char *sock_tune_profile_name(sock_tune_profile_t profile);
+
+/**
+ * sock_tune_apply - Set the options on a TCP socket
+ * @fd:   Socket (listening, accepted or not yet connected)
+ * @tune: Options (NULL: nothing is changed)
+ *
+ * Buffer sizes should be set before connect()/listen() so the kernel can
+ * pick a matching window scale; accepted sockets inherit them from the
+ * listener. Every option is attempted even if an earlier one fails, and
+ * options the platform lacks are skipped.
+ *
+ * Returns: 0 if every option was set, E_NETWORK_ERROR if any was refused
+ *          (the socket stays usable), E_INVALID_ARGUMENT for a bad fd
+ */
+int sock_tune_apply(int fd, const sock_tune_t *tune);
+
+#endif /* SOCK_TUNE_H */
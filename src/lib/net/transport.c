@@ -0,0 +1,946 @@
+/**
+ * transport.c
+ *
+ * The transport kinds of transport.h. Stream writes loop over partial
+ * writes on a private copy of the caller's iovec array and, when a
+ * non-blocking socket is full, wait on the descriptor or append the rest
+ * to the transport's queue; reads are single calls whose EAGAIN and
+ * SSL_ERROR_WANT_* map to E_WOULD_BLOCK.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "transport.h"
+#include "shm_link.h"
+#include "lib/common/definitions.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/stage_prof.h"
+#include "lib/security/tls_config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#if TLS_ENABLED
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include "lib/security/tls_session.h"
+#endif
+
+/* ========================================================================
+ * Shared helpers
+ * ======================================================================== */
+
+/**
+ * wait_fd_ready - Wait until a non-blocking socket is ready again
+ * @fd:     Socket
+ * @events: POLLIN or POLLOUT
+ *
+ * Returns: 0 when ready, E_IO_ERROR on timeout or hangup
+ */
+static int wait_fd_ready(int fd, short events) {
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    do {
+        ret = poll(&pfd, 1, XOE_TRANSPORT_SEND_TIMEOUT_MS);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret <= 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+        return E_IO_ERROR;
+    }
+    return 0;
+}
+
+/**
+ * check_iov - Validate a caller's iovec array
+ */
+static int check_iov(const struct iovec *iov, int iovcnt) {
+    int i;
+
+    if (iov == NULL || iovcnt <= 0 || iovcnt > XOE_TRANSPORT_MAX_IOV) {
+        return E_INVALID_ARGUMENT;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_base == NULL && iov[i].iov_len > 0) {
+            return E_INVALID_ARGUMENT;
+        }
+    }
+    return 0;
+}
+
+/**
+ * queue_append - Copy buffers to the end of a queue
+ * @queue:  Queue
+ * @iov:    Buffers
+ * @iovcnt: Entries
+ *
+ * Queued bytes are moved to the front before the buffer grows; OpenSSL
+ * accepts a moved retry (SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER).
+ *
+ * Returns: 0, or E_OUT_OF_MEMORY (nothing queued)
+ */
+static int queue_append(xoe_transport_queue_t *queue, const struct iovec *iov,
+                        int iovcnt) {
+    size_t total = 0;
+    size_t size;
+    uint8_t *data;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    if (total > queue->size - queue->start - queue->len) {
+        if (queue->start > 0) {
+            memmove(queue->data, queue->data + queue->start, queue->len);
+            queue->start = 0;
+        }
+        if (total > queue->size - queue->len) {
+            size = (queue->size > 0) ? queue->size : XOE_TRANSPORT_QUEUE_KEEP;
+            while (size < queue->len + total) {
+                size *= 2;
+            }
+            data = (uint8_t *)realloc(queue->data, size);
+            if (data == NULL) {
+                return E_OUT_OF_MEMORY;
+            }
+            mem_budget_charge(size - queue->size);
+            queue->data = data;
+            queue->size = size;
+        }
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > 0) {
+            memcpy(queue->data + queue->start + queue->len, iov[i].iov_base,
+                   iov[i].iov_len);
+            queue->len += iov[i].iov_len;
+        }
+    }
+    return 0;
+}
+
+/**
+ * queue_put - Copy one buffer to the end of a queue
+ */
+static int queue_put(xoe_transport_queue_t *queue, const void *data,
+                     size_t len) {
+    struct iovec iov;
+
+    iov.iov_base = (void *)data;
+    iov.iov_len = len;
+    return queue_append(queue, &iov, 1);
+}
+
+/**
+ * queue_consume - Drop bytes the socket has taken from a queue's front
+ *
+ * An emptied queue keeps a small buffer for the next backlog.
+ */
+static void queue_consume(xoe_transport_queue_t *queue, size_t len) {
+    queue->start += len;
+    queue->len -= len;
+    if (queue->len > 0) {
+        return;
+    }
+    queue->start = 0;
+    if (queue->size > XOE_TRANSPORT_QUEUE_KEEP) {
+        xoe_transport_queue_free(queue);
+    }
+}
+
+/**
+ * sendmsg_all - Send a whole iovec array on a stream socket
+ * @fd:     Socket
+ * @iov:    Buffers (copied; the caller's array is not modified)
+ * @iovcnt: Entries (checked by the caller)
+ * @queue:  Takes what a full socket does not, or NULL to wait for room
+ *
+ * Returns: 0, E_OUT_OF_MEMORY (queue), or E_IO_ERROR
+ */
+static int sendmsg_all(int fd, const struct iovec *iov, int iovcnt,
+                       xoe_transport_queue_t *queue) {
+    struct iovec local[XOE_TRANSPORT_MAX_IOV];
+    struct iovec *next = local;
+    struct msghdr msg;
+    ssize_t sent;
+
+    memcpy(local, iov, (size_t)iovcnt * sizeof(struct iovec));
+
+    while (iovcnt > 0) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = next;
+        msg.msg_iovlen = iovcnt;
+
+        sent = sendmsg(fd, &msg, 0);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (queue != NULL) {
+                return queue_append(queue, next, iovcnt);
+            }
+            if (wait_fd_ready(fd, POLLOUT) != 0) {
+                return E_IO_ERROR;
+            }
+            continue;
+        }
+        if (sent <= 0) {
+            return E_IO_ERROR;
+        }
+
+        /* Skip fully written entries, trim the partially written one */
+        while (iovcnt > 0 && (size_t)sent >= next->iov_len) {
+            sent -= (ssize_t)next->iov_len;
+            next++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            next->iov_base = (uint8_t *)next->iov_base + sent;
+            next->iov_len -= (size_t)sent;
+        }
+    }
+    return 0;
+}
+
+static int no_flush(xoe_transport_t *t) {
+    (void)t;
+    return 0;
+}
+
+static int fd_of(const xoe_transport_t *t) {
+    return t->fd;
+}
+
+static int nothing_pending(xoe_transport_t *t) {
+    (void)t;
+    return FALSE;
+}
+
+/* ========================================================================
+ * tcp
+ * ======================================================================== */
+
+static int tcp_readv(xoe_transport_t *t, const struct iovec *iov, int iovcnt) {
+    struct msghdr msg;
+    ssize_t received;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+
+    do {
+        received = recvmsg(t->fd, &msg, 0);
+    } while (received < 0 && errno == EINTR);
+
+    if (received < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? E_WOULD_BLOCK
+                                                         : E_IO_ERROR;
+    }
+    return (int)received;
+}
+
+static int tcp_writev(xoe_transport_t *t, const struct iovec *iov,
+                      int iovcnt) {
+    return sendmsg_all(t->fd, iov, iovcnt, t->queue);
+}
+
+/**
+ * tcp_flush - Send queued bytes until the socket is full
+ */
+static int tcp_flush(xoe_transport_t *t) {
+    xoe_transport_queue_t *queue = t->queue;
+    ssize_t sent;
+
+    while (queue != NULL && queue->len > 0) {
+        sent = send(t->fd, queue->data + queue->start, queue->len, 0);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return E_WOULD_BLOCK;
+        }
+        if (sent <= 0) {
+            return E_IO_ERROR;
+        }
+        queue_consume(queue, (size_t)sent);
+    }
+    return 0;
+}
+
+static const xoe_transport_ops_t tcp_ops = {
+    "tcp", tcp_readv, tcp_writev, tcp_flush, fd_of, nothing_pending
+};
+
+/* ========================================================================
+ * shm
+ * ======================================================================== */
+
+static int shm_readv(xoe_transport_t *t, const struct iovec *iov, int iovcnt) {
+    int total = 0;
+    int received;
+    int i;
+
+    /* Later entries only while the ring keeps filling the earlier ones */
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        if (total > 0 && !shm_link_pending(t->link)) {
+            break;
+        }
+        received = shm_link_recv(t->link, iov[i].iov_base,
+                                 (uint32_t)iov[i].iov_len);
+        if (received <= 0) {
+            return (total > 0) ? total : received;
+        }
+        total += received;
+        if ((size_t)received < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
+static int shm_writev(xoe_transport_t *t, const struct iovec *iov,
+                      int iovcnt) {
+    return shm_link_sendv(t->link, iov, iovcnt, XOE_TRANSPORT_SEND_TIMEOUT_MS);
+}
+
+static int shm_pending(xoe_transport_t *t) {
+    return shm_link_pending(t->link);
+}
+
+static const xoe_transport_ops_t shm_ops = {
+    "shm", shm_readv, shm_writev, no_flush, fd_of, shm_pending
+};
+
+/* ========================================================================
+ * tls and ktls
+ * ======================================================================== */
+
+#if TLS_ENABLED
+/**
+ * ssl_read_result - Map a failed SSL_read()
+ */
+static int ssl_read_result(SSL *ssl, int result) {
+    switch (SSL_get_error(ssl, result)) {
+        case SSL_ERROR_WANT_READ:
+        case SSL_ERROR_WANT_WRITE:
+            return E_WOULD_BLOCK;
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        default:
+            /* Leave no stale entries in this thread's error queue */
+            ERR_clear_error();
+            return E_IO_ERROR;
+    }
+}
+
+static int tls_readv(xoe_transport_t *t, const struct iovec *iov, int iovcnt) {
+    SSL *ssl = (SSL *)t->ssl;
+    int total = 0;
+    int received;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+        if (total > 0 && SSL_pending(ssl) <= 0) {
+            break;
+        }
+        received = SSL_read(ssl, iov[i].iov_base, (int)iov[i].iov_len);
+        if (received <= 0) {
+            return (total > 0) ? total : ssl_read_result(ssl, received);
+        }
+        total += received;
+        if ((size_t)received < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
+/**
+ * ssl_write_all - Write a buffer through OpenSSL
+ *
+ * Non-blocking sockets are waited on and the write retried with the same
+ * arguments, as OpenSSL requires. With a queue, the unwritten rest is
+ * queued instead: tls_flush() offers it again from its first byte.
+ */
+static int ssl_write_all(xoe_transport_t *t, const void *buffer, size_t len) {
+    SSL *ssl = (SSL *)t->ssl;
+    const uint8_t *buf = (const uint8_t *)buffer;
+    size_t total = 0;
+    int sent;
+    int ssl_error;
+
+    while (total < len) {
+        sent = SSL_write(ssl, buf + total, (int)(len - total));
+        if (sent <= 0) {
+            ssl_error = SSL_get_error(ssl, sent);
+            if (t->queue != NULL && (ssl_error == SSL_ERROR_WANT_WRITE ||
+                                     ssl_error == SSL_ERROR_WANT_READ)) {
+                return queue_put(t->queue, buf + total, len - total);
+            }
+            if (ssl_error == SSL_ERROR_WANT_WRITE) {
+                if (wait_fd_ready(SSL_get_fd(ssl), POLLOUT) != 0) {
+                    return E_IO_ERROR;
+                }
+                continue;
+            }
+            if (ssl_error == SSL_ERROR_WANT_READ) {
+                if (wait_fd_ready(SSL_get_fd(ssl), POLLIN) != 0) {
+                    return E_IO_ERROR;
+                }
+                continue;
+            }
+            ERR_clear_error();
+            return E_IO_ERROR;
+        }
+        total += (size_t)sent;
+    }
+    return 0;
+}
+
+/**
+ * tls_put - Write through OpenSSL, or queue behind bytes already queued
+ */
+static int tls_put(xoe_transport_t *t, const void *buffer, size_t len) {
+    if (t->queue != NULL && t->queue->len > 0) {
+        return queue_put(t->queue, buffer, len);
+    }
+    return ssl_write_all(t, buffer, len);
+}
+
+/**
+ * tls_writev - Send buffers as few, full TLS records as possible
+ *
+ * Small buffers are coalesced into one record-sized staging buffer; a
+ * buffer that would fill whole records on its own is written directly.
+ */
+static int tls_writev(xoe_transport_t *t, const struct iovec *iov,
+                      int iovcnt) {
+    uint8_t record[XOE_TRANSPORT_TLS_RECORD_SIZE];
+    size_t used = 0;
+    const uint8_t *data;
+    size_t len;
+    size_t take;
+    int result;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        data = (const uint8_t *)iov[i].iov_base;
+        len = iov[i].iov_len;
+
+        while (len > 0) {
+            if (used == 0 && len >= sizeof(record)) {
+                result = tls_put(t, data, len);
+                if (result != 0) {
+                    return result;
+                }
+                break;
+            }
+
+            take = sizeof(record) - used;
+            if (take > len) {
+                take = len;
+            }
+            memcpy(record + used, data, take);
+            used += take;
+            data += take;
+            len -= take;
+
+            if (used == sizeof(record)) {
+                result = tls_put(t, record, used);
+                if (result != 0) {
+                    return result;
+                }
+                used = 0;
+            }
+        }
+    }
+
+    if (used > 0) {
+        return tls_put(t, record, used);
+    }
+    return 0;
+}
+
+/**
+ * tls_flush - Send queued bytes until the socket is full
+ *
+ * Partial writes return after each record, and every retry offers at
+ * least the bytes of the one OpenSSL could not finish, from the same
+ * first byte.
+ */
+static int tls_flush(xoe_transport_t *t) {
+    xoe_transport_queue_t *queue = t->queue;
+    SSL *ssl = (SSL *)t->ssl;
+    size_t len;
+    int sent;
+    int ssl_error;
+
+    while (queue != NULL && queue->len > 0) {
+        len = (queue->len > INT_MAX) ? INT_MAX : queue->len;
+        sent = SSL_write(ssl, queue->data + queue->start, (int)len);
+        if (sent <= 0) {
+            ssl_error = SSL_get_error(ssl, sent);
+            if (ssl_error == SSL_ERROR_WANT_WRITE ||
+                ssl_error == SSL_ERROR_WANT_READ) {
+                return E_WOULD_BLOCK;
+            }
+            ERR_clear_error();
+            return E_IO_ERROR;
+        }
+        queue_consume(queue, (size_t)sent);
+    }
+    return 0;
+}
+
+static int tls_pending(xoe_transport_t *t) {
+    return SSL_pending((SSL *)t->ssl) > 0;
+}
+
+static const xoe_transport_ops_t tls_ops = {
+    "tls", tls_readv, tls_writev, tls_flush, fd_of, tls_pending
+};
+
+/* The kernel builds the records, so no staging copy */
+static const xoe_transport_ops_t ktls_ops = {
+    "ktls", tls_readv, tcp_writev, tcp_flush, fd_of, tls_pending
+};
+#endif
+
+/* ========================================================================
+ * udp
+ * ======================================================================== */
+
+static int udp_readv(xoe_transport_t *t, const struct iovec *iov, int iovcnt) {
+    struct msghdr msg;
+    ssize_t received;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+
+    do {
+        received = recvmsg(t->fd, &msg, MSG_DONTWAIT);
+    } while (received < 0 && errno == EINTR);
+
+    if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return E_WOULD_BLOCK;
+        }
+        if (errno == ECONNREFUSED || errno == EHOSTUNREACH ||
+            errno == ENETUNREACH) {
+            return E_NETWORK_ERROR;
+        }
+        return E_IO_ERROR;
+    }
+
+    if (received == 0 || (msg.msg_flags & MSG_TRUNC)) {
+        return E_PROTOCOL_ERROR;
+    }
+    return (int)received;
+}
+
+static int udp_writev(xoe_transport_t *t, const struct iovec *iov,
+                      int iovcnt) {
+    struct msghdr msg;
+    ssize_t sent;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+
+    do {
+        sent = sendmsg(t->fd, &msg, 0);
+    } while (sent < 0 && errno == EINTR);
+
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ||
+            errno == ECONNREFUSED) {
+            return 0;   /* Dropped, as the network might have */
+        }
+        return E_NETWORK_ERROR;
+    }
+    return 0;
+}
+
+static const xoe_transport_ops_t udp_ops = {
+    "udp", udp_readv, udp_writev, no_flush, fd_of, nothing_pending
+};
+
+#if TLS_ENABLED
+static int dtls_readv(xoe_transport_t *t, const struct iovec *iov,
+                      int iovcnt) {
+    SSL *ssl = (SSL *)t->ssl;
+    int received;
+
+    (void)iovcnt;
+    received = SSL_read(ssl, iov[0].iov_base, (int)iov[0].iov_len);
+    if (received > 0) {
+        return received;
+    }
+    return ssl_read_result(ssl, received);
+}
+
+static int dtls_writev(xoe_transport_t *t, const struct iovec *iov,
+                       int iovcnt) {
+    SSL *ssl = (SSL *)t->ssl;
+    uint8_t datagram[XOE_TRANSPORT_DGRAM_MAX];
+    const void *data = iov[0].iov_base;
+    size_t len = iov[0].iov_len;
+    int written;
+    int i;
+
+    /* One SSL_write() is one record is one datagram */
+    if (iovcnt > 1) {
+        len = 0;
+        for (i = 0; i < iovcnt; i++) {
+            if (iov[i].iov_len > sizeof(datagram) - len) {
+                return E_INVALID_ARGUMENT;
+            }
+            memcpy(datagram + len, iov[i].iov_base, iov[i].iov_len);
+            len += iov[i].iov_len;
+        }
+        data = datagram;
+    }
+
+    written = SSL_write(ssl, data, (int)len);
+    if (written <= 0) {
+        if (SSL_get_error(ssl, written) == SSL_ERROR_WANT_WRITE) {
+            return 0;
+        }
+        ERR_clear_error();
+        return E_IO_ERROR;
+    }
+    return 0;
+}
+
+static const xoe_transport_ops_t dtls_ops = {
+    "dtls", dtls_readv, dtls_writev, no_flush, fd_of, tls_pending
+};
+#endif
+
+/* ========================================================================
+ * Binding and dispatch
+ * ======================================================================== */
+
+/**
+ * xoe_transport_init_fd - Bind a stream descriptor
+ */
+int xoe_transport_init_fd(xoe_transport_t *t, int fd) {
+    if (t == NULL || fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    t->fd = fd;
+    t->ssl = NULL;
+    t->batch = NULL;
+    t->queue = NULL;
+    t->link = shm_link_find(fd);
+    t->ops = (t->link != NULL) ? &shm_ops : &tcp_ops;
+    return 0;
+}
+
+/**
+ * xoe_transport_init_tls - Bind a TLS session
+ */
+int xoe_transport_init_tls(xoe_transport_t *t, void *ssl) {
+    if (t == NULL || ssl == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+#if TLS_ENABLED
+    t->fd = SSL_get_fd((SSL *)ssl);
+    t->ssl = ssl;
+    t->link = NULL;
+    t->batch = NULL;
+    t->queue = NULL;
+    t->ops = (tls_session_ktls_status((SSL *)ssl) & TLS_KTLS_TX)
+             ? &ktls_ops : &tls_ops;
+    return 0;
+#else
+    return E_NOT_SUPPORTED;
+#endif
+}
+
+/**
+ * xoe_transport_init_udp - Bind a connected datagram socket
+ */
+int xoe_transport_init_udp(xoe_transport_t *t, int fd, void *ssl) {
+    if (t == NULL || fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    t->fd = fd;
+    t->ssl = ssl;
+    t->link = NULL;
+    t->batch = NULL;
+    t->queue = NULL;
+    t->ops = &udp_ops;
+    if (ssl != NULL) {
+#if TLS_ENABLED
+        t->ops = &dtls_ops;
+#else
+        return E_NOT_SUPPORTED;
+#endif
+    }
+    return 0;
+}
+
+/**
+ * xoe_transport_readv - Read once into @iov
+ */
+int xoe_transport_readv(xoe_transport_t *t, const struct iovec *iov,
+                        int iovcnt) {
+    STAGE_PROF_VAR(start);
+    int result;
+
+    if (t == NULL || t->ops == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    result = check_iov(iov, iovcnt);
+    if (result != 0) {
+        return result;
+    }
+    STAGE_PROF_START(start);
+    result = t->ops->readv(t, iov, iovcnt);
+    STAGE_PROF_STOP(STAGE_RECV_SYSCALL, start);
+    return result;
+}
+
+/**
+ * write_through - Hand buffers to the kind, behind any queued bytes
+ *
+ * While bytes are queued nothing is sent ahead of them; flush() sends
+ * the queue once the socket polls writable.
+ */
+static int write_through(xoe_transport_t *t, const struct iovec *iov,
+                         int iovcnt) {
+    STAGE_PROF_VAR(start);
+    int result;
+
+    if (t->queue != NULL && t->queue->len > 0) {
+        return queue_append(t->queue, iov, iovcnt);
+    }
+
+    STAGE_PROF_START(start);
+    result = t->ops->writev(t, iov, iovcnt);
+    STAGE_PROF_STOP(STAGE_SEND_SYSCALL, start);
+    return result;
+}
+
+/**
+ * batch_write - Write out a corked transport's gathered bytes
+ *
+ * The batch is empty afterwards, whether or not the write succeeded.
+ */
+static int batch_write(xoe_transport_t *t) {
+    struct iovec iov;
+
+    if (t->batch->len == 0) {
+        return 0;
+    }
+    iov.iov_base = t->batch->data;
+    iov.iov_len = t->batch->len;
+    t->batch->len = 0;
+
+    return write_through(t, &iov, 1);
+}
+
+/**
+ * batch_gather - Copy @iov into a corked transport's batch if it fits
+ *
+ * Returns: TRUE if gathered, FALSE if too large (nothing copied)
+ */
+static int batch_gather(xoe_transport_t *t, const struct iovec *iov,
+                        int iovcnt) {
+    size_t total = 0;
+    int i;
+
+    for (i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+    if (total > sizeof(t->batch->data) - t->batch->len) {
+        return FALSE;
+    }
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len > 0) {
+            memcpy(t->batch->data + t->batch->len, iov[i].iov_base,
+                   iov[i].iov_len);
+            t->batch->len += iov[i].iov_len;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * xoe_transport_writev - Write all of @iov
+ */
+int xoe_transport_writev(xoe_transport_t *t, const struct iovec *iov,
+                         int iovcnt) {
+    int result;
+
+    if (t == NULL || t->ops == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    result = check_iov(iov, iovcnt);
+    if (result != 0) {
+        return result;
+    }
+
+    /* Corked: gather, making room (or going straight through) if needed */
+    if (t->batch != NULL) {
+        if (batch_gather(t, iov, iovcnt)) {
+            return 0;
+        }
+        result = batch_write(t);
+        if (result != 0) {
+            return result;
+        }
+        if (batch_gather(t, iov, iovcnt)) {
+            return 0;
+        }
+    }
+
+    return write_through(t, iov, iovcnt);
+}
+
+/**
+ * xoe_transport_flush - Push out what the transport still holds
+ */
+int xoe_transport_flush(xoe_transport_t *t) {
+    int result;
+
+    if (t == NULL || t->ops == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (t->batch != NULL) {
+        result = batch_write(t);
+        if (result != 0) {
+            return result;
+        }
+    }
+    return t->ops->flush(t);
+}
+
+/**
+ * is_stream - Whether the kind writes a byte stream to its descriptor
+ *
+ * shm links are left out: their rings already take writes without a
+ * system call.
+ */
+static int is_stream(const xoe_transport_t *t) {
+#if TLS_ENABLED
+    if (t->ops == &tls_ops || t->ops == &ktls_ops) {
+        return TRUE;
+    }
+#endif
+    return t->ops == &tcp_ops;
+}
+
+/**
+ * xoe_transport_set_queue - Queue what a full socket does not take
+ */
+int xoe_transport_set_queue(xoe_transport_t *t, xoe_transport_queue_t *queue) {
+    if (t == NULL || t->ops == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (!is_stream(t)) {
+        return E_NOT_SUPPORTED;
+    }
+#if TLS_ENABLED
+    if (queue != NULL && t->ssl != NULL) {
+        SSL_set_mode((SSL *)t->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                                    SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    }
+#endif
+    t->queue = queue;
+    return 0;
+}
+
+/**
+ * xoe_transport_queued - Bytes waiting in the outbound queue
+ */
+size_t xoe_transport_queued(const xoe_transport_t *t) {
+    return (t != NULL && t->queue != NULL) ? t->queue->len : 0;
+}
+
+/**
+ * xoe_transport_queue_free - Release a queue's buffer
+ */
+void xoe_transport_queue_free(xoe_transport_queue_t *queue) {
+    if (queue == NULL) {
+        return;
+    }
+    free(queue->data);
+    mem_budget_uncharge(queue->size);
+    memset(queue, 0, sizeof(*queue));
+}
+
+/**
+ * xoe_transport_cork - Gather writes until the transport is uncorked
+ */
+int xoe_transport_cork(xoe_transport_t *t, xoe_transport_batch_t *batch) {
+    if (t == NULL || t->ops == NULL || batch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (!is_stream(t)) {
+        return E_NOT_SUPPORTED;
+    }
+    batch->len = 0;
+    t->batch = batch;
+    return 0;
+}
+
+/**
+ * xoe_transport_uncork - Flush the gathered writes and stop gathering
+ */
+int xoe_transport_uncork(xoe_transport_t *t) {
+    int result;
+
+    if (t == NULL || t->batch == NULL) {
+        return 0;
+    }
+    result = batch_write(t);
+    t->batch = NULL;
+    return result;
+}
+
+/**
+ * xoe_transport_poll_fd - Descriptor to poll for readiness
+ */
+int xoe_transport_poll_fd(const xoe_transport_t *t) {
+    return (t != NULL && t->ops != NULL) ? t->ops->poll_fd(t) : -1;
+}
+
+/**
+ * xoe_transport_pending - Whether received bytes wait in user space
+ */
+int xoe_transport_pending(xoe_transport_t *t) {
+    return (t != NULL && t->ops != NULL) ? t->ops->pending(t) : FALSE;
+}
+
+/**
+ * xoe_transport_name - Kind of a bound transport
+ */
+const char *xoe_transport_name(const xoe_transport_t *t) {
+    return (t != NULL && t->ops != NULL) ? t->ops->name : "none";
+}
+
+/**
+ * xoe_transport_is_tcp - Whether writes go to the socket unchanged
+ */
+int xoe_transport_is_tcp(const xoe_transport_t *t) {
+    return t != NULL && t->ops == &tcp_ops;
+}
@@ -0,0 +1,295 @@
+/**
+ * transport.h
+ *
+ * Byte transports under the wire layer.
+ *
+ * A connection is set up as plain TCP, TLS, kernel TLS, a same-host
+ * shared-memory link (lib/net/shm_link.h) or a UDP association, but
+ * once it carries frames every one of them is used the same way. An
+ * xoe_transport_t binds the connection to the operations of its kind
+ * once, when it is opened or its handshake completes, so the wire layer
+ * (lib/protocol/wire_format.h) and its callers have a single path with no
+ * per-frame "TLS or not" test:
+ *
+ *   readv    One read into the buffers: bytes read, 0 at end of stream,
+ *            E_WOULD_BLOCK if a non-blocking source has nothing yet
+ *   writev   The whole of the buffers. A full non-blocking socket is
+ *            waited for (up to XOE_TRANSPORT_SEND_TIMEOUT_MS), as the
+ *            senders expect send-all semantics, unless the transport has
+ *            an outbound queue (xoe_transport_set_queue())
+ *   flush    Push out anything the transport still holds (a corked
+ *            transport's gathered writes, see xoe_transport_cork(), and
+ *            its queued bytes)
+ *   poll_fd  Descriptor to poll for readiness
+ *   pending  Bytes already received into user space (an OpenSSL record,
+ *            a link's ring), which poll() cannot report
+ *
+ * Kinds:
+ *
+ *   tcp   recv()/sendmsg() on a stream socket
+ *   shm   The link's rings; the descriptor is its doorbell socket
+ *   tls   SSL_read()/SSL_write(), small buffers coalesced into full
+ *         records
+ *   ktls  TLS whose records the kernel builds: buffers go to sendmsg()
+ *         unchanged, reads still pass through OpenSSL for control
+ *         records
+ *   udp   One datagram per call on a connected socket ("dtls" when a
+ *         DTLS session protects it). Datagrams are lossy: one the kernel
+ *         will not take right now (or DTLS cannot write yet) is dropped
+ *         and the write still succeeds
+ *
+ * An event loop cannot wait for a peer that does not read. It gives
+ * each stream transport an outbound queue instead: writes then send what
+ * the socket takes and queue the rest, bytes written later queue behind
+ * them, and flush() sends the queue when the socket polls writable.
+ *
+ * A transport is a small value held by its connection; it owns nothing,
+ * so the descriptor, TLS session and queue are released as before. Like
+ * the connection, it is used by one thread at a time.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include "lib/common/types.h"
+
+#include <sys/uio.h>
+
+/* Longest wait of a write for a full non-blocking socket */
+#define XOE_TRANSPORT_SEND_TIMEOUT_MS 5000
+
+/* Buffers one writev() accepts */
+#define XOE_TRANSPORT_MAX_IOV 8
+
+/* TLS record plaintext; the tls kind coalesces writes up to this size */
+#define XOE_TRANSPORT_TLS_RECORD_SIZE 16384
+
+/* Largest datagram the udp kind gathers for DTLS */
+#define XOE_TRANSPORT_DGRAM_MAX 65507
+
+/* Bytes a corked transport gathers before writing (one TLS record) */
+#define XOE_TRANSPORT_BATCH_SIZE XOE_TRANSPORT_TLS_RECORD_SIZE
+
+/* Queued bytes past which the queue's owner stops adding to it (the
+ * event loop stops reading the connection) */
+#ifndef XOE_TRANSPORT_QUEUE_HIGH
+#define XOE_TRANSPORT_QUEUE_HIGH (256 * 1024)
+#endif
+
+/* Allocation an emptied queue keeps for the next backlog */
+#define XOE_TRANSPORT_QUEUE_KEEP XOE_TRANSPORT_BATCH_SIZE
+
+struct shm_link;
+typedef struct xoe_transport xoe_transport_t;
+
+/* Writes gathered while a transport is corked; held by the caller */
+typedef struct {
+    uint8_t data[XOE_TRANSPORT_BATCH_SIZE];
+    size_t len;
+} xoe_transport_batch_t;
+
+/* Bytes a full socket has not taken yet; held by the caller. Zero it
+ * before use, release it with xoe_transport_queue_free() */
+typedef struct {
+    uint8_t *data;              /* Allocated on first use */
+    size_t size;                /* Bytes allocated (charged to the memory
+                                   budget) */
+    size_t start;               /* First byte not yet written */
+    size_t len;                 /* Bytes queued from start */
+} xoe_transport_queue_t;
+
+/* Operations of one transport kind (see the top of this file) */
+typedef struct {
+    const char *name;
+    int (*readv)(xoe_transport_t *t, const struct iovec *iov, int iovcnt);
+    int (*writev)(xoe_transport_t *t, const struct iovec *iov, int iovcnt);
+    int (*flush)(xoe_transport_t *t);
+    int (*poll_fd)(const xoe_transport_t *t);
+    int (*pending)(xoe_transport_t *t);
+} xoe_transport_ops_t;
+
+/* A connection's transport */
+struct xoe_transport {
+    const xoe_transport_ops_t *ops;
+    int fd;                     /* Socket (a link's doorbell for shm) */
+    void *ssl;                  /* SSL* of tls, ktls and DTLS udp */
+    struct shm_link *link;      /* Ring pair of shm */
+    xoe_transport_batch_t *batch; /* Gathers writes while corked, or NULL */
+    xoe_transport_queue_t *queue; /* Takes what a full socket does not, or
+                                     NULL to wait for room */
+};
+
+/**
+ * xoe_transport_init_fd - Bind a stream descriptor
+ * @t:  Transport to fill
+ * @fd: Connected socket; a descriptor carrying a shared-memory link
+ *      gets the shm kind, any other the tcp kind
+ *
+ * Returns: 0, or E_INVALID_ARGUMENT
+ */
+int xoe_transport_init_fd(xoe_transport_t *t, int fd);
+
+/**
+ * xoe_transport_init_tls - Bind a TLS session
+ * @t:   Transport to fill
+ * @ssl: SSL* whose handshake has completed (the ktls kind is chosen when
+ *       the kernel encrypts its sent records)
+ *
+ * Bind again if kernel TLS may have been enabled since.
+ *
+ * Returns: 0, E_INVALID_ARGUMENT, or E_NOT_SUPPORTED without TLS support
+ */
+int xoe_transport_init_tls(xoe_transport_t *t, void *ssl);
+
+/**
+ * xoe_transport_init_udp - Bind a connected datagram socket
+ * @t:   Transport to fill
+ * @fd:  Connected UDP socket
+ * @ssl: DTLS session on @fd, or NULL for plain UDP
+ *
+ * Reads never wait, whether or not @fd is blocking.
+ *
+ * Returns: 0, E_INVALID_ARGUMENT, or E_NOT_SUPPORTED for DTLS without
+ *          TLS support
+ */
+int xoe_transport_init_udp(xoe_transport_t *t, int fd, void *ssl);
+
+/**
+ * xoe_transport_readv - Read once into @iov
+ * @t:      Transport
+ * @iov:    Buffers (the first only, for DTLS)
+ * @iovcnt: Entries (1..XOE_TRANSPORT_MAX_IOV)
+ *
+ * Returns: Bytes read (> 0), 0 at end of stream, E_WOULD_BLOCK, or a
+ *          negative error code (E_PROTOCOL_ERROR for an empty or
+ *          truncated datagram, E_NETWORK_ERROR for an unreachable peer)
+ */
+int xoe_transport_readv(xoe_transport_t *t, const struct iovec *iov,
+                        int iovcnt);
+
+/**
+ * xoe_transport_writev - Write all of @iov
+ * @t:      Transport
+ * @iov:    Buffers (not modified)
+ * @iovcnt: Entries (1..XOE_TRANSPORT_MAX_IOV)
+ *
+ * With a queue, what the socket does not take is queued and the write
+ * still succeeds.
+ *
+ * Returns: 0, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY (queue), or E_IO_ERROR
+ *          (E_NETWORK_ERROR for a datagram the network refused)
+ */
+int xoe_transport_writev(xoe_transport_t *t, const struct iovec *iov,
+                         int iovcnt);
+
+/**
+ * xoe_transport_flush - Push out what the transport still holds
+ * @t: Transport
+ *
+ * Writes what a corked transport has gathered, then sends the queue
+ * without waiting; otherwise no kind holds data past writev(). Callers
+ * that batch call it at the end of a batch, event loops when a socket
+ * with queued bytes polls writable.
+ *
+ * Returns: 0 once nothing is held, E_WOULD_BLOCK while queued bytes
+ *          remain, E_INVALID_ARGUMENT for an unbound transport, or
+ *          E_IO_ERROR
+ */
+int xoe_transport_flush(xoe_transport_t *t);
+
+/**
+ * xoe_transport_set_queue - Queue what a full socket does not take
+ * @t:     Stream transport (tcp, tls or ktls), bound
+ * @queue: Queue held by the caller, or NULL to wait for room again
+ *
+ * From here writes never wait: see xoe_transport_writev(). A TLS session
+ * is switched to partial writes on a moving buffer, so a write OpenSSL
+ * could not finish is retried from the queue.
+ *
+ * Detach only an empty queue (xoe_transport_queued()); bytes still in it
+ * are not sent. Rebinding the transport (xoe_transport_init_*()) detaches
+ * it too, so a caller that rebinds sets the queue again.
+ *
+ * Returns: 0, E_INVALID_ARGUMENT, or E_NOT_SUPPORTED for shm and datagram
+ *          kinds (a link's ring has no writability to poll for; a
+ *          datagram is dropped instead)
+ */
+int xoe_transport_set_queue(xoe_transport_t *t, xoe_transport_queue_t *queue);
+
+/**
+ * xoe_transport_queued - Bytes waiting in the outbound queue
+ * @t: Transport
+ *
+ * Returns: Bytes queued, 0 without a queue
+ */
+size_t xoe_transport_queued(const xoe_transport_t *t);
+
+/**
+ * xoe_transport_queue_free - Release a queue's buffer
+ * @queue: Queue no transport uses any more (NULL is ignored)
+ *
+ * Queued bytes are dropped; the queue is empty and reusable afterwards.
+ */
+void xoe_transport_queue_free(xoe_transport_queue_t *queue);
+
+/**
+ * xoe_transport_cork - Gather writes until the transport is uncorked
+ * @t:     Stream transport (tcp, tls or ktls)
+ * @batch: Buffer to gather in, held by the caller until uncorked
+ *
+ * writev() then copies buffers that fit into @batch and returns; what
+ * does not fit first flushes @batch and, if larger than @batch, is
+ * written straight through. Several small frames thus leave in one
+ * system call (one TLS record) instead of one each. Writes that bypass
+ * the transport (zero-copy, splice()) must flush first to keep order.
+ *
+ * Rebinding the transport (xoe_transport_init_*()) uncorks it without
+ * flushing.
+ *
+ * Returns: 0, E_INVALID_ARGUMENT, or E_NOT_SUPPORTED for shm and
+ *          datagram kinds (left uncorked: a datagram is one write)
+ */
+int xoe_transport_cork(xoe_transport_t *t, xoe_transport_batch_t *batch);
+
+/**
+ * xoe_transport_uncork - Flush the gathered writes and stop gathering
+ * @t: Transport (corked or not)
+ *
+ * Returns: 0, or the error of the flushing write (the batch is dropped)
+ */
+int xoe_transport_uncork(xoe_transport_t *t);
+
+/**
+ * xoe_transport_poll_fd - Descriptor to poll for readiness
+ * @t: Transport
+ */
+int xoe_transport_poll_fd(const xoe_transport_t *t);
+
+/**
+ * xoe_transport_pending - Whether received bytes wait in user space
+ * @t: Transport
+ *
+ * Returns: TRUE if readv() would return data without the descriptor
+ *          polling readable, else FALSE
+ */
+int xoe_transport_pending(xoe_transport_t *t);
+
+/**
+ * xoe_transport_name - Kind of a bound transport ("tcp", "tls", ...)
+ * @t: Transport
+ */
+const char *xoe_transport_name(const xoe_transport_t *t);
+
+/**
+ * xoe_transport_is_tcp - Whether writes go to the socket unchanged
+ * @t: Transport
+ *
+ * Returns: TRUE for the tcp kind, whose bytes reach the descriptor as
+ *          written (so the socket may be driven directly: zero-copy
+ *          sends, splice()), else FALSE
+ */
+int xoe_transport_is_tcp(const xoe_transport_t *t);
+
+#endif /* TRANSPORT_H */
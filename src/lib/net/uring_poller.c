@@ -0,0 +1,611 @@
+/**
+ * uring_poller.c
+ *
+ * One-shot IORING_OP_POLL_ADD requests over a raw io_uring. Descriptors
+ * needing a poll (new, just fired, or interest changed) go on an arm list
+ * that uring_poller_wait() turns into submission queue entries right
+ * before it enters the kernel, so a batch of changes costs one system
+ * call together with the wait itself.
+ *
+ * user_data layout: bit 63 marks POLL_REMOVE completions (ignored),
+ * bits 32..62 carry the descriptor's generation, bits 0..31 the
+ * descriptor.
+ *
+ * [LLM-ARCH]
+ */
+
+/* syscall(), MAP_POPULATE */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "uring_poller.h"
+#include "lib/common/definitions.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <stdint.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && \
+    defined(IORING_ENTER_EXT_ARG)
+#define URING_POLLER_AVAILABLE 1
+#else
+#define URING_POLLER_AVAILABLE 0
+#endif
+
+#if URING_POLLER_AVAILABLE
+
+#define URING_TAG_REMOVE  (1ULL << 63)
+#define URING_GEN_MASK    0x7fffffffu
+
+/* Initial descriptor table size */
+#define URING_MIN_SLOTS   64
+
+/* Per-descriptor state */
+typedef struct {
+    void *data;             /* Returned with events */
+    uint32_t gen;           /* Bumped whenever a pending poll goes stale */
+    uint8_t watched;        /* Added and not removed */
+    uint8_t armed;          /* POLL_ADD queued or in flight for gen */
+    uint8_t want_read;      /* POLLIN in the mask */
+    uint8_t want_write;     /* POLLOUT in the mask */
+    uint8_t queued;         /* On the arm list */
+} uring_slot_t;
+
+struct uring_poller {
+    int ring_fd;
+
+    /* Submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;         /* Entries prepared so far */
+    struct io_uring_sqe *sqes;
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    /* Mappings */
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;                  /* == sq_ring with a single mapping */
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    /* Descriptor table, indexed by fd */
+    uring_slot_t *slots;
+    int num_slots;
+    int *arm_list;                  /* Descriptors waiting for a poll */
+    int arm_count;
+};
+
+/* ========================================================================
+ * Ring Primitives
+ * ======================================================================== */
+
+/**
+ * ring_enter - Publish prepared entries and call io_uring_enter()
+ *
+ * Returns: As the system call (-1 with errno set on failure)
+ */
+static int ring_enter(uring_poller_t *p, unsigned min_complete,
+                      unsigned flags, const void *arg, size_t arg_size) {
+    unsigned to_submit;
+
+    __atomic_store_n(p->sq_tail, p->sq_local_tail, __ATOMIC_RELEASE);
+    to_submit = p->sq_local_tail - __atomic_load_n(p->sq_head,
+                                                   __ATOMIC_ACQUIRE);
+
+    return (int)syscall(__NR_io_uring_enter, p->ring_fd, to_submit,
+                        min_complete, flags, arg, arg_size);
+}
+
+/**
+ * ring_unsubmitted - Entries prepared but not yet consumed by the kernel
+ */
+static unsigned ring_unsubmitted(uring_poller_t *p) {
+    return p->sq_local_tail - __atomic_load_n(p->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * ring_get_sqe - Next free submission entry, zeroed
+ *
+ * Submits what is queued when the ring is full.
+ *
+ * Returns: Entry, or NULL if the kernel accepts nothing
+ */
+static struct io_uring_sqe *ring_get_sqe(uring_poller_t *p) {
+    struct io_uring_sqe *sqe;
+
+    if (ring_unsubmitted(p) >= p->sq_entries) {
+        ring_enter(p, 0, 0, NULL, 0);
+        if (ring_unsubmitted(p) >= p->sq_entries) {
+            return NULL;
+        }
+    }
+
+    sqe = &p->sqes[p->sq_local_tail & p->sq_mask];
+    p->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+/**
+ * slot_tag - user_data for a descriptor's current poll
+ */
+static uint64_t slot_tag(int fd, uint32_t gen) {
+    return ((uint64_t)(gen & URING_GEN_MASK) << 32) | (uint32_t)fd;
+}
+
+/* ========================================================================
+ * Descriptor Table
+ * ======================================================================== */
+
+/**
+ * ensure_slot - Grow the table to cover @fd
+ */
+static int ensure_slot(uring_poller_t *p, int fd) {
+    uring_slot_t *slots;
+    int *arm_list;
+    int count = (p->num_slots > 0) ? p->num_slots : URING_MIN_SLOTS;
+
+    if (fd < p->num_slots) {
+        return 0;
+    }
+    while (count <= fd) {
+        count *= 2;
+    }
+
+    slots = (uring_slot_t *)realloc(p->slots, (size_t)count * sizeof(*slots));
+    if (slots == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    p->slots = slots;
+    memset(&slots[p->num_slots], 0,
+           (size_t)(count - p->num_slots) * sizeof(*slots));
+
+    /* Each descriptor is on the arm list at most once */
+    arm_list = (int *)realloc(p->arm_list, (size_t)count * sizeof(*arm_list));
+    if (arm_list == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    p->arm_list = arm_list;
+    p->num_slots = count;
+    return 0;
+}
+
+/**
+ * queue_arm - Put a descriptor on the arm list
+ */
+static void queue_arm(uring_poller_t *p, int fd) {
+    if (!p->slots[fd].queued) {
+        p->slots[fd].queued = TRUE;
+        p->arm_list[p->arm_count++] = fd;
+    }
+}
+
+/**
+ * cancel_poll - Queue removal of a descriptor's in-flight poll
+ *
+ * Bumping the generation first makes any completion of the old poll,
+ * already posted or not, stale.
+ */
+static void cancel_poll(uring_poller_t *p, int fd) {
+    uring_slot_t *slot = &p->slots[fd];
+    struct io_uring_sqe *sqe;
+
+    sqe = ring_get_sqe(p);
+    if (sqe != NULL) {
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = slot_tag(fd, slot->gen);
+        sqe->user_data = URING_TAG_REMOVE;
+    }
+    slot->gen++;
+    slot->armed = FALSE;
+}
+
+/**
+ * arm_queued - Turn the arm list into POLL_ADD entries
+ */
+static void arm_queued(uring_poller_t *p) {
+    struct io_uring_sqe *sqe;
+    uring_slot_t *slot;
+    uint32_t mask;
+    int fd;
+    int i;
+
+    for (i = 0; i < p->arm_count; i++) {
+        fd = p->arm_list[i];
+        slot = &p->slots[fd];
+
+        if (!slot->watched || slot->armed) {
+            slot->queued = FALSE;
+            continue;
+        }
+
+        sqe = ring_get_sqe(p);
+        if (sqe == NULL) {
+            /* Keep the rest for the next wait */
+            memmove(p->arm_list, &p->arm_list[i],
+                    (size_t)(p->arm_count - i) * sizeof(int));
+            p->arm_count -= i;
+            return;
+        }
+
+        mask = (slot->want_read ? POLLIN : 0) |
+               (slot->want_write ? POLLOUT : 0);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        mask = (mask << 16) | (mask >> 16);
+#endif
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = mask;
+        sqe->user_data = slot_tag(fd, slot->gen);
+
+        slot->armed = TRUE;
+        slot->queued = FALSE;
+    }
+    p->arm_count = 0;
+}
+
+/* ========================================================================
+ * Public Functions
+ * ======================================================================== */
+
+int uring_poller_create(uring_poller_t **poller) {
+    struct io_uring_params params;
+    uring_poller_t *p;
+    int mmap_flags = MAP_SHARED;
+    unsigned i;
+
+    if (poller == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    *poller = NULL;
+
+#ifdef MAP_POPULATE
+    mmap_flags |= MAP_POPULATE;
+#endif
+
+    p = (uring_poller_t *)calloc(1, sizeof(*p));
+    if (p == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    p->sq_ring = MAP_FAILED;
+    p->cq_ring = MAP_FAILED;
+    p->sqes = (struct io_uring_sqe *)MAP_FAILED;
+
+    memset(&params, 0, sizeof(params));
+    p->ring_fd = (int)syscall(__NR_io_uring_setup, URING_POLLER_ENTRIES,
+                              &params);
+    if (p->ring_fd < 0) {
+        free(p);
+        return (errno == ENOMEM) ? E_OUT_OF_MEMORY : E_NOT_SUPPORTED;
+    }
+    if (!(params.features & IORING_FEAT_NODROP) ||
+        !(params.features & IORING_FEAT_EXT_ARG)) {
+        uring_poller_destroy(p);
+        return E_NOT_SUPPORTED;
+    }
+
+    p->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    p->cq_ring_size = params.cq_off.cqes +
+                      params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (p->cq_ring_size > p->sq_ring_size) {
+            p->sq_ring_size = p->cq_ring_size;
+        }
+        p->cq_ring_size = 0;
+    }
+
+    p->sq_ring = mmap(NULL, p->sq_ring_size, PROT_READ | PROT_WRITE,
+                      mmap_flags, p->ring_fd, IORING_OFF_SQ_RING);
+    if (p->sq_ring == MAP_FAILED) {
+        uring_poller_destroy(p);
+        return E_OUT_OF_MEMORY;
+    }
+    if (p->cq_ring_size == 0) {
+        p->cq_ring = p->sq_ring;
+    } else {
+        p->cq_ring = mmap(NULL, p->cq_ring_size, PROT_READ | PROT_WRITE,
+                          mmap_flags, p->ring_fd, IORING_OFF_CQ_RING);
+        if (p->cq_ring == MAP_FAILED) {
+            uring_poller_destroy(p);
+            return E_OUT_OF_MEMORY;
+        }
+    }
+
+    p->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    p->sqes = (struct io_uring_sqe *)mmap(NULL, p->sqes_size,
+                                          PROT_READ | PROT_WRITE, mmap_flags,
+                                          p->ring_fd, IORING_OFF_SQES);
+    if (p->sqes == MAP_FAILED) {
+        uring_poller_destroy(p);
+        return E_OUT_OF_MEMORY;
+    }
+
+    p->sq_head = (unsigned *)((char *)p->sq_ring + params.sq_off.head);
+    p->sq_tail = (unsigned *)((char *)p->sq_ring + params.sq_off.tail);
+    p->sq_mask = *(unsigned *)((char *)p->sq_ring + params.sq_off.ring_mask);
+    p->sq_array = (unsigned *)((char *)p->sq_ring + params.sq_off.array);
+    p->sq_entries = params.sq_entries;
+    p->sq_local_tail = *p->sq_tail;
+
+    p->cq_head = (unsigned *)((char *)p->cq_ring + params.cq_off.head);
+    p->cq_tail = (unsigned *)((char *)p->cq_ring + params.cq_off.tail);
+    p->cq_mask = *(unsigned *)((char *)p->cq_ring + params.cq_off.ring_mask);
+    p->cqes = (struct io_uring_cqe *)((char *)p->cq_ring +
+                                      params.cq_off.cqes);
+
+    /* Slot i of the ring always holds entry i */
+    for (i = 0; i < p->sq_entries; i++) {
+        p->sq_array[i] = i;
+    }
+
+    if (ensure_slot(p, URING_MIN_SLOTS - 1) != 0) {
+        uring_poller_destroy(p);
+        return E_OUT_OF_MEMORY;
+    }
+
+    *poller = p;
+    return 0;
+}
+
+void uring_poller_destroy(uring_poller_t *poller) {
+    if (poller == NULL) {
+        return;
+    }
+
+    if (poller->sqes != (struct io_uring_sqe *)MAP_FAILED) {
+        munmap(poller->sqes, poller->sqes_size);
+    }
+    if (poller->cq_ring != MAP_FAILED && poller->cq_ring != poller->sq_ring) {
+        munmap(poller->cq_ring, poller->cq_ring_size);
+    }
+    if (poller->sq_ring != MAP_FAILED) {
+        munmap(poller->sq_ring, poller->sq_ring_size);
+    }
+    /* Closing the ring cancels every outstanding poll */
+    if (poller->ring_fd >= 0) {
+        close(poller->ring_fd);
+    }
+
+    free(poller->slots);
+    free(poller->arm_list);
+    free(poller);
+}
+
+int uring_poller_add(uring_poller_t *poller, int fd, void *data) {
+    uring_slot_t *slot;
+    int result;
+
+    if (poller == NULL || fd < 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    result = ensure_slot(poller, fd);
+    if (result != 0) {
+        return result;
+    }
+
+    slot = &poller->slots[fd];
+    if (slot->watched) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    slot->gen++;
+    slot->data = data;
+    slot->watched = TRUE;
+    slot->armed = FALSE;
+    slot->want_read = TRUE;
+    slot->want_write = FALSE;
+    queue_arm(poller, fd);
+    return 0;
+}
+
+int uring_poller_set_write(uring_poller_t *poller, int fd, void *data,
+                           int enable) {
+    return uring_poller_set_interest(poller, fd, data, TRUE, enable);
+}
+
+int uring_poller_set_interest(uring_poller_t *poller, int fd, void *data,
+                              int read, int write) {
+    uring_slot_t *slot;
+
+    if (poller == NULL || fd < 0 || fd >= poller->num_slots ||
+        !poller->slots[fd].watched) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    slot = &poller->slots[fd];
+    slot->data = data;
+    read = read ? TRUE : FALSE;
+    write = write ? TRUE : FALSE;
+    if (slot->want_read == read && slot->want_write == write) {
+        return 0;
+    }
+
+    slot->want_read = (uint8_t)read;
+    slot->want_write = (uint8_t)write;
+    if (slot->armed) {
+        cancel_poll(poller, fd);
+    }
+    queue_arm(poller, fd);
+    return 0;
+}
+
+void uring_poller_remove(uring_poller_t *poller, int fd) {
+    uring_slot_t *slot;
+
+    if (poller == NULL || fd < 0 || fd >= poller->num_slots ||
+        !poller->slots[fd].watched) {
+        return;
+    }
+
+    slot = &poller->slots[fd];
+    if (slot->armed) {
+        cancel_poll(poller, fd);
+    }
+    slot->watched = FALSE;
+    slot->want_write = FALSE;
+    slot->data = NULL;
+}
+
+int uring_poller_wait(uring_poller_t *poller, uring_poller_event_t *out,
+                      int max, int timeout_ms) {
+    struct io_uring_getevents_arg arg;
+    struct __kernel_timespec ts;
+    struct io_uring_cqe *cqe;
+    uring_slot_t *slot;
+    unsigned head;
+    unsigned tail;
+    uint64_t user_data;
+    uint32_t gen;
+    int res;
+    int fd;
+    int n = 0;
+
+    if (poller == NULL || out == NULL || max <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* Completions of cancelled polls are dropped; wait again after a
+     * batch that held nothing else */
+    do {
+        arm_queued(poller);
+
+        head = *poller->cq_head;
+        tail = __atomic_load_n(poller->cq_tail, __ATOMIC_ACQUIRE);
+
+        if (head == tail) {
+            /* Submit and wait in one call */
+            memset(&arg, 0, sizeof(arg));
+            if (timeout_ms >= 0) {
+                ts.tv_sec = timeout_ms / 1000;
+                ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+                arg.ts = (uint64_t)(uintptr_t)&ts;
+            }
+
+            if (ring_enter(poller, (timeout_ms != 0) ? 1 : 0,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                           &arg, sizeof(arg)) < 0 &&
+                errno != ETIME && errno != EBUSY) {
+                return -1;
+            }
+            tail = __atomic_load_n(poller->cq_tail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                return 0;   /* Timed out */
+            }
+        } else if (ring_unsubmitted(poller) > 0) {
+            /* Events are already waiting; only submit */
+            ring_enter(poller, 0, 0, NULL, 0);
+        }
+
+        while (head != tail && n < max) {
+            cqe = &poller->cqes[head & poller->cq_mask];
+            user_data = cqe->user_data;
+            res = cqe->res;
+            head++;
+
+            if (user_data & URING_TAG_REMOVE) {
+                continue;
+            }
+
+            fd = (int)(uint32_t)user_data;
+            gen = (uint32_t)(user_data >> 32);
+            if (fd < 0 || fd >= poller->num_slots) {
+                continue;
+            }
+            slot = &poller->slots[fd];
+            if (!slot->watched || (slot->gen & URING_GEN_MASK) != gen) {
+                continue;   /* Removed, re-added or interest changed since */
+            }
+
+            /* One-shot: re-arm on the next wait (level-triggered) */
+            slot->armed = FALSE;
+            queue_arm(poller, fd);
+
+            /* Errors are reported as readable so recv() sees them */
+            out[n].data = slot->data;
+            out[n].readable = (res < 0) ||
+                              (res & (POLLIN | POLLHUP | POLLERR)) != 0;
+            out[n].writable = (res > 0) && (res & POLLOUT) != 0;
+            n++;
+        }
+
+        __atomic_store_n(poller->cq_head, head, __ATOMIC_RELEASE);
+    } while (n == 0 && timeout_ms != 0);
+
+    return n;
+}
+
+#else /* !URING_POLLER_AVAILABLE */
+
+int uring_poller_create(uring_poller_t **poller) {
+    if (poller != NULL) {
+        *poller = NULL;
+    }
+    return E_NOT_SUPPORTED;
+}
+
+void uring_poller_destroy(uring_poller_t *poller) {
+    (void)poller;
+}
+
+int uring_poller_add(uring_poller_t *poller, int fd, void *data) {
+    (void)poller;
+    (void)fd;
+    (void)data;
+    return E_NOT_SUPPORTED;
+}
+
+int uring_poller_set_write(uring_poller_t *poller, int fd, void *data,
+                           int enable) {
+    (void)poller;
+    (void)fd;
+    (void)data;
+    (void)enable;
+    return E_NOT_SUPPORTED;
+}
+
+int uring_poller_set_interest(uring_poller_t *poller, int fd, void *data,
+                              int read, int write) {
+    (void)poller;
+    (void)fd;
+    (void)data;
+    (void)read;
+    (void)write;
+    return E_NOT_SUPPORTED;
+}
+
+void uring_poller_remove(uring_poller_t *poller, int fd) {
+    (void)poller;
+    (void)fd;
+}
+
+int uring_poller_wait(uring_poller_t *poller, uring_poller_event_t *out,
+                      int max, int timeout_ms) {
+    (void)poller;
+    (void)out;
+    (void)max;
+    (void)timeout_ms;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif /* URING_POLLER_AVAILABLE */
@@ -0,0 +1,124 @@
+/**
+ * uring_poller.h
+ *
+ * io_uring readiness poller for XOE (Linux).
+ *
+ * An alternative to epoll for the server event loop. Interest changes
+ * (new connection, write interest on/off, removal) become submission
+ * queue entries that are flushed together with the next wait in a
+ * single io_uring_enter(), instead of one epoll_ctl() system call each.
+ *
+ * Sockets are watched with one-shot IORING_OP_POLL_ADD requests that are
+ * re-armed on the next wait after they fire. A re-armed poll on a socket
+ * that still has unread data completes at once, so callers see the same
+ * level-triggered behaviour as with epoll and may drain in bounded
+ * batches.
+ *
+ * Each descriptor carries a generation number in its request's user_data;
+ * completions for a descriptor that has since been removed, re-added or
+ * had its interest changed are dropped.
+ *
+ * Uses the raw system calls and <linux/io_uring.h> (no liburing). Needs
+ * IORING_FEAT_NODROP and IORING_FEAT_EXT_ARG (Linux 5.11); elsewhere
+ * uring_poller_create() fails with E_NOT_SUPPORTED and callers keep
+ * epoll.
+ *
+ * A poller is not thread-safe; it belongs to one event loop worker.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef URING_POLLER_H
+#define URING_POLLER_H
+
+/* Submission queue entries (completion queue is twice this) */
+#define URING_POLLER_ENTRIES 256
+
+/* Opaque poller handle */
+typedef struct uring_poller uring_poller_t;
+
+/**
+ * Readiness report
+ */
+typedef struct {
+    void *data;         /* Pointer given to uring_poller_add() */
+    int readable;       /* Readable, hangup or error */
+    int writable;       /* Writable (only with write interest) */
+} uring_poller_event_t;
+
+/**
+ * uring_poller_create - Set up a ring
+ * @poller: Receives the poller
+ *
+ * Returns: 0 on success, E_NOT_SUPPORTED if the kernel (or a sysctl such
+ *          as kernel.io_uring_disabled) refuses io_uring or lacks a needed
+ *          feature, E_OUT_OF_MEMORY
+ */
+int uring_poller_create(uring_poller_t **poller);
+
+/**
+ * uring_poller_destroy - Release the ring and its outstanding requests
+ * @poller: Poller (NULL is ignored)
+ */
+void uring_poller_destroy(uring_poller_t *poller);
+
+/**
+ * uring_poller_add - Watch a descriptor for readability
+ * @poller: Poller
+ * @fd:     Descriptor
+ * @data:   Returned with its events
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY
+ */
+int uring_poller_add(uring_poller_t *poller, int fd, void *data);
+
+/**
+ * uring_poller_set_write - Add or drop write interest
+ * @poller: Poller
+ * @fd:     Watched descriptor
+ * @data:   Returned with its events
+ * @enable: TRUE to also report writability
+ *
+ * Reading is resumed if it was paused.
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT if @fd is not watched
+ */
+int uring_poller_set_write(uring_poller_t *poller, int fd, void *data,
+                           int enable);
+
+/**
+ * uring_poller_set_interest - Choose the readiness reported for a descriptor
+ * @poller: Poller
+ * @fd:     Watched descriptor
+ * @data:   Returned with its events
+ * @read:   Report readability (FALSE pauses reading; hangup and error
+ *          are still reported)
+ * @write:  Report writability
+ *
+ * Returns: 0 on success, E_INVALID_ARGUMENT if @fd is not watched
+ */
+int uring_poller_set_interest(uring_poller_t *poller, int fd, void *data,
+                              int read, int write);
+
+/**
+ * uring_poller_remove - Stop watching a descriptor
+ * @poller: Poller
+ * @fd:     Descriptor (may be closed right after; its pending poll is
+ *          cancelled on the next wait)
+ */
+void uring_poller_remove(uring_poller_t *poller, int fd);
+
+/**
+ * uring_poller_wait - Submit queued changes and wait for readiness
+ * @poller:     Poller
+ * @out:        Receives up to @max events
+ * @max:        Capacity of @out
+ * @timeout_ms: Longest wait (0 = do not block, negative = no limit)
+ *
+ * Returns: Number of events (0 on timeout), or -1 with errno set
+ *          (EINTR when interrupted by a signal)
+ */
+int uring_poller_wait(uring_poller_t *poller, uring_poller_event_t *out,
+                      int max, int timeout_ms);
+
+#endif /* URING_POLLER_H */
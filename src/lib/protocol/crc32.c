@@ -0,0 +1,331 @@
+/**
+ * @file crc32.c
+ * @brief CRC32 kernel selection and hardware implementations
+ *
+ * Kernels are compiled with per-function target attributes, so the rest
+ * of the tree keeps the baseline ISA flags; the CPU is probed once at
+ * first use and the bulk kernel is reached through a function pointer.
+ *
+ * The PCLMULQDQ kernel follows Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (fold by 4 x 128 bits, then
+ * Barrett reduction), with the bit-reflected constants for 0x04C11DB7.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "crc32.h"
+
+#include <string.h>
+#include <pthread.h>
+#include <zlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XOE_CRC32_HAVE_PCLMUL 1
+#include <immintrin.h>
+#else
+#define XOE_CRC32_HAVE_PCLMUL 0
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && \
+    defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define XOE_CRC32_HAVE_ARMV8 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#endif
+#else
+#define XOE_CRC32_HAVE_ARMV8 0
+#endif
+
+/* PCLMUL kernel needs at least one 64-byte block to be worthwhile */
+#define CRC32_PCLMUL_MIN_LENGTH 64
+
+/* Reflected CRC32 polynomial */
+#define CRC32_POLY_REFLECTED 0xEDB88320UL
+
+typedef uint32_t (*crc32_kernel_fn)(uint32_t crc, const uint8_t* data,
+                                    uint32_t len);
+
+static crc32_kernel_fn crc32_kernel;
+static const char* crc32_kernel_name = "zlib";
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+/* ========================================================================
+ * Portable kernel (zlib)
+ * ======================================================================== */
+
+static uint32_t crc32_zlib(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+    return (uint32_t)crc32((uLong)crc, (const Bytef*)data, (uInt)len);
+}
+
+/* ========================================================================
+ * x86 PCLMULQDQ kernel
+ * ======================================================================== */
+
+#if XOE_CRC32_HAVE_PCLMUL
+/**
+ * @brief Fold a multiple of 16 bytes (at least 64) into a CRC
+ *
+ * @param crc   Internal (pre-inverted) CRC state
+ * @param buf   Data
+ * @param len   Length, >= 64 and a multiple of 16
+ *
+ * @return Internal (not yet inverted) CRC state
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_fold(uint32_t crc, const uint8_t* buf,
+                                  uint32_t len)
+{
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) =
+        { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) =
+        { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) =
+        { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const uint64_t poly[2] __attribute__((aligned(16))) =
+        { 0x01db710641ULL, 0x01f7011641ULL };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    /* Fold four lanes in parallel, 64 bytes per iteration */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    /* Fold the four lanes into one 128-bit value */
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Remaining 16-byte blocks */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits down to 64 */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+    uint32_t chunk;
+
+    if (len >= CRC32_PCLMUL_MIN_LENGTH) {
+        chunk = len & ~(uint32_t)15;
+        crc = ~crc32_pclmul_fold(~crc, data, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+
+    /* Tail (and short buffers) */
+    if (len > 0) {
+        crc = crc32_zlib(crc, data, len);
+    }
+    return crc;
+}
+#endif /* XOE_CRC32_HAVE_PCLMUL */
+
+/* ========================================================================
+ * ARMv8 CRC32 kernel
+ * ======================================================================== */
+
+#if XOE_CRC32_HAVE_ARMV8
+#if defined(__clang__)
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t* data, uint32_t len)
+{
+    uint64_t word;
+
+    crc = ~crc;
+
+    while (len > 0 && ((uintptr_t)data & 7) != 0) {
+        crc = __crc32b(crc, *data++);
+        len--;
+    }
+    while (len >= 8) {
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32d(crc, word);
+        data += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32b(crc, *data++);
+        len--;
+    }
+
+    return ~crc;
+}
+
+static int cpu_has_armv8_crc(void)
+{
+#if defined(__ARM_FEATURE_CRC32) || defined(__APPLE__)
+    return 1;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+#else
+    return 0;
+#endif
+}
+#endif /* XOE_CRC32_HAVE_ARMV8 */
+
+/* ========================================================================
+ * Dispatch
+ * ======================================================================== */
+
+/**
+ * @brief Probe the CPU and select the bulk kernel (once per process)
+ *
+ * Also builds the byte table used for the fixed-width network-order
+ * helpers, which are too short for any of the bulk kernels.
+ */
+static void crc32_select_kernel(void)
+{
+    uint32_t c;
+    int i;
+    int bit;
+
+    for (i = 0; i < 256; i++) {
+        c = (uint32_t)i;
+        for (bit = 0; bit < 8; bit++) {
+            c = (c & 1) ? (uint32_t)(CRC32_POLY_REFLECTED ^ (c >> 1)) : (c >> 1);
+        }
+        crc32_table[i] = c;
+    }
+
+    crc32_kernel = crc32_zlib;
+    crc32_kernel_name = "zlib";
+
+#if XOE_CRC32_HAVE_PCLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1")) {
+        crc32_kernel = crc32_pclmul;
+        crc32_kernel_name = "pclmul";
+    }
+#endif
+
+#if XOE_CRC32_HAVE_ARMV8
+    if (cpu_has_armv8_crc()) {
+        crc32_kernel = crc32_armv8;
+        crc32_kernel_name = "armv8-crc";
+    }
+#endif
+}
+
+uint32_t xoe_crc32_update(uint32_t crc, const void* data, uint32_t len)
+{
+    if (data == NULL || len == 0) {
+        return crc;
+    }
+
+    pthread_once(&crc32_once, crc32_select_kernel);
+    return crc32_kernel(crc, (const uint8_t*)data, len);
+}
+
+/**
+ * @brief Table step over the low @p bytes bytes of @p value, MSB first
+ */
+static uint32_t crc32_be_bytes(uint32_t crc, uint32_t value, int bytes)
+{
+    int shift;
+
+    pthread_once(&crc32_once, crc32_select_kernel);
+
+    crc = ~crc;
+    for (shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        crc = crc32_table[(crc ^ (value >> shift)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+uint32_t xoe_crc32_be16(uint32_t crc, uint16_t value)
+{
+    return crc32_be_bytes(crc, value, 2);
+}
+
+uint32_t xoe_crc32_be32(uint32_t crc, uint32_t value)
+{
+    return crc32_be_bytes(crc, value, 4);
+}
+
+const char* xoe_crc32_impl_name(void)
+{
+    pthread_once(&crc32_once, crc32_select_kernel);
+    return crc32_kernel_name;
+}
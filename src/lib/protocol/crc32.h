@@ -0,0 +1,61 @@
+/**
+ * @file crc32.h
+ * @brief CRC32 (IEEE 802.3, zlib-compatible) with hardware dispatch
+ *
+ * All frame checksums (wire header, serial, USB) use this module. On first
+ * use it selects the fastest kernel the CPU supports:
+ *   - x86/x86-64: PCLMULQDQ carry-less multiply folding
+ *   - AArch64:    ARMv8 CRC32 instructions
+ *   - otherwise:  zlib crc32()
+ * Every kernel produces results identical to zlib crc32(), so the wire
+ * format is unchanged and peers with different kernels interoperate.
+ *
+ * Note: the SSE4.2 crc32 instruction implements CRC32C (Castagnoli) and
+ * therefore cannot be used for this polynomial.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef XOE_CRC32_H
+#define XOE_CRC32_H
+
+#include "lib/common/types.h"
+
+/**
+ * @brief Extend a CRC32 over a buffer
+ *
+ * Same contract as zlib crc32(crc, data, len): start with crc = 0 and
+ * pass the previous result to continue over further buffers.
+ *
+ * @param crc   Running CRC (0 to start)
+ * @param data  Bytes to add (may be NULL when len is 0)
+ * @param len   Number of bytes
+ *
+ * @return Updated CRC
+ */
+uint32_t xoe_crc32_update(uint32_t crc, const void* data, uint32_t len);
+
+/**
+ * @brief Extend a CRC32 over a 16-bit value in network byte order
+ *
+ * Equivalent to xoe_crc32_update() over the two big-endian bytes of
+ * @p value, without serializing them to a buffer first.
+ */
+uint32_t xoe_crc32_be16(uint32_t crc, uint16_t value);
+
+/**
+ * @brief Extend a CRC32 over a 32-bit value in network byte order
+ *
+ * Equivalent to xoe_crc32_update() over the four big-endian bytes of
+ * @p value, without serializing them to a buffer first.
+ */
+uint32_t xoe_crc32_be32(uint32_t crc, uint32_t value);
+
+/**
+ * @brief Name of the selected kernel ("pclmul", "armv8-crc" or "zlib")
+ *
+ * For diagnostics and logging.
+ */
+const char* xoe_crc32_impl_name(void);
+
+#endif /* XOE_CRC32_H */
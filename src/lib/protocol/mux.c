@@ -0,0 +1,432 @@
+/**
+ * @file mux.c
+ * @brief Channel multiplexing framing and per-channel credit accounting
+ *
+ * [LLM-ARCH]
+ */
+
+#include "lib/protocol/mux.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* ============================================================================
+ * Framing
+ * ============================================================================ */
+
+int xoe_mux_encapsulate(const xoe_mux_header_t* header, uint32_t inner_len,
+                        xoe_packet_t* packet, uint8_t** inner)
+{
+    xoe_payload_t* payload;
+    uint8_t* data;
+
+    if (header == NULL || packet == NULL ||
+        header->channel >= XOE_MUX_MAX_CHANNELS) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (inner_len > XOE_WIRE_MAX_PAYLOAD - XOE_MUX_HEADER_SIZE) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    payload = xoe_payload_alloc(XOE_MUX_HEADER_SIZE + inner_len);
+    if (payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    data = (uint8_t*)payload->data;
+
+    xoe_wire_write_uint16(data, header->channel);
+    data[2] = header->type;
+    data[3] = 0;
+    xoe_wire_write_uint16(data + 4, header->inner_protocol);
+    xoe_wire_write_uint16(data + 6, header->inner_version);
+    xoe_wire_write_uint32(data + 8, header->value);
+
+    packet->protocol_id = XOE_PROTOCOL_MUX;
+    packet->protocol_version = XOE_MUX_VERSION;
+    packet->payload = payload;
+    packet->checksum = 0;
+
+    if (inner != NULL) {
+        *inner = data + XOE_MUX_HEADER_SIZE;
+    }
+    return 0;
+}
+
+int xoe_mux_decapsulate(const xoe_packet_t* packet, xoe_mux_header_t* header,
+                        xoe_packet_t* inner, xoe_payload_t* inner_payload)
+{
+    const uint8_t* data;
+
+    if (packet == NULL || header == NULL ||
+        (inner != NULL && inner_payload == NULL)) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (packet->protocol_id != XOE_PROTOCOL_MUX || packet->payload == NULL ||
+        packet->payload->data == NULL ||
+        packet->payload->len < XOE_MUX_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+    data = (const uint8_t*)packet->payload->data;
+
+    header->channel = xoe_wire_read_uint16(data);
+    header->type = data[2];
+    header->inner_protocol = xoe_wire_read_uint16(data + 4);
+    header->inner_version = xoe_wire_read_uint16(data + 6);
+    header->value = xoe_wire_read_uint32(data + 8);
+
+    if (header->channel >= XOE_MUX_MAX_CHANNELS ||
+        header->type < XOE_MUX_OPEN || header->type > XOE_MUX_CLOSE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (inner != NULL) {
+        inner_payload->len = packet->payload->len - XOE_MUX_HEADER_SIZE;
+        inner_payload->data = (void*)(data + XOE_MUX_HEADER_SIZE);
+        inner_payload->owns_data = FALSE;
+        inner->protocol_id = header->inner_protocol;
+        inner->protocol_version = header->inner_version;
+        inner->payload = inner_payload;
+        inner->checksum = 0;
+    }
+    return 0;
+}
+
+void xoe_mux_free_payload(xoe_packet_t* packet)
+{
+    if (packet == NULL) {
+        return;
+    }
+    xoe_payload_release(packet->payload);
+    packet->payload = NULL;
+}
+
+/* ============================================================================
+ * Channel Table
+ * ============================================================================ */
+
+/**
+ * @brief Channel slot, or NULL for an ID out of range
+ */
+static xoe_mux_channel_t* mux_channel(xoe_mux_t* mux, uint16_t channel)
+{
+    if (mux == NULL || channel >= XOE_MUX_MAX_CHANNELS) {
+        return NULL;
+    }
+    return &mux->channels[channel];
+}
+
+/**
+ * @brief Move a channel to OPEN with both windows set (lock held)
+ */
+static void mux_set_open(xoe_mux_t* mux, xoe_mux_channel_t* ch,
+                         uint32_t peer_window)
+{
+    if (ch->state != XOE_MUX_CHANNEL_OPEN) {
+        metrics_add(METRIC_MUX_CHANNELS_OPEN, 1);
+    }
+    ch->state = XOE_MUX_CHANNEL_OPEN;
+    ch->tx_credit = peer_window;
+    pthread_cond_broadcast(&mux->credit_changed);
+}
+
+int xoe_mux_init(xoe_mux_t* mux)
+{
+    if (mux == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(mux, 0, sizeof(*mux));
+    if (pthread_mutex_init(&mux->lock, NULL) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    if (pthread_cond_init(&mux->credit_changed, NULL) != 0) {
+        pthread_mutex_destroy(&mux->lock);
+        return E_UNKNOWN_ERROR;
+    }
+    return 0;
+}
+
+void xoe_mux_destroy(xoe_mux_t* mux)
+{
+    int i;
+
+    if (mux == NULL) {
+        return;
+    }
+    for (i = 0; i < XOE_MUX_MAX_CHANNELS; i++) {
+        xoe_mux_channel_close(mux, (uint16_t)i);
+    }
+    pthread_cond_destroy(&mux->credit_changed);
+    pthread_mutex_destroy(&mux->lock);
+}
+
+void xoe_mux_shutdown(xoe_mux_t* mux)
+{
+    if (mux == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&mux->lock);
+    mux->shutdown = TRUE;
+    pthread_cond_broadcast(&mux->credit_changed);
+    pthread_mutex_unlock(&mux->lock);
+}
+
+int xoe_mux_channel_open(xoe_mux_t* mux, uint16_t channel,
+                         uint16_t inner_protocol, uint16_t inner_version,
+                         uint32_t rx_window)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int result = 0;
+
+    if (ch == NULL || rx_window < XOE_MUX_MIN_WINDOW) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (ch->state != XOE_MUX_CHANNEL_CLOSED) {
+        result = E_INVALID_STATE;
+    } else {
+        memset(ch, 0, sizeof(*ch));
+        ch->state = XOE_MUX_CHANNEL_OPENING;
+        ch->inner_protocol = inner_protocol;
+        ch->inner_version = inner_version;
+        ch->rx_window = rx_window;
+        ch->rx_outstanding = rx_window;
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+int xoe_mux_channel_accept(xoe_mux_t* mux, uint16_t channel,
+                           uint16_t inner_protocol, uint16_t inner_version,
+                           uint32_t peer_window, uint32_t rx_window)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int result = 0;
+
+    if (ch == NULL || rx_window < XOE_MUX_MIN_WINDOW) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (peer_window < XOE_MUX_MIN_WINDOW) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (ch->state != XOE_MUX_CHANNEL_CLOSED) {
+        result = E_INVALID_STATE;
+    } else {
+        memset(ch, 0, sizeof(*ch));
+        ch->inner_protocol = inner_protocol;
+        ch->inner_version = inner_version;
+        ch->rx_window = rx_window;
+        ch->rx_outstanding = rx_window;
+        mux_set_open(mux, ch, peer_window);
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+int xoe_mux_channel_opened(xoe_mux_t* mux, uint16_t channel,
+                           uint32_t peer_window)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int result = 0;
+
+    if (ch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (peer_window < XOE_MUX_MIN_WINDOW) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (ch->state != XOE_MUX_CHANNEL_OPENING) {
+        result = E_INVALID_STATE;
+    } else {
+        mux_set_open(mux, ch, peer_window);
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+int xoe_mux_channel_close(xoe_mux_t* mux, uint16_t channel)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int previous;
+
+    if (ch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    previous = ch->state;
+    if (previous == XOE_MUX_CHANNEL_OPEN) {
+        metrics_sub(METRIC_MUX_CHANNELS_OPEN, 1);
+    }
+    ch->state = XOE_MUX_CHANNEL_CLOSED;
+    ch->tx_credit = 0;
+    pthread_cond_broadcast(&mux->credit_changed);
+    pthread_mutex_unlock(&mux->lock);
+    return previous;
+}
+
+int xoe_mux_channel_state(xoe_mux_t* mux, uint16_t channel)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int state;
+
+    if (ch == NULL) {
+        return XOE_MUX_CHANNEL_CLOSED;
+    }
+    pthread_mutex_lock(&mux->lock);
+    state = ch->state;
+    pthread_mutex_unlock(&mux->lock);
+    return state;
+}
+
+int xoe_mux_tx_acquire(xoe_mux_t* mux, uint16_t channel, uint32_t min_len,
+                       uint32_t max_len, int timeout_ms)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    struct timespec deadline;
+    struct timeval now;
+    int stalled = FALSE;
+    int result;
+
+    if (ch == NULL || min_len == 0 || min_len > XOE_MUX_MIN_WINDOW ||
+        max_len < min_len) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (timeout_ms >= 0) {
+        gettimeofday(&now, NULL);
+        deadline.tv_sec = now.tv_sec + (timeout_ms / 1000);
+        deadline.tv_nsec = (now.tv_usec * 1000) +
+                           ((long)(timeout_ms % 1000) * 1000000);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    for (;;) {
+        if (mux->shutdown || ch->state == XOE_MUX_CHANNEL_CLOSED) {
+            result = E_INVALID_STATE;
+            break;
+        }
+        if (ch->state == XOE_MUX_CHANNEL_OPEN && ch->tx_credit >= min_len) {
+            result = (int)((ch->tx_credit < max_len) ? ch->tx_credit : max_len);
+            ch->tx_credit -= (uint32_t)result;
+            break;
+        }
+
+        /* Count waits for credit, not the wait for OPEN_ACK */
+        if (!stalled && ch->state == XOE_MUX_CHANNEL_OPEN) {
+            stalled = TRUE;
+            metrics_add(METRIC_MUX_CREDIT_STALLS, 1);
+        }
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&mux->credit_changed, &mux->lock);
+        } else if (pthread_cond_timedwait(&mux->credit_changed, &mux->lock,
+                                          &deadline) == ETIMEDOUT) {
+            result = E_TIMEOUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+int xoe_mux_tx_try(xoe_mux_t* mux, uint16_t channel, uint32_t len)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int result = 0;
+
+    if (ch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (mux->shutdown || ch->state != XOE_MUX_CHANNEL_OPEN) {
+        result = E_INVALID_STATE;
+    } else if (ch->tx_credit < len) {
+        result = E_WOULD_BLOCK;
+    } else {
+        ch->tx_credit -= len;
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+int xoe_mux_tx_grant(xoe_mux_t* mux, uint16_t channel, uint32_t bytes)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int result = 0;
+
+    if (ch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (ch->state == XOE_MUX_CHANNEL_OPEN) {
+        if (bytes > XOE_WIRE_MAX_PAYLOAD ||
+            ch->tx_credit > XOE_WIRE_MAX_PAYLOAD - bytes) {
+            result = E_PROTOCOL_ERROR;
+        } else {
+            ch->tx_credit += bytes;
+            pthread_cond_broadcast(&mux->credit_changed);
+        }
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+int xoe_mux_rx_accept(xoe_mux_t* mux, uint16_t channel, uint32_t len)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    int result = 0;
+
+    if (ch == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (ch->state != XOE_MUX_CHANNEL_OPEN) {
+        result = E_INVALID_STATE;
+    } else if (len > ch->rx_outstanding) {
+        result = E_PROTOCOL_ERROR;
+    } else {
+        ch->rx_outstanding -= len;
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return result;
+}
+
+uint32_t xoe_mux_rx_consumed(xoe_mux_t* mux, uint16_t channel, uint32_t len)
+{
+    xoe_mux_channel_t* ch = mux_channel(mux, channel);
+    uint32_t credit = 0;
+
+    if (ch == NULL || len == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&mux->lock);
+    if (ch->state == XOE_MUX_CHANNEL_OPEN) {
+        ch->rx_pending += len;
+        if (ch->rx_pending >= ch->rx_window / XOE_MUX_CREDIT_DIVISOR ||
+            ch->rx_outstanding == 0) {
+            credit = ch->rx_pending;
+            ch->rx_outstanding += credit;
+            ch->rx_pending = 0;
+        }
+    }
+    pthread_mutex_unlock(&mux->lock);
+    return credit;
+}
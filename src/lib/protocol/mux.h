@@ -0,0 +1,263 @@
+/**
+ * @file mux.h
+ * @brief Channel multiplexing over one XOE connection
+ *
+ * Carries several independent streams (for example the ports of a serial
+ * concentrator) over one TCP connection, and so one TLS session, as
+ * XOE_PROTOCOL_MUX frames. Each frame starts with a fixed header naming
+ * the channel and the frame type, followed for DATA frames by the payload
+ * the inner protocol would otherwise have sent as its own frame:
+ *
+ *   channel (2) | type (1) | reserved (1) | inner protocol_id (2) |
+ *   inner protocol_version (2) | value (4)            (network order)
+ *
+ * Either side opens a channel with OPEN, naming the inner protocol and
+ * the receive window it grants; the peer answers OPEN_ACK with its own
+ * window, or CLOSE with a reason. Flow control is credit based and per
+ * channel: a sender may have at most the granted window of DATA payload
+ * bytes unacknowledged, and the receiver returns bytes with CREDIT once it
+ * has consumed them. A slow channel therefore stops only itself, never
+ * the other channels sharing the connection.
+ *
+ * xoe_mux_t keeps the credit state of all channels of one connection and
+ * is thread-safe: senders may block in xoe_mux_tx_acquire() while the
+ * receive thread grants credit.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef MUX_H
+#define MUX_H
+
+#include <pthread.h>
+
+#include "lib/common/types.h"
+#include "lib/protocol/protocol.h"
+
+/* Multiplexing protocol version */
+#define XOE_MUX_VERSION 0x0001
+
+/* Channel header size in bytes */
+#define XOE_MUX_HEADER_SIZE 12
+
+/* Channels per connection (channel IDs 0 .. XOE_MUX_MAX_CHANNELS - 1) */
+#define XOE_MUX_MAX_CHANNELS 64
+
+/* Receive window granted when the caller has no better figure (bytes) */
+#define XOE_MUX_DEFAULT_WINDOW (16 * 1024)
+
+/* Smallest window accepted; must hold one full inner frame */
+#define XOE_MUX_MIN_WINDOW 1024
+
+/* Consumed bytes are credited back once this fraction of the window */
+#define XOE_MUX_CREDIT_DIVISOR 4
+
+/* Frame types */
+#define XOE_MUX_OPEN     1   /* Open channel; value = receive window */
+#define XOE_MUX_OPEN_ACK 2   /* Channel accepted; value = receive window */
+#define XOE_MUX_DATA     3   /* Inner protocol payload */
+#define XOE_MUX_CREDIT   4   /* value = payload bytes credited back */
+#define XOE_MUX_CLOSE    5   /* Channel closed; value = reason (positive E_*) */
+
+/* Channel states */
+#define XOE_MUX_CHANNEL_CLOSED  0
+#define XOE_MUX_CHANNEL_OPENING 1   /* OPEN sent, waiting for OPEN_ACK */
+#define XOE_MUX_CHANNEL_OPEN    2
+
+/**
+ * @brief Decoded channel header
+ */
+typedef struct {
+    uint16_t channel;           /* Channel ID */
+    uint8_t type;               /* XOE_MUX_OPEN, ... */
+    uint16_t inner_protocol;    /* Protocol carried on the channel */
+    uint16_t inner_version;     /* Its version */
+    uint32_t value;             /* Window, credit or reason (see type) */
+} xoe_mux_header_t;
+
+/**
+ * @brief Credit state of one channel
+ */
+typedef struct {
+    int state;                  /* XOE_MUX_CHANNEL_* */
+    uint16_t inner_protocol;
+    uint16_t inner_version;
+    uint32_t tx_credit;         /* Payload bytes we may still send */
+    uint32_t rx_window;         /* Window we granted the peer */
+    uint32_t rx_outstanding;    /* Payload bytes the peer may still send */
+    uint32_t rx_pending;        /* Consumed bytes not yet credited back */
+} xoe_mux_channel_t;
+
+/**
+ * @brief Channel table of one connection
+ */
+typedef struct xoe_mux {
+    pthread_mutex_t lock;
+    pthread_cond_t credit_changed;  /* Credit granted, state changed */
+    int shutdown;
+    xoe_mux_channel_t channels[XOE_MUX_MAX_CHANNELS];
+} xoe_mux_t;
+
+/* ============================================================================
+ * Framing
+ * ============================================================================ */
+
+/**
+ * @brief Allocate a channel frame with room for @p inner_len payload bytes
+ *
+ * Writes the header into a pooled payload and points @p inner at the
+ * bytes after it, which the caller fills before sending.
+ *
+ * @param header    Channel header
+ * @param inner_len Payload bytes after the header
+ * @param packet    Receives the frame (free with xoe_mux_free_payload())
+ * @param inner     Receives the start of the payload area (may be NULL)
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_BUFFER_TOO_SMALL if the
+ *         frame would exceed the wire maximum, E_OUT_OF_MEMORY
+ */
+int xoe_mux_encapsulate(const xoe_mux_header_t* header, uint32_t inner_len,
+                        xoe_packet_t* packet, uint8_t** inner);
+
+/**
+ * @brief Decode a channel frame
+ *
+ * @p inner is filled in as the packet the inner protocol would have
+ * received, with @p inner_payload pointing into @p packet's buffer
+ * (owns_data FALSE); it stays valid while @p packet is. The inner
+ * checksum is left 0.
+ *
+ * @param packet        XOE_PROTOCOL_MUX frame
+ * @param header        Receives the channel header
+ * @param inner         Receives the inner packet view (may be NULL)
+ * @param inner_payload Storage for the inner payload view (may be NULL
+ *                      when @p inner is)
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_PROTOCOL_ERROR for a
+ *         foreign or truncated frame, an unknown type or channel
+ */
+int xoe_mux_decapsulate(const xoe_packet_t* packet, xoe_mux_header_t* header,
+                        xoe_packet_t* inner, xoe_payload_t* inner_payload);
+
+/**
+ * @brief Release a frame built by xoe_mux_encapsulate()
+ */
+void xoe_mux_free_payload(xoe_packet_t* packet);
+
+/* ============================================================================
+ * Channel Table
+ * ============================================================================ */
+
+/**
+ * @brief Initialize a channel table with every channel closed
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_UNKNOWN_ERROR
+ */
+int xoe_mux_init(xoe_mux_t* mux);
+
+/**
+ * @brief Destroy a channel table (no thread may be using it)
+ */
+void xoe_mux_destroy(xoe_mux_t* mux);
+
+/**
+ * @brief Fail all waiting and later xoe_mux_tx_acquire() calls
+ */
+void xoe_mux_shutdown(xoe_mux_t* mux);
+
+/**
+ * @brief Record a locally opened channel (send OPEN with @p rx_window)
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT for a bad channel or a window
+ *         below XOE_MUX_MIN_WINDOW, E_INVALID_STATE if the channel is not
+ *         closed
+ */
+int xoe_mux_channel_open(xoe_mux_t* mux, uint16_t channel,
+                         uint16_t inner_protocol, uint16_t inner_version,
+                         uint32_t rx_window);
+
+/**
+ * @brief Accept a channel the peer opened (reply OPEN_ACK with @p rx_window)
+ *
+ * @param peer_window   Window from the peer's OPEN (our send credit)
+ *
+ * @return As xoe_mux_channel_open(); a @p peer_window below
+ *         XOE_MUX_MIN_WINDOW is E_PROTOCOL_ERROR
+ */
+int xoe_mux_channel_accept(xoe_mux_t* mux, uint16_t channel,
+                           uint16_t inner_protocol, uint16_t inner_version,
+                           uint32_t peer_window, uint32_t rx_window);
+
+/**
+ * @brief Complete a locally opened channel on OPEN_ACK
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_INVALID_STATE if no OPEN
+ *         is pending, E_PROTOCOL_ERROR for a window below the minimum
+ */
+int xoe_mux_channel_opened(xoe_mux_t* mux, uint16_t channel,
+                           uint32_t peer_window);
+
+/**
+ * @brief Close a channel (either side's CLOSE); wakes blocked senders
+ *
+ * @return Previous state (XOE_MUX_CHANNEL_*), or E_INVALID_ARGUMENT
+ */
+int xoe_mux_channel_close(xoe_mux_t* mux, uint16_t channel);
+
+/**
+ * @brief Current state of a channel (XOE_MUX_CHANNEL_CLOSED if invalid)
+ */
+int xoe_mux_channel_state(xoe_mux_t* mux, uint16_t channel);
+
+/**
+ * @brief Take send credit, waiting for the peer if necessary
+ *
+ * Waits until the channel is open with at least @p min_len bytes of
+ * credit, then takes up to @p max_len of it.
+ *
+ * @param min_len       Smallest useful amount (1 .. XOE_MUX_MIN_WINDOW)
+ * @param max_len       Largest amount wanted (>= @p min_len)
+ * @param timeout_ms    Longest wait (< 0 waits indefinitely)
+ *
+ * @return Bytes taken (> 0), E_TIMEOUT, E_INVALID_STATE once the channel
+ *         is closed or the table shut down, E_INVALID_ARGUMENT
+ */
+int xoe_mux_tx_acquire(xoe_mux_t* mux, uint16_t channel, uint32_t min_len,
+                       uint32_t max_len, int timeout_ms);
+
+/**
+ * @brief Take exactly @p len bytes of send credit without waiting
+ *
+ * @return 0 on success, E_WOULD_BLOCK without enough credit,
+ *         E_INVALID_STATE if the channel is not open, E_INVALID_ARGUMENT
+ */
+int xoe_mux_tx_try(xoe_mux_t* mux, uint16_t channel, uint32_t len);
+
+/**
+ * @brief Add credit from the peer's CREDIT frame
+ *
+ * @return 0 on success (also for a closed channel, where credit may race
+ *         the CLOSE), E_INVALID_ARGUMENT, E_PROTOCOL_ERROR if the credit
+ *         would overflow
+ */
+int xoe_mux_tx_grant(xoe_mux_t* mux, uint16_t channel, uint32_t bytes);
+
+/**
+ * @brief Account for a received DATA frame of @p len payload bytes
+ *
+ * @return 0 on success, E_INVALID_STATE if the channel is not open,
+ *         E_PROTOCOL_ERROR if the peer exceeded its window
+ */
+int xoe_mux_rx_accept(xoe_mux_t* mux, uint16_t channel, uint32_t len);
+
+/**
+ * @brief Release consumed payload bytes
+ *
+ * Batches releases until 1 / XOE_MUX_CREDIT_DIVISOR of the window has
+ * been consumed, or the peer has no credit left.
+ *
+ * @return Bytes to send back in a CREDIT frame now (0 = nothing due yet)
+ */
+uint32_t xoe_mux_rx_consumed(xoe_mux_t* mux, uint16_t channel, uint32_t len);
+
+#endif /* MUX_H */
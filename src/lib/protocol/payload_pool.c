@@ -0,0 +1,276 @@
+/**
+ * @file payload_pool.c
+ * @brief Per-thread size-class cache for xoe_payload_t blocks
+ *
+ * Each block is a single allocation: a small header, the xoe_payload_t
+ * descriptor handed to callers, and the data buffer right behind it.
+ * Caches live in pthread thread-specific data, so allocation and release
+ * never take a lock; a block released on another thread simply joins that
+ * thread's cache. A reference count in the block header lets several
+ * owners share one payload (xoe_payload_ref()).
+ *
+ * A block's capacity is charged to the memory budget (mem_budget.h) while
+ * it is handed out and uncharged with its last reference, so cached
+ * blocks are not counted.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "payload_pool.h"
+#include "lib/common/definitions.h"
+#include "lib/common/mem_budget.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Number of size classes: 256 B, 1 KiB, ... 1 MiB (powers of four) */
+#define POOL_NUM_CLASSES 7
+
+/* Size class index for blocks too large to cache */
+#define POOL_CLASS_UNCACHED (-1)
+
+typedef struct pool_block {
+    struct pool_block* next;    /* Free list link while cached */
+    int size_class;             /* Class index or POOL_CLASS_UNCACHED */
+    int refs;                   /* References held (atomic) */
+    uint32_t capacity;          /* Data bytes behind the header */
+    xoe_payload_t payload;      /* Descriptor handed to the caller */
+} pool_block_t;
+
+/* Data starts right after the block header (pointer-aligned) */
+#define POOL_BLOCK_DATA(block) ((uint8_t*)(block) + sizeof(pool_block_t))
+
+typedef struct {
+    pool_block_t* free_list[POOL_NUM_CLASSES];
+    uint32_t count[POOL_NUM_CLASSES];
+} pool_cache_t;
+
+/* Thread-specific data key for per-thread caches */
+static pthread_key_t pool_cache_key;
+static pthread_once_t pool_cache_key_once = PTHREAD_ONCE_INIT;
+static int pool_cache_key_valid = FALSE;
+
+/**
+ * @brief Free every cached block and the cache itself
+ *
+ * Thread-specific data destructor; also used for explicit cleanup.
+ */
+static void pool_cache_destroy(void* ptr)
+{
+    pool_cache_t* cache = (pool_cache_t*)ptr;
+    pool_block_t* block;
+    int i;
+
+    if (cache == NULL) {
+        return;
+    }
+
+    for (i = 0; i < POOL_NUM_CLASSES; i++) {
+        while (cache->free_list[i] != NULL) {
+            block = cache->free_list[i];
+            cache->free_list[i] = block->next;
+            free(block);
+        }
+    }
+    free(cache);
+}
+
+/**
+ * @brief Create the thread-specific data key (once per process)
+ */
+static void make_pool_cache_key(void)
+{
+    pool_cache_key_valid =
+        (pthread_key_create(&pool_cache_key, pool_cache_destroy) == 0);
+}
+
+/**
+ * @brief Get the calling thread's cache, creating it on first use
+ *
+ * @return Cache, or NULL if caching is unavailable (blocks then go
+ *         straight to malloc()/free())
+ */
+static pool_cache_t* get_pool_cache(void)
+{
+    pool_cache_t* cache;
+
+    pthread_once(&pool_cache_key_once, make_pool_cache_key);
+    if (!pool_cache_key_valid) {
+        return NULL;
+    }
+
+    cache = (pool_cache_t*)pthread_getspecific(pool_cache_key);
+    if (cache == NULL) {
+        cache = (pool_cache_t*)calloc(1, sizeof(pool_cache_t));
+        if (cache != NULL && pthread_setspecific(pool_cache_key, cache) != 0) {
+            free(cache);
+            cache = NULL;
+        }
+    }
+
+    return cache;
+}
+
+/**
+ * @brief Map a data length to its size class
+ *
+ * @return Class index, or POOL_CLASS_UNCACHED if above the largest class
+ */
+static int size_class_for(uint32_t len)
+{
+    uint32_t class_size = XOE_PAYLOAD_POOL_MIN_CLASS;
+    int i;
+
+    for (i = 0; i < POOL_NUM_CLASSES; i++) {
+        if (len <= class_size) {
+            return i;
+        }
+        class_size <<= 2;
+    }
+    return POOL_CLASS_UNCACHED;
+}
+
+/**
+ * @brief Data capacity of a size class
+ */
+static uint32_t class_capacity(int size_class)
+{
+    return (uint32_t)XOE_PAYLOAD_POOL_MIN_CLASS << (2 * size_class);
+}
+
+/**
+ * @brief Maximum number of cached blocks for a size class
+ */
+static uint32_t class_limit(int size_class)
+{
+    uint32_t limit = XOE_PAYLOAD_POOL_CLASS_BYTES / class_capacity(size_class);
+
+    if (limit > XOE_PAYLOAD_POOL_CLASS_MAX_BLOCKS) {
+        limit = XOE_PAYLOAD_POOL_CLASS_MAX_BLOCKS;
+    }
+    if (limit < 2) {
+        limit = 2;
+    }
+    return limit;
+}
+
+xoe_payload_t* xoe_payload_alloc(uint32_t len)
+{
+    pool_cache_t* cache;
+    pool_block_t* block = NULL;
+    int size_class;
+    size_t capacity;
+
+    size_class = size_class_for(len);
+
+    if (size_class != POOL_CLASS_UNCACHED) {
+        cache = get_pool_cache();
+        if (cache != NULL && cache->free_list[size_class] != NULL) {
+            block = cache->free_list[size_class];
+            cache->free_list[size_class] = block->next;
+            cache->count[size_class]--;
+        }
+        capacity = class_capacity(size_class);
+    } else {
+        capacity = len;
+    }
+
+    if (block == NULL) {
+        block = (pool_block_t*)malloc(sizeof(pool_block_t) + capacity);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->size_class = size_class;
+        block->capacity = (uint32_t)capacity;
+    }
+
+    block->next = NULL;
+    block->refs = 1;
+    block->payload.data = POOL_BLOCK_DATA(block);
+    block->payload.len = len;
+    block->payload.owns_data = XOE_PAYLOAD_POOLED;
+    mem_budget_charge(block->capacity);
+
+    return &block->payload;
+}
+
+xoe_payload_t* xoe_payload_ref(xoe_payload_t* payload)
+{
+    pool_block_t* block;
+    xoe_payload_t* copy;
+
+    if (payload == NULL) {
+        return NULL;
+    }
+
+    if (payload->owns_data == XOE_PAYLOAD_POOLED) {
+        block = (pool_block_t*)((uint8_t*)payload -
+                                offsetof(pool_block_t, payload));
+        __atomic_add_fetch(&block->refs, 1, __ATOMIC_RELAXED);
+        return payload;
+    }
+
+    copy = xoe_payload_alloc(payload->len);
+    if (copy != NULL && payload->len > 0) {
+        memcpy(copy->data, payload->data, payload->len);
+    }
+    return copy;
+}
+
+void xoe_payload_release(xoe_payload_t* payload)
+{
+    pool_block_t* block;
+    pool_cache_t* cache;
+
+    if (payload == NULL) {
+        return;
+    }
+
+    if (payload->owns_data != XOE_PAYLOAD_POOLED) {
+        /* Plain malloc'd descriptor; data freed only if owned */
+        if (payload->owns_data && payload->data != NULL) {
+            free(payload->data);
+        }
+        free(payload);
+        return;
+    }
+
+    block = (pool_block_t*)((uint8_t*)payload - offsetof(pool_block_t, payload));
+
+    /* Shared: the last reference returns the block */
+    if (__atomic_sub_fetch(&block->refs, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+    mem_budget_uncharge(block->capacity);
+
+    if (block->size_class != POOL_CLASS_UNCACHED) {
+        cache = get_pool_cache();
+        if (cache != NULL &&
+            cache->count[block->size_class] < class_limit(block->size_class)) {
+            block->next = cache->free_list[block->size_class];
+            cache->free_list[block->size_class] = block;
+            cache->count[block->size_class]++;
+            return;
+        }
+    }
+
+    free(block);
+}
+
+void xoe_payload_pool_thread_cleanup(void)
+{
+    pool_cache_t* cache;
+
+    pthread_once(&pool_cache_key_once, make_pool_cache_key);
+    if (!pool_cache_key_valid) {
+        return;
+    }
+
+    cache = (pool_cache_t*)pthread_getspecific(pool_cache_key);
+    if (cache != NULL) {
+        pthread_setspecific(pool_cache_key, NULL);
+        pool_cache_destroy(cache);
+    }
+}
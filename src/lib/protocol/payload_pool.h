@@ -0,0 +1,95 @@
+/**
+ * @file payload_pool.h
+ * @brief Pooled allocator for xoe_payload_t buffers
+ *
+ * Allocates a payload descriptor and its data buffer as one block taken
+ * from a per-thread cache of power-of-four size classes (256 B .. 1 MiB).
+ * Released blocks go back to the releasing thread's cache, so the steady
+ * state of a bridge moving frames does no malloc()/free() at all and small
+ * chunks no longer fragment the heap.
+ *
+ * Payloads from this pool carry owns_data == XOE_PAYLOAD_POOLED and must be
+ * released with xoe_payload_release() (which the xoe_wire / serial / USB
+ * free_payload functions call). Blocks may be released on any thread.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef PAYLOAD_POOL_H
+#define PAYLOAD_POOL_H
+
+#include "lib/common/types.h"
+#include "lib/protocol/protocol.h"
+
+/* owns_data value for payloads allocated by xoe_payload_alloc() */
+#define XOE_PAYLOAD_POOLED 2
+
+/* Smallest and largest pooled size class (larger requests bypass caching) */
+#define XOE_PAYLOAD_POOL_MIN_CLASS 256
+#define XOE_PAYLOAD_POOL_MAX_CLASS (1024 * 1024)
+
+/* Per-thread, per-class cache limits (smaller in the small profile) */
+#ifndef XOE_PAYLOAD_POOL_CLASS_BYTES
+#if XOE_SMALL_FOOTPRINT
+#define XOE_PAYLOAD_POOL_CLASS_BYTES (64 * 1024)
+#else
+#define XOE_PAYLOAD_POOL_CLASS_BYTES (512 * 1024)
+#endif
+#endif
+#ifndef XOE_PAYLOAD_POOL_CLASS_MAX_BLOCKS
+#if XOE_SMALL_FOOTPRINT
+#define XOE_PAYLOAD_POOL_CLASS_MAX_BLOCKS 8
+#else
+#define XOE_PAYLOAD_POOL_CLASS_MAX_BLOCKS 32
+#endif
+#endif
+
+/**
+ * @brief Allocate a payload with room for @p len data bytes
+ *
+ * The returned payload has data pointing at its own buffer, len set to
+ * @p len and owns_data set to XOE_PAYLOAD_POOLED.
+ *
+ * @param len   Data bytes required (0 is allowed)
+ *
+ * @return Payload, or NULL on allocation failure
+ */
+xoe_payload_t* xoe_payload_alloc(uint32_t len);
+
+/**
+ * @brief Take another reference to a payload
+ *
+ * Lets one received frame be queued to several destinations without a
+ * copy each: every holder releases its reference with
+ * xoe_payload_release(), and the block goes back to a cache with the
+ * last one. A shared payload is immutable; no holder may write to it.
+ * Payloads not from this pool have no count and are copied into one
+ * that is, which the caller then owns (and may share in turn).
+ *
+ * @param payload   Payload to share (NULL returns NULL)
+ *
+ * @return @p payload itself for a pooled payload, otherwise a pooled
+ *         copy, or NULL on allocation failure
+ */
+xoe_payload_t* xoe_payload_ref(xoe_payload_t* payload);
+
+/**
+ * @brief Release a payload according to its owns_data mode
+ *
+ * XOE_PAYLOAD_POOLED drops one reference and returns the block to the
+ * calling thread's cache with the last one, TRUE frees both data and
+ * descriptor, FALSE frees the descriptor only.
+ *
+ * @param payload   Payload to release (NULL is a no-op)
+ */
+void xoe_payload_release(xoe_payload_t* payload);
+
+/**
+ * @brief Drop every block cached by the calling thread
+ *
+ * Runs automatically when a thread exits; call it explicitly from the
+ * main thread on shutdown or when memory should be handed back early.
+ */
+void xoe_payload_pool_thread_cleanup(void);
+
+#endif /* PAYLOAD_POOL_H */
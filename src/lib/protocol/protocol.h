@@ -4,9 +4,12 @@
 #include "lib/common/types.h"
 
 /* Protocol ID constants */
-#define XOE_PROTOCOL_RAW    0x0000  /* Raw/echo protocol (future) */
+#define XOE_PROTOCOL_RAW    0x0000  /* Raw byte stream, echoed (standard client) */
 #define XOE_PROTOCOL_SERIAL 0x0001  /* Serial port protocol */
 #define XOE_PROTOCOL_USB    0x0002  /* USB device protocol */
+#define XOE_PROTOCOL_MUX    0x0003  /* Channel multiplexing (lib/protocol/mux.h) */
+#define XOE_PROTOCOL_CLUSTER 0x0004 /* Links between server nodes (core/cluster.h) */
+#define XOE_PROTOCOL_WIRE_CTRL 0xFF00  /* Wire-level control (feature negotiation) */
 
 
 
@@ -31,6 +34,10 @@
  *   Caller must only free the payload structure, not the data buffer.
  *   The data buffer is either a stack variable or owned by another
  *   structure.
+ * - If owns_data == XOE_PAYLOAD_POOLED (lib/protocol/payload_pool.h):
+ *   Descriptor and data are one block from the payload pool. Release it
+ *   with xoe_payload_release() only; never free() either pointer. This is
+ *   what xoe_wire_recv() and the protocol encapsulate functions return.
  *
  * Example (owned data):
  *   xoe_payload_t* p = malloc(sizeof(xoe_payload_t));
@@ -50,7 +57,7 @@
 typedef struct {
     uint32_t len;       /* Length of data in bytes */
     void* data;         /* Pointer to data buffer */
-    int owns_data;      /* TRUE if data was malloc'd and should be freed */
+    int owns_data;      /* FALSE, TRUE (malloc'd) or XOE_PAYLOAD_POOLED */
 } xoe_payload_t;
 
 /**
@@ -70,7 +77,7 @@ typedef struct {
  * - The packet DOES own the payload pointer (packet->payload)
  * - The payload's data ownership depends on payload->owns_data flag
  *
- * Proper cleanup sequence:
+ * Proper cleanup sequence (xoe_payload_release() implements step 1):
  *   1. If packet->payload != NULL:
  *      a. If packet->payload->owns_data == TRUE:
  *         free(packet->payload->data);
@@ -80,7 +87,7 @@ typedef struct {
  * Example (encapsulation creates owned payload):
  *   xoe_packet_t packet;
  *   usb_protocol_encapsulate(urb, data, len, &packet);
- *   // packet.payload and packet.payload->data are now malloc'd
+ *   // packet.payload is now a pooled block
  *   // Later: usb_protocol_free_payload(&packet);
  *
  * Thread safety: Packets are not thread-safe. Each thread must use
@@ -97,60 +104,72 @@ typedef struct {
     uint32_t checksum;
 } xoe_packet_t;
 
-/* An opaque pointer to a struct that will hold protocol-specific session data. */
-/* The core server doesn't need to know the contents of this struct. */
-struct protocol_session;
+/* Where a protocol's frames run (protocol_handler_t.dispatch) */
+#define XOE_DISPATCH_INLINE 0   /* On the I/O thread owning the connection */
+#define XOE_DISPATCH_POOL   1   /* On the shared protocol pool's threads */
+
+/* The server's per-connection state (client_info_t, core/server.h).
+ * Handlers keep their per-connection session in it. */
+struct client_info;
 
 /**
  * @brief Defines the interface (a "contract") for any protocol handler.
  *
+ * The server looks handlers up by protocol_id in its registry
+ * (core/protocol_registry.h) for every frame it receives; a protocol
+ * without one is echoed.
+ *
+ * DISPATCH:
+ * ---------
+ * - XOE_DISPATCH_INLINE: handle_packet() runs on the event loop worker
+ *   that owns the connection, in receive order, and may send on it
+ *   directly. For cheap, latency-critical protocols (serial).
+ * - XOE_DISPATCH_POOL: handle_packet() runs on a thread of the shared
+ *   protocol pool, which the protocol adds pool_threads threads to, so
+ *   CPU-heavy work (crypto, compression, authentication) never delays
+ *   other connections' frames. A connection's frames still run one at a
+ *   time and in order, though not always on the same thread. The handler
+ *   must not send on the connection itself; it queues replies with
+ *   protocol_registry_reply(), which the owning worker sends.
+ *
  * MEMORY OWNERSHIP SEMANTICS:
  * ---------------------------
- * Protocol handlers must follow strict memory ownership rules to prevent
- * leaks and double-free errors.
- *
- * init_session():
- * - Allocates and returns a new protocol_session structure
- * - The returned session is owned by the caller (core server)
- * - Returns NULL on allocation failure
- * - Must allocate all session-specific resources
- *
- * handle_data():
- * - Receives a session pointer owned by the caller
- * - May allocate temporary resources (must free before returning)
- * - Must NOT free the session structure itself
- * - Packet structures created during handling must be cleaned up
+ * handle_packet():
+ * - The packet and its payload belong to the caller and are released
+ *   once it returns; take xoe_payload_ref() to keep the payload longer
+ * - Per-connection state goes in the client structure, allocated on first
+ *   use
+ * - Returns 0, or a negative error code to close the connection
  *
  * cleanup_session():
- * - Receives a session pointer owned by the caller
- * - MUST free all session-specific resources
- * - MUST free the session structure itself
- * - After cleanup_session() returns, session pointer is invalid
+ * - Called on the owning worker when the connection closes, after the
+ *   protocol's pending frames for it have finished or been dropped
+ * - MUST free the state handle_packet() hung on the client
  *
  * Example protocol handler lifecycle:
- *   // Connection established
- *   struct protocol_session* sess = handler->init_session(socket);
- *
- *   // Data received
- *   handler->handle_data(sess);  // May create/free packets internally
+ *   // Frame received (inline, or queued to the pool)
+ *   handler->handle_packet(client, &packet);
  *
  *   // Connection closed
- *   handler->cleanup_session(sess);  // sess is now invalid
+ *   handler->cleanup_session(client);
  *
- * Thread safety: Protocol handlers must be thread-safe if the server
- *                supports concurrent connections. Each session is
- *                accessed by only one thread, but init_session() may
- *                be called concurrently.
+ * Thread safety: handle_packet() is called concurrently for different
+ *                connections (several workers, several pool threads),
+ *                never concurrently for one.
  */
 typedef struct {
     /* A human-readable name for the protocol. */
     const char* name;
-    /* Called to initialize a new session when a client connects. */
-    struct protocol_session* (*init_session)(int client_socket);
-    /* Called when there is data to be read from the client. */
-    void (*handle_data)(struct protocol_session* session);
-    /* Called to clean up a session when the connection is closed. */
-    void (*cleanup_session)(struct protocol_session* session);
+    /* The XOE_PROTOCOL_* frames it handles. */
+    uint16_t protocol_id;
+    /* XOE_DISPATCH_INLINE or XOE_DISPATCH_POOL. */
+    int dispatch;
+    /* Threads it adds to the shared pool (XOE_DISPATCH_POOL only). */
+    int pool_threads;
+    /* Called for every frame of the protocol. */
+    int (*handle_packet)(struct client_info* client, xoe_packet_t* packet);
+    /* Called when the connection closes (NULL if nothing to free). */
+    void (*cleanup_session)(struct client_info* client);
 } protocol_handler_t;
 
 #endif /* PROTOCOL_H */
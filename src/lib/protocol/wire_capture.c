@@ -0,0 +1,524 @@
+/*
+ * wire_capture.c - Full-frame wire capture to a trace file, and its reader
+ *
+ * The ring is addressed by free-running stream offsets: head is the end of
+ * the records taken (recording threads advance it under the lock), tail
+ * the end of what the writer has put in the file. A stream offset maps to
+ * ring position offset % XOE_WIRE_CAPTURE_RING and to file offset
+ * XOE_WIRE_CAPTURE_PAGE + offset, so ring and file stay page-aligned with
+ * each other. The writer copies [tail, head rounded down to a page) to the
+ * file without the lock held; recording threads never write below head,
+ * and refuse a record that would pass tail + XOE_WIRE_CAPTURE_RING.
+ *
+ * Timestamps are read under the lock, so records are in time order in
+ * the file even when several threads record at once.
+ *
+ * Author: [LLM-ARCH]
+ */
+
+/* posix_fallocate(), pwrite() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "wire_capture.h"
+#include "wire_trace.h"
+#include "lib/common/definitions.h"
+#include "lib/common/log.h"
+#include "lib/common/metrics.h"
+#include "lib/common/thread_sched.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#define CAPTURE_ALIGN(n) (((n) + 7u) & ~(size_t)7u)
+#define CAPTURE_PAGE_FLOOR(n) ((n) & ~(uint64_t)(XOE_WIRE_CAPTURE_PAGE - 1))
+
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Capture state (lock: capture_lock, except where marked atomic) */
+static struct {
+    pthread_cond_t wake;            /* Writer: pages to write, or stop */
+    pthread_t writer;
+    int active;                     /* Recording (atomic) */
+    int stopping;                   /* Writer: flush everything and exit */
+    int fd;
+    uint8_t* ring;
+    uint64_t head;                  /* Stream end of the records taken */
+    uint64_t tail;                  /* Stream end written to the file */
+    uint64_t max_bytes;             /* 0 = no limit */
+    uint64_t allocated;             /* File bytes preallocated */
+    uint64_t frames;
+    uint64_t dropped;
+    xoe_wire_capture_file_header_t header;
+} capture;
+
+/*
+ * Writer
+ */
+
+/**
+ * @brief Compute absolute deadline for pthread_cond_timedwait
+ */
+static void deadline_after_ms(struct timespec* ts, unsigned int timeout_ms)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    ts->tv_sec = now.tv_sec + (timeout_ms / 1000);
+    ts->tv_nsec = (now.tv_usec + (long)(timeout_ms % 1000) * 1000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * @brief Make sure the file has blocks up to @p file_end
+ */
+static int capture_reserve(uint64_t file_end)
+{
+    while (capture.allocated < file_end) {
+#if defined(__linux__) || defined(__FreeBSD__)
+        if (posix_fallocate(capture.fd, (off_t)capture.allocated,
+                            XOE_WIRE_CAPTURE_EXTENT) != 0 &&
+            ftruncate(capture.fd, (off_t)(capture.allocated +
+                                          XOE_WIRE_CAPTURE_EXTENT)) != 0) {
+            return E_IO_ERROR;
+        }
+#else
+        if (ftruncate(capture.fd, (off_t)(capture.allocated +
+                                          XOE_WIRE_CAPTURE_EXTENT)) != 0) {
+            return E_IO_ERROR;
+        }
+#endif
+        capture.allocated += XOE_WIRE_CAPTURE_EXTENT;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write stream bytes [from, to) from the ring to the file
+ *
+ * Called without the lock; only the writer touches the file and this
+ * part of the ring.
+ */
+static int capture_write(uint64_t from, uint64_t to)
+{
+    uint64_t pos;
+    size_t chunk;
+    ssize_t written;
+
+    if (capture_reserve(XOE_WIRE_CAPTURE_PAGE + to) != 0) {
+        return E_IO_ERROR;
+    }
+
+    while (from < to) {
+        pos = from % XOE_WIRE_CAPTURE_RING;
+        chunk = (size_t)(to - from);
+        if (chunk > XOE_WIRE_CAPTURE_RING - pos) {
+            chunk = (size_t)(XOE_WIRE_CAPTURE_RING - pos);
+        }
+        written = pwrite(capture.fd, capture.ring + pos, chunk,
+                         (off_t)(XOE_WIRE_CAPTURE_PAGE + from));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return E_IO_ERROR;
+        }
+        from += (uint64_t)written;
+    }
+    return 0;
+}
+
+/**
+ * @brief Zero-pad the records taken out to a page boundary (lock held)
+ */
+static void capture_pad_locked(void)
+{
+    uint64_t end = CAPTURE_PAGE_FLOOR(capture.head + XOE_WIRE_CAPTURE_PAGE - 1);
+
+    /* tail is page-aligned, so the padded end is still within the ring */
+    memset(capture.ring + capture.head % XOE_WIRE_CAPTURE_RING, 0,
+           (size_t)(end - capture.head));
+    capture.head = end;
+}
+
+static void* capture_writer(void* arg)
+{
+    struct timespec deadline;
+    uint64_t from;
+    uint64_t to;
+    int flush;
+    int failed = FALSE;
+
+    (void)arg;
+
+    pthread_mutex_lock(&capture_lock);
+    for (;;) {
+        flush = capture.stopping;
+        if (!flush && CAPTURE_PAGE_FLOOR(capture.head) <= capture.tail) {
+            deadline_after_ms(&deadline, XOE_WIRE_CAPTURE_FLUSH_MS);
+            flush = (pthread_cond_timedwait(&capture.wake, &capture_lock,
+                                            &deadline) == ETIMEDOUT);
+            flush = flush || capture.stopping;
+        }
+        if (flush) {
+            capture_pad_locked();
+        }
+
+        from = capture.tail;
+        to = CAPTURE_PAGE_FLOOR(capture.head);
+        if (to <= from) {
+            if (capture.stopping) {
+                break;
+            }
+            continue;
+        }
+
+        pthread_mutex_unlock(&capture_lock);
+        if (!failed && capture_write(from, to) != 0) {
+            LOG_ERROR("Wire capture: write failed, errno=%d: %s; recording "
+                      "stopped", errno, strerror(errno));
+            failed = TRUE;
+            __atomic_store_n(&capture.active, FALSE, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_lock(&capture_lock);
+        if (!failed) {
+            capture.tail = to;
+        } else {
+            /* Free the ring; nothing more reaches the file */
+            capture.head = capture.tail;
+        }
+    }
+    pthread_mutex_unlock(&capture_lock);
+
+    return NULL;
+}
+
+/*
+ * Recording
+ */
+
+int xoe_wire_capture_open(const char* path, int role, uint64_t max_bytes)
+{
+    struct timespec now;
+    void* ring;
+    int fd;
+
+    if (path == NULL || (role != XOE_WIRE_CAPTURE_ROLE_SERVER &&
+                         role != XOE_WIRE_CAPTURE_ROLE_CLIENT)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&capture_lock);
+    if (capture.ring != NULL) {
+        pthread_mutex_unlock(&capture_lock);
+        return E_INVALID_STATE;
+    }
+
+    if (posix_memalign(&ring, XOE_WIRE_CAPTURE_PAGE,
+                       XOE_WIRE_CAPTURE_RING) != 0) {
+        pthread_mutex_unlock(&capture_lock);
+        return E_OUT_OF_MEMORY;
+    }
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(ring);
+        pthread_mutex_unlock(&capture_lock);
+        return E_IO_ERROR;
+    }
+
+    memset(&capture.header, 0, sizeof(capture.header));
+    capture.header.magic = XOE_WIRE_CAPTURE_MAGIC;
+    capture.header.version = XOE_WIRE_CAPTURE_VERSION;
+    capture.header.page_size = XOE_WIRE_CAPTURE_PAGE;
+    capture.header.snaplen = XOE_WIRE_CAPTURE_SNAPLEN;
+    capture.header.role = (uint32_t)role;
+    clock_gettime(CLOCK_REALTIME, &now);
+    capture.header.start_realtime_ns = (uint64_t)now.tv_sec * 1000000000ULL +
+                                       (uint64_t)now.tv_nsec;
+    capture.header.start_ns = xoe_wire_trace_now_ns();
+
+    capture.fd = fd;
+    capture.ring = (uint8_t*)ring;
+    capture.head = 0;
+    capture.tail = 0;
+    capture.allocated = 0;
+    capture.max_bytes = max_bytes;
+    capture.frames = 0;
+    capture.dropped = 0;
+    capture.stopping = FALSE;
+
+    if (pwrite(fd, &capture.header, sizeof(capture.header), 0) !=
+            (ssize_t)sizeof(capture.header) ||
+        capture_reserve(XOE_WIRE_CAPTURE_PAGE) != 0 ||
+        pthread_cond_init(&capture.wake, NULL) != 0) {
+        goto fail;
+    }
+    if (thread_sched_create(&capture.writer, THREAD_CLASS_NONE,
+                            capture_writer, NULL) != 0) {
+        pthread_cond_destroy(&capture.wake);
+        goto fail;
+    }
+
+    __atomic_store_n(&capture.active, TRUE, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&capture_lock);
+    return 0;
+
+fail:
+    close(fd);
+    unlink(path);
+    free(ring);
+    capture.ring = NULL;
+    pthread_mutex_unlock(&capture_lock);
+    return E_IO_ERROR;
+}
+
+void xoe_wire_capture_close(void)
+{
+    pthread_mutex_lock(&capture_lock);
+    if (capture.ring == NULL) {
+        pthread_mutex_unlock(&capture_lock);
+        return;
+    }
+    __atomic_store_n(&capture.active, FALSE, __ATOMIC_RELEASE);
+    capture.stopping = TRUE;
+    pthread_cond_signal(&capture.wake);
+    pthread_mutex_unlock(&capture_lock);
+
+    pthread_join(capture.writer, NULL);
+
+    pthread_mutex_lock(&capture_lock);
+    capture.header.data_length = capture.tail;
+    capture.header.frames = capture.frames;
+    capture.header.dropped = capture.dropped;
+    if (pwrite(capture.fd, &capture.header, sizeof(capture.header), 0) !=
+            (ssize_t)sizeof(capture.header) ||
+        ftruncate(capture.fd,
+                  (off_t)(XOE_WIRE_CAPTURE_PAGE + capture.tail)) != 0) {
+        LOG_ERROR("Wire capture: could not finish the file, errno=%d: %s",
+                  errno, strerror(errno));
+    }
+    close(capture.fd);
+    capture.fd = -1;
+    pthread_cond_destroy(&capture.wake);
+    free(capture.ring);
+    capture.ring = NULL;
+    pthread_mutex_unlock(&capture_lock);
+}
+
+int xoe_wire_capture_active(void)
+{
+    return __atomic_load_n(&capture.active, __ATOMIC_ACQUIRE);
+}
+
+void xoe_wire_capture_get_stats(xoe_wire_capture_stats_t* stats)
+{
+    if (stats == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&capture_lock);
+    stats->frames = capture.frames;
+    stats->dropped = capture.dropped;
+    stats->bytes = capture.tail;
+    pthread_mutex_unlock(&capture_lock);
+}
+
+void xoe_wire_capture_frame(int fd, int type, const uint8_t* header_buffer,
+                            const uint8_t* payload, int status)
+{
+    xoe_wire_capture_record_t record;
+    uint8_t* slot;
+    uint64_t gap;
+    uint64_t pos;
+    size_t size;
+
+    if (!__atomic_load_n(&capture.active, __ATOMIC_ACQUIRE) ||
+        header_buffer == NULL) {
+        return;
+    }
+
+    memset(&record, 0, sizeof(record));
+    record.conn_id = xoe_wire_trace_conn_id(fd);
+    record.length = xoe_wire_read_uint32(header_buffer + 4);
+    record.captured = (payload == NULL) ? 0
+                      : (record.length < XOE_WIRE_CAPTURE_SNAPLEN)
+                      ? record.length : XOE_WIRE_CAPTURE_SNAPLEN;
+    record.type = (uint8_t)type;
+    record.status = (uint8_t)status;
+    memcpy(record.header, header_buffer, XOE_WIRE_HEADER_SIZE);
+    size = CAPTURE_ALIGN(sizeof(record) + record.captured);
+
+    pthread_mutex_lock(&capture_lock);
+    if (!__atomic_load_n(&capture.active, __ATOMIC_RELAXED)) {
+        pthread_mutex_unlock(&capture_lock);
+        return;
+    }
+
+    /* Headers never straddle a page, records never wrap the ring */
+    pos = capture.head % XOE_WIRE_CAPTURE_RING;
+    gap = XOE_WIRE_CAPTURE_PAGE - capture.head % XOE_WIRE_CAPTURE_PAGE;
+    if (gap >= sizeof(record)) {
+        gap = 0;
+    }
+    if (pos + gap + size > XOE_WIRE_CAPTURE_RING) {
+        gap = XOE_WIRE_CAPTURE_RING - pos;
+    }
+    if ((capture.max_bytes != 0 &&
+         capture.head + gap + size > capture.max_bytes) ||
+        capture.head + gap + size - capture.tail > XOE_WIRE_CAPTURE_RING) {
+        capture.dropped++;
+        pthread_mutex_unlock(&capture_lock);
+        metrics_add(METRIC_CAPTURE_DROPPED, 1);
+        return;
+    }
+
+    memset(capture.ring + pos, 0, (size_t)gap);
+    capture.head += gap;
+    slot = capture.ring + capture.head % XOE_WIRE_CAPTURE_RING;
+
+    record.timestamp_ns = xoe_wire_trace_now_ns();
+    memcpy(slot, &record, sizeof(record));
+    if (record.captured > 0) {
+        memcpy(slot + sizeof(record), payload, record.captured);
+    }
+    memset(slot + sizeof(record) + record.captured, 0,
+           size - sizeof(record) - record.captured);
+    capture.head += size;
+    capture.frames++;
+
+    /* Wake the writer once a quarter of the ring is waiting */
+    if (capture.head - capture.tail >= XOE_WIRE_CAPTURE_RING / 4) {
+        pthread_cond_signal(&capture.wake);
+    }
+    pthread_mutex_unlock(&capture_lock);
+
+    metrics_add(METRIC_CAPTURE_FRAMES, 1);
+}
+
+/*
+ * Reading
+ */
+
+int xoe_wire_capture_reader_open(xoe_wire_capture_reader_t* reader,
+                                 const char* path)
+{
+    const xoe_wire_capture_file_header_t* header;
+    struct stat st;
+    void* map;
+    int fd;
+
+    if (reader == NULL || path == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    memset(reader, 0, sizeof(*reader));
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return (errno == ENOENT) ? E_FILE_NOT_FOUND : E_IO_ERROR;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return E_IO_ERROR;
+    }
+    if (st.st_size < XOE_WIRE_CAPTURE_PAGE) {
+        close(fd);
+        return E_PROTOCOL_ERROR;
+    }
+
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return E_IO_ERROR;
+    }
+
+    header = (const xoe_wire_capture_file_header_t*)map;
+    if (header->magic != XOE_WIRE_CAPTURE_MAGIC ||
+        header->version != XOE_WIRE_CAPTURE_VERSION ||
+        header->page_size != XOE_WIRE_CAPTURE_PAGE) {
+        munmap(map, (size_t)st.st_size);
+        return E_PROTOCOL_ERROR;
+    }
+
+    reader->map = (const uint8_t*)map;
+    reader->map_length = (size_t)st.st_size;
+    reader->header = header;
+    reader->end = reader->map_length;
+    if (header->data_length != 0 &&
+        header->data_length < reader->map_length - XOE_WIRE_CAPTURE_PAGE) {
+        reader->end = XOE_WIRE_CAPTURE_PAGE + (size_t)header->data_length;
+    }
+    reader->offset = XOE_WIRE_CAPTURE_PAGE;
+
+    return 0;
+}
+
+int xoe_wire_capture_reader_next(xoe_wire_capture_reader_t* reader,
+                                 const xoe_wire_capture_record_t** record,
+                                 const uint8_t** payload)
+{
+    const xoe_wire_capture_record_t* rec;
+    size_t in_page;
+
+    if (reader == NULL || reader->map == NULL || record == NULL ||
+        payload == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    while (reader->offset < reader->end) {
+        in_page = XOE_WIRE_CAPTURE_PAGE -
+                  reader->offset % XOE_WIRE_CAPTURE_PAGE;
+        if (reader->end - reader->offset < sizeof(*rec)) {
+            break;
+        }
+        rec = (const xoe_wire_capture_record_t*)(reader->map + reader->offset);
+        if (in_page < sizeof(*rec) || rec->type == XOE_WIRE_CAPTURE_PAD) {
+            reader->offset += in_page;
+            continue;
+        }
+
+        if ((rec->type != XOE_WIRE_CAPTURE_TX &&
+             rec->type != XOE_WIRE_CAPTURE_RX) ||
+            rec->captured > rec->length ||
+            rec->captured > reader->end - reader->offset - sizeof(*rec)) {
+            reader->offset = reader->end;
+            return E_PROTOCOL_ERROR;
+        }
+
+        *record = rec;
+        *payload = (const uint8_t*)(rec + 1);
+        reader->offset += CAPTURE_ALIGN(sizeof(*rec) + rec->captured);
+        return 1;
+    }
+
+    return 0;
+}
+
+void xoe_wire_capture_reader_rewind(xoe_wire_capture_reader_t* reader)
+{
+    if (reader != NULL) {
+        reader->offset = XOE_WIRE_CAPTURE_PAGE;
+    }
+}
+
+void xoe_wire_capture_reader_close(xoe_wire_capture_reader_t* reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+    if (reader->map != NULL) {
+        munmap((void*)reader->map, reader->map_length);
+    }
+    memset(reader, 0, sizeof(*reader));
+}
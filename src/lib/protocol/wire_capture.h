@@ -0,0 +1,225 @@
+/*
+ * wire_capture.h - Full-frame wire capture to a trace file, and its reader
+ *
+ * Where the flight recorder (wire_trace.h) keeps the metadata of the last
+ * few frames per socket, a capture keeps every frame: each xoe_wire frame
+ * sent or received, header and payload, with a monotonic nanosecond
+ * timestamp and the number of its connection (xoe_wire_trace_conn_id()),
+ * is appended to one trace file for the whole process. Recording hooks
+ * into the same send/receive paths as the flight recorder; while no
+ * capture is open it costs one load per frame.
+ *
+ * Recording threads copy frames into an in-memory ring under a mutex; a
+ * background writer moves whole pages from the ring to the file with
+ * pwrite() at page-aligned offsets, extending the file
+ * XOE_WIRE_CAPTURE_EXTENT bytes at a time with posix_fallocate() so
+ * appends do not allocate blocks one write at a time. A frame that finds
+ * the ring (or the --capture-max limit) full is dropped and counted rather
+ * than stalling the data path.
+ *
+ * File layout (host byte order; the magic number tells a reader with the
+ * other byte order that it cannot use the file):
+ *
+ *   [0, XOE_WIRE_CAPTURE_PAGE)   xoe_wire_capture_file_header_t, zero padded
+ *   [XOE_WIRE_CAPTURE_PAGE, ...) records, each an xoe_wire_capture_record_t
+ *                                followed by its captured payload bytes,
+ *                                padded to 8 bytes
+ *
+ * A record header never straddles a page boundary. Zero bytes where a
+ * record header would start pad to the next page: the writer pads the
+ * page out when it flushes a partial page, when the ring wraps, and where
+ * a header would not fit. Records are therefore aligned for direct use in
+ * a read-only mmap() of the file, which is how the reader walks them.
+ *
+ * Author: [LLM-ARCH]
+ */
+
+#ifndef WIRE_CAPTURE_H
+#define WIRE_CAPTURE_H
+
+#include "lib/common/types.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stddef.h>
+
+/* File identification ("XCAP" read as a little-endian word) */
+#define XOE_WIRE_CAPTURE_MAGIC 0x50414358u
+#define XOE_WIRE_CAPTURE_VERSION 1
+
+/* File header size and unit of every write */
+#define XOE_WIRE_CAPTURE_PAGE 4096
+
+/* In-memory ring between the recording threads and the writer */
+#ifndef XOE_WIRE_CAPTURE_RING
+#if XOE_SMALL_FOOTPRINT
+#define XOE_WIRE_CAPTURE_RING (512 * 1024)
+#else
+#define XOE_WIRE_CAPTURE_RING (4 * 1024 * 1024)
+#endif
+#endif
+
+/* Payload bytes kept per frame; longer frames are cut (length is kept) */
+#ifndef XOE_WIRE_CAPTURE_SNAPLEN
+#if XOE_SMALL_FOOTPRINT
+#define XOE_WIRE_CAPTURE_SNAPLEN (16 * 1024)
+#else
+#define XOE_WIRE_CAPTURE_SNAPLEN (64 * 1024)
+#endif
+#endif
+
+/* File space preallocated ahead of the writer */
+#define XOE_WIRE_CAPTURE_EXTENT (16 * 1024 * 1024)
+
+/* Longest a captured frame waits in the ring before it reaches the file */
+#define XOE_WIRE_CAPTURE_FLUSH_MS 1000
+
+/* Default and largest --capture-max (MiB of records, 0 = no limit) */
+#define XOE_WIRE_CAPTURE_DEFAULT_MB 1024
+#define XOE_WIRE_CAPTURE_MAX_MB (1024 * 1024)
+
+/* Record types (a zero type is padding) */
+#define XOE_WIRE_CAPTURE_PAD 0
+#define XOE_WIRE_CAPTURE_TX  1      /* Frame sent by the capturing process */
+#define XOE_WIRE_CAPTURE_RX  2      /* Frame received by it */
+
+/* Side of the connection the capturing process was on */
+#define XOE_WIRE_CAPTURE_ROLE_SERVER 1
+#define XOE_WIRE_CAPTURE_ROLE_CLIENT 2
+
+/**
+ * @brief File header (start of the first page)
+ */
+typedef struct {
+    uint32_t magic;             /* XOE_WIRE_CAPTURE_MAGIC */
+    uint32_t version;           /* XOE_WIRE_CAPTURE_VERSION */
+    uint32_t page_size;         /* XOE_WIRE_CAPTURE_PAGE (records start here) */
+    uint32_t snaplen;           /* Payload bytes kept per frame at most */
+    uint32_t role;              /* XOE_WIRE_CAPTURE_ROLE_* */
+    uint32_t reserved;
+    uint64_t start_realtime_ns; /* Wall clock when the capture was opened */
+    uint64_t start_ns;          /* Monotonic clock at the same moment */
+    uint64_t data_length;       /* Record bytes, set on close (0 while the
+                                   capture is open or after a crash: read to
+                                   the end of the file) */
+    uint64_t frames;            /* Frames recorded, set on close */
+    uint64_t dropped;           /* Frames dropped, set on close */
+} xoe_wire_capture_file_header_t;
+
+/**
+ * @brief Record header (followed by @c captured payload bytes)
+ */
+typedef struct {
+    uint64_t timestamp_ns;      /* Monotonic clock (xoe_wire_trace_now_ns()) */
+    uint32_t conn_id;           /* xoe_wire_trace_conn_id() of the socket */
+    uint32_t length;            /* Payload length from the frame header */
+    uint32_t captured;          /* Payload bytes that follow (<= length) */
+    uint8_t type;               /* XOE_WIRE_CAPTURE_TX or _RX */
+    uint8_t status;             /* XOE_WIRE_TRACE_OK or _UNCHECKED */
+    uint16_t reserved;
+    uint8_t header[XOE_WIRE_HEADER_SIZE]; /* Wire header as sent */
+    uint32_t reserved2;
+} xoe_wire_capture_record_t;
+
+/**
+ * @brief Totals of the open (or last) capture
+ */
+typedef struct {
+    uint64_t frames;            /* Frames recorded */
+    uint64_t dropped;           /* Frames dropped: ring or limit full */
+    uint64_t bytes;             /* Record bytes written to the file */
+} xoe_wire_capture_stats_t;
+
+/**
+ * @brief Start capturing to @p path
+ *
+ * Creates (or truncates) the file, writes its header, preallocates the
+ * first extent and starts the writer thread.
+ *
+ * @param path      Trace file
+ * @param role      XOE_WIRE_CAPTURE_ROLE_SERVER or _CLIENT
+ * @param max_bytes Stop recording once this many record bytes were taken
+ *                  (0 = no limit)
+ *
+ * @return 0, E_INVALID_ARGUMENT, E_IO_ERROR, E_OUT_OF_MEMORY, or
+ *         E_INVALID_STATE if a capture is already open
+ */
+int xoe_wire_capture_open(const char* path, int role, uint64_t max_bytes);
+
+/**
+ * @brief Flush everything recorded, finish the file header and close
+ *
+ * Trims the preallocated tail off the file. A no-op when no capture is
+ * open.
+ */
+void xoe_wire_capture_close(void);
+
+/**
+ * @brief Whether a capture is open
+ */
+int xoe_wire_capture_active(void);
+
+/**
+ * @brief Totals of the open capture, or of the last one closed
+ */
+void xoe_wire_capture_get_stats(xoe_wire_capture_stats_t* stats);
+
+/**
+ * @brief Record one frame (no-op while no capture is open)
+ *
+ * Safe to call from any thread. Only frames that went out, or arrived
+ * with a valid (or unchecked) checksum, are recorded.
+ *
+ * @param fd            Socket the frame went out on / came in from
+ * @param type          XOE_WIRE_CAPTURE_TX or XOE_WIRE_CAPTURE_RX
+ * @param header_buffer Serialized wire header (XOE_WIRE_HEADER_SIZE bytes)
+ * @param payload       Payload bytes (NULL for an empty payload)
+ * @param status        XOE_WIRE_TRACE_OK or XOE_WIRE_TRACE_UNCHECKED
+ */
+void xoe_wire_capture_frame(int fd, int type, const uint8_t* header_buffer,
+                            const uint8_t* payload, int status);
+
+/**
+ * @brief Sequential reader over a memory-mapped trace file
+ */
+typedef struct {
+    const uint8_t* map;         /* Whole file, read-only */
+    size_t map_length;
+    size_t offset;              /* Next record, from the start of the file */
+    size_t end;                 /* End of the records */
+    const xoe_wire_capture_file_header_t* header;
+} xoe_wire_capture_reader_t;
+
+/**
+ * @brief Map a trace file and check its header
+ *
+ * @return 0, E_INVALID_ARGUMENT, E_FILE_NOT_FOUND, E_IO_ERROR, or
+ *         E_PROTOCOL_ERROR for a file that is not a usable capture
+ */
+int xoe_wire_capture_reader_open(xoe_wire_capture_reader_t* reader,
+                                 const char* path);
+
+/**
+ * @brief Step to the next record
+ *
+ * @param reader    Open reader
+ * @param record    Receives the record header (points into the map)
+ * @param payload   Receives the captured payload (points into the map)
+ *
+ * @return 1 for a record, 0 at the end, E_PROTOCOL_ERROR for a damaged
+ *         record (reading stops there)
+ */
+int xoe_wire_capture_reader_next(xoe_wire_capture_reader_t* reader,
+                                 const xoe_wire_capture_record_t** record,
+                                 const uint8_t** payload);
+
+/**
+ * @brief Go back to the first record
+ */
+void xoe_wire_capture_reader_rewind(xoe_wire_capture_reader_t* reader);
+
+/**
+ * @brief Unmap the file
+ */
+void xoe_wire_capture_reader_close(xoe_wire_capture_reader_t* reader);
+
+#endif /* WIRE_CAPTURE_H */
@@ -0,0 +1,368 @@
+/**
+ * @file wire_compress.c
+ * @brief Negotiated per-frame payload compression
+ *
+ * [LLM-ARCH]
+ */
+
+#include "lib/protocol/wire_compress.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if LZ4_ENABLED
+#include <lz4.h>
+#endif
+
+/* Every sync flush ends in an empty stored block; it is not sent */
+static const uint8_t zlib_flush_tail[4] = {0x00, 0x00, 0xFF, 0xFF};
+
+/* ============================================================================
+ * Back-ends
+ * ============================================================================ */
+
+/**
+ * @brief Deflate one frame onto the send stream
+ */
+static int zlib_compress(xoe_wire_compress_t* comp, const uint8_t* in,
+                         uint32_t len, uint8_t* out, uint32_t cap,
+                         uint32_t* out_len)
+{
+    z_stream* strm = &comp->deflater;
+
+    strm->next_in = (Bytef*)in;
+    strm->avail_in = len;
+    strm->next_out = out;
+    strm->avail_out = cap;
+
+    if (deflate(strm, Z_SYNC_FLUSH) != Z_OK || strm->avail_in != 0 ||
+        strm->avail_out == 0) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    *out_len = cap - strm->avail_out;
+    if (*out_len >= sizeof(zlib_flush_tail) &&
+        memcmp(out + *out_len - sizeof(zlib_flush_tail), zlib_flush_tail,
+               sizeof(zlib_flush_tail)) == 0) {
+        *out_len -= sizeof(zlib_flush_tail);
+    }
+    return 0;
+}
+
+/**
+ * @brief Inflate one frame from the receive stream
+ *
+ * @p out has room for one byte more than @p orig_len, so inflate is never
+ * stopped by a full buffer before it has consumed the whole frame.
+ */
+static int zlib_decompress(xoe_wire_compress_t* comp, const uint8_t* in,
+                           uint32_t in_len, uint8_t* out, uint32_t orig_len)
+{
+    z_stream* strm = &comp->inflater;
+    int rc;
+
+    strm->next_out = out;
+    strm->avail_out = orig_len + 1;
+
+    strm->next_in = (Bytef*)in;
+    strm->avail_in = in_len;
+    rc = inflate(strm, Z_SYNC_FLUSH);
+    if ((rc != Z_OK && rc != Z_BUF_ERROR) || strm->avail_in != 0) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    strm->next_in = (Bytef*)zlib_flush_tail;
+    strm->avail_in = sizeof(zlib_flush_tail);
+    rc = inflate(strm, Z_SYNC_FLUSH);
+    if ((rc != Z_OK && rc != Z_BUF_ERROR) || strm->avail_in != 0 ||
+        strm->avail_out != 1) {
+        return E_PROTOCOL_ERROR;
+    }
+    return 0;
+}
+
+#if LZ4_ENABLED
+/**
+ * @brief Offset in a ring where the next @p len bytes go
+ *
+ * Both directions apply the same rule, so the receiver's ring holds every
+ * frame at the offset the sender compressed it from.
+ */
+static uint32_t lz4_ring_slot(uint32_t offset, uint32_t len)
+{
+    return (offset + len > XOE_WIRE_LZ4_RING_SIZE) ? 0 : offset;
+}
+
+static int lz4_compress(xoe_wire_compress_t* comp, const uint8_t* in,
+                        uint32_t len, uint8_t* out, uint32_t cap,
+                        uint32_t* out_len)
+{
+    uint8_t* src;
+    int n;
+
+    comp->tx_offset = lz4_ring_slot(comp->tx_offset, len);
+    src = comp->tx_ring + comp->tx_offset;
+    memcpy(src, in, len);
+
+    n = LZ4_compress_fast_continue((LZ4_stream_t*)comp->lz4_tx,
+                                   (const char*)src, (char*)out,
+                                   (int)len, (int)cap, 1);
+    if (n <= 0) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    comp->tx_offset += len;
+    *out_len = (uint32_t)n;
+    return 0;
+}
+
+static int lz4_decompress(xoe_wire_compress_t* comp, const uint8_t* in,
+                          uint32_t in_len, uint8_t* out, uint32_t orig_len)
+{
+    uint8_t* dst;
+    int n;
+
+    comp->rx_offset = lz4_ring_slot(comp->rx_offset, orig_len);
+    dst = comp->rx_ring + comp->rx_offset;
+
+    n = LZ4_decompress_safe_continue((LZ4_streamDecode_t*)comp->lz4_rx,
+                                     (const char*)in, (char*)dst,
+                                     (int)in_len, (int)orig_len);
+    if (n != (int)orig_len) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    comp->rx_offset += orig_len;
+    memcpy(out, dst, orig_len);
+    return 0;
+}
+#endif /* LZ4_ENABLED */
+
+/* ============================================================================
+ * Public Functions
+ * ============================================================================ */
+
+int xoe_wire_compress_init(xoe_wire_compress_t* comp, uint32_t features)
+{
+    if (comp == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(comp, 0, sizeof(*comp));
+
+    if (features & XOE_WIRE_FEATURE_COMPRESS_LZ4) {
+#if LZ4_ENABLED
+        comp->lz4_tx = LZ4_createStream();
+        comp->lz4_rx = LZ4_createStreamDecode();
+        comp->tx_ring = (uint8_t*)malloc(XOE_WIRE_LZ4_RING_SIZE);
+        comp->rx_ring = (uint8_t*)malloc(XOE_WIRE_LZ4_RING_SIZE);
+        comp->algorithm = XOE_WIRE_FEATURE_COMPRESS_LZ4;
+        if (comp->lz4_tx == NULL || comp->lz4_rx == NULL ||
+            comp->tx_ring == NULL || comp->rx_ring == NULL) {
+            xoe_wire_compress_cleanup(comp);
+            return E_OUT_OF_MEMORY;
+        }
+        return 0;
+#else
+        return E_NOT_SUPPORTED;
+#endif
+    }
+
+    if (features & XOE_WIRE_FEATURE_COMPRESS_ZLIB) {
+        /* Raw deflate: no zlib header or trailer inside the frames */
+        if (deflateInit2(&comp->deflater, XOE_WIRE_ZLIB_LEVEL, Z_DEFLATED,
+                         -XOE_WIRE_ZLIB_WINDOW_BITS, XOE_WIRE_ZLIB_MEM_LEVEL,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            return E_OUT_OF_MEMORY;
+        }
+        if (inflateInit2(&comp->inflater, -XOE_WIRE_ZLIB_WINDOW_BITS) != Z_OK) {
+            deflateEnd(&comp->deflater);
+            return E_OUT_OF_MEMORY;
+        }
+        comp->algorithm = XOE_WIRE_FEATURE_COMPRESS_ZLIB;
+    }
+
+    return 0;
+}
+
+void xoe_wire_compress_cleanup(xoe_wire_compress_t* comp)
+{
+    if (comp == NULL) {
+        return;
+    }
+
+    if (comp->algorithm == XOE_WIRE_FEATURE_COMPRESS_ZLIB) {
+        deflateEnd(&comp->deflater);
+        inflateEnd(&comp->inflater);
+    }
+#if LZ4_ENABLED
+    if (comp->lz4_tx != NULL) {
+        LZ4_freeStream((LZ4_stream_t*)comp->lz4_tx);
+    }
+    if (comp->lz4_rx != NULL) {
+        LZ4_freeStreamDecode((LZ4_streamDecode_t*)comp->lz4_rx);
+    }
+#endif
+    free(comp->tx_ring);
+    free(comp->rx_ring);
+
+    memset(comp, 0, sizeof(*comp));
+}
+
+int xoe_wire_compress_packet(xoe_wire_compress_t* comp,
+                             const xoe_packet_t* packet, xoe_packet_t* out)
+{
+    xoe_payload_t* payload;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t compressed_len = 0;
+    uint8_t* data;
+    int result;
+
+    if (comp == NULL || comp->algorithm == 0 || packet == NULL ||
+        out == NULL) {
+        return 0;
+    }
+
+    len = (packet->payload != NULL) ? packet->payload->len : 0;
+    if (packet->protocol_id == XOE_PROTOCOL_WIRE_CTRL ||
+        len < XOE_WIRE_COMPRESS_MIN_INPUT || len > XOE_WIRE_COMPRESS_MAX_INPUT) {
+        return 0;
+    }
+    if (comp->skip_frames > 0) {
+        comp->skip_frames--;
+        metrics_add(METRIC_COMPRESS_SKIPPED, 1);
+        return 0;
+    }
+
+    /* Worst case of either back-end for incompressible input */
+    cap = len + len / 8 + 64;
+    payload = xoe_payload_alloc(XOE_WIRE_COMPRESS_HEADER_SIZE + cap);
+    if (payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    data = (uint8_t*)payload->data;
+
+#if LZ4_ENABLED
+    if (comp->algorithm == XOE_WIRE_FEATURE_COMPRESS_LZ4) {
+        result = lz4_compress(comp, (const uint8_t*)packet->payload->data, len,
+                              data + XOE_WIRE_COMPRESS_HEADER_SIZE, cap,
+                              &compressed_len);
+    } else
+#endif
+    {
+        result = zlib_compress(comp, (const uint8_t*)packet->payload->data, len,
+                               data + XOE_WIRE_COMPRESS_HEADER_SIZE, cap,
+                               &compressed_len);
+    }
+    if (result != 0) {
+        xoe_payload_release(payload);
+        return result;
+    }
+
+    xoe_wire_write_uint16(data, (uint16_t)len);
+    payload->len = XOE_WIRE_COMPRESS_HEADER_SIZE + compressed_len;
+
+    /* The history already holds this frame, so it goes out compressed
+     * either way; a poor result only sends the next frames raw */
+    if (payload->len >= len) {
+        comp->backoff = (comp->backoff == 0) ? 1 : comp->backoff * 2;
+        if (comp->backoff > XOE_WIRE_COMPRESS_MAX_BACKOFF) {
+            comp->backoff = XOE_WIRE_COMPRESS_MAX_BACKOFF;
+        }
+        comp->skip_frames = comp->backoff;
+    } else {
+        comp->backoff = 0;
+    }
+
+    metrics_add(METRIC_COMPRESS_IN_BYTES, len);
+    metrics_add(METRIC_COMPRESS_OUT_BYTES, payload->len);
+
+    memset(out, 0, sizeof(*out));
+    out->protocol_id = packet->protocol_id;
+    out->protocol_version = (uint16_t)(packet->protocol_version |
+                                       XOE_WIRE_VERSION_COMPRESSED);
+    out->payload = payload;
+    return 1;
+}
+
+int xoe_wire_decompress_packet(xoe_wire_compress_t* comp,
+                               xoe_packet_t* packet)
+{
+    xoe_payload_t* payload;
+    const uint8_t* in;
+    uint32_t in_len;
+    uint32_t orig_len;
+    int result;
+
+    if (packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (!(packet->protocol_version & XOE_WIRE_VERSION_COMPRESSED)) {
+        return 0;
+    }
+    if (comp == NULL || comp->algorithm == 0 || packet->payload == NULL ||
+        packet->payload->len < XOE_WIRE_COMPRESS_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    in = (const uint8_t*)packet->payload->data;
+    in_len = packet->payload->len - XOE_WIRE_COMPRESS_HEADER_SIZE;
+    orig_len = xoe_wire_read_uint16(in);
+    in += XOE_WIRE_COMPRESS_HEADER_SIZE;
+    if (orig_len > XOE_WIRE_COMPRESS_MAX_INPUT) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    payload = xoe_payload_alloc(orig_len + 1);
+    if (payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+#if LZ4_ENABLED
+    if (comp->algorithm == XOE_WIRE_FEATURE_COMPRESS_LZ4) {
+        result = lz4_decompress(comp, in, in_len, (uint8_t*)payload->data,
+                                orig_len);
+    } else
+#endif
+    {
+        result = zlib_decompress(comp, in, in_len, (uint8_t*)payload->data,
+                                 orig_len);
+    }
+    if (result != 0) {
+        xoe_payload_release(payload);
+        return result;
+    }
+
+    payload->len = orig_len;
+    xoe_payload_release(packet->payload);
+    packet->payload = payload;
+    packet->protocol_version &= (uint16_t)~XOE_WIRE_VERSION_COMPRESSED;
+    return 0;
+}
+
+int xoe_wire_send_compressed(xoe_wire_compress_t* comp, xoe_transport_t* t,
+                             uint32_t features, const xoe_packet_t* packet)
+{
+    xoe_packet_t compressed;
+    const xoe_packet_t* frame = packet;
+    int result;
+
+    result = xoe_wire_compress_packet(comp, packet, &compressed);
+    if (result < 0) {
+        return result;
+    }
+    if (result == 1) {
+        frame = &compressed;
+    }
+
+    result = xoe_wire_send_transport(t, frame, features);
+
+    if (frame == &compressed) {
+        xoe_wire_free_payload(&compressed);
+    }
+    return result;
+}
@@ -0,0 +1,145 @@
+/**
+ * @file wire_compress.h
+ * @brief Negotiated per-frame payload compression
+ *
+ * Once a connection has negotiated XOE_WIRE_FEATURE_COMPRESS_ZLIB or
+ * XOE_WIRE_FEATURE_COMPRESS_LZ4 (HELLO / HELLO_ACK, see wire_format.h),
+ * either side may send any frame's payload compressed. Such frames have
+ * XOE_WIRE_VERSION_COMPRESSED set in protocol_version and carry
+ *
+ *   original length (2) | compressed bytes           (network order)
+ *
+ * Every other frame is sent and received exactly as before, so the sender
+ * decides per frame: control frames, frames under
+ * XOE_WIRE_COMPRESS_MIN_INPUT bytes and frames over
+ * XOE_WIRE_COMPRESS_MAX_INPUT bytes stay raw. A frame that does not
+ * shrink was already added to the stream history and is still sent
+ * compressed (a few bytes of overhead); the sender then leaves the next
+ * 1, 2, 4 .. XOE_WIRE_COMPRESS_MAX_BACKOFF frames raw, so incompressible
+ * traffic costs almost no CPU.
+ *
+ * Each direction is one continuous stream, so every frame is compressed
+ * against the history of the frames before it (a raw deflate stream with
+ * a sync flush per frame, or an LZ4 ring buffer). Repetitive traffic such
+ * as ASCII telemetry or Modbus polling shrinks to a few bytes per frame.
+ * The receiver must therefore decompress frames in order, and a failed
+ * compression or decompression leaves the stream unusable: the
+ * connection has to be closed.
+ *
+ * Compressing secrets next to attacker-chosen data inside TLS leaks
+ * information through frame sizes (CRIME); only negotiate compression
+ * where that does not apply.
+ *
+ * An xoe_wire_compress_t is not thread-safe; senders and the receiving
+ * thread must serialize use of their direction.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef WIRE_COMPRESS_H
+#define WIRE_COMPRESS_H
+
+#include <zlib.h>
+
+#include "lib/common/types.h"
+#include "lib/protocol/protocol.h"
+#include "lib/protocol/wire_format.h"
+
+/* Compressed payload header: original payload length */
+#define XOE_WIRE_COMPRESS_HEADER_SIZE 2
+
+/* Payloads outside this range are sent raw */
+#define XOE_WIRE_COMPRESS_MIN_INPUT 16
+#define XOE_WIRE_COMPRESS_MAX_INPUT 16384
+
+/* Longest run of raw frames after a frame that did not shrink */
+#define XOE_WIRE_COMPRESS_MAX_BACKOFF 64
+
+/* zlib stream: 8 KiB history, ~64 KiB of deflate state per connection */
+#define XOE_WIRE_ZLIB_WINDOW_BITS 13
+#define XOE_WIRE_ZLIB_MEM_LEVEL 6
+#define XOE_WIRE_ZLIB_LEVEL 6
+
+/* LZ4 ring buffer per direction (history plus the largest frame) */
+#define XOE_WIRE_LZ4_RING_SIZE (64 * 1024)
+
+/**
+ * @brief Compression state of one connection (both directions)
+ */
+typedef struct xoe_wire_compress {
+    uint32_t algorithm;         /* XOE_WIRE_FEATURE_COMPRESS_*, 0 = off */
+
+    /* Send direction */
+    z_stream deflater;
+    void* lz4_tx;               /* LZ4_stream_t* */
+    uint8_t* tx_ring;
+    uint32_t tx_offset;
+    uint32_t skip_frames;       /* Frames left to send raw */
+    uint32_t backoff;           /* Length of the last raw run */
+
+    /* Receive direction */
+    z_stream inflater;
+    void* lz4_rx;               /* LZ4_streamDecode_t* */
+    uint8_t* rx_ring;
+    uint32_t rx_offset;
+} xoe_wire_compress_t;
+
+/**
+ * @brief Set up compression for the negotiated features
+ *
+ * @param comp      State to initialize
+ * @param features  Negotiated XOE_WIRE_FEATURE_* bits; without a
+ *                  compression bit the state is inactive
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_NOT_SUPPORTED for LZ4 in a
+ *         build without LZ4_ENABLED, E_OUT_OF_MEMORY
+ */
+int xoe_wire_compress_init(xoe_wire_compress_t* comp, uint32_t features);
+
+/**
+ * @brief Release the stream state (the structure itself is the caller's)
+ */
+void xoe_wire_compress_cleanup(xoe_wire_compress_t* comp);
+
+/**
+ * @brief Compress a frame if it is worth it
+ *
+ * @param comp      Connection state (NULL or inactive: never compresses)
+ * @param packet    Frame to send
+ * @param out       Receives the compressed frame when 1 is returned;
+ *                  release it with xoe_wire_free_payload()
+ *
+ * @return 1 if @p out should be sent, 0 if @p packet should be sent as
+ *         is, negative error code if the stream failed
+ */
+int xoe_wire_compress_packet(xoe_wire_compress_t* comp,
+                             const xoe_packet_t* packet, xoe_packet_t* out);
+
+/**
+ * @brief Restore a received frame in place
+ *
+ * Frames without XOE_WIRE_VERSION_COMPRESSED are left alone. A compressed
+ * frame's payload is released and replaced by a pooled payload holding
+ * the original bytes, and the flag is cleared.
+ *
+ * @return 0 on success, E_PROTOCOL_ERROR for a compressed frame on a
+ *         connection without compression or with corrupt data,
+ *         E_OUT_OF_MEMORY
+ */
+int xoe_wire_decompress_packet(xoe_wire_compress_t* comp,
+                               xoe_packet_t* packet);
+
+/**
+ * @brief Compress if worth it and send over the connection's transport
+ *
+ * @param comp      Connection state (may be NULL)
+ * @param t         Bound transport (lib/net/transport.h)
+ * @param features  Negotiated features, for the checksum option
+ * @param packet    Frame to send
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int xoe_wire_send_compressed(xoe_wire_compress_t* comp, xoe_transport_t* t,
+                             uint32_t features, const xoe_packet_t* packet);
+
+#endif /* WIRE_COMPRESS_H */
@@ -0,0 +1,244 @@
+/**
+ * @file wire_dgram.c
+ * @brief XOE wire frames over UDP and DTLS
+ *
+ * [LLM-ARCH]
+ */
+
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/metrics.h"
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/uio.h>
+
+uint32_t xoe_wire_dgram_features_accept(uint32_t requested,
+                                        int transport_authenticated)
+{
+    uint32_t accepted = requested & XOE_WIRE_FEATURES_DGRAM;
+
+    /* The frame CRC is the only integrity check on plain UDP */
+    if (!transport_authenticated) {
+        accepted &= ~(uint32_t)XOE_WIRE_FEATURE_NO_CHECKSUM;
+    }
+
+    return accepted;
+}
+
+int xoe_wire_dgram_encode(const xoe_packet_t* packet, uint32_t features,
+                          uint8_t* buffer, uint32_t size)
+{
+    xoe_wire_header_t header;
+    const uint8_t* payload = NULL;
+
+    if (packet == NULL || buffer == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    header.protocol_id = packet->protocol_id;
+    header.protocol_version = packet->protocol_version;
+    header.payload_length = 0;
+    if (packet->payload != NULL && packet->payload->data != NULL) {
+        payload = packet->payload->data;
+        header.payload_length = packet->payload->len;
+    }
+
+    if (header.payload_length > XOE_WIRE_DGRAM_MAX - XOE_WIRE_HEADER_SIZE ||
+        XOE_WIRE_HEADER_SIZE + header.payload_length > size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    header.checksum = (features & XOE_WIRE_FEATURE_NO_CHECKSUM)
+                      ? 0 : xoe_wire_packet_checksum(&header, payload);
+    xoe_wire_serialize_header(buffer, &header);
+    if (header.payload_length > 0) {
+        memcpy(buffer + XOE_WIRE_HEADER_SIZE, payload, header.payload_length);
+    }
+
+    return (int)(XOE_WIRE_HEADER_SIZE + header.payload_length);
+}
+
+int xoe_wire_dgram_decode(const uint8_t* buffer, uint32_t len,
+                          uint32_t features, xoe_packet_t* packet)
+{
+    xoe_wire_header_t header;
+
+    if (buffer == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(packet, 0, sizeof(xoe_packet_t));
+    if (len < XOE_WIRE_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    xoe_wire_deserialize_header(&header, buffer);
+    if (header.payload_length != len - XOE_WIRE_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    if (!(features & XOE_WIRE_FEATURE_NO_CHECKSUM) &&
+        xoe_wire_packet_checksum(&header, buffer + XOE_WIRE_HEADER_SIZE) !=
+        header.checksum) {
+        metrics_add(METRIC_NET_CHECKSUM_FAILURES, 1);
+        return E_CHECKSUM_MISMATCH;
+    }
+
+    if (header.payload_length > 0) {
+        packet->payload = xoe_payload_alloc(header.payload_length);
+        if (packet->payload == NULL) {
+            return E_OUT_OF_MEMORY;
+        }
+        memcpy(packet->payload->data, buffer + XOE_WIRE_HEADER_SIZE,
+               header.payload_length);
+    }
+
+    packet->protocol_id = header.protocol_id;
+    packet->protocol_version = header.protocol_version;
+    packet->checksum = header.checksum;
+
+    metrics_add(METRIC_NET_RX_FRAMES, 1);
+    metrics_add(METRIC_NET_RX_BYTES, len);
+    return 0;
+}
+
+int xoe_wire_dgram_send(int fd, void* ssl, const struct sockaddr* to,
+                        socklen_t to_len, uint32_t features,
+                        const xoe_packet_t* packet)
+{
+    uint8_t buffer[XOE_WIRE_DGRAM_MAX];
+    xoe_transport_t transport;
+    struct iovec iov;
+    ssize_t sent;
+    int len;
+    int result;
+
+    len = xoe_wire_dgram_encode(packet, features, buffer, sizeof(buffer));
+    if (len < 0) {
+        return len;
+    }
+
+    if (to == NULL || ssl != NULL) {
+        /* Connected socket or DTLS session: the udp transport */
+        result = xoe_transport_init_udp(&transport, fd, ssl);
+        if (result != 0) {
+            return result;
+        }
+        iov.iov_base = buffer;
+        iov.iov_len = (size_t)len;
+        result = xoe_transport_writev(&transport, &iov, 1);
+        if (result != 0) {
+            return result;
+        }
+    } else {
+        /* An unconnected server socket answers each peer by address */
+        do {
+            sent = sendto(fd, buffer, (size_t)len, 0, to, to_len);
+        } while (sent < 0 && errno == EINTR);
+
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ||
+                errno == ECONNREFUSED) {
+                return 0;
+            }
+            return E_NETWORK_ERROR;
+        }
+    }
+
+    metrics_add(METRIC_NET_TX_FRAMES, 1);
+    metrics_add(METRIC_NET_TX_BYTES, (uint64_t)len);
+    return 0;
+}
+
+int xoe_wire_dgram_recv(int fd, void* ssl, uint8_t* buffer, uint32_t size)
+{
+    xoe_transport_t transport;
+    struct iovec iov;
+    int result;
+
+    if (buffer == NULL || size == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    result = xoe_transport_init_udp(&transport, fd, ssl);
+    if (result != 0) {
+        return result;
+    }
+    iov.iov_base = buffer;
+    iov.iov_len = size;
+    return xoe_transport_readv(&transport, &iov, 1);
+}
+
+int xoe_wire_dgram_negotiate(int fd, void* ssl, uint32_t requested,
+                             uint32_t* accepted, int timeout_ms)
+{
+    uint8_t datagram[XOE_WIRE_DGRAM_MAX];
+    uint8_t hello[XOE_WIRE_HELLO_SIZE];
+    xoe_payload_t hello_payload;
+    xoe_packet_t hello_packet;
+    xoe_packet_t packet;
+    struct pollfd pfd;
+    uint64_t deadline;
+    uint64_t resend_at = 0;
+    uint64_t now;
+    uint16_t type;
+    uint32_t features;
+    int wait_ms;
+    int result;
+
+    if (fd < 0 || accepted == NULL || timeout_ms <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    *accepted = 0;
+    xoe_wire_hello_init(&hello_packet, &hello_payload, hello,
+                        XOE_WIRE_CTRL_HELLO, requested);
+    deadline = latency_now_ms() + (uint64_t)timeout_ms;
+
+    for (;;) {
+        now = latency_now_ms();
+        if (now >= deadline) {
+            return E_TIMEOUT;
+        }
+        if (now >= resend_at) {
+            result = xoe_wire_dgram_send(fd, ssl, NULL, 0, 0, &hello_packet);
+            if (result != 0) {
+                return result;
+            }
+            resend_at = now + XOE_WIRE_DGRAM_HELLO_RETRY_MS;
+        }
+
+        result = xoe_wire_dgram_recv(fd, ssl, datagram, sizeof(datagram));
+        if (result == E_WOULD_BLOCK || result == E_NETWORK_ERROR ||
+            result == E_PROTOCOL_ERROR) {
+            /* Nothing yet, or the server is not up: wait and resend */
+            wait_ms = (int)(((resend_at < deadline) ? resend_at : deadline) - now);
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, wait_ms) < 0 && errno != EINTR) {
+                return E_IO_ERROR;
+            }
+            continue;
+        }
+        if (result <= 0) {
+            return (result == 0) ? E_IO_ERROR : result;
+        }
+
+        if (xoe_wire_dgram_decode(datagram, (uint32_t)result, 0, &packet) != 0) {
+            continue;
+        }
+        if (xoe_wire_hello_parse(&packet, &type, &features) == 0 &&
+            type == XOE_WIRE_CTRL_HELLO_ACK) {
+            xoe_wire_free_payload(&packet);
+            *accepted = features & requested;
+            return 0;
+        }
+        xoe_wire_free_payload(&packet);
+    }
+}
@@ -0,0 +1,145 @@
+/**
+ * @file wire_dgram.h
+ * @brief XOE wire frames over UDP and DTLS
+ *
+ * A datagram carries exactly one wire frame, header and payload as on a
+ * stream (see wire_format.h), so a lost or reordered datagram costs only
+ * its own frame instead of stalling everything behind it the way a lost
+ * TCP segment does. Frames are limited to XOE_WIRE_DGRAM_MAX bytes so
+ * they leave unfragmented on a 1500-byte MTU, DTLS record overhead
+ * included; a datagram whose length does not match its header is
+ * dropped.
+ *
+ * Over DTLS a frame is one record: SSL_write() produces one datagram and
+ * SSL_read() returns one, so the same functions serve both transports.
+ *
+ * An association starts with the HELLO / HELLO_ACK exchange of stream
+ * connections, resent by the client every XOE_WIRE_DGRAM_HELLO_RETRY_MS
+ * until answered (xoe_wire_dgram_negotiate()). Servers grant only the
+ * features that make sense without a byte stream: stream compression and
+ * session resumption never are, XOE_WIRE_FEATURE_SERIAL_LATEST only here.
+ * Loss recovery, where wanted, is up to the protocol on top (see
+ * connectors/serial/serial_dgram.h).
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef WIRE_DGRAM_H
+#define WIRE_DGRAM_H
+
+#include "lib/common/types.h"
+#include "lib/protocol/protocol.h"
+
+#include <sys/socket.h>
+
+/* Largest frame (header + payload) in one datagram */
+#define XOE_WIRE_DGRAM_MAX 1400
+
+/* Client HELLO: resent at this interval until a HELLO_ACK arrives */
+#define XOE_WIRE_DGRAM_HELLO_RETRY_MS 250
+
+/* Default time a client waits for the HELLO_ACK */
+#define XOE_WIRE_DGRAM_HELLO_TIMEOUT_MS 5000
+
+/* Features a server may grant on a datagram association */
+#define XOE_WIRE_FEATURES_DGRAM (XOE_WIRE_FEATURE_NO_CHECKSUM | \
+                                 XOE_WIRE_FEATURE_SERIAL_LATEST)
+
+/**
+ * @brief Decide which requested features a datagram server grants
+ *
+ * @param requested                 Features from the client HELLO
+ * @param transport_authenticated   TRUE over DTLS
+ *
+ * @return Granted feature bits (checksum-off only over DTLS)
+ */
+uint32_t xoe_wire_dgram_features_accept(uint32_t requested,
+                                        int transport_authenticated);
+
+/**
+ * @brief Serialize a packet into one datagram
+ *
+ * @param packet    Packet to send
+ * @param features  Negotiated features (XOE_WIRE_FEATURE_NO_CHECKSUM
+ *                  sends checksum 0)
+ * @param buffer    Output buffer
+ * @param size      Buffer size
+ *
+ * @return Datagram length, E_INVALID_ARGUMENT, or E_BUFFER_TOO_SMALL if
+ *         the frame exceeds @p size or XOE_WIRE_DGRAM_MAX
+ */
+int xoe_wire_dgram_encode(const xoe_packet_t* packet, uint32_t features,
+                          uint8_t* buffer, uint32_t size);
+
+/**
+ * @brief Parse one received datagram
+ *
+ * @param buffer    Datagram
+ * @param len       Datagram length
+ * @param features  Negotiated features (checksum skipped with
+ *                  XOE_WIRE_FEATURE_NO_CHECKSUM)
+ * @param packet    Output packet (release with xoe_wire_free_payload())
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, E_PROTOCOL_ERROR if the
+ *         datagram is not exactly one frame, E_CHECKSUM_MISMATCH,
+ *         E_OUT_OF_MEMORY
+ */
+int xoe_wire_dgram_decode(const uint8_t* buffer, uint32_t len,
+                          uint32_t features, xoe_packet_t* packet);
+
+/**
+ * @brief Send a packet as one datagram
+ *
+ * A datagram the kernel cannot queue right now (EAGAIN, ENOBUFS), or
+ * that an earlier ICMP error bounced (ECONNREFUSED), counts as lost and
+ * the call succeeds: datagram senders recover from loss anyway.
+ *
+ * @param fd        UDP socket
+ * @param ssl       DTLS session on @p fd (SSL*), or NULL
+ * @param to        Destination for an unconnected socket, or NULL
+ * @param to_len    Size of @p to
+ * @param features  Negotiated features
+ * @param packet    Packet to send
+ *
+ * @return 0 on success (or loss), negative error code on failure
+ */
+int xoe_wire_dgram_send(int fd, void* ssl, const struct sockaddr* to,
+                        socklen_t to_len, uint32_t features,
+                        const xoe_packet_t* packet);
+
+/**
+ * @brief Receive one datagram from a connected socket or DTLS session
+ *
+ * @param fd        Non-blocking connected UDP socket
+ * @param ssl       DTLS session on @p fd (SSL*), or NULL
+ * @param buffer    Output buffer
+ * @param size      Buffer size (XOE_WIRE_DGRAM_MAX is enough)
+ *
+ * @return Datagram length, 0 if the peer closed the DTLS session,
+ *         E_WOULD_BLOCK if nothing is queued, E_NETWORK_ERROR for an
+ *         ICMP error reported on the socket (the peer may come back),
+ *         E_PROTOCOL_ERROR for an oversized datagram (dropped), or
+ *         E_IO_ERROR
+ */
+int xoe_wire_dgram_recv(int fd, void* ssl, uint8_t* buffer, uint32_t size);
+
+/**
+ * @brief Client side: negotiate features on a datagram association
+ *
+ * Sends a HELLO every XOE_WIRE_DGRAM_HELLO_RETRY_MS until the HELLO_ACK
+ * arrives; other datagrams received meanwhile are dropped. Blocks the
+ * caller.
+ *
+ * @param fd            Connected UDP socket
+ * @param ssl           DTLS session on @p fd (SSL*), or NULL
+ * @param requested     Features to request
+ * @param accepted      Output: features granted by the server
+ * @param timeout_ms    How long to wait for the HELLO_ACK
+ *
+ * @return 0 on success, E_TIMEOUT if the server never answered,
+ *         negative error code on I/O failure
+ */
+int xoe_wire_dgram_negotiate(int fd, void* ssl, uint32_t requested,
+                             uint32_t* accepted, int timeout_ms);
+
+#endif /* WIRE_DGRAM_H */
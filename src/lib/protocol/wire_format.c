@@ -11,71 +11,22 @@
  */
 
 #include "wire_format.h"
+#include "crc32.h"
+#include "payload_pool.h"
+#include "wire_capture.h"
+#include "wire_trace.h"
+#include "wire_zerocopy.h"
 #include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+#include "lib/common/stage_prof.h"
 
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/socket.h>
-#include <zlib.h>
-
-#if TLS_ENABLED
-#include <openssl/ssl.h>
-#endif
-
-/*
- * Byte order conversion helpers
- */
-
-void xoe_wire_write_uint16(uint8_t* buffer, uint16_t value)
-{
-    buffer[0] = (uint8_t)(value >> 8);
-    buffer[1] = (uint8_t)(value);
-}
-
-void xoe_wire_write_uint32(uint8_t* buffer, uint32_t value)
-{
-    buffer[0] = (uint8_t)(value >> 24);
-    buffer[1] = (uint8_t)(value >> 16);
-    buffer[2] = (uint8_t)(value >> 8);
-    buffer[3] = (uint8_t)(value);
-}
-
-uint16_t xoe_wire_read_uint16(const uint8_t* buffer)
-{
-    return ((uint16_t)buffer[0] << 8) | buffer[1];
-}
-
-uint32_t xoe_wire_read_uint32(const uint8_t* buffer)
-{
-    return ((uint32_t)buffer[0] << 24) |
-           ((uint32_t)buffer[1] << 16) |
-           ((uint32_t)buffer[2] << 8) |
-           buffer[3];
-}
+#include <sys/uio.h>
 
 /*
- * Header serialization
- */
-
-void xoe_wire_serialize_header(uint8_t* buffer, const xoe_wire_header_t* header)
-{
-    xoe_wire_write_uint16(buffer + 0, header->protocol_id);
-    xoe_wire_write_uint16(buffer + 2, header->protocol_version);
-    xoe_wire_write_uint32(buffer + 4, header->payload_length);
-    xoe_wire_write_uint32(buffer + 8, header->checksum);
-}
-
-void xoe_wire_deserialize_header(xoe_wire_header_t* header, const uint8_t* buffer)
-{
-    header->protocol_id = xoe_wire_read_uint16(buffer + 0);
-    header->protocol_version = xoe_wire_read_uint16(buffer + 2);
-    header->payload_length = xoe_wire_read_uint32(buffer + 4);
-    header->checksum = xoe_wire_read_uint32(buffer + 8);
-}
-
-/*
- * Checksum calculation using zlib CRC32
+ * Checksum calculation (zlib-compatible CRC32, see crc32.h)
  */
 
 uint32_t xoe_wire_checksum(const void* data, uint32_t len)
@@ -83,35 +34,35 @@ uint32_t xoe_wire_checksum(const void* data, uint32_t len)
     if (data == NULL || len == 0) {
         return 0;
     }
-    return (uint32_t)crc32(0L, (const Bytef*)data, len);
+    return xoe_crc32_update(0, data, len);
 }
 
 /**
  * @brief Calculate checksum over header fields and payload
  *
  * Checksum covers: protocol_id, protocol_version, payload_length, payload_data
- * (checksum field itself is NOT included)
+ * (checksum field itself is NOT included). Header fields are folded into
+ * the CRC in network byte order directly, without serializing them first.
  */
-static uint32_t calculate_packet_checksum(const xoe_wire_header_t* header,
-                                          const void* payload_data)
+uint32_t xoe_wire_packet_checksum(const xoe_wire_header_t* header,
+                                  const void* payload_data)
 {
+    STAGE_PROF_VAR(start);
     uint32_t crc;
-    uint8_t header_bytes[8];  /* First 8 bytes of header (excluding checksum) */
 
-    /* Serialize header fields for checksum calculation */
-    xoe_wire_write_uint16(header_bytes + 0, header->protocol_id);
-    xoe_wire_write_uint16(header_bytes + 2, header->protocol_version);
-    xoe_wire_write_uint32(header_bytes + 4, header->payload_length);
+    STAGE_PROF_START(start);
 
     /* Start with header fields */
-    crc = (uint32_t)crc32(0L, header_bytes, 8);
+    crc = xoe_crc32_be16(0, header->protocol_id);
+    crc = xoe_crc32_be16(crc, header->protocol_version);
+    crc = xoe_crc32_be32(crc, header->payload_length);
 
     /* Include payload if present */
     if (payload_data != NULL && header->payload_length > 0) {
-        crc = (uint32_t)crc32(crc, (const Bytef*)payload_data,
-                              header->payload_length);
+        crc = xoe_crc32_update(crc, payload_data, header->payload_length);
     }
 
+    STAGE_PROF_STOP(STAGE_CHECKSUM, start);
     return crc;
 }
 
@@ -119,14 +70,16 @@ static uint32_t calculate_packet_checksum(const xoe_wire_header_t* header,
  * Helper to receive exactly n bytes (handles partial reads)
  */
 
-static int recv_exact(int fd, void* buffer, size_t len)
+static int recv_exact(xoe_transport_t* t, void* buffer, size_t len)
 {
+    struct iovec iov;
     size_t total = 0;
-    ssize_t received;
-    uint8_t* buf = (uint8_t*)buffer;
+    int received;
 
     while (total < len) {
-        received = recv(fd, buf + total, len - total, 0);
+        iov.iov_base = (uint8_t*)buffer + total;
+        iov.iov_len = len - total;
+        received = xoe_transport_readv(t, &iov, 1);
         if (received <= 0) {
             return E_IO_ERROR;
         }
@@ -135,71 +88,72 @@ static int recv_exact(int fd, void* buffer, size_t len)
     return 0;
 }
 
-static int send_exact(int fd, const void* buffer, size_t len)
-{
-    size_t total = 0;
-    ssize_t sent;
-    const uint8_t* buf = (const uint8_t*)buffer;
+/*
+ * Metrics accounting (a frame is its header plus payload on the wire)
+ */
 
-    while (total < len) {
-        sent = send(fd, buf + total, len - total, 0);
-        if (sent <= 0) {
-            return E_IO_ERROR;
-        }
-        total += (size_t)sent;
+static int count_tx_frame(int result, uint32_t payload_length)
+{
+    if (result == 0) {
+        metrics_add(METRIC_NET_TX_FRAMES, 1);
+        metrics_add(METRIC_NET_TX_BYTES,
+                    (uint64_t)XOE_WIRE_HEADER_SIZE + payload_length);
     }
-    return 0;
+    return result;
 }
 
-#if TLS_ENABLED
-static int tls_recv_exact(SSL* ssl, void* buffer, size_t len)
+static void count_rx_frame(uint32_t payload_length)
 {
-    size_t total = 0;
-    int received;
-    uint8_t* buf = (uint8_t*)buffer;
-
-    while (total < len) {
-        received = SSL_read(ssl, buf + total, (int)(len - total));
-        if (received <= 0) {
-            return E_IO_ERROR;
-        }
-        total += (size_t)received;
-    }
-    return 0;
+    metrics_add(METRIC_NET_RX_FRAMES, 1);
+    metrics_add(METRIC_NET_RX_BYTES,
+                (uint64_t)XOE_WIRE_HEADER_SIZE + payload_length);
 }
 
-static int tls_send_exact(SSL* ssl, const void* buffer, size_t len)
+/* Caller-framed data: frame boundaries are unknown, count the bytes */
+static int count_tx_iov(int result, const struct iovec* iov, int iovcnt)
 {
-    size_t total = 0;
-    int sent;
-    const uint8_t* buf = (const uint8_t*)buffer;
+    uint64_t bytes = 0;
+    int i;
 
-    while (total < len) {
-        sent = SSL_write(ssl, buf + total, (int)(len - total));
-        if (sent <= 0) {
-            return E_IO_ERROR;
+    if (result == 0) {
+        for (i = 0; i < iovcnt; i++) {
+            bytes += iov[i].iov_len;
         }
-        total += (size_t)sent;
+        metrics_add(METRIC_NET_TX_BYTES, bytes);
     }
-    return 0;
+    return result;
+}
+
+/*
+ * Flight recorder (see wire_trace.h)
+ */
+
+static int trace_tx_frame(int fd, const uint8_t* header_buffer, int result,
+                          int status)
+{
+    xoe_wire_trace_record_header(fd, XOE_WIRE_TRACE_TX, header_buffer,
+                                 (result == 0) ? status : XOE_WIRE_TRACE_FAILED);
+    return result;
 }
-#endif
 
 /*
  * Network I/O functions
  */
 
-int xoe_wire_send(int fd, const xoe_packet_t* packet)
+/**
+ * @brief Build the serialized wire header for an outgoing packet
+ *
+ * With XOE_WIRE_FEATURE_NO_CHECKSUM in @p features the checksum field is
+ * sent as 0 and the CRC is not computed.
+ *
+ * @return Payload length announced in the header
+ */
+static uint32_t prepare_send_header(const xoe_packet_t* packet,
+                                    uint8_t* header_buffer,
+                                    uint32_t features)
 {
     xoe_wire_header_t header;
-    uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
-    int result;
-
-    if (packet == NULL) {
-        return E_INVALID_ARGUMENT;
-    }
 
-    /* Build wire header from packet */
     header.protocol_id = packet->protocol_id;
     header.protocol_version = packet->protocol_version;
 
@@ -210,45 +164,99 @@ int xoe_wire_send(int fd, const xoe_packet_t* packet)
     }
 
     /* Calculate checksum over header fields + payload */
-    header.checksum = calculate_packet_checksum(&header,
-        (packet->payload != NULL) ? packet->payload->data : NULL);
+    if (features & XOE_WIRE_FEATURE_NO_CHECKSUM) {
+        header.checksum = 0;
+    } else {
+        header.checksum = xoe_wire_packet_checksum(&header,
+            (packet->payload != NULL) ? packet->payload->data : NULL);
+    }
 
-    /* Serialize header to buffer */
     xoe_wire_serialize_header(header_buffer, &header);
 
-    /* Send header */
-    result = send_exact(fd, header_buffer, XOE_WIRE_HEADER_SIZE);
-    if (result != 0) {
-        return result;
-    }
+    return header.payload_length;
+}
 
-    /* Send payload if present */
-    if (header.payload_length > 0) {
-        result = send_exact(fd, packet->payload->data, header.payload_length);
-        if (result != 0) {
-            return result;
+/**
+ * @brief Write a framed header and its payload in one transport write
+ */
+static int send_frame(xoe_transport_t* t, const xoe_packet_t* packet,
+                      const uint8_t* header_buffer, uint32_t payload_length,
+                      int trace_status)
+{
+    struct iovec iov[2];
+    int fd = xoe_transport_poll_fd(t);
+    int result;
+
+    /* Header and payload leave together: one segment, or one TLS record */
+    iov[0].iov_base = (void*)header_buffer;
+    iov[0].iov_len = XOE_WIRE_HEADER_SIZE;
+    iov[1].iov_base = (payload_length > 0) ? packet->payload->data : NULL;
+    iov[1].iov_len = payload_length;
+
+    /* Large pooled payloads may leave without a copy (wire_zerocopy.h),
+     * after what a corked transport has gathered; behind queued bytes
+     * they are copied into the queue */
+    result = E_NOT_SUPPORTED;
+    if (payload_length >= XOE_WIRE_ZEROCOPY_MIN) {
+        result = xoe_transport_flush(t);
+        if (result == 0) {
+            result = xoe_wire_zerocopy_send(t, header_buffer,
+                                            packet->payload);
         }
     }
+    if (result == E_NOT_SUPPORTED || result == E_WOULD_BLOCK) {
+        result = xoe_transport_writev(t, iov, (payload_length > 0) ? 2 : 1);
+    }
+    result = count_tx_frame(result, payload_length);
+    if (result == 0) {
+        xoe_wire_capture_frame(fd, XOE_WIRE_CAPTURE_TX, header_buffer,
+                               (const uint8_t*)iov[1].iov_base, trace_status);
+    }
+    return trace_tx_frame(fd, header_buffer, result, trace_status);
+}
 
-    return 0;
+int xoe_wire_send_transport(xoe_transport_t* t, const xoe_packet_t* packet,
+                            uint32_t features)
+{
+    uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
+    uint32_t payload_length;
+
+    if (t == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    payload_length = prepare_send_header(packet, header_buffer, features);
+    return send_frame(t, packet, header_buffer, payload_length,
+                      (features & XOE_WIRE_FEATURE_NO_CHECKSUM)
+                          ? XOE_WIRE_TRACE_UNCHECKED : XOE_WIRE_TRACE_OK);
 }
 
-int xoe_wire_recv(int fd, xoe_packet_t* packet)
+int xoe_wire_sendv_transport(xoe_transport_t* t, const struct iovec* iov,
+                             int iovcnt)
+{
+    return count_tx_iov(xoe_transport_writev(t, iov, iovcnt), iov, iovcnt);
+}
+
+int xoe_wire_recv_transport(xoe_transport_t* t, xoe_packet_t* packet,
+                            uint32_t features)
 {
     xoe_wire_header_t header;
     uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
     uint32_t calculated_checksum;
+    int status;
+    int fd;
     int result;
 
-    if (packet == NULL) {
+    if (t == NULL || packet == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
     /* Initialize packet */
     memset(packet, 0, sizeof(xoe_packet_t));
+    fd = xoe_transport_poll_fd(t);
 
     /* Receive header */
-    result = recv_exact(fd, header_buffer, XOE_WIRE_HEADER_SIZE);
+    result = recv_exact(t, header_buffer, XOE_WIRE_HEADER_SIZE);
     if (result != 0) {
         return result;
     }
@@ -258,6 +266,8 @@ int xoe_wire_recv(int fd, xoe_packet_t* packet)
 
     /* Validate payload length */
     if (header.payload_length > XOE_WIRE_MAX_PAYLOAD) {
+        xoe_wire_trace_record(fd, XOE_WIRE_TRACE_RX, header.protocol_id,
+                              header.payload_length, XOE_WIRE_TRACE_FAILED);
         return E_PROTOCOL_ERROR;
     }
 
@@ -268,169 +278,882 @@ int xoe_wire_recv(int fd, xoe_packet_t* packet)
 
     /* Allocate and receive payload if present */
     if (header.payload_length > 0) {
-        packet->payload = (xoe_payload_t*)malloc(sizeof(xoe_payload_t));
+        packet->payload = xoe_payload_alloc(header.payload_length);
         if (packet->payload == NULL) {
             return E_OUT_OF_MEMORY;
         }
 
-        packet->payload->data = malloc(header.payload_length);
-        if (packet->payload->data == NULL) {
-            free(packet->payload);
-            packet->payload = NULL;
-            return E_OUT_OF_MEMORY;
-        }
-
-        packet->payload->len = header.payload_length;
-        packet->payload->owns_data = TRUE;
-
-        result = recv_exact(fd, packet->payload->data, header.payload_length);
+        result = recv_exact(t, packet->payload->data, header.payload_length);
         if (result != 0) {
             xoe_wire_free_payload(packet);
             return result;
         }
     }
 
-    /* Validate checksum */
-    calculated_checksum = calculate_packet_checksum(&header,
-        (packet->payload != NULL) ? packet->payload->data : NULL);
+    /* Validate checksum (skipped when negotiated off for this session) */
+    if (!(features & XOE_WIRE_FEATURE_NO_CHECKSUM)) {
+        calculated_checksum = xoe_wire_packet_checksum(&header,
+            (packet->payload != NULL) ? packet->payload->data : NULL);
 
-    if (calculated_checksum != header.checksum) {
-        xoe_wire_free_payload(packet);
-        return E_CHECKSUM_MISMATCH;
+        if (calculated_checksum != header.checksum) {
+            xoe_wire_free_payload(packet);
+            metrics_add(METRIC_NET_CHECKSUM_FAILURES, 1);
+            xoe_wire_trace_record(fd, XOE_WIRE_TRACE_RX, header.protocol_id,
+                                  header.payload_length,
+                                  XOE_WIRE_TRACE_BAD_CHECKSUM);
+            return E_CHECKSUM_MISMATCH;
+        }
     }
 
+    status = (features & XOE_WIRE_FEATURE_NO_CHECKSUM)
+             ? XOE_WIRE_TRACE_UNCHECKED : XOE_WIRE_TRACE_OK;
+    count_rx_frame(header.payload_length);
+    xoe_wire_trace_record(fd, XOE_WIRE_TRACE_RX, header.protocol_id,
+                          header.payload_length, status);
+    xoe_wire_capture_frame(fd, XOE_WIRE_CAPTURE_RX, header_buffer,
+                           (packet->payload != NULL)
+                               ? packet->payload->data : NULL,
+                           status);
     return 0;
 }
 
-#if TLS_ENABLED
-int xoe_wire_send_tls(void* ssl_ptr, const xoe_packet_t* packet)
+/*
+ * Descriptor and SSL* entry points: bind a transport for the one call
+ */
+
+int xoe_wire_sendv(int fd, const struct iovec* iov, int iovcnt)
 {
-    SSL* ssl = (SSL*)ssl_ptr;
-    xoe_wire_header_t header;
-    uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
+    xoe_transport_t t;
     int result;
 
-    if (packet == NULL || ssl == NULL) {
+    result = xoe_transport_init_fd(&t, fd);
+    if (result != 0) {
+        /* Argument errors first, as for a bad iovec */
+        return (iov == NULL || iovcnt <= 0 || iovcnt > XOE_WIRE_SENDV_MAX_IOV)
+               ? E_INVALID_ARGUMENT : E_IO_ERROR;
+    }
+    return xoe_wire_sendv_transport(&t, iov, iovcnt);
+}
+
+int xoe_wire_sendv_tls(void* ssl_ptr, const struct iovec* iov, int iovcnt)
+{
+    xoe_transport_t t;
+    int result;
+
+    result = xoe_transport_init_tls(&t, ssl_ptr);
+    if (result != 0) {
+        return result;
+    }
+    return xoe_wire_sendv_transport(&t, iov, iovcnt);
+}
+
+int xoe_wire_send(int fd, const xoe_packet_t* packet)
+{
+    xoe_transport_t t;
+
+    if (packet == NULL) {
         return E_INVALID_ARGUMENT;
     }
+    if (xoe_transport_init_fd(&t, fd) != 0) {
+        return E_IO_ERROR;
+    }
+    return xoe_wire_send_transport(&t, packet, 0);
+}
+
+uint32_t xoe_wire_build_header(const xoe_packet_t* packet,
+                               uint8_t* header_buffer,
+                               int relay)
+{
+    xoe_wire_header_t header;
+
+    /* A received checksum is still valid for the unchanged frame */
+    if (!relay || packet->checksum == 0) {
+        return prepare_send_header(packet, header_buffer, 0);
+    }
 
-    /* Build wire header from packet */
     header.protocol_id = packet->protocol_id;
     header.protocol_version = packet->protocol_version;
+    header.payload_length = (packet->payload != NULL &&
+                             packet->payload->data != NULL)
+                            ? packet->payload->len : 0;
+    header.checksum = packet->checksum;
+    xoe_wire_serialize_header(header_buffer, &header);
 
-    if (packet->payload != NULL && packet->payload->data != NULL) {
-        header.payload_length = packet->payload->len;
-    } else {
-        header.payload_length = 0;
+    return header.payload_length;
+}
+
+int xoe_wire_forward(int fd, const xoe_packet_t* packet)
+{
+    uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
+    uint32_t payload_length;
+    xoe_transport_t t;
+
+    if (packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (xoe_transport_init_fd(&t, fd) != 0) {
+        return E_IO_ERROR;
     }
 
-    /* Calculate checksum */
-    header.checksum = calculate_packet_checksum(&header,
-        (packet->payload != NULL) ? packet->payload->data : NULL);
+    payload_length = xoe_wire_build_header(packet, header_buffer, TRUE);
+    return send_frame(&t, packet, header_buffer, payload_length,
+                      XOE_WIRE_TRACE_OK);
+}
 
-    /* Serialize and send header */
-    xoe_wire_serialize_header(header_buffer, &header);
-    result = tls_send_exact(ssl, header_buffer, XOE_WIRE_HEADER_SIZE);
+int xoe_wire_recv(int fd, xoe_packet_t* packet)
+{
+    xoe_transport_t t;
+
+    if (packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (xoe_transport_init_fd(&t, fd) != 0) {
+        memset(packet, 0, sizeof(xoe_packet_t));
+        return E_IO_ERROR;
+    }
+    return xoe_wire_recv_transport(&t, packet, 0);
+}
+
+int xoe_wire_send_tls(void* ssl_ptr, const xoe_packet_t* packet)
+{
+    return xoe_wire_send_tls_ex(ssl_ptr, packet, 0);
+}
+
+int xoe_wire_send_tls_ex(void* ssl_ptr, const xoe_packet_t* packet,
+                         uint32_t features)
+{
+    xoe_transport_t t;
+    int result;
+
+    if (packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    result = xoe_transport_init_tls(&t, ssl_ptr);
     if (result != 0) {
         return result;
     }
+    return xoe_wire_send_transport(&t, packet, features);
+}
 
-    /* Send payload if present */
-    if (header.payload_length > 0) {
-        result = tls_send_exact(ssl, packet->payload->data, header.payload_length);
-        if (result != 0) {
-            return result;
-        }
+int xoe_wire_recv_tls(void* ssl_ptr, xoe_packet_t* packet)
+{
+    return xoe_wire_recv_tls_ex(ssl_ptr, packet, 0);
+}
+
+int xoe_wire_recv_tls_ex(void* ssl_ptr, xoe_packet_t* packet,
+                         uint32_t features)
+{
+    xoe_transport_t t;
+    int result;
+
+    if (packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    result = xoe_transport_init_tls(&t, ssl_ptr);
+    if (result != 0) {
+        return result;
+    }
+    return xoe_wire_recv_transport(&t, packet, features);
+}
+
+/*
+ * Feature negotiation
+ */
+
+uint32_t xoe_wire_features_accept(uint32_t requested,
+                                  int transport_authenticated)
+{
+    uint32_t accepted = requested & XOE_WIRE_FEATURES_SUPPORTED;
+
+    /* Frame CRC is the only integrity check on plain TCP */
+    if (!transport_authenticated) {
+        accepted &= ~(uint32_t)XOE_WIRE_FEATURE_NO_CHECKSUM;
+    }
+
+    /* One compression back-end per connection; LZ4 is the cheaper one */
+    if (accepted & XOE_WIRE_FEATURE_COMPRESS_LZ4) {
+        accepted &= ~(uint32_t)XOE_WIRE_FEATURE_COMPRESS_ZLIB;
+    }
+
+    return accepted;
+}
+
+void xoe_wire_hello_init(xoe_packet_t* packet, xoe_payload_t* payload,
+                         uint8_t* buffer, uint16_t type, uint32_t features)
+{
+    xoe_wire_write_uint16(buffer + 0, type);
+    xoe_wire_write_uint16(buffer + 2, 0);
+    xoe_wire_write_uint32(buffer + 4, features);
+
+    payload->data = buffer;
+    payload->len = XOE_WIRE_HELLO_SIZE;
+    payload->owns_data = FALSE;
+
+    memset(packet, 0, sizeof(xoe_packet_t));
+    packet->protocol_id = XOE_PROTOCOL_WIRE_CTRL;
+    packet->protocol_version = XOE_WIRE_VERSION;
+    packet->payload = payload;
+}
+
+int xoe_wire_hello_parse(const xoe_packet_t* packet, uint16_t* type,
+                         uint32_t* features)
+{
+    const uint8_t* data;
+
+    if (packet == NULL || type == NULL || features == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (packet->protocol_id != XOE_PROTOCOL_WIRE_CTRL ||
+        packet->payload == NULL || packet->payload->data == NULL ||
+        packet->payload->len < XOE_WIRE_HELLO_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    data = (const uint8_t*)packet->payload->data;
+    *type = xoe_wire_read_uint16(data + 0);
+    *features = xoe_wire_read_uint32(data + 4);
+
+    if (*type != XOE_WIRE_CTRL_HELLO && *type != XOE_WIRE_CTRL_HELLO_ACK) {
+        return E_PROTOCOL_ERROR;
     }
 
     return 0;
 }
 
-int xoe_wire_recv_tls(void* ssl_ptr, xoe_packet_t* packet)
+int xoe_wire_negotiate_transport(xoe_transport_t* t, uint32_t requested,
+                                 uint32_t* accepted)
 {
-    SSL* ssl = (SSL*)ssl_ptr;
-    xoe_wire_header_t header;
-    uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
-    uint32_t calculated_checksum;
+    xoe_packet_t packet;
+    xoe_payload_t payload;
+    uint8_t buffer[XOE_WIRE_HELLO_SIZE];
+    uint16_t type = 0;
+    uint32_t features = 0;
     int result;
 
-    if (packet == NULL || ssl == NULL) {
+    if (t == NULL || accepted == NULL) {
         return E_INVALID_ARGUMENT;
     }
 
-    /* Initialize packet */
-    memset(packet, 0, sizeof(xoe_packet_t));
+    *accepted = 0;
 
-    /* Receive header */
-    result = tls_recv_exact(ssl, header_buffer, XOE_WIRE_HEADER_SIZE);
+    xoe_wire_hello_init(&packet, &payload, buffer, XOE_WIRE_CTRL_HELLO,
+                        requested);
+    result = xoe_wire_send_transport(t, &packet, 0);
     if (result != 0) {
         return result;
     }
 
-    /* Deserialize header */
-    xoe_wire_deserialize_header(&header, header_buffer);
+    result = xoe_wire_recv_transport(t, &packet, 0);
+    if (result != 0) {
+        return result;
+    }
 
-    /* Validate payload length */
-    if (header.payload_length > XOE_WIRE_MAX_PAYLOAD) {
+    /*
+     * Servers predating negotiation echo unknown protocols, so anything
+     * other than an ACK leaves all features off.
+     */
+    if (xoe_wire_hello_parse(&packet, &type, &features) == 0 &&
+        type == XOE_WIRE_CTRL_HELLO_ACK) {
+        *accepted = features & requested;
+    }
+    xoe_wire_free_payload(&packet);
+
+    return 0;
+}
+
+int xoe_wire_negotiate(int fd, uint32_t requested, uint32_t* accepted)
+{
+    xoe_transport_t t;
+
+    if (accepted == NULL || xoe_transport_init_fd(&t, fd) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    return xoe_wire_negotiate_transport(&t, requested, accepted);
+}
+
+int xoe_wire_negotiate_tls(void* ssl_ptr, uint32_t requested,
+                           uint32_t* accepted)
+{
+    xoe_transport_t t;
+    int result;
+
+    if (accepted == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    result = xoe_transport_init_tls(&t, ssl_ptr);
+    if (result != 0) {
+        return result;
+    }
+    return xoe_wire_negotiate_transport(&t, requested, accepted);
+}
+
+int xoe_wire_raw_join_init(xoe_packet_t* packet, xoe_payload_t* payload,
+                           uint8_t* buffer, const char* name)
+{
+    size_t len;
+    size_t i;
+
+    if (packet == NULL || payload == NULL || buffer == NULL || name == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    len = strlen(name);
+    if (len == 0 || len > XOE_WIRE_RAW_NAME_MAX) {
+        return E_INVALID_ARGUMENT;
+    }
+    for (i = 0; i < len; i++) {
+        if (!isgraph((unsigned char)name[i])) {
+            return E_INVALID_ARGUMENT;
+        }
+    }
+
+    xoe_wire_write_uint16(buffer + 0, XOE_WIRE_CTRL_RAW_JOIN);
+    xoe_wire_write_uint16(buffer + 2, 0);
+    memcpy(buffer + XOE_WIRE_RAW_JOIN_HEADER, name, len);
+
+    payload->data = buffer;
+    payload->len = (uint32_t)(XOE_WIRE_RAW_JOIN_HEADER + len);
+    payload->owns_data = FALSE;
+
+    memset(packet, 0, sizeof(xoe_packet_t));
+    packet->protocol_id = XOE_PROTOCOL_WIRE_CTRL;
+    packet->protocol_version = XOE_WIRE_VERSION;
+    packet->payload = payload;
+
+    return 0;
+}
+
+int xoe_wire_raw_join_parse(const xoe_packet_t* packet, char* name)
+{
+    const uint8_t* data;
+    uint32_t len;
+    uint32_t i;
+
+    if (packet == NULL || name == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    if (packet->protocol_id != XOE_PROTOCOL_WIRE_CTRL ||
+        packet->payload == NULL || packet->payload->data == NULL ||
+        packet->payload->len <= XOE_WIRE_RAW_JOIN_HEADER ||
+        packet->payload->len > XOE_WIRE_RAW_JOIN_HEADER +
+                               XOE_WIRE_RAW_NAME_MAX) {
         return E_PROTOCOL_ERROR;
     }
 
-    /* Copy header fields to packet */
-    packet->protocol_id = header.protocol_id;
-    packet->protocol_version = header.protocol_version;
-    packet->checksum = header.checksum;
+    data = (const uint8_t*)packet->payload->data;
+    if (xoe_wire_read_uint16(data + 0) != XOE_WIRE_CTRL_RAW_JOIN) {
+        return E_PROTOCOL_ERROR;
+    }
 
-    /* Allocate and receive payload if present */
-    if (header.payload_length > 0) {
-        packet->payload = (xoe_payload_t*)malloc(sizeof(xoe_payload_t));
-        if (packet->payload == NULL) {
-            return E_OUT_OF_MEMORY;
+    len = packet->payload->len - XOE_WIRE_RAW_JOIN_HEADER;
+    for (i = 0; i < len; i++) {
+        if (!isgraph(data[XOE_WIRE_RAW_JOIN_HEADER + i])) {
+            return E_PROTOCOL_ERROR;
+        }
+        name[i] = (char)data[XOE_WIRE_RAW_JOIN_HEADER + i];
+    }
+    name[len] = '\0';
+
+    return 0;
+}
+
+int xoe_wire_raw_join(int fd, const char* name)
+{
+    xoe_transport_t t;
+    xoe_packet_t packet;
+    xoe_payload_t payload;
+    uint8_t buffer[XOE_WIRE_RAW_JOIN_HEADER + XOE_WIRE_RAW_NAME_MAX];
+    const uint8_t* data;
+    int result;
+
+    if (xoe_transport_init_fd(&t, fd) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    result = xoe_wire_raw_join_init(&packet, &payload, buffer, name);
+    if (result != 0) {
+        return result;
+    }
+
+    result = xoe_wire_send_transport(&t, &packet, 0);
+    if (result != 0) {
+        return result;
+    }
+
+    /* Exact reads: the raw bytes right behind the answer stay unread */
+    result = xoe_wire_recv_transport(&t, &packet, 0);
+    if (result != 0) {
+        return result;
+    }
+
+    result = E_PROTOCOL_ERROR;
+    if (packet.protocol_id == XOE_PROTOCOL_WIRE_CTRL &&
+        packet.payload != NULL &&
+        packet.payload->len >= XOE_WIRE_HELLO_SIZE) {
+        data = (const uint8_t*)packet.payload->data;
+        if (xoe_wire_read_uint16(data + 0) == XOE_WIRE_CTRL_RAW_READY) {
+            result = 0;
         }
+    }
+    xoe_wire_free_payload(&packet);
+
+    return result;
+}
+
+/*
+ * Incremental frame decoder
+ */
+
+int xoe_wire_decoder_init(xoe_wire_decoder_t* decoder, uint32_t buffer_size)
+{
+    if (decoder == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    memset(decoder, 0, sizeof(xoe_wire_decoder_t));
+
+    if (buffer_size == 0) {
+        buffer_size = XOE_WIRE_DECODER_DEFAULT_BUFFER;
+    }
+
+    decoder->buffer = (uint8_t*)malloc(buffer_size);
+    if (decoder->buffer == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    decoder->buffer_size = buffer_size;
+    decoder->buffer_initial = buffer_size;
+    decoder->buffer_max = buffer_size;
+    decoder->trace_fd = -1;
+    mem_budget_charge(buffer_size);
+
+    return 0;
+}
+
+void xoe_wire_decoder_set_max_buffer(xoe_wire_decoder_t* decoder,
+                                     uint32_t max_size)
+{
+    if (decoder == NULL) {
+        return;
+    }
+
+    decoder->buffer_max = (max_size > decoder->buffer_initial)
+                          ? max_size : decoder->buffer_initial;
+}
+
+void xoe_wire_decoder_set_account(xoe_wire_decoder_t* decoder,
+                                  mem_account_t* account)
+{
+    size_t held;
 
-        packet->payload->data = malloc(header.payload_length);
-        if (packet->payload->data == NULL) {
-            free(packet->payload);
-            packet->payload = NULL;
+    if (decoder == NULL || decoder->account == account) {
+        return;
+    }
+
+    held = decoder->buffer_size;
+    if (decoder->payload != NULL) {
+        held += decoder->header.payload_length;
+    }
+    mem_account_uncharge(decoder->account, held);
+    mem_account_charge(account, held);
+    decoder->account = account;
+}
+
+void xoe_wire_decoder_set_features(xoe_wire_decoder_t* decoder,
+                                   uint32_t features)
+{
+    if (decoder != NULL) {
+        decoder->features = features;
+    }
+}
+
+int xoe_wire_decoder_idle(const xoe_wire_decoder_t* decoder)
+{
+    if (decoder == NULL) {
+        return TRUE;
+    }
+
+    return decoder->buffer_start == decoder->buffer_end &&
+           decoder->header_got == 0 && decoder->payload == NULL;
+}
+
+void xoe_wire_decoder_cleanup(xoe_wire_decoder_t* decoder)
+{
+    if (decoder == NULL) {
+        return;
+    }
+
+    xoe_wire_decoder_set_account(decoder, NULL);
+    mem_budget_uncharge(decoder->buffer_size);
+    free(decoder->buffer);
+    xoe_payload_release(decoder->payload);
+    memset(decoder, 0, sizeof(xoe_wire_decoder_t));
+}
+
+/**
+ * @brief Hand the frame being assembled over (or drop it), uncharging it
+ */
+static xoe_payload_t* decoder_take_payload(xoe_wire_decoder_t* decoder)
+{
+    xoe_payload_t* payload = decoder->payload;
+
+    if (payload != NULL) {
+        mem_account_uncharge(decoder->account, decoder->header.payload_length);
+    }
+    decoder->payload = NULL;
+    return payload;
+}
+
+/**
+ * @brief Drop any partial frame (stream can no longer be trusted)
+ */
+static void decoder_reset_frame(xoe_wire_decoder_t* decoder)
+{
+    xoe_payload_release(decoder_take_payload(decoder));
+    decoder->header_got = 0;
+    decoder->payload_got = 0;
+}
+
+/**
+ * @brief Validate the completed frame and hand it over as a packet
+ */
+static int decoder_complete_frame(xoe_wire_decoder_t* decoder,
+                                  xoe_packet_t* packet)
+{
+    xoe_payload_t* payload = decoder_take_payload(decoder);
+    int status;
+
+    /* Payload ownership moves to the packet; parser starts a new frame */
+    decoder->header_got = 0;
+    decoder->payload_got = 0;
+
+    if (!(decoder->features & XOE_WIRE_FEATURE_NO_CHECKSUM) &&
+        xoe_wire_packet_checksum(&decoder->header,
+            (payload != NULL) ? payload->data : NULL) !=
+        decoder->header.checksum) {
+        xoe_payload_release(payload);
+        metrics_add(METRIC_NET_CHECKSUM_FAILURES, 1);
+        xoe_wire_trace_record(decoder->trace_fd, XOE_WIRE_TRACE_RX,
+                              decoder->header.protocol_id,
+                              decoder->header.payload_length,
+                              XOE_WIRE_TRACE_BAD_CHECKSUM);
+        return E_CHECKSUM_MISMATCH;
+    }
+
+    status = (decoder->features & XOE_WIRE_FEATURE_NO_CHECKSUM)
+             ? XOE_WIRE_TRACE_UNCHECKED : XOE_WIRE_TRACE_OK;
+    count_rx_frame(decoder->header.payload_length);
+    xoe_wire_trace_record(decoder->trace_fd, XOE_WIRE_TRACE_RX,
+                          decoder->header.protocol_id,
+                          decoder->header.payload_length, status);
+    xoe_wire_capture_frame(decoder->trace_fd, XOE_WIRE_CAPTURE_RX,
+                           decoder->header_buf,
+                           (payload != NULL) ? payload->data : NULL, status);
+
+    memset(packet, 0, sizeof(xoe_packet_t));
+    packet->protocol_id = decoder->header.protocol_id;
+    packet->protocol_version = decoder->header.protocol_version;
+    packet->checksum = decoder->header.checksum;
+    packet->payload = payload;
+
+    return 1;
+}
+
+int xoe_wire_decoder_feed(xoe_wire_decoder_t* decoder, const void* data,
+                          uint32_t len, uint32_t* consumed,
+                          xoe_packet_t* packet)
+{
+    const uint8_t* in = (const uint8_t*)data;
+    uint32_t used = 0;
+    uint32_t take;
+
+    if (decoder == NULL || consumed == NULL || packet == NULL ||
+        (data == NULL && len > 0)) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    *consumed = 0;
+
+    /* Header */
+    if (decoder->header_got < XOE_WIRE_HEADER_SIZE) {
+        take = XOE_WIRE_HEADER_SIZE - decoder->header_got;
+        if (take > len) {
+            take = len;
+        }
+        memcpy(decoder->header_buf + decoder->header_got, in, take);
+        decoder->header_got += take;
+        used += take;
+
+        if (decoder->header_got < XOE_WIRE_HEADER_SIZE) {
+            *consumed = used;
+            return 0;
+        }
+
+        xoe_wire_deserialize_header(&decoder->header, decoder->header_buf);
+
+        /* Validate payload length before allocating */
+        if (decoder->header.payload_length > XOE_WIRE_MAX_PAYLOAD) {
+            xoe_wire_trace_record(decoder->trace_fd, XOE_WIRE_TRACE_RX,
+                                  decoder->header.protocol_id,
+                                  decoder->header.payload_length,
+                                  XOE_WIRE_TRACE_FAILED);
+            decoder_reset_frame(decoder);
+            *consumed = used;
+            return E_PROTOCOL_ERROR;
+        }
+
+        decoder->payload_got = 0;
+    }
+
+    /* Payload buffer, unless the budget has to free some memory first */
+    if (decoder->payload == NULL && decoder->header.payload_length > 0) {
+        *consumed = used;
+        if (decoder->account != NULL &&
+            !mem_budget_fits(decoder->header.payload_length)) {
+            if (mem_budget_limit() < decoder->header.payload_length) {
+                metrics_add(METRIC_MEM_REFUSED, 1);
+                decoder_reset_frame(decoder);
+                return E_OUT_OF_MEMORY;
+            }
+            return E_WOULD_BLOCK;
+        }
+        decoder->payload = xoe_payload_alloc(decoder->header.payload_length);
+        if (decoder->payload == NULL) {
+            decoder_reset_frame(decoder);
             return E_OUT_OF_MEMORY;
         }
+        mem_account_charge(decoder->account, decoder->header.payload_length);
+    }
+
+    /* Payload */
+    if (decoder->payload_got < decoder->header.payload_length) {
+        take = decoder->header.payload_length - decoder->payload_got;
+        if (take > len - used) {
+            take = len - used;
+        }
+        memcpy((uint8_t*)decoder->payload->data + decoder->payload_got,
+               in + used, take);
+        decoder->payload_got += take;
+        used += take;
+
+        if (decoder->payload_got < decoder->header.payload_length) {
+            *consumed = used;
+            return 0;
+        }
+    }
 
-        packet->payload->len = header.payload_length;
-        packet->payload->owns_data = TRUE;
+    *consumed = used;
+    return decoder_complete_frame(decoder, packet);
+}
 
-        result = tls_recv_exact(ssl, packet->payload->data, header.payload_length);
-        if (result != 0) {
-            xoe_wire_free_payload(packet);
-            return result;
+int xoe_wire_decoder_next(xoe_wire_decoder_t* decoder, xoe_packet_t* packet)
+{
+    uint32_t consumed = 0;
+    int result;
+
+    if (decoder == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    /*
+     * A direct payload read can complete a frame with nothing staged, and
+     * a frame held back for memory retries its payload buffer
+     */
+    if (decoder->buffer_start == decoder->buffer_end &&
+        !(decoder->header_got == XOE_WIRE_HEADER_SIZE &&
+          (decoder->payload_got == decoder->header.payload_length ||
+           decoder->payload == NULL))) {
+        return 0;
+    }
+
+    result = xoe_wire_decoder_feed(decoder,
+                                   decoder->buffer + decoder->buffer_start,
+                                   decoder->buffer_end - decoder->buffer_start,
+                                   &consumed, packet);
+    decoder->buffer_start += consumed;
+
+    if (decoder->buffer_start == decoder->buffer_end) {
+        decoder->buffer_start = 0;
+        decoder->buffer_end = 0;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Resize the staging buffer, keeping its staged bytes
+ *
+ * @return TRUE if resized, FALSE if the allocation failed
+ */
+static int decoder_resize(xoe_wire_decoder_t* decoder, uint32_t size)
+{
+    uint8_t* buffer;
+
+    buffer = (uint8_t*)realloc(decoder->buffer, size);
+    if (buffer == NULL) {
+        return FALSE;
+    }
+
+    if (size > decoder->buffer_size) {
+        mem_budget_charge(size - decoder->buffer_size);
+        mem_account_charge(decoder->account, size - decoder->buffer_size);
+    } else {
+        mem_budget_uncharge(decoder->buffer_size - size);
+        mem_account_uncharge(decoder->account, decoder->buffer_size - size);
+    }
+    decoder->buffer = buffer;
+    decoder->buffer_size = size;
+    decoder->short_reads = 0;
+    return TRUE;
+}
+
+/**
+ * @brief Adapt the staging buffer to a read of @count into @space bytes
+ *
+ * A full read doubles it; a long run of short ones halves it, once the
+ * staged bytes fit.
+ */
+static void decoder_adapt(xoe_wire_decoder_t* decoder, uint32_t count,
+                          uint32_t space)
+{
+    uint32_t size = decoder->buffer_size;
+
+    if (count == space && size < decoder->buffer_max) {
+        if (!mem_budget_pressure()) {
+            decoder_resize(decoder, (size < decoder->buffer_max / 2)
+                                    ? size * 2 : decoder->buffer_max);
         }
+        return;
     }
 
-    /* Validate checksum */
-    calculated_checksum = calculate_packet_checksum(&header,
-        (packet->payload != NULL) ? packet->payload->data : NULL);
+    if (count >= size / 4) {
+        decoder->short_reads = 0;
+        return;
+    }
 
-    if (calculated_checksum != header.checksum) {
-        xoe_wire_free_payload(packet);
-        return E_CHECKSUM_MISMATCH;
+    if (size > decoder->buffer_initial &&
+        ++decoder->short_reads >= XOE_WIRE_DECODER_SHRINK_READS &&
+        decoder->buffer_end - decoder->buffer_start <= size / 2) {
+        if (decoder->buffer_start > 0) {
+            memmove(decoder->buffer, decoder->buffer + decoder->buffer_start,
+                    decoder->buffer_end - decoder->buffer_start);
+            decoder->buffer_end -= decoder->buffer_start;
+            decoder->buffer_start = 0;
+        }
+        decoder_resize(decoder, (size / 2 > decoder->buffer_initial)
+                                ? size / 2 : decoder->buffer_initial);
     }
+}
 
-    return 0;
+/**
+ * @brief Choose where the next read lands
+ *
+ * While a payload is being assembled and nothing is staged, bytes go
+ * straight into the payload buffer (no staging copy for large frames).
+ * Otherwise staged bytes are compacted and the free tail is returned.
+ */
+static uint8_t* decoder_read_target(xoe_wire_decoder_t* decoder,
+                                    uint32_t* space, int* direct)
+{
+    uint32_t staged = decoder->buffer_end - decoder->buffer_start;
+
+    *direct = FALSE;
+
+    if (staged == 0 &&
+        decoder->header_got == XOE_WIRE_HEADER_SIZE &&
+        decoder->payload != NULL &&
+        decoder->header.payload_length - decoder->payload_got >=
+            decoder->buffer_initial) {
+        *direct = TRUE;
+        *space = decoder->header.payload_length - decoder->payload_got;
+        return (uint8_t*)decoder->payload->data + decoder->payload_got;
+    }
+
+    if (decoder->buffer_start > 0) {
+        memmove(decoder->buffer, decoder->buffer + decoder->buffer_start,
+                staged);
+        decoder->buffer_start = 0;
+        decoder->buffer_end = staged;
+    }
+
+    *space = decoder->buffer_size - decoder->buffer_end;
+    return decoder->buffer + decoder->buffer_end;
 }
-#else
-/* Stub implementations when TLS is disabled */
-int xoe_wire_send_tls(void* ssl_ptr, const xoe_packet_t* packet)
+
+/**
+ * @brief Account for bytes landed by decoder_read_target()
+ */
+static void decoder_commit_read(xoe_wire_decoder_t* decoder, int direct,
+                                uint32_t count)
 {
-    (void)ssl_ptr;
-    (void)packet;
-    return E_NOT_SUPPORTED;
+    if (direct) {
+        decoder->payload_got += count;
+    } else {
+        decoder->buffer_end += count;
+    }
 }
 
-int xoe_wire_recv_tls(void* ssl_ptr, xoe_packet_t* packet)
+int xoe_wire_decoder_recv_transport(xoe_wire_decoder_t* decoder,
+                                    xoe_transport_t* t)
 {
-    (void)ssl_ptr;
-    (void)packet;
-    return E_NOT_SUPPORTED;
+    struct iovec iov;
+    uint32_t space;
+    int direct;
+    int received;
+
+    if (decoder == NULL || decoder->buffer == NULL || t == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    decoder->trace_fd = xoe_transport_poll_fd(t);
+    iov.iov_base = decoder_read_target(decoder, &space, &direct);
+    iov.iov_len = space;
+    if (space == 0) {
+        return E_BUFFER_TOO_SMALL;  /* Caller must drain with _next() */
+    }
+
+    received = xoe_transport_readv(t, &iov, 1);
+    if (received > 0) {
+        decoder_commit_read(decoder, direct, (uint32_t)received);
+        if (!direct) {
+            decoder_adapt(decoder, (uint32_t)received, space);
+        }
+    }
+    return received;
+}
+
+int xoe_wire_decoder_recv(xoe_wire_decoder_t* decoder, int fd)
+{
+    xoe_transport_t t;
+
+    if (xoe_transport_init_fd(&t, fd) != 0) {
+        return E_INVALID_ARGUMENT;
+    }
+    return xoe_wire_decoder_recv_transport(decoder, &t);
+}
+
+int xoe_wire_pending(int fd)
+{
+    xoe_transport_t t;
+
+    if (xoe_transport_init_fd(&t, fd) != 0) {
+        return FALSE;
+    }
+    return xoe_transport_pending(&t);
+}
+
+int xoe_wire_decoder_recv_tls(xoe_wire_decoder_t* decoder, void* ssl_ptr)
+{
+    xoe_transport_t t;
+    int result;
+
+    result = xoe_transport_init_tls(&t, ssl_ptr);
+    if (result != 0) {
+        return result;
+    }
+    return xoe_wire_decoder_recv_transport(decoder, &t);
 }
-#endif
 
 void xoe_wire_free_payload(xoe_packet_t* packet)
 {
@@ -439,10 +1162,7 @@ void xoe_wire_free_payload(xoe_packet_t* packet)
     }
 
     if (packet->payload != NULL) {
-        if (packet->payload->owns_data && packet->payload->data != NULL) {
-            free(packet->payload->data);
-        }
-        free(packet->payload);
+        xoe_payload_release(packet->payload);
         packet->payload = NULL;
     }
 }
@@ -24,7 +24,11 @@
 #define WIRE_FORMAT_H
 
 #include "lib/common/types.h"
+#include "lib/common/mem_budget.h"
 #include "lib/protocol/protocol.h"
+#include "lib/net/transport.h"
+
+#include <sys/uio.h>
 
 /* Wire protocol version - increment on breaking changes */
 #define XOE_WIRE_VERSION 2
@@ -35,6 +39,79 @@
 /* Maximum payload size (1MB limit for safety) */
 #define XOE_WIRE_MAX_PAYLOAD (1024 * 1024)
 
+/* Maximum time a send waits for a full non-blocking socket to drain */
+#define XOE_WIRE_SEND_TIMEOUT_MS XOE_TRANSPORT_SEND_TIMEOUT_MS
+
+/* Maximum iovec entries accepted by xoe_wire_sendv*() */
+#define XOE_WIRE_SENDV_MAX_IOV XOE_TRANSPORT_MAX_IOV
+
+/* Maximum TLS record plaintext; smaller frames are sent as one record */
+#define XOE_WIRE_TLS_RECORD_SIZE XOE_TRANSPORT_TLS_RECORD_SIZE
+
+/*
+ * Per-connection feature bits, negotiated with a HELLO / HELLO_ACK
+ * exchange on XOE_PROTOCOL_WIRE_CTRL (see "Feature negotiation" below).
+ *
+ * XOE_WIRE_FEATURE_NO_CHECKSUM: frames carry checksum 0 and receivers
+ * skip CRC validation. Only granted on integrity-protected transports
+ * (TLS AEAD); plain TCP always keeps full CRC validation.
+ *
+ * XOE_WIRE_FEATURE_COMPRESS_ZLIB / _LZ4: either side may send frames
+ * compressed with that back-end, marked per frame by
+ * XOE_WIRE_VERSION_COMPRESSED (see lib/protocol/wire_compress.h). A
+ * server grants at most one of them; LZ4 exists only in builds with
+ * LZ4_ENABLED (make LZ4=1).
+ *
+ * XOE_WIRE_FEATURE_SERIAL_RESUME: serial frames carry a cumulative ACK
+ * and the client may resume its session on a new connection after a
+ * drop (see connectors/serial/serial_session.h).
+ *
+ * XOE_WIRE_FEATURE_SERIAL_LATEST: datagram transports only (see
+ * lib/protocol/wire_dgram.h). Serial frames are latest-value-wins: never
+ * retransmitted, and a frame older than one already received is dropped.
+ * Without it a datagram association delivers serial frames reliably and
+ * in order. TCP servers never grant it.
+ */
+#define XOE_WIRE_FEATURE_NO_CHECKSUM   0x00000001U
+#define XOE_WIRE_FEATURE_COMPRESS_ZLIB 0x00000002U
+#define XOE_WIRE_FEATURE_COMPRESS_LZ4  0x00000004U
+#define XOE_WIRE_FEATURE_SERIAL_RESUME 0x00000008U
+#define XOE_WIRE_FEATURE_SERIAL_LATEST 0x00000010U
+#define XOE_WIRE_FEATURES_COMPRESS     (XOE_WIRE_FEATURE_COMPRESS_ZLIB | \
+                                        XOE_WIRE_FEATURE_COMPRESS_LZ4)
+
+#ifndef LZ4_ENABLED
+#define LZ4_ENABLED 0
+#endif
+
+#if LZ4_ENABLED
+#define XOE_WIRE_FEATURES_SUPPORTED  (XOE_WIRE_FEATURE_NO_CHECKSUM | \
+                                      XOE_WIRE_FEATURE_COMPRESS_ZLIB | \
+                                      XOE_WIRE_FEATURE_COMPRESS_LZ4 | \
+                                      XOE_WIRE_FEATURE_SERIAL_RESUME)
+#else
+#define XOE_WIRE_FEATURES_SUPPORTED  (XOE_WIRE_FEATURE_NO_CHECKSUM | \
+                                      XOE_WIRE_FEATURE_COMPRESS_ZLIB | \
+                                      XOE_WIRE_FEATURE_SERIAL_RESUME)
+#endif
+
+/* protocol_version bit marking a compressed payload (wire_compress.h) */
+#define XOE_WIRE_VERSION_COMPRESSED 0x8000U
+
+/* Control message types (first 16 bits of a WIRE_CTRL payload) */
+#define XOE_WIRE_CTRL_HELLO     1   /* Client: requested features */
+#define XOE_WIRE_CTRL_HELLO_ACK 2   /* Server: accepted features */
+#define XOE_WIRE_CTRL_RAW_JOIN  3   /* Client: join a raw passthrough channel */
+#define XOE_WIRE_CTRL_RAW_READY 4   /* Server: paired, raw bytes follow */
+
+/* HELLO payload: type(2) + reserved(2) + features(4), big-endian.
+ * RAW_READY has the same layout with features 0. */
+#define XOE_WIRE_HELLO_SIZE 8
+
+/* RAW_JOIN payload: type(2) + reserved(2) + channel name (no terminator) */
+#define XOE_WIRE_RAW_JOIN_HEADER 4
+#define XOE_WIRE_RAW_NAME_MAX 64
+
 /**
  * @brief Wire format header structure (for documentation only)
  *
@@ -54,27 +131,49 @@ typedef struct {
 
 /*
  * Byte order conversion helpers (big-endian / network byte order)
+ *
+ * These and the header (de)serializers below run for every frame sent and
+ * received, so they are defined here to be inlined at each call site.
  */
 
 /**
  * @brief Write 16-bit value in big-endian format
  */
-void xoe_wire_write_uint16(uint8_t* buffer, uint16_t value);
+static inline void xoe_wire_write_uint16(uint8_t* buffer, uint16_t value)
+{
+    buffer[0] = (uint8_t)(value >> 8);
+    buffer[1] = (uint8_t)(value);
+}
 
 /**
  * @brief Write 32-bit value in big-endian format
  */
-void xoe_wire_write_uint32(uint8_t* buffer, uint32_t value);
+static inline void xoe_wire_write_uint32(uint8_t* buffer, uint32_t value)
+{
+    buffer[0] = (uint8_t)(value >> 24);
+    buffer[1] = (uint8_t)(value >> 16);
+    buffer[2] = (uint8_t)(value >> 8);
+    buffer[3] = (uint8_t)(value);
+}
 
 /**
  * @brief Read 16-bit value from big-endian format
  */
-uint16_t xoe_wire_read_uint16(const uint8_t* buffer);
+static inline uint16_t xoe_wire_read_uint16(const uint8_t* buffer)
+{
+    return (uint16_t)(((uint16_t)buffer[0] << 8) | buffer[1]);
+}
 
 /**
  * @brief Read 32-bit value from big-endian format
  */
-uint32_t xoe_wire_read_uint32(const uint8_t* buffer);
+static inline uint32_t xoe_wire_read_uint32(const uint8_t* buffer)
+{
+    return ((uint32_t)buffer[0] << 24) |
+           ((uint32_t)buffer[1] << 16) |
+           ((uint32_t)buffer[2] << 8) |
+           buffer[3];
+}
 
 /*
  * Header serialization
@@ -86,7 +185,14 @@ uint32_t xoe_wire_read_uint32(const uint8_t* buffer);
  * @param buffer    Output buffer (must be at least XOE_WIRE_HEADER_SIZE bytes)
  * @param header    Header structure to serialize
  */
-void xoe_wire_serialize_header(uint8_t* buffer, const xoe_wire_header_t* header);
+static inline void xoe_wire_serialize_header(uint8_t* buffer,
+                                             const xoe_wire_header_t* header)
+{
+    xoe_wire_write_uint16(buffer + 0, header->protocol_id);
+    xoe_wire_write_uint16(buffer + 2, header->protocol_version);
+    xoe_wire_write_uint32(buffer + 4, header->payload_length);
+    xoe_wire_write_uint32(buffer + 8, header->checksum);
+}
 
 /**
  * @brief Deserialize wire header from byte buffer
@@ -94,17 +200,94 @@ void xoe_wire_serialize_header(uint8_t* buffer, const xoe_wire_header_t* header)
  * @param header    Output header structure
  * @param buffer    Input buffer (must be at least XOE_WIRE_HEADER_SIZE bytes)
  */
-void xoe_wire_deserialize_header(xoe_wire_header_t* header, const uint8_t* buffer);
+static inline void xoe_wire_deserialize_header(xoe_wire_header_t* header,
+                                               const uint8_t* buffer)
+{
+    header->protocol_id = xoe_wire_read_uint16(buffer + 0);
+    header->protocol_version = xoe_wire_read_uint16(buffer + 2);
+    header->payload_length = xoe_wire_read_uint32(buffer + 4);
+    header->checksum = xoe_wire_read_uint32(buffer + 8);
+}
+
+/**
+ * @brief Calculate packet checksum over header fields and payload
+ *
+ * Covers protocol_id, protocol_version, payload_length and the payload
+ * bytes; the checksum field itself is not included.
+ *
+ * @param header        Header with payload_length set
+ * @param payload_data  Payload bytes (may be NULL when payload_length is 0)
+ *
+ * @return CRC32 checksum value
+ */
+uint32_t xoe_wire_packet_checksum(const xoe_wire_header_t* header,
+                                  const void* payload_data);
 
 /*
  * Network I/O functions
+ *
+ * Every frame goes through a transport (lib/net/transport.h) bound once
+ * per connection, whatever carries it: TCP, TLS, kernel TLS, a
+ * shared-memory link or UDP. The descriptor and SSL* variants below bind
+ * one for the duration of the call, for callers that do not keep one.
+ */
+
+/**
+ * @brief Send an XOE packet over a transport
+ *
+ * Header and payload go to the transport in one write, so small frames
+ * leave as one TCP segment, TLS record or datagram.
+ *
+ * @param t         Bound transport
+ * @param packet    Packet to send
+ * @param features  Features negotiated for this connection (with
+ *                  XOE_WIRE_FEATURE_NO_CHECKSUM the checksum is sent as 0)
+ *
+ * @return 0 on success, negative error code on failure
+ *         E_INVALID_ARGUMENT if t or packet is NULL
+ *         E_IO_ERROR on send failure
  */
+int xoe_wire_send_transport(xoe_transport_t* t, const xoe_packet_t* packet,
+                            uint32_t features);
+
+/**
+ * @brief Receive an XOE packet from a transport
+ *
+ * Blocking counterpart of the incremental decoder: reads until a whole
+ * frame has arrived.
+ *
+ * @param t         Bound transport
+ * @param packet    Output packet (payload from the payload pool)
+ * @param features  Features negotiated for this connection (with
+ *                  XOE_WIRE_FEATURE_NO_CHECKSUM the CRC is not checked)
+ *
+ * @return 0 on success, negative error code on failure (as xoe_wire_recv())
+ */
+int xoe_wire_recv_transport(xoe_transport_t* t, xoe_packet_t* packet,
+                            uint32_t features);
+
+/**
+ * @brief Send pre-serialized data from several buffers over a transport
+ *
+ * @param t         Bound transport
+ * @param iov       Segments to send, in order
+ * @param iovcnt    Number of segments (1..XOE_WIRE_SENDV_MAX_IOV)
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT on bad iov/iovcnt, E_IO_ERROR
+ */
+int xoe_wire_sendv_transport(xoe_transport_t* t, const struct iovec* iov,
+                             int iovcnt);
 
 /**
  * @brief Send an XOE packet over a socket
  *
- * Serializes the packet to wire format and sends header + payload.
- * Calculates checksum over the entire packet.
+ * Serializes the packet to wire format and sends header + payload with a
+ * single sendmsg() call, so small frames leave as one TCP segment.
+ * Calculates checksum over the entire packet. Works on non-blocking
+ * sockets: a full send buffer is waited on for up to
+ * XOE_WIRE_SEND_TIMEOUT_MS. A descriptor carrying a shared-memory link
+ * (lib/net/shm_link.h) is written through the link's ring instead, here
+ * and in every other plain-socket call of this file.
  *
  * @param fd        Socket file descriptor
  * @param packet    Packet to send (internal representation)
@@ -115,6 +298,41 @@ void xoe_wire_deserialize_header(xoe_wire_header_t* header, const uint8_t* buffe
  */
 int xoe_wire_send(int fd, const xoe_packet_t* packet);
 
+/**
+ * @brief Relay a received XOE packet over a socket unchanged
+ *
+ * Sends a packet obtained from xoe_wire_recv() (or a TLS receive) as-is,
+ * reusing its already verified checksum instead of recomputing the CRC.
+ * The payload must not have been modified since it was received. A zero
+ * checksum (frame received with XOE_WIRE_FEATURE_NO_CHECKSUM) is
+ * recomputed, since the receiving link may still validate it.
+ *
+ * @param fd        Socket file descriptor
+ * @param packet    Received packet to relay
+ *
+ * @return 0 on success, negative error code on failure
+ *         E_INVALID_ARGUMENT if packet is NULL
+ *         E_IO_ERROR on send failure
+ */
+int xoe_wire_forward(int fd, const xoe_packet_t* packet);
+
+/**
+ * @brief Serialize the wire header for a packet about to be sent
+ *
+ * For callers that queue frames and write them later (e.g. with
+ * xoe_wire_sendv()). The header is ready to be followed by the payload.
+ *
+ * @param packet        Packet to frame
+ * @param header_buffer Output buffer (XOE_WIRE_HEADER_SIZE bytes)
+ * @param relay         TRUE to reuse a non-zero received checksum as
+ *                      xoe_wire_forward() does, FALSE to compute the CRC
+ *
+ * @return Payload length announced in the header
+ */
+uint32_t xoe_wire_build_header(const xoe_packet_t* packet,
+                               uint8_t* header_buffer,
+                               int relay);
+
 /**
  * @brief Receive an XOE packet from a socket
  *
@@ -131,14 +349,17 @@ int xoe_wire_send(int fd, const xoe_packet_t* packet);
  *         E_OUT_OF_MEMORY if payload allocation fails
  *         E_PROTOCOL_ERROR if payload_length exceeds maximum
  *
- * @note Caller is responsible for freeing packet->payload and packet->payload->data
+ * @note The payload comes from the payload pool; release it with
+ *       xoe_wire_free_payload()
  */
 int xoe_wire_recv(int fd, xoe_packet_t* packet);
 
 /**
  * @brief Send an XOE packet over a TLS connection
  *
- * TLS-enabled version of xoe_wire_send().
+ * TLS-enabled version of xoe_wire_send(). Header and payload are
+ * coalesced, so frames up to XOE_WIRE_TLS_RECORD_SIZE bytes produce a
+ * single TLS record.
  *
  * @param ssl       OpenSSL SSL pointer (cast to void* for header compatibility)
  * @param packet    Packet to send
@@ -159,10 +380,424 @@ int xoe_wire_send_tls(void* ssl, const xoe_packet_t* packet);
  */
 int xoe_wire_recv_tls(void* ssl, xoe_packet_t* packet);
 
+/**
+ * @brief Send over TLS honoring negotiated connection features
+ *
+ * Like xoe_wire_send_tls(); with XOE_WIRE_FEATURE_NO_CHECKSUM the CRC is
+ * skipped and the checksum field is sent as 0.
+ *
+ * @param ssl       OpenSSL SSL pointer
+ * @param packet    Packet to send
+ * @param features  Features negotiated for this connection
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int xoe_wire_send_tls_ex(void* ssl, const xoe_packet_t* packet,
+                         uint32_t features);
+
+/**
+ * @brief Receive over TLS honoring negotiated connection features
+ *
+ * Like xoe_wire_recv_tls(); with XOE_WIRE_FEATURE_NO_CHECKSUM the CRC is
+ * not validated.
+ *
+ * @param ssl       OpenSSL SSL pointer
+ * @param packet    Output packet
+ * @param features  Features negotiated for this connection
+ *
+ * @return 0 on success, negative error code on failure
+ */
+int xoe_wire_recv_tls_ex(void* ssl, xoe_packet_t* packet, uint32_t features);
+
+/*
+ * Feature negotiation
+ *
+ * After the TLS handshake a client may send a HELLO frame listing the
+ * features it wants; the server answers with a HELLO_ACK carrying the
+ * subset it grants. Each side applies the result from then on: frames
+ * still checksummed while the ACK is in flight remain valid. Peers that
+ * never negotiate keep every feature off.
+ */
+
+/**
+ * @brief Decide which requested features a server grants
+ *
+ * @param requested                 Features from the client HELLO
+ * @param transport_authenticated   TRUE if the transport protects
+ *                                  integrity (TLS)
+ *
+ * @return Granted feature bits
+ */
+uint32_t xoe_wire_features_accept(uint32_t requested,
+                                  int transport_authenticated);
+
+/**
+ * @brief Build a HELLO / HELLO_ACK packet in caller-provided storage
+ *
+ * The packet references @p payload and @p buffer (owns_data FALSE) and
+ * must not be passed to xoe_wire_free_payload().
+ *
+ * @param packet    Output packet
+ * @param payload   Payload descriptor storage
+ * @param buffer    XOE_WIRE_HELLO_SIZE bytes of payload storage
+ * @param type      XOE_WIRE_CTRL_HELLO, XOE_WIRE_CTRL_HELLO_ACK or
+ *                  XOE_WIRE_CTRL_RAW_READY (features 0)
+ * @param features  Feature bits
+ */
+void xoe_wire_hello_init(xoe_packet_t* packet, xoe_payload_t* payload,
+                         uint8_t* buffer, uint16_t type, uint32_t features);
+
+/**
+ * @brief Parse a HELLO / HELLO_ACK packet
+ *
+ * @param packet    Received WIRE_CTRL packet
+ * @param type      Output: control message type
+ * @param features  Output: feature bits
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, or E_PROTOCOL_ERROR if the
+ *         packet is not a well-formed HELLO / HELLO_ACK
+ */
+int xoe_wire_hello_parse(const xoe_packet_t* packet, uint16_t* type,
+                         uint32_t* features);
+
+/**
+ * @brief Client side: negotiate features over a bound transport
+ *
+ * Blocking HELLO / HELLO_ACK round trip; call right after connecting (or
+ * the TLS handshake), before other traffic. Servers without negotiation
+ * support leave @p accepted at 0.
+ *
+ * @param t         Bound transport
+ * @param requested Features to request
+ * @param accepted  Output: features granted by the server
+ *
+ * @return 0 on success, negative error code on I/O failure
+ */
+int xoe_wire_negotiate_transport(xoe_transport_t* t, uint32_t requested,
+                                 uint32_t* accepted);
+
+/**
+ * @brief Client side: negotiate features over a connected plain socket
+ *
+ * Blocking HELLO / HELLO_ACK round trip, like xoe_wire_negotiate_tls();
+ * call right after connecting, before other traffic.
+ *
+ * @param fd        Connected socket
+ * @param requested Features to request
+ * @param accepted  Output: features granted by the server
+ *
+ * @return 0 on success, negative error code on I/O failure
+ */
+int xoe_wire_negotiate(int fd, uint32_t requested, uint32_t* accepted);
+
+/**
+ * @brief Client side: negotiate features over an established TLS session
+ *
+ * Blocking HELLO / HELLO_ACK round trip; call right after the handshake,
+ * before other traffic. Servers without negotiation support leave
+ * @p accepted at 0.
+ *
+ * @param ssl       OpenSSL SSL pointer
+ * @param requested Features to request
+ * @param accepted  Output: features granted by the server
+ *
+ * @return 0 on success, negative error code on I/O failure
+ */
+int xoe_wire_negotiate_tls(void* ssl, uint32_t requested, uint32_t* accepted);
+
+/*
+ * Raw passthrough
+ *
+ * A client on plain TCP may turn its connection into one end of a raw
+ * byte pipe: it sends a RAW_JOIN naming a channel and waits. Once a
+ * second connection joins the same name the server answers both with
+ * RAW_READY, and from then on each one's bytes reach the other unframed
+ * and untouched (the server relays them with splice(), see
+ * core/raw_relay.h). Nothing may be sent between RAW_JOIN and RAW_READY.
+ */
+
+/**
+ * @brief Build a RAW_JOIN packet in caller-provided storage
+ *
+ * The packet references @p payload and @p buffer (owns_data FALSE) and
+ * must not be passed to xoe_wire_free_payload().
+ *
+ * @param packet    Output packet
+ * @param payload   Payload descriptor storage
+ * @param buffer    XOE_WIRE_RAW_JOIN_HEADER + XOE_WIRE_RAW_NAME_MAX bytes
+ * @param name      Channel name, 1 to XOE_WIRE_RAW_NAME_MAX printable
+ *                  characters
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT for a missing or invalid name
+ */
+int xoe_wire_raw_join_init(xoe_packet_t* packet, xoe_payload_t* payload,
+                           uint8_t* buffer, const char* name);
+
+/**
+ * @brief Parse a RAW_JOIN packet
+ *
+ * @param packet    Received WIRE_CTRL packet
+ * @param name      Output: XOE_WIRE_RAW_NAME_MAX + 1 bytes, receives the
+ *                  NUL-terminated channel name
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT, or E_PROTOCOL_ERROR if the
+ *         packet is not a well-formed RAW_JOIN
+ */
+int xoe_wire_raw_join_parse(const xoe_packet_t* packet, char* name);
+
+/**
+ * @brief Client side: join a raw passthrough channel on a plain socket
+ *
+ * Sends RAW_JOIN and blocks until the server answers RAW_READY, i.e.
+ * until a peer has joined the same channel. Call right after connecting,
+ * instead of any other traffic; afterwards the socket carries raw bytes.
+ *
+ * @param fd        Connected blocking socket
+ * @param name      Channel name
+ *
+ * @return 0 once paired, E_INVALID_ARGUMENT, E_PROTOCOL_ERROR if the
+ *         server answered something else, or the receive error (the
+ *         server closes the connection when no peer joins in time)
+ */
+int xoe_wire_raw_join(int fd, const char* name);
+
+/**
+ * @brief Send pre-serialized data from several buffers in one call
+ *
+ * Gathers all segments into a single sendmsg() (retried on partial
+ * writes), e.g. a serialized header plus a payload that lives elsewhere.
+ * Same non-blocking behavior as xoe_wire_send().
+ *
+ * @param fd        Socket file descriptor
+ * @param iov       Segments to send, in order
+ * @param iovcnt    Number of segments (1..XOE_WIRE_SENDV_MAX_IOV)
+ *
+ * @return 0 on success, negative error code on failure
+ *         E_INVALID_ARGUMENT on bad iov/iovcnt
+ *         E_IO_ERROR on send failure
+ */
+int xoe_wire_sendv(int fd, const struct iovec* iov, int iovcnt);
+
+/**
+ * @brief Send several buffers over TLS as few records as possible
+ *
+ * TLS-enabled version of xoe_wire_sendv(). Segments are coalesced into
+ * full records instead of one SSL_write() per segment. When the session
+ * runs in kernel TLS (see tls_session_ktls_status()) they go to the
+ * socket with a single sendmsg(), as in xoe_wire_sendv().
+ *
+ * @param ssl       OpenSSL SSL pointer
+ * @param iov       Segments to send, in order
+ * @param iovcnt    Number of segments (1..XOE_WIRE_SENDV_MAX_IOV)
+ *
+ * @return 0 on success, negative error code on failure
+ *         E_NOT_SUPPORTED if built without TLS
+ */
+int xoe_wire_sendv_tls(void* ssl, const struct iovec* iov, int iovcnt);
+
+/*
+ * Incremental frame decoder
+ *
+ * Resumable parser for non-blocking I/O: bytes go in as they arrive and
+ * complete packets come out, with partial header/payload state kept in
+ * the decoder between calls. Bytes can either be pushed by the caller
+ * (xoe_wire_decoder_feed) or pulled from a transport into the decoder's
+ * staging buffer (xoe_wire_decoder_recv_transport) and then drained with
+ * xoe_wire_decoder_next, which yields every frame a single read
+ * delivered.
+ *
+ * Decoders are not thread-safe; each should be owned by one thread.
+ */
+
+/* Default staging buffer size for xoe_wire_decoder_init() */
+#define XOE_WIRE_DECODER_DEFAULT_BUFFER 4096
+
+/* Reads not reaching a quarter of a grown staging buffer before it is
+ * halved again (xoe_wire_decoder_set_max_buffer()) */
+#define XOE_WIRE_DECODER_SHRINK_READS 64
+
+/**
+ * @brief Incremental decoder state (treat as opaque)
+ */
+typedef struct {
+    uint8_t* buffer;            /* Staging buffer for pulled bytes */
+    uint32_t buffer_size;       /* Staging buffer capacity */
+    uint32_t buffer_start;      /* First unparsed staged byte */
+    uint32_t buffer_end;        /* One past last staged byte */
+    uint32_t buffer_initial;    /* Size at init; grown buffers return to it */
+    uint32_t buffer_max;        /* Growth limit (buffer_initial = fixed) */
+    uint32_t short_reads;       /* Consecutive reads well short of the size */
+    uint8_t header_buf[XOE_WIRE_HEADER_SIZE]; /* Partial header */
+    uint32_t header_got;        /* Header bytes collected */
+    xoe_wire_header_t header;   /* Decoded header of current frame */
+    xoe_payload_t* payload;     /* Payload being assembled (pooled) */
+    uint32_t payload_got;       /* Payload bytes collected */
+    uint32_t features;          /* Negotiated XOE_WIRE_FEATURE_* bits */
+    int trace_fd;               /* Socket frames are traced under, or -1 */
+    mem_account_t* account;     /* Charged for buffers, or NULL */
+} xoe_wire_decoder_t;
+
+/**
+ * @brief Initialize a decoder
+ *
+ * @param decoder       Decoder to initialize
+ * @param buffer_size   Staging buffer size for recv/next (0 = default,
+ *                      XOE_WIRE_DECODER_DEFAULT_BUFFER)
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT or E_OUT_OF_MEMORY
+ */
+int xoe_wire_decoder_init(xoe_wire_decoder_t* decoder, uint32_t buffer_size);
+
+/**
+ * @brief Release decoder buffers, including any partial frame
+ */
+void xoe_wire_decoder_cleanup(xoe_wire_decoder_t* decoder);
+
+/**
+ * @brief Let the staging buffer adapt to the traffic, up to a limit
+ *
+ * A read that fills all the free staging space means the socket holds
+ * more: the buffer doubles (while the memory budget has room), so the
+ * next read takes more frames in one call. After
+ * XOE_WIRE_DECODER_SHRINK_READS reads below a quarter of it, a grown
+ * buffer is halved again, back down to its initial size. Payloads of at
+ * least the initial size still bypass the staging buffer.
+ *
+ * @param decoder   Decoder
+ * @param max_size  Largest staging buffer (at most the initial size
+ *                  keeps the buffer fixed, the default)
+ */
+void xoe_wire_decoder_set_max_buffer(xoe_wire_decoder_t* decoder,
+                                     uint32_t max_size);
+
+/**
+ * @brief Apply negotiated connection features to subsequent frames
+ *
+ * With XOE_WIRE_FEATURE_NO_CHECKSUM, completed frames are not CRC
+ * validated. Only set this for integrity-protected transports.
+ */
+void xoe_wire_decoder_set_features(xoe_wire_decoder_t* decoder,
+                                   uint32_t features);
+
+/**
+ * @brief Charge this decoder's memory to a connection and obey the budget
+ *
+ * The staging buffer and the payload of the frame being assembled are
+ * tracked in @p account (mem_budget.h). From then on a frame whose
+ * payload the memory budget cannot take yet is held back after its
+ * header: feed/next return E_WOULD_BLOCK and the caller retries once
+ * memory is freed. A payload larger than the whole limit is refused with
+ * E_OUT_OF_MEMORY. Decoders without an account never wait.
+ *
+ * @param decoder   Decoder
+ * @param account   Account to charge (NULL detaches)
+ */
+void xoe_wire_decoder_set_account(xoe_wire_decoder_t* decoder,
+                                  mem_account_t* account);
+
+/**
+ * @brief Check that no partial frame is staged or being assembled
+ *
+ * An idle decoder holds no bytes of the stream, so the connection can
+ * continue in another decoder (or another process) without losing data.
+ *
+ * @return TRUE if idle (or decoder is NULL), FALSE otherwise
+ */
+int xoe_wire_decoder_idle(const xoe_wire_decoder_t* decoder);
+
+/**
+ * @brief Push caller-owned bytes into the decoder
+ *
+ * Consumes bytes up to the end of at most one frame. Call repeatedly,
+ * advancing by *consumed, until all input is consumed.
+ *
+ * @param decoder   Decoder
+ * @param data      Input bytes
+ * @param len       Number of input bytes
+ * @param consumed  Output: bytes consumed from data
+ * @param packet    Output: completed packet when 1 is returned
+ *                  (free with xoe_wire_free_payload)
+ *
+ * @return 1 if a packet was completed, 0 if more input is needed,
+ *         E_WOULD_BLOCK if the frame waits for memory (decoders with an
+ *         account only; nothing after the header is consumed), or a
+ *         negative error code (E_PROTOCOL_ERROR, E_CHECKSUM_MISMATCH,
+ *         E_OUT_OF_MEMORY) on a malformed stream. After an error the
+ *         stream is desynchronized and the connection should be dropped.
+ */
+int xoe_wire_decoder_feed(xoe_wire_decoder_t* decoder, const void* data,
+                          uint32_t len, uint32_t* consumed,
+                          xoe_packet_t* packet);
+
+/**
+ * @brief Read once from a transport into the decoder
+ *
+ * Performs a single transport read. Reads straight into the payload
+ * buffer when a large payload is being assembled and nothing is staged.
+ * Callers must keep draining while xoe_transport_pending() reports
+ * bytes held in user space (TLS records, a shared-memory ring). Resizes
+ * the staging buffer if xoe_wire_decoder_set_max_buffer() allows.
+ *
+ * @return bytes read (> 0), 0 on orderly shutdown, E_WOULD_BLOCK if
+ *         nothing has arrived, E_IO_ERROR on failure
+ */
+int xoe_wire_decoder_recv_transport(xoe_wire_decoder_t* decoder,
+                                    xoe_transport_t* t);
+
+/**
+ * @brief Read once from a socket into the decoder
+ *
+ * Performs a single recv(). Reads straight into the payload buffer when a
+ * large payload is being assembled and nothing is staged. On a
+ * shared-memory link (lib/net/shm_link.h) it reads the link's ring.
+ *
+ * @return bytes read (> 0), 0 on orderly shutdown, E_WOULD_BLOCK if the
+ *         socket has no data, E_IO_ERROR on failure
+ */
+int xoe_wire_decoder_recv(xoe_wire_decoder_t* decoder, int fd);
+
+/**
+ * @brief Whether a descriptor holds received bytes poll() does not see
+ *
+ * The SSL_pending() of shared-memory links: bytes a read left in the
+ * link's ring. A link must not go back to poll() before this returned
+ * FALSE, which also arms its wakeup. Always FALSE for sockets.
+ *
+ * @param fd    Descriptor passed to xoe_wire_decoder_recv()
+ *
+ * @return TRUE if another read would return data at once
+ */
+int xoe_wire_pending(int fd);
+
+/**
+ * @brief Read once from a TLS connection into the decoder
+ *
+ * TLS version of xoe_wire_decoder_recv(). Callers must keep draining
+ * while SSL_pending() reports buffered records.
+ *
+ * @param ssl   OpenSSL SSL pointer
+ *
+ * @return bytes read (> 0), 0 on close_notify, E_WOULD_BLOCK on
+ *         WANT_READ/WANT_WRITE, E_IO_ERROR on failure
+ */
+int xoe_wire_decoder_recv_tls(xoe_wire_decoder_t* decoder, void* ssl);
+
+/**
+ * @brief Take the next complete packet from staged bytes
+ *
+ * @param decoder   Decoder
+ * @param packet    Output packet when 1 is returned
+ *
+ * @return 1 if a packet was produced, 0 if more bytes are needed,
+ *         negative error code as for xoe_wire_decoder_feed()
+ */
+int xoe_wire_decoder_next(xoe_wire_decoder_t* decoder, xoe_packet_t* packet);
+
 /**
  * @brief Calculate CRC32 checksum of data
  *
- * Uses zlib crc32() for reliability.
+ * zlib-compatible CRC32, hardware accelerated where available
+ * (see lib/protocol/crc32.h).
  *
  * @param data      Data to checksum
  * @param len       Length of data in bytes
@@ -174,6 +809,9 @@ uint32_t xoe_wire_checksum(const void* data, uint32_t len);
 /**
  * @brief Free packet payload allocated by xoe_wire_recv()
  *
+ * Honors every owns_data mode (pooled, malloc'd, borrowed), so it is safe
+ * for any packet payload.
+ *
  * @param packet    Packet whose payload should be freed
  */
 void xoe_wire_free_payload(xoe_packet_t* packet);
@@ -0,0 +1,189 @@
+/**
+ * @file wire_l2.c
+ * @brief XOE wire frames directly in Ethernet frames
+ *
+ * [LLM-ARCH]
+ */
+
+#include "lib/protocol/wire_l2.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+#include "lib/common/metrics.h"
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+int xoe_wire_l2_encode(uint8_t* buffer, uint32_t size, uint32_t association,
+                       uint16_t flags, uint32_t features,
+                       const xoe_packet_t* packet)
+{
+    int len;
+
+    if (buffer == NULL || packet == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (size < XOE_WIRE_L2_HEADER_SIZE) {
+        return E_BUFFER_TOO_SMALL;
+    }
+
+    len = xoe_wire_dgram_encode(packet, features,
+                                buffer + XOE_WIRE_L2_HEADER_SIZE,
+                                size - XOE_WIRE_L2_HEADER_SIZE);
+    if (len < 0) {
+        return len;
+    }
+
+    buffer[0] = (uint8_t)(len >> 8);
+    buffer[1] = (uint8_t)len;
+    buffer[2] = (uint8_t)(flags >> 8);
+    buffer[3] = (uint8_t)flags;
+    buffer[4] = (uint8_t)(association >> 24);
+    buffer[5] = (uint8_t)(association >> 16);
+    buffer[6] = (uint8_t)(association >> 8);
+    buffer[7] = (uint8_t)association;
+    return XOE_WIRE_L2_HEADER_SIZE + len;
+}
+
+int xoe_wire_l2_parse(const uint8_t* data, uint32_t len, uint32_t* association,
+                      uint16_t* flags, const uint8_t** frame,
+                      uint32_t* frame_len)
+{
+    uint32_t length;
+
+    if (data == NULL || len < XOE_WIRE_L2_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    length = ((uint32_t)data[0] << 8) | data[1];
+    if (length > len - XOE_WIRE_L2_HEADER_SIZE) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    *flags = (uint16_t)(((uint32_t)data[2] << 8) | data[3]);
+    *association = ((uint32_t)data[4] << 24) | ((uint32_t)data[5] << 16) |
+                   ((uint32_t)data[6] << 8) | data[7];
+    *frame = data + XOE_WIRE_L2_HEADER_SIZE;
+    *frame_len = length;
+    return 0;
+}
+
+int xoe_wire_l2_send(l2_ring_t* ring, const uint8_t* dst, uint32_t association,
+                     uint16_t flags, uint32_t features,
+                     const xoe_packet_t* packet)
+{
+    uint32_t capacity;
+    uint8_t* payload;
+    int len;
+
+    payload = l2_ring_tx_begin(ring, dst, &capacity);
+    if (payload == NULL) {
+        return 0;   /* Ring full: lost */
+    }
+
+    /* An uncommitted slot is simply begun again by the next send */
+    len = xoe_wire_l2_encode(payload, capacity, association, flags, features,
+                             packet);
+    if (len < 0) {
+        return len;
+    }
+
+    metrics_add(METRIC_NET_TX_FRAMES, 1);
+    metrics_add(METRIC_NET_TX_BYTES, (uint64_t)len);
+    return l2_ring_tx_commit(ring, (uint32_t)len);
+}
+
+/**
+ * @brief Take a HELLO_ACK for @p association from the ring, if one came
+ *
+ * @return TRUE once found (server_mac and accepted are set)
+ */
+static int l2_hello_ack(l2_ring_t* ring, uint8_t* server_mac,
+                        uint32_t association, uint32_t* accepted)
+{
+    l2_ring_frame_t frame;
+    xoe_packet_t packet;
+    const uint8_t* wire;
+    uint32_t wire_len;
+    uint32_t id;
+    uint32_t features;
+    uint16_t flags;
+    uint16_t type;
+    int found = FALSE;
+
+    while (!found && l2_ring_recv(ring, &frame)) {
+        if (xoe_wire_l2_parse(frame.data, frame.len, &id, &flags, &wire,
+                              &wire_len) != 0 ||
+            id != association || !(flags & XOE_WIRE_L2_FROM_SERVER) ||
+            xoe_wire_dgram_decode(wire, wire_len, 0, &packet) != 0) {
+            continue;
+        }
+        if (xoe_wire_hello_parse(&packet, &type, &features) == 0 &&
+            type == XOE_WIRE_CTRL_HELLO_ACK) {
+            memcpy(server_mac, frame.src, L2_RING_MAC_LEN);
+            *accepted = features;
+            found = TRUE;
+        }
+        xoe_wire_free_payload(&packet);
+    }
+    return found;
+}
+
+int xoe_wire_l2_negotiate(l2_ring_t* ring, uint8_t* server_mac,
+                          uint32_t association, uint32_t requested,
+                          uint32_t* accepted, int timeout_ms)
+{
+    uint8_t hello[XOE_WIRE_HELLO_SIZE];
+    xoe_payload_t hello_payload;
+    xoe_packet_t hello_packet;
+    struct pollfd pfd;
+    uint64_t deadline;
+    uint64_t resend_at = 0;
+    uint64_t now;
+    uint32_t features;
+    int result;
+
+    if (ring == NULL || server_mac == NULL || accepted == NULL ||
+        timeout_ms <= 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    *accepted = 0;
+    xoe_wire_hello_init(&hello_packet, &hello_payload, hello,
+                        XOE_WIRE_CTRL_HELLO, requested);
+    deadline = latency_now_ns() / 1000000 + (uint64_t)timeout_ms;
+
+    for (;;) {
+        if (l2_hello_ack(ring, server_mac, association, &features)) {
+            *accepted = features & requested;
+            return 0;
+        }
+
+        now = latency_now_ns() / 1000000;
+        if (now >= deadline) {
+            return E_TIMEOUT;
+        }
+        if (now >= resend_at) {
+            result = xoe_wire_l2_send(ring, server_mac, association, 0, 0,
+                                      &hello_packet);
+            if (result == 0) {
+                result = l2_ring_flush(ring);
+            }
+            if (result != 0) {
+                return result;
+            }
+            resend_at = now + XOE_WIRE_DGRAM_HELLO_RETRY_MS;
+        }
+
+        pfd.fd = l2_ring_fd(ring);
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (int)(((resend_at < deadline) ? resend_at
+                                                       : deadline) - now)) < 0 &&
+            errno != EINTR) {
+            return E_IO_ERROR;
+        }
+    }
+}
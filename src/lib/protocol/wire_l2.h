@@ -0,0 +1,120 @@
+/**
+ * @file wire_l2.h
+ * @brief XOE wire frames directly in Ethernet frames
+ *
+ * Same-segment deployments can skip IP and UDP: each Ethernet frame of
+ * EtherType XOE_WIRE_L2_ETHERTYPE carries one wire frame, exactly as a
+ * datagram does (see wire_dgram.h), behind an 8-byte header:
+ *
+ *   0  length       uint16  Wire frame length (Ethernet pads short frames)
+ *   2  flags        uint16  XOE_WIRE_L2_FROM_SERVER on server frames
+ *   4  association  uint32  Chosen by the client, one per channel
+ *
+ * all big-endian. A client may run several associations from one MAC
+ * address; the server tells them apart by (MAC, association). The flag
+ * keeps a host that is both client and server, or any host on the
+ * loopback device, from taking its own frames for the other side's.
+ *
+ * Associations open with the HELLO / HELLO_ACK exchange of datagram
+ * links. A client that does not know the server's MAC sends its HELLO to
+ * the broadcast address and learns the MAC from the HELLO_ACK. Grants
+ * are those of plain UDP: frames stay checksummed, since nothing else
+ * protects them end to end.
+ *
+ * Frames go through AF_PACKET rings (lib/net/l2_ring.h): sending queues
+ * into the ring and the owner flushes once per loop iteration, so frames
+ * for many channels leave with one system call.
+ *
+ * [LLM-ARCH]
+ */
+
+#ifndef WIRE_L2_H
+#define WIRE_L2_H
+
+#include "lib/common/types.h"
+#include "lib/net/l2_ring.h"
+#include "lib/protocol/protocol.h"
+
+/* IEEE 802 "local experimental" EtherType 1 */
+#define XOE_WIRE_L2_ETHERTYPE 0x88B5
+
+/* Header in front of the wire frame */
+#define XOE_WIRE_L2_HEADER_SIZE 8
+
+/* Header flags */
+#define XOE_WIRE_L2_FROM_SERVER 0x0001
+
+/**
+ * @brief Serialize a packet behind the layer-2 header
+ *
+ * @param buffer        Output (the frame payload)
+ * @param size          Buffer size
+ * @param association   Association ID
+ * @param flags         XOE_WIRE_L2_* flags
+ * @param features      Negotiated features (as for xoe_wire_dgram_encode())
+ * @param packet        Packet
+ *
+ * @return Payload length, E_INVALID_ARGUMENT or E_BUFFER_TOO_SMALL
+ */
+int xoe_wire_l2_encode(uint8_t* buffer, uint32_t size, uint32_t association,
+                       uint16_t flags, uint32_t features,
+                       const xoe_packet_t* packet);
+
+/**
+ * @brief Split a received frame payload into header and wire frame
+ *
+ * @param data          Frame payload (padding included)
+ * @param len           Its length
+ * @param association   Output: association ID
+ * @param flags         Output: XOE_WIRE_L2_* flags
+ * @param frame         Output: the wire frame, for xoe_wire_dgram_decode()
+ * @param frame_len     Output: its length
+ *
+ * @return 0, or E_PROTOCOL_ERROR if the payload is shorter than it says
+ */
+int xoe_wire_l2_parse(const uint8_t* data, uint32_t len, uint32_t* association,
+                      uint16_t* flags, const uint8_t** frame,
+                      uint32_t* frame_len);
+
+/**
+ * @brief Queue a packet on a ring (xoe_wire_dgram_send() for layer 2)
+ *
+ * A full send ring counts as loss and succeeds. The frame leaves on the
+ * next l2_ring_flush().
+ *
+ * @param ring          Ring
+ * @param dst           Destination MAC
+ * @param association   Association ID
+ * @param flags         XOE_WIRE_L2_* flags
+ * @param features      Negotiated features
+ * @param packet        Packet
+ *
+ * @return 0 on success (or loss), negative error code on failure
+ */
+int xoe_wire_l2_send(l2_ring_t* ring, const uint8_t* dst, uint32_t association,
+                     uint16_t flags, uint32_t features,
+                     const xoe_packet_t* packet);
+
+/**
+ * @brief Client side: open an association with the HELLO exchange
+ *
+ * Sends a HELLO every XOE_WIRE_DGRAM_HELLO_RETRY_MS until the HELLO_ACK
+ * for @p association arrives; other frames received meanwhile are
+ * dropped. Blocks the caller.
+ *
+ * @param ring          Ring
+ * @param server_mac    Server MAC; the broadcast address to discover it,
+ *                      in which case the answering server's is stored
+ * @param association   Association ID
+ * @param requested     Features to request
+ * @param accepted      Output: features granted by the server
+ * @param timeout_ms    How long to wait for the HELLO_ACK
+ *
+ * @return 0 on success, E_TIMEOUT if no server answered, negative error
+ *         code on I/O failure
+ */
+int xoe_wire_l2_negotiate(l2_ring_t* ring, uint8_t* server_mac,
+                          uint32_t association, uint32_t requested,
+                          uint32_t* accepted, int timeout_ms);
+
+#endif /* WIRE_L2_H */
@@ -0,0 +1,254 @@
+/*
+ * wire_trace.c - Per-connection frame flight recorder
+ *
+ * Each traced socket has a ring of XOE_WIRE_TRACE_DEPTH entries and a
+ * frame counter. A recorder takes the next number with one atomic add,
+ * clears the slot's seq, fills the slot, and publishes it by storing the
+ * number with release order. Readers copy a slot and keep it only if its
+ * seq is the expected number both before and after the copy, so a slot
+ * being overwritten is skipped instead of reported half-written.
+ *
+ * Author: [LLM-ARCH]
+ */
+
+#include "wire_trace.h"
+#include "wire_format.h"
+#include "lib/common/definitions.h"
+
+#include <string.h>
+#include <time.h>
+
+#define XOE_WIRE_TRACE_MASK (XOE_WIRE_TRACE_DEPTH - 1)
+
+typedef struct {
+    uint32_t next;              /* Frames recorded so far */
+    uint32_t conn_id;           /* Connection number, 0 until first asked */
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+} xoe_wire_trace_t;
+
+/* Untouched traces stay in zero pages; only used descriptors cost memory */
+static xoe_wire_trace_t traces[XOE_WIRE_TRACE_MAX_FDS];
+
+/* Second of the last dump (rate limits xoe_wire_trace_dump) */
+static uint64_t last_dump_second;
+
+/* Last connection number handed out */
+static uint32_t last_conn_id;
+
+static const char* const status_names[] = {
+    "ok", "unchecked", "BAD-CRC", "FAILED"
+};
+
+/*
+ * Recording
+ */
+
+uint64_t xoe_wire_trace_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void xoe_wire_trace_record(int fd, int direction, uint16_t protocol_id,
+                           uint32_t length, int status)
+{
+    xoe_wire_trace_t* trace;
+    xoe_wire_trace_entry_t* entry;
+    uint32_t seq;
+
+    if (fd < 0 || fd >= XOE_WIRE_TRACE_MAX_FDS) {
+        return;
+    }
+    trace = &traces[fd];
+
+    seq = __atomic_add_fetch(&trace->next, 1, __ATOMIC_RELAXED);
+    entry = &trace->entries[(seq - 1) & XOE_WIRE_TRACE_MASK];
+
+    /* Unpublish, fill, republish (readers check seq around their copy) */
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry->timestamp_ns = xoe_wire_trace_now_ns();
+    entry->length = length;
+    entry->protocol_id = protocol_id;
+    entry->direction = (uint8_t)direction;
+    entry->status = (uint8_t)status;
+    __atomic_store_n(&entry->seq, seq, __ATOMIC_RELEASE);
+}
+
+void xoe_wire_trace_record_header(int fd, int direction,
+                                  const uint8_t* header_buffer, int status)
+{
+    if (header_buffer == NULL) {
+        return;
+    }
+    xoe_wire_trace_record(fd, direction,
+                          xoe_wire_read_uint16(header_buffer + 0),
+                          xoe_wire_read_uint32(header_buffer + 4),
+                          status);
+}
+
+void xoe_wire_trace_reset(int fd)
+{
+    xoe_wire_trace_t* trace;
+    int i;
+
+    if (fd < 0 || fd >= XOE_WIRE_TRACE_MAX_FDS) {
+        return;
+    }
+    trace = &traces[fd];
+
+    __atomic_store_n(&trace->next, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&trace->conn_id, 0, __ATOMIC_RELAXED);
+    for (i = 0; i < XOE_WIRE_TRACE_DEPTH; i++) {
+        __atomic_store_n(&trace->entries[i].seq, 0, __ATOMIC_RELEASE);
+    }
+}
+
+uint32_t xoe_wire_trace_conn_id(int fd)
+{
+    uint32_t id;
+    uint32_t expected = 0;
+
+    if (fd < 0 || fd >= XOE_WIRE_TRACE_MAX_FDS) {
+        return 0;
+    }
+
+    id = __atomic_load_n(&traces[fd].conn_id, __ATOMIC_RELAXED);
+    if (id != 0) {
+        return id;
+    }
+
+    /* First use since reset: the first thread to claim a number wins */
+    id = __atomic_add_fetch(&last_conn_id, 1, __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&traces[fd].conn_id, &expected, id,
+                                     FALSE, __ATOMIC_RELAXED,
+                                     __ATOMIC_RELAXED)) {
+        id = expected;
+    }
+    return id;
+}
+
+/*
+ * Reading
+ */
+
+int xoe_wire_trace_snapshot(int fd, xoe_wire_trace_entry_t* entries, int max)
+{
+    const xoe_wire_trace_t* trace;
+    const xoe_wire_trace_entry_t* entry;
+    uint32_t next;
+    uint32_t seq;
+    uint32_t first;
+    int count = 0;
+
+    if (fd < 0 || fd >= XOE_WIRE_TRACE_MAX_FDS || entries == NULL ||
+        max <= 0) {
+        return 0;
+    }
+    trace = &traces[fd];
+
+    next = __atomic_load_n(&trace->next, __ATOMIC_ACQUIRE);
+    first = (next > XOE_WIRE_TRACE_DEPTH) ? next - XOE_WIRE_TRACE_DEPTH + 1
+                                          : 1;
+
+    for (seq = first; seq <= next && count < max; seq++) {
+        entry = &trace->entries[(seq - 1) & XOE_WIRE_TRACE_MASK];
+        if (__atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue;
+        }
+        entries[count] = *entry;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+        entries[count].seq = seq;
+        count++;
+    }
+
+    return count;
+}
+
+int xoe_wire_trace_active(int* fds, int max)
+{
+    int count = 0;
+    int fd;
+
+    if (fds == NULL || max <= 0) {
+        return 0;
+    }
+
+    for (fd = 0; fd < XOE_WIRE_TRACE_MAX_FDS && count < max; fd++) {
+        if (__atomic_load_n(&traces[fd].next, __ATOMIC_RELAXED) != 0) {
+            fds[count++] = fd;
+        }
+    }
+    return count;
+}
+
+int xoe_wire_trace_format(const xoe_wire_trace_entry_t* entry,
+                          uint64_t now_ns, char* buffer, size_t size)
+{
+    uint64_t age_us;
+    int len;
+
+    if (entry == NULL || buffer == NULL || size == 0) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    age_us = (now_ns > entry->timestamp_ns)
+             ? (now_ns - entry->timestamp_ns) / 1000ULL : 0;
+
+    len = snprintf(buffer, size, "#%-8lu %s proto=0x%04x len=%-7lu %-9s -%llu us",
+                   (unsigned long)entry->seq,
+                   entry->direction == XOE_WIRE_TRACE_RX ? "rx" : "tx",
+                   (unsigned int)entry->protocol_id,
+                   (unsigned long)entry->length,
+                   entry->status <= XOE_WIRE_TRACE_FAILED
+                       ? status_names[entry->status] : "?",
+                   (unsigned long long)age_us);
+    if (len < 0 || (size_t)len >= size) {
+        return E_BUFFER_TOO_SMALL;
+    }
+    return len;
+}
+
+int xoe_wire_trace_dump(int fd, const char* reason, FILE* out)
+{
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+    char line[XOE_WIRE_TRACE_LINE_MAX];
+    uint64_t now;
+    uint64_t second;
+    uint64_t last;
+    int count;
+    int i;
+
+    if (out == NULL) {
+        return FALSE;
+    }
+
+    now = xoe_wire_trace_now_ns();
+    second = now / 1000000000ULL + 1;   /* + 1: never equal to the initial 0 */
+    last = __atomic_load_n(&last_dump_second, __ATOMIC_RELAXED);
+    if (last == second ||
+        !__atomic_compare_exchange_n(&last_dump_second, &last, second, FALSE,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return FALSE;
+    }
+
+    count = xoe_wire_trace_snapshot(fd, entries, XOE_WIRE_TRACE_DEPTH);
+    if (count == 0) {
+        return FALSE;
+    }
+
+    fprintf(out, "--- wire trace fd=%d (%s): last %d frames ---\n",
+            fd, reason != NULL ? reason : "dump", count);
+    for (i = 0; i < count; i++) {
+        if (xoe_wire_trace_format(&entries[i], now, line, sizeof(line)) > 0) {
+            fprintf(out, "  %s\n", line);
+        }
+    }
+    fflush(out);
+    return TRUE;
+}
@@ -0,0 +1,156 @@
+/*
+ * wire_trace.h - Per-connection frame flight recorder
+ *
+ * Keeps the metadata of the last XOE_WIRE_TRACE_DEPTH frames sent and
+ * received on every socket: when, which protocol, how long, the frame's
+ * number on that connection, and whether its checksum held. Recording is
+ * always on and happens inside the wire send/receive paths (plain, TLS,
+ * incremental decoder, and the USB send queue); it costs one clock read
+ * and a few stores per frame, so incidents can be examined after the
+ * fact without turning on verbose logging, which changes the timing.
+ *
+ * Traces are indexed by socket descriptor; descriptors at or above
+ * XOE_WIRE_TRACE_MAX_FDS are not traced. A trace belongs to whatever
+ * connection holds the descriptor, so servers reset it on accept.
+ *
+ * Author: [LLM-ARCH]
+ */
+
+#ifndef WIRE_TRACE_H
+#define WIRE_TRACE_H
+
+#include "lib/common/types.h"
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Frames remembered per connection (power of two) */
+#ifndef XOE_WIRE_TRACE_DEPTH
+#if XOE_SMALL_FOOTPRINT
+#define XOE_WIRE_TRACE_DEPTH 16
+#else
+#define XOE_WIRE_TRACE_DEPTH 64
+#endif
+#endif
+
+/* Highest socket descriptor traced, plus one */
+#define XOE_WIRE_TRACE_MAX_FDS 1024
+
+/* Longest line produced by xoe_wire_trace_format() */
+#define XOE_WIRE_TRACE_LINE_MAX 96
+
+/* Frame direction */
+#define XOE_WIRE_TRACE_TX 0
+#define XOE_WIRE_TRACE_RX 1
+
+/* Frame outcome */
+#define XOE_WIRE_TRACE_OK          0   /* Sent, or received with valid CRC */
+#define XOE_WIRE_TRACE_UNCHECKED   1   /* Checksum negotiated off */
+#define XOE_WIRE_TRACE_BAD_CHECKSUM 2  /* Received, CRC mismatch */
+#define XOE_WIRE_TRACE_FAILED      3   /* Send failed or header rejected */
+
+/**
+ * @brief Metadata of one traced frame
+ */
+typedef struct {
+    uint64_t timestamp_ns;      /* Monotonic clock when recorded */
+    uint32_t seq;               /* Frame number on this connection, from 1 */
+    uint32_t length;            /* Payload length announced in the header */
+    uint16_t protocol_id;       /* Header protocol_id */
+    uint8_t direction;          /* XOE_WIRE_TRACE_TX or _RX */
+    uint8_t status;             /* XOE_WIRE_TRACE_OK, ... */
+} xoe_wire_trace_entry_t;
+
+/**
+ * @brief Record a frame on a socket's trace
+ *
+ * Safe to call from several threads on the same socket. Negative and
+ * out-of-range descriptors are ignored.
+ *
+ * @param fd            Socket the frame went out on / came in from
+ * @param direction     XOE_WIRE_TRACE_TX or XOE_WIRE_TRACE_RX
+ * @param protocol_id   Header protocol_id
+ * @param length        Header payload_length
+ * @param status        XOE_WIRE_TRACE_OK, ...
+ */
+void xoe_wire_trace_record(int fd, int direction, uint16_t protocol_id,
+                           uint32_t length, int status);
+
+/**
+ * @brief Record a frame from its serialized wire header
+ */
+void xoe_wire_trace_record_header(int fd, int direction,
+                                  const uint8_t* header_buffer, int status);
+
+/**
+ * @brief Forget a socket's history (new connection on the descriptor)
+ */
+void xoe_wire_trace_reset(int fd);
+
+/**
+ * @brief Number identifying the connection on a socket
+ *
+ * Numbers are handed out from 1 on first use and kept until the next
+ * xoe_wire_trace_reset(), so they tell apart connections that reused a
+ * descriptor (wire captures group frames by them).
+ *
+ * @return Connection number, 0 for an untraced descriptor
+ */
+uint32_t xoe_wire_trace_conn_id(int fd);
+
+/**
+ * @brief Copy a socket's trace, oldest frame first
+ *
+ * Entries being overwritten while copied are skipped.
+ *
+ * @param fd        Socket
+ * @param entries   Receives up to @p max entries
+ * @param max       Capacity of @p entries
+ *
+ * @return Entries copied (0 for an untraced socket)
+ */
+int xoe_wire_trace_snapshot(int fd, xoe_wire_trace_entry_t* entries, int max);
+
+/**
+ * @brief List sockets that have recorded frames
+ *
+ * @param fds   Receives up to @p max descriptors, ascending
+ * @param max   Capacity of @p fds
+ *
+ * @return Descriptors written
+ */
+int xoe_wire_trace_active(int* fds, int max);
+
+/**
+ * @brief Format one entry as a line of text (no newline)
+ *
+ * @param entry     Entry to format
+ * @param now_ns    Reference time; the age of the entry is shown
+ * @param buffer    Output (NUL-terminated)
+ * @param size      Size of @p buffer
+ *
+ * @return Length written, E_INVALID_ARGUMENT or E_BUFFER_TOO_SMALL
+ */
+int xoe_wire_trace_format(const xoe_wire_trace_entry_t* entry,
+                          uint64_t now_ns, char* buffer, size_t size);
+
+/**
+ * @brief Write a socket's trace to a stream
+ *
+ * Used on connection errors; at most one dump per second is written
+ * so a misbehaving peer cannot flood the output.
+ *
+ * @param fd        Socket
+ * @param reason    Why the trace is dumped (shown in the heading)
+ * @param out       Stream to write to
+ *
+ * @return TRUE if the trace was written, FALSE if rate limited or empty
+ */
+int xoe_wire_trace_dump(int fd, const char* reason, FILE* out);
+
+/**
+ * @brief Monotonic clock in nanoseconds (the trace time base)
+ */
+uint64_t xoe_wire_trace_now_ns(void);
+
+#endif /* WIRE_TRACE_H */
@@ -0,0 +1,435 @@
+/*
+ * wire_zerocopy.c - MSG_ZEROCOPY sends and their completions
+ *
+ * The kernel numbers the MSG_ZEROCOPY send calls of a socket that moved
+ * data, from 0, and reports finished ones as ranges [lo, hi] on the error
+ * queue. Each enabled socket mirrors that counter (next_id) and keeps a
+ * FIFO of the payloads it sent, each with the number one past its last
+ * call. TCP reports ranges in order, so a payload is released as soon as
+ * a completion reaches its number.
+ *
+ * Per-socket state is allocated on first enable and kept for the
+ * descriptor number, like the flight recorder's; a mutex guards it since
+ * the reaping reader and a sender may be different threads. Sends on one
+ * socket are serialized by their callers, as frames would interleave
+ * otherwise. count is also read without the lock, as a cheap "anything
+ * outstanding" test.
+ *
+ * Author: [LLM-ARCH]
+ */
+
+#include "wire_zerocopy.h"
+#include "payload_pool.h"
+#include "wire_format.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+#include "lib/common/stage_prof.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#define WIRE_ZEROCOPY_SUPPORTED 1
+#else
+#define WIRE_ZEROCOPY_SUPPORTED 0
+#endif
+
+/* Completions read per recvmsg() control buffer */
+#define ZEROCOPY_CONTROL_SIZE 128
+
+typedef struct {
+    xoe_payload_t* payload;     /* Reference held until the kernel is done */
+    uint32_t end;               /* One past the frame's last send call */
+} zerocopy_frame_t;
+
+typedef struct {
+    pthread_mutex_t lock;       /* Protects everything below */
+    int enabled;
+    uint32_t next_id;           /* Send calls made (the kernel's counter) */
+    uint32_t done;              /* One past the last completed call */
+    zerocopy_frame_t frames[XOE_WIRE_ZEROCOPY_MAX_PENDING];
+    int head;                   /* Oldest frame */
+    int count;                  /* Frames held by the kernel (atomic) */
+} zerocopy_socket_t;
+
+/* Allocated on first enable, then kept for the descriptor number */
+static zerocopy_socket_t* sockets[XOE_WIRE_ZEROCOPY_MAX_FDS];
+
+/**
+ * @brief State of an enabled socket, or NULL
+ */
+static zerocopy_socket_t* socket_of(int fd)
+{
+    zerocopy_socket_t* zc;
+
+    if (fd < 0 || fd >= XOE_WIRE_ZEROCOPY_MAX_FDS) {
+        return NULL;
+    }
+    zc = __atomic_load_n(&sockets[fd], __ATOMIC_ACQUIRE);
+    if (zc == NULL || !__atomic_load_n(&zc->enabled, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return zc;
+}
+
+/**
+ * @brief Release frames the completions have reached (lock held)
+ */
+static void release_done(zerocopy_socket_t* zc)
+{
+    zerocopy_frame_t* frame;
+
+    while (zc->count > 0) {
+        frame = &zc->frames[zc->head];
+        if ((int32_t)(zc->done - frame->end) < 0) {
+            break;
+        }
+        xoe_payload_release(frame->payload);
+        frame->payload = NULL;
+        zc->head = (zc->head + 1) % XOE_WIRE_ZEROCOPY_MAX_PENDING;
+        __atomic_store_n(&zc->count, zc->count - 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Drop every frame, done or not (lock held)
+ */
+static void release_all(zerocopy_socket_t* zc)
+{
+    zc->done = zc->next_id;
+    release_done(zc);
+    zc->head = 0;
+}
+
+#if WIRE_ZEROCOPY_SUPPORTED
+
+/**
+ * @brief Read the error queue until it is empty (lock held)
+ */
+static void read_completions(int fd, zerocopy_socket_t* zc)
+{
+    union {
+        struct cmsghdr align;
+        char buf[ZEROCOPY_CONTROL_SIZE];
+    } control;
+    struct sock_extended_err* err;
+    struct cmsghdr* cmsg;
+    struct msghdr msg;
+    uint32_t end;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP &&
+                   cmsg->cmsg_type == IP_RECVERR) ||
+                  (cmsg->cmsg_level == SOL_IPV6 &&
+                   cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            err = (struct sock_extended_err*)CMSG_DATA(cmsg);
+            if (err->ee_errno != 0 ||
+                err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+
+            /* [ee_info, ee_data] finished; ranges arrive in order */
+            end = err->ee_data + 1;
+            if ((int32_t)(end - zc->done) > 0) {
+                zc->done = end;
+            }
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                metrics_add(METRIC_NET_ZEROCOPY_COPIED,
+                            (uint64_t)(err->ee_data - err->ee_info) + 1);
+            }
+        }
+    }
+    release_done(zc);
+}
+
+/**
+ * @brief Wait for room in the send buffer, reading completions meanwhile
+ *
+ * Completions raise POLLERR without anything being wrong with the
+ * connection, so an error only counts once SO_ERROR says so.
+ *
+ * @return 0 when writable, E_IO_ERROR on timeout, hangup or error
+ */
+static int wait_writable(int fd, zerocopy_socket_t* zc)
+{
+    struct pollfd pfd;
+    socklen_t len;
+    int error;
+    int ret;
+
+    for (;;) {
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+
+        ret = poll(&pfd, 1, XOE_WIRE_SEND_TIMEOUT_MS);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0 || (pfd.revents & (POLLHUP | POLLNVAL))) {
+            return E_IO_ERROR;
+        }
+        if (pfd.revents & POLLERR) {
+            error = 0;
+            len = sizeof(error);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 ||
+                error != 0) {
+                return E_IO_ERROR;
+            }
+            pthread_mutex_lock(&zc->lock);
+            read_completions(fd, zc);
+            pthread_mutex_unlock(&zc->lock);
+        }
+        if (pfd.revents & POLLOUT) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Send all of @p data, counting the MSG_ZEROCOPY calls that moved
+ *        data in @p calls
+ *
+ * A call the kernel refuses for lack of option memory (ENOBUFS) is made
+ * again without MSG_ZEROCOPY. A full socket is waited for, unless
+ * @p done is given: then the send stops there.
+ *
+ * @param done Bytes sent, or NULL to wait for room
+ * @return 0, E_WOULD_BLOCK (socket full, with @p done), or E_IO_ERROR
+ */
+static int send_all(int fd, zerocopy_socket_t* zc, const uint8_t* data,
+                    size_t len, int flags, uint32_t* calls, size_t* done)
+{
+    STAGE_PROF_VAR(start);
+    ssize_t sent;
+
+    if (done != NULL) {
+        *done = 0;
+    }
+
+    while (len > 0) {
+        STAGE_PROF_START(start);
+        sent = send(fd, data, len, flags);
+        STAGE_PROF_STOP(STAGE_SEND_SYSCALL, start);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+                flags &= ~MSG_ZEROCOPY;
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (done != NULL) {
+                    return E_WOULD_BLOCK;
+                }
+                if (wait_writable(fd, zc) != 0) {
+                    return E_IO_ERROR;
+                }
+                continue;
+            }
+            return E_IO_ERROR;
+        }
+        if (sent == 0) {
+            return E_IO_ERROR;
+        }
+        if (flags & MSG_ZEROCOPY) {
+            (*calls)++;
+        }
+        data += sent;
+        len -= (size_t)sent;
+        if (done != NULL) {
+            *done += (size_t)sent;
+        }
+    }
+    return 0;
+}
+
+#endif /* WIRE_ZEROCOPY_SUPPORTED */
+
+/*
+ * Public API
+ */
+
+int xoe_wire_zerocopy_enable(int fd)
+{
+#if WIRE_ZEROCOPY_SUPPORTED
+    zerocopy_socket_t* zc;
+    zerocopy_socket_t* expected = NULL;
+    int one = 1;
+
+    if (fd < 0 || fd >= XOE_WIRE_ZEROCOPY_MAX_FDS) {
+        return E_INVALID_ARGUMENT;
+    }
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+        return E_NOT_SUPPORTED;
+    }
+
+    zc = __atomic_load_n(&sockets[fd], __ATOMIC_ACQUIRE);
+    if (zc == NULL) {
+        zc = (zerocopy_socket_t*)calloc(1, sizeof(zerocopy_socket_t));
+        if (zc == NULL) {
+            return E_OUT_OF_MEMORY;
+        }
+        pthread_mutex_init(&zc->lock, NULL);
+        if (!__atomic_compare_exchange_n(&sockets[fd], &expected, zc, FALSE,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE)) {
+            pthread_mutex_destroy(&zc->lock);
+            free(zc);
+            zc = expected;
+        }
+    }
+
+    /* A new socket: the kernel's counter starts again from 0 */
+    pthread_mutex_lock(&zc->lock);
+    release_all(zc);
+    zc->next_id = 0;
+    zc->done = 0;
+    __atomic_store_n(&zc->enabled, TRUE, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&zc->lock);
+    return 0;
+#else
+    (void)fd;
+    return E_NOT_SUPPORTED;
+#endif
+}
+
+void xoe_wire_zerocopy_reset(int fd)
+{
+    zerocopy_socket_t* zc = socket_of(fd);
+
+    if (zc == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&zc->lock);
+    __atomic_store_n(&zc->enabled, FALSE, __ATOMIC_RELAXED);
+    release_all(zc);
+    pthread_mutex_unlock(&zc->lock);
+}
+
+int xoe_wire_zerocopy_reap(int fd)
+{
+    zerocopy_socket_t* zc = socket_of(fd);
+    int pending;
+
+    if (zc == NULL || __atomic_load_n(&zc->count, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&zc->lock);
+#if WIRE_ZEROCOPY_SUPPORTED
+    read_completions(fd, zc);
+#endif
+    pending = zc->count;
+    pthread_mutex_unlock(&zc->lock);
+    return pending;
+}
+
+int xoe_wire_zerocopy_pending(int fd)
+{
+    zerocopy_socket_t* zc = socket_of(fd);
+
+    return (zc != NULL) ? __atomic_load_n(&zc->count, __ATOMIC_RELAXED) : 0;
+}
+
+int xoe_wire_zerocopy_send(xoe_transport_t* t, const uint8_t* header_buffer,
+                           xoe_payload_t* payload)
+{
+#if WIRE_ZEROCOPY_SUPPORTED
+    zerocopy_socket_t* zc;
+    zerocopy_frame_t* frame;
+    struct iovec rest[2];
+    size_t header_done = 0;
+    size_t payload_done = 0;
+    size_t* done;
+    uint32_t calls = 0;
+    int fd;
+    int result;
+
+    if (payload == NULL || payload->len < XOE_WIRE_ZEROCOPY_MIN ||
+        payload->owns_data != XOE_PAYLOAD_POOLED ||
+        !xoe_transport_is_tcp(t)) {
+        return E_NOT_SUPPORTED;
+    }
+    fd = t->fd;
+    zc = socket_of(fd);
+    if (zc == NULL) {
+        return E_NOT_SUPPORTED;
+    }
+
+    pthread_mutex_lock(&zc->lock);
+    if (zc->count == XOE_WIRE_ZEROCOPY_MAX_PENDING) {
+        read_completions(fd, zc);
+    }
+    if (zc->count == XOE_WIRE_ZEROCOPY_MAX_PENDING) {
+        pthread_mutex_unlock(&zc->lock);
+        return E_NOT_SUPPORTED;
+    }
+    pthread_mutex_unlock(&zc->lock);
+
+    /* A transport with an outbound queue is not waited on: the rest of
+     * the frame is copied into the queue */
+    done = (t->queue != NULL) ? &header_done : NULL;
+    result = send_all(fd, zc, header_buffer, XOE_WIRE_HEADER_SIZE,
+                      MSG_MORE, &calls, done);
+    if (result == 0) {
+        done = (t->queue != NULL) ? &payload_done : NULL;
+        result = send_all(fd, zc, (const uint8_t*)payload->data,
+                          payload->len, MSG_ZEROCOPY, &calls, done);
+    }
+    if (result == E_WOULD_BLOCK) {
+        rest[0].iov_base = (void*)(header_buffer + header_done);
+        rest[0].iov_len = XOE_WIRE_HEADER_SIZE - header_done;
+        rest[1].iov_base = (uint8_t*)payload->data + payload_done;
+        rest[1].iov_len = payload->len - payload_done;
+        result = xoe_transport_writev(t, rest, 2);
+    }
+
+    /* Pages of a failed send may still be queued: hold them all the same */
+    if (calls > 0) {
+        pthread_mutex_lock(&zc->lock);
+        zc->next_id += calls;
+        frame = &zc->frames[(zc->head + zc->count) %
+                            XOE_WIRE_ZEROCOPY_MAX_PENDING];
+        frame->payload = xoe_payload_ref(payload);
+        frame->end = zc->next_id;
+        __atomic_store_n(&zc->count, zc->count + 1, __ATOMIC_RELAXED);
+        read_completions(fd, zc);
+        pthread_mutex_unlock(&zc->lock);
+        metrics_add(METRIC_NET_ZEROCOPY_FRAMES, 1);
+    }
+    return result;
+#else
+    (void)t;
+    (void)header_buffer;
+    (void)payload;
+    return E_NOT_SUPPORTED;
+#endif
+}
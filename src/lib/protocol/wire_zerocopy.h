@@ -0,0 +1,102 @@
+/*
+ * wire_zerocopy.h - MSG_ZEROCOPY sends of large frame payloads
+ *
+ * Copying a payload into the socket costs more than everything else the
+ * send path does once frames reach tens of kilobytes (large URBs,
+ * compressed batches). On a socket enabled here, the wire layer sends the
+ * payload of a frame of XOE_WIRE_ZEROCOPY_MIN bytes or more with
+ * MSG_ZEROCOPY: the kernel transmits straight from the payload's pages.
+ * The header still goes out by copy, with MSG_MORE so both leave in one
+ * segment.
+ *
+ * The pages must stay untouched until the kernel reports it is done with
+ * them on the socket's error queue. The send takes a payload pool
+ * reference (xoe_payload_ref()) that is dropped when that completion is
+ * read, so the caller frees its packet as usual and the block only
+ * returns to the pool once the data has left. Completions are read by
+ * xoe_wire_zerocopy_reap(), which the owner of the socket calls when it
+ * polls readable or with an error (the error queue raises POLLERR), and
+ * by the send path itself.
+ *
+ * Everything else is sent by copy, as before: payloads that are not from
+ * the pool, transports other than plain TCP, and frames sent while
+ * XOE_WIRE_ZEROCOPY_MAX_PENDING earlier ones are still held by the
+ * kernel. Loopback and some drivers copy anyway; the kernel says so in
+ * the completion, counted as zerocopy_copied.
+ *
+ * Linux only (4.14+); elsewhere enabling fails with E_NOT_SUPPORTED.
+ *
+ * Author: [LLM-ARCH]
+ */
+
+#ifndef WIRE_ZEROCOPY_H
+#define WIRE_ZEROCOPY_H
+
+#include "lib/common/types.h"
+#include "lib/protocol/protocol.h"
+#include "lib/net/transport.h"
+
+/* Smallest payload sent with MSG_ZEROCOPY (pinning pages costs more below) */
+#define XOE_WIRE_ZEROCOPY_MIN (16 * 1024)
+
+/* Frames per socket the kernel may hold before sends fall back to copying */
+#define XOE_WIRE_ZEROCOPY_MAX_PENDING 64
+
+/* Descriptors at or above this number are never enabled */
+#define XOE_WIRE_ZEROCOPY_MAX_FDS 1024
+
+/**
+ * @brief Send large payloads on @p fd without copying them
+ *
+ * Sets SO_ZEROCOPY on the socket and starts tracking its completions. The
+ * caller must call xoe_wire_zerocopy_reap() when the socket polls
+ * readable or with an error, and xoe_wire_zerocopy_reset() before it
+ * closes the socket.
+ *
+ * @return 0, E_INVALID_ARGUMENT, E_OUT_OF_MEMORY, or E_NOT_SUPPORTED where
+ *         the platform or kernel has no MSG_ZEROCOPY
+ */
+int xoe_wire_zerocopy_enable(int fd);
+
+/**
+ * @brief Stop tracking @p fd and drop every payload reference it holds
+ *
+ * Call before the socket is closed or handed on; data the kernel has not
+ * sent yet may then be overwritten, so only once the connection is done
+ * with. A no-op for a socket never enabled.
+ */
+void xoe_wire_zerocopy_reset(int fd);
+
+/**
+ * @brief Read the completions waiting on @p fd and release their payloads
+ *
+ * Never blocks. Costs nothing for a socket with no frame outstanding.
+ *
+ * @return Frames still held by the kernel
+ */
+int xoe_wire_zerocopy_reap(int fd);
+
+/**
+ * @brief Frames sent on @p fd the kernel has not completed yet
+ */
+int xoe_wire_zerocopy_pending(int fd);
+
+/**
+ * @brief Send one frame with its payload by MSG_ZEROCOPY (wire layer)
+ *
+ * A full socket is waited for, unless the transport has an outbound
+ * queue (xoe_transport_set_queue()): then what the socket did not take
+ * is copied into the queue.
+ *
+ * @param t                 Transport of the connection
+ * @param header_buffer     Serialized wire header
+ * @param payload           Payload (its len bytes follow the header)
+ *
+ * @return 0 when sent (or queued), E_NOT_SUPPORTED if this frame must be
+ *         sent by copy (nothing was written), E_OUT_OF_MEMORY (queue), or
+ *         E_IO_ERROR
+ */
+int xoe_wire_zerocopy_send(xoe_transport_t* t, const uint8_t* header_buffer,
+                           xoe_payload_t* payload);
+
+#endif /* WIRE_ZEROCOPY_H */
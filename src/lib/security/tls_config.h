@@ -11,7 +11,9 @@
 #define TLS_CONFIG_H
 
 /* TLS Enable/Disable - Set to 0 to disable TLS and use plain TCP */
+#ifndef TLS_ENABLED
 #define TLS_ENABLED 1
+#endif
 
 /* Encryption Mode Selection (runtime) */
 #define ENCRYPT_NONE  0  /* Plain TCP, no encryption */
@@ -28,16 +30,47 @@
 /* Note: TLS_MIN_VERSION uses OpenSSL constants defined in openssl/tls1.h */
 /* TLS1_3_VERSION is defined as 0x0304 in OpenSSL 1.1.1+ */
 
+/* Multiple certificates (e.g. RSA and ECDSA) may be given as one
+ * comma-separated list each for the certificate and key paths, matched
+ * by position. Clients get the ECDSA certificate when they support it. */
+#define TLS_CERT_LIST_SEPARATOR ','
+
 /* TLS Cipher Suite Configuration */
+/* The lists below are preference orders and may be overridden at build
+ * time (-DTLS_CIPHER_SUITES=...). */
+
 /* TLS 1.3 cipher suites (TLSv1.3 ciphersuites parameter) */
+#ifndef TLS_CIPHER_SUITES
 #define TLS_CIPHER_SUITES "TLS_AES_256_GCM_SHA384:TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256"
+#endif
 
 /* TLS 1.2 cipher list (strong ciphers only with forward secrecy) */
 /* Prioritizes ECDHE for forward secrecy, AES-GCM and ChaCha20 for AEAD */
 /* Excludes: anonymous auth, export ciphers, DES, RC4, MD5, PSK */
+#ifndef TLS_CIPHER_LIST
 #define TLS_CIPHER_LIST "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:" \
                         "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:" \
                         "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256"
+#endif
+
+/* Key exchange groups, in preference order (X25519 is fastest without
+ * hardware support) */
+#ifndef TLS_GROUPS
+#define TLS_GROUPS "X25519:P-256:P-384"
+#endif
+
+/* AES vs ChaCha20-Poly1305 preference. ChaCha20 is several times faster
+ * than AES on CPUs without AES instructions (e.g. Cortex-A7). With the
+ * preference applied, ChaCha20 suites move to the front of both lists.
+ * Servers also pick ChaCha20 for any client that lists it first, so
+ * such peers get it even from an AES-first server. */
+#define TLS_PREFER_AUTO   0  /* ChaCha20 first when the CPU lacks AES */
+#define TLS_PREFER_AES    1  /* Lists as configured */
+#define TLS_PREFER_CHACHA 2  /* ChaCha20 first always */
+
+#ifndef TLS_CIPHER_PREFERENCE
+#define TLS_CIPHER_PREFERENCE TLS_PREFER_AUTO
+#endif
 
 /* Client Certificate Verification Mode */
 #define TLS_VERIFY_NONE   0  /* No client certificate verification */
@@ -48,6 +81,30 @@
 /* TLS Session Configuration */
 #define TLS_SESSION_TIMEOUT 300  /* Session timeout in seconds (5 minutes) */
 
+/* TLS Session Resumption */
+/* Servers issue stateless session tickets under keys rotated every
+ * TLS_TICKET_KEY_LIFETIME seconds. Tickets under the previous key are
+ * still accepted (and replaced), so none is honored for more than two
+ * lifetimes. Set TLS_SESSION_TICKETS to 0 to use the session cache only. */
+#define TLS_SESSION_TICKETS       1
+#define TLS_TICKET_KEY_LIFETIME   TLS_SESSION_TIMEOUT
+#define TLS_TICKETS_PER_HANDSHAKE 1  /* TLS 1.3 tickets sent per handshake */
+
+/* Client contexts keep the latest session and offer it on the next
+ * connection (TLS 1.3 PSK resumption, TLS 1.2 ticket or session ID).
+ * Set to 0 to always perform a full handshake. */
+#define TLS_CLIENT_RESUMPTION     1
+
+/* Kernel TLS Offload */
+/* After the handshake, hand record encryption to the kernel (Linux with
+ * the "tls" module, OpenSSL 3.0+ built with kTLS) so encrypted streams
+ * can use the plain-socket send paths. Connections whose cipher or
+ * kernel lacks support stay in userspace. Opt-in: build with
+ * -DTLS_KTLS=1, or call tls_context_enable_ktls(). */
+#ifndef TLS_KTLS
+#define TLS_KTLS 0
+#endif
+
 /* TLS Buffer Sizes */
 /* Note: OpenSSL TLS record size is typically 16KB, but we use smaller
  * buffers to match the existing xoe server buffer size */
@@ -8,15 +8,499 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#if defined(__linux__) && (defined(__aarch64__) || defined(__arm__))
+#include <sys/auxv.h>
+#endif
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#else
+#include <openssl/hmac.h>
+#endif
 
 #include "tls_context.h"
 #include "tls_config.h"
 #include "tls_error.h"
 #include "lib/common/definitions.h"
 
+/* ============================================================================
+ * Context Attachments
+ * ============================================================================ */
+
+/* Session ticket key sizes (AES-256-CBC + HMAC-SHA256, as OpenSSL uses) */
+#define TICKET_KEY_NAME_SIZE   16
+#define TICKET_KEY_SECRET_SIZE 32
+
+/**
+ * @brief One session ticket key
+ */
+typedef struct {
+    unsigned char name[TICKET_KEY_NAME_SIZE];     /* Sent in the ticket */
+    unsigned char aes_key[TICKET_KEY_SECRET_SIZE];
+    unsigned char hmac_key[TICKET_KEY_SECRET_SIZE];
+    time_t created;
+    int valid;
+} ticket_key_t;
+
+/**
+ * @brief Server ticket key ring (current issues, previous still decrypts)
+ *
+ * Ticket callbacks run on every connection thread, hence the lock.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    ticket_key_t current;
+    ticket_key_t previous;
+} ticket_keys_t;
+
+/**
+ * @brief Client session store (latest session received from the server)
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    SSL_SESSION* session;
+} client_sessions_t;
+
+static int g_ticket_keys_index = -1;
+static int g_client_sessions_index = -1;
+static pthread_once_t g_ex_index_once = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief SSL_CTX_free() hook for the ticket key ring
+ */
+static void free_ticket_keys(void* parent, void* ptr, CRYPTO_EX_DATA* ad,
+                             int idx, long argl, void* argp) {
+    ticket_keys_t* keys = (ticket_keys_t*)ptr;
+
+    (void)parent;
+    (void)ad;
+    (void)idx;
+    (void)argl;
+    (void)argp;
+
+    if (keys != NULL) {
+        pthread_mutex_destroy(&keys->lock);
+        OPENSSL_cleanse(keys, sizeof(ticket_keys_t));
+        free(keys);
+    }
+}
+
+/**
+ * @brief SSL_CTX_free() hook for the client session store
+ */
+static void free_client_sessions(void* parent, void* ptr, CRYPTO_EX_DATA* ad,
+                                 int idx, long argl, void* argp) {
+    client_sessions_t* store = (client_sessions_t*)ptr;
+
+    (void)parent;
+    (void)ad;
+    (void)idx;
+    (void)argl;
+    (void)argp;
+
+    if (store != NULL) {
+        if (store->session != NULL) {
+            SSL_SESSION_free(store->session);
+        }
+        pthread_mutex_destroy(&store->lock);
+        free(store);
+    }
+}
+
+static void make_ex_indexes(void) {
+    g_ticket_keys_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+                                                   free_ticket_keys);
+    g_client_sessions_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+                                                       free_client_sessions);
+}
+
+/**
+ * @brief Attach data to a context (freed along with it)
+ *
+ * @return 0 on success, negative error code on failure
+ */
+static int attach_ex_data(SSL_CTX* ctx, const int* index, void* data) {
+    pthread_once(&g_ex_index_once, make_ex_indexes);
+    if (*index < 0 || !SSL_CTX_set_ex_data(ctx, *index, data)) {
+        return E_UNKNOWN_ERROR;
+    }
+    return 0;
+}
+
+static void* get_ex_data(SSL_CTX* ctx, const int* index) {
+    pthread_once(&g_ex_index_once, make_ex_indexes);
+    if (ctx == NULL || *index < 0) {
+        return NULL;
+    }
+    return SSL_CTX_get_ex_data(ctx, *index);
+}
+
+/* kTLS needs Linux and an OpenSSL 3 build with it compiled in */
+#if defined(__linux__) && OPENSSL_VERSION_NUMBER >= 0x30000000L && \
+    !defined(OPENSSL_NO_KTLS)
+#define TLS_KTLS_AVAILABLE 1
+#else
+#define TLS_KTLS_AVAILABLE 0
+#endif
+
+/* ============================================================================
+ * Cipher Preference
+ * ============================================================================ */
+
+/* AES feature bits from the kernel's hwcap ABI */
+#if defined(__linux__) && defined(__aarch64__)
+#define CPU_HWCAP_AES_TYPE AT_HWCAP
+#define CPU_HWCAP_AES_BIT  (1UL << 3)   /* HWCAP_AES */
+#elif defined(__linux__) && defined(__arm__)
+#define CPU_HWCAP_AES_TYPE AT_HWCAP2
+#define CPU_HWCAP_AES_BIT  (1UL << 0)   /* HWCAP2_AES */
+#endif
+
+/**
+ * @brief Check whether this CPU has AES instructions
+ *
+ * Unknown platforms are assumed to have them, which keeps the lists as
+ * configured.
+ */
+static int cpu_has_aes(void) {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") ? TRUE : FALSE;
+#elif defined(CPU_HWCAP_AES_TYPE)
+    return (getauxval(CPU_HWCAP_AES_TYPE) & CPU_HWCAP_AES_BIT) ? TRUE : FALSE;
+#else
+    return TRUE;
+#endif
+}
+
+/**
+ * @brief Check whether a cipher list entry names a ChaCha20 suite
+ */
+static int is_chacha_entry(const char* entry, size_t len) {
+    size_t i;
+
+    for (i = 0; i + 8 <= len; i++) {
+        if (strncmp(entry + i, "CHACHA20", 8) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Copy a cipher list with its ChaCha20 entries moved to the front
+ *
+ * Relative order is kept within both groups.
+ *
+ * @return 0 on success, E_INVALID_ARGUMENT if the list does not fit
+ */
+static int order_chacha_first(const char* list, char* out, size_t size) {
+    const char* entry;
+    const char* end;
+    size_t used = 0;
+    size_t len;
+    int pass;
+
+    /* Pass 0 copies the ChaCha20 entries, pass 1 the rest */
+    for (pass = 0; pass < 2; pass++) {
+        for (entry = list; *entry != '\0'; entry = end) {
+            end = strchr(entry, ':');
+            if (end == NULL) {
+                end = entry + strlen(entry);
+            }
+            len = (size_t)(end - entry);
+            if (*end == ':') {
+                end++;
+            }
+
+            if (len == 0 || is_chacha_entry(entry, len) != (pass == 0)) {
+                continue;
+            }
+            if (used + len + 2 > size) {
+                return E_INVALID_ARGUMENT;
+            }
+            if (used > 0) {
+                out[used++] = ':';
+            }
+            memcpy(out + used, entry, len);
+            used += len;
+        }
+    }
+
+    out[used] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Set a cipher list, reordered for the ChaCha20 preference
+ */
+static int set_cipher_preference(SSL_CTX* ctx, int tls_version) {
+    char ordered[512];
+    const char* list;
+    int ok;
+
+    list = (tls_version == ENCRYPT_TLS13) ? TLS_CIPHER_SUITES : TLS_CIPHER_LIST;
+    if (tls_context_prefers_chacha()) {
+        if (order_chacha_first(list, ordered, sizeof(ordered)) != 0) {
+            fprintf(stderr, "Cipher list too long to reorder\n");
+            return E_TLS_CIPHER_MISMATCH;
+        }
+        list = ordered;
+    }
+
+    if (tls_version == ENCRYPT_TLS13) {
+        /* TLS 1.3: Use SSL_CTX_set_ciphersuites() */
+        ok = SSL_CTX_set_ciphersuites(ctx, list);
+    } else {
+        /* TLS 1.2: Use SSL_CTX_set_cipher_list() with strong ciphers only */
+        ok = SSL_CTX_set_cipher_list(ctx, list);
+    }
+    if (!ok) {
+        tls_print_errors(tls_version == ENCRYPT_TLS13 ?
+                         "Failed to set TLS 1.3 cipher suites" :
+                         "Failed to set TLS 1.2 cipher list");
+        return E_TLS_CIPHER_MISMATCH;
+    }
+
+    return 0;
+}
+
+/* ============================================================================
+ * Session Tickets (server)
+ * ============================================================================ */
+
+static int generate_ticket_key(ticket_key_t* key) {
+    if (RAND_bytes(key->name, sizeof(key->name)) != 1 ||
+        RAND_bytes(key->aes_key, sizeof(key->aes_key)) != 1 ||
+        RAND_bytes(key->hmac_key, sizeof(key->hmac_key)) != 1) {
+        return E_UNKNOWN_ERROR;
+    }
+    key->created = time(NULL);
+    key->valid = TRUE;
+    return 0;
+}
+
+/**
+ * @brief Make a new current key; the old one only decrypts from now on
+ *
+ * Caller holds keys->lock.
+ */
+static int rotate_ticket_keys_locked(ticket_keys_t* keys) {
+    ticket_key_t next;
+
+    if (generate_ticket_key(&next) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+    keys->previous = keys->current;
+    keys->current = next;
+    OPENSSL_cleanse(&next, sizeof(next));
+    return 0;
+}
+
+/**
+ * @brief Rotate an aged current key and retire an aged previous key
+ *
+ * Caller holds keys->lock. Rotation is lazy (on the next handshake), so
+ * an idle server also drops the previous key once it is two lifetimes
+ * old rather than honoring its tickets indefinitely.
+ */
+static void refresh_ticket_keys_locked(ticket_keys_t* keys) {
+    time_t now = time(NULL);
+
+    if (now - keys->current.created >= TLS_TICKET_KEY_LIFETIME) {
+        rotate_ticket_keys_locked(keys);
+    }
+    if (keys->previous.valid &&
+        now - keys->previous.created >= 2 * TLS_TICKET_KEY_LIFETIME) {
+        OPENSSL_cleanse(&keys->previous, sizeof(keys->previous));
+    }
+}
+
+/**
+ * @brief Key the HMAC of a ticket
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int init_ticket_hmac(EVP_MAC_CTX* hmac_ctx, const ticket_key_t* key) {
+    OSSL_PARAM params[3];
+
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+                                                  (void*)key->hmac_key,
+                                                  sizeof(key->hmac_key));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 (char*)"SHA256", 0);
+    params[2] = OSSL_PARAM_construct_end();
+    return EVP_MAC_CTX_set_params(hmac_ctx, params) ? 0 : E_UNKNOWN_ERROR;
+}
+#else
+static int init_ticket_hmac(HMAC_CTX* hmac_ctx, const ticket_key_t* key) {
+    return HMAC_Init_ex(hmac_ctx, key->hmac_key, sizeof(key->hmac_key),
+                        EVP_sha256(), NULL) ? 0 : E_UNKNOWN_ERROR;
+}
+#endif
+
+/**
+ * @brief OpenSSL ticket key callback
+ *
+ * Encrypting (enc = 1) uses the current key. Decrypting looks the key up
+ * by name: 1 accepts the ticket, 2 accepts it and issues a fresh one
+ * (previous key, or any TLS 1.3 ticket), 0 rejects it (full handshake).
+ */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                         EVP_CIPHER_CTX* cipher_ctx, EVP_MAC_CTX* hmac_ctx,
+                         int enc) {
+#else
+static int ticket_key_cb(SSL* ssl, unsigned char* key_name, unsigned char* iv,
+                         EVP_CIPHER_CTX* cipher_ctx, HMAC_CTX* hmac_ctx,
+                         int enc) {
+#endif
+    ticket_keys_t* keys;
+    ticket_key_t key;
+    int result = 0;
+
+    keys = (ticket_keys_t*)get_ex_data(SSL_get_SSL_CTX(ssl),
+                                       &g_ticket_keys_index);
+    if (keys == NULL) {
+        return -1;
+    }
+
+    /* Copy the key out so the crypto runs without the lock */
+    pthread_mutex_lock(&keys->lock);
+    refresh_ticket_keys_locked(keys);
+    if (enc) {
+        key = keys->current;
+        result = 1;
+    } else if (memcmp(key_name, keys->current.name, TICKET_KEY_NAME_SIZE) == 0) {
+        key = keys->current;
+        result = 1;
+    } else if (keys->previous.valid &&
+               memcmp(key_name, keys->previous.name, TICKET_KEY_NAME_SIZE) == 0) {
+        key = keys->previous;
+        result = 2;
+    }
+    pthread_mutex_unlock(&keys->lock);
+
+    if (result == 0) {
+        return 0;  /* Unknown or retired key */
+    }
+    if (!enc && SSL_version(ssl) >= TLS1_3_VERSION) {
+        result = 2;  /* Clients use a TLS 1.3 ticket once; always replace it */
+    }
+
+    if (enc) {
+        memcpy(key_name, key.name, TICKET_KEY_NAME_SIZE);
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1 ||
+            !EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), NULL,
+                                key.aes_key, iv)) {
+            result = -1;
+        }
+    } else if (!EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), NULL,
+                                   key.aes_key, iv)) {
+        result = -1;
+    }
+    if (result > 0 && init_ticket_hmac(hmac_ctx, &key) != 0) {
+        result = -1;
+    }
+
+    OPENSSL_cleanse(&key, sizeof(key));
+    return result;
+}
+
+/**
+ * @brief Issue session tickets under a rotating key ring
+ */
+static int enable_session_tickets(SSL_CTX* ctx) {
+    ticket_keys_t* keys;
+
+    keys = (ticket_keys_t*)calloc(1, sizeof(ticket_keys_t));
+    if (keys == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    if (pthread_mutex_init(&keys->lock, NULL) != 0) {
+        free(keys);
+        return E_OUT_OF_MEMORY;
+    }
+    if (generate_ticket_key(&keys->current) != 0 ||
+        attach_ex_data(ctx, &g_ticket_keys_index, keys) != 0) {
+        free_ticket_keys(NULL, keys, NULL, 0, 0, NULL);
+        return E_UNKNOWN_ERROR;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key_cb);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticket_key_cb);
+#endif
+    SSL_CTX_set_num_tickets(ctx, TLS_TICKETS_PER_HANDSHAKE);
+    return 0;
+}
+
+/* ============================================================================
+ * Session Storage (client)
+ * ============================================================================ */
+
+/**
+ * @brief New session callback: keep the latest session from the server
+ *
+ * Runs after a full handshake (TLS 1.2) or when a TLS 1.3 ticket arrives
+ * with the first read.
+ */
+static int store_client_session(SSL* ssl, SSL_SESSION* session) {
+    client_sessions_t* store;
+    SSL_SESSION* old;
+
+    store = (client_sessions_t*)get_ex_data(SSL_get_SSL_CTX(ssl),
+                                            &g_client_sessions_index);
+    if (store == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    old = store->session;
+    store->session = session;
+    pthread_mutex_unlock(&store->lock);
+
+    if (old != NULL) {
+        SSL_SESSION_free(old);
+    }
+    return 1;  /* We keep the reference */
+}
+
+/**
+ * @brief Enable the client session store on a client context
+ */
+static int enable_client_resumption(SSL_CTX* ctx) {
+    client_sessions_t* store;
+
+    store = (client_sessions_t*)calloc(1, sizeof(client_sessions_t));
+    if (store == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    if (pthread_mutex_init(&store->lock, NULL) != 0) {
+        free(store);
+        return E_OUT_OF_MEMORY;
+    }
+    if (attach_ex_data(ctx, &g_client_sessions_index, store) != 0) {
+        free_client_sessions(NULL, store, NULL, 0, 0, NULL);
+        return E_UNKNOWN_ERROR;
+    }
+
+    /* Our store instead of OpenSSL's internal client cache */
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+                                        SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, store_client_session);
+    return 0;
+}
+
 /**
  * @brief Load certificate and private key into SSL context
  *
@@ -28,7 +512,8 @@
  * @param key_file Path to key file
  * @return 0 on success, negative error code on failure
  */
-static int load_certificates(SSL_CTX* ctx, const char* cert_file, const char* key_file) {
+static int load_certificate_pair(SSL_CTX* ctx, const char* cert_file,
+                                 const char* key_file) {
     /* Load server certificate */
     if (SSL_CTX_use_certificate_file(ctx, cert_file, SSL_FILETYPE_PEM) <= 0) {
         tls_print_errors("Failed to load certificate");
@@ -43,7 +528,61 @@ static int load_certificates(SSL_CTX* ctx, const char* cert_file, const char* ke
 
     /* Verify that private key matches certificate */
     if (!SSL_CTX_check_private_key(ctx)) {
-        fprintf(stderr, "Private key does not match certificate\n");
+        fprintf(stderr, "Private key does not match certificate %s\n",
+                cert_file);
+        return E_TLS_CERT_INVALID;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Copy the next entry of a TLS_CERT_LIST_SEPARATOR list
+ *
+ * @return Rest of the list, or NULL after the last entry
+ */
+static const char* next_path(const char* list, char* out, size_t size) {
+    const char* end = strchr(list, TLS_CERT_LIST_SEPARATOR);
+    size_t len = (end != NULL) ? (size_t)(end - list) : strlen(list);
+
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(out, list, len);
+    out[len] = '\0';
+    return (end != NULL) ? end + 1 : NULL;
+}
+
+/**
+ * @brief Load every certificate/key pair of the configured lists
+ *
+ * OpenSSL keeps one certificate per key type and serves each client the
+ * best one its signature algorithms allow (ECDSA before RSA).
+ */
+static int load_certificates(SSL_CTX* ctx, const char* cert_files,
+                             const char* key_files) {
+    char cert_file[TLS_CERT_PATH_MAX];
+    char key_file[TLS_CERT_PATH_MAX];
+    const char* certs = cert_files;
+    const char* keys = key_files;
+    int ret;
+
+    while (certs != NULL) {
+        if (keys == NULL) {
+            fprintf(stderr, "More certificates than private keys\n");
+            return E_TLS_CERT_INVALID;
+        }
+        certs = next_path(certs, cert_file, sizeof(cert_file));
+        keys = next_path(keys, key_file, sizeof(key_file));
+
+        ret = load_certificate_pair(ctx, cert_file, key_file);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    if (keys != NULL) {
+        fprintf(stderr, "More private keys than certificates\n");
         return E_TLS_CERT_INVALID;
     }
 
@@ -90,12 +629,24 @@ SSL_CTX* tls_context_init(const char* cert_file, const char* key_file, int tls_v
     SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
     SSL_CTX_set_timeout(ctx, TLS_SESSION_TIMEOUT);
 
+    /* Stateless resumption: tickets under rotating keys */
+#if TLS_SESSION_TICKETS
+    if (enable_session_tickets(ctx) != 0) {
+        fprintf(stderr, "Failed to set up session ticket keys\n");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+#else
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+#endif
+
     return ctx;
 }
 
 int tls_context_configure(SSL_CTX* ctx, int tls_version) {
     int min_version;
     int max_version;
+    int ret;
 
     if (ctx == NULL) {
         fprintf(stderr, "SSL context is NULL\n");
@@ -127,27 +678,65 @@ int tls_context_configure(SSL_CTX* ctx, int tls_version) {
     }
 
     /* Set cipher suites based on TLS version */
-    if (tls_version == ENCRYPT_TLS13) {
-        /* TLS 1.3: Use SSL_CTX_set_ciphersuites() */
-        if (!SSL_CTX_set_ciphersuites(ctx, TLS_CIPHER_SUITES)) {
-            tls_print_errors("Failed to set TLS 1.3 cipher suites");
-            return E_TLS_CIPHER_MISMATCH;
-        }
-    } else if (tls_version == ENCRYPT_TLS12) {
-        /* TLS 1.2: Use SSL_CTX_set_cipher_list() with strong ciphers only */
-        if (!SSL_CTX_set_cipher_list(ctx, TLS_CIPHER_LIST)) {
-            tls_print_errors("Failed to set TLS 1.2 cipher list");
-            return E_TLS_CIPHER_MISMATCH;
-        }
+    ret = set_cipher_preference(ctx, tls_version);
+    if (ret != 0) {
+        return ret;
+    }
+
+    /* Key exchange groups */
+    if (!SSL_CTX_set1_groups_list(ctx, TLS_GROUPS)) {
+        tls_print_errors("Failed to set key exchange groups");
+        return E_TLS_CIPHER_MISMATCH;
     }
 
+    /* Servers choose by their own list, except that a client listing
+     * ChaCha20 first (no AES instructions) gets it. Ignored by clients. */
+    SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE |
+                             SSL_OP_PRIORITIZE_CHACHA);
+
     /* Set secure options */
     SSL_CTX_set_options(ctx, SSL_OP_NO_COMPRESSION);  /* Disable compression (CRIME attack) */
     SSL_CTX_set_options(ctx, SSL_OP_NO_RENEGOTIATION); /* Disable renegotiation */
 
+#if TLS_KTLS
+    /* Best effort: without kTLS support connections stay in userspace */
+    tls_context_enable_ktls(ctx);
+#endif
+
     return 0;
 }
 
+int tls_context_prefers_chacha(void) {
+#if TLS_CIPHER_PREFERENCE == TLS_PREFER_CHACHA
+    return TRUE;
+#elif TLS_CIPHER_PREFERENCE == TLS_PREFER_AES
+    return FALSE;
+#else
+    static int prefers = -1;
+
+    /* Racing first calls compute the same answer */
+    if (prefers < 0) {
+        prefers = cpu_has_aes() ? FALSE : TRUE;
+    }
+    return prefers;
+#endif
+}
+
+int tls_context_enable_ktls(SSL_CTX* ctx) {
+    if (ctx == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+#if TLS_KTLS_AVAILABLE
+    /* OpenSSL switches each direction to the kernel after the handshake
+     * when the negotiated cipher and the kernel both support it */
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+    return 0;
+#else
+    return E_NOT_SUPPORTED;
+#endif
+}
+
 SSL_CTX* tls_context_init_client(int tls_version) {
     SSL_CTX* ctx;
     int ret;
@@ -179,6 +768,15 @@ SSL_CTX* tls_context_init_client(int tls_version) {
      */
     SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
 
+#if TLS_CLIENT_RESUMPTION
+    /* Offer the last session on the next connection */
+    if (enable_client_resumption(ctx) != 0) {
+        fprintf(stderr, "Failed to set up client session storage\n");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+#endif
+
     return ctx;
 }
 
@@ -235,9 +833,239 @@ SSL_CTX* tls_context_init_client_verified(int tls_version, const char* ca_file,
     }
     SSL_CTX_set_verify(ctx, ssl_verify_mode, NULL);
 
+#if TLS_CLIENT_RESUMPTION
+    /* Offer the last session on the next connection */
+    if (enable_client_resumption(ctx) != 0) {
+        fprintf(stderr, "Failed to set up client session storage\n");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+#endif
+
+    return ctx;
+}
+
+/* ============================================================================
+ * DTLS
+ * ============================================================================ */
+
+#define DTLS_COOKIE_SECRET_SIZE 32
+
+static unsigned char g_cookie_secret[DTLS_COOKIE_SECRET_SIZE];
+static int g_cookie_secret_ready = FALSE;
+static pthread_once_t g_cookie_secret_once = PTHREAD_ONCE_INIT;
+
+static void make_cookie_secret(void) {
+    g_cookie_secret_ready = (RAND_bytes(g_cookie_secret,
+                                        sizeof(g_cookie_secret)) == 1);
+}
+
+/**
+ * @brief HMAC-SHA256 of the peer address of a listening DTLS session
+ */
+static int compute_cookie(SSL* ssl, unsigned char* cookie, size_t* len) {
+    unsigned char data[sizeof(struct in6_addr) + sizeof(unsigned short)];
+    BIO_ADDR* peer;
+    unsigned short port;
+    size_t addr_len = 0;
+    int ok;
+
+    if (!g_cookie_secret_ready) {
+        return 0;
+    }
+
+    peer = BIO_ADDR_new();
+    if (peer == NULL) {
+        return 0;
+    }
+    ok = BIO_dgram_get_peer(SSL_get_rbio(ssl), peer) > 0 &&
+         BIO_ADDR_rawaddress(peer, NULL, &addr_len) &&
+         addr_len <= sizeof(struct in6_addr) &&
+         BIO_ADDR_rawaddress(peer, data, &addr_len);
+    port = BIO_ADDR_rawport(peer);
+    BIO_ADDR_free(peer);
+    if (!ok) {
+        return 0;
+    }
+    memcpy(data + addr_len, &port, sizeof(port));
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    return EVP_Q_mac(NULL, "HMAC", NULL, "SHA256", NULL, g_cookie_secret,
+                     sizeof(g_cookie_secret), data, addr_len + sizeof(port),
+                     cookie, EVP_MAX_MD_SIZE, len) != NULL;
+#else
+    {
+        unsigned int out_len = 0;
+
+        ok = HMAC(EVP_sha256(), g_cookie_secret, sizeof(g_cookie_secret),
+                  data, addr_len + sizeof(port), cookie, &out_len) != NULL;
+        *len = out_len;
+        return ok;
+    }
+#endif
+}
+
+static int generate_cookie_cb(SSL* ssl, unsigned char* cookie,
+                              unsigned int* cookie_len) {
+    size_t len = 0;
+
+    if (!compute_cookie(ssl, cookie, &len)) {
+        return 0;
+    }
+    *cookie_len = (unsigned int)len;
+    return 1;
+}
+
+static int verify_cookie_cb(SSL* ssl, const unsigned char* cookie,
+                            unsigned int cookie_len) {
+    unsigned char expected[EVP_MAX_MD_SIZE];
+    size_t len = 0;
+
+    return compute_cookie(ssl, expected, &len) && len == cookie_len &&
+           CRYPTO_memcmp(expected, cookie, len) == 0;
+}
+
+/**
+ * @brief Create a DTLS context with the versions and ciphers of TLS ones
+ */
+static SSL_CTX* dtls_context_new(const SSL_METHOD* method, int tls_version) {
+    SSL_CTX* ctx;
+    int version = DTLS1_2_VERSION;
+    int cipher_mode = ENCRYPT_TLS12;
+
+    if (tls_version != ENCRYPT_TLS12 && tls_version != ENCRYPT_TLS13) {
+        fprintf(stderr, "Invalid TLS version: %d (must be ENCRYPT_TLS12 or ENCRYPT_TLS13)\n", tls_version);
+        return NULL;
+    }
+    if (tls_version == ENCRYPT_TLS13) {
+#ifdef DTLS1_3_VERSION
+        version = DTLS1_3_VERSION;
+        cipher_mode = ENCRYPT_TLS13;
+#else
+        fprintf(stderr, "DTLS 1.3 not available in this OpenSSL, using DTLS 1.2\n");
+#endif
+    }
+
+    ctx = SSL_CTX_new(method);
+    if (ctx == NULL) {
+        tls_print_errors("Failed to create DTLS context");
+        return NULL;
+    }
+
+    if (!SSL_CTX_set_min_proto_version(ctx, version) ||
+        !SSL_CTX_set_max_proto_version(ctx, version)) {
+        tls_print_errors("Failed to set DTLS version");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    if (set_cipher_preference(ctx, cipher_mode) != 0 ||
+        !SSL_CTX_set1_groups_list(ctx, TLS_GROUPS)) {
+        tls_print_errors("Failed to set DTLS ciphers");
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+
+    SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE |
+                             SSL_OP_PRIORITIZE_CHACHA |
+                             SSL_OP_NO_COMPRESSION |
+                             SSL_OP_NO_RENEGOTIATION |
+                             SSL_OP_NO_TICKET);
+
+    /* Whole records per read: one datagram, one frame */
+    SSL_CTX_set_read_ahead(ctx, 1);
+
+    return ctx;
+}
+
+SSL_CTX* tls_context_init_dtls(const char* cert_file, const char* key_file,
+                               int tls_version) {
+    SSL_CTX* ctx;
+
+    if (cert_file == NULL || key_file == NULL) {
+        fprintf(stderr, "Certificate and key file paths must not be NULL\n");
+        return NULL;
+    }
+
+    pthread_once(&g_cookie_secret_once, make_cookie_secret);
+    if (!g_cookie_secret_ready) {
+        fprintf(stderr, "Failed to generate DTLS cookie secret\n");
+        return NULL;
+    }
+
+    ctx = dtls_context_new(DTLS_server_method(), tls_version);
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    if (load_certificates(ctx, cert_file, key_file) != 0) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+
+    SSL_CTX_set_cookie_generate_cb(ctx, generate_cookie_cb);
+    SSL_CTX_set_cookie_verify_cb(ctx, verify_cookie_cb);
+
+    return ctx;
+}
+
+SSL_CTX* tls_context_init_dtls_client(int tls_version) {
+    SSL_CTX* ctx;
+
+    ctx = dtls_context_new(DTLS_client_method(), tls_version);
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    /* Testing only, as with tls_context_init_client() */
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+
     return ctx;
 }
 
+int tls_context_rotate_ticket_keys(SSL_CTX* ctx) {
+    ticket_keys_t* keys;
+    int result;
+
+    if (ctx == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    keys = (ticket_keys_t*)get_ex_data(ctx, &g_ticket_keys_index);
+    if (keys == NULL) {
+        return E_NOT_SUPPORTED;  /* Client context, or tickets disabled */
+    }
+
+    pthread_mutex_lock(&keys->lock);
+    result = rotate_ticket_keys_locked(keys);
+    pthread_mutex_unlock(&keys->lock);
+
+    return result;
+}
+
+SSL_SESSION* tls_context_take_session(SSL_CTX* ctx) {
+    client_sessions_t* store;
+    SSL_SESSION* session;
+
+    store = (client_sessions_t*)get_ex_data(ctx, &g_client_sessions_index);
+    if (store == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    session = store->session;
+    if (session != NULL) {
+        if (SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION) {
+            /* TLS 1.3 tickets are single-use (RFC 8446, C.4) */
+            store->session = NULL;
+        } else {
+            SSL_SESSION_up_ref(session);
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    return session;
+}
+
 void tls_context_cleanup(SSL_CTX* ctx) {
     if (ctx != NULL) {
         SSL_CTX_free(ctx);
@@ -29,8 +29,12 @@
  * Must be called once before accepting client connections.
  * The returned context is read-only and thread-safe after initialization.
  *
- * @param cert_file Path to PEM-encoded certificate file
- * @param key_file  Path to PEM-encoded private key file
+ * Several certificates of different key types (e.g. RSA and ECDSA) can
+ * be loaded by passing comma-separated lists, matched by position. Each
+ * client is then served the cheapest one it supports (ECDSA first).
+ *
+ * @param cert_file Path to PEM-encoded certificate file (or a list)
+ * @param key_file  Path to PEM-encoded private key file (or a list)
  * @param tls_version TLS version to use (ENCRYPT_TLS12 or ENCRYPT_TLS13)
  * @return SSL_CTX* on success, NULL on failure
  *
@@ -47,7 +51,8 @@ SSL_CTX* tls_context_init(const char* cert_file, const char* key_file, int tls_v
  * @brief Configure TLS context with cipher suites and options
  *
  * Sets minimum and maximum TLS version according to parameter.
- * Configures cipher suites from tls_config.h.
+ * Configures cipher suites and key exchange groups from tls_config.h,
+ * with ChaCha20 suites first when tls_context_prefers_chacha().
  * Enables session caching for connection resumption.
  * Sets secure default options.
  *
@@ -97,6 +102,98 @@ SSL_CTX* tls_context_init_client(int tls_version);
 SSL_CTX* tls_context_init_client_verified(int tls_version, const char* ca_file,
                                           int verify_mode);
 
+/**
+ * @brief Initialize a DTLS server context for datagram associations
+ *
+ * Same certificate, key and cipher policy as tls_context_init(), over
+ * DTLS. DTLS 1.3 is used for ENCRYPT_TLS13 where OpenSSL provides it
+ * (DTLS1_3_VERSION); otherwise both modes run DTLS 1.2. Installs the
+ * cookie callbacks DTLSv1_listen() needs: a cookie is an HMAC of the
+ * client address under a random per-process secret, so a spoofed source
+ * cannot make the server keep handshake state.
+ *
+ * @param cert_file Path to PEM-encoded certificate file (or a list)
+ * @param key_file  Path to PEM-encoded private key file (or a list)
+ * @param tls_version ENCRYPT_TLS12 or ENCRYPT_TLS13
+ * @return SSL_CTX* on success, NULL on failure
+ */
+SSL_CTX* tls_context_init_dtls(const char* cert_file, const char* key_file,
+                               int tls_version);
+
+/**
+ * @brief Initialize a DTLS client context (insecure, no verification)
+ *
+ * The datagram counterpart of tls_context_init_client(), with the same
+ * version choice as tls_context_init_dtls().
+ *
+ * @param tls_version ENCRYPT_TLS12 or ENCRYPT_TLS13
+ * @return SSL_CTX* on success, NULL on failure
+ */
+SSL_CTX* tls_context_init_dtls_client(int tls_version);
+
+/**
+ * @brief Check whether contexts put ChaCha20-Poly1305 suites first
+ *
+ * Follows TLS_CIPHER_PREFERENCE; with TLS_PREFER_AUTO, TRUE when the CPU
+ * lacks AES instructions (detected once).
+ *
+ * @return TRUE if ChaCha20 is preferred, FALSE otherwise
+ */
+int tls_context_prefers_chacha(void);
+
+/**
+ * @brief Enable kernel TLS offload on a context
+ *
+ * After each handshake, OpenSSL hands record encryption (and, where the
+ * kernel and OpenSSL version allow, decryption) to the kernel. The
+ * tls_session_ktls_status() of a session tells which directions moved;
+ * the rest stays in userspace, so enabling this is always safe.
+ * Done automatically by every init function when built with TLS_KTLS=1.
+ *
+ * @param ctx SSL context, before sessions are created from it
+ * @return 0 on success, negative error code on failure
+ *
+ * Error codes:
+ *   E_INVALID_ARGUMENT - ctx is NULL
+ *   E_NOT_SUPPORTED    - Not Linux, or OpenSSL lacks kTLS (needs 3.0+)
+ */
+int tls_context_enable_ktls(SSL_CTX* ctx);
+
+/**
+ * @brief Rotate the session ticket keys of a server context
+ *
+ * Keys also rotate on their own every TLS_TICKET_KEY_LIFETIME seconds.
+ * After a rotation, tickets under the previous key are still accepted
+ * (and replaced with new ones); a second rotation retires them.
+ * Thread-safe - may be called while connections are being accepted.
+ *
+ * @param ctx Server SSL context (from tls_context_init)
+ * @return 0 on success, negative error code on failure
+ *
+ * Error codes:
+ *   E_INVALID_ARGUMENT - ctx is NULL
+ *   E_NOT_SUPPORTED    - Not a server context, or TLS_SESSION_TICKETS is 0
+ *   E_UNKNOWN_ERROR    - Key generation failed
+ */
+int tls_context_rotate_ticket_keys(SSL_CTX* ctx);
+
+/**
+ * @brief Take the session to offer on the next client connection
+ *
+ * Client contexts keep the latest session the server issued. TLS 1.3
+ * sessions (tickets) are handed out once, as RFC 8446 advises against
+ * reuse; TLS 1.2 sessions stay stored until the server issues another.
+ * Sessions are not keyed by server, so use one client context per server.
+ *
+ * Called by the tls_session_create_client*() functions; most callers
+ * need not use it directly.
+ *
+ * @param ctx Client SSL context
+ * @return Session (caller frees with SSL_SESSION_free), or NULL if none
+ *         is stored or TLS_CLIENT_RESUMPTION is 0
+ */
+SSL_SESSION* tls_context_take_session(SSL_CTX* ctx);
+
 /**
  * @brief Clean up the global TLS context
  *
@@ -8,12 +8,18 @@
  */
 
 #include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/socket.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
 #include "tls_session.h"
+#include "tls_context.h"
 #include "tls_error.h"
 #include "lib/common/definitions.h"
+#include "lib/common/latency.h"
 
 SSL* tls_session_create(SSL_CTX* ctx, int client_socket) {
     SSL* ssl;
@@ -98,6 +104,80 @@ int tls_session_handshake(SSL* ssl) {
     return 0;
 }
 
+SSL* tls_session_create_deferred(SSL_CTX* ctx, int client_socket) {
+    SSL* ssl;
+
+    /* Validate arguments */
+    if (ctx == NULL) {
+        fprintf(stderr, "SSL context is NULL\n");
+        return NULL;
+    }
+
+    if (client_socket < 0) {
+        fprintf(stderr, "Invalid client socket: %d\n", client_socket);
+        return NULL;
+    }
+
+    /* Create new SSL session from context */
+    ssl = SSL_new(ctx);
+    if (ssl == NULL) {
+        tls_print_errors("Failed to create SSL session");
+        return NULL;
+    }
+
+    /* Bind SSL session to socket file descriptor */
+    if (!SSL_set_fd(ssl, client_socket)) {
+        tls_print_errors("Failed to bind SSL to socket");
+        SSL_free(ssl);
+        return NULL;
+    }
+
+    /* Handshake is driven later by tls_session_handshake_step() */
+    SSL_set_accept_state(ssl);
+
+    return ssl;
+}
+
+int tls_session_handshake_step(SSL* ssl) {
+    int ret;
+    int ssl_error;
+
+    if (ssl == NULL) {
+        fprintf(stderr, "SSL session is NULL\n");
+        return E_INVALID_ARGUMENT;
+    }
+
+    ret = SSL_do_handshake(ssl);
+    if (ret == 1) {
+        return 0;
+    }
+
+    ssl_error = SSL_get_error(ssl, ret);
+    switch (ssl_error) {
+        case SSL_ERROR_WANT_READ:
+            return TLS_HANDSHAKE_WANT_READ;
+
+        case SSL_ERROR_WANT_WRITE:
+            return TLS_HANDSHAKE_WANT_WRITE;
+
+        case SSL_ERROR_ZERO_RETURN:
+            fprintf(stderr, "TLS handshake: connection closed by peer\n");
+            return E_NETWORK_ERROR;
+
+        case SSL_ERROR_SYSCALL:
+            tls_print_errors("TLS handshake: system call error");
+            return E_NETWORK_ERROR;
+
+        case SSL_ERROR_SSL:
+            tls_print_errors("TLS handshake: protocol error");
+            return E_TLS_HANDSHAKE_FAILED;
+
+        default:
+            tls_print_errors("TLS handshake: unknown error");
+            return E_UNKNOWN_ERROR;
+    }
+}
+
 int tls_session_shutdown(SSL* ssl) {
     int ret;
     int ssl_error;
@@ -107,6 +187,12 @@ int tls_session_shutdown(SSL* ssl) {
         return E_INVALID_ARGUMENT;
     }
 
+    /* Handshake never completed or session hit a fatal error: there is
+     * no established session to close (SSL_shutdown would only fail) */
+    if (SSL_in_init(ssl)) {
+        return 0;
+    }
+
     /* Send close_notify and wait for peer's close_notify */
     ret = SSL_shutdown(ssl);
 
@@ -123,9 +209,12 @@ int tls_session_shutdown(SSL* ssl) {
         /* If still not complete, that's OK - peer may have already closed */
         return 0;
     } else {
-        /* Error during shutdown - log but don't fail */
+        /* Error during shutdown - log but don't fail. WANT_READ/WANT_WRITE
+         * just mean a non-blocking socket was not ready. */
         ssl_error = SSL_get_error(ssl, ret);
-        if (ssl_error != SSL_ERROR_ZERO_RETURN) {
+        if (ssl_error != SSL_ERROR_ZERO_RETURN &&
+            ssl_error != SSL_ERROR_WANT_READ &&
+            ssl_error != SSL_ERROR_WANT_WRITE) {
             /* Not a clean shutdown, but not critical */
             tls_print_errors("TLS shutdown warning");
         }
@@ -133,6 +222,23 @@ int tls_session_shutdown(SSL* ssl) {
     }
 }
 
+/**
+ * @brief Offer the context's stored session on a new client connection
+ *
+ * Failure is harmless: the handshake simply runs in full.
+ */
+static void offer_stored_session(SSL_CTX* ctx, SSL* ssl) {
+    SSL_SESSION* session;
+
+    session = tls_context_take_session(ctx);
+    if (session != NULL) {
+        if (SSL_SESSION_is_resumable(session)) {
+            SSL_set_session(ssl, session);
+        }
+        SSL_SESSION_free(session);  /* SSL_set_session took its own reference */
+    }
+}
+
 SSL* tls_session_create_client(SSL_CTX* ctx, int server_socket) {
     SSL* ssl;
     int ret;
@@ -163,6 +269,8 @@ SSL* tls_session_create_client(SSL_CTX* ctx, int server_socket) {
         return NULL;
     }
 
+    offer_stored_session(ctx, ssl);
+
     /* Perform client-side TLS handshake */
     ret = SSL_connect(ssl);
     if (ret <= 0) {
@@ -251,6 +359,8 @@ SSL* tls_session_create_client_verified(SSL_CTX* ctx, int server_socket,
         return NULL;
     }
 
+    offer_stored_session(ctx, ssl);
+
     /* Perform client-side TLS handshake */
     ret = SSL_connect(ssl);
     if (ret <= 0) {
@@ -288,6 +398,174 @@ SSL* tls_session_create_client_verified(SSL_CTX* ctx, int server_socket,
     return ssl;
 }
 
+int tls_session_ktls_status(SSL* ssl) {
+    int status = 0;
+
+    if (ssl == NULL) {
+        return 0;
+    }
+
+#if defined(__linux__) && OPENSSL_VERSION_NUMBER >= 0x30000000L && \
+    !defined(OPENSSL_NO_KTLS)
+    if (BIO_get_ktls_send(SSL_get_wbio(ssl))) {
+        status |= TLS_KTLS_TX;
+    }
+    if (BIO_get_ktls_recv(SSL_get_rbio(ssl))) {
+        status |= TLS_KTLS_RX;
+    }
+#endif
+
+    return status;
+}
+
+int tls_session_is_resumed(SSL* ssl) {
+    if (ssl == NULL) {
+        return FALSE;
+    }
+    return SSL_session_reused(ssl) ? TRUE : FALSE;
+}
+
+/* ============================================================================
+ * DTLS
+ * ============================================================================ */
+
+long tls_session_dtls_timer(SSL* ssl) {
+    struct timeval left;
+
+    if (ssl == NULL || !DTLSv1_get_timeout(ssl, &left)) {
+        return -1;
+    }
+    if (left.tv_sec == 0 && left.tv_usec == 0) {
+        DTLSv1_handle_timeout(ssl);
+        if (!DTLSv1_get_timeout(ssl, &left)) {
+            return -1;
+        }
+    }
+    return (long)left.tv_sec * 1000 + (left.tv_usec + 999) / 1000;
+}
+
+SSL* tls_session_create_dtls_client(SSL_CTX* ctx, int server_socket,
+                                    int timeout_ms) {
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    struct pollfd pfd;
+    long long deadline;
+    long wait_ms;
+    BIO* bio;
+    SSL* ssl;
+    int result;
+
+    if (ctx == NULL || server_socket < 0 || timeout_ms <= 0) {
+        fprintf(stderr, "DTLS client: invalid argument\n");
+        return NULL;
+    }
+    if (getpeername(server_socket, (struct sockaddr*)&peer, &peer_len) != 0) {
+        perror("DTLS client: getpeername");
+        return NULL;
+    }
+
+    ssl = SSL_new(ctx);
+    bio = BIO_new_dgram(server_socket, BIO_NOCLOSE);
+    if (ssl == NULL || bio == NULL) {
+        tls_print_errors("Failed to create DTLS client session");
+        BIO_free(bio);
+        SSL_free(ssl);
+        return NULL;
+    }
+    BIO_ctrl(bio, BIO_CTRL_DGRAM_SET_CONNECTED, 0, &peer);
+    SSL_set_bio(ssl, bio, bio);
+    SSL_set_connect_state(ssl);
+
+    deadline = (long long)latency_now_ms() + timeout_ms;
+    for (;;) {
+        result = tls_session_handshake_step(ssl);
+        if (result == 0) {
+            return ssl;
+        }
+        if (result < 0) {
+            break;
+        }
+
+        wait_ms = (long)(deadline - (long long)latency_now_ms());
+        if (wait_ms <= 0) {
+            fprintf(stderr, "DTLS client handshake: timed out\n");
+            break;
+        }
+        result = (int)tls_session_dtls_timer(ssl);
+        if (result >= 0 && result < wait_ms) {
+            wait_ms = result;
+        }
+
+        pfd.fd = server_socket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (int)wait_ms) < 0 && errno != EINTR) {
+            perror("DTLS client handshake: poll");
+            break;
+        }
+        if (pfd.revents == 0) {
+            tls_session_dtls_timer(ssl);
+        }
+    }
+
+    SSL_free(ssl);
+    return NULL;
+}
+
+SSL* tls_session_dtls_listen(SSL_CTX* ctx, int listen_fd,
+                             struct sockaddr_in* peer) {
+    BIO_ADDR* client;
+    BIO* bio;
+    SSL* ssl;
+    int result;
+
+    if (ctx == NULL || listen_fd < 0 || peer == NULL) {
+        return NULL;
+    }
+
+    ssl = SSL_new(ctx);
+    bio = BIO_new_dgram(listen_fd, BIO_NOCLOSE);
+    client = BIO_ADDR_new();
+    if (ssl == NULL || bio == NULL || client == NULL) {
+        tls_print_errors("Failed to create DTLS listening session");
+        BIO_ADDR_free(client);
+        BIO_free(bio);
+        SSL_free(ssl);
+        return NULL;
+    }
+    SSL_set_bio(ssl, bio, bio);
+    SSL_set_options(ssl, SSL_OP_COOKIE_EXCHANGE);
+
+    result = DTLSv1_listen(ssl, client);
+    if (result <= 0 || BIO_ADDR_family(client) != AF_INET) {
+        /* Nothing queued, a cookie just sent, or garbage dropped */
+        ERR_clear_error();
+        BIO_ADDR_free(client);
+        SSL_free(ssl);
+        return NULL;
+    }
+
+    memset(peer, 0, sizeof(*peer));
+    peer->sin_family = AF_INET;
+    peer->sin_port = BIO_ADDR_rawport(client);
+    BIO_ADDR_rawaddress(client, &peer->sin_addr, NULL);
+    BIO_ADDR_free(client);
+    return ssl;
+}
+
+int tls_session_dtls_attach(SSL* ssl, int fd, const struct sockaddr_in* peer) {
+    BIO* bio;
+
+    if (ssl == NULL || fd < 0 || peer == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    bio = SSL_get_rbio(ssl);
+    BIO_set_fd(bio, fd, BIO_NOCLOSE);
+    BIO_ctrl(bio, BIO_CTRL_DGRAM_SET_CONNECTED, 0, (void*)peer);
+    return 0;
+}
+
 void tls_session_destroy(SSL* ssl) {
     if (ssl != NULL) {
         SSL_free(ssl);
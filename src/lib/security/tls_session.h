@@ -6,8 +6,9 @@
  * connection has its own SSL object that handles the TLS handshake and
  * encrypted I/O for that specific connection.
  *
- * Each SSL session is owned exclusively by a single client thread, so no
- * locking is required for SSL operations.
+ * Each SSL session is owned exclusively by a single thread (a client
+ * thread, or the server event loop worker that owns the connection), so
+ * no locking is required for SSL operations.
  */
 
 #ifndef TLS_SESSION_H
@@ -15,6 +16,8 @@
 
 #include "tls_types.h"
 
+#include <netinet/in.h>
+
 /**
  * @brief Create a new TLS session for a client connection
  *
@@ -53,6 +56,36 @@ SSL* tls_session_create(SSL_CTX* ctx, int client_socket);
  */
 int tls_session_handshake(SSL* ssl);
 
+/* Return values of tls_session_handshake_step() while still in progress */
+#define TLS_HANDSHAKE_WANT_READ  1  /* Wait for socket readable, then retry */
+#define TLS_HANDSHAKE_WANT_WRITE 2  /* Wait for socket writable, then retry */
+
+/**
+ * @brief Create a server-side TLS session without performing the handshake
+ *
+ * Creates an SSL object bound to the client socket and puts it in accept
+ * state. Intended for non-blocking sockets driven by an event loop: the
+ * caller drives the handshake with tls_session_handshake_step() each time
+ * the socket becomes ready.
+ *
+ * @param ctx           Global SSL context (from tls_context_init)
+ * @param client_socket Client socket file descriptor (typically O_NONBLOCK)
+ * @return SSL* on success, NULL on failure
+ */
+SSL* tls_session_create_deferred(SSL_CTX* ctx, int client_socket);
+
+/**
+ * @brief Advance a non-blocking server-side TLS handshake
+ *
+ * Calls SSL_do_handshake() once. Never blocks on a non-blocking socket.
+ *
+ * @param ssl SSL session object from tls_session_create_deferred()
+ * @return 0 when the handshake has completed,
+ *         TLS_HANDSHAKE_WANT_READ or TLS_HANDSHAKE_WANT_WRITE to retry later,
+ *         negative error code on failure
+ */
+int tls_session_handshake_step(SSL* ssl);
+
 /**
  * @brief Gracefully shutdown TLS session
  *
@@ -73,8 +106,8 @@ int tls_session_shutdown(SSL* ssl);
  * @brief Create a new TLS session for client-side connection
  *
  * Creates an SSL object from the client context, associates it with the
- * server socket, and performs the client-side TLS handshake.
- * This is a blocking operation that will wait for the server to complete the handshake.
+ * server socket, and performs the client-side TLS handshake, offering the
+ * context's stored session for resumption. This is a blocking operation that will wait for the server to complete the handshake.
  *
  * On success, returns an SSL object ready for encrypted I/O.
  * On failure, returns NULL and the socket should be closed.
@@ -98,7 +131,8 @@ SSL* tls_session_create_client(SSL_CTX* ctx, int server_socket);
  *
  * Creates an SSL object from the client context, associates it with the
  * server socket, enables hostname verification, and performs the client-side
- * TLS handshake. This is the recommended function for production use.
+ * TLS handshake (resuming the stored session when the server accepts it).
+ * This is the recommended function for production use.
  *
  * Hostname verification ensures the server certificate matches the expected
  * hostname, preventing man-in-the-middle attacks.
@@ -119,6 +153,86 @@ SSL* tls_session_create_client(SSL_CTX* ctx, int server_socket);
 SSL* tls_session_create_client_verified(SSL_CTX* ctx, int server_socket,
                                         const char* hostname);
 
+/**
+ * @brief Create a DTLS client session and complete its handshake
+ *
+ * Drives the handshake on a connected, non-blocking UDP socket, resending
+ * flights on the DTLS retransmit timer, until it completes or
+ * @p timeout_ms expires.
+ *
+ * @param ctx           Client DTLS context (from tls_context_init_dtls_client)
+ * @param server_socket Connected non-blocking UDP socket
+ * @param timeout_ms    Handshake deadline
+ * @return SSL* on success, NULL on failure or timeout
+ */
+SSL* tls_session_create_dtls_client(SSL_CTX* ctx, int server_socket,
+                                    int timeout_ms);
+
+/**
+ * @brief Answer one client on a DTLS listening socket
+ *
+ * Runs DTLSv1_listen() on the non-blocking, unconnected @p listen_fd:
+ * ClientHellos without a valid cookie get a HelloVerifyRequest and are
+ * forgotten. Once a client returns its cookie, the session is handed to
+ * the caller in the accepting state; it still reads from @p listen_fd
+ * until moved to a socket of its own with tls_session_dtls_attach().
+ *
+ * @param ctx       Server DTLS context (from tls_context_init_dtls)
+ * @param listen_fd UDP socket bound to the server port
+ * @param peer      Output: the client's address
+ * @return SSL* for a verified client, NULL if none is ready
+ */
+SSL* tls_session_dtls_listen(SSL_CTX* ctx, int listen_fd,
+                             struct sockaddr_in* peer);
+
+/**
+ * @brief Move a listened DTLS session to a socket connected to its peer
+ *
+ * @param ssl   Session from tls_session_dtls_listen()
+ * @param fd    UDP socket bound to the server port and connected to @p peer
+ * @param peer  The client's address
+ * @return 0 on success, E_INVALID_ARGUMENT
+ */
+int tls_session_dtls_attach(SSL* ssl, int fd, const struct sockaddr_in* peer);
+
+/**
+ * @brief Service the DTLS retransmit timer of a handshake in progress
+ *
+ * Resends the last flight if the timer has expired.
+ *
+ * @param ssl DTLS session
+ * @return Milliseconds until the timer expires, -1 if none runs
+ */
+long tls_session_dtls_timer(SSL* ssl);
+
+/* tls_session_ktls_status() flags */
+#define TLS_KTLS_TX 0x01  /* Kernel encrypts sent records */
+#define TLS_KTLS_RX 0x02  /* Kernel decrypts received records */
+
+/**
+ * @brief Report which directions of a session run in kernel TLS
+ *
+ * With TLS_KTLS_TX set, plain send()/sendmsg() on the socket produce
+ * application data records, so callers may bypass SSL_write(). Receiving
+ * still goes through SSL_read(), which handles non-data records.
+ *
+ * @param ssl SSL session object after a completed handshake
+ * @return Bitmask of TLS_KTLS_TX and TLS_KTLS_RX (0 if none or ssl is NULL)
+ */
+int tls_session_ktls_status(SSL* ssl);
+
+/**
+ * @brief Check whether a session was resumed rather than fully negotiated
+ *
+ * Client sessions offer the context's stored session (see
+ * tls_context_take_session), so a reconnect to the same server skips the
+ * certificate exchange when the server still accepts it.
+ *
+ * @param ssl SSL session object after a completed handshake
+ * @return TRUE if resumed, FALSE otherwise (or if ssl is NULL)
+ */
+int tls_session_is_resumed(SSL* ssl);
+
 /**
  * @brief Destroy TLS session and free resources
  *
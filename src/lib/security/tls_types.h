@@ -3,7 +3,7 @@
  * @brief Common forward declarations for OpenSSL types
  *
  * This header provides C89-compatible forward declarations for OpenSSL
- * types (SSL and SSL_CTX) to avoid redefinition warnings when multiple
+ * types (SSL, SSL_CTX and SSL_SESSION) to avoid redefinition warnings when multiple
  * TLS module headers are included.
  *
  * All TLS-related headers should include this file instead of declaring
@@ -23,6 +23,7 @@
 #ifndef OPENSSL_SSL_H
 typedef struct ssl_st SSL;
 typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_session_st SSL_SESSION;
 #endif
 
 #endif /* TLS_TYPES_H */
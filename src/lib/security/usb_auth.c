@@ -12,10 +12,14 @@
 #include "lib/common/definitions.h"
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
+#include <openssl/rand.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <fcntl.h>
-#include <unistd.h>
 #include <time.h>
 
 /* USB device class constants (duplicated here to avoid circular includes) */
@@ -35,30 +39,32 @@ static void secure_zero(void* ptr, size_t len)
 }
 
 /**
- * @brief Generate cryptographically secure random bytes
+ * @brief HMAC keyed with one shared secret, ready to be copied
  */
-static int generate_random_bytes(uint8_t* buffer, size_t len)
-{
-    int fd = -1;
-    ssize_t bytes_read = 0;
-    size_t total_read = 0;
-
-    fd = open("/dev/urandom", O_RDONLY);
-    if (fd < 0) {
-        return E_UNKNOWN_ERROR;
-    }
+struct usb_auth_key {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX* ctx;
+#else
+    HMAC_CTX* ctx;
+#endif
+};
 
-    while (total_read < len) {
-        bytes_read = read(fd, buffer + total_read, len - total_read);
-        if (bytes_read <= 0) {
-            close(fd);
-            return E_UNKNOWN_ERROR;
-        }
-        total_read += (size_t)bytes_read;
-    }
-
-    close(fd);
-    return 0;
+/**
+ * @brief Build the authenticated message
+ *
+ * challenge || device_id (4 bytes BE) || device_class (1 byte)
+ */
+static void build_message(unsigned char* message,
+                          const uint8_t* challenge,
+                          uint32_t device_id,
+                          uint8_t device_class)
+{
+    memcpy(message, challenge, USB_AUTH_CHALLENGE_LEN);
+    message[USB_AUTH_CHALLENGE_LEN + 0] = (uint8_t)((device_id >> 24) & 0xFF);
+    message[USB_AUTH_CHALLENGE_LEN + 1] = (uint8_t)((device_id >> 16) & 0xFF);
+    message[USB_AUTH_CHALLENGE_LEN + 2] = (uint8_t)((device_id >> 8) & 0xFF);
+    message[USB_AUTH_CHALLENGE_LEN + 3] = (uint8_t)(device_id & 0xFF);
+    message[USB_AUTH_CHALLENGE_LEN + 4] = device_class;
 }
 
 /**
@@ -82,7 +88,12 @@ int usb_auth_generate_challenge(uint8_t* challenge)
         return E_INVALID_ARGUMENT;
     }
 
-    return generate_random_bytes(challenge, USB_AUTH_CHALLENGE_LEN);
+    /* OpenSSL's CSPRNG (seeded from the OS): no file opened per nonce */
+    if (RAND_bytes(challenge, USB_AUTH_CHALLENGE_LEN) != 1) {
+        return E_UNKNOWN_ERROR;
+    }
+
+    return 0;
 }
 
 int usb_auth_compute_response(const char* secret,
@@ -105,13 +116,7 @@ int usb_auth_compute_response(const char* secret,
         return E_INVALID_ARGUMENT;
     }
 
-    /* Build message: challenge || device_id (4 bytes BE) || device_class (1 byte) */
-    memcpy(message, challenge, USB_AUTH_CHALLENGE_LEN);
-    message[USB_AUTH_CHALLENGE_LEN + 0] = (uint8_t)((device_id >> 24) & 0xFF);
-    message[USB_AUTH_CHALLENGE_LEN + 1] = (uint8_t)((device_id >> 16) & 0xFF);
-    message[USB_AUTH_CHALLENGE_LEN + 2] = (uint8_t)((device_id >> 8) & 0xFF);
-    message[USB_AUTH_CHALLENGE_LEN + 3] = (uint8_t)(device_id & 0xFF);
-    message[USB_AUTH_CHALLENGE_LEN + 4] = device_class;
+    build_message(message, challenge, device_id, device_class);
 
     /* Compute HMAC-SHA256 */
     result = HMAC(EVP_sha256(),
@@ -161,6 +166,147 @@ int usb_auth_verify_response(const char* secret,
     return match;
 }
 
+usb_auth_key_t* usb_auth_key_create(const char* secret)
+{
+    usb_auth_key_t* key;
+    size_t secret_len;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[2];
+    EVP_MAC* mac;
+#endif
+
+    if (secret == NULL) {
+        return NULL;
+    }
+    secret_len = strlen(secret);
+    if (secret_len == 0) {
+        return NULL;
+    }
+
+    key = (usb_auth_key_t*)calloc(1, sizeof(*key));
+    if (key == NULL) {
+        return NULL;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+    if (mac != NULL) {
+        key->ctx = EVP_MAC_CTX_new(mac);
+        EVP_MAC_free(mac);  /* The context keeps its own reference */
+    }
+    params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 (char*)"SHA256", 0);
+    params[1] = OSSL_PARAM_construct_end();
+    if (key->ctx == NULL ||
+        !EVP_MAC_init(key->ctx, (const unsigned char*)secret, secret_len,
+                      params)) {
+        usb_auth_key_free(key);
+        return NULL;
+    }
+#else
+    key->ctx = HMAC_CTX_new();
+    if (key->ctx == NULL ||
+        !HMAC_Init_ex(key->ctx, secret, (int)secret_len, EVP_sha256(), NULL)) {
+        usb_auth_key_free(key);
+        return NULL;
+    }
+#endif
+
+    return key;
+}
+
+void usb_auth_key_free(usb_auth_key_t* key)
+{
+    if (key == NULL) {
+        return;
+    }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(key->ctx);
+#else
+    HMAC_CTX_free(key->ctx);
+#endif
+    free(key);
+}
+
+int usb_auth_key_compute(const usb_auth_key_t* key,
+                         const uint8_t* challenge,
+                         uint32_t device_id,
+                         uint8_t device_class,
+                         uint8_t* response_out)
+{
+    unsigned char message[USB_AUTH_CHALLENGE_LEN + 5];
+    int ok = 0;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX* ctx;
+    size_t hmac_len = 0;
+#else
+    HMAC_CTX* ctx;
+    unsigned int hmac_len = 0;
+#endif
+
+    if (key == NULL || challenge == NULL || response_out == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    build_message(message, challenge, device_id, device_class);
+
+    /* Copy the keyed state; the shared context is never written */
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    ctx = EVP_MAC_CTX_dup(key->ctx);
+    if (ctx != NULL) {
+        ok = EVP_MAC_update(ctx, message, sizeof(message)) &&
+             EVP_MAC_final(ctx, response_out, &hmac_len,
+                           USB_AUTH_RESPONSE_LEN);
+        EVP_MAC_CTX_free(ctx);
+    }
+#else
+    ctx = HMAC_CTX_new();
+    if (ctx != NULL) {
+        ok = HMAC_CTX_copy(ctx, key->ctx) &&
+             HMAC_Update(ctx, message, sizeof(message)) &&
+             HMAC_Final(ctx, response_out, &hmac_len);
+        HMAC_CTX_free(ctx);
+    }
+#endif
+
+    secure_zero(message, sizeof(message));
+
+    if (!ok || hmac_len != USB_AUTH_RESPONSE_LEN) {
+        return E_UNKNOWN_ERROR;
+    }
+
+    return 0;
+}
+
+int usb_auth_key_verify(const usb_auth_key_t* key,
+                        const uint8_t* challenge,
+                        uint32_t device_id,
+                        uint8_t device_class,
+                        const uint8_t* client_response)
+{
+    uint8_t expected_response[USB_AUTH_RESPONSE_LEN];
+    int result = 0;
+    int match = 0;
+
+    if (key == NULL || challenge == NULL || client_response == NULL) {
+        return E_INVALID_ARGUMENT;
+    }
+
+    result = usb_auth_key_compute(key, challenge, device_id, device_class,
+                                  expected_response);
+    if (result != 0) {
+        secure_zero(expected_response, sizeof(expected_response));
+        return result;
+    }
+
+    match = constant_time_compare(expected_response, client_response,
+                                  USB_AUTH_RESPONSE_LEN);
+    secure_zero(expected_response, sizeof(expected_response));
+
+    return match;
+}
+
 int usb_auth_check_class_whitelist(uint8_t device_class,
                                    const uint8_t* allowed_classes,
                                    int allowed_count)
@@ -38,11 +38,22 @@ typedef struct {
 /* Wire size for validation */
 #define USB_AUTH_PAYLOAD_WIRE_SIZE 72
 
+/**
+ * @brief HMAC-SHA256 keyed with a shared secret
+ *
+ * Keying the HMAC hashes the secret into the inner and outer pads; a key
+ * object does that once, and each computation starts from a copy of the
+ * keyed state. Servers keep one per configured secret so a registration
+ * storm costs two hash passes per device, not a rekey each time. The
+ * object is only read after creation and may be shared by threads.
+ */
+typedef struct usb_auth_key usb_auth_key_t;
+
 /**
  * @brief Generate random authentication challenge
  *
  * Generates a cryptographically secure 32-byte random nonce
- * using /dev/urandom.
+ * from OpenSSL's CSPRNG (seeded by the operating system).
  *
  * @param challenge  Output buffer (must be USB_AUTH_CHALLENGE_LEN bytes)
  * @return 0 on success, negative error code on failure
@@ -86,6 +97,53 @@ int usb_auth_verify_response(const char* secret,
                              uint8_t device_class,
                              const uint8_t* client_response);
 
+/**
+ * @brief Key an HMAC with a shared secret
+ *
+ * @param secret Shared secret string (non-empty)
+ * @return Key object, or NULL on failure; free with usb_auth_key_free()
+ */
+usb_auth_key_t* usb_auth_key_create(const char* secret);
+
+/**
+ * @brief Free a key object
+ *
+ * @param key Key (may be NULL)
+ */
+void usb_auth_key_free(usb_auth_key_t* key);
+
+/**
+ * @brief usb_auth_compute_response() with a prepared key
+ *
+ * @param key          Key from usb_auth_key_create()
+ * @param challenge    32-byte challenge
+ * @param device_id    USB device identifier (VID:PID)
+ * @param device_class USB device class code
+ * @param response_out Output buffer (must be USB_AUTH_RESPONSE_LEN bytes)
+ * @return 0 on success, negative error code on failure
+ */
+int usb_auth_key_compute(const usb_auth_key_t* key,
+                         const uint8_t* challenge,
+                         uint32_t device_id,
+                         uint8_t device_class,
+                         uint8_t* response_out);
+
+/**
+ * @brief usb_auth_verify_response() with a prepared key
+ *
+ * @param key             Key from usb_auth_key_create()
+ * @param challenge       32-byte challenge that was sent
+ * @param device_id       USB device identifier
+ * @param device_class    USB device class code
+ * @param client_response 32-byte response from client
+ * @return 1 if valid, 0 if invalid, negative on error
+ */
+int usb_auth_key_verify(const usb_auth_key_t* key,
+                        const uint8_t* challenge,
+                        uint32_t device_id,
+                        uint8_t device_class,
+                        const uint8_t* client_response);
+
 /**
  * @brief Check if device class is allowed by whitelist
  *
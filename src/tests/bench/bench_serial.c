@@ -0,0 +1,914 @@
+/**
+ * @file bench_serial.c
+ * @brief Serial bridge benchmark over pty pairs and a loopback server
+ *
+ * Each case runs a real serial_client_t against the slave side of an
+ * openpty() pair while the benchmark plays both the serial device (the
+ * pty master) and the XOE server (a loopback TCP peer). With TLS on, a
+ * relay thread terminates the client's plain TCP connection and carries
+ * it to the server over TLS, as a TLS front end would in deployment.
+ *
+ * Reported per case:
+ *   - throughput serial→network and network→serial (bytes/s),
+ *   - round-trip latency percentiles for short echoed messages,
+ *   - process CPU time per MB moved during the throughput phases.
+ *
+ * A pty does not pace bytes at the baud rate, so throughput measures
+ * the bridge itself; the baud rate still selects the read timing (idle
+ * gap, read size) the client uses.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/serial/serial_client.h"
+#include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_port.h"
+#include "connectors/serial/serial_protocol.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/security/tls_config.h"
+#include "lib/security/tls_context.h"
+#include "lib/security/tls_session.h"
+#include "lib/security/tls_io.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+
+#if defined(__APPLE__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#include <util.h>
+#elif defined(__FreeBSD__)
+#include <libutil.h>
+#else
+#include <pty.h>
+#endif
+
+/* Defaults (overridable on the command line) */
+#define BENCH_DEFAULT_BYTES (2 * 1024 * 1024)
+#define BENCH_DEFAULT_SAMPLES 200
+#define BENCH_MAX_SAMPLES 100000
+
+/* Round-trip message size */
+#define BENCH_PING_SIZE 16
+
+/* Per-operation timeout; a stalled case fails instead of hanging */
+#define BENCH_IO_TIMEOUT_MS 5000
+
+/* Pty master write size for the serial→network stream */
+#define BENCH_WRITE_SIZE 4096
+
+#define BENCH_CERT_FILE "./certs/server.crt"
+#define BENCH_KEY_FILE "./certs/server.key"
+
+/* ============================================================================
+ * Benchmark Matrix
+ * ============================================================================ */
+
+static const int bench_bauds[] = { 9600, 115200, 230400 };
+static const int bench_chunks[] = { 64, SERIAL_COALESCE_MAX_BYTES };
+
+#define BENCH_COUNT(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+typedef struct {
+    int baud_rate;
+    int chunk_bytes;
+    int use_tls;
+} bench_case_t;
+
+typedef struct {
+    double s2n_bytes_per_sec;
+    double n2s_bytes_per_sec;
+    long p50_us;
+    long p90_us;
+    long p99_us;
+    long max_us;
+    double cpu_ms_per_mb;
+} bench_result_t;
+
+/* ============================================================================
+ * Rig: pty device, loopback server, optional TLS relay, serial client
+ * ============================================================================ */
+
+typedef struct {
+    int plain_fd;                 /* Relay end of the client's TCP link */
+    int tls_fd;                   /* Relay end of the TLS link */
+    SSL_CTX* ctx;
+    int handshake_result;         /* 0 once the TLS session is up */
+} bench_relay_t;
+
+typedef struct {
+    int master_fd;                /* Pty master: the serial device */
+    int slave_fd;                 /* Held open so the pty stays up */
+    int client_fd;                /* Handed to the serial client */
+    int server_fd;                /* Benchmark's server end */
+    SSL* server_ssl;              /* Non-NULL with TLS on */
+    bench_relay_t relay;
+    pthread_t relay_thread;
+    int relay_started;
+    serial_client_t* client;
+} bench_rig_t;
+
+static SSL_CTX* g_server_ctx = NULL;
+static SSL_CTX* g_client_ctx = NULL;
+
+static long now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+static double cpu_seconds(void) {
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    return (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * @brief Connect to a loopback listener and accept the other end
+ */
+static int bench_tcp_pair(int listen_fd, int* connect_fd, int* accept_fd) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd;
+
+    if (getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) != 0) {
+        return E_NETWORK_ERROR;
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return E_NETWORK_ERROR;
+    }
+    if (connect(fd, (struct sockaddr*)&addr, addr_len) != 0) {
+        close(fd);
+        return E_NETWORK_ERROR;
+    }
+
+    *accept_fd = accept(listen_fd, NULL, NULL);
+    if (*accept_fd < 0) {
+        close(fd);
+        return E_NETWORK_ERROR;
+    }
+    *connect_fd = fd;
+    return 0;
+}
+
+static int bench_listen(void) {
+    struct sockaddr_in addr;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 4) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void set_recv_timeout(int fd, int timeout_ms) {
+    struct timeval tv;
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+static int write_all(int fd, const void* data, int len) {
+    const unsigned char* p = (const unsigned char*)data;
+    int done = 0;
+    ssize_t n;
+
+    while (done < len) {
+        n = write(fd, p + done, (size_t)(len - done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return E_NETWORK_ERROR;
+        }
+        done += (int)n;
+    }
+    return 0;
+}
+
+static int tls_write_all(SSL* ssl, const void* data, int len) {
+    const unsigned char* p = (const unsigned char*)data;
+    int done = 0;
+    int n;
+
+    while (done < len) {
+        n = tls_write(ssl, p + done, len - done);
+        if (n <= 0) {
+            return E_NETWORK_ERROR;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief TLS relay: plain TCP from the client <-> TLS to the server
+ *
+ * One thread serves both directions so the SSL object is never used
+ * concurrently. Exits when either side closes.
+ */
+static void* bench_relay_thread(void* arg) {
+    bench_relay_t* relay = (bench_relay_t*)arg;
+    unsigned char buffer[16384];
+    fd_set read_fds;
+    SSL* ssl;
+    int max_fd;
+    int n;
+
+    ssl = tls_session_create_client(relay->ctx, relay->tls_fd);
+    relay->handshake_result = (ssl != NULL) ? 0 : E_NETWORK_ERROR;
+    if (ssl == NULL) {
+        shutdown(relay->plain_fd, SHUT_RDWR);
+        return NULL;
+    }
+
+    /*
+     * A readable socket may carry only TLS 1.3 session tickets; without
+     * this, SSL_read() would block for application data behind them.
+     */
+    SSL_clear_mode(ssl, SSL_MODE_AUTO_RETRY);
+
+    max_fd = (relay->plain_fd > relay->tls_fd) ? relay->plain_fd : relay->tls_fd;
+    for (;;) {
+        FD_ZERO(&read_fds);
+        FD_SET(relay->plain_fd, &read_fds);
+        FD_SET(relay->tls_fd, &read_fds);
+
+        /* Decrypted bytes may already be buffered inside OpenSSL */
+        if (SSL_pending(ssl) == 0 &&
+            select(max_fd + 1, &read_fds, NULL, NULL, NULL) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (SSL_pending(ssl) > 0 || FD_ISSET(relay->tls_fd, &read_fds)) {
+            n = SSL_read(ssl, buffer, sizeof(buffer));
+            if (n <= 0) {
+                if (SSL_get_error(ssl, n) != SSL_ERROR_WANT_READ) {
+                    break;
+                }
+            } else if (write_all(relay->plain_fd, buffer, n) != 0) {
+                break;
+            }
+        }
+        if (FD_ISSET(relay->plain_fd, &read_fds)) {
+            n = (int)read(relay->plain_fd, buffer, sizeof(buffer));
+            if (n <= 0 || tls_write_all(ssl, buffer, n) != 0) {
+                break;
+            }
+        }
+    }
+
+    /* Closing the client's link makes its network thread exit */
+    shutdown(relay->plain_fd, SHUT_RDWR);
+    tls_session_destroy(ssl);
+    return NULL;
+}
+
+static void bench_rig_close(bench_rig_t* rig) {
+    /* Drop the server first so the client's network thread sees EOF */
+    if (rig->server_fd >= 0) {
+        shutdown(rig->server_fd, SHUT_RDWR);
+    }
+    if (rig->relay_started) {
+        pthread_join(rig->relay_thread, NULL);
+        rig->relay_started = FALSE;
+    }
+    if (rig->client != NULL) {
+        serial_client_stop(rig->client);
+        serial_client_cleanup(&rig->client);
+    }
+    if (rig->server_ssl != NULL) {
+        tls_session_destroy(rig->server_ssl);
+    }
+    if (rig->server_fd >= 0) {
+        close(rig->server_fd);
+    }
+    if (rig->relay.plain_fd >= 0) {
+        close(rig->relay.plain_fd);
+    }
+    if (rig->relay.tls_fd >= 0) {
+        close(rig->relay.tls_fd);
+    }
+    if (rig->client_fd >= 0) {
+        close(rig->client_fd);
+    }
+    if (rig->master_fd >= 0) {
+        close(rig->master_fd);
+    }
+    if (rig->slave_fd >= 0) {
+        close(rig->slave_fd);
+    }
+}
+
+static int bench_rig_open(bench_rig_t* rig, const bench_case_t* bench_case) {
+    serial_config_t config;
+    char* slave_name;
+    int listen_fd;
+    int result;
+
+    memset(rig, 0, sizeof(*rig));
+    rig->master_fd = rig->slave_fd = rig->client_fd = rig->server_fd = -1;
+    rig->relay.plain_fd = rig->relay.tls_fd = -1;
+
+    if (openpty(&rig->master_fd, &rig->slave_fd, NULL, NULL, NULL) != 0) {
+        fprintf(stderr, "openpty failed: %s\n", strerror(errno));
+        return E_UNKNOWN_ERROR;
+    }
+    slave_name = ttyname(rig->slave_fd);
+    if (slave_name == NULL) {
+        bench_rig_close(rig);
+        return E_UNKNOWN_ERROR;
+    }
+
+    listen_fd = bench_listen();
+    if (listen_fd < 0) {
+        bench_rig_close(rig);
+        return E_NETWORK_ERROR;
+    }
+
+    if (!bench_case->use_tls) {
+        result = bench_tcp_pair(listen_fd, &rig->client_fd, &rig->server_fd);
+    } else {
+        result = bench_tcp_pair(listen_fd, &rig->client_fd, &rig->relay.plain_fd);
+        if (result == 0) {
+            result = bench_tcp_pair(listen_fd, &rig->relay.tls_fd, &rig->server_fd);
+        }
+        if (result == 0) {
+            rig->relay.ctx = g_client_ctx;
+            if (pthread_create(&rig->relay_thread, NULL, bench_relay_thread,
+                               &rig->relay) != 0) {
+                result = E_UNKNOWN_ERROR;
+            } else {
+                rig->relay_started = TRUE;
+                rig->server_ssl = tls_session_create(g_server_ctx, rig->server_fd);
+                if (rig->server_ssl == NULL) {
+                    result = E_NETWORK_ERROR;
+                }
+            }
+        }
+    }
+    close(listen_fd);
+    if (result != 0) {
+        bench_rig_close(rig);
+        return result;
+    }
+    set_recv_timeout(rig->server_fd, BENCH_IO_TIMEOUT_MS);
+
+    serial_config_init_defaults(&config);
+    strncpy(config.device_path, slave_name, SERIAL_DEVICE_PATH_MAX - 1);
+    config.baud_rate = bench_case->baud_rate;
+    config.coalesce_bytes = bench_case->chunk_bytes;
+
+    rig->client = serial_client_init(&config, rig->client_fd);
+    if (rig->client == NULL) {
+        bench_rig_close(rig);
+        return E_UNKNOWN_ERROR;
+    }
+    if (serial_client_start(rig->client) != 0) {
+        bench_rig_close(rig);
+        return E_UNKNOWN_ERROR;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Server-Side Frame I/O
+ * ============================================================================ */
+
+static int bench_send_data(bench_rig_t* rig, const void* data, int len,
+                           uint16_t sequence) {
+    xoe_packet_t packet;
+    int result;
+
+    result = serial_protocol_encapsulate(data, (uint32_t)len, sequence, 0, &packet);
+    if (result != 0) {
+        return result;
+    }
+    if (rig->server_ssl != NULL) {
+        result = xoe_wire_send_tls(rig->server_ssl, &packet);
+    } else {
+        result = xoe_wire_send(rig->server_fd, &packet);
+    }
+    serial_protocol_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Receive the next data frame's bytes (control frames skipped)
+ *
+ * @return Bytes stored, or negative error code
+ */
+static int bench_recv_data(bench_rig_t* rig, void* data, int max_len) {
+    xoe_packet_t packet;
+    uint32_t actual_len;
+    uint16_t sequence;
+    uint16_t flags;
+    int result;
+
+    for (;;) {
+        if (rig->server_ssl != NULL) {
+            result = xoe_wire_recv_tls(rig->server_ssl, &packet);
+        } else {
+            result = xoe_wire_recv(rig->server_fd, &packet);
+        }
+        if (result != 0) {
+            return result;
+        }
+
+        /* The wire CRC covers the length field; decapsulate checks payload CRC */
+        packet.checksum = serial_protocol_checksum(&packet);
+        result = serial_protocol_decapsulate(&packet, data, (uint32_t)max_len,
+                                             &actual_len, &sequence, &flags);
+        xoe_wire_free_payload(&packet);
+        if (result != 0) {
+            return result;
+        }
+        if (actual_len > 0) {
+            return (int)actual_len;
+        }
+    }
+}
+
+/**
+ * @brief Read exactly len bytes from the pty master
+ */
+static int master_read_all(int fd, void* data, int len) {
+    unsigned char* p = (unsigned char*)data;
+    struct pollfd pfd;
+    int done = 0;
+    ssize_t n;
+
+    while (done < len) {
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, BENCH_IO_TIMEOUT_MS) <= 0) {
+            return E_TIMEOUT;
+        }
+        n = read(fd, p + done, (size_t)(len - done));
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return E_NETWORK_ERROR;
+        }
+        if (n == 0) {
+            return E_NETWORK_ERROR;
+        }
+        done += (int)n;
+    }
+    return 0;
+}
+
+static unsigned char pattern_byte(long offset) {
+    return (unsigned char)((offset * 31) % 251);
+}
+
+static void fill_pattern(unsigned char* data, int len, long offset) {
+    int i;
+
+    for (i = 0; i < len; i++) {
+        data[i] = pattern_byte(offset + i);
+    }
+}
+
+static int check_pattern(const unsigned char* data, int len, long offset) {
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (data[i] != pattern_byte(offset + i)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* ============================================================================
+ * Phases
+ * ============================================================================ */
+
+static int compare_long(const void* a, const void* b) {
+    long la = *(const long*)a;
+    long lb = *(const long*)b;
+
+    return (la > lb) - (la < lb);
+}
+
+static long percentile(const long* sorted, int count, int pct) {
+    int index = (count * pct + 99) / 100 - 1;
+
+    if (index < 0) {
+        index = 0;
+    }
+    return sorted[index];
+}
+
+/**
+ * @brief Serial → server → serial echo of short messages
+ */
+static int bench_latency(bench_rig_t* rig, int samples, bench_result_t* result) {
+    unsigned char message[BENCH_PING_SIZE];
+    unsigned char echo[SERIAL_MAX_PAYLOAD_SIZE];
+    long* rtt;
+    long start;
+    int received;
+    int n;
+    int i;
+
+    rtt = (long*)malloc((size_t)samples * sizeof(long));
+    if (rtt == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < samples; i++) {
+        fill_pattern(message, BENCH_PING_SIZE, i);
+        start = now_us();
+        if (write_all(rig->master_fd, message, BENCH_PING_SIZE) != 0) {
+            free(rtt);
+            return E_NETWORK_ERROR;
+        }
+
+        /* The client may split a message; gather it before echoing */
+        for (received = 0; received < BENCH_PING_SIZE; received += n) {
+            n = bench_recv_data(rig, echo + received, (int)sizeof(echo) - received);
+            if (n < 0) {
+                free(rtt);
+                return n;
+            }
+        }
+        if (received != BENCH_PING_SIZE ||
+            bench_send_data(rig, echo, received, (uint16_t)i) != 0 ||
+            master_read_all(rig->master_fd, echo, BENCH_PING_SIZE) != 0 ||
+            memcmp(echo, message, BENCH_PING_SIZE) != 0) {
+            free(rtt);
+            return E_NETWORK_ERROR;
+        }
+        rtt[i] = now_us() - start;
+    }
+
+    qsort(rtt, (size_t)samples, sizeof(long), compare_long);
+    result->p50_us = percentile(rtt, samples, 50);
+    result->p90_us = percentile(rtt, samples, 90);
+    result->p99_us = percentile(rtt, samples, 99);
+    result->max_us = rtt[samples - 1];
+    free(rtt);
+    return 0;
+}
+
+typedef struct {
+    bench_rig_t* rig;
+    long total;
+    int chunk;
+    int stop;                     /* Set by the reader to abandon the stream */
+    int result;
+} bench_stream_t;
+
+/**
+ * @brief Write to the pty master, giving up once the stream is stopped
+ */
+static int master_write_all(bench_stream_t* stream, const unsigned char* data,
+                            int len) {
+    struct pollfd pfd;
+    int done = 0;
+    ssize_t n;
+
+    while (done < len) {
+        if (__atomic_load_n(&stream->stop, __ATOMIC_ACQUIRE)) {
+            return E_INVALID_STATE;
+        }
+        pfd.fd = stream->rig->master_fd;
+        pfd.events = POLLOUT;
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        n = write(stream->rig->master_fd, data + done, (size_t)(len - done));
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return E_NETWORK_ERROR;
+        }
+        done += (int)n;
+    }
+    return 0;
+}
+
+static void* bench_master_writer(void* arg) {
+    bench_stream_t* stream = (bench_stream_t*)arg;
+    unsigned char data[BENCH_WRITE_SIZE];
+    long offset;
+    int len;
+
+    stream->result = 0;
+    for (offset = 0; offset < stream->total; offset += len) {
+        len = (stream->total - offset > BENCH_WRITE_SIZE) ?
+              BENCH_WRITE_SIZE : (int)(stream->total - offset);
+        fill_pattern(data, len, offset);
+        if (master_write_all(stream, data, len) != 0) {
+            stream->result = E_NETWORK_ERROR;
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void* bench_server_writer(void* arg) {
+    bench_stream_t* stream = (bench_stream_t*)arg;
+    unsigned char data[SERIAL_MAX_PAYLOAD_SIZE];
+    uint16_t sequence = 0;
+    long offset;
+    int len;
+
+    stream->result = 0;
+    for (offset = 0; offset < stream->total; offset += len) {
+        len = (stream->total - offset > stream->chunk) ?
+              stream->chunk : (int)(stream->total - offset);
+        fill_pattern(data, len, offset);
+        if (bench_send_data(stream->rig, data, len, sequence++) != 0) {
+            stream->result = E_NETWORK_ERROR;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Stream total bytes pty master → client → server
+ */
+static int bench_serial_to_net(bench_rig_t* rig, long total, double* bytes_per_sec) {
+    unsigned char data[SERIAL_MAX_PAYLOAD_SIZE];
+    bench_stream_t stream;
+    pthread_t writer;
+    long received = 0;
+    long start;
+    long elapsed;
+    int n;
+
+    stream.rig = rig;
+    stream.total = total;
+    stream.chunk = BENCH_WRITE_SIZE;
+    stream.stop = FALSE;
+    start = now_us();
+    if (pthread_create(&writer, NULL, bench_master_writer, &stream) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+
+    while (received < total) {
+        n = bench_recv_data(rig, data, (int)sizeof(data));
+        if (n < 0 || received + n > total || !check_pattern(data, n, received)) {
+            break;
+        }
+        received += n;
+    }
+    elapsed = now_us() - start;
+
+    /* A short transfer leaves the writer waiting on the pty; stop it */
+    __atomic_store_n(&stream.stop, TRUE, __ATOMIC_RELEASE);
+    pthread_join(writer, NULL);
+
+    if (received < total || stream.result != 0) {
+        return E_NETWORK_ERROR;
+    }
+    *bytes_per_sec = (double)total * 1e6 / (double)(elapsed > 0 ? elapsed : 1);
+    return 0;
+}
+
+/**
+ * @brief Stream total bytes server → client → pty master
+ */
+static int bench_net_to_serial(bench_rig_t* rig, long total, int chunk,
+                               double* bytes_per_sec) {
+    unsigned char data[BENCH_WRITE_SIZE];
+    bench_stream_t stream;
+    pthread_t writer;
+    struct pollfd pfd;
+    long received = 0;
+    long start;
+    long elapsed;
+    ssize_t n;
+
+    stream.rig = rig;
+    stream.total = total;
+    stream.chunk = chunk;
+    stream.stop = FALSE;
+    start = now_us();
+    if (pthread_create(&writer, NULL, bench_server_writer, &stream) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+
+    while (received < total) {
+        pfd.fd = rig->master_fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, BENCH_IO_TIMEOUT_MS) <= 0) {
+            break;
+        }
+        n = read(rig->master_fd, data, sizeof(data));
+        if (n <= 0 || received + n > total || !check_pattern(data, (int)n, received)) {
+            break;
+        }
+        received += n;
+    }
+    elapsed = now_us() - start;
+
+    /* A short transfer leaves the writer blocked on the socket; unblock it */
+    if (received < total) {
+        shutdown(rig->server_fd, SHUT_RDWR);
+    }
+    pthread_join(writer, NULL);
+
+    if (received < total || stream.result != 0) {
+        return E_NETWORK_ERROR;
+    }
+    *bytes_per_sec = (double)total * 1e6 / (double)(elapsed > 0 ? elapsed : 1);
+    return 0;
+}
+
+static int bench_run_case(const bench_case_t* bench_case, long bytes, int samples,
+                          bench_result_t* result) {
+    bench_rig_t rig;
+    double cpu_start;
+    int status;
+
+    memset(result, 0, sizeof(*result));
+    status = bench_rig_open(&rig, bench_case);
+    if (status != 0) {
+        return status;
+    }
+
+    status = bench_latency(&rig, samples, result);
+    if (status == 0) {
+        cpu_start = cpu_seconds();
+        status = bench_serial_to_net(&rig, bytes, &result->s2n_bytes_per_sec);
+        if (status == 0) {
+            status = bench_net_to_serial(&rig, bytes, bench_case->chunk_bytes,
+                                         &result->n2s_bytes_per_sec);
+        }
+        result->cpu_ms_per_mb = (cpu_seconds() - cpu_start) * 1000.0 /
+                                (2.0 * (double)bytes / (1024.0 * 1024.0));
+    }
+
+    bench_rig_close(&rig);
+    return status;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--bytes <n>] [--samples <n>] [--no-tls] [--csv] [--verbose]\n",
+            prog);
+    fprintf(stderr, "  --bytes <n>    Bytes streamed per direction (default: %d)\n",
+            BENCH_DEFAULT_BYTES);
+    fprintf(stderr, "  --samples <n>  Round trips per case (default: %d)\n",
+            BENCH_DEFAULT_SAMPLES);
+    fprintf(stderr, "  --no-tls       Skip the TLS cases\n");
+    fprintf(stderr, "  --csv          Machine-readable output for run-to-run comparison\n");
+    fprintf(stderr, "  --verbose      Keep the serial client's log output\n");
+}
+
+int main(int argc, char* argv[]) {
+    bench_case_t bench_case;
+    bench_result_t result;
+    FILE* report;
+    long bytes = BENCH_DEFAULT_BYTES;
+    int samples = BENCH_DEFAULT_SAMPLES;
+    int with_tls = TRUE;
+    int csv = FALSE;
+    int verbose = FALSE;
+    int failures = 0;
+    int status;
+    int b;
+    int c;
+    int t;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) {
+            bytes = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            samples = (int)strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--no-tls") == 0) {
+            with_tls = FALSE;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = TRUE;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = TRUE;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (bytes <= 0 || samples <= 0 || samples > BENCH_MAX_SAMPLES) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Teardown closes sockets under in-flight writes */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* The client logs to stdout; report on a private copy of it */
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (report == NULL) {
+        return EXIT_FAILURE;
+    }
+    if (!verbose && freopen("/dev/null", "w", stdout) == NULL) {
+        fclose(report);
+        return EXIT_FAILURE;
+    }
+
+    if (with_tls) {
+        g_server_ctx = tls_context_init(BENCH_CERT_FILE, BENCH_KEY_FILE, ENCRYPT_TLS13);
+        g_client_ctx = tls_context_init_client(ENCRYPT_TLS13);
+        if (g_server_ctx == NULL || g_client_ctx == NULL) {
+            fprintf(stderr, "TLS cases skipped: cannot load %s / %s\n",
+                    BENCH_CERT_FILE, BENCH_KEY_FILE);
+            with_tls = FALSE;
+        }
+    }
+
+    if (csv) {
+        fprintf(report, "baud,chunk,tls,s2n_bytes_per_sec,n2s_bytes_per_sec,"
+                        "p50_us,p90_us,p99_us,max_us,cpu_ms_per_mb\n");
+    } else {
+        fprintf(report, "=== Serial Bridge Benchmark (%ld bytes/direction, %d round trips) ===\n\n",
+                bytes, samples);
+        fprintf(report, "%7s %6s %4s %12s %12s %8s %8s %8s %8s %10s\n",
+                "baud", "chunk", "tls", "s2n B/s", "n2s B/s",
+                "p50 us", "p90 us", "p99 us", "max us", "CPU ms/MB");
+    }
+    fflush(report);
+
+    for (t = 0; t <= (with_tls ? 1 : 0); t++) {
+        for (b = 0; b < BENCH_COUNT(bench_bauds); b++) {
+            for (c = 0; c < BENCH_COUNT(bench_chunks); c++) {
+                bench_case.baud_rate = bench_bauds[b];
+                bench_case.chunk_bytes = bench_chunks[c];
+                bench_case.use_tls = t;
+
+                status = bench_run_case(&bench_case, bytes, samples, &result);
+                if (status != 0) {
+                    failures++;
+                    fprintf(report, csv ? "%d,%d,%s,FAILED(%d)\n" :
+                                          "%7d %6d %4s FAILED (error %d)\n",
+                            bench_case.baud_rate, bench_case.chunk_bytes,
+                            t ? "on" : "off", status);
+                } else {
+                    fprintf(report, csv ? "%d,%d,%s,%.0f,%.0f,%ld,%ld,%ld,%ld,%.2f\n" :
+                                          "%7d %6d %4s %12.0f %12.0f %8ld %8ld %8ld %8ld %10.2f\n",
+                            bench_case.baud_rate, bench_case.chunk_bytes,
+                            t ? "on" : "off",
+                            result.s2n_bytes_per_sec, result.n2s_bytes_per_sec,
+                            result.p50_us, result.p90_us, result.p99_us,
+                            result.max_us, result.cpu_ms_per_mb);
+                }
+                fflush(report);
+            }
+        }
+    }
+
+    if (!csv) {
+        fprintf(report, "\nPty lines are not paced at the baud rate; it only selects read timing.\n"
+                        "CPU covers the whole process (bridge and benchmark peers).\n");
+    }
+
+    tls_context_cleanup(g_server_ctx);
+    tls_context_cleanup(g_client_ctx);
+    fclose(report);
+    return (failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
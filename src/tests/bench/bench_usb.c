@@ -0,0 +1,604 @@
+/**
+ * @file bench_usb.c
+ * @brief USB forwarding benchmark over a virtual loopback device
+ *
+ * Each case runs the real forwarding path without hardware: a
+ * usb_client_t (pending request table and network thread) submits URBs
+ * on a socketpair to a usb_server_t, which routes them through
+ * usb_server_handle_urb() to a device agent on a second socketpair. The
+ * agent executes each URB against a virtual loopback device
+ * (usb_virtual.h) paced at the case's bus rate and answers with a
+ * RET_SUBMIT that the server routes back to the client.
+ *
+ * Workers loop bulk OUT then bulk IN of the same size, so the device
+ * always holds the data the next IN asks for. Reported per case:
+ *   - URB throughput (URBs/s) and data throughput (bytes/s, both ways),
+ *   - per-URB round-trip latency percentiles through the server,
+ *   - the share of requests whose pending entry timed out.
+ *
+ * The agent serves one URB at a time, like a device behind a single
+ * endpoint queue; with many workers on a slow bus, requests queue up
+ * and the timeout rate shows where the pending timeout becomes too short.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "connectors/usb/usb_client.h"
+#include "connectors/usb/usb_server.h"
+#include "connectors/usb/usb_transfer.h"
+#include "connectors/usb/usb_virtual.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+
+/* Defaults (overridable on the command line) */
+#define BENCH_DEFAULT_TIME_MS 500
+#define BENCH_DEFAULT_TIMEOUT_MS 100
+#define BENCH_MAX_WORKERS 32
+#define BENCH_MAX_SAMPLES 200000
+
+/* Routed device (VID:PID) */
+#define BENCH_DEVICE_ID 0x1d6b0104U
+
+/* Device agent's wait for looped-back data */
+#define BENCH_AGENT_IN_TIMEOUT_MS 100
+
+/* ============================================================================
+ * Benchmark Matrix
+ * ============================================================================ */
+
+typedef struct {
+    const char* name;
+    uint32_t rate;                /* Bytes per second per endpoint (0: unpaced) */
+    unsigned int latency_us;      /* Per-transfer cost */
+} bench_bus_t;
+
+/* Unpaced, then roughly USB 1.1 full speed and USB 2.0 high speed bulk */
+static const bench_bus_t bench_buses[] = {
+    { "unpaced", 0, 0 },
+    { "full", 1000000, 1000 },
+    { "high", 40000000, 125 }
+};
+static const uint32_t bench_sizes[] = { 64, USB_MAX_DATA_SIZE };
+static const int bench_workers[] = { 1, 8, 32 };
+
+#define BENCH_COUNT(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+typedef struct {
+    double urbs_per_sec;
+    double bytes_per_sec;
+    long p50_us;
+    long p99_us;
+    long max_us;
+    double timeout_pct;
+    unsigned long errors;
+} bench_result_t;
+
+/* ============================================================================
+ * Rig: server, host client, device agent
+ * ============================================================================ */
+
+typedef struct {
+    usb_server_t* server;
+    int fd;                       /* Server end of one client link */
+    pthread_t thread;
+    int started;
+} bench_dispatch_t;
+
+typedef struct {
+    usb_server_t* server;
+    int host_fds[2];              /* [0] server end, [1] client end */
+    int device_fds[2];            /* [0] server end, [1] agent end */
+    bench_dispatch_t dispatch[2];
+    usb_device_t device;
+    int device_open;
+    pthread_t agent_thread;
+    int agent_started;
+    usb_client_t* client;
+    int client_started;
+} bench_rig_t;
+
+static long now_us(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000L + ts.tv_nsec / 1000L;
+}
+
+/**
+ * @brief Server side of one link: what the event loop does per packet
+ */
+static void* bench_dispatch_thread(void* arg) {
+    bench_dispatch_t* dispatch = (bench_dispatch_t*)arg;
+    xoe_packet_t packet;
+
+    while (xoe_wire_recv(dispatch->fd, &packet) == 0) {
+        usb_server_handle_urb(dispatch->server, &packet, dispatch->fd);
+        xoe_wire_free_payload(&packet);
+    }
+    xoe_payload_pool_thread_cleanup();
+    return NULL;
+}
+
+/**
+ * @brief Device agent: execute each URB on the virtual device and reply
+ */
+static void* bench_agent_thread(void* arg) {
+    bench_rig_t* rig = (bench_rig_t*)arg;
+    unsigned char* data;
+    usb_urb_header_t urb;
+    xoe_packet_t packet;
+    uint32_t data_len;
+    int transferred;
+    int result;
+
+    data = (unsigned char*)malloc(USB_MAX_DATA_SIZE);
+    if (data == NULL) {
+        return NULL;
+    }
+
+    while (xoe_wire_recv(rig->device_fds[1], &packet) == 0) {
+        data_len = USB_MAX_DATA_SIZE;
+        result = usb_protocol_decapsulate(&packet, &urb, data, &data_len);
+        xoe_wire_free_payload(&packet);
+        if (result != 0 || urb.command != USB_CMD_SUBMIT) {
+            continue;
+        }
+
+        transferred = 0;
+        if (urb.endpoint & 0x80) {
+            result = usb_transfer_bulk_read(&rig->device, urb.endpoint, data,
+                                            (int)urb.transfer_length,
+                                            &transferred,
+                                            BENCH_AGENT_IN_TIMEOUT_MS);
+        } else {
+            result = usb_transfer_bulk_write(&rig->device, urb.endpoint, data,
+                                             (int)data_len, &transferred,
+                                             BENCH_AGENT_IN_TIMEOUT_MS);
+        }
+
+        /* actual_length counts the data in the frame: none for OUT */
+        urb.command = USB_RET_SUBMIT;
+        urb.status = result;
+        urb.actual_length = (urb.endpoint & 0x80) ? (uint32_t)transferred : 0;
+        if (usb_protocol_encapsulate(&urb, data, urb.actual_length,
+                                     &packet) != 0) {
+            continue;
+        }
+        result = xoe_wire_send(rig->device_fds[1], &packet);
+        usb_protocol_free_payload(&packet);
+        if (result != 0) {
+            break;
+        }
+    }
+
+    free(data);
+    xoe_payload_pool_thread_cleanup();
+    return NULL;
+}
+
+static void bench_rig_close(bench_rig_t* rig) {
+    int i;
+
+    /* Closes the client link; the network thread exits on EOF */
+    if (rig->client != NULL) {
+        if (rig->client_started) {
+            usb_client_stop(rig->client);
+        } else if (rig->client->socket_fd >= 0) {
+            close(rig->client->socket_fd);
+        }
+        rig->client->socket_fd = -1;
+        usb_client_cleanup(rig->client);
+    } else if (rig->host_fds[1] >= 0) {
+        close(rig->host_fds[1]);
+    }
+
+    /* EOF on the device link stops the agent and the device dispatcher */
+    if (rig->device_fds[0] >= 0) {
+        shutdown(rig->device_fds[0], SHUT_RDWR);
+    }
+    if (rig->agent_started) {
+        pthread_join(rig->agent_thread, NULL);
+    }
+    for (i = 0; i < 2; i++) {
+        if (rig->dispatch[i].started) {
+            pthread_join(rig->dispatch[i].thread, NULL);
+        }
+    }
+
+    usb_server_cleanup(rig->server);
+    if (rig->device_open) {
+        usb_device_close(&rig->device);
+    }
+    if (rig->host_fds[0] >= 0) {
+        close(rig->host_fds[0]);
+    }
+    if (rig->device_fds[0] >= 0) {
+        close(rig->device_fds[0]);
+    }
+    if (rig->device_fds[1] >= 0) {
+        close(rig->device_fds[1]);
+    }
+}
+
+static int bench_rig_open(bench_rig_t* rig, const bench_bus_t* bus) {
+    usb_virtual_config_t config;
+    int result;
+    int i;
+
+    memset(rig, 0, sizeof(*rig));
+    rig->host_fds[0] = rig->host_fds[1] = -1;
+    rig->device_fds[0] = rig->device_fds[1] = -1;
+
+    rig->server = usb_server_init();
+    if (rig->server == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, rig->host_fds) != 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, rig->device_fds) != 0) {
+        bench_rig_close(rig);
+        return E_NETWORK_ERROR;
+    }
+
+    /* Both ends advertise the device; routing skips the sender */
+    result = usb_server_register_client(rig->server, rig->device_fds[0],
+                                        BENCH_DEVICE_ID);
+    if (result == 0) {
+        result = usb_server_register_client(rig->server, rig->host_fds[0],
+                                            BENCH_DEVICE_ID);
+    }
+    if (result != 0) {
+        bench_rig_close(rig);
+        return result;
+    }
+
+    usb_virtual_config_init(&config);
+    config.in_rate = bus->rate;
+    config.out_rate = bus->rate;
+    config.latency_us = bus->latency_us;
+
+    /* Room for one OUT per worker: the serial agent must never block on
+     * a full ring while the IN that would drain it waits behind */
+    config.fifo_size = BENCH_MAX_WORKERS * USB_MAX_DATA_SIZE;
+    result = usb_virtual_open(&rig->device, &config);
+    if (result != 0) {
+        bench_rig_close(rig);
+        return result;
+    }
+    rig->device_open = TRUE;
+
+    rig->dispatch[0].fd = rig->host_fds[0];
+    rig->dispatch[1].fd = rig->device_fds[0];
+    for (i = 0; i < 2; i++) {
+        rig->dispatch[i].server = rig->server;
+        if (pthread_create(&rig->dispatch[i].thread, NULL,
+                           bench_dispatch_thread, &rig->dispatch[i]) != 0) {
+            bench_rig_close(rig);
+            return E_UNKNOWN_ERROR;
+        }
+        rig->dispatch[i].started = TRUE;
+    }
+    if (pthread_create(&rig->agent_thread, NULL, bench_agent_thread, rig) != 0) {
+        bench_rig_close(rig);
+        return E_UNKNOWN_ERROR;
+    }
+    rig->agent_started = TRUE;
+
+    /* A connected client: only the pending table and network thread run */
+    rig->client = usb_client_init("127.0.0.1", 1, 1);
+    if (rig->client == NULL) {
+        bench_rig_close(rig);
+        return E_OUT_OF_MEMORY;
+    }
+    rig->client->socket_fd = rig->host_fds[1];
+    rig->host_fds[1] = -1;
+    rig->client->running = TRUE;
+    if (pthread_create(&rig->client->network_thread, NULL,
+                       usb_client_network_thread, rig->client) != 0) {
+        rig->client->running = FALSE;
+        bench_rig_close(rig);
+        return E_UNKNOWN_ERROR;
+    }
+    rig->client_started = TRUE;
+
+    return 0;
+}
+
+/* ============================================================================
+ * Workers
+ * ============================================================================ */
+
+typedef struct {
+    long* samples;                /* Round-trip times (us) */
+    int sample_count;             /* Claimed slots (may exceed capacity) */
+    long deadline_us;
+    unsigned int timeout_ms;
+} bench_shared_t;
+
+typedef struct {
+    bench_rig_t* rig;
+    bench_shared_t* shared;
+    uint32_t size;
+    pthread_t thread;
+    unsigned long urbs;
+    unsigned long long bytes;
+    unsigned long timeouts;
+    unsigned long errors;
+} bench_worker_t;
+
+/**
+ * @brief Submit one URB and account for it
+ */
+static void bench_submit(bench_worker_t* worker, uint8_t endpoint,
+                         unsigned char* data) {
+    usb_urb_header_t urb;
+    uint32_t actual = 0;
+    long start;
+    int index;
+    int result;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_SUBMIT;
+    urb.device_id = BENCH_DEVICE_ID;
+    urb.endpoint = endpoint;
+    urb.transfer_type = USB_TRANSFER_BULK;
+    urb.transfer_length = worker->size;
+
+    start = now_us();
+    if (endpoint & 0x80) {
+        urb.actual_length = 0;
+        result = usb_client_submit_urb_sync(worker->rig->client, &urb,
+                                            NULL, 0, data, worker->size,
+                                            &actual, worker->shared->timeout_ms);
+    } else {
+        urb.actual_length = worker->size;
+        result = usb_client_submit_urb_sync(worker->rig->client, &urb,
+                                            data, worker->size, NULL, 0,
+                                            &actual, worker->shared->timeout_ms);
+        actual = worker->size;
+    }
+
+    if (result == E_TIMEOUT) {
+        worker->timeouts++;
+        return;
+    }
+    if (result != 0) {
+        worker->errors++;
+        return;
+    }
+
+    index = __atomic_fetch_add(&worker->shared->sample_count, 1,
+                               __ATOMIC_RELAXED);
+    if (index < BENCH_MAX_SAMPLES) {
+        worker->shared->samples[index] = now_us() - start;
+    }
+    worker->urbs++;
+    worker->bytes += actual;
+}
+
+static void* bench_worker_thread(void* arg) {
+    bench_worker_t* worker = (bench_worker_t*)arg;
+    unsigned char data[USB_MAX_DATA_SIZE];
+
+    memset(data, 0xa5, sizeof(data));
+    while (now_us() < worker->shared->deadline_us) {
+        bench_submit(worker, USB_VIRTUAL_OUT_ENDPOINT, data);
+        bench_submit(worker, USB_VIRTUAL_IN_ENDPOINT, data);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Cases
+ * ============================================================================ */
+
+static int compare_long(const void* a, const void* b) {
+    long la = *(const long*)a;
+    long lb = *(const long*)b;
+
+    return (la > lb) - (la < lb);
+}
+
+static long percentile(const long* sorted, int count, int pct) {
+    int index = (count * pct + 99) / 100 - 1;
+
+    if (index < 0) {
+        index = 0;
+    }
+    return sorted[index];
+}
+
+static int bench_run_case(const bench_bus_t* bus, uint32_t size, int workers,
+                          long time_ms, unsigned int timeout_ms,
+                          long* samples, bench_result_t* result) {
+    bench_worker_t worker[BENCH_MAX_WORKERS];
+    bench_shared_t shared;
+    bench_rig_t rig;
+    unsigned long urbs = 0;
+    unsigned long timeouts = 0;
+    unsigned long long bytes = 0;
+    long start;
+    long elapsed;
+    int started = 0;
+    int count;
+    int status;
+    int i;
+
+    memset(result, 0, sizeof(*result));
+    status = bench_rig_open(&rig, bus);
+    if (status != 0) {
+        return status;
+    }
+
+    shared.samples = samples;
+    shared.sample_count = 0;
+    shared.timeout_ms = timeout_ms;
+    start = now_us();
+    shared.deadline_us = start + time_ms * 1000L;
+
+    for (i = 0; i < workers; i++) {
+        memset(&worker[i], 0, sizeof(worker[i]));
+        worker[i].rig = &rig;
+        worker[i].shared = &shared;
+        worker[i].size = size;
+        if (pthread_create(&worker[i].thread, NULL, bench_worker_thread,
+                           &worker[i]) != 0) {
+            status = E_UNKNOWN_ERROR;
+            break;
+        }
+        started++;
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(worker[i].thread, NULL);
+        urbs += worker[i].urbs;
+        bytes += worker[i].bytes;
+        timeouts += worker[i].timeouts;
+        result->errors += worker[i].errors;
+    }
+    elapsed = now_us() - start;
+
+    bench_rig_close(&rig);
+    if (status != 0) {
+        return status;
+    }
+    if (urbs == 0) {
+        return E_TIMEOUT;
+    }
+
+    result->urbs_per_sec = (double)urbs * 1e6 / (double)elapsed;
+    result->bytes_per_sec = (double)bytes * 1e6 / (double)elapsed;
+    result->timeout_pct = 100.0 * (double)timeouts /
+                          (double)(urbs + timeouts + result->errors);
+
+    count = (shared.sample_count < BENCH_MAX_SAMPLES) ?
+            shared.sample_count : BENCH_MAX_SAMPLES;
+    qsort(samples, (size_t)count, sizeof(long), compare_long);
+    result->p50_us = percentile(samples, count, 50);
+    result->p99_us = percentile(samples, count, 99);
+    result->max_us = samples[count - 1];
+    return 0;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--time-ms <n>] [--timeout-ms <n>] [--csv] [--verbose]\n",
+            prog);
+    fprintf(stderr, "  --time-ms <n>     Run time per case (default: %d)\n",
+            BENCH_DEFAULT_TIME_MS);
+    fprintf(stderr, "  --timeout-ms <n>  Pending request timeout (default: %d)\n",
+            BENCH_DEFAULT_TIMEOUT_MS);
+    fprintf(stderr, "  --csv             Machine-readable output for run-to-run comparison\n");
+    fprintf(stderr, "  --verbose         Keep the client and server log output\n");
+}
+
+int main(int argc, char* argv[]) {
+    bench_result_t result;
+    FILE* report;
+    long* samples;
+    long time_ms = BENCH_DEFAULT_TIME_MS;
+    long timeout_ms = BENCH_DEFAULT_TIMEOUT_MS;
+    int csv = FALSE;
+    int verbose = FALSE;
+    int failures = 0;
+    int status;
+    int b;
+    int s;
+    int w;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time-ms") == 0 && i + 1 < argc) {
+            time_ms = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--timeout-ms") == 0 && i + 1 < argc) {
+            timeout_ms = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            csv = TRUE;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = TRUE;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (time_ms <= 0 || timeout_ms <= 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Teardown closes sockets under in-flight writes */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Client and server log to stdout and stderr (including the expected
+     * EOF at teardown); report on a private copy of stdout */
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (report == NULL) {
+        return EXIT_FAILURE;
+    }
+    if (!verbose && (freopen("/dev/null", "w", stdout) == NULL ||
+                     freopen("/dev/null", "w", stderr) == NULL)) {
+        fclose(report);
+        return EXIT_FAILURE;
+    }
+
+    samples = (long*)malloc(BENCH_MAX_SAMPLES * sizeof(long));
+    if (samples == NULL) {
+        fclose(report);
+        return EXIT_FAILURE;
+    }
+
+    if (csv) {
+        fprintf(report, "bus,size,workers,urbs_per_sec,bytes_per_sec,"
+                        "p50_us,p99_us,max_us,timeout_pct,errors\n");
+    } else {
+        fprintf(report, "=== USB Forwarding Benchmark (%ld ms/case, %ld ms timeout) ===\n\n",
+                time_ms, timeout_ms);
+        fprintf(report, "%8s %5s %7s %10s %12s %8s %8s %8s %9s %6s\n",
+                "bus", "size", "workers", "URB/s", "data B/s",
+                "p50 us", "p99 us", "max us", "timeout%", "errors");
+    }
+    fflush(report);
+
+    for (b = 0; b < BENCH_COUNT(bench_buses); b++) {
+        for (s = 0; s < BENCH_COUNT(bench_sizes); s++) {
+            for (w = 0; w < BENCH_COUNT(bench_workers); w++) {
+                status = bench_run_case(&bench_buses[b], bench_sizes[s],
+                                        bench_workers[w], time_ms,
+                                        (unsigned int)timeout_ms,
+                                        samples, &result);
+                if (status != 0) {
+                    failures++;
+                    fprintf(report, csv ? "%s,%u,%d,FAILED(%d)\n" :
+                                          "%8s %5u %7d FAILED (error %d)\n",
+                            bench_buses[b].name, bench_sizes[s],
+                            bench_workers[w], status);
+                } else {
+                    fprintf(report, csv ? "%s,%u,%d,%.0f,%.0f,%ld,%ld,%ld,%.2f,%lu\n" :
+                                          "%8s %5u %7d %10.0f %12.0f %8ld %8ld %8ld %9.2f %6lu\n",
+                            bench_buses[b].name, bench_sizes[s],
+                            bench_workers[w], result.urbs_per_sec,
+                            result.bytes_per_sec, result.p50_us,
+                            result.p99_us, result.max_us,
+                            result.timeout_pct, result.errors);
+                }
+                fflush(report);
+            }
+        }
+    }
+
+    free(samples);
+    xoe_payload_pool_thread_cleanup();
+    fclose(report);
+    return (failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,465 @@
+/**
+ * @file bench_wire.c
+ * @brief Wire format micro-benchmarks
+ *
+ * Measures the per-frame cost of the wire layer in isolation:
+ *   - xoe_wire_serialize_header() / xoe_wire_deserialize_header(),
+ *   - xoe_wire_packet_checksum() across payload sizes,
+ *   - xoe_wire_send() / xoe_wire_recv() over an AF_UNIX socketpair,
+ *   - xoe_wire_send_tls() / xoe_wire_recv_tls() over an in-memory BIO
+ *     pair, so only record protection and framing are timed.
+ *
+ * Payloads run from 16 bytes to XOE_WIRE_MAX_PAYLOAD. Each measurement
+ * is calibrated to run for about --time-ms and reports ns/frame and
+ * payload GB/s (10^9 bytes per second). Use it as the baseline before
+ * checksum, batching or pooling changes.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/security/tls_config.h"
+#include "lib/security/tls_context.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include <openssl/bio.h>
+
+/* Defaults (overridable on the command line) */
+#define BENCH_DEFAULT_TIME_MS 200
+#define BENCH_MIN_FRAMES 16L
+#define BENCH_MAX_FRAMES 10000000L
+
+/* First trial run size when calibrating */
+#define BENCH_CALIBRATE_FRAMES 16L
+
+/* BIO pair capacity: one maximal frame plus TLS record overhead */
+#define BENCH_BIO_SIZE (XOE_WIRE_MAX_PAYLOAD + 256 * 1024)
+
+/* Handshake rounds before an in-memory handshake is declared stuck */
+#define BENCH_HANDSHAKE_ROUNDS 64
+
+#define BENCH_CERT_FILE "./certs/server.crt"
+#define BENCH_KEY_FILE "./certs/server.key"
+
+static const uint32_t bench_sizes[] = {
+    16, 64, 256, 1024, 4096, 16384, 65536, 262144, XOE_WIRE_MAX_PAYLOAD
+};
+
+#define BENCH_COUNT(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+/* Keeps computed values alive so loops are not optimized away */
+static volatile uint32_t g_sink;
+
+static long g_target_ns = BENCH_DEFAULT_TIME_MS * 1000000L;
+static int g_csv = FALSE;
+
+/**
+ * @brief One benchmark: run frames iterations over a payload size
+ *
+ * @return 0 on success, negative error code on failure
+ */
+typedef int (*bench_fn_t)(void* ctx, uint32_t size, long frames);
+
+static long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+static void init_packet(xoe_packet_t* packet, xoe_payload_t* payload) {
+    memset(packet, 0, sizeof(*packet));
+    packet->protocol_id = 0x0001;
+    packet->protocol_version = 1;
+    packet->payload = payload;
+}
+
+static void report(const char* name, uint32_t size, long frames, long elapsed_ns) {
+    double ns_per_frame = (double)elapsed_ns / (double)frames;
+    double gb_per_sec = (size > 0) ?
+        (double)size * (double)frames / (double)elapsed_ns : 0.0;
+
+    if (g_csv) {
+        printf("%s,%u,%ld,%.1f,%.3f\n", name, size, frames, ns_per_frame, gb_per_sec);
+    } else {
+        printf("%-20s %9u %10ld %14.1f %10.3f\n",
+               name, size, frames, ns_per_frame, gb_per_sec);
+    }
+    fflush(stdout);
+}
+
+/**
+ * @brief Calibrate, run for about g_target_ns and report one row
+ */
+static int measure(const char* name, bench_fn_t fn, void* ctx, uint32_t size) {
+    long frames;
+    long start;
+    long elapsed;
+    int result;
+
+    /*
+     * Grow a trial run until it is long enough to time reliably (this
+     * also warms caches and the payload pool), then scale to the target.
+     */
+    frames = BENCH_CALIBRATE_FRAMES;
+    for (;;) {
+        start = now_ns();
+        result = fn(ctx, size, frames);
+        elapsed = now_ns() - start;
+        if (result != 0) {
+            return result;
+        }
+        if (elapsed >= g_target_ns / 8 || frames >= BENCH_MAX_FRAMES) {
+            break;
+        }
+        frames *= 4;
+    }
+
+    frames = (long)((double)frames * (double)g_target_ns /
+                    (double)(elapsed > 0 ? elapsed : 1));
+    if (frames < BENCH_MIN_FRAMES) {
+        frames = BENCH_MIN_FRAMES;
+    }
+    if (frames > BENCH_MAX_FRAMES) {
+        frames = BENCH_MAX_FRAMES;
+    }
+
+    start = now_ns();
+    result = fn(ctx, size, frames);
+    elapsed = now_ns() - start;
+    if (result != 0) {
+        return result;
+    }
+
+    report(name, size, frames, elapsed > 0 ? elapsed : 1);
+    return 0;
+}
+
+/* ============================================================================
+ * Header and Checksum
+ * ============================================================================ */
+
+static int bench_serialize(void* ctx, uint32_t size, long frames) {
+    uint8_t buffer[XOE_WIRE_HEADER_SIZE];
+    xoe_wire_header_t header;
+    xoe_wire_header_t parsed;
+    long i;
+
+    (void)ctx;
+    header.protocol_id = 0x0001;
+    header.protocol_version = 1;
+    header.payload_length = size;
+    header.checksum = 0x12345678;
+
+    for (i = 0; i < frames; i++) {
+        header.checksum += (uint32_t)i;
+        xoe_wire_serialize_header(buffer, &header);
+        xoe_wire_deserialize_header(&parsed, buffer);
+        g_sink += parsed.checksum;
+    }
+    return 0;
+}
+
+static int bench_checksum(void* ctx, uint32_t size, long frames) {
+    const unsigned char* data = (const unsigned char*)ctx;
+    xoe_wire_header_t header;
+    long i;
+
+    header.protocol_id = 0x0001;
+    header.protocol_version = 1;
+    header.payload_length = size;
+    header.checksum = 0;
+
+    for (i = 0; i < frames; i++) {
+        g_sink += xoe_wire_packet_checksum(&header, data);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Socketpair Send/Receive
+ * ============================================================================ */
+
+typedef struct {
+    int fd;
+    xoe_packet_t* packet;
+    long frames;
+    int result;
+} bench_sender_t;
+
+static void* bench_sender_thread(void* arg) {
+    bench_sender_t* sender = (bench_sender_t*)arg;
+    long i;
+
+    sender->result = 0;
+    for (i = 0; i < sender->frames; i++) {
+        sender->result = xoe_wire_send(sender->fd, sender->packet);
+        if (sender->result != 0) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    int fds[2];
+    xoe_payload_t* payload;
+} bench_socket_ctx_t;
+
+static int bench_socketpair(void* ctx, uint32_t size, long frames) {
+    bench_socket_ctx_t* sock = (bench_socket_ctx_t*)ctx;
+    bench_sender_t sender;
+    xoe_packet_t packet;
+    xoe_packet_t received;
+    pthread_t thread;
+    int result = 0;
+    long i;
+
+    sock->payload->len = size;
+    init_packet(&packet, sock->payload);
+
+    sender.fd = sock->fds[0];
+    sender.packet = &packet;
+    sender.frames = frames;
+    if (pthread_create(&thread, NULL, bench_sender_thread, &sender) != 0) {
+        return E_UNKNOWN_ERROR;
+    }
+
+    for (i = 0; i < frames; i++) {
+        result = xoe_wire_recv(sock->fds[1], &received);
+        if (result != 0) {
+            /* Unblock the sender so it can be joined */
+            shutdown(sock->fds[1], SHUT_RDWR);
+            break;
+        }
+        g_sink += received.checksum;
+        xoe_wire_free_payload(&received);
+    }
+
+    pthread_join(thread, NULL);
+    return (result != 0) ? result : sender.result;
+}
+
+/* ============================================================================
+ * TLS Send/Receive over an In-Memory BIO Pair
+ * ============================================================================ */
+
+typedef struct {
+    SSL* client;
+    SSL* server;
+    xoe_payload_t* payload;
+} bench_tls_ctx_t;
+
+static int drive_handshake(SSL* client, SSL* server) {
+    int client_done = FALSE;
+    int server_done = FALSE;
+    int round;
+
+    for (round = 0; round < BENCH_HANDSHAKE_ROUNDS; round++) {
+        if (!client_done) {
+            client_done = (SSL_do_handshake(client) == 1);
+        }
+        if (!server_done) {
+            server_done = (SSL_do_handshake(server) == 1);
+        }
+        if (client_done && server_done) {
+            return 0;
+        }
+    }
+    return E_UNKNOWN_ERROR;
+}
+
+static int tls_pair_open(bench_tls_ctx_t* tls, SSL_CTX* server_ctx,
+                         SSL_CTX* client_ctx) {
+    BIO* client_bio;
+    BIO* server_bio;
+
+    tls->client = SSL_new(client_ctx);
+    tls->server = SSL_new(server_ctx);
+    if (tls->client == NULL || tls->server == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    if (BIO_new_bio_pair(&client_bio, BENCH_BIO_SIZE,
+                         &server_bio, BENCH_BIO_SIZE) != 1) {
+        return E_OUT_OF_MEMORY;
+    }
+
+    /* Each SSL reads and writes its own end of the pair */
+    SSL_set_bio(tls->client, client_bio, client_bio);
+    SSL_set_bio(tls->server, server_bio, server_bio);
+    SSL_set_connect_state(tls->client);
+    SSL_set_accept_state(tls->server);
+
+    return drive_handshake(tls->client, tls->server);
+}
+
+static void tls_pair_close(bench_tls_ctx_t* tls) {
+    if (tls->client != NULL) {
+        SSL_free(tls->client);
+    }
+    if (tls->server != NULL) {
+        SSL_free(tls->server);
+    }
+}
+
+/**
+ * @brief Frames alternate client send / server receive on one thread
+ *
+ * The BIO pair holds a whole frame, so sends never wait for the reader.
+ */
+static int bench_tls(void* ctx, uint32_t size, long frames) {
+    bench_tls_ctx_t* tls = (bench_tls_ctx_t*)ctx;
+    xoe_packet_t packet;
+    xoe_packet_t received;
+    int result;
+    long i;
+
+    tls->payload->len = size;
+    init_packet(&packet, tls->payload);
+
+    for (i = 0; i < frames; i++) {
+        result = xoe_wire_send_tls(tls->client, &packet);
+        if (result != 0) {
+            return result;
+        }
+        result = xoe_wire_recv_tls(tls->server, &received);
+        if (result != 0) {
+            return result;
+        }
+        g_sink += received.checksum;
+        xoe_wire_free_payload(&received);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--time-ms <n>] [--no-tls] [--csv]\n", prog);
+    fprintf(stderr, "  --time-ms <n>  Target run time per measurement (default: %d)\n",
+            BENCH_DEFAULT_TIME_MS);
+    fprintf(stderr, "  --no-tls       Skip the TLS measurements\n");
+    fprintf(stderr, "  --csv          Machine-readable output for run-to-run comparison\n");
+}
+
+int main(int argc, char* argv[]) {
+    bench_socket_ctx_t sock;
+    bench_tls_ctx_t tls;
+    SSL_CTX* server_ctx = NULL;
+    SSL_CTX* client_ctx = NULL;
+    xoe_payload_t* payload;
+    int with_tls = TRUE;
+    int failures = 0;
+    long time_ms;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time-ms") == 0 && i + 1 < argc) {
+            time_ms = strtol(argv[++i], NULL, 10);
+            if (time_ms <= 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            g_target_ns = time_ms * 1000000L;
+        } else if (strcmp(argv[i], "--no-tls") == 0) {
+            with_tls = FALSE;
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            g_csv = TRUE;
+        } else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* A failed receive shuts the socketpair under the sender */
+    signal(SIGPIPE, SIG_IGN);
+
+    payload = xoe_payload_alloc(XOE_WIRE_MAX_PAYLOAD);
+    if (payload == NULL) {
+        return EXIT_FAILURE;
+    }
+    for (i = 0; i < (int)XOE_WIRE_MAX_PAYLOAD; i++) {
+        ((unsigned char*)payload->data)[i] = (unsigned char)(i * 31);
+    }
+
+    if (g_csv) {
+        printf("operation,payload_bytes,frames,ns_per_frame,gb_per_sec\n");
+    } else {
+        printf("=== Wire Format Micro-Benchmarks (~%ld ms per row) ===\n\n",
+               g_target_ns / 1000000L);
+        printf("%-20s %9s %10s %14s %10s\n",
+               "operation", "payload", "frames", "ns/frame", "GB/s");
+    }
+
+    /* Header cost does not depend on the payload size */
+    if (measure("serialize_header", bench_serialize, NULL, 0) != 0) {
+        failures++;
+    }
+
+    for (i = 0; i < BENCH_COUNT(bench_sizes); i++) {
+        if (measure("packet_checksum", bench_checksum, payload->data,
+                    bench_sizes[i]) != 0) {
+            failures++;
+        }
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sock.fds) != 0) {
+        fprintf(stderr, "socketpair failed\n");
+        failures++;
+    } else {
+        sock.payload = payload;
+        for (i = 0; i < BENCH_COUNT(bench_sizes) && failures == 0; i++) {
+            if (measure("send_recv_socket", bench_socketpair, &sock,
+                        bench_sizes[i]) != 0) {
+                fprintf(stderr, "send_recv_socket failed at %u bytes\n", bench_sizes[i]);
+                failures++;
+            }
+        }
+        close(sock.fds[0]);
+        close(sock.fds[1]);
+    }
+
+    if (with_tls) {
+        server_ctx = tls_context_init(BENCH_CERT_FILE, BENCH_KEY_FILE, ENCRYPT_TLS13);
+        client_ctx = tls_context_init_client(ENCRYPT_TLS13);
+        memset(&tls, 0, sizeof(tls));
+        if (server_ctx == NULL || client_ctx == NULL) {
+            fprintf(stderr, "TLS rows skipped: cannot load %s / %s\n",
+                    BENCH_CERT_FILE, BENCH_KEY_FILE);
+        } else if (tls_pair_open(&tls, server_ctx, client_ctx) != 0) {
+            fprintf(stderr, "In-memory TLS handshake failed\n");
+            failures++;
+        } else {
+            tls.payload = payload;
+            for (i = 0; i < BENCH_COUNT(bench_sizes); i++) {
+                if (measure("send_recv_tls13_mem", bench_tls, &tls,
+                            bench_sizes[i]) != 0) {
+                    fprintf(stderr, "send_recv_tls13_mem failed at %u bytes\n",
+                            bench_sizes[i]);
+                    failures++;
+                    break;
+                }
+            }
+        }
+        tls_pair_close(&tls);
+        tls_context_cleanup(server_ctx);
+        tls_context_cleanup(client_ctx);
+    }
+
+    payload->len = XOE_WIRE_MAX_PAYLOAD;
+    xoe_payload_release(payload);
+    xoe_payload_pool_thread_cleanup();
+    return (failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+/**
+ * @file test_bench_client.c
+ * @brief Unit tests for the echo load generator
+ *
+ * Configuration limits, an unpaced and a paced run against an in-process
+ * echo peer (which returns every byte, so frames come back intact), the
+ * stop flag, and a run where no connection can be set up.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/bench_client.h"
+#include "lib/common/definitions.h"
+#include "lib/common/latency.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* Connections the echo peer serves at once */
+#define ECHO_MAX_CONNS 8
+
+/**
+ * @brief Echo peer: accepts connections and writes back whatever arrives
+ */
+typedef struct {
+    int listener;
+    int port;
+    volatile int stop;
+    pthread_t thread;
+} echo_peer_t;
+
+static void* echo_thread(void* arg)
+{
+    echo_peer_t* peer = (echo_peer_t*)arg;
+    struct pollfd fds[ECHO_MAX_CONNS + 1];
+    char buffer[16384];
+    int count = 1;
+    ssize_t n;
+    int i;
+
+    fds[0].fd = peer->listener;
+    fds[0].events = POLLIN;
+
+    while (!peer->stop) {
+        if (poll(fds, (nfds_t)count, 20) <= 0) {
+            continue;
+        }
+        if ((fds[0].revents & POLLIN) && count <= ECHO_MAX_CONNS) {
+            fds[count].fd = accept(peer->listener, NULL, NULL);
+            fds[count].events = POLLIN;
+            fds[count].revents = 0;
+            count++;
+        }
+        for (i = 1; i < count; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP))) {
+                continue;
+            }
+            n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n <= 0 || write(fds[i].fd, buffer, (size_t)n) != n) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+            }
+        }
+    }
+
+    for (i = 1; i < count; i++) {
+        if (fds[i].fd >= 0) {
+            close(fds[i].fd);
+        }
+    }
+    return NULL;
+}
+
+static int echo_start(echo_peer_t* peer)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(peer, 0, sizeof(*peer));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    peer->listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (peer->listener < 0 ||
+        bind(peer->listener, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(peer->listener, ECHO_MAX_CONNS) != 0 ||
+        getsockname(peer->listener, (struct sockaddr*)&addr, &len) != 0) {
+        return -1;
+    }
+    peer->port = ntohs(addr.sin_port);
+    return pthread_create(&peer->thread, NULL, echo_thread, peer);
+}
+
+static void echo_stop(echo_peer_t* peer)
+{
+    peer->stop = 1;
+    pthread_join(peer->thread, NULL);
+    close(peer->listener);
+}
+
+/* ============================================================================
+ * Configuration Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test defaults and the limits enforced on each field
+ */
+void test_config(void) {
+    bench_config_t config;
+
+    bench_config_init_defaults(&config);
+    TEST_ASSERT_EQUAL(BENCH_DEFAULT_FRAME_SIZE, (int)config.frame_size,
+                      "Default frame size");
+    TEST_ASSERT_EQUAL(BENCH_DEFAULT_DEPTH, config.depth, "Default depth");
+    TEST_ASSERT_ERROR(bench_config_validate(&config), E_INVALID_ARGUMENT,
+                      "No connections: off");
+
+    config.connections = 4;
+    TEST_ASSERT_EQUAL(0, bench_config_validate(&config), "Valid");
+
+    config.frame_size = BENCH_MIN_FRAME_SIZE - 1;
+    TEST_ASSERT_ERROR(bench_config_validate(&config), E_INVALID_ARGUMENT,
+                      "Frame too small for the timestamp");
+    config.frame_size = BENCH_DEFAULT_FRAME_SIZE;
+    config.depth = 0;
+    TEST_ASSERT_ERROR(bench_config_validate(&config), E_INVALID_ARGUMENT,
+                      "Zero depth");
+    config.depth = 1;
+    config.connections = BENCH_MAX_CONNECTIONS + 1;
+    TEST_ASSERT_ERROR(bench_config_validate(&config), E_INVALID_ARGUMENT,
+                      "Too many connections");
+    TEST_ASSERT_ERROR(bench_config_validate(NULL), E_INVALID_ARGUMENT, "NULL");
+}
+
+/* ============================================================================
+ * Run Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test an unpaced run keeps every connection busy and times echoes
+ */
+void test_run_unlimited(void) {
+    echo_peer_t peer;
+    bench_config_t config;
+    bench_result_t result;
+    latency_snapshot_t before;
+    latency_snapshot_t after;
+
+    TEST_ASSERT_EQUAL(0, echo_start(&peer), "Echo peer");
+    latency_snapshot(LATENCY_BENCH_RTT, &before);
+
+    bench_config_init_defaults(&config);
+    config.connections = 3;
+    config.threads = 2;
+    config.depth = 4;
+    config.frame_size = 200;
+    config.duration_ms = 300;
+
+    TEST_ASSERT_EQUAL(0, bench_client_run(&config, "127.0.0.1", peer.port,
+                                          NULL, NULL, NULL, &result), "Run");
+    TEST_ASSERT_EQUAL(3, result.connected, "All connected");
+    TEST_ASSERT_EQUAL(0, result.failed + result.lost, "No failures");
+    TEST_ASSERT(result.frames_received > 100, "Echoes received");
+    TEST_ASSERT(result.frames_sent - result.frames_received <= 3 * 4,
+                "At most depth frames in flight per connection");
+    TEST_ASSERT_EQUAL(200, (int)(result.bytes_received /
+                                 result.frames_received), "Whole frames");
+
+    latency_snapshot(LATENCY_BENCH_RTT, &after);
+    TEST_ASSERT(after.count - before.count == result.frames_received,
+                "One RTT sample per echo");
+
+    echo_stop(&peer);
+}
+
+/**
+ * @brief Test a paced run sends at the target rate
+ */
+void test_run_paced(void) {
+    echo_peer_t peer;
+    bench_config_t config;
+    bench_result_t result;
+
+    TEST_ASSERT_EQUAL(0, echo_start(&peer), "Echo peer");
+
+    bench_config_init_defaults(&config);
+    config.connections = 2;
+    config.rate = 400;
+    config.duration_ms = 500;
+
+    TEST_ASSERT_EQUAL(0, bench_client_run(&config, "127.0.0.1", peer.port,
+                                          NULL, NULL, NULL, &result), "Run");
+    /* 200 frames due; allow for scheduling noise on a loaded host */
+    TEST_ASSERT(result.frames_sent >= 150 && result.frames_sent <= 210,
+                "Sent at the target rate");
+
+    echo_stop(&peer);
+}
+
+/**
+ * @brief Test the stop flag ends a run early
+ */
+void test_stop(void) {
+    echo_peer_t peer;
+    bench_config_t config;
+    bench_result_t result;
+    volatile sig_atomic_t stop = 1;
+
+    TEST_ASSERT_EQUAL(0, echo_start(&peer), "Echo peer");
+
+    bench_config_init_defaults(&config);
+    config.connections = 1;
+    config.duration_ms = 60000;
+
+    TEST_ASSERT_EQUAL(0, bench_client_run(&config, "127.0.0.1", peer.port,
+                                          NULL, NULL, &stop, &result), "Run");
+    TEST_ASSERT(result.elapsed_ns < 1000000000ULL, "Stopped early");
+
+    echo_stop(&peer);
+}
+
+/**
+ * @brief Test a run without a reachable server reports every failure
+ */
+void test_no_server(void) {
+    echo_peer_t peer;
+    bench_config_t config;
+    bench_result_t result;
+    int port;
+
+    /* A port that was just free */
+    TEST_ASSERT_EQUAL(0, echo_start(&peer), "Echo peer");
+    port = peer.port;
+    echo_stop(&peer);
+
+    bench_config_init_defaults(&config);
+    config.connections = 2;
+    config.duration_ms = 100;
+
+    TEST_ASSERT_ERROR(bench_client_run(&config, "127.0.0.1", port, NULL, NULL,
+                                       NULL, &result),
+                      E_NETWORK_ERROR, "Nothing connected");
+    TEST_ASSERT_EQUAL(2, result.failed, "Failures counted");
+    TEST_ASSERT_ERROR(bench_client_run(NULL, "127.0.0.1", port, NULL, NULL,
+                                       NULL, &result),
+                      E_INVALID_ARGUMENT, "NULL config");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Bench Client Unit Tests ===\n\n");
+
+    /* Configuration tests */
+    run_test("test_config", test_config);
+
+    /* Run tests */
+    run_test("test_run_unlimited", test_run_unlimited);
+    run_test("test_run_paced", test_run_paced);
+    run_test("test_stop", test_stop);
+    run_test("test_no_server", test_no_server);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,630 @@
+/**
+ * @file test_cluster.c
+ * @brief Unit tests for routing USB devices across the nodes of a cluster
+ *
+ * Parses peer specifications and secret files, then runs two nodes on
+ * loopback, each with its own USB server, naming each other as peers:
+ * device_ids registered on one node become routes on the other, URBs no
+ * local client can take cross the links to the client that registered
+ * the device, and the route goes when the device unregisters. A raw
+ * socket playing a node checks that links come only from peer addresses
+ * and only up after a keyed answer for the right role, and that an
+ * oversized device snapshot drops the link.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/cluster.h"
+#include "connectors/usb/usb_server.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/security/usb_auth.h"
+#include "lib/common/definitions.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* Longest wait for a snapshot to reach the other node (ms) */
+#define TEST_SYNC_MS 5000
+
+/* Shared secret of the test nodes */
+#define TEST_SECRET "test-cluster-secret"
+
+/* Node id the raw socket claims */
+#define TEST_RAW_NODE 9
+
+static void init_config(cluster_config_t* config, int node_id) {
+    memset(config, 0, sizeof(*config));
+    config->node_id = node_id;
+    strcpy(config->secret, TEST_SECRET);
+}
+
+static void init_loopback(struct sockaddr_in* address, int port) {
+    memset(address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address->sin_port = htons((uint16_t)port);
+}
+
+/**
+ * @brief Listen on a free port of @ip
+ *
+ * @return Listening socket (its port in @port), or -1
+ */
+static int open_test_listener(const char* ip, int* port) {
+    struct sockaddr_in address;
+    socklen_t len = sizeof(address);
+    int fd;
+
+    init_loopback(&address, 0);
+    inet_pton(AF_INET, ip, &address.sin_addr);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(fd, 4) != 0 ||
+        getsockname(fd, (struct sockaddr*)&address, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(address.sin_port);
+    return fd;
+}
+
+/**
+ * @brief Connect to a node's link port, with a 2 s receive timeout
+ */
+static int connect_node(const cluster_t* node) {
+    struct sockaddr_in address;
+    struct timeval tv;
+    int fd;
+
+    init_loopback(&address, cluster_port(node));
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    tv.tv_sec = 2;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/**
+ * @brief Send a cluster frame as the raw node
+ */
+static int send_frame(int fd, int type, const uint8_t* body, uint32_t len) {
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    uint8_t* data;
+    int result;
+
+    data = (uint8_t*)malloc(CLUSTER_HEADER_SIZE + len);
+    if (data == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    data[0] = (uint8_t)type;
+    data[1] = 0;
+    data[2] = (uint8_t)(TEST_RAW_NODE >> 8);
+    data[3] = (uint8_t)TEST_RAW_NODE;
+    if (len > 0) {
+        memcpy(data + CLUSTER_HEADER_SIZE, body, len);
+    }
+
+    payload.data = data;
+    payload.len = CLUSTER_HEADER_SIZE + len;
+    payload.owns_data = FALSE;
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_CLUSTER;
+    packet.protocol_version = CLUSTER_VERSION;
+    packet.payload = &payload;
+
+    result = xoe_wire_send(fd, &packet);
+    free(data);
+    return result;
+}
+
+/**
+ * @brief Receive cluster frames until one of @type, skipping the rest
+ *
+ * @return Body length (up to @size copied to @body), or a negative error
+ */
+static int recv_frame(int fd, int type, uint8_t* body, uint32_t size) {
+    xoe_packet_t packet;
+    const uint8_t* data;
+    uint32_t len;
+
+    while (xoe_wire_recv(fd, &packet) == 0) {
+        data = (const uint8_t*)packet.payload->data;
+        len = packet.payload->len;
+        if (packet.protocol_id == XOE_PROTOCOL_CLUSTER &&
+            len >= CLUSTER_HEADER_SIZE && data[0] == type) {
+            len -= CLUSTER_HEADER_SIZE;
+            memcpy(body, data + CLUSTER_HEADER_SIZE, (len < size) ? len : size);
+            xoe_wire_free_payload(&packet);
+            return (int)len;
+        }
+        xoe_wire_free_payload(&packet);
+    }
+    return E_IO_ERROR;
+}
+
+/**
+ * @brief Whether the node closes @fd within the receive timeout
+ */
+static int link_closed(int fd) {
+    uint8_t buffer[256];
+    ssize_t received;
+
+    do {
+        received = recv(fd, buffer, sizeof(buffer), 0);
+    } while (received > 0);
+    return received == 0 || errno == ECONNRESET;
+}
+
+/**
+ * @brief Exchange HELLOs with a node and answer its challenge
+ *
+ * @return 0 once the answer is sent, negative error code otherwise
+ */
+static int raw_handshake(int fd, int role) {
+    uint8_t theirs[USB_AUTH_CHALLENGE_LEN];
+    uint8_t ours[USB_AUTH_CHALLENGE_LEN];
+    uint8_t answer[USB_AUTH_RESPONSE_LEN];
+    usb_auth_key_t* key;
+    int result = E_PROTOCOL_ERROR;
+
+    if (recv_frame(fd, CLUSTER_MSG_HELLO, theirs, sizeof(theirs)) !=
+        USB_AUTH_CHALLENGE_LEN ||
+        usb_auth_generate_challenge(ours) != 0 ||
+        send_frame(fd, CLUSTER_MSG_HELLO, ours, sizeof(ours)) != 0 ||
+        recv_frame(fd, CLUSTER_MSG_AUTH, answer, sizeof(answer)) !=
+        USB_AUTH_RESPONSE_LEN) {
+        return E_PROTOCOL_ERROR;
+    }
+
+    key = usb_auth_key_create(TEST_SECRET);
+    if (key == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    /* The node accepted the link, so it answers as the acceptor */
+    if (usb_auth_key_verify(key, ours, 1, CLUSTER_ROLE_ACCEPTOR,
+                            answer) == 1 &&
+        usb_auth_key_compute(key, theirs, TEST_RAW_NODE, (uint8_t)role,
+                             answer) == 0) {
+        result = send_frame(fd, CLUSTER_MSG_AUTH, answer, sizeof(answer));
+    }
+    usb_auth_key_free(key);
+    return result;
+}
+
+static void init_test_urb(usb_urb_header_t* urb, uint32_t device_id,
+                          uint32_t seqnum) {
+    memset(urb, 0, sizeof(*urb));
+    urb->command = USB_CMD_SUBMIT;
+    urb->seqnum = seqnum;
+    urb->device_id = device_id;
+    urb->endpoint = 0x81;
+    urb->transfer_type = USB_TRANSFER_BULK;
+    urb->transfer_length = 4;
+    urb->actual_length = 4;
+}
+
+/**
+ * @brief Receive one URB on a socket, with a short timeout
+ *
+ * @return 0 and the header on success, negative error code otherwise
+ */
+static int recv_test_urb(int fd, usb_urb_header_t* urb) {
+    xoe_packet_t packet;
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint32_t data_len = sizeof(data);
+    struct timeval tv;
+    int result;
+
+    tv.tv_sec = 2;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    result = xoe_wire_recv(fd, &packet);
+    if (result != 0) {
+        return result;
+    }
+    result = usb_protocol_decapsulate(&packet, urb, data, &data_len);
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Wait until a node routes @p device_id to @p node_id
+ *
+ * @return TRUE if it did within TEST_SYNC_MS
+ */
+static int wait_route(cluster_t* cluster, uint32_t device_id, int node_id) {
+    int waited;
+
+    for (waited = 0; waited < TEST_SYNC_MS; waited += 10) {
+        if (cluster_route(cluster, device_id) == node_id) {
+            return TRUE;
+        }
+        usleep(10000);
+    }
+    return FALSE;
+}
+
+/* ============================================================================
+ * Configuration Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test splitting "host:port" peers
+ */
+void test_parse_peer(void) {
+    char host[32];
+    int port = 0;
+
+    TEST_ASSERT_SUCCESS(cluster_parse_peer("node-2.local:12346", host,
+                                           sizeof(host), &port),
+                        "Host and port parsed");
+    TEST_ASSERT_STR_EQUAL("node-2.local", host, "Host kept");
+    TEST_ASSERT_EQUAL(12346, port, "Port kept");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      cluster_parse_peer("node-2", host, sizeof(host), &port),
+                      "Missing port refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      cluster_parse_peer(":12346", host, sizeof(host), &port),
+                      "Missing host refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      cluster_parse_peer("node-2:0", host, sizeof(host), &port),
+                      "Port 0 refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      cluster_parse_peer("node-2:80x", host, sizeof(host), &port),
+                      "Trailing junk refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      cluster_parse_peer("a-rather-long-host-name-here:1", host,
+                                         8, &port),
+                      "Host longer than the buffer refused");
+}
+
+/**
+ * @brief Test a node without a USB server, and a node without an id
+ */
+void test_start_config(void) {
+    cluster_config_t config;
+    cluster_t* node;
+    struct sockaddr_in address;
+
+    init_loopback(&address, 0);
+
+    init_config(&config, 3);
+    node = cluster_start(&config, &address, NULL);
+    TEST_ASSERT_NOT_NULL(node, "Node started without a USB server");
+    cluster_stop(node);
+
+    config.secret[0] = '\0';
+    TEST_ASSERT(cluster_start(&config, &address, NULL) == NULL,
+                "Node without a secret refused");
+
+    init_config(&config, 0);
+    TEST_ASSERT(cluster_start(&config, &address, NULL) == NULL,
+                "Node id 0 refused");
+}
+
+/**
+ * @brief Test reading the secret from the first line of a file
+ */
+void test_load_secret(void) {
+    char path[] = "/tmp/test_cluster_secretXXXXXX";
+    char long_secret[USB_AUTH_SECRET_MAX + 1];
+    cluster_config_t config;
+    FILE* file;
+    int fd;
+
+    memset(&config, 0, sizeof(config));
+    fd = mkstemp(path);
+    file = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (file == NULL) {
+        TEST_SKIP("cannot create a temporary file");
+        return;
+    }
+    fputs("s3cret\nsecond line\n", file);
+    fclose(file);
+
+    TEST_ASSERT_SUCCESS(cluster_load_secret(path, &config), "Secret read");
+    TEST_ASSERT_STR_EQUAL("s3cret", config.secret, "First line, no newline");
+
+    file = fopen(path, "w");
+    if (file != NULL) {
+        fputs("\n", file);
+        fclose(file);
+    }
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, cluster_load_secret(path, &config),
+                      "Empty secret refused");
+
+    memset(long_secret, 'x', sizeof(long_secret) - 1);
+    long_secret[sizeof(long_secret) - 1] = '\0';
+    file = fopen(path, "w");
+    if (file != NULL) {
+        fputs(long_secret, file);
+        fclose(file);
+    }
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, cluster_load_secret(path, &config),
+                      "Secret too long for the HMAC key refused");
+
+    unlink(path);
+    TEST_ASSERT_EQUAL(E_FILE_NOT_FOUND, cluster_load_secret(path, &config),
+                      "Missing file refused");
+}
+
+/* ============================================================================
+ * Routing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test URBs crossing a link both ways, and routes going away
+ */
+void test_route_across_nodes(void) {
+    usb_server_t* server_a = usb_server_init();
+    usb_server_t* server_b = usb_server_init();
+    cluster_config_t config_a;
+    cluster_config_t config_b;
+    cluster_t* node_a = NULL;
+    cluster_t* node_b = NULL;
+    struct sockaddr_in address;
+    int port_b = 0;
+    int probe;
+    usb_urb_header_t urb;
+    usb_urb_header_t received;
+    const uint32_t device_id = 0x1234abcd;
+    const uint8_t data[4] = { 1, 2, 3, 4 };
+    int on_a[2] = { -1, -1 };
+    int on_b[2] = { -1, -1 };
+
+    if (server_a == NULL || server_b == NULL ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, on_a) != 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, on_b) != 0) {
+        TEST_SKIP("setup failed");
+        goto done;
+    }
+
+    /* A node accepts links only from its peers, so each names the other;
+     * B's port is picked first so A can be given it */
+    probe = open_test_listener("127.0.0.1", &port_b);
+    if (probe < 0) {
+        TEST_SKIP("no free port");
+        goto done;
+    }
+    close(probe);
+
+    init_loopback(&address, 0);
+    init_config(&config_a, 1);
+    config_a.peer_count = 1;
+    snprintf(config_a.peers[0], CLUSTER_PEER_MAX, "127.0.0.1:%d", port_b);
+    node_a = cluster_start(&config_a, &address, server_a);
+    TEST_ASSERT_NOT_NULL(node_a, "Node 1 started");
+    if (node_a == NULL) {
+        goto done;
+    }
+
+    init_loopback(&address, port_b);
+    init_config(&config_b, 2);
+    config_b.peer_count = 1;
+    snprintf(config_b.peers[0], CLUSTER_PEER_MAX, "127.0.0.1:%d",
+             cluster_port(node_a));
+    node_b = cluster_start(&config_b, &address, server_b);
+    TEST_ASSERT_NOT_NULL(node_b, "Node 2 started");
+    if (node_b == NULL) {
+        goto done;
+    }
+
+    /* A device on node 1 becomes a route on node 2 */
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server_a, on_a[0], device_id),
+                        "Device registered on node 1");
+    TEST_ASSERT(wait_route(node_b, device_id, 1), "Node 2 routes it to node 1");
+
+    init_test_urb(&urb, device_id, 7);
+    TEST_ASSERT_SUCCESS(usb_server_route_urb(server_b, &urb, data, 4, -5),
+                        "URB forwarded from node 2");
+    TEST_ASSERT_SUCCESS(recv_test_urb(on_a[1], &received),
+                        "Client on node 1 received it");
+    TEST_ASSERT_EQUAL(7, received.seqnum, "Same URB");
+    TEST_ASSERT_EQUAL(1, server_b->urbs_relayed, "Counted as relayed");
+
+    /* The peer of the device on node 2: each node's miss goes to the other */
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server_b, on_b[0], device_id),
+                        "Peer registered on node 2");
+    TEST_ASSERT(wait_route(node_a, device_id, 2), "Node 1 routes it to node 2");
+
+    init_test_urb(&urb, device_id, 8);
+    TEST_ASSERT_SUCCESS(usb_server_route_urb(server_a, &urb, data, 4, on_a[0]),
+                        "URB from node 1's client forwarded");
+    TEST_ASSERT_SUCCESS(recv_test_urb(on_b[1], &received),
+                        "Client on node 2 received it");
+    TEST_ASSERT_EQUAL(8, received.seqnum, "Same URB");
+
+    /* Unregistering withdraws the route */
+    TEST_ASSERT_SUCCESS(usb_server_unregister_client(server_a, on_a[0]),
+                        "Device unregistered on node 1");
+    TEST_ASSERT(wait_route(node_b, device_id, E_NOT_FOUND),
+                "Node 2 forgot the route");
+    init_test_urb(&urb, device_id, 9);
+    TEST_ASSERT_EQUAL(E_NOT_FOUND,
+                      usb_server_route_urb(server_b, &urb, data, 4, on_b[0]),
+                      "Nowhere to send it now");
+
+    /* Stopping a node withdraws everything it announced */
+    cluster_stop(node_b);
+    node_b = NULL;
+    TEST_ASSERT(wait_route(node_a, device_id, E_NOT_FOUND),
+                "Node 1 forgot node 2's devices");
+
+done:
+    cluster_stop(node_b);
+    cluster_stop(node_a);
+    if (on_a[0] >= 0) {
+        close(on_a[0]);
+        close(on_a[1]);
+    }
+    if (on_b[0] >= 0) {
+        close(on_b[0]);
+        close(on_b[1]);
+    }
+    usb_server_cleanup(server_a);
+    usb_server_cleanup(server_b);
+}
+
+/* ============================================================================
+ * Link Admission Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test refusing links from addresses no peer resolves to
+ */
+void test_refuse_unknown_address(void) {
+    cluster_config_t config;
+    cluster_t* node;
+    struct sockaddr_in address;
+    int peer_fd;
+    int peer_port = 0;
+    int fd;
+
+    /* The only peer is on 127.0.0.2; the test connects from 127.0.0.1 */
+    peer_fd = open_test_listener("127.0.0.2", &peer_port);
+    if (peer_fd < 0) {
+        TEST_SKIP("cannot listen on 127.0.0.2");
+        return;
+    }
+
+    init_loopback(&address, 0);
+    init_config(&config, 1);
+    config.peer_count = 1;
+    snprintf(config.peers[0], CLUSTER_PEER_MAX, "127.0.0.2:%d", peer_port);
+    node = cluster_start(&config, &address, NULL);
+    TEST_ASSERT_NOT_NULL(node, "Node started");
+    if (node != NULL) {
+        fd = connect_node(node);
+        TEST_ASSERT(fd >= 0, "Connected");
+        if (fd >= 0) {
+            TEST_ASSERT(link_closed(fd), "Closed without a HELLO");
+            close(fd);
+        }
+    }
+
+    cluster_stop(node);
+    close(peer_fd);
+}
+
+/**
+ * @brief Test the challenge: wrong role refused, right answer links up
+ */
+void test_link_auth(void) {
+    usb_server_t* server = usb_server_init();
+    cluster_config_t config;
+    cluster_t* node = NULL;
+    struct sockaddr_in address;
+    const uint32_t device_id = 0x0bad0001;
+    uint8_t* devices = NULL;
+    uint8_t id[4];
+    uint32_t i;
+    int peer_fd;
+    int peer_port = 0;
+    int fd;
+
+    /* The peer is the test's own address; the node's dial goes unanswered */
+    peer_fd = open_test_listener("127.0.0.1", &peer_port);
+    if (server == NULL || peer_fd < 0) {
+        TEST_SKIP("setup failed");
+        goto done;
+    }
+
+    init_loopback(&address, 0);
+    init_config(&config, 1);
+    config.peer_count = 1;
+    snprintf(config.peers[0], CLUSTER_PEER_MAX, "127.0.0.1:%d", peer_port);
+    node = cluster_start(&config, &address, server);
+    TEST_ASSERT_NOT_NULL(node, "Node started");
+    if (node == NULL) {
+        goto done;
+    }
+
+    /* An answer made for the acceptor's role cannot open a dialed link */
+    fd = connect_node(node);
+    TEST_ASSERT_SUCCESS(raw_handshake(fd, CLUSTER_ROLE_ACCEPTOR),
+                        "Node answered our challenge with the secret");
+    TEST_ASSERT(link_closed(fd), "Answer for the wrong role refused");
+    close(fd);
+
+    fd = connect_node(node);
+    TEST_ASSERT_SUCCESS(raw_handshake(fd, CLUSTER_ROLE_DIALER),
+                        "Handshake as the dialer");
+    id[0] = (uint8_t)(device_id >> 24);
+    id[1] = (uint8_t)(device_id >> 16);
+    id[2] = (uint8_t)(device_id >> 8);
+    id[3] = (uint8_t)device_id;
+    TEST_ASSERT_SUCCESS(send_frame(fd, CLUSTER_MSG_DEVICES, id, sizeof(id)),
+                        "Device snapshot sent");
+    TEST_ASSERT(wait_route(node, device_id, TEST_RAW_NODE),
+                "Authenticated node's device routed");
+
+    /* More device_ids than a server can register is a bad frame */
+    devices = (uint8_t*)malloc((CLUSTER_MAX_DEVICES + 1) * 4);
+    if (devices != NULL) {
+        for (i = 0; i < (CLUSTER_MAX_DEVICES + 1) * 4; i += 4) {
+            memcpy(devices + i, id, 4);
+        }
+        TEST_ASSERT_SUCCESS(send_frame(fd, CLUSTER_MSG_DEVICES, devices,
+                                       (CLUSTER_MAX_DEVICES + 1) * 4),
+                            "Oversized snapshot sent");
+        TEST_ASSERT(link_closed(fd), "Oversized snapshot drops the link");
+        TEST_ASSERT(wait_route(node, device_id, E_NOT_FOUND),
+                    "Routes went with the node's last link");
+    }
+    close(fd);
+
+done:
+    free(devices);
+    cluster_stop(node);
+    if (peer_fd >= 0) {
+        close(peer_fd);
+    }
+    usb_server_cleanup(server);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Cluster Unit Tests ===\n\n");
+
+    /* Configuration tests */
+    run_test("test_parse_peer", test_parse_peer);
+
+    run_test("test_start_config", test_start_config);
+
+    run_test("test_load_secret", test_load_secret);
+
+    /* Routing tests */
+    run_test("test_route_across_nodes", test_route_across_nodes);
+
+    /* Link admission tests */
+    run_test("test_refuse_unknown_address", test_refuse_unknown_address);
+
+    run_test("test_link_auth", test_link_auth);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file test_crc32.c
+ * @brief Unit tests for the CRC32 dispatch layer
+ *
+ * Verifies that whichever kernel is selected on this CPU produces the
+ * same results as zlib crc32() across lengths, alignments and chaining,
+ * and that the network-order helpers match byte-wise CRCs.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/crc32.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define TEST_BUFFER_SIZE 70000
+
+static uint8_t test_buffer[TEST_BUFFER_SIZE];
+
+static void fill_test_buffer(void) {
+    uint32_t state = 0x12345678;
+    uint32_t i;
+
+    for (i = 0; i < TEST_BUFFER_SIZE; i++) {
+        state = state * 1103515245 + 12345;
+        test_buffer[i] = (uint8_t)(state >> 16);
+    }
+}
+
+static uint32_t zlib_crc(uint32_t crc, const uint8_t* data, uint32_t len) {
+    return (uint32_t)crc32((uLong)crc, (const Bytef*)data, (uInt)len);
+}
+
+/* ============================================================================
+ * xoe_crc32_update() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test known check value ("123456789" -> 0xCBF43926)
+ */
+void test_update_check_value(void) {
+    const char* check = "123456789";
+
+    TEST_ASSERT_EQUAL(0xCBF43926UL, xoe_crc32_update(0, check, 9),
+                      "CRC32 check value should match");
+}
+
+/**
+ * @brief Test every length up to several SIMD blocks at all alignments
+ */
+void test_update_matches_zlib(void) {
+    uint32_t offset;
+    uint32_t len;
+    int mismatches = 0;
+
+    for (offset = 0; offset < 16; offset++) {
+        for (len = 0; len <= 1024; len++) {
+            if (xoe_crc32_update(0, test_buffer + offset, len) !=
+                zlib_crc(0, test_buffer + offset, len)) {
+                mismatches++;
+            }
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, mismatches, "All lengths/alignments should match zlib");
+}
+
+/**
+ * @brief Test large buffers (wire maximum region)
+ */
+void test_update_large(void) {
+    TEST_ASSERT_EQUAL(zlib_crc(0, test_buffer, TEST_BUFFER_SIZE),
+                      xoe_crc32_update(0, test_buffer, TEST_BUFFER_SIZE),
+                      "Large buffer should match zlib");
+    TEST_ASSERT_EQUAL(zlib_crc(0, test_buffer + 3, 65536 + 13),
+                      xoe_crc32_update(0, test_buffer + 3, 65536 + 13),
+                      "Unaligned large buffer should match zlib");
+}
+
+/**
+ * @brief Test that chained updates equal a single pass
+ */
+void test_update_chaining(void) {
+    uint32_t crc;
+
+    crc = xoe_crc32_update(0, test_buffer, 100);
+    crc = xoe_crc32_update(crc, test_buffer + 100, 900);
+
+    TEST_ASSERT_EQUAL(zlib_crc(0, test_buffer, 1000), crc,
+                      "Chained CRC should equal single pass");
+}
+
+/**
+ * @brief Test NULL/empty input leaves the CRC unchanged
+ */
+void test_update_empty(void) {
+    TEST_ASSERT_EQUAL(0x1234, xoe_crc32_update(0x1234, NULL, 0),
+                      "Empty update should not change CRC");
+    TEST_ASSERT_EQUAL(0x1234, xoe_crc32_update(0x1234, test_buffer, 0),
+                      "Zero length should not change CRC");
+}
+
+/* ============================================================================
+ * Network Order Helper Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test be16/be32 helpers against serialized bytes
+ */
+void test_be_helpers(void) {
+    uint8_t bytes[6] = {0x12, 0x34, 0xDE, 0xAD, 0xBE, 0xEF};
+    uint32_t crc;
+
+    crc = xoe_crc32_be16(0, 0x1234);
+    crc = xoe_crc32_be32(crc, 0xDEADBEEFUL);
+
+    TEST_ASSERT_EQUAL(zlib_crc(0, bytes, sizeof(bytes)), crc,
+                      "Network order helpers should match byte-wise CRC");
+}
+
+/**
+ * @brief Test that a kernel name is reported
+ */
+void test_impl_name(void) {
+    const char* name = xoe_crc32_impl_name();
+
+    TEST_ASSERT_NOT_NULL(name, "Kernel name should be available");
+    if (name != NULL) {
+        printf("  (kernel: %s)\n", name);
+    }
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== CRC32 Unit Tests ===\n\n");
+
+    fill_test_buffer();
+
+    /* xoe_crc32_update() tests */
+    run_test("test_update_check_value", test_update_check_value);
+    run_test("test_update_matches_zlib", test_update_matches_zlib);
+    run_test("test_update_large", test_update_large);
+    run_test("test_update_chaining", test_update_chaining);
+    run_test("test_update_empty", test_update_empty);
+
+    /* Network order helper tests */
+    run_test("test_be_helpers", test_be_helpers);
+    run_test("test_impl_name", test_impl_name);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file test_event_poller.c
+ * @brief Unit tests for the shared event loop poller
+ *
+ * Level-triggered readability, hangup reported as readable, write
+ * interest on and off, reading paused and resumed, and removal, on the
+ * platform's default backend; asking for io_uring always yields a
+ * working poller, with or without kernel support.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/event_poller.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Wait used where an event is expected (ms) */
+#define TEST_WAIT_MS 1000
+
+/* Wait used where no event is expected (ms) */
+#define TEST_QUIET_MS 50
+
+static int tag_a;
+static int tag_b;
+
+/**
+ * @brief Check readiness, hangup and removal on one poller
+ */
+static void check_readable(event_poller_t *poller) {
+    event_poller_event_t events[4];
+    char buf[8];
+    int sv[2];
+    int n;
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv),
+                      "socketpair");
+    TEST_ASSERT_EQUAL(0, event_poller_add(poller, sv[0], &tag_a), "Add");
+
+    n = event_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Idle socket reports nothing");
+
+    TEST_ASSERT_EQUAL(1, (int)write(sv[1], "x", 1), "Write");
+    n = event_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Data reported");
+    TEST_ASSERT(events[0].data == &tag_a, "Event carries its data");
+    TEST_ASSERT(events[0].readable && !events[0].writable, "Readable only");
+
+    n = event_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Unread data reported again");
+
+    TEST_ASSERT_EQUAL(1, (int)read(sv[0], buf, sizeof(buf)), "Drain");
+    n = event_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Drained socket quiet");
+
+    close(sv[1]);
+    n = event_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT(n == 1 && events[0].readable, "Hangup reported as readable");
+
+    event_poller_remove(poller, sv[0]);
+    n = event_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Removed descriptor reports nothing");
+    close(sv[0]);
+}
+
+/* ============================================================================
+ * Readiness Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test data and hangup are reported until consumed or removed
+ */
+void test_readable_level_triggered(void) {
+    event_poller_t poller;
+
+    TEST_ASSERT_EQUAL(0, event_poller_create(&poller, FALSE), "Create");
+    check_readable(&poller);
+    event_poller_destroy(&poller);
+    TEST_ASSERT_EQUAL(-1, poller.fd, "Destroy resets the descriptor");
+}
+
+/**
+ * @brief Test write interest is reported only while enabled
+ */
+void test_write_interest(void) {
+    event_poller_t poller;
+    event_poller_event_t events[4];
+    int sv[2];
+    int n;
+
+    TEST_ASSERT_EQUAL(0, event_poller_create(&poller, FALSE), "Create");
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    event_poller_add(&poller, sv[0], &tag_a);
+
+    TEST_ASSERT_EQUAL(0, event_poller_set_write(&poller, sv[0], &tag_b, TRUE),
+                      "Enable write interest");
+    n = event_poller_wait(&poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Writable reported");
+    TEST_ASSERT(events[0].writable && !events[0].readable,
+                "Writable flag only");
+    TEST_ASSERT(events[0].data == &tag_b, "Updated data returned");
+
+    TEST_ASSERT_EQUAL(0, event_poller_set_write(&poller, sv[0], &tag_b, FALSE),
+                      "Drop write interest");
+    n = event_poller_wait(&poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Quiet once write interest dropped");
+
+    write(sv[1], "x", 1);
+    n = event_poller_wait(&poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT(n == 1 && events[0].readable, "Still watched for reading");
+
+    close(sv[0]);
+    close(sv[1]);
+    event_poller_destroy(&poller);
+}
+
+/**
+ * @brief Test reading can be paused while data waits, and resumed
+ */
+void test_read_paused(void) {
+    event_poller_t poller;
+    event_poller_event_t events[4];
+    int sv[2];
+    int n;
+
+    TEST_ASSERT_EQUAL(0, event_poller_create(&poller, FALSE), "Create");
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    event_poller_add(&poller, sv[0], &tag_a);
+    write(sv[1], "x", 1);
+
+    TEST_ASSERT_EQUAL(0, event_poller_set_interest(&poller, sv[0], &tag_a,
+                                                   FALSE, FALSE),
+                      "Pause reading");
+    n = event_poller_wait(&poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Unread data not reported while paused");
+
+    TEST_ASSERT_EQUAL(0, event_poller_set_interest(&poller, sv[0], &tag_a,
+                                                   FALSE, TRUE),
+                      "Write interest while paused");
+    n = event_poller_wait(&poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT(n == 1 && events[0].writable && !events[0].readable,
+                "Only writability reported");
+
+    TEST_ASSERT_EQUAL(0, event_poller_set_write(&poller, sv[0], &tag_a, FALSE),
+                      "Write interest dropped");
+    n = event_poller_wait(&poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT(n == 1 && events[0].readable, "Reading resumed");
+
+    close(sv[0]);
+    close(sv[1]);
+    event_poller_destroy(&poller);
+}
+
+/* ============================================================================
+ * Backend Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test asking for io_uring gives a working poller either way
+ */
+void test_io_uring_request(void) {
+    event_poller_t poller;
+
+    TEST_ASSERT_EQUAL(0, event_poller_create(&poller, TRUE),
+                      "Create falls back when io_uring is missing");
+    TEST_ASSERT(poller.uring != NULL || poller.fd >= 0, "Some backend set");
+    check_readable(&poller);
+    event_poller_destroy(&poller);
+    TEST_ASSERT_NULL(poller.uring, "Destroy releases the ring");
+}
+
+/**
+ * @brief Test destroying a never-created poller and NULL are no-ops
+ */
+void test_destroy_unused(void) {
+    event_poller_t poller;
+
+    poller.fd = -1;
+    poller.uring = NULL;
+    event_poller_destroy(&poller);
+    event_poller_destroy(NULL);
+    TEST_ASSERT_EQUAL(-1, poller.fd, "Unused poller untouched");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Event Poller Unit Tests ===\n\n");
+
+    /* Readiness tests */
+    run_test("test_readable_level_triggered", test_readable_level_triggered);
+    run_test("test_write_interest", test_write_interest);
+    run_test("test_read_paused", test_read_paused);
+
+    /* Backend tests */
+    run_test("test_io_uring_request", test_io_uring_request);
+    run_test("test_destroy_unused", test_destroy_unused);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
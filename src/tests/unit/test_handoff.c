@@ -0,0 +1,247 @@
+/**
+ * @file test_handoff.c
+ * @brief Unit tests for the upgrade handoff between server processes
+ *
+ * Passing descriptors with their records over a socket pair, the end
+ * marker, malformed and truncated streams, and the upgrade socket from
+ * listen through hello to accept, including which files at its path are
+ * replaced.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/handoff.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Check a received descriptor reaches the same pipe as the original
+ */
+static int same_pipe(int received_write_end, int read_end)
+{
+    char byte = 0;
+
+    if (write(received_write_end, "x", 1) != 1 ||
+        read(read_end, &byte, 1) != 1) {
+        return FALSE;
+    }
+    return byte == 'x';
+}
+
+/* ============================================================================
+ * Message Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test listening descriptors arrive and refer to the same files
+ */
+void test_listeners_roundtrip(void) {
+    int pair[2];
+    int pipe_a[2];
+    int pipe_b[2];
+    int sent[2];
+    int fds[HANDOFF_MAX_FDS];
+    int count = 0;
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair),
+                      "Socket pair");
+    TEST_ASSERT_EQUAL(0, pipe(pipe_a), "Pipe A");
+    TEST_ASSERT_EQUAL(0, pipe(pipe_b), "Pipe B");
+    sent[0] = pipe_a[1];
+    sent[1] = pipe_b[1];
+
+    TEST_ASSERT_EQUAL(0, handoff_send_listeners(pair[0], sent, 2), "Send");
+    TEST_ASSERT_EQUAL(0, handoff_recv_listeners(pair[1], fds,
+                                                HANDOFF_MAX_FDS, &count),
+                      "Receive");
+    TEST_ASSERT_EQUAL(2, count, "Both descriptors");
+    TEST_ASSERT(fds[0] != pipe_a[1], "New descriptor number");
+    TEST_ASSERT(same_pipe(fds[0], pipe_a[0]), "First in order");
+    TEST_ASSERT(same_pipe(fds[1], pipe_b[0]), "Second in order");
+
+    TEST_ASSERT_ERROR(handoff_send_listeners(pair[0], sent, 0),
+                      E_INVALID_ARGUMENT, "No descriptors");
+    TEST_ASSERT_ERROR(handoff_send_listeners(pair[0], sent,
+                                             HANDOFF_MAX_FDS + 1),
+                      E_INVALID_ARGUMENT, "Too many descriptors");
+
+    close(fds[0]);
+    close(fds[1]);
+    close(pipe_a[0]);
+    close(pipe_a[1]);
+    close(pipe_b[0]);
+    close(pipe_b[1]);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+/**
+ * @brief Test connections keep their address, features and kTLS flag
+ */
+void test_conn_roundtrip(void) {
+    int pair[2];
+    int pipe_fds[2];
+    handoff_conn_t out;
+    handoff_conn_t in;
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair),
+                      "Socket pair");
+    TEST_ASSERT_EQUAL(0, pipe(pipe_fds), "Pipe");
+
+    memset(&out, 0, sizeof(out));
+    out.fd = pipe_fds[1];
+    out.addr.sin_family = AF_INET;
+    out.addr.sin_addr.s_addr = htonl(0x0A000001);
+    out.addr.sin_port = htons(40000);
+    out.wire_features = 0x5;
+    out.ktls = TRUE;
+
+    TEST_ASSERT_EQUAL(0, handoff_send_conn(pair[0], &out), "Send");
+    TEST_ASSERT_EQUAL(0, handoff_send_end(pair[0]), "Send end");
+
+    TEST_ASSERT_EQUAL(1, handoff_recv_conn(pair[1], &in), "Connection");
+    TEST_ASSERT(same_pipe(in.fd, pipe_fds[0]), "Descriptor passed");
+    TEST_ASSERT_EQUAL(AF_INET, in.addr.sin_family, "Family");
+    TEST_ASSERT(in.addr.sin_addr.s_addr == htonl(0x0A000001), "Address");
+    TEST_ASSERT_EQUAL(40000, ntohs(in.addr.sin_port), "Port");
+    TEST_ASSERT_EQUAL(0x5, (int)in.wire_features, "Features");
+    TEST_ASSERT_EQUAL(TRUE, in.ktls, "Kernel TLS flag");
+    TEST_ASSERT_EQUAL(0, handoff_recv_conn(pair[1], &in), "End marker");
+
+    close(in.fd);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+/**
+ * @brief Test malformed, mistyped and cut-off streams are rejected
+ */
+void test_bad_stream(void) {
+    int pair[2];
+    int fds[HANDOFF_MAX_FDS];
+    int count;
+    handoff_conn_t conn;
+    char garbage[64];
+
+    memset(garbage, 0x5A, sizeof(garbage));
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair),
+                      "Socket pair");
+    TEST_ASSERT(write(pair[0], garbage, sizeof(garbage)) > 0, "Write");
+    TEST_ASSERT_ERROR(handoff_recv_conn(pair[1], &conn), E_PROTOCOL_ERROR,
+                      "Bad magic");
+    close(pair[0]);
+    close(pair[1]);
+
+    /* An end marker where listeners are expected */
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, pair),
+                      "Socket pair");
+    TEST_ASSERT_EQUAL(0, handoff_send_end(pair[0]), "Send end");
+    TEST_ASSERT_ERROR(handoff_recv_listeners(pair[1], fds, HANDOFF_MAX_FDS,
+                                             &count),
+                      E_PROTOCOL_ERROR, "Wrong message type");
+
+    /* Peer gone mid-stream */
+    close(pair[0]);
+    TEST_ASSERT_ERROR(handoff_recv_conn(pair[1], &conn), E_NETWORK_ERROR,
+                      "Closed peer");
+    close(pair[1]);
+
+    TEST_ASSERT_ERROR(handoff_recv_conn(-1, &conn), E_INVALID_ARGUMENT,
+                      "Bad socket");
+    TEST_ASSERT_ERROR(handoff_send_conn(0, NULL), E_INVALID_ARGUMENT,
+                      "NULL connection");
+}
+
+/* ============================================================================
+ * Upgrade Socket Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test connect, hello and accept on a filesystem socket
+ */
+void test_upgrade_socket(void) {
+    char path[HANDOFF_PATH_MAX];
+    struct stat st;
+    int listen_fd;
+    int client;
+    int server;
+    int fd;
+
+    snprintf(path, sizeof(path), "/tmp/xoe-test-handoff-%d.sock",
+             (int)getpid());
+    (void)unlink(path);
+
+    TEST_ASSERT_ERROR(handoff_connect(path), E_NOT_FOUND, "Nobody listening");
+
+    /* A socket file left behind by a dead server is replaced */
+    listen_fd = handoff_listen(path);
+    TEST_ASSERT(listen_fd >= 0, "Listen");
+    close(listen_fd);
+    TEST_ASSERT(stat(path, &st) == 0, "Stale path left");
+    listen_fd = handoff_listen(path);
+    TEST_ASSERT(listen_fd >= 0, "Listen over stale path");
+    TEST_ASSERT(stat(path, &st) == 0 && (st.st_mode & 0777) == 0600,
+                "Owner only");
+
+    client = handoff_connect(path);
+    TEST_ASSERT(client >= 0, "Connect and hello");
+    server = handoff_accept(listen_fd);
+    TEST_ASSERT(server >= 0, "Accept with hello");
+
+    TEST_ASSERT_EQUAL(0, handoff_send_end(server), "Server to client");
+    {
+        handoff_conn_t conn;
+        TEST_ASSERT_EQUAL(0, handoff_recv_conn(client, &conn), "Received");
+    }
+
+    /* A server still listening keeps its socket */
+    TEST_ASSERT(handoff_listen(path) < 0, "Live socket not replaced");
+    TEST_ASSERT(stat(path, &st) == 0 && S_ISSOCK(st.st_mode), "Socket kept");
+
+    close(client);
+    close(server);
+    handoff_close_listener(listen_fd, path);
+    TEST_ASSERT(stat(path, &st) != 0, "Path removed");
+
+    /* Only sockets are removed */
+    fd = open(path, O_CREAT | O_WRONLY, 0600);
+    TEST_ASSERT(fd >= 0, "Regular file created");
+    close(fd);
+    TEST_ASSERT(handoff_listen(path) < 0, "Regular file not replaced");
+    TEST_ASSERT(stat(path, &st) == 0 && S_ISREG(st.st_mode), "File kept");
+    (void)unlink(path);
+
+    TEST_ASSERT_ERROR(handoff_listen(""), E_INVALID_ARGUMENT, "Empty path");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Handoff Unit Tests ===\n\n");
+
+    /* Message tests */
+    run_test("test_listeners_roundtrip", test_listeners_roundtrip);
+    run_test("test_conn_roundtrip", test_conn_roundtrip);
+    run_test("test_bad_stream", test_bad_stream);
+
+    /* Upgrade socket tests */
+    run_test("test_upgrade_socket", test_upgrade_socket);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
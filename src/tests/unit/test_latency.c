@@ -0,0 +1,272 @@
+/**
+ * @file test_latency.c
+ * @brief Unit tests for the latency histograms
+ *
+ * Bucket precision across the range, percentiles of known distributions,
+ * exact counts under concurrent recording, and the Prometheus summary
+ * format.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/latency.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Samples per thread in the concurrency test */
+#define TEST_SAMPLES_PER_THREAD 10000
+
+/* Threads in the concurrency test */
+#define TEST_THREADS 4
+
+/**
+ * @brief Histogram samples recorded since an earlier snapshot
+ */
+static void snapshot_delta(latency_id_t id, const latency_snapshot_t* before,
+                           latency_snapshot_t* delta)
+{
+    int i;
+
+    latency_snapshot(id, delta);
+    delta->count -= before->count;
+    delta->sum_ns -= before->sum_ns;
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        delta->buckets[i] -= before->buckets[i];
+    }
+}
+
+/**
+ * @brief Thread body: record TEST_SAMPLES_PER_THREAD samples
+ */
+static void* record_thread(void* arg)
+{
+    int i;
+
+    (void)arg;
+    for (i = 0; i < TEST_SAMPLES_PER_THREAD; i++) {
+        latency_record(LATENCY_SERIAL_TO_NET, (uint64_t)(i + 1) * 100);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Histogram Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test single samples come back within the bucket precision
+ */
+void test_single_sample_precision(void) {
+    static const uint64_t samples[] = {
+        0, 1, 15, 31, 32, 33, 1000, 12345, 999999, 123456789ULL,
+        (1ULL << 39) + 12345
+    };
+    latency_snapshot_t before;
+    latency_snapshot_t delta;
+    uint64_t value;
+    size_t i;
+    int ok = TRUE;
+
+    for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+        latency_snapshot(LATENCY_USB_ROUTE, &before);
+        latency_record(LATENCY_USB_ROUTE, samples[i]);
+        snapshot_delta(LATENCY_USB_ROUTE, &before, &delta);
+        delta.max_ns = 0;
+
+        value = latency_percentile(&delta, 0.5);
+        if (delta.count != 1 || value < samples[i] ||
+            value - samples[i] > samples[i] / LATENCY_SUB_BUCKETS) {
+            ok = FALSE;
+        }
+    }
+    TEST_ASSERT(ok, "Reported value should be within one sub-bucket");
+
+    /* Small values are exact */
+    latency_snapshot(LATENCY_USB_ROUTE, &before);
+    latency_record(LATENCY_USB_ROUTE, 17);
+    snapshot_delta(LATENCY_USB_ROUTE, &before, &delta);
+    delta.max_ns = 0;
+    TEST_ASSERT_EQUAL(17, latency_percentile(&delta, 0.5),
+                      "Values below two sub-bucket spans should be exact");
+}
+
+/**
+ * @brief Test samples beyond the range land in the last bucket
+ */
+void test_out_of_range_sample(void) {
+    latency_snapshot_t before;
+    latency_snapshot_t delta;
+
+    latency_snapshot(LATENCY_USB_ROUTE, &before);
+    latency_record(LATENCY_USB_ROUTE, ~(uint64_t)0);
+    snapshot_delta(LATENCY_USB_ROUTE, &before, &delta);
+
+    TEST_ASSERT_EQUAL(1, delta.buckets[LATENCY_BUCKETS - 1],
+                      "Huge sample should land in the last bucket");
+    TEST_ASSERT_EQUAL(~(uint64_t)0, delta.max_ns,
+                      "Maximum should keep the real value");
+}
+
+/**
+ * @brief Test percentiles of a uniform distribution
+ */
+void test_percentiles(void) {
+    latency_snapshot_t before;
+    latency_snapshot_t delta;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    int i;
+
+    latency_snapshot(LATENCY_USB_URB_COMPLETION, &before);
+    for (i = 1; i <= 10000; i++) {
+        latency_record(LATENCY_USB_URB_COMPLETION, (uint64_t)i * 1000);
+    }
+    snapshot_delta(LATENCY_USB_URB_COMPLETION, &before, &delta);
+
+    p50 = latency_percentile(&delta, 0.5);
+    p99 = latency_percentile(&delta, 0.99);
+    p999 = latency_percentile(&delta, 0.999);
+
+    TEST_ASSERT_EQUAL(10000, delta.count, "Every sample should be counted");
+    TEST_ASSERT(p50 >= 5000000 && p50 <= 5000000 + 5000000 / 16,
+                "p50 should be near 5 ms");
+    TEST_ASSERT(p99 >= 9900000 && p99 <= 9900000 + 9900000 / 16,
+                "p99 should be near 9.9 ms");
+    TEST_ASSERT(p999 >= 9990000 && p999 <= 10000000,
+                "p999 should be near 9.99 ms and capped at the maximum");
+    TEST_ASSERT(p50 <= p99 && p99 <= p999, "Percentiles should be ordered");
+    TEST_ASSERT_EQUAL(10000000, latency_percentile(&delta, 1.0),
+                      "p100 should be the maximum");
+}
+
+/**
+ * @brief Test empty histograms and invalid ids
+ */
+void test_empty_and_invalid(void) {
+    latency_snapshot_t snapshot;
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    TEST_ASSERT_EQUAL(0, latency_percentile(&snapshot, 0.99),
+                      "Empty histogram should report zero");
+    TEST_ASSERT_EQUAL(0, latency_percentile(NULL, 0.5),
+                      "NULL snapshot should report zero");
+
+    latency_record(LATENCY_COUNT, 1);
+    latency_snapshot(LATENCY_COUNT, &snapshot);
+    TEST_ASSERT_EQUAL(0, snapshot.count,
+                      "Out-of-range id should give an empty snapshot");
+    TEST_ASSERT_NULL(latency_describe(LATENCY_COUNT),
+                     "No description past the registry");
+    TEST_ASSERT_NOT_NULL(latency_describe(LATENCY_SERIAL_TO_NET),
+                         "Registered histogram should be described");
+}
+
+/**
+ * @brief Test latency_record_since() measures elapsed time
+ */
+void test_record_since(void) {
+    latency_snapshot_t before;
+    latency_snapshot_t delta;
+    uint64_t start;
+
+    latency_snapshot(LATENCY_USB_ROUTE, &before);
+    start = latency_now_ns();
+    latency_record_since(LATENCY_USB_ROUTE, start);
+    latency_record_since(LATENCY_USB_ROUTE, start + 1000000000ULL);
+    snapshot_delta(LATENCY_USB_ROUTE, &before, &delta);
+
+    TEST_ASSERT_EQUAL(2, delta.count, "Both samples should be counted");
+    TEST_ASSERT(delta.buckets[0] >= 1,
+                "Start in the future should record zero");
+}
+
+/**
+ * @brief Test concurrent recorders lose no samples
+ */
+void test_concurrent_record(void) {
+    pthread_t threads[TEST_THREADS];
+    latency_snapshot_t before;
+    latency_snapshot_t delta;
+    int i;
+
+    latency_snapshot(LATENCY_SERIAL_TO_NET, &before);
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, record_thread, NULL);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    snapshot_delta(LATENCY_SERIAL_TO_NET, &before, &delta);
+
+    TEST_ASSERT_EQUAL((uint64_t)TEST_THREADS * TEST_SAMPLES_PER_THREAD,
+                      delta.count, "No sample should be lost");
+    TEST_ASSERT_EQUAL((uint64_t)TEST_THREADS * 100ULL *
+                      TEST_SAMPLES_PER_THREAD *
+                      (TEST_SAMPLES_PER_THREAD + 1) / 2,
+                      delta.sum_ns, "Sum should be exact");
+}
+
+/* ============================================================================
+ * Format Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the Prometheus summary format
+ */
+void test_prometheus_format(void) {
+    latency_snapshot_t snapshot;
+    char buffer[LATENCY_FORMAT_MAX];
+    int len;
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.buckets[10] = 1;
+    snapshot.count = 1;
+    snapshot.sum_ns = 10;
+    snapshot.max_ns = 10;
+
+    len = latency_format_prometheus(&snapshot, LATENCY_USB_ROUTE,
+                                    buffer, sizeof(buffer));
+    TEST_ASSERT(len > 0, "Format should succeed");
+    TEST_ASSERT(strstr(buffer, "# TYPE xoe_usb_route_seconds summary\n") != NULL,
+                "Summary should be typed");
+    TEST_ASSERT(strstr(buffer,
+                       "xoe_usb_route_seconds{quantile=\"0.999\"} 0.000000010\n")
+                != NULL, "p999 should be in seconds");
+    TEST_ASSERT(strstr(buffer, "xoe_usb_route_seconds_count 1\n") != NULL,
+                "Count should be written");
+
+    TEST_ASSERT_ERROR(latency_format_prometheus(&snapshot, LATENCY_USB_ROUTE,
+                                                buffer, 16),
+                      E_BUFFER_TOO_SMALL, "Short buffer should be rejected");
+    TEST_ASSERT_ERROR(latency_format_prometheus(&snapshot, LATENCY_COUNT,
+                                                buffer, sizeof(buffer)),
+                      E_INVALID_ARGUMENT, "Unknown id should be rejected");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Latency Histogram Unit Tests ===\n\n");
+
+    /* Histogram tests */
+    run_test("test_single_sample_precision", test_single_sample_precision);
+    run_test("test_out_of_range_sample", test_out_of_range_sample);
+    run_test("test_percentiles", test_percentiles);
+    run_test("test_empty_and_invalid", test_empty_and_invalid);
+    run_test("test_record_since", test_record_since);
+    run_test("test_concurrent_record", test_concurrent_record);
+
+    /* Format tests */
+    run_test("test_prometheus_format", test_prometheus_format);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
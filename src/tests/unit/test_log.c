@@ -0,0 +1,317 @@
+/**
+ * @file test_log.c
+ * @brief Unit tests for the asynchronous logger
+ *
+ * Level parsing and filtering, per-call-site rate limiting, ordered
+ * delivery through the background writer from several threads, and
+ * line truncation. Output is captured by pointing stdout and stderr at
+ * temporary files.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/log.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/* Threads and messages per thread in the concurrency test */
+#define TEST_THREADS 4
+#define TEST_MESSAGES_PER_THREAD 10
+
+/* Captured output of one stream */
+#define TEST_CAPTURE_MAX 65536
+
+typedef struct {
+    int saved_fd;
+    int file_fd;
+    FILE* stream;
+} capture_t;
+
+static char captured[TEST_CAPTURE_MAX];
+
+/**
+ * @brief Redirect a stream to a temporary file
+ */
+static void capture_begin(capture_t* cap, FILE* stream)
+{
+    char path[] = "/tmp/xoe_test_log_XXXXXX";
+
+    fflush(stream);
+    cap->stream = stream;
+    cap->file_fd = mkstemp(path);
+    unlink(path);
+    cap->saved_fd = dup(fileno(stream));
+    dup2(cap->file_fd, fileno(stream));
+}
+
+/**
+ * @brief Restore the stream and read what was written into captured[]
+ */
+static const char* capture_end(capture_t* cap)
+{
+    ssize_t len;
+
+    fflush(cap->stream);
+    dup2(cap->saved_fd, fileno(cap->stream));
+    close(cap->saved_fd);
+
+    lseek(cap->file_fd, 0, SEEK_SET);
+    len = read(cap->file_fd, captured, sizeof(captured) - 1);
+    close(cap->file_fd);
+    captured[len > 0 ? len : 0] = '\0';
+    return captured;
+}
+
+/**
+ * @brief Count occurrences of a substring
+ */
+static int count_of(const char* haystack, const char* needle)
+{
+    int count = 0;
+
+    while ((haystack = strstr(haystack, needle)) != NULL) {
+        count++;
+        haystack += strlen(needle);
+    }
+    return count;
+}
+
+/**
+ * @brief Thread body: log TEST_MESSAGES_PER_THREAD numbered lines
+ */
+static void* log_thread(void* arg)
+{
+    int id = *(int*)arg;
+    int i;
+
+    for (i = 0; i < TEST_MESSAGES_PER_THREAD; i++) {
+        /* One call site per thread keeps each under the rate limit */
+        switch (id) {
+            case 0: LOG_INFO("thread %d message %d", id, i); break;
+            case 1: LOG_INFO("thread %d message %d", id, i); break;
+            case 2: LOG_INFO("thread %d message %d", id, i); break;
+            default: LOG_INFO("thread %d message %d", id, i); break;
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Level Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test level names parse and unknown names are rejected
+ */
+void test_parse_level(void) {
+    log_level_t level = LOG_LEVEL_INFO;
+
+    TEST_ASSERT_EQUAL(0, log_parse_level("debug", &level), "debug parses");
+    TEST_ASSERT_EQUAL(LOG_LEVEL_DEBUG, level, "debug is the debug level");
+    TEST_ASSERT_EQUAL(0, log_parse_level("error", &level), "error parses");
+    TEST_ASSERT_EQUAL(LOG_LEVEL_ERROR, level, "error is the error level");
+    TEST_ASSERT_ERROR(log_parse_level("loud", &level), E_INVALID_ARGUMENT,
+                      "Unknown name should be rejected");
+    TEST_ASSERT_ERROR(log_parse_level(NULL, &level), E_INVALID_ARGUMENT,
+                      "NULL name should be rejected");
+}
+
+/**
+ * @brief Test messages above the level are not written
+ */
+void test_level_filter(void) {
+    capture_t cap;
+    const char* out;
+
+    log_set_level(LOG_LEVEL_INFO);
+    TEST_ASSERT(!log_enabled(LOG_LEVEL_DEBUG), "Debug off at info level");
+    TEST_ASSERT(log_enabled(LOG_LEVEL_WARN), "Warn on at info level");
+
+    capture_begin(&cap, stdout);
+    LOG_DEBUG("hidden %d", 1);
+    LOG_INFO("shown %d", 2);
+    out = capture_end(&cap);
+
+    TEST_ASSERT(strstr(out, "hidden") == NULL, "Debug message filtered");
+    TEST_ASSERT(strstr(out, "[INFO] shown 2\n") != NULL,
+                "Info message written synchronously before log_start");
+}
+
+/**
+ * @brief Test warnings go to stderr with their source location
+ */
+void test_warn_format(void) {
+    capture_t cap;
+    const char* out;
+
+    capture_begin(&cap, stderr);
+    LOG_WARN("careful %s", "now");
+    out = capture_end(&cap);
+
+    TEST_ASSERT(strncmp(out, "[WARN] ", 7) == 0, "Tagged with the level");
+    TEST_ASSERT(strstr(out, "test_log.c:") != NULL, "Source file shown");
+    TEST_ASSERT(strstr(out, ": careful now\n") != NULL, "Message formatted");
+}
+
+/* ============================================================================
+ * Rate Limit Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test one call site is limited to LOG_RATE_LIMIT per second
+ */
+void test_rate_limit(void) {
+    capture_t cap;
+    const char* out;
+    int i;
+
+    capture_begin(&cap, stdout);
+    for (i = 0; i < LOG_RATE_LIMIT * 5; i++) {
+        LOG_INFO("chatty %d", i);
+    }
+    out = capture_end(&cap);
+
+    /* A second boundary in the loop can let one more window through */
+    TEST_ASSERT(count_of(out, "chatty") >= LOG_RATE_LIMIT &&
+                count_of(out, "chatty") <= 2 * LOG_RATE_LIMIT,
+                "Burst should be cut at the per-site limit");
+
+    /* A fresh site is not affected by another site's limit */
+    capture_begin(&cap, stdout);
+    LOG_INFO("quiet site");
+    out = capture_end(&cap);
+    TEST_ASSERT(strstr(out, "quiet site") != NULL,
+                "Other call sites keep their own budget");
+}
+
+/**
+ * @brief Test a limited site reports what it suppressed
+ */
+void test_suppressed_report(void) {
+    log_site_t site;
+    capture_t cap;
+    const char* out;
+    int i;
+
+    memset(&site, 0, sizeof(site));
+    capture_begin(&cap, stdout);
+    for (i = 0; i < LOG_RATE_LIMIT + 7; i++) {
+        log_write(&site, LOG_LEVEL_INFO, __FILE__, __LINE__, "line %d", i);
+    }
+
+    /* Force a new window without waiting */
+    site.window--;
+    log_write(&site, LOG_LEVEL_INFO, __FILE__, __LINE__, "after");
+    out = capture_end(&cap);
+
+    TEST_ASSERT_EQUAL(LOG_RATE_LIMIT + 1, count_of(out, "[INFO]"),
+                      "Only the limit plus the next window's line written");
+    TEST_ASSERT(strstr(out, "after (7 similar suppressed)\n") != NULL,
+                "Suppressed count reported on the next line");
+}
+
+/* ============================================================================
+ * Writer Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test queued messages from several threads all arrive in order
+ */
+void test_async_delivery(void) {
+    pthread_t threads[TEST_THREADS];
+    int ids[TEST_THREADS];
+    char expected[64];
+    capture_t cap;
+    const char* out;
+    const char* prev;
+    const char* at;
+    int ordered = TRUE;
+    int i;
+    int j;
+
+    capture_begin(&cap, stdout);
+    TEST_ASSERT_EQUAL(0, log_start(), "Writer should start");
+    TEST_ASSERT_EQUAL(0, log_start(), "Second start is a no-op");
+
+    for (i = 0; i < TEST_THREADS; i++) {
+        ids[i] = i;
+        pthread_create(&threads[i], NULL, log_thread, &ids[i]);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    log_stop();
+    out = capture_end(&cap);
+
+    TEST_ASSERT_EQUAL(TEST_THREADS * TEST_MESSAGES_PER_THREAD,
+                      count_of(out, "[INFO] thread "),
+                      "Every message should be written by log_stop");
+    TEST_ASSERT_EQUAL(0, (int)log_dropped(), "Nothing dropped");
+
+    /* Each thread's messages keep their order */
+    for (i = 0; i < TEST_THREADS; i++) {
+        prev = out;
+        for (j = 0; j < TEST_MESSAGES_PER_THREAD; j++) {
+            snprintf(expected, sizeof(expected), "thread %d message %d\n",
+                     i, j);
+            at = strstr(out, expected);
+            if (at == NULL || at < prev) {
+                ordered = FALSE;
+            }
+            prev = (at != NULL) ? at : prev;
+        }
+    }
+    TEST_ASSERT(ordered, "Per-thread order should be preserved");
+}
+
+/**
+ * @brief Test long messages are truncated to one terminated line
+ */
+void test_truncation(void) {
+    char long_text[LOG_LINE_MAX * 2];
+    capture_t cap;
+    const char* out;
+
+    memset(long_text, 'x', sizeof(long_text) - 1);
+    long_text[sizeof(long_text) - 1] = '\0';
+
+    capture_begin(&cap, stdout);
+    LOG_INFO("%s", long_text);
+    out = capture_end(&cap);
+
+    TEST_ASSERT_EQUAL(LOG_LINE_MAX - 1, (int)strlen(out),
+                      "Line should be cut to LOG_LINE_MAX - 1 bytes");
+    TEST_ASSERT_EQUAL('\n', out[strlen(out) - 1],
+                      "Truncated line should still end in a newline");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Logger Unit Tests ===\n\n");
+
+    /* Level tests */
+    run_test("test_parse_level", test_parse_level);
+    run_test("test_level_filter", test_level_filter);
+    run_test("test_warn_format", test_warn_format);
+
+    /* Rate limit tests */
+    run_test("test_rate_limit", test_rate_limit);
+    run_test("test_suppressed_report", test_suppressed_report);
+
+    /* Writer tests */
+    run_test("test_async_delivery", test_async_delivery);
+    run_test("test_truncation", test_truncation);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
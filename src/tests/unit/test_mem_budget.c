@@ -0,0 +1,277 @@
+/**
+ * @file test_mem_budget.c
+ * @brief Unit tests for the memory budget and thread stack sizes
+ *
+ * Charges the budget directly, through pooled payloads and through a wire
+ * decoder with a connection account, and checks that a decoder holds a
+ * frame back while the budget is short and refuses one that can never
+ * fit. Also checks that threads get the configured stack size.
+ *
+ * [LLM-ARCH]
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/mem_budget.h"
+#include "lib/common/thread_sched.h"
+#include "lib/common/definitions.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Bytes standing in for memory held by other connections */
+#define OTHER_CONNECTIONS (64 * 1024)
+
+/* Payload of the frames the decoder tests feed */
+#define FRAME_PAYLOAD 16384
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Build a complete wire frame into @p out
+ *
+ * @return Total frame length (header plus payload)
+ */
+static uint32_t build_frame(uint8_t* out, const uint8_t* payload, uint32_t len)
+{
+    xoe_wire_header_t header;
+
+    header.protocol_id = 0x0001;
+    header.protocol_version = 1;
+    header.payload_length = len;
+    header.checksum = xoe_wire_packet_checksum(&header, payload);
+
+    xoe_wire_serialize_header(out, &header);
+    memcpy(out + XOE_WIRE_HEADER_SIZE, payload, len);
+
+    return XOE_WIRE_HEADER_SIZE + len;
+}
+
+/* ============================================================================
+ * Budget Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test charging, the peak, the high-water mark and the limit
+ */
+void test_charge(void) {
+    size_t base = mem_budget_used();
+
+    mem_budget_set_limit(0);
+    mem_budget_charge(1000);
+    TEST_ASSERT_EQUAL(base + 1000, mem_budget_used(), "Charged");
+    TEST_ASSERT(mem_budget_peak() >= base + 1000, "Peak follows");
+    TEST_ASSERT(mem_budget_fits(1 << 30), "Unlimited fits anything");
+    TEST_ASSERT(!mem_budget_pressure(), "Unlimited never throttles");
+
+    mem_budget_set_limit(base + 1000 + 100);
+    TEST_ASSERT(mem_budget_fits(100), "Up to the limit fits");
+    TEST_ASSERT(!mem_budget_fits(101), "Past the limit does not");
+    TEST_ASSERT(mem_budget_pressure(), "Past the high-water mark");
+
+    mem_budget_uncharge(1000);
+    TEST_ASSERT_EQUAL(base, mem_budget_used(), "Uncharged");
+    mem_budget_set_limit(0);
+}
+
+/**
+ * @brief Test a connection account against the per-connection limit
+ */
+void test_account(void) {
+    mem_account_t account;
+
+    memset(&account, 0, sizeof(account));
+    mem_budget_set_conn_limit(4096);
+    mem_account_charge(&account, 4000);
+    TEST_ASSERT_EQUAL(4000, (int)mem_account_used(&account), "Tracked");
+    TEST_ASSERT(!mem_account_over(&account), "Under the limit");
+    mem_account_charge(&account, 96);
+    TEST_ASSERT(mem_account_over(&account), "At the limit");
+    mem_account_uncharge(&account, 4096);
+    TEST_ASSERT(!mem_account_over(&account), "Back under");
+
+    mem_budget_set_conn_limit(0);
+    mem_account_charge(&account, 1 << 20);
+    TEST_ASSERT(!mem_account_over(&account), "No per-connection limit");
+    mem_account_uncharge(&account, 1 << 20);
+    TEST_ASSERT_EQUAL(0, (int)mem_account_used(NULL), "NULL account");
+}
+
+/**
+ * @brief Test pooled payloads count while handed out, not while cached
+ */
+void test_payload_pool(void) {
+    size_t base = mem_budget_used();
+    xoe_payload_t* payload;
+
+    payload = xoe_payload_alloc(1000);
+    TEST_ASSERT_NOT_NULL(payload, "Allocated");
+    TEST_ASSERT_EQUAL(base + 1024, mem_budget_used(),
+                      "Size class capacity charged");
+    TEST_ASSERT(xoe_payload_ref(payload) == payload, "Shared");
+    xoe_payload_release(payload);
+    TEST_ASSERT_EQUAL(base + 1024, mem_budget_used(), "Still referenced");
+    xoe_payload_release(payload);
+    TEST_ASSERT_EQUAL(base, mem_budget_used(), "Uncharged with the last");
+}
+
+/* ============================================================================
+ * Decoder Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a frame waits for memory after its header, then completes
+ */
+void test_decoder_waits(void) {
+    static uint8_t payload[FRAME_PAYLOAD];
+    static uint8_t frame[XOE_WIRE_HEADER_SIZE + FRAME_PAYLOAD];
+    xoe_wire_decoder_t decoder;
+    mem_account_t account;
+    xoe_packet_t packet;
+    uint32_t frame_len;
+    uint32_t consumed = 0;
+    uint32_t offset;
+    int result;
+
+    memset(payload, 0x5A, sizeof(payload));
+    frame_len = build_frame(frame, payload, sizeof(payload));
+    memset(&account, 0, sizeof(account));
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Decoder init");
+    xoe_wire_decoder_set_account(&decoder, &account);
+    TEST_ASSERT_EQUAL(XOE_WIRE_DECODER_DEFAULT_BUFFER,
+                      (int)mem_account_used(&account), "Staging charged");
+
+    /* Other connections hold most of the budget */
+    mem_budget_charge(OTHER_CONNECTIONS);
+    mem_budget_set_limit(mem_budget_used() + FRAME_PAYLOAD / 2);
+
+    result = xoe_wire_decoder_feed(&decoder, frame, frame_len, &consumed,
+                                   &packet);
+    TEST_ASSERT_EQUAL(E_WOULD_BLOCK, result, "Frame held back");
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE, (int)consumed,
+                      "Only the header taken");
+    TEST_ASSERT(!xoe_wire_decoder_idle(&decoder), "Frame in progress");
+    offset = consumed;
+
+    mem_budget_uncharge(OTHER_CONNECTIONS);
+    result = xoe_wire_decoder_feed(&decoder, frame + offset,
+                                   frame_len - offset, &consumed, &packet);
+    TEST_ASSERT_EQUAL(1, result, "Frame completed once memory was freed");
+    TEST_ASSERT_EQUAL(FRAME_PAYLOAD, (int)packet.payload->len, "Payload");
+    TEST_ASSERT(memcmp(packet.payload->data, payload, FRAME_PAYLOAD) == 0,
+                "Payload intact");
+    TEST_ASSERT_EQUAL(XOE_WIRE_DECODER_DEFAULT_BUFFER,
+                      (int)mem_account_used(&account),
+                      "Completed frame left the account");
+    xoe_wire_free_payload(&packet);
+
+    mem_budget_set_limit(0);
+    xoe_wire_decoder_cleanup(&decoder);
+    TEST_ASSERT_EQUAL(0, (int)mem_account_used(&account), "All uncharged");
+}
+
+/**
+ * @brief Test a frame larger than the whole budget is refused
+ */
+void test_decoder_refuses(void) {
+    static uint8_t payload[FRAME_PAYLOAD];
+    static uint8_t frame[XOE_WIRE_HEADER_SIZE + FRAME_PAYLOAD];
+    xoe_wire_decoder_t decoder;
+    mem_account_t account;
+    xoe_packet_t packet;
+    uint32_t frame_len;
+    uint32_t consumed = 0;
+    int result;
+
+    memset(payload, 0, sizeof(payload));
+    frame_len = build_frame(frame, payload, sizeof(payload));
+    memset(&account, 0, sizeof(account));
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Decoder init");
+    mem_budget_set_limit(FRAME_PAYLOAD / 2);
+
+    /* Without an account the budget is not enforced */
+    result = xoe_wire_decoder_feed(&decoder, frame, frame_len, &consumed,
+                                   &packet);
+    TEST_ASSERT_EQUAL(1, result, "Decoder without an account never waits");
+    xoe_wire_free_payload(&packet);
+
+    xoe_wire_decoder_set_account(&decoder, &account);
+    result = xoe_wire_decoder_feed(&decoder, frame, frame_len, &consumed,
+                                   &packet);
+    TEST_ASSERT_EQUAL(E_OUT_OF_MEMORY, result, "Larger than the budget");
+
+    mem_budget_set_limit(0);
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/* ============================================================================
+ * Thread Stack Tests
+ * ============================================================================ */
+
+static void* stack_probe(void* arg) {
+    size_t* size = (size_t*)arg;
+#if defined(__linux__)
+    pthread_attr_t attr;
+
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        (void)pthread_attr_getstacksize(&attr, size);
+        pthread_attr_destroy(&attr);
+    }
+#else
+    (void)size;
+#endif
+    return NULL;
+}
+
+/**
+ * @brief Test new threads get the configured stack size
+ */
+void test_thread_stack(void) {
+#if defined(__linux__)
+    pthread_t thread;
+    size_t size = 0;
+
+    thread_sched_set_stack_size(256 * 1024);
+    TEST_ASSERT_SUCCESS(thread_sched_create(&thread, THREAD_CLASS_NONE,
+                                            stack_probe, &size),
+                        "Thread started");
+    pthread_join(thread, NULL);
+    TEST_ASSERT_EQUAL(256 * 1024, (int)size, "Stack size applied");
+    thread_sched_set_stack_size(0);
+#else
+    TEST_SKIP("reading a thread's stack size is Linux-only");
+#endif
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Memory Budget Unit Tests ===\n\n");
+
+    /* Budget tests */
+    run_test("test_charge", test_charge);
+    run_test("test_account", test_account);
+    run_test("test_payload_pool", test_payload_pool);
+
+    /* Decoder tests */
+    run_test("test_decoder_waits", test_decoder_waits);
+    run_test("test_decoder_refuses", test_decoder_refuses);
+
+    /* Thread stack tests */
+    run_test("test_thread_stack", test_thread_stack);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
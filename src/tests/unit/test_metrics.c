@@ -0,0 +1,304 @@
+/**
+ * @file test_metrics.c
+ * @brief Unit tests for the runtime metrics registry
+ *
+ * Counter and gauge arithmetic, exact totals across concurrent and
+ * short-lived threads (shard reuse and overflow), the Prometheus text
+ * format, and the wire format hooks that feed the network counters.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/metrics.h"
+#include "lib/common/definitions.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Increments per thread in the concurrency tests */
+#define TEST_ADDS_PER_THREAD 10000
+
+/**
+ * @brief Change of one metric since an earlier snapshot
+ */
+static uint64_t delta_since(const metrics_snapshot_t* before, metric_id_t id)
+{
+    metrics_snapshot_t now;
+
+    metrics_snapshot(&now);
+    return now.values[id] - before->values[id];
+}
+
+/**
+ * @brief Thread body: bump a counter TEST_ADDS_PER_THREAD times
+ */
+static void* add_thread(void* arg)
+{
+    int i;
+
+    (void)arg;
+    for (i = 0; i < TEST_ADDS_PER_THREAD; i++) {
+        metrics_add(METRIC_SERIAL_RX_BYTES, 1);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Registry Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test counters add up and gauges move both ways
+ */
+void test_counter_and_gauge(void) {
+    metrics_snapshot_t before;
+    metrics_snapshot_t after;
+
+    metrics_snapshot(&before);
+    metrics_add(METRIC_USB_URBS_ROUTED, 3);
+    metrics_add(METRIC_USB_URBS_ROUTED, 4);
+    TEST_ASSERT_EQUAL(7, delta_since(&before, METRIC_USB_URBS_ROUTED),
+                      "Counter should sum its increments");
+
+    metrics_add(METRIC_CONN_ACTIVE, 2);
+    metrics_sub(METRIC_CONN_ACTIVE, 5);
+    metrics_snapshot(&after);
+    TEST_ASSERT_EQUAL(-3, metrics_gauge(&after, METRIC_CONN_ACTIVE) -
+                          metrics_gauge(&before, METRIC_CONN_ACTIVE),
+                      "Gauge should go below its starting level");
+    metrics_add(METRIC_CONN_ACTIVE, 3);
+
+    /* Out-of-range ids are ignored */
+    metrics_add(METRIC_COUNT, 1);
+    metrics_add((metric_id_t)-1, 1);
+    TEST_ASSERT_NULL(metrics_describe(METRIC_COUNT),
+                     "No description past the registry");
+}
+
+/**
+ * @brief Test every metric has a name, help text and distinct name
+ */
+void test_descriptors(void) {
+    const metric_desc_t* a;
+    const metric_desc_t* b;
+    int unique = TRUE;
+    int complete = TRUE;
+    int i;
+    int j;
+
+    for (i = 0; i < (int)METRIC_COUNT; i++) {
+        a = metrics_describe((metric_id_t)i);
+        if (a == NULL || a->name == NULL || a->help == NULL) {
+            complete = FALSE;
+            continue;
+        }
+        for (j = 0; j < i; j++) {
+            b = metrics_describe((metric_id_t)j);
+            if (b != NULL && b->name != NULL && strcmp(a->name, b->name) == 0) {
+                unique = FALSE;
+            }
+        }
+    }
+    TEST_ASSERT(complete, "Every metric should be described");
+    TEST_ASSERT(unique, "Metric names should be unique");
+}
+
+/**
+ * @brief Test concurrent writers lose no updates
+ */
+void test_concurrent_threads(void) {
+    metrics_snapshot_t before;
+    pthread_t threads[8];
+    int started = 0;
+    int i;
+
+    metrics_snapshot(&before);
+    for (i = 0; i < 8; i++) {
+        if (pthread_create(&threads[i], NULL, add_thread, NULL) == 0) {
+            started++;
+        }
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL((uint64_t)started * TEST_ADDS_PER_THREAD,
+                      delta_since(&before, METRIC_SERIAL_RX_BYTES),
+                      "All concurrent increments should be counted");
+}
+
+/**
+ * @brief Test shards outlive their threads and overflow stays exact
+ *
+ * More short-lived threads than shards reuse released shards; more live
+ * threads than shards spill into the overflow shard.
+ */
+void test_shard_reuse_and_overflow(void) {
+    metrics_snapshot_t before;
+    pthread_t threads[METRICS_MAX_SHARDS + 8];
+    int started = 0;
+    int i;
+
+    metrics_snapshot(&before);
+    for (i = 0; i < METRICS_MAX_SHARDS * 2; i++) {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, add_thread, NULL) == 0) {
+            pthread_join(thread, NULL);
+            started++;
+        }
+    }
+    TEST_ASSERT_EQUAL((uint64_t)started * TEST_ADDS_PER_THREAD,
+                      delta_since(&before, METRIC_SERIAL_RX_BYTES),
+                      "Reused shards should keep exiting threads' counts");
+
+    metrics_snapshot(&before);
+    started = 0;
+    for (i = 0; i < METRICS_MAX_SHARDS + 8; i++) {
+        if (pthread_create(&threads[i], NULL, add_thread, NULL) == 0) {
+            started++;
+        }
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT_EQUAL((uint64_t)started * TEST_ADDS_PER_THREAD,
+                      delta_since(&before, METRIC_SERIAL_RX_BYTES),
+                      "Threads beyond the shard count should be counted");
+}
+
+/* ============================================================================
+ * Format Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test counters and gauges in the Prometheus text format
+ */
+void test_prometheus_format(void) {
+    metrics_snapshot_t snapshot;
+    char buffer[METRICS_FORMAT_MAX];
+    int len;
+
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.values[METRIC_NET_RX_FRAMES] = 42;
+    snapshot.values[METRIC_CONN_ACTIVE] = (uint64_t)0 - 2;
+
+    len = metrics_format_prometheus(&snapshot, METRIC_NET_RX_FRAMES,
+                                    buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER(len, 0, "Counter should format");
+    TEST_ASSERT(strstr(buffer, "# TYPE xoe_net_rx_frames_total counter\n")
+                != NULL, "Counter TYPE line should carry _total");
+    TEST_ASSERT(strstr(buffer, "\nxoe_net_rx_frames_total 42\n") != NULL,
+                "Counter sample should follow");
+
+    len = metrics_format_prometheus(&snapshot, METRIC_CONN_ACTIVE,
+                                    buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER(len, 0, "Gauge should format");
+    TEST_ASSERT(strstr(buffer, "# TYPE xoe_conn_active gauge\n") != NULL,
+                "Gauge TYPE line should have no suffix");
+    TEST_ASSERT(strstr(buffer, "\nxoe_conn_active -2\n") != NULL,
+                "Gauge sample should be signed");
+
+    TEST_ASSERT_ERROR(metrics_format_prometheus(&snapshot, METRIC_CONN_ACTIVE,
+                                                buffer, 16),
+                      E_BUFFER_TOO_SMALL, "Short buffer should be reported");
+    TEST_ASSERT_ERROR(metrics_format_prometheus(&snapshot, METRIC_COUNT,
+                                                buffer, sizeof(buffer)),
+                      E_INVALID_ARGUMENT, "Unknown metric should fail");
+}
+
+/* ============================================================================
+ * Wire Hook Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test sent, received and corrupted frames reach the counters
+ */
+void test_wire_counters(void) {
+    metrics_snapshot_t before;
+    xoe_packet_t out;
+    xoe_packet_t in;
+    xoe_payload_t payload;
+    uint8_t data[100];
+    uint8_t frame[XOE_WIRE_HEADER_SIZE + sizeof(data)];
+    int fds[2];
+
+    memset(data, 0x33, sizeof(data));
+    payload.data = data;
+    payload.len = sizeof(data);
+    payload.owns_data = FALSE;
+    memset(&out, 0, sizeof(out));
+    out.protocol_id = 0x0003;
+    out.protocol_version = 1;
+    out.payload = &payload;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        TEST_SKIP("socketpair unavailable");
+        return;
+    }
+
+    metrics_snapshot(&before);
+    TEST_ASSERT_SUCCESS(xoe_wire_send(fds[1], &out), "Send should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(fds[0], &in), "Recv should succeed");
+    xoe_wire_free_payload(&in);
+
+    TEST_ASSERT_EQUAL(1, delta_since(&before, METRIC_NET_TX_FRAMES),
+                      "One frame sent");
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE + sizeof(data),
+                      delta_since(&before, METRIC_NET_TX_BYTES),
+                      "Sent bytes include the header");
+    TEST_ASSERT_EQUAL(1, delta_since(&before, METRIC_NET_RX_FRAMES),
+                      "One frame received");
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE + sizeof(data),
+                      delta_since(&before, METRIC_NET_RX_BYTES),
+                      "Received bytes include the header");
+
+    /* Flip a payload byte in flight */
+    TEST_ASSERT_SUCCESS(xoe_wire_send(fds[1], &out), "Send should succeed");
+    TEST_ASSERT_EQUAL((ssize_t)sizeof(frame),
+                      recv(fds[0], frame, sizeof(frame), MSG_WAITALL),
+                      "Frame should arrive whole");
+    frame[XOE_WIRE_HEADER_SIZE] ^= 0xff;
+    TEST_ASSERT_EQUAL((ssize_t)sizeof(frame),
+                      write(fds[1], frame, sizeof(frame)),
+                      "Corrupted frame should be written");
+    TEST_ASSERT_ERROR(xoe_wire_recv(fds[0], &in), E_CHECKSUM_MISMATCH,
+                      "Corrupted frame should fail the checksum");
+
+    TEST_ASSERT_EQUAL(1, delta_since(&before, METRIC_NET_CHECKSUM_FAILURES),
+                      "Checksum failure should be counted");
+    TEST_ASSERT_EQUAL(1, delta_since(&before, METRIC_NET_RX_FRAMES),
+                      "Rejected frame is not a received frame");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Metrics Unit Tests ===\n\n");
+
+    /* Registry tests */
+    run_test("test_counter_and_gauge", test_counter_and_gauge);
+    run_test("test_descriptors", test_descriptors);
+    run_test("test_concurrent_threads", test_concurrent_threads);
+    run_test("test_shard_reuse_and_overflow", test_shard_reuse_and_overflow);
+
+    /* Format tests */
+    run_test("test_prometheus_format", test_prometheus_format);
+
+    /* Wire hook tests */
+    run_test("test_wire_counters", test_wire_counters);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,289 @@
+/**
+ * @file test_mgmt_config.c
+ * @brief Unit tests for the configuration manager's published snapshots
+ *
+ * Deep copies, snapshots pinned across an apply, the per-thread reader
+ * cache, snapshots outliving the manager, telling live settings from
+ * restart-only ones, and readers racing a stream of applies (every
+ * snapshot must be internally consistent).
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/mgmt/mgmt_config.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* Reader threads and applies in the concurrency test */
+#define TEST_READERS 4
+#define TEST_APPLIES 2000
+
+static mgmt_config_manager_t* shared_mgr;
+static volatile int applies_done;
+static int torn_reads;
+
+/**
+ * @brief Build a server configuration with its own strings
+ */
+static void make_config(xoe_config_t* config, int port)
+{
+    memset(config, 0, sizeof(*config));
+    config->mode = MODE_SERVER;
+    config->listen_port = port;
+    config->connect_server_port = port;
+    config->conn_rate = 20;
+    config->listen_address = "127.0.0.1";
+    config->program_name = "xoe";
+}
+
+/* ============================================================================
+ * Snapshot Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the initial snapshot is a deep copy of every field
+ */
+void test_initial_snapshot(void) {
+    xoe_config_t config;
+    mgmt_config_manager_t* mgr;
+    mgmt_config_snapshot_t* snapshot;
+
+    make_config(&config, 1000);
+    mgr = mgmt_config_init(&config);
+    TEST_ASSERT_NOT_NULL(mgr, "Manager created");
+
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    TEST_ASSERT_NOT_NULL(snapshot, "Snapshot");
+    TEST_ASSERT_EQUAL(1, (int)snapshot->generation, "First generation");
+    TEST_ASSERT_EQUAL(1000, snapshot->config.listen_port, "Port copied");
+    TEST_ASSERT_EQUAL(20, snapshot->config.conn_rate, "Other fields copied");
+    TEST_ASSERT(snapshot->config.listen_address != config.listen_address,
+                "String duplicated");
+    TEST_ASSERT_STR_EQUAL("127.0.0.1", snapshot->config.listen_address,
+                          "String contents");
+    mgmt_config_snapshot_release(snapshot);
+
+    TEST_ASSERT_EQUAL(1000, mgmt_config_get_listen_port(mgr), "Getter");
+    TEST_ASSERT_NULL(mgmt_config_snapshot_acquire(NULL), "NULL manager");
+    mgmt_config_snapshot_release(NULL);
+
+    mgmt_config_destroy(mgr);
+}
+
+/**
+ * @brief Test a pinned snapshot is unchanged by a later apply
+ */
+void test_pinned_across_apply(void) {
+    xoe_config_t config;
+    mgmt_config_manager_t* mgr;
+    mgmt_config_snapshot_t* old_snapshot;
+    mgmt_config_snapshot_t* new_snapshot;
+
+    make_config(&config, 1000);
+    mgr = mgmt_config_init(&config);
+    TEST_ASSERT_NOT_NULL(mgr, "Manager created");
+
+    old_snapshot = mgmt_config_snapshot_acquire(mgr);
+    TEST_ASSERT_EQUAL(0, mgmt_config_set_listen_port(mgr, 2000), "Set port");
+    TEST_ASSERT_EQUAL(1000, mgmt_config_get_listen_port(mgr),
+                      "Pending change not visible");
+    TEST_ASSERT_EQUAL(0, mgmt_config_apply_pending(mgr), "Apply");
+
+    new_snapshot = mgmt_config_snapshot_acquire(mgr);
+    TEST_ASSERT(new_snapshot != old_snapshot, "New snapshot published");
+    TEST_ASSERT_EQUAL(2, (int)new_snapshot->generation, "Generation bumped");
+    TEST_ASSERT_EQUAL(2000, new_snapshot->config.listen_port, "New value");
+    TEST_ASSERT_EQUAL(1000, old_snapshot->config.listen_port,
+                      "Pinned snapshot unchanged");
+    TEST_ASSERT_STR_EQUAL("127.0.0.1", old_snapshot->config.listen_address,
+                          "Pinned strings still valid");
+
+    mgmt_config_snapshot_release(old_snapshot);
+    mgmt_config_snapshot_release(new_snapshot);
+    mgmt_config_destroy(mgr);
+}
+
+/**
+ * @brief Test the reader cache follows applies
+ */
+void test_reader(void) {
+    xoe_config_t config;
+    mgmt_config_manager_t* mgr;
+    mgmt_config_reader_t reader = MGMT_CONFIG_READER_INIT;
+    const xoe_config_t* first;
+    const xoe_config_t* view;
+
+    make_config(&config, 1000);
+    mgr = mgmt_config_init(&config);
+    TEST_ASSERT_NOT_NULL(mgr, "Manager created");
+
+    first = mgmt_config_read(mgr, &reader);
+    TEST_ASSERT_NOT_NULL(first, "First read");
+    TEST_ASSERT_EQUAL(1000, first->listen_port, "Initial value");
+    TEST_ASSERT(mgmt_config_read(mgr, &reader) == first,
+                "Cached while unchanged");
+
+    mgmt_config_set_listen_port(mgr, 3000);
+    TEST_ASSERT_EQUAL(0, mgmt_config_apply_pending(mgr), "Apply");
+    view = mgmt_config_read(mgr, &reader);
+    TEST_ASSERT_EQUAL(3000, view->listen_port, "Reader sees the apply");
+
+    mgmt_config_reader_release(&reader);
+    TEST_ASSERT_NULL(reader.snapshot, "Released");
+    TEST_ASSERT_NULL(mgmt_config_read(NULL, &reader), "NULL manager");
+    mgmt_config_destroy(mgr);
+}
+
+/**
+ * @brief Test a pinned snapshot outlives the manager
+ */
+void test_outlives_manager(void) {
+    xoe_config_t config;
+    mgmt_config_manager_t* mgr;
+    mgmt_config_snapshot_t* snapshot;
+
+    make_config(&config, 1000);
+    mgr = mgmt_config_init(&config);
+    TEST_ASSERT_NOT_NULL(mgr, "Manager created");
+
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    mgmt_config_destroy(mgr);
+    TEST_ASSERT_EQUAL(1000, snapshot->config.listen_port, "Still readable");
+    mgmt_config_snapshot_release(snapshot);
+}
+
+/**
+ * @brief Test live settings can be applied without a restart, others not
+ */
+void test_needs_restart(void) {
+    xoe_config_t config;
+    mgmt_config_manager_t* mgr;
+    mgmt_config_snapshot_t* snapshot;
+    const uint8_t classes[2] = {0x08, 0x02};
+    char what[64];
+
+    make_config(&config, 1000);
+    mgr = mgmt_config_init(&config);
+    TEST_ASSERT_NOT_NULL(mgr, "Manager created");
+
+    TEST_ASSERT_EQUAL(0, mgmt_config_set_conn_rate(mgr, 0), "Rate");
+    TEST_ASSERT_EQUAL(0, mgmt_config_set_tls_cert(mgr, "/tmp/new.crt"), "Cert");
+    TEST_ASSERT_EQUAL(0, mgmt_config_set_rcvbuf(mgr, 65536), "Buffer");
+    TEST_ASSERT_EQUAL(0, mgmt_config_set_usb_classes(mgr, classes, 2),
+                      "USB classes");
+    TEST_ASSERT_EQUAL(-1, mgmt_config_set_conn_rate(mgr, MAX_CONN_RATE + 1),
+                      "Rate out of range");
+    TEST_ASSERT_EQUAL(-1, mgmt_config_set_usb_classes(mgr, classes,
+                                                      MAX_USB_CLASSES + 1),
+                      "Too many classes");
+    TEST_ASSERT_EQUAL(0, mgmt_config_pending_needs_restart(mgr, what,
+                                                           sizeof(what)),
+                      "Live settings only");
+
+    TEST_ASSERT_EQUAL(0, mgmt_config_apply_pending(mgr), "Apply");
+    snapshot = mgmt_config_snapshot_acquire(mgr);
+    TEST_ASSERT_EQUAL(0, snapshot->config.conn_rate, "Rate applied");
+    TEST_ASSERT_STR_EQUAL("/tmp/new.crt", snapshot->config.cert_path,
+                          "Cert applied");
+    TEST_ASSERT_EQUAL(65536, snapshot->config.sock_tune.rcvbuf,
+                      "Buffer applied");
+    TEST_ASSERT_EQUAL(2, snapshot->config.usb_class_count, "Classes applied");
+    mgmt_config_snapshot_release(snapshot);
+
+    mgmt_config_set_listen_port(mgr, 2000);
+    TEST_ASSERT_EQUAL(1, mgmt_config_pending_needs_restart(mgr, what,
+                                                           sizeof(what)),
+                      "Port needs a restart");
+    TEST_ASSERT_STR_EQUAL("port", what, "Setting named");
+
+    mgmt_config_destroy(mgr);
+}
+
+/* ============================================================================
+ * Concurrency Tests
+ * ============================================================================ */
+
+static void* reader_thread(void* arg)
+{
+    mgmt_config_reader_t reader = MGMT_CONFIG_READER_INIT;
+    mgmt_config_snapshot_t* snapshot;
+    const xoe_config_t* view;
+
+    (void)arg;
+    while (!__atomic_load_n(&applies_done, __ATOMIC_ACQUIRE)) {
+        view = mgmt_config_read(shared_mgr, &reader);
+        if (view->listen_port != view->connect_server_port) {
+            __atomic_fetch_add(&torn_reads, 1, __ATOMIC_RELAXED);
+        }
+
+        snapshot = mgmt_config_snapshot_acquire(shared_mgr);
+        if (snapshot->config.listen_port !=
+            snapshot->config.connect_server_port) {
+            __atomic_fetch_add(&torn_reads, 1, __ATOMIC_RELAXED);
+        }
+        mgmt_config_snapshot_release(snapshot);
+    }
+    mgmt_config_reader_release(&reader);
+    return NULL;
+}
+
+/**
+ * @brief Test readers never see a half-applied configuration
+ */
+void test_concurrent_apply(void) {
+    xoe_config_t config;
+    pthread_t threads[TEST_READERS];
+    int i;
+
+    make_config(&config, 1);
+    shared_mgr = mgmt_config_init(&config);
+    TEST_ASSERT_NOT_NULL(shared_mgr, "Manager created");
+    applies_done = 0;
+    torn_reads = 0;
+
+    for (i = 0; i < TEST_READERS; i++) {
+        pthread_create(&threads[i], NULL, reader_thread, NULL);
+    }
+    /* Both ports change together; a reader must never see them differ */
+    for (i = 2; i < TEST_APPLIES; i++) {
+        mgmt_config_set_listen_port(shared_mgr, i);
+        mgmt_config_set_connect_port(shared_mgr, i);
+        mgmt_config_apply_pending(shared_mgr);
+    }
+    __atomic_store_n(&applies_done, 1, __ATOMIC_RELEASE);
+    for (i = 0; i < TEST_READERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL(0, torn_reads, "No torn reads");
+    TEST_ASSERT_EQUAL(TEST_APPLIES - 1, mgmt_config_get_listen_port(shared_mgr),
+                      "Last apply active");
+    mgmt_config_destroy(shared_mgr);
+    shared_mgr = NULL;
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Config Manager Unit Tests ===\n\n");
+
+    /* Snapshot tests */
+    run_test("test_initial_snapshot", test_initial_snapshot);
+    run_test("test_pinned_across_apply", test_pinned_across_apply);
+    run_test("test_reader", test_reader);
+    run_test("test_outlives_manager", test_outlives_manager);
+    run_test("test_needs_restart", test_needs_restart);
+
+    /* Concurrency tests */
+    run_test("test_concurrent_apply", test_concurrent_apply);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,435 @@
+/**
+ * @file test_mgmt_server.c
+ * @brief Unit tests for the event-driven management server
+ *
+ * Login and commands over real loopback sockets, input split across
+ * reads and several commands in one, every session slot served by the
+ * one loop thread, `watch` streaming deltas until the next line, failed
+ * logins closing the session, and stop with sessions still open.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/mgmt/mgmt_server.h"
+#include "core/mgmt/mgmt_internal.h"
+#include "lib/common/definitions.h"
+#include "lib/common/metrics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+/* Console password used throughout */
+#define TEST_PASSWORD "s3cret-pass"
+
+/* Longest wait for expected output (ms) */
+#define TEST_WAIT_MS 3000
+
+static xoe_config_t config;
+static char password[] = TEST_PASSWORD;
+
+/**
+ * @brief Start a server on a free port derived from the pid
+ */
+static mgmt_server_t* start_server(void)
+{
+    mgmt_server_t* server = NULL;
+    int attempt;
+
+    memset(&config, 0, sizeof(config));
+    config.mgmt_password = password;
+    for (attempt = 0; attempt < 20 && server == NULL; attempt++) {
+        config.mgmt_port = 20000 + (int)((getpid() * 7 + attempt * 131) %
+                                         20000);
+        server = mgmt_server_start(&config);
+    }
+    TEST_ASSERT_NOT_NULL(server, "Server should start");
+    return server;
+}
+
+/**
+ * @brief Connect to the server under test
+ */
+static int connect_console(void)
+{
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)config.mgmt_port);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Read until @p needle shows up @p times times, or end of stream
+ *
+ * @return Bytes read into @p buf (NUL-terminated)
+ */
+static size_t read_until(int fd, const char* needle, int times,
+                         char* buf, size_t size)
+{
+    struct pollfd pfd;
+    size_t used = 0;
+    const char* p;
+    ssize_t n;
+    int seen;
+
+    buf[0] = '\0';
+    for (;;) {
+        seen = 0;
+        for (p = strstr(buf, needle); p != NULL;
+             p = strstr(p + strlen(needle), needle)) {
+            seen++;
+        }
+        if (seen >= times || used == size - 1) {
+            break;
+        }
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, TEST_WAIT_MS) <= 0) {
+            break;
+        }
+        n = recv(fd, buf + used, size - 1 - used, 0);
+        if (n <= 0) {
+            break;
+        }
+        used += (size_t)n;
+        buf[used] = '\0';
+    }
+    return used;
+}
+
+/**
+ * @brief Check the session reaches end of stream
+ */
+static int at_eof(int fd)
+{
+    char buf[256];
+
+    while (read_until(fd, "\x01", 1, buf, sizeof(buf)) > 0) {
+    }
+    return recv(fd, buf, sizeof(buf), MSG_DONTWAIT) == 0;
+}
+
+/**
+ * @brief Connect and log in; returns the socket or -1
+ */
+static int login(void)
+{
+    char buf[256];
+    int fd = connect_console();
+
+    if (fd < 0) {
+        return -1;
+    }
+    read_until(fd, "Password: ", 1, buf, sizeof(buf));
+    send(fd, TEST_PASSWORD "\n", strlen(TEST_PASSWORD) + 1, 0);
+    read_until(fd, "xoe> ", 1, buf, sizeof(buf));
+    if (strstr(buf, "Authentication successful") == NULL) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#ifdef __linux__
+/**
+ * @brief Threads of this process
+ */
+static int thread_count(void)
+{
+    DIR* dir = opendir("/proc/self/task");
+    struct dirent* entry;
+    int count = 0;
+
+    if (dir == NULL) {
+        return -1;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+#endif
+
+/* ============================================================================
+ * Session Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a wrong password is retried, then commands run until quit
+ */
+void test_login_and_command(void) {
+    mgmt_server_t* server = start_server();
+    char buf[4096];
+    int fd;
+
+    if (server == NULL) {
+        return;
+    }
+    fd = connect_console();
+    TEST_ASSERT(fd >= 0, "Console should connect");
+
+    read_until(fd, "Password: ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "XOE Management Console") != NULL,
+                "Banner should come first");
+    send(fd, "wrong\n", 6, 0);
+    read_until(fd, "Password: ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Incorrect password") != NULL,
+                "Wrong password should be retried");
+
+    send(fd, TEST_PASSWORD "\r\n", strlen(TEST_PASSWORD) + 2, 0);
+    read_until(fd, "xoe> ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Authentication successful") != NULL,
+                "CRLF password should be accepted");
+
+    send(fd, "help\n", 5, 0);
+    read_until(fd, "xoe> ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "watch") != NULL, "Help should list watch");
+
+    send(fd, "quit\n", 5, 0);
+    read_until(fd, "Goodbye\n", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Goodbye") != NULL, "Quit should say goodbye");
+    TEST_ASSERT(at_eof(fd), "Quit should close the session");
+
+    close(fd);
+    mgmt_server_stop(server);
+}
+
+/**
+ * @brief Test input split byte by byte and several commands in one write
+ */
+void test_split_and_pipelined_input(void) {
+    mgmt_server_t* server = start_server();
+    const char* secret = TEST_PASSWORD "\n";
+    const char* batch = "show clients\nbogus\nhelp\n";
+    char buf[8192];
+    size_t i;
+    int fd;
+
+    if (server == NULL) {
+        return;
+    }
+    fd = connect_console();
+    read_until(fd, "Password: ", 1, buf, sizeof(buf));
+    for (i = 0; i < strlen(secret); i++) {
+        send(fd, secret + i, 1, 0);
+        usleep(1000);
+    }
+    read_until(fd, "xoe> ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Authentication successful") != NULL,
+                "Password sent a byte at a time should log in");
+
+    send(fd, batch, strlen(batch), 0);
+    read_until(fd, "xoe> ", 3, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Active Connections") != NULL,
+                "First command should run");
+    TEST_ASSERT(strstr(buf, "Unknown command: bogus") != NULL,
+                "Second command should run");
+    TEST_ASSERT(strstr(buf, "Available Commands") != NULL,
+                "Third command should run");
+
+    close(fd);
+    mgmt_server_stop(server);
+}
+
+/**
+ * @brief Test three wrong passwords end the session
+ */
+void test_auth_failure_closes(void) {
+    mgmt_server_t* server = start_server();
+    char buf[1024];
+    int fd;
+
+    if (server == NULL) {
+        return;
+    }
+    fd = connect_console();
+    read_until(fd, "Password: ", 1, buf, sizeof(buf));
+    send(fd, "a\nb\nc\n", 6, 0);
+    read_until(fd, "Authentication failed", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Authentication failed") != NULL,
+                "Third failure should be reported");
+    TEST_ASSERT(at_eof(fd), "Session should be closed");
+
+    close(fd);
+    mgmt_server_stop(server);
+}
+
+/* ============================================================================
+ * Scaling Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test every slot is served by the loop thread, then the next refused
+ */
+void test_sessions_share_one_thread(void) {
+    mgmt_server_t* server = start_server();
+    int fds[MAX_MGMT_SESSIONS];
+    char buf[4096];
+#ifdef __linux__
+    int threads;
+#endif
+    int extra;
+    int ok = 0;
+    int i;
+
+    if (server == NULL) {
+        return;
+    }
+#ifdef __linux__
+    threads = thread_count();
+#endif
+
+    for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
+        fds[i] = login();
+        if (fds[i] >= 0) {
+            ok++;
+        }
+    }
+    TEST_ASSERT_EQUAL(MAX_MGMT_SESSIONS, ok, "Every slot should log in");
+    TEST_ASSERT_EQUAL(MAX_MGMT_SESSIONS,
+                      mgmt_server_get_active_sessions(server),
+                      "Every slot should be counted");
+#ifdef __linux__
+    TEST_ASSERT_EQUAL(threads, thread_count(),
+                      "Sessions should not add threads");
+#endif
+
+    extra = connect_console();
+    read_until(extra, "\n", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Management server full") != NULL,
+                "One session too many should be refused");
+    close(extra);
+
+    /* Each session still answers */
+    for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
+        send(fds[i], "show status\n", 12, 0);
+    }
+    ok = 0;
+    for (i = 0; i < MAX_MGMT_SESSIONS; i++) {
+        read_until(fds[i], "xoe> ", 1, buf, sizeof(buf));
+        if (strstr(buf, "Server Status") != NULL) {
+            ok++;
+        }
+        close(fds[i]);
+    }
+    TEST_ASSERT_EQUAL(MAX_MGMT_SESSIONS, ok, "Every session should answer");
+
+    mgmt_server_stop(server);
+}
+
+/* ============================================================================
+ * Watch Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test watch streams changed counters until the next line
+ */
+void test_watch_streams_deltas(void) {
+    mgmt_server_t* server = start_server();
+    char buf[4096];
+    int fd;
+
+    if (server == NULL) {
+        return;
+    }
+    fd = login();
+    TEST_ASSERT(fd >= 0, "Console should log in");
+
+    send(fd, "watch 0\n", 8, 0);
+    read_until(fd, "xoe> ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Usage: watch") != NULL,
+                "Zero interval should be refused");
+
+    send(fd, "watch 1\n", 8, 0);
+    read_until(fd, "press Enter to stop\n", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Watching every 1 s") != NULL,
+                "Watch should start");
+    TEST_ASSERT(strstr(buf, "xoe> ") == NULL, "No prompt while watching");
+
+    metrics_add(METRIC_CONN_RATE_LIMITED, 3);
+    read_until(fd, "\n", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "[1.") != NULL, "First tick after a second");
+    TEST_ASSERT(strstr(buf, "conn_rate_limited+3") != NULL,
+                "Counter increase should be reported");
+
+    read_until(fd, "\n", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "[2.") != NULL, "Second tick follows");
+    TEST_ASSERT(strstr(buf, "conn_rate_limited") == NULL,
+                "Unchanged counter should be left out");
+
+    send(fd, "\n", 1, 0);
+    read_until(fd, "xoe> ", 1, buf, sizeof(buf));
+    TEST_ASSERT(strstr(buf, "Watch stopped") != NULL, "Enter should stop");
+    TEST_ASSERT(strstr(buf, "xoe> ") != NULL, "Prompt should return");
+
+    close(fd);
+    mgmt_server_stop(server);
+}
+
+/**
+ * @brief Test stop closes sessions that are still open
+ */
+void test_stop_closes_sessions(void) {
+    mgmt_server_t* server = start_server();
+    int watcher;
+    int idle;
+
+    if (server == NULL) {
+        return;
+    }
+    watcher = login();
+    idle = connect_console();
+    send(watcher, "watch\n", 6, 0);
+
+    mgmt_server_stop(server);
+    TEST_ASSERT(at_eof(watcher), "Watcher should see end of stream");
+    TEST_ASSERT(at_eof(idle), "Unauthenticated session should be closed");
+
+    close(watcher);
+    close(idle);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Management Server Unit Tests ===\n\n");
+
+    /* Session tests */
+    run_test("test_login_and_command", test_login_and_command);
+    run_test("test_split_and_pipelined_input",
+             test_split_and_pipelined_input);
+    run_test("test_auth_failure_closes", test_auth_failure_closes);
+
+    /* Scaling tests */
+    run_test("test_sessions_share_one_thread",
+             test_sessions_share_one_thread);
+
+    /* Watch tests */
+    run_test("test_watch_streams_deltas", test_watch_streams_deltas);
+    run_test("test_stop_closes_sessions", test_stop_closes_sessions);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
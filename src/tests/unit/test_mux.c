@@ -0,0 +1,256 @@
+/**
+ * @file test_mux.c
+ * @brief Unit tests for channel multiplexing
+ *
+ * Frame encoding round trip and rejection of foreign or malformed frames,
+ * then the per-channel credit rules: opening handshake, partial and
+ * exhausted send credit, a sender woken by a grant, window enforcement on
+ * receive, batched credit return, and close/shutdown releasing senders.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/mux.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* Window used by the credit tests */
+#define TEST_WINDOW 4096
+
+/* ============================================================================
+ * Framing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a DATA frame decodes to the header and inner view it was built from
+ */
+void test_frame_round_trip(void) {
+    xoe_mux_header_t header;
+    xoe_mux_header_t decoded;
+    xoe_packet_t packet;
+    xoe_packet_t inner;
+    xoe_payload_t inner_payload;
+    uint8_t* data;
+
+    memset(&header, 0, sizeof(header));
+    header.channel = 15;
+    header.type = XOE_MUX_DATA;
+    header.inner_protocol = XOE_PROTOCOL_SERIAL;
+    header.inner_version = 1;
+    header.value = 0xA1B2C3D4U;
+
+    TEST_ASSERT_EQUAL(0, xoe_mux_encapsulate(&header, 5, &packet, &data),
+                      "Encapsulate");
+    memcpy(data, "hello", 5);
+    TEST_ASSERT_EQUAL(XOE_PROTOCOL_MUX, packet.protocol_id, "Protocol ID");
+    TEST_ASSERT_EQUAL(XOE_MUX_HEADER_SIZE + 5, (int)packet.payload->len,
+                      "Header plus payload");
+
+    TEST_ASSERT_EQUAL(0, xoe_mux_decapsulate(&packet, &decoded, &inner,
+                                             &inner_payload), "Decapsulate");
+    TEST_ASSERT_EQUAL(15, decoded.channel, "Channel");
+    TEST_ASSERT_EQUAL(XOE_MUX_DATA, decoded.type, "Type");
+    TEST_ASSERT(decoded.value == 0xA1B2C3D4U, "Value");
+    TEST_ASSERT_EQUAL(XOE_PROTOCOL_SERIAL, inner.protocol_id, "Inner protocol");
+    TEST_ASSERT_EQUAL(5, (int)inner.payload->len, "Inner length");
+    TEST_ASSERT(memcmp(inner.payload->data, "hello", 5) == 0, "Inner bytes");
+    TEST_ASSERT_EQUAL(FALSE, inner.payload->owns_data, "Inner is a view");
+
+    xoe_mux_free_payload(&packet);
+    TEST_ASSERT_NULL(packet.payload, "Payload released");
+}
+
+/**
+ * @brief Test foreign, short and out-of-range frames are refused
+ */
+void test_frame_rejects(void) {
+    xoe_mux_header_t header;
+    xoe_packet_t packet;
+    uint8_t* data;
+
+    memset(&header, 0, sizeof(header));
+    header.type = XOE_MUX_CREDIT;
+
+    header.channel = XOE_MUX_MAX_CHANNELS;
+    TEST_ASSERT_ERROR(xoe_mux_encapsulate(&header, 0, &packet, NULL),
+                      E_INVALID_ARGUMENT, "Channel out of range not built");
+    header.channel = 0;
+
+    TEST_ASSERT_EQUAL(0, xoe_mux_encapsulate(&header, 0, &packet, &data),
+                      "Control frame");
+
+    packet.protocol_id = XOE_PROTOCOL_SERIAL;
+    TEST_ASSERT_ERROR(xoe_mux_decapsulate(&packet, &header, NULL, NULL),
+                      E_PROTOCOL_ERROR, "Foreign protocol refused");
+    packet.protocol_id = XOE_PROTOCOL_MUX;
+
+    ((uint8_t*)packet.payload->data)[2] = 9;
+    TEST_ASSERT_ERROR(xoe_mux_decapsulate(&packet, &header, NULL, NULL),
+                      E_PROTOCOL_ERROR, "Unknown type refused");
+    ((uint8_t*)packet.payload->data)[2] = XOE_MUX_CREDIT;
+
+    xoe_wire_write_uint16((uint8_t*)packet.payload->data, 0xFFFF);
+    TEST_ASSERT_ERROR(xoe_mux_decapsulate(&packet, &header, NULL, NULL),
+                      E_PROTOCOL_ERROR, "Unknown channel refused");
+
+    packet.payload->len = XOE_MUX_HEADER_SIZE - 1;
+    TEST_ASSERT_ERROR(xoe_mux_decapsulate(&packet, &header, NULL, NULL),
+                      E_PROTOCOL_ERROR, "Truncated header refused");
+
+    xoe_mux_free_payload(&packet);
+}
+
+/* ============================================================================
+ * Credit Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the open handshake and send credit accounting
+ */
+void test_open_and_send_credit(void) {
+    xoe_mux_t mux;
+
+    TEST_ASSERT_EQUAL(0, xoe_mux_init(&mux), "Init");
+    TEST_ASSERT_ERROR(xoe_mux_channel_open(&mux, 0, XOE_PROTOCOL_SERIAL, 1,
+                                           XOE_MUX_MIN_WINDOW - 1),
+                      E_INVALID_ARGUMENT, "Tiny window refused");
+    TEST_ASSERT_EQUAL(0, xoe_mux_channel_open(&mux, 0, XOE_PROTOCOL_SERIAL, 1,
+                                              TEST_WINDOW), "Open");
+    TEST_ASSERT_ERROR(xoe_mux_channel_open(&mux, 0, XOE_PROTOCOL_SERIAL, 1,
+                                           TEST_WINDOW),
+                      E_INVALID_STATE, "Second open refused");
+
+    TEST_ASSERT_ERROR(xoe_mux_tx_acquire(&mux, 0, 1, 100, 0), E_TIMEOUT,
+                      "No credit before OPEN_ACK");
+    TEST_ASSERT_EQUAL(0, xoe_mux_channel_opened(&mux, 0, 2048), "OPEN_ACK");
+    TEST_ASSERT_EQUAL(XOE_MUX_CHANNEL_OPEN, xoe_mux_channel_state(&mux, 0),
+                      "Channel open");
+
+    TEST_ASSERT_EQUAL(1500, xoe_mux_tx_acquire(&mux, 0, 5, 1500, 0),
+                      "Full request granted");
+    TEST_ASSERT_EQUAL(548, xoe_mux_tx_acquire(&mux, 0, 5, 1500, 0),
+                      "Remaining credit granted");
+    TEST_ASSERT_ERROR(xoe_mux_tx_acquire(&mux, 0, 5, 1500, 10), E_TIMEOUT,
+                      "Exhausted credit waits");
+    TEST_ASSERT_ERROR(xoe_mux_tx_try(&mux, 0, 1), E_WOULD_BLOCK,
+                      "try does not wait");
+
+    TEST_ASSERT_EQUAL(0, xoe_mux_tx_grant(&mux, 0, 100), "Grant");
+    TEST_ASSERT_EQUAL(0, xoe_mux_tx_try(&mux, 0, 100), "Granted bytes usable");
+    TEST_ASSERT_ERROR(xoe_mux_tx_grant(&mux, 0, XOE_WIRE_MAX_PAYLOAD + 1),
+                      E_PROTOCOL_ERROR, "Overflowing grant refused");
+
+    xoe_mux_destroy(&mux);
+}
+
+/**
+ * @brief Test receive window enforcement and batched credit return
+ */
+void test_receive_window(void) {
+    xoe_mux_t mux;
+    uint32_t credit;
+
+    xoe_mux_init(&mux);
+    TEST_ASSERT_ERROR(xoe_mux_rx_accept(&mux, 3, 10), E_INVALID_STATE,
+                      "Data on a closed channel refused");
+    TEST_ASSERT_ERROR(xoe_mux_channel_accept(&mux, 3, XOE_PROTOCOL_RAW, 0,
+                                             10, TEST_WINDOW),
+                      E_PROTOCOL_ERROR, "Peer window below minimum refused");
+    TEST_ASSERT_EQUAL(0, xoe_mux_channel_accept(&mux, 3, XOE_PROTOCOL_RAW, 0,
+                                                TEST_WINDOW, TEST_WINDOW),
+                      "Accept peer OPEN");
+
+    TEST_ASSERT_EQUAL(0, xoe_mux_rx_accept(&mux, 3, TEST_WINDOW - 10),
+                      "Within window");
+    TEST_ASSERT_ERROR(xoe_mux_rx_accept(&mux, 3, 11), E_PROTOCOL_ERROR,
+                      "Beyond window refused");
+
+    credit = xoe_mux_rx_consumed(&mux, 3, 100);
+    TEST_ASSERT_EQUAL(0, (int)credit, "Small release batched");
+    credit = xoe_mux_rx_consumed(&mux, 3,
+                                 TEST_WINDOW / XOE_MUX_CREDIT_DIVISOR);
+    TEST_ASSERT_EQUAL(100 + TEST_WINDOW / XOE_MUX_CREDIT_DIVISOR, (int)credit,
+                      "Batch credited once a quarter window is consumed");
+    TEST_ASSERT_EQUAL(0, xoe_mux_rx_accept(&mux, 3, (uint32_t)credit + 10),
+                      "Credited bytes may be sent again");
+
+    xoe_mux_destroy(&mux);
+}
+
+/* Shared with the waiter thread */
+static xoe_mux_t waiter_mux;
+static int waiter_result;
+
+/**
+ * @brief Block for credit on channel 1
+ */
+static void* waiter_func(void* arg)
+{
+    (void)arg;
+    waiter_result = xoe_mux_tx_acquire(&waiter_mux, 1, 1, 64, -1);
+    return NULL;
+}
+
+/**
+ * @brief Test grants wake a blocked sender and close/shutdown release it
+ */
+void test_blocked_sender(void) {
+    pthread_t thread;
+
+    xoe_mux_init(&waiter_mux);
+    xoe_mux_channel_accept(&waiter_mux, 1, XOE_PROTOCOL_SERIAL, 1,
+                           XOE_MUX_MIN_WINDOW, TEST_WINDOW);
+    xoe_mux_tx_try(&waiter_mux, 1, XOE_MUX_MIN_WINDOW);
+
+    waiter_result = 0;
+    pthread_create(&thread, NULL, waiter_func, NULL);
+    usleep(20000);
+    xoe_mux_tx_grant(&waiter_mux, 1, 40);
+    pthread_join(thread, NULL);
+    TEST_ASSERT_EQUAL(40, waiter_result, "Grant wakes the sender");
+
+    pthread_create(&thread, NULL, waiter_func, NULL);
+    usleep(20000);
+    TEST_ASSERT_EQUAL(XOE_MUX_CHANNEL_OPEN,
+                      xoe_mux_channel_close(&waiter_mux, 1),
+                      "Close reports previous state");
+    pthread_join(thread, NULL);
+    TEST_ASSERT_ERROR(waiter_result, E_INVALID_STATE, "Close releases sender");
+    TEST_ASSERT_EQUAL(0, xoe_mux_tx_grant(&waiter_mux, 1, 10),
+                      "Late credit on a closed channel ignored");
+
+    xoe_mux_channel_accept(&waiter_mux, 1, XOE_PROTOCOL_SERIAL, 1,
+                           XOE_MUX_MIN_WINDOW, TEST_WINDOW);
+    xoe_mux_shutdown(&waiter_mux);
+    TEST_ASSERT_ERROR(xoe_mux_tx_acquire(&waiter_mux, 1, 1, 64, -1),
+                      E_INVALID_STATE, "Shutdown fails senders");
+
+    xoe_mux_destroy(&waiter_mux);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Channel Multiplexing Unit Tests ===\n\n");
+
+    /* Framing tests */
+    run_test("test_frame_round_trip", test_frame_round_trip);
+    run_test("test_frame_rejects", test_frame_rejects);
+
+    /* Credit tests */
+    run_test("test_open_and_send_credit", test_open_and_send_credit);
+    run_test("test_receive_window", test_receive_window);
+    run_test("test_blocked_sender", test_blocked_sender);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
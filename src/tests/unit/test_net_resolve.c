@@ -3,7 +3,8 @@
  * @brief Unit tests for network address resolution module
  *
  * Tests the net_resolve module for proper hostname resolution,
- * error handling, and thread-safe operation.
+ * error handling, and thread-safe operation, and that parallel connects
+ * get past black-holed and refusing addresses quickly.
  *
  * [LLM-ARCH]
  */
@@ -14,8 +15,14 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <sys/socket.h>
 
 /* ============================================================================
  * net_resolve_to_sockaddr() Tests
@@ -293,6 +300,274 @@ void test_connect_refused(void) {
     TEST_ASSERT_NOT_EQUAL(0, result.sys_errno, "sys_errno should be set");
 }
 
+/* ============================================================================
+ * Parallel Connect and Cache Tests
+ * ============================================================================ */
+
+/**
+ * @brief Open a listener on 127.0.0.1 with an ephemeral port
+ *
+ * @param backlog listen() backlog
+ * @param addr Output: the listener's address
+ * @return Listening socket, or -1
+ */
+static int open_test_listener(int backlog, net_resolve_addr_t *addr) {
+    struct sockaddr_in *in4 = (struct sockaddr_in *)&addr->addr;
+    int fd;
+
+    memset(addr, 0, sizeof(*addr));
+    in4->sin_family = AF_INET;
+    in4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr->len = sizeof(*in4);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)in4, addr->len) != 0 ||
+        listen(fd, backlog) != 0 ||
+        getsockname(fd, (struct sockaddr *)in4, &addr->len) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static long elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long)(now.tv_sec - start->tv_sec) * 1000 +
+           (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/**
+ * @brief Test a black-holed first address costs only the stagger
+ *
+ * A listener whose accept queue is full drops SYNs, like a host that
+ * never answers. A serial connect would wait for the TCP timeout.
+ */
+void test_connect_addrs_blackhole(void) {
+    net_resolve_addr_t addrs[2];
+    net_resolve_addr_t filler;
+    net_resolve_result_t result;
+    struct timespec start;
+    struct pollfd pfd;
+    int fillers[4];
+    int dead;
+    int live;
+    int sock = -1;
+    int winner = -1;
+    int i;
+
+    dead = open_test_listener(0, &addrs[0]);
+    live = open_test_listener(8, &addrs[1]);
+    if (dead < 0 || live < 0) {
+        TEST_SKIP("loopback listeners unavailable");
+        return;
+    }
+
+    /* Fill the dead listener's accept queue */
+    for (i = 0; i < 4; i++) {
+        fillers[i] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        filler = addrs[0];
+        (void)connect(fillers[i], (struct sockaddr *)&filler.addr, filler.len);
+    }
+    usleep(50000);
+    pfd.fd = fillers[3];
+    pfd.events = POLLOUT;
+    if (poll(&pfd, 1, 100) != 0) {
+        TEST_SKIP("accept queue overflow does not drop SYNs here");
+    } else {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        TEST_ASSERT_SUCCESS(net_resolve_connect_addrs(addrs, 2, NULL, &sock,
+                                                      &winner, &result),
+                            "Second address should answer");
+        TEST_ASSERT_EQUAL(1, winner, "Live listener won");
+        TEST_ASSERT(elapsed_ms(&start) < 900, "Took the stagger, not a timeout");
+        TEST_ASSERT(sock >= 0 && (fcntl(sock, F_GETFL, 0) & O_NONBLOCK) == 0,
+                    "Blocking socket returned");
+        if (sock >= 0) {
+            close(sock);
+        }
+    }
+
+    for (i = 0; i < 4; i++) {
+        close(fillers[i]);
+    }
+    close(dead);
+    close(live);
+}
+
+/**
+ * @brief Test a timed connect gives up on a black-holed address
+ */
+void test_connect_timed_blackhole(void) {
+    net_resolve_addr_t dead_addr;
+    net_resolve_addr_t filler;
+    net_resolve_result_t result;
+    struct timespec start;
+    struct pollfd pfd;
+    int fillers[4];
+    int dead;
+    int sock = -1;
+    int port;
+    int i;
+
+    dead = open_test_listener(0, &dead_addr);
+    if (dead < 0) {
+        TEST_SKIP("loopback listener unavailable");
+        return;
+    }
+    port = ntohs(((struct sockaddr_in *)&dead_addr.addr)->sin_port);
+
+    for (i = 0; i < 4; i++) {
+        fillers[i] = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        filler = dead_addr;
+        (void)connect(fillers[i], (struct sockaddr *)&filler.addr, filler.len);
+    }
+    usleep(50000);
+    pfd.fd = fillers[3];
+    pfd.events = POLLOUT;
+    if (poll(&pfd, 1, 100) != 0) {
+        TEST_SKIP("accept queue overflow does not drop SYNs here");
+    } else {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        TEST_ASSERT_EQUAL(E_TIMEOUT,
+                          net_resolve_connect_timed("127.0.0.1", port, NULL,
+                                                    300, &sock, &result),
+                          "Gave up");
+        TEST_ASSERT_EQUAL(E_TIMEOUT, result.error_code, "Reported as a timeout");
+        TEST_ASSERT(elapsed_ms(&start) < 900, "After the limit, not the TCP timeout");
+        TEST_ASSERT_EQUAL(-1, sock, "No socket returned");
+    }
+
+    for (i = 0; i < 4; i++) {
+        close(fillers[i]);
+    }
+    close(dead);
+}
+
+/**
+ * @brief Test a refused address moves on without waiting for the stagger
+ */
+void test_connect_addrs_refused(void) {
+    net_resolve_addr_t addrs[2];
+    net_resolve_result_t result;
+    struct timespec start;
+    int closed;
+    int live;
+    int sock = -1;
+    int winner = -1;
+
+    closed = open_test_listener(1, &addrs[0]);
+    live = open_test_listener(8, &addrs[1]);
+    if (closed < 0 || live < 0) {
+        TEST_SKIP("loopback listeners unavailable");
+        return;
+    }
+    close(closed);  /* Its port now refuses */
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    TEST_ASSERT_SUCCESS(net_resolve_connect_addrs(addrs, 2, NULL, &sock,
+                                                  &winner, &result),
+                        "Second address should answer");
+    TEST_ASSERT_EQUAL(1, winner, "Live listener won");
+    TEST_ASSERT(elapsed_ms(&start) < NET_RESOLVE_ATTEMPT_DELAY_MS,
+                "No stagger after a refusal");
+    if (sock >= 0) {
+        close(sock);
+    }
+
+    /* Only refusing addresses: the error of the last one */
+    addrs[1] = addrs[0];
+    TEST_ASSERT_EQUAL(E_NETWORK_ERROR,
+                      net_resolve_connect_addrs(addrs, 2, NULL, &sock, NULL,
+                                                &result),
+                      "Every address refused");
+    TEST_ASSERT_EQUAL(ECONNREFUSED, result.sys_errno, "Refusal reported");
+    TEST_ASSERT_EQUAL(-1, sock, "No socket");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      net_resolve_connect_addrs(addrs, 0, NULL, &sock, NULL,
+                                                &result),
+                      "No addresses");
+    close(live);
+}
+
+/**
+ * @brief Test connecting by hostname, from the resolver and the cache
+ */
+void test_connect_hostname_cached(void) {
+    net_resolve_addr_t addr;
+    net_resolve_result_t result;
+    int port;
+    int live;
+    int sock = -1;
+    int i;
+
+    live = open_test_listener(8, &addr);
+    if (live < 0) {
+        TEST_SKIP("loopback listener unavailable");
+        return;
+    }
+    port = ntohs(((struct sockaddr_in *)&addr.addr)->sin_port);
+
+    /* "localhost" may resolve to ::1 first; the server only has IPv4 */
+    net_resolve_cache_flush();
+    for (i = 0; i < 2; i++) {
+        sock = -1;
+        TEST_ASSERT_SUCCESS(net_resolve_connect("localhost", port, &sock,
+                                                &result),
+                            i == 0 ? "Resolved connect" : "Cached connect");
+        if (sock >= 0) {
+            close(sock);
+        }
+    }
+
+    /* A refused cached entry is dropped, and re-resolved next time */
+    close(live);
+    TEST_ASSERT_EQUAL(E_NETWORK_ERROR,
+                      net_resolve_connect("localhost", port, &sock, &result),
+                      "Listener gone");
+    TEST_ASSERT_EQUAL(-1, sock, "No socket");
+    net_resolve_cache_flush();
+}
+
+/**
+ * @brief Test an IPv6 literal connects
+ */
+void test_connect_ipv6_literal(void) {
+    struct sockaddr_in6 in6;
+    socklen_t len = sizeof(in6);
+    net_resolve_result_t result;
+    int listener;
+    int sock = -1;
+
+    listener = socket(AF_INET6, SOCK_STREAM, 0);
+    memset(&in6, 0, sizeof(in6));
+    in6.sin6_family = AF_INET6;
+    in6.sin6_addr = in6addr_loopback;
+    if (listener < 0 ||
+        bind(listener, (struct sockaddr *)&in6, sizeof(in6)) != 0 ||
+        listen(listener, 8) != 0 ||
+        getsockname(listener, (struct sockaddr *)&in6, &len) != 0) {
+        if (listener >= 0) {
+            close(listener);
+        }
+        TEST_SKIP("IPv6 loopback unavailable");
+        return;
+    }
+
+    TEST_ASSERT_SUCCESS(net_resolve_connect("::1", ntohs(in6.sin6_port),
+                                            &sock, &result),
+                        "IPv6 literal connect");
+    if (sock >= 0) {
+        close(sock);
+    }
+    close(listener);
+}
+
 /* ============================================================================
  * net_resolve_format_error() Tests
  * ============================================================================ */
@@ -408,6 +683,13 @@ int main(void) {
     run_test("test_connect_invalid_hostname", test_connect_invalid_hostname);
     run_test("test_connect_refused", test_connect_refused);
 
+    /* Parallel connect and cache tests */
+    run_test("test_connect_addrs_blackhole", test_connect_addrs_blackhole);
+    run_test("test_connect_addrs_refused", test_connect_addrs_refused);
+    run_test("test_connect_timed_blackhole", test_connect_timed_blackhole);
+    run_test("test_connect_hostname_cached", test_connect_hostname_cached);
+    run_test("test_connect_ipv6_literal", test_connect_ipv6_literal);
+
     /* net_resolve_format_error() tests */
     run_test("test_format_error_success", test_format_error_success);
     run_test("test_format_error_invalid_arg", test_format_error_invalid_arg);
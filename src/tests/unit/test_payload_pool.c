@@ -0,0 +1,268 @@
+/**
+ * @file test_payload_pool.c
+ * @brief Unit tests for the pooled payload allocator
+ *
+ * Tests size class reuse, oversized (uncached) blocks, ownership modes
+ * handled by xoe_payload_release(), shared references, and per-thread
+ * cache isolation.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* ============================================================================
+ * xoe_payload_alloc() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that the returned payload is usable and pooled
+ */
+void test_alloc_basic(void) {
+    xoe_payload_t* payload = xoe_payload_alloc(100);
+
+    TEST_ASSERT_NOT_NULL(payload, "Allocation should succeed");
+    if (payload == NULL) {
+        return;
+    }
+
+    TEST_ASSERT_NOT_NULL(payload->data, "Data should be present");
+    TEST_ASSERT_EQUAL(100, payload->len, "Length should be set");
+    TEST_ASSERT_EQUAL(XOE_PAYLOAD_POOLED, payload->owns_data,
+                      "Payload should be marked pooled");
+
+    memset(payload->data, 0xAB, payload->len);
+    xoe_payload_release(payload);
+}
+
+/**
+ * @brief Test that a released block is reused for the same size class
+ */
+void test_alloc_reuses_block(void) {
+    xoe_payload_t* first;
+    xoe_payload_t* second;
+
+    first = xoe_payload_alloc(200);
+    TEST_ASSERT_NOT_NULL(first, "First allocation should succeed");
+    xoe_payload_release(first);
+
+    second = xoe_payload_alloc(XOE_PAYLOAD_POOL_MIN_CLASS);
+    TEST_ASSERT_NOT_NULL(second, "Second allocation should succeed");
+    TEST_ASSERT(first == second, "Same size class should reuse the block");
+    if (second != NULL) {
+        TEST_ASSERT_EQUAL(XOE_PAYLOAD_POOL_MIN_CLASS, second->len,
+                          "Length should reflect the new request");
+    }
+    xoe_payload_release(second);
+}
+
+/**
+ * @brief Test that different size classes do not share blocks
+ */
+void test_alloc_class_separation(void) {
+    xoe_payload_t* small;
+    xoe_payload_t* large;
+
+    small = xoe_payload_alloc(16);
+    xoe_payload_release(small);
+
+    large = xoe_payload_alloc(XOE_PAYLOAD_POOL_MIN_CLASS * 4);
+    TEST_ASSERT_NOT_NULL(large, "Allocation should succeed");
+    TEST_ASSERT(large != small, "Larger class should not reuse a small block");
+    if (large != NULL) {
+        memset(large->data, 0, large->len);
+    }
+    xoe_payload_release(large);
+}
+
+/**
+ * @brief Test allocations above the largest class
+ */
+void test_alloc_oversized(void) {
+    uint32_t len = XOE_PAYLOAD_POOL_MAX_CLASS + 1;
+    xoe_payload_t* payload = xoe_payload_alloc(len);
+
+    TEST_ASSERT_NOT_NULL(payload, "Oversized allocation should succeed");
+    if (payload != NULL) {
+        TEST_ASSERT_EQUAL(len, payload->len, "Length should be set");
+        memset(payload->data, 0, payload->len);
+    }
+    xoe_payload_release(payload);
+}
+
+/* ============================================================================
+ * xoe_payload_release() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test release of malloc'd and borrowed payloads
+ */
+void test_release_ownership_modes(void) {
+    static char borrowed[8];
+    xoe_payload_t* owned;
+    xoe_payload_t* view;
+
+    owned = (xoe_payload_t*)malloc(sizeof(xoe_payload_t));
+    view = (xoe_payload_t*)malloc(sizeof(xoe_payload_t));
+    TEST_ASSERT_NOT_NULL(owned, "Descriptor allocation should succeed");
+    TEST_ASSERT_NOT_NULL(view, "Descriptor allocation should succeed");
+    if (owned == NULL || view == NULL) {
+        free(owned);
+        free(view);
+        return;
+    }
+
+    owned->data = malloc(32);
+    owned->len = 32;
+    owned->owns_data = TRUE;
+
+    view->data = borrowed;
+    view->len = sizeof(borrowed);
+    view->owns_data = FALSE;
+
+    /* Must free data+descriptor and descriptor only, respectively */
+    xoe_payload_release(owned);
+    xoe_payload_release(view);
+    xoe_payload_release(NULL);
+
+    TEST_ASSERT(1, "Release of all ownership modes should not crash");
+}
+
+/* ============================================================================
+ * xoe_payload_ref() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that a shared block is recycled only after the last release
+ */
+void test_ref_shares_block(void) {
+    xoe_payload_t* payload;
+    xoe_payload_t* other;
+
+    payload = xoe_payload_alloc(100);
+    TEST_ASSERT_NOT_NULL(payload, "Allocation should succeed");
+    if (payload == NULL) {
+        return;
+    }
+
+    TEST_ASSERT(xoe_payload_ref(payload) == payload,
+                "A pooled payload should be shared, not copied");
+    TEST_ASSERT(xoe_payload_ref(payload) == payload,
+                "A payload may be shared many times");
+
+    xoe_payload_release(payload);
+    xoe_payload_release(payload);
+    other = xoe_payload_alloc(100);
+    TEST_ASSERT(other != payload,
+                "A block still referenced must not be reused");
+    xoe_payload_release(other);
+
+    xoe_payload_release(payload);
+    other = xoe_payload_alloc(100);
+    TEST_ASSERT(other == payload,
+                "The last release should return the block to the cache");
+    xoe_payload_release(other);
+}
+
+/**
+ * @brief Test that a payload outside the pool is copied into it
+ */
+void test_ref_copies_unpooled(void) {
+    static char borrowed[8] = "serial!";
+    xoe_payload_t view;
+    xoe_payload_t* copy;
+
+    view.data = borrowed;
+    view.len = sizeof(borrowed);
+    view.owns_data = FALSE;
+
+    copy = xoe_payload_ref(&view);
+    TEST_ASSERT_NOT_NULL(copy, "Copy should succeed");
+    if (copy == NULL) {
+        return;
+    }
+    TEST_ASSERT(copy != &view, "An unpooled payload should be copied");
+    TEST_ASSERT_EQUAL(XOE_PAYLOAD_POOLED, copy->owns_data,
+                      "The copy should come from the pool");
+    TEST_ASSERT_EQUAL(sizeof(borrowed), copy->len, "Length should match");
+    TEST_ASSERT(memcmp(copy->data, borrowed, sizeof(borrowed)) == 0,
+                "Data should match");
+    xoe_payload_release(copy);
+
+    TEST_ASSERT_NULL(xoe_payload_ref(NULL), "NULL should give NULL");
+}
+
+/* ============================================================================
+ * Thread Cache Tests
+ * ============================================================================ */
+
+static xoe_payload_t* thread_alloc_result;
+
+static void* alloc_in_thread(void* arg) {
+    (void)arg;
+    thread_alloc_result = xoe_payload_alloc(64);
+    xoe_payload_release(thread_alloc_result);
+    return NULL;
+}
+
+/**
+ * @brief Test that each thread has its own cache
+ */
+void test_thread_local_cache(void) {
+    xoe_payload_t* mine;
+    pthread_t thread;
+
+    mine = xoe_payload_alloc(64);
+    xoe_payload_release(mine);
+
+    /* Our cached block must not be handed out to another thread */
+    if (pthread_create(&thread, NULL, alloc_in_thread, NULL) != 0) {
+        TEST_SKIP("pthread_create failed");
+        return;
+    }
+    pthread_join(thread, NULL);
+
+    TEST_ASSERT(thread_alloc_result != mine,
+                "Another thread should not take this thread's cached block");
+
+    TEST_ASSERT(xoe_payload_alloc(64) == mine,
+                "This thread's cached block should still be available");
+    xoe_payload_release(mine);
+
+    xoe_payload_pool_thread_cleanup();
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Payload Pool Unit Tests ===\n\n");
+
+    /* xoe_payload_alloc() tests */
+    run_test("test_alloc_basic", test_alloc_basic);
+    run_test("test_alloc_reuses_block", test_alloc_reuses_block);
+    run_test("test_alloc_class_separation", test_alloc_class_separation);
+    run_test("test_alloc_oversized", test_alloc_oversized);
+
+    /* xoe_payload_release() tests */
+    run_test("test_release_ownership_modes", test_release_ownership_modes);
+
+    /* xoe_payload_ref() tests */
+    run_test("test_ref_shares_block", test_ref_shares_block);
+    run_test("test_ref_copies_unpooled", test_ref_copies_unpooled);
+
+    /* Thread cache tests */
+    run_test("test_thread_local_cache", test_thread_local_cache);
+
+    print_test_summary();
+    xoe_payload_pool_thread_cleanup();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,398 @@
+/**
+ * @file test_protocol_registry.c
+ * @brief Unit tests for the server's protocol dispatch table
+ *
+ * Tests registration rules, lookup by id with the default handler,
+ * inline dispatch, pool dispatch keeping each connection's frames in
+ * order, queued replies, dropping a closing connection's frames, and a
+ * failing pool handler shutting the socket down.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/protocol_registry.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define FRAMES_PER_CLIENT 200
+
+/* What the handlers saw (pool handlers update it under the lock) */
+static pthread_mutex_t seen_lock = PTHREAD_MUTEX_INITIALIZER;
+static int inline_calls;
+static int default_calls;
+static int pool_calls;
+static int cleanups;
+static int out_of_order;
+static int pool_delay_us;
+static uint32_t last_seen[2];
+
+/* Connections the tests dispatch for */
+static client_info_t clients[2];
+
+/* Replies sent by protocol_registry_flush() */
+static int sent[2];
+static int sent_out_of_order;
+
+static int client_index(const client_info_t *client) {
+    return (client == &clients[1]) ? 1 : 0;
+}
+
+static int handle_inline(struct client_info *client, xoe_packet_t *packet) {
+    (void)client;
+    (void)packet;
+    inline_calls++;
+    return 0;
+}
+
+static int handle_default(struct client_info *client, xoe_packet_t *packet) {
+    (void)client;
+    (void)packet;
+    default_calls++;
+    return 0;
+}
+
+/**
+ * @brief Check the frame number in the payload and echo it as a reply
+ */
+static int handle_pool(struct client_info *client, xoe_packet_t *packet) {
+    int index = client_index(client);
+    uint32_t number;
+
+    memcpy(&number, packet->payload->data, sizeof(number));
+    if (pool_delay_us > 0) {
+        usleep((useconds_t)pool_delay_us);
+    }
+
+    pthread_mutex_lock(&seen_lock);
+    if (number != last_seen[index] + 1) {
+        out_of_order++;
+    }
+    last_seen[index] = number;
+    pool_calls++;
+    pthread_mutex_unlock(&seen_lock);
+
+    return protocol_registry_reply(client, packet);
+}
+
+static int handle_failing(struct client_info *client, xoe_packet_t *packet) {
+    (void)client;
+    (void)packet;
+    return E_PROTOCOL_ERROR;
+}
+
+static void cleanup_session(struct client_info *client) {
+    (void)client;
+    cleanups++;
+}
+
+static int record_send(client_info_t *client, const xoe_packet_t *packet) {
+    int index = client_index(client);
+    uint32_t number;
+
+    memcpy(&number, packet->payload->data, sizeof(number));
+    if (number != (uint32_t)sent[index] + 1) {
+        sent_out_of_order++;
+    }
+    sent[index]++;
+    return 0;
+}
+
+static const protocol_handler_t inline_handler = {
+    "inline", 0x0001, XOE_DISPATCH_INLINE, 0, handle_inline, cleanup_session
+};
+static const protocol_handler_t pool_handler = {
+    "pool", 0xFF01, XOE_DISPATCH_POOL, 2, handle_pool, cleanup_session
+};
+static const protocol_handler_t failing_handler = {
+    "failing", 0x0002, XOE_DISPATCH_POOL, 1, handle_failing, NULL
+};
+static const protocol_handler_t default_handler = {
+    "default", 0, XOE_DISPATCH_INLINE, 0, handle_default, NULL
+};
+
+static void reset_seen(void) {
+    inline_calls = 0;
+    default_calls = 0;
+    pool_calls = 0;
+    cleanups = 0;
+    out_of_order = 0;
+    pool_delay_us = 0;
+    memset(last_seen, 0, sizeof(last_seen));
+    memset(sent, 0, sizeof(sent));
+    sent_out_of_order = 0;
+    memset(clients, 0, sizeof(clients));
+    clients[0].client_socket = -1;
+    clients[1].client_socket = -1;
+}
+
+/**
+ * @brief Build a frame carrying a number
+ */
+static int make_frame(uint16_t protocol_id, uint32_t number,
+                      xoe_packet_t *packet) {
+    memset(packet, 0, sizeof(*packet));
+    packet->protocol_id = protocol_id;
+    packet->payload = xoe_payload_alloc(sizeof(number));
+    if (packet->payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    memcpy(packet->payload->data, &number, sizeof(number));
+    return 0;
+}
+
+/**
+ * @brief Dispatch one numbered frame and release the caller's reference
+ */
+static int dispatch_number(client_info_t *client, uint16_t protocol_id,
+                           uint32_t number) {
+    xoe_packet_t packet;
+    int result;
+
+    result = make_frame(protocol_id, number, &packet);
+    if (result != 0) {
+        return result;
+    }
+    result = protocol_registry_dispatch(client, &packet);
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Wait until the pools are done with a client
+ */
+static int wait_idle(client_info_t *client) {
+    int i;
+
+    for (i = 0; i < 500; i++) {
+        if (!protocol_registry_pending(client)) {
+            return TRUE;
+        }
+        usleep(10000);
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Wait until the pool handler has run @p calls frames
+ */
+static int wait_pool_calls(int calls) {
+    int done = FALSE;
+    int i;
+
+    for (i = 0; i < 500 && !done; i++) {
+        pthread_mutex_lock(&seen_lock);
+        done = (pool_calls >= calls);
+        pthread_mutex_unlock(&seen_lock);
+        if (!done) {
+            usleep(10000);
+        }
+    }
+    return done;
+}
+
+/* ============================================================================
+ * Registration Tests
+ * ============================================================================ */
+
+void test_register_rules(void) {
+    protocol_handler_t bad;
+
+    reset_seen();
+
+    bad = inline_handler;
+    bad.handle_packet = NULL;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, protocol_registry_register(&bad),
+                      "Handler without handle_packet refused");
+    bad = pool_handler;
+    bad.pool_threads = 0;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, protocol_registry_register(&bad),
+                      "Pool without threads refused");
+    bad.pool_threads = PROTOCOL_POOL_THREADS_MAX + 1;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, protocol_registry_register(&bad),
+                      "Oversized pool refused");
+    bad = inline_handler;
+    bad.dispatch = 7;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, protocol_registry_register(&bad),
+                      "Unknown dispatch refused");
+
+    TEST_ASSERT_SUCCESS(protocol_registry_register(&inline_handler),
+                        "Register inline handler");
+    TEST_ASSERT_EQUAL(E_DEVICE_BUSY,
+                      protocol_registry_register(&inline_handler),
+                      "Second handler for the id refused");
+
+    TEST_ASSERT(protocol_registry_lookup(0x0001) == &inline_handler,
+                "Lookup finds the handler");
+    TEST_ASSERT_NULL(protocol_registry_lookup(0x0101),
+                     "Same low byte, other page: nothing without default");
+    TEST_ASSERT_EQUAL(E_NOT_SUPPORTED, dispatch_number(&clients[0], 0x0005, 1),
+                      "Unknown protocol closes without default");
+
+    TEST_ASSERT_SUCCESS(protocol_registry_set_default(&default_handler),
+                        "Set default handler");
+    TEST_ASSERT(protocol_registry_lookup(0xFF00) == &default_handler,
+                "Unregistered id falls back to default");
+
+    TEST_ASSERT_SUCCESS(protocol_registry_start(), "Start registry");
+    TEST_ASSERT_EQUAL(E_INVALID_STATE,
+                      protocol_registry_register(&pool_handler),
+                      "No registration once started");
+    TEST_ASSERT_EQUAL(E_INVALID_STATE,
+                      protocol_registry_set_default(NULL),
+                      "Default fixed once started");
+
+    protocol_registry_cleanup();
+    TEST_ASSERT_NULL(protocol_registry_lookup(0x0001),
+                     "Cleanup forgets handlers");
+}
+
+/* ============================================================================
+ * Dispatch Tests
+ * ============================================================================ */
+
+void test_inline_dispatch(void) {
+    reset_seen();
+
+    TEST_ASSERT_SUCCESS(protocol_registry_register(&inline_handler),
+                        "Register inline handler");
+    TEST_ASSERT_SUCCESS(protocol_registry_set_default(&default_handler),
+                        "Set default handler");
+    TEST_ASSERT_SUCCESS(protocol_registry_start(), "Start registry");
+
+    TEST_ASSERT_SUCCESS(dispatch_number(&clients[0], 0x0001, 1),
+                        "Dispatch registered protocol");
+    TEST_ASSERT_SUCCESS(dispatch_number(&clients[0], 0x1234, 2),
+                        "Dispatch unregistered protocol");
+    TEST_ASSERT_EQUAL(1, inline_calls, "Inline handler ran on the caller");
+    TEST_ASSERT_EQUAL(1, default_calls, "Default handler ran");
+
+    protocol_registry_release(&clients[0]);
+    TEST_ASSERT_EQUAL(1, cleanups, "cleanup_session on release");
+
+    protocol_registry_cleanup();
+}
+
+void test_pool_order_and_replies(void) {
+    uint32_t i;
+    int result = 0;
+
+    reset_seen();
+
+    TEST_ASSERT_SUCCESS(protocol_registry_register(&pool_handler),
+                        "Register pool handler");
+    TEST_ASSERT_SUCCESS(protocol_registry_start(), "Start registry");
+
+    for (i = 1; i <= FRAMES_PER_CLIENT && result == 0; i++) {
+        result = dispatch_number(&clients[0], pool_handler.protocol_id, i);
+        if (result == 0) {
+            result = dispatch_number(&clients[1], pool_handler.protocol_id, i);
+        }
+    }
+    TEST_ASSERT_SUCCESS(result, "Frames queued");
+    TEST_ASSERT(wait_pool_calls(2 * FRAMES_PER_CLIENT), "Pools drained");
+
+    pthread_mutex_lock(&seen_lock);
+    TEST_ASSERT_EQUAL(2 * FRAMES_PER_CLIENT, pool_calls, "Every frame ran");
+    TEST_ASSERT_EQUAL(0, out_of_order, "Frames ran in order per client");
+    pthread_mutex_unlock(&seen_lock);
+
+    TEST_ASSERT(protocol_registry_pending(&clients[0]),
+                "Replies pending until flushed");
+    protocol_registry_flush(NULL, record_send);
+    TEST_ASSERT_EQUAL(FRAMES_PER_CLIENT, sent[0], "Replies to client 0");
+    TEST_ASSERT_EQUAL(FRAMES_PER_CLIENT, sent[1], "Replies to client 1");
+    TEST_ASSERT_EQUAL(0, sent_out_of_order, "Replies in order");
+    TEST_ASSERT(!protocol_registry_pending(&clients[0]), "Nothing pending");
+
+    protocol_registry_release(&clients[0]);
+    protocol_registry_release(&clients[1]);
+    protocol_registry_cleanup();
+}
+
+void test_release_drops_frames(void) {
+    uint32_t i;
+    int result = 0;
+
+    reset_seen();
+    pool_delay_us = 100000;
+
+    TEST_ASSERT_SUCCESS(protocol_registry_register(&pool_handler),
+                        "Register pool handler");
+    TEST_ASSERT_SUCCESS(protocol_registry_start(), "Start registry");
+
+    for (i = 1; i <= 4 && result == 0; i++) {
+        result = dispatch_number(&clients[0], pool_handler.protocol_id, i);
+    }
+    TEST_ASSERT_SUCCESS(result, "Frames queued");
+    usleep(20000);
+
+    /* The first frame is running; release waits for it, drops the rest */
+    protocol_registry_release(&clients[0]);
+    pthread_mutex_lock(&seen_lock);
+    TEST_ASSERT_EQUAL(1, pool_calls, "Queued frames dropped");
+    pthread_mutex_unlock(&seen_lock);
+    TEST_ASSERT_EQUAL(1, cleanups, "cleanup_session after the running frame");
+    TEST_ASSERT(!protocol_registry_pending(&clients[0]),
+                "Its reply dropped too");
+
+    protocol_registry_flush(NULL, record_send);
+    TEST_ASSERT_EQUAL(0, sent[0], "Nothing sent to the released client");
+
+    protocol_registry_cleanup();
+}
+
+void test_pool_failure_shuts_down(void) {
+    int pair[2];
+    char byte;
+
+    reset_seen();
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, pair),
+                        "Create socket pair");
+    clients[0].client_socket = pair[0];
+
+    TEST_ASSERT_SUCCESS(protocol_registry_register(&failing_handler),
+                        "Register failing handler");
+    TEST_ASSERT_SUCCESS(protocol_registry_start(), "Start registry");
+
+    TEST_ASSERT_SUCCESS(dispatch_number(&clients[0],
+                                        failing_handler.protocol_id, 1),
+                        "Queueing succeeds");
+    TEST_ASSERT(wait_idle(&clients[0]), "Pool drained");
+    TEST_ASSERT_EQUAL(0, (int)read(pair[1], &byte, 1),
+                      "Peer sees the connection shut down");
+
+    protocol_registry_release(&clients[0]);
+    protocol_registry_cleanup();
+    close(pair[0]);
+    close(pair[1]);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Protocol Registry Unit Tests ===\n\n");
+
+    /* Table tests */
+    run_test("test_register_rules", test_register_rules);
+
+    /* Dispatch tests */
+    run_test("test_inline_dispatch", test_inline_dispatch);
+    run_test("test_pool_order_and_replies", test_pool_order_and_replies);
+    run_test("test_release_drops_frames", test_release_drops_frames);
+    run_test("test_pool_failure_shuts_down", test_pool_failure_shuts_down);
+
+    print_test_summary();
+    xoe_payload_pool_thread_cleanup();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+/**
+ * @file test_rate_limit.c
+ * @brief Unit tests for the sharded per-address rate limiter
+ *
+ * Burst and refill behaviour, changing the rate in place, IPv4/IPv6 keys,
+ * forgetting an address, LRU eviction under a flood of new addresses (the
+ * limiter must not fail open), and exact token accounting with several
+ * threads on one address.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/rate_limit.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+/* Refill period long enough never to elapse during a test */
+#define TEST_SLOW_REFILL_MS 600000
+
+/* Threads and attempts per thread in the concurrency test */
+#define TEST_THREADS 4
+#define TEST_ATTEMPTS 500
+
+static rate_limiter_t limiter;
+static rate_limit_key_t shared_key;
+static int allowed_total;
+
+/**
+ * @brief Build a key for an IPv4 address in dotted form
+ */
+static rate_limit_key_t key_v4(const char* text)
+{
+    struct sockaddr_in addr;
+    rate_limit_key_t key;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, text, &addr.sin_addr);
+    rate_limit_key_from_sockaddr((struct sockaddr*)&addr, &key);
+    return key;
+}
+
+/**
+ * @brief Build a key for the n-th address of 10.0.0.0/8
+ */
+static rate_limit_key_t key_index(uint32_t n)
+{
+    struct sockaddr_in addr;
+    rate_limit_key_t key;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(0x0A000000u + n);
+    rate_limit_key_from_sockaddr((struct sockaddr*)&addr, &key);
+    return key;
+}
+
+/**
+ * @brief Thread body: hammer the shared address, count what got through
+ */
+static void* allow_thread(void* arg)
+{
+    int i;
+
+    (void)arg;
+    for (i = 0; i < TEST_ATTEMPTS; i++) {
+        if (rate_limiter_allow(&limiter, &shared_key)) {
+            __atomic_add_fetch(&allowed_total, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Key Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test IPv4 maps into IPv6 space and other families are refused
+ */
+void test_keys(void) {
+    struct sockaddr_in6 addr6;
+    struct sockaddr addr_unix;
+    rate_limit_key_t key4;
+    rate_limit_key_t key6;
+
+    memset(&addr6, 0, sizeof(addr6));
+    addr6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "::ffff:192.0.2.1", &addr6.sin6_addr);
+
+    key4 = key_v4("192.0.2.1");
+    TEST_ASSERT_EQUAL(0, rate_limit_key_from_sockaddr(
+                             (struct sockaddr*)&addr6, &key6),
+                      "IPv6 address accepted");
+    TEST_ASSERT(memcmp(&key4, &key6, sizeof(key4)) == 0,
+                "IPv4 and its mapped IPv6 form share a key");
+
+    inet_pton(AF_INET6, "2001:db8::1", &addr6.sin6_addr);
+    rate_limit_key_from_sockaddr((struct sockaddr*)&addr6, &key6);
+    TEST_ASSERT(memcmp(&key4, &key6, sizeof(key4)) != 0,
+                "Native IPv6 address has its own key");
+
+    memset(&addr_unix, 0, sizeof(addr_unix));
+    addr_unix.sa_family = AF_UNIX;
+    TEST_ASSERT_ERROR(rate_limit_key_from_sockaddr(&addr_unix, &key4),
+                      E_INVALID_ARGUMENT, "Other families refused");
+    TEST_ASSERT_ERROR(rate_limit_key_from_sockaddr(NULL, &key4),
+                      E_INVALID_ARGUMENT, "NULL address refused");
+}
+
+/* ============================================================================
+ * Bucket Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test an address gets its burst, then is refused, others unaffected
+ */
+void test_burst(void) {
+    rate_limit_key_t a = key_v4("198.51.100.1");
+    rate_limit_key_t b = key_v4("198.51.100.2");
+    int allowed = 0;
+    int i;
+
+    TEST_ASSERT_ERROR(rate_limiter_init(&limiter, 0, 10), E_INVALID_ARGUMENT,
+                      "Zero burst refused");
+    TEST_ASSERT_EQUAL(0, rate_limiter_init(&limiter, 5, TEST_SLOW_REFILL_MS),
+                      "Init");
+
+    TEST_ASSERT(!rate_limiter_blocked(&limiter, &a),
+                "Unknown address is not blocked");
+    for (i = 0; i < 8; i++) {
+        allowed += rate_limiter_allow(&limiter, &a);
+    }
+    TEST_ASSERT_EQUAL(5, allowed, "Exactly the burst allowed");
+    TEST_ASSERT(rate_limiter_blocked(&limiter, &a), "Address now blocked");
+    TEST_ASSERT(rate_limiter_allow(&limiter, &b), "Other address unaffected");
+
+    rate_limiter_forget(&limiter, &a);
+    TEST_ASSERT(!rate_limiter_blocked(&limiter, &a), "Forgotten address free");
+    TEST_ASSERT(rate_limiter_allow(&limiter, &a), "Forgotten address allowed");
+
+    rate_limiter_destroy(&limiter);
+}
+
+/**
+ * @brief Test tokens come back over time
+ */
+void test_refill(void) {
+    rate_limit_key_t a = key_v4("203.0.113.7");
+
+    TEST_ASSERT_EQUAL(0, rate_limiter_init(&limiter, 2, 20), "Init");
+    TEST_ASSERT(rate_limiter_allow(&limiter, &a), "First allowed");
+    TEST_ASSERT(rate_limiter_allow(&limiter, &a), "Second allowed");
+    TEST_ASSERT(!rate_limiter_allow(&limiter, &a), "Third refused");
+
+    usleep(50000);
+    TEST_ASSERT(rate_limiter_allow(&limiter, &a), "Allowed after refill");
+
+    rate_limiter_destroy(&limiter);
+}
+
+/**
+ * @brief Test a rate change takes effect for tracked and new addresses
+ */
+void test_set_rate(void) {
+    rate_limit_key_t a = key_v4("203.0.113.8");
+    rate_limit_key_t b = key_v4("203.0.113.9");
+    int allowed = 0;
+    int i;
+
+    TEST_ASSERT_EQUAL(0, rate_limiter_init(&limiter, 10, TEST_SLOW_REFILL_MS),
+                      "Init");
+    TEST_ASSERT(rate_limiter_allow(&limiter, &a), "First allowed");
+
+    TEST_ASSERT_ERROR(rate_limiter_set_rate(&limiter, 0, 10),
+                      E_INVALID_ARGUMENT, "Zero burst refused");
+    TEST_ASSERT_EQUAL(0, rate_limiter_set_rate(&limiter, 3,
+                                               TEST_SLOW_REFILL_MS),
+                      "Lower the burst");
+    for (i = 0; i < 5; i++) {
+        allowed += rate_limiter_allow(&limiter, &a);
+    }
+    TEST_ASSERT_EQUAL(3, allowed, "Tracked address capped at the new burst");
+    allowed = 0;
+    for (i = 0; i < 5; i++) {
+        allowed += rate_limiter_allow(&limiter, &b);
+    }
+    TEST_ASSERT_EQUAL(3, allowed, "New address gets the new burst");
+
+    rate_limiter_destroy(&limiter);
+}
+
+/* ============================================================================
+ * Eviction Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a flood of new addresses cannot unblock an active attacker
+ */
+void test_flood_does_not_fail_open(void) {
+    rate_limit_key_t attacker = key_v4("192.0.2.66");
+    rate_limit_key_t idle = key_v4("192.0.2.99");
+    rate_limit_key_t key;
+    int capacity = RATE_LIMIT_SHARDS * RATE_LIMIT_SHARD_ENTRIES;
+    int leaked = 0;
+    int i;
+
+    TEST_ASSERT_EQUAL(0, rate_limiter_init(&limiter, 3, TEST_SLOW_REFILL_MS),
+                      "Init");
+    for (i = 0; i < 3; i++) {
+        rate_limiter_allow(&limiter, &attacker);
+        rate_limiter_allow(&limiter, &idle);
+    }
+    TEST_ASSERT(rate_limiter_blocked(&limiter, &idle), "Idle source blocked");
+
+    /* Ten table-fulls of new sources while the attacker keeps retrying */
+    for (i = 0; i < capacity * 10; i++) {
+        key = key_index((uint32_t)i);
+        rate_limiter_allow(&limiter, &key);
+        if ((i % 16) == 0 && rate_limiter_allow(&limiter, &attacker)) {
+            leaked++;
+        }
+    }
+    TEST_ASSERT_EQUAL(0, leaked, "Attacker stays limited during the flood");
+
+    /* A source that went quiet was evicted and starts afresh */
+    TEST_ASSERT(!rate_limiter_blocked(&limiter, &idle),
+                "Least recently seen source evicted");
+
+    rate_limiter_destroy(&limiter);
+}
+
+/* ============================================================================
+ * Concurrency Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test threads racing on one address never exceed its burst
+ */
+void test_concurrent_exact(void) {
+    pthread_t threads[TEST_THREADS];
+    int i;
+
+    TEST_ASSERT_EQUAL(0, rate_limiter_init(&limiter, 100, TEST_SLOW_REFILL_MS),
+                      "Init");
+    shared_key = key_v4("192.0.2.200");
+    allowed_total = 0;
+
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_create(&threads[i], NULL, allow_thread, NULL);
+    }
+    for (i = 0; i < TEST_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    TEST_ASSERT_EQUAL(100, allowed_total, "Exactly the burst allowed");
+
+    rate_limiter_destroy(&limiter);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Rate Limiter Unit Tests ===\n\n");
+
+    /* Key tests */
+    run_test("test_keys", test_keys);
+
+    /* Bucket tests */
+    run_test("test_burst", test_burst);
+    run_test("test_refill", test_refill);
+    run_test("test_set_rate", test_set_rate);
+
+    /* Eviction tests */
+    run_test("test_flood_does_not_fail_open", test_flood_does_not_fail_open);
+
+    /* Concurrency tests */
+    run_test("test_concurrent_exact", test_concurrent_exact);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
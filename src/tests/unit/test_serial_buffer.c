@@ -10,15 +10,23 @@
 
 #include "tests/framework/test_framework.h"
 #include "connectors/serial/serial_buffer.h"
+#include "connectors/serial/serial_ring.h"
 #include "lib/common/definitions.h"
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 
 /* Test data constants */
 #define TEST_SMALL_SIZE 256
 #define TEST_DATA_SIZE 64
 
+/* Non-power-of-two capacity exercising rounded ring storage */
+#define TEST_ODD_SIZE 100
+
+/* Bytes streamed through the buffer by the threaded test */
+#define TEST_STREAM_SIZE (1024 * 1024)
+
 /**
  * @brief Test default size initialization
  *
@@ -456,6 +464,353 @@ void test_buffer_free_space_null(void) {
     TEST_ASSERT_EQUAL(0, result, "free_space(NULL) should return 0");
 }
 
+/**
+ * @brief Test ring capacity with rounded storage
+ *
+ * Verifies that a non-power-of-two capacity is honoured exactly and
+ * that data wraps intact across the end of the rounded storage.
+ */
+void test_ring_odd_capacity_wrap(void) {
+    serial_ring_t ring;
+    unsigned char write_data[160];
+    unsigned char read_data[160];
+    int i;
+
+    TEST_ASSERT_SUCCESS(serial_ring_init(&ring, TEST_ODD_SIZE),
+                        "Ring initialization should succeed");
+    if (ring.data == NULL) {
+        return;
+    }
+    TEST_ASSERT_EQUAL(128, ring.size, "Storage should round up to a power of two");
+
+    for (i = 0; i < 160; i++) {
+        write_data[i] = (unsigned char)(i * 3 + 1);
+    }
+
+    TEST_ASSERT_EQUAL(TEST_ODD_SIZE, serial_ring_write(&ring, write_data, 150),
+                      "Write should stop at the requested capacity");
+    TEST_ASSERT_EQUAL(0, serial_ring_free_space(&ring), "Ring should be full");
+    TEST_ASSERT_EQUAL(0, serial_ring_write(&ring, write_data, 1),
+                      "Write to a full ring should not block");
+
+    TEST_ASSERT_EQUAL(60, serial_ring_read(&ring, read_data, 60),
+                      "Partial read should succeed");
+
+    /* Crosses the 128-byte storage boundary */
+    TEST_ASSERT_EQUAL(60, serial_ring_write(&ring, write_data + 100, 60),
+                      "Write into freed space should succeed");
+    TEST_ASSERT_EQUAL(TEST_ODD_SIZE, serial_ring_read(&ring, read_data + 60, 100),
+                      "Read should drain the ring");
+    TEST_ASSERT(memcmp(write_data, read_data, sizeof(read_data)) == 0,
+                "Data should be intact across the wrap");
+    TEST_ASSERT_EQUAL(0, serial_ring_read(&ring, read_data, 1),
+                      "Read from an empty ring should not block");
+
+    serial_ring_destroy(&ring);
+}
+
+/**
+ * @brief Test ring rejects out of range capacities
+ */
+void test_ring_init_invalid(void) {
+    serial_ring_t ring;
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_ring_init(&ring, 0),
+                      "Zero capacity should be rejected");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_ring_init(NULL, 16),
+                      "NULL ring should be rejected");
+}
+
+typedef struct {
+    serial_buffer_t* buffer;
+    uint32_t received;
+    int in_order;
+} stream_reader_args_t;
+
+static void* stream_reader(void* arg) {
+    stream_reader_args_t* args = (stream_reader_args_t*)arg;
+    unsigned char chunk[37];
+    int bytes_read;
+    int i;
+
+    /* Odd chunk size so reads straddle writes and the wrap point */
+    while ((bytes_read = serial_buffer_read(args->buffer, chunk,
+                                            sizeof(chunk))) > 0) {
+        for (i = 0; i < bytes_read; i++) {
+            if (chunk[i] != (unsigned char)((args->received + i) % 251)) {
+                args->in_order = FALSE;
+            }
+        }
+        args->received += (uint32_t)bytes_read;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Test a producer and consumer thread streaming through the buffer
+ *
+ * Verifies that blocking on full and empty wakes the other side and
+ * that every byte arrives once and in order.
+ */
+void test_buffer_threaded_stream(void) {
+    serial_buffer_t buffer;
+    stream_reader_args_t args;
+    pthread_t thread;
+    unsigned char chunk[53];
+    uint32_t sent = 0;
+    uint32_t len;
+    uint32_t i;
+
+    if (serial_buffer_init(&buffer, TEST_ODD_SIZE) != 0) {
+        TEST_SKIP("buffer init failed");
+        return;
+    }
+
+    args.buffer = &buffer;
+    args.received = 0;
+    args.in_order = TRUE;
+    if (pthread_create(&thread, NULL, stream_reader, &args) != 0) {
+        serial_buffer_destroy(&buffer);
+        TEST_SKIP("pthread_create failed");
+        return;
+    }
+
+    while (sent < TEST_STREAM_SIZE) {
+        len = TEST_STREAM_SIZE - sent;
+        if (len > sizeof(chunk)) {
+            len = sizeof(chunk);
+        }
+        for (i = 0; i < len; i++) {
+            chunk[i] = (unsigned char)((sent + i) % 251);
+        }
+        if (serial_buffer_write(&buffer, chunk, len) != (int)len) {
+            break;
+        }
+        sent += len;
+    }
+
+    serial_buffer_close(&buffer);
+    pthread_join(thread, NULL);
+
+    TEST_ASSERT_EQUAL(TEST_STREAM_SIZE, sent, "Writer should send every byte");
+    TEST_ASSERT_EQUAL(TEST_STREAM_SIZE, args.received,
+                      "Reader should receive every byte");
+    TEST_ASSERT(args.in_order, "Bytes should arrive in order");
+
+    serial_buffer_destroy(&buffer);
+}
+
+static void* close_after_delay(void* arg) {
+    struct timespec delay;
+
+    delay.tv_sec = 0;
+    delay.tv_nsec = 20000000L;
+    nanosleep(&delay, NULL);
+    serial_buffer_close((serial_buffer_t*)arg);
+    return NULL;
+}
+
+/**
+ * @brief Test close releases a writer blocked on a full buffer
+ */
+void test_buffer_close_wakes_writer(void) {
+    serial_buffer_t buffer;
+    unsigned char write_data[TEST_DATA_SIZE];
+    pthread_t thread;
+    int result;
+
+    if (serial_buffer_init(&buffer, TEST_DATA_SIZE) != 0) {
+        TEST_SKIP("buffer init failed");
+        return;
+    }
+    memset(write_data, 0x5A, sizeof(write_data));
+    serial_buffer_write(&buffer, write_data, sizeof(write_data));
+
+    if (pthread_create(&thread, NULL, close_after_delay, &buffer) != 0) {
+        serial_buffer_destroy(&buffer);
+        TEST_SKIP("pthread_create failed");
+        return;
+    }
+
+    /* Blocks on the full buffer until the other thread closes it */
+    result = serial_buffer_write(&buffer, write_data, sizeof(write_data));
+    pthread_join(thread, NULL);
+
+    TEST_ASSERT_EQUAL(0, result, "Blocked write should return 0 after close");
+    TEST_ASSERT_EQUAL(TEST_DATA_SIZE, serial_buffer_available(&buffer),
+                      "Buffered data should remain readable");
+
+    serial_buffer_destroy(&buffer);
+}
+
+/**
+ * @brief Test peek exposes wrapped data as two spans
+ *
+ * Verifies that serial_buffer_peek() splits a region at the end of the
+ * rounded storage and that consume releases exactly what was used.
+ */
+void test_buffer_peek_spans_wrap(void) {
+    serial_buffer_t buffer;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    unsigned char data[TEST_ODD_SIZE];
+    unsigned char scratch[TEST_ODD_SIZE];
+    int span_count = 0;
+    int i;
+
+    serial_buffer_init(&buffer, TEST_ODD_SIZE);
+    for (i = 0; i < TEST_ODD_SIZE; i++) {
+        data[i] = (unsigned char)i;
+    }
+
+    /* Move the read position to 90 of 128, then fill across the end */
+    serial_buffer_write(&buffer, data, 90);
+    serial_buffer_read(&buffer, scratch, 90);
+    serial_buffer_write(&buffer, data, 80);
+
+    TEST_ASSERT_EQUAL(80, serial_buffer_peek(&buffer, TEST_ODD_SIZE, spans, &span_count),
+                      "Peek should expose all queued bytes");
+    TEST_ASSERT_EQUAL(2, span_count, "Wrapped data should need two spans");
+    if (span_count == 2) {
+        TEST_ASSERT_EQUAL(38, spans[0].iov_len, "First span should run to the end");
+        TEST_ASSERT_EQUAL(42, spans[1].iov_len, "Second span should hold the rest");
+        TEST_ASSERT(memcmp(spans[0].iov_base, data, 38) == 0 &&
+                    memcmp(spans[1].iov_base, data + 38, 42) == 0,
+                    "Spans should expose the data in place");
+    }
+    TEST_ASSERT_EQUAL(80, serial_buffer_available(&buffer),
+                      "Peek should not consume");
+
+    serial_buffer_consume(&buffer, 38);
+    TEST_ASSERT_EQUAL(10, serial_buffer_peek(&buffer, 10, spans, &span_count),
+                      "Peek should honour max_len");
+    TEST_ASSERT_EQUAL(1, span_count, "Unwrapped data should need one span");
+
+    serial_buffer_destroy(&buffer);
+}
+
+/**
+ * @brief Test data written into reserved spans becomes readable on commit
+ */
+void test_buffer_reserve_commit(void) {
+    serial_buffer_t buffer;
+    struct iovec spans[SERIAL_RING_MAX_SPANS];
+    unsigned char data[TEST_ODD_SIZE];
+    unsigned char out[TEST_ODD_SIZE];
+    int span_count = 0;
+    int reserved;
+    uint32_t filled = 0;
+    int i;
+
+    serial_buffer_init(&buffer, TEST_ODD_SIZE);
+    for (i = 0; i < TEST_ODD_SIZE; i++) {
+        data[i] = (unsigned char)(255 - i);
+    }
+
+    /* Leave the write position at 120 of 128 */
+    serial_buffer_write(&buffer, data, 60);
+    serial_buffer_read(&buffer, out, sizeof(out));
+    serial_buffer_write(&buffer, data, 60);
+    serial_buffer_read(&buffer, out, sizeof(out));
+
+    reserved = serial_buffer_reserve(&buffer, 30, spans, &span_count);
+    TEST_ASSERT_EQUAL(TEST_ODD_SIZE, reserved, "Reserve should expose all free space");
+    TEST_ASSERT_EQUAL(2, span_count, "Free space should wrap");
+    TEST_ASSERT_EQUAL(8, spans[0].iov_len, "First span should run to the end");
+    TEST_ASSERT_EQUAL(0, serial_buffer_available(&buffer),
+                      "Nothing should be readable before commit");
+
+    for (i = 0; i < span_count && filled < 30; i++) {
+        uint32_t chunk = (uint32_t)spans[i].iov_len;
+
+        if (chunk > 30 - filled) {
+            chunk = 30 - filled;
+        }
+        memcpy(spans[i].iov_base, data + filled, chunk);
+        filled += chunk;
+    }
+    serial_buffer_commit(&buffer, 30);
+
+    TEST_ASSERT_EQUAL(30, serial_buffer_read(&buffer, out, sizeof(out)),
+                      "Committed bytes should be readable");
+    TEST_ASSERT(memcmp(out, data, 30) == 0, "Committed data should be intact");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_buffer_reserve(&buffer, TEST_ODD_SIZE + 1, spans, &span_count),
+                      "Reserving more than the capacity should be rejected");
+    serial_buffer_close(&buffer);
+    TEST_ASSERT_EQUAL(0, serial_buffer_reserve(&buffer, 1, spans, &span_count),
+                      "Reserve on a closed buffer should return 0");
+
+    serial_buffer_destroy(&buffer);
+}
+
+/**
+ * @brief Test watermark validation
+ */
+void test_buffer_watermarks_invalid(void) {
+    serial_buffer_t buffer;
+
+    serial_buffer_init(&buffer, TEST_SMALL_SIZE);
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_buffer_set_watermarks(&buffer, TEST_SMALL_SIZE + 1, 0),
+                      "High watermark above capacity should be rejected");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_buffer_set_watermarks(&buffer, 64, 64),
+                      "Low watermark must be below high");
+    TEST_ASSERT_SUCCESS(serial_buffer_set_watermarks(&buffer, 0, 0),
+                        "Zero high watermark should disable flow control");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_buffer_set_watermarks(NULL, 64, 0),
+                      "NULL buffer should be rejected");
+
+    serial_buffer_destroy(&buffer);
+}
+
+/**
+ * @brief Test XOFF at the high watermark and XON at the low one
+ *
+ * Verifies each crossing is reported exactly once, with hysteresis
+ * between the two watermarks.
+ */
+void test_buffer_watermark_events(void) {
+    serial_buffer_t buffer;
+    unsigned char data[TEST_SMALL_SIZE];
+
+    serial_buffer_init(&buffer, TEST_SMALL_SIZE);
+    memset(data, 0x42, sizeof(data));
+
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_NONE, serial_buffer_flow_update(&buffer),
+                      "No events without watermarks");
+    serial_buffer_set_watermarks(&buffer, 192, 64);
+
+    serial_buffer_write(&buffer, data, 191);
+    TEST_ASSERT_EQUAL(FALSE, serial_buffer_flow_pending(&buffer),
+                      "Below high watermark should not be pending");
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_NONE, serial_buffer_flow_update(&buffer),
+                      "Below high watermark should report nothing");
+
+    serial_buffer_write(&buffer, data, 1);
+    TEST_ASSERT_EQUAL(TRUE, serial_buffer_flow_pending(&buffer),
+                      "Reaching high watermark should be pending");
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_XOFF, serial_buffer_flow_update(&buffer),
+                      "Reaching high watermark should report XOFF");
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_NONE, serial_buffer_flow_update(&buffer),
+                      "XOFF should be reported once");
+
+    /* Between the watermarks: still throttled */
+    serial_buffer_read(&buffer, data, 100);
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_NONE, serial_buffer_flow_update(&buffer),
+                      "Above low watermark should not report XON");
+
+    serial_buffer_read(&buffer, data, 28);
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_XON, serial_buffer_flow_update(&buffer),
+                      "Draining to low watermark should report XON");
+    TEST_ASSERT_EQUAL(SERIAL_BUFFER_FLOW_NONE, serial_buffer_flow_update(&buffer),
+                      "XON should be reported once");
+
+    serial_buffer_destroy(&buffer);
+}
+
 /**
  * @brief Main test runner for serial buffer tests
  *
@@ -497,6 +852,20 @@ int main(void) {
     run_test("test_buffer_available_null", test_buffer_available_null);
     run_test("test_buffer_free_space_null", test_buffer_free_space_null);
 
+    /* SPSC ring and threaded tests */
+    run_test("test_ring_odd_capacity_wrap", test_ring_odd_capacity_wrap);
+    run_test("test_ring_init_invalid", test_ring_init_invalid);
+    run_test("test_buffer_threaded_stream", test_buffer_threaded_stream);
+    run_test("test_buffer_close_wakes_writer", test_buffer_close_wakes_writer);
+
+    /* Span access tests */
+    run_test("test_buffer_peek_spans_wrap", test_buffer_peek_spans_wrap);
+    run_test("test_buffer_reserve_commit", test_buffer_reserve_commit);
+
+    /* Flow control watermark tests */
+    run_test("test_buffer_watermarks_invalid", test_buffer_watermarks_invalid);
+    run_test("test_buffer_watermark_events", test_buffer_watermark_events);
+
     print_test_summary();
 
     return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
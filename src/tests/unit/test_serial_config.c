@@ -0,0 +1,178 @@
+/**
+ * @file test_serial_config.c
+ * @brief Unit tests for the multi-device serial configuration
+ *
+ * Device spec parsing ("path[@baud]", comma lists, repeated specs),
+ * rejection of malformed specs without a partial commit, the device
+ * limit, and resolution against the shared settings.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/serial/serial_config.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * Spec Parsing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test single, per-port baud and comma-separated specs accumulate
+ */
+void test_add_specs(void) {
+    serial_multi_config_t* multi;
+
+    multi = serial_multi_config_init(SERIAL_MULTI_MAX_DEVICES);
+    TEST_ASSERT_NOT_NULL(multi, "Init");
+
+    TEST_ASSERT_EQUAL(0, serial_multi_config_add_spec(multi, "/dev/ttyS0"),
+                      "Plain path");
+    TEST_ASSERT_EQUAL(0, serial_multi_config_add_spec(multi,
+                                                      "/dev/ttyUSB0@115200"),
+                      "Path with baud");
+    TEST_ASSERT_EQUAL(0, serial_multi_config_add_spec(multi,
+                                                      "/dev/ttyS1,/dev/ttyS2@9600"),
+                      "Comma-separated list");
+
+    TEST_ASSERT_EQUAL(4, multi->device_count, "Four devices");
+    TEST_ASSERT_STR_EQUAL("/dev/ttyS0", multi->devices[0].device_path, "Path 0");
+    TEST_ASSERT_EQUAL(0, multi->devices[0].baud_rate, "Shared baud");
+    TEST_ASSERT_STR_EQUAL("/dev/ttyUSB0", multi->devices[1].device_path,
+                          "Baud stripped from path");
+    TEST_ASSERT_EQUAL(115200, multi->devices[1].baud_rate, "Own baud");
+    TEST_ASSERT_STR_EQUAL("/dev/ttyS2", multi->devices[3].device_path, "Path 3");
+    TEST_ASSERT_EQUAL(9600, multi->devices[3].baud_rate, "List entry baud");
+
+    serial_multi_config_free(multi);
+}
+
+/**
+ * @brief Test malformed specs are refused and leave the list unchanged
+ */
+void test_reject_specs(void) {
+    serial_multi_config_t* multi;
+
+    multi = serial_multi_config_init(4);
+    serial_multi_config_add_spec(multi, "/dev/ttyS0");
+
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, ""),
+                      E_INVALID_ARGUMENT, "Empty spec");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS1,"),
+                      E_INVALID_ARGUMENT, "Empty list entry");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS1@"),
+                      E_INVALID_ARGUMENT, "Missing baud");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS1@20"),
+                      E_INVALID_ARGUMENT, "Unsupported baud");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS1@96k"),
+                      E_INVALID_ARGUMENT, "Trailing garbage");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS1,@9600"),
+                      E_INVALID_ARGUMENT, "Baud without path");
+    TEST_ASSERT_EQUAL(1, multi->device_count, "Nothing partially added");
+
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "a,b,c,d"),
+                      E_BUFFER_TOO_SMALL, "List past the limit");
+    TEST_ASSERT_EQUAL(1, multi->device_count, "Overflowing list not added");
+    TEST_ASSERT_EQUAL(0, serial_multi_config_add_spec(multi, "a,b,c"),
+                      "List up to the limit");
+
+    TEST_ASSERT_NULL(serial_multi_config_init(0), "Zero capacity refused");
+    TEST_ASSERT_NULL(serial_multi_config_init(SERIAL_MULTI_MAX_DEVICES + 1),
+                     "Capacity above maximum refused");
+
+    serial_multi_config_free(multi);
+}
+
+/* ============================================================================
+ * Resolution Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test ports inherit the shared settings but keep path and own baud
+ */
+void test_resolve(void) {
+    serial_multi_config_t* multi;
+    serial_config_t base;
+
+    serial_config_init_defaults(&base);
+    base.baud_rate = 57600;
+    base.parity = SERIAL_PARITY_EVEN;
+    base.coalesce_us = 123;
+
+    multi = serial_multi_config_init(2);
+    serial_multi_config_add_spec(multi, "/dev/ttyS0,/dev/ttyS1@230400");
+
+    TEST_ASSERT_EQUAL(0, serial_multi_config_resolve(multi, &base), "Resolve");
+    TEST_ASSERT_STR_EQUAL("/dev/ttyS0", multi->devices[0].device_path,
+                          "Path kept");
+    TEST_ASSERT_EQUAL(57600, multi->devices[0].baud_rate, "Shared baud");
+    TEST_ASSERT_EQUAL(230400, multi->devices[1].baud_rate, "Own baud kept");
+    TEST_ASSERT_EQUAL(SERIAL_PARITY_EVEN, multi->devices[1].parity,
+                      "Shared parity");
+    TEST_ASSERT_EQUAL(123, multi->devices[1].coalesce_us, "Shared coalescing");
+
+    TEST_ASSERT_ERROR(serial_multi_config_resolve(NULL, &base),
+                      E_INVALID_ARGUMENT, "NULL list");
+
+    serial_multi_config_free(multi);
+}
+
+/**
+ * @brief Test per-port delivery modes override the shared one
+ */
+void test_delivery_modes(void) {
+    serial_multi_config_t* multi;
+    serial_config_t base;
+
+    serial_config_init_defaults(&base);
+    TEST_ASSERT_EQUAL(SERIAL_DELIVERY_DEFAULT, base.delivery, "Default mode");
+    base.delivery = SERIAL_DELIVERY_LATEST;
+
+    multi = serial_multi_config_init(4);
+    TEST_ASSERT_EQUAL(0, serial_multi_config_add_spec(multi,
+                      "/dev/ttyS0@115200#reliable,/dev/ttyS1#latest,/dev/ttyS2"),
+                      "Specs with modes");
+    TEST_ASSERT_EQUAL(115200, multi->devices[0].baud_rate, "Baud before mode");
+    TEST_ASSERT_STR_EQUAL("/dev/ttyS1", multi->devices[1].device_path,
+                          "Mode not in path");
+
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS3#fast"),
+                      E_INVALID_ARGUMENT, "Unknown mode");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS3#"),
+                      E_INVALID_ARGUMENT, "Empty mode");
+    TEST_ASSERT_ERROR(serial_multi_config_add_spec(multi, "/dev/ttyS3#latest@9600"),
+                      E_INVALID_ARGUMENT, "Mode before baud");
+
+    serial_multi_config_resolve(multi, &base);
+    TEST_ASSERT_EQUAL(SERIAL_DELIVERY_RELIABLE, multi->devices[0].delivery,
+                      "Own reliable kept");
+    TEST_ASSERT_EQUAL(SERIAL_DELIVERY_LATEST, multi->devices[1].delivery,
+                      "Own latest kept");
+    TEST_ASSERT_EQUAL(SERIAL_DELIVERY_LATEST, multi->devices[2].delivery,
+                      "Shared mode");
+
+    serial_multi_config_free(multi);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Serial Configuration Unit Tests ===\n\n");
+
+    /* Spec parsing tests */
+    run_test("test_add_specs", test_add_specs);
+    run_test("test_reject_specs", test_reject_specs);
+
+    /* Resolution tests */
+    run_test("test_resolve", test_resolve);
+    run_test("test_delivery_modes", test_delivery_modes);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,451 @@
+/**
+ * @file test_serial_dgram.c
+ * @brief Unit tests for serial channels over datagrams
+ *
+ * Two channels are joined by an in-memory link that queues encoded
+ * datagrams and can lose or reorder them. Tests in-order delivery and
+ * ACKs, selective retransmission after a SACK, the retransmit timeout
+ * and its backoff, duplicates, the full window, latest-value-wins
+ * delivery, keepalives and the peer timeout.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/serial/serial_dgram.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LINK_MAX 128
+
+/**
+ * @brief One direction of the in-memory link
+ */
+typedef struct {
+    uint8_t datagrams[LINK_MAX][XOE_WIRE_DGRAM_MAX];
+    int lengths[LINK_MAX];
+    int count;
+} test_link_t;
+
+static test_link_t g_a_to_b;
+static test_link_t g_b_to_a;
+
+/**
+ * @brief serial_dgram_send_fn: queue the packet as a datagram
+ */
+static int link_send(void* arg, const xoe_packet_t* packet) {
+    test_link_t* link = (test_link_t*)arg;
+    int len;
+
+    if (link->count == LINK_MAX) {
+        return 0;                   /* Lost */
+    }
+    len = xoe_wire_dgram_encode(packet, 0, link->datagrams[link->count],
+                                XOE_WIRE_DGRAM_MAX);
+    if (len < 0) {
+        return len;
+    }
+    link->lengths[link->count++] = len;
+    return 0;
+}
+
+/**
+ * @brief Hand one queued datagram to a channel
+ */
+static int link_deliver_one(test_link_t* link, int index,
+                            serial_dgram_t* channel, uint64_t now_ms) {
+    xoe_packet_t packet;
+    int result;
+
+    result = xoe_wire_dgram_decode(link->datagrams[index],
+                                   (uint32_t)link->lengths[index], 0, &packet);
+    if (result != 0) {
+        return result;
+    }
+    result = serial_dgram_input(channel, &packet, now_ms);
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Deliver every queued datagram except those in @p lose_mask
+ *
+ * @param lose_mask Bit i: datagram i is lost
+ */
+static void link_deliver(test_link_t* link, serial_dgram_t* channel,
+                         uint64_t lose_mask, uint64_t now_ms) {
+    int count = link->count;
+    int i;
+
+    link->count = 0;
+    for (i = 0; i < count; i++) {
+        if (i < 64 && (lose_mask & ((uint64_t)1 << i))) {
+            continue;
+        }
+        link_deliver_one(link, i, channel, now_ms);
+    }
+}
+
+/**
+ * @brief Create a channel pair joined by the link
+ */
+static int make_pair(int mode, serial_dgram_t** a, serial_dgram_t** b,
+                     uint64_t now_ms) {
+    g_a_to_b.count = 0;
+    g_b_to_a.count = 0;
+    *a = serial_dgram_create(mode, link_send, &g_a_to_b, now_ms);
+    *b = serial_dgram_create(mode, link_send, &g_b_to_a, now_ms);
+    if (*a == NULL || *b == NULL) {
+        serial_dgram_destroy(*a);
+        serial_dgram_destroy(*b);
+        return E_OUT_OF_MEMORY;
+    }
+    return 0;
+}
+
+/**
+ * @brief Take every deliverable frame's first byte into @p out
+ *
+ * @return Number of frames taken
+ */
+static int drain(serial_dgram_t* channel, unsigned char* out, int max,
+                 uint64_t now_ms) {
+    const unsigned char* data;
+    uint32_t len;
+    uint16_t flags;
+    int taken = 0;
+
+    while (taken < max && serial_dgram_peek(channel, &data, &len, &flags)) {
+        out[taken++] = data[0];
+        serial_dgram_consume(channel, now_ms);
+    }
+    return taken;
+}
+
+/* ============================================================================
+ * Reliable Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test in-order delivery and the delayed ACK releasing the sender
+ */
+void test_reliable_in_order(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    unsigned char out[8];
+    unsigned char byte;
+    int i;
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, 1000), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    for (i = 0; i < 3; i++) {
+        byte = (unsigned char)('a' + i);
+        TEST_ASSERT_SUCCESS(serial_dgram_send(a, &byte, 1, 0, 1000), "Sent");
+    }
+    TEST_ASSERT_EQUAL(3, serial_session_unacked(a->session), "Three in flight");
+
+    link_deliver(&g_a_to_b, b, 0, 1001);
+    TEST_ASSERT_EQUAL(0, g_b_to_a.count, "In-order frames need no SACK");
+    TEST_ASSERT_EQUAL(3, drain(b, out, 8, 1001), "All three delivered");
+    TEST_ASSERT(memcmp(out, "abc", 3) == 0, "In order");
+
+    /* The ACK waits a moment for a reply to carry it */
+    TEST_ASSERT_SUCCESS(serial_dgram_tick(b, 1002), "Early tick");
+    TEST_ASSERT_EQUAL(0, g_b_to_a.count, "ACK still delayed");
+    TEST_ASSERT_EQUAL(SERIAL_DGRAM_ACK_DELAY_MS - 1, serial_dgram_next_ms(b, 1002),
+                      "Tick due when the ACK is");
+    TEST_ASSERT_SUCCESS(serial_dgram_tick(b, 1001 + SERIAL_DGRAM_ACK_DELAY_MS),
+                        "ACK tick");
+    TEST_ASSERT_EQUAL(1, g_b_to_a.count, "One pure ACK");
+
+    link_deliver(&g_b_to_a, a, 0, 1020);
+    TEST_ASSERT_EQUAL(0, serial_session_unacked(a->session), "All acknowledged");
+    TEST_ASSERT(a->srtt_ms > 0, "Round trip measured");
+    TEST_ASSERT_EQUAL(0, a->retransmits, "Nothing resent");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/**
+ * @brief Test that a lost frame is resent alone once a SACK reports it
+ */
+void test_reliable_sack_retransmit(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    unsigned char out[8];
+    unsigned char byte;
+    int i;
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, 1000), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    for (i = 0; i < 4; i++) {
+        byte = (unsigned char)i;
+        serial_dgram_send(a, &byte, 1, 0, 1000);
+    }
+
+    /* Frame 1 is lost: 2 and 3 arrive past the gap */
+    link_deliver(&g_a_to_b, b, 0x2, 1010);
+    TEST_ASSERT_EQUAL(2, g_b_to_a.count, "A SACK for each frame past the gap");
+    TEST_ASSERT_EQUAL(1, drain(b, out, 8, 1010), "Only frame 0 deliverable");
+
+    link_deliver(&g_b_to_a, a, 0, 1030);
+    TEST_ASSERT_EQUAL(1, a->retransmits, "Gap resent once, not per SACK");
+    TEST_ASSERT_EQUAL(1, g_a_to_b.count, "Only the missing frame");
+
+    link_deliver(&g_a_to_b, b, 0, 1040);
+    TEST_ASSERT_EQUAL(3, drain(b, out + 1, 7, 1040), "Rest delivered");
+    TEST_ASSERT(out[0] == 0 && out[1] == 1 && out[2] == 2 && out[3] == 3,
+                "In order");
+
+    /* The SACKed frames are not resent by the timeout */
+    g_b_to_a.count = 0;
+    serial_dgram_tick(a, 1000 + SERIAL_DGRAM_RTO_INITIAL_MS);
+    TEST_ASSERT_EQUAL(1, a->retransmits, "SACKed frames left alone");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/**
+ * @brief Test the retransmit timeout and its doubling
+ */
+void test_reliable_rto_backoff(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    unsigned char byte = 'x';
+    unsigned char out[2];
+    uint64_t now = 1000;
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, now), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    serial_dgram_send(a, &byte, 1, 0, now);
+    g_a_to_b.count = 0;             /* Lost */
+
+    TEST_ASSERT_EQUAL(SERIAL_DGRAM_RTO_INITIAL_MS, serial_dgram_next_ms(a, now),
+                      "Timeout pending");
+    serial_dgram_tick(a, now + SERIAL_DGRAM_RTO_INITIAL_MS - 1);
+    TEST_ASSERT_EQUAL(0, a->retransmits, "Not before the timeout");
+
+    now += SERIAL_DGRAM_RTO_INITIAL_MS;
+    serial_dgram_tick(a, now);
+    TEST_ASSERT_EQUAL(1, a->retransmits, "Resent at the timeout");
+    TEST_ASSERT_EQUAL(SERIAL_DGRAM_RTO_INITIAL_MS * 2, a->rto_ms, "Backed off");
+    TEST_ASSERT_EQUAL(SERIAL_DGRAM_RTO_INITIAL_MS * 2, serial_dgram_next_ms(a, now),
+                      "Next timeout twice as far");
+
+    link_deliver(&g_a_to_b, b, 0, now + 5);
+    TEST_ASSERT_EQUAL(1, drain(b, out, 2, now + 5), "Arrived the second time");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/**
+ * @brief Test duplicates: buffered once, and a delivered one re-ACKed
+ */
+void test_reliable_duplicates(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    unsigned char byte = 'd';
+    unsigned char out[4];
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, 1000), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    serial_dgram_send(a, &byte, 1, 0, 1000);
+    TEST_ASSERT_SUCCESS(link_deliver_one(&g_a_to_b, 0, b, 1001), "First copy");
+    TEST_ASSERT_SUCCESS(link_deliver_one(&g_a_to_b, 0, b, 1001), "Second copy");
+    TEST_ASSERT_EQUAL(1, (int)b->session->duplicates, "Duplicate counted");
+    TEST_ASSERT_EQUAL(1, drain(b, out, 4, 1001), "Delivered once");
+
+    /* Once delivered, a copy means our ACK was lost: answer at once */
+    g_b_to_a.count = 0;
+    TEST_ASSERT_SUCCESS(link_deliver_one(&g_a_to_b, 0, b, 1002), "Late copy");
+    TEST_ASSERT_EQUAL(1, g_b_to_a.count, "ACKed immediately");
+    TEST_ASSERT_EQUAL(0, drain(b, out, 4, 1002), "Not delivered again");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/**
+ * @brief Test that a full window refuses more data
+ */
+void test_reliable_window_full(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    unsigned char byte = 'w';
+    int i;
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, 1000), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    for (i = 0; i < SERIAL_DGRAM_WINDOW; i++) {
+        TEST_ASSERT(serial_dgram_can_send(a), "Window open");
+        serial_dgram_send(a, &byte, 1, 0, 1000);
+    }
+    TEST_ASSERT(!serial_dgram_can_send(a), "Window full");
+    TEST_ASSERT_EQUAL(E_WOULD_BLOCK, serial_dgram_send(a, &byte, 1, 0, 1000),
+                      "Send refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_dgram_send(a, &byte, 0, 0, 1000),
+                      "Empty frame refused");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/**
+ * @brief Test that a reliable channel refuses frames without an ACK
+ */
+void test_reliable_requires_ack(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    xoe_packet_t packet;
+    unsigned char byte = 'n';
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, 1000), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    TEST_ASSERT_SUCCESS(serial_protocol_encapsulate_ack(&byte, 1, 0, 0, 0,
+                                                        &packet), "Built");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR, serial_dgram_input(b, &packet, 1000),
+                      "Stream-style frame refused");
+    serial_protocol_free_payload(&packet);
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/* ============================================================================
+ * Latest-Value-Wins Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that only the newest frame is delivered
+ */
+void test_latest_newest_wins(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    unsigned char byte;
+    unsigned char out[4];
+    int i;
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_LATEST, &a, &b, 1000), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    for (i = 0; i < 3; i++) {
+        byte = (unsigned char)('0' + i);
+        serial_dgram_send(a, &byte, 1, 0, 1000);
+    }
+
+    /* Reordered: 2 arrives first, then the stale 0 and 1 */
+    link_deliver_one(&g_a_to_b, 2, b, 1001);
+    link_deliver_one(&g_a_to_b, 0, b, 1001);
+    link_deliver_one(&g_a_to_b, 1, b, 1001);
+    g_a_to_b.count = 0;
+    TEST_ASSERT_EQUAL(1, drain(b, out, 4, 1001), "One frame");
+    TEST_ASSERT_EQUAL('2', out[0], "The newest");
+    TEST_ASSERT_EQUAL(2, (int)b->dropped, "Stale frames dropped");
+
+    /* Two new frames before the TTY takes one: the first is superseded */
+    byte = '3';
+    serial_dgram_send(a, &byte, 1, 0, 1002);
+    byte = '4';
+    serial_dgram_send(a, &byte, 1, 0, 1002);
+    link_deliver(&g_a_to_b, b, 0, 1003);
+    TEST_ASSERT_EQUAL(1, drain(b, out, 4, 1003), "One frame");
+    TEST_ASSERT_EQUAL('4', out[0], "The newest");
+    TEST_ASSERT_EQUAL(3, (int)b->dropped, "Superseded frame dropped");
+
+    /* Nothing is ever acknowledged or resent */
+    serial_dgram_tick(a, 1000 + SERIAL_DGRAM_RTO_MAX_MS);
+    TEST_ASSERT_EQUAL(0, g_b_to_a.count, "No ACKs");
+    TEST_ASSERT_EQUAL(0, a->retransmits, "No retransmits");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/* ============================================================================
+ * Liveness Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test keepalives on an idle channel and the peer timeout
+ */
+void test_keepalive_and_timeout(void) {
+    serial_dgram_t* a;
+    serial_dgram_t* b;
+    uint64_t now = 1000;
+
+    TEST_ASSERT_SUCCESS(make_pair(SERIAL_DGRAM_RELIABLE, &a, &b, now), "Pair");
+    if (a == NULL) {
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(SERIAL_DGRAM_KEEPALIVE_MS, serial_dgram_next_ms(a, now),
+                      "Idle: next work is the keepalive");
+    now += SERIAL_DGRAM_KEEPALIVE_MS;
+    TEST_ASSERT_SUCCESS(serial_dgram_tick(a, now), "Keepalive tick");
+    TEST_ASSERT_EQUAL(1, g_a_to_b.count, "Keepalive sent");
+
+    /* Keepalives keep the receiver's peer alive */
+    link_deliver(&g_a_to_b, b, 0, now);
+    TEST_ASSERT_SUCCESS(serial_dgram_tick(b, now + SERIAL_DGRAM_PEER_TIMEOUT_MS - 1),
+                        "Peer heard from recently");
+
+    /* a never hears from b */
+    TEST_ASSERT_EQUAL(E_TIMEOUT,
+                      serial_dgram_tick(a, 1000 + SERIAL_DGRAM_PEER_TIMEOUT_MS),
+                      "Silent peer reported gone");
+
+    serial_dgram_destroy(a);
+    serial_dgram_destroy(b);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Serial Datagram Unit Tests ===\n\n");
+
+    /* Reliable tests */
+    run_test("test_reliable_in_order", test_reliable_in_order);
+    run_test("test_reliable_sack_retransmit", test_reliable_sack_retransmit);
+    run_test("test_reliable_rto_backoff", test_reliable_rto_backoff);
+    run_test("test_reliable_duplicates", test_reliable_duplicates);
+    run_test("test_reliable_window_full", test_reliable_window_full);
+    run_test("test_reliable_requires_ack", test_reliable_requires_ack);
+
+    /* Latest-value-wins tests */
+    run_test("test_latest_newest_wins", test_latest_newest_wins);
+
+    /* Liveness tests */
+    run_test("test_keepalive_and_timeout", test_keepalive_and_timeout);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,473 @@
+/**
+ * @file test_serial_hub.c
+ * @brief Unit tests for the serial routing hub
+ *
+ * Tests joining topics (one publisher each), publisher fan-out with one
+ * shared payload, writer lease arbitration, dropped subscriber writes,
+ * outbox overflow, per-owner ready lists and wakeups, cleanup on leave,
+ * and the join / status frames.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/serial/serial_hub.h"
+#include "connectors/serial/serial_protocol.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Two pretend event loop workers */
+static int owner_a;
+static int owner_b;
+static int wakes_a;
+static int wakes_b;
+
+static void count_wake(void* owner) {
+    if (owner == &owner_a) {
+        wakes_a++;
+    } else if (owner == &owner_b) {
+        wakes_b++;
+    }
+}
+
+/* Pretend cluster: counts what the hub hands it */
+static int topic_changes;
+static int relayed_frames;
+static int relayed_role;
+static int relay_nodes;
+
+static void count_change(void* ctx) {
+    (void)ctx;
+    topic_changes++;
+}
+
+static int count_relay(void* ctx, const char* topic, int role,
+                       const xoe_packet_t* packet) {
+    (void)ctx;
+    (void)topic;
+    (void)packet;
+    relayed_frames++;
+    relayed_role = role;
+    return relay_nodes;
+}
+
+/**
+ * @brief Build a serial frame in a pooled payload
+ */
+static int make_frame(const char* text, xoe_packet_t* packet) {
+    return serial_protocol_encapsulate(text, (uint32_t)strlen(text), 1, 0,
+                                       packet);
+}
+
+/**
+ * @brief Take every frame queued for a member, checking its text
+ *
+ * @return Frames taken
+ */
+static int drain(serial_hub_member_t* member, const char* expect) {
+    xoe_packet_t packet;
+    const unsigned char* data;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t sequence;
+    uint16_t ack;
+    int taken = 0;
+
+    while (serial_hub_take(member, &packet)) {
+        if (expect != NULL &&
+            serial_protocol_peek(&packet, &flags, &sequence, &ack, &data,
+                                 &len) == 0) {
+            TEST_ASSERT(len == strlen(expect) &&
+                        memcmp(data, expect, len) == 0, "Frame data routed");
+        }
+        serial_protocol_free_payload(&packet);
+        taken++;
+    }
+    return taken;
+}
+
+/* ============================================================================
+ * Membership Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test argument checks and the one-publisher rule
+ */
+void test_join_rules(void) {
+    serial_hub_member_t* pub = NULL;
+    serial_hub_member_t* other = NULL;
+    char long_name[SERIAL_HUB_TOPIC_MAX + 2];
+
+    memset(long_name, 'x', sizeof(long_name) - 1);
+    long_name[sizeof(long_name) - 1] = '\0';
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_hub_join("", SERIAL_HUB_PUBLISHER, &owner_a,
+                                      count_wake, NULL, &other),
+                      "Empty topic refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_hub_join(long_name, SERIAL_HUB_PUBLISHER,
+                                      &owner_a, count_wake, NULL, &other),
+                      "Overlong topic refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_hub_join("tty", 9, &owner_a, count_wake, NULL,
+                                      &other),
+                      "Unknown role refused");
+
+    TEST_ASSERT_SUCCESS(serial_hub_join("tty", SERIAL_HUB_PUBLISHER, &owner_a,
+                                        count_wake, NULL, &pub),
+                        "Publisher joined");
+    TEST_ASSERT_EQUAL(E_DEVICE_BUSY,
+                      serial_hub_join("tty", SERIAL_HUB_PUBLISHER, &owner_b,
+                                      count_wake, NULL, &other),
+                      "Second publisher refused");
+
+    /* The topic is gone with its last member */
+    serial_hub_leave(pub);
+    TEST_ASSERT_SUCCESS(serial_hub_join("tty", SERIAL_HUB_PUBLISHER, &owner_b,
+                                        count_wake, NULL, &other),
+                        "Publisher may join again once the first left");
+    serial_hub_leave(other);
+    serial_hub_leave(NULL);
+}
+
+/* ============================================================================
+ * Routing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that one published frame reaches every member, shared
+ */
+void test_publish_fan_out(void) {
+    serial_hub_member_t* pub = NULL;
+    serial_hub_member_t* sub1 = NULL;
+    serial_hub_member_t* sub2 = NULL;
+    serial_hub_member_t* writer = NULL;
+    serial_hub_member_t* elsewhere = NULL;
+    xoe_packet_t frame;
+    xoe_packet_t copy1;
+    xoe_packet_t copy2;
+    serial_hub_member_t* first;
+    serial_hub_member_t* second;
+
+    serial_hub_join("fan", SERIAL_HUB_PUBLISHER, &owner_a, count_wake,
+                    NULL, &pub);
+    serial_hub_join("fan", SERIAL_HUB_SUBSCRIBER, &owner_a, count_wake,
+                    NULL, &sub1);
+    serial_hub_join("fan", SERIAL_HUB_SUBSCRIBER, &owner_b, count_wake,
+                    NULL, &sub2);
+    serial_hub_join("fan", SERIAL_HUB_WRITER, &owner_b, count_wake,
+                    NULL, &writer);
+    serial_hub_join("other", SERIAL_HUB_SUBSCRIBER, &owner_a, count_wake,
+                    NULL, &elsewhere);
+    TEST_ASSERT(pub && sub1 && sub2 && writer && elsewhere, "All joined");
+    if (!(pub && sub1 && sub2 && writer && elsewhere)) {
+        return;
+    }
+
+    wakes_a = 0;
+    wakes_b = 0;
+    TEST_ASSERT_SUCCESS(make_frame("hello", &frame), "Frame built");
+    TEST_ASSERT_EQUAL(3, serial_hub_route(pub, &frame),
+                      "Queued for both subscribers and the writer");
+    TEST_ASSERT_EQUAL(3, serial_hub_route(pub, &frame),
+                      "Second frame queued too");
+    TEST_ASSERT_EQUAL(1, wakes_a, "Owner A woken for its member");
+    TEST_ASSERT_EQUAL(2, wakes_b, "Owner B woken for each of its members");
+
+    /* Shared, not copied */
+    TEST_ASSERT(serial_hub_take(sub1, &copy1) == 1, "Subscriber 1 frame");
+    TEST_ASSERT(serial_hub_take(sub2, &copy2) == 1, "Subscriber 2 frame");
+    TEST_ASSERT(copy1.payload == frame.payload &&
+                copy2.payload == frame.payload,
+                "Every recipient holds the received payload");
+    serial_protocol_free_payload(&frame);
+    serial_protocol_free_payload(&copy1);
+    serial_protocol_free_payload(&copy2);
+
+    /* Each owner finds only its own members */
+    TEST_ASSERT(serial_hub_next_ready(&owner_a) == sub1, "A: subscriber 1");
+    TEST_ASSERT_NULL(serial_hub_next_ready(&owner_a), "A: nothing else");
+    first = serial_hub_next_ready(&owner_b);
+    second = serial_hub_next_ready(&owner_b);
+    TEST_ASSERT((first == sub2 && second == writer) ||
+                (first == writer && second == sub2), "B: both members");
+    TEST_ASSERT_NULL(serial_hub_next_ready(&owner_b), "B: nothing else");
+
+    TEST_ASSERT_EQUAL(1, drain(sub1, "hello"), "Rest of subscriber 1");
+    TEST_ASSERT_EQUAL(1, drain(sub2, "hello"), "Rest of subscriber 2");
+    TEST_ASSERT_EQUAL(2, drain(writer, "hello"), "Writer gets both");
+    TEST_ASSERT_EQUAL(0, drain(pub, NULL), "Nothing back to the publisher");
+    TEST_ASSERT_EQUAL(0, drain(elsewhere, NULL), "Other topics untouched");
+
+    serial_hub_leave(elsewhere);
+    serial_hub_leave(writer);
+    serial_hub_leave(sub2);
+    serial_hub_leave(sub1);
+    serial_hub_leave(pub);
+}
+
+/**
+ * @brief Test the write lease and dropped subscriber writes
+ */
+void test_writer_arbitration(void) {
+    serial_hub_member_t* pub = NULL;
+    serial_hub_member_t* sub = NULL;
+    serial_hub_member_t* first = NULL;
+    serial_hub_member_t* second = NULL;
+    xoe_packet_t frame;
+
+    serial_hub_join("console", SERIAL_HUB_WRITER, &owner_a, count_wake,
+                    NULL, &first);
+    serial_hub_join("console", SERIAL_HUB_WRITER, &owner_b, count_wake,
+                    NULL, &second);
+    serial_hub_join("console", SERIAL_HUB_SUBSCRIBER, &owner_b, count_wake,
+                    NULL, &sub);
+    TEST_ASSERT(first && second && sub, "Joined");
+    if (!(first && second && sub)) {
+        return;
+    }
+    TEST_ASSERT_SUCCESS(make_frame("ls\n", &frame), "Frame built");
+
+    /* Without a publisher the write goes nowhere, but takes the lease */
+    TEST_ASSERT_EQUAL(0, serial_hub_route(first, &frame), "No publisher yet");
+
+    serial_hub_join("console", SERIAL_HUB_PUBLISHER, &owner_a, count_wake,
+                    NULL, &pub);
+    TEST_ASSERT_NOT_NULL(pub, "Publisher joined");
+    if (pub == NULL) {
+        serial_protocol_free_payload(&frame);
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(1, serial_hub_route(first, &frame),
+                      "Lease holder reaches the publisher");
+    TEST_ASSERT_EQUAL(0, serial_hub_route(second, &frame),
+                      "Other writer is held off");
+    TEST_ASSERT_EQUAL(0, serial_hub_route(sub, &frame),
+                      "Subscriber writes are dropped");
+    TEST_ASSERT_EQUAL(1, serial_hub_member_dropped(second),
+                      "Held-off frame counted");
+    TEST_ASSERT_EQUAL(1, serial_hub_member_dropped(sub),
+                      "Subscriber frame counted");
+    TEST_ASSERT_EQUAL(1, drain(pub, "ls\n"), "Publisher got one frame");
+
+    /* Leaving releases the lease */
+    serial_hub_leave(first);
+    TEST_ASSERT_EQUAL(1, serial_hub_route(second, &frame),
+                      "Lease passes once the holder left");
+    TEST_ASSERT_EQUAL(1, drain(pub, "ls\n"), "Publisher got it");
+
+    serial_protocol_free_payload(&frame);
+    serial_hub_leave(sub);
+    serial_hub_leave(second);
+    serial_hub_leave(pub);
+}
+
+/**
+ * @brief Test that a full outbox drops frames for that member only
+ */
+void test_outbox_overflow(void) {
+    serial_hub_member_t* pub = NULL;
+    serial_hub_member_t* slow = NULL;
+    serial_hub_member_t* fast = NULL;
+    xoe_packet_t frame;
+    int i;
+
+    serial_hub_join("busy", SERIAL_HUB_PUBLISHER, &owner_a, count_wake,
+                    NULL, &pub);
+    serial_hub_join("busy", SERIAL_HUB_SUBSCRIBER, &owner_a, count_wake,
+                    NULL, &slow);
+    serial_hub_join("busy", SERIAL_HUB_SUBSCRIBER, &owner_b, count_wake,
+                    NULL, &fast);
+    TEST_ASSERT(pub && slow && fast, "Joined");
+    if (!(pub && slow && fast)) {
+        return;
+    }
+    TEST_ASSERT_SUCCESS(make_frame("x", &frame), "Frame built");
+
+    for (i = 0; i < SERIAL_HUB_OUTBOX_MAX; i++) {
+        serial_hub_route(pub, &frame);
+        drain(fast, NULL);
+    }
+    TEST_ASSERT_EQUAL(1, serial_hub_route(pub, &frame),
+                      "Only the member with room gets it");
+    TEST_ASSERT_EQUAL(1, serial_hub_member_dropped(slow),
+                      "Overflow counted for the slow member");
+    TEST_ASSERT_EQUAL(0, serial_hub_member_dropped(fast), "None for the fast");
+
+    /* Leaving with a full outbox releases every reference */
+    serial_hub_leave(slow);
+    serial_protocol_free_payload(&frame);
+    serial_hub_leave(fast);
+    serial_hub_leave(pub);
+    TEST_ASSERT(1, "Queued payloads released on leave");
+}
+
+/**
+ * @brief Test relaying to other nodes and delivering what they relay
+ */
+void test_cluster_relay(void) {
+    serial_hub_member_t* pub = NULL;
+    serial_hub_member_t* sub = NULL;
+    serial_hub_member_t* writer = NULL;
+    xoe_packet_t frame;
+    char names[4][SERIAL_HUB_TOPIC_MAX + 1];
+
+    topic_changes = 0;
+    relayed_frames = 0;
+    relay_nodes = 1;
+    serial_hub_set_relay(count_change, count_relay, NULL);
+
+    serial_hub_join("bus", SERIAL_HUB_SUBSCRIBER, &owner_a, count_wake,
+                    NULL, &sub);
+    serial_hub_join("bus", SERIAL_HUB_WRITER, &owner_b, count_wake,
+                    NULL, &writer);
+    TEST_ASSERT(sub && writer, "Joined");
+    if (!(sub && writer)) {
+        serial_hub_set_relay(NULL, NULL, NULL);
+        return;
+    }
+    TEST_ASSERT_EQUAL(1, topic_changes, "New topic noted once");
+    TEST_ASSERT_EQUAL(1, serial_hub_topic_names(names, 4), "One topic here");
+    TEST_ASSERT_STR_EQUAL("bus", names[0], "Topic listed");
+    TEST_ASSERT_SUCCESS(make_frame("poll", &frame), "Frame built");
+
+    /* The publisher is on another node: writes go there */
+    TEST_ASSERT_EQUAL(0, serial_hub_route(writer, &frame),
+                      "No local publisher");
+    TEST_ASSERT_EQUAL(1, relayed_frames, "Write relayed");
+    TEST_ASSERT_EQUAL(SERIAL_HUB_WRITER, relayed_role, "As a writer");
+    TEST_ASSERT_EQUAL(0, serial_hub_member_dropped(writer),
+                      "Not counted as dropped");
+    relay_nodes = 0;
+    serial_hub_route(writer, &frame);
+    TEST_ASSERT_EQUAL(1, serial_hub_member_dropped(writer),
+                      "Dropped when no node has the topic");
+
+    /* Its frames come back to every local member */
+    TEST_ASSERT_EQUAL(2, serial_hub_deliver("bus", SERIAL_HUB_PUBLISHER,
+                                            &frame),
+                      "Remote publisher's frame delivered");
+    TEST_ASSERT_EQUAL(1, drain(sub, "poll"), "Subscriber got it");
+    TEST_ASSERT_EQUAL(1, drain(writer, "poll"), "Writer got it");
+    TEST_ASSERT_EQUAL(0, serial_hub_deliver("nowhere", SERIAL_HUB_PUBLISHER,
+                                            &frame),
+                      "Unknown topic ignored");
+
+    /* With a local publisher, remote writes reach it and its frames leave */
+    serial_hub_join("bus", SERIAL_HUB_PUBLISHER, &owner_a, count_wake,
+                    NULL, &pub);
+    TEST_ASSERT_NOT_NULL(pub, "Publisher joined");
+    if (pub != NULL) {
+        TEST_ASSERT_EQUAL(0, serial_hub_deliver("bus", SERIAL_HUB_WRITER,
+                                                &frame),
+                          "Remote write held off by the local lease");
+
+        relayed_frames = 0;
+        TEST_ASSERT_EQUAL(2, serial_hub_route(pub, &frame),
+                          "Queued for local members");
+        TEST_ASSERT_EQUAL(1, relayed_frames, "And relayed");
+        TEST_ASSERT_EQUAL(SERIAL_HUB_PUBLISHER, relayed_role,
+                          "As the publisher");
+        drain(sub, NULL);
+
+        /* Leaving releases the lease to remote writers */
+        serial_hub_leave(writer);
+        writer = NULL;
+        TEST_ASSERT_EQUAL(1, serial_hub_deliver("bus", SERIAL_HUB_WRITER,
+                                                &frame),
+                          "Remote write reaches the publisher");
+        TEST_ASSERT_EQUAL(1, drain(pub, "poll"), "Publisher got it");
+        serial_hub_leave(pub);
+    }
+
+    serial_protocol_free_payload(&frame);
+    serial_hub_leave(writer);
+    serial_hub_leave(sub);
+    TEST_ASSERT_EQUAL(2, topic_changes, "Topic going away noted");
+    serial_hub_set_relay(NULL, NULL, NULL);
+}
+
+/* ============================================================================
+ * Frame Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the join and status frames and role names
+ */
+void test_hub_frames(void) {
+    xoe_packet_t packet;
+    const unsigned char* data;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t sequence;
+    uint16_t ack;
+    char topic[SERIAL_HUB_TOPIC_MAX + 1];
+    int role;
+
+    TEST_ASSERT_SUCCESS(serial_hub_join_frame("plc-1", SERIAL_HUB_WRITER,
+                                              &packet), "Join frame built");
+    TEST_ASSERT_SUCCESS(serial_protocol_peek(&packet, &flags, &sequence,
+                                             &ack, &data, &len), "Peeked");
+    TEST_ASSERT(flags & SERIAL_FLAG_HUB, "Marked as a hub frame");
+    TEST_ASSERT_SUCCESS(serial_hub_join_parse(data, len, topic, &role),
+                        "Join frame parsed");
+    TEST_ASSERT(strcmp(topic, "plc-1") == 0, "Topic kept");
+    TEST_ASSERT_EQUAL(SERIAL_HUB_WRITER, role, "Role kept");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      serial_hub_status_parse(&packet),
+                      "A join is not a status");
+    serial_protocol_free_payload(&packet);
+
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      serial_hub_join_parse((const unsigned char*)"\002",
+                                            1, topic, &role),
+                      "Join without a topic refused");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      serial_hub_join_parse((const unsigned char*)"\007ab",
+                                            3, topic, &role),
+                      "Join with a bad role refused");
+
+    TEST_ASSERT_SUCCESS(serial_hub_status_frame(SERIAL_HUB_TAKEN, &packet),
+                        "Status frame built");
+    TEST_ASSERT_EQUAL(SERIAL_HUB_TAKEN, serial_hub_status_parse(&packet),
+                      "Status parsed");
+    serial_protocol_free_payload(&packet);
+
+    TEST_ASSERT_EQUAL(SERIAL_HUB_PUBLISHER, serial_hub_parse_role("pub"),
+                      "pub");
+    TEST_ASSERT_EQUAL(SERIAL_HUB_SUBSCRIBER, serial_hub_parse_role("sub"),
+                      "sub");
+    TEST_ASSERT_EQUAL(SERIAL_HUB_WRITER, serial_hub_parse_role("write"),
+                      "write");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_hub_parse_role("admin"),
+                      "Unknown role");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Serial Hub Unit Tests ===\n\n");
+
+    /* Membership tests */
+    run_test("test_join_rules", test_join_rules);
+
+    /* Routing tests */
+    run_test("test_publish_fan_out", test_publish_fan_out);
+    run_test("test_writer_arbitration", test_writer_arbitration);
+    run_test("test_outbox_overflow", test_outbox_overflow);
+    run_test("test_cluster_relay", test_cluster_relay);
+
+    /* Frame tests */
+    run_test("test_hub_frames", test_hub_frames);
+
+    print_test_summary();
+    xoe_payload_pool_thread_cleanup();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
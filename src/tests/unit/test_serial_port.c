@@ -0,0 +1,627 @@
+/**
+ * @file test_serial_port.c
+ * @brief Unit tests for serial port configuration and coalesced reads
+ *
+ * Tests coalescing limits in serial_config_validate(), the idle gap,
+ * character time and read size derived from the line settings,
+ * serial_port_read_coalesced() and serial_port_read_adaptive() over
+ * a pipe (byte limit, idle flush, window expiry and timeout),
+ * gathered writes through serial_port_writev(), and baud rate
+ * validation and opening a pseudo-terminal at a non-standard rate.
+ *
+ * [LLM-ARCH]
+ */
+
+/* posix_openpt() and ptsname() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "tests/framework/test_framework.h"
+#include "connectors/serial/serial_port.h"
+#include "connectors/serial/serial_config.h"
+#include "connectors/serial/serial_baud.h"
+#include "lib/common/definitions.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+/* Pipes are not ttys: skip the termios timeout update */
+#define TEST_NO_TIMEOUT (-1)
+
+static void init_test_config(serial_config_t* config) {
+    serial_config_init_defaults(config);
+    strcpy(config->device_path, "/dev/ttyUSB0");
+}
+
+/* ============================================================================
+ * Configuration Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test coalescing defaults
+ */
+void test_config_coalesce_defaults(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+
+    TEST_ASSERT_EQUAL(SERIAL_DEFAULT_COALESCE_BYTES, config.coalesce_bytes,
+                      "Default byte limit should be set");
+    TEST_ASSERT_EQUAL(SERIAL_DEFAULT_COALESCE_US, config.coalesce_us,
+                      "Default window should be set");
+    TEST_ASSERT_SUCCESS(serial_config_validate(&config),
+                        "Defaults should validate");
+}
+
+/**
+ * @brief Test coalescing limit validation
+ */
+void test_config_coalesce_limits(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+    config.coalesce_bytes = 0;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_config_validate(&config),
+                      "Zero byte limit should be rejected");
+
+    config.coalesce_bytes = SERIAL_COALESCE_MAX_BYTES + 1;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_config_validate(&config),
+                      "Byte limit above max payload should be rejected");
+
+    config.coalesce_bytes = 1;
+    config.coalesce_us = -1;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_config_validate(&config),
+                      "Negative window should be rejected");
+
+    config.coalesce_us = 0;
+    TEST_ASSERT_SUCCESS(serial_config_validate(&config),
+                        "Disabled window should validate");
+}
+
+/**
+ * @brief Test read mode default and validation
+ */
+void test_config_read_mode(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+    TEST_ASSERT_EQUAL(SERIAL_READ_MODE_ADAPTIVE, config.read_mode,
+                      "Adaptive reads should be the default");
+
+    config.read_mode = SERIAL_READ_MODE_FIXED;
+    TEST_ASSERT_SUCCESS(serial_config_validate(&config),
+                        "Fixed mode should validate");
+
+    config.read_mode = SERIAL_READ_MODE_FRAME;
+    TEST_ASSERT_SUCCESS(serial_config_validate(&config),
+                        "Frame mode should validate");
+
+    config.read_mode = 7;
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_config_validate(&config),
+                      "Unknown read mode should be rejected");
+}
+
+/**
+ * @brief Test idle gap derived from baud rate and framing
+ */
+void test_idle_gap(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+    config.read_mode = SERIAL_READ_MODE_FIXED;
+
+    /* 8N1 at 9600: 4 chars * 10 bits / 9600 baud = 4167 us */
+    config.baud_rate = 9600;
+    TEST_ASSERT_EQUAL(4167, serial_config_idle_gap_us(&config),
+                      "8N1 idle gap should be four character times");
+
+    /* 7E2 at 9600: 4 chars * 11 bits */
+    config.data_bits = 7;
+    config.parity = SERIAL_PARITY_EVEN;
+    config.stop_bits = 2;
+    TEST_ASSERT_EQUAL(4584, serial_config_idle_gap_us(&config),
+                      "Parity and stop bits should lengthen the gap");
+
+    /* Fast lines are clamped to the minimum */
+    config.baud_rate = 4000000;
+    TEST_ASSERT_EQUAL(SERIAL_COALESCE_MIN_IDLE_US, serial_config_idle_gap_us(&config),
+                      "Idle gap should not drop below the minimum");
+}
+
+/**
+ * @brief Test character time derived from baud rate and framing
+ */
+void test_char_time(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+
+    /* 8N1 at 9600: 10 bits / 9600 baud = 1041.7 us, rounded up */
+    config.baud_rate = 9600;
+    TEST_ASSERT_EQUAL(1042, serial_config_char_time_us(&config),
+                      "8N1 character time should include start and stop bits");
+
+    /* 7E2 at 115200: 11 bits */
+    config.baud_rate = 115200;
+    config.data_bits = 7;
+    config.parity = SERIAL_PARITY_EVEN;
+    config.stop_bits = 2;
+    TEST_ASSERT_EQUAL(96, serial_config_char_time_us(&config),
+                      "Parity and stop bits should lengthen the character");
+
+    config.baud_rate = 0;
+    TEST_ASSERT_EQUAL(0, serial_config_char_time_us(&config),
+                      "Invalid baud rate should give zero");
+    TEST_ASSERT_EQUAL(0, serial_config_char_time_us(NULL),
+                      "NULL config should give zero");
+}
+
+/**
+ * @brief Test the adaptive idle gap tracks one character time
+ */
+void test_idle_gap_adaptive(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+    config.read_mode = SERIAL_READ_MODE_ADAPTIVE;
+
+    /* 8N1 at 9600: 1.5 chars * 10 bits / 9600 baud = 1562.5 us */
+    config.baud_rate = 9600;
+    TEST_ASSERT_EQUAL(1563, serial_config_idle_gap_us(&config),
+                      "Adaptive gap should be one and a half characters");
+
+    config.baud_rate = 230400;
+    TEST_ASSERT_EQUAL(66, serial_config_idle_gap_us(&config),
+                      "Adaptive gap should shrink with the baud rate");
+
+    config.baud_rate = 4000000;
+    TEST_ASSERT_EQUAL(SERIAL_ADAPTIVE_MIN_IDLE_US, serial_config_idle_gap_us(&config),
+                      "Adaptive gap should not drop below the minimum");
+}
+
+/**
+ * @brief Test frame mode gap, read size and window
+ */
+void test_frame_mode(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+    config.read_mode = SERIAL_READ_MODE_FRAME;
+    config.coalesce_bytes = 64;
+
+    /* 8N1 at 9600: 3.5 chars * 10 bits / 9600 baud = 3645.8 us */
+    config.baud_rate = 9600;
+    TEST_ASSERT_EQUAL(3646, serial_config_idle_gap_us(&config),
+                      "Frame gap should be three and a half characters");
+    TEST_ASSERT_EQUAL(64, serial_config_read_chunk(&config),
+                      "Frame mode should read one frame per burst");
+
+    /* 64 chars of 1042 us, then the gap */
+    TEST_ASSERT_EQUAL(64 * 1042 + 3646, serial_config_burst_window_us(&config),
+                      "Window should cover a full frame and its gap");
+
+    config.baud_rate = 38400;
+    TEST_ASSERT_EQUAL(SERIAL_FRAME_FIXED_GAP_US, serial_config_idle_gap_us(&config),
+                      "Fast lines should use the fixed Modbus gap");
+
+    config.read_mode = SERIAL_READ_MODE_ADAPTIVE;
+    TEST_ASSERT_EQUAL(config.coalesce_us, serial_config_burst_window_us(&config),
+                      "Other modes should keep the coalescing window");
+}
+
+/**
+ * @brief Test read size per burst
+ */
+void test_read_chunk(void) {
+    serial_config_t config;
+
+    init_test_config(&config);
+
+    /* Fixed mode reads one frame */
+    config.read_mode = SERIAL_READ_MODE_FIXED;
+    config.baud_rate = 230400;
+    TEST_ASSERT_EQUAL(SERIAL_DEFAULT_COALESCE_BYTES, serial_config_read_chunk(&config),
+                      "Fixed mode should read one frame per burst");
+
+    /* 8N1 at 230400 delivers 1152 bytes in 50 ms */
+    config.read_mode = SERIAL_READ_MODE_ADAPTIVE;
+    TEST_ASSERT_EQUAL(1152, serial_config_read_chunk(&config),
+                      "Fast lines should read more than one frame");
+
+    /* Slow line with small frames: clamped to the minimum chunk */
+    config.baud_rate = 9600;
+    config.coalesce_bytes = 64;
+    TEST_ASSERT_EQUAL(SERIAL_READ_CHUNK_SIZE, serial_config_read_chunk(&config),
+                      "Slow lines should still read a minimum chunk");
+
+    /* Never less than one frame */
+    config.coalesce_bytes = SERIAL_COALESCE_MAX_BYTES;
+    TEST_ASSERT_EQUAL(SERIAL_COALESCE_MAX_BYTES, serial_config_read_chunk(&config),
+                      "Read size should cover a full frame");
+
+    config.baud_rate = 4000000;
+    TEST_ASSERT_EQUAL(SERIAL_READ_CHUNK_MAX, serial_config_read_chunk(&config),
+                      "Read size should be capped");
+}
+
+/* ============================================================================
+ * serial_port_read_coalesced() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that queued reads are packed up to the byte limit
+ */
+void test_coalesced_byte_limit(void) {
+    int fds[2];
+    unsigned char data[300];
+    unsigned char out[300];
+    int result;
+    int i;
+
+    if (pipe(fds) != 0) {
+        TEST_SKIP("pipe failed");
+        return;
+    }
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (unsigned char)i;
+    }
+
+    /* Three separate writes, as separate serial reads would deliver them */
+    TEST_ASSERT_EQUAL(100, write(fds[1], data, 100), "Write should succeed");
+    TEST_ASSERT_EQUAL(100, write(fds[1], data + 100, 100), "Write should succeed");
+    TEST_ASSERT_EQUAL(100, write(fds[1], data + 200, 100), "Write should succeed");
+
+    result = serial_port_read_coalesced(fds[0], out, 250, TEST_NO_TIMEOUT,
+                                        100000, 50000);
+    TEST_ASSERT_EQUAL(250, result, "Burst should stop at the byte limit");
+    TEST_ASSERT(memcmp(out, data, 250) == 0, "Data should be in order");
+
+    result = serial_port_read_coalesced(fds[0], out, 250, TEST_NO_TIMEOUT,
+                                        100000, 1000);
+    TEST_ASSERT_EQUAL(50, result, "Remainder should flush when the line is idle");
+    TEST_ASSERT(memcmp(out, data + 250, 50) == 0, "Remainder should follow");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+typedef struct {
+    int fd;
+    int delay_us;
+    int count;
+} trickle_args_t;
+
+static void* trickle_writer(void* arg) {
+    trickle_args_t* args = (trickle_args_t*)arg;
+    unsigned char byte = 0x5A;
+    struct timespec delay;
+    int i;
+
+    delay.tv_sec = 0;
+    delay.tv_nsec = (long)args->delay_us * 1000L;
+
+    for (i = 0; i < args->count; i++) {
+        if (write(args->fd, &byte, 1) != 1) {
+            break;
+        }
+        nanosleep(&delay, NULL);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Test that a continuously busy line is cut at the window
+ */
+void test_coalesced_window(void) {
+    int fds[2];
+    unsigned char out[1020];
+    trickle_args_t args;
+    pthread_t thread;
+    int result;
+
+    if (pipe(fds) != 0) {
+        TEST_SKIP("pipe failed");
+        return;
+    }
+
+    /* One byte every ~1 ms for ~200 ms, idle gap 50 ms, window 20 ms */
+    args.fd = fds[1];
+    args.delay_us = 1000;
+    args.count = 200;
+    if (pthread_create(&thread, NULL, trickle_writer, &args) != 0) {
+        close(fds[0]);
+        close(fds[1]);
+        TEST_SKIP("pthread_create failed");
+        return;
+    }
+
+    result = serial_port_read_coalesced(fds[0], out, sizeof(out), TEST_NO_TIMEOUT,
+                                        20000, 50000);
+    TEST_ASSERT(result > 1, "Several bytes should be coalesced");
+    TEST_ASSERT(result < 150, "Burst should end at the window, not the stream");
+
+    pthread_join(thread, NULL);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test that a zero window degenerates to a single read
+ */
+void test_coalesced_disabled(void) {
+    int fds[2];
+    unsigned char out[64];
+    int result;
+
+    if (pipe(fds) != 0) {
+        TEST_SKIP("pipe failed");
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(10, write(fds[1], "0123456789", 10), "Write should succeed");
+
+    result = serial_port_read_coalesced(fds[0], out, sizeof(out), TEST_NO_TIMEOUT,
+                                        0, 0);
+    TEST_ASSERT_EQUAL(10, result, "Single read should return available data");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test NULL/invalid arguments
+ */
+void test_coalesced_invalid_args(void) {
+    unsigned char out[4];
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_port_read_coalesced(-1, out, sizeof(out), 0, 1000, 100),
+                      "Invalid fd should be rejected");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_port_read_coalesced(0, NULL, 4, 0, 1000, 100),
+                      "NULL buffer should be rejected");
+}
+
+/* ============================================================================
+ * serial_port_read_adaptive() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that queued data is collected and flushed on idle
+ */
+void test_adaptive_idle_flush(void) {
+    int fds[2];
+    unsigned char data[300];
+    unsigned char out[300];
+    int result;
+    int i;
+
+    if (pipe(fds) != 0) {
+        TEST_SKIP("pipe failed");
+        return;
+    }
+
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (unsigned char)(i * 7);
+    }
+
+    TEST_ASSERT_EQUAL(200, write(fds[1], data, 200), "Write should succeed");
+    TEST_ASSERT_EQUAL(100, write(fds[1], data + 200, 100), "Write should succeed");
+
+    result = serial_port_read_adaptive(fds[0], out, sizeof(out), 1000,
+                                       100000, 1000);
+    TEST_ASSERT_EQUAL(300, result, "Queued writes should form one burst");
+    TEST_ASSERT(memcmp(out, data, sizeof(data)) == 0, "Data should be in order");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test that a quiet line times out without blocking in read()
+ */
+void test_adaptive_timeout(void) {
+    int fds[2];
+    unsigned char out[16];
+    struct timespec start;
+    struct timespec end;
+    long waited_ms;
+
+    if (pipe(fds) != 0) {
+        TEST_SKIP("pipe failed");
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    TEST_ASSERT_EQUAL(0, serial_port_read_adaptive(fds[0], out, sizeof(out), 30,
+                                                   1000, 100),
+                      "Empty line should time out");
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    waited_ms = (end.tv_sec - start.tv_sec) * 1000L +
+                (end.tv_nsec - start.tv_nsec) / 1000000L;
+    TEST_ASSERT(waited_ms >= 25, "Timeout should be honoured");
+
+    TEST_ASSERT_EQUAL(0, serial_port_read_adaptive(fds[0], out, sizeof(out), 0,
+                                                   1000, 100),
+                      "Zero timeout should poll");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_port_read_adaptive(-1, out, sizeof(out), 0, 1000, 100),
+                      "Invalid fd should be rejected");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_port_read_adaptive(fds[0], NULL, 4, 0, 1000, 100),
+                      "NULL buffer should be rejected");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * serial_port_writev() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test gathered regions arrive back to back
+ */
+void test_writev_gathers(void) {
+    struct iovec iov[3];
+    char out[16];
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        TEST_SKIP("pipe failed");
+        return;
+    }
+
+    iov[0].iov_base = "wrap";
+    iov[0].iov_len = 4;
+    iov[1].iov_base = "";
+    iov[1].iov_len = 0;
+    iov[2].iov_base = "around";
+    iov[2].iov_len = 6;
+
+    TEST_ASSERT_EQUAL(10, serial_port_writev(fds[1], iov, 3),
+                      "All regions should be written");
+    memset(out, 0, sizeof(out));
+    TEST_ASSERT_EQUAL(10, (int)read(fds[0], out, sizeof(out)),
+                      "Reader should get every byte");
+    TEST_ASSERT(memcmp(out, "wraparound", 10) == 0,
+                "Regions should arrive in order");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test NULL/invalid writev arguments
+ */
+void test_writev_invalid_args(void) {
+    struct iovec iov[SERIAL_PORT_WRITEV_MAX_IOV + 1];
+
+    memset(iov, 0, sizeof(iov));
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_port_writev(-1, iov, 1),
+                      "Invalid fd should be rejected");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_port_writev(1, NULL, 1),
+                      "NULL regions should be rejected");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_port_writev(1, iov, SERIAL_PORT_WRITEV_MAX_IOV + 1),
+                      "Too many regions should be rejected");
+}
+
+/* ============================================================================
+ * Baud Rate Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test which rates are accepted
+ */
+void test_validate_baud(void) {
+    TEST_ASSERT_SUCCESS(serial_validate_baud(9600), "9600 accepted");
+    TEST_ASSERT_SUCCESS(serial_validate_baud(230400), "230400 accepted");
+    TEST_ASSERT_FAILURE(serial_validate_baud(0), "Zero refused");
+    TEST_ASSERT_FAILURE(serial_validate_baud(SERIAL_BAUD_MIN - 1),
+                        "Below the range refused");
+    TEST_ASSERT_FAILURE(serial_validate_baud(SERIAL_BAUD_MAX + 1),
+                        "Above the range refused");
+
+    if (!SERIAL_BAUD_CUSTOM) {
+        TEST_SKIP("no arbitrary rates on this platform");
+        return;
+    }
+    TEST_ASSERT_SUCCESS(serial_validate_baud(250000), "DMX rate accepted");
+    TEST_ASSERT_SUCCESS(serial_validate_baud(921600), "921600 accepted");
+    TEST_ASSERT_SUCCESS(serial_validate_baud(3000000), "3 Mbaud accepted");
+    TEST_ASSERT_SUCCESS(serial_validate_baud(SERIAL_BAUD_MAX), "Maximum accepted");
+}
+
+/**
+ * @brief Test opening a pseudo-terminal at rates without a constant
+ */
+void test_open_custom_baud(void) {
+    serial_config_t config;
+    const char* name;
+    int master;
+    int fd = -1;
+
+    if (!SERIAL_BAUD_CUSTOM) {
+        TEST_SKIP("no arbitrary rates on this platform");
+        return;
+    }
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0 ||
+        (name = ptsname(master)) == NULL) {
+        if (master >= 0) {
+            close(master);
+        }
+        TEST_SKIP("no pseudo-terminals");
+        return;
+    }
+
+    init_test_config(&config);
+    strncpy(config.device_path, name, sizeof(config.device_path) - 1);
+    config.baud_rate = 250000;
+    TEST_ASSERT_SUCCESS(serial_port_open(&config, &fd), "Opened at 250000");
+    if (fd >= 0) {
+        TEST_ASSERT_SUCCESS(serial_baud_set_custom(fd, 3000000),
+                            "Switched to 3 Mbaud");
+        serial_port_close(fd);
+    }
+
+    fd = -1;
+    config.baud_rate = 921600;
+    TEST_ASSERT_SUCCESS(serial_port_open(&config, &fd), "Opened at 921600");
+    if (fd >= 0) {
+        serial_port_close(fd);
+    }
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, serial_baud_set_custom(-1, 250000),
+                      "Bad descriptor refused");
+    close(master);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Serial Port Unit Tests ===\n\n");
+
+    /* Configuration tests */
+    run_test("test_config_coalesce_defaults", test_config_coalesce_defaults);
+    run_test("test_config_coalesce_limits", test_config_coalesce_limits);
+    run_test("test_config_read_mode", test_config_read_mode);
+    run_test("test_idle_gap", test_idle_gap);
+    run_test("test_char_time", test_char_time);
+    run_test("test_idle_gap_adaptive", test_idle_gap_adaptive);
+    run_test("test_read_chunk", test_read_chunk);
+    run_test("test_frame_mode", test_frame_mode);
+
+    /* serial_port_read_coalesced() tests */
+    run_test("test_coalesced_byte_limit", test_coalesced_byte_limit);
+    run_test("test_coalesced_window", test_coalesced_window);
+    run_test("test_coalesced_disabled", test_coalesced_disabled);
+    run_test("test_coalesced_invalid_args", test_coalesced_invalid_args);
+
+    /* serial_port_read_adaptive() tests */
+    run_test("test_adaptive_idle_flush", test_adaptive_idle_flush);
+    run_test("test_adaptive_timeout", test_adaptive_timeout);
+
+    /* serial_port_writev() tests */
+    run_test("test_writev_gathers", test_writev_gathers);
+    run_test("test_writev_invalid_args", test_writev_invalid_args);
+
+    /* Baud rate tests */
+    run_test("test_validate_baud", test_validate_baud);
+    run_test("test_open_custom_baud", test_open_custom_baud);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -206,6 +206,69 @@ void test_decapsulate_basic(void) {
     serial_protocol_free_payload(&packet);
 }
 
+/**
+ * @brief Test decapsulation split across two output regions
+ *
+ * Verifies that serial_protocol_decapsulate_iov() fills the regions in
+ * order, as when decoding into a wrapped ring reservation.
+ */
+void test_decapsulate_iov_split(void) {
+    unsigned char test_data[TEST_DATA_SIZE];
+    unsigned char first[10];
+    unsigned char second[TEST_DATA_SIZE];
+    struct iovec iov[2];
+    xoe_packet_t packet;
+    uint32_t actual_len;
+    uint16_t sequence, flags;
+    int i;
+
+    for (i = 0; i < TEST_DATA_SIZE; i++) {
+        test_data[i] = (unsigned char)(i * 5 + 1);
+    }
+    serial_protocol_encapsulate(test_data, TEST_DATA_SIZE, 7, 0, &packet);
+
+    iov[0].iov_base = first;
+    iov[0].iov_len = sizeof(first);
+    iov[1].iov_base = second;
+    iov[1].iov_len = TEST_DATA_SIZE - sizeof(first) - 1;
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      serial_protocol_decapsulate_iov(&packet, iov, 2, &actual_len,
+                                                      &sequence, &flags),
+                      "Regions one byte short should be rejected");
+
+    iov[1].iov_len = sizeof(second);
+    TEST_ASSERT_SUCCESS(serial_protocol_decapsulate_iov(&packet, iov, 2, &actual_len,
+                                                        &sequence, &flags),
+                        "Split decapsulation should succeed");
+    TEST_ASSERT_EQUAL(TEST_DATA_SIZE, actual_len, "Length should match original");
+    TEST_ASSERT(memcmp(first, test_data, sizeof(first)) == 0 &&
+                memcmp(second, test_data + sizeof(first),
+                       TEST_DATA_SIZE - sizeof(first)) == 0,
+                "Data should continue across the regions");
+
+    serial_protocol_free_payload(&packet);
+}
+
+/**
+ * @brief Test control-only frames need no output regions
+ */
+void test_decapsulate_iov_control_frame(void) {
+    unsigned char none = 0;
+    xoe_packet_t packet;
+    uint32_t actual_len = 1;
+    uint16_t sequence, flags = 0;
+
+    serial_protocol_encapsulate(&none, 0, 3, SERIAL_FLAG_XOFF, &packet);
+
+    TEST_ASSERT_SUCCESS(serial_protocol_decapsulate_iov(&packet, NULL, 0, &actual_len,
+                                                        &sequence, &flags),
+                        "Control frame should decapsulate without regions");
+    TEST_ASSERT_EQUAL(0, actual_len, "Control frame should carry no data");
+    TEST_ASSERT_EQUAL(SERIAL_FLAG_XOFF, flags, "Flags should be preserved");
+
+    serial_protocol_free_payload(&packet);
+}
+
 /**
  * @brief Test decapsulation with NULL packet
  *
@@ -582,6 +645,8 @@ int main(void) {
     run_test("test_decapsulate_buffer_too_small", test_decapsulate_buffer_too_small);
     run_test("test_decapsulate_invalid_protocol", test_decapsulate_invalid_protocol);
     run_test("test_decapsulate_corrupted_checksum", test_decapsulate_corrupted_checksum);
+    run_test("test_decapsulate_iov_split", test_decapsulate_iov_split);
+    run_test("test_decapsulate_iov_control_frame", test_decapsulate_iov_control_frame);
 
     /* Round-trip tests */
     run_test("test_roundtrip_basic", test_roundtrip_basic);
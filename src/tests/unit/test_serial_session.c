@@ -0,0 +1,314 @@
+/**
+ * @file test_serial_session.c
+ * @brief Unit tests for resumable serial sessions
+ *
+ * Tests the retransmit window (store, cumulative ACK, window full),
+ * duplicate and gap detection on receive, sequence wraparound, the ACK
+ * header and RESUME frame round trip, and the server's park table.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/serial/serial_session.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ============================================================================
+ * Window Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test storing frames until the window is full, and ACKs freeing it
+ */
+void test_window_store_and_ack(void) {
+    serial_session_t* session;
+    const serial_session_frame_t* frame;
+    unsigned char byte;
+    uint16_t seq;
+    int i;
+
+    session = serial_session_create(1);
+    TEST_ASSERT_NOT_NULL(session, "Allocated");
+    if (session == NULL) {
+        return;
+    }
+
+    for (i = 0; i < SERIAL_SESSION_WINDOW; i++) {
+        byte = (unsigned char)i;
+        TEST_ASSERT_SUCCESS(serial_session_store(session, &byte, 1, 0, &seq),
+                            "Stored");
+        TEST_ASSERT_EQUAL(i, seq, "Sequences in order");
+    }
+    TEST_ASSERT(serial_session_window_full(session), "Window full");
+    TEST_ASSERT_EQUAL(E_WOULD_BLOCK,
+                      serial_session_store(session, &byte, 1, 0, &seq),
+                      "Store refused while full");
+
+    TEST_ASSERT_EQUAL(10, serial_session_ack(session, 10), "Ten released");
+    TEST_ASSERT_EQUAL(0, serial_session_ack(session, 5), "Old ACK ignored");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      serial_session_ack(session, SERIAL_SESSION_WINDOW + 1),
+                      "ACK of unsent frames refused");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_WINDOW - 10,
+                      serial_session_unacked(session), "Rest unacknowledged");
+
+    /* Retransmission order: oldest unacknowledged first */
+    frame = serial_session_frame(session, 0);
+    TEST_ASSERT_NOT_NULL(frame, "First pending frame");
+    if (frame != NULL) {
+        TEST_ASSERT_EQUAL(10, frame->sequence, "Oldest first");
+        TEST_ASSERT_EQUAL(10, frame->data[0], "Its data");
+    }
+    TEST_ASSERT(serial_session_frame(session, SERIAL_SESSION_WINDOW - 10) == NULL,
+                "Past the pending frames");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      serial_session_store(session, &byte, 0, 0, &seq),
+                      "Empty data frame refused");
+
+    serial_session_destroy(session);
+}
+
+/**
+ * @brief Test receive-side duplicate and gap detection, and ACK pacing
+ */
+void test_accept_duplicates_and_gaps(void) {
+    serial_session_t* session;
+    int i;
+
+    session = serial_session_create(2);
+    TEST_ASSERT_NOT_NULL(session, "Allocated");
+    if (session == NULL) {
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_NEW, serial_session_accept(session, 0),
+                      "First frame");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_NEW, serial_session_accept(session, 1),
+                      "Second frame");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_DUPLICATE, serial_session_accept(session, 0),
+                      "Retransmitted frame dropped");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR, serial_session_accept(session, 3),
+                      "Gap detected");
+    TEST_ASSERT_EQUAL(1, (int)session->duplicates, "Duplicate counted");
+
+    TEST_ASSERT_EQUAL(2, serial_session_take_ack(session), "ACK is next expected");
+    TEST_ASSERT(!serial_session_ack_due(session), "Countdown reset");
+    for (i = 0; i < SERIAL_SESSION_ACK_EVERY; i++) {
+        serial_session_accept(session, (uint16_t)(2 + i));
+    }
+    TEST_ASSERT(serial_session_ack_due(session), "Pure ACK due");
+
+    serial_session_destroy(session);
+}
+
+/**
+ * @brief Test both directions across the 16-bit sequence wrap
+ */
+void test_sequence_wraparound(void) {
+    serial_session_t* session;
+    unsigned char byte = 0x55;
+    uint16_t seq;
+    int i;
+
+    session = serial_session_create(3);
+    TEST_ASSERT_NOT_NULL(session, "Allocated");
+    if (session == NULL) {
+        return;
+    }
+
+    session->tx_next = 0xFFF0;
+    session->tx_acked = 0xFFF0;
+    session->rx_next = 0xFFFE;
+
+    for (i = 0; i < 32; i++) {
+        TEST_ASSERT_SUCCESS(serial_session_store(session, &byte, 1, 0, &seq),
+                            "Stored across the wrap");
+    }
+    TEST_ASSERT_EQUAL(0x0010, session->tx_next, "Wrapped");
+    TEST_ASSERT_EQUAL(32, serial_session_unacked(session), "All pending");
+    TEST_ASSERT_EQUAL(20, serial_session_ack(session, 0x0004),
+                      "ACK past the wrap");
+    TEST_ASSERT_EQUAL(0, serial_session_ack(session, 0xFFF8),
+                      "Old ACK before the wrap ignored");
+
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_NEW, serial_session_accept(session, 0xFFFE),
+                      "Before the wrap");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_NEW, serial_session_accept(session, 0xFFFF),
+                      "Last sequence");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_NEW, serial_session_accept(session, 0x0000),
+                      "After the wrap");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_DUPLICATE,
+                      serial_session_accept(session, 0xFFFF),
+                      "Duplicate across the wrap");
+
+    serial_session_destroy(session);
+}
+
+/* ============================================================================
+ * Frame Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the ACK header round trip through peek and decapsulate
+ */
+void test_ack_header_roundtrip(void) {
+    const unsigned char* data;
+    unsigned char out[16];
+    xoe_packet_t packet;
+    uint32_t data_len;
+    uint32_t actual_len;
+    uint16_t flags;
+    uint16_t seq;
+    uint16_t ack;
+
+    TEST_ASSERT_SUCCESS(serial_protocol_encapsulate_ack("hello", 5, 7, 0x1234,
+                                                        SERIAL_FLAG_ACK |
+                                                        SERIAL_FLAG_XOFF,
+                                                        &packet),
+                        "Encapsulated");
+    TEST_ASSERT_EQUAL(SERIAL_ACK_HEADER_SIZE + 5, (int)packet.payload->len,
+                      "Header carries the ACK");
+
+    TEST_ASSERT_SUCCESS(serial_protocol_peek(&packet, &flags, &seq, &ack,
+                                             &data, &data_len), "Peeked");
+    TEST_ASSERT_EQUAL(7, seq, "Sequence");
+    TEST_ASSERT_EQUAL(0x1234, ack, "ACK");
+    TEST_ASSERT(flags & SERIAL_FLAG_XOFF, "Flags");
+    TEST_ASSERT(data_len == 5 && memcmp(data, "hello", 5) == 0, "Data");
+
+    TEST_ASSERT_SUCCESS(serial_protocol_decapsulate(&packet, out, sizeof(out),
+                                                    &actual_len, &seq, &flags),
+                        "Decapsulated");
+    TEST_ASSERT(actual_len == 5 && memcmp(out, "hello", 5) == 0,
+                "Decapsulation skips the ACK");
+    serial_protocol_free_payload(&packet);
+
+    /* Control frame without data */
+    TEST_ASSERT_SUCCESS(serial_protocol_encapsulate_ack(NULL, 0, 9, 3,
+                                                        SERIAL_FLAG_ACK, &packet),
+                        "Pure ACK encapsulated");
+    TEST_ASSERT_SUCCESS(serial_protocol_peek(&packet, &flags, &seq, &ack,
+                                             &data, &data_len), "Peeked");
+    TEST_ASSERT(ack == 3 && data_len == 0, "Pure ACK");
+    serial_protocol_free_payload(&packet);
+}
+
+/**
+ * @brief Test a RESUME frame carries the ID, status and both positions
+ */
+void test_resume_frame(void) {
+    serial_session_t* session;
+    const unsigned char* data;
+    xoe_packet_t packet;
+    uint32_t data_len;
+    uint64_t id;
+    uint16_t flags;
+    uint16_t seq;
+    uint16_t ack;
+    int status;
+
+    session = serial_session_create(0x0123456789ABCDEFULL);
+    TEST_ASSERT_NOT_NULL(session, "Allocated");
+    if (session == NULL) {
+        return;
+    }
+    session->tx_next = 40;
+    session->tx_acked = 38;
+    session->rx_next = 17;
+
+    TEST_ASSERT_SUCCESS(serial_session_resume_frame(session,
+                                                    SERIAL_SESSION_RESUMED,
+                                                    SERIAL_FLAG_XOFF, &packet),
+                        "Built");
+    TEST_ASSERT_SUCCESS(serial_protocol_peek(&packet, &flags, &seq, &ack,
+                                             &data, &data_len), "Peeked");
+    TEST_ASSERT((flags & SERIAL_FLAG_RESUME) && (flags & SERIAL_FLAG_ACK) &&
+                (flags & SERIAL_FLAG_XOFF), "Flags");
+    TEST_ASSERT_EQUAL(40, seq, "Next data sequence");
+    TEST_ASSERT_EQUAL(17, ack, "ACK of what was received");
+    TEST_ASSERT_SUCCESS(serial_session_resume_parse(data, data_len, &id,
+                                                    &status), "Parsed");
+    TEST_ASSERT(id == 0x0123456789ABCDEFULL, "Session ID");
+    TEST_ASSERT_EQUAL(SERIAL_SESSION_RESUMED, status, "Status");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      serial_session_resume_parse(data, data_len - 1, &id,
+                                                  &status),
+                      "Truncated payload refused");
+    serial_protocol_free_payload(&packet);
+
+    serial_session_destroy(session);
+}
+
+/* ============================================================================
+ * Park Table Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test parking, resuming and flushing sessions
+ */
+void test_park_and_unpark(void) {
+    serial_session_t* session;
+    unsigned char byte = 1;
+    uint16_t seq;
+    int i;
+
+    session = serial_session_create(42);
+    TEST_ASSERT_NOT_NULL(session, "Allocated");
+    if (session == NULL) {
+        return;
+    }
+    serial_session_store(session, &byte, 1, 0, &seq);
+    serial_session_park(session);
+
+    TEST_ASSERT(serial_session_unpark(7) == NULL, "Unknown ID");
+    session = serial_session_unpark(42);
+    TEST_ASSERT_NOT_NULL(session, "Parked session back");
+    if (session != NULL) {
+        TEST_ASSERT_EQUAL(1, serial_session_unacked(session), "State kept");
+    }
+    TEST_ASSERT(serial_session_unpark(42) == NULL, "Taken only once");
+    serial_session_destroy(session);
+
+    /* A full table gives way to new sessions */
+    for (i = 0; i < SERIAL_SESSION_PARK_MAX + 1; i++) {
+        session = serial_session_create((uint64_t)(100 + i));
+        if (session != NULL) {
+            serial_session_park(session);
+        }
+    }
+    session = serial_session_unpark((uint64_t)(100 + SERIAL_SESSION_PARK_MAX));
+    TEST_ASSERT_NOT_NULL(session, "Newest kept");
+    serial_session_destroy(session);
+
+    serial_session_park_flush();
+    TEST_ASSERT(serial_session_unpark(101) == NULL, "Flushed");
+
+    TEST_ASSERT(serial_session_new_id() != 0, "IDs are non-zero");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Serial Session Unit Tests ===\n\n");
+
+    /* Window tests */
+    run_test("test_window_store_and_ack", test_window_store_and_ack);
+    run_test("test_accept_duplicates_and_gaps", test_accept_duplicates_and_gaps);
+    run_test("test_sequence_wraparound", test_sequence_wraparound);
+
+    /* Frame tests */
+    run_test("test_ack_header_roundtrip", test_ack_header_roundtrip);
+    run_test("test_resume_frame", test_resume_frame);
+
+    /* Park table tests */
+    run_test("test_park_and_unpark", test_park_and_unpark);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,338 @@
+/**
+ * @file test_server_pool.c
+ * @brief Unit tests for picking among and failing over between servers
+ *
+ * Parses -c lists and policies, then runs pools against loopback
+ * listeners: a dead entry is passed over, each policy picks as
+ * documented, and a failover takes the standby connection the checker
+ * opened instead of connecting.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/server_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/* Longest wait for the checker to open a standby (ms) */
+#define TEST_STANDBY_MS 3000
+
+/**
+ * @brief Open a listener on 127.0.0.1 with an ephemeral port
+ *
+ * @return Listening socket (port in @p port), or -1
+ */
+static int open_listener(int* port) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 8) != 0 ||
+        getsockname(fd, (struct sockaddr*)&addr, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/**
+ * @brief Port nothing listens on (bound, so it stays free, but refusing)
+ */
+static int closed_port(int* holder) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    *holder = socket(AF_INET, SOCK_STREAM, 0);
+    if (*holder < 0 ||
+        bind(*holder, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        getsockname(*holder, (struct sockaddr*)&addr, &len) != 0) {
+        return -1;
+    }
+    return ntohs(addr.sin_port);
+}
+
+/**
+ * @brief Whether a listener has a connection waiting within @p wait_ms
+ */
+static int pending(int listener, int wait_ms) {
+    struct pollfd pfd;
+
+    pfd.fd = listener;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, wait_ms) == 1;
+}
+
+/**
+ * @brief Accept and close every waiting connection
+ */
+static void drain_listener(int listener) {
+    while (pending(listener, 0)) {
+        close(accept(listener, NULL, NULL));
+    }
+}
+
+static void add_server(server_list_t* list, int port) {
+    snprintf(list->hosts[list->count], NET_RESOLVE_HOST_MAX, "127.0.0.1");
+    list->ports[list->count] = port;
+    list->count++;
+}
+
+/* ============================================================================
+ * Parsing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test -c lists and policy names
+ */
+void test_list_parse(void) {
+    server_list_t list;
+    server_policy_t policy;
+    char long_list[512];
+    int i;
+
+    memset(&list, 0, sizeof(list));
+    TEST_ASSERT_SUCCESS(server_list_parse("10.0.0.1:12345", &list),
+                        "Single server");
+    TEST_ASSERT_EQUAL(1, list.count, "One entry");
+    TEST_ASSERT_STR_EQUAL("10.0.0.1", list.hosts[0], "Host");
+    TEST_ASSERT_EQUAL(12345, list.ports[0], "Port");
+
+    TEST_ASSERT_SUCCESS(server_list_parse("a:1,node-b.local:2,c:65535", &list),
+                        "Three servers");
+    TEST_ASSERT_EQUAL(3, list.count, "Three entries");
+    TEST_ASSERT_STR_EQUAL("node-b.local", list.hosts[1], "Second host");
+    TEST_ASSERT_EQUAL(65535, list.ports[2], "Third port");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, server_list_parse("a", &list),
+                      "Missing port");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, server_list_parse("a:1,", &list),
+                      "Empty entry");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, server_list_parse("a:0", &list),
+                      "Port 0");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, server_list_parse("a:1x", &list),
+                      "Trailing junk");
+
+    long_list[0] = '\0';
+    for (i = 0; i <= SERVER_POOL_MAX; i++) {
+        strcat(long_list, (i == 0) ? "h:1" : ",h:1");
+    }
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, server_list_parse(long_list, &list),
+                      "More than SERVER_POOL_MAX servers");
+
+    TEST_ASSERT_SUCCESS(server_policy_parse("rtt", &policy), "rtt");
+    TEST_ASSERT_EQUAL(SERVER_POLICY_RTT, policy, "rtt parsed");
+    TEST_ASSERT_SUCCESS(server_policy_parse("hash", &policy), "hash");
+    TEST_ASSERT_STR_EQUAL("hash", server_policy_name(policy), "Name");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      server_policy_parse("random", &policy), "Unknown");
+}
+
+/* ============================================================================
+ * Policy Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test primary skips a dead server, and hash is stable
+ */
+void test_policies(void) {
+    server_list_t list;
+    server_list_t reversed;
+    server_pool_t* pool;
+    int listeners[2];
+    int ports[2];
+    int holder = -1;
+    int dead;
+    int picked;
+    int hits[2] = { 0, 0 };
+    uint32_t key;
+
+    listeners[0] = open_listener(&ports[0]);
+    listeners[1] = open_listener(&ports[1]);
+    dead = closed_port(&holder);
+    if (listeners[0] < 0 || listeners[1] < 0 || dead < 0) {
+        TEST_SKIP("loopback listeners unavailable");
+        goto done;
+    }
+
+    memset(&list, 0, sizeof(list));
+    add_server(&list, dead);
+    add_server(&list, ports[0]);
+    add_server(&list, ports[1]);
+
+    pool = server_pool_create(&list, NULL, 0);
+    TEST_ASSERT_NOT_NULL(pool, "Pool created");
+    if (pool != NULL) {
+        TEST_ASSERT_EQUAL(1, server_pool_pick(pool),
+                          "Primary: first server that answered");
+        server_pool_destroy(pool);
+    }
+
+    list.policy = SERVER_POLICY_RTT;
+    pool = server_pool_create(&list, NULL, 0);
+    if (pool != NULL) {
+        picked = server_pool_pick(pool);
+        TEST_ASSERT(picked == 1 || picked == 2, "RTT: a live server");
+        server_pool_destroy(pool);
+    }
+
+    /* Hash: the same key picks the same server whatever the list order */
+    list.policy = SERVER_POLICY_HASH;
+    memset(&reversed, 0, sizeof(reversed));
+    reversed.policy = SERVER_POLICY_HASH;
+    add_server(&reversed, ports[1]);
+    add_server(&reversed, ports[0]);
+    add_server(&reversed, dead);
+    for (key = 1; key <= 40; key++) {
+        server_pool_t* a = server_pool_create(&list, NULL, key);
+        server_pool_t* b = server_pool_create(&reversed, NULL, key);
+        int pa = (a != NULL) ? server_pool_pick(a) : -1;
+        int pb = (b != NULL) ? server_pool_pick(b) : -1;
+
+        TEST_ASSERT(pa > 0 && pb >= 0 &&
+                    list.ports[pa] == reversed.ports[pb],
+                    "Same server for the same key");
+        if (pa > 0) {
+            hits[pa - 1]++;
+        }
+        server_pool_destroy(a);
+        server_pool_destroy(b);
+        drain_listener(listeners[0]);
+        drain_listener(listeners[1]);
+    }
+    TEST_ASSERT(hits[0] > 0 && hits[1] > 0, "Keys spread over both servers");
+
+done:
+    if (holder >= 0) {
+        close(holder);
+    }
+    if (listeners[0] >= 0) {
+        close(listeners[0]);
+    }
+    if (listeners[1] >= 0) {
+        close(listeners[1]);
+    }
+}
+
+/**
+ * @brief Test nothing healthy, and a failover onto the standby
+ */
+void test_failover(void) {
+    server_list_t list;
+    server_pool_t* pool = NULL;
+    int listeners[2];
+    int ports[2];
+    int holder = -1;
+    int dead;
+    int index = -1;
+    int sock = -1;
+    int standby_peer = -1;
+    int waited;
+
+    listeners[0] = open_listener(&ports[0]);
+    listeners[1] = open_listener(&ports[1]);
+    dead = closed_port(&holder);
+    if (listeners[0] < 0 || listeners[1] < 0 || dead < 0) {
+        TEST_SKIP("loopback listeners unavailable");
+        goto done;
+    }
+
+    memset(&list, 0, sizeof(list));
+    add_server(&list, dead);
+    pool = server_pool_create(&list, NULL, 0);
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, server_pool_pick(pool), "Nothing healthy");
+    TEST_ASSERT(server_pool_connect(pool, &sock, NULL) != 0, "Nothing to connect to");
+    server_pool_destroy(pool);
+
+    add_server(&list, ports[0]);
+    add_server(&list, ports[1]);
+    pool = server_pool_create(&list, NULL, 0);
+    if (pool == NULL) {
+        TEST_ASSERT_NOT_NULL(pool, "Pool created");
+        goto done;
+    }
+    drain_listener(listeners[0]);
+    drain_listener(listeners[1]);
+
+    TEST_ASSERT_SUCCESS(server_pool_connect(pool, &sock, &index), "Connected");
+    TEST_ASSERT_EQUAL(1, index, "To the first live server");
+    TEST_ASSERT(pending(listeners[0], 1000), "It accepted the connection");
+    drain_listener(listeners[0]);
+
+    /* The checker opens a standby to the other live server */
+    TEST_ASSERT_SUCCESS(server_pool_standby(pool), "Checker started");
+    for (waited = 0; waited < TEST_STANDBY_MS && !pending(listeners[1], 10);
+         waited += 10) {
+    }
+    TEST_ASSERT(pending(listeners[1], 0), "Standby opened");
+    /* Keep the server end open: a closed standby is rightly dropped */
+    standby_peer = accept(listeners[1], NULL, NULL);
+    usleep(100000);
+
+    /* The connection is lost: the next connect is the standby, at once */
+    close(sock);
+    sock = -1;
+    TEST_ASSERT_SUCCESS(server_pool_connect(pool, &sock, &index),
+                        "Failed over");
+    TEST_ASSERT_EQUAL(2, index, "To the other live server");
+    TEST_ASSERT(!pending(listeners[1], 0), "Through the standby, no new connect");
+    TEST_ASSERT_EQUAL(1, server_pool_failovers(pool), "Failover counted");
+
+done:
+    if (sock >= 0) {
+        close(sock);
+    }
+    if (standby_peer >= 0) {
+        close(standby_peer);
+    }
+    server_pool_destroy(pool);
+    if (holder >= 0) {
+        close(holder);
+    }
+    if (listeners[0] >= 0) {
+        close(listeners[0]);
+    }
+    if (listeners[1] >= 0) {
+        close(listeners[1]);
+    }
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Server Pool Unit Tests ===\n\n");
+
+    /* Parsing tests */
+    run_test("test_list_parse", test_list_parse);
+
+    /* Policy tests */
+    run_test("test_policies", test_policies);
+    run_test("test_failover", test_failover);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
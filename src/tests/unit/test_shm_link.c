@@ -0,0 +1,409 @@
+/**
+ * @file test_shm_link.c
+ * @brief Unit tests for same-host shared-memory links
+ *
+ * Tests connect address parsing, a packet round trip through the wire
+ * layer in both directions, a stream several rings long (the writer
+ * waits for room), doorbell wakeups and end of stream on a non-blocking
+ * descriptor, refusal of memory the client could still shrink, and which
+ * files at the listening path are replaced.
+ *
+ * [LLM-ARCH]
+ */
+
+/* memfd_create() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/shm_link.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/protocol/protocol.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/* Bytes streamed by test_stream_wraps_ring() */
+#define STREAM_BYTES (3 * SHM_LINK_RING_SIZE + 12345)
+
+static char g_path[64];
+
+/**
+ * @brief Open a listener and one connected link pair on it
+ *
+ * @return 0, or E_NOT_SUPPORTED where links are unavailable
+ */
+static int open_pair(int* listen_fd, int* client_fd, int* server_fd) {
+    int result;
+
+    snprintf(g_path, sizeof(g_path), "/tmp/xoe-test-shm-%d.sock",
+             (int)getpid());
+    *listen_fd = shm_link_listen(g_path);
+    if (*listen_fd < 0) {
+        return *listen_fd;
+    }
+
+    /* The memory waits in the socket until accepted */
+    result = shm_link_connect(g_path, client_fd);
+    if (result != 0) {
+        shm_link_close_listener(*listen_fd, g_path);
+        return result;
+    }
+    result = shm_link_accept(*listen_fd, server_fd);
+    if (result != 0) {
+        shm_link_close(*client_fd);
+        shm_link_close_listener(*listen_fd, g_path);
+    }
+    return result;
+}
+
+/* ============================================================================
+ * Address Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that only shm: and unix: addresses name links
+ */
+void test_address_parsing(void) {
+    TEST_ASSERT(strcmp(shm_link_address("shm:/run/xoe.sock"),
+                       "/run/xoe.sock") == 0, "shm: prefix stripped");
+    TEST_ASSERT(strcmp(shm_link_address("unix:rel.sock"), "rel.sock") == 0,
+                "unix: prefix stripped");
+    TEST_ASSERT_NULL(shm_link_address("127.0.0.1"), "IP address is not a link");
+    TEST_ASSERT_NULL(shm_link_address("shmhost"), "Host name is not a link");
+    TEST_ASSERT_NULL(shm_link_address(NULL), "NULL is not a link");
+    TEST_ASSERT_NULL(shm_link_find(-1), "No link behind -1");
+}
+
+/* ============================================================================
+ * Link Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a packet each way through xoe_wire_send()/xoe_wire_recv()
+ */
+void test_wire_roundtrip(void) {
+    xoe_packet_t packet;
+    xoe_packet_t received;
+    int listen_fd;
+    int client_fd;
+    int server_fd;
+    int result;
+    uint32_t i;
+
+    result = open_pair(&listen_fd, &client_fd, &server_fd);
+    if (result == E_NOT_SUPPORTED) {
+        TEST_SKIP("shared-memory links unavailable");
+        return;
+    }
+    TEST_ASSERT_SUCCESS(result, "Link established");
+    if (result != 0) {
+        return;
+    }
+    TEST_ASSERT_NOT_NULL(shm_link_find(client_fd), "Client side registered");
+    TEST_ASSERT_NOT_NULL(shm_link_find(server_fd), "Server side registered");
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_RAW;
+    packet.protocol_version = 1;
+    packet.payload = xoe_payload_alloc(5000);
+    TEST_ASSERT_NOT_NULL(packet.payload, "Payload allocated");
+    if (packet.payload == NULL) {
+        return;
+    }
+    for (i = 0; i < 5000; i++) {
+        ((uint8_t*)packet.payload->data)[i] = (uint8_t)(i * 7);
+    }
+
+    TEST_ASSERT_SUCCESS(xoe_wire_send(client_fd, &packet), "Client sent");
+    TEST_ASSERT(xoe_wire_pending(server_fd), "Server sees pending bytes");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(server_fd, &received), "Server received");
+    TEST_ASSERT_EQUAL(5000, received.payload->len, "Length kept");
+    TEST_ASSERT(memcmp(received.payload->data, packet.payload->data,
+                       5000) == 0, "Payload kept");
+    TEST_ASSERT(!xoe_wire_pending(server_fd), "Ring drained");
+
+    TEST_ASSERT_SUCCESS(xoe_wire_send(server_fd, &received), "Server echoed");
+    xoe_wire_free_payload(&received);
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(client_fd, &received), "Client received");
+    TEST_ASSERT(memcmp(received.payload->data, packet.payload->data,
+                       5000) == 0, "Echo kept");
+
+    xoe_wire_free_payload(&received);
+    xoe_wire_free_payload(&packet);
+    shm_link_close(client_fd);
+    shm_link_close(server_fd);
+    TEST_ASSERT_NULL(shm_link_find(server_fd), "Closed link unregistered");
+    shm_link_close_listener(listen_fd, g_path);
+}
+
+/**
+ * @brief Reader for test_stream_wraps_ring(): counts pattern mismatches
+ */
+static void* stream_reader(void* arg) {
+    int fd = *(int*)arg;
+    shm_link_t* link = shm_link_find(fd);
+    uint8_t buf[4096];
+    long mismatches = 0;
+    uint32_t total = 0;
+    int n;
+    int i;
+
+    while (total < STREAM_BYTES) {
+        n = shm_link_recv(link, buf, sizeof(buf));
+        if (n <= 0) {
+            mismatches++;
+            break;
+        }
+        for (i = 0; i < n; i++) {
+            if (buf[i] != (uint8_t)((total + (uint32_t)i) % 251)) {
+                mismatches++;
+            }
+        }
+        total += (uint32_t)n;
+    }
+    return (void*)mismatches;
+}
+
+/**
+ * @brief Test a stream several rings long against a slower reader
+ */
+void test_stream_wraps_ring(void) {
+    struct iovec iov;
+    pthread_t reader;
+    void* mismatches = NULL;
+    uint8_t* data;
+    int listen_fd;
+    int client_fd;
+    int server_fd;
+    int result;
+    uint32_t i;
+
+    result = open_pair(&listen_fd, &client_fd, &server_fd);
+    if (result == E_NOT_SUPPORTED) {
+        TEST_SKIP("shared-memory links unavailable");
+        return;
+    }
+    TEST_ASSERT_SUCCESS(result, "Link established");
+    if (result != 0) {
+        return;
+    }
+
+    data = (uint8_t*)malloc(STREAM_BYTES);
+    TEST_ASSERT_NOT_NULL(data, "Buffer allocated");
+    if (data == NULL) {
+        return;
+    }
+    for (i = 0; i < STREAM_BYTES; i++) {
+        data[i] = (uint8_t)(i % 251);
+    }
+
+    TEST_ASSERT(pthread_create(&reader, NULL, stream_reader, &server_fd) == 0,
+                "Reader started");
+    iov.iov_base = data;
+    iov.iov_len = STREAM_BYTES;
+    TEST_ASSERT_SUCCESS(shm_link_sendv(shm_link_find(client_fd), &iov, 1,
+                                       XOE_WIRE_SEND_TIMEOUT_MS),
+                        "Whole stream written");
+    pthread_join(reader, &mismatches);
+    TEST_ASSERT(mismatches == NULL, "Every byte arrived in order");
+
+    free(data);
+    shm_link_close(client_fd);
+    shm_link_close(server_fd);
+    shm_link_close_listener(listen_fd, g_path);
+}
+
+/**
+ * @brief Test doorbell wakeups and end of stream on a polled descriptor
+ */
+void test_doorbell_and_hangup(void) {
+    struct iovec iov;
+    struct pollfd pfd;
+    char byte = 'x';
+    char buf[16];
+    shm_link_t* link;
+    int listen_fd;
+    int client_fd;
+    int server_fd;
+    int result;
+
+    result = open_pair(&listen_fd, &client_fd, &server_fd);
+    if (result == E_NOT_SUPPORTED) {
+        TEST_SKIP("shared-memory links unavailable");
+        return;
+    }
+    TEST_ASSERT_SUCCESS(result, "Link established");
+    if (result != 0) {
+        return;
+    }
+    link = shm_link_find(server_fd);
+    (void)fcntl(server_fd, F_SETFL, fcntl(server_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    TEST_ASSERT_ERROR(shm_link_recv(link, buf, sizeof(buf)), E_WOULD_BLOCK,
+                      "Empty ring would block");
+
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    TEST_ASSERT_SUCCESS(shm_link_sendv(shm_link_find(client_fd), &iov, 1,
+                                       XOE_WIRE_SEND_TIMEOUT_MS), "Sent");
+    pfd.fd = server_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    TEST_ASSERT_EQUAL(1, poll(&pfd, 1, 1000), "Doorbell made it readable");
+    TEST_ASSERT_EQUAL(1, shm_link_recv(link, buf, sizeof(buf)), "Byte read");
+    TEST_ASSERT_EQUAL('x', buf[0], "Byte kept");
+    TEST_ASSERT_ERROR(shm_link_recv(link, buf, sizeof(buf)), E_WOULD_BLOCK,
+                      "Doorbell consumed with the byte");
+
+    shm_link_close(client_fd);
+    TEST_ASSERT_EQUAL(1, poll(&pfd, 1, 1000), "Hangup made it readable");
+    TEST_ASSERT_EQUAL(0, shm_link_recv(link, buf, sizeof(buf)),
+                      "End of stream");
+    TEST_ASSERT_ERROR(shm_link_sendv(link, &iov, 1, 100), E_IO_ERROR,
+                      "Send to a closed peer fails");
+
+    shm_link_close(server_fd);
+    shm_link_close_listener(listen_fd, g_path);
+}
+
+/**
+ * @brief Test that memory without a shrink seal is refused
+ */
+void test_unsealed_memory_refused(void) {
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct sockaddr_un addr;
+    struct msghdr mh;
+    struct iovec iov;
+    struct cmsghdr* cmsg;
+    char byte = 0;
+    int listen_fd;
+    int sock;
+    int mem;
+    int fd;
+
+    snprintf(g_path, sizeof(g_path), "/tmp/xoe-test-shm-%d.sock",
+             (int)getpid());
+    listen_fd = shm_link_listen(g_path);
+    TEST_ASSERT(listen_fd >= 0, "Listening");
+    if (listen_fd < 0) {
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, g_path, sizeof(addr.sun_path) - 1);
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT(connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == 0,
+                "Connected");
+
+    mem = memfd_create("test", MFD_CLOEXEC);
+    TEST_ASSERT(mem >= 0 && ftruncate(mem, 4096) == 0, "Memory created");
+
+    memset(&mh, 0, sizeof(mh));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = &byte;
+    iov.iov_len = 1;
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &mem, sizeof(int));
+    TEST_ASSERT(sendmsg(sock, &mh, 0) == 1, "Memory passed");
+
+    TEST_ASSERT_ERROR(shm_link_accept(listen_fd, &fd), E_PROTOCOL_ERROR,
+                      "Unsealed memory refused");
+    TEST_ASSERT_EQUAL(-1, fd, "No descriptor returned");
+
+    close(mem);
+    close(sock);
+    shm_link_close_listener(listen_fd, g_path);
+#else
+    TEST_SKIP("memfd sealing unavailable");
+#endif
+}
+
+/**
+ * @brief Test which files at the listening path are replaced
+ */
+void test_listen_path(void) {
+#if defined(__linux__)
+    struct stat st;
+    int listen_fd;
+    int second;
+    int fd;
+
+    snprintf(g_path, sizeof(g_path), "/tmp/xoe-test-shm-%d.sock",
+             (int)getpid());
+    (void)unlink(g_path);
+
+    /* A socket left behind by a dead server is replaced */
+    listen_fd = shm_link_listen(g_path);
+    TEST_ASSERT(listen_fd >= 0, "Listening");
+    close(listen_fd);
+    listen_fd = shm_link_listen(g_path);
+    TEST_ASSERT(listen_fd >= 0, "Listening over a stale socket");
+    TEST_ASSERT(stat(g_path, &st) == 0 && (st.st_mode & 0777) == 0600,
+                "Owner only");
+
+    /* A server still listening keeps its socket */
+    second = shm_link_listen(g_path);
+    TEST_ASSERT(second < 0, "Live socket not replaced");
+    if (second >= 0) {
+        close(second);
+    }
+    shm_link_close_listener(listen_fd, g_path);
+
+    /* Only sockets are removed */
+    fd = open(g_path, O_CREAT | O_WRONLY, 0600);
+    TEST_ASSERT(fd >= 0, "Regular file created");
+    close(fd);
+    TEST_ASSERT(shm_link_listen(g_path) < 0, "Regular file not replaced");
+    TEST_ASSERT(stat(g_path, &st) == 0 && S_ISREG(st.st_mode), "File kept");
+    (void)unlink(g_path);
+#else
+    TEST_SKIP("shared-memory links are Linux only");
+#endif
+}
+
+/* ============================================================================
+ * Main Test Runner
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Shared-Memory Link Unit Tests ===\n\n");
+
+    /* Address tests */
+    run_test("test_address_parsing", test_address_parsing);
+
+    /* Link tests */
+    run_test("test_wire_roundtrip", test_wire_roundtrip);
+    run_test("test_stream_wraps_ring", test_stream_wraps_ring);
+    run_test("test_doorbell_and_hangup", test_doorbell_and_hangup);
+    run_test("test_unsealed_memory_refused", test_unsealed_memory_refused);
+    run_test("test_listen_path", test_listen_path);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+/**
+ * @file test_sock_tune.c
+ * @brief Unit tests for the socket tuning profiles
+ *
+ * Preset contents, profile name parsing, and the options actually landing
+ * on a socket (read back with getsockopt), including a loopback connect
+ * through net_resolve_connect_tuned().
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/sock_tune.h"
+#include "lib/net/net_resolve.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * @brief Read back an int socket option (-1 on failure)
+ */
+static int get_int_opt(int fd, int level, int name)
+{
+    int value = 0;
+    socklen_t len = sizeof(value);
+
+    if (getsockopt(fd, level, name, &value, &len) != 0) {
+        return -1;
+    }
+    return value;
+}
+
+/* ============================================================================
+ * Preset Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test each preset carries the options it documents
+ */
+void test_presets(void) {
+    sock_tune_t tune;
+
+    sock_tune_preset(&tune, SOCK_TUNE_LOW_LATENCY);
+    TEST_ASSERT(tune.nodelay, "low-latency sets TCP_NODELAY");
+    TEST_ASSERT(tune.keepalive, "low-latency enables keepalive");
+    TEST_ASSERT(tune.user_timeout_ms > 0, "low-latency bounds dead peers");
+    TEST_ASSERT_EQUAL(0, tune.sndbuf, "low-latency keeps kernel buffers");
+    TEST_ASSERT_EQUAL(0, tune.busy_poll_us, "Busy polling off by default");
+
+    sock_tune_preset(&tune, SOCK_TUNE_BULK);
+    TEST_ASSERT(!tune.nodelay, "bulk leaves Nagle on");
+    TEST_ASSERT_EQUAL(SOCK_TUNE_BULK_BUFFER, tune.rcvbuf, "bulk buffers");
+
+    sock_tune_preset(&tune, SOCK_TUNE_SYSTEM);
+    TEST_ASSERT(!tune.nodelay && !tune.keepalive && tune.sndbuf == 0,
+                "system sets nothing");
+}
+
+/**
+ * @brief Test profile names round-trip and unknown names are refused
+ */
+void test_parse_profile(void) {
+    sock_tune_profile_t profile;
+
+    TEST_ASSERT_EQUAL(0, sock_tune_parse_profile("bulk", &profile), "bulk");
+    TEST_ASSERT_EQUAL(SOCK_TUNE_BULK, profile, "bulk parsed");
+    TEST_ASSERT_EQUAL(0, sock_tune_parse_profile("low-latency", &profile),
+                      "low-latency");
+    TEST_ASSERT_STR_EQUAL("low-latency", sock_tune_profile_name(profile),
+                          "Name round-trips");
+    TEST_ASSERT_ERROR(sock_tune_parse_profile("fast", &profile),
+                      E_INVALID_ARGUMENT, "Unknown profile refused");
+    TEST_ASSERT_ERROR(sock_tune_parse_profile(NULL, &profile),
+                      E_INVALID_ARGUMENT, "NULL name refused");
+}
+
+/* ============================================================================
+ * Apply Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the low-latency options are set on a TCP socket
+ */
+void test_apply_low_latency(void) {
+    sock_tune_t tune;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(fd >= 0, "socket");
+
+    sock_tune_preset(&tune, SOCK_TUNE_LOW_LATENCY);
+    TEST_ASSERT_EQUAL(0, sock_tune_apply(fd, &tune), "Apply");
+    TEST_ASSERT(get_int_opt(fd, IPPROTO_TCP, TCP_NODELAY) != 0,
+                "TCP_NODELAY set");
+    TEST_ASSERT(get_int_opt(fd, SOL_SOCKET, SO_KEEPALIVE) != 0,
+                "SO_KEEPALIVE set");
+#if defined(TCP_KEEPIDLE)
+    TEST_ASSERT_EQUAL(SOCK_TUNE_KEEPIDLE_S,
+                      get_int_opt(fd, IPPROTO_TCP, TCP_KEEPIDLE),
+                      "TCP_KEEPIDLE set");
+#endif
+#if defined(TCP_KEEPCNT)
+    TEST_ASSERT_EQUAL(SOCK_TUNE_KEEPCNT,
+                      get_int_opt(fd, IPPROTO_TCP, TCP_KEEPCNT),
+                      "TCP_KEEPCNT set");
+#endif
+
+    TEST_ASSERT_EQUAL(0, sock_tune_apply(fd, NULL), "NULL options ignored");
+    TEST_ASSERT_ERROR(sock_tune_apply(-1, &tune), E_INVALID_ARGUMENT,
+                      "Bad descriptor refused");
+    close(fd);
+}
+
+/**
+ * @brief Test the bulk buffers are set (the kernel may round them)
+ */
+void test_apply_bulk(void) {
+    sock_tune_t tune;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(fd >= 0, "socket");
+
+    sock_tune_preset(&tune, SOCK_TUNE_BULK);
+    sock_tune_apply(fd, &tune);
+    TEST_ASSERT_EQUAL(0, get_int_opt(fd, IPPROTO_TCP, TCP_NODELAY),
+                      "Nagle left on");
+    /* Linux doubles the request but caps it at net.core.rmem_max */
+    TEST_ASSERT(get_int_opt(fd, SOL_SOCKET, SO_RCVBUF) > 0,
+                "Receive buffer readable");
+    close(fd);
+}
+
+/**
+ * @brief Test a connect through net_resolve_connect_tuned is tuned
+ */
+void test_connect_tuned(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    sock_tune_t tune;
+    int listener;
+    int sock = -1;
+    int peer;
+
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, bind(listener, (struct sockaddr*)&addr, sizeof(addr)),
+                      "bind");
+    TEST_ASSERT_EQUAL(0, listen(listener, 1), "listen");
+    getsockname(listener, (struct sockaddr*)&addr, &len);
+
+    sock_tune_preset(&tune, SOCK_TUNE_LOW_LATENCY);
+    TEST_ASSERT_EQUAL(0, net_resolve_connect_tuned("127.0.0.1",
+                                                   ntohs(addr.sin_port),
+                                                   &tune, &sock, NULL),
+                      "Connect");
+    TEST_ASSERT(get_int_opt(sock, IPPROTO_TCP, TCP_NODELAY) != 0,
+                "Connected socket has TCP_NODELAY");
+
+    peer = accept(listener, NULL, NULL);
+    TEST_ASSERT(peer >= 0, "accept");
+
+    close(peer);
+    close(sock);
+    close(listener);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Socket Tuning Unit Tests ===\n\n");
+
+    /* Preset tests */
+    run_test("test_presets", test_presets);
+    run_test("test_parse_profile", test_parse_profile);
+
+    /* Apply tests */
+    run_test("test_apply_low_latency", test_apply_low_latency);
+    run_test("test_apply_bulk", test_apply_bulk);
+    run_test("test_connect_tuned", test_connect_tuned);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
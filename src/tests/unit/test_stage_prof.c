@@ -0,0 +1,297 @@
+/**
+ * @file test_stage_prof.c
+ * @brief Unit tests for the hot-stage profiler
+ *
+ * Switching on and off, exact totals across concurrent threads (slot
+ * reuse and overflow), clearing on a new run, and the wire format hooks
+ * that feed the checksum and syscall stages. Built without
+ * XOE_STAGE_PROFILE, only the stub behaviour is checked.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/stage_prof.h"
+#include "lib/common/definitions.h"
+#include "lib/protocol/wire_format.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Samples per thread in the concurrency tests */
+#define TEST_SAMPLES_PER_THREAD 1000
+
+/**
+ * @brief Samples of one stage in a fresh snapshot
+ */
+static uint64_t stage_count(stage_id_t id)
+{
+    stage_prof_snapshot_t snapshot;
+
+    stage_prof_snapshot(&snapshot);
+    return snapshot.stages[id].count;
+}
+
+#if XOE_STAGE_PROFILE
+
+/**
+ * @brief Thread body: record TEST_SAMPLES_PER_THREAD route lookups
+ */
+static void* record_thread(void* arg)
+{
+    STAGE_PROF_VAR(start);
+    int i;
+
+    (void)arg;
+    for (i = 0; i < TEST_SAMPLES_PER_THREAD; i++) {
+        STAGE_PROF_START(start);
+        STAGE_PROF_STOP(STAGE_ROUTE_LOOKUP, start);
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Switch Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test stages bracketed while off record nothing
+ */
+void test_off_records_nothing(void) {
+    STAGE_PROF_VAR(start);
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should start");
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+    TEST_ASSERT(!stage_prof_running(), "Profiler should report stopped");
+
+    STAGE_PROF_START(start);
+    TEST_ASSERT_EQUAL(0, start, "Start taken while off should be empty");
+    STAGE_PROF_STOP(STAGE_DECAPSULATE, start);
+
+    TEST_ASSERT_EQUAL(0, stage_count(STAGE_DECAPSULATE),
+                      "Nothing should be recorded while off");
+}
+
+/**
+ * @brief Test samples, their sum and the largest one while on
+ */
+void test_records_while_on(void) {
+    stage_prof_snapshot_t snapshot;
+    struct timespec pause;
+    STAGE_PROF_VAR(start);
+    int i;
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should start");
+    TEST_ASSERT(stage_prof_running(), "Profiler should report running");
+
+    for (i = 0; i < 10; i++) {
+        STAGE_PROF_START(start);
+        STAGE_PROF_STOP(STAGE_DECAPSULATE, start);
+    }
+
+    /* One long sample: 2 ms */
+    pause.tv_sec = 0;
+    pause.tv_nsec = 2000000L;
+    STAGE_PROF_START(start);
+    nanosleep(&pause, NULL);
+    STAGE_PROF_STOP(STAGE_DECAPSULATE, start);
+
+    stage_prof_snapshot(&snapshot);
+    TEST_ASSERT(snapshot.running, "Snapshot should report running");
+    TEST_ASSERT_EQUAL(11, snapshot.stages[STAGE_DECAPSULATE].count,
+                      "Every sample should be counted");
+    TEST_ASSERT_EQUAL(1, snapshot.stages[STAGE_DECAPSULATE].threads,
+                      "One thread should have recorded");
+    /* Calibration error is well under 10% */
+    TEST_ASSERT(snapshot.stages[STAGE_DECAPSULATE].max_ns >= 1800000ULL,
+                "Largest sample should cover the sleep");
+    TEST_ASSERT(snapshot.stages[STAGE_DECAPSULATE].sum_ns >=
+                snapshot.stages[STAGE_DECAPSULATE].max_ns,
+                "Sum should include the largest sample");
+    TEST_ASSERT(snapshot.elapsed_ns >= 1800000ULL,
+                "Elapsed time should cover the run");
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+    TEST_ASSERT_EQUAL(11, stage_count(STAGE_DECAPSULATE),
+                      "Totals should stay after stopping");
+}
+
+/**
+ * @brief Test a new run starts from zero and "on" twice keeps totals
+ */
+void test_restart_clears(void) {
+    STAGE_PROF_VAR(start);
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should start");
+    STAGE_PROF_START(start);
+    STAGE_PROF_STOP(STAGE_CHECKSUM, start);
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Second on should succeed");
+    TEST_ASSERT_EQUAL(1, stage_count(STAGE_CHECKSUM),
+                      "On while running should keep totals");
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should restart");
+    TEST_ASSERT_EQUAL(0, stage_count(STAGE_CHECKSUM),
+                      "A new run should start from zero");
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+}
+
+/* ============================================================================
+ * Concurrency Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test exact totals from more threads than slots
+ *
+ * Short-lived threads reuse released slots; more live threads than slots
+ * spill into the overflow slot.
+ */
+void test_threads_and_overflow(void) {
+    pthread_t threads[STAGE_PROF_MAX_SLOTS + 8];
+    int started = 0;
+    int i;
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should start");
+
+    for (i = 0; i < STAGE_PROF_MAX_SLOTS * 2; i++) {
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, record_thread, NULL) == 0) {
+            pthread_join(thread, NULL);
+            started++;
+        }
+    }
+    TEST_ASSERT_EQUAL((uint64_t)started * TEST_SAMPLES_PER_THREAD,
+                      stage_count(STAGE_ROUTE_LOOKUP),
+                      "Reused slots should keep exited threads' samples");
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should restart");
+
+    started = 0;
+    for (i = 0; i < STAGE_PROF_MAX_SLOTS + 8; i++) {
+        if (pthread_create(&threads[i], NULL, record_thread, NULL) == 0) {
+            started++;
+        }
+    }
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT_EQUAL((uint64_t)started * TEST_SAMPLES_PER_THREAD,
+                      stage_count(STAGE_ROUTE_LOOKUP),
+                      "Threads beyond the slot count should be counted");
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+}
+
+/* ============================================================================
+ * Wire Hook Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a frame sent and received feeds checksum and syscall stages
+ */
+void test_wire_stages(void) {
+    stage_prof_snapshot_t snapshot;
+    uint8_t data[64];
+    xoe_payload_t payload;
+    xoe_packet_t out;
+    xoe_packet_t in;
+    int fds[2];
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds),
+                        "Socket pair should open");
+    memset(data, 0x5a, sizeof(data));
+    payload.data = data;
+    payload.len = sizeof(data);
+    payload.owns_data = FALSE;
+    memset(&out, 0, sizeof(out));
+    out.protocol_id = 0x0001;
+    out.protocol_version = 1;
+    out.payload = &payload;
+
+    TEST_ASSERT_SUCCESS(stage_prof_enable(TRUE), "Profiler should start");
+    TEST_ASSERT_SUCCESS(xoe_wire_send(fds[1], &out), "Frame should send");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(fds[0], &in), "Frame should arrive");
+    xoe_wire_free_payload(&in);
+    TEST_ASSERT_SUCCESS(stage_prof_enable(FALSE), "Profiler should stop");
+
+    stage_prof_snapshot(&snapshot);
+    TEST_ASSERT(snapshot.stages[STAGE_CHECKSUM].count >= 2,
+                "Send and receive should each checksum the frame");
+    TEST_ASSERT(snapshot.stages[STAGE_SEND_SYSCALL].count >= 1,
+                "Send should be profiled");
+    TEST_ASSERT(snapshot.stages[STAGE_RECV_SYSCALL].count >= 1,
+                "Receive should be profiled");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+#else /* !XOE_STAGE_PROFILE */
+
+/**
+ * @brief Test the stub refuses to start and records nothing
+ */
+void test_compiled_out(void) {
+    STAGE_PROF_VAR(start);
+
+    TEST_ASSERT_ERROR(stage_prof_enable(TRUE), E_NOT_SUPPORTED,
+                      "Profiler should not start when compiled out");
+    TEST_ASSERT(!stage_prof_running(), "Profiler should report stopped");
+    STAGE_PROF_START(start);
+    STAGE_PROF_STOP(STAGE_CHECKSUM, start);
+    TEST_ASSERT_EQUAL(0, stage_count(STAGE_CHECKSUM),
+                      "Nothing should be recorded");
+}
+
+#endif /* XOE_STAGE_PROFILE */
+
+/**
+ * @brief Test every stage is described and out-of-range ids are not
+ */
+void test_descriptors(void) {
+    int id;
+
+    for (id = 0; id < (int)STAGE_COUNT; id++) {
+        TEST_ASSERT_NOT_NULL(stage_prof_describe((stage_id_t)id),
+                             "Every stage should be described");
+    }
+    TEST_ASSERT_NULL(stage_prof_describe(STAGE_COUNT),
+                     "Out-of-range stage should have no description");
+    TEST_ASSERT(strcmp(stage_prof_describe(STAGE_SEND_LOCK_WAIT)->name,
+                       "send_lock_wait") == 0,
+                "Names should follow the enum order");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Stage Profiler Unit Tests ===\n\n");
+
+    run_test("test_descriptors", test_descriptors);
+#if XOE_STAGE_PROFILE
+    /* Switch tests */
+    run_test("test_off_records_nothing", test_off_records_nothing);
+    run_test("test_records_while_on", test_records_while_on);
+    run_test("test_restart_clears", test_restart_clears);
+
+    /* Concurrency tests */
+    run_test("test_threads_and_overflow", test_threads_and_overflow);
+
+    /* Wire hook tests */
+    run_test("test_wire_stages", test_wire_stages);
+#else
+    run_test("test_compiled_out", test_compiled_out);
+#endif
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
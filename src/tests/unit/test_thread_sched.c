@@ -0,0 +1,285 @@
+/**
+ * @file test_thread_sched.c
+ * @brief Unit tests for per-class thread CPU sets and scheduling policies
+ *
+ * Parses --sched specifications, then starts threads through
+ * thread_sched_create() and checks from inside them that their class's
+ * CPU set and policy are in effect, both at start and after a live
+ * change. Real-time checks are skipped without CAP_SYS_NICE.
+ *
+ * [LLM-ARCH]
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/thread_sched.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+/**
+ * @brief What a test thread saw, and the flag that lets it finish
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int started;
+    int finish;
+} probe_t;
+
+static void* probe_thread(void* arg) {
+    probe_t* probe = (probe_t*)arg;
+
+    pthread_mutex_lock(&probe->lock);
+    probe->started = 1;
+    pthread_cond_broadcast(&probe->cond);
+    while (!probe->finish) {
+        pthread_cond_wait(&probe->cond, &probe->lock);
+    }
+    pthread_mutex_unlock(&probe->lock);
+    return NULL;
+}
+
+static void probe_start(probe_t* probe, pthread_t* thread, thread_class_t cls) {
+    memset(probe, 0, sizeof(*probe));
+    pthread_mutex_init(&probe->lock, NULL);
+    pthread_cond_init(&probe->cond, NULL);
+    if (thread_sched_create(thread, cls, probe_thread, probe) != 0) {
+        probe->started = -1;
+        return;
+    }
+    pthread_mutex_lock(&probe->lock);
+    while (!probe->started) {
+        pthread_cond_wait(&probe->cond, &probe->lock);
+    }
+    pthread_mutex_unlock(&probe->lock);
+}
+
+static void probe_stop(probe_t* probe, pthread_t thread) {
+    if (probe->started == 1) {
+        pthread_mutex_lock(&probe->lock);
+        probe->finish = 1;
+        pthread_cond_broadcast(&probe->cond);
+        pthread_mutex_unlock(&probe->lock);
+        pthread_join(thread, NULL);
+    }
+    pthread_cond_destroy(&probe->cond);
+    pthread_mutex_destroy(&probe->lock);
+}
+
+#if defined(__linux__)
+/**
+ * @brief Number of CPUs a thread may run on, and whether @p cpu is one
+ */
+static int allowed_cpus(pthread_t thread, int cpu, int* has_cpu) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(thread, sizeof(set), &set) != 0) {
+        return -1;
+    }
+    *has_cpu = CPU_ISSET(cpu, &set);
+    return CPU_COUNT(&set);
+}
+#endif
+
+/* ============================================================================
+ * Parsing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test CPU lists and --sched specifications
+ */
+void test_parse(void) {
+    thread_sched_class_t entry;
+    thread_class_t cls;
+    int cpus[4];
+    int count = 0;
+
+    TEST_ASSERT_SUCCESS(thread_sched_parse_cpus("0,2-3", cpus, 4, &count),
+                        "List with a range");
+    TEST_ASSERT_EQUAL(3, count, "Three CPUs");
+    TEST_ASSERT_EQUAL(3, cpus[2], "Range end");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse_cpus("0-4", cpus, 4, &count),
+                      "More than max");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse_cpus("3-1", cpus, 4, &count),
+                      "Backwards range");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse_cpus("1,", cpus, 4, &count),
+                      "Trailing comma");
+
+    TEST_ASSERT_SUCCESS(thread_sched_parse("serial:2,3:fifo:80", &cls, &entry),
+                        "Full specification");
+    TEST_ASSERT_EQUAL(THREAD_CLASS_SERIAL, cls, "Class");
+    TEST_ASSERT_EQUAL(2, entry.cpu_count, "CPUs");
+    TEST_ASSERT_EQUAL(THREAD_POLICY_FIFO, entry.policy, "Policy");
+    TEST_ASSERT_EQUAL(80, entry.priority, "Priority");
+
+    TEST_ASSERT_SUCCESS(thread_sched_parse("usb:any:rr", &cls, &entry),
+                        "Any CPU, default priority");
+    TEST_ASSERT_EQUAL(THREAD_CLASS_USB, cls, "usb class");
+    TEST_ASSERT_EQUAL(0, entry.cpu_count, "No CPU set");
+    TEST_ASSERT_EQUAL(THREAD_SCHED_DEFAULT_PRIO, entry.priority,
+                      "Default priority");
+
+    TEST_ASSERT_SUCCESS(thread_sched_parse("net:0-1", &cls, &entry),
+                        "CPUs only");
+    TEST_ASSERT_EQUAL(THREAD_POLICY_DEFAULT, entry.policy, "Default policy");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse("disk:0", &cls, &entry),
+                      "Unknown class");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse("net", &cls, &entry), "No CPUs");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse("net:0:idle", &cls, &entry),
+                      "Unknown policy");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse("net:0:fifo:100", &cls, &entry),
+                      "Priority out of range");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      thread_sched_parse("net:0:default:10", &cls, &entry),
+                      "Priority without a real-time policy");
+}
+
+/**
+ * @brief Test the description used by bench reports and mgmt "get sched"
+ */
+void test_format(void) {
+    thread_sched_t sched;
+    thread_class_t cls;
+    char text[THREAD_SCHED_FORMAT_MAX];
+
+    memset(&sched, 0, sizeof(sched));
+    thread_sched_format(&sched, text, sizeof(text));
+    TEST_ASSERT_STR_EQUAL("default", text, "Nothing configured");
+
+    (void)thread_sched_parse("serial:2,3:fifo:80", &cls,
+                             &sched.classes[THREAD_CLASS_SERIAL]);
+    (void)thread_sched_parse("net:0", &cls, &sched.classes[THREAD_CLASS_NET]);
+    thread_sched_format(&sched, text, sizeof(text));
+    TEST_ASSERT_STR_EQUAL("serial cpus 2,3 fifo/80, net cpus 0", text,
+                          "Configured classes");
+}
+
+/* ============================================================================
+ * Applying Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a class's CPU set reaches new and running threads
+ */
+void test_affinity(void) {
+#if defined(__linux__)
+    thread_sched_t sched;
+    thread_class_t cls;
+    probe_t net_probe;
+    probe_t usb_probe;
+    pthread_t net_thread;
+    pthread_t usb_thread;
+    int has_cpu = 0;
+    int before;
+
+    before = allowed_cpus(pthread_self(), 0, &has_cpu);
+    if (before < 2 || !has_cpu) {
+        TEST_SKIP("needs CPU 0 and one more CPU");
+        return;
+    }
+
+    memset(&sched, 0, sizeof(sched));
+    (void)thread_sched_parse("net:0", &cls, &sched.classes[THREAD_CLASS_NET]);
+    TEST_ASSERT_SUCCESS(thread_sched_set(&sched), "Settings installed");
+
+    probe_start(&net_probe, &net_thread, THREAD_CLASS_NET);
+    probe_start(&usb_probe, &usb_thread, THREAD_CLASS_USB);
+    TEST_ASSERT_EQUAL(1, net_probe.started, "net thread started");
+    TEST_ASSERT_EQUAL(1, allowed_cpus(net_thread, 0, &has_cpu),
+                      "net thread on one CPU");
+    TEST_ASSERT(has_cpu, "CPU 0");
+    TEST_ASSERT_EQUAL(before, allowed_cpus(usb_thread, 0, &has_cpu),
+                      "usb thread left alone");
+
+    /* Live change: the running thread goes back to every CPU */
+    memset(&sched, 0, sizeof(sched));
+    TEST_ASSERT_SUCCESS(thread_sched_set(&sched), "Settings cleared");
+    TEST_ASSERT_EQUAL(before, allowed_cpus(net_thread, 0, &has_cpu),
+                      "Running net thread released");
+
+    probe_stop(&net_probe, net_thread);
+    probe_stop(&usb_probe, usb_thread);
+#else
+    TEST_SKIP("CPU affinity is Linux-only");
+#endif
+}
+
+/**
+ * @brief Test a real-time policy and memory locking, then undoing them
+ */
+void test_realtime(void) {
+#if defined(__linux__)
+    thread_sched_t sched;
+    thread_class_t cls;
+    struct sched_param param;
+    probe_t probe;
+    pthread_t thread;
+    int policy = -1;
+    int result;
+
+    memset(&sched, 0, sizeof(sched));
+    (void)thread_sched_parse("serial:any:rr:10", &cls,
+                             &sched.classes[THREAD_CLASS_SERIAL]);
+    result = thread_sched_set(&sched);
+    probe_start(&probe, &thread, THREAD_CLASS_SERIAL);
+    pthread_getschedparam(thread, &policy, &param);
+    if (result == E_PERMISSION_DENIED || policy != SCHED_RR) {
+        probe_stop(&probe, thread);
+        memset(&sched, 0, sizeof(sched));
+        (void)thread_sched_set(&sched);
+        TEST_SKIP("real-time scheduling not permitted");
+        return;
+    }
+    TEST_ASSERT_SUCCESS(result, "Real-time settings installed");
+    TEST_ASSERT_EQUAL(10, param.sched_priority, "Priority");
+    TEST_ASSERT(thread_sched_memory_locked(), "Memory locked");
+
+    memset(&sched, 0, sizeof(sched));
+    TEST_ASSERT_SUCCESS(thread_sched_set(&sched), "Back to default");
+    pthread_getschedparam(thread, &policy, &param);
+    TEST_ASSERT_EQUAL(SCHED_OTHER, policy, "Running thread back to default");
+    TEST_ASSERT(!thread_sched_memory_locked(), "Memory unlocked");
+
+    probe_stop(&probe, thread);
+#else
+    TEST_SKIP("scheduling policies are Linux-only");
+#endif
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Thread Scheduling Unit Tests ===\n\n");
+
+    /* Parsing tests */
+    run_test("test_parse", test_parse);
+    run_test("test_format", test_format);
+
+    /* Applying tests */
+    run_test("test_affinity", test_affinity);
+    run_test("test_realtime", test_realtime);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
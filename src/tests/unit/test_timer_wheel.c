@@ -0,0 +1,275 @@
+/**
+ * @file test_timer_wheel.c
+ * @brief Unit tests for the hierarchical timer wheel
+ *
+ * Tests that timers fire in deadline order and never early, that
+ * cancelled and re-armed timers behave, that deadlines on the coarse
+ * levels cascade down and fire on time, that next_ms() reports the wait
+ * the owner may sleep, and that callbacks may re-arm timers.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/timer_wheel.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_TIMERS 8
+
+/* Order in which test timers fired */
+static int fired_order[64];
+static int fired_count;
+
+static void record_fire(timer_wheel_timer_t* timer, void* arg) {
+    (void)timer;
+    if (fired_count < (int)(sizeof(fired_order) / sizeof(fired_order[0]))) {
+        fired_order[fired_count] = (int)(long)arg;
+    }
+    fired_count++;
+}
+
+/* Re-arms itself every 10 ms until it fired three times */
+static timer_wheel_t* rearm_wheel;
+static uint64_t rearm_at;
+
+static void rearm_fire(timer_wheel_timer_t* timer, void* arg) {
+    (void)arg;
+    fired_count++;
+    if (fired_count < 3) {
+        rearm_at += 10;
+        timer_wheel_add(rearm_wheel, timer, rearm_at);
+    }
+}
+
+static void reset_fired(void) {
+    memset(fired_order, 0, sizeof(fired_order));
+    fired_count = 0;
+}
+
+/* ============================================================================
+ * Timer Wheel Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test timers fire in deadline order, not before their deadline
+ */
+void test_fire_in_order(void) {
+    timer_wheel_t* wheel;
+    timer_wheel_timer_t timers[3];
+
+    wheel = (timer_wheel_t*)malloc(sizeof(*wheel));
+    TEST_ASSERT_NOT_NULL(wheel, "Allocated");
+    if (wheel == NULL) {
+        return;
+    }
+    reset_fired();
+
+    timer_wheel_init(wheel, 1000, 1);
+    timer_wheel_timer_init(&timers[0], record_fire, (void*)1L);
+    timer_wheel_timer_init(&timers[1], record_fire, (void*)2L);
+    timer_wheel_timer_init(&timers[2], record_fire, (void*)3L);
+    timer_wheel_add(wheel, &timers[0], 1030);
+    timer_wheel_add(wheel, &timers[1], 1010);
+    timer_wheel_add(wheel, &timers[2], 1020);
+    TEST_ASSERT(timer_wheel_pending(&timers[0]), "Armed");
+
+    TEST_ASSERT_EQUAL(0, timer_wheel_advance(wheel, 1009), "Not yet");
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 1010), "First due");
+    TEST_ASSERT_EQUAL(2, timer_wheel_advance(wheel, 1100), "Rest due");
+    TEST_ASSERT_EQUAL(3, fired_count, "All fired");
+    TEST_ASSERT(fired_order[0] == 2 && fired_order[1] == 3 &&
+                fired_order[2] == 1, "Deadline order");
+    TEST_ASSERT(!timer_wheel_pending(&timers[0]), "Idle after firing");
+
+    free(wheel);
+}
+
+/**
+ * @brief Test cancelling and re-arming
+ */
+void test_cancel_and_rearm(void) {
+    timer_wheel_t* wheel;
+    timer_wheel_timer_t timers[TEST_TIMERS];
+    int i;
+
+    wheel = (timer_wheel_t*)malloc(sizeof(*wheel));
+    TEST_ASSERT_NOT_NULL(wheel, "Allocated");
+    if (wheel == NULL) {
+        return;
+    }
+    reset_fired();
+
+    timer_wheel_init(wheel, 0, 1);
+    for (i = 0; i < TEST_TIMERS; i++) {
+        timer_wheel_timer_init(&timers[i], record_fire, (void*)(long)i);
+        timer_wheel_add(wheel, &timers[i], 50);
+    }
+    timer_wheel_cancel(wheel, &timers[3]);
+    timer_wheel_cancel(wheel, &timers[3]);
+    TEST_ASSERT(!timer_wheel_pending(&timers[3]), "Cancelled");
+
+    /* Moved later, then back earlier */
+    timer_wheel_add(wheel, &timers[5], 5000);
+    timer_wheel_add(wheel, &timers[6], 5000);
+    timer_wheel_add(wheel, &timers[6], 20);
+
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 20), "Re-armed earlier");
+    TEST_ASSERT_EQUAL(6, fired_order[0], "Timer 6");
+    TEST_ASSERT_EQUAL(TEST_TIMERS - 3, timer_wheel_advance(wheel, 100),
+                      "Cancelled and moved timers skipped");
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 5000), "Moved timer");
+    TEST_ASSERT_EQUAL(-1, (int)timer_wheel_next_ms(wheel, 5000), "Empty");
+
+    free(wheel);
+}
+
+/**
+ * @brief Test far deadlines cascade through the levels and fire on time
+ */
+void test_cascade(void) {
+    timer_wheel_t* wheel;
+    timer_wheel_timer_t near_timer;
+    timer_wheel_timer_t mid_timer;
+    timer_wheel_timer_t far_timer;
+    timer_wheel_timer_t beyond_timer;
+    uint64_t beyond_ms;
+
+    wheel = (timer_wheel_t*)malloc(sizeof(*wheel));
+    TEST_ASSERT_NOT_NULL(wheel, "Allocated");
+    if (wheel == NULL) {
+        return;
+    }
+    reset_fired();
+
+    /* 10 ms ticks: deadlines round up, never fire early */
+    timer_wheel_init(wheel, 7, 10);
+    timer_wheel_timer_init(&near_timer, record_fire, (void*)1L);
+    timer_wheel_timer_init(&mid_timer, record_fire, (void*)2L);
+    timer_wheel_timer_init(&far_timer, record_fire, (void*)3L);
+    timer_wheel_timer_init(&beyond_timer, record_fire, (void*)4L);
+    timer_wheel_add(wheel, &near_timer, 7 + 15);
+    timer_wheel_add(wheel, &mid_timer, 7 + 12345);
+    timer_wheel_add(wheel, &far_timer, 7 + 3000001);
+    beyond_ms = 7 + ((uint64_t)1 << 24) * 10 * 3;
+    timer_wheel_add(wheel, &beyond_timer, beyond_ms);
+
+    TEST_ASSERT_EQUAL(0, timer_wheel_advance(wheel, 7 + 19), "Rounded up");
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 7 + 20), "Near fired");
+
+    TEST_ASSERT_EQUAL(0, timer_wheel_advance(wheel, 7 + 12349), "Mid early");
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 7 + 12350), "Mid fired");
+
+    TEST_ASSERT_EQUAL(0, timer_wheel_advance(wheel, 7 + 3000009), "Far early");
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 7 + 3000010), "Far fired");
+
+    TEST_ASSERT_EQUAL(0, timer_wheel_advance(wheel, beyond_ms - 1),
+                      "Beyond range kept");
+    TEST_ASSERT(timer_wheel_pending(&beyond_timer), "Still armed");
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, beyond_ms),
+                      "Beyond range fired");
+    TEST_ASSERT_EQUAL(4, fired_count, "All fired");
+
+    free(wheel);
+}
+
+/**
+ * @brief Test next_ms() reports how long the owner may sleep
+ */
+void test_next_ms(void) {
+    timer_wheel_t* wheel;
+    timer_wheel_timer_t near_timer;
+    timer_wheel_timer_t far_timer;
+    uint64_t now;
+    int wakeups = 0;
+    long wait;
+
+    wheel = (timer_wheel_t*)malloc(sizeof(*wheel));
+    TEST_ASSERT_NOT_NULL(wheel, "Allocated");
+    if (wheel == NULL) {
+        return;
+    }
+    reset_fired();
+
+    timer_wheel_init(wheel, 100, 1);
+    TEST_ASSERT_EQUAL(-1, (int)timer_wheel_next_ms(wheel, 100), "Empty");
+
+    timer_wheel_timer_init(&near_timer, record_fire, NULL);
+    timer_wheel_timer_init(&far_timer, record_fire, NULL);
+    timer_wheel_add(wheel, &near_timer, 130);
+    timer_wheel_add(wheel, &far_timer, 100 + 10000);
+    TEST_ASSERT_EQUAL(30, (int)timer_wheel_next_ms(wheel, 100), "Near deadline");
+    TEST_ASSERT_EQUAL(0, (int)timer_wheel_next_ms(wheel, 140), "Overdue");
+
+    timer_wheel_advance(wheel, 140);
+
+    /* A coarse deadline may wake early to cascade, but never late */
+    wait = timer_wheel_next_ms(wheel, 140);
+    TEST_ASSERT(wait > 0 && wait <= 10000 - 40, "Far deadline bounded");
+    now = 140;
+    while (timer_wheel_pending(&far_timer) && wakeups < 16) {
+        wait = timer_wheel_next_ms(wheel, now);
+        if (wait < 0) {
+            break;
+        }
+        now += (uint64_t)wait;
+        timer_wheel_advance(wheel, now);
+        wakeups++;
+    }
+    TEST_ASSERT(!timer_wheel_pending(&far_timer), "Far timer fired");
+    TEST_ASSERT_EQUAL(100 + 10000, (int)now, "Woken at the deadline");
+    TEST_ASSERT(wakeups <= TIMER_WHEEL_LEVELS, "Few wakeups");
+    TEST_ASSERT_EQUAL(2, fired_count, "Both fired");
+
+    free(wheel);
+}
+
+/**
+ * @brief Test a callback re-arming its own timer
+ */
+void test_rearm_from_callback(void) {
+    timer_wheel_t* wheel;
+    timer_wheel_timer_t timer;
+
+    wheel = (timer_wheel_t*)malloc(sizeof(*wheel));
+    TEST_ASSERT_NOT_NULL(wheel, "Allocated");
+    if (wheel == NULL) {
+        return;
+    }
+    reset_fired();
+
+    timer_wheel_init(wheel, 0, 1);
+    rearm_wheel = wheel;
+    rearm_at = 10;
+    timer_wheel_timer_init(&timer, rearm_fire, NULL);
+    timer_wheel_add(wheel, &timer, rearm_at);
+
+    TEST_ASSERT_EQUAL(1, timer_wheel_advance(wheel, 15), "First expiry");
+    TEST_ASSERT(timer_wheel_pending(&timer), "Re-armed");
+    TEST_ASSERT_EQUAL(2, timer_wheel_advance(wheel, 1000), "Re-armed expiries");
+    TEST_ASSERT_EQUAL(3, fired_count, "Fired three times");
+    TEST_ASSERT(!timer_wheel_pending(&timer), "Stopped re-arming");
+
+    free(wheel);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Timer Wheel Unit Tests ===\n\n");
+
+    /* Timer wheel tests */
+    run_test("test_fire_in_order", test_fire_in_order);
+    run_test("test_cancel_and_rearm", test_cancel_and_rearm);
+    run_test("test_cascade", test_cascade);
+    run_test("test_next_ms", test_next_ms);
+    run_test("test_rearm_from_callback", test_rearm_from_callback);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
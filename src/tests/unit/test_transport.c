@@ -0,0 +1,528 @@
+/**
+ * @file test_transport.c
+ * @brief Unit tests for the byte transports under the wire layer
+ *
+ * Tests kind selection and argument checks, gathered writes and
+ * scattered reads over a stream socket pair, datagram boundaries and
+ * truncation over a datagram pair, whole frames through
+ * xoe_wire_send_transport() and the incremental decoder, corked writes
+ * gathered into one, a full socket's bytes queued and flushed in order,
+ * and the decoder's staging buffer adapting to load.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/transport.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* ============================================================================
+ * Binding Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test kind selection and argument checks
+ */
+void test_init_and_arguments(void) {
+    xoe_transport_t t;
+    struct iovec iov[XOE_TRANSPORT_MAX_IOV + 1];
+    char byte = 0;
+    int fds[2];
+    int i;
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_init_fd(NULL, 0),
+                      "No transport refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_init_fd(&t, -1),
+                      "Negative descriptor refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_init_tls(&t, NULL),
+                      "No TLS session refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_init_udp(&t, -1, NULL),
+                      "Negative datagram socket refused");
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "Pair created");
+    TEST_ASSERT_SUCCESS(xoe_transport_init_fd(&t, fds[0]), "Stream bound");
+    TEST_ASSERT_STR_EQUAL("tcp", xoe_transport_name(&t), "Plain socket is tcp");
+    TEST_ASSERT_EQUAL(fds[0], xoe_transport_poll_fd(&t), "Polls the socket");
+    TEST_ASSERT(!xoe_transport_pending(&t), "Nothing held in user space");
+    TEST_ASSERT_SUCCESS(xoe_transport_flush(&t), "Flush is a no-op");
+
+    for (i = 0; i <= XOE_TRANSPORT_MAX_IOV; i++) {
+        iov[i].iov_base = &byte;
+        iov[i].iov_len = 1;
+    }
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_writev(&t, iov, 0),
+                      "Empty iovec refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      xoe_transport_writev(&t, iov, XOE_TRANSPORT_MAX_IOV + 1),
+                      "Too many buffers refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_readv(&t, NULL, 1),
+                      "Missing iovec refused");
+
+    TEST_ASSERT_SUCCESS(xoe_transport_init_udp(&t, fds[1], NULL), "Datagram bound");
+    TEST_ASSERT_STR_EQUAL("udp", xoe_transport_name(&t), "Datagram kind");
+    TEST_ASSERT_STR_EQUAL("none", xoe_transport_name(NULL), "Unbound name");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * Stream Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test gathered writes and scattered reads on a stream
+ */
+void test_stream_readv_writev(void) {
+    xoe_transport_t writer;
+    xoe_transport_t reader;
+    struct iovec iov[3];
+    char out[16];
+    char head[4];
+    char tail[16];
+    int fds[2];
+    int received;
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "Pair created");
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+    xoe_transport_init_fd(&writer, fds[0]);
+    xoe_transport_init_fd(&reader, fds[1]);
+
+    iov[0].iov_base = "abc";
+    iov[0].iov_len = 3;
+    iov[1].iov_base = "";
+    iov[1].iov_len = 0;
+    iov[2].iov_base = "defgh";
+    iov[2].iov_len = 5;
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 3), "Gathered write");
+
+    memset(head, 0, sizeof(head));
+    memset(tail, 0, sizeof(tail));
+    iov[0].iov_base = head;
+    iov[0].iov_len = sizeof(head);
+    iov[1].iov_base = tail;
+    iov[1].iov_len = sizeof(tail);
+    received = xoe_transport_readv(&reader, iov, 2);
+    TEST_ASSERT_EQUAL(8, received, "Every byte in one read");
+    memcpy(out, head, 4);
+    memcpy(out + 4, tail, 4);
+    TEST_ASSERT(memcmp(out, "abcdefgh", 8) == 0, "Bytes kept in order");
+
+    close(fds[0]);
+    iov[0].iov_base = head;
+    iov[0].iov_len = sizeof(head);
+    TEST_ASSERT_EQUAL(0, xoe_transport_readv(&reader, iov, 1),
+                      "End of stream reads 0");
+    close(fds[1]);
+}
+
+/**
+ * @brief Test a frame through the transport entry points of the wire layer
+ */
+void test_stream_wire_frames(void) {
+    xoe_transport_t writer;
+    xoe_transport_t reader;
+    xoe_wire_decoder_t decoder;
+    xoe_packet_t packet;
+    xoe_packet_t received;
+    int fds[2];
+    int result;
+    uint32_t i;
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "Pair created");
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+    xoe_transport_init_fd(&writer, fds[0]);
+    xoe_transport_init_fd(&reader, fds[1]);
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_RAW;
+    packet.protocol_version = 1;
+    packet.payload = xoe_payload_alloc(3000);
+    TEST_ASSERT_NOT_NULL(packet.payload, "Payload allocated");
+    if (packet.payload == NULL) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+    for (i = 0; i < 3000; i++) {
+        ((uint8_t*)packet.payload->data)[i] = (uint8_t)(i * 3);
+    }
+
+    /* Blocking receive */
+    TEST_ASSERT_SUCCESS(xoe_wire_send_transport(&writer, &packet, 0), "Sent");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv_transport(&reader, &received, 0),
+                        "Received");
+    TEST_ASSERT_EQUAL(3000, received.payload->len, "Length kept");
+    TEST_ASSERT(memcmp(received.payload->data, packet.payload->data,
+                       3000) == 0, "Payload kept");
+    xoe_wire_free_payload(&received);
+
+    /* Incremental decoder */
+    TEST_ASSERT_SUCCESS(xoe_wire_send_transport(&writer, &packet, 0),
+                        "Sent again");
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Decoder ready");
+    result = 0;
+    while (result == 0) {
+        TEST_ASSERT_GREATER(xoe_wire_decoder_recv_transport(&decoder, &reader),
+                            0, "Bytes read");
+        result = xoe_wire_decoder_next(&decoder, &received);
+    }
+    TEST_ASSERT_EQUAL(1, result, "Frame completed");
+    if (result == 1) {
+        TEST_ASSERT(memcmp(received.payload->data, packet.payload->data,
+                           3000) == 0, "Decoded payload kept");
+        xoe_wire_free_payload(&received);
+    }
+    xoe_wire_decoder_cleanup(&decoder);
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      xoe_wire_send_transport(NULL, &packet, 0),
+                      "No transport refused");
+    xoe_wire_free_payload(&packet);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Count the bytes waiting on a socket without blocking
+ */
+static int bytes_waiting(int fd) {
+    char buffer[XOE_TRANSPORT_BATCH_SIZE * 2];
+    int received;
+
+    received = (int)recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT | MSG_PEEK);
+    return (received < 0) ? 0 : received;
+}
+
+/**
+ * @brief Test a corked stream gathers writes until uncorked
+ */
+void test_stream_cork(void) {
+    static xoe_transport_batch_t batch;
+    static char big[XOE_TRANSPORT_BATCH_SIZE + 1];
+    xoe_transport_t writer;
+    xoe_transport_t dgram;
+    struct iovec iov[2];
+    char buffer[16];
+    int fds[2];
+    int dfds[2];
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "Pair created");
+    xoe_transport_init_fd(&writer, fds[0]);
+
+    TEST_ASSERT_SUCCESS(xoe_transport_cork(&writer, &batch), "Corked");
+    iov[0].iov_base = "ab";
+    iov[0].iov_len = 2;
+    iov[1].iov_base = "cd";
+    iov[1].iov_len = 2;
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 2), "First write");
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 1), "Second write");
+    TEST_ASSERT_EQUAL(0, bytes_waiting(fds[1]), "Held while corked");
+    TEST_ASSERT_EQUAL(6, (int)batch.len, "Gathered in the batch");
+
+    TEST_ASSERT_SUCCESS(xoe_transport_uncork(&writer), "Uncorked");
+    TEST_ASSERT_EQUAL(6, (int)recv(fds[1], buffer, sizeof(buffer), 0),
+                      "Sent together");
+    TEST_ASSERT(memcmp(buffer, "abcdab", 6) == 0, "Order kept");
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 1),
+                        "Uncorked writes go straight out");
+    TEST_ASSERT_EQUAL(2, bytes_waiting(fds[1]), "Sent at once");
+    recv(fds[1], buffer, sizeof(buffer), 0);
+
+    /* Larger than the batch: what was gathered goes first, then it */
+    xoe_transport_cork(&writer, &batch);
+    xoe_transport_writev(&writer, iov, 1);
+    memset(big, 'z', sizeof(big));
+    iov[0].iov_base = big;
+    iov[0].iov_len = sizeof(big);
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 1),
+                        "Large write passes through");
+    TEST_ASSERT_EQUAL(0, (int)batch.len, "Batch flushed before it");
+    TEST_ASSERT_EQUAL(2 + (int)sizeof(big), bytes_waiting(fds[1]),
+                      "Both sent");
+    TEST_ASSERT_SUCCESS(xoe_transport_uncork(&writer), "Nothing left");
+    TEST_ASSERT_SUCCESS(xoe_transport_uncork(&writer), "Uncork is idempotent");
+
+    /* Rebinding drops the cork; datagrams are never gathered */
+    xoe_transport_cork(&writer, &batch);
+    xoe_transport_init_fd(&writer, fds[0]);
+    TEST_ASSERT_NULL(writer.batch, "Rebinding uncorks");
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_DGRAM, 0, dfds),
+                        "Datagram pair created");
+    xoe_transport_init_udp(&dgram, dfds[0], NULL);
+    TEST_ASSERT_EQUAL(E_NOT_SUPPORTED, xoe_transport_cork(&dgram, &batch),
+                      "Datagram kind not corked");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_cork(&writer, NULL),
+                      "No batch refused");
+
+    close(fds[0]);
+    close(fds[1]);
+    close(dfds[0]);
+    close(dfds[1]);
+}
+
+/**
+ * @brief Test a full non-blocking stream queues what it does not take
+ */
+void test_stream_queue(void) {
+    static xoe_transport_queue_t queue;
+    static char chunk[1024];
+    static char buffer[4096];
+    xoe_transport_t writer;
+    xoe_transport_t dgram;
+    struct iovec iov;
+    size_t sent = 0;
+    size_t received = 0;
+    size_t i;
+    int ordered = TRUE;
+    int sndbuf = 4096;
+    int fds[2];
+    int dfds[2];
+    int result;
+    int n;
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "Pair created");
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+    xoe_transport_init_fd(&writer, fds[0]);
+    TEST_ASSERT_SUCCESS(xoe_transport_set_queue(&writer, &queue), "Queue set");
+    TEST_ASSERT_EQUAL(0, (int)xoe_transport_queued(&writer), "Starts empty");
+
+    /* Fill the socket; the write that does not fit still succeeds */
+    iov.iov_base = chunk;
+    iov.iov_len = sizeof(chunk);
+    while (xoe_transport_queued(&writer) == 0 && sent < 1024 * 1024) {
+        for (i = 0; i < sizeof(chunk); i++) {
+            chunk[i] = (char)((sent + i) % 251);
+        }
+        TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, &iov, 1),
+                            "Write never waits");
+        sent += sizeof(chunk);
+    }
+    TEST_ASSERT(xoe_transport_queued(&writer) > 0, "Rest queued");
+    for (i = 0; i < sizeof(chunk); i++) {
+        chunk[i] = (char)((sent + i) % 251);
+    }
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, &iov, 1),
+                        "Later write queued behind");
+    sent += sizeof(chunk);
+    TEST_ASSERT_EQUAL(E_WOULD_BLOCK, xoe_transport_flush(&writer),
+                      "Flush leaves what the peer has not read");
+
+    /* The peer reads; each flush sends what now fits */
+    result = E_WOULD_BLOCK;
+    while (received < sent) {
+        n = (int)recv(fds[1], buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n > 0) {
+            for (i = 0; i < (size_t)n; i++) {
+                if (buffer[i] != (char)((received + i) % 251)) {
+                    ordered = FALSE;
+                }
+            }
+            received += (size_t)n;
+        }
+        if (result == E_WOULD_BLOCK) {
+            result = xoe_transport_flush(&writer);
+        }
+        if (n <= 0 && result != E_WOULD_BLOCK) {
+            break;
+        }
+    }
+    TEST_ASSERT_SUCCESS(result, "Flushed once drained");
+    TEST_ASSERT_EQUAL((int)sent, (int)received, "Every byte arrived");
+    TEST_ASSERT(ordered, "Order kept");
+    TEST_ASSERT_EQUAL(0, (int)xoe_transport_queued(&writer), "Queue empty");
+    TEST_ASSERT(queue.size <= XOE_TRANSPORT_QUEUE_KEEP,
+                "Emptied queue gave its memory back");
+
+    /* Rebinding detaches; datagram and unbound kinds take no queue */
+    xoe_transport_init_fd(&writer, fds[0]);
+    TEST_ASSERT_NULL(writer.queue, "Rebinding detaches the queue");
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_DGRAM, 0, dfds),
+                        "Datagram pair created");
+    xoe_transport_init_udp(&dgram, dfds[0], NULL);
+    TEST_ASSERT_EQUAL(E_NOT_SUPPORTED, xoe_transport_set_queue(&dgram, &queue),
+                      "Datagram kind not queued");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, xoe_transport_set_queue(NULL, &queue),
+                      "No transport refused");
+    xoe_transport_queue_free(&queue);
+
+    close(fds[0]);
+    close(fds[1]);
+    close(dfds[0]);
+    close(dfds[1]);
+}
+
+/**
+ * @brief Send @count small frames on a transport, corked into few writes
+ */
+static int send_small_frames(xoe_transport_t* t, int count) {
+    static xoe_transport_batch_t batch;
+    xoe_packet_t packet;
+    int result = 0;
+    int i;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = XOE_PROTOCOL_RAW;
+    packet.protocol_version = 1;
+    packet.payload = xoe_payload_alloc(100);
+    if (packet.payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    memset(packet.payload->data, 0x5A, 100);
+    xoe_transport_cork(t, &batch);
+    for (i = 0; i < count && result == 0; i++) {
+        result = xoe_wire_send_transport(t, &packet, 0);
+    }
+    if (xoe_transport_uncork(t) != 0 && result == 0) {
+        result = E_IO_ERROR;
+    }
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Drain every frame the socket holds through a decoder
+ *
+ * @return Frames decoded
+ */
+static int drain_frames(xoe_wire_decoder_t* decoder, xoe_transport_t* t) {
+    xoe_packet_t packet;
+    int frames = 0;
+
+    while (xoe_wire_decoder_recv_transport(decoder, t) > 0) {
+        while (xoe_wire_decoder_next(decoder, &packet) == 1) {
+            xoe_wire_free_payload(&packet);
+            frames++;
+        }
+    }
+    return frames;
+}
+
+/**
+ * @brief Test the decoder's staging buffer grows under load and shrinks back
+ */
+void test_decoder_buffer_adapts(void) {
+    xoe_transport_t writer;
+    xoe_transport_t reader;
+    xoe_wire_decoder_t decoder;
+    int frames;
+    int fds[2];
+    int i;
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "Pair created");
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL, 0) | O_NONBLOCK);
+    xoe_transport_init_fd(&writer, fds[0]);
+    xoe_transport_init_fd(&reader, fds[1]);
+    if (xoe_wire_decoder_init(&decoder, 1024) != 0) {
+        TEST_SKIP("decoder init failed");
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    /* Fixed by default */
+    TEST_ASSERT_SUCCESS(send_small_frames(&writer, 100), "Frames sent");
+    TEST_ASSERT_EQUAL(100, drain_frames(&decoder, &reader), "All decoded");
+    TEST_ASSERT_EQUAL(1024, (int)decoder.buffer_size, "Size fixed");
+
+    /* A backlog doubles it read by read, up to the limit */
+    xoe_wire_decoder_set_max_buffer(&decoder, 8192);
+    TEST_ASSERT_SUCCESS(send_small_frames(&writer, 300), "Backlog sent");
+    TEST_ASSERT_EQUAL(300, drain_frames(&decoder, &reader), "All decoded");
+    TEST_ASSERT_EQUAL(8192, (int)decoder.buffer_size, "Grown to the limit");
+
+    /* A long run of short reads halves it */
+    frames = 0;
+    for (i = 0; i < XOE_WIRE_DECODER_SHRINK_READS; i++) {
+        send_small_frames(&writer, 1);
+        frames += drain_frames(&decoder, &reader);
+    }
+    TEST_ASSERT_EQUAL(XOE_WIRE_DECODER_SHRINK_READS, frames, "All decoded");
+    TEST_ASSERT_EQUAL(4096, (int)decoder.buffer_size, "Halved");
+
+    xoe_wire_decoder_cleanup(&decoder);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * Datagram Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test datagram boundaries, gathering and truncation
+ */
+void test_dgram_boundaries(void) {
+    xoe_transport_t writer;
+    xoe_transport_t reader;
+    struct iovec iov[2];
+    char buffer[64];
+    int fds[2];
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), "Pair created");
+    xoe_transport_init_udp(&writer, fds[0], NULL);
+    xoe_transport_init_udp(&reader, fds[1], NULL);
+
+    iov[0].iov_base = buffer;
+    iov[0].iov_len = sizeof(buffer);
+    TEST_ASSERT_EQUAL(E_WOULD_BLOCK, xoe_transport_readv(&reader, iov, 1),
+                      "Reads never wait");
+
+    iov[0].iov_base = "head";
+    iov[0].iov_len = 4;
+    iov[1].iov_base = "body";
+    iov[1].iov_len = 4;
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 2), "First datagram");
+    TEST_ASSERT_SUCCESS(xoe_transport_writev(&writer, iov, 1), "Second datagram");
+
+    iov[0].iov_base = buffer;
+    iov[0].iov_len = sizeof(buffer);
+    TEST_ASSERT_EQUAL(8, xoe_transport_readv(&reader, iov, 1),
+                      "Buffers gathered into one datagram");
+    TEST_ASSERT(memcmp(buffer, "headbody", 8) == 0, "Datagram kept");
+    TEST_ASSERT_EQUAL(4, xoe_transport_readv(&reader, iov, 1),
+                      "Boundary kept");
+
+    /* A datagram larger than the buffers is dropped, not split */
+    memset(buffer, 0, sizeof(buffer));
+    TEST_ASSERT_EQUAL(40, (int)send(fds[0], buffer, 40, 0), "Raw send");
+    iov[0].iov_len = 20;
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR, xoe_transport_readv(&reader, iov, 1),
+                      "Truncated datagram refused");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Transport Unit Tests ===\n\n");
+
+    /* Binding tests */
+    run_test("test_init_and_arguments", test_init_and_arguments);
+
+    /* Stream tests */
+    run_test("test_stream_readv_writev", test_stream_readv_writev);
+    run_test("test_stream_wire_frames", test_stream_wire_frames);
+    run_test("test_stream_cork", test_stream_cork);
+    run_test("test_stream_queue", test_stream_queue);
+    run_test("test_decoder_buffer_adapts", test_decoder_buffer_adapts);
+
+    /* Datagram tests */
+    run_test("test_dgram_boundaries", test_dgram_boundaries);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
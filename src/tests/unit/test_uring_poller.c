@@ -0,0 +1,186 @@
+/**
+ * @file test_uring_poller.c
+ * @brief Unit tests for the io_uring readiness poller
+ *
+ * Readability over a socketpair, level-triggered re-reporting of unread
+ * data, write interest on and off, removal (no further events) and a
+ * descriptor number reused after close. Skipped when the kernel refuses
+ * io_uring.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/uring_poller.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Wait used where an event is expected (ms) */
+#define TEST_WAIT_MS 1000
+
+/* Wait used where no event is expected (ms) */
+#define TEST_QUIET_MS 50
+
+static uring_poller_t *poller;
+static int tag_a;
+static int tag_b;
+
+/**
+ * @brief Create the poller, or report the test as skipped
+ */
+static int setup(void)
+{
+    int result = uring_poller_create(&poller);
+
+    if (result == E_NOT_SUPPORTED) {
+        TEST_SKIP("io_uring not available on this kernel");
+        return FALSE;
+    }
+    TEST_ASSERT_EQUAL(0, result, "Create poller");
+    return result == 0;
+}
+
+/* ============================================================================
+ * Readiness Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test data is reported, and reported again while left unread
+ */
+void test_readable_level_triggered(void) {
+    uring_poller_event_t events[4];
+    char buf[8];
+    int sv[2];
+    int n;
+
+    if (!setup()) {
+        return;
+    }
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv),
+                      "socketpair");
+    TEST_ASSERT_EQUAL(0, uring_poller_add(poller, sv[0], &tag_a), "Add");
+    TEST_ASSERT_ERROR(uring_poller_add(poller, sv[0], &tag_a),
+                      E_INVALID_ARGUMENT, "Second add refused");
+
+    n = uring_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Idle socket reports nothing");
+
+    TEST_ASSERT_EQUAL(1, (int)write(sv[1], "x", 1), "Write");
+    n = uring_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Data reported");
+    TEST_ASSERT(events[0].data == &tag_a, "Event carries its data");
+    TEST_ASSERT(events[0].readable && !events[0].writable, "Readable only");
+
+    n = uring_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Unread data reported again");
+
+    TEST_ASSERT_EQUAL(1, (int)read(sv[0], buf, sizeof(buf)), "Drain");
+    n = uring_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Drained socket quiet");
+
+    close(sv[1]);
+    n = uring_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT(n == 1 && events[0].readable, "Hangup reported as readable");
+
+    uring_poller_remove(poller, sv[0]);
+    close(sv[0]);
+    uring_poller_destroy(poller);
+}
+
+/**
+ * @brief Test write interest is reported only while enabled
+ */
+void test_write_interest(void) {
+    uring_poller_event_t events[4];
+    int sv[2];
+    int n;
+
+    if (!setup()) {
+        return;
+    }
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    uring_poller_add(poller, sv[0], &tag_a);
+
+    TEST_ASSERT_ERROR(uring_poller_set_write(poller, sv[1], &tag_b, TRUE),
+                      E_INVALID_ARGUMENT, "Unwatched descriptor refused");
+
+    TEST_ASSERT_EQUAL(0, uring_poller_set_write(poller, sv[0], &tag_b, TRUE),
+                      "Enable write interest");
+    n = uring_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Writable reported");
+    TEST_ASSERT(events[0].writable, "Writable flag set");
+    TEST_ASSERT(events[0].data == &tag_b, "Updated data returned");
+
+    uring_poller_set_write(poller, sv[0], &tag_b, FALSE);
+    n = uring_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Quiet once write interest dropped");
+
+    close(sv[0]);
+    close(sv[1]);
+    uring_poller_destroy(poller);
+}
+
+/* ============================================================================
+ * Removal Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test removed descriptors stay silent, and a reused number works
+ */
+void test_remove_and_reuse(void) {
+    uring_poller_event_t events[4];
+    int sv[2];
+    int reused[2];
+    int n;
+
+    if (!setup()) {
+        return;
+    }
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    uring_poller_add(poller, sv[0], &tag_a);
+    uring_poller_wait(poller, events, 4, 0);    /* Poll now in flight */
+
+    uring_poller_remove(poller, sv[0]);
+    write(sv[1], "x", 1);
+    n = uring_poller_wait(poller, events, 4, TEST_QUIET_MS);
+    TEST_ASSERT_EQUAL(0, n, "Removed descriptor reports nothing");
+
+    /* The lowest free number comes back for the next socketpair */
+    close(sv[0]);
+    close(sv[1]);
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, reused),
+                      "socketpair");
+    TEST_ASSERT_EQUAL(0, uring_poller_add(poller, reused[0], &tag_b),
+                      "Re-add reused number");
+    write(reused[1], "y", 1);
+    n = uring_poller_wait(poller, events, 4, TEST_WAIT_MS);
+    TEST_ASSERT_EQUAL(1, n, "Reused descriptor reported once");
+    TEST_ASSERT(events[0].data == &tag_b, "With its new data");
+
+    close(reused[0]);
+    close(reused[1]);
+    uring_poller_destroy(poller);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== io_uring Poller Unit Tests ===\n\n");
+
+    /* Readiness tests */
+    run_test("test_readable_level_triggered", test_readable_level_triggered);
+    run_test("test_write_interest", test_write_interest);
+
+    /* Removal tests */
+    run_test("test_remove_and_reuse", test_remove_and_reuse);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,263 @@
+/**
+ * @file test_usb_batch.c
+ * @brief Unit tests for the USB client's batched send path
+ *
+ * Tests that URBs leave alone while batching is off or the link is idle,
+ * that small URBs sent while a write is in progress share one batch
+ * frame written ahead of the next large URB, and that large URBs framed
+ * in place are sent unchanged.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_batch.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Larger than USB_BATCH_MAX_URB_DATA */
+#define TEST_LARGE_SIZE 1000
+
+static void init_test_urb(usb_urb_header_t* urb, uint32_t seqnum,
+                          uint32_t len) {
+    memset(urb, 0, sizeof(*urb));
+    urb->command = USB_CMD_SUBMIT;
+    urb->seqnum = seqnum;
+    urb->device_id = 0x12345678;
+    urb->endpoint = 0x81;
+    urb->transfer_type = USB_TRANSFER_INTERRUPT;
+    urb->transfer_length = len;
+    urb->actual_length = len;
+}
+
+/**
+ * @brief Receive one frame and decode its URB header
+ *
+ * @param data Receives the URB data (USB_MAX_DATA_SIZE bytes)
+ * @return 0 on success, negative error code otherwise
+ */
+static int recv_test_urb(int fd, usb_urb_header_t* urb, uint8_t* data,
+                         uint32_t* data_len) {
+    xoe_packet_t packet;
+    int result;
+
+    result = xoe_wire_recv(fd, &packet);
+    if (result != 0) {
+        return result;
+    }
+    *data_len = USB_MAX_DATA_SIZE;
+    result = usb_protocol_decapsulate(&packet, urb, data, data_len);
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Check nothing is waiting on a socket
+ */
+static int socket_empty(int fd) {
+    char byte;
+
+    return recv(fd, &byte, 1, MSG_DONTWAIT) < 0 &&
+           (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/* ============================================================================
+ * Batching Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test URBs leave in frames of their own without batching
+ */
+void test_disabled_and_idle(void) {
+    usb_batch_t batch;
+    usb_urb_header_t urb;
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint32_t data_len;
+    int pair[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0 ||
+        usb_batch_init(&batch) != 0) {
+        TEST_SKIP("setup failed");
+        return;
+    }
+
+    init_test_urb(&urb, 1, 8);
+    memset(data, 0x11, 8);
+    TEST_ASSERT_SUCCESS(usb_batch_send(&batch, pair[0], &urb, data, 8),
+                        "Send without batching");
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb, data, &data_len),
+                        "Frame should arrive");
+    TEST_ASSERT_EQUAL(USB_CMD_SUBMIT, urb.command, "Plain URB");
+    TEST_ASSERT_EQUAL(8, (int)data_len, "URB data");
+
+    /* An idle link writes at once, without a batch around one URB */
+    usb_batch_set_enabled(&batch, TRUE);
+    init_test_urb(&urb, 2, 8);
+    TEST_ASSERT_SUCCESS(usb_batch_send(&batch, pair[0], &urb, data, 8),
+                        "Send on an idle link");
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb, data, &data_len),
+                        "Frame should arrive");
+    TEST_ASSERT_EQUAL(USB_CMD_SUBMIT, urb.command, "Still a plain URB");
+    TEST_ASSERT_EQUAL(2, (int)urb.seqnum, "Seqnum kept");
+    TEST_ASSERT(data_len == 8 && data[0] == 0x11, "Data kept");
+    TEST_ASSERT_EQUAL(2, (int)batch.frames_sent, "Two frames");
+    TEST_ASSERT_EQUAL(0, (int)batch.batches_sent, "No batches");
+
+    usb_batch_cleanup(&batch);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+/**
+ * @brief Test URBs sent during a write share a frame, ahead of later URBs
+ */
+void test_busy_link_batches(void) {
+    usb_batch_t batch;
+    usb_urb_header_t urb;
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint8_t large[TEST_LARGE_SIZE];
+    const uint8_t* entry;
+    uint32_t entry_len;
+    uint32_t data_len;
+    uint32_t offset = 0;
+    int pair[2];
+    int i;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0 ||
+        usb_batch_init(&batch) != 0) {
+        TEST_SKIP("setup failed");
+        return;
+    }
+    usb_batch_set_enabled(&batch, TRUE);
+
+    /* Another thread is writing: small URBs wait in the batch */
+    batch.sending = TRUE;
+    for (i = 0; i < 3; i++) {
+        init_test_urb(&urb, 10 + (uint32_t)i, 4);
+        memset(data, i, 4);
+        TEST_ASSERT_SUCCESS(usb_batch_send(&batch, pair[0], &urb, data, 4),
+                            "Queued behind the write");
+    }
+    TEST_ASSERT_EQUAL(3, batch.count, "Three URBs batched");
+    TEST_ASSERT(socket_empty(pair[1]), "Nothing written yet");
+    batch.sending = FALSE;
+
+    /* A large URB goes alone, after the batch queued before it */
+    memset(large, 0x5A, sizeof(large));
+    init_test_urb(&urb, 20, sizeof(large));
+    urb.transfer_type = USB_TRANSFER_BULK;
+    TEST_ASSERT_SUCCESS(usb_batch_send(&batch, pair[0], &urb, large,
+                                       sizeof(large)),
+                        "Large URB sent");
+
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb, data, &data_len),
+                        "Batch should arrive first");
+    TEST_ASSERT_EQUAL(USB_CMD_BATCH, urb.command, "Batch frame");
+    TEST_ASSERT_EQUAL(3, urb.number_of_packets, "Entry count");
+
+    packet.protocol_id = XOE_PROTOCOL_USB;
+    packet.protocol_version = XOE_PROTOCOL_USB_VERSION;
+    packet.payload = &payload;
+    packet.checksum = 0;
+    payload.owns_data = FALSE;
+    for (i = 0; i < 3; i++) {
+        usb_urb_header_t inner;
+        uint8_t inner_data[8];
+        uint32_t inner_len = sizeof(inner_data);
+
+        TEST_ASSERT_SUCCESS(usb_protocol_batch_next(data, data_len, &offset,
+                                                    &entry, &entry_len),
+                            "Entry present");
+        payload.data = (void*)entry;
+        payload.len = entry_len;
+        TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &inner,
+                                                     inner_data, &inner_len),
+                            "Entry decodes");
+        TEST_ASSERT_EQUAL(10 + i, (int)inner.seqnum, "In send order");
+        TEST_ASSERT(inner_len == 4 && inner_data[0] == (uint8_t)i, "Entry data");
+    }
+
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb, data, &data_len),
+                        "Large URB should follow");
+    TEST_ASSERT_EQUAL(20, (int)urb.seqnum, "Large URB");
+    TEST_ASSERT_EQUAL(TEST_LARGE_SIZE, (int)data_len, "Large URB data");
+
+    TEST_ASSERT_EQUAL(2, (int)batch.frames_sent, "Two frames");
+    TEST_ASSERT_EQUAL(1, (int)batch.batches_sent, "One batch");
+    TEST_ASSERT_EQUAL(3, (int)batch.batched_urbs, "Three URBs batched");
+    TEST_ASSERT_EQUAL(3, batch.largest_batch, "Largest batch");
+
+    usb_batch_cleanup(&batch);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+/**
+ * @brief Test in-place sends: large URBs unchanged, small ones batched
+ */
+void test_send_in_place(void) {
+    usb_batch_t batch;
+    usb_urb_header_t urb;
+    uint8_t frame[USB_URB_HEADER_WIRE_SIZE + TEST_LARGE_SIZE];
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint32_t data_len;
+    int pair[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0 ||
+        usb_batch_init(&batch) != 0) {
+        TEST_SKIP("setup failed");
+        return;
+    }
+    usb_batch_set_enabled(&batch, TRUE);
+
+    memset(frame + USB_URB_HEADER_WIRE_SIZE, 0x77, TEST_LARGE_SIZE);
+    init_test_urb(&urb, 30, TEST_LARGE_SIZE);
+    TEST_ASSERT_SUCCESS(usb_batch_send_in_place(&batch, pair[0], &urb,
+                                                frame + USB_URB_HEADER_WIRE_SIZE,
+                                                TEST_LARGE_SIZE),
+                        "Large URB sent in place");
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb, data, &data_len),
+                        "Frame should arrive");
+    TEST_ASSERT_EQUAL(30, (int)urb.seqnum, "Seqnum");
+    TEST_ASSERT(data_len == TEST_LARGE_SIZE && data[0] == 0x77 &&
+                data[TEST_LARGE_SIZE - 1] == 0x77, "Data sent unchanged");
+
+    /* A small one is copied into a batch while the link is busy */
+    batch.sending = TRUE;
+    init_test_urb(&urb, 31, 16);
+    TEST_ASSERT_SUCCESS(usb_batch_send_in_place(&batch, pair[0], &urb,
+                                                frame + USB_URB_HEADER_WIRE_SIZE,
+                                                16),
+                        "Small URB batched");
+    TEST_ASSERT_EQUAL(1, batch.count, "Copied into the batch");
+    batch.sending = FALSE;
+
+    usb_batch_cleanup(&batch);
+    close(pair[0]);
+    close(pair[1]);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB Batch Unit Tests ===\n\n");
+
+    /* Batching tests */
+    run_test("test_disabled_and_idle", test_disabled_and_idle);
+    run_test("test_busy_link_batches", test_busy_link_batches);
+    run_test("test_send_in_place", test_send_in_place);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file test_usb_desc_cache.c
+ * @brief Unit tests for the cached USB descriptors
+ *
+ * Tests adding and finding descriptors, answering GET_DESCRIPTOR setup
+ * packets (cut to wLength, other requests refused), the wire form round
+ * trip, and rejection of cut-off or oversized records.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_desc_cache.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Device descriptor of a made-up full-speed device */
+static const uint8_t test_device_desc[18] = {
+    18, USB_DESC_TYPE_DEVICE, 0x00, 0x02, 0x00, 0x00, 0x00, 64,
+    0x34, 0x12, 0x78, 0x56, 0x00, 0x01, 1, 2, 0, 1
+};
+
+/* String descriptor 2 ("Hi") in US English */
+static const uint8_t test_string_desc[6] = {
+    6, USB_DESC_TYPE_STRING, 'H', 0, 'i', 0
+};
+
+/**
+ * @brief Build a GET_DESCRIPTOR setup packet
+ */
+static void get_descriptor_setup(uint8_t setup[8], uint8_t type,
+                                 uint8_t index, uint16_t langid,
+                                 uint16_t length) {
+    setup[0] = USB_REQ_TYPE_STANDARD_IN;
+    setup[1] = USB_REQ_GET_DESCRIPTOR;
+    setup[2] = index;
+    setup[3] = type;
+    setup[4] = (uint8_t)langid;
+    setup[5] = (uint8_t)(langid >> 8);
+    setup[6] = (uint8_t)length;
+    setup[7] = (uint8_t)(length >> 8);
+}
+
+/**
+ * @brief Fill a cache with the test descriptors
+ */
+static void fill_test_cache(usb_desc_cache_t* cache) {
+    usb_desc_cache_init(cache);
+    usb_desc_cache_add(cache, USB_DESC_TYPE_DEVICE, 0, 0,
+                       test_device_desc, sizeof(test_device_desc));
+    usb_desc_cache_add(cache, USB_DESC_TYPE_STRING, 2, 0x0409,
+                       test_string_desc, sizeof(test_string_desc));
+}
+
+/* ============================================================================
+ * Cache Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test descriptors are found by type, index and language
+ */
+void test_add_and_find(void) {
+    usb_desc_cache_t cache;
+    const uint8_t* desc;
+    uint32_t length;
+
+    fill_test_cache(&cache);
+    TEST_ASSERT_EQUAL(2, cache.count, "Two records");
+    TEST_ASSERT_EQUAL(2 * USB_DESC_RECORD_HEADER_SIZE + 18 + 6,
+                      (int)cache.size, "Wire size");
+
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_find(&cache, USB_DESC_TYPE_DEVICE, 0, 0,
+                                             &desc, &length), "Device");
+    TEST_ASSERT_EQUAL(18, (int)length, "Device length");
+    TEST_ASSERT(memcmp(desc, test_device_desc, 18) == 0, "Device bytes");
+
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_find(&cache, USB_DESC_TYPE_STRING, 2,
+                                             0x0409, &desc, &length), "String");
+    TEST_ASSERT_EQUAL('H', desc[2], "String bytes");
+    TEST_ASSERT_ERROR(usb_desc_cache_find(&cache, USB_DESC_TYPE_STRING, 2,
+                                          0x0407, &desc, &length),
+                      E_NOT_FOUND, "Other language");
+    TEST_ASSERT_ERROR(usb_desc_cache_find(&cache, USB_DESC_TYPE_CONFIG, 0, 0,
+                                          &desc, &length),
+                      E_NOT_FOUND, "Not cached");
+}
+
+/**
+ * @brief Test GET_DESCRIPTOR requests are answered and cut to wLength
+ */
+void test_answer_setup(void) {
+    usb_desc_cache_t cache;
+    uint8_t setup[8];
+    const uint8_t* desc;
+    uint32_t length;
+
+    fill_test_cache(&cache);
+
+    /* Hosts ask for 64 bytes first, then the exact size */
+    get_descriptor_setup(setup, USB_DESC_TYPE_DEVICE, 0, 0, 64);
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_answer(&cache, setup, &desc, &length),
+                      "Answered");
+    TEST_ASSERT_EQUAL(18, (int)length, "Whole descriptor");
+
+    get_descriptor_setup(setup, USB_DESC_TYPE_DEVICE, 0, 0, 8);
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_answer(&cache, setup, &desc, &length),
+                      "Answered");
+    TEST_ASSERT_EQUAL(8, (int)length, "Cut to wLength");
+
+    get_descriptor_setup(setup, USB_DESC_TYPE_STRING, 2, 0x0409, 255);
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_answer(&cache, setup, &desc, &length),
+                      "String answered");
+    TEST_ASSERT_EQUAL(6, (int)length, "String length");
+
+    /* Class requests and other directions go to the device */
+    get_descriptor_setup(setup, USB_DESC_TYPE_DEVICE, 0, 0, 64);
+    setup[0] = 0x81;
+    TEST_ASSERT_ERROR(usb_desc_cache_answer(&cache, setup, &desc, &length),
+                      E_NOT_FOUND, "Interface recipient");
+    get_descriptor_setup(setup, USB_DESC_TYPE_DEVICE, 0, 0, 64);
+    setup[1] = 0x00;
+    TEST_ASSERT_ERROR(usb_desc_cache_answer(&cache, setup, &desc, &length),
+                      E_NOT_FOUND, "GET_STATUS");
+    get_descriptor_setup(setup, USB_DESC_TYPE_CONFIG, 0, 0, 9);
+    TEST_ASSERT_ERROR(usb_desc_cache_answer(&cache, setup, &desc, &length),
+                      E_NOT_FOUND, "Not cached");
+}
+
+/**
+ * @brief Test the wire form loads back into an equal cache
+ */
+void test_parse_roundtrip(void) {
+    usb_desc_cache_t cache;
+    usb_desc_cache_t copy;
+    const uint8_t* desc;
+    uint32_t length;
+
+    fill_test_cache(&cache);
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_parse(&copy, cache.data, cache.size),
+                      "Parsed");
+    TEST_ASSERT_EQUAL(2, copy.count, "Both records");
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_find(&copy, USB_DESC_TYPE_STRING, 2,
+                                             0x0409, &desc, &length), "String");
+    TEST_ASSERT(length == sizeof(test_string_desc) &&
+                memcmp(desc, test_string_desc, length) == 0, "Bytes kept");
+
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_parse(&copy, NULL, 0), "Empty");
+    TEST_ASSERT_EQUAL(0, copy.count, "No records");
+}
+
+/**
+ * @brief Test malformed wire data and a full cache are refused
+ */
+void test_limits(void) {
+    usb_desc_cache_t* cache;
+    uint8_t record[USB_DESC_RECORD_HEADER_SIZE + 4] = {
+        USB_DESC_TYPE_STRING, 1, 0x04, 0x09, 0x00, 0x04, 4, 3, 'A', 0
+    };
+    uint8_t big[USB_DESC_CACHE_MAX_SIZE];
+    int i;
+
+    cache = (usb_desc_cache_t*)malloc(sizeof(*cache));
+    TEST_ASSERT_NOT_NULL(cache, "Allocated");
+    if (cache == NULL) {
+        return;
+    }
+
+    TEST_ASSERT_EQUAL(0, usb_desc_cache_parse(cache, record, sizeof(record)),
+                      "Well formed");
+    TEST_ASSERT_ERROR(usb_desc_cache_parse(cache, record, sizeof(record) - 1),
+                      E_PROTOCOL_ERROR, "Descriptor cut off");
+    TEST_ASSERT_EQUAL(0, cache->count, "Left empty");
+    TEST_ASSERT_ERROR(usb_desc_cache_parse(cache, record, 3),
+                      E_PROTOCOL_ERROR, "Header cut off");
+    record[5] = 0;
+    TEST_ASSERT_ERROR(usb_desc_cache_parse(cache, record, sizeof(record)),
+                      E_PROTOCOL_ERROR, "Empty descriptor");
+
+    memset(big, 0, sizeof(big));
+    TEST_ASSERT_ERROR(usb_desc_cache_add(cache, USB_DESC_TYPE_CONFIG, 0, 0, big,
+                                         sizeof(big)),
+                      E_BUFFER_TOO_SMALL, "Larger than the cache");
+
+    usb_desc_cache_init(cache);
+    for (i = 0; i < USB_DESC_CACHE_MAX_RECORDS; i++) {
+        TEST_ASSERT_EQUAL(0, usb_desc_cache_add(cache, USB_DESC_TYPE_STRING,
+                                                (uint8_t)i, 0x0409,
+                                                test_string_desc,
+                                                sizeof(test_string_desc)),
+                          "Added");
+    }
+    TEST_ASSERT_ERROR(usb_desc_cache_add(cache, USB_DESC_TYPE_STRING, 200,
+                                         0x0409, test_string_desc,
+                                         sizeof(test_string_desc)),
+                      E_BUFFER_TOO_SMALL, "Out of records");
+    TEST_ASSERT_EQUAL(USB_DESC_CACHE_MAX_RECORDS, cache->count,
+                      "Cache unchanged");
+
+    free(cache);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB Descriptor Cache Unit Tests ===\n\n");
+
+    /* Cache tests */
+    run_test("test_add_and_find", test_add_and_find);
+    run_test("test_answer_setup", test_answer_setup);
+    run_test("test_parse_roundtrip", test_parse_roundtrip);
+    run_test("test_limits", test_limits);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
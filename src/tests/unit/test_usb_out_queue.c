@@ -0,0 +1,402 @@
+/**
+ * @file test_usb_out_queue.c
+ * @brief Unit tests for the USB client per-device OUT queue
+ *
+ * Tests FIFO order through the front/consume pair, a push waiting on a
+ * full queue until the writer consumes, close waking blocked pushes and
+ * fronts, the jitter buffer prefill, the non-blocking front used by the
+ * completion-driven writer, cancelling queued URBs, batching freed slots
+ * into credit, and argument limits.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_out_queue.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* Slot size used by every test */
+#define TEST_SLOT_SIZE 64
+
+typedef struct {
+    usb_out_queue_t* queue;
+    int result;
+    volatile int done;
+} push_job_t;
+
+static void* push_thread(void* arg) {
+    push_job_t* job = (push_job_t*)arg;
+    unsigned char data[4] = {9, 9, 9, 9};
+
+    job->result = usb_out_queue_push(job->queue, data, sizeof(data));
+    job->done = 1;
+    return NULL;
+}
+
+static void* front_thread(void* arg) {
+    push_job_t* job = (push_job_t*)arg;
+    const unsigned char* data;
+    uint32_t length;
+
+    job->result = usb_out_queue_front(job->queue, &data, &length);
+    job->done = 1;
+    return NULL;
+}
+
+/* ============================================================================
+ * Queue Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test URBs come out in order with their lengths
+ */
+void test_fifo_order(void) {
+    usb_out_queue_t queue;
+    unsigned char data[TEST_SLOT_SIZE];
+    const unsigned char* front;
+    uint32_t length;
+    int i;
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 3, TEST_SLOT_SIZE), "Init");
+
+    /* Wrap around the ring twice */
+    for (i = 0; i < 7; i++) {
+        memset(data, i + 1, sizeof(data));
+        TEST_ASSERT_EQUAL(0, usb_out_queue_push(&queue, data, (uint32_t)(i + 1)),
+                          "Push");
+        TEST_ASSERT_EQUAL(0, usb_out_queue_front(&queue, &front, &length),
+                          "Front");
+        TEST_ASSERT_EQUAL(i + 1, (int)length, "Length kept");
+        TEST_ASSERT_EQUAL(i + 1, front[0], "Data kept");
+        usb_out_queue_consume(&queue);
+    }
+
+    for (i = 0; i < 3; i++) {
+        memset(data, 0x40 + i, sizeof(data));
+        usb_out_queue_push(&queue, data, TEST_SLOT_SIZE);
+    }
+    for (i = 0; i < 3; i++) {
+        usb_out_queue_front(&queue, &front, &length);
+        TEST_ASSERT_EQUAL(0x40 + i, front[TEST_SLOT_SIZE - 1], "Oldest first");
+        usb_out_queue_consume(&queue);
+    }
+    TEST_ASSERT_EQUAL(10, (int)queue.urbs_queued, "Counted");
+
+    usb_out_queue_cleanup(&queue);
+}
+
+/**
+ * @brief Test a push on a full queue waits for the writer to consume
+ */
+void test_full_queue_waits(void) {
+    usb_out_queue_t queue;
+    unsigned char data[4] = {1, 2, 3, 4};
+    const unsigned char* front;
+    uint32_t length;
+    push_job_t job;
+    pthread_t thread;
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 2, TEST_SLOT_SIZE), "Init");
+    usb_out_queue_push(&queue, data, sizeof(data));
+    usb_out_queue_push(&queue, data, sizeof(data));
+
+    job.queue = &queue;
+    job.result = -1;
+    job.done = 0;
+    pthread_create(&thread, NULL, push_thread, &job);
+    usleep(50000);
+    TEST_ASSERT_EQUAL(0, job.done, "Push waits while full");
+
+    /* The slot being written stays owned until consumed */
+    usb_out_queue_front(&queue, &front, &length);
+    usleep(20000);
+    TEST_ASSERT_EQUAL(0, job.done, "Front alone frees nothing");
+    usb_out_queue_consume(&queue);
+
+    pthread_join(thread, NULL);
+    TEST_ASSERT_EQUAL(0, job.result, "Push completed after consume");
+    TEST_ASSERT_EQUAL(1, (int)queue.push_waits, "Wait counted");
+    TEST_ASSERT_EQUAL(2, queue.count, "Queue full again");
+
+    usb_out_queue_cleanup(&queue);
+}
+
+/**
+ * @brief Test close wakes waiting pushes and fronts
+ */
+void test_close_wakes(void) {
+    usb_out_queue_t queue;
+    unsigned char data[4] = {1, 2, 3, 4};
+    const unsigned char* front;
+    uint32_t length;
+    push_job_t job;
+    pthread_t thread;
+
+    /* Writer waiting for data */
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 1, TEST_SLOT_SIZE), "Init");
+    job.queue = &queue;
+    job.result = 0;
+    job.done = 0;
+    pthread_create(&thread, NULL, front_thread, &job);
+    usleep(20000);
+    usb_out_queue_close(&queue);
+    pthread_join(thread, NULL);
+    TEST_ASSERT_ERROR(job.result, E_INVALID_STATE, "Front woken by close");
+    usb_out_queue_cleanup(&queue);
+
+    /* Network thread waiting for room */
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 1, TEST_SLOT_SIZE), "Init");
+    usb_out_queue_push(&queue, data, sizeof(data));
+    job.result = 0;
+    job.done = 0;
+    pthread_create(&thread, NULL, push_thread, &job);
+    usleep(20000);
+    usb_out_queue_close(&queue);
+    pthread_join(thread, NULL);
+    TEST_ASSERT_ERROR(job.result, E_INVALID_STATE, "Push woken by close");
+    TEST_ASSERT_ERROR(usb_out_queue_front(&queue, &front, &length),
+                      E_INVALID_STATE, "Queued data discarded");
+    usb_out_queue_cleanup(&queue);
+}
+
+/**
+ * @brief Test the writer waits for the prefill, again after running dry
+ */
+void test_prefill(void) {
+    usb_out_queue_t queue;
+    unsigned char data[4] = {1, 2, 3, 4};
+    const unsigned char* front;
+    uint32_t length;
+    int packets;
+    push_job_t job;
+    pthread_t thread;
+    int round;
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 4, TEST_SLOT_SIZE), "Init");
+    usb_out_queue_set_prefill(&queue, 2);
+    job.queue = &queue;
+
+    for (round = 0; round < 2; round++) {
+        job.result = -1;
+        job.done = 0;
+        pthread_create(&thread, NULL, front_thread, &job);
+
+        usb_out_queue_push_iso(&queue, data, sizeof(data), 8);
+        usleep(30000);
+        TEST_ASSERT_EQUAL(0, job.done, "Held below the prefill");
+
+        usb_out_queue_push_iso(&queue, data, sizeof(data), 8);
+        pthread_join(thread, NULL);
+        TEST_ASSERT_EQUAL(0, job.result, "Released at the prefill");
+
+        /* Drain: the writer must wait for the prefill again */
+        TEST_ASSERT_EQUAL(0, usb_out_queue_front_iso(&queue, &front, &length,
+                                                     &packets), "Front");
+        TEST_ASSERT_EQUAL(8, packets, "Packet count kept");
+        usb_out_queue_consume(&queue);
+        usb_out_queue_consume(&queue);
+    }
+
+    TEST_ASSERT_EQUAL(2, (int)queue.underruns, "Every drain counted");
+
+    /* A prefill beyond the depth could never be reached */
+    usb_out_queue_set_prefill(&queue, 100);
+    TEST_ASSERT_EQUAL(4, queue.prefill, "Capped at depth");
+
+    usb_out_queue_cleanup(&queue);
+}
+
+/**
+ * @brief Test the non-blocking front: prefill, put back, missed tries
+ */
+void test_try_front(void) {
+    usb_out_queue_t queue;
+    unsigned char data[4] = {1, 2, 3, 4};
+    const unsigned char* front;
+    const unsigned char* other;
+    uint32_t length;
+    uint32_t seqnum;
+    int packets;
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 4, TEST_SLOT_SIZE), "Init");
+    usb_out_queue_set_prefill(&queue, 2);
+
+    TEST_ASSERT_ERROR(usb_out_queue_try_front_urb(&queue, &front, &length,
+                                                  &packets, &seqnum),
+                      E_WOULD_BLOCK, "Empty");
+    usb_out_queue_push_urb(&queue, 7, data, sizeof(data), 8);
+    TEST_ASSERT_ERROR(usb_out_queue_try_front_urb(&queue, &front, &length,
+                                                  &packets, &seqnum),
+                      E_WOULD_BLOCK, "Below the prefill");
+    usb_out_queue_push_urb(&queue, 8, data, sizeof(data), 8);
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_try_front_urb(&queue, &front, &length,
+                                                     &packets, &seqnum),
+                      "Ready at the prefill");
+    TEST_ASSERT_EQUAL(7, (int)seqnum, "Oldest first");
+    TEST_ASSERT_EQUAL(FALSE, usb_out_queue_put_back(&queue), "Nobody missed it");
+
+    /* A second writer is refused while the first holds the URB */
+    TEST_ASSERT_EQUAL(0, usb_out_queue_try_front_urb(&queue, &front, &length,
+                                                     &packets, &seqnum),
+                      "Same URB again");
+    TEST_ASSERT_EQUAL(7, (int)seqnum, "Put back in place");
+    TEST_ASSERT_ERROR(usb_out_queue_try_front_urb(&queue, &other, &length,
+                                                  &packets, &seqnum),
+                      E_WOULD_BLOCK, "Held by the other writer");
+    TEST_ASSERT_EQUAL(TRUE, usb_out_queue_put_back(&queue), "Told to retry");
+
+    /* A URB cancelled after it was put back is skipped */
+    TEST_ASSERT_EQUAL(0, usb_out_queue_cancel(&queue, 7), "Cancelled");
+    TEST_ASSERT_EQUAL(0, usb_out_queue_try_front_urb(&queue, &front, &length,
+                                                     &packets, &seqnum),
+                      "Next URB");
+    TEST_ASSERT_EQUAL(8, (int)seqnum, "Cancelled URB skipped");
+    usb_out_queue_consume(&queue);
+
+    usb_out_queue_close(&queue);
+    TEST_ASSERT_ERROR(usb_out_queue_try_front_urb(&queue, &front, &length,
+                                                  &packets, &seqnum),
+                      E_INVALID_STATE, "Closed");
+
+    usb_out_queue_cleanup(&queue);
+}
+
+/**
+ * @brief Test a cancelled URB is skipped and the writer's URB is kept
+ */
+void test_cancel(void) {
+    usb_out_queue_t queue;
+    unsigned char data[4] = {1, 2, 3, 4};
+    const unsigned char* front;
+    uint32_t length;
+    uint32_t seqnum;
+    int packets;
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 4, TEST_SLOT_SIZE), "Init");
+    usb_out_queue_push_urb(&queue, 10, data, 1, 0);
+    usb_out_queue_push_urb(&queue, 11, data, 2, 0);
+    usb_out_queue_push_urb(&queue, 12, data, 3, 0);
+
+    /* The writer holds 10 */
+    TEST_ASSERT_EQUAL(0, usb_out_queue_front_urb(&queue, &front, &length,
+                                                 &packets, &seqnum), "Front");
+    TEST_ASSERT_EQUAL(10, (int)seqnum, "Oldest first");
+    TEST_ASSERT_ERROR(usb_out_queue_cancel(&queue, 10), E_NOT_FOUND,
+                      "Held by the writer");
+    TEST_ASSERT_EQUAL(0, usb_out_queue_cancel(&queue, 11), "Queued");
+    TEST_ASSERT_ERROR(usb_out_queue_cancel(&queue, 11), E_NOT_FOUND,
+                      "Only once");
+    usb_out_queue_consume(&queue);
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_front_urb(&queue, &front, &length,
+                                                 &packets, &seqnum), "Front");
+    TEST_ASSERT_EQUAL(12, (int)seqnum, "Cancelled URB skipped");
+    TEST_ASSERT_EQUAL(3, (int)length, "Next URB intact");
+    usb_out_queue_consume(&queue);
+    TEST_ASSERT_EQUAL(0, queue.count, "Cancelled slot freed");
+    TEST_ASSERT_EQUAL(1, (int)queue.cancelled, "Counted");
+
+    TEST_ASSERT_ERROR(usb_out_queue_cancel(&queue, 0), E_INVALID_ARGUMENT,
+                      "Untagged URBs cannot be cancelled");
+
+    usb_out_queue_cleanup(&queue);
+}
+
+/**
+ * @brief Test freed slots are returned as credit in batches
+ */
+void test_take_credit(void) {
+    usb_out_queue_t queue;
+    unsigned char data[4] = {1, 2, 3, 4};
+    const unsigned char* front;
+    uint32_t length;
+    uint32_t seqnum;
+    int packets;
+    int i;
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 4, TEST_SLOT_SIZE), "Init");
+    for (i = 0; i < 4; i++) {
+        usb_out_queue_push_urb(&queue, (uint32_t)(i + 1), data, 4, 0);
+    }
+    TEST_ASSERT_EQUAL(0, usb_out_queue_take_credit(&queue, 2), "None freed");
+
+    usb_out_queue_front_urb(&queue, &front, &length, &packets, &seqnum);
+    usb_out_queue_consume(&queue);
+    TEST_ASSERT_EQUAL(0, usb_out_queue_take_credit(&queue, 2),
+                      "Below the batch while URBs are queued");
+
+    /* A cancelled slot is freed when the writer skips it */
+    TEST_ASSERT_EQUAL(0, usb_out_queue_cancel(&queue, 2), "Cancelled");
+    usb_out_queue_front_urb(&queue, &front, &length, &packets, &seqnum);
+    TEST_ASSERT_EQUAL(3, (int)seqnum, "Cancelled URB skipped");
+    TEST_ASSERT_EQUAL(2, usb_out_queue_take_credit(&queue, 2),
+                      "Batch reached");
+    TEST_ASSERT_EQUAL(0, usb_out_queue_take_credit(&queue, 2), "Taken once");
+
+    usb_out_queue_consume(&queue);
+    TEST_ASSERT_EQUAL(0, usb_out_queue_take_credit(&queue, 2),
+                      "Still one queued");
+    usb_out_queue_front_urb(&queue, &front, &length, &packets, &seqnum);
+    usb_out_queue_consume(&queue);
+    TEST_ASSERT_EQUAL(2, usb_out_queue_take_credit(&queue, 4),
+                      "An empty queue returns what it has");
+
+    usb_out_queue_cleanup(&queue);
+    TEST_ASSERT_EQUAL(0, usb_out_queue_take_credit(NULL, 1), "No queue");
+}
+
+/**
+ * @brief Test argument limits
+ */
+void test_limits(void) {
+    usb_out_queue_t queue;
+    unsigned char data[TEST_SLOT_SIZE + 1];
+
+    memset(data, 0, sizeof(data));
+    TEST_ASSERT_ERROR(usb_out_queue_init(&queue, 0, TEST_SLOT_SIZE),
+                      E_INVALID_ARGUMENT, "Zero depth");
+    TEST_ASSERT_ERROR(usb_out_queue_init(&queue, 1, 0),
+                      E_INVALID_ARGUMENT, "Zero slot size");
+
+    TEST_ASSERT_EQUAL(0, usb_out_queue_init(&queue, 1, TEST_SLOT_SIZE), "Init");
+    TEST_ASSERT_ERROR(usb_out_queue_push(&queue, data, TEST_SLOT_SIZE + 1),
+                      E_BUFFER_TOO_SMALL, "URB larger than a slot");
+    TEST_ASSERT_ERROR(usb_out_queue_push(&queue, data, 0),
+                      E_INVALID_ARGUMENT, "Empty URB");
+    TEST_ASSERT_EQUAL(0, queue.count, "Nothing queued");
+    usb_out_queue_cleanup(&queue);
+
+    /* Never initialized */
+    memset(&queue, 0, sizeof(queue));
+    usb_out_queue_close(&queue);
+    usb_out_queue_cleanup(&queue);
+    usb_out_queue_cleanup(NULL);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB OUT Queue Unit Tests ===\n\n");
+
+    /* Queue tests */
+    run_test("test_fifo_order", test_fifo_order);
+    run_test("test_full_queue_waits", test_full_queue_waits);
+    run_test("test_close_wakes", test_close_wakes);
+    run_test("test_prefill", test_prefill);
+    run_test("test_try_front", test_try_front);
+    run_test("test_cancel", test_cancel);
+    run_test("test_take_credit", test_take_credit);
+    run_test("test_limits", test_limits);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
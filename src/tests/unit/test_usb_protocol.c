@@ -0,0 +1,513 @@
+/**
+ * @file test_usb_protocol.c
+ * @brief Unit tests for USB URB encapsulation and URB size negotiation
+ *
+ * Tests round trips at the base and large URB sizes, framing in place,
+ * the size limits enforced by usb_protocol_encapsulate() and
+ * usb_protocol_decapsulate(),
+ * usb_protocol_negotiate_urb_size() against old and new peers, the
+ * isochronous packet descriptors and the entries of batch frames.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_protocol.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint8_t test_data[USB_MAX_LARGE_DATA_SIZE + 1];
+
+static void fill_test_data(void) {
+    uint32_t i;
+
+    for (i = 0; i < sizeof(test_data); i++) {
+        test_data[i] = (uint8_t)(i * 7 + 3);
+    }
+}
+
+static void init_test_urb(usb_urb_header_t* urb, uint32_t len) {
+    memset(urb, 0, sizeof(*urb));
+    urb->command = USB_CMD_SUBMIT;
+    urb->seqnum = 42;
+    urb->device_id = 0x12345678;
+    urb->endpoint = 0x81;
+    urb->transfer_type = USB_TRANSFER_BULK;
+    urb->transfer_length = len;
+    urb->actual_length = len;
+}
+
+/* ============================================================================
+ * Encapsulation Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a URB at the base size survives a round trip
+ */
+void test_roundtrip_base_size(void) {
+    usb_urb_header_t urb;
+    usb_urb_header_t out_urb;
+    xoe_packet_t packet;
+    uint8_t* out;
+    uint32_t out_len;
+
+    init_test_urb(&urb, USB_MAX_DATA_SIZE);
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, test_data,
+                                                 USB_MAX_DATA_SIZE, &packet),
+                        "Base size URB should encapsulate");
+
+    out = (uint8_t*)malloc(USB_MAX_DATA_SIZE);
+    if (out == NULL) {
+        usb_protocol_free_payload(&packet);
+        TEST_SKIP("malloc failed");
+        return;
+    }
+
+    out_len = USB_MAX_DATA_SIZE;
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &out_urb, out, &out_len),
+                        "Base size URB should decapsulate");
+    TEST_ASSERT_EQUAL(USB_MAX_DATA_SIZE, out_len, "Length should round trip");
+    TEST_ASSERT(memcmp(out, test_data, USB_MAX_DATA_SIZE) == 0,
+                "Data should round trip");
+    TEST_ASSERT_EQUAL(42, out_urb.seqnum, "Header should round trip");
+
+    free(out);
+    usb_protocol_free_payload(&packet);
+}
+
+/**
+ * @brief Test a 64 KB URB survives a round trip
+ */
+void test_roundtrip_large_size(void) {
+    usb_urb_header_t urb;
+    usb_urb_header_t out_urb;
+    xoe_packet_t packet;
+    uint8_t* out;
+    uint32_t out_len;
+
+    init_test_urb(&urb, USB_MAX_LARGE_DATA_SIZE);
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, test_data,
+                                                 USB_MAX_LARGE_DATA_SIZE, &packet),
+                        "Large URB should encapsulate");
+    if (packet.payload == NULL) {
+        return;
+    }
+    TEST_ASSERT_EQUAL(USB_MAX_LARGE_PAYLOAD_SIZE, packet.payload->len,
+                      "Payload should hold header and data");
+
+    out = (uint8_t*)malloc(USB_MAX_LARGE_DATA_SIZE);
+    if (out == NULL) {
+        usb_protocol_free_payload(&packet);
+        TEST_SKIP("malloc failed");
+        return;
+    }
+
+    out_len = USB_MAX_LARGE_DATA_SIZE;
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &out_urb, out, &out_len),
+                        "Large URB should decapsulate");
+    TEST_ASSERT_EQUAL(USB_MAX_LARGE_DATA_SIZE, out_len, "Length should round trip");
+    TEST_ASSERT(memcmp(out, test_data, USB_MAX_LARGE_DATA_SIZE) == 0,
+                "Data should round trip");
+    TEST_ASSERT_EQUAL(USB_MAX_LARGE_DATA_SIZE, out_urb.actual_length,
+                      "actual_length should round trip");
+
+    free(out);
+    usb_protocol_free_payload(&packet);
+}
+
+/**
+ * @brief Test a URB framed in place matches the copying encapsulation
+ */
+void test_encapsulate_in_place(void) {
+    static uint8_t frame[USB_URB_HEADER_WIRE_SIZE + 512];
+    usb_urb_header_t urb;
+    usb_urb_header_t out_urb;
+    xoe_packet_t copied;
+    xoe_packet_t framed;
+    xoe_payload_t payload;
+    uint8_t out[512];
+    uint32_t out_len = sizeof(out);
+
+    init_test_urb(&urb, 512);
+    memcpy(frame + USB_URB_HEADER_WIRE_SIZE, test_data, 512);
+
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate_in_place(&urb, frame, 512,
+                                                          &payload, &framed),
+                        "Framing in place should succeed");
+    TEST_ASSERT(framed.payload == &payload, "Caller's payload used");
+    TEST_ASSERT(payload.data == frame, "No copy of the data");
+    TEST_ASSERT_EQUAL(USB_URB_HEADER_WIRE_SIZE + 512, (int)payload.len,
+                      "Header and data");
+    TEST_ASSERT_EQUAL(FALSE, payload.owns_data, "Data not owned");
+
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, test_data, 512, &copied),
+                        "Copying encapsulation should succeed");
+    TEST_ASSERT(memcmp(copied.payload->data, frame, sizeof(frame)) == 0,
+                "Same bytes as the copying encapsulation");
+    usb_protocol_free_payload(&copied);
+
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&framed, &out_urb, out,
+                                                 &out_len),
+                        "In-place frame should decapsulate");
+    TEST_ASSERT_EQUAL(42, (int)out_urb.seqnum, "Header kept");
+    TEST_ASSERT(memcmp(out, test_data, 512) == 0, "Data kept");
+
+    TEST_ASSERT_ERROR(usb_protocol_encapsulate_in_place(&urb, frame,
+                                                        USB_MAX_LARGE_DATA_SIZE + 1,
+                                                        &payload, &framed),
+                      E_INVALID_ARGUMENT, "Above the large URB limit");
+}
+
+/**
+ * @brief Test URBs above the protocol ceiling are rejected
+ */
+void test_encapsulate_over_limit(void) {
+    usb_urb_header_t urb;
+    xoe_packet_t packet;
+
+    memset(&packet, 0, sizeof(packet));
+    init_test_urb(&urb, USB_MAX_LARGE_DATA_SIZE + 1);
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      usb_protocol_encapsulate(&urb, test_data,
+                                               USB_MAX_LARGE_DATA_SIZE + 1, &packet),
+                      "Data above the large URB limit should be rejected");
+    TEST_ASSERT_NULL(packet.payload, "No payload should be allocated");
+}
+
+/**
+ * @brief Test a short output buffer is reported, not overrun
+ */
+void test_decapsulate_buffer_too_small(void) {
+    usb_urb_header_t urb;
+    usb_urb_header_t out_urb;
+    xoe_packet_t packet;
+    uint8_t out[USB_MAX_DATA_SIZE];
+    uint32_t out_len;
+
+    init_test_urb(&urb, USB_MAX_DATA_SIZE + 1);
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, test_data,
+                                                 USB_MAX_DATA_SIZE + 1, &packet),
+                        "Large URB should encapsulate");
+
+    out_len = sizeof(out);
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      usb_protocol_decapsulate(&packet, &out_urb, out, &out_len),
+                      "Base size buffer should be too small for a large URB");
+
+    usb_protocol_free_payload(&packet);
+}
+
+/**
+ * @brief Test oversized payloads from the wire are rejected
+ */
+void test_decapsulate_oversized_payload(void) {
+    usb_urb_header_t out_urb;
+    xoe_packet_t packet;
+    uint32_t out_len = 0;
+
+    packet.protocol_id = XOE_PROTOCOL_USB;
+    packet.protocol_version = XOE_PROTOCOL_USB_VERSION;
+    packet.checksum = 0;
+    packet.payload = xoe_payload_alloc(USB_MAX_LARGE_PAYLOAD_SIZE + 1);
+    if (packet.payload == NULL) {
+        TEST_SKIP("xoe_payload_alloc failed");
+        return;
+    }
+    memset(packet.payload->data, 0, packet.payload->len);
+
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_decapsulate(&packet, &out_urb, NULL, &out_len),
+                      "Payload above the large URB limit should be rejected");
+
+    usb_protocol_free_payload(&packet);
+}
+
+/* ============================================================================
+ * usb_protocol_negotiate_urb_size() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test peers without negotiation get the base size
+ */
+void test_negotiate_legacy_peer(void) {
+    TEST_ASSERT_EQUAL(USB_MAX_DATA_SIZE,
+                      usb_protocol_negotiate_urb_size(0, USB_MAX_LARGE_DATA_SIZE),
+                      "Unset request should fall back to the base size");
+    TEST_ASSERT_EQUAL(USB_MAX_DATA_SIZE,
+                      usb_protocol_negotiate_urb_size(512, USB_MAX_LARGE_DATA_SIZE),
+                      "Requests below the base size should be raised to it");
+}
+
+/**
+ * @brief Test requests are capped at the local limit
+ */
+void test_negotiate_caps(void) {
+    TEST_ASSERT_EQUAL(16384,
+                      usb_protocol_negotiate_urb_size(16384, USB_MAX_LARGE_DATA_SIZE),
+                      "Request within the limit should be granted");
+    TEST_ASSERT_EQUAL(16384,
+                      usb_protocol_negotiate_urb_size(USB_MAX_LARGE_DATA_SIZE, 16384),
+                      "Request above the limit should be capped");
+    TEST_ASSERT_EQUAL(USB_MAX_LARGE_DATA_SIZE,
+                      usb_protocol_negotiate_urb_size(0xFFFFFFFFUL, 0xFFFFFFFFUL),
+                      "Grant should never exceed the protocol ceiling");
+    TEST_ASSERT_EQUAL(USB_MAX_DATA_SIZE,
+                      usb_protocol_negotiate_urb_size(16384, 0),
+                      "Grant should never drop below the base size");
+}
+
+/* ============================================================================
+ * Isochronous Descriptor Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test an isochronous URB keeps its descriptors and packet count
+ */
+void test_iso_roundtrip(void) {
+    usb_iso_packet_t sent[3];
+    usb_iso_packet_t received[3];
+    usb_urb_header_t urb;
+    usb_urb_header_t decoded;
+    xoe_packet_t packet;
+    uint8_t body[USB_ISO_PACKET_WIRE_SIZE * 3 + 300];
+    uint8_t out[sizeof(body)];
+    uint32_t out_len = sizeof(out);
+    uint32_t offset = 0;
+    int header_len;
+
+    /* A short packet and an errored empty one between two full ones */
+    sent[0].length = 192;
+    sent[0].actual_length = 192;
+    sent[0].status = 0;
+    sent[1].length = 192;
+    sent[1].actual_length = 0;
+    sent[1].status = E_USB_OVERFLOW;
+    sent[2].length = 192;
+    sent[2].actual_length = 108;
+    sent[2].status = 0;
+
+    header_len = usb_protocol_iso_write_descriptors(body, sent, 3);
+    TEST_ASSERT_EQUAL(USB_ISO_PACKET_WIRE_SIZE * 3, header_len,
+                      "Descriptors should be 12 bytes each");
+    memcpy(body + header_len, test_data, 300);
+
+    init_test_urb(&urb, sizeof(body));
+    urb.transfer_type = USB_TRANSFER_ISOCHRONOUS;
+    urb.number_of_packets = 3;
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, body, sizeof(body), &packet),
+                        "Encapsulation should succeed");
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &decoded, out, &out_len),
+                        "Decapsulation should succeed");
+    usb_protocol_free_payload(&packet);
+
+    TEST_ASSERT_EQUAL(3, decoded.number_of_packets, "Packet count should survive");
+    TEST_ASSERT_SUCCESS(usb_protocol_iso_read_descriptors(out, out_len, 3,
+                                                          received, &offset),
+                        "Descriptors should parse");
+    TEST_ASSERT_EQUAL(header_len, (int)offset, "Data should follow descriptors");
+    TEST_ASSERT_EQUAL(108, (int)received[2].actual_length, "Short packet kept");
+    TEST_ASSERT_EQUAL(E_USB_OVERFLOW, received[1].status, "Packet status kept");
+    TEST_ASSERT(memcmp(out + offset, test_data, 300) == 0,
+                "Packet data should be intact");
+}
+
+/**
+ * @brief Test descriptors that do not match the data are rejected
+ */
+void test_iso_bad_descriptors(void) {
+    usb_iso_packet_t packets[2];
+    usb_iso_packet_t parsed[2];
+    uint8_t body[USB_ISO_PACKET_WIRE_SIZE * 2 + 64];
+    uint32_t offset;
+
+    packets[0].length = 32;
+    packets[0].actual_length = 32;
+    packets[0].status = 0;
+    packets[1].length = 32;
+    packets[1].actual_length = 32;
+    packets[1].status = 0;
+    usb_protocol_iso_write_descriptors(body, packets, 2);
+
+    TEST_ASSERT_SUCCESS(usb_protocol_iso_read_descriptors(body, sizeof(body), 2,
+                                                          parsed, &offset),
+                        "Matching data should parse");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_iso_read_descriptors(body, sizeof(body) - 1, 2,
+                                                        parsed, &offset),
+                      "Missing data should be rejected");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_iso_read_descriptors(body, sizeof(body), 1,
+                                                        parsed, &offset),
+                      "Unaccounted data should be rejected");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_iso_read_descriptors(body, 8, 2, parsed, &offset),
+                      "Truncated descriptors should be rejected");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_iso_read_descriptors(body, sizeof(body),
+                                                        USB_ISO_MAX_PACKETS + 1,
+                                                        parsed, &offset),
+                      "Packet count above the limit should be rejected");
+
+    /* A packet claiming more than it asked for */
+    packets[0].length = 16;
+    usb_protocol_iso_write_descriptors(body, packets, 2);
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_iso_read_descriptors(body, sizeof(body), 2,
+                                                        parsed, &offset),
+                      "Overlong packet should be rejected");
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      usb_protocol_iso_write_descriptors(body, packets, 0),
+                      "Zero packets should be refused");
+}
+
+/* ============================================================================
+ * Batch Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test URBs appended to a batch come back out in order
+ */
+void test_batch_roundtrip(void) {
+    uint8_t batch[USB_BATCH_ENTRY_SIZE(64) + USB_BATCH_ENTRY_SIZE(0)];
+    uint8_t data[64];
+    usb_urb_header_t urb;
+    usb_urb_header_t parsed;
+    xoe_payload_t payload;
+    xoe_packet_t packet;
+    const uint8_t* entry;
+    uint32_t entry_len;
+    uint32_t used = 0;
+    uint32_t offset = 0;
+    uint32_t data_len;
+
+    init_test_urb(&urb, 64);
+    TEST_ASSERT_SUCCESS(usb_protocol_batch_append(batch, sizeof(batch), &used,
+                                                  &urb, test_data, 64),
+                        "First URB should fit");
+    urb.command = USB_RET_UNLINK;
+    urb.seqnum = 43;
+    urb.transfer_length = 0;
+    urb.actual_length = 0;
+    TEST_ASSERT_SUCCESS(usb_protocol_batch_append(batch, sizeof(batch), &used,
+                                                  &urb, NULL, 0),
+                        "Second URB should fit");
+    TEST_ASSERT_EQUAL(sizeof(batch), used, "Batch should be full");
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      usb_protocol_batch_append(batch, sizeof(batch), &used,
+                                                &urb, NULL, 0),
+                      "Third URB should not fit");
+    TEST_ASSERT_EQUAL(sizeof(batch), used, "Batch should be unchanged");
+
+    /* Each entry is a URB frame payload as it would travel alone */
+    packet.protocol_id = XOE_PROTOCOL_USB;
+    packet.protocol_version = XOE_PROTOCOL_USB_VERSION;
+    packet.payload = &payload;
+    packet.checksum = 0;
+    payload.owns_data = FALSE;
+
+    TEST_ASSERT_SUCCESS(usb_protocol_batch_next(batch, used, &offset,
+                                                &entry, &entry_len),
+                        "First entry");
+    payload.data = (void*)entry;
+    payload.len = entry_len;
+    data_len = sizeof(data);
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &parsed, data, &data_len),
+                        "First URB should decode");
+    TEST_ASSERT_EQUAL(42, (int)parsed.seqnum, "First seqnum");
+    TEST_ASSERT(data_len == 64 && memcmp(data, test_data, 64) == 0,
+                "First URB data");
+
+    TEST_ASSERT_SUCCESS(usb_protocol_batch_next(batch, used, &offset,
+                                                &entry, &entry_len),
+                        "Second entry");
+    TEST_ASSERT_EQUAL(USB_URB_HEADER_WIRE_SIZE, entry_len, "Header only");
+    payload.data = (void*)entry;
+    payload.len = entry_len;
+    data_len = sizeof(data);
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &parsed, data, &data_len),
+                        "Second URB should decode");
+    TEST_ASSERT_EQUAL(USB_RET_UNLINK, parsed.command, "Second command");
+
+    TEST_ASSERT_EQUAL(E_NOT_FOUND,
+                      usb_protocol_batch_next(batch, used, &offset,
+                                              &entry, &entry_len),
+                      "No third entry");
+}
+
+/**
+ * @brief Test cut-off and undersized entries are rejected
+ */
+void test_batch_malformed(void) {
+    uint8_t batch[USB_BATCH_ENTRY_SIZE(16)];
+    usb_urb_header_t urb;
+    const uint8_t* entry;
+    uint32_t entry_len;
+    uint32_t used = 0;
+    uint32_t offset;
+
+    init_test_urb(&urb, 16);
+    usb_protocol_batch_append(batch, sizeof(batch), &used, &urb, test_data, 16);
+
+    offset = 0;
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_batch_next(batch, used - 1, &offset,
+                                              &entry, &entry_len),
+                      "Cut-off URB should be rejected");
+    offset = 0;
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_batch_next(batch, 3, &offset,
+                                              &entry, &entry_len),
+                      "Cut-off length should be rejected");
+
+    /* An entry too short to hold a URB header */
+    batch[3] = USB_URB_HEADER_WIRE_SIZE - 1;
+    offset = 0;
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_protocol_batch_next(batch, used, &offset,
+                                              &entry, &entry_len),
+                      "Short entry should be rejected");
+
+    offset = 0;
+    TEST_ASSERT_EQUAL(E_NOT_FOUND,
+                      usb_protocol_batch_next(batch, 0, &offset,
+                                              &entry, &entry_len),
+                      "Empty batch has no entries");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB Protocol Unit Tests ===\n\n");
+
+    fill_test_data();
+
+    /* Encapsulation tests */
+    run_test("test_roundtrip_base_size", test_roundtrip_base_size);
+    run_test("test_roundtrip_large_size", test_roundtrip_large_size);
+    run_test("test_encapsulate_in_place", test_encapsulate_in_place);
+    run_test("test_encapsulate_over_limit", test_encapsulate_over_limit);
+    run_test("test_decapsulate_buffer_too_small", test_decapsulate_buffer_too_small);
+    run_test("test_decapsulate_oversized_payload", test_decapsulate_oversized_payload);
+
+    /* usb_protocol_negotiate_urb_size() tests */
+    run_test("test_negotiate_legacy_peer", test_negotiate_legacy_peer);
+    run_test("test_negotiate_caps", test_negotiate_caps);
+
+    /* Isochronous descriptor tests */
+    run_test("test_iso_roundtrip", test_iso_roundtrip);
+    run_test("test_iso_bad_descriptors", test_iso_bad_descriptors);
+
+    /* Batch tests */
+    run_test("test_batch_roundtrip", test_batch_roundtrip);
+    run_test("test_batch_malformed", test_batch_malformed);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,743 @@
+/**
+ * @file test_usb_send_queue.c
+ * @brief Unit tests for the USB server per-socket send queues
+ *
+ * Tests in-order delivery through the writer thread, isolation of a
+ * peer that stops reading, the stall-then-drop policy and its counters,
+ * backpressure releasing once the peer drains its socket, traffic
+ * classes, round robin between devices, and OUT endpoint credit.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_send_queue.h"
+#include "connectors/usb/usb_protocol.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* Frame size used to fill a stalled socket quickly */
+#define TEST_FRAME_SIZE 8192
+
+static void init_test_packet(xoe_packet_t* packet, uint32_t len, uint8_t fill) {
+    memset(packet, 0, sizeof(*packet));
+    packet->protocol_id = 0x0003;
+    packet->protocol_version = 1;
+    packet->payload = xoe_payload_alloc(len);
+    if (packet->payload != NULL) {
+        memset(packet->payload->data, fill, len);
+    }
+}
+
+static void init_test_urb(xoe_packet_t* packet, uint16_t command,
+                          uint8_t transfer_type, uint32_t device_id,
+                          uint32_t seqnum, uint32_t data_len) {
+    static uint8_t data[TEST_FRAME_SIZE];
+    usb_urb_header_t urb;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = command;
+    urb.seqnum = seqnum;
+    urb.device_id = device_id;
+    urb.endpoint = 0x81;
+    urb.transfer_type = transfer_type;
+    urb.transfer_length = data_len;
+    memset(packet, 0, sizeof(*packet));
+    if (usb_protocol_encapsulate(&urb, data, data_len, packet) != 0) {
+        packet->payload = NULL;
+    }
+}
+
+/* OUT URB (endpoint 0x02) of a device, with data_len bytes of data */
+static void init_out_urb(xoe_packet_t* packet, uint16_t command,
+                         uint32_t device_id, uint32_t seqnum,
+                         uint32_t data_len) {
+    init_test_urb(packet, command, USB_TRANSFER_BULK, device_id, seqnum,
+                  data_len);
+    if (packet->payload != NULL) {
+        ((uint8_t*)packet->payload->data)[12] = 0x02;
+    }
+}
+
+/* Device and seqnum of a received URB frame */
+static uint32_t urb_field(const xoe_packet_t* packet, int offset) {
+    const uint8_t* p = (const uint8_t*)packet->payload->data + offset;
+
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static int open_test_pair(int fds[2]) {
+    struct timeval tv;
+    int sndbuf = 4096;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        return -1;
+    }
+
+    /* Small send buffer so a silent peer fills up early */
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return 0;
+}
+
+static long elapsed_ms(const struct timeval* start) {
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000L +
+           (now.tv_usec - start->tv_usec) / 1000L;
+}
+
+/**
+ * @brief Push frames until one is dropped (stall disabled)
+ *
+ * @return Number of frames queued before the drop, -1 on allocation failure
+ */
+static int fill_queue(usb_send_queue_t* queue) {
+    xoe_packet_t packet;
+    int queued = 0;
+    int result;
+
+    for (;;) {
+        init_test_packet(&packet, TEST_FRAME_SIZE, 0x11);
+        if (packet.payload == NULL) {
+            return -1;
+        }
+        result = usb_send_queue_push(queue, &packet, FALSE, 0);
+        if (result != 0) {
+            break;
+        }
+        queued++;
+    }
+    return (result == E_WOULD_BLOCK) ? queued : -1;
+}
+
+/* ============================================================================
+ * Delivery Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that queued frames reach the peer in order
+ */
+void test_push_delivers_in_order(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    int fds[2];
+    int ordered = 0;
+    int i;
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+
+    queue = usb_send_queue_create(&writer, fds[0]);
+    TEST_ASSERT_NOT_NULL(queue, "Queue should be created");
+    if (queue != NULL) {
+        for (i = 0; i < 10; i++) {
+            init_test_packet(&packet, 100, (uint8_t)i);
+            TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 0),
+                                "Push should succeed");
+            TEST_ASSERT_NULL(packet.payload, "Payload should be taken over");
+        }
+
+        for (i = 0; i < 10; i++) {
+            if (xoe_wire_recv(fds[1], &packet) == 0) {
+                if (packet.payload->len == 100 &&
+                    ((uint8_t*)packet.payload->data)[0] == (uint8_t)i) {
+                    ordered++;
+                }
+                xoe_wire_free_payload(&packet);
+            }
+        }
+        TEST_ASSERT_EQUAL(10, ordered, "Frames should arrive valid and in order");
+
+        usb_send_queue_release(queue);
+    }
+
+    usb_send_writer_cleanup(&writer);
+    TEST_ASSERT_EQUAL(10, writer.frames_sent, "Sent frames should be counted");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test that a peer that stops reading does not delay another
+ */
+void test_slow_peer_isolated(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* slow;
+    usb_send_queue_t* fast;
+    xoe_packet_t packet;
+    struct timeval start;
+    int slow_fds[2];
+    int fast_fds[2];
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(slow_fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+    if (open_test_pair(fast_fds) != 0) {
+        close(slow_fds[0]);
+        close(slow_fds[1]);
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+
+    slow = usb_send_queue_create(&writer, slow_fds[0]);
+    fast = usb_send_queue_create(&writer, fast_fds[0]);
+    if (slow == NULL || fast == NULL) {
+        usb_send_queue_release(slow);
+        usb_send_queue_release(fast);
+        TEST_SKIP("queue create failed");
+    } else {
+        /* The silent peer's queue fills and starts dropping */
+        TEST_ASSERT(fill_queue(slow) >= USB_SEND_QUEUE_DEPTH,
+                    "Full queue should drop rather than block");
+        TEST_ASSERT(writer.frames_dropped >= 1, "Drop should be counted");
+
+        /* The other peer is unaffected */
+        gettimeofday(&start, NULL);
+        init_test_packet(&packet, 100, 0x22);
+        TEST_ASSERT_SUCCESS(usb_send_queue_push(fast, &packet, FALSE, 0),
+                            "Push to a healthy peer should succeed");
+        TEST_ASSERT_SUCCESS(xoe_wire_recv(fast_fds[1], &packet),
+                            "Healthy peer should receive its frame");
+        xoe_wire_free_payload(&packet);
+        TEST_ASSERT(elapsed_ms(&start) < 500,
+                    "Healthy peer should not wait on the stalled one");
+
+        usb_send_queue_release(slow);
+        usb_send_queue_release(fast);
+    }
+
+    usb_send_writer_cleanup(&writer);
+    close(slow_fds[0]);
+    close(slow_fds[1]);
+    close(fast_fds[0]);
+    close(fast_fds[1]);
+}
+
+/* ============================================================================
+ * Stall Policy Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that a full queue stalls for the limit, then drops
+ */
+void test_stall_then_drop(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    struct timeval start;
+    int fds[2];
+    long waited;
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+
+    queue = usb_send_queue_create(&writer, fds[0]);
+    if (queue == NULL || fill_queue(queue) < 0) {
+        usb_send_queue_release(queue);
+        TEST_SKIP("setup failed");
+    } else {
+        init_test_packet(&packet, TEST_FRAME_SIZE, 0x33);
+        gettimeofday(&start, NULL);
+        TEST_ASSERT_EQUAL(E_WOULD_BLOCK, usb_send_queue_push(queue, &packet, FALSE, 30),
+                          "Push should be dropped after the stall");
+        waited = elapsed_ms(&start);
+        TEST_ASSERT(waited >= 25, "Push should wait for the stall limit");
+        TEST_ASSERT_NULL(packet.payload, "Dropped payload should be released");
+        TEST_ASSERT_EQUAL(1, writer.frames_stalled, "Stall should be counted");
+
+        usb_send_queue_release(queue);
+    }
+
+    usb_send_writer_cleanup(&writer);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+typedef struct {
+    int fd;
+    int delay_ms;
+} drain_args_t;
+
+static void* drain_peer(void* arg) {
+    drain_args_t* args = (drain_args_t*)arg;
+    struct timespec delay;
+    char buffer[4096];
+
+    delay.tv_sec = 0;
+    delay.tv_nsec = (long)args->delay_ms * 1000000L;
+    nanosleep(&delay, NULL);
+
+    while (recv(args->fd, buffer, sizeof(buffer), 0) > 0) {
+        /* Discard until the writer side closes or times out */
+    }
+    return NULL;
+}
+
+/**
+ * @brief Test that a stalled push completes once the peer drains
+ */
+void test_backpressure_resumes(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    drain_args_t args;
+    pthread_t thread;
+    int fds[2];
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+
+    queue = usb_send_queue_create(&writer, fds[0]);
+    if (queue == NULL || fill_queue(queue) < 0) {
+        usb_send_queue_release(queue);
+        TEST_SKIP("setup failed");
+    } else {
+        args.fd = fds[1];
+        args.delay_ms = 20;
+        if (pthread_create(&thread, NULL, drain_peer, &args) != 0) {
+            usb_send_queue_release(queue);
+            TEST_SKIP("pthread_create failed");
+        } else {
+            init_test_packet(&packet, TEST_FRAME_SIZE, 0x44);
+            TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 2000),
+                                "Push should complete once the peer reads");
+
+            usb_send_queue_release(queue);
+            shutdown(fds[0], SHUT_WR);
+            pthread_join(thread, NULL);
+        }
+    }
+
+    usb_send_writer_cleanup(&writer);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test that a closed peer fails the queue instead of blocking
+ */
+void test_peer_closed(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    int fds[2];
+    int result = 0;
+    int i;
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+    close(fds[1]);
+
+    queue = usb_send_queue_create(&writer, fds[0]);
+    if (queue == NULL) {
+        TEST_SKIP("queue create failed");
+    } else {
+        /* The writer notices the dead peer after the first write */
+        for (i = 0; i < 100 && result == 0; i++) {
+            struct timespec delay;
+
+            init_test_packet(&packet, 100, 0x55);
+            result = usb_send_queue_push(queue, &packet, FALSE, 0);
+            delay.tv_sec = 0;
+            delay.tv_nsec = 5000000L;
+            nanosleep(&delay, NULL);
+        }
+        TEST_ASSERT_EQUAL(E_NETWORK_ERROR, result, "Dead peer should fail pushes");
+        TEST_ASSERT_EQUAL(1, writer.queue_failures, "Failure should be counted");
+
+        usb_send_queue_release(queue);
+    }
+
+    usb_send_writer_cleanup(&writer);
+    close(fds[0]);
+}
+
+/* ============================================================================
+ * Scheduling Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test traffic classes chosen from the URB header
+ */
+void test_frame_class(void) {
+    xoe_packet_t packet;
+    uint32_t key;
+
+    init_test_urb(&packet, USB_RET_SUBMIT, USB_TRANSFER_INTERRUPT,
+                  0x12345678, 1, 8);
+    TEST_ASSERT_EQUAL(USB_SEND_CLASS_URGENT, usb_send_frame_class(&packet, &key),
+                      "Interrupt completion should be urgent");
+    TEST_ASSERT_EQUAL(0x12345678, key, "Flow should follow the device");
+    xoe_wire_free_payload(&packet);
+
+    init_test_urb(&packet, USB_CMD_SUBMIT, USB_TRANSFER_CONTROL, 1, 2, 0);
+    TEST_ASSERT_EQUAL(USB_SEND_CLASS_URGENT, usb_send_frame_class(&packet, NULL),
+                      "Control URB should be urgent");
+    xoe_wire_free_payload(&packet);
+
+    init_test_urb(&packet, USB_CMD_SUBMIT, USB_TRANSFER_BULK, 1, 3, 64);
+    TEST_ASSERT_EQUAL(USB_SEND_CLASS_BULK, usb_send_frame_class(&packet, NULL),
+                      "Bulk URB should be bulk");
+    xoe_wire_free_payload(&packet);
+
+    /* Must not overtake the URB it cancels */
+    init_test_urb(&packet, USB_CMD_UNLINK, USB_TRANSFER_INTERRUPT, 1, 4, 0);
+    TEST_ASSERT_EQUAL(USB_SEND_CLASS_BULK, usb_send_frame_class(&packet, NULL),
+                      "Unlink should go with bulk");
+    xoe_wire_free_payload(&packet);
+
+    init_test_packet(&packet, 16, 0);
+    packet.protocol_id = XOE_PROTOCOL_SERIAL;
+    TEST_ASSERT_EQUAL(USB_SEND_CLASS_SERIAL, usb_send_frame_class(&packet, &key),
+                      "Serial frame should be in the serial class");
+    TEST_ASSERT_EQUAL(XOE_PROTOCOL_SERIAL, key, "Flow should follow the protocol");
+    packet.protocol_id = XOE_PROTOCOL_USB;
+    TEST_ASSERT_EQUAL(USB_SEND_CLASS_BULK, usb_send_frame_class(&packet, NULL),
+                      "Truncated URB should be bulk");
+    xoe_wire_free_payload(&packet);
+}
+
+/**
+ * @brief Push bulk URBs of two devices and an interrupt URB to a blocked
+ *        peer, then drain it
+ *
+ * @param order Filled with the received frames as device_id << 8 | seqnum
+ * @return Frames received
+ */
+static int run_mixed_traffic(uint32_t* order, int max) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    int fds[2];
+    int received = 0;
+    int i;
+
+    if (usb_send_writer_init(&writer) != 0) {
+        return -1;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        return -1;
+    }
+    queue = usb_send_queue_create(&writer, fds[0]);
+    if (queue == NULL) {
+        usb_send_writer_cleanup(&writer);
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    /* Device 1 fills the socket first; device 2 and the report follow */
+    for (i = 0; i < 12; i++) {
+        init_test_urb(&packet, USB_RET_SUBMIT, USB_TRANSFER_BULK, 1,
+                      (uint32_t)i, TEST_FRAME_SIZE);
+        usb_send_queue_push(queue, &packet, FALSE, 0);
+    }
+    for (i = 0; i < 2; i++) {
+        init_test_urb(&packet, USB_RET_SUBMIT, USB_TRANSFER_BULK, 2,
+                      (uint32_t)i, TEST_FRAME_SIZE);
+        usb_send_queue_push(queue, &packet, FALSE, 0);
+    }
+    init_test_urb(&packet, USB_RET_SUBMIT, USB_TRANSFER_INTERRUPT, 3, 0, 8);
+    usb_send_queue_push(queue, &packet, FALSE, 0);
+
+    while (received < max && xoe_wire_recv(fds[1], &packet) == 0) {
+        order[received++] = (urb_field(&packet, 8) << 8) | urb_field(&packet, 4);
+        xoe_wire_free_payload(&packet);
+    }
+
+    usb_send_queue_release(queue);
+    usb_send_writer_cleanup(&writer);
+    close(fds[0]);
+    close(fds[1]);
+    return received;
+}
+
+/**
+ * @brief Test that an interrupt report overtakes queued bulk data
+ */
+void test_urgent_overtakes_bulk(void) {
+    uint32_t order[15];
+    int position = -1;
+    int last = -1;
+    int in_order = TRUE;
+    int i;
+
+    if (run_mixed_traffic(order, 15) != 15) {
+        TEST_SKIP("setup failed");
+        return;
+    }
+
+    for (i = 0; i < 15; i++) {
+        if (order[i] == (3U << 8)) {
+            position = i;
+        } else if ((order[i] >> 8) == 1) {
+            in_order &= ((int)(order[i] & 0xFF) == last + 1);
+            last = (int)(order[i] & 0xFF);
+        }
+    }
+    TEST_ASSERT(position >= 0 && position < 8,
+                "Interrupt report should not wait for the bulk backlog");
+    TEST_ASSERT(in_order, "Frames of one device should stay in order");
+}
+
+/**
+ * @brief Test that a second bulk device shares the socket with the first
+ */
+void test_devices_round_robin(void) {
+    uint32_t order[15];
+    int second_done = -1;
+    int i;
+
+    if (run_mixed_traffic(order, 15) != 15) {
+        TEST_SKIP("setup failed");
+        return;
+    }
+
+    for (i = 0; i < 15; i++) {
+        if (order[i] == ((2U << 8) | 1U)) {
+            second_done = i;
+        }
+    }
+    TEST_ASSERT(second_done >= 0 && second_done < 12,
+                "Second device should not wait for the first to finish");
+}
+
+/* ============================================================================
+ * Credit Tests
+ * ============================================================================ */
+
+/* Receive one URB frame as device_id << 8 | seqnum (0 if none came) */
+static uint32_t recv_urb_key(int fd, uint16_t* command) {
+    xoe_packet_t packet;
+    uint32_t key;
+
+    if (xoe_wire_recv(fd, &packet) != 0) {
+        return 0;
+    }
+    key = (urb_field(&packet, 8) << 8) | urb_field(&packet, 4);
+    if (command != NULL) {
+        *command = (uint16_t)(urb_field(&packet, 0) >> 16);
+    }
+    xoe_wire_free_payload(&packet);
+    return key;
+}
+
+/* TRUE if nothing arrives within a short wait */
+static int peer_idle(int fd) {
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 100) == 0;
+}
+
+/**
+ * @brief Test that an endpoint out of credit waits while others flow
+ */
+void test_credit_gates_endpoint(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    uint32_t first;
+    uint32_t second;
+    int fds[2];
+    int i;
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+
+    queue = usb_send_queue_create(&writer, fds[0]);
+    TEST_ASSERT_NOT_NULL(queue, "Queue should be created");
+    if (queue != NULL) {
+        TEST_ASSERT_ERROR(usb_send_queue_credit(queue, 1, 0x81, 1, TRUE),
+                          E_INVALID_ARGUMENT, "IN endpoints take no credit");
+        TEST_ASSERT_ERROR(usb_send_queue_credit(queue, 1, 0x02, 1, FALSE),
+                          E_NOT_FOUND, "Credit needs a window first");
+        TEST_ASSERT_SUCCESS(usb_send_queue_credit(queue, 1, 0x02, 1, TRUE),
+                            "Window of one URB");
+
+        for (i = 0; i < 3; i++) {
+            init_out_urb(&packet, USB_CMD_SUBMIT, 1, (uint32_t)i, 100);
+            TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 0),
+                                "Push within the held limit");
+        }
+        init_out_urb(&packet, USB_CMD_SUBMIT, 2, 0, 100);
+        TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 0),
+                            "Endpoint without a window is unlimited");
+
+        first = recv_urb_key(fds[1], NULL);
+        second = recv_urb_key(fds[1], NULL);
+        TEST_ASSERT((first == (1U << 8) && second == (2U << 8)) ||
+                    (first == (2U << 8) && second == (1U << 8)),
+                    "One URB of the window and the other device's URB");
+        TEST_ASSERT(peer_idle(fds[1]), "The rest wait for credit");
+
+        TEST_ASSERT_SUCCESS(usb_send_queue_credit(queue, 1, 0x02, 2, FALSE),
+                            "Credit returned");
+        TEST_ASSERT_EQUAL((1U << 8) | 1, recv_urb_key(fds[1], NULL),
+                          "Held URBs released in order");
+        TEST_ASSERT_EQUAL((1U << 8) | 2, recv_urb_key(fds[1], NULL),
+                          "Second held URB released");
+
+        usb_send_queue_release(queue);
+    }
+
+    usb_send_writer_cleanup(&writer);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test the held limit and unlinking a held URB
+ */
+void test_credit_held_limit(void) {
+    usb_send_writer_t writer;
+    usb_send_queue_t* queue;
+    xoe_packet_t packet;
+    uint16_t command = 0;
+    int fds[2];
+    int i;
+
+    if (usb_send_writer_init(&writer) != 0) {
+        TEST_SKIP("writer init failed");
+        return;
+    }
+    if (open_test_pair(fds) != 0) {
+        usb_send_writer_cleanup(&writer);
+        TEST_SKIP("socketpair failed");
+        return;
+    }
+
+    queue = usb_send_queue_create(&writer, fds[0]);
+    TEST_ASSERT_NOT_NULL(queue, "Queue should be created");
+    if (queue != NULL) {
+        usb_send_queue_credit(queue, 1, 0x02, 0, TRUE);
+
+        for (i = 0; i < USB_SEND_HELD_MAX; i++) {
+            init_out_urb(&packet, USB_CMD_SUBMIT, 1, (uint32_t)i, 100);
+            TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 0),
+                                "Held");
+        }
+        init_out_urb(&packet, USB_CMD_SUBMIT, 1, 99, 100);
+        TEST_ASSERT_ERROR(usb_send_queue_push(queue, &packet, FALSE, 0),
+                          E_WOULD_BLOCK, "Endpoint's held URBs are bounded");
+        TEST_ASSERT_NULL(packet.payload, "Dropped payload released");
+
+        init_out_urb(&packet, USB_CMD_SUBMIT, 2, 0, 100);
+        TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 0),
+                            "Other devices still queue");
+        TEST_ASSERT_EQUAL(2U << 8, recv_urb_key(fds[1], NULL),
+                          "Other device's URB sent");
+
+        /* Unlinking a held URB drops it; the unlink itself still goes */
+        init_out_urb(&packet, USB_CMD_UNLINK, 1, 1, 0);
+        TEST_ASSERT_SUCCESS(usb_send_queue_push(queue, &packet, FALSE, 0),
+                            "Unlink queued");
+        TEST_ASSERT_EQUAL((1U << 8) | 1, recv_urb_key(fds[1], &command),
+                          "Unlink sent");
+        TEST_ASSERT_EQUAL(USB_CMD_UNLINK, command, "It is the unlink");
+
+        usb_send_queue_credit(queue, 1, 0x02, 8, FALSE);
+        TEST_ASSERT_EQUAL(1U << 8, recv_urb_key(fds[1], NULL), "Held URB 0");
+        TEST_ASSERT_EQUAL((1U << 8) | 2, recv_urb_key(fds[1], NULL),
+                          "Unlinked URB 1 never sent");
+        TEST_ASSERT_EQUAL((1U << 8) | 3, recv_urb_key(fds[1], NULL),
+                          "Held URB 3");
+        TEST_ASSERT(peer_idle(fds[1]), "Nothing else");
+
+        usb_send_queue_release(queue);
+    }
+
+    usb_send_writer_cleanup(&writer);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB Send Queue Unit Tests ===\n\n");
+
+    /* Delivery tests */
+    run_test("test_push_delivers_in_order", test_push_delivers_in_order);
+    run_test("test_slow_peer_isolated", test_slow_peer_isolated);
+
+    /* Stall policy tests */
+    run_test("test_stall_then_drop", test_stall_then_drop);
+    run_test("test_backpressure_resumes", test_backpressure_resumes);
+    run_test("test_peer_closed", test_peer_closed);
+
+    /* Scheduling tests */
+    run_test("test_frame_class", test_frame_class);
+    run_test("test_urgent_overtakes_bulk", test_urgent_overtakes_bulk);
+    run_test("test_devices_round_robin", test_devices_round_robin);
+
+    /* Credit tests */
+    run_test("test_credit_gates_endpoint", test_credit_gates_endpoint);
+    run_test("test_credit_held_limit", test_credit_held_limit);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,1032 @@
+/**
+ * @file test_usb_server.c
+ * @brief Unit tests for the USB server client registry and routing
+ *
+ * Registers clients on socketpairs, routes URBs by device_id through the
+ * hash index (including growth past the initial bucket count), and checks
+ * unregistration, entry reuse, the negotiated URB size gate, the
+ * isochronous bandwidth budget, the zero-copy relay of data URBs,
+ * descriptor reads answered from the registration's cache, replies to a
+ * client with no send queue handed to its reply route, the unpacking of
+ * batch frames, challenge-response authentication (several
+ * registrations in flight on one socket included) and server mode
+ * starting the USB server on first use.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_server.h"
+#include "core/server.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/security/usb_auth.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+/* More clients than the initial bucket count, to force index growth */
+#define TEST_CLIENT_COUNT (USB_INITIAL_CLIENTS * 4)
+
+static void init_test_urb(usb_urb_header_t* urb, uint32_t device_id,
+                          uint32_t len) {
+    memset(urb, 0, sizeof(*urb));
+    urb->command = USB_CMD_SUBMIT;
+    urb->seqnum = device_id;
+    urb->device_id = device_id;
+    urb->endpoint = 0x81;
+    urb->transfer_type = USB_TRANSFER_BULK;
+    urb->transfer_length = len;
+    urb->actual_length = len;
+}
+
+/**
+ * @brief Receive one frame on a socket, with a short timeout
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+static int recv_test_packet(int fd, xoe_packet_t* packet) {
+    struct timeval tv;
+
+    /* Frames are written asynchronously by the server's send writer */
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    return xoe_wire_recv(fd, packet);
+}
+
+/**
+ * @brief Receive one URB on a socket, with a short timeout
+ *
+ * @return 0 and the header on success, negative error code otherwise
+ */
+static int recv_test_urb(int fd, usb_urb_header_t* urb) {
+    xoe_packet_t packet;
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint32_t data_len = sizeof(data);
+    int result;
+
+    result = recv_test_packet(fd, &packet);
+    if (result != 0) {
+        return result;
+    }
+    result = usb_protocol_decapsulate(&packet, urb, data, &data_len);
+    xoe_wire_free_payload(&packet);
+    return result;
+}
+
+/* ============================================================================
+ * Registry Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test routing to every client after the index has grown
+ */
+void test_route_many_clients(void) {
+    usb_server_t* server = usb_server_init();
+    int pairs[TEST_CLIENT_COUNT][2];
+    usb_urb_header_t urb;
+    usb_urb_header_t received;
+    int delivered = 0;
+    int i;
+
+    TEST_ASSERT_NOT_NULL(server, "Server should initialize");
+    if (server == NULL) {
+        return;
+    }
+
+    for (i = 0; i < TEST_CLIENT_COUNT; i++) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]) != 0) {
+            TEST_SKIP("socketpair failed");
+            usb_server_cleanup(server);
+            return;
+        }
+        /* Device IDs sharing their low bits, like VID:PID values */
+        TEST_ASSERT_SUCCESS(usb_server_register_client(server, pairs[i][0],
+                                                       0x10000000U + ((uint32_t)i << 16)),
+                            "Registration should succeed");
+    }
+    TEST_ASSERT_EQUAL(TEST_CLIENT_COUNT, server->active_clients,
+                      "All clients should be active");
+
+    for (i = 0; i < TEST_CLIENT_COUNT; i++) {
+        init_test_urb(&urb, 0x10000000U + ((uint32_t)i << 16), 0);
+        if (usb_server_route_urb(server, &urb, NULL, 0, -1) == 0 &&
+            recv_test_urb(pairs[i][1], &received) == 0 &&
+            received.device_id == urb.device_id) {
+            delivered++;
+        }
+    }
+    TEST_ASSERT_EQUAL(TEST_CLIENT_COUNT, delivered,
+                      "Every URB should reach its own client");
+
+    for (i = 0; i < TEST_CLIENT_COUNT; i++) {
+        close(pairs[i][0]);
+        close(pairs[i][1]);
+    }
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Test unknown devices and loopback are not routed
+ */
+void test_route_no_target(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    int pair[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, pair[0], 0x12345678),
+                        "Registration should succeed");
+
+    init_test_urb(&urb, 0x87654321, 0);
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, usb_server_route_urb(server, &urb, NULL, 0, -1),
+                      "Unknown device_id should not be routed");
+
+    init_test_urb(&urb, 0x12345678, 0);
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, usb_server_route_urb(server, &urb, NULL, 0, pair[0]),
+                      "URB should not loop back to its sender");
+
+    close(pair[0]);
+    close(pair[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Test unregistered entries stop routing and are reused
+ */
+void test_unregister_and_reuse(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    int pair[2];
+    int entries_before;
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, pair[0], 0x11112222),
+                        "Registration should succeed");
+    entries_before = server->entry_count;
+    TEST_ASSERT(usb_server_has_client(server, pair[0]),
+                "Registered socket should be known");
+
+    TEST_ASSERT_SUCCESS(usb_server_unregister_client(server, pair[0]),
+                        "Unregistration should succeed");
+    TEST_ASSERT(!usb_server_has_client(server, pair[0]),
+                "Unregistered socket should be unknown");
+    TEST_ASSERT_EQUAL(0, server->active_clients, "No client should be active");
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, usb_server_unregister_client(server, pair[0]),
+                      "Second unregistration should find nothing");
+
+    init_test_urb(&urb, 0x11112222, 0);
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, usb_server_route_urb(server, &urb, NULL, 0, -1),
+                      "Unregistered device should not be routed");
+
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, pair[0], 0x33334444),
+                        "Re-registration should succeed");
+    TEST_ASSERT_EQUAL(entries_before, server->entry_count,
+                      "Released entry should be reused");
+
+    close(pair[0]);
+    close(pair[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Test URBs above the target's negotiated size are refused
+ */
+void test_route_size_gate(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    static uint8_t data[USB_MAX_DATA_SIZE + 1];
+    int pair[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    /* usb_server_register_client() does not negotiate: base size only */
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, pair[0], 0x11112222),
+                        "Registration should succeed");
+
+    init_test_urb(&urb, 0x11112222, sizeof(data));
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      usb_server_route_urb(server, &urb, data, sizeof(data), -1),
+                      "URB above the target's size should be refused");
+
+    close(pair[0]);
+    close(pair[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Register through the protocol path, advertising iso bandwidth
+ *
+ * @return Status of the USB_RET_REGISTER reply, or a receive error
+ */
+static int register_with_bandwidth(usb_server_t* server, int pair[2],
+                                   uint32_t device_id, uint32_t bandwidth) {
+    usb_urb_header_t urb;
+    xoe_packet_t packet;
+    int result;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_REGISTER;
+    urb.seqnum = 1;
+    urb.device_id = device_id;
+    urb.endpoint = USB_CLASS_AUDIO;
+    urb.actual_length = bandwidth;
+
+    result = usb_protocol_encapsulate(&urb, NULL, 0, &packet);
+    if (result != 0) {
+        return result;
+    }
+    usb_server_handle_urb(server, &packet, pair[0]);
+    usb_protocol_free_payload(&packet);
+
+    result = recv_test_urb(pair[1], &urb);
+    if (result != 0) {
+        return result;
+    }
+    return (urb.command == USB_RET_REGISTER) ? urb.status : E_PROTOCOL_ERROR;
+}
+
+/**
+ * @brief Test registrations reserve iso bandwidth against the budget
+ */
+void test_iso_budget(void) {
+    usb_server_t* server = usb_server_init();
+    int a[2];
+    int b[2];
+    int c[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, a) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, b) != 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, c) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    usb_server_set_iso_budget(server, 1000);
+
+    TEST_ASSERT_SUCCESS(register_with_bandwidth(server, a, 0x11110001, 600),
+                        "Stream within the budget should register");
+    TEST_ASSERT_EQUAL(E_USB_NO_BANDWIDTH,
+                      register_with_bandwidth(server, b, 0x11110002, 600),
+                      "Stream over the budget should be refused");
+    TEST_ASSERT_EQUAL(1, server->bandwidth_rejects, "Refusal should be counted");
+    TEST_ASSERT(!usb_server_has_client(server, b[0]),
+                "Refused device should not be registered");
+
+    TEST_ASSERT_SUCCESS(register_with_bandwidth(server, b, 0x11110002, 400),
+                        "Stream filling the budget should register");
+    TEST_ASSERT_SUCCESS(register_with_bandwidth(server, c, 0x11110003, 0),
+                        "Device without streams should always register");
+    TEST_ASSERT_EQUAL(1000, (int)server->iso_reserved, "Budget fully reserved");
+
+    /* Unregistering returns the reservation */
+    TEST_ASSERT_SUCCESS(usb_server_unregister_client(server, a[0]),
+                        "Unregistration should succeed");
+    TEST_ASSERT_EQUAL(400, (int)server->iso_reserved, "Reservation released");
+    TEST_ASSERT_SUCCESS(register_with_bandwidth(server, a, 0x11110001, 600),
+                        "Released bandwidth should be reusable");
+
+    close(a[0]);
+    close(a[1]);
+    close(b[0]);
+    close(b[1]);
+    close(c[0]);
+    close(c[1]);
+    usb_server_cleanup(server);
+}
+
+/* ============================================================================
+ * Forwarding Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test data URBs are relayed to the target unchanged
+ */
+void test_handle_urb_forwards_frame(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    xoe_packet_t sent;
+    xoe_packet_t received;
+    xoe_packet_t relayed;
+    uint8_t data[256];
+    uint8_t frame[USB_URB_HEADER_WIRE_SIZE + 256];
+    uint32_t frame_len;
+    uint32_t checksum;
+    unsigned long routed;
+    int sender[2];
+    int target[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, sender) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, target) != 0) {
+        close(sender[0]);
+        close(sender[1]);
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    memset(data, 0x3C, sizeof(data));
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, target[0], 0x11112222),
+                        "Registration should succeed");
+
+    /* Frame as the server receives it from the sending client */
+    init_test_urb(&urb, 0x11112222, sizeof(data));
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, data, sizeof(data), &sent),
+                        "Encapsulation should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_send(sender[1], &sent), "Send should succeed");
+    usb_protocol_free_payload(&sent);
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(sender[0], &received), "Recv should succeed");
+
+    checksum = received.checksum;
+    frame_len = (received.payload != NULL) ? received.payload->len : 0;
+    if (frame_len == sizeof(frame)) {
+        memcpy(frame, received.payload->data, sizeof(frame));
+    }
+
+    routed = server->packets_routed;
+    TEST_ASSERT_SUCCESS(usb_server_handle_urb(server, &received, sender[0]),
+                        "Data URB should be forwarded");
+    TEST_ASSERT_EQUAL(routed + 1, server->packets_routed,
+                      "Forwarded URB should be counted");
+    TEST_ASSERT_NULL(received.payload, "Payload should be handed to the queue");
+
+    TEST_ASSERT_SUCCESS(recv_test_packet(target[1], &relayed),
+                        "Target should receive a valid frame");
+    TEST_ASSERT_EQUAL(checksum, relayed.checksum,
+                      "Frame should be relayed unchanged");
+    if (relayed.payload != NULL) {
+        TEST_ASSERT_EQUAL(sizeof(frame), relayed.payload->len,
+                          "Payload length should match");
+        TEST_ASSERT(memcmp(frame, relayed.payload->data, sizeof(frame)) == 0,
+                    "Payload bytes should match");
+    }
+    xoe_wire_free_payload(&relayed);
+    xoe_wire_free_payload(&received);
+
+    close(sender[0]);
+    close(sender[1]);
+    close(target[0]);
+    close(target[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Send a header-only URB through usb_server_handle_urb()
+ */
+static int handle_header_urb(usb_server_t* server, int pair[2],
+                             const usb_urb_header_t* urb) {
+    xoe_packet_t sent;
+    xoe_packet_t received;
+    int result;
+
+    result = usb_protocol_encapsulate(urb, NULL, 0, &sent);
+    if (result != 0) {
+        return result;
+    }
+    result = xoe_wire_send(pair[1], &sent);
+    usb_protocol_free_payload(&sent);
+    if (result != 0 || xoe_wire_recv(pair[0], &received) != 0) {
+        return E_IO_ERROR;
+    }
+    result = usb_server_handle_urb(server, &received, pair[0]);
+    xoe_wire_free_payload(&received);
+    return result;
+}
+
+/**
+ * @brief Test an unlink reaches the device side and its reply comes back
+ */
+void test_handle_urb_routes_unlink(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    usb_urb_header_t received;
+    int requester[2];
+    int device[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, requester) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, device) != 0) {
+        close(requester[0]);
+        close(requester[1]);
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    /* Both ends of the forwarded device register its ID */
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, requester[0],
+                                                   0x11113333),
+                        "Requester should register");
+    TEST_ASSERT_SUCCESS(usb_server_register_client(server, device[0],
+                                                   0x11113333),
+                        "Device side should register");
+
+    init_test_urb(&urb, 0x11113333, 0);
+    urb.command = USB_CMD_UNLINK;
+    urb.seqnum = 77;
+    urb.endpoint = 0x01;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, requester, &urb),
+                        "Unlink should be routed");
+    TEST_ASSERT_SUCCESS(recv_test_urb(device[1], &received),
+                        "Device side should receive the unlink");
+    TEST_ASSERT_EQUAL(USB_CMD_UNLINK, received.command, "Command kept");
+    TEST_ASSERT_EQUAL(77, (int)received.seqnum, "Seqnum of the URB kept");
+    TEST_ASSERT_EQUAL(0x01, received.endpoint, "Endpoint kept");
+
+    urb.command = USB_RET_UNLINK;
+    urb.status = E_NOT_FOUND;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, device, &urb),
+                        "Unlink reply should be routed");
+    TEST_ASSERT_SUCCESS(recv_test_urb(requester[1], &received),
+                        "Requester should receive the reply");
+    TEST_ASSERT_EQUAL(USB_RET_UNLINK, received.command, "Reply command");
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, received.status, "Status kept");
+
+    close(requester[0]);
+    close(requester[1]);
+    close(device[0]);
+    close(device[1]);
+    usb_server_cleanup(server);
+}
+
+/* ============================================================================
+ * Descriptor Cache Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test descriptor reads and enumeration are answered by the server
+ */
+void test_cached_descriptors(void) {
+    static const uint8_t device_desc[18] = {
+        18, USB_DESC_TYPE_DEVICE, 0x00, 0x02, 0x00, 0x00, 0x00, 64,
+        0x11, 0x11, 0x44, 0x44, 0x00, 0x01, 0, 0, 0, 1
+    };
+    usb_server_t* server = usb_server_init();
+    usb_desc_cache_t cache;
+    usb_urb_header_t urb;
+    xoe_packet_t packet;
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint32_t data_len;
+    unsigned long routed;
+    int requester[2];
+    int device[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, requester) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, device) != 0) {
+        close(requester[0]);
+        close(requester[1]);
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    /* The device side registers with its descriptors as the data */
+    usb_desc_cache_init(&cache);
+    usb_desc_cache_add(&cache, USB_DESC_TYPE_DEVICE, 0, 0,
+                       device_desc, sizeof(device_desc));
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_REGISTER;
+    urb.seqnum = 1;
+    urb.device_id = 0x11114444;
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, cache.data, cache.size,
+                                                 &packet),
+                        "Encapsulation should succeed");
+    usb_server_handle_urb(server, &packet, device[0]);
+    usb_protocol_free_payload(&packet);
+    TEST_ASSERT_SUCCESS(recv_test_urb(device[1], &urb),
+                        "Device side should get its reply");
+    TEST_ASSERT_EQUAL(0, urb.status, "Registration should succeed");
+
+    /* GET_DESCRIPTOR(device, 64 bytes) is answered without the device */
+    init_test_urb(&urb, 0x11114444, 0);
+    urb.seqnum = 5;
+    urb.endpoint = 0x80;
+    urb.transfer_type = USB_TRANSFER_CONTROL;
+    urb.transfer_length = 64;
+    urb.setup[0] = USB_REQ_TYPE_STANDARD_IN;
+    urb.setup[1] = USB_REQ_GET_DESCRIPTOR;
+    urb.setup[3] = USB_DESC_TYPE_DEVICE;
+    urb.setup[6] = 64;
+    routed = server->packets_routed;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, requester, &urb),
+                        "Descriptor read should be answered");
+    TEST_ASSERT_EQUAL(routed, server->packets_routed,
+                      "Nothing should be routed to the device");
+    TEST_ASSERT_EQUAL(1, server->descriptor_hits, "Hit should be counted");
+
+    TEST_ASSERT_SUCCESS(recv_test_packet(requester[1], &packet),
+                        "Requester should get the reply");
+    data_len = sizeof(data);
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &urb, data, &data_len),
+                        "Reply should decode");
+    xoe_wire_free_payload(&packet);
+    TEST_ASSERT_EQUAL(USB_RET_SUBMIT, urb.command, "Completion");
+    TEST_ASSERT_EQUAL(5, (int)urb.seqnum, "Seqnum of the request");
+    TEST_ASSERT_EQUAL(18, (int)urb.actual_length, "Whole descriptor");
+    TEST_ASSERT(data_len == 18 && memcmp(data, device_desc, 18) == 0,
+                "Descriptor bytes");
+
+    /* Descriptors it does not hold go to the device */
+    init_test_urb(&urb, 0x11114444, 0);
+    urb.seqnum = 6;
+    urb.endpoint = 0x80;
+    urb.transfer_type = USB_TRANSFER_CONTROL;
+    urb.setup[0] = USB_REQ_TYPE_STANDARD_IN;
+    urb.setup[1] = USB_REQ_GET_DESCRIPTOR;
+    urb.setup[3] = USB_DESC_TYPE_CONFIG;
+    urb.setup[6] = 9;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, requester, &urb),
+                        "Uncached read should be routed");
+    TEST_ASSERT_SUCCESS(recv_test_urb(device[1], &urb),
+                        "Device side should receive it");
+    TEST_ASSERT_EQUAL(6, (int)urb.seqnum, "Routed request");
+
+    /* Enumeration returns the cache in its wire form */
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_ENUM;
+    urb.seqnum = 7;
+    urb.device_id = 0x11114444;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, requester, &urb),
+                        "Enumeration should be answered");
+    TEST_ASSERT_SUCCESS(recv_test_packet(requester[1], &packet),
+                        "Requester should get the reply");
+    data_len = sizeof(data);
+    TEST_ASSERT_SUCCESS(usb_protocol_decapsulate(&packet, &urb, data, &data_len),
+                        "Reply should decode");
+    xoe_wire_free_payload(&packet);
+    TEST_ASSERT_EQUAL(USB_RET_ENUM, urb.command, "Enumeration reply");
+    TEST_ASSERT_EQUAL(0, urb.status, "Descriptors found");
+    TEST_ASSERT(data_len == cache.size &&
+                memcmp(data, cache.data, cache.size) == 0, "Cache returned");
+
+    urb.command = USB_CMD_ENUM;
+    urb.device_id = 0x11115555;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, requester, &urb),
+                        "Unknown device should be answered");
+    TEST_ASSERT_SUCCESS(recv_test_urb(requester[1], &urb),
+                        "Requester should get the reply");
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, urb.status, "No such device");
+
+    close(requester[0]);
+    close(requester[1]);
+    close(device[0]);
+    close(device[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Keep the reply handed to a test reply route
+ */
+static int capture_reply(void* arg, const xoe_packet_t* packet) {
+    usb_urb_header_t* urb = (usb_urb_header_t*)arg;
+    uint8_t data[USB_MAX_DATA_SIZE];
+    uint32_t data_len = sizeof(data);
+
+    return usb_protocol_decapsulate(packet, urb, data, &data_len);
+}
+
+/**
+ * @brief Test a client with no send queue is answered through its route
+ */
+void test_reply_route(void) {
+    usb_server_t* server = usb_server_init();
+    usb_server_reply_t reply;
+    usb_urb_header_t urb;
+    usb_urb_header_t answer;
+    xoe_packet_t packet;
+    char byte;
+    int pair[2];
+
+    TEST_ASSERT_NOT_NULL(server, "Server should initialize");
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_ENUM;
+    urb.seqnum = 9;
+    urb.device_id = 0x22223333;
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, NULL, 0, &packet),
+                        "Request should encode");
+
+    memset(&answer, 0, sizeof(answer));
+    reply.send = capture_reply;
+    reply.arg = &answer;
+    TEST_ASSERT_SUCCESS(usb_server_handle_urb_from(server, &packet, pair[0],
+                                                   &reply),
+                        "Enumeration should be answered");
+    usb_protocol_free_payload(&packet);
+    TEST_ASSERT_EQUAL(USB_RET_ENUM, answer.command, "Route got the reply");
+    TEST_ASSERT_EQUAL(9, (int)answer.seqnum, "Reply to the request");
+    TEST_ASSERT_EQUAL(E_NOT_FOUND, answer.status, "No such device");
+    TEST_ASSERT(recv(pair[1], &byte, 1, MSG_DONTWAIT) < 0,
+                "Nothing written to the socket");
+
+    close(pair[0]);
+    close(pair[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Test the URBs of a batch reach their targets in order
+ */
+void test_handle_batch(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    usb_urb_header_t received;
+    xoe_packet_t packet;
+    uint8_t batch[USB_BATCH_ENTRY_SIZE(8) * 3];
+    uint8_t report[8];
+    uint32_t used = 0;
+    unsigned long errors;
+    int sender[2];
+    int device[2];
+    int i;
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, sender) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, device) != 0) {
+        close(sender[0]);
+        close(sender[1]);
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    /* The registration reply advertises batching */
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_REGISTER;
+    urb.seqnum = 1;
+    urb.device_id = 0x11116666;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, device, &urb),
+                        "Registration should succeed");
+    TEST_ASSERT_SUCCESS(recv_test_urb(device[1], &received),
+                        "Device side should get its reply");
+    TEST_ASSERT(received.flags & USB_FLAG_BATCH, "Batching advertised");
+
+    /* Three interrupt reports in one frame */
+    memset(report, 0, sizeof(report));
+    for (i = 0; i < 3; i++) {
+        init_test_urb(&urb, 0x11116666, sizeof(report));
+        urb.seqnum = 10 + (uint32_t)i;
+        urb.transfer_type = USB_TRANSFER_INTERRUPT;
+        report[0] = (uint8_t)i;
+        usb_protocol_batch_append(batch, sizeof(batch), &used, &urb,
+                                  report, sizeof(report));
+    }
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_BATCH;
+    urb.number_of_packets = 3;
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, batch, used, &packet),
+                        "Encapsulation should succeed");
+    TEST_ASSERT_SUCCESS(usb_server_handle_urb(server, &packet, sender[0]),
+                        "Batch should be handled");
+    usb_protocol_free_payload(&packet);
+    TEST_ASSERT_EQUAL(1, server->batches_received, "Batch counted");
+    TEST_ASSERT_EQUAL(3, server->batched_urbs, "URBs counted");
+
+    for (i = 0; i < 3; i++) {
+        TEST_ASSERT_SUCCESS(recv_test_urb(device[1], &received),
+                            "Device side should receive each URB");
+        TEST_ASSERT_EQUAL(10 + i, (int)received.seqnum, "In batch order");
+        TEST_ASSERT_EQUAL(USB_CMD_SUBMIT, received.command, "Unpacked URB");
+    }
+
+    /* An entry count that does not match drops the whole batch */
+    urb.number_of_packets = 4;
+    TEST_ASSERT_SUCCESS(usb_protocol_encapsulate(&urb, batch, used, &packet),
+                        "Encapsulation should succeed");
+    errors = server->routing_errors;
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      usb_server_handle_urb(server, &packet, sender[0]),
+                      "Malformed batch should be refused");
+    usb_protocol_free_payload(&packet);
+    TEST_ASSERT_EQUAL(errors + 1, server->routing_errors, "Error counted");
+    TEST_ASSERT_EQUAL(1, server->batches_received, "Nothing unpacked");
+
+    close(sender[0]);
+    close(sender[1]);
+    close(device[0]);
+    close(device[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Register a device on a socket and answer the challenge it gets
+ *
+ * @param secret Secret to answer with
+ * @return Status of the final USB_RET_REGISTER, or negative test error
+ */
+static int register_with_secret(usb_server_t* server, int pair[2],
+                                uint32_t device_id, const char* secret) {
+    usb_urb_header_t urb;
+    usb_auth_payload_t auth;
+    xoe_packet_t packet;
+    uint32_t data_len = sizeof(auth);
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_REGISTER;
+    urb.seqnum = 3;
+    urb.device_id = device_id;
+    urb.endpoint = 0x08;  /* Mass storage */
+    if (handle_header_urb(server, pair, &urb) != 0 ||
+        recv_test_packet(pair[1], &packet) != 0) {
+        return E_IO_ERROR;
+    }
+    if (usb_protocol_decapsulate(&packet, &urb, &auth, &data_len) != 0 ||
+        urb.command != USB_CMD_AUTH || data_len != sizeof(auth)) {
+        xoe_wire_free_payload(&packet);
+        return E_PROTOCOL_ERROR;
+    }
+    xoe_wire_free_payload(&packet);
+
+    usb_auth_compute_response(secret, auth.challenge, auth.device_id,
+                              auth.device_class, auth.response);
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_RET_AUTH;
+    urb.seqnum = 3;
+    urb.device_id = device_id;
+    if (usb_protocol_encapsulate(&urb, &auth, sizeof(auth), &packet) != 0) {
+        return E_OUT_OF_MEMORY;
+    }
+    usb_server_handle_urb(server, &packet, pair[0]);
+    usb_protocol_free_payload(&packet);
+
+    if (recv_test_urb(pair[1], &urb) != 0 || urb.command != USB_RET_REGISTER) {
+        return E_PROTOCOL_ERROR;
+    }
+    return urb.status;
+}
+
+/**
+ * @brief Test registrations are verified with the server's keyed HMAC
+ */
+void test_auth_registration(void) {
+    usb_server_t* server = usb_server_init();
+    usb_auth_key_t* key;
+    uint8_t challenge[USB_AUTH_CHALLENGE_LEN];
+    uint8_t one_shot[USB_AUTH_RESPONSE_LEN];
+    uint8_t keyed[USB_AUTH_RESPONSE_LEN];
+    int good[2];
+    int bad[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, good) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, bad) != 0) {
+        close(good[0]);
+        close(good[1]);
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+
+    /* A prepared key computes what the one-shot HMAC does */
+    key = usb_auth_key_create("site-secret");
+    TEST_ASSERT_NOT_NULL(key, "Key should be created");
+    memset(challenge, 0xA5, sizeof(challenge));
+    usb_auth_compute_response("site-secret", challenge, 0x12345678, 8, one_shot);
+    TEST_ASSERT_SUCCESS(usb_auth_key_compute(key, challenge, 0x12345678, 8,
+                                             keyed),
+                        "Keyed HMAC should compute");
+    TEST_ASSERT(memcmp(one_shot, keyed, sizeof(keyed)) == 0,
+                "Keyed and one-shot HMAC agree");
+    TEST_ASSERT_EQUAL(1, usb_auth_key_verify(key, challenge, 0x12345678, 8,
+                                             one_shot), "Response verifies");
+    TEST_ASSERT_EQUAL(0, usb_auth_key_verify(key, challenge, 0x12345679, 8,
+                                             one_shot), "Other device fails");
+    usb_auth_key_free(key);
+    TEST_ASSERT_NULL(usb_auth_key_create(""), "Empty secret refused");
+
+    TEST_ASSERT_SUCCESS(usb_server_set_auth_secret(server, "site-secret"),
+                        "Secret should be set");
+    TEST_ASSERT_EQUAL(0, register_with_secret(server, good, 0x11117777,
+                                              "site-secret"),
+                      "Right secret should register");
+    TEST_ASSERT_EQUAL(E_USB_AUTH_FAILED,
+                      register_with_secret(server, bad, 0x11118888,
+                                           "wrong-secret"),
+                      "Wrong secret should be refused");
+    TEST_ASSERT_EQUAL(1, server->auth_failures, "Failure counted");
+
+    close(good[0]);
+    close(good[1]);
+    close(bad[0]);
+    close(bad[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Receive a challenge and answer it with a secret
+ *
+ * @param urb Receives the challenge header (its seqnum names the
+ *            registration); the answer is not sent
+ * @param auth Receives the payload, response filled in
+ * @return 0 on success, negative test error
+ */
+static int recv_challenge(int fd, const char* secret, usb_urb_header_t* urb,
+                          usb_auth_payload_t* auth) {
+    xoe_packet_t packet;
+    uint32_t data_len = sizeof(*auth);
+    int result;
+
+    if (recv_test_packet(fd, &packet) != 0) {
+        return E_IO_ERROR;
+    }
+    result = usb_protocol_decapsulate(&packet, urb, auth, &data_len);
+    xoe_wire_free_payload(&packet);
+    if (result != 0 || urb->command != USB_CMD_AUTH ||
+        data_len != sizeof(*auth)) {
+        return E_PROTOCOL_ERROR;
+    }
+    usb_auth_compute_response(secret, auth->challenge, auth->device_id,
+                              auth->device_class, auth->response);
+    return 0;
+}
+
+/**
+ * @brief Send an authentication response for a registration
+ */
+static int send_auth_response(usb_server_t* server, int fd, uint32_t seqnum,
+                              const usb_auth_payload_t* auth) {
+    usb_urb_header_t urb;
+    xoe_packet_t packet;
+    int result;
+
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_RET_AUTH;
+    urb.seqnum = seqnum;
+    urb.device_id = auth->device_id;
+    if (usb_protocol_encapsulate(&urb, auth, sizeof(*auth), &packet) != 0) {
+        return E_OUT_OF_MEMORY;
+    }
+    result = usb_server_handle_urb(server, &packet, fd);
+    usb_protocol_free_payload(&packet);
+    return result;
+}
+
+/**
+ * @brief Test registrations in flight together are each answered by seqnum
+ */
+void test_pipelined_auth(void) {
+    usb_server_t* server = usb_server_init();
+    usb_urb_header_t urb;
+    usb_urb_header_t first;
+    usb_urb_header_t second;
+    usb_auth_payload_t first_auth;
+    usb_auth_payload_t second_auth;
+    int pair[2];
+
+    if (server == NULL || socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+        TEST_SKIP("setup failed");
+        usb_server_cleanup(server);
+        return;
+    }
+    usb_server_set_auth_secret(server, "site-secret");
+
+    /* Both requests go out before either challenge is read */
+    memset(&urb, 0, sizeof(urb));
+    urb.command = USB_CMD_REGISTER;
+    urb.seqnum = 10;
+    urb.device_id = 0x11110001;
+    urb.endpoint = 0x08;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, pair, &urb),
+                        "First registration sent");
+    urb.seqnum = 11;
+    urb.device_id = 0x11110002;
+    TEST_ASSERT_SUCCESS(handle_header_urb(server, pair, &urb),
+                        "Second registration sent");
+
+    TEST_ASSERT_SUCCESS(recv_challenge(pair[1], "site-secret", &first,
+                                       &first_auth), "First challenge");
+    TEST_ASSERT_SUCCESS(recv_challenge(pair[1], "site-secret", &second,
+                                       &second_auth), "Second challenge");
+    TEST_ASSERT_EQUAL(10, (int)first.seqnum, "Challenge names its request");
+    TEST_ASSERT_EQUAL(11, (int)second.seqnum, "Challenge names its request");
+
+    /* A response for no registration in flight is refused */
+    TEST_ASSERT(send_auth_response(server, pair[0], 12, &second_auth) != 0,
+                "Unknown seqnum refused");
+
+    /* Answered in the other order, each completes its own registration */
+    TEST_ASSERT_SUCCESS(send_auth_response(server, pair[0], 11, &second_auth),
+                        "Second answered");
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb), "Second reply");
+    TEST_ASSERT(urb.command == USB_RET_REGISTER && urb.seqnum == 11 &&
+                urb.status == 0, "Second registered");
+
+    TEST_ASSERT_SUCCESS(send_auth_response(server, pair[0], 10, &first_auth),
+                        "First answered");
+    TEST_ASSERT_SUCCESS(recv_test_urb(pair[1], &urb), "First reply");
+    TEST_ASSERT(urb.command == USB_RET_REGISTER && urb.seqnum == 10 &&
+                urb.status == 0, "First registered");
+
+    TEST_ASSERT_EQUAL(2, server->active_clients, "Both devices routable");
+    TEST_ASSERT_EQUAL(0, server->auth_failures, "No failure counted");
+
+    close(pair[0]);
+    close(pair[1]);
+    usb_server_cleanup(server);
+}
+
+/**
+ * @brief Test server mode starts the USB server on first use
+ */
+void test_lazy_start(void) {
+    xoe_config_t config;
+    usb_server_t* usb;
+
+    memset(&config, 0, sizeof(config));
+    config.usb_classes[0] = 0x03;
+    config.usb_class_count = 1;
+    config.usb_iso_budget_kbps = 100;
+
+    server_usb_prepare(&config);
+    TEST_ASSERT_NULL(g_usb_server, "Not started when prepared");
+#if !XOE_USB_ENABLED
+    TEST_ASSERT_NULL(server_usb_get(), "Never started without USB support");
+    return;
+#endif
+
+    usb = server_usb_get();
+    TEST_ASSERT_NOT_NULL(usb, "Started on first use");
+    TEST_ASSERT(g_usb_server == usb, "Published");
+    TEST_ASSERT(server_usb_get() == usb, "Started once");
+    TEST_ASSERT_EQUAL(1, usb->allowed_class_count, "Whitelist applied");
+    TEST_ASSERT_EQUAL(100 * 1024, (int)usb->iso_budget, "Budget applied");
+
+    server_usb_cleanup();
+    TEST_ASSERT_NULL(g_usb_server, "Stopped");
+    server_usb_cleanup();
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB Server Unit Tests ===\n\n");
+
+    /* Registry tests */
+    run_test("test_route_many_clients", test_route_many_clients);
+    run_test("test_route_no_target", test_route_no_target);
+    run_test("test_unregister_and_reuse", test_unregister_and_reuse);
+    run_test("test_route_size_gate", test_route_size_gate);
+    run_test("test_iso_budget", test_iso_budget);
+
+    /* Forwarding tests */
+    run_test("test_handle_urb_forwards_frame", test_handle_urb_forwards_frame);
+    run_test("test_handle_urb_routes_unlink", test_handle_urb_routes_unlink);
+
+    /* Descriptor cache tests */
+    run_test("test_cached_descriptors", test_cached_descriptors);
+    run_test("test_reply_route", test_reply_route);
+    run_test("test_handle_batch", test_handle_batch);
+    run_test("test_auth_registration", test_auth_registration);
+    run_test("test_pipelined_auth", test_pipelined_auth);
+
+    /* Server mode tests */
+    run_test("test_lazy_start", test_lazy_start);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,248 @@
+/**
+ * @file test_usb_virtual.c
+ * @brief Unit tests for the virtual USB loopback device
+ *
+ * Drives the virtual backend through the synchronous transfer API: data
+ * integrity across the loopback ring, libusb-style timeouts, endpoint
+ * validation, rate pacing and release through usb_device_close().
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "connectors/usb/usb_virtual.h"
+#include "connectors/usb/usb_transfer.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * @brief Milliseconds on the monotonic clock
+ */
+static long test_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long)ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/* ============================================================================
+ * Loopback Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test OUT data comes back on IN, across the ring wrap
+ */
+void test_loopback_data(void) {
+    usb_virtual_config_t config;
+    usb_virtual_stats_t stats;
+    usb_device_t dev;
+    unsigned char out[300];
+    unsigned char in[300];
+    int transferred = 0;
+    int matched = 0;
+    int round;
+    int i;
+
+    /* Small ring so the rounds wrap around it */
+    usb_virtual_config_init(&config);
+    config.fifo_size = 512;
+    if (usb_virtual_open(&dev, &config) != 0) {
+        TEST_SKIP("virtual device open failed");
+        return;
+    }
+    TEST_ASSERT(usb_device_is_connected(&dev),
+                "Virtual device should report connected");
+
+    for (round = 0; round < 4; round++) {
+        for (i = 0; i < (int)sizeof(out); i++) {
+            out[i] = (unsigned char)(round * 31 + i);
+        }
+        if (usb_transfer_bulk_write(&dev, USB_VIRTUAL_OUT_ENDPOINT, out,
+                                    (int)sizeof(out), &transferred,
+                                    100) != 0 ||
+            transferred != (int)sizeof(out)) {
+            continue;
+        }
+        if (usb_transfer_bulk_read(&dev, USB_VIRTUAL_IN_ENDPOINT, in,
+                                   (int)sizeof(in), &transferred, 100) == 0 &&
+            transferred == (int)sizeof(in) &&
+            memcmp(in, out, sizeof(out)) == 0) {
+            matched++;
+        }
+    }
+    TEST_ASSERT_EQUAL(4, matched, "Every round should loop back intact");
+
+    TEST_ASSERT_SUCCESS(usb_virtual_get_stats(&dev, &stats),
+                        "Stats should be available");
+    TEST_ASSERT_EQUAL(4, stats.out_transfers, "Four OUT transfers");
+    TEST_ASSERT_EQUAL(4 * sizeof(out), stats.in_bytes,
+                      "All bytes should come back");
+
+    TEST_ASSERT_SUCCESS(usb_device_close(&dev), "Close should succeed");
+    TEST_ASSERT(!usb_device_is_connected(&dev),
+                "Closed device should report disconnected");
+}
+
+/**
+ * @brief Test IN returns what is queued rather than filling the buffer
+ */
+void test_short_read(void) {
+    usb_device_t dev;
+    unsigned char data[64];
+    int transferred = 0;
+
+    if (usb_virtual_open(&dev, NULL) != 0) {
+        TEST_SKIP("virtual device open failed");
+        return;
+    }
+
+    memset(data, 0x5a, sizeof(data));
+    TEST_ASSERT_SUCCESS(usb_transfer_bulk_write(&dev, USB_VIRTUAL_OUT_ENDPOINT,
+                                                data, 10, &transferred, 100),
+                        "Write should succeed");
+    TEST_ASSERT_SUCCESS(usb_transfer_bulk_read(&dev, USB_VIRTUAL_IN_ENDPOINT,
+                                               data, (int)sizeof(data),
+                                               &transferred, 100),
+                        "Read should succeed");
+    TEST_ASSERT_EQUAL(10, transferred, "Read should return the queued bytes");
+
+    usb_device_close(&dev);
+}
+
+/* ============================================================================
+ * Timeout and Validation Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test an empty IN endpoint and a full ring time out
+ */
+void test_timeouts(void) {
+    usb_virtual_config_t config;
+    usb_virtual_stats_t stats;
+    usb_device_t dev;
+    unsigned char data[128];
+    int transferred = -1;
+
+    usb_virtual_config_init(&config);
+    config.fifo_size = 100;
+    if (usb_virtual_open(&dev, &config) != 0) {
+        TEST_SKIP("virtual device open failed");
+        return;
+    }
+
+    TEST_ASSERT_ERROR(usb_transfer_bulk_read(&dev, USB_VIRTUAL_IN_ENDPOINT,
+                                             data, (int)sizeof(data),
+                                             &transferred, 20),
+                      E_TIMEOUT, "Empty IN endpoint should time out");
+    TEST_ASSERT_EQUAL(0, transferred, "Timed out read moves nothing");
+
+    /* Only the ring capacity is accepted before the timeout */
+    memset(data, 0, sizeof(data));
+    TEST_ASSERT_ERROR(usb_transfer_bulk_write(&dev, USB_VIRTUAL_OUT_ENDPOINT,
+                                              data, (int)sizeof(data),
+                                              &transferred, 20),
+                      E_TIMEOUT, "Write into a full ring should time out");
+    TEST_ASSERT_EQUAL(100, transferred, "Partial write should be reported");
+
+    TEST_ASSERT_SUCCESS(usb_virtual_get_stats(&dev, &stats),
+                        "Stats should be available");
+    TEST_ASSERT_EQUAL(2, stats.timeouts, "Both timeouts should be counted");
+
+    usb_device_close(&dev);
+}
+
+/**
+ * @brief Test endpoint direction and address checks
+ */
+void test_endpoint_validation(void) {
+    usb_virtual_config_t config;
+    usb_device_t dev;
+    unsigned char data[8];
+    int transferred = 0;
+
+    usb_virtual_config_init(&config);
+    config.in_endpoint = 0x02;
+    TEST_ASSERT_ERROR(usb_virtual_open(&dev, &config), E_INVALID_ARGUMENT,
+                      "IN endpoint without direction bit should be rejected");
+
+    if (usb_virtual_open(&dev, NULL) != 0) {
+        TEST_SKIP("virtual device open failed");
+        return;
+    }
+
+    memset(data, 0, sizeof(data));
+    TEST_ASSERT_ERROR(usb_transfer_bulk_write(&dev, USB_VIRTUAL_IN_ENDPOINT,
+                                              data, (int)sizeof(data),
+                                              &transferred, 10),
+                      E_INVALID_ARGUMENT, "Write to an IN endpoint fails");
+    TEST_ASSERT_ERROR(usb_transfer_bulk_write(&dev, 0x05, data,
+                                              (int)sizeof(data),
+                                              &transferred, 10),
+                      E_USB_PIPE_ERROR, "Unknown endpoint should fail");
+    TEST_ASSERT_ERROR(usb_virtual_get_stats(NULL, NULL), E_INVALID_ARGUMENT,
+                      "Stats need a virtual device");
+
+    usb_device_close(&dev);
+}
+
+/* ============================================================================
+ * Pacing Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test transfers on one endpoint add up to the configured rate
+ */
+void test_rate_pacing(void) {
+    usb_virtual_config_t config;
+    usb_device_t dev;
+    unsigned char data[1000];
+    int transferred = 0;
+    long start;
+    long elapsed;
+    int i;
+
+    /* 100 KB/s: five 1000-byte writes take 50 ms */
+    usb_virtual_config_init(&config);
+    config.out_rate = 100000;
+    if (usb_virtual_open(&dev, &config) != 0) {
+        TEST_SKIP("virtual device open failed");
+        return;
+    }
+
+    memset(data, 0, sizeof(data));
+    start = test_now_ms();
+    for (i = 0; i < 5; i++) {
+        usb_transfer_bulk_write(&dev, USB_VIRTUAL_OUT_ENDPOINT, data,
+                                (int)sizeof(data), &transferred, 1000);
+    }
+    elapsed = test_now_ms() - start;
+    TEST_ASSERT_RANGE(elapsed, 49, 500, "Writes should be paced at the rate");
+
+    usb_device_close(&dev);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== USB Virtual Device Unit Tests ===\n\n");
+
+    /* Loopback tests */
+    run_test("test_loopback_data", test_loopback_data);
+    run_test("test_short_read", test_short_read);
+
+    /* Timeout and validation tests */
+    run_test("test_timeouts", test_timeouts);
+    run_test("test_endpoint_validation", test_endpoint_validation);
+
+    /* Pacing tests */
+    run_test("test_rate_pacing", test_rate_pacing);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,492 @@
+/**
+ * @file test_wire_capture.c
+ * @brief Unit tests for wire capture files and their replay
+ *
+ * Writes captures through the recorder and the real send/receive paths,
+ * reads them back through the mmap reader (frame order, payloads,
+ * connection numbers, snap length, ring wrap-around, the size limit and
+ * damaged files), and replays one against a listener that checks the
+ * frames arrive as captured.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "core/replay_client.h"
+#include "lib/protocol/wire_capture.h"
+#include "lib/protocol/wire_trace.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+/* Descriptors used for the synthetic (no real socket) tests */
+#define TEST_FD_A 900
+#define TEST_FD_B 901
+
+/* Frames each replayed connection carries */
+#define REPLAY_FRAMES 20
+
+static char capture_path[64];
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Pick a fresh trace file name
+ */
+static void make_capture_path(void)
+{
+    int fd;
+
+    strcpy(capture_path, "/tmp/xoe_capture_XXXXXX");
+    fd = mkstemp(capture_path);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/**
+ * @brief Record a frame whose payload is @p len bytes of @p fill
+ */
+static void record_frame(int fd, int type, uint16_t protocol_id,
+                         uint32_t len, uint8_t fill)
+{
+    static uint8_t payload[XOE_WIRE_MAX_PAYLOAD];
+    uint8_t header_buffer[XOE_WIRE_HEADER_SIZE];
+    xoe_wire_header_t header;
+
+    memset(payload, fill, len);
+    header.protocol_id = protocol_id;
+    header.protocol_version = 1;
+    header.payload_length = len;
+    header.checksum = xoe_wire_packet_checksum(&header, payload);
+    xoe_wire_serialize_header(header_buffer, &header);
+
+    xoe_wire_capture_frame(fd, type, header_buffer,
+                           (len > 0) ? payload : NULL, XOE_WIRE_TRACE_OK);
+}
+
+/* ============================================================================
+ * File Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test frames come back in order with their fields and payloads
+ */
+void test_roundtrip(void) {
+    xoe_wire_capture_reader_t reader;
+    const xoe_wire_capture_record_t* record;
+    const uint8_t* payload;
+    xoe_wire_capture_stats_t stats;
+    uint32_t conn_a;
+    uint32_t conn_b;
+    struct stat st;
+
+    make_capture_path();
+    xoe_wire_trace_reset(TEST_FD_A);
+    xoe_wire_trace_reset(TEST_FD_B);
+
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_open(capture_path,
+                            XOE_WIRE_CAPTURE_ROLE_SERVER, 0), "Open");
+    TEST_ASSERT(xoe_wire_capture_active(), "Recording");
+    TEST_ASSERT_ERROR(xoe_wire_capture_open(capture_path,
+                          XOE_WIRE_CAPTURE_ROLE_SERVER, 0),
+                      E_INVALID_STATE, "Only one capture at a time");
+
+    record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_RX, 0x0001, 100, 0xA1);
+    record_frame(TEST_FD_B, XOE_WIRE_CAPTURE_RX, 0x0002, 0, 0);
+    record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_TX, 0x0001, 5000, 0xA2);
+    conn_a = xoe_wire_trace_conn_id(TEST_FD_A);
+    conn_b = xoe_wire_trace_conn_id(TEST_FD_B);
+    TEST_ASSERT(conn_a != 0 && conn_b != 0 && conn_a != conn_b,
+                "Distinct connection numbers");
+
+    xoe_wire_capture_close();
+    TEST_ASSERT(!xoe_wire_capture_active(), "Stopped");
+    record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_RX, 0x0001, 10, 0);
+
+    xoe_wire_capture_get_stats(&stats);
+    TEST_ASSERT_EQUAL(3, (int)stats.frames, "Three frames recorded");
+    TEST_ASSERT_EQUAL(0, (int)stats.dropped, "None dropped");
+    TEST_ASSERT_EQUAL(0, (int)(stats.bytes % XOE_WIRE_CAPTURE_PAGE),
+                      "Whole pages written");
+    TEST_ASSERT_EQUAL(0, stat(capture_path, &st), "File exists");
+    TEST_ASSERT_EQUAL((long)(XOE_WIRE_CAPTURE_PAGE + stats.bytes),
+                      (long)st.st_size, "Preallocated tail trimmed");
+
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_reader_open(&reader, capture_path),
+                        "Reader open");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_ROLE_SERVER, (int)reader.header->role,
+                      "Role kept");
+    TEST_ASSERT_EQUAL(3, (int)reader.header->frames, "Frame count kept");
+
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "First");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_RX, record->type, "First received");
+    TEST_ASSERT_EQUAL(conn_a, record->conn_id, "First connection");
+    TEST_ASSERT_EQUAL(100, (int)record->length, "First length");
+    TEST_ASSERT_EQUAL(100, (int)record->captured, "First complete");
+    TEST_ASSERT_EQUAL(0x0001, xoe_wire_read_uint16(record->header),
+                      "First protocol");
+    TEST_ASSERT(payload[0] == 0xA1 && payload[99] == 0xA1, "First payload");
+
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "Second");
+    TEST_ASSERT_EQUAL(conn_b, record->conn_id, "Second connection");
+    TEST_ASSERT_EQUAL(0, (int)record->length, "Empty payload");
+
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "Third");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_TX, record->type, "Third sent");
+    TEST_ASSERT(payload[0] == 0xA2 && payload[4999] == 0xA2, "Third payload");
+
+    TEST_ASSERT_EQUAL(0, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "End");
+    xoe_wire_capture_reader_rewind(&reader);
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "Rewound");
+    TEST_ASSERT_EQUAL(100, (int)record->length, "First again");
+    xoe_wire_capture_reader_close(&reader);
+    unlink(capture_path);
+}
+
+/**
+ * @brief Test frames above the snap length keep their length only
+ */
+void test_snaplen(void) {
+    xoe_wire_capture_reader_t reader;
+    const xoe_wire_capture_record_t* record;
+    const uint8_t* payload;
+
+    make_capture_path();
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_open(capture_path,
+                            XOE_WIRE_CAPTURE_ROLE_CLIENT, 0), "Open");
+    record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_TX, 0x0001,
+                 XOE_WIRE_CAPTURE_SNAPLEN + 1000, 0x5A);
+    xoe_wire_capture_close();
+
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_reader_open(&reader, capture_path),
+                        "Reader open");
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "Record");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_SNAPLEN + 1000, (int)record->length,
+                      "Full length kept");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_SNAPLEN, (int)record->captured,
+                      "Payload cut");
+    TEST_ASSERT_EQUAL(0x5A, payload[XOE_WIRE_CAPTURE_SNAPLEN - 1],
+                      "Kept part intact");
+    xoe_wire_capture_reader_close(&reader);
+    unlink(capture_path);
+}
+
+/**
+ * @brief Test several laps of the ring, with records across pages, come
+ *        back complete and in order
+ */
+void test_ring_wrap(void) {
+    xoe_wire_capture_reader_t reader;
+    const xoe_wire_capture_record_t* record;
+    const uint8_t* payload;
+    xoe_wire_capture_stats_t stats;
+    uint32_t frames = (3 * XOE_WIRE_CAPTURE_RING) / 3000;
+    uint32_t expected_len;
+    uint32_t read_count = 0;
+    uint32_t i;
+    int in_order = TRUE;
+
+    make_capture_path();
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_open(capture_path,
+                            XOE_WIRE_CAPTURE_ROLE_SERVER, 0), "Open");
+    for (i = 0; i < frames; i++) {
+        record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_RX, 0x0001,
+                     1000 + i % 3000, (uint8_t)i);
+        /* Give the writer room, so nothing is dropped */
+        if (i % 64 == 0) {
+            usleep(1000);
+        }
+    }
+    xoe_wire_capture_close();
+    xoe_wire_capture_get_stats(&stats);
+
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_reader_open(&reader, capture_path),
+                        "Reader open");
+    while (xoe_wire_capture_reader_next(&reader, &record, &payload) == 1) {
+        /* Dropped frames leave gaps; the rest stay in order */
+        while (read_count < frames &&
+               (uint8_t)read_count != payload[0]) {
+            read_count++;
+        }
+        expected_len = 1000 + read_count % 3000;
+        if (record->length != expected_len ||
+            payload[record->captured - 1] != (uint8_t)read_count) {
+            in_order = FALSE;
+        }
+        read_count++;
+    }
+    xoe_wire_capture_reader_close(&reader);
+
+    TEST_ASSERT(in_order, "Frames intact and in order");
+    TEST_ASSERT_EQUAL((int)frames, (int)(stats.frames + stats.dropped),
+                      "Every frame recorded or counted as dropped");
+    TEST_ASSERT(stats.bytes > 2 * XOE_WIRE_CAPTURE_RING,
+                "Wrapped the ring");
+    unlink(capture_path);
+}
+
+/**
+ * @brief Test recording stops at the size limit
+ */
+void test_size_limit(void) {
+    xoe_wire_capture_stats_t stats;
+    int i;
+
+    make_capture_path();
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_open(capture_path,
+                            XOE_WIRE_CAPTURE_ROLE_SERVER,
+                            XOE_WIRE_CAPTURE_PAGE * 4), "Open");
+    for (i = 0; i < 20; i++) {
+        record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_RX, 0x0001, 1000, 1);
+    }
+    xoe_wire_capture_close();
+    xoe_wire_capture_get_stats(&stats);
+
+    TEST_ASSERT(stats.frames > 0 && stats.frames < 20, "Some recorded");
+    TEST_ASSERT_EQUAL(20, (int)(stats.frames + stats.dropped),
+                      "The rest dropped");
+    TEST_ASSERT(stats.bytes <= XOE_WIRE_CAPTURE_PAGE * 4, "Within the limit");
+    unlink(capture_path);
+}
+
+/**
+ * @brief Test files that are not captures are refused
+ */
+void test_bad_file(void) {
+    xoe_wire_capture_reader_t reader;
+    uint8_t junk[XOE_WIRE_CAPTURE_PAGE];
+    FILE* file;
+
+    TEST_ASSERT_ERROR(xoe_wire_capture_reader_open(&reader,
+                          "/nonexistent/capture"), E_FILE_NOT_FOUND,
+                      "Missing file");
+
+    make_capture_path();
+    memset(junk, 0x77, sizeof(junk));
+    file = fopen(capture_path, "wb");
+    TEST_ASSERT_NOT_NULL(file, "Create");
+    fwrite(junk, 1, sizeof(junk), file);
+    fclose(file);
+    TEST_ASSERT_ERROR(xoe_wire_capture_reader_open(&reader, capture_path),
+                      E_PROTOCOL_ERROR, "Wrong magic");
+    unlink(capture_path);
+
+    TEST_ASSERT_ERROR(xoe_wire_capture_open(capture_path, 0, 0),
+                      E_INVALID_ARGUMENT, "Unknown role");
+}
+
+/**
+ * @brief Test the real send and receive paths record both ends
+ */
+void test_wire_paths_capture(void) {
+    xoe_wire_capture_reader_t reader;
+    const xoe_wire_capture_record_t* record;
+    const uint8_t* payload;
+    xoe_packet_t packet;
+    xoe_packet_t received;
+    uint8_t data[4] = {1, 2, 3, 4};
+    int sv[2];
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv),
+                      "socketpair");
+    xoe_wire_trace_reset(sv[0]);
+    xoe_wire_trace_reset(sv[1]);
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = 0x0003;
+    packet.protocol_version = 1;
+    packet.payload = xoe_payload_alloc(sizeof(data));
+    memcpy(packet.payload->data, data, sizeof(data));
+
+    make_capture_path();
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_open(capture_path,
+                            XOE_WIRE_CAPTURE_ROLE_CLIENT, 0), "Open");
+    TEST_ASSERT_EQUAL(0, xoe_wire_send(sv[0], &packet), "Send");
+    TEST_ASSERT_EQUAL(0, xoe_wire_recv(sv[1], &received), "Receive");
+    xoe_wire_capture_close();
+    xoe_wire_free_payload(&received);
+    xoe_wire_free_payload(&packet);
+
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_reader_open(&reader, capture_path),
+                        "Reader open");
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "Sent");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_TX, record->type, "Sent first");
+    TEST_ASSERT_EQUAL(xoe_wire_trace_conn_id(sv[0]), record->conn_id,
+                      "Sender's connection");
+    TEST_ASSERT(memcmp(payload, data, sizeof(data)) == 0, "Sent payload");
+    TEST_ASSERT_EQUAL(1, xoe_wire_capture_reader_next(&reader, &record,
+                                                      &payload), "Received");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CAPTURE_RX, record->type, "Received second");
+    TEST_ASSERT_EQUAL(xoe_wire_trace_conn_id(sv[1]), record->conn_id,
+                      "Receiver's connection");
+    TEST_ASSERT_EQUAL(0x0003, xoe_wire_read_uint16(record->header),
+                      "Header as on the wire");
+    xoe_wire_capture_reader_close(&reader);
+    unlink(capture_path);
+
+    close(sv[0]);
+    close(sv[1]);
+}
+
+/* ============================================================================
+ * Replay Tests
+ * ============================================================================ */
+
+/**
+ * @brief What the listener saw
+ */
+typedef struct {
+    int listen_fd;
+    int connections;
+    int frames;
+    int payload_ok;
+} replay_sink_t;
+
+/**
+ * @brief Accept two connections and check every frame they carry
+ */
+static void* replay_sink(void* arg)
+{
+    replay_sink_t* sink = (replay_sink_t*)arg;
+    xoe_packet_t packet;
+    int fds[2];
+    int i;
+    int n;
+
+    sink->payload_ok = TRUE;
+    for (i = 0; i < 2; i++) {
+        fds[i] = accept(sink->listen_fd, NULL, NULL);
+        if (fds[i] < 0) {
+            return NULL;
+        }
+        sink->connections++;
+    }
+
+    /* Connection i carries fill bytes 0x10 + i, lengths 1..REPLAY_FRAMES */
+    for (i = 0; i < 2; i++) {
+        for (n = 1; n <= REPLAY_FRAMES; n++) {
+            if (xoe_wire_recv(fds[i], &packet) != 0) {
+                sink->payload_ok = FALSE;
+                break;
+            }
+            if (packet.payload == NULL ||
+                packet.payload->len != (uint32_t)n * 100 ||
+                ((const uint8_t*)packet.payload->data)[0] != 0x10 + i) {
+                sink->payload_ok = FALSE;
+            }
+            sink->frames++;
+            xoe_wire_free_payload(&packet);
+        }
+        close(fds[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Test a server-side capture replays its received frames, one
+ *        connection per captured connection
+ */
+void test_replay(void) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    replay_config_t config;
+    replay_result_t result;
+    replay_sink_t sink;
+    pthread_t thread;
+    int n;
+
+    make_capture_path();
+    xoe_wire_trace_reset(TEST_FD_A);
+    xoe_wire_trace_reset(TEST_FD_B);
+    TEST_ASSERT_SUCCESS(xoe_wire_capture_open(capture_path,
+                            XOE_WIRE_CAPTURE_ROLE_SERVER, 0), "Open");
+    for (n = 1; n <= REPLAY_FRAMES; n++) {
+        record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_RX, 0x0001,
+                     (uint32_t)n * 100, 0x10);
+        /* Replies are not replayed */
+        record_frame(TEST_FD_A, XOE_WIRE_CAPTURE_TX, 0x0001, 7, 0xEE);
+        record_frame(TEST_FD_B, XOE_WIRE_CAPTURE_RX, 0x0001,
+                     (uint32_t)n * 100, 0x11);
+    }
+    xoe_wire_capture_close();
+
+    memset(&sink, 0, sizeof(sink));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sink.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    TEST_ASSERT(sink.listen_fd >= 0, "Listener socket");
+    TEST_ASSERT_EQUAL(0, bind(sink.listen_fd, (struct sockaddr*)&addr,
+                              sizeof(addr)), "Bind");
+    TEST_ASSERT_EQUAL(0, listen(sink.listen_fd, 4), "Listen");
+    getsockname(sink.listen_fd, (struct sockaddr*)&addr, &addr_len);
+    TEST_ASSERT_EQUAL(0, pthread_create(&thread, NULL, replay_sink, &sink),
+                      "Listener thread");
+
+    replay_config_init_defaults(&config);
+    config.path = capture_path;
+    config.speed = 0;
+    TEST_ASSERT_SUCCESS(replay_client_run(&config, "127.0.0.1",
+                                          ntohs(addr.sin_port), NULL, NULL,
+                                          NULL, &result), "Replay");
+    pthread_join(thread, NULL);
+    close(sink.listen_fd);
+
+    TEST_ASSERT_EQUAL(2, result.connected, "A connection per capture one");
+    TEST_ASSERT_EQUAL(2 * REPLAY_FRAMES, (int)result.frames_sent,
+                      "Received frames replayed, replies not");
+    TEST_ASSERT_EQUAL(0, (int)result.frames_skipped, "None skipped");
+    TEST_ASSERT_EQUAL(2, sink.connections, "Listener saw both");
+    TEST_ASSERT_EQUAL(2 * REPLAY_FRAMES, sink.frames, "All frames arrived");
+    TEST_ASSERT(sink.payload_ok, "Frames arrived as captured, in order");
+
+    config.path = "/nonexistent/capture";
+    TEST_ASSERT_ERROR(replay_client_run(&config, "127.0.0.1",
+                                        ntohs(addr.sin_port), NULL, NULL,
+                                        NULL, &result), E_FILE_NOT_FOUND,
+                      "Missing trace");
+    unlink(capture_path);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Wire Capture Unit Tests ===\n\n");
+
+    /* File tests */
+    run_test("test_roundtrip", test_roundtrip);
+    run_test("test_snaplen", test_snaplen);
+    run_test("test_ring_wrap", test_ring_wrap);
+    run_test("test_size_limit", test_size_limit);
+    run_test("test_bad_file", test_bad_file);
+    run_test("test_wire_paths_capture", test_wire_paths_capture);
+
+    /* Replay tests */
+    run_test("test_replay", test_replay);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,308 @@
+/**
+ * @file test_wire_compress.c
+ * @brief Unit tests for negotiated per-frame compression
+ *
+ * Feature negotiation picks one back-end, a run of repetitive frames
+ * round-trips and shrinks as the stream history builds up, small and
+ * control frames stay raw, incompressible frames back off, and corrupt
+ * or unexpected compressed frames are refused.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/wire_compress.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Frames per round-trip run */
+#define TEST_FRAMES 50
+
+/**
+ * @brief Build a frame around a pooled copy of @p data
+ */
+static void make_packet(xoe_packet_t* packet, const void* data, uint32_t len)
+{
+    memset(packet, 0, sizeof(*packet));
+    packet->protocol_id = XOE_PROTOCOL_SERIAL;
+    packet->protocol_version = 1;
+    packet->payload = xoe_payload_alloc(len);
+    memcpy(packet->payload->data, data, len);
+}
+
+/**
+ * @brief Send @p frames telemetry lines from @p tx to @p rx
+ *
+ * Frames the sender leaves raw are passed through the receiver as well.
+ *
+ * @return Total payload bytes on the wire, or -1 on a mismatch
+ */
+static long round_trip(xoe_wire_compress_t* tx, xoe_wire_compress_t* rx,
+                       int frames)
+{
+    xoe_packet_t packet;
+    xoe_packet_t wire;
+    char line[128];
+    long total = 0;
+    int len;
+    int rc;
+    int i;
+
+    for (i = 0; i < frames; i++) {
+        len = snprintf(line, sizeof(line),
+                       "$GPGGA,1234%02d.00,4807.038,N,01131.000,E,1,08,0.9,"
+                       "545.4,M,46.9,M,,*47\r\n", i % 60);
+        make_packet(&packet, line, (uint32_t)len);
+
+        rc = xoe_wire_compress_packet(tx, &packet, &wire);
+        if (rc < 0) {
+            xoe_wire_free_payload(&packet);
+            return -1;
+        }
+        if (rc == 0) {
+            /* Sent raw: the receiver sees a copy of the original frame */
+            make_packet(&wire, line, (uint32_t)len);
+        }
+        total += (long)wire.payload->len;
+        if (xoe_wire_decompress_packet(rx, &wire) != 0 ||
+            wire.protocol_version != 1 ||
+            wire.payload->len != (uint32_t)len ||
+            memcmp(wire.payload->data, line, (size_t)len) != 0) {
+            total = -1;
+        }
+        xoe_wire_free_payload(&wire);
+        xoe_wire_free_payload(&packet);
+        if (total < 0) {
+            return -1;
+        }
+    }
+    return total;
+}
+
+/* ============================================================================
+ * Negotiation Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test the server grants one back-end and only supported ones
+ */
+void test_negotiation(void) {
+    uint32_t accepted;
+    xoe_wire_compress_t comp;
+
+    accepted = xoe_wire_features_accept(XOE_WIRE_FEATURE_COMPRESS_ZLIB, FALSE);
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURE_COMPRESS_ZLIB, (int)accepted,
+                      "zlib granted on plain TCP");
+
+    accepted = xoe_wire_features_accept(XOE_WIRE_FEATURES_COMPRESS, FALSE);
+#if LZ4_ENABLED
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURE_COMPRESS_LZ4, (int)accepted,
+                      "LZ4 preferred when both are offered");
+#else
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURE_COMPRESS_ZLIB, (int)accepted,
+                      "LZ4 not granted without LZ4 support");
+    TEST_ASSERT_ERROR(xoe_wire_compress_init(&comp,
+                                             XOE_WIRE_FEATURE_COMPRESS_LZ4),
+                      E_NOT_SUPPORTED, "LZ4 state refused without support");
+#endif
+
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_init(&comp, 0), "Init without bits");
+    TEST_ASSERT_EQUAL(0, (int)comp.algorithm, "Inactive");
+    xoe_wire_compress_cleanup(&comp);
+}
+
+/* ============================================================================
+ * Round-Trip Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a back-end round-trips a stream and exploits its history
+ */
+static void check_stream(uint32_t feature, const char* name) {
+    xoe_wire_compress_t tx;
+    xoe_wire_compress_t rx;
+    long first;
+    long rest;
+    char message[96];
+
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_init(&tx, feature), "Init sender");
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_init(&rx, feature), "Init receiver");
+
+    first = round_trip(&tx, &rx, 1);
+    rest = round_trip(&tx, &rx, TEST_FRAMES - 1);
+    snprintf(message, sizeof(message), "%s frames round-trip", name);
+    TEST_ASSERT(first > 0 && rest > 0, message);
+    snprintf(message, sizeof(message),
+             "%s history shrinks later frames (%ld then %ld avg)",
+             name, first, rest / (TEST_FRAMES - 1));
+    TEST_ASSERT(rest / (TEST_FRAMES - 1) < first / 2, message);
+
+    xoe_wire_compress_cleanup(&tx);
+    xoe_wire_compress_cleanup(&rx);
+}
+
+void test_zlib_stream(void) {
+    check_stream(XOE_WIRE_FEATURE_COMPRESS_ZLIB, "zlib");
+}
+
+#if LZ4_ENABLED
+void test_lz4_stream(void) {
+    check_stream(XOE_WIRE_FEATURE_COMPRESS_LZ4, "LZ4");
+}
+#endif
+
+/* ============================================================================
+ * Adaptive Skipping Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test small, control and oversized frames are never compressed
+ */
+void test_skip_rules(void) {
+    xoe_wire_compress_t comp;
+    xoe_packet_t packet;
+    xoe_packet_t wire;
+    uint8_t* big;
+
+    xoe_wire_compress_init(&comp, XOE_WIRE_FEATURE_COMPRESS_ZLIB);
+
+    make_packet(&packet, "0123456789", 10);
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_packet(&comp, &packet, &wire),
+                      "Small frame raw");
+    xoe_wire_free_payload(&packet);
+
+    big = (uint8_t*)calloc(1, XOE_WIRE_COMPRESS_MAX_INPUT + 1);
+    make_packet(&packet, big, XOE_WIRE_COMPRESS_MAX_INPUT + 1);
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_packet(&comp, &packet, &wire),
+                      "Oversized frame raw");
+    packet.protocol_id = XOE_PROTOCOL_WIRE_CTRL;
+    packet.payload->len = 64;
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_packet(&comp, &packet, &wire),
+                      "Control frame raw");
+    xoe_wire_free_payload(&packet);
+    free(big);
+
+    TEST_ASSERT_EQUAL(0, xoe_wire_compress_packet(NULL, &packet, &wire),
+                      "No state: raw");
+
+    xoe_wire_compress_cleanup(&comp);
+}
+
+/**
+ * @brief Test incompressible frames back off and the stream stays in sync
+ */
+void test_backoff(void) {
+    xoe_wire_compress_t tx;
+    xoe_wire_compress_t rx;
+    xoe_packet_t packet;
+    xoe_packet_t wire;
+    uint8_t noise[512];
+    uint32_t state = 12345;
+    int compressed = 0;
+    int i;
+    int j;
+
+    xoe_wire_compress_init(&tx, XOE_WIRE_FEATURE_COMPRESS_ZLIB);
+    xoe_wire_compress_init(&rx, XOE_WIRE_FEATURE_COMPRESS_ZLIB);
+
+    for (i = 0; i < 40; i++) {
+        for (j = 0; j < (int)sizeof(noise); j++) {
+            state = state * 1103515245U + 12345U;
+            noise[j] = (uint8_t)(state >> 16);
+        }
+        make_packet(&packet, noise, sizeof(noise));
+        if (xoe_wire_compress_packet(&tx, &packet, &wire) == 1) {
+            compressed++;
+            xoe_wire_decompress_packet(&rx, &wire);
+            xoe_wire_free_payload(&wire);
+        }
+        xoe_wire_free_payload(&packet);
+    }
+    TEST_ASSERT(compressed > 0 && compressed <= 6,
+                "Random data attempted only a few times");
+
+    /* Compressible traffic afterwards still decodes on the same streams */
+    TEST_ASSERT(round_trip(&tx, &rx, 4) > 0, "Stream in sync after backoff");
+
+    xoe_wire_compress_cleanup(&tx);
+    xoe_wire_compress_cleanup(&rx);
+}
+
+/* ============================================================================
+ * Receive Validation Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test corrupt and unexpected compressed frames are refused
+ */
+void test_reject_frames(void) {
+    xoe_wire_compress_t tx;
+    xoe_wire_compress_t rx;
+    xoe_packet_t packet;
+    xoe_packet_t wire;
+    const char* text = "temperature=21.5 humidity=40 pressure=1013\r\n";
+
+    xoe_wire_compress_init(&tx, XOE_WIRE_FEATURE_COMPRESS_ZLIB);
+    xoe_wire_compress_init(&rx, XOE_WIRE_FEATURE_COMPRESS_ZLIB);
+
+    make_packet(&packet, text, (uint32_t)strlen(text));
+    TEST_ASSERT_EQUAL(0, xoe_wire_decompress_packet(&rx, &packet),
+                      "Raw frame passes through");
+    TEST_ASSERT_EQUAL(1, xoe_wire_compress_packet(&tx, &packet, &wire),
+                      "Compressed");
+
+    TEST_ASSERT_ERROR(xoe_wire_decompress_packet(NULL, &wire),
+                      E_PROTOCOL_ERROR, "Compressed frame without state");
+
+    xoe_wire_write_uint16((uint8_t*)wire.payload->data,
+                          (uint16_t)strlen(text) + 5);
+    TEST_ASSERT_ERROR(xoe_wire_decompress_packet(&rx, &wire),
+                      E_PROTOCOL_ERROR, "Wrong original length");
+
+    xoe_wire_write_uint16((uint8_t*)wire.payload->data,
+                          XOE_WIRE_COMPRESS_MAX_INPUT + 1);
+    TEST_ASSERT_ERROR(xoe_wire_decompress_packet(&rx, &wire),
+                      E_PROTOCOL_ERROR, "Oversized original length");
+
+    wire.payload->len = 1;
+    TEST_ASSERT_ERROR(xoe_wire_decompress_packet(&rx, &wire),
+                      E_PROTOCOL_ERROR, "Truncated frame");
+
+    xoe_wire_free_payload(&wire);
+    xoe_wire_free_payload(&packet);
+    xoe_wire_compress_cleanup(&tx);
+    xoe_wire_compress_cleanup(&rx);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Frame Compression Unit Tests ===\n\n");
+
+    /* Negotiation tests */
+    run_test("test_negotiation", test_negotiation);
+
+    /* Round-trip tests */
+    run_test("test_zlib_stream", test_zlib_stream);
+#if LZ4_ENABLED
+    run_test("test_lz4_stream", test_lz4_stream);
+#endif
+
+    /* Adaptive skipping tests */
+    run_test("test_skip_rules", test_skip_rules);
+    run_test("test_backoff", test_backoff);
+
+    /* Receive validation tests */
+    run_test("test_reject_frames", test_reject_frames);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+/**
+ * @file test_wire_dgram.c
+ * @brief Unit tests for wire frames over datagrams
+ *
+ * Tests the feature grant rules, encode/decode round trips with and
+ * without checksums, rejection of truncated, padded, corrupted and
+ * oversized datagrams, and send/recv over a datagram socket pair.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Build a packet around a payload of @p len bytes 0, 1, 2, ...
+ */
+static int make_packet(xoe_packet_t* packet, uint16_t protocol_id,
+                       uint32_t len) {
+    uint32_t i;
+
+    memset(packet, 0, sizeof(xoe_packet_t));
+    packet->protocol_id = protocol_id;
+    packet->protocol_version = 1;
+    if (len == 0) {
+        return 0;
+    }
+    packet->payload = xoe_payload_alloc(len);
+    if (packet->payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < len; i++) {
+        ((uint8_t*)packet->payload->data)[i] = (uint8_t)i;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Feature Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test which features a datagram server grants
+ */
+void test_features_accept(void) {
+    uint32_t all = XOE_WIRE_FEATURE_NO_CHECKSUM |
+                   XOE_WIRE_FEATURE_SERIAL_LATEST |
+                   XOE_WIRE_FEATURE_COMPRESS_ZLIB |
+                   XOE_WIRE_FEATURE_SERIAL_RESUME;
+
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURE_SERIAL_LATEST,
+                      xoe_wire_dgram_features_accept(all, FALSE),
+                      "Plain UDP keeps checksums, never streams features");
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURES_DGRAM,
+                      xoe_wire_dgram_features_accept(all, TRUE),
+                      "DTLS may drop the checksum");
+    TEST_ASSERT_EQUAL(0, xoe_wire_dgram_features_accept(0, TRUE),
+                      "Nothing requested, nothing granted");
+}
+
+/* ============================================================================
+ * Encode / Decode Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that a frame survives encode and decode
+ */
+void test_encode_decode_roundtrip(void) {
+    xoe_packet_t packet;
+    xoe_packet_t decoded;
+    uint8_t buffer[XOE_WIRE_DGRAM_MAX];
+    int len;
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 0x0042, 100), "Packet built");
+    len = xoe_wire_dgram_encode(&packet, 0, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE + 100, len, "Header plus payload");
+
+    TEST_ASSERT_SUCCESS(xoe_wire_dgram_decode(buffer, (uint32_t)len, 0,
+                                              &decoded), "Decoded");
+    TEST_ASSERT_EQUAL(0x0042, decoded.protocol_id, "Protocol ID kept");
+    TEST_ASSERT_NOT_NULL(decoded.payload, "Payload present");
+    if (decoded.payload != NULL) {
+        TEST_ASSERT_EQUAL(100, decoded.payload->len, "Payload length kept");
+        TEST_ASSERT(memcmp(decoded.payload->data, packet.payload->data,
+                           100) == 0, "Payload bytes kept");
+    }
+    xoe_wire_free_payload(&decoded);
+
+    /* Header-only frames are valid too */
+    xoe_wire_free_payload(&packet);
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 0x0007, 0), "Empty packet built");
+    len = xoe_wire_dgram_encode(&packet, 0, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE, len, "Header only");
+    TEST_ASSERT_SUCCESS(xoe_wire_dgram_decode(buffer, (uint32_t)len, 0,
+                                              &decoded), "Empty decoded");
+    TEST_ASSERT_NULL(decoded.payload, "No payload");
+}
+
+/**
+ * @brief Test that a datagram must hold exactly one frame
+ */
+void test_decode_length_mismatch(void) {
+    xoe_packet_t packet;
+    xoe_packet_t decoded;
+    uint8_t buffer[XOE_WIRE_DGRAM_MAX];
+    int len;
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 1, 32), "Packet built");
+    len = xoe_wire_dgram_encode(&packet, 0, buffer, sizeof(buffer));
+    xoe_wire_free_payload(&packet);
+
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      xoe_wire_dgram_decode(buffer, (uint32_t)len - 1, 0,
+                                            &decoded),
+                      "Truncated datagram refused");
+    buffer[len] = 0;
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      xoe_wire_dgram_decode(buffer, (uint32_t)len + 1, 0,
+                                            &decoded),
+                      "Trailing bytes refused");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      xoe_wire_dgram_decode(buffer, XOE_WIRE_HEADER_SIZE - 1, 0,
+                                            &decoded),
+                      "Shorter than a header refused");
+}
+
+/**
+ * @brief Test the checksum, and skipping it when negotiated away
+ */
+void test_decode_checksum(void) {
+    xoe_packet_t packet;
+    xoe_packet_t decoded;
+    uint8_t buffer[XOE_WIRE_DGRAM_MAX];
+    int len;
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 1, 16), "Packet built");
+    len = xoe_wire_dgram_encode(&packet, 0, buffer, sizeof(buffer));
+    buffer[len - 1] ^= 0xFF;
+    TEST_ASSERT_EQUAL(E_CHECKSUM_MISMATCH,
+                      xoe_wire_dgram_decode(buffer, (uint32_t)len, 0, &decoded),
+                      "Corrupted payload refused");
+
+    len = xoe_wire_dgram_encode(&packet, XOE_WIRE_FEATURE_NO_CHECKSUM, buffer,
+                                sizeof(buffer));
+    xoe_wire_free_payload(&packet);
+    TEST_ASSERT_SUCCESS(xoe_wire_dgram_decode(buffer, (uint32_t)len,
+                                              XOE_WIRE_FEATURE_NO_CHECKSUM,
+                                              &decoded),
+                        "Checksum 0 accepted once negotiated away");
+    TEST_ASSERT_EQUAL(0, decoded.checksum, "Sent without checksum");
+    xoe_wire_free_payload(&decoded);
+}
+
+/**
+ * @brief Test that frames too big for one datagram are refused
+ */
+void test_encode_oversized(void) {
+    xoe_packet_t packet;
+    uint8_t buffer[XOE_WIRE_DGRAM_MAX * 2];
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 1,
+                                    XOE_WIRE_DGRAM_MAX - XOE_WIRE_HEADER_SIZE),
+                        "Largest packet built");
+    TEST_ASSERT_EQUAL(XOE_WIRE_DGRAM_MAX,
+                      xoe_wire_dgram_encode(&packet, 0, buffer, sizeof(buffer)),
+                      "Largest frame fits");
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      xoe_wire_dgram_encode(&packet, 0, buffer, 64),
+                      "Small buffer refused");
+    xoe_wire_free_payload(&packet);
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 1,
+                                    XOE_WIRE_DGRAM_MAX - XOE_WIRE_HEADER_SIZE + 1),
+                        "Oversized packet built");
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      xoe_wire_dgram_encode(&packet, 0, buffer, sizeof(buffer)),
+                      "Frame over the datagram limit refused");
+    xoe_wire_free_payload(&packet);
+}
+
+/* ============================================================================
+ * Socket Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test send and receive over a datagram socket pair
+ */
+void test_send_recv_socketpair(void) {
+    xoe_packet_t packet;
+    xoe_packet_t decoded;
+    uint8_t buffer[XOE_WIRE_DGRAM_MAX];
+    int fds[2];
+    int len;
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), "Pair created");
+
+    TEST_ASSERT_EQUAL(E_WOULD_BLOCK,
+                      xoe_wire_dgram_recv(fds[1], NULL, buffer, sizeof(buffer)),
+                      "Nothing queued yet");
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 0x0099, 200), "Packet built");
+    TEST_ASSERT_SUCCESS(xoe_wire_dgram_send(fds[0], NULL, NULL, 0, 0, &packet),
+                        "Sent");
+    xoe_wire_free_payload(&packet);
+
+    len = xoe_wire_dgram_recv(fds[1], NULL, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE + 200, len, "One whole datagram");
+    if (len > 0) {
+        TEST_ASSERT_SUCCESS(xoe_wire_dgram_decode(buffer, (uint32_t)len, 0,
+                                                  &decoded), "Decoded");
+        TEST_ASSERT_EQUAL(0x0099, decoded.protocol_id, "Protocol ID kept");
+        xoe_wire_free_payload(&decoded);
+    }
+
+    /* A datagram larger than the buffer is dropped, not split */
+    memset(buffer, 0, sizeof(buffer));
+    TEST_ASSERT_EQUAL(100, (int)send(fds[0], buffer, 100, 0), "Raw send");
+    TEST_ASSERT_EQUAL(E_PROTOCOL_ERROR,
+                      xoe_wire_dgram_recv(fds[1], NULL, buffer, 50),
+                      "Oversized datagram refused");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Wire Datagram Unit Tests ===\n\n");
+
+    /* Feature tests */
+    run_test("test_features_accept", test_features_accept);
+
+    /* Encode / decode tests */
+    run_test("test_encode_decode_roundtrip", test_encode_decode_roundtrip);
+    run_test("test_decode_length_mismatch", test_decode_length_mismatch);
+    run_test("test_decode_checksum", test_decode_checksum);
+    run_test("test_encode_oversized", test_encode_oversized);
+
+    /* Socket tests */
+    run_test("test_send_recv_socketpair", test_send_recv_socketpair);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
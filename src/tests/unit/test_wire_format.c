@@ -0,0 +1,655 @@
+/**
+ * @file test_wire_format.c
+ * @brief Unit tests for the wire format frame decoder
+ *
+ * Tests the incremental decoder for correct reassembly across arbitrary
+ * byte boundaries, framing error detection, and non-blocking socket reads.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+/* ============================================================================
+ * Helpers
+ * ============================================================================ */
+
+/**
+ * @brief Build a complete wire frame into @p out
+ *
+ * @return Total frame length (header plus payload)
+ */
+static uint32_t build_frame(uint8_t* out, uint16_t protocol_id,
+                            const uint8_t* payload, uint32_t len)
+{
+    xoe_wire_header_t header;
+
+    header.protocol_id = protocol_id;
+    header.protocol_version = 1;
+    header.payload_length = len;
+    header.checksum = xoe_wire_packet_checksum(&header, payload);
+
+    xoe_wire_serialize_header(out, &header);
+    if (len > 0) {
+        memcpy(out + XOE_WIRE_HEADER_SIZE, payload, len);
+    }
+
+    return XOE_WIRE_HEADER_SIZE + len;
+}
+
+/* ============================================================================
+ * xoe_wire_decoder_feed() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test reassembly when input arrives one byte at a time
+ */
+void test_feed_byte_at_a_time(void) {
+    xoe_wire_decoder_t decoder;
+    xoe_packet_t packet;
+    uint8_t payload[100];
+    uint8_t frame[XOE_WIRE_HEADER_SIZE + sizeof(payload)];
+    uint32_t frame_len;
+    uint32_t consumed;
+    uint32_t i;
+    int result = 0;
+    int completions = 0;
+
+    for (i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+    frame_len = build_frame(frame, 0x0042, payload, sizeof(payload));
+
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Init should succeed");
+    TEST_ASSERT(xoe_wire_decoder_idle(&decoder), "Fresh decoder should be idle");
+
+    for (i = 0; i < frame_len; i++) {
+        result = xoe_wire_decoder_feed(&decoder, frame + i, 1, &consumed, &packet);
+        if (result != 0) {
+            break;
+        }
+        TEST_ASSERT_EQUAL(1, consumed, "Each byte should be consumed");
+        TEST_ASSERT(!xoe_wire_decoder_idle(&decoder),
+                    "Decoder holding a partial frame should not be idle");
+    }
+    TEST_ASSERT(xoe_wire_decoder_idle(&decoder),
+                "Decoder should be idle once the frame is out");
+
+    if (result == 1) {
+        completions++;
+        TEST_ASSERT_EQUAL(frame_len - 1, i, "Frame should complete on last byte");
+        TEST_ASSERT_EQUAL(0x0042, packet.protocol_id, "Protocol ID should match");
+        TEST_ASSERT_NOT_NULL(packet.payload, "Payload should be present");
+        if (packet.payload != NULL) {
+            TEST_ASSERT_EQUAL(sizeof(payload), packet.payload->len,
+                              "Payload length should match");
+            TEST_ASSERT(memcmp(payload, packet.payload->data, sizeof(payload)) == 0,
+                        "Payload bytes should match");
+        }
+        xoe_wire_free_payload(&packet);
+    }
+    TEST_ASSERT_EQUAL(1, completions, "Exactly one packet should complete");
+
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/**
+ * @brief Test that several frames in one buffer are returned one by one
+ */
+void test_feed_multiple_frames(void) {
+    xoe_wire_decoder_t decoder;
+    xoe_packet_t packet;
+    uint8_t stream[256];
+    uint8_t payload[] = {'a', 'b', 'c'};
+    uint32_t stream_len = 0;
+    uint32_t offset = 0;
+    uint32_t consumed;
+    int completions = 0;
+    int result;
+
+    stream_len += build_frame(stream + stream_len, 1, payload, sizeof(payload));
+    stream_len += build_frame(stream + stream_len, 2, NULL, 0);
+    stream_len += build_frame(stream + stream_len, 3, payload, sizeof(payload));
+
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Init should succeed");
+
+    while (offset < stream_len) {
+        result = xoe_wire_decoder_feed(&decoder, stream + offset,
+                                       stream_len - offset, &consumed, &packet);
+        offset += consumed;
+        if (result != 1) {
+            break;
+        }
+        completions++;
+        TEST_ASSERT_EQUAL(completions, packet.protocol_id,
+                          "Frames should complete in order");
+        if (packet.protocol_id == 2) {
+            TEST_ASSERT_NULL(packet.payload, "Empty frame should have no payload");
+        }
+        xoe_wire_free_payload(&packet);
+    }
+
+    TEST_ASSERT_EQUAL(3, completions, "All three frames should complete");
+    TEST_ASSERT_EQUAL(stream_len, offset, "Whole stream should be consumed");
+
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/**
+ * @brief Test that a corrupted payload is rejected
+ */
+void test_feed_bad_checksum(void) {
+    xoe_wire_decoder_t decoder;
+    xoe_packet_t packet;
+    uint8_t payload[] = {1, 2, 3, 4};
+    uint8_t frame[64];
+    uint32_t frame_len;
+    uint32_t consumed;
+    int result;
+
+    frame_len = build_frame(frame, 1, payload, sizeof(payload));
+    frame[frame_len - 1] ^= 0xFF;
+
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Init should succeed");
+
+    result = xoe_wire_decoder_feed(&decoder, frame, frame_len, &consumed, &packet);
+    TEST_ASSERT_ERROR(result, E_CHECKSUM_MISMATCH, "Corrupt frame should be rejected");
+
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/**
+ * @brief Test that an oversized length is rejected before allocation
+ */
+void test_feed_oversized_length(void) {
+    xoe_wire_decoder_t decoder;
+    xoe_wire_header_t header;
+    xoe_packet_t packet;
+    uint8_t buffer[XOE_WIRE_HEADER_SIZE];
+    uint32_t consumed;
+    int result;
+
+    header.protocol_id = 1;
+    header.protocol_version = 1;
+    header.payload_length = XOE_WIRE_MAX_PAYLOAD + 1;
+    header.checksum = 0;
+    xoe_wire_serialize_header(buffer, &header);
+
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Init should succeed");
+
+    result = xoe_wire_decoder_feed(&decoder, buffer, sizeof(buffer), &consumed, &packet);
+    TEST_ASSERT_ERROR(result, E_PROTOCOL_ERROR, "Oversized frame should be rejected");
+
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/**
+ * @brief Test NULL argument handling
+ */
+void test_feed_null_args(void) {
+    xoe_packet_t packet;
+    uint32_t consumed;
+    uint8_t byte = 0;
+
+    TEST_ASSERT_ERROR(xoe_wire_decoder_init(NULL, 0), E_INVALID_ARGUMENT,
+                      "NULL decoder should fail init");
+    TEST_ASSERT_ERROR(xoe_wire_decoder_feed(NULL, &byte, 1, &consumed, &packet),
+                      E_INVALID_ARGUMENT, "NULL decoder should fail feed");
+    TEST_ASSERT_ERROR(xoe_wire_decoder_next(NULL, &packet), E_INVALID_ARGUMENT,
+                      "NULL decoder should fail next");
+    xoe_wire_decoder_cleanup(NULL);
+}
+
+/* ============================================================================
+ * xoe_wire_decoder_recv() / xoe_wire_decoder_next() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test non-blocking reads through a socket pair
+ *
+ * Uses a small staging buffer so a large payload is read directly into
+ * the packet buffer, and checks E_WOULD_BLOCK/EOF reporting.
+ */
+void test_recv_socketpair(void) {
+    xoe_wire_decoder_t decoder;
+    xoe_packet_t packet;
+    static uint8_t frame[XOE_WIRE_HEADER_SIZE + 8192];
+    static uint8_t payload[8192];
+    int fds[2];
+    uint32_t frame_len;
+    uint32_t i;
+    int completions = 0;
+    int result;
+
+    for (i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 7);
+    }
+    frame_len = build_frame(frame, 9, payload, sizeof(payload));
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        TEST_SKIP("socketpair unavailable");
+        return;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 64), "Init should succeed");
+
+    result = xoe_wire_decoder_recv(&decoder, fds[0]);
+    TEST_ASSERT_ERROR(result, E_WOULD_BLOCK, "Empty socket should not block");
+
+    TEST_ASSERT_EQUAL((ssize_t)frame_len, write(fds[1], frame, frame_len),
+                      "Frame should be written");
+
+    for (i = 0; i < 1000 && completions == 0; i++) {
+        result = xoe_wire_decoder_recv(&decoder, fds[0]);
+        if (result <= 0) {
+            break;
+        }
+        while (xoe_wire_decoder_next(&decoder, &packet) == 1) {
+            completions++;
+            TEST_ASSERT_NOT_NULL(packet.payload, "Payload should be present");
+            if (packet.payload != NULL) {
+                TEST_ASSERT(memcmp(payload, packet.payload->data,
+                                   sizeof(payload)) == 0,
+                            "Payload bytes should match");
+            }
+            xoe_wire_free_payload(&packet);
+        }
+    }
+    TEST_ASSERT_EQUAL(1, completions, "Frame should be decoded from socket");
+
+    close(fds[1]);
+    TEST_ASSERT_EQUAL(0, xoe_wire_decoder_recv(&decoder, fds[0]),
+                      "Closed peer should report EOF");
+
+    close(fds[0]);
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/* ============================================================================
+ * xoe_wire_send() / xoe_wire_forward() / xoe_wire_sendv() Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that a sent packet decodes back to the same content
+ */
+void test_send_roundtrip(void) {
+    xoe_packet_t out;
+    xoe_packet_t in;
+    xoe_payload_t payload;
+    uint8_t data[256];
+    int fds[2];
+    uint32_t i;
+
+    for (i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(255 - i);
+    }
+    payload.data = data;
+    payload.len = sizeof(data);
+    payload.owns_data = FALSE;
+
+    memset(&out, 0, sizeof(out));
+    out.protocol_id = 0x0003;
+    out.protocol_version = 1;
+    out.payload = &payload;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        TEST_SKIP("socketpair unavailable");
+        return;
+    }
+
+    TEST_ASSERT_SUCCESS(xoe_wire_send(fds[1], &out), "Send should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(fds[0], &in), "Recv should succeed");
+    TEST_ASSERT_EQUAL(0x0003, in.protocol_id, "Protocol ID should match");
+    TEST_ASSERT_NOT_NULL(in.payload, "Payload should be present");
+    if (in.payload != NULL) {
+        TEST_ASSERT_EQUAL(sizeof(data), in.payload->len, "Length should match");
+        TEST_ASSERT(memcmp(data, in.payload->data, sizeof(data)) == 0,
+                    "Payload bytes should match");
+    }
+    xoe_wire_free_payload(&in);
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test that a relayed packet keeps its bytes and checksum
+ */
+void test_forward_relay(void) {
+    xoe_packet_t out;
+    xoe_packet_t relayed;
+    xoe_packet_t in;
+    xoe_payload_t payload;
+    uint8_t data[64];
+    int a[2];
+    int b[2];
+
+    memset(data, 0xA5, sizeof(data));
+    payload.data = data;
+    payload.len = sizeof(data);
+    payload.owns_data = FALSE;
+
+    memset(&out, 0, sizeof(out));
+    out.protocol_id = 0x0003;
+    out.protocol_version = 1;
+    out.payload = &payload;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, a) != 0) {
+        TEST_SKIP("socketpair unavailable");
+        return;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, b) != 0) {
+        close(a[0]);
+        close(a[1]);
+        TEST_SKIP("socketpair unavailable");
+        return;
+    }
+
+    TEST_ASSERT_SUCCESS(xoe_wire_send(a[1], &out), "Send should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(a[0], &relayed), "Recv should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_forward(b[1], &relayed), "Forward should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(b[0], &in), "Relayed frame should verify");
+    TEST_ASSERT_EQUAL(relayed.checksum, in.checksum, "Checksum should be reused");
+    if (in.payload != NULL) {
+        TEST_ASSERT(memcmp(data, in.payload->data, sizeof(data)) == 0,
+                    "Payload bytes should match");
+    }
+    xoe_wire_free_payload(&in);
+
+    /* Frames received with checksums off get one computed for the relay */
+    relayed.checksum = 0;
+    TEST_ASSERT_SUCCESS(xoe_wire_forward(b[1], &relayed), "Forward should succeed");
+    TEST_ASSERT_SUCCESS(xoe_wire_recv(b[0], &in),
+                        "Zero checksum should be recomputed");
+    xoe_wire_free_payload(&in);
+    xoe_wire_free_payload(&relayed);
+
+    TEST_ASSERT_ERROR(xoe_wire_forward(b[1], NULL), E_INVALID_ARGUMENT,
+                      "NULL packet should be rejected");
+
+    close(a[0]);
+    close(a[1]);
+    close(b[0]);
+    close(b[1]);
+}
+
+/**
+ * @brief Test that segments sent together arrive contiguously
+ */
+void test_sendv_segments(void) {
+    struct iovec iov[3];
+    char received[16];
+    ssize_t got;
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        TEST_SKIP("socketpair unavailable");
+        return;
+    }
+
+    iov[0].iov_base = "abc";
+    iov[0].iov_len = 3;
+    iov[1].iov_base = NULL;
+    iov[1].iov_len = 0;
+    iov[2].iov_base = "defg";
+    iov[2].iov_len = 4;
+
+    TEST_ASSERT_SUCCESS(xoe_wire_sendv(fds[1], iov, 3), "Sendv should succeed");
+
+    memset(received, 0, sizeof(received));
+    got = recv(fds[0], received, sizeof(received) - 1, 0);
+    TEST_ASSERT_EQUAL(7, got, "All segment bytes should arrive");
+    TEST_ASSERT_STR_EQUAL("abcdefg", received, "Segments should be in order");
+
+    close(fds[0]);
+    close(fds[1]);
+}
+
+/**
+ * @brief Test sendv argument validation
+ */
+void test_sendv_invalid_args(void) {
+    struct iovec iov[XOE_WIRE_SENDV_MAX_IOV + 1];
+
+    memset(iov, 0, sizeof(iov));
+
+    TEST_ASSERT_ERROR(xoe_wire_sendv(-1, NULL, 1), E_INVALID_ARGUMENT,
+                      "NULL iov should be rejected");
+    TEST_ASSERT_ERROR(xoe_wire_sendv(-1, iov, 0), E_INVALID_ARGUMENT,
+                      "Zero segments should be rejected");
+    TEST_ASSERT_ERROR(xoe_wire_sendv(-1, iov, XOE_WIRE_SENDV_MAX_IOV + 1),
+                      E_INVALID_ARGUMENT, "Too many segments should be rejected");
+    TEST_ASSERT_ERROR(xoe_wire_sendv_tls(NULL, iov, 1), E_INVALID_ARGUMENT,
+                      "NULL SSL should be rejected");
+}
+
+/* ============================================================================
+ * Feature Negotiation Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that checksum-off is only granted on authenticated transports
+ */
+void test_features_accept(void) {
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURE_NO_CHECKSUM,
+                      xoe_wire_features_accept(XOE_WIRE_FEATURE_NO_CHECKSUM, TRUE),
+                      "TLS should grant checksum-off");
+    TEST_ASSERT_EQUAL(0,
+                      xoe_wire_features_accept(XOE_WIRE_FEATURE_NO_CHECKSUM, FALSE),
+                      "Plain TCP should keep checksums");
+    TEST_ASSERT_EQUAL(0, xoe_wire_features_accept(0x80000000U, TRUE),
+                      "Unknown features should not be granted");
+}
+
+/**
+ * @brief Test HELLO encode/parse round trip
+ */
+void test_hello_roundtrip(void) {
+    xoe_packet_t packet;
+    xoe_payload_t payload;
+    uint8_t buffer[XOE_WIRE_HELLO_SIZE];
+    uint16_t type = 0;
+    uint32_t features = 0;
+
+    xoe_wire_hello_init(&packet, &payload, buffer, XOE_WIRE_CTRL_HELLO_ACK,
+                        XOE_WIRE_FEATURE_NO_CHECKSUM);
+
+    TEST_ASSERT_EQUAL(XOE_PROTOCOL_WIRE_CTRL, packet.protocol_id,
+                      "HELLO should use the wire control protocol");
+    TEST_ASSERT_SUCCESS(xoe_wire_hello_parse(&packet, &type, &features),
+                        "HELLO should parse");
+    TEST_ASSERT_EQUAL(XOE_WIRE_CTRL_HELLO_ACK, type, "Type should round trip");
+    TEST_ASSERT_EQUAL(XOE_WIRE_FEATURE_NO_CHECKSUM, features,
+                      "Features should round trip");
+
+    packet.protocol_id = XOE_PROTOCOL_RAW;
+    TEST_ASSERT_ERROR(xoe_wire_hello_parse(&packet, &type, &features),
+                      E_PROTOCOL_ERROR, "Non-control packet should be rejected");
+}
+
+/**
+ * @brief Test RAW_JOIN encode/parse and channel name validation
+ */
+void test_raw_join_roundtrip(void) {
+    xoe_packet_t packet;
+    xoe_payload_t payload;
+    uint8_t buffer[XOE_WIRE_RAW_JOIN_HEADER + XOE_WIRE_RAW_NAME_MAX];
+    char name[XOE_WIRE_RAW_NAME_MAX + 1];
+    char longest[XOE_WIRE_RAW_NAME_MAX + 2];
+    uint16_t type = 0;
+    uint32_t features = 0;
+
+    TEST_ASSERT_SUCCESS(xoe_wire_raw_join_init(&packet, &payload, buffer,
+                                               "cam-1"),
+                        "RAW_JOIN should build");
+    TEST_ASSERT_EQUAL(XOE_PROTOCOL_WIRE_CTRL, packet.protocol_id,
+                      "RAW_JOIN should use the wire control protocol");
+    TEST_ASSERT_EQUAL(XOE_WIRE_RAW_JOIN_HEADER + 5, (int)payload.len,
+                      "Name should follow the header unterminated");
+    TEST_ASSERT_SUCCESS(xoe_wire_raw_join_parse(&packet, name),
+                        "RAW_JOIN should parse");
+    TEST_ASSERT(strcmp(name, "cam-1") == 0, "Name should round trip");
+    TEST_ASSERT_ERROR(xoe_wire_hello_parse(&packet, &type, &features),
+                      E_PROTOCOL_ERROR, "RAW_JOIN is not a HELLO");
+
+    memset(longest, 'n', XOE_WIRE_RAW_NAME_MAX);
+    longest[XOE_WIRE_RAW_NAME_MAX] = '\0';
+    TEST_ASSERT_SUCCESS(xoe_wire_raw_join_init(&packet, &payload, buffer,
+                                               longest),
+                        "Longest name should build");
+    TEST_ASSERT_SUCCESS(xoe_wire_raw_join_parse(&packet, name),
+                        "Longest name should parse");
+    TEST_ASSERT_EQUAL(XOE_WIRE_RAW_NAME_MAX, (int)strlen(name),
+                      "Longest name should be kept whole");
+
+    longest[XOE_WIRE_RAW_NAME_MAX] = 'n';
+    longest[XOE_WIRE_RAW_NAME_MAX + 1] = '\0';
+    TEST_ASSERT_ERROR(xoe_wire_raw_join_init(&packet, &payload, buffer,
+                                             longest),
+                      E_INVALID_ARGUMENT, "Overlong name should be rejected");
+    TEST_ASSERT_ERROR(xoe_wire_raw_join_init(&packet, &payload, buffer, ""),
+                      E_INVALID_ARGUMENT, "Empty name should be rejected");
+    TEST_ASSERT_ERROR(xoe_wire_raw_join_init(&packet, &payload, buffer,
+                                             "two words"),
+                      E_INVALID_ARGUMENT, "Spaces should be rejected");
+
+    /* A HELLO is not a RAW_JOIN, and a bad byte on the wire is refused */
+    xoe_wire_hello_init(&packet, &payload, buffer, XOE_WIRE_CTRL_HELLO, 0);
+    TEST_ASSERT_ERROR(xoe_wire_raw_join_parse(&packet, name),
+                      E_PROTOCOL_ERROR, "HELLO is not a RAW_JOIN");
+    TEST_ASSERT_SUCCESS(xoe_wire_raw_join_init(&packet, &payload, buffer,
+                                               "ab"),
+                        "RAW_JOIN should build");
+    buffer[XOE_WIRE_RAW_JOIN_HEADER + 1] = '\n';
+    TEST_ASSERT_ERROR(xoe_wire_raw_join_parse(&packet, name),
+                      E_PROTOCOL_ERROR, "Control characters should be refused");
+}
+
+/**
+ * @brief Test the client side of a raw join against a scripted server
+ */
+void test_raw_join_client(void) {
+    int sv[2];
+    uint8_t frame[64];
+    uint8_t ready[XOE_WIRE_HELLO_SIZE];
+    uint8_t received[XOE_WIRE_HEADER_SIZE + XOE_WIRE_RAW_JOIN_HEADER + 3];
+    uint8_t tail[4];
+    uint32_t frame_len;
+    pid_t pid;
+    int status;
+
+    TEST_ASSERT_SUCCESS(socketpair(AF_UNIX, SOCK_STREAM, 0, sv),
+                        "socketpair should succeed");
+
+    /* READY immediately followed by raw bytes the join must not consume */
+    xoe_wire_write_uint16(ready, XOE_WIRE_CTRL_RAW_READY);
+    xoe_wire_write_uint16(ready + 2, 0);
+    xoe_wire_write_uint32(ready + 4, 0);
+    frame_len = build_frame(frame, XOE_PROTOCOL_WIRE_CTRL, ready,
+                            sizeof(ready));
+    memcpy(frame + frame_len, "RAW!", 4);
+
+    pid = fork();
+    if (pid == 0) {
+        close(sv[0]);
+        if (recv(sv[1], received, sizeof(received), MSG_WAITALL) !=
+                (ssize_t)sizeof(received) ||
+            memcmp(received + XOE_WIRE_HEADER_SIZE +
+                   XOE_WIRE_RAW_JOIN_HEADER, "abc", 3) != 0) {
+            _exit(1);
+        }
+        if (write(sv[1], frame, frame_len + 4) != (ssize_t)(frame_len + 4)) {
+            _exit(1);
+        }
+        _exit(0);
+    }
+    close(sv[1]);
+
+    TEST_ASSERT_SUCCESS(xoe_wire_raw_join(sv[0], "abc"),
+                        "Join should complete on RAW_READY");
+    TEST_ASSERT_EQUAL(4, (int)recv(sv[0], tail, sizeof(tail), MSG_WAITALL),
+                      "Raw bytes after READY should be left to read");
+    TEST_ASSERT(memcmp(tail, "RAW!", 4) == 0, "Raw bytes should be intact");
+    TEST_ASSERT(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+                WEXITSTATUS(status) == 0, "Server should have seen the name");
+
+    close(sv[0]);
+}
+
+/**
+ * @brief Test that a negotiated decoder accepts frames without checksum
+ */
+void test_decoder_no_checksum(void) {
+    xoe_wire_decoder_t decoder;
+    xoe_packet_t packet;
+    uint8_t payload[] = {9, 8, 7};
+    uint8_t frame[64];
+    uint32_t frame_len;
+    uint32_t consumed;
+    int result;
+
+    frame_len = build_frame(frame, 1, payload, sizeof(payload));
+    memset(frame + 8, 0, 4);  /* Checksum field as sent with NO_CHECKSUM */
+
+    TEST_ASSERT_SUCCESS(xoe_wire_decoder_init(&decoder, 0), "Init should succeed");
+
+    result = xoe_wire_decoder_feed(&decoder, frame, frame_len, &consumed, &packet);
+    TEST_ASSERT_ERROR(result, E_CHECKSUM_MISMATCH,
+                      "Checksums should be enforced by default");
+
+    xoe_wire_decoder_set_features(&decoder, XOE_WIRE_FEATURE_NO_CHECKSUM);
+    result = xoe_wire_decoder_feed(&decoder, frame, frame_len, &consumed, &packet);
+    TEST_ASSERT_EQUAL(1, result, "Negotiated decoder should skip the CRC");
+    if (result == 1) {
+        xoe_wire_free_payload(&packet);
+    }
+
+    xoe_wire_decoder_cleanup(&decoder);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Wire Format Unit Tests ===\n\n");
+
+    /* xoe_wire_decoder_feed() tests */
+    run_test("test_feed_byte_at_a_time", test_feed_byte_at_a_time);
+    run_test("test_feed_multiple_frames", test_feed_multiple_frames);
+    run_test("test_feed_bad_checksum", test_feed_bad_checksum);
+    run_test("test_feed_oversized_length", test_feed_oversized_length);
+    run_test("test_feed_null_args", test_feed_null_args);
+
+    /* xoe_wire_decoder_recv() / xoe_wire_decoder_next() tests */
+    run_test("test_recv_socketpair", test_recv_socketpair);
+
+    /* xoe_wire_send() / xoe_wire_forward() / xoe_wire_sendv() tests */
+    run_test("test_send_roundtrip", test_send_roundtrip);
+    run_test("test_forward_relay", test_forward_relay);
+    run_test("test_sendv_segments", test_sendv_segments);
+    run_test("test_sendv_invalid_args", test_sendv_invalid_args);
+
+    /* Feature negotiation tests */
+    run_test("test_features_accept", test_features_accept);
+    run_test("test_hello_roundtrip", test_hello_roundtrip);
+    run_test("test_decoder_no_checksum", test_decoder_no_checksum);
+
+    /* Raw passthrough tests */
+    run_test("test_raw_join_roundtrip", test_raw_join_roundtrip);
+    run_test("test_raw_join_client", test_raw_join_client);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
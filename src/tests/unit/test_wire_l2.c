@@ -0,0 +1,241 @@
+/**
+ * @file test_wire_l2.c
+ * @brief Unit tests for wire frames in Ethernet frames
+ *
+ * Tests the layer-2 header round trip, acceptance of Ethernet padding,
+ * rejection of frames shorter than they claim, MAC address parsing, and
+ * a send/receive through two AF_PACKET rings on the loopback device
+ * (skipped without CAP_NET_RAW).
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/net/l2_ring.h"
+#include "lib/protocol/wire_l2.h"
+#include "lib/protocol/wire_dgram.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+/**
+ * @brief Build a packet around a payload of @p len bytes 0, 1, 2, ...
+ */
+static int make_packet(xoe_packet_t* packet, uint16_t protocol_id,
+                       uint32_t len) {
+    uint32_t i;
+
+    memset(packet, 0, sizeof(xoe_packet_t));
+    packet->protocol_id = protocol_id;
+    packet->protocol_version = 1;
+    packet->payload = xoe_payload_alloc(len);
+    if (packet->payload == NULL) {
+        return E_OUT_OF_MEMORY;
+    }
+    for (i = 0; i < len; i++) {
+        ((uint8_t*)packet->payload->data)[i] = (uint8_t)i;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Header Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test that header fields and the wire frame survive a round trip
+ */
+void test_encode_parse_roundtrip(void) {
+    xoe_packet_t packet;
+    xoe_packet_t decoded;
+    uint8_t buffer[256];
+    const uint8_t* frame;
+    uint32_t frame_len;
+    uint32_t association;
+    uint16_t flags;
+    int len;
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 0x0042, 20), "Packet built");
+    len = xoe_wire_l2_encode(buffer, sizeof(buffer), 0xA1B2C3D4,
+                             XOE_WIRE_L2_FROM_SERVER, 0, &packet);
+    TEST_ASSERT_EQUAL(XOE_WIRE_L2_HEADER_SIZE + XOE_WIRE_HEADER_SIZE + 20, len,
+                      "Layer-2 header, wire header and payload");
+
+    TEST_ASSERT_SUCCESS(xoe_wire_l2_parse(buffer, (uint32_t)len, &association,
+                                          &flags, &frame, &frame_len),
+                        "Parsed");
+    TEST_ASSERT_EQUAL(0xA1B2C3D4, association, "Association kept");
+    TEST_ASSERT_EQUAL(XOE_WIRE_L2_FROM_SERVER, flags, "Flags kept");
+    TEST_ASSERT(frame == buffer + XOE_WIRE_L2_HEADER_SIZE,
+                "Wire frame follows the header");
+    TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE + 20, frame_len, "Frame length");
+
+    TEST_ASSERT_SUCCESS(xoe_wire_dgram_decode(frame, frame_len, 0, &decoded),
+                        "Wire frame decodes");
+    TEST_ASSERT_EQUAL(0x0042, decoded.protocol_id, "Protocol ID kept");
+    xoe_wire_free_payload(&decoded);
+    xoe_wire_free_payload(&packet);
+}
+
+/**
+ * @brief Test that padding is ignored and short payloads are refused
+ */
+void test_parse_padding_and_truncation(void) {
+    xoe_packet_t packet;
+    uint8_t buffer[256];
+    const uint8_t* frame;
+    uint32_t frame_len;
+    uint32_t association;
+    uint16_t flags;
+    int len;
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 0x0042, 4), "Packet built");
+    len = xoe_wire_l2_encode(buffer, sizeof(buffer), 7, 0, 0, &packet);
+    TEST_ASSERT(len > 0, "Encoded");
+
+    /* Ethernet pads anything under 46 bytes of payload */
+    memset(buffer + len, 0, 46 - (size_t)len);
+    TEST_ASSERT_SUCCESS(xoe_wire_l2_parse(buffer, 46, &association, &flags,
+                                          &frame, &frame_len),
+                        "Padded payload parsed");
+    TEST_ASSERT_EQUAL((uint32_t)len - XOE_WIRE_L2_HEADER_SIZE, frame_len,
+                      "Padding not part of the frame");
+
+    TEST_ASSERT_ERROR(xoe_wire_l2_parse(buffer, (uint32_t)len - 1,
+                                        &association, &flags, &frame,
+                                        &frame_len),
+                      E_PROTOCOL_ERROR, "Truncated payload refused");
+    TEST_ASSERT_ERROR(xoe_wire_l2_parse(buffer, XOE_WIRE_L2_HEADER_SIZE - 1,
+                                        &association, &flags, &frame,
+                                        &frame_len),
+                      E_PROTOCOL_ERROR, "Partial header refused");
+
+    TEST_ASSERT_EQUAL(E_BUFFER_TOO_SMALL,
+                      xoe_wire_l2_encode(buffer, XOE_WIRE_L2_HEADER_SIZE + 4,
+                                         7, 0, 0, &packet),
+                      "Encode checks the buffer size");
+    xoe_wire_free_payload(&packet);
+}
+
+/**
+ * @brief Test MAC address parsing and formatting
+ */
+void test_mac_parse_format(void) {
+    uint8_t mac[L2_RING_MAC_LEN];
+    char text[L2_RING_MAC_STRLEN];
+
+    TEST_ASSERT_SUCCESS(l2_ring_parse_mac("02:0A:bc:00:ff:9e", mac),
+                        "Colon form parsed");
+    TEST_ASSERT(mac[0] == 0x02 && mac[1] == 0x0a && mac[2] == 0xbc &&
+                mac[3] == 0x00 && mac[4] == 0xff && mac[5] == 0x9e,
+                "Bytes parsed");
+    TEST_ASSERT(strcmp(l2_ring_format_mac(mac, text),
+                       "02:0a:bc:00:ff:9e") == 0, "Formatted lower case");
+
+    TEST_ASSERT_SUCCESS(l2_ring_parse_mac("02-0a-bc-00-ff-9e", mac),
+                        "Dash form parsed");
+    TEST_ASSERT_ERROR(l2_ring_parse_mac("02:0a:bc:00:ff", mac),
+                      E_INVALID_ARGUMENT, "Five bytes refused");
+    TEST_ASSERT_ERROR(l2_ring_parse_mac("02:0a:bc:00:ff:9e:01", mac),
+                      E_INVALID_ARGUMENT, "Seven bytes refused");
+    TEST_ASSERT_ERROR(l2_ring_parse_mac("02:0a:bc:00:ff:9g", mac),
+                      E_INVALID_ARGUMENT, "Non-hex refused");
+}
+
+/* ============================================================================
+ * Ring Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test a frame sent on one ring and received on another over lo
+ *
+ * The loopback device hands every frame to every packet socket bound to
+ * it, the sender included: the sender sees its own frame, as wire_l2.h
+ * describes.
+ */
+void test_ring_loopback(void) {
+    static const uint8_t broadcast[L2_RING_MAC_LEN] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+    l2_ring_t* sender = NULL;
+    l2_ring_t* receiver = NULL;
+    l2_ring_frame_t frame;
+    xoe_packet_t packet;
+    const uint8_t* wire;
+    uint32_t wire_len;
+    uint32_t association = 0;
+    uint16_t flags = 0;
+    struct pollfd pfd;
+    int found = FALSE;
+    int result;
+    int tries;
+
+    result = l2_ring_open("lo", XOE_WIRE_L2_ETHERTYPE, &sender);
+    if (result == E_PERMISSION_DENIED || result == E_NOT_SUPPORTED ||
+        result == E_NOT_FOUND) {
+        TEST_SKIP("AF_PACKET rings on lo unavailable");
+        return;
+    }
+    TEST_ASSERT_SUCCESS(result, "Sender opened");
+    TEST_ASSERT_SUCCESS(l2_ring_open("lo", XOE_WIRE_L2_ETHERTYPE, &receiver),
+                        "Receiver opened");
+    TEST_ASSERT(l2_ring_mtu(receiver) > XOE_WIRE_L2_HEADER_SIZE,
+                "MTU reported");
+
+    TEST_ASSERT_SUCCESS(make_packet(&packet, 0x0042, 300), "Packet built");
+    TEST_ASSERT_SUCCESS(xoe_wire_l2_send(sender, broadcast, 0x12345678, 0, 0,
+                                         &packet), "Queued");
+    TEST_ASSERT_SUCCESS(l2_ring_flush(sender), "Flushed");
+
+    /* The receive block retires within L2_RING_RX_TIMEOUT_MS */
+    for (tries = 0; tries < 50 && !found; tries++) {
+        pfd.fd = l2_ring_fd(receiver);
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        (void)poll(&pfd, 1, 20);
+        while (!found && l2_ring_recv(receiver, &frame)) {
+            found = xoe_wire_l2_parse(frame.data, frame.len, &association,
+                                      &flags, &wire, &wire_len) == 0 &&
+                    association == 0x12345678;
+        }
+    }
+    TEST_ASSERT(found, "Frame received");
+    if (found) {
+        TEST_ASSERT_EQUAL(0, flags, "Flags kept");
+        TEST_ASSERT(memcmp(frame.src, l2_ring_mac(sender),
+                           L2_RING_MAC_LEN) == 0, "Sender MAC reported");
+        TEST_ASSERT_EQUAL(XOE_WIRE_HEADER_SIZE + 300, wire_len,
+                          "Frame length kept");
+        TEST_ASSERT(memcmp(wire + XOE_WIRE_HEADER_SIZE,
+                           packet.payload->data, 300) == 0,
+                    "Payload bytes kept");
+    }
+
+    xoe_wire_free_payload(&packet);
+    l2_ring_close(receiver);
+    l2_ring_close(sender);
+}
+
+/* ============================================================================
+ * Main Test Runner
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Wire Layer-2 Unit Tests ===\n\n");
+
+    /* Header tests */
+    run_test("test_encode_parse_roundtrip", test_encode_parse_roundtrip);
+    run_test("test_parse_padding_and_truncation",
+             test_parse_padding_and_truncation);
+    run_test("test_mac_parse_format", test_mac_parse_format);
+
+    /* Ring tests */
+    run_test("test_ring_loopback", test_ring_loopback);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
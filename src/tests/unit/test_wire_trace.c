@@ -0,0 +1,262 @@
+/**
+ * @file test_wire_trace.c
+ * @brief Unit tests for the wire frame flight recorder
+ *
+ * Ring wrap-around and ordering, reset, descriptor bounds, recording from
+ * the real send/receive paths over a socketpair (including a corrupted
+ * frame), formatting, and the dump rate limit.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/protocol/wire_trace.h"
+#include "lib/protocol/wire_format.h"
+#include "lib/protocol/payload_pool.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+/* Descriptor used for the synthetic (no real socket) tests */
+#define TEST_FD 900
+
+/* ============================================================================
+ * Ring Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test entries come back oldest first with their fields
+ */
+void test_record_and_snapshot(void) {
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+    int count;
+
+    xoe_wire_trace_reset(TEST_FD);
+    xoe_wire_trace_record(TEST_FD, XOE_WIRE_TRACE_TX, 0x0001, 10,
+                          XOE_WIRE_TRACE_OK);
+    xoe_wire_trace_record(TEST_FD, XOE_WIRE_TRACE_RX, 0x0002, 20,
+                          XOE_WIRE_TRACE_BAD_CHECKSUM);
+
+    count = xoe_wire_trace_snapshot(TEST_FD, entries, XOE_WIRE_TRACE_DEPTH);
+    TEST_ASSERT_EQUAL(2, count, "Both frames recorded");
+    TEST_ASSERT_EQUAL(1, (int)entries[0].seq, "First frame numbered 1");
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_TX, entries[0].direction,
+                      "First frame sent");
+    TEST_ASSERT_EQUAL(10, (int)entries[0].length, "First frame length");
+    TEST_ASSERT_EQUAL(0x0002, entries[1].protocol_id, "Second frame protocol");
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_BAD_CHECKSUM, entries[1].status,
+                      "Second frame status");
+    TEST_ASSERT(entries[1].timestamp_ns >= entries[0].timestamp_ns,
+                "Timestamps are monotonic");
+}
+
+/**
+ * @brief Test the ring keeps only the newest XOE_WIRE_TRACE_DEPTH frames
+ */
+void test_wraparound(void) {
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+    int total = XOE_WIRE_TRACE_DEPTH * 2 + 5;
+    int ordered = TRUE;
+    int count;
+    int i;
+
+    xoe_wire_trace_reset(TEST_FD);
+    for (i = 1; i <= total; i++) {
+        xoe_wire_trace_record(TEST_FD, XOE_WIRE_TRACE_TX, 0x0001,
+                              (uint32_t)i, XOE_WIRE_TRACE_OK);
+    }
+
+    count = xoe_wire_trace_snapshot(TEST_FD, entries, XOE_WIRE_TRACE_DEPTH);
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_DEPTH, count, "Ring is full");
+    for (i = 0; i < count; i++) {
+        if ((int)entries[i].seq != total - XOE_WIRE_TRACE_DEPTH + 1 + i ||
+            entries[i].length != entries[i].seq) {
+            ordered = FALSE;
+        }
+    }
+    TEST_ASSERT(ordered, "Newest frames kept, oldest first");
+
+    count = xoe_wire_trace_snapshot(TEST_FD, entries, 3);
+    TEST_ASSERT_EQUAL(3, count, "Snapshot honors the caller's capacity");
+}
+
+/**
+ * @brief Test reset forgets history and bad descriptors are ignored
+ */
+void test_reset_and_bounds(void) {
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+    int fds[8];
+    int count;
+    int i;
+    int listed = FALSE;
+
+    xoe_wire_trace_record(TEST_FD, XOE_WIRE_TRACE_TX, 1, 1, XOE_WIRE_TRACE_OK);
+    count = xoe_wire_trace_active(fds, 8);
+    for (i = 0; i < count; i++) {
+        if (fds[i] == TEST_FD) {
+            listed = TRUE;
+        }
+    }
+    TEST_ASSERT(listed, "Traced descriptor is listed as active");
+
+    xoe_wire_trace_reset(TEST_FD);
+    TEST_ASSERT_EQUAL(0, xoe_wire_trace_snapshot(TEST_FD, entries,
+                                                 XOE_WIRE_TRACE_DEPTH),
+                      "Reset trace is empty");
+
+    xoe_wire_trace_record(-1, XOE_WIRE_TRACE_TX, 1, 1, XOE_WIRE_TRACE_OK);
+    xoe_wire_trace_record(XOE_WIRE_TRACE_MAX_FDS, XOE_WIRE_TRACE_TX, 1, 1,
+                          XOE_WIRE_TRACE_OK);
+    TEST_ASSERT_EQUAL(0, xoe_wire_trace_snapshot(XOE_WIRE_TRACE_MAX_FDS,
+                                                 entries, XOE_WIRE_TRACE_DEPTH),
+                      "Out-of-range descriptor is not traced");
+}
+
+/* ============================================================================
+ * Wire Path Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test xoe_wire_send/recv record frames on both ends
+ */
+void test_wire_paths_record(void) {
+    xoe_wire_trace_entry_t entries[XOE_WIRE_TRACE_DEPTH];
+    xoe_packet_t packet;
+    xoe_packet_t received;
+    uint8_t frame[XOE_WIRE_HEADER_SIZE + 4];
+    uint8_t data[4] = {1, 2, 3, 4};
+    int sv[2];
+    int count;
+
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv),
+                      "socketpair");
+    xoe_wire_trace_reset(sv[0]);
+    xoe_wire_trace_reset(sv[1]);
+
+    memset(&packet, 0, sizeof(packet));
+    packet.protocol_id = 0x0003;
+    packet.protocol_version = 1;
+    packet.payload = xoe_payload_alloc(sizeof(data));
+    memcpy(packet.payload->data, data, sizeof(data));
+
+    TEST_ASSERT_EQUAL(0, xoe_wire_send(sv[0], &packet), "Send");
+    TEST_ASSERT_EQUAL(0, xoe_wire_recv(sv[1], &received), "Receive");
+    xoe_wire_free_payload(&received);
+
+    count = xoe_wire_trace_snapshot(sv[0], entries, XOE_WIRE_TRACE_DEPTH);
+    TEST_ASSERT_EQUAL(1, count, "Sender traced one frame");
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_TX, entries[0].direction, "Sent");
+    TEST_ASSERT_EQUAL(4, (int)entries[0].length, "Sent length");
+
+    count = xoe_wire_trace_snapshot(sv[1], entries, XOE_WIRE_TRACE_DEPTH);
+    TEST_ASSERT_EQUAL(1, count, "Receiver traced one frame");
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_RX, entries[0].direction, "Received");
+    TEST_ASSERT_EQUAL(0x0003, entries[0].protocol_id, "Received protocol");
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_OK, entries[0].status, "Checksum held");
+
+    /* Corrupt one payload byte of a hand-built frame */
+    xoe_wire_build_header(&packet, frame, TRUE);
+    memcpy(frame + XOE_WIRE_HEADER_SIZE, data, sizeof(data));
+    frame[XOE_WIRE_HEADER_SIZE] ^= 0xFF;
+    TEST_ASSERT_EQUAL((ssize_t)sizeof(frame),
+                      write(sv[0], frame, sizeof(frame)), "Raw write");
+    TEST_ASSERT_ERROR(xoe_wire_recv(sv[1], &received), E_CHECKSUM_MISMATCH,
+                      "Corrupt frame rejected");
+
+    count = xoe_wire_trace_snapshot(sv[1], entries, XOE_WIRE_TRACE_DEPTH);
+    TEST_ASSERT_EQUAL(2, count, "Corrupt frame traced too");
+    TEST_ASSERT_EQUAL(XOE_WIRE_TRACE_BAD_CHECKSUM, entries[1].status,
+                      "Corrupt frame marked");
+
+    xoe_wire_free_payload(&packet);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+/* ============================================================================
+ * Output Tests
+ * ============================================================================ */
+
+/**
+ * @brief Test an entry formats to one line with its fields
+ */
+void test_format(void) {
+    xoe_wire_trace_entry_t entry;
+    char line[XOE_WIRE_TRACE_LINE_MAX];
+    char tiny[8];
+    int len;
+
+    memset(&entry, 0, sizeof(entry));
+    entry.seq = 42;
+    entry.timestamp_ns = 1000000;
+    entry.length = 512;
+    entry.protocol_id = 0x0002;
+    entry.direction = XOE_WIRE_TRACE_RX;
+    entry.status = XOE_WIRE_TRACE_BAD_CHECKSUM;
+
+    len = xoe_wire_trace_format(&entry, 3000000, line, sizeof(line));
+    TEST_ASSERT(len > 0, "Entry formats");
+    TEST_ASSERT(strstr(line, "#42") != NULL, "Frame number shown");
+    TEST_ASSERT(strstr(line, "rx proto=0x0002 len=512") != NULL,
+                "Direction, protocol and length shown");
+    TEST_ASSERT(strstr(line, "BAD-CRC") != NULL, "Status shown");
+    TEST_ASSERT(strstr(line, "-2000 us") != NULL, "Age shown");
+
+    TEST_ASSERT_ERROR(xoe_wire_trace_format(&entry, 0, tiny, sizeof(tiny)),
+                      E_BUFFER_TOO_SMALL, "Short buffer reported");
+}
+
+/**
+ * @brief Test dumps are limited to one per second
+ */
+void test_dump_rate_limit(void) {
+    FILE* out;
+    long size;
+    int first;
+    int second;
+
+    xoe_wire_trace_reset(TEST_FD);
+    xoe_wire_trace_record(TEST_FD, XOE_WIRE_TRACE_RX, 0x0001, 8,
+                          XOE_WIRE_TRACE_BAD_CHECKSUM);
+
+    out = tmpfile();
+    TEST_ASSERT(out != NULL, "tmpfile");
+    first = xoe_wire_trace_dump(TEST_FD, "test", out);
+    second = xoe_wire_trace_dump(TEST_FD, "test", out);
+
+    /* A second boundary between the calls can let both through */
+    TEST_ASSERT(first || second, "A dump was written");
+    size = ftell(out);
+    TEST_ASSERT(size > 0, "Dump has content");
+    fclose(out);
+
+    TEST_ASSERT_EQUAL(FALSE, xoe_wire_trace_dump(TEST_FD, "test", NULL),
+                      "NULL stream rejected");
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Wire Trace Unit Tests ===\n\n");
+
+    /* Ring tests */
+    run_test("test_record_and_snapshot", test_record_and_snapshot);
+    run_test("test_wraparound", test_wraparound);
+    run_test("test_reset_and_bounds", test_reset_and_bounds);
+
+    /* Wire path tests */
+    run_test("test_wire_paths_record", test_wire_paths_record);
+
+    /* Output tests */
+    run_test("test_format", test_format);
+    run_test("test_dump_rate_limit", test_dump_rate_limit);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
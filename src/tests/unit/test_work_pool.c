@@ -0,0 +1,366 @@
+/**
+ * @file test_work_pool.c
+ * @brief Unit tests for the work-stealing pool
+ *
+ * Tests argument checks, unordered tasks all running (queued ones too
+ * when the pool stops), sequences running their tasks one at a time and
+ * in order, idle threads stealing what waits behind a busy one,
+ * cancelling a sequence's queued tasks while one runs, and submitters
+ * waiting for room at the task limit.
+ *
+ * [LLM-ARCH]
+ */
+
+#include "tests/framework/test_framework.h"
+#include "lib/common/work_pool.h"
+#include "lib/common/metrics.h"
+#include "lib/common/definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define TEST_SEQS 8
+#define TEST_TASKS_PER_SEQ 200
+
+/**
+ * @brief A task of the tests, numbered within its sequence
+ */
+typedef struct {
+    work_task_t task;
+    int seq;                    /* Index into the per-sequence state */
+    int number;
+    int delay_us;
+} test_job_t;
+
+static pthread_mutex_t state_lock = PTHREAD_MUTEX_INITIALIZER;
+static int ran;
+static int dropped;
+static int out_of_order;
+static int overlapped;
+static int last_number[TEST_SEQS];
+static int running[TEST_SEQS];
+
+/* Gate holding tasks until the test opens it */
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static int gate_open;
+
+static void reset_state(void) {
+    ran = 0;
+    dropped = 0;
+    out_of_order = 0;
+    overlapped = 0;
+    memset(last_number, 0, sizeof(last_number));
+    memset(running, 0, sizeof(running));
+    gate_open = FALSE;
+}
+
+static int get_ran(void) {
+    int value;
+
+    pthread_mutex_lock(&state_lock);
+    value = ran;
+    pthread_mutex_unlock(&state_lock);
+    return value;
+}
+
+/**
+ * @brief Check order and exclusion within the job's sequence
+ */
+static void run_job(work_task_t* task, void* arg) {
+    test_job_t* job = (test_job_t*)arg;
+
+    (void)task;
+    pthread_mutex_lock(&state_lock);
+    if (running[job->seq]++ > 0) {
+        overlapped++;
+    }
+    if (job->number != last_number[job->seq] + 1) {
+        out_of_order++;
+    }
+    last_number[job->seq] = job->number;
+    pthread_mutex_unlock(&state_lock);
+
+    if (job->delay_us > 0) {
+        usleep((useconds_t)job->delay_us);
+    }
+
+    pthread_mutex_lock(&state_lock);
+    running[job->seq]--;
+    ran++;
+    pthread_mutex_unlock(&state_lock);
+}
+
+/**
+ * @brief Count a task without ordering checks
+ */
+static void count_job(work_task_t* task, void* arg) {
+    (void)task;
+    (void)arg;
+    pthread_mutex_lock(&state_lock);
+    ran++;
+    pthread_mutex_unlock(&state_lock);
+}
+
+/**
+ * @brief Wait for the gate, then count
+ */
+static void gated_job(work_task_t* task, void* arg) {
+    pthread_mutex_lock(&gate_lock);
+    while (!gate_open) {
+        pthread_cond_wait(&gate_cond, &gate_lock);
+    }
+    pthread_mutex_unlock(&gate_lock);
+    count_job(task, arg);
+}
+
+static void drop_job(work_task_t* task, void* arg) {
+    (void)task;
+    (void)arg;
+    dropped++;
+}
+
+static void open_gate(void) {
+    pthread_mutex_lock(&gate_lock);
+    gate_open = TRUE;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&gate_lock);
+}
+
+/**
+ * @brief Wait until @p count tasks have run
+ */
+static int wait_ran(int count) {
+    int i;
+
+    for (i = 0; i < 500; i++) {
+        if (get_ran() >= count) {
+            return TRUE;
+        }
+        usleep(10000);
+    }
+    return FALSE;
+}
+
+/* ============================================================================
+ * Pool Tests
+ * ============================================================================ */
+
+void test_start_arguments(void) {
+    work_pool_t pool;
+
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, work_pool_start(NULL, 1, 0),
+                      "NULL pool refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, work_pool_start(&pool, 0, 0),
+                      "No threads refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT,
+                      work_pool_start(&pool, WORK_POOL_MAX_THREADS + 1, 0),
+                      "Too many threads refused");
+    TEST_ASSERT_EQUAL(E_INVALID_ARGUMENT, work_pool_start(&pool, 1, -1),
+                      "Negative limit refused");
+
+    memset(&pool, 0, sizeof(pool));
+    work_pool_stop(&pool);
+    work_pool_stop(NULL);
+    TEST_ASSERT_NULL(pool.threads, "Stopping an unstarted pool is a no-op");
+}
+
+void test_unordered_tasks(void) {
+    static work_task_t tasks[500];
+    work_pool_t pool;
+    int i;
+
+    reset_state();
+    TEST_ASSERT_SUCCESS(work_pool_start(&pool, 4, 0), "Pool started");
+    for (i = 0; i < 500; i++) {
+        work_task_init(&tasks[i], count_job, NULL);
+        work_pool_submit(&pool, NULL, &tasks[i]);
+    }
+    work_pool_stop(&pool);
+    TEST_ASSERT_EQUAL(500, get_ran(), "Queued tasks run before stopping");
+    TEST_ASSERT_NULL(pool.threads, "Stopped pool cleared");
+}
+
+/* ============================================================================
+ * Sequence Tests
+ * ============================================================================ */
+
+void test_sequence_order(void) {
+    static test_job_t jobs[TEST_SEQS][TEST_TASKS_PER_SEQ];
+    static work_seq_t seqs[TEST_SEQS];
+    work_pool_t pool;
+    int i;
+    int j;
+
+    reset_state();
+    memset(seqs, 0, sizeof(seqs));
+    TEST_ASSERT_SUCCESS(work_pool_start(&pool, 4, 0), "Pool started");
+
+    /* Interleaved, as connections' frames arrive */
+    for (j = 0; j < TEST_TASKS_PER_SEQ; j++) {
+        for (i = 0; i < TEST_SEQS; i++) {
+            jobs[i][j].seq = i;
+            jobs[i][j].number = j + 1;
+            jobs[i][j].delay_us = (j % 16 == 0) ? 200 : 0;
+            work_task_init(&jobs[i][j].task, run_job, &jobs[i][j]);
+            work_pool_submit(&pool, &seqs[i], &jobs[i][j].task);
+        }
+    }
+    for (i = 0; i < TEST_SEQS; i++) {
+        work_seq_wait(&pool, &seqs[i]);
+    }
+
+    TEST_ASSERT_EQUAL(TEST_SEQS * TEST_TASKS_PER_SEQ, get_ran(),
+                      "Every task ran");
+    TEST_ASSERT_EQUAL(0, out_of_order, "Submission order kept per sequence");
+    TEST_ASSERT_EQUAL(0, overlapped, "One task of a sequence at a time");
+    TEST_ASSERT(!work_seq_busy(&pool, &seqs[0]), "Idle after waiting");
+
+    work_pool_stop(&pool);
+}
+
+void test_idle_threads_steal(void) {
+    static test_job_t hot[10];
+    static work_task_t quick[20];
+    static work_seq_t seq;
+    metrics_snapshot_t before;
+    metrics_snapshot_t after;
+    work_pool_t pool;
+    int i;
+
+    reset_state();
+    memset(&seq, 0, sizeof(seq));
+    metrics_snapshot(&before);
+    TEST_ASSERT_SUCCESS(work_pool_start(&pool, 2, 0), "Pool started");
+
+    /* One thread is kept busy by the hot sequence; half the quick tasks
+     * land on its deque and must be stolen by the other */
+    for (i = 0; i < 10; i++) {
+        hot[i].seq = 0;
+        hot[i].number = i + 1;
+        hot[i].delay_us = 30000;
+        work_task_init(&hot[i].task, run_job, &hot[i]);
+        work_pool_submit(&pool, &seq, &hot[i].task);
+    }
+    usleep(10000);
+    for (i = 0; i < 20; i++) {
+        work_task_init(&quick[i], count_job, NULL);
+        work_pool_submit(&pool, NULL, &quick[i]);
+    }
+
+    TEST_ASSERT(wait_ran(20), "Quick tasks ran");
+    TEST_ASSERT(work_seq_busy(&pool, &seq),
+                "...while the hot sequence was still running");
+    work_seq_wait(&pool, &seq);
+    metrics_snapshot(&after);
+    TEST_ASSERT_EQUAL(30, get_ran(), "Every task ran");
+    TEST_ASSERT_EQUAL(0, out_of_order, "Hot sequence kept its order");
+    TEST_ASSERT(after.values[METRIC_POOL_STEALS] >
+                before.values[METRIC_POOL_STEALS], "Steals counted");
+
+    work_pool_stop(&pool);
+}
+
+void test_cancel_and_wait(void) {
+    static test_job_t jobs[4];
+    static work_seq_t seq;
+    work_pool_t pool;
+    int i;
+
+    reset_state();
+    memset(&seq, 0, sizeof(seq));
+    TEST_ASSERT_SUCCESS(work_pool_start(&pool, 2, 0), "Pool started");
+
+    for (i = 0; i < 4; i++) {
+        jobs[i].seq = 0;
+        jobs[i].number = i + 1;
+        jobs[i].delay_us = 100000;
+        work_task_init(&jobs[i].task, run_job, &jobs[i]);
+        work_pool_submit(&pool, &seq, &jobs[i].task);
+    }
+    usleep(20000);
+
+    /* The first task is running; the rest have not started */
+    TEST_ASSERT_EQUAL(3, work_seq_cancel(&pool, &seq, drop_job),
+                      "Queued tasks taken back");
+    TEST_ASSERT_EQUAL(3, dropped, "Each passed to drop");
+    work_seq_wait(&pool, &seq);
+    TEST_ASSERT_EQUAL(1, get_ran(), "Running task finished");
+    TEST_ASSERT(!work_seq_busy(&pool, &seq), "Sequence idle");
+    TEST_ASSERT_EQUAL(0, work_seq_cancel(&pool, &seq, drop_job),
+                      "Nothing left to cancel");
+
+    work_pool_stop(&pool);
+}
+
+/**
+ * @brief Submit one task from a helper thread and note when it returned
+ */
+typedef struct {
+    work_pool_t* pool;
+    work_task_t task;
+    int returned;
+} submitter_t;
+
+static void* submit_thread(void* arg) {
+    submitter_t* submitter = (submitter_t*)arg;
+
+    work_task_init(&submitter->task, count_job, NULL);
+    work_pool_submit(submitter->pool, NULL, &submitter->task);
+    __atomic_store_n(&submitter->returned, TRUE, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+void test_submit_waits_for_room(void) {
+    static work_task_t gated[4];
+    submitter_t submitter;
+    pthread_t thread;
+    work_pool_t pool;
+    int i;
+
+    reset_state();
+    TEST_ASSERT_SUCCESS(work_pool_start(&pool, 2, 4), "Pool started");
+    for (i = 0; i < 4; i++) {
+        work_task_init(&gated[i], gated_job, NULL);
+        work_pool_submit(&pool, NULL, &gated[i]);
+    }
+
+    submitter.pool = &pool;
+    submitter.returned = FALSE;
+    TEST_ASSERT_SUCCESS(pthread_create(&thread, NULL, submit_thread,
+                                       &submitter), "Submitter started");
+    usleep(50000);
+    TEST_ASSERT(!__atomic_load_n(&submitter.returned, __ATOMIC_SEQ_CST),
+                "Fifth task waits while four are unfinished");
+
+    open_gate();
+    pthread_join(thread, NULL);
+    TEST_ASSERT(submitter.returned, "Queued once tasks finished");
+    TEST_ASSERT(wait_ran(5), "All five ran");
+
+    work_pool_stop(&pool);
+}
+
+/* ============================================================================
+ * Main
+ * ============================================================================ */
+
+int main(void) {
+    printf("=== Work Pool Unit Tests ===\n\n");
+
+    /* Pool tests */
+    run_test("test_start_arguments", test_start_arguments);
+    run_test("test_unordered_tasks", test_unordered_tasks);
+
+    /* Sequence tests */
+    run_test("test_sequence_order", test_sequence_order);
+    run_test("test_idle_threads_steal", test_idle_threads_steal);
+    run_test("test_cancel_and_wait", test_cancel_and_wait);
+    run_test("test_submit_waits_for_room", test_submit_waits_for_room);
+
+    print_test_summary();
+
+    return (tests_failed > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}